@@ -75,9 +75,11 @@ std::string adb_version() {
 
 uint32_t calculate_apacket_checksum(const apacket* p) {
     uint32_t sum = 0;
-    for (size_t i = 0; i < p->msg.data_length; ++i) {
-        sum += static_cast<uint8_t>(p->payload[i]);
-    }
+    p->payload.iterate_blocks([&sum](const char* data, size_t length) {
+        for (size_t i = 0; i < length; ++i) {
+            sum += static_cast<uint8_t>(data[i]);
+        }
+    });
     return sum;
 }
 
@@ -146,7 +148,8 @@ void print_packet(const char *label, apacket *p)
     fprintf(stderr, "%s: %s %08x %08x %04x \"",
             label, tag, p->msg.arg0, p->msg.arg1, p->msg.data_length);
     count = p->msg.data_length;
-    const char* x = p->payload.data();
+    std::string data = p->payload.coalesce<std::string>();
+    const char* x = data.data();
     if (count > DUMPMAX) {
         count = DUMPMAX;
         tag = "\n";
@@ -227,7 +230,7 @@ void send_connect(atransport* t) {
                    << connection_str.length() << ")";
     }
 
-    cp->payload.assign(connection_str.begin(), connection_str.end());
+    cp->payload.append(Block(connection_str.begin(), connection_str.end()));
     cp->msg.data_length = cp->payload.size();
 
     send_packet(cp, t);
@@ -293,7 +296,7 @@ static void handle_new_connection(atransport* t, apacket* p) {
     handle_offline(t);
 
     t->update_version(p->msg.arg0, p->msg.arg1);
-    std::string banner(p->payload.begin(), p->payload.end());
+    std::string banner = p->payload.coalesce<std::string>();
     parse_banner(banner, t);
 
 #if ADB_HOST
@@ -327,16 +330,18 @@ void handle_packet(apacket *p, atransport *t)
     case A_AUTH:
         switch (p->msg.arg0) {
 #if ADB_HOST
-            case ADB_AUTH_TOKEN:
+            case ADB_AUTH_TOKEN: {
                 if (t->GetConnectionState() != kCsAuthorizing) {
                     t->SetConnectionState(kCsAuthorizing);
                 }
-                send_auth_response(p->payload.data(), p->msg.data_length, t);
+                std::string token = p->payload.coalesce<std::string>();
+                send_auth_response(token.data(), token.size(), t);
                 break;
+            }
 #else
             case ADB_AUTH_SIGNATURE: {
                 // TODO: Switch to string_view.
-                std::string signature(p->payload.begin(), p->payload.end());
+                std::string signature = p->payload.coalesce<std::string>();
                 std::string auth_key;
                 if (adbd_auth_verify(t->token, sizeof(t->token), signature, &auth_key)) {
                     adbd_auth_verified(t);
@@ -350,10 +355,12 @@ void handle_packet(apacket *p, atransport *t)
                 break;
             }
 
-            case ADB_AUTH_RSAPUBLICKEY:
-                t->auth_key = std::string(p->payload.data());
+            case ADB_AUTH_RSAPUBLICKEY: {
+                std::string key = p->payload.coalesce<std::string>();
+                t->auth_key = std::string(key.c_str());
                 adbd_auth_confirm_key(t);
                 break;
+            }
 #endif
             default:
                 t->SetConnectionState(kCsOffline);
@@ -364,7 +371,8 @@ void handle_packet(apacket *p, atransport *t)
 
     case A_OPEN: /* OPEN(local-id, 0, "destination") */
         if (t->online && p->msg.arg0 != 0 && p->msg.arg1 == 0) {
-            std::string_view address(p->payload.begin(), p->payload.size());
+            std::string payload = p->payload.coalesce<std::string>();
+            std::string_view address(payload);
 
             // Historically, we received service names as a char*, and stopped at the first NUL
             // byte. The client sent strings with null termination, which post-string_view, start
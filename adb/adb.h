@@ -60,7 +60,7 @@ constexpr size_t LINUX_MAX_SOCKET_SIZE = 4194304;
 std::string adb_version();
 
 // Increment this when we want to force users to start a new adb server.
-#define ADB_SERVER_VERSION 41
+#define ADB_SERVER_VERSION 45
 
 using TransportId = uint64_t;
 class atransport;
@@ -163,7 +163,7 @@ unique_fd execute_abb_command(std::string_view command);
 #if !ADB_HOST
 int init_jdwp(void);
 asocket* create_jdwp_service_socket();
-asocket* create_jdwp_tracker_service_socket();
+asocket* create_jdwp_tracker_service_socket(bool delta);
 unique_fd create_jdwp_connection_fd(int jdwp_pid);
 #endif
 
@@ -21,16 +21,22 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <android-base/file.h>
+#include <android-base/parseint.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 
 #include "adb.h"
 #include "adb_client.h"
+#include "adb_io.h"
 #include "adb_unique_fd.h"
 #include "adb_utils.h"
 #include "client/file_sync_client.h"
@@ -41,6 +47,9 @@
 static constexpr int kFastDeployMinApi = 24;
 #endif
 
+// Upper bound for $ADB_INSTALL_JOBS.
+static constexpr size_t kMaxInstallJobs = 16;
+
 namespace {
 
 enum InstallMode {
@@ -179,23 +188,15 @@ static int install_app_streamed(int argc, const char** argv, bool use_fastdeploy
     if (use_fastdeploy == true) {
 #if defined(ENABLE_FASTDEPLOY)
         TemporaryFile metadataTmpFile;
-        std::string patchTmpFilePath;
-        {
-            TemporaryFile patchTmpFile;
-            patchTmpFile.DoNotRemove();
-            patchTmpFilePath = patchTmpFile.path;
-        }
 
         FILE* metadataFile = fopen(metadataTmpFile.path, "wb");
         extract_metadata(file, metadataFile);
         fclose(metadataFile);
 
-        create_patch(file, metadataTmpFile.path, patchTmpFilePath.c_str());
         // pass all but 1st (command) and last (apk path) parameters through to pm for
         // session creation
         std::vector<const char*> pm_args{argv + 1, argv + argc - 1};
-        install_patch(file, patchTmpFilePath.c_str(), pm_args.size(), pm_args.data());
-        adb_unlink(patchTmpFilePath.c_str());
+        install_patch(file, metadataTmpFile.path, pm_args.size(), pm_args.data());
         delete_device_patch_file(file);
         return 0;
 #else
@@ -291,14 +292,12 @@ static int install_app_legacy(int argc, const char** argv, bool use_fastdeploy,
     if (use_fastdeploy == true) {
 #if defined(ENABLE_FASTDEPLOY)
         TemporaryFile metadataTmpFile;
-        TemporaryFile patchTmpFile;
 
         FILE* metadataFile = fopen(metadataTmpFile.path, "wb");
         extract_metadata(apk_file[0], metadataFile);
         fclose(metadataFile);
 
-        create_patch(apk_file[0], metadataTmpFile.path, patchTmpFile.path);
-        apply_patch_on_device(apk_file[0], patchTmpFile.path, apk_dest.c_str());
+        apply_patch_on_device(apk_file[0], metadataTmpFile.path, apk_dest.c_str());
 #else
         error_exit("fastdeploy is disabled");
 #endif
@@ -415,6 +414,134 @@ int install_app(int argc, const char** argv) {
     }
 }
 
+// Streams one split into an install session with install-write. On failure the
+// reason is left in *error.
+static bool install_write_split(const std::string& install_cmd, bool use_abb, int session_id,
+                                const char* file, bool report, std::string* error) {
+    struct stat sb;
+    if (stat(file, &sb) == -1) {
+        *error = android::base::StringPrintf("failed to stat \"%s\": %s", file, strerror(errno));
+        return false;
+    }
+
+    unique_fd local_fd(adb_open(file, O_RDONLY | O_CLOEXEC));
+    if (local_fd < 0) {
+        *error = android::base::StringPrintf("failed to open \"%s\": %s", file, strerror(errno));
+        return false;
+    }
+#ifdef __linux__
+    posix_fadvise(local_fd.get(), 0, 0, POSIX_FADV_SEQUENTIAL | POSIX_FADV_NOREUSE);
+#endif
+
+    std::string size = android::base::StringPrintf("%" PRIu64, static_cast<uint64_t>(sb.st_size));
+    std::string name = android::base::Basename(file);
+    std::string connect_error;
+    unique_fd remote_fd;
+    if (use_abb) {
+        std::vector<std::string> cmd_args = {
+                "package", "install-write", "-S", size, std::to_string(session_id), name, "-"};
+        remote_fd = send_abb_exec_command(cmd_args, &connect_error);
+    } else {
+        std::string cmd = android::base::StringPrintf("%s install-write -S %s %d %s -",
+                                                      install_cmd.c_str(), size.c_str(),
+                                                      session_id, name.c_str());
+        remote_fd.reset(adb_connect(cmd, &connect_error));
+    }
+    if (remote_fd < 0) {
+        *error = "connect error for write: " + connect_error;
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<char> buf(256 * 1024);
+    uint64_t total = 0;
+    while (true) {
+        int len = adb_read(local_fd.get(), buf.data(), buf.size());
+        if (len < 0) {
+            *error = android::base::StringPrintf("failed to read \"%s\": %s", file,
+                                                 strerror(errno));
+            return false;
+        }
+        if (len == 0) break;
+        if (!WriteFdExactly(remote_fd.get(), buf.data(), len)) {
+            break;
+        }
+        total += len;
+    }
+
+    char status[BUFSIZ];
+    read_status_line(remote_fd.get(), status, sizeof(status));
+    if (strncmp("Success", status, 7)) {
+        *error = android::base::StringPrintf("failed to write \"%s\"\n%s", file, status);
+        return false;
+    }
+
+    if (report) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        double seconds = std::max(elapsed.count(), 0.001);
+        printf("%s: %" PRIu64 " bytes in %.3fs (%.1f MB/s)\n", name.c_str(), total, seconds,
+               total / seconds / (1024.0 * 1024.0));
+    }
+    return true;
+}
+
+// Streams every split into the session, $ADB_INSTALL_JOBS of them at a time.
+// With more than one job each split gets its own stream, so the device can be
+// writing one split while the host is still reading the next.
+static bool install_write_splits(const std::string& install_cmd, int session_id,
+                                 const char** files, size_t count) {
+    size_t jobs = 1;
+    const char* jobs_env = getenv("ADB_INSTALL_JOBS");
+    if (jobs_env != nullptr && !android::base::ParseUint(jobs_env, &jobs, kMaxInstallJobs)) {
+        fprintf(stderr, "adb: ignoring $ADB_INSTALL_JOBS '%s': expected 1-%zu\n", jobs_env,
+                kMaxInstallJobs);
+    }
+    jobs = std::clamp<size_t>(jobs, 1, count);
+
+    const bool use_abb = install_cmd != "exec:pm" && can_use_feature(kFeatureAbbExec);
+    if (jobs == 1) {
+        for (size_t i = 0; i < count; ++i) {
+            std::string error;
+            if (!install_write_split(install_cmd, use_abb, session_id, files[i], false, &error)) {
+                fprintf(stderr, "adb: %s\n", error.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::mutex output_mutex;
+    auto worker = [&]() {
+        size_t i;
+        while (!failed && (i = next++) < count) {
+            std::string error;
+            bool success =
+                    install_write_split(install_cmd, use_abb, session_id, files[i], true, &error);
+            if (!success) {
+                std::lock_guard<std::mutex> lock(output_mutex);
+                fprintf(stderr, "adb: %s\n", error.c_str());
+                failed = true;
+            }
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < jobs; ++i) {
+        threads.emplace_back(worker);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    if (failed) return false;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%zu splits written in %.3fs over %zu streams\n", count, elapsed.count(), jobs);
+    return true;
+}
+
 int install_multiple_app(int argc, const char** argv) {
     // Find all APK arguments starting at end.
     // All other arguments passed through verbatim.
@@ -481,48 +608,9 @@ int install_multiple_app(int argc, const char** argv) {
     }
 
     // Valid session, now stream the APKs
-    bool success = true;
-    for (int i = first_apk; i < argc; i++) {
-        const char* file = argv[i];
-        struct stat sb;
-        if (stat(file, &sb) == -1) {
-            fprintf(stderr, "adb: failed to stat \"%s\": %s\n", file, strerror(errno));
-            success = false;
-            goto finalize_session;
-        }
-
-        std::string cmd =
-                android::base::StringPrintf("%s install-write -S %" PRIu64 " %d %s -",
-                                            install_cmd.c_str(), static_cast<uint64_t>(sb.st_size),
-                                            session_id, android::base::Basename(file).c_str());
-
-        unique_fd local_fd(adb_open(file, O_RDONLY | O_CLOEXEC));
-        if (local_fd < 0) {
-            fprintf(stderr, "adb: failed to open \"%s\": %s\n", file, strerror(errno));
-            success = false;
-            goto finalize_session;
-        }
-
-        std::string error;
-        unique_fd remote_fd(adb_connect(cmd, &error));
-        if (remote_fd < 0) {
-            fprintf(stderr, "adb: connect error for write: %s\n", error.c_str());
-            success = false;
-            goto finalize_session;
-        }
-
-        copy_to_file(local_fd.get(), remote_fd.get());
-        read_status_line(remote_fd.get(), buf, sizeof(buf));
-
-        if (strncmp("Success", buf, 7)) {
-            fprintf(stderr, "adb: failed to write \"%s\"\n", file);
-            fputs(buf, stderr);
-            success = false;
-            goto finalize_session;
-        }
-    }
+    bool success = install_write_splits(install_cmd, session_id, argv + first_apk,
+                                        argc - first_apk);
 
-finalize_session:
     // Commit session if we streamed everything okay; otherwise abandon.
     std::string service = android::base::StringPrintf("%s install-%s %d", install_cmd.c_str(),
                                                       success ? "commit" : "abandon", session_id);
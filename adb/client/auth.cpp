@@ -470,7 +470,7 @@ static void send_auth_publickey(atransport* t) {
     p->msg.arg0 = ADB_AUTH_RSAPUBLICKEY;
 
     // adbd expects a null-terminated string.
-    p->payload.assign(key.data(), key.data() + key.size() + 1);
+    p->payload.append(Block(key.data(), key.data() + key.size() + 1));
     p->msg.data_length = p->payload.size();
     send_packet(p, t);
 }
@@ -497,7 +497,7 @@ void send_auth_response(const char* token, size_t token_size, atransport* t) {
 
     p->msg.command = A_AUTH;
     p->msg.arg0 = ADB_AUTH_SIGNATURE;
-    p->payload.assign(result.begin(), result.end());
+    p->payload.append(Block(result.begin(), result.end()));
     p->msg.data_length = p->payload.size();
     send_packet(p, t);
 }
@@ -31,7 +31,12 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
@@ -139,6 +144,10 @@ static void help() {
         "     -T: disable PTY allocation\n"
         "     -t: force PTY allocation\n"
         "     -x: disable remote exit codes and stdout/stderr separation\n"
+        " shell-batch [-j JOBS]\n"
+        "     run each line of stdin as a shell command, printing \"#adb-exit STATUS\"\n"
+        "     after its output; reuses one client and device for the whole batch\n"
+        "     -j: commands to run at once; output still follows input order (default 1)\n"
         " emu COMMAND              run emulator console command\n"
         "\n"
         "app installation (see also `adb shell cmd package help`):\n"
@@ -213,6 +222,7 @@ static void help() {
         " reconnect                kick connection from host side to force reconnect\n"
         " reconnect device         kick connection from device side to force reconnect\n"
         " reconnect offline        reset offline/unauthorized devices to force reconnect\n"
+        " usb-stats                show the device's USB transfer sizes and throughput\n"
         "\n"
         "environment variables:\n"
         " $ADB_TRACE\n"
@@ -222,6 +232,11 @@ static void help() {
         " $ANDROID_SERIAL          serial number to connect to (see -s)\n"
         " $ANDROID_LOG_TAGS        tags to be used by logcat (see logcat --help)\n"
         " $ADB_LOCAL_TRANSPORT_MAX_PORT max emulator scan port (default 5585, 16 emus)\n"
+        " $ADB_INSTALL_JOBS        splits to stream at once for install-multiple (default 1, max 16)\n"
+        " $ADB_COMPRESSION         set to 0 to send push/pull data uncompressed\n"
+        " $ADB_SYNC_DELTA          set to 0 to resend changed files whole on push --sync/sync\n"
+        " $ADB_SYNC_PIPELINE       files to keep in flight during push/pull (default 1, max 128)\n"
+        " $ADB_URING               set to 0 to make the server wait on epoll instead of io_uring\n"
     );
     // clang-format on
 }
@@ -764,6 +779,123 @@ static int adb_shell(int argc, const char** argv) {
                        service_string);
 }
 
+struct BatchCommandResult {
+    std::string out;
+    std::string err;
+    int status = 0;
+};
+
+static BatchCommandResult run_batch_command(const std::string& command, bool use_shell_protocol,
+                                            TransportId* transport) {
+    BatchCommandResult result;
+    std::string service = ShellServiceString(
+            use_shell_protocol, use_shell_protocol ? kShellServiceArgRaw : "", command);
+    std::string error;
+    unique_fd fd(adb_connect(transport, service, &error));
+    if (fd < 0) {
+        result.err = "error: " + error + "\n";
+        result.status = 1;
+        return result;
+    }
+
+    DefaultStandardStreamsCallback callback(&result.out, &result.err);
+    result.status = read_and_dump(fd.get(), use_shell_protocol, &callback);
+    return result;
+}
+
+// Runs many short commands without paying for a new adb process, server
+// version check, feature query and device lookup for each one. The device is
+// looked up for the first command only; the rest are sent straight to its
+// transport id.
+static int adb_shell_batch(int argc, const char** argv) {
+    static constexpr size_t kMaxJobs = 64;
+    size_t jobs = 1;
+    if (argc == 3 && !strcmp(argv[1], "-j")) {
+        if (!android::base::ParseUint(argv[2], &jobs, kMaxJobs) || jobs == 0) {
+            error_exit("-j expects 1-%zu, got '%s'", kMaxJobs, argv[2]);
+        }
+    } else if (argc != 1) {
+        error_exit("usage: adb shell-batch [-j JOBS]");
+    }
+
+    FeatureSet features;
+    std::string error;
+    if (!adb_get_feature_set(&features, &error)) {
+        fprintf(stderr, "error: %s\n", error.c_str());
+        return 1;
+    }
+    const bool use_shell_protocol = CanUseFeature(features, kFeatureShell2);
+
+    // Results are printed in input order, while up to |jobs| commands run.
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::future<BatchCommandResult>> pending;
+    bool eof = false;
+
+    std::thread printer([&]() {
+        while (true) {
+            std::future<BatchCommandResult> next;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return !pending.empty() || eof; });
+                if (pending.empty()) return;
+                next = std::move(pending.front());
+            }
+
+            BatchCommandResult result = next.get();
+            fwrite(result.err.data(), 1, result.err.size(), stderr);
+            fflush(stderr);
+            fwrite(result.out.data(), 1, result.out.size(), stdout);
+            if (!result.out.empty() && result.out.back() != '\n') {
+                fputc('\n', stdout);
+            }
+            printf("#adb-exit %d\n", result.status);
+            fflush(stdout);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.pop_front();
+            cv.notify_all();
+        }
+    });
+
+    bool pinned = false;
+    TransportId transport_id = 0;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (android::base::Trim(line).empty()) continue;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return pending.size() < jobs; });
+        }
+
+        auto result = std::async(std::launch::async, run_batch_command, line, use_shell_protocol,
+                                 pinned ? nullptr : &transport_id);
+        if (!pinned) {
+            result.wait();
+            if (transport_id != 0) {
+                TransportType type;
+                adb_get_transport(&type, nullptr, nullptr);
+                adb_set_transport(type, nullptr, transport_id);
+                pinned = true;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(std::move(result));
+        cv.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        eof = true;
+        cv.notify_all();
+    }
+    printer.join();
+    return 0;
+}
+
 static int adb_abb(int argc, const char** argv) {
     FeatureSet features;
     std::string error_message;
@@ -1185,6 +1317,48 @@ int send_shell_command(const std::string& command, bool disable_shell_protocol,
     return read_and_dump(fd.get(), use_shell_protocol, callback);
 }
 
+int send_shell_command_with_stdin(const std::string& command,
+                                  const std::function<void(borrowed_fd)>& write_stdin,
+                                  StandardStreamsCallbackInterface* callback) {
+    std::string error;
+    unique_fd fd(adb_connect(ShellServiceString(true, "", command), &error));
+    if (fd < 0) {
+        fprintf(stderr, "adb: failed to run %s: %s\n", command.c_str(), error.c_str());
+        return 1;
+    }
+
+    int sockets[2];
+    if (adb_socketpair(sockets) != 0) {
+        fprintf(stderr, "adb: failed to create socketpair: %s\n", strerror(errno));
+        return 1;
+    }
+    unique_fd stdin_write(sockets[0]);
+    unique_fd stdin_read(sockets[1]);
+
+    std::thread writer([&]() {
+        write_stdin(stdin_write);
+        stdin_write.reset();
+    });
+
+    // The output is at most a few messages, so it can wait for stdin to be sent.
+    ShellProtocol protocol(fd);
+    while (true) {
+        int r = adb_read(stdin_read, protocol.data(), protocol.data_capacity());
+        if (r <= 0) {
+            protocol.Write(ShellProtocol::kIdCloseStdin, 0);
+            break;
+        }
+        if (!protocol.Write(ShellProtocol::kIdStdin, r)) {
+            break;
+        }
+    }
+    // Unblocks the writer if the device went away.
+    stdin_read.reset();
+    writer.join();
+
+    return read_and_dump(fd.get(), true, callback);
+}
+
 static int logcat(int argc, const char** argv) {
     char* log_tags = getenv("ANDROID_LOG_TAGS");
     std::string quoted = escape_arg(log_tags == nullptr ? "" : log_tags);
@@ -1633,6 +1807,8 @@ int adb_commandline(int argc, const char** argv) {
         return adb_send_emulator_command(argc, argv, serial);
     } else if (!strcmp(argv[0], "shell")) {
         return adb_shell(argc, argv);
+    } else if (!strcmp(argv[0], "shell-batch")) {
+        return adb_shell_batch(argc, argv);
     } else if (!strcmp(argv[0], "exec-in") || !strcmp(argv[0], "exec-out")) {
         int exec_in = !strcmp(argv[0], "exec-in");
 
@@ -1934,6 +2110,8 @@ int adb_commandline(int argc, const char** argv) {
             }
         }
         return 0;
+    } else if (!strcmp(argv[0], "usb-stats")) {
+        return adb_connect_command("usb-stats");
     } else if (!strcmp(argv[0], "host-features")) {
         return adb_query_command("host:host-features");
     } else if (!strcmp(argv[0], "reconnect")) {
@@ -17,6 +17,8 @@
 #ifndef COMMANDLINE_H
 #define COMMANDLINE_H
 
+#include <functional>
+
 #include <android-base/strings.h>
 
 #include "adb.h"
@@ -109,6 +111,12 @@ int send_shell_command(
         const std::string& command, bool disable_shell_protocol = false,
         StandardStreamsCallbackInterface* callback = &DEFAULT_STANDARD_STREAMS_CALLBACK);
 
+// Like send_shell_command, but the command's stdin is whatever |write_stdin| writes to the fd
+// it's given, sent to the device as it's written. Requires the shell protocol.
+int send_shell_command_with_stdin(
+        const std::string& command, const std::function<void(borrowed_fd)>& write_stdin,
+        StandardStreamsCallbackInterface* callback = &DEFAULT_STANDARD_STREAMS_CALLBACK);
+
 // Connects to the device "abb" service with |command| and returns the fd.
 template <typename ContainerT>
 unique_fd send_abb_exec_command(const ContainerT& command_args, std::string* error) {
@@ -229,16 +229,20 @@ void extract_metadata(const char* apkPath, FILE* outputFp) {
     }
 }
 
-void create_patch(const char* apkPath, const char* metadataPath, const char* patchPath) {
+static void create_patch(const char* apkPath, const char* metadataPath, borrowed_fd output) {
     DeployPatchGenerator generator(false);
+    bool success = generator.CreatePatch(apkPath, metadataPath, output);
+    if (!success) {
+        error_exit("Failed to create patch for %s", apkPath);
+    }
+}
+
+void create_patch(const char* apkPath, const char* metadataPath, const char* patchPath) {
     unique_fd patchFd(adb_open(patchPath, O_WRONLY | O_CREAT | O_CLOEXEC));
     if (patchFd < 0) {
         perror_exit("adb: failed to create %s", patchPath);
     }
-    bool success = generator.CreatePatch(apkPath, metadataPath, patchFd);
-    if (!success) {
-        error_exit("Failed to create patch for %s", apkPath);
-    }
+    create_patch(apkPath, metadataPath, patchFd);
 }
 
 std::string get_patch_path(const char* apkPath) {
@@ -248,42 +252,56 @@ std::string get_patch_path(const char* apkPath) {
     return patchDevicePath;
 }
 
-void apply_patch_on_device(const char* apkPath, const char* patchPath, const char* outputPath) {
-    const std::string kAgentApplyCommandPattern = "/data/local/tmp/deployagent apply %s %s -o %s";
+// Creates the patch for |apkPath| and runs "deployagent apply <package> <patch> <agentArgs>"
+// with it. With the shell protocol the patch is written straight to the agent's stdin, so that
+// creating it, sending it and applying it on the device all happen at once. Otherwise it is
+// created and pushed first.
+static void apply_patch(const char* apkPath, const char* metadataPath,
+                        const std::string& agentArgs) {
+    const char* kAgentApplyCommandPattern = "/data/local/tmp/deployagent apply %s %s %s";
     std::string packageName = get_packagename_from_apk(apkPath);
-    std::string patchDevicePath = get_patch_path(apkPath);
 
-    std::vector<const char*> srcs = {patchPath};
-    bool push_ok = do_sync_push(srcs, patchDevicePath.c_str(), false);
-    if (!push_ok) {
-        error_exit("Error pushing %s to %s returned", patchPath, patchDevicePath.c_str());
+    FeatureSet features;
+    std::string error;
+    if (!adb_get_feature_set(&features, &error)) {
+        error_exit("%s", error.c_str());
     }
 
-    std::string applyPatchCommand =
-            android::base::StringPrintf(kAgentApplyCommandPattern.c_str(), packageName.c_str(),
-                                        patchDevicePath.c_str(), outputPath);
+    std::string applyPatchCommand;
+    int returnCode;
+    if (CanUseFeature(features, kFeatureShell2)) {
+        applyPatchCommand = android::base::StringPrintf(
+                kAgentApplyCommandPattern, packageName.c_str(), "-", agentArgs.c_str());
+        returnCode = send_shell_command_with_stdin(
+                applyPatchCommand,
+                [&](borrowed_fd output) { create_patch(apkPath, metadataPath, output); });
+    } else {
+        TemporaryFile patchTmpFile;
+        create_patch(apkPath, metadataPath, patchTmpFile.path);
+
+        std::string patchDevicePath = get_patch_path(apkPath);
+        std::vector<const char*> srcs = {patchTmpFile.path};
+        bool push_ok = do_sync_push(srcs, patchDevicePath.c_str(), false);
+        if (!push_ok) {
+            error_exit("Error pushing %s to %s returned", patchTmpFile.path,
+                       patchDevicePath.c_str());
+        }
 
-    int returnCode = send_shell_command(applyPatchCommand);
+        applyPatchCommand = android::base::StringPrintf(kAgentApplyCommandPattern,
+                                                        packageName.c_str(),
+                                                        patchDevicePath.c_str(), agentArgs.c_str());
+        returnCode = send_shell_command(applyPatchCommand);
+    }
     if (returnCode != 0) {
         error_exit("Executing %s returned %d", applyPatchCommand.c_str(), returnCode);
     }
 }
 
-void install_patch(const char* apkPath, const char* patchPath, int argc, const char** argv) {
-    const std::string kAgentApplyCommandPattern = "/data/local/tmp/deployagent apply %s %s -pm %s";
-    std::string packageName = get_packagename_from_apk(apkPath);
-
-    std::string patchDevicePath =
-            android::base::StringPrintf("%s%s.patch", kDeviceAgentPath, packageName.c_str());
-
-    std::vector<const char*> srcs{patchPath};
-    bool push_ok = do_sync_push(srcs, patchDevicePath.c_str(), false);
-    if (!push_ok) {
-        error_exit("Error pushing %s to %s returned", patchPath, patchDevicePath.c_str());
-    }
+void apply_patch_on_device(const char* apkPath, const char* metadataPath, const char* outputPath) {
+    apply_patch(apkPath, metadataPath, std::string("-o ") + outputPath);
+}
 
-    std::vector<unsigned char> applyOutputBuffer;
-    std::vector<unsigned char> applyErrorBuffer;
+void install_patch(const char* apkPath, const char* metadataPath, int argc, const char** argv) {
     std::string argsString;
 
     bool rSwitchPresent = false;
@@ -298,13 +316,7 @@ void install_patch(const char* apkPath, const char* patchPath, int argc, const c
         argsString.append("-r");
     }
 
-    std::string applyPatchCommand =
-            android::base::StringPrintf(kAgentApplyCommandPattern.c_str(), packageName.c_str(),
-                                        patchDevicePath.c_str(), argsString.c_str());
-    int returnCode = send_shell_command(applyPatchCommand);
-    if (returnCode != 0) {
-        error_exit("Executing %s returned %d", applyPatchCommand.c_str(), returnCode);
-    }
+    apply_patch(apkPath, metadataPath, "-pm " + argsString);
 }
 
 bool find_package(const char* apkPath) {
@@ -29,7 +29,7 @@ int get_device_api_level();
 void update_agent(FastDeploy_AgentUpdateStrategy agentUpdateStrategy);
 void extract_metadata(const char* apkPath, FILE* outputFp);
 void create_patch(const char* apkPath, const char* metadataPath, const char* patchPath);
-void apply_patch_on_device(const char* apkPath, const char* patchPath, const char* outputPath);
-void install_patch(const char* apkPath, const char* patchPath, int argc, const char** argv);
+void apply_patch_on_device(const char* apkPath, const char* metadataPath, const char* outputPath);
+void install_patch(const char* apkPath, const char* metadataPath, int argc, const char** argv);
 std::string get_patch_path(const char* apkPath);
 bool find_package(const char* apkPath);
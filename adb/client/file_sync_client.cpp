@@ -29,6 +29,7 @@
 #include <utime.h>
 
 #include <chrono>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <sstream>
@@ -41,6 +42,7 @@
 #include "adb_client.h"
 #include "adb_io.h"
 #include "adb_utils.h"
+#include "compression_utils.h"
 #include "file_sync_protocol.h"
 #include "line_printer.h"
 #include "sysdeps/errno.h"
@@ -49,9 +51,26 @@
 #include "client/commandline.h"
 
 #include <android-base/file.h>
+#include <android-base/parseint.h>
 #include <android-base/strings.h>
 #include <android-base/stringprintf.h>
 
+#include <openssl/sha.h>
+
+// adbd stops reading requests while its replies are backed up, so the files
+// in flight have to be bounded. Each reply ties up around 600 bytes of the
+// device's socket buffer once bookkeeping is counted, and the default buffer
+// is about 200KiB, which leaves comfortable room for this many.
+static constexpr size_t kMaxPipelineDepth = 128;
+
+// Files this size or bigger are patched rather than resent by `push --sync`
+// and `adb sync`, when the device has an older copy. Below it the extra round
+// trip for the remote hashes costs more than it saves.
+static constexpr uint64_t kDeltaMinSize = 1024 * 1024;
+// Small enough to isolate a few changed pages, big enough that the hashes of
+// a 200MiB library are 400KiB. Doubled as needed for huge files.
+static constexpr uint32_t kDeltaBlockSize = 16 * 1024;
+
 struct syncsendbuf {
     unsigned id;
     unsigned size;
@@ -82,6 +101,9 @@ struct copyinfo {
     uint32_t mode;
     uint64_t size = 0;
     bool skip = false;
+    // Patch the older copy on the device, remote_size bytes long.
+    bool delta = false;
+    uint64_t remote_size = 0;
 
     copyinfo(const std::string& local_path,
              const std::string& remote_path,
@@ -202,14 +224,30 @@ struct TransferLedger {
 
 class SyncConnection {
   public:
-    SyncConnection() : expect_done_(false) {
+    SyncConnection() : pipeline_depth_(1), compression_(false), delta_(false) {
         max = SYNC_DATA_MAX; // TODO: decide at runtime.
 
+        // Opt-in: older devices are happy with pipelined requests (replies
+        // arrive in order), but a failure is reported later than the file
+        // being sent at the time.
+        const char* depth = getenv("ADB_SYNC_PIPELINE");
+        if (depth != nullptr &&
+            !android::base::ParseUint(depth, &pipeline_depth_, kMaxPipelineDepth)) {
+            Warning("ignoring $ADB_SYNC_PIPELINE '%s': expected 1-%zu", depth, kMaxPipelineDepth);
+        }
+        if (pipeline_depth_ == 0) pipeline_depth_ = 1;
+
         std::string error;
         if (!adb_get_feature_set(&features_, &error)) {
             Error("failed to get feature set: %s", error.c_str());
         } else {
             have_stat_v2_ = CanUseFeature(features_, kFeatureStat2);
+            const char* compression = getenv("ADB_COMPRESSION");
+            compression_ = CanUseFeature(features_, kFeatureSendRecv2) &&
+                           CanUseFeature(features_, kFeatureSendRecv2Brotli) &&
+                           !(compression && !strcmp(compression, "0"));
+            const char* delta = getenv("ADB_SYNC_DELTA");
+            delta_ = CanUseFeature(features_, kFeatureDeltaSync) && !(delta && !strcmp(delta, "0"));
             fd.reset(adb_connect("sync:", &error));
             if (fd < 0) {
                 Error("connect failed: %s", error.c_str());
@@ -237,6 +275,59 @@ class SyncConnection {
 
     bool IsValid() { return fd >= 0; }
 
+    // How many files may be sent or requested before waiting on the first.
+    size_t PipelineDepth() const { return pipeline_depth_; }
+
+    // Whether regular file contents travel brotli compressed.
+    bool UsingCompression() const { return compression_; }
+
+    // Whether a local file should be sent as a patch against remote, the
+    // result of an lstat of the older copy on the device.
+    bool CanSendDelta(mode_t local_mode, uint64_t local_size, const struct stat& remote) const {
+        return delta_ && S_ISREG(local_mode) && S_ISREG(remote.st_mode) &&
+               local_size >= kDeltaMinSize && remote.st_size > 0;
+    }
+
+    // Fetch the block hashes of rpath, which was remote_size bytes long when
+    // last looked at. Fails, with errno set, if the device can't hash it.
+    bool RequestHashes(const char* rpath, uint64_t remote_size, uint32_t* block_size,
+                       std::vector<uint8_t>* digests) {
+        *block_size = kDeltaBlockSize;
+        while ((remote_size / *block_size) >= SYNC_HASH_MAX_BLOCKS &&
+               *block_size < SYNC_HASH_BLOCK_MAX) {
+            *block_size *= 2;
+        }
+
+        std::vector<char> buf;
+        if (!AppendRequest(&buf, ID_HASH, rpath)) {
+            return false;
+        }
+        syncmsg msg;
+        msg.hash_setup.id = ID_HASH;
+        msg.hash_setup.block_size = *block_size;
+        AppendBytes(&buf, &msg.hash_setup, sizeof(msg.hash_setup));
+        if (!WriteFdExactly(fd, &buf[0], buf.size())) {
+            return false;
+        }
+
+        if (!ReadFdExactly(fd, &msg.hash, sizeof(msg.hash))) {
+            PLOG(FATAL) << "protocol fault: failed to read hash response";
+        }
+        if (msg.hash.id != ID_HASH || msg.hash.count > SYNC_HASH_MAX_BLOCKS) {
+            LOG(FATAL) << "protocol fault: bad hash response: " << msg.hash.id;
+        }
+        digests->resize(msg.hash.count * SYNC_HASH_DIGEST_LENGTH);
+        if (!digests->empty() && !ReadFdExactly(fd, digests->data(), digests->size())) {
+            PLOG(FATAL) << "protocol fault: failed to read hashes";
+        }
+        if (msg.hash.error != 0) {
+            errno = errno_from_wire(msg.hash.error);
+            return false;
+        }
+        *block_size = msg.hash.block_size;
+        return true;
+    }
+
     bool ReceivedError(const char* from, const char* to) {
         adb_pollfd pfd = {.fd = fd.get(), .events = POLLIN};
         int rc = adb_poll(&pfd, 1, 0);
@@ -301,6 +392,23 @@ class SyncConnection {
         return WriteFdExactly(fd, &buf[0], buf.size());
     }
 
+    // Ask for rpath, as a compressed stream if the device supports it.
+    bool SendRecv(const char* rpath) {
+        if (!compression_) {
+            return SendRequest(ID_RECV, rpath);
+        }
+
+        std::vector<char> buf;
+        if (!AppendRequest(&buf, ID_RECV_V2, rpath)) {
+            return false;
+        }
+        syncmsg msg;
+        msg.recv_v2_setup.id = ID_RECV_V2;
+        msg.recv_v2_setup.flags = kSyncFlagBrotli;
+        AppendBytes(&buf, &msg.recv_v2_setup, sizeof(msg.recv_v2_setup));
+        return WriteFdExactly(fd, &buf[0], buf.size());
+    }
+
     bool SendStat(const char* path_and_mode) {
         if (!have_stat_v2_) {
             errno = ENOTSUP;
@@ -374,43 +482,43 @@ class SyncConnection {
 
     // Sending header, payload, and footer in a single write makes a huge
     // difference to "adb sync" performance.
-    bool SendSmallFile(const char* path_and_mode,
-                       const char* lpath, const char* rpath,
-                       unsigned mtime,
+    bool SendSmallFile(const char* lpath, const char* rpath, mode_t mode, unsigned mtime,
                        const char* data, size_t data_length) {
-        size_t path_length = strlen(path_and_mode);
-        if (path_length > 1024) {
-            Error("SendSmallFile failed: path too long: %zu", path_length);
-            errno = ENAMETOOLONG;
+        bool compressed = compression_ && !S_ISLNK(mode);
+
+        std::vector<char> buf;
+        buf.reserve(sizeof(SyncRequest) + strlen(rpath) + sizeof(syncmsg) +
+                    sizeof(SyncRequest) + data_length + sizeof(SyncRequest));
+        if (!AppendSendRequest(&buf, rpath, mode, compressed)) {
+            Error("SendSmallFile failed: path too long: %zu", strlen(rpath));
             return false;
         }
 
-        std::vector<char> buf(sizeof(SyncRequest) + path_length +
-                              sizeof(SyncRequest) + data_length +
-                              sizeof(SyncRequest));
-        char* p = &buf[0];
-
-        SyncRequest* req_send = reinterpret_cast<SyncRequest*>(p);
-        req_send->id = ID_SEND;
-        req_send->path_length = path_length;
-        p += sizeof(SyncRequest);
-        memcpy(p, path_and_mode, path_length);
-        p += path_length;
-
-        SyncRequest* req_data = reinterpret_cast<SyncRequest*>(p);
-        req_data->id = ID_DATA;
-        req_data->path_length = data_length;
-        p += sizeof(SyncRequest);
-        memcpy(p, data, data_length);
-        p += data_length;
+        auto append_data = [&buf](const char* chunk, size_t chunk_length) {
+            SyncRequest req_data;
+            req_data.id = ID_DATA;
+            req_data.path_length = chunk_length;
+            AppendBytes(&buf, &req_data, sizeof(req_data));
+            AppendBytes(&buf, chunk, chunk_length);
+            return true;
+        };
+        if (compressed) {
+            BrotliEncoder encoder(max - sizeof(SyncRequest));
+            if (!encoder.Encode(data, data_length, true, append_data)) {
+                Error("failed to compress '%s'", lpath);
+                return false;
+            }
+        } else {
+            append_data(data, data_length);
+        }
 
-        SyncRequest* req_done = reinterpret_cast<SyncRequest*>(p);
-        req_done->id = ID_DONE;
-        req_done->path_length = mtime;
-        p += sizeof(SyncRequest);
+        SyncRequest req_done;
+        req_done.id = ID_DONE;
+        req_done.path_length = mtime;
+        AppendBytes(&buf, &req_done, sizeof(req_done));
 
-        WriteOrDie(lpath, rpath, &buf[0], (p - &buf[0]));
-        expect_done_ = true;
+        WriteOrDie(lpath, rpath, &buf[0], buf.size());
+        deferred_acknowledgements_.push_back({lpath, rpath});
 
         // RecordFilesTransferred gets called in CopyDone.
         RecordBytesTransferred(data_length);
@@ -418,11 +526,18 @@ class SyncConnection {
         return true;
     }
 
-    bool SendLargeFile(const char* path_and_mode,
-                       const char* lpath, const char* rpath,
-                       unsigned mtime) {
-        if (!SendRequest(ID_SEND, path_and_mode)) {
-            Error("failed to send ID_SEND message '%s': %s", path_and_mode, strerror(errno));
+    bool SendLargeFile(const char* lpath, const char* rpath, mode_t mode, unsigned mtime) {
+        // ReceivedError can't tell an earlier file's acknowledgement from a
+        // failure of this one, and a large file hides the round trip anyway.
+        if (!ReadAcknowledgements(true)) {
+            return false;
+        }
+
+        bool compressed = compression_;
+        std::vector<char> buf;
+        if (!AppendSendRequest(&buf, rpath, mode, compressed) ||
+            !WriteFdExactly(fd, &buf[0], buf.size())) {
+            Error("failed to send ID_SEND message '%s': %s", rpath, strerror(errno));
             return false;
         }
 
@@ -443,17 +558,39 @@ class SyncConnection {
 
         syncsendbuf sbuf;
         sbuf.id = ID_DATA;
+        auto send_data = [&](const char* data, size_t length) {
+            sbuf.size = length;
+            if (data != sbuf.data) memcpy(sbuf.data, data, length);
+            return WriteOrDie(lpath, rpath, &sbuf, sizeof(SyncRequest) + length);
+        };
+
+        std::unique_ptr<BrotliEncoder> encoder;
+        std::vector<char> input;
+        if (compressed) {
+            encoder.reset(new BrotliEncoder(max - sizeof(SyncRequest)));
+            input.resize(max - sizeof(SyncRequest));
+        }
+
         while (true) {
-            int bytes_read = adb_read(lfd, sbuf.data, max - sizeof(SyncRequest));
+            char* data = encoder ? &input[0] : sbuf.data;
+            int bytes_read = adb_read(lfd, data, max - sizeof(SyncRequest));
             if (bytes_read == -1) {
                 Error("reading '%s' locally failed: %s", lpath, strerror(errno));
                 return false;
-            } else if (bytes_read == 0) {
-                break;
             }
 
-            sbuf.size = bytes_read;
-            WriteOrDie(lpath, rpath, &sbuf, sizeof(SyncRequest) + bytes_read);
+            if (encoder) {
+                // The final, empty read finishes the stream.
+                if (!encoder->Encode(data, bytes_read, bytes_read == 0, send_data)) {
+                    Error("failed to compress '%s'", lpath);
+                    return false;
+                }
+            } else if (bytes_read > 0) {
+                send_data(data, bytes_read);
+            }
+            if (bytes_read == 0) {
+                break;
+            }
 
             RecordBytesTransferred(bytes_read);
             bytes_copied += bytes_read;
@@ -469,10 +606,126 @@ class SyncConnection {
         syncmsg msg;
         msg.data.id = ID_DONE;
         msg.data.size = mtime;
-        expect_done_ = true;
 
         // RecordFilesTransferred gets called in CopyDone.
-        return WriteOrDie(lpath, rpath, &msg.data, sizeof(msg.data));
+        WriteOrDie(lpath, rpath, &msg.data, sizeof(msg.data));
+        deferred_acknowledgements_.push_back({lpath, rpath});
+        return true;
+    }
+
+    // Send the blocks of lpath that differ from the digests of the copy on
+    // the device, which is then cut to the length of lpath.
+    bool SendDelta(const char* lpath, const char* rpath, mode_t mode, unsigned mtime,
+                   uint32_t block_size, const std::vector<uint8_t>& digests) {
+        unique_fd lfd(adb_open(lpath, O_RDONLY));
+        struct stat st;
+        if (lfd < 0 || fstat(lfd.get(), &st) == -1) {
+            Error("opening '%s' locally failed: %s", lpath, strerror(errno));
+            return false;
+        }
+
+        std::vector<char> buf;
+        if (!AppendRequest(&buf, ID_SEND_V2, rpath)) {
+            Error("failed to send ID_SEND_V2 message '%s': %s", rpath, strerror(errno));
+            return false;
+        }
+        syncmsg msg;
+        msg.send_v2_setup.id = ID_SEND_V2;
+        msg.send_v2_setup.mode = mode;
+        msg.send_v2_setup.flags = kSyncFlagDelta;
+        AppendBytes(&buf, &msg.send_v2_setup, sizeof(msg.send_v2_setup));
+        WriteOrDie(lpath, rpath, &buf[0], buf.size());
+
+        auto seek = [&](uint64_t offset) {
+            struct __attribute__((packed)) {
+                SyncRequest req;
+                uint64_t offset;
+            } packet = {{ID_SEEK, sizeof(uint64_t)}, offset};
+            WriteOrDie(lpath, rpath, &packet, sizeof(packet));
+        };
+
+        uint64_t total_size = st.st_size;
+        size_t count = digests.size() / SYNC_HASH_DIGEST_LENGTH;
+        std::vector<char> block(block_size);
+        uint64_t offset = 0;
+        // Where the device will write the next ID_DATA.
+        uint64_t position = 0;
+        syncsendbuf sbuf;
+        sbuf.id = ID_DATA;
+        for (size_t index = 0;; ++index) {
+            size_t length = 0;
+            while (length < block_size) {
+                int bytes_read = adb_read(lfd, &block[length], block_size - length);
+                if (bytes_read == -1) {
+                    Error("reading '%s' locally failed: %s", lpath, strerror(errno));
+                    return false;
+                }
+                if (bytes_read == 0) break;
+                length += bytes_read;
+            }
+            if (length == 0) break;
+
+            uint8_t digest[SHA256_DIGEST_LENGTH];
+            SHA256(reinterpret_cast<const uint8_t*>(block.data()), length, digest);
+            if (index >= count ||
+                memcmp(digest, &digests[index * SYNC_HASH_DIGEST_LENGTH], sizeof(digest))) {
+                if (position != offset) seek(offset);
+                for (size_t sent = 0; sent < length;) {
+                    size_t chunk = std::min(length - sent, max - sizeof(SyncRequest));
+                    sbuf.size = chunk;
+                    memcpy(sbuf.data, &block[sent], chunk);
+                    WriteOrDie(lpath, rpath, &sbuf, sizeof(SyncRequest) + chunk);
+                    sent += chunk;
+                }
+                position = offset + length;
+                RecordBytesTransferred(length);
+            }
+            offset += length;
+
+            // Check to see if we've received an error from the other side.
+            if (ReceivedError(lpath, rpath)) {
+                break;
+            }
+
+            ReportProgress(rpath, offset, total_size);
+            if (length < block_size) break;
+        }
+        if (position != offset) seek(offset);
+
+        msg.data.id = ID_DONE;
+        msg.data.size = mtime;
+
+        // RecordFilesTransferred gets called in CopyDone.
+        WriteOrDie(lpath, rpath, &msg.data, sizeof(msg.data));
+        deferred_acknowledgements_.push_back({lpath, rpath});
+        return true;
+    }
+
+    // Collect the device's replies to the files sent so far, oldest first.
+    // Waits only while PipelineDepth() or more files are outstanding, unless
+    // read_all is set. adbd hangs up after a failure, so the first failure
+    // reported ends the pipeline.
+    bool ReadAcknowledgements(bool read_all = false) {
+        while (!deferred_acknowledgements_.empty()) {
+            if (!read_all && deferred_acknowledgements_.size() < pipeline_depth_) {
+                adb_pollfd pfd = {.fd = fd.get(), .events = POLLIN};
+                int rc = adb_poll(&pfd, 1, 0);
+                if (rc < 0) {
+                    Error("failed to poll: %s", strerror(errno));
+                    deferred_acknowledgements_.clear();
+                    return false;
+                }
+                if (rc == 0) break;
+            }
+
+            DeferredAcknowledgement ack = std::move(deferred_acknowledgements_.front());
+            deferred_acknowledgements_.pop_front();
+            if (!CopyDone(ack.from.c_str(), ack.to.c_str())) {
+                deferred_acknowledgements_.clear();
+                return false;
+            }
+        }
+        return true;
     }
 
     bool CopyDone(const char* from, const char* to) {
@@ -482,14 +735,8 @@ class SyncConnection {
             return false;
         }
         if (msg.status.id == ID_OKAY) {
-            if (expect_done_) {
-                expect_done_ = false;
-                RecordFilesTransferred(1);
-                return true;
-            } else {
-                Error("failed to copy '%s' to '%s': received premature success", from, to);
-                return true;
-            }
+            RecordFilesTransferred(1);
+            return true;
         }
         if (msg.status.id != ID_FAIL) {
             Error("failed to copy '%s' to '%s': unknown reason %d", from, to, msg.status.id);
@@ -575,9 +822,55 @@ class SyncConnection {
     size_t max;
 
   private:
-    bool expect_done_;
+    static void AppendBytes(std::vector<char>* buf, const void* data, size_t length) {
+        const char* p = static_cast<const char*>(data);
+        buf->insert(buf->end(), p, p + length);
+    }
+
+    bool AppendRequest(std::vector<char>* buf, uint32_t id, const char* path) {
+        size_t path_length = strlen(path);
+        if (path_length > 1024) {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+        SyncRequest req;
+        req.id = id;
+        req.path_length = path_length;
+        AppendBytes(buf, &req, sizeof(req));
+        AppendBytes(buf, path, path_length);
+        return true;
+    }
+
+    // ID_SEND carries the mode as a ",mode" suffix on the path; ID_SEND_V2
+    // puts it in the setup message that follows.
+    bool AppendSendRequest(std::vector<char>* buf, const char* rpath, mode_t mode,
+                           bool compressed) {
+        if (!compressed) {
+            std::string path_and_mode = android::base::StringPrintf("%s,%d", rpath, mode);
+            return AppendRequest(buf, ID_SEND, path_and_mode.c_str());
+        }
+        if (!AppendRequest(buf, ID_SEND_V2, rpath)) {
+            return false;
+        }
+        syncmsg msg;
+        msg.send_v2_setup.id = ID_SEND_V2;
+        msg.send_v2_setup.mode = mode;
+        msg.send_v2_setup.flags = kSyncFlagBrotli;
+        AppendBytes(buf, &msg.send_v2_setup, sizeof(msg.send_v2_setup));
+        return true;
+    }
+
+    struct DeferredAcknowledgement {
+        std::string from;
+        std::string to;
+    };
+
+    std::deque<DeferredAcknowledgement> deferred_acknowledgements_;
+    size_t pipeline_depth_;
     FeatureSet features_;
     bool have_stat_v2_;
+    bool compression_;
+    bool delta_;
 
     TransferLedger global_ledger_;
     TransferLedger current_ledger_;
@@ -591,9 +884,12 @@ class SyncConnection {
         if (!WriteFdExactly(fd, data, data_length)) {
             if (errno == ECONNRESET) {
                 // Assume adbd told us why it was closing the connection, and
-                // try to read failure reason from adbd.
+                // try to read failure reason from adbd. It may be about a file
+                // sent earlier that is still waiting for its reply.
                 syncmsg msg;
-                if (!ReadFdExactly(fd, &msg.status, sizeof(msg.status))) {
+                if (!ReadAcknowledgements(true)) {
+                    // Already reported against the file it belongs to.
+                } else if (!ReadFdExactly(fd, &msg.status, sizeof(msg.status))) {
                     Error("failed to copy '%s' to '%s': no response: %s", from, to, strerror(errno));
                 } else if (msg.status.id != ID_FAIL) {
                     Error("failed to copy '%s' to '%s': not ID_FAIL: %d", from, to, msg.status.id);
@@ -675,9 +971,30 @@ static bool sync_stat_fallback(SyncConnection& sc, const char* path, struct stat
 }
 
 static bool sync_send(SyncConnection& sc, const char* lpath, const char* rpath, unsigned mtime,
-                      mode_t mode, bool sync) {
-    std::string path_and_mode = android::base::StringPrintf("%s,%d", rpath, mode);
+                      mode_t mode, bool sync);
+
+// Patch the older, remote_size byte copy of lpath on the device, falling back
+// to sending it whole if the device can't hash it.
+static bool sync_send_delta(SyncConnection& sc, const char* lpath, const char* rpath,
+                            unsigned mtime, mode_t mode, uint64_t remote_size) {
+    // The hashes queue behind the replies to earlier files.
+    if (!sc.ReadAcknowledgements(true)) {
+        return false;
+    }
 
+    uint32_t block_size;
+    std::vector<uint8_t> digests;
+    if (!sc.RequestHashes(rpath, remote_size, &block_size, &digests)) {
+        return sync_send(sc, lpath, rpath, mtime, mode, false);
+    }
+    return sc.SendDelta(lpath, rpath, mode, mtime, block_size, digests) &&
+           sc.ReadAcknowledgements();
+}
+
+// With a pipeline depth above one the device's reply may still be outstanding
+// on return; callers collect it with ReadAcknowledgements(true).
+static bool sync_send(SyncConnection& sc, const char* lpath, const char* rpath, unsigned mtime,
+                      mode_t mode, bool sync) {
     if (sync) {
         struct stat st;
         if (sync_lstat(sc, rpath, &st)) {
@@ -685,6 +1002,11 @@ static bool sync_send(SyncConnection& sc, const char* lpath, const char* rpath,
                 sc.RecordFilesSkipped(1);
                 return true;
             }
+
+            struct stat local_st;
+            if (stat(lpath, &local_st) == 0 && sc.CanSendDelta(mode, local_st.st_size, st)) {
+                return sync_send_delta(sc, lpath, rpath, mtime, mode, st.st_size);
+            }
         }
     }
 
@@ -698,10 +1020,10 @@ static bool sync_send(SyncConnection& sc, const char* lpath, const char* rpath,
         }
         buf[data_length++] = '\0';
 
-        if (!sc.SendSmallFile(path_and_mode.c_str(), lpath, rpath, mtime, buf, data_length)) {
+        if (!sc.SendSmallFile(lpath, rpath, mode, mtime, buf, data_length)) {
             return false;
         }
-        return sc.CopyDone(lpath, rpath);
+        return sc.ReadAcknowledgements();
 #endif
     }
 
@@ -716,22 +1038,20 @@ static bool sync_send(SyncConnection& sc, const char* lpath, const char* rpath,
             sc.Error("failed to read all of '%s': %s", lpath, strerror(errno));
             return false;
         }
-        if (!sc.SendSmallFile(path_and_mode.c_str(), lpath, rpath, mtime,
-                              data.data(), data.size())) {
+        if (!sc.SendSmallFile(lpath, rpath, mode, mtime, data.data(), data.size())) {
             return false;
         }
     } else {
-        if (!sc.SendLargeFile(path_and_mode.c_str(), lpath, rpath, mtime)) {
+        if (!sc.SendLargeFile(lpath, rpath, mode, mtime)) {
             return false;
         }
     }
-    return sc.CopyDone(lpath, rpath);
+    return sc.ReadAcknowledgements();
 }
 
-static bool sync_recv(SyncConnection& sc, const char* rpath, const char* lpath,
-                      const char* name, uint64_t expected_size) {
-    if (!sc.SendRequest(ID_RECV, rpath)) return false;
-
+// Receive a file whose ID_RECV request has already been sent.
+static bool sync_finish_recv(SyncConnection& sc, const char* rpath, const char* lpath,
+                             const char* name, uint64_t expected_size) {
     adb_unlink(lpath);
     unique_fd lfd(adb_creat(lpath, 0644));
     if (lfd < 0) {
@@ -740,6 +1060,22 @@ static bool sync_recv(SyncConnection& sc, const char* rpath, const char* lpath,
     }
 
     uint64_t bytes_copied = 0;
+    bool write_failed = false;
+    auto write_data = [&](const char* data, size_t length) {
+        if (!WriteFdExactly(lfd, data, length)) {
+            write_failed = true;
+            return false;
+        }
+        bytes_copied += length;
+        sc.RecordBytesTransferred(length);
+        return true;
+    };
+
+    std::unique_ptr<BrotliDecoder> decoder;
+    if (sc.UsingCompression()) {
+        decoder.reset(new BrotliDecoder(SYNC_DATA_MAX));
+    }
+
     while (true) {
         syncmsg msg;
         if (!ReadFdExactly(sc.fd, &msg.data, sizeof(msg.data))) {
@@ -747,7 +1083,14 @@ static bool sync_recv(SyncConnection& sc, const char* rpath, const char* lpath,
             return false;
         }
 
-        if (msg.data.id == ID_DONE) break;
+        if (msg.data.id == ID_DONE) {
+            if (decoder && !decoder->Finished()) {
+                sc.Error("failed to copy '%s' to '%s': truncated compressed data", rpath, lpath);
+                adb_unlink(lpath);
+                return false;
+            }
+            break;
+        }
 
         if (msg.data.id != ID_DATA) {
             adb_unlink(lpath);
@@ -767,15 +1110,19 @@ static bool sync_recv(SyncConnection& sc, const char* rpath, const char* lpath,
             return false;
         }
 
-        if (!WriteFdExactly(lfd, buffer, msg.data.size)) {
-            sc.Error("cannot write '%s': %s", lpath, strerror(errno));
+        bool ok = decoder ? decoder->Decode(buffer, msg.data.size, write_data) !=
+                                    BrotliDecoder::Result::Error
+                          : write_data(buffer, msg.data.size);
+        if (!ok) {
+            if (write_failed) {
+                sc.Error("cannot write '%s': %s", lpath, strerror(errno));
+            } else {
+                sc.Error("failed to copy '%s' to '%s': corrupt compressed data", rpath, lpath);
+            }
             adb_unlink(lpath);
             return false;
         }
 
-        bytes_copied += msg.data.size;
-
-        sc.RecordBytesTransferred(msg.data.size);
         sc.ReportProgress(name != nullptr ? name : rpath, bytes_copied, expected_size);
     }
 
@@ -783,6 +1130,12 @@ static bool sync_recv(SyncConnection& sc, const char* rpath, const char* lpath,
     return true;
 }
 
+static bool sync_recv(SyncConnection& sc, const char* rpath, const char* lpath,
+                      const char* name, uint64_t expected_size) {
+    if (!sc.SendRecv(rpath)) return false;
+    return sync_finish_recv(sc, rpath, lpath, name, expected_size);
+}
+
 bool do_sync_ls(const char* path) {
     SyncConnection sc;
     if (!sc.IsValid()) return false;
@@ -921,6 +1274,9 @@ static bool copy_local_dir_remote(SyncConnection& sc, std::string lpath,
             if (sc.FinishStat(&st)) {
                 if (st.st_size == static_cast<off_t>(ci.size) && st.st_mtime == ci.time) {
                     ci.skip = true;
+                } else if (sc.CanSendDelta(ci.mode, ci.size, st)) {
+                    ci.delta = true;
+                    ci.remote_size = st.st_size;
                 }
             }
         }
@@ -933,7 +1289,12 @@ static bool copy_local_dir_remote(SyncConnection& sc, std::string lpath,
             if (list_only) {
                 sc.Println("would push: %s -> %s", ci.lpath.c_str(), ci.rpath.c_str());
             } else {
-                if (!sync_send(sc, ci.lpath.c_str(), ci.rpath.c_str(), ci.time, ci.mode, false)) {
+                bool sent = ci.delta ? sync_send_delta(sc, ci.lpath.c_str(), ci.rpath.c_str(),
+                                                       ci.time, ci.mode, ci.remote_size)
+                                     : sync_send(sc, ci.lpath.c_str(), ci.rpath.c_str(), ci.time,
+                                                 ci.mode, false);
+                if (!sent) {
+                    sc.ReadAcknowledgements(true);
                     return false;
                 }
             }
@@ -942,6 +1303,10 @@ static bool copy_local_dir_remote(SyncConnection& sc, std::string lpath,
         }
     }
 
+    if (!sc.ReadAcknowledgements(true)) {
+        return false;
+    }
+
     sc.RecordFilesSkipped(skipped);
     sc.ReportTransferRate(lpath, TransferDirection::push);
     return true;
@@ -1034,6 +1399,7 @@ bool do_sync_push(const std::vector<const char*>& srcs, const char* dst, bool sy
         sc.NewTransfer();
         sc.SetExpectedTotalBytes(st.st_size);
         success &= sync_send(sc, src_path, dst_path, st.st_mtime, st.st_mode, sync);
+        success &= sc.ReadAcknowledgements(true);
         sc.ReportTransferRate(src_path, TransferDirection::push);
     }
 
@@ -1134,8 +1500,15 @@ static bool copy_remote_dir_local(SyncConnection& sc, std::string rpath,
 
     sc.ComputeExpectedTotalBytes(file_list);
 
+    // Keep up to PipelineDepth() ID_RECV requests ahead of the file being
+    // received, so the device goes straight on to the next one.
+    auto should_recv = [](const copyinfo& ci) { return !ci.skip && !S_ISDIR(ci.mode); };
+    size_t requested = 0;
+    size_t in_flight = 0;
+
     int skipped = 0;
-    for (const copyinfo &ci : file_list) {
+    for (size_t i = 0; i < file_list.size(); ++i) {
+        const copyinfo& ci = file_list[i];
         if (!ci.skip) {
             if (S_ISDIR(ci.mode)) {
                 // Entry is for an empty directory, create it and continue.
@@ -1148,7 +1521,16 @@ static bool copy_remote_dir_local(SyncConnection& sc, std::string rpath,
                 continue;
             }
 
-            if (!sync_recv(sc, ci.rpath.c_str(), ci.lpath.c_str(), nullptr, ci.size)) {
+            while (requested <= i ||
+                   (requested < file_list.size() && in_flight < sc.PipelineDepth())) {
+                const copyinfo& next = file_list[requested++];
+                if (!should_recv(next)) continue;
+                if (!sc.SendRecv(next.rpath.c_str())) return false;
+                ++in_flight;
+            }
+
+            --in_flight;
+            if (!sync_finish_recv(sc, ci.rpath.c_str(), ci.lpath.c_str(), nullptr, ci.size)) {
                 return false;
             }
 
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+#include <brotli/decode.h>
+#include <brotli/encode.h>
+
+// Streaming brotli codecs for the compressed sync transfers. Output is handed
+// to a sink in blocks of at most the size given at construction, so neither
+// side ever holds more than a block, however well the data compresses.
+using CompressionSink = std::function<bool(const char* data, size_t length)>;
+
+class BrotliEncoder {
+  public:
+    explicit BrotliEncoder(size_t output_block_size)
+        : output_(output_block_size),
+          state_(BrotliEncoderCreateInstance(nullptr, nullptr, nullptr)) {
+        // The cheapest level: transfers are bound by the link or by the
+        // device's CPU, and higher levels cost far more than they save.
+        BrotliEncoderSetParameter(state_, BROTLI_PARAM_QUALITY, 1);
+    }
+
+    ~BrotliEncoder() { BrotliEncoderDestroyInstance(state_); }
+
+    BrotliEncoder(const BrotliEncoder&) = delete;
+    BrotliEncoder& operator=(const BrotliEncoder&) = delete;
+
+    // Compress length bytes of data. Set finish on the last call, which
+    // flushes the end of the stream. Returns false if the sink fails. At this
+    // quality every call is compressed on its own, so feed it whole reads.
+    bool Encode(const char* data, size_t length, bool finish, const CompressionSink& sink) {
+        BrotliEncoderOperation op = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+        const uint8_t* next_in = reinterpret_cast<const uint8_t*>(data);
+        size_t avail_in = length;
+        while (true) {
+            uint8_t* next_out = reinterpret_cast<uint8_t*>(output_.data());
+            size_t avail_out = output_.size();
+            if (!BrotliEncoderCompressStream(state_, op, &avail_in, &next_in, &avail_out,
+                                             &next_out, nullptr)) {
+                return false;
+            }
+            size_t produced = output_.size() - avail_out;
+            if (produced && !sink(output_.data(), produced)) {
+                return false;
+            }
+            if (avail_in || BrotliEncoderHasMoreOutput(state_)) {
+                continue;
+            }
+            if (finish && !BrotliEncoderIsFinished(state_)) {
+                continue;
+            }
+            return true;
+        }
+    }
+
+  private:
+    std::vector<char> output_;
+    BrotliEncoderState* state_;
+};
+
+class BrotliDecoder {
+  public:
+    enum class Result {
+        NeedInput,  // Everything so far was consumed, the stream continues.
+        Done,       // The end of the stream was reached.
+        Error,      // Corrupt input, trailing garbage, or the sink failed.
+    };
+
+    explicit BrotliDecoder(size_t output_block_size)
+        : output_(output_block_size),
+          state_(BrotliDecoderCreateInstance(nullptr, nullptr, nullptr)),
+          done_(false) {}
+
+    ~BrotliDecoder() { BrotliDecoderDestroyInstance(state_); }
+
+    BrotliDecoder(const BrotliDecoder&) = delete;
+    BrotliDecoder& operator=(const BrotliDecoder&) = delete;
+
+    bool Finished() const { return done_; }
+
+    Result Decode(const char* data, size_t length, const CompressionSink& sink) {
+        if (done_) {
+            return length ? Result::Error : Result::Done;
+        }
+        const uint8_t* next_in = reinterpret_cast<const uint8_t*>(data);
+        size_t avail_in = length;
+        while (true) {
+            uint8_t* next_out = reinterpret_cast<uint8_t*>(output_.data());
+            size_t avail_out = output_.size();
+            BrotliDecoderResult rc = BrotliDecoderDecompressStream(
+                    state_, &avail_in, &next_in, &avail_out, &next_out, nullptr);
+            if (rc == BROTLI_DECODER_RESULT_ERROR) {
+                return Result::Error;
+            }
+            size_t produced = output_.size() - avail_out;
+            if (produced && !sink(output_.data(), produced)) {
+                return Result::Error;
+            }
+            switch (rc) {
+                case BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT:
+                    continue;
+                case BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT:
+                    return Result::NeedInput;
+                case BROTLI_DECODER_RESULT_SUCCESS:
+                    done_ = true;
+                    return avail_in ? Result::Error : Result::Done;
+                default:
+                    return Result::Error;
+            }
+        }
+    }
+
+  private:
+    std::vector<char> output_;
+    BrotliDecoderState* state_;
+    bool done_;
+};
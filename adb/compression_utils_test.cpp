@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compression_utils.h"
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+
+static constexpr size_t kBlockSize = 1024;
+
+static std::string Compress(const std::string& input, size_t chunk_size) {
+    BrotliEncoder encoder(kBlockSize);
+    std::string output;
+    auto sink = [&output](const char* data, size_t length) {
+        EXPECT_LE(length, kBlockSize);
+        output.append(data, length);
+        return true;
+    };
+    size_t offset = 0;
+    do {
+        size_t length = std::min(chunk_size, input.size() - offset);
+        bool finish = (offset + length) == input.size();
+        EXPECT_TRUE(encoder.Encode(input.data() + offset, length, finish, sink));
+        offset += length;
+    } while (offset < input.size());
+    return output;
+}
+
+static BrotliDecoder::Result Decompress(const std::string& input, size_t chunk_size,
+                                        std::string* output) {
+    BrotliDecoder decoder(kBlockSize);
+    auto sink = [output](const char* data, size_t length) {
+        EXPECT_LE(length, kBlockSize);
+        output->append(data, length);
+        return true;
+    };
+    BrotliDecoder::Result result = BrotliDecoder::Result::NeedInput;
+    for (size_t offset = 0; offset < input.size(); offset += chunk_size) {
+        size_t length = std::min(chunk_size, input.size() - offset);
+        result = decoder.Decode(input.data() + offset, length, sink);
+        if (result == BrotliDecoder::Result::Error) break;
+    }
+    return result;
+}
+
+TEST(compression, brotli_round_trip) {
+    std::string input;
+    srandom(1);
+    for (size_t i = 0; i < 256 * 1024; ++i) {
+        // Mostly compressible, with enough noise to produce several blocks.
+        input.push_back((i % 7) ? 'a' + (i % 13) : static_cast<char>(random()));
+    }
+
+    for (size_t chunk_size : {1, 100, 4096, 64 * 1024, 1024 * 1024}) {
+        std::string compressed = Compress(input, chunk_size);
+        if (chunk_size >= 4096) {
+            EXPECT_LT(compressed.size(), input.size());
+        }
+
+        std::string output;
+        ASSERT_EQ(BrotliDecoder::Result::Done, Decompress(compressed, chunk_size, &output));
+        EXPECT_EQ(input, output);
+    }
+}
+
+TEST(compression, brotli_empty) {
+    std::string compressed = Compress("", 1);
+    ASSERT_FALSE(compressed.empty());
+
+    std::string output;
+    ASSERT_EQ(BrotliDecoder::Result::Done, Decompress(compressed, 1, &output));
+    EXPECT_TRUE(output.empty());
+}
+
+TEST(compression, brotli_expands_in_blocks) {
+    // A megabyte of zeros is a few bytes on the wire; the decoder must still
+    // hand it over in blocks no larger than it was asked for.
+    std::string input(1024 * 1024, '\0');
+    std::string compressed = Compress(input, input.size());
+    EXPECT_LT(compressed.size(), kBlockSize);
+
+    std::string output;
+    ASSERT_EQ(BrotliDecoder::Result::Done, Decompress(compressed, compressed.size(), &output));
+    EXPECT_EQ(input, output);
+}
+
+TEST(compression, brotli_truncated) {
+    std::string compressed = Compress(std::string(100000, 'x') + "tail", 4096);
+    compressed.pop_back();
+
+    std::string output;
+    EXPECT_EQ(BrotliDecoder::Result::NeedInput,
+              Decompress(compressed, compressed.size(), &output));
+}
+
+TEST(compression, brotli_trailing_garbage) {
+    std::string compressed = Compress("hello, world", 4096) + "junk";
+
+    std::string output;
+    EXPECT_EQ(BrotliDecoder::Result::Error, Decompress(compressed, compressed.size(), &output));
+}
+
+TEST(compression, brotli_corrupt) {
+    std::string output;
+    EXPECT_EQ(BrotliDecoder::Result::Error,
+              Decompress(std::string(64, '\xff'), 64, &output));
+}
+
+TEST(compression, brotli_sink_failure) {
+    std::string compressed = Compress(std::string(100000, 'x'), 4096);
+    BrotliDecoder decoder(kBlockSize);
+    EXPECT_EQ(BrotliDecoder::Result::Error,
+              decoder.Decode(compressed.data(), compressed.size(),
+                             [](const char*, size_t) { return false; }));
+}
@@ -22,6 +22,7 @@
 
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -31,6 +32,7 @@
 #include <unistd.h>
 #include <utime.h>
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <vector>
@@ -40,6 +42,7 @@
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 
+#include <openssl/sha.h>
 #include <private/android_filesystem_config.h>
 #include <private/android_logger.h>
 
@@ -52,6 +55,7 @@
 #include "adb_io.h"
 #include "adb_trace.h"
 #include "adb_utils.h"
+#include "compression_utils.h"
 #include "file_sync_protocol.h"
 #include "security_log_tags.h"
 #include "sysdeps/errno.h"
@@ -226,11 +230,159 @@ static bool SendSyncFailErrno(int fd, const std::string& reason) {
     return SendSyncFail(fd, StringPrintf("%s: %s", reason.c_str(), strerror(errno)));
 }
 
+// Hash the consecutive block_size blocks of path, the last of which may be short.
+static bool hash_file(const char* path, uint32_t block_size, std::vector<char>& buffer,
+                      uint64_t* size, std::vector<uint8_t>* digests) {
+    unique_fd fd(adb_open(path, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd.get(), &st) == -1) return false;
+    if (!S_ISREG(st.st_mode)) {
+        errno = EINVAL;
+        return false;
+    }
+    if ((st.st_size / block_size) >= SYNC_HASH_MAX_BLOCKS) {
+        errno = EFBIG;
+        return false;
+    }
+
+    int rc = posix_fadvise(fd.get(), 0, 0, POSIX_FADV_SEQUENTIAL | POSIX_FADV_NOREUSE);
+    if (rc != 0) {
+        D("[ Failed to fadvise: %s ]", strerror(rc));
+    }
+
+    *size = 0;
+    while (true) {
+        SHA256_CTX ctx;
+        SHA256_Init(&ctx);
+        uint32_t block_length = 0;
+        while (block_length < block_size) {
+            size_t want = std::min<size_t>(buffer.size(), block_size - block_length);
+            int r = adb_read(fd.get(), &buffer[0], want);
+            if (r < 0) return false;
+            if (r == 0) break;
+            SHA256_Update(&ctx, &buffer[0], r);
+            block_length += r;
+        }
+        if (block_length == 0) break;
+
+        size_t offset = digests->size();
+        digests->resize(offset + SYNC_HASH_DIGEST_LENGTH);
+        SHA256_Final(&(*digests)[offset], &ctx);
+        *size += block_length;
+        if (block_length < block_size) break;
+    }
+    return true;
+}
+
+static bool do_hash(int s, const char* path, std::vector<char>& buffer) {
+    syncmsg msg;
+    if (!ReadFdExactly(s, &msg.hash_setup, sizeof(msg.hash_setup))) {
+        SendSyncFail(s, "failed to read hash setup");
+        return false;
+    }
+    if (msg.hash_setup.id != ID_HASH) {
+        SendSyncFail(s, StringPrintf("unexpected hash setup id %08x", msg.hash_setup.id));
+        return false;
+    }
+
+    uint32_t block_size = msg.hash_setup.block_size;
+    msg = {};
+    msg.hash.id = ID_HASH;
+    msg.hash.block_size = block_size;
+
+    std::vector<uint8_t> digests;
+    if (block_size < SYNC_HASH_BLOCK_MIN || block_size > SYNC_HASH_BLOCK_MAX) {
+        msg.hash.error = errno_to_wire(EINVAL);
+    } else if (!hash_file(path, block_size, buffer, &msg.hash.size, &digests)) {
+        msg.hash.error = errno_to_wire(errno);
+        msg.hash.size = 0;
+        digests.clear();
+    }
+    msg.hash.count = digests.size() / SYNC_HASH_DIGEST_LENGTH;
+
+    return WriteFdExactly(s, &msg.hash, sizeof(msg.hash)) &&
+           (digests.empty() || WriteFdExactly(s, digests.data(), digests.size()));
+}
+
+#if defined(__linux__)
+// A pipe to splice(2) file data through, so that it moves between the page
+// cache and the socket without being copied through userspace.
+class SplicePipe {
+  public:
+    bool Open(size_t capacity) {
+        if (!android::base::Pipe(&read_, &write_)) return false;
+        // Room for a whole ID_DATA payload; the default is usually enough anyway.
+        fcntl(write_.get(), F_SETPIPE_SZ, static_cast<int>(capacity));
+        return true;
+    }
+
+    // Move up to length bytes from in into the (empty) pipe.
+    ssize_t Fill(int in, size_t length) {
+        return TEMP_FAILURE_RETRY(
+                splice(in, nullptr, write_.get(), nullptr, length, SPLICE_F_MOVE));
+    }
+
+    // Move length bytes from the pipe to out.
+    bool Drain(int out, size_t length) {
+        while (length > 0) {
+            ssize_t n = TEMP_FAILURE_RETRY(
+                    splice(read_.get(), nullptr, out, nullptr, length, SPLICE_F_MOVE));
+            if (n <= 0) return false;
+            length -= n;
+        }
+        return true;
+    }
+
+  private:
+    unique_fd read_;
+    unique_fd write_;
+};
+
+static bool splice_unsupported(int error) {
+    return error == EINVAL || error == ENOSYS || error == EOPNOTSUPP;
+}
+
+enum class SpliceResult {
+    kOk,
+    kUnsupported,  // Nothing was moved, use read/write instead.
+    kReadFailed,
+    kWriteFailed,
+};
+
+// Move an ID_DATA payload of length bytes from the socket to fd. On failure,
+// *consumed says how much of the payload was taken off the socket.
+static SpliceResult splice_payload(int s, int fd, SplicePipe& pipe, size_t length,
+                                   size_t* consumed) {
+    *consumed = 0;
+    while (*consumed < length) {
+        ssize_t n = pipe.Fill(s, length - *consumed);
+        if (n <= 0) {
+            if (n < 0 && *consumed == 0 && splice_unsupported(errno)) {
+                return SpliceResult::kUnsupported;
+            }
+            return SpliceResult::kReadFailed;
+        }
+        *consumed += n;
+        if (!pipe.Drain(fd, n)) {
+            return SpliceResult::kWriteFailed;
+        }
+    }
+    return SpliceResult::kOk;
+}
+#endif
+
 static bool handle_send_file(int s, const char* path, uint32_t* timestamp, uid_t uid, gid_t gid,
                              uint64_t capabilities, mode_t mode, std::vector<char>& buffer,
-                             bool do_unlink) {
+                             bool do_unlink, bool compressed) {
     int rc;
     syncmsg msg;
+    std::unique_ptr<BrotliDecoder> decoder;
+    bool write_failed = false;
+#if defined(__linux__)
+    std::unique_ptr<SplicePipe> splice_pipe;
+#endif
 
     __android_log_security_bswrite(SEC_TAG_ADB_SEND_FILE, path);
 
@@ -272,11 +424,27 @@ static bool handle_send_file(int s, const char* path, uint32_t* timestamp, uid_t
         D("[ Failed to fadvise: %s ]", strerror(rc));
     }
 
+    if (compressed) {
+        decoder.reset(new BrotliDecoder(buffer.size()));
+    }
+#if defined(__linux__)
+    else {
+        splice_pipe.reset(new SplicePipe);
+        if (!splice_pipe->Open(buffer.size())) {
+            splice_pipe.reset();
+        }
+    }
+#endif
+
     while (true) {
         if (!ReadFdExactly(s, &msg.data, sizeof(msg.data))) goto fail;
 
         if (msg.data.id != ID_DATA) {
             if (msg.data.id == ID_DONE) {
+                if (decoder && !decoder->Finished()) {
+                    SendSyncFail(s, "truncated compressed data");
+                    goto abort;
+                }
                 *timestamp = msg.data.size;
                 break;
             }
@@ -289,9 +457,42 @@ static bool handle_send_file(int s, const char* path, uint32_t* timestamp, uid_t
             goto abort;
         }
 
+#if defined(__linux__)
+        if (splice_pipe) {
+            size_t consumed;
+            switch (splice_payload(s, fd.get(), *splice_pipe, msg.data.size, &consumed)) {
+                case SpliceResult::kOk:
+                    continue;
+                case SpliceResult::kUnsupported:
+                    splice_pipe.reset();
+                    break;
+                case SpliceResult::kReadFailed:
+                    goto abort;
+                case SpliceResult::kWriteFailed:
+                    SendSyncFailErrno(s, "write failed");
+                    if (!ReadFdExactly(s, &buffer[0], msg.data.size - consumed)) goto abort;
+                    goto fail;
+            }
+        }
+#endif
+
         if (!ReadFdExactly(s, &buffer[0], msg.data.size)) goto abort;
 
-        if (!WriteFdExactly(fd.get(), &buffer[0], msg.data.size)) {
+        if (decoder) {
+            auto write_data = [&fd, &write_failed](const char* data, size_t length) {
+                write_failed = !WriteFdExactly(fd.get(), data, length);
+                return !write_failed;
+            };
+            if (decoder->Decode(&buffer[0], msg.data.size, write_data) ==
+                BrotliDecoder::Result::Error) {
+                if (write_failed) {
+                    SendSyncFailErrno(s, "write failed");
+                } else {
+                    SendSyncFail(s, "corrupt compressed data");
+                }
+                goto fail;
+            }
+        } else if (!WriteFdExactly(fd.get(), &buffer[0], msg.data.size)) {
             SendSyncFailErrno(s, "write failed");
             goto fail;
         }
@@ -396,23 +597,8 @@ static bool handle_send_link(int s, const std::string& path, uint32_t* timestamp
 }
 #endif
 
-static bool do_send(int s, const std::string& spec, std::vector<char>& buffer) {
-    // 'spec' is of the form "/some/path,0755". Break it up.
-    size_t comma = spec.find_last_of(',');
-    if (comma == std::string::npos) {
-        SendSyncFail(s, "missing , in ID_SEND");
-        return false;
-    }
-
-    std::string path = spec.substr(0, comma);
-
-    errno = 0;
-    mode_t mode = strtoul(spec.substr(comma + 1).c_str(), nullptr, 0);
-    if (errno != 0) {
-        SendSyncFail(s, "bad mode");
-        return false;
-    }
-
+static bool do_send(int s, const std::string& path, mode_t mode, bool compressed,
+                    std::vector<char>& buffer) {
     // Don't delete files before copying if they are not "regular" or symlinks.
     struct stat st;
     bool do_unlink = (lstat(path.c_str(), &st) == -1) || S_ISREG(st.st_mode) ||
@@ -424,6 +610,10 @@ static bool do_send(int s, const std::string& spec, std::vector<char>& buffer) {
     bool result;
     uint32_t timestamp;
     if (S_ISLNK(mode)) {
+        if (compressed) {
+            SendSyncFail(s, "compressed symlinks are not supported");
+            return false;
+        }
         result = handle_send_link(s, path, &timestamp, buffer);
     } else {
         // Copy user permission bits to "group" and "other" permissions.
@@ -441,7 +631,7 @@ static bool do_send(int s, const std::string& spec, std::vector<char>& buffer) {
         }
 
         result = handle_send_file(s, path.c_str(), &timestamp, uid, gid, capabilities, mode, buffer,
-                                  do_unlink);
+                                  do_unlink, compressed);
     }
 
     if (!result) {
@@ -457,7 +647,174 @@ static bool do_send(int s, const std::string& spec, std::vector<char>& buffer) {
     return true;
 }
 
-static bool do_recv(int s, const char* path, std::vector<char>& buffer) {
+// Throw away the rest of a failed delta transfer, see handle_send_file.
+static void discard_send_delta(int s, std::vector<char>& buffer) {
+    syncmsg msg;
+    while (ReadFdExactly(s, &msg.data, sizeof(msg.data))) {
+        if (msg.data.id == ID_DONE) break;
+        if (msg.data.id != ID_DATA && msg.data.id != ID_SEEK) break;
+        if (msg.data.size > buffer.size()) break;
+        if (!ReadFdExactly(s, &buffer[0], msg.data.size)) break;
+    }
+}
+
+// Patch an existing regular file as described by kSyncFlagDelta. Ownership
+// and permissions are left as they are.
+static bool do_send_delta(int s, const std::string& path, std::vector<char>& buffer) {
+    __android_log_security_bswrite(SEC_TAG_ADB_SEND_FILE, path.c_str());
+
+    struct stat st;
+    unique_fd fd(adb_open(path.c_str(), O_WRONLY | O_CLOEXEC));
+    if (fd < 0) {
+        SendSyncFailErrno(s, "couldn't open file");
+        discard_send_delta(s, buffer);
+        return false;
+    }
+    if (fstat(fd.get(), &st) == -1 || !S_ISREG(st.st_mode)) {
+        SendSyncFail(s, "delta target is not a regular file");
+        discard_send_delta(s, buffer);
+        return false;
+    }
+
+    syncmsg msg;
+    uint64_t position = 0;
+    uint32_t timestamp;
+    while (true) {
+        if (!ReadFdExactly(s, &msg.data, sizeof(msg.data))) return false;
+
+        if (msg.data.id == ID_DONE) {
+            timestamp = msg.data.size;
+            break;
+        }
+
+        if (msg.data.id == ID_SEEK) {
+            uint64_t offset;
+            if (msg.data.size != sizeof(offset) || !ReadFdExactly(s, &offset, sizeof(offset))) {
+                SendSyncFail(s, "invalid seek message");
+                return false;
+            }
+            if (adb_lseek(fd.get(), offset, SEEK_SET) == -1) {
+                SendSyncFailErrno(s, "seek failed");
+                discard_send_delta(s, buffer);
+                return false;
+            }
+            position = offset;
+            continue;
+        }
+
+        if (msg.data.id != ID_DATA) {
+            SendSyncFail(s, "invalid data message");
+            return false;
+        }
+        if (msg.data.size > buffer.size()) {
+            SendSyncFail(s, "oversize data message");
+            return false;
+        }
+        if (!ReadFdExactly(s, &buffer[0], msg.data.size)) return false;
+
+        if (!WriteFdExactly(fd.get(), &buffer[0], msg.data.size)) {
+            SendSyncFailErrno(s, "write failed");
+            discard_send_delta(s, buffer);
+            return false;
+        }
+        position += msg.data.size;
+    }
+
+    if (ftruncate(fd.get(), position) == -1) {
+        SendSyncFailErrno(s, "ftruncate failed");
+        return false;
+    }
+    fd.reset();
+
+    struct timeval tv[2];
+    tv[0].tv_sec = timestamp;
+    tv[0].tv_usec = 0;
+    tv[1].tv_sec = timestamp;
+    tv[1].tv_usec = 0;
+    lutimes(path.c_str(), tv);
+
+    msg.status.id = ID_OKAY;
+    msg.status.msglen = 0;
+    return WriteFdExactly(s, &msg.status, sizeof(msg.status));
+}
+
+static bool do_send_v1(int s, const std::string& spec, std::vector<char>& buffer) {
+    // 'spec' is of the form "/some/path,0755". Break it up.
+    size_t comma = spec.find_last_of(',');
+    if (comma == std::string::npos) {
+        SendSyncFail(s, "missing , in ID_SEND");
+        return false;
+    }
+
+    std::string path = spec.substr(0, comma);
+
+    errno = 0;
+    mode_t mode = strtoul(spec.substr(comma + 1).c_str(), nullptr, 0);
+    if (errno != 0) {
+        SendSyncFail(s, "bad mode");
+        return false;
+    }
+
+    return do_send(s, path, mode, false, buffer);
+}
+
+static bool do_send_v2(int s, const std::string& path, std::vector<char>& buffer) {
+    syncmsg msg;
+    if (!ReadFdExactly(s, &msg.send_v2_setup, sizeof(msg.send_v2_setup))) {
+        SendSyncFail(s, "failed to read send_v2 setup");
+        return false;
+    }
+    if (msg.send_v2_setup.id != ID_SEND_V2) {
+        SendSyncFail(s, StringPrintf("unexpected send_v2 setup id %08x", msg.send_v2_setup.id));
+        return false;
+    }
+    if (msg.send_v2_setup.flags & ~(kSyncFlagBrotli | kSyncFlagDelta)) {
+        SendSyncFail(s, StringPrintf("unknown send_v2 flags %#x", msg.send_v2_setup.flags));
+        return false;
+    }
+    if (msg.send_v2_setup.flags & kSyncFlagDelta) {
+        if (msg.send_v2_setup.flags & kSyncFlagBrotli) {
+            SendSyncFail(s, "delta transfers can't be compressed");
+            return false;
+        }
+        return do_send_delta(s, path, buffer);
+    }
+
+    return do_send(s, path, msg.send_v2_setup.mode, msg.send_v2_setup.flags & kSyncFlagBrotli,
+                   buffer);
+}
+
+#if defined(__linux__)
+// Send the rest of fd as ID_DATA packets by splicing it through a pipe, from
+// the page cache to the socket. A packet is only announced once its payload
+// is in the pipe, so this can stop at any point and leave the rest to read(2);
+// *eof is set if it got to the end of the file.
+static bool recv_splice(int s, int fd, size_t max_payload, bool* eof) {
+    SplicePipe pipe;
+    if (!pipe.Open(max_payload)) return true;
+
+    syncmsg msg;
+    msg.data.id = ID_DATA;
+    while (true) {
+        ssize_t n = pipe.Fill(fd, max_payload);
+        if (n < 0) {
+            if (splice_unsupported(errno)) return true;
+            SendSyncFailErrno(s, "read failed");
+            return false;
+        }
+        if (n == 0) {
+            *eof = true;
+            return true;
+        }
+        msg.data.size = n;
+        if (!WriteFdExactly(s, &msg.data, sizeof(msg.data)) || !pipe.Drain(s, n)) {
+            return false;
+        }
+    }
+}
+#endif
+
+static bool do_recv(int s, const char* path, bool compressed, std::vector<char>& buffer) {
     __android_log_security_bswrite(SEC_TAG_ADB_RECV_FILE, path);
 
     unique_fd fd(adb_open(path, O_RDONLY | O_CLOEXEC));
@@ -473,17 +830,36 @@ static bool do_recv(int s, const char* path, std::vector<char>& buffer) {
 
     syncmsg msg;
     msg.data.id = ID_DATA;
-    while (true) {
+    auto send_data = [s, &msg](const char* data, size_t length) {
+        msg.data.size = length;
+        return WriteFdExactly(s, &msg.data, sizeof(msg.data)) && WriteFdExactly(s, data, length);
+    };
+
+    std::unique_ptr<BrotliEncoder> encoder;
+    if (compressed) {
+        encoder.reset(new BrotliEncoder(buffer.size() - sizeof(msg.data)));
+    }
+
+    bool eof = false;
+#if defined(__linux__)
+    if (!encoder && !recv_splice(s, fd.get(), buffer.size() - sizeof(msg.data), &eof)) {
+        return false;
+    }
+#endif
+
+    while (!eof) {
         int r = adb_read(fd.get(), &buffer[0], buffer.size() - sizeof(msg.data));
-        if (r <= 0) {
-            if (r == 0) break;
+        if (r < 0) {
             SendSyncFailErrno(s, "read failed");
             return false;
         }
-        msg.data.size = r;
-        if (!WriteFdExactly(s, &msg.data, sizeof(msg.data)) || !WriteFdExactly(s, &buffer[0], r)) {
+        if (encoder) {
+            // The final, empty read finishes the stream.
+            if (!encoder->Encode(&buffer[0], r, r == 0, send_data)) return false;
+        } else if (r > 0 && !send_data(&buffer[0], r)) {
             return false;
         }
+        if (r == 0) break;
     }
 
     msg.data.id = ID_DONE;
@@ -491,6 +867,24 @@ static bool do_recv(int s, const char* path, std::vector<char>& buffer) {
     return WriteFdExactly(s, &msg.data, sizeof(msg.data));
 }
 
+static bool do_recv_v2(int s, const char* path, std::vector<char>& buffer) {
+    syncmsg msg;
+    if (!ReadFdExactly(s, &msg.recv_v2_setup, sizeof(msg.recv_v2_setup))) {
+        SendSyncFail(s, "failed to read recv_v2 setup");
+        return false;
+    }
+    if (msg.recv_v2_setup.id != ID_RECV_V2) {
+        SendSyncFail(s, StringPrintf("unexpected recv_v2 setup id %08x", msg.recv_v2_setup.id));
+        return false;
+    }
+    if (msg.recv_v2_setup.flags & ~kSyncFlagBrotli) {
+        SendSyncFail(s, StringPrintf("unknown recv_v2 flags %#x", msg.recv_v2_setup.flags));
+        return false;
+    }
+
+    return do_recv(s, path, msg.recv_v2_setup.flags & kSyncFlagBrotli, buffer);
+}
+
 static const char* sync_id_to_name(uint32_t id) {
   switch (id) {
     case ID_LSTAT_V1:
@@ -505,6 +899,12 @@ static const char* sync_id_to_name(uint32_t id) {
       return "send";
     case ID_RECV:
       return "recv";
+    case ID_SEND_V2:
+      return "send_v2";
+    case ID_RECV_V2:
+      return "recv_v2";
+    case ID_HASH:
+      return "hash";
     case ID_QUIT:
         return "quit";
     default:
@@ -550,10 +950,19 @@ static bool handle_sync_command(int fd, std::vector<char>& buffer) {
             if (!do_list(fd, name)) return false;
             break;
         case ID_SEND:
-            if (!do_send(fd, name, buffer)) return false;
+            if (!do_send_v1(fd, name, buffer)) return false;
             break;
         case ID_RECV:
-            if (!do_recv(fd, name, buffer)) return false;
+            if (!do_recv(fd, name, false, buffer)) return false;
+            break;
+        case ID_SEND_V2:
+            if (!do_send_v2(fd, name, buffer)) return false;
+            break;
+        case ID_RECV_V2:
+            if (!do_recv_v2(fd, name, buffer)) return false;
+            break;
+        case ID_HASH:
+            if (!do_hash(fd, name, buffer)) return false;
             break;
         case ID_QUIT:
             return false;
@@ -28,11 +28,18 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <android-base/strings.h>
+
 #include "sysdeps.h"
 
 #include "adb.h"
 #include "adb_io.h"
 #include "adb_utils.h"
+#include "compression_utils.h"
 
 /* TODO:
 ** - sync with vsync to avoid tearing
@@ -57,21 +64,36 @@ struct fbinfo {
     unsigned int alpha_length;
 } __attribute__((packed));
 
-void framebuffer_service(unique_fd fd) {
-    struct fbinfo fbinfo;
-    unsigned int i, bsize;
-    char buf[640];
-    int fd_screencap;
+/* Sent before each compressed frame's pixels. */
+struct fbframe {
+    unsigned int flags;
+} __attribute__((packed));
+
+/* The frame's pixels are XORed with the previous frame's. */
+#define FBFRAME_DELTA 1
+
+/* How much of the pixels is read, and compressed, at a time. */
+static constexpr size_t kChunkSize = 256 * 1024;
+/* The most compressed data sent in one block. */
+static constexpr size_t kBlockSize = 64 * 1024;
+
+/* Runs screencap, and reads its header into |fbinfo|. Returns the pipe carrying the pixels, or
+   -1 if screencap failed or uses a format we don't know. */
+static int start_screencap(pid_t* pid, struct fbinfo* fbinfo) {
     int w, h, f, c;
     int fds[2];
-    pid_t pid;
 
-    if (pipe2(fds, O_CLOEXEC) < 0) return;
+    *pid = -1;
+    if (pipe2(fds, O_CLOEXEC) < 0) return -1;
 
-    pid = fork();
-    if (pid < 0) goto done;
+    *pid = fork();
+    if (*pid < 0) {
+        adb_close(fds[0]);
+        adb_close(fds[1]);
+        return -1;
+    }
 
-    if (pid == 0) {
+    if (*pid == 0) {
         dup2(fds[1], STDOUT_FILENO);
         adb_close(fds[0]);
         adb_close(fds[1]);
@@ -82,106 +104,207 @@ void framebuffer_service(unique_fd fd) {
     }
 
     adb_close(fds[1]);
-    fd_screencap = fds[0];
+    int fd_screencap = fds[0];
 
     /* read w, h, format & color space */
-    if(!ReadFdExactly(fd_screencap, &w, 4)) goto done;
-    if(!ReadFdExactly(fd_screencap, &h, 4)) goto done;
-    if(!ReadFdExactly(fd_screencap, &f, 4)) goto done;
-    if(!ReadFdExactly(fd_screencap, &c, 4)) goto done;
+    if(!ReadFdExactly(fd_screencap, &w, 4)) goto fail;
+    if(!ReadFdExactly(fd_screencap, &h, 4)) goto fail;
+    if(!ReadFdExactly(fd_screencap, &f, 4)) goto fail;
+    if(!ReadFdExactly(fd_screencap, &c, 4)) goto fail;
 
-    fbinfo.version = DDMS_RAWIMAGE_VERSION;
-    fbinfo.colorSpace = c;
+    fbinfo->version = DDMS_RAWIMAGE_VERSION;
+    fbinfo->colorSpace = c;
     /* see hardware/hardware.h */
     switch (f) {
         case 1: /* RGBA_8888 */
-            fbinfo.bpp = 32;
-            fbinfo.size = w * h * 4;
-            fbinfo.width = w;
-            fbinfo.height = h;
-            fbinfo.red_offset = 0;
-            fbinfo.red_length = 8;
-            fbinfo.green_offset = 8;
-            fbinfo.green_length = 8;
-            fbinfo.blue_offset = 16;
-            fbinfo.blue_length = 8;
-            fbinfo.alpha_offset = 24;
-            fbinfo.alpha_length = 8;
+            fbinfo->bpp = 32;
+            fbinfo->size = w * h * 4;
+            fbinfo->width = w;
+            fbinfo->height = h;
+            fbinfo->red_offset = 0;
+            fbinfo->red_length = 8;
+            fbinfo->green_offset = 8;
+            fbinfo->green_length = 8;
+            fbinfo->blue_offset = 16;
+            fbinfo->blue_length = 8;
+            fbinfo->alpha_offset = 24;
+            fbinfo->alpha_length = 8;
             break;
         case 2: /* RGBX_8888 */
-            fbinfo.bpp = 32;
-            fbinfo.size = w * h * 4;
-            fbinfo.width = w;
-            fbinfo.height = h;
-            fbinfo.red_offset = 0;
-            fbinfo.red_length = 8;
-            fbinfo.green_offset = 8;
-            fbinfo.green_length = 8;
-            fbinfo.blue_offset = 16;
-            fbinfo.blue_length = 8;
-            fbinfo.alpha_offset = 24;
-            fbinfo.alpha_length = 0;
+            fbinfo->bpp = 32;
+            fbinfo->size = w * h * 4;
+            fbinfo->width = w;
+            fbinfo->height = h;
+            fbinfo->red_offset = 0;
+            fbinfo->red_length = 8;
+            fbinfo->green_offset = 8;
+            fbinfo->green_length = 8;
+            fbinfo->blue_offset = 16;
+            fbinfo->blue_length = 8;
+            fbinfo->alpha_offset = 24;
+            fbinfo->alpha_length = 0;
             break;
         case 3: /* RGB_888 */
-            fbinfo.bpp = 24;
-            fbinfo.size = w * h * 3;
-            fbinfo.width = w;
-            fbinfo.height = h;
-            fbinfo.red_offset = 0;
-            fbinfo.red_length = 8;
-            fbinfo.green_offset = 8;
-            fbinfo.green_length = 8;
-            fbinfo.blue_offset = 16;
-            fbinfo.blue_length = 8;
-            fbinfo.alpha_offset = 24;
-            fbinfo.alpha_length = 0;
+            fbinfo->bpp = 24;
+            fbinfo->size = w * h * 3;
+            fbinfo->width = w;
+            fbinfo->height = h;
+            fbinfo->red_offset = 0;
+            fbinfo->red_length = 8;
+            fbinfo->green_offset = 8;
+            fbinfo->green_length = 8;
+            fbinfo->blue_offset = 16;
+            fbinfo->blue_length = 8;
+            fbinfo->alpha_offset = 24;
+            fbinfo->alpha_length = 0;
             break;
         case 4: /* RGB_565 */
-            fbinfo.bpp = 16;
-            fbinfo.size = w * h * 2;
-            fbinfo.width = w;
-            fbinfo.height = h;
-            fbinfo.red_offset = 11;
-            fbinfo.red_length = 5;
-            fbinfo.green_offset = 5;
-            fbinfo.green_length = 6;
-            fbinfo.blue_offset = 0;
-            fbinfo.blue_length = 5;
-            fbinfo.alpha_offset = 0;
-            fbinfo.alpha_length = 0;
+            fbinfo->bpp = 16;
+            fbinfo->size = w * h * 2;
+            fbinfo->width = w;
+            fbinfo->height = h;
+            fbinfo->red_offset = 11;
+            fbinfo->red_length = 5;
+            fbinfo->green_offset = 5;
+            fbinfo->green_length = 6;
+            fbinfo->blue_offset = 0;
+            fbinfo->blue_length = 5;
+            fbinfo->alpha_offset = 0;
+            fbinfo->alpha_length = 0;
             break;
         case 5: /* BGRA_8888 */
-            fbinfo.bpp = 32;
-            fbinfo.size = w * h * 4;
-            fbinfo.width = w;
-            fbinfo.height = h;
-            fbinfo.red_offset = 16;
-            fbinfo.red_length = 8;
-            fbinfo.green_offset = 8;
-            fbinfo.green_length = 8;
-            fbinfo.blue_offset = 0;
-            fbinfo.blue_length = 8;
-            fbinfo.alpha_offset = 24;
-            fbinfo.alpha_length = 8;
+            fbinfo->bpp = 32;
+            fbinfo->size = w * h * 4;
+            fbinfo->width = w;
+            fbinfo->height = h;
+            fbinfo->red_offset = 16;
+            fbinfo->red_length = 8;
+            fbinfo->green_offset = 8;
+            fbinfo->green_length = 8;
+            fbinfo->blue_offset = 0;
+            fbinfo->blue_length = 8;
+            fbinfo->alpha_offset = 24;
+            fbinfo->alpha_length = 8;
            break;
         default:
-            goto done;
+            goto fail;
+    }
+    return fd_screencap;
+
+fail:
+    adb_close(fd_screencap);
+    return -1;
+}
+
+static void finish_screencap(int fd_screencap, pid_t pid) {
+    if (fd_screencap >= 0) adb_close(fd_screencap);
+    if (pid > 0) TEMP_FAILURE_RETRY(waitpid(pid, nullptr, 0));
+}
+
+/* Sends one frame as it comes from screencap. */
+static void send_raw_frame(int fd) {
+    struct fbinfo fbinfo;
+    pid_t pid;
+    int fd_screencap = start_screencap(&pid, &fbinfo);
+    if (fd_screencap < 0) {
+        finish_screencap(fd_screencap, pid);
+        return;
     }
 
+    std::vector<char> buf(kChunkSize);
+    unsigned int i, bsize;
+
     /* write header */
-    if (!WriteFdExactly(fd.get(), &fbinfo, sizeof(fbinfo))) goto done;
+    if (!WriteFdExactly(fd, &fbinfo, sizeof(fbinfo))) goto done;
 
     /* write data */
     for(i = 0; i < fbinfo.size; i += bsize) {
-      bsize = sizeof(buf);
+      bsize = buf.size();
       if (i + bsize > fbinfo.size)
         bsize = fbinfo.size - i;
-      if(!ReadFdExactly(fd_screencap, buf, bsize)) goto done;
-      if (!WriteFdExactly(fd.get(), buf, bsize)) goto done;
+      if(!ReadFdExactly(fd_screencap, buf.data(), bsize)) goto done;
+      if (!WriteFdExactly(fd, buf.data(), bsize)) goto done;
     }
 
 done:
-    adb_close(fds[0]);
+    finish_screencap(fd_screencap, pid);
+}
+
+/* Sends one frame with its pixels brotli compressed, in blocks that each start with their
+   length, ending with an empty block. With |previous|, which holds the last frame sent, frames
+   of the same size are sent XORed with it: what didn't change compresses to almost nothing.
+   |previous| is then updated to this frame. */
+static bool send_compressed_frame(int fd, std::vector<char>* previous) {
+    struct fbinfo fbinfo;
+    pid_t pid;
+    int fd_screencap = start_screencap(&pid, &fbinfo);
+    if (fd_screencap < 0) {
+        finish_screencap(fd_screencap, pid);
+        return false;
+    }
+
+    struct fbframe frame = {};
+    bool delta = previous && previous->size() == fbinfo.size;
+    if (delta) frame.flags |= FBFRAME_DELTA;
+    if (previous && !delta) previous->resize(fbinfo.size);
+
+    std::vector<char> chunk(kChunkSize);
+    std::vector<char> block(sizeof(uint32_t) + kBlockSize);
+    auto send_block = [fd, &block](const char* data, size_t length) {
+        uint32_t block_length = length;
+        memcpy(block.data(), &block_length, sizeof(block_length));
+        memcpy(block.data() + sizeof(block_length), data, length);
+        return WriteFdExactly(fd, block.data(), sizeof(block_length) + length);
+    };
+    BrotliEncoder encoder(kBlockSize);
 
-    TEMP_FAILURE_RETRY(waitpid(pid, nullptr, 0));
+    bool ok =
+            WriteFdExactly(fd, &fbinfo, sizeof(fbinfo)) && WriteFdExactly(fd, &frame, sizeof(frame));
+    for (size_t i = 0; ok && i < fbinfo.size; i += chunk.size()) {
+        size_t length = std::min(chunk.size(), fbinfo.size - i);
+        if (!ReadFdExactly(fd_screencap, chunk.data(), length)) {
+            ok = false;
+            break;
+        }
+        if (previous) {
+            char* last = previous->data() + i;
+            for (size_t j = 0; j < length; j++) {
+                char pixel = chunk[j];
+                if (delta) chunk[j] ^= last[j];
+                last[j] = pixel;
+            }
+        }
+        ok = encoder.Encode(chunk.data(), length, i + length == fbinfo.size, send_block);
+    }
+    if (ok && fbinfo.size == 0) ok = encoder.Encode(nullptr, 0, true, send_block);
+
+    uint32_t end = 0;
+    ok = ok && WriteFdExactly(fd, &end, sizeof(end));
+    finish_screencap(fd_screencap, pid);
+    return ok;
+}
+
+void framebuffer_service(unique_fd fd, std::string options) {
+    bool compressed = false;
+    bool delta = false;
+    for (const std::string& option : android::base::Split(options, ",")) {
+        if (option == "brotli") {
+            compressed = true;
+        } else if (option == "delta") {
+            delta = true;
+        } else if (!option.empty()) {
+            return;
+        }
+    }
+    if (!compressed) {
+        if (!delta) send_raw_frame(fd.get());
+        return;
+    }
+
+    /* The first frame is sent right away, then another each time the client sends a byte. */
+    std::vector<char> previous;
+    while (send_compressed_frame(fd.get(), delta ? &previous : nullptr) && delta) {
+        char request;
+        if (!ReadFdExactly(fd.get(), &request, 1)) break;
+    }
 }
@@ -16,8 +16,11 @@
 
 #pragma once
 
+#include <string>
+
 #include "adb_unique_fd.h"
 
 #if defined(__ANDROID__)
-void framebuffer_service(unique_fd fd);
+// |options| is what follows "framebuffer:" in the service name: see SERVICES.TXT.
+void framebuffer_service(unique_fd fd, std::string options);
 #endif
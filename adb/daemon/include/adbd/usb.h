@@ -21,6 +21,7 @@
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
+#include <string>
 #include <vector>
 
 #include <android-base/unique_fd.h>
@@ -64,5 +65,8 @@ struct usb_handle {
 };
 
 usb_handle *create_usb_handle(unsigned num_bufs, unsigned io_size);
+// A description of the current FunctionFS AIO connection's configuration and throughput.
+std::string usb_ffs_stats();
+
 bool open_functionfs(android::base::unique_fd* control, android::base::unique_fd* bulk_out,
                      android::base::unique_fd* bulk_in);
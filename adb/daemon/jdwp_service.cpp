@@ -25,16 +25,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
 #include <sys/un.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <list>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 
 #include <adbconnection/server.h>
 #include <android-base/cmsg.h>
+#include <android-base/stringprintf.h>
 #include <android-base/unique_fd.h>
 
 #include "adb.h"
@@ -45,6 +50,10 @@
 using android::base::borrowed_fd;
 using android::base::unique_fd;
 
+#if !defined(__NR_pidfd_open)
+#define __NR_pidfd_open 434
+#endif
+
 /* here's how these things work.
 
    when adbd starts, it creates a unix server socket
@@ -64,7 +73,9 @@ using android::base::unique_fd;
 
     the connection is kept alive. it will be closed automatically if
     the JDWP process terminates (this allows adbd to detect dead
-    processes).
+    processes). on kernels with pidfd_open(), adbd also waits on a
+    pidfd for the process, which notices its death even if a child
+    it forked still holds the connection.
 
     adbd thus maintains a list of "active" JDWP processes. it can send
     its content to clients through the "device:debug-ports" service,
@@ -133,7 +144,8 @@ using android::base::unique_fd;
  **/
 
 static void jdwp_process_event(int socket, unsigned events, void* _proc);
-static void jdwp_process_list_updated(void);
+static void jdwp_process_exit_event(int pidfd, unsigned events, void* _proc);
+static void jdwp_process_list_changed(char change, pid_t pid);
 
 struct JdwpProcess;
 static auto& _jdwp_list = *new std::list<std::unique_ptr<JdwpProcess>>();
@@ -149,6 +161,15 @@ struct JdwpProcess {
         if (!this->fde) {
             LOG(FATAL) << "could not create fdevent for new JDWP process";
         }
+        fdevent_set(this->fde, FDE_READ);
+
+        int pidfd = syscall(__NR_pidfd_open, pid, 0);
+        if (pidfd >= 0) {
+            this->exit_fde = fdevent_create(pidfd, jdwp_process_exit_event, this);
+            fdevent_set(this->exit_fde, FDE_READ);
+        } else {
+            D("pidfd_open(%d) failed, relying on the JDWP socket: %s", pid, strerror(errno));
+        }
     }
 
     ~JdwpProcess() {
@@ -162,17 +183,26 @@ struct JdwpProcess {
             this->fde = nullptr;
         }
 
+        if (this->exit_fde) {
+            fdevent_destroy(this->exit_fde);
+            this->exit_fde = nullptr;
+        }
+
         out_fds.clear();
     }
 
     void RemoveFromList() {
+        pid_t removed_pid = this->pid;
         auto pred = [this](const auto& proc) { return proc.get() == this; };
         _jdwp_list.remove_if(pred);
+        jdwp_process_list_changed('-', removed_pid);
     }
 
     borrowed_fd socket = -1;
     int32_t pid = -1;
     fdevent* fde = nullptr;
+    // Watches a pidfd for the process, if the kernel has them.
+    fdevent* exit_fde = nullptr;
 
     std::vector<unique_fd> out_fds;
 };
@@ -193,9 +223,12 @@ static size_t jdwp_process_list(char* buffer, size_t bufferlen) {
     return temp.length();
 }
 
+// Message is length-prefixed with 4 hex digits in ASCII.
+static constexpr size_t kJdwpMsgHeaderLen = 4;
+static constexpr size_t kJdwpMsgMaxLen = kJdwpMsgHeaderLen + 0xffff;
+
 static size_t jdwp_process_list_msg(char* buffer, size_t bufferlen) {
-    // Message is length-prefixed with 4 hex digits in ASCII.
-    static constexpr size_t header_len = 4;
+    static constexpr size_t header_len = kJdwpMsgHeaderLen;
     if (bufferlen < header_len) {
         LOG(FATAL) << "invalid JDWP process list buffer size: " << bufferlen;
     }
@@ -239,7 +272,16 @@ static void jdwp_process_event(int socket, unsigned events, void* _proc) {
 
 CloseProcess:
     proc->RemoveFromList();
-    jdwp_process_list_updated();
+}
+
+static void jdwp_process_exit_event(int pidfd, unsigned events, void* _proc) {
+    JdwpProcess* proc = reinterpret_cast<JdwpProcess*>(_proc);
+    CHECK_EQ(pidfd, proc->exit_fde->fd.get());
+
+    if (events & FDE_READ) {
+        D("JDWP process %d exited", proc->pid);
+        proc->RemoveFromList();
+    }
 }
 
 unique_fd create_jdwp_connection_fd(int pid) {
@@ -304,11 +346,10 @@ static void jdwp_socket_ready(asocket* s) {
      * on the second one, close the connection
      */
     if (!jdwp->pass) {
-        apacket::payload_type data;
-        data.resize(s->get_max_payload());
+        Block data(s->get_max_payload());
         size_t len = jdwp_process_list(&data[0], data.size());
         data.resize(len);
-        peer->enqueue(peer, std::move(data));
+        peer->enqueue(peer, apacket::payload_type(std::move(data)));
         jdwp->pass = true;
     } else {
         peer->close(peer);
@@ -332,29 +373,88 @@ asocket* create_jdwp_service_socket(void) {
     return s;
 }
 
-/** "track-jdwp" local service implementation
- ** this periodically sends the list of known JDWP process pids
- ** to the client...
+/** "track-jdwp" and "track-jdwp-delta" local service implementation
+ ** this sends the list of known JDWP process pids to the client,
+ ** and then either the whole list or just what changed in it
+ ** whenever it changes...
  **/
 
 struct JdwpTracker : public asocket {
     bool need_initial;
+    bool delta;
+    // How much of _jdwp_list_changes the client already knows about.
+    size_t changes_sent;
 };
 
 static auto& _jdwp_trackers = *new std::vector<std::unique_ptr<JdwpTracker>>();
 
-static void jdwp_process_list_updated(void) {
-    std::string data;
-    data.resize(1024);
+// The processes added to and removed from _jdwp_list since the trackers were last updated, as
+// "+<pid>\n" and "-<pid>\n" lines in the order it happened. Many processes starting or dying at
+// once (e.g. when the zygote restarts) thus only cost one update per tracker.
+static auto& _jdwp_list_changes = *new std::string();
+static bool _jdwp_list_update_pending = false;
+
+static size_t jdwp_tracker_max_msg_len(asocket* s) {
+    return std::min<size_t>(s->get_max_payload(), kJdwpMsgMaxLen);
+}
+
+static void jdwp_tracker_send_list(JdwpTracker* t) {
+    Block data(jdwp_tracker_max_msg_len(t));
     data.resize(jdwp_process_list_msg(&data[0], data.size()));
+    t->peer->enqueue(t->peer, apacket::payload_type(std::move(data)));
+}
+
+// Sends the given "\n"-terminated lines in as many messages as it takes.
+static void jdwp_tracker_send_delta(JdwpTracker* t, std::string_view lines) {
+    const size_t max_len = jdwp_tracker_max_msg_len(t) - kJdwpMsgHeaderLen;
+    while (!lines.empty()) {
+        size_t len = lines.size();
+        if (len > max_len) {
+            // A single line is much shorter than any max payload.
+            len = lines.rfind('\n', max_len - 1) + 1;
+        }
+
+        std::string msg = android::base::StringPrintf("%04zx", len);
+        msg.append(lines.substr(0, len));
+        lines.remove_prefix(len);
+        t->peer->enqueue(t->peer, apacket::payload_type(Block(msg.begin(), msg.end())));
+    }
+}
+
+static void jdwp_process_list_updated(void) {
+    _jdwp_list_update_pending = false;
 
     for (auto& t : _jdwp_trackers) {
-        if (t->peer) {
-            // The tracker might not have been connected yet.
-            apacket::payload_type payload(data.begin(), data.end());
-            t->peer->enqueue(t->peer, std::move(payload));
+        // The tracker might not have been connected yet, in which case its initial list
+        // will be up to date anyway.
+        if (!t->peer || t->need_initial || t->changes_sent == _jdwp_list_changes.size()) {
+            continue;
+        }
+
+        if (t->delta) {
+            jdwp_tracker_send_delta(
+                    t.get(), std::string_view(_jdwp_list_changes).substr(t->changes_sent));
+        } else {
+            jdwp_tracker_send_list(t.get());
         }
     }
+
+    _jdwp_list_changes.clear();
+    for (auto& t : _jdwp_trackers) {
+        t->changes_sent = 0;
+    }
+}
+
+static void jdwp_process_list_changed(char change, pid_t pid) {
+    _jdwp_list_changes += change;
+    _jdwp_list_changes += std::to_string(pid);
+    _jdwp_list_changes += '\n';
+
+    // Let the rest of this turn of the fdevent loop happen before telling the trackers.
+    if (!_jdwp_list_update_pending) {
+        _jdwp_list_update_pending = true;
+        fdevent_run_on_main_thread(jdwp_process_list_updated);
+    }
 }
 
 static void jdwp_tracker_close(asocket* s) {
@@ -378,11 +478,9 @@ static void jdwp_tracker_ready(asocket* s) {
     JdwpTracker* t = (JdwpTracker*)s;
 
     if (t->need_initial) {
-        apacket::payload_type data;
-        data.resize(s->get_max_payload());
-        data.resize(jdwp_process_list_msg(&data[0], data.size()));
         t->need_initial = false;
-        s->peer->enqueue(s->peer, std::move(data));
+        t->changes_sent = _jdwp_list_changes.size();
+        jdwp_tracker_send_list(t);
     }
 }
 
@@ -393,7 +491,7 @@ static int jdwp_tracker_enqueue(asocket* s, apacket::payload_type) {
     return -1;
 }
 
-asocket* create_jdwp_tracker_service_socket(void) {
+asocket* create_jdwp_tracker_service_socket(bool delta) {
     auto t = std::make_unique<JdwpTracker>();
     if (!t) {
         LOG(FATAL) << "failed to allocate JdwpTracker";
@@ -408,6 +506,8 @@ asocket* create_jdwp_tracker_service_socket(void) {
     t->enqueue = jdwp_tracker_enqueue;
     t->close = jdwp_tracker_close;
     t->need_initial = true;
+    t->delta = delta;
+    t->changes_sent = 0;
 
     asocket* result = t.get();
 
@@ -428,7 +528,7 @@ int init_jdwp(void) {
                     LOG(FATAL) << "failed to allocate JdwpProcess";
                 }
                 _jdwp_list.emplace_back(std::move(proc));
-                jdwp_process_list_updated();
+                jdwp_process_list_changed('+', pid);
             });
         });
     }).detach();
@@ -39,6 +39,7 @@
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <android-base/unique_fd.h>
+#include <adbd/usb.h>
 #include <cutils/sockets.h>
 #include <log/log_properties.h>
 
@@ -121,6 +122,12 @@ unique_fd ShellService(std::string_view args, const atransport* transport) {
     return StartSubprocess(command, terminal_type.c_str(), type, protocol);
 }
 
+#if defined(__ANDROID__)
+static void usb_stats_service(unique_fd fd) {
+    WriteFdExactly(fd.get(), usb_ffs_stats());
+}
+#endif
+
 static void spin_service(unique_fd fd) {
     if (!__android_log_is_debuggable()) {
         WriteFdExactly(fd.get(), "refusing to spin on non-debuggable build\n");
@@ -209,7 +216,7 @@ struct SourceSocket : public ServiceSocket {
 
         Block block(len);
         memset(block.data(), 0, block.size());
-        peer->enqueue(peer, std::move(block));
+        peer->enqueue(peer, apacket::payload_type(std::move(block)));
         bytes_left_ -= len;
     }
 
@@ -222,7 +229,9 @@ asocket* daemon_service_to_socket(std::string_view name) {
     if (name == "jdwp") {
         return create_jdwp_service_socket();
     } else if (name == "track-jdwp") {
-        return create_jdwp_tracker_service_socket();
+        return create_jdwp_tracker_service_socket(false);
+    } else if (name == "track-jdwp-delta") {
+        return create_jdwp_tracker_service_socket(true);
     } else if (android::base::ConsumePrefix(&name, "sink:")) {
         uint64_t byte_count = 0;
         if (!ParseUint(&byte_count, name)) {
@@ -248,8 +257,10 @@ unique_fd daemon_service_to_fd(std::string_view name, atransport* transport) {
 #endif
 
 #if defined(__ANDROID__)
-    if (name.starts_with("framebuffer:")) {
-        return create_service_thread("fb", framebuffer_service);
+    if (android::base::ConsumePrefix(&name, "framebuffer:")) {
+        std::string options(name);
+        return create_service_thread("fb",
+                                     std::bind(framebuffer_service, std::placeholders::_1, options));
     } else if (android::base::ConsumePrefix(&name, "remount:")) {
         std::string arg(name);
         return create_service_thread("remount",
@@ -286,6 +297,8 @@ unique_fd daemon_service_to_fd(std::string_view name, atransport* transport) {
                                      std::bind(restart_tcp_service, std::placeholders::_1, port));
     } else if (name.starts_with("usb:")) {
         return create_service_thread("usb", restart_usb_service);
+    } else if (name == "usb-stats") {
+        return create_service_thread("usb-stats", usb_stats_service);
     }
 #endif
 
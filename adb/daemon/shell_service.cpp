@@ -88,7 +88,10 @@
 #include <sys/select.h>
 #include <termios.h>
 
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <unordered_map>
@@ -407,6 +410,62 @@ bool Subprocess::ForkAndExec(std::string* error) {
     return true;
 }
 
+// Runs in-process commands on a bounded set of reused threads, so that a stream of commands
+// doesn't cost a new thread each, and a burst of them doesn't create an unbounded number of
+// threads. Commands started while all of the threads are busy wait for one to be free; their
+// streams are already connected, so they can be written to in the meantime.
+class InProcessCommandRunner {
+  public:
+    void Run(Command* command, std::string args, unique_fd inout_sfd, unique_fd err_sfd) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back({command, std::move(args), std::move(inout_sfd), std::move(err_sfd)});
+        if (queue_.size() > idle_threads_ && threads_ < kMaxThreads) {
+            ++threads_;
+            std::thread(&InProcessCommandRunner::Loop, this).detach();
+        } else {
+            cv_.notify_one();
+        }
+    }
+
+  private:
+    // Plenty for scripts issuing commands in parallel, while leaving room for commands that
+    // block on their input.
+    static constexpr size_t kMaxThreads = 16;
+
+    struct Job {
+        Command* command;
+        std::string args;
+        unique_fd inout_sfd;
+        unique_fd err_sfd;
+    };
+
+    void Loop() {
+        adb_thread_setname("inprocess cmd");
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            ++idle_threads_;
+            cv_.wait(lock, [this]() { return !queue_.empty(); });
+            --idle_threads_;
+            Job job = std::move(queue_.front());
+            queue_.pop_front();
+            lock.unlock();
+
+            job.command(job.args, job.inout_sfd, job.inout_sfd, job.err_sfd);
+            // Close the streams before waiting for the next job, so the client sees EOF.
+            job = {};
+            lock.lock();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Job> queue_;
+    size_t threads_ = 0;
+    size_t idle_threads_ = 0;
+};
+
+auto& g_inprocess_command_runner = *new InProcessCommandRunner();
+
 bool Subprocess::ExecInProcess(Command command, std::string* _Nonnull error) {
     unique_fd child_stdinout_sfd, child_stderr_sfd;
 
@@ -438,10 +497,8 @@ bool Subprocess::ExecInProcess(Command command, std::string* _Nonnull error) {
         return false;
     }
 
-    std::thread([inout_sfd = std::move(child_stdinout_sfd), err_sfd = std::move(child_stderr_sfd),
-                 command = std::move(command),
-                 args = command_]() { command(args, inout_sfd, inout_sfd, err_sfd); })
-            .detach();
+    g_inprocess_command_runner.Run(command, command_, std::move(child_stdinout_sfd),
+                                   std::move(child_stderr_sfd));
 
     D("execinprocess: completed");
     return true;
@@ -716,24 +773,37 @@ unique_fd* Subprocess::PassInput() {
 }
 
 unique_fd* Subprocess::PassOutput(unique_fd* sfd, ShellProtocol::Id id) {
-    int bytes = adb_read(*sfd, output_->data(), output_->data_capacity());
-    if (bytes == 0 || (bytes < 0 && errno != EAGAIN)) {
-        // read() returns EIO if a PTY closes; don't report this as an error,
-        // it just means the subprocess completed.
-        if (bytes < 0 && !(type_ == SubprocessType::kPty && errno == EIO)) {
-            PLOG(ERROR) << "error reading output FD " << sfd->get();
+    // Rather than sending a packet per read, keep reading while the subprocess has output ready,
+    // so that a subprocess writing a lot of data gets it sent in packets as large as the buffer.
+    // The FD is non-blocking, so this never waits for more output than is already there.
+    size_t length = 0;
+    bool dead = false;
+    while (length < output_->data_capacity()) {
+        int bytes = adb_read(*sfd, output_->data() + length, output_->data_capacity() - length);
+        if (bytes > 0) {
+            length += bytes;
+            continue;
+        }
+        if (bytes == 0 || errno != EAGAIN) {
+            // read() returns EIO if a PTY closes; don't report this as an error,
+            // it just means the subprocess completed.
+            if (bytes < 0 && !(type_ == SubprocessType::kPty && errno == EIO)) {
+                PLOG(ERROR) << "error reading output FD " << sfd->get();
+            }
+            dead = true;
         }
-        return sfd;
+        break;
     }
 
-    if (bytes > 0 && !output_->Write(id, bytes)) {
+    // Send whatever was read before the FD closed too.
+    if (length > 0 && !output_->Write(id, length)) {
         if (errno != 0) {
             PLOG(ERROR) << "error reading protocol FD " << protocol_sfd_.get();
         }
         return &protocol_sfd_;
     }
 
-    return nullptr;
+    return dead ? sfd : nullptr;
 }
 
 void Subprocess::WaitForExit() {
@@ -184,6 +184,20 @@ TEST_F(ShellServiceTest, RawShellProtocolSubprocess) {
     ExpectLinesEqual(stderr, {"bar"});
 }
 
+// Tests that output larger than the shell protocol buffer arrives whole.
+TEST_F(ShellServiceTest, RawShellProtocolLargeOutput) {
+    ASSERT_NO_FATAL_FAILURE(StartTestSubprocess(
+            "head -c 4194304 /dev/zero | tr '\\0' x; echo; exit 3",
+            SubprocessType::kRaw, SubprocessProtocol::kShell));
+
+    std::string stdout, stderr;
+    EXPECT_EQ(3, ReadShellProtocol(command_fd_, &stdout, &stderr));
+    ASSERT_EQ(4194305u, stdout.size());
+    EXPECT_EQ(4194304u, stdout.find_first_not_of('x'));
+    EXPECT_EQ('\n', stdout.back());
+    EXPECT_EQ("", stderr);
+}
+
 // Tests a PTY subprocess with the shell protocol.
 TEST_F(ShellServiceTest, PtyShellProtocolSubprocess) {
     ASSERT_NO_FATAL_FAILURE(StartTestSubprocess(
@@ -318,3 +332,28 @@ TEST_F(ShellServiceTest, RawShellProtocolInprocess) {
     ExpectLinesEqual(stdout, {"out"});
     ExpectLinesEqual(stderr, {"err"});
 }
+
+// Tests that more inprocess commands than there are threads to run them all get to run, and
+// that the ones waiting for a thread can be written to in the meantime.
+TEST_F(ShellServiceTest, ManyInprocessCommands) {
+    constexpr int kCommands = 40;
+    std::vector<unique_fd> fds;
+    for (int i = 0; i < kCommands; ++i) {
+        fds.push_back(StartCommandInProcess(std::to_string(i),
+                                            [](auto args, auto in, auto out, auto) -> int {
+                                                char input[2];
+                                                EXPECT_TRUE(ReadFdExactly(in, input, 2));
+                                                WriteFdExactly(out, std::string(args) + "\n");
+                                                return 0;
+                                            },
+                                            SubprocessProtocol::kNone));
+        ASSERT_GE(fds.back(), 0);
+    }
+
+    for (int i = kCommands - 1; i >= 0; --i) {
+        ASSERT_TRUE(WriteFdExactly(fds[i], "in"));
+    }
+    for (int i = 0; i < kCommands; ++i) {
+        ExpectLinesEqual(ReadRaw(fds[i]), {std::to_string(i)});
+    }
+}
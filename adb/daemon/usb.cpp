@@ -19,6 +19,7 @@
 #include "sysdeps.h"
 
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -39,9 +40,11 @@
 
 #include <asyncio/AsyncIO.h>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/macros.h>
 #include <android-base/properties.h>
+#include <android-base/strings.h>
 #include <android-base/thread_annotations.h>
 
 #include <adbd/usb.h>
@@ -57,14 +60,106 @@ using android::base::StringPrintf;
 // We can't find out whether we have support for AIO on ffs endpoints until we submit a read.
 static std::optional<bool> gFfsAioSupported;
 
-// Not all USB controllers support operations larger than 16k, so don't go above that.
-// Also, each submitted operation does an allocation in the kernel of that size, so we want to
-// minimize our queue depth while still maintaining a deep enough queue to keep the USB stack fed.
-static constexpr size_t kUsbReadQueueDepth = 8;
-static constexpr size_t kUsbReadSize = 4 * PAGE_SIZE;
+// Not all USB controllers support operations larger than 16k, so don't go above that unless the
+// link is fast enough to need it. Also, each submitted operation does an allocation in the kernel
+// of that size, so we want to minimize our queue depth while still maintaining a deep enough queue
+// to keep the USB stack fed. SuperSpeed links need both more and larger operations in flight.
+static constexpr size_t kUsbQueueDepth = 8;
+static constexpr size_t kUsbTransferSize = 4 * PAGE_SIZE;
 
-static constexpr size_t kUsbWriteQueueDepth = 8;
-static constexpr size_t kUsbWriteSize = 4 * PAGE_SIZE;
+static constexpr size_t kUsbSuperSpeedQueueDepth = 16;
+static constexpr size_t kUsbSuperSpeedTransferSize = 16 * PAGE_SIZE;
+
+// Bounds for the persist.adb.usb.queue_depth and persist.adb.usb.transfer_size overrides.
+static constexpr size_t kUsbMaxQueueDepth = 64;
+static constexpr size_t kUsbMaxTransferSize = 256 * PAGE_SIZE;
+
+struct UsbTransferConfig {
+    std::string speed;
+    size_t queue_depth;
+    size_t transfer_size;
+};
+
+// The UDC reports the negotiated speed once the host has enabled the function.
+static std::string usb_link_speed() {
+    std::string controller = android::base::GetProperty("sys.usb.controller", "");
+    std::string speed;
+    if (controller.empty() ||
+        !android::base::ReadFileToString("/sys/class/udc/" + controller + "/current_speed",
+                                         &speed)) {
+        return "unknown";
+    }
+    return android::base::Trim(speed);
+}
+
+static UsbTransferConfig usb_transfer_config() {
+    UsbTransferConfig config;
+    config.speed = usb_link_speed();
+    if (android::base::StartsWith(config.speed, "super-speed")) {
+        config.queue_depth = kUsbSuperSpeedQueueDepth;
+        config.transfer_size = kUsbSuperSpeedTransferSize;
+    } else {
+        config.queue_depth = kUsbQueueDepth;
+        config.transfer_size = kUsbTransferSize;
+    }
+
+    config.queue_depth = android::base::GetUintProperty<size_t>(
+            "persist.adb.usb.queue_depth", config.queue_depth, kUsbMaxQueueDepth);
+    config.queue_depth = std::max<size_t>(config.queue_depth, 1);
+    size_t transfer_size = android::base::GetUintProperty<size_t>(
+            "persist.adb.usb.transfer_size", config.transfer_size, kUsbMaxTransferSize);
+    config.transfer_size = std::max<size_t>(transfer_size & ~(PAGE_SIZE - 1), PAGE_SIZE);
+    return config;
+}
+
+// Bytes moved in one direction, and the rate over the last full second.
+struct UsbThroughput {
+    void Reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        total = 0;
+        window_start = std::chrono::steady_clock::now();
+        window_bytes = 0;
+        last_rate = 0;
+        peak_rate = 0;
+    }
+
+    void Record(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        total += bytes;
+        window_bytes += bytes;
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed = now - window_start;
+        if (elapsed >= 1s) {
+            last_rate = window_bytes / elapsed.count();
+            peak_rate = std::max(peak_rate, last_rate);
+            window_start = now;
+            window_bytes = 0;
+        }
+    }
+
+    std::string Describe() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return StringPrintf("%" PRIu64 " bytes, last %.1f MB/s, peak %.1f MB/s", total,
+                            last_rate / 1e6, peak_rate / 1e6);
+    }
+
+    std::mutex mutex;
+    uint64_t total GUARDED_BY(mutex) = 0;
+    std::chrono::steady_clock::time_point window_start GUARDED_BY(mutex);
+    uint64_t window_bytes GUARDED_BY(mutex) = 0;
+    double last_rate GUARDED_BY(mutex) = 0;
+    double peak_rate GUARDED_BY(mutex) = 0;
+};
+
+// What the current (or last) UsbFfsConnection is doing, for the usb-stats service.
+struct UsbStats {
+    std::mutex mutex;
+    std::optional<UsbTransferConfig> config GUARDED_BY(mutex);
+    UsbThroughput received;
+    UsbThroughput sent;
+};
+
+static auto& gUsbStats = *new UsbStats();
 
 static const char* to_string(enum usb_functionfs_event_type type) {
     switch (type) {
@@ -120,7 +215,10 @@ struct TransferId {
 struct IoBlock {
     bool pending = false;
     struct iocb control = {};
-    std::shared_ptr<Block> payload;
+    std::shared_ptr<Block> payload;  // Reads only.
+
+    // Writes point into a packet's payload chain, which this keeps alive.
+    std::shared_ptr<const IOVector> write_payload;
 
     TransferId id() const { return TransferId::from_value(control.aio_data); }
 };
@@ -188,7 +286,7 @@ struct UsbFfsConnection : public Connection {
             PLOG(FATAL) << "failed to create eventfd";
         }
 
-        aio_context_ = ScopedAioContext::Create(kUsbReadQueueDepth + kUsbWriteQueueDepth);
+        aio_context_ = ScopedAioContext::Create(2 * kUsbMaxQueueDepth);
     }
 
     ~UsbFfsConnection() {
@@ -217,17 +315,17 @@ struct UsbFfsConnection : public Connection {
             // The kernel attempts to allocate a contiguous block of memory for each write,
             // which can fail if the write is large and the kernel heap is fragmented.
             // Split large writes into smaller chunks to avoid this.
-            std::shared_ptr<Block> payload = std::make_shared<Block>(std::move(packet->payload));
-            size_t offset = 0;
-            size_t len = payload->size();
-
-            while (len > 0) {
-                size_t write_size = std::min(kUsbWriteSize, len);
-                write_requests_.push_back(
-                        CreateWriteBlock(payload, offset, write_size, next_write_id_++));
-                len -= write_size;
-                offset += write_size;
-            }
+            std::shared_ptr<const IOVector> payload =
+                    std::make_shared<IOVector>(std::move(packet->payload));
+            payload->iterate_blocks([this, &payload](const char* data, size_t len) {
+                while (len > 0) {
+                    size_t write_size = std::min(write_transfer_size_, len);
+                    write_requests_.push_back(
+                            CreateWriteBlock(payload, data, write_size, next_write_id_++));
+                    len -= write_size;
+                    data += write_size;
+                }
+            });
         }
         SubmitWrites();
         return true;
@@ -342,6 +440,7 @@ struct UsbFfsConnection : public Connection {
                         }
 
                         enabled = true;
+                        ConfigureTransfers();
                         StartWorker();
                         break;
 
@@ -410,12 +509,33 @@ struct UsbFfsConnection : public Connection {
         });
     }
 
+    // Size the queues for the speed the host negotiated, which is only known once enabled.
+    void ConfigureTransfers() {
+        UsbTransferConfig config = usb_transfer_config();
+        LOG(INFO) << "USB link speed " << config.speed << ": " << config.queue_depth << " x "
+                  << config.transfer_size << " byte transfers in flight each way";
+
+        read_queue_depth_ = config.queue_depth;
+        read_transfer_size_ = config.transfer_size;
+        read_requests_.resize(read_queue_depth_);
+        {
+            std::lock_guard<std::mutex> lock(write_mutex_);
+            write_queue_depth_ = config.queue_depth;
+            write_transfer_size_ = config.transfer_size;
+        }
+
+        std::lock_guard<std::mutex> lock(gUsbStats.mutex);
+        gUsbStats.config = std::move(config);
+        gUsbStats.received.Reset();
+        gUsbStats.sent.Reset();
+    }
+
     void StartWorker() {
         CHECK(!worker_started_);
         worker_started_ = true;
         worker_thread_ = std::thread([this]() {
             adb_thread_setname("UsbFfs-worker");
-            for (size_t i = 0; i < kUsbReadQueueDepth; ++i) {
+            for (size_t i = 0; i < read_queue_depth_; ++i) {
                 read_requests_[i] = CreateReadBlock(next_read_id_++);
                 if (!SubmitRead(&read_requests_[i])) {
                     return;
@@ -466,7 +586,7 @@ struct UsbFfsConnection : public Connection {
 
     void PrepareReadBlock(IoBlock* block, uint64_t id) {
         block->pending = false;
-        block->payload = std::make_shared<Block>(kUsbReadSize);
+        block->payload = std::make_shared<Block>(read_transfer_size_);
         block->control.aio_data = static_cast<uint64_t>(TransferId::read(id));
         block->control.aio_buf = reinterpret_cast<uintptr_t>(block->payload->data());
         block->control.aio_nbytes = block->payload->size();
@@ -486,7 +606,7 @@ struct UsbFfsConnection : public Connection {
     }
 
     void ReadEvents() {
-        static constexpr size_t kMaxEvents = kUsbReadQueueDepth + kUsbWriteQueueDepth;
+        static constexpr size_t kMaxEvents = 2 * kUsbMaxQueueDepth;
         struct io_event events[kMaxEvents];
         struct timespec timeout = {.tv_sec = 0, .tv_nsec = 0};
         int rc = io_getevents(aio_context_.get(), 0, kMaxEvents, events, &timeout);
@@ -517,10 +637,11 @@ struct UsbFfsConnection : public Connection {
     }
 
     void HandleRead(TransferId id, int64_t size) {
-        uint64_t read_idx = id.id % kUsbReadQueueDepth;
+        uint64_t read_idx = id.id % read_queue_depth_;
         IoBlock* block = &read_requests_[read_idx];
         block->pending = false;
         block->payload->resize(size);
+        gUsbStats.received.Record(size);
 
         // Notification for completed reads can be received out of order.
         if (block->id().id != needed_read_id_) {
@@ -530,7 +651,7 @@ struct UsbFfsConnection : public Connection {
         }
 
         for (uint64_t id = needed_read_id_;; ++id) {
-            size_t read_idx = id % kUsbReadQueueDepth;
+            size_t read_idx = id % read_queue_depth_;
             IoBlock* current_block = &read_requests_[read_idx];
             if (current_block->pending) {
                 break;
@@ -559,16 +680,14 @@ struct UsbFfsConnection : public Connection {
                 auto packet = std::make_unique<apacket>();
                 packet->msg = *incoming_header_;
 
-                // TODO: Make apacket contain an IOVector so we don't have to coalesce.
-                packet->payload = incoming_payload_.coalesce();
+                packet->payload = std::move(incoming_payload_);
                 read_callback_(this, std::move(packet));
 
                 incoming_header_.reset();
-                incoming_payload_.clear();
             }
         }
 
-        PrepareReadBlock(block, block->id().id + kUsbReadQueueDepth);
+        PrepareReadBlock(block, block->id().id + read_queue_depth_);
         SubmitRead(block);
     }
 
@@ -598,6 +717,7 @@ struct UsbFfsConnection : public Connection {
                 });
         CHECK(it != write_requests_.end());
 
+        gUsbStats.sent.Record((*it)->control.aio_nbytes);
         write_requests_.erase(it);
         size_t outstanding_writes = --writes_submitted_;
         LOG(DEBUG) << "USB write: reaped, down to " << outstanding_writes;
@@ -605,16 +725,16 @@ struct UsbFfsConnection : public Connection {
         SubmitWrites();
     }
 
-    std::unique_ptr<IoBlock> CreateWriteBlock(std::shared_ptr<Block> payload, size_t offset,
-                                              size_t len, uint64_t id) {
+    std::unique_ptr<IoBlock> CreateWriteBlock(std::shared_ptr<const IOVector> payload,
+                                              const char* data, size_t len, uint64_t id) {
         auto block = std::make_unique<IoBlock>();
-        block->payload = std::move(payload);
+        block->write_payload = std::move(payload);
         block->control.aio_data = static_cast<uint64_t>(TransferId::write(id));
         block->control.aio_rw_flags = 0;
         block->control.aio_lio_opcode = IOCB_CMD_PWRITE;
         block->control.aio_reqprio = 0;
         block->control.aio_fildes = write_fd_.get();
-        block->control.aio_buf = reinterpret_cast<uintptr_t>(block->payload->data() + offset);
+        block->control.aio_buf = reinterpret_cast<uintptr_t>(data);
         block->control.aio_nbytes = len;
         block->control.aio_offset = 0;
         block->control.aio_flags = IOCB_FLAG_RESFD;
@@ -623,24 +743,26 @@ struct UsbFfsConnection : public Connection {
     }
 
     std::unique_ptr<IoBlock> CreateWriteBlock(Block payload, uint64_t id) {
-        std::shared_ptr<Block> block = std::make_shared<Block>(std::move(payload));
-        size_t len = block->size();
-        return CreateWriteBlock(std::move(block), 0, len, id);
+        // The block's buffer doesn't move along with it.
+        const char* data = payload.data();
+        size_t len = payload.size();
+        auto chain = std::make_shared<const IOVector>(std::move(payload));
+        return CreateWriteBlock(std::move(chain), data, len, id);
     }
 
     void SubmitWrites() REQUIRES(write_mutex_) {
-        if (writes_submitted_ == kUsbWriteQueueDepth) {
+        if (writes_submitted_ >= write_queue_depth_) {
             return;
         }
 
-        ssize_t writes_to_submit = std::min(kUsbWriteQueueDepth - writes_submitted_,
+        ssize_t writes_to_submit = std::min(write_queue_depth_ - writes_submitted_,
                                             write_requests_.size() - writes_submitted_);
         CHECK_GE(writes_to_submit, 0);
         if (writes_to_submit == 0) {
             return;
         }
 
-        struct iocb* iocbs[kUsbWriteQueueDepth];
+        struct iocb* iocbs[kUsbMaxQueueDepth];
         for (int i = 0; i < writes_to_submit; ++i) {
             CHECK(!write_requests_[writes_submitted_ + i]->pending);
             write_requests_[writes_submitted_ + i]->pending = true;
@@ -689,7 +811,9 @@ struct UsbFfsConnection : public Connection {
     std::optional<amessage> incoming_header_;
     IOVector incoming_payload_;
 
-    std::array<IoBlock, kUsbReadQueueDepth> read_requests_;
+    size_t read_queue_depth_ = kUsbQueueDepth;
+    size_t read_transfer_size_ = kUsbTransferSize;
+    std::vector<IoBlock> read_requests_;
     IOVector read_data_;
 
     // ID of the next request that we're going to send out.
@@ -702,10 +826,28 @@ struct UsbFfsConnection : public Connection {
     std::deque<std::unique_ptr<IoBlock>> write_requests_ GUARDED_BY(write_mutex_);
     size_t next_write_id_ GUARDED_BY(write_mutex_) = 0;
     size_t writes_submitted_ GUARDED_BY(write_mutex_) = 0;
+    size_t write_queue_depth_ GUARDED_BY(write_mutex_) = kUsbQueueDepth;
+    size_t write_transfer_size_ GUARDED_BY(write_mutex_) = kUsbTransferSize;
 
     static constexpr int kInterruptionSignal = SIGUSR1;
 };
 
+std::string usb_ffs_stats() {
+    std::lock_guard<std::mutex> lock(gUsbStats.mutex);
+    if (!gUsbStats.config) {
+        return "no FunctionFS AIO connection\n";
+    }
+
+    const UsbTransferConfig& config = *gUsbStats.config;
+    return StringPrintf(
+            "link speed: %s\n"
+            "transfers: %zu x %zu bytes in flight each way\n"
+            "received: %s\n"
+            "sent: %s\n",
+            config.speed.c_str(), config.queue_depth, config.transfer_size,
+            gUsbStats.received.Describe().c_str(), gUsbStats.sent.Describe().c_str());
+}
+
 void usb_init_legacy();
 
 static void usb_ffs_open_thread() {
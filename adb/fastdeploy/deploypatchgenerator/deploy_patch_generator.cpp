@@ -25,6 +25,8 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 
 #include "adb_unique_fd.h"
 #include "android-base/file.h"
@@ -142,22 +144,35 @@ bool DeployPatchGenerator::CreatePatch(const char* localApkPath, const char* dev
 uint64_t DeployPatchGenerator::BuildIdenticalEntries(std::vector<SimpleEntry>& outIdenticalEntries,
                                                      const APKMetaData& localApkMetadata,
                                                      const APKMetaData& deviceApkMetadata) {
+    // Index the device entries by name, so that large APKs don't take a number of comparisons
+    // that grows with the square of their entry count. If a name appears more than once, the
+    // first entry with it wins, as it did when the entries were searched in order.
+    std::unordered_multimap<std::string_view, int> deviceEntries;
+    deviceEntries.reserve(deviceApkMetadata.entries_size());
+    for (int j = 0; j < deviceApkMetadata.entries_size(); j++) {
+        deviceEntries.emplace(deviceApkMetadata.entries(j).filename(), j);
+    }
+
     uint64_t totalSize = 0;
     for (int i = 0; i < localApkMetadata.entries_size(); i++) {
         const APKEntry& localEntry = localApkMetadata.entries(i);
         totalSize += localEntry.compressedsize();
-        for (int j = 0; j < deviceApkMetadata.entries_size(); j++) {
-            const APKEntry& deviceEntry = deviceApkMetadata.entries(j);
-            if (deviceEntry.crc32() == localEntry.crc32() &&
-                deviceEntry.filename().compare(localEntry.filename()) == 0) {
-                SimpleEntry simpleEntry;
-                simpleEntry.localEntry = const_cast<APKEntry*>(&localEntry);
-                simpleEntry.deviceEntry = const_cast<APKEntry*>(&deviceEntry);
-                APKEntryToLog(localEntry);
-                outIdenticalEntries.push_back(simpleEntry);
-                break;
+        auto [begin, end] = deviceEntries.equal_range(localEntry.filename());
+        int deviceIndex = -1;
+        for (auto it = begin; it != end; ++it) {
+            if (deviceApkMetadata.entries(it->second).crc32() == localEntry.crc32() &&
+                (deviceIndex == -1 || it->second < deviceIndex)) {
+                deviceIndex = it->second;
             }
         }
+        if (deviceIndex != -1) {
+            const APKEntry& deviceEntry = deviceApkMetadata.entries(deviceIndex);
+            SimpleEntry simpleEntry;
+            simpleEntry.localEntry = const_cast<APKEntry*>(&localEntry);
+            simpleEntry.deviceEntry = const_cast<APKEntry*>(&deviceEntry);
+            APKEntryToLog(localEntry);
+            outIdenticalEntries.push_back(simpleEntry);
+        }
     }
     std::sort(outIdenticalEntries.begin(), outIdenticalEntries.end(),
               [](const SimpleEntry& lhs, const SimpleEntry& rhs) {
@@ -69,4 +69,33 @@ TEST(DeployPatchGeneratorTest, NoDeviceMetadata) {
     // Expect a patch file that has a size at least the size of our initial APK.
     long patchSize = adb_lseek(output.fd, 0L, SEEK_END);
     EXPECT_GT(patchSize, apkSize);
-}
\ No newline at end of file
+}
+TEST(DeployPatchGeneratorTest, EntriesMatchByNameAndCrc) {
+    APKMetaData local;
+    APKMetaData device;
+    auto add_entry = [](APKMetaData* metadata, const char* name, uint64_t crc32, int64_t offset) {
+        APKEntry* entry = metadata->add_entries();
+        entry->set_filename(name);
+        entry->set_crc32(crc32);
+        entry->set_dataoffset(offset);
+    };
+    add_entry(&local, "classes.dex", 1, 100);
+    add_entry(&local, "resources.arsc", 2, 50);
+    add_entry(&local, "lib/libfoo.so", 3, 200);
+    add_entry(&device, "lib/libfoo.so", 4, 10);
+    add_entry(&device, "lib/libfoo.so", 3, 20);
+    add_entry(&device, "classes.dex", 1, 30);
+    add_entry(&device, "classes.dex", 1, 40);
+    add_entry(&device, "res/raw/unused", 2, 50);
+
+    TestPatchGenerator generator;
+    std::vector<DeployPatchGenerator::SimpleEntry> entries;
+    generator.GatherIdenticalEntries(entries, local, device);
+
+    // resources.arsc has no match, and the entries are sorted by local data offset.
+    ASSERT_EQ(2u, entries.size());
+    EXPECT_EQ("classes.dex", entries[0].localEntry->filename());
+    EXPECT_EQ(30, entries[0].deviceEntry->dataoffset());
+    EXPECT_EQ("lib/libfoo.so", entries[1].localEntry->filename());
+    EXPECT_EQ(20, entries[1].deviceEntry->dataoffset());
+}
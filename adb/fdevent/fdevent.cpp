@@ -28,6 +28,7 @@
 #include "fdevent.h"
 #include "fdevent_epoll.h"
 #include "fdevent_poll.h"
+#include "fdevent_uring.h"
 
 using namespace std::chrono_literals;
 using std::chrono::duration_cast;
@@ -188,6 +189,9 @@ void fdevent_context::TerminateLoop() {
 
 static std::unique_ptr<fdevent_context> fdevent_create_context() {
 #if defined(__linux__)
+    if (auto context = fdevent_context_uring::TryCreate()) {
+        return context;
+    }
     return std::make_unique<fdevent_context_epoll>();
 #else
     return std::make_unique<fdevent_context_poll>();
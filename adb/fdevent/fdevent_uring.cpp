@@ -0,0 +1,445 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fdevent_uring.h"
+
+#if defined(__linux__)
+
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <android-base/logging.h>
+#include <android-base/threads.h>
+
+#include "adb_unique_fd.h"
+#include "fdevent.h"
+
+#if !defined(__NR_io_uring_setup)
+// The io_uring syscalls have the same numbers on every architecture adb runs on.
+#define __NR_io_uring_setup 425
+#define __NR_io_uring_enter 426
+#endif
+
+// Room for a loop iteration's worth of requests without an intermediate submit.
+static constexpr unsigned kRingEntries = 256;
+
+// user_data of requests whose completions are of no interest. Poll and
+// timeout ids are allocated from 1.
+static constexpr uint64_t kIgnoredCompletion = 0;
+
+static int io_uring_setup(unsigned entries, io_uring_params* params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static void fdevent_interrupt(int fd, unsigned, void*) {
+    uint64_t buf;
+    ssize_t rc = TEMP_FAILURE_RETRY(adb_read(fd, &buf, sizeof(buf)));
+    if (rc == -1) {
+        PLOG(FATAL) << "failed to read from fdevent interrupt fd";
+    }
+}
+
+std::unique_ptr<fdevent_context> fdevent_context_uring::TryCreate() {
+    const char* env = getenv("ADB_URING");
+    if (env && strcmp(env, "0") == 0) {
+        return nullptr;
+    }
+
+    std::unique_ptr<fdevent_context_uring> context(new fdevent_context_uring());
+    if (!context->Init()) {
+        return nullptr;
+    }
+    return context;
+}
+
+bool fdevent_context_uring::Init() {
+    io_uring_params params = {};
+    ring_fd_.reset(io_uring_setup(kRingEntries, &params));
+    if (ring_fd_ == -1) {
+        PLOG(INFO) << "io_uring unavailable, falling back to epoll";
+        return false;
+    }
+
+    // Single mmap (5.4) for simplicity, and no dropped completions (5.5) so
+    // that a burst of ready fds can't lose a wakeup. Everything used below
+    // arrived by 5.5 as well.
+    constexpr uint32_t kRequiredFeatures = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP;
+    if ((params.features & kRequiredFeatures) != kRequiredFeatures) {
+        LOG(INFO) << "io_uring lacks required features, falling back to epoll";
+        return false;
+    }
+
+    ring_size_ = std::max(params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+                          params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    void* ring = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_.get(), IORING_OFF_SQ_RING);
+    if (ring == MAP_FAILED) {
+        PLOG(INFO) << "failed to map io_uring, falling back to epoll";
+        return false;
+    }
+    ring_ = ring;
+
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_.get(), IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        PLOG(INFO) << "failed to map io_uring entries, falling back to epoll";
+        return false;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    char* base = static_cast<char*>(ring_);
+    sq_head_ = reinterpret_cast<uint32_t*>(base + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<uint32_t*>(base + params.sq_off.tail);
+    sq_array_ = reinterpret_cast<uint32_t*>(base + params.sq_off.array);
+    sq_mask_ = *reinterpret_cast<uint32_t*>(base + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    sq_local_tail_ = *sq_tail_;
+
+    cq_head_ = reinterpret_cast<uint32_t*>(base + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<uint32_t*>(base + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<uint32_t*>(base + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+
+    if (!Probe()) {
+        LOG(INFO) << "io_uring lacks poll or timeout support, falling back to epoll";
+        return false;
+    }
+
+    unique_fd interrupt_fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+    if (interrupt_fd == -1) {
+        PLOG(FATAL) << "failed to create fdevent interrupt eventfd";
+    }
+
+    unique_fd interrupt_fd_dup(fcntl(interrupt_fd.get(), F_DUPFD_CLOEXEC, 3));
+    if (interrupt_fd_dup == -1) {
+        PLOG(FATAL) << "failed to dup fdevent interrupt eventfd";
+    }
+
+    interrupt_fd_ = std::move(interrupt_fd_dup);
+    interrupt_fde_ = this->Create(std::move(interrupt_fd), fdevent_interrupt, nullptr);
+    CHECK(interrupt_fde_ != nullptr);
+    this->Add(interrupt_fde_, FDE_READ);
+    return true;
+}
+
+// Issue one of each request the loop relies on: kernels, or seccomp policies,
+// that don't know an opcode fail it with EINVAL rather than at setup time.
+bool fdevent_context_uring::Probe() {
+    unique_fd probe_fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+    if (probe_fd == -1) {
+        return false;
+    }
+
+    Timespec zero = {};
+    io_uring_sqe* sqe = GetSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = probe_fd.get();
+    sqe->poll_events = POLLOUT;
+
+    sqe = GetSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->addr = UINT64_MAX;
+
+    sqe = GetSqe();
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->addr = reinterpret_cast<uintptr_t>(&zero);
+    sqe->len = 1;
+
+    sqe = GetSqe();
+    sqe->opcode = IORING_OP_TIMEOUT_REMOVE;
+    sqe->addr = UINT64_MAX;
+
+    constexpr size_t kProbes = 4;
+    while (completions_.size() < kProbes) {
+        Submit(1);
+        Reap();
+    }
+
+    bool supported = std::none_of(completions_.begin(), completions_.end(),
+                                  [](const Completion& c) { return c.res == -EINVAL; });
+    completions_.clear();
+    return supported;
+}
+
+fdevent_context_uring::~fdevent_context_uring() {
+    if (interrupt_fde_) {
+        // Destroy calls virtual methods, but this class is final, so that's okay.
+        this->Destroy(interrupt_fde_);
+    }
+
+    // Closing the ring cancels anything still outstanding.
+    if (sqes_) {
+        munmap(sqes_, sqes_size_);
+    }
+    if (ring_) {
+        munmap(ring_, ring_size_);
+    }
+}
+
+io_uring_sqe* fdevent_context_uring::GetSqe() {
+    if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) == sq_entries_) {
+        Submit(0);
+    }
+
+    uint32_t index = sq_local_tail_ & sq_mask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = kIgnoredCompletion;
+    sq_array_[index] = index;
+    ++sq_local_tail_;
+    ++to_submit_;
+    return sqe;
+}
+
+// Submit everything queued and, if min_complete is nonzero, wait for that many
+// completions to become available.
+void fdevent_context_uring::Submit(unsigned min_complete) {
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+
+    bool waited = min_complete == 0;
+    while (to_submit_ > 0 || !waited) {
+        unsigned wait = waited ? 0 : min_complete;
+        int rc = io_uring_enter(ring_fd_.get(), to_submit_, wait, wait ? IORING_ENTER_GETEVENTS : 0);
+        if (rc == -1) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EBUSY) {
+                // Completions are backed up in the kernel; make room for them.
+                Reap();
+                continue;
+            }
+            PLOG(FATAL) << "io_uring_enter failed";
+        }
+        to_submit_ -= rc;
+        waited = true;
+    }
+}
+
+void fdevent_context_uring::Reap() {
+    uint32_t head = *cq_head_;
+    uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        completions_.push_back({cqe.user_data, cqe.res});
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+static unsigned calculate_poll_mask(fdevent* fde) {
+    unsigned result = POLLRDHUP;
+    if (fde->state & FDE_READ) {
+        result |= POLLIN;
+    }
+    if (fde->state & FDE_WRITE) {
+        result |= POLLOUT;
+    }
+    if (fde->state & FDE_ERROR) {
+        result |= POLLERR;
+    }
+    return result;
+}
+
+void fdevent_context_uring::ArmPolls() {
+    for (fdevent* fde : dirty_) {
+        unsigned mask = calculate_poll_mask(fde);
+        if (auto it = armed_.find(fde); it != armed_.end()) {
+            if (it->second.mask == mask) {
+                continue;
+            }
+            CancelPoll(fde);
+        }
+
+        uint64_t id = next_id_++;
+        io_uring_sqe* sqe = GetSqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fde->fd.get();
+        sqe->poll_events = mask;
+        sqe->user_data = id;
+        armed_[fde] = {id, mask};
+        polls_[id] = fde;
+    }
+    dirty_.clear();
+}
+
+void fdevent_context_uring::CancelPoll(fdevent* fde) {
+    auto it = armed_.find(fde);
+    if (it == armed_.end()) {
+        return;
+    }
+
+    // The poll completes with ECANCELED, which is dropped once its id is gone.
+    io_uring_sqe* sqe = GetSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->addr = it->second.id;
+    polls_.erase(it->second.id);
+    armed_.erase(it);
+}
+
+void fdevent_context_uring::Register(fdevent* fde) {
+    dirty_.insert(fde);
+}
+
+void fdevent_context_uring::Unregister(fdevent* fde) {
+    dirty_.erase(fde);
+    if (armed_.count(fde)) {
+        CancelPoll(fde);
+        // Submit right away: the poll holds a reference to the file, which
+        // would otherwise outlive the close by as long as the loop sleeps.
+        Submit(0);
+    }
+}
+
+void fdevent_context_uring::Set(fdevent* fde, unsigned events) {
+    unsigned previous_state = fde->state;
+    fde->state = events;
+
+    // If the state is the same, or only differed by FDE_TIMEOUT, the poll can stay.
+    if ((previous_state & ~FDE_TIMEOUT) == (events & ~FDE_TIMEOUT)) {
+        return;
+    }
+
+    dirty_.insert(fde);
+}
+
+void fdevent_context_uring::Loop() {
+    main_thread_id_ = android::base::GetThreadId();
+
+    std::vector<fdevent_event> fde_events;
+    while (true) {
+        if (terminate_loop_) {
+            break;
+        }
+
+        // Polls are one-shot: everything that fired last time is rearmed here,
+        // along with whatever changed interest, in the same io_uring_enter as
+        // the wait.
+        ArmPolls();
+
+        if (timeout_id_ != 0) {
+            io_uring_sqe* sqe = GetSqe();
+            sqe->opcode = IORING_OP_TIMEOUT_REMOVE;
+            sqe->addr = timeout_id_;
+            timeout_id_ = 0;
+        }
+
+        std::optional<std::chrono::milliseconds> timeout = CalculatePollDuration();
+        if (timeout) {
+            timeout_ts_.tv_sec = timeout->count() / 1000;
+            timeout_ts_.tv_nsec = (timeout->count() % 1000) * 1000000;
+            timeout_id_ = next_id_++;
+            io_uring_sqe* sqe = GetSqe();
+            sqe->opcode = IORING_OP_TIMEOUT;
+            sqe->addr = reinterpret_cast<uintptr_t>(&timeout_ts_);
+            sqe->len = 1;
+            sqe->user_data = timeout_id_;
+        }
+
+        Submit(completions_.empty() ? 1 : 0);
+        Reap();
+
+        auto post_poll = std::chrono::steady_clock::now();
+        std::unordered_map<fdevent*, unsigned> event_map;
+        for (const Completion& completion : completions_) {
+            auto it = polls_.find(completion.user_data);
+            if (it == polls_.end()) {
+                if (completion.user_data == timeout_id_) {
+                    timeout_id_ = 0;
+                }
+                continue;
+            }
+
+            fdevent* fde = it->second;
+            polls_.erase(it);
+            armed_.erase(fde);
+            dirty_.insert(fde);
+
+            unsigned events = 0;
+            if (completion.res < 0) {
+                events |= FDE_READ | FDE_ERROR;
+            } else {
+                if (completion.res & POLLIN) {
+                    CHECK(fde->state & FDE_READ);
+                    events |= FDE_READ;
+                }
+                if (completion.res & POLLOUT) {
+                    CHECK(fde->state & FDE_WRITE);
+                    events |= FDE_WRITE;
+                }
+                if (completion.res & (POLLERR | POLLHUP | POLLRDHUP)) {
+                    // We fake a read, as the rest of the code assumes that errors will
+                    // be detected at that point.
+                    events |= FDE_READ | FDE_ERROR;
+                }
+            }
+            event_map[fde] |= events;
+        }
+        completions_.clear();
+
+        for (const auto& [fd, fde] : installed_fdevents_) {
+            unsigned events = 0;
+            if (auto it = event_map.find(fde); it != event_map.end()) {
+                events = it->second;
+            }
+
+            if (events == 0) {
+                if (fde->timeout) {
+                    auto deadline = fde->last_active + *fde->timeout;
+                    if (deadline < post_poll) {
+                        events |= FDE_TIMEOUT;
+                    }
+                }
+            }
+
+            if (events != 0) {
+                LOG(DEBUG) << dump_fde(fde) << " got events " << std::hex << std::showbase
+                           << events;
+                fde_events.push_back({fde, events});
+                fde->last_active = post_poll;
+            }
+        }
+        this->HandleEvents(std::move(fde_events));
+        fde_events.clear();
+    }
+
+    main_thread_id_.reset();
+}
+
+size_t fdevent_context_uring::InstalledCount() {
+    // We always have an installed fde for interrupt.
+    return this->installed_fdevents_.size() - 1;
+}
+
+void fdevent_context_uring::Interrupt() {
+    uint64_t i = 1;
+    ssize_t rc = TEMP_FAILURE_RETRY(adb_write(this->interrupt_fd_, &i, sizeof(i)));
+    if (rc != sizeof(i)) {
+        PLOG(FATAL) << "failed to write to fdevent interrupt eventfd";
+    }
+}
+
+#endif  // defined(__linux__)
@@ -0,0 +1,120 @@
+#pragma once
+
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if defined(__linux__)
+
+#include "sysdeps.h"
+
+#include <linux/io_uring.h>
+
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "adb_unique_fd.h"
+#include "fdevent.h"
+
+// An fdevent_context that waits for readiness with io_uring poll requests.
+//
+// Each loop iteration queues the poll requests that need (re)arming, any
+// cancellations and the timeout, and hands them to the kernel in the same
+// io_uring_enter that waits for completions. epoll needs a separate epoll_ctl
+// for every change of interest, which adds up when sockets toggle FDE_WRITE
+// as their queues fill and drain.
+struct fdevent_context_uring final : public fdevent_context {
+    // Returns nullptr if the running kernel lacks what this needs, or if
+    // $ADB_URING is 0, in which case the caller should fall back to epoll.
+    static std::unique_ptr<fdevent_context> TryCreate();
+
+    virtual ~fdevent_context_uring();
+
+    virtual void Register(fdevent* fde) final;
+    virtual void Unregister(fdevent* fde) final;
+
+    virtual void Set(fdevent* fde, unsigned events) final;
+
+    virtual void Loop() final;
+    size_t InstalledCount() final;
+
+  protected:
+    virtual void Interrupt() final;
+
+  private:
+    fdevent_context_uring() = default;
+
+    bool Init();
+    bool Probe();
+
+    io_uring_sqe* GetSqe();
+    void Submit(unsigned min_complete);
+    void Reap();
+
+    void ArmPolls();
+    void CancelPoll(fdevent* fde);
+
+    struct Poll {
+        uint64_t id;
+        unsigned mask;
+    };
+
+    struct Completion {
+        uint64_t user_data;
+        int32_t res;
+    };
+
+    // The layout of the kernel's __kernel_timespec, which older uapi headers lack.
+    struct Timespec {
+        int64_t tv_sec;
+        int64_t tv_nsec;
+    };
+
+    unique_fd ring_fd_;
+    void* ring_ = nullptr;
+    size_t ring_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+
+    uint32_t* sq_head_ = nullptr;
+    uint32_t* sq_tail_ = nullptr;
+    uint32_t* sq_array_ = nullptr;
+    uint32_t sq_mask_ = 0;
+    uint32_t sq_entries_ = 0;
+    uint32_t sq_local_tail_ = 0;
+    unsigned to_submit_ = 0;
+
+    uint32_t* cq_head_ = nullptr;
+    uint32_t* cq_tail_ = nullptr;
+    uint32_t cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    std::vector<Completion> completions_;
+
+    // All operations to fdevent happen on the main thread, so none of this
+    // needs a lock.
+    uint64_t next_id_ = 1;
+    std::unordered_map<fdevent*, Poll> armed_;
+    std::unordered_map<uint64_t, fdevent*> polls_;
+    std::unordered_set<fdevent*> dirty_;
+    uint64_t timeout_id_ = 0;
+    Timespec timeout_ts_ = {};
+
+    unique_fd interrupt_fd_;
+    fdevent* interrupt_fde_ = nullptr;
+};
+
+#endif  // defined(__linux__)
@@ -24,6 +24,10 @@
 #define ID_LIST MKID('L', 'I', 'S', 'T')
 #define ID_SEND MKID('S', 'E', 'N', 'D')
 #define ID_RECV MKID('R', 'E', 'C', 'V')
+#define ID_SEND_V2 MKID('S', 'N', 'D', '2')
+#define ID_RECV_V2 MKID('R', 'C', 'V', '2')
+#define ID_HASH MKID('H', 'A', 'S', 'H')
+#define ID_SEEK MKID('S', 'E', 'E', 'K')
 #define ID_DENT MKID('D', 'E', 'N', 'T')
 #define ID_DONE MKID('D', 'O', 'N', 'E')
 #define ID_DATA MKID('D', 'A', 'T', 'A')
@@ -37,6 +41,24 @@ struct SyncRequest {
     // Followed by 'path_length' bytes of path (not NUL-terminated).
 } __attribute__((packed));
 
+// Flags for the _V2 transfers.
+enum SyncFlag : uint32_t {
+    kSyncFlagNone = 0,
+    // The ID_DATA payloads are a single brotli stream, ending at ID_DONE.
+    kSyncFlagBrotli = 1,
+    // Patch the existing file in place: ID_SEEK packets, whose 8 byte payload
+    // is an offset, move the write position and ID_DATA packets are written
+    // at it. The file is cut at the final position when ID_DONE arrives.
+    // Not combined with kSyncFlagBrotli.
+    kSyncFlagDelta = 2,
+};
+
+// Block sizes an ID_HASH request may ask for.
+#define SYNC_HASH_BLOCK_MIN (4 * 1024)
+#define SYNC_HASH_BLOCK_MAX (1024 * 1024)
+#define SYNC_HASH_MAX_BLOCKS 65536
+#define SYNC_HASH_DIGEST_LENGTH 32
+
 union syncmsg {
     struct __attribute__((packed)) {
         uint32_t id;
@@ -73,6 +95,31 @@ union syncmsg {
         uint32_t id;
         uint32_t msglen;
     } status;
+    // Follows the path of an ID_SEND_V2 request, which has no ",mode" suffix.
+    struct __attribute__((packed)) {
+        uint32_t id;  // ID_SEND_V2
+        uint32_t mode;
+        uint32_t flags;
+    } send_v2_setup;
+    // Follows the path of an ID_RECV_V2 request.
+    struct __attribute__((packed)) {
+        uint32_t id;  // ID_RECV_V2
+        uint32_t flags;
+    } recv_v2_setup;
+    // Follows the path of an ID_HASH request.
+    struct __attribute__((packed)) {
+        uint32_t id;  // ID_HASH
+        uint32_t block_size;
+    } hash_setup;
+    // The reply to ID_HASH, followed by 'count' SHA-256 digests of the
+    // consecutive blocks of the file, the last of which may be short.
+    struct __attribute__((packed)) {
+        uint32_t id;  // ID_HASH
+        uint32_t error;
+        uint64_t size;
+        uint32_t block_size;
+        uint32_t count;
+    } hash;
 };
 
 #define SYNC_DATA_MAX (64 * 1024)
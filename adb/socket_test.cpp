@@ -121,8 +121,7 @@ static void CreateCloser(CloseWithPacketArg* arg) {
         // each write to give the underlying implementation time to flush.
         bool socket_filled = false;
         for (int i = 0; i < 128; ++i) {
-            apacket::payload_type data;
-            data.resize(MAX_PAYLOAD);
+            apacket::payload_type data{Block(MAX_PAYLOAD)};
             arg->bytes_written += data.size();
             int ret = s->enqueue(s, std::move(data));
             if (ret == 1) {
@@ -125,8 +125,7 @@ static SocketFlushResult local_socket_flush_incoming(asocket* s) {
         if (rc > 0 && static_cast<size_t>(rc) == s->packet_queue.size()) {
             s->packet_queue.clear();
         } else if (rc > 0) {
-            // TODO: Implement a faster drop_front?
-            s->packet_queue.take_front(rc);
+            s->packet_queue.drop_front(rc);
             fdevent_add(s->fde, FDE_WRITE);
             return SocketFlushResult::TryAgain;
         } else if (rc == -1 && errno == EAGAIN) {
@@ -152,9 +151,8 @@ static SocketFlushResult local_socket_flush_incoming(asocket* s) {
 // Returns false if the socket has been closed and destroyed as a side-effect of this function.
 static bool local_socket_flush_outgoing(asocket* s) {
     const size_t max_payload = s->get_max_payload();
-    apacket::payload_type data;
-    data.resize(max_payload);
-    char* x = &data[0];
+    Block data(max_payload);
+    char* x = data.data();
     size_t avail = max_payload;
     int r = 0;
     int is_eof = 0;
@@ -187,7 +185,7 @@ static bool local_socket_flush_outgoing(asocket* s) {
         // so save variables for debug printing below.
         unsigned saved_id = s->id;
         int saved_fd = s->fd;
-        r = s->peer->enqueue(s->peer, std::move(data));
+        r = s->peer->enqueue(s->peer, apacket::payload_type(std::move(data)));
         D("LS(%u): fd=%d post peer->enqueue(). r=%d", saved_id, saved_fd, r);
 
         if (r < 0) {
@@ -511,9 +509,10 @@ void connect_to_remote(asocket* s, std::string_view destination) {
 
     // adbd used to expect a null-terminated string.
     // Keep doing so to maintain backward compatibility.
-    p->payload.resize(destination.size() + 1);
-    memcpy(p->payload.data(), destination.data(), destination.size());
-    p->payload[destination.size()] = '\0';
+    Block payload(destination.size() + 1);
+    memcpy(payload.data(), destination.data(), destination.size());
+    payload[destination.size()] = '\0';
+    p->payload.append(std::move(payload));
     p->msg.data_length = p->payload.size();
 
     CHECK_LE(p->msg.data_length, s->get_max_payload());
@@ -726,12 +725,7 @@ static int smart_socket_enqueue(asocket* s, apacket::payload_type data) {
 
     D("SS(%d): enqueue %zu", s->id, data.size());
 
-    if (s->smart_socket_data.empty()) {
-        // TODO: Make this an IOVector?
-        s->smart_socket_data.assign(data.begin(), data.end());
-    } else {
-        std::copy(data.begin(), data.end(), std::back_inserter(s->smart_socket_data));
-    }
+    data.iterate_blocks([s](const char* buf, size_t len) { s->smart_socket_data.append(buf, len); });
 
     /* don't bother if we can't decode the length */
     if (s->smart_socket_data.size() < 4) {
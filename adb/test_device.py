@@ -771,6 +771,47 @@ class FileOperationsTest(DeviceTest):
             if host_dir is not None:
                 shutil.rmtree(host_dir)
 
+    def test_push_pull_dir_pipelined(self):
+        """Push and pull a directory of small files with $ADB_SYNC_PIPELINE."""
+        self.device.shell(['rm', '-rf', self.DEVICE_TEMP_DIR])
+        self.device.shell(['mkdir', self.DEVICE_TEMP_DIR])
+
+        old_pipeline = os.environ.get('ADB_SYNC_PIPELINE')
+        os.environ['ADB_SYNC_PIPELINE'] = '16'
+        host_dir = None
+        pull_dir = None
+        try:
+            host_dir = tempfile.mkdtemp()
+            pull_dir = tempfile.mkdtemp()
+
+            # Make sure the temp directory isn't setuid, or else adb will complain.
+            os.chmod(host_dir, 0o700)
+
+            temp_files = make_random_host_files(in_dir=host_dir, num_files=128)
+            self.device.push(host_dir, self.DEVICE_TEMP_DIR)
+
+            remote_dir = posixpath.join(self.DEVICE_TEMP_DIR,
+                                        os.path.basename(host_dir))
+            for temp_file in temp_files:
+                self._verify_remote(temp_file.checksum,
+                                    posixpath.join(remote_dir, temp_file.base_name))
+
+            self.device.pull(remote=remote_dir, local=pull_dir)
+            for temp_file in temp_files:
+                self._verify_local(temp_file.checksum,
+                                   os.path.join(pull_dir, os.path.basename(host_dir),
+                                                temp_file.base_name))
+            self.device.shell(['rm', '-rf', self.DEVICE_TEMP_DIR])
+        finally:
+            if old_pipeline is None:
+                del os.environ['ADB_SYNC_PIPELINE']
+            else:
+                os.environ['ADB_SYNC_PIPELINE'] = old_pipeline
+            if host_dir is not None:
+                shutil.rmtree(host_dir)
+            if pull_dir is not None:
+                shutil.rmtree(pull_dir)
+
     def disabled_test_push_empty(self):
         """Push an empty directory to the device."""
         self.device.shell(['rm', '-rf', self.DEVICE_TEMP_DIR])
@@ -1206,6 +1247,35 @@ class FileOperationsTest(DeviceTest):
             if temp_dir is not None:
                 shutil.rmtree(temp_dir)
 
+    def test_push_sync_delta(self):
+        """Patch a large file on the device with push --sync.
+
+        Devices without delta_sync get the whole file, which must work too.
+        """
+        host_dir = tempfile.mkdtemp()
+        try:
+            host_path = os.path.join(host_dir, 'big')
+            contents = bytearray(os.urandom(4 * 1024 * 1024))
+            with open(host_path, 'wb') as f:
+                f.write(contents)
+            self.device.shell(['rm', '-f', self.DEVICE_TEMP_FILE])
+            self.device.push(local=host_path, remote=self.DEVICE_TEMP_FILE)
+
+            # Change a few bytes in the middle, shorten the file, and make the
+            # host copy newer.
+            contents[1234567:1234571] = b'adb!'
+            del contents[-12345:]
+            with open(host_path, 'wb') as f:
+                f.write(contents)
+            mtime = os.stat(host_path).st_mtime + 10
+            os.utime(host_path, (mtime, mtime))
+
+            self.device.push(local=host_path, remote=self.DEVICE_TEMP_FILE, sync=True)
+            self._verify_remote(compute_md5(bytes(contents)), self.DEVICE_TEMP_FILE)
+            self.device.shell(['rm', '-f', self.DEVICE_TEMP_FILE])
+        finally:
+            shutil.rmtree(host_dir)
+
     def test_unicode_paths(self):
         """Ensure that we can support non-ASCII paths, even on Windows."""
         name = u'로보카 폴리'
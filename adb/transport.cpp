@@ -74,6 +74,11 @@ const char* const kFeatureAbb = "abb";
 const char* const kFeatureFixedPushSymlinkTimestamp = "fixed_push_symlink_timestamp";
 const char* const kFeatureAbbExec = "abb_exec";
 const char* const kFeatureRemountShell = "remount_shell";
+const char* const kFeatureSendRecv2 = "sendrecv_v2";
+const char* const kFeatureSendRecv2Brotli = "sendrecv_v2_brotli";
+const char* const kFeatureDeltaSync = "delta_sync";
+const char* const kFeatureFramebufferBrotli = "framebuffer_brotli";
+const char* const kFeatureTrackJdwpDelta = "track_jdwp_delta";
 
 namespace {
 
@@ -398,27 +403,33 @@ bool FdConnection::Read(apacket* packet) {
         return false;
     }
 
-    packet->payload.resize(packet->msg.data_length);
-
-    if (!ReadFdExactly(fd_.get(), &packet->payload[0], packet->payload.size())) {
+    Block payload(packet->msg.data_length);
+    if (!ReadFdExactly(fd_.get(), payload.data(), payload.size())) {
         D("remote local: terminated (data)");
         return false;
     }
+    packet->payload.append(std::move(payload));
 
     return true;
 }
 
 bool FdConnection::Write(apacket* packet) {
-    if (!WriteFdExactly(fd_.get(), &packet->msg, sizeof(packet->msg))) {
-        D("remote local: write terminated");
-        return false;
-    }
-
-    if (packet->msg.data_length) {
-        if (!WriteFdExactly(fd_.get(), &packet->payload[0], packet->msg.data_length)) {
+    // Gather the header and every block of the payload into one writev.
+    const char* header = reinterpret_cast<const char*>(&packet->msg);
+    IOVector data(Block(header, header + sizeof(packet->msg)));
+    data.append(std::move(packet->payload));
+
+    while (!data.empty()) {
+        std::vector<adb_iovec> iovs = data.iovecs();
+        ssize_t rc = adb_writev(fd_.get(), iovs.data(), iovs.size());
+        if (rc == -1 && errno == EAGAIN) {
+            std::this_thread::yield();
+            continue;
+        } else if (rc <= 0) {
             D("remote local: write terminated");
             return false;
         }
+        data.drop_front(rc);
     }
 
     return true;
@@ -527,13 +538,12 @@ static int device_tracker_enqueue(asocket* socket, apacket::payload_type) {
 static int device_tracker_send(device_tracker* tracker, const std::string& string) {
     asocket* peer = tracker->socket.peer;
 
-    apacket::payload_type data;
-    data.resize(4 + string.size());
+    Block data(4 + string.size());
     char buf[5];
     snprintf(buf, sizeof(buf), "%04x", static_cast<int>(string.size()));
     memcpy(&data[0], buf, 4);
     memcpy(&data[4], string.data(), string.size());
-    return peer->enqueue(peer, std::move(data));
+    return peer->enqueue(peer, apacket::payload_type(std::move(data)));
 }
 
 static void device_tracker_ready(asocket* socket) {
@@ -1051,6 +1061,11 @@ const FeatureSet& supported_features() {
             kFeatureFixedPushSymlinkTimestamp,
             kFeatureAbbExec,
             kFeatureRemountShell,
+            kFeatureSendRecv2,
+            kFeatureSendRecv2Brotli,
+            kFeatureDeltaSync,
+            kFeatureFramebufferBrotli,
+            kFeatureTrackJdwpDelta,
             // Increment ADB_SERVER_VERSION when adding a feature that adbd needs
             // to know about. Otherwise, the client can be stuck running an old
             // version of the server even after upgrading their copy of adb.
@@ -72,6 +72,16 @@ extern const char* const kFeatureAbbExec;
 // adbd properly updates symlink timestamps on push.
 extern const char* const kFeatureFixedPushSymlinkTimestamp;
 extern const char* const kFeatureRemountShell;
+// adbd supports ID_SEND_V2/ID_RECV_V2.
+extern const char* const kFeatureSendRecv2;
+// adbd supports brotli compressed ID_SEND_V2/ID_RECV_V2 transfers.
+extern const char* const kFeatureSendRecv2Brotli;
+// adbd supports ID_HASH and delta ID_SEND_V2 transfers.
+extern const char* const kFeatureDeltaSync;
+// adbd supports the brotli and delta options of framebuffer:.
+extern const char* const kFeatureFramebufferBrotli;
+// adbd supports track-jdwp-delta.
+extern const char* const kFeatureTrackJdwpDelta;
 
 TransportId NextTransportId();
 
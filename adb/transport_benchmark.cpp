@@ -16,6 +16,14 @@
 
 #include <malloc.h>
 #include <stdio.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include <android-base/logging.h>
 #include <benchmark/benchmark.h>
@@ -51,6 +59,12 @@ std::unique_ptr<Connection> MakeConnection<NonblockingFdConnection>(unique_fd fd
     return Connection::FromFd(std::move(fd));
 }
 
+static apacket::payload_type MakePayload(size_t size) {
+    Block block(size);
+    memset(block.data(), 0xff, block.size());
+    return apacket::payload_type(std::move(block));
+}
+
 template <typename ConnectionType>
 void BM_Connection_Unidirectional(benchmark::State& state) {
     int fds[2];
@@ -83,9 +97,7 @@ void BM_Connection_Unidirectional(benchmark::State& state) {
         memset(&packet->msg, 0, sizeof(packet->msg));
         packet->msg.command = A_WRTE;
         packet->msg.data_length = data_size;
-        packet->payload.resize(data_size);
-
-        memset(&packet->payload[0], 0xff, data_size);
+        packet->payload = MakePayload(data_size);
 
         received_bytes = 0;
         client->Write(std::move(packet));
@@ -157,9 +169,7 @@ void BM_Connection_Echo(benchmark::State& state) {
         memset(&packet->msg, 0, sizeof(packet->msg));
         packet->msg.command = A_WRTE;
         packet->msg.data_length = data_size;
-        packet->payload.resize(data_size);
-
-        memset(&packet->payload[0], 0xff, data_size);
+        packet->payload = MakePayload(data_size);
 
         received_bytes = 0;
         client->Write(std::move(packet));
@@ -182,6 +192,279 @@ void BM_Connection_Echo(benchmark::State& state) {
 ADB_CONNECTION_BENCHMARK(BM_Connection_Echo, ThreadPolicy::SameThread);
 ADB_CONNECTION_BENCHMARK(BM_Connection_Echo, ThreadPolicy::MainThread);
 
+static std::unique_ptr<apacket> MakePacket(size_t size, uint32_t local_id = 0) {
+    std::unique_ptr<apacket> packet = std::make_unique<apacket>();
+    memset(&packet->msg, 0, sizeof(packet->msg));
+    packet->msg.command = A_WRTE;
+    packet->msg.arg0 = local_id;
+    packet->msg.data_length = size;
+    packet->payload = MakePayload(size);
+    return packet;
+}
+
+// Counts what a connection delivers, for threads that wait on it without spinning, so that the
+// CPU the process uses is the connections' own.
+struct ByteCounter {
+    void Add(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        total += bytes;
+        cv.notify_all();
+    }
+
+    void WaitFor(uint64_t target) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this, target]() { return total >= target; });
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint64_t total = 0;
+};
+
+// CPU used by every thread in the process. The library's CPU time only covers the benchmark
+// thread, which spends most of its time waiting on the connections' threads.
+static double ProcessCpuSeconds() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void ReportCpuPerMegabyte(benchmark::State& state, double cpu_seconds, uint64_t bytes) {
+    state.counters["cpu_ms_per_MB"] = bytes ? cpu_seconds * 1e3 / (bytes / 1e6) : 0;
+}
+
+template <typename ConnectionType>
+struct ConnectionPair {
+    ConnectionPair() {
+        int fds[2];
+        if (adb_socketpair(fds) != 0) {
+            LOG(FATAL) << "failed to create socketpair";
+        }
+        client = MakeConnection<ConnectionType>(unique_fd(fds[0]));
+        server = MakeConnection<ConnectionType>(unique_fd(fds[1]));
+        client->SetErrorCallback(
+            [](Connection*, const std::string& error) { LOG(INFO) << "client closed: " << error; });
+        server->SetErrorCallback(
+            [](Connection*, const std::string& error) { LOG(INFO) << "server closed: " << error; });
+    }
+
+    void Start() {
+        client->Start();
+        server->Start();
+    }
+
+    ~ConnectionPair() {
+        client->Stop();
+        server->Stop();
+    }
+
+    std::unique_ptr<Connection> client;
+    std::unique_ptr<Connection> server;
+};
+
+// A traffic mix: range(0) of every 64 packets carry a shell_v2 sized line of output, the rest are
+// the MAX_PAYLOAD chunks of a bulk transfer such as push or pull.
+template <typename ConnectionType>
+void BM_Connection_Mixed(benchmark::State& state) {
+    static constexpr size_t kSmallPacketSize = 80;
+    static constexpr size_t kBatch = 64;
+
+    ByteCounter received;
+    ConnectionPair<ConnectionType> pair;
+    pair.client->SetReadCallback([](Connection*, std::unique_ptr<apacket>) { return true; });
+    pair.server->SetReadCallback([&received](Connection*, std::unique_ptr<apacket> packet) {
+        received.Add(packet->payload.size());
+        return true;
+    });
+    pair.Start();
+
+    size_t small_packets = state.range(0);
+    uint64_t sent = 0;
+    double cpu_start = ProcessCpuSeconds();
+    for (auto _ : state) {
+        for (size_t i = 0; i < kBatch; ++i) {
+            // Spread the small packets evenly through the batch.
+            bool small = (i * small_packets) % kBatch < small_packets;
+            size_t size = small ? kSmallPacketSize : MAX_PAYLOAD;
+            pair.client->Write(MakePacket(size));
+            sent += size;
+        }
+        received.WaitFor(sent);
+    }
+    ReportCpuPerMegabyte(state, ProcessCpuSeconds() - cpu_start, sent);
+    state.SetBytesProcessed(sent);
+}
+
+#define ADB_MIXED_BENCHMARK(connection_type)                  \
+    BENCHMARK_TEMPLATE(BM_Connection_Mixed, connection_type) \
+        ->Arg(0)                                             \
+        ->Arg(8)                                             \
+        ->Arg(32)                                            \
+        ->Arg(56)                                            \
+        ->Arg(64)                                            \
+        ->UseRealTime()
+
+ADB_MIXED_BENCHMARK(FdConnection);
+ADB_MIXED_BENCHMARK(NonblockingFdConnection);
+
+// Round trip time of a small shell_v2 packet while range(0) other streams keep the connection
+// busy with MAX_PAYLOAD writes, which is what an interactive shell sees next to a pull.
+template <typename ConnectionType>
+void BM_Connection_StreamLatency(benchmark::State& state) {
+    static constexpr uint32_t kShellId = 1;
+    static constexpr size_t kShellPacketSize = 32;
+
+    ByteCounter echoed;
+    ByteCounter bulk_received;
+    ConnectionPair<ConnectionType> pair;
+    pair.client->SetReadCallback([&echoed](Connection*, std::unique_ptr<apacket> packet) {
+        echoed.Add(packet->payload.size());
+        return true;
+    });
+    pair.server->SetReadCallback(
+        [&bulk_received](Connection* connection, std::unique_ptr<apacket> packet) {
+            if (packet->msg.arg0 == kShellId) {
+                connection->Write(std::move(packet));
+            } else {
+                bulk_received.Add(packet->payload.size());
+            }
+            return true;
+        });
+    pair.Start();
+
+    // The bulk streams keep a couple of packets each queued, the way sync does.
+    std::atomic<bool> done(false);
+    std::atomic<uint64_t> bulk_sent(0);
+    const uint64_t window = 2 * MAX_PAYLOAD * state.range(0);
+    std::vector<std::thread> bulk_streams;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        bulk_streams.emplace_back([&, id = kShellId + 1 + i]() {
+            while (!done) {
+                pair.client->Write(MakePacket(MAX_PAYLOAD, id));
+                bulk_sent += MAX_PAYLOAD;
+                std::unique_lock<std::mutex> lock(bulk_received.mutex);
+                bulk_received.cv.wait(lock, [&]() {
+                    return done || bulk_received.total + window >= bulk_sent;
+                });
+            }
+        });
+    }
+
+    std::vector<double> latencies;
+    uint64_t expected = 0;
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        pair.client->Write(MakePacket(kShellPacketSize, kShellId));
+        expected += kShellPacketSize;
+        echoed.WaitFor(expected);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        state.SetIterationTime(elapsed.count());
+        latencies.push_back(elapsed.count());
+    }
+
+    done = true;
+    bulk_received.Add(0);
+    for (std::thread& thread : bulk_streams) {
+        thread.join();
+    }
+
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        state.counters["p50_us"] = latencies[latencies.size() / 2] * 1e6;
+        state.counters["p99_us"] = latencies[latencies.size() * 99 / 100] * 1e6;
+    }
+}
+
+#define ADB_LATENCY_BENCHMARK(connection_type)                        \
+    BENCHMARK_TEMPLATE(BM_Connection_StreamLatency, connection_type) \
+        ->Arg(0)                                                     \
+        ->Arg(1)                                                     \
+        ->Arg(4)                                                     \
+        ->UseManualTime()
+
+ADB_LATENCY_BENCHMARK(FdConnection);
+ADB_LATENCY_BENCHMARK(NonblockingFdConnection);
+
+// range(0) forwarded sockets writing 16KiB packets at once, as a port forward to a busy device
+// service would.
+template <typename ConnectionType>
+void BM_Connection_ConcurrentStreams(benchmark::State& state) {
+    static constexpr size_t kPacketSize = 16384;
+    static constexpr size_t kPacketsPerStream = 64;
+
+    ByteCounter received;
+    ConnectionPair<ConnectionType> pair;
+    pair.client->SetReadCallback([](Connection*, std::unique_ptr<apacket>) { return true; });
+    pair.server->SetReadCallback([&received](Connection*, std::unique_ptr<apacket> packet) {
+        received.Add(packet->payload.size());
+        return true;
+    });
+    pair.Start();
+
+    size_t streams = state.range(0);
+    uint64_t sent = 0;
+    double cpu_start = ProcessCpuSeconds();
+    for (auto _ : state) {
+        std::vector<std::thread> writers;
+        for (size_t i = 0; i < streams; ++i) {
+            writers.emplace_back([&pair, id = i + 1]() {
+                for (size_t n = 0; n < kPacketsPerStream; ++n) {
+                    pair.client->Write(MakePacket(kPacketSize, id));
+                }
+            });
+        }
+        for (std::thread& writer : writers) {
+            writer.join();
+        }
+        sent += streams * kPacketsPerStream * kPacketSize;
+        received.WaitFor(sent);
+    }
+    ReportCpuPerMegabyte(state, ProcessCpuSeconds() - cpu_start, sent);
+    state.SetBytesProcessed(sent);
+}
+
+#define ADB_STREAMS_BENCHMARK(connection_type)                             \
+    BENCHMARK_TEMPLATE(BM_Connection_ConcurrentStreams, connection_type) \
+        ->Arg(1)                                                         \
+        ->Arg(4)                                                         \
+        ->Arg(16)                                                        \
+        ->UseRealTime()
+
+ADB_STREAMS_BENCHMARK(FdConnection);
+ADB_STREAMS_BENCHMARK(NonblockingFdConnection);
+
+// A MAX_PAYLOAD packet arriving in reads of range(0) bytes, as the fd and USB
+// connections see it, handed on as a chain of blocks...
+void BM_IOVector_TakeFront(benchmark::State& state) {
+    size_t read_size = state.range(0);
+    for (auto _ : state) {
+        IOVector read_buffer;
+        for (size_t n = 0; n < MAX_PAYLOAD; n += read_size) {
+            read_buffer.append(Block(std::min(read_size, MAX_PAYLOAD - n)));
+        }
+        IOVector payload = read_buffer.take_front(MAX_PAYLOAD);
+        benchmark::DoNotOptimize(payload.iovecs());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * MAX_PAYLOAD);
+}
+
+// ...or copied into a contiguous block first.
+void BM_IOVector_Coalesce(benchmark::State& state) {
+    size_t read_size = state.range(0);
+    for (auto _ : state) {
+        IOVector read_buffer;
+        for (size_t n = 0; n < MAX_PAYLOAD; n += read_size) {
+            read_buffer.append(Block(std::min(read_size, MAX_PAYLOAD - n)));
+        }
+        Block payload = read_buffer.take_front(MAX_PAYLOAD).coalesce();
+        benchmark::DoNotOptimize(payload.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * MAX_PAYLOAD);
+}
+
+BENCHMARK(BM_IOVector_TakeFront)->Arg(16384)->Arg(65536)->Arg(MAX_PAYLOAD);
+BENCHMARK(BM_IOVector_Coalesce)->Arg(16384)->Arg(65536)->Arg(MAX_PAYLOAD);
+
 int main(int argc, char** argv) {
     // Set M_DECAY_TIME so that our allocations aren't immediately purged on free.
     mallopt(M_DECAY_TIME, 1);
@@ -103,6 +103,12 @@ struct NonblockingFdConnection : public Connection {
                         return;
                     }
                     block->resize(rc);
+                    if (static_cast<size_t>(rc) < MAX_PAYLOAD / 16) {
+                        // Payloads now reference the blocks they were read into, so don't let a
+                        // short read pin a MAX_PAYLOAD allocation while its packet is queued.
+                        block = std::make_unique<IOVector::block_type>(block->begin(),
+                                                                       block->end());
+                    }
                     read_buffer_.append(std::move(block));
 
                     if (!read_header_ && read_buffer_.size() >= sizeof(amessage)) {
@@ -113,13 +119,9 @@ struct NonblockingFdConnection : public Connection {
                     }
 
                     if (read_header_ && read_buffer_.size() >= read_header_->data_length) {
-                        auto data_chain = read_buffer_.take_front(read_header_->data_length);
-
-                        // TODO: Make apacket carry around a IOVector instead of coalescing.
-                        auto payload = data_chain.coalesce<apacket::payload_type>();
                         auto packet = std::make_unique<apacket>();
                         packet->msg = *read_header_;
-                        packet->payload = std::move(payload);
+                        packet->payload = read_buffer_.take_front(read_header_->data_length);
                         read_header_ = nullptr;
                         read_callback_(this, std::move(packet));
                     }
@@ -184,8 +186,7 @@ struct NonblockingFdConnection : public Connection {
             return WriteResult::Error;
         }
 
-        // TODO: Implement a more efficient drop_front?
-        write_buffer_.take_front(rc);
+        write_buffer_.drop_front(rc);
         writable_ = write_buffer_.empty();
         if (write_buffer_.empty()) {
             return WriteResult::Completed;
@@ -201,9 +202,7 @@ struct NonblockingFdConnection : public Connection {
         const char* header_end = header_begin + sizeof(packet->msg);
         auto header_block = std::make_unique<IOVector::block_type>(header_begin, header_end);
         write_buffer_.append(std::move(header_block));
-        if (!packet->payload.empty()) {
-            write_buffer_.append(std::make_unique<IOVector::block_type>(std::move(packet->payload)));
-        }
+        write_buffer_.append(std::move(packet->payload));
 
         WriteResult result = DispatchWrites();
         if (result == WriteResult::TryAgain) {
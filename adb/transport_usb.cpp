@@ -79,17 +79,23 @@ static int UsbReadPayload(usb_handle* h, apacket* p) {
         len += usb_packet_size - rem_size;
     }
 
-    p->payload.resize(len);
-    int rc = usb_read(h, &p->payload[0], p->payload.size());
+    Block payload(len);
+    int rc = usb_read(h, payload.data(), payload.size());
     if (rc != static_cast<int>(p->msg.data_length)) {
         return -1;
     }
 
-    p->payload.resize(rc);
+    payload.resize(rc);
+    p->payload.append(std::move(payload));
     return rc;
 #else
-    p->payload.resize(p->msg.data_length);
-    return usb_read(h, &p->payload[0], p->payload.size());
+    Block payload(p->msg.data_length);
+    int rc = usb_read(h, payload.data(), payload.size());
+    if (rc > 0) {
+        payload.resize(rc);
+        p->payload.append(std::move(payload));
+    }
+    return rc;
 #endif
 }
 
@@ -134,12 +140,12 @@ static int remote_read(apacket* p, usb_handle* usb) {
             return -1;
         }
 
-        p->payload.resize(p->msg.data_length);
-        if (usb_read(usb, &p->payload[0], p->payload.size())
-                != static_cast<int>(p->payload.size())) {
+        Block payload(p->msg.data_length);
+        if (usb_read(usb, payload.data(), payload.size()) != static_cast<int>(payload.size())) {
             PLOG(ERROR) << "remote usb: terminated (data)";
             return -1;
         }
+        p->payload.append(std::move(payload));
     }
 
     return 0;
@@ -163,7 +169,12 @@ bool UsbConnection::Write(apacket* packet) {
         return false;
     }
 
-    if (packet->msg.data_length != 0 && usb_write(handle_, packet->payload.data(), size) != size) {
+    // A payload is a single block unless it was reassembled from several reads, so this
+    // rarely has to copy.
+    if (packet->msg.data_length != 0 &&
+        !packet->payload.coalesced([this, size](const char* data, size_t length) {
+            return usb_write(handle_, data, length) == size;
+        })) {
         PLOG(ERROR) << "remote usb: 2 - write terminated";
         return false;
     }
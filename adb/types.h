@@ -133,12 +133,6 @@ struct amessage {
     uint32_t magic;       /* command ^ 0xffffffff             */
 };
 
-struct apacket {
-    using payload_type = Block;
-    amessage msg;
-    payload_type payload;
-};
-
 struct IOVector {
     using value_type = char;
     using block_type = Block;
@@ -150,6 +144,8 @@ struct IOVector {
         append(std::move(block));
     }
 
+    explicit IOVector(block_type&& block) { append(std::move(block)); }
+
     IOVector(const IOVector& copy) = delete;
     IOVector(IOVector&& move) noexcept : IOVector() { *this = std::move(move); }
 
@@ -157,138 +153,119 @@ struct IOVector {
     IOVector& operator=(IOVector&& move) noexcept {
         chain_ = std::move(move.chain_);
         chain_length_ = move.chain_length_;
-        begin_offset_ = move.begin_offset_;
-        end_offset_ = move.end_offset_;
 
         move.chain_.clear();
         move.chain_length_ = 0;
-        move.begin_offset_ = 0;
-        move.end_offset_ = 0;
 
         return *this;
     }
 
-    size_type size() const { return chain_length_ - begin_offset_ - end_offset_; }
+    size_type size() const { return chain_length_; }
     bool empty() const { return size() == 0; }
 
     void clear() {
         chain_length_ = 0;
-        begin_offset_ = 0;
-        end_offset_ = 0;
         chain_.clear();
     }
 
     // Split the first |len| bytes out of this chain into its own.
+    // Blocks straddling the split are shared between both chains, not copied.
     IOVector take_front(size_type len) {
         IOVector head;
-
-        if (len == 0) {
-            return head;
-        }
         CHECK_GE(size(), len);
 
-        std::shared_ptr<const block_type> first_block = chain_.front();
-        CHECK_GE(first_block->size(), begin_offset_);
-        head.append_shared(std::move(first_block));
-        head.begin_offset_ = begin_offset_;
+        while (len > 0) {
+            Range& front = chain_.front();
+            if (front.length <= len) {
+                len -= front.length;
+                chain_length_ -= front.length;
+                head.chain_length_ += front.length;
+                head.chain_.emplace_back(std::move(front));
+                chain_.pop_front();
+            } else {
+                head.chain_length_ += len;
+                head.chain_.push_back({front.block, front.offset, len});
+                front.offset += len;
+                front.length -= len;
+                chain_length_ -= len;
+                len = 0;
+            }
+        }
 
-        while (head.size() < len) {
-            pop_front_block();
-            CHECK(!chain_.empty());
+        return head;
+    }
 
-            head.append_shared(chain_.front());
-        }
+    // Discard the first |len| bytes of this chain.
+    void drop_front(size_type len) {
+        CHECK_GE(size(), len);
 
-        if (head.size() == len) {
-            // Head takes full ownership of the last block it took.
-            head.end_offset_ = 0;
-            begin_offset_ = 0;
-            pop_front_block();
-        } else {
-            // Head takes partial ownership of the last block it took.
-            size_t bytes_taken = head.size() - len;
-            head.end_offset_ = bytes_taken;
-            CHECK_GE(chain_.front()->size(), bytes_taken);
-            begin_offset_ = chain_.front()->size() - bytes_taken;
+        while (len > 0) {
+            Range& front = chain_.front();
+            if (front.length <= len) {
+                len -= front.length;
+                chain_length_ -= front.length;
+                chain_.pop_front();
+            } else {
+                front.offset += len;
+                front.length -= len;
+                chain_length_ -= len;
+                len = 0;
+            }
         }
-
-        return head;
     }
 
-    // Add a nonempty block to the chain.
-    // The end of the chain must be a complete block (i.e. end_offset_ == 0).
+    // Add a block to the end of the chain. Empty blocks are dropped.
     void append(std::unique_ptr<const block_type> block) {
         if (block->size() == 0) {
             return;
         }
 
-        CHECK_EQ(0ULL, end_offset_);
-        chain_length_ += block->size();
-        chain_.emplace_back(std::move(block));
+        size_t length = block->size();
+        chain_length_ += length;
+        chain_.push_back({std::move(block), 0, length});
     }
 
     void append(block_type&& block) { append(std::make_unique<block_type>(std::move(block))); }
 
-    void trim_front() {
-        if (begin_offset_ == 0) {
+    // Move all of the blocks of another chain onto the end of this one.
+    void append(IOVector&& chain) {
+        if (empty()) {
+            *this = std::move(chain);
             return;
         }
 
-        const block_type* first_block = chain_.front().get();
-        auto copy = std::make_unique<block_type>(first_block->size() - begin_offset_);
-        memcpy(copy->data(), first_block->data() + begin_offset_, copy->size());
-        chain_.front() = std::move(copy);
-
-        chain_length_ -= begin_offset_;
-        begin_offset_ = 0;
+        for (Range& range : chain.chain_) {
+            chain_.emplace_back(std::move(range));
+        }
+        chain_length_ += chain.chain_length_;
+        chain.clear();
     }
 
-  private:
-    // append, except takes a shared_ptr.
-    // Private to prevent exterior mutation of blocks.
-    void append_shared(std::shared_ptr<const block_type> block) {
-        CHECK_NE(0ULL, block->size());
-        CHECK_EQ(0ULL, end_offset_);
-        chain_length_ += block->size();
-        chain_.emplace_back(std::move(block));
-    }
+    // Replace the first block with a copy of the part of it that's in use, so
+    // that the remainder of the original can be freed.
+    void trim_front() {
+        if (chain_.empty()) {
+            return;
+        }
 
-    // Drop the front block from the chain, and update chain_length_ appropriately.
-    void pop_front_block() {
-        chain_length_ -= chain_.front()->size();
-        begin_offset_ = 0;
-        chain_.pop_front();
+        Range& front = chain_.front();
+        if (front.offset == 0 && front.length == front.block->size()) {
+            return;
+        }
+
+        auto copy = std::make_unique<block_type>(front.data(), front.data() + front.length);
+        front.block = std::move(copy);
+        front.offset = 0;
     }
 
     // Iterate over the blocks with a callback with an operator()(const char*, size_t).
     template <typename Fn>
     void iterate_blocks(Fn&& callback) const {
-        if (chain_.size() == 0) {
-            return;
-        }
-
-        for (size_t i = 0; i < chain_.size(); ++i) {
-            const std::shared_ptr<const block_type>& block = chain_.at(i);
-            const char* begin = block->data();
-            size_t length = block->size();
-
-            // Note that both of these conditions can be true if there's only one block.
-            if (i == 0) {
-                CHECK_GE(block->size(), begin_offset_);
-                begin += begin_offset_;
-                length -= begin_offset_;
-            }
-
-            if (i == chain_.size() - 1) {
-                CHECK_GE(length, end_offset_);
-                length -= end_offset_;
-            }
-
-            callback(begin, length);
+        for (const Range& range : chain_) {
+            callback(range.data(), range.length);
         }
     }
 
-  public:
     // Copy all of the blocks into a single block.
     template <typename CollectionType = block_type>
     CollectionType coalesce() const {
@@ -313,7 +290,7 @@ struct IOVector {
         typename std::result_of<FunctionType(const char*, size_t)>::type {
         if (chain_.size() == 1) {
             // If we only have one block, we can use it directly.
-            return f(chain_.front()->data() + begin_offset_, size());
+            return f(chain_.front().data(), size());
         } else {
             // Otherwise, copy to a single block.
             auto data = coalesce();
@@ -324,6 +301,7 @@ struct IOVector {
     // Get a list of iovecs that can be used to write out all of the blocks.
     std::vector<adb_iovec> iovecs() const {
         std::vector<adb_iovec> result;
+        result.reserve(chain_.size());
         iterate_blocks([&result](const char* data, size_t len) {
             adb_iovec iov;
             iov.iov_base = const_cast<char*>(data);
@@ -335,10 +313,25 @@ struct IOVector {
     }
 
   private:
-    // Total length of all of the blocks in the chain.
+    // The part of a block that belongs to this chain. Blocks are immutable
+    // once appended, so take_front can share them instead of copying.
+    struct Range {
+        std::shared_ptr<const block_type> block;
+        size_t offset;
+        size_t length;
+
+        const char* data() const { return block->data() + offset; }
+    };
+
+    // Total length of all of the ranges in the chain.
     size_t chain_length_ = 0;
+    std::deque<Range> chain_;
+};
 
-    size_t begin_offset_ = 0;
-    size_t end_offset_ = 0;
-    std::deque<std::shared_ptr<const block_type>> chain_;
+// The payload is kept as a chain of blocks from the read that produced it to
+// the write that consumes it; code that needs it contiguous calls coalesce().
+struct apacket {
+    using payload_type = IOVector;
+    amessage msg;
+    payload_type payload;
 };
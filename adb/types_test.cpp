@@ -117,3 +117,51 @@ TEST(IOVector, misaligned_split) {
     ASSERT_EQ(1ULL, bc.size());
     ASSERT_EQ(*create_block("x"), bc.coalesce());
 }
+
+TEST(IOVector, drop_front) {
+    IOVector bc;
+    bc.append(create_block("foo"));
+    bc.append(create_block("bar"));
+    bc.append(create_block("baz"));
+
+    bc.drop_front(2);
+    ASSERT_EQ(7ULL, bc.size());
+    ASSERT_EQ(*create_block("obarbaz"), bc.coalesce());
+
+    bc.drop_front(4);
+    ASSERT_EQ(3ULL, bc.size());
+    ASSERT_EQ(*create_block("baz"), bc.coalesce());
+
+    bc.drop_front(3);
+    ASSERT_TRUE(bc.empty());
+}
+
+TEST(IOVector, append_chain) {
+    IOVector source;
+    source.append(create_block("foo"));
+    source.append(create_block("bar"));
+    source.append(create_block("baz"));
+
+    // Misaligned on both ends.
+    IOVector bc = source.take_front(4);
+    ASSERT_EQ(*create_block("foob"), bc.coalesce());
+
+    source.drop_front(1);
+    bc.append(std::move(source));
+    ASSERT_TRUE(source.empty());
+    ASSERT_EQ(8ULL, bc.size());
+    ASSERT_EQ(*create_block("foobrbaz"), bc.coalesce());
+
+    bc.append(create_block("qux"));
+    ASSERT_EQ(*create_block("foobrbazqux"), bc.coalesce());
+    ASSERT_EQ(5ULL, bc.iovecs().size());
+}
+
+TEST(IOVector, trim_front) {
+    IOVector bc;
+    bc.append(create_block("foobar"));
+    bc.drop_front(3);
+    bc.trim_front();
+    ASSERT_EQ(3ULL, bc.size());
+    ASSERT_EQ(*create_block("bar"), bc.coalesce());
+}
@@ -60,6 +60,8 @@
 #endif
 #endif
 
+#include <stdint.h>
+
 #include <functional>
 #include <memory>
 #include <ostream>
@@ -131,6 +133,36 @@ class LogdLogger {
 };
 #endif
 
+// Passes messages on to another logger from a background thread, so that logging
+// doesn't block on a slow destination, like logd when it is backed up. Up to
+// `capacity` messages are queued without taking a lock; messages logged while
+// the queue is full are dropped, and a count of them is logged once it drains.
+// FATAL messages are logged on the calling thread after the queued ones, since
+// the process is about to abort.
+//
+// Copies share the queue and the thread, which logs the remaining messages and
+// exits once the last copy is destroyed. The thread doesn't survive fork(), so
+// a child process has to set a new logger.
+//
+//   SetLogger(AsyncLogger(LogdLogger()));
+class AsyncLogger {
+ public:
+  explicit AsyncLogger(LogFunction&& logger, size_t capacity = 256);
+
+  void operator()(LogId, LogSeverity, const char* tag, const char* file,
+                  unsigned int line, const char* message);
+
+  // Waits until the messages queued so far have been passed on.
+  void Flush();
+
+  // Returns how many messages were dropped so far because the queue was full.
+  uint64_t GetDroppedCount() const;
+
+ private:
+  class Queue;
+  std::shared_ptr<Queue> queue_;
+};
+
 // Configure logging based on ANDROID_LOG_TAGS environment variable.
 // We need to parse a string that looks like
 //
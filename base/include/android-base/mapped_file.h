@@ -28,6 +28,10 @@
 #include <windows.h>
 #define PROT_READ 1
 #define PROT_WRITE 2
+#define MADV_NORMAL 0
+#define MADV_RANDOM 1
+#define MADV_SEQUENTIAL 2
+#define MADV_WILLNEED 3
 using os_handle = HANDLE;
 #else
 #include <sys/mman.h>
@@ -71,6 +75,14 @@ class MappedFile {
 
   bool isValid() const { return base_ != nullptr; }
 
+  /**
+   * Tells the kernel how the mapping is going to be accessed, like `madvise(2)`: for instance
+   * `MADV_WILLNEED` to start reading all of it in ahead of the first access, or `MADV_SEQUENTIAL`
+   * for a single pass over it. The advice is only a hint, so failures can usually be ignored.
+   * Returns true without doing anything on Windows.
+   */
+  bool Advise(int advice) const;
+
   explicit operator bool() const { return isValid(); }
 
  private:
@@ -18,9 +18,16 @@
 
 #include <sys/cdefs.h>
 
+#include <stdint.h>
+
 #include <chrono>
+#include <functional>
 #include <limits>
+#include <mutex>
 #include <string>
+#include <vector>
+
+struct prop_info;
 
 namespace android {
 namespace base {
@@ -67,5 +74,82 @@ bool WaitForPropertyCreation(const std::string& key, std::chrono::milliseconds r
                                                          std::chrono::milliseconds::max());
 #endif
 
+// A condition on a system property, for WaitForProperties: that the property
+// exists, that it has a given value, or that its value satisfies a predicate.
+struct PropertyCondition {
+  explicit PropertyCondition(std::string key) : key(std::move(key)) {}
+  PropertyCondition(std::string key, std::string expected_value);
+  PropertyCondition(std::string key, std::function<bool(const std::string&)> predicate)
+      : key(std::move(key)), predicate(std::move(predicate)) {}
+
+  std::string key;
+  // Null to only wait for the property to be created.
+  std::function<bool(const std::string& value)> predicate;
+};
+
+// Waits until each of `conditions` has held, watching them all at once rather
+// than one after the other. A property's value is only read again after its own
+// serial changes, and once a single condition is left on a property that
+// exists, changes to other properties don't wake the caller at all.
+//
+// A condition that has held isn't checked again, so this is meant for
+// properties that only move forward, like the ones announcing that something
+// is ready.
+// Times out after `relative_timeout`.
+// Returns true on success, false on timeout. If `satisfied` isn't null, it is
+// set to which of the conditions held.
+#if defined(__BIONIC__)
+bool WaitForProperties(const std::vector<PropertyCondition>& conditions,
+                       std::chrono::milliseconds relative_timeout = std::chrono::milliseconds::max(),
+                       std::vector<bool>* satisfied = nullptr);
+#endif
+
+// Reads a system property that is read over and over, like a debug flag that
+// is checked on every frame. The property is only looked up by name until it
+// exists, and its value is only copied out again after the property changes,
+// which costs one load of its serial number per call rather than a lookup and a
+// copy.
+//
+// Not thread-safe: callers sharing one must serialize their calls to Get, and
+// the returned string is only valid until the next call. See CachedBoolProperty
+// for a thread-safe flag.
+class CachedProperty {
+ public:
+  explicit CachedProperty(const std::string& property_name);
+
+  // Returns the current value of the property, or the empty string if it
+  // doesn't exist. If `changed` isn't null, sets it to whether the value is
+  // different from the one returned by the previous call (the first call counts
+  // as a change).
+  const std::string& Get(bool* changed = nullptr);
+
+ private:
+  CachedProperty(const CachedProperty&) = delete;
+  CachedProperty& operator=(const CachedProperty&) = delete;
+
+  const std::string key_;
+  const prop_info* prop_info_;
+  // The serial of the property area when the property was last looked up and
+  // didn't exist, and the serial of the property when it was last read.
+  uint32_t cached_area_serial_;
+  uint32_t cached_property_serial_;
+  bool read_once_;
+  std::string cached_value_;
+};
+
+// A CachedProperty parsed like GetBoolProperty, which can be shared by threads.
+class CachedBoolProperty {
+ public:
+  explicit CachedBoolProperty(const std::string& property_name);
+
+  bool Get(bool default_value);
+
+ private:
+  std::mutex lock_;
+  CachedProperty property_;
+  // The value last returned by property_, parsed: -1 if it isn't a boolean.
+  int cached_value_;
+};
+
 } // namespace base
 } // namespace android
@@ -16,6 +16,10 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <iterator>
 #include <sstream>
 #include <string>
 #include <string_view>
@@ -32,9 +36,125 @@ namespace base {
 std::vector<std::string> Split(const std::string& s,
                                const std::string& delimiters);
 
+// Iterates over the pieces of a string split at each occurrence of a character
+// in delimiters, without copying them: the pieces are views into the string,
+// which must outlive the iteration. Use SplitView or Tokenize to create one:
+//
+//   for (std::string_view flag : Tokenize(flags, ",")) { ... }
+class StringSplitter {
+ public:
+  class iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view*;
+    using reference = const std::string_view&;
+
+    reference operator*() const { return piece_; }
+    pointer operator->() const { return &piece_; }
+    iterator& operator++() {
+      Advance();
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator result = *this;
+      Advance();
+      return result;
+    }
+    bool operator==(const iterator& other) const { return pos_ == other.pos_; }
+    bool operator!=(const iterator& other) const { return pos_ != other.pos_; }
+
+   private:
+    friend class StringSplitter;
+
+    iterator(const StringSplitter* splitter, size_t pos) : splitter_(splitter), pos_(pos) {
+      if (pos_ == std::string_view::npos) return;
+      Find(pos_);
+      if (splitter_->skip_empty_ && piece_.empty()) Advance();
+    }
+
+    // Makes piece_ the piece that starts at pos.
+    void Find(size_t pos) {
+      std::string_view s = splitter_->s_;
+      size_t end = splitter_->FindDelimiter(pos);
+      pos_ = pos;
+      piece_ = s.substr(pos, end - pos);
+    }
+
+    void Advance() {
+      do {
+        size_t end = pos_ + piece_.size();
+        if (end == splitter_->s_.size()) {
+          pos_ = std::string_view::npos;
+          piece_ = {};
+          return;
+        }
+        Find(end + 1);
+      } while (splitter_->skip_empty_ && piece_.empty());
+    }
+
+    const StringSplitter* splitter_;
+    // Offset of piece_ in the string, or npos once past the last piece.
+    size_t pos_;
+    std::string_view piece_;
+  };
+
+  // The empty string is not a valid delimiter list.
+  StringSplitter(std::string_view s, std::string_view delimiters, bool skip_empty)
+      : s_(s), skip_empty_(skip_empty), single_delimiter_(0), table_{} {
+    if (delimiters.empty()) abort();
+    if (delimiters.size() == 1) {
+      single_delimiter_ = delimiters[0];
+    } else {
+      for (unsigned char c : delimiters) table_[c >> 6] |= uint64_t(1) << (c & 63);
+    }
+  }
+
+  iterator begin() const { return iterator(this, 0); }
+  iterator end() const { return iterator(this, std::string_view::npos); }
+
+ private:
+  // Returns the offset of the first delimiter at or after pos, or the size of
+  // the string. A single delimiter is found with memchr, and a set of them with
+  // a table lookup per character rather than a scan of the delimiters.
+  size_t FindDelimiter(size_t pos) const {
+    if (table_[0] == 0 && table_[1] == 0 && table_[2] == 0 && table_[3] == 0) {
+      size_t found = s_.find(single_delimiter_, pos);
+      return found == std::string_view::npos ? s_.size() : found;
+    }
+    for (; pos < s_.size(); pos++) {
+      unsigned char c = s_[pos];
+      if (table_[c >> 6] & (uint64_t(1) << (c & 63))) break;
+    }
+    return pos;
+  }
+
+  std::string_view s_;
+  bool skip_empty_;
+  char single_delimiter_;
+  uint64_t table_[4];
+};
+
+// Like Split, but returns views into 's' instead of allocating a vector of
+// strings. Consecutive delimiters yield empty pieces, and the empty string
+// yields a single empty piece.
+inline StringSplitter SplitView(std::string_view s, std::string_view delimiters) {
+  return StringSplitter(s, delimiters, false);
+}
+
+// Like SplitView, but skips empty pieces, so that runs of delimiters count as
+// one and the empty string has no pieces at all.
+inline StringSplitter Tokenize(std::string_view s, std::string_view delimiters) {
+  return StringSplitter(s, delimiters, true);
+}
+
 // Trims whitespace off both ends of the given string.
 std::string Trim(const std::string& s);
 
+// Like Trim, but returns a view into 's' instead of a copy.
+std::string_view TrimView(std::string_view s);
+
 // Joins a container of things into a single string, using the given separator.
 template <typename ContainerT, typename SeparatorT>
 std::string Join(const ContainerT& things, SeparatorT separator) {
@@ -36,11 +36,14 @@
 #include <sys/uio.h>
 #endif
 
+#include <atomic>
+#include <condition_variable>
 #include <iostream>
 #include <limits>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -278,6 +281,192 @@ void LogdLogger::operator()(LogId id, LogSeverity severity, const char* tag,
 }
 #endif
 
+// A bounded multi-producer queue of messages (after Dmitry Vyukov's), drained by
+// a single thread that owns the logger. Each slot carries a sequence number
+// that says whether it is free for the producer claiming position `pos` (it is
+// `pos`) or holds the message at `pos` (it is `pos + 1`). The strings of a slot
+// keep their capacity, so queueing a message rarely allocates once warmed up.
+class AsyncLogger::Queue {
+ public:
+  Queue(LogFunction&& logger, size_t capacity) : logger_(std::move(logger)) {
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    mask_ = size - 1;
+    slots_.reset(new Slot[size]);
+    for (size_t i = 0; i < size; i++) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    thread_ = std::thread(&Queue::Run, this);
+  }
+
+  ~Queue() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wakeup_.notify_one();
+    thread_.join();
+  }
+
+  bool Push(LogId id, LogSeverity severity, const char* tag, const char* file, unsigned int line,
+            const char* message) {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &slots_[pos & mask_];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->id = id;
+    slot->severity = severity;
+    slot->tag.assign(tag);
+    slot->file.assign(file);
+    slot->line = line;
+    slot->message.assign(message);
+    // Sequentially consistent, like the accesses in Run, so that either the
+    // thread sees the message before it goes to sleep, or we see that it needs
+    // waking up.
+    slot->sequence.store(pos + 1, std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_seq_cst)) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      wakeup_.notify_one();
+    }
+    return true;
+  }
+
+  void Flush() {
+    size_t target = enqueue_pos_.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(mutex_);
+    flushed_.wait(lock, [&] { return processed_.load(std::memory_order_acquire) >= target; });
+  }
+
+  void LogNow(LogId id, LogSeverity severity, const char* tag, const char* file,
+              unsigned int line, const char* message) {
+    std::lock_guard<std::mutex> lock(logger_lock_);
+    logger_(id, severity, tag, file, line, message);
+  }
+
+  uint64_t GetDroppedCount() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    LogId id;
+    LogSeverity severity;
+    unsigned int line;
+    std::string tag;
+    std::string file;
+    std::string message;
+  };
+
+  bool HasMessage(std::memory_order order = std::memory_order_acquire) const {
+    return slots_[dequeue_pos_ & mask_].sequence.load(order) == dequeue_pos_ + 1;
+  }
+
+  void Drain() {
+    while (HasMessage()) {
+      // Take the strings out of the slot, so that it can be reused while the
+      // message is being logged. Ours go back in, so no memory changes hands.
+      Slot& slot = slots_[dequeue_pos_ & mask_];
+      LogId id = slot.id;
+      LogSeverity severity = slot.severity;
+      unsigned int line = slot.line;
+      tag_.swap(slot.tag);
+      file_.swap(slot.file);
+      message_.swap(slot.message);
+      slot.sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+      dequeue_pos_++;
+
+      {
+        std::lock_guard<std::mutex> lock(logger_lock_);
+        logger_(id, severity, tag_.c_str(), file_.c_str(), line, message_.c_str());
+        // Once the queue has drained, say how many messages didn't fit, under
+        // the tag of the last one to be logged.
+        uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (dropped != reported_dropped_ && !HasMessage()) {
+          std::string report = std::to_string(dropped - reported_dropped_) +
+                               " log messages dropped, the queue was full";
+          logger_(id, WARNING, tag_.c_str(), GetFileBasename(__FILE__), __LINE__,
+                  report.c_str());
+          reported_dropped_ = dropped;
+        }
+      }
+      processed_.store(dequeue_pos_, std::memory_order_release);
+    }
+  }
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      sleeping_.store(false, std::memory_order_relaxed);
+      lock.unlock();
+      Drain();
+      lock.lock();
+      flushed_.notify_all();
+
+      sleeping_.store(true, std::memory_order_seq_cst);
+      if (HasMessage(std::memory_order_seq_cst)) continue;
+      if (stopping_) break;
+      wakeup_.wait(lock);
+    }
+  }
+
+  LogFunction logger_;
+  // Serializes the calls to logger_ from the thread and from LogNow.
+  std::mutex logger_lock_;
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  std::atomic<size_t> enqueue_pos_{0};
+  // Only used by the thread.
+  size_t dequeue_pos_ = 0;
+  uint64_t reported_dropped_ = 0;
+  std::string tag_;
+  std::string file_;
+  std::string message_;
+
+  std::atomic<size_t> processed_{0};
+  std::atomic<uint64_t> dropped_{0};
+
+  // Guards stopping_, and the sleeping and flushing hand-offs.
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  std::condition_variable flushed_;
+  std::atomic<bool> sleeping_{false};
+  bool stopping_ = false;
+
+  std::thread thread_;
+};
+
+AsyncLogger::AsyncLogger(LogFunction&& logger, size_t capacity)
+    : queue_(std::make_shared<Queue>(std::move(logger), capacity)) {}
+
+void AsyncLogger::operator()(LogId id, LogSeverity severity, const char* tag, const char* file,
+                             unsigned int line, const char* message) {
+  if (severity == FATAL) {
+    queue_->Flush();
+    queue_->LogNow(id, severity, tag, file, line, message);
+    return;
+  }
+  queue_->Push(id, severity, tag, file, line, message);
+}
+
+void AsyncLogger::Flush() {
+  queue_->Flush();
+}
+
+uint64_t AsyncLogger::GetDroppedCount() const {
+  return queue_->GetDroppedCount();
+}
+
 void InitLogging(char* argv[], LogFunction&& logger, AbortFunction&& aborter) {
   SetLogger(std::forward<LogFunction>(logger));
   SetAborter(std::forward<AbortFunction>(aborter));
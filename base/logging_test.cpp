@@ -22,8 +22,12 @@
 #include <signal.h>
 #endif
 
+#include <condition_variable>
+#include <mutex>
 #include <regex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "android-base/file.h"
 #include "android-base/stringprintf.h"
@@ -648,3 +652,105 @@ TEST(logging, StdioLogger) {
   // Whereas ERROR logging includes the program name.
   ASSERT_EQ(android::base::Basename(android::base::GetExecutablePath()) + ": err\n", cap_err.str());
 }
+
+TEST(logging, AsyncLogger) {
+  std::mutex lock;
+  std::vector<std::string> messages;
+  android::base::AsyncLogger logger(
+      [&](android::base::LogId, android::base::LogSeverity, const char*, const char*,
+          unsigned int, const char* message) {
+        std::lock_guard<std::mutex> guard(lock);
+        messages.push_back(message);
+      },
+      1024);
+  android::base::SetLogger(android::base::AsyncLogger(logger));
+
+  android::base::ScopedLogSeverity sls(android::base::INFO);
+  for (int i = 0; i < 100; i++) {
+    LOG(INFO) << "message " << i;
+  }
+  logger.Flush();
+  android::base::SetLogger(android::base::StderrLogger);
+
+  ASSERT_EQ(100U, messages.size());
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ("message " + std::to_string(i), messages[i]);
+  }
+  ASSERT_EQ(0U, logger.GetDroppedCount());
+}
+
+TEST(logging, AsyncLogger_full) {
+  std::mutex lock;
+  std::condition_variable cv;
+  bool blocked = false;
+  bool released = false;
+  std::vector<std::string> messages;
+  android::base::AsyncLogger logger(
+      [&](android::base::LogId, android::base::LogSeverity, const char*, const char*,
+          unsigned int, const char* message) {
+        std::unique_lock<std::mutex> guard(lock);
+        messages.push_back(message);
+        blocked = true;
+        cv.notify_all();
+        cv.wait(guard, [&] { return released; });
+      },
+      2);
+  android::base::SetLogger(android::base::AsyncLogger(logger));
+
+  android::base::ScopedLogSeverity sls(android::base::INFO);
+  LOG(INFO) << "first";
+  {
+    // Wait for the thread to be stuck in the logger, so that the queue is empty.
+    std::unique_lock<std::mutex> guard(lock);
+    cv.wait(guard, [&] { return blocked; });
+  }
+  for (int i = 0; i < 4; i++) {
+    LOG(INFO) << "message " << i;
+  }
+  ASSERT_EQ(2U, logger.GetDroppedCount());
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    released = true;
+  }
+  cv.notify_all();
+  logger.Flush();
+  android::base::SetLogger(android::base::StderrLogger);
+
+  ASSERT_EQ(4U, messages.size());
+  ASSERT_EQ("first", messages[0]);
+  ASSERT_EQ("message 0", messages[1]);
+  ASSERT_EQ("message 1", messages[2]);
+  ASSERT_EQ("2 log messages dropped, the queue was full", messages[3]);
+}
+
+TEST(logging, AsyncLogger_FATAL_is_synchronous) {
+  std::mutex lock;
+  std::vector<std::string> messages;
+  std::thread::id fatal_thread;
+  android::base::AsyncLogger logger(
+      [&](android::base::LogId, android::base::LogSeverity severity, const char*, const char*,
+          unsigned int, const char* message) {
+        std::lock_guard<std::mutex> guard(lock);
+        messages.push_back(message);
+        if (severity == android::base::FATAL) fatal_thread = std::this_thread::get_id();
+      });
+  android::base::SetLogger(android::base::AsyncLogger(logger));
+  android::base::SetAborter([](const char*) {});
+
+  android::base::ScopedLogSeverity sls(android::base::INFO);
+  LOG(INFO) << "info";
+  LOG(FATAL) << "fatal";
+
+  // Both are logged by the time LOG(FATAL) returns, in order.
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    ASSERT_EQ(2U, messages.size());
+    ASSERT_EQ("info", messages[0]);
+    ASSERT_EQ("fatal", messages[1]);
+    ASSERT_EQ(std::this_thread::get_id(), fatal_thread);
+  }
+
+  android::base::SetAborter(android::base::DefaultAborter);
+  android::base::SetLogger(android::base::StderrLogger);
+}
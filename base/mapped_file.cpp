@@ -106,6 +106,17 @@ MappedFile& MappedFile::operator=(MappedFile&& other) {
   return *this;
 }
 
+bool MappedFile::Advise(int advice) const {
+#if defined(_WIN32)
+  UNUSED(advice);
+  return true;
+#else
+  if (base_ == nullptr || size_ == 0) return true;
+  // The mapping starts at a page boundary, as madvise requires.
+  return madvise(base_, size_ + offset_, advice) == 0;
+#endif
+}
+
 MappedFile::~MappedFile() {
   Close();
 }
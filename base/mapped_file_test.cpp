@@ -49,3 +49,20 @@ TEST(mapped_file, zero_length_mapping) {
   EXPECT_EQ(0u, m->size());
   EXPECT_NE(nullptr, m->data());
 }
+
+TEST(mapped_file, advise) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+  ASSERT_TRUE(android::base::WriteStringToFd(std::string(3 * 4096, 'x'), tf.fd));
+
+  auto m = android::base::MappedFile::FromFd(tf.fd, 4097, 4096, PROT_READ);
+  ASSERT_NE(nullptr, m);
+  EXPECT_TRUE(m->Advise(MADV_WILLNEED));
+  EXPECT_TRUE(m->Advise(MADV_SEQUENTIAL));
+  EXPECT_EQ('x', m->data()[0]);
+  EXPECT_EQ('x', m->data()[4095]);
+
+  auto empty = android::base::MappedFile::FromFd(tf.fd, 4096, 0, PROT_READ);
+  ASSERT_NE(nullptr, empty);
+  EXPECT_TRUE(empty->Advise(MADV_WILLNEED));
+}
@@ -33,14 +33,19 @@
 namespace android {
 namespace base {
 
-bool GetBoolProperty(const std::string& key, bool default_value) {
-  std::string value = GetProperty(key, "");
+// Returns 1 or 0 for the values GetBoolProperty understands, or -1 otherwise.
+static int ParseBoolValue(const std::string& value) {
   if (value == "1" || value == "y" || value == "yes" || value == "on" || value == "true") {
-    return true;
+    return 1;
   } else if (value == "0" || value == "n" || value == "no" || value == "off" || value == "false") {
-    return false;
+    return 0;
   }
-  return default_value;
+  return -1;
+}
+
+bool GetBoolProperty(const std::string& key, bool default_value) {
+  int result = ParseBoolValue(GetProperty(key, ""));
+  return result == -1 ? default_value : result == 1;
 }
 
 template <typename T>
@@ -104,6 +109,73 @@ bool SetProperty(const std::string& key, const std::string& value) {
   return (__system_property_set(key.c_str(), value.c_str()) == 0);
 }
 
+PropertyCondition::PropertyCondition(std::string key, std::string expected_value)
+    : key(std::move(key)),
+      predicate([expected_value = std::move(expected_value)](const std::string& value) {
+        return value == expected_value;
+      }) {}
+
+CachedProperty::CachedProperty(const std::string& property_name)
+    : key_(property_name),
+      prop_info_(nullptr),
+      cached_area_serial_(0),
+      cached_property_serial_(0),
+      read_once_(false) {}
+
+const std::string& CachedProperty::Get(bool* changed) {
+  bool first = !read_once_;
+  read_once_ = true;
+  if (changed != nullptr) *changed = first;
+#if defined(__BIONIC__)
+  if (prop_info_ == nullptr) {
+    // Properties can't be removed, so it's only worth looking again once the
+    // property area has changed since the last time.
+    uint32_t area_serial = __system_property_area_serial();
+    if (!first && area_serial == cached_area_serial_) return cached_value_;
+    cached_area_serial_ = area_serial;
+    prop_info_ = __system_property_find(key_.c_str());
+    if (prop_info_ == nullptr) return cached_value_;
+  } else if (__system_property_serial(prop_info_) == cached_property_serial_) {
+    return cached_value_;
+  }
+
+  struct ReadData {
+    CachedProperty* property;
+    bool changed;
+  } data = {this, false};
+  __system_property_read_callback(prop_info_,
+                                  [](void* cookie, const char*, const char* value, unsigned serial) {
+                                    auto data = reinterpret_cast<ReadData*>(cookie);
+                                    data->property->cached_property_serial_ = serial;
+                                    if (data->property->cached_value_ != value) {
+                                      data->property->cached_value_ = value;
+                                      data->changed = true;
+                                    }
+                                  },
+                                  &data);
+  if (changed != nullptr && data.changed) *changed = true;
+#else
+  auto it = g_properties.find(key_);
+  const std::string& value = it == g_properties.end() ? "" : it->second;
+  if (cached_value_ != value) {
+    cached_value_ = value;
+    if (changed != nullptr) *changed = true;
+  }
+#endif
+  return cached_value_;
+}
+
+CachedBoolProperty::CachedBoolProperty(const std::string& property_name)
+    : property_(property_name), cached_value_(-1) {}
+
+bool CachedBoolProperty::Get(bool default_value) {
+  std::lock_guard<std::mutex> lock(lock_);
+  bool changed;
+  const std::string& value = property_.Get(&changed);
+  if (changed) cached_value_ = ParseBoolValue(value);
+  return cached_value_ == -1 ? default_value : cached_value_ == 1;
+}
+
 #if defined(__BIONIC__)
 
 struct WaitForPropertyData {
@@ -192,6 +264,83 @@ bool WaitForPropertyCreation(const std::string& key,
   return (WaitForPropertyCreation(key, relative_timeout, start_time) != nullptr);
 }
 
+bool WaitForProperties(const std::vector<PropertyCondition>& conditions,
+                       std::chrono::milliseconds relative_timeout, std::vector<bool>* satisfied) {
+  auto start_time = std::chrono::steady_clock::now();
+
+  struct WatchedProperty {
+    const prop_info* pi = nullptr;
+    // The serial of the value last checked, valid once `read` is set.
+    uint32_t serial = 0;
+    bool read = false;
+    bool done = false;
+  };
+  std::vector<WatchedProperty> watched(conditions.size());
+  size_t remaining = conditions.size();
+
+  auto finish = [&](bool result) {
+    if (satisfied != nullptr) {
+      satisfied->resize(watched.size());
+      for (size_t i = 0; i < watched.size(); ++i) (*satisfied)[i] = watched[i].done;
+    }
+    return result;
+  };
+
+  while (true) {
+    // Read before checking, so that a change made while checking ends the wait below.
+    uint32_t global_serial = __system_property_area_serial();
+    bool missing = false;
+    WatchedProperty* last = nullptr;
+
+    for (size_t i = 0; i < conditions.size(); ++i) {
+      WatchedProperty& w = watched[i];
+      if (w.done) continue;
+      if (w.pi == nullptr) {
+        w.pi = __system_property_find(conditions[i].key.c_str());
+        if (w.pi == nullptr) {
+          missing = true;
+          continue;
+        }
+      }
+
+      if (!conditions[i].predicate) {
+        w.done = true;
+      } else if (!w.read || __system_property_serial(w.pi) != w.serial) {
+        struct ReadData {
+          WatchedProperty* watched;
+          std::string value;
+        } data = {&w, {}};
+        __system_property_read_callback(
+            w.pi,
+            [](void* cookie, const char*, const char* value, unsigned serial) {
+              auto data = reinterpret_cast<ReadData*>(cookie);
+              data->watched->serial = serial;
+              data->value = value;
+            },
+            &data);
+        w.read = true;
+        w.done = conditions[i].predicate(data.value);
+      }
+      if (w.done) {
+        --remaining;
+      } else {
+        last = &w;
+      }
+    }
+    if (remaining == 0) return finish(true);
+
+    timespec ts;
+    UpdateTimeSpec(ts, relative_timeout, start_time);
+    uint32_t unused;
+    if (!missing && remaining == 1) {
+      // Only this property matters now: wait on its own serial.
+      if (!__system_property_wait(last->pi, last->serial, &unused, &ts)) return finish(false);
+    } else {
+      if (!__system_property_wait(nullptr, global_serial, &unused, &ts)) return finish(false);
+    }
+  }
+}
+
 #endif
 
 }  // namespace base
@@ -16,6 +16,8 @@
 
 #include "android-base/properties.h"
 
+#include <unistd.h>
+
 #include <gtest/gtest.h>
 
 #include <atomic>
@@ -127,6 +129,53 @@ TEST(properties, GetUintProperty_uint16_t) { CheckGetUintProperty<uint16_t>(); }
 TEST(properties, GetUintProperty_uint32_t) { CheckGetUintProperty<uint32_t>(); }
 TEST(properties, GetUintProperty_uint64_t) { CheckGetUintProperty<uint64_t>(); }
 
+TEST(properties, CachedProperty) {
+  android::base::SetProperty("debug.libbase.CachedProperty_test", "");
+  android::base::CachedProperty cached_property("debug.libbase.CachedProperty_test");
+  bool changed;
+  ASSERT_EQ("", cached_property.Get(&changed));
+  ASSERT_TRUE(changed);
+  ASSERT_EQ("", cached_property.Get(&changed));
+  ASSERT_FALSE(changed);
+
+  android::base::SetProperty("debug.libbase.CachedProperty_test", "foo");
+  ASSERT_EQ("foo", cached_property.Get(&changed));
+  ASSERT_TRUE(changed);
+  ASSERT_EQ("foo", cached_property.Get(&changed));
+  ASSERT_FALSE(changed);
+
+  // Setting the same value again isn't a change.
+  android::base::SetProperty("debug.libbase.CachedProperty_test", "foo");
+  ASSERT_EQ("foo", cached_property.Get(&changed));
+  ASSERT_FALSE(changed);
+
+  android::base::SetProperty("debug.libbase.CachedProperty_test", "bar");
+  ASSERT_EQ("bar", cached_property.Get());
+}
+
+TEST(properties, CachedProperty_created_later) {
+  android::base::CachedProperty cached_property("debug.libbase.CachedProperty_test_" +
+                                                std::to_string(getpid()));
+  ASSERT_EQ("", cached_property.Get());
+
+  android::base::SetProperty("debug.libbase.CachedProperty_test_" + std::to_string(getpid()),
+                             "created");
+  bool changed;
+  ASSERT_EQ("created", cached_property.Get(&changed));
+  ASSERT_TRUE(changed);
+}
+
+TEST(properties, CachedBoolProperty) {
+  android::base::CachedBoolProperty cached_property("debug.libbase.CachedProperty_test");
+  android::base::SetProperty("debug.libbase.CachedProperty_test", "true");
+  ASSERT_TRUE(cached_property.Get(false));
+  android::base::SetProperty("debug.libbase.CachedProperty_test", "0");
+  ASSERT_FALSE(cached_property.Get(true));
+  android::base::SetProperty("debug.libbase.CachedProperty_test", "burp");
+  ASSERT_TRUE(cached_property.Get(true));
+  ASSERT_FALSE(cached_property.Get(false));
+}
+
 TEST(properties, WaitForProperty) {
 #if defined(__BIONIC__)
   std::atomic<bool> flag{false};
@@ -230,3 +279,51 @@ TEST(properties, WaitForPropertyCreation_timeout) {
   GTEST_LOG_(INFO) << "This test does nothing on the host.\n";
 #endif
 }
+
+TEST(properties, WaitForProperties) {
+#if defined(__BIONIC__)
+  android::base::SetProperty("debug.libbase.WaitForProperties_test.a", "");
+  android::base::SetProperty("debug.libbase.WaitForProperties_test.b", "0");
+  std::thread thread([&]() {
+    std::this_thread::sleep_for(100ms);
+    android::base::SetProperty("debug.libbase.WaitForProperties_test.b", "3");
+    android::base::SetProperty("debug.libbase.WaitForProperties_test.unrelated", "x");
+    std::this_thread::sleep_for(100ms);
+    android::base::SetProperty("debug.libbase.WaitForProperties_test.c", "created");
+    android::base::SetProperty("debug.libbase.WaitForProperties_test.a", "ready");
+  });
+
+  std::vector<android::base::PropertyCondition> conditions = {
+      {"debug.libbase.WaitForProperties_test.a", "ready"},
+      {"debug.libbase.WaitForProperties_test.b",
+       [](const std::string& value) { return value > "2"; }},
+      android::base::PropertyCondition("debug.libbase.WaitForProperties_test.c"),
+  };
+  std::vector<bool> satisfied;
+  ASSERT_TRUE(android::base::WaitForProperties(conditions, 1s, &satisfied));
+  ASSERT_EQ(std::vector<bool>({true, true, true}), satisfied);
+  thread.join();
+#else
+  GTEST_LOG_(INFO) << "This test does nothing on the host.\n";
+#endif
+}
+
+TEST(properties, WaitForProperties_timeout) {
+#if defined(__BIONIC__)
+  android::base::SetProperty("debug.libbase.WaitForProperties_timeout_test.a", "1");
+
+  std::vector<android::base::PropertyCondition> conditions = {
+      {"debug.libbase.WaitForProperties_timeout_test.a", "1"},
+      {"debug.libbase.WaitForProperties_timeout_test.b", "1"},
+  };
+  std::vector<bool> satisfied;
+  auto t0 = std::chrono::steady_clock::now();
+  ASSERT_FALSE(android::base::WaitForProperties(conditions, 200ms, &satisfied));
+  auto t1 = std::chrono::steady_clock::now();
+
+  ASSERT_GE(std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0), 200ms);
+  ASSERT_EQ(std::vector<bool>({true, false}), satisfied);
+#else
+  GTEST_LOG_(INFO) << "This test does nothing on the host.\n";
+#endif
+}
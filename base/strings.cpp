@@ -47,37 +47,24 @@ std::vector<std::string> Split(const std::string& s,
 }
 
 std::string Trim(const std::string& s) {
-  std::string result;
-
-  if (s.size() == 0) {
-    return result;
-  }
+  return std::string(TrimView(s));
+}
 
+std::string_view TrimView(std::string_view s) {
   size_t start_index = 0;
-  size_t end_index = s.size() - 1;
+  size_t end_index = s.size();
 
   // Skip initial whitespace.
-  while (start_index < s.size()) {
-    if (!isspace(s[start_index])) {
-      break;
-    }
+  while (start_index < end_index && isspace(s[start_index])) {
     start_index++;
   }
 
   // Skip terminating whitespace.
-  while (end_index >= start_index) {
-    if (!isspace(s[end_index])) {
-      break;
-    }
+  while (end_index > start_index && isspace(s[end_index - 1])) {
     end_index--;
   }
 
-  // All spaces, no beef.
-  if (end_index < start_index) {
-    return "";
-  }
-  // Start_index is the first non-space, end_index is the last one.
-  return s.substr(start_index, end_index - start_index + 1);
+  return s.substr(start_index, end_index - start_index);
 }
 
 // These cases are probably the norm, so we mark them extern in the header to
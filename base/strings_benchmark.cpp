@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "android-base/strings.h"
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+// Shaped like the flags of an fstab entry.
+static const std::string kFlags =
+    "wait,check,formattable,fileencryption=aes-256-xts:aes-256-cts,quota,reservedsize=128M,"
+    "keydirectory=/metadata/vold/metadata_encryption,latemount,first_stage_mount";
+
+// Shaped like a kernel command line.
+static const std::string kCmdline =
+    "console=ttyMSM0,115200n8 androidboot.hardware=qcom  androidboot.console=ttyMSM0 "
+    "androidboot.memcg=1 lpm_levels.sleep_disabled=1 msm_rtb.filter=0x237 "
+    "service_locator.enable=1 swiotlb=2048 loop.max_part=7 androidboot.usbcontroller=a600000.dwc3";
+
+static void BenchmarkSplit(benchmark::State& state) {
+  for (auto _ : state) {
+    for (const auto& piece : android::base::Split(kFlags, ",")) {
+      benchmark::DoNotOptimize(piece.data());
+    }
+  }
+}
+
+BENCHMARK(BenchmarkSplit);
+
+static void BenchmarkSplitView(benchmark::State& state) {
+  for (auto _ : state) {
+    for (std::string_view piece : android::base::SplitView(kFlags, ",")) {
+      benchmark::DoNotOptimize(piece.data());
+    }
+  }
+}
+
+BENCHMARK(BenchmarkSplitView);
+
+static void BenchmarkSplitAny(benchmark::State& state) {
+  for (auto _ : state) {
+    for (const auto& piece : android::base::Split(kCmdline, " =")) {
+      benchmark::DoNotOptimize(piece.data());
+    }
+  }
+}
+
+BENCHMARK(BenchmarkSplitAny);
+
+static void BenchmarkTokenizeAny(benchmark::State& state) {
+  for (auto _ : state) {
+    for (std::string_view piece : android::base::Tokenize(kCmdline, " =")) {
+      benchmark::DoNotOptimize(piece.data());
+    }
+  }
+}
+
+BENCHMARK(BenchmarkTokenizeAny);
+
+static void BenchmarkTrim(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(android::base::Trim(kCmdline + "\n"));
+  }
+}
+
+BENCHMARK(BenchmarkTrim);
+
+static void BenchmarkTrimView(benchmark::State& state) {
+  std::string cmdline = kCmdline + "\n";
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(android::base::TrimView(cmdline));
+  }
+}
+
+BENCHMARK(BenchmarkTrimView);
@@ -83,6 +83,62 @@ TEST(strings, split_any_with_empty_part) {
   ASSERT_EQ("bar", parts[2]);
 }
 
+static std::vector<std::string> Collect(const android::base::StringSplitter& splitter) {
+  return std::vector<std::string>(splitter.begin(), splitter.end());
+}
+
+TEST(strings, split_view_matches_split) {
+  for (std::string s : {"", "foo", "foo,bar,baz", "foo,,bar", ",foo,bar,", ",", ",,",
+                        "foo:bar,baz", "foo:,bar", "\xff\x80" "foo\x80"}) {
+    for (std::string delimiters : {",", ",:", "\x80", ":\x80"}) {
+      SCOPED_TRACE("'" + s + "' split at '" + delimiters + "'");
+      ASSERT_EQ(android::base::Split(s, delimiters),
+                Collect(android::base::SplitView(s, delimiters)));
+    }
+  }
+}
+
+TEST(strings, split_view_null_char) {
+  std::string s("foo\0bar", 7);
+  std::vector<std::string> parts = Collect(android::base::SplitView(s, std::string_view("\0", 1)));
+  ASSERT_EQ(2U, parts.size());
+  ASSERT_EQ("foo", parts[0]);
+  ASSERT_EQ("bar", parts[1]);
+}
+
+TEST(strings, split_view_returns_views) {
+  std::string s = "foo,bar";
+  std::vector<std::string_view> parts;
+  for (std::string_view piece : android::base::SplitView(s, ",")) {
+    parts.push_back(piece);
+  }
+  ASSERT_EQ(2U, parts.size());
+  ASSERT_EQ(s.data(), parts[0].data());
+  ASSERT_EQ(s.data() + 4, parts[1].data());
+}
+
+TEST(strings, tokenize_empty) {
+  ASSERT_TRUE(Collect(android::base::Tokenize("", " ")).empty());
+  ASSERT_TRUE(Collect(android::base::Tokenize("   ", " ")).empty());
+}
+
+TEST(strings, tokenize_skips_empty_parts) {
+  std::vector<std::string> parts = Collect(android::base::Tokenize("  foo bar\t\tbaz ", " \t"));
+  ASSERT_EQ(3U, parts.size());
+  ASSERT_EQ("foo", parts[0]);
+  ASSERT_EQ("bar", parts[1]);
+  ASSERT_EQ("baz", parts[2]);
+}
+
+TEST(strings, trim_view) {
+  ASSERT_EQ("", android::base::TrimView(""));
+  ASSERT_EQ("", android::base::TrimView(" \t\n"));
+  ASSERT_EQ("foo bar", android::base::TrimView("\v\tfoo bar\n\f"));
+
+  std::string s = " foo ";
+  ASSERT_EQ(s.data() + 1, android::base::TrimView(s).data());
+}
+
 TEST(strings, trim_empty) {
   ASSERT_EQ("", android::base::Trim(""));
 }
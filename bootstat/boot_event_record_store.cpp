@@ -19,7 +19,7 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <sys/stat.h>
-#include <utime.h>
+#include <unistd.h>
 
 #include <chrono>
 #include <cstdlib>
@@ -30,18 +30,21 @@
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/parseint.h>
+#include <android-base/unique_fd.h>
 
 namespace {
 
 const char BOOTSTAT_DATA_DIR[] = "/data/misc/bootstat/";
 
-// Given a boot even record file at |path|, extracts the event's relative time
-// from the record into |uptime|.
-bool ParseRecordEventTime(const std::string& path, int32_t* uptime) {
+// Given a boot even record file |name| in the directory |dir_fd| (or at the
+// path |name| if |dir_fd| is AT_FDCWD), extracts the event's relative time
+// from the record into |uptime|. |path| is only used in error messages.
+bool ParseRecordEventTime(int dir_fd, const char* name, const std::string& path,
+                          int32_t* uptime) {
   DCHECK_NE(static_cast<int32_t*>(nullptr), uptime);
 
   struct stat file_stat;
-  if (stat(path.c_str(), &file_stat) == -1) {
+  if (fstatat(dir_fd, name, &file_stat, 0) == -1) {
     PLOG(ERROR) << "Failed to read " << path;
     return false;
   }
@@ -68,31 +71,22 @@ void BootEventRecordStore::AddBootEvent(const std::string& event) {
 // optimize on-disk size requirements and small-file thrashing.
 void BootEventRecordStore::AddBootEventWithValue(const std::string& event, int32_t value) {
   std::string record_path = GetBootEventPath(event);
-  int record_fd = creat(record_path.c_str(), S_IRUSR | S_IWUSR);
+  android::base::unique_fd record_fd(
+      open(record_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR));
   if (record_fd == -1) {
     PLOG(ERROR) << "Failed to create " << record_path;
     return;
   }
 
-  // Fill out the stat structure for |record_path| in order to get the atime to
-  // set in the utime() call.
-  struct stat file_stat;
-  if (stat(record_path.c_str(), &file_stat) == -1) {
-    PLOG(ERROR) << "Failed to read " << record_path;
-    close(record_fd);
-    return;
-  }
-
-  // Set the |modtime| of the file to store the value of the boot event while
-  // preserving the |actime| (as read by stat).
-  struct utimbuf times = {/* actime */ file_stat.st_atime, /* modtime */ value};
-  if (utime(record_path.c_str(), &times) == -1) {
+  // Set the |mtime| of the file to store the value of the boot event while
+  // preserving the |atime|, through the open descriptor so that the path isn't
+  // looked up again.
+  const struct timespec times[] = {{/* tv_sec */ 0, /* tv_nsec */ UTIME_OMIT},
+                                   {/* tv_sec */ value, /* tv_nsec */ 0}};
+  if (futimens(record_fd, times) == -1) {
     PLOG(ERROR) << "Failed to set mtime for " << record_path;
-    close(record_fd);
     return;
   }
-
-  close(record_fd);
 }
 
 bool BootEventRecordStore::GetBootEvent(const std::string& event, BootEventRecord* record) const {
@@ -101,7 +95,7 @@ bool BootEventRecordStore::GetBootEvent(const std::string& event, BootEventRecor
 
   const std::string record_path = GetBootEventPath(event);
   int32_t uptime;
-  if (!ParseRecordEventTime(record_path, &uptime)) {
+  if (!ParseRecordEventTime(AT_FDCWD, record_path.c_str(), record_path, &uptime)) {
     LOG(ERROR) << "Failed to parse boot time record: " << record_path;
     return false;
   }
@@ -126,14 +120,17 @@ std::vector<BootEventRecordStore::BootEventRecord> BootEventRecordStore::GetAllB
       continue;
     }
 
+    // Stat the record relative to the directory, rather than looking up the
+    // store path again for each of them.
     const std::string event = entry->d_name;
-    BootEventRecord record;
-    if (!GetBootEvent(event, &record)) {
+    int32_t uptime;
+    if (!ParseRecordEventTime(dirfd(dir.get()), entry->d_name, GetBootEventPath(event),
+                              &uptime)) {
       LOG(ERROR) << "Failed to parse boot time event: " << event;
       continue;
     }
 
-    events.push_back(record);
+    events.emplace_back(event, uptime);
   }
 
   return events;
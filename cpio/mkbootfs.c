@@ -6,6 +6,7 @@
 #include <ctype.h>
 
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <dirent.h>
 
@@ -41,6 +42,10 @@ struct fs_config_entry {
 };
 
 static struct fs_config_entry* canned_config = NULL;
+/* canned_config sorted by name for bsearch, and the entry for paths not in it. */
+static struct fs_config_entry** canned_config_by_name = NULL;
+static int canned_config_count = 0;
+static struct fs_config_entry* canned_config_default = NULL;
 static char *target_out_path = NULL;
 
 /* Each line in the canned file should be a path plus three ints (uid,
@@ -63,22 +68,25 @@ static void fix_stat(const char *path, struct stat *s)
         // Use the list of file uid/gid/modes loaded from the file
         // given with -f.
 
-        struct fs_config_entry* empty_path_config = NULL;
-        struct fs_config_entry* p;
-        for (p = canned_config; p->name; ++p) {
-            if (!p->name[0]) {
-                empty_path_config = p;
-            }
-            if (strcmp(p->name, path) == 0) {
-                s->st_uid = p->uid;
-                s->st_gid = p->gid;
-                s->st_mode = p->mode | (s->st_mode & ~07777);
-                return;
+        // The first entry for a path wins, and it is the first one in
+        // canned_config_by_name too.
+        int lo = 0, hi = canned_config_count;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (strcmp(canned_config_by_name[mid]->name, path) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
             }
         }
-        s->st_uid = empty_path_config->uid;
-        s->st_gid = empty_path_config->gid;
-        s->st_mode = empty_path_config->mode | (s->st_mode & ~07777);
+        struct fs_config_entry* p = canned_config_default;
+        if (lo < canned_config_count && strcmp(canned_config_by_name[lo]->name, path) == 0) {
+            p = canned_config_by_name[lo];
+        }
+        if (p == NULL) die("no canned config for '%s'", path);
+        s->st_uid = p->uid;
+        s->st_gid = p->gid;
+        s->st_mode = p->mode | (s->st_mode & ~07777);
     } else {
         // Use the compiled-in fs_config() function.
         unsigned st_mode = s->st_mode;
@@ -88,6 +96,16 @@ static void fix_stat(const char *path, struct stat *s)
     }
 }
 
+/* Pads the output with zeroes to a multiple of alignment, a power of 2. */
+static void _pad(int alignment)
+{
+    static const char zeroes[0x100];
+    int count = -total_size & (alignment - 1);
+
+    fwrite(zeroes, 1, count, stdout);
+    total_size += count;
+}
+
 static void _eject(struct stat *s, char *out, int olen, char *data, unsigned datasize)
 {
     // Nothing is special about this value, just picked something in the
@@ -95,10 +113,7 @@ static void _eject(struct stat *s, char *out, int olen, char *data, unsigned dat
     // values which may be special.
     static unsigned next_inode = 300000;
 
-    while(total_size & 3) {
-        total_size++;
-        putchar(0);
-    }
+    _pad(4);
 
     fix_stat(out, s);
 //    fprintf(stderr, "_eject %s: mode=0%o\n", out, s->st_mode);
@@ -127,10 +142,7 @@ static void _eject(struct stat *s, char *out, int olen, char *data, unsigned dat
 
     if(strlen(out) != (unsigned int)olen) die("ACK!");
 
-    while(total_size & 3) {
-        total_size++;
-        putchar(0);
-    }
+    _pad(4);
 
     if(datasize) {
         fwrite(data, datasize, 1, stdout);
@@ -144,10 +156,7 @@ static void _eject_trailer()
     memset(&s, 0, sizeof(s));
     _eject(&s, TRAILER, 10, 0, 0);
 
-    while(total_size & 0xff) {
-        total_size++;
-        putchar(0);
-    }
+    _pad(0x100);
 }
 
 static void _archive(char *in, char *out, int ilen, int olen);
@@ -241,22 +250,22 @@ static void _archive(char *in, char *out, int ilen, int olen)
     if(lstat(in, &s)) die("could not stat '%s'\n", in);
 
     if(S_ISREG(s.st_mode)){
-        char *tmp;
+        char *tmp = NULL;
         int fd;
 
         fd = open(in, O_RDONLY);
         if(fd < 0) die("cannot open '%s' for read", in);
 
-        tmp = (char*) malloc(s.st_size);
-        if(tmp == 0) die("cannot allocate %d bytes", s.st_size);
-
-        if(read(fd, tmp, s.st_size) != s.st_size) {
-            die("cannot read %d bytes", s.st_size);
+        // Map the file rather than copy it: it is only written straight out.
+        if(s.st_size > 0) {
+            tmp = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(tmp == MAP_FAILED) die("cannot map %d bytes of '%s'", s.st_size, in);
+            madvise(tmp, s.st_size, MADV_SEQUENTIAL);
         }
 
         _eject(&s, out, olen, tmp, s.st_size);
 
-        free(tmp);
+        if(tmp) munmap(tmp, s.st_size);
         close(fd);
     } else if(S_ISDIR(s.st_mode)) {
         _eject(&s, out, olen, 0, 0);
@@ -283,6 +292,15 @@ void archive(const char *start, const char *prefix)
     _archive_dir(in, out, strlen(in), strlen(out));
 }
 
+/* Sorts by name, keeping the order of the file for the same name. */
+static int compare_canned(const void* a, const void* b) {
+    const struct fs_config_entry* ea = *(const struct fs_config_entry**)a;
+    const struct fs_config_entry* eb = *(const struct fs_config_entry**)b;
+    int result = strcmp(ea->name, eb->name);
+    if (result != 0) return result;
+    return ea < eb ? -1 : ea > eb;
+}
+
 static void read_canned_config(char* filename)
 {
     int allocated = 8;
@@ -326,6 +344,17 @@ static void read_canned_config(char* filename)
     canned_config[used].name = NULL;
 
     fclose(f);
+
+    // Paths that aren't listed get the last entry without a path.
+    canned_config_by_name =
+        (struct fs_config_entry**)malloc((used + 1) * sizeof(struct fs_config_entry*));
+    if (canned_config_by_name == NULL) die("failed to allocate memory");
+    for (int i = 0; i < used; ++i) {
+        if (!canned_config[i].name[0]) canned_config_default = &canned_config[i];
+        canned_config_by_name[i] = &canned_config[i];
+    }
+    canned_config_count = used;
+    qsort(canned_config_by_name, used, sizeof(struct fs_config_entry*), compare_canned);
 }
 
 
@@ -348,6 +377,10 @@ int main(int argc, char *argv[])
 
     if(argc == 0) die("no directories to process?!");
 
+    // The output is usually piped into a compressor: write it in large chunks.
+    static char stdout_buffer[1024 * 1024];
+    setvbuf(stdout, stdout_buffer, _IOFBF, sizeof(stdout_buffer));
+
     while(argc-- > 0){
         char *x = strchr(*argv, '=');
         if(x != 0) {
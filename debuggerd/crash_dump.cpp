@@ -26,10 +26,12 @@
 #include <syscall.h>
 #include <unistd.h>
 
+#include <chrono>
 #include <limits>
 #include <map>
 #include <memory>
 #include <set>
+#include <string>
 #include <vector>
 
 #include <android-base/file.h>
@@ -188,6 +190,27 @@ static bool activity_manager_notify(pid_t pid, int signal, const std::string& am
   return true;
 }
 
+// Keeps track of how long each phase of a dump took, so that the time a crash
+// takes can be broken down from the tombstone and the log.
+class PhaseTimer {
+ public:
+  PhaseTimer() : start_(std::chrono::steady_clock::now()) {}
+
+  void Finish(const char* phase) {
+    auto now = std::chrono::steady_clock::now();
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(now - start_).count();
+    summary_ += StringPrintf("%s%s %lld.%03lldms", summary_.empty() ? "" : ", ", phase,
+                             static_cast<long long>(us / 1000), static_cast<long long>(us % 1000));
+    start_ = now;
+  }
+
+  const std::string& summary() const { return summary_; }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+  std::string summary_;
+};
+
 // Globals used by the abort handler.
 static pid_t g_target_thread = -1;
 static bool g_tombstoned_connected = false;
@@ -411,6 +434,7 @@ int main(int argc, char** argv) {
   }
 
   ATRACE_NAME("after reparent");
+  PhaseTimer timer;
   pid_t pseudothread_tid;
   DebuggerdDumpType dump_type;
   uintptr_t abort_msg_address = 0;
@@ -491,6 +515,7 @@ int main(int argc, char** argv) {
       thread_info[thread] = std::move(info);
     }
   }
+  timer.Finish("ptrace");
 
   // Trace the pseudothread with PTRACE_O_TRACECLONE and tell it to fork.
   if (!ptrace_seize_thread(target_proc_fd, pseudothread_tid, &error, PTRACE_O_TRACECLONE)) {
@@ -508,6 +533,7 @@ int main(int argc, char** argv) {
 
   // The pseudothread can die now.
   fork_exit_write.reset();
+  timer.Finish("fork");
 
   // Defer the message until later, for readability.
   bool wait_for_gdb = android::base::GetBoolProperty("debug.debuggerd.wait_for_gdb", false);
@@ -530,6 +556,7 @@ int main(int argc, char** argv) {
       PLOG(ERROR) << "failed to detach from thread " << tid;
     }
   }
+  timer.Finish("resume");
 
   // Drop our capabilities now that we've fetched all of the information we need.
   drop_capabilities();
@@ -540,6 +567,7 @@ int main(int argc, char** argv) {
     g_tombstoned_connected =
         tombstoned_connect(g_target_thread, &g_tombstoned_socket, &g_output_fd, dump_type);
   }
+  timer.Finish("tombstoned_connect");
 
   if (g_tombstoned_connected) {
     if (TEMP_FAILURE_RETRY(dup2(g_output_fd.get(), STDOUT_FILENO)) == -1) {
@@ -594,6 +622,13 @@ int main(int argc, char** argv) {
                         abort_msg_address, &open_files, &amfd_data);
     }
   }
+  timer.Finish("dump");
+
+  // The output fd is still open as stdout, so the phases so far end up at the
+  // bottom of the tombstone.
+  if (!backtrace) {
+    dprintf(STDOUT_FILENO, "\ncrash_dump phases: %s\n", timer.summary().c_str());
+  }
 
   if (fatal_signal) {
     // Don't try to notify ActivityManager if it just crashed, or we might hang until timeout.
@@ -620,6 +655,9 @@ int main(int argc, char** argv) {
   if (g_tombstoned_connected && !tombstoned_notify_completion(g_tombstoned_socket.get())) {
     LOG(ERROR) << "failed to notify tombstoned of completion";
   }
+  timer.Finish("notify");
+
+  LOG(INFO) << "dump of process " << target_process << " phases: " << timer.summary();
 
   return 0;
 }
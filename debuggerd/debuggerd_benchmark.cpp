@@ -18,11 +18,15 @@
 #include <errno.h>
 #include <sched.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include <benchmark/benchmark.h>
 #include <debuggerd/client.h>
@@ -63,7 +67,7 @@ static std::chrono::duration<double> GetMaximumPause(std::atomic<ThreadState>& s
   return max_diff;
 }
 
-static void PerformDump() {
+static void PerformDump(DebuggerdDumpType dump_type = kDebuggerdNativeBacktrace) {
   pid_t target = getpid();
   pid_t forkpid = fork();
   if (forkpid == -1) {
@@ -84,7 +88,7 @@ static void PerformDump() {
       err(1, "failed to open /dev/null");
     }
 
-    if (!debuggerd_trigger_dump(target, kDebuggerdNativeBacktrace, 1000, std::move(output_fd))) {
+    if (!debuggerd_trigger_dump(target, dump_type, 5000, std::move(output_fd))) {
       errx(1, "failed to trigger dump");
     }
 
@@ -125,4 +129,105 @@ static void BM_maximum_pause_debuggerd(benchmark::State& state) {
 BENCHMARK(BM_maximum_pause_noop)->Iterations(128)->UseManualTime();
 BENCHMARK(BM_maximum_pause_debuggerd)->Iterations(128)->UseManualTime();
 
+// Keeps |count| idle threads alive for as long as it is.
+class IdleThreads {
+ public:
+  explicit IdleThreads(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      threads_.emplace_back([this]() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return stopping_; });
+      });
+    }
+  }
+
+  ~IdleThreads() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+};
+
+// Keeps |count| separate mappings alive for as long as it is.
+class ManyMaps {
+ public:
+  explicit ManyMaps(size_t count) {
+    size_t page_size = getpagesize();
+    // Alternate the protection of the pages, so that the kernel can't merge neighbouring maps.
+    size_ = 2 * count * page_size;
+    base_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base_ == MAP_FAILED) {
+      err(1, "mmap failed");
+    }
+    for (size_t i = 0; i < count; ++i) {
+      void* page = static_cast<char*>(base_) + (2 * i + 1) * page_size;
+      if (mprotect(page, page_size, PROT_NONE) != 0) {
+        err(1, "mprotect failed");
+      }
+    }
+  }
+
+  ~ManyMaps() { munmap(base_, size_); }
+
+ private:
+  void* base_;
+  size_t size_;
+};
+
+// The time an entire dump takes, from the request to the end of the output,
+// for a process with state.range(0) extra threads.
+static void BM_dump_threads(benchmark::State& state) {
+  IdleThreads threads(state.range(0));
+  for (auto _ : state) {
+    PerformDump();
+  }
+}
+BENCHMARK(BM_dump_threads)->Arg(0)->Arg(16)->Arg(128)->Iterations(32)->Unit(benchmark::kMillisecond);
+
+// The same, for a full tombstone, which also dumps the maps.
+static void BM_dump_tombstone_threads(benchmark::State& state) {
+  IdleThreads threads(state.range(0));
+  for (auto _ : state) {
+    PerformDump(kDebuggerdTombstone);
+  }
+}
+BENCHMARK(BM_dump_tombstone_threads)
+    ->Arg(0)
+    ->Arg(16)
+    ->Arg(128)
+    ->Iterations(32)
+    ->Unit(benchmark::kMillisecond);
+
+// A full tombstone of a process with state.range(0) extra mappings.
+static void BM_dump_tombstone_maps(benchmark::State& state) {
+  ManyMaps maps(state.range(0));
+  for (auto _ : state) {
+    PerformDump(kDebuggerdTombstone);
+  }
+}
+BENCHMARK(BM_dump_tombstone_maps)
+    ->Arg(0)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Iterations(32)
+    ->Unit(benchmark::kMillisecond);
+
+// How long the process is paused for while dumping with state.range(0) extra threads.
+static void BM_maximum_pause_debuggerd_threads(benchmark::State& state) {
+  IdleThreads threads(state.range(0));
+  BM_maximum_pause_impl(state, []() { PerformDump(); });
+}
+BENCHMARK(BM_maximum_pause_debuggerd_threads)->Arg(16)->Arg(128)->Iterations(32)->UseManualTime();
+
 BENCHMARK_MAIN();
@@ -59,25 +59,28 @@ static void dump_process_footer(log_t* log, pid_t pid) {
   _LOG(log, logtype::BACKTRACE, "\n----- end %d -----\n", pid);
 }
 
-void dump_backtrace_thread(int output_fd, unwindstack::Unwinder* unwinder,
-                           const ThreadInfo& thread) {
+static void dump_thread_unwind(int output_fd, const ThreadInfo& thread,
+                               const ThreadUnwind& unwind) {
   log_t log;
   log.tfd = output_fd;
   log.amfd_data = nullptr;
 
   _LOG(&log, logtype::BACKTRACE, "\n\"%s\" sysTid=%d\n", thread.thread_name.c_str(), thread.tid);
 
-  unwinder->SetRegs(thread.registers.get());
-  unwinder->Unwind();
-  if (unwinder->NumFrames() == 0) {
+  if (unwind.frames.empty()) {
     _LOG(&log, logtype::THREAD, "Unwind failed: tid = %d", thread.tid);
     return;
   }
 
-  log_backtrace(&log, unwinder, "  ");
+  log_backtrace(&log, unwind, "  ");
 }
 
-void dump_backtrace(android::base::unique_fd output_fd, unwindstack::Unwinder* unwinder,
+void dump_backtrace_thread(int output_fd, unwindstack::Unwinder* unwinder,
+                           const ThreadInfo& thread) {
+  dump_thread_unwind(output_fd, thread, unwind_thread(unwinder, thread));
+}
+
+void dump_backtrace(android::base::unique_fd output_fd, unwindstack::UnwinderFromPid* unwinder,
                     const std::map<pid_t, ThreadInfo>& thread_info, pid_t target_thread) {
   log_t log;
   log.tfd = output_fd.get();
@@ -89,12 +92,14 @@ void dump_backtrace(android::base::unique_fd output_fd, unwindstack::Unwinder* u
     return;
   }
 
+  std::map<pid_t, ThreadUnwind> unwinds = unwind_threads(unwinder, thread_info);
+
   dump_process_header(&log, target->second.pid, target->second.process_name.c_str());
 
-  dump_backtrace_thread(output_fd.get(), unwinder, target->second);
+  dump_thread_unwind(output_fd.get(), target->second, unwinds[target_thread]);
   for (const auto& [tid, info] : thread_info) {
     if (tid != target_thread) {
-      dump_backtrace_thread(output_fd.get(), unwinder, info);
+      dump_thread_unwind(output_fd.get(), info, unwinds[tid]);
     }
   }
 
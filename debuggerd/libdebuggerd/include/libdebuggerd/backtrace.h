@@ -31,11 +31,13 @@
 // Forward delcaration
 namespace unwindstack {
 class Unwinder;
+class UnwinderFromPid;
 }
 
 // Dumps a backtrace using a format similar to what Dalvik uses so that the result
 // can be intermixed in a bug report.
-void dump_backtrace(android::base::unique_fd output_fd, unwindstack::Unwinder* unwinder,
+// The threads are unwound in parallel, but written out in order.
+void dump_backtrace(android::base::unique_fd output_fd, unwindstack::UnwinderFromPid* unwinder,
                     const std::map<pid_t, ThreadInfo>& thread_info, pid_t target_thread);
 
 void dump_backtrace_header(int output_fd);
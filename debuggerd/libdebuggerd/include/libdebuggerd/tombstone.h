@@ -32,6 +32,7 @@
 // Forward declarations
 namespace unwindstack {
 class Unwinder;
+class UnwinderFromPid;
 }
 
 // The maximum number of frames to save when unwinding.
@@ -52,7 +53,8 @@ void engrave_tombstone(int tombstone_fd, unwindstack::Unwinder* unwinder,
 void engrave_tombstone_ucontext(int tombstone_fd, uint64_t abort_msg_address, siginfo_t* siginfo,
                                 ucontext_t* ucontext);
 
-void engrave_tombstone(android::base::unique_fd output_fd, unwindstack::Unwinder* unwinder,
+// The threads are unwound in parallel, but written out in order.
+void engrave_tombstone(android::base::unique_fd output_fd, unwindstack::UnwinderFromPid* unwinder,
                        const std::map<pid_t, ThreadInfo>& thread_info, pid_t target_thread,
                        uint64_t abort_msg_address, OpenFilesList* open_files,
                        std::string* amfd_data);
@@ -18,8 +18,10 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <unwindstack/Regs.h>
+#include <unwindstack/Unwinder.h>
 
 struct ThreadInfo {
   std::unique_ptr<unwindstack::Regs> registers;
@@ -35,3 +37,12 @@ struct ThreadInfo {
   int signo = 0;
   siginfo_t* siginfo = nullptr;
 };
+
+// What an unwind of one thread leaves behind, so that the unwinder can move on
+// to another thread before this one is written out.
+struct ThreadUnwind {
+  std::vector<unwindstack::FrameData> frames;
+  // The frames as Unwinder::FormatFrame prints them, with build ids.
+  std::vector<std::string> formatted_frames;
+  bool elf_from_memory_not_file = false;
+};
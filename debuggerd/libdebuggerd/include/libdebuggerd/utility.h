@@ -23,10 +23,13 @@
 #include <stdbool.h>
 #include <sys/types.h>
 
+#include <map>
 #include <string>
 
 #include <android-base/macros.h>
 
+#include "types.h"
+
 struct log_t {
   // Tombstone file descriptor.
   int tfd;
@@ -38,15 +41,22 @@ struct log_t {
   pid_t current_tid;
   // logd daemon crash, can block asking for logcat data, allow suppression.
   bool should_retrieve_logcat;
+  // If set, the output for tfd is collected here, and only written once
+  // kLogBufferSize bytes have accumulated or flush_log is called.
+  std::string* tfd_buffer;
 
   log_t()
       : tfd(-1),
         amfd_data(nullptr),
         crashed_tid(-1),
         current_tid(-1),
-        should_retrieve_logcat(true) {}
+        should_retrieve_logcat(true),
+        tfd_buffer(nullptr) {}
 };
 
+// The most output to hold in a log_t's tfd_buffer.
+static constexpr size_t kLogBufferSize = 32 * 1024;
+
 // List of types of logs to simplify the logging decision in _LOG
 enum logtype {
   HEADER,
@@ -72,12 +82,26 @@ typedef uint32_t word_t;
 // Log information onto the tombstone.
 void _LOG(log_t* log, logtype ltype, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
 
+// Writes out anything held in log->tfd_buffer.
+void flush_log(log_t* log);
+
 namespace unwindstack {
 class Unwinder;
+class UnwinderFromPid;
 class Memory;
 }
 
-void log_backtrace(log_t* log, unwindstack::Unwinder* unwinder, const char* prefix);
+void log_backtrace(log_t* log, const ThreadUnwind& unwind, const char* prefix);
+
+// Unwinds a copy of the thread's registers.
+ThreadUnwind unwind_thread(unwindstack::Unwinder* unwinder, const ThreadInfo& thread);
+
+// Unwinds all of the threads, spread over a few worker threads that share the
+// maps of unwinder. Any thread that a worker could not unwind is unwound again
+// with unwinder itself on the calling thread, which is the only one that can
+// read memory with ptrace.
+std::map<pid_t, ThreadUnwind> unwind_threads(unwindstack::UnwinderFromPid* unwinder,
+                                             const std::map<pid_t, ThreadInfo>& threads);
 
 void dump_memory(log_t* log, unwindstack::Memory* backtrace, uint64_t addr, const std::string&);
 
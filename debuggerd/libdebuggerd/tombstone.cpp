@@ -32,6 +32,7 @@
 #include <sys/stat.h>
 #include <time.h>
 
+#include <chrono>
 #include <memory>
 #include <string>
 
@@ -475,7 +476,8 @@ void dump_memory_and_code(log_t* log, unwindstack::Maps* maps, unwindstack::Memo
 }
 
 static bool dump_thread(log_t* log, unwindstack::Unwinder* unwinder, const ThreadInfo& thread_info,
-                        uint64_t abort_msg_address, bool primary_thread) {
+                        const ThreadUnwind& unwind, uint64_t abort_msg_address,
+                        bool primary_thread) {
   log->current_tid = thread_info.tid;
   if (!primary_thread) {
     _LOG(log, logtype::THREAD, "--- --- --- --- --- --- --- --- --- --- --- --- --- --- --- ---\n");
@@ -493,18 +495,14 @@ static bool dump_thread(log_t* log, unwindstack::Unwinder* unwinder, const Threa
 
   dump_registers(log, thread_info.registers.get());
 
-  // Unwind will mutate the registers, so make a copy first.
-  std::unique_ptr<unwindstack::Regs> regs_copy(thread_info.registers->Clone());
-  unwinder->SetRegs(regs_copy.get());
-  unwinder->Unwind();
-  if (unwinder->NumFrames() == 0) {
+  if (unwind.frames.empty()) {
     _LOG(log, logtype::THREAD, "Failed to unwind");
   } else {
     _LOG(log, logtype::BACKTRACE, "\nbacktrace:\n");
-    log_backtrace(log, unwinder, "    ");
+    log_backtrace(log, unwind, "    ");
 
     _LOG(log, logtype::STACK, "\nstack:\n");
-    dump_stack(log, unwinder->frames(), unwinder->GetMaps(), unwinder->GetProcessMemory().get());
+    dump_stack(log, unwind.frames, unwinder->GetMaps(), unwinder->GetProcessMemory().get());
   }
 
   if (primary_thread) {
@@ -692,31 +690,67 @@ void engrave_tombstone_ucontext(int tombstone_fd, uint64_t abort_msg_address, si
                     nullptr, nullptr);
 }
 
-void engrave_tombstone(unique_fd output_fd, unwindstack::Unwinder* unwinder,
+// Writes out the output of each section of a tombstone as soon as it is
+// finished, and keeps track of how long each one took.
+class SectionTimer {
+ public:
+  explicit SectionTimer(log_t* log) : log_(log), start_(std::chrono::steady_clock::now()) {}
+
+  void Finish(const char* section) {
+    flush_log(log_);
+    auto now = std::chrono::steady_clock::now();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - start_).count();
+    summary_ += StringPrintf("%s%s %lldms", summary_.empty() ? "" : ", ", section,
+                             static_cast<long long>(ms));
+    start_ = now;
+  }
+
+  const std::string& summary() { return summary_; }
+
+ private:
+  log_t* log_;
+  std::chrono::steady_clock::time_point start_;
+  std::string summary_;
+};
+
+void engrave_tombstone(unique_fd output_fd, unwindstack::UnwinderFromPid* unwinder,
                        const std::map<pid_t, ThreadInfo>& threads, pid_t target_thread,
                        uint64_t abort_msg_address, OpenFilesList* open_files,
                        std::string* amfd_data) {
   // don't copy log messages to tombstone unless this is a dev device
   bool want_logs = android::base::GetBoolProperty("ro.debuggable", false);
 
+  std::string buffer;
+  buffer.reserve(kLogBufferSize);
+
   log_t log;
   log.current_tid = target_thread;
   log.crashed_tid = target_thread;
   log.tfd = output_fd.get();
   log.amfd_data = amfd_data;
+  log.tfd_buffer = &buffer;
+
+  SectionTimer timer(&log);
 
   _LOG(&log, logtype::HEADER, "*** *** *** *** *** *** *** *** *** *** *** *** *** *** *** ***\n");
   dump_header_info(&log);
   dump_timestamp(&log, time(nullptr));
+  timer.Finish("header");
 
   auto it = threads.find(target_thread);
   if (it == threads.end()) {
     LOG(FATAL) << "failed to find target thread";
   }
-  dump_thread(&log, unwinder, it->second, abort_msg_address, true);
+  std::map<pid_t, ThreadUnwind> unwinds = unwind_threads(unwinder, threads);
+  timer.Finish("unwind");
+
+  dump_thread(&log, unwinder, it->second, unwinds[target_thread], abort_msg_address, true);
+  unwinds.erase(target_thread);
+  timer.Finish("crashing thread");
 
   if (want_logs) {
     dump_logs(&log, it->second.pid, 50);
+    timer.Finish("log tail");
   }
 
   for (auto& [tid, thread_info] : threads) {
@@ -724,15 +758,23 @@ void engrave_tombstone(unique_fd output_fd, unwindstack::Unwinder* unwinder,
       continue;
     }
 
-    dump_thread(&log, unwinder, thread_info, 0, false);
+    dump_thread(&log, unwinder, thread_info, unwinds[tid], 0, false);
+    // Nothing else needs the frames.
+    unwinds.erase(tid);
+    flush_log(&log);
   }
+  timer.Finish("other threads");
 
   if (open_files) {
     _LOG(&log, logtype::OPEN_FILES, "\nopen files:\n");
     dump_open_files_list(&log, *open_files, "    ");
+    timer.Finish("open files");
   }
 
   if (want_logs) {
     dump_logs(&log, it->second.pid, 0);
+    timer.Finish("logs");
   }
+
+  ALOGI("tombstone sections: %s", timer.summary().c_str());
 }
@@ -28,8 +28,13 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
@@ -40,8 +45,13 @@
 #include <unwindstack/Memory.h>
 #include <unwindstack/Unwinder.h>
 
+#include "libdebuggerd/tombstone.h"
+
 using android::base::unique_fd;
 
+// The most threads to unwind at once.
+static constexpr size_t kMaxUnwindJobs = 8;
+
 // Whitelist output desired in the logcat output.
 bool is_allowed_in_logcat(enum logtype ltype) {
   if ((ltype == HEADER)
@@ -66,6 +76,16 @@ static bool should_write_to_kmsg() {
 }
 
 __attribute__((__weak__, visibility("default")))
+void flush_log(log_t* log) {
+  if (log->tfd_buffer == nullptr || log->tfd_buffer->empty()) {
+    return;
+  }
+  if (!android::base::WriteFully(log->tfd, log->tfd_buffer->data(), log->tfd_buffer->size())) {
+    ALOGE("failed to write tombstone output: %s", strerror(errno));
+  }
+  log->tfd_buffer->clear();
+}
+
 void _LOG(log_t* log, enum logtype ltype, const char* fmt, ...) {
   bool write_to_tombstone = (log->tfd != -1);
   bool write_to_logcat = is_allowed_in_logcat(ltype)
@@ -83,7 +103,14 @@ void _LOG(log_t* log, enum logtype ltype, const char* fmt, ...) {
   if (msg.empty()) return;
 
   if (write_to_tombstone) {
-    TEMP_FAILURE_RETRY(write(log->tfd, msg.c_str(), msg.size()));
+    if (log->tfd_buffer != nullptr) {
+      log->tfd_buffer->append(msg);
+      if (log->tfd_buffer->size() >= kLogBufferSize) {
+        flush_log(log);
+      }
+    } else {
+      TEMP_FAILURE_RETRY(write(log->tfd, msg.c_str(), msg.size()));
+    }
   }
 
   if (write_to_logcat) {
@@ -424,8 +451,19 @@ const char* get_sigcode(const siginfo_t* si) {
   return "?";
 }
 
-void log_backtrace(log_t* log, unwindstack::Unwinder* unwinder, const char* prefix) {
-  if (unwinder->elf_from_memory_not_file()) {
+static ThreadUnwind capture_unwind(unwindstack::Unwinder* unwinder) {
+  ThreadUnwind unwind;
+  unwind.frames = unwinder->frames();
+  unwind.elf_from_memory_not_file = unwinder->elf_from_memory_not_file();
+  unwinder->SetDisplayBuildID(true);
+  for (const auto& frame : unwind.frames) {
+    unwind.formatted_frames.push_back(unwinder->FormatFrame(frame));
+  }
+  return unwind;
+}
+
+void log_backtrace(log_t* log, const ThreadUnwind& unwind, const char* prefix) {
+  if (unwind.elf_from_memory_not_file) {
     _LOG(log, logtype::BACKTRACE,
          "%sNOTE: Function names and BuildId information is missing for some frames due\n", prefix);
     _LOG(log, logtype::BACKTRACE,
@@ -437,8 +475,56 @@ void log_backtrace(log_t* log, unwindstack::Unwinder* unwinder, const char* pref
 #endif
   }
 
-  unwinder->SetDisplayBuildID(true);
-  for (size_t i = 0; i < unwinder->NumFrames(); i++) {
-    _LOG(log, logtype::BACKTRACE, "%s%s\n", prefix, unwinder->FormatFrame(i).c_str());
+  for (const auto& frame : unwind.formatted_frames) {
+    _LOG(log, logtype::BACKTRACE, "%s%s\n", prefix, frame.c_str());
+  }
+}
+
+ThreadUnwind unwind_thread(unwindstack::Unwinder* unwinder, const ThreadInfo& thread) {
+  // Unwind will mutate the registers, so make a copy first.
+  std::unique_ptr<unwindstack::Regs> regs_copy(thread.registers->Clone());
+  unwinder->SetRegs(regs_copy.get());
+  unwinder->Unwind();
+  return capture_unwind(unwinder);
+}
+
+std::map<pid_t, ThreadUnwind> unwind_threads(unwindstack::UnwinderFromPid* unwinder,
+                                             const std::map<pid_t, ThreadInfo>& threads) {
+  std::vector<const ThreadInfo*> infos;
+  for (const auto& [tid, info] : threads) {
+    infos.push_back(&info);
+  }
+  std::vector<ThreadUnwind> unwinds(infos.size());
+
+  // Unwinding in the crashing process itself, as the fallback handler does,
+  // has no business starting threads.
+  size_t jobs = std::min<size_t>({kMaxUnwindJobs, std::thread::hardware_concurrency(),
+                                  infos.size()});
+  if (jobs > 1 && unwinder->pid() != getpid()) {
+    std::atomic_size_t next(0);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < jobs; i++) {
+      workers.emplace_back([&]() {
+        unwindstack::UnwinderFromPid worker(kMaxFrames, unwinder->pid());
+        if (!worker.Init(infos[0]->registers->Arch(), unwinder->GetMaps())) {
+          return;
+        }
+        for (size_t index = next++; index < infos.size(); index = next++) {
+          unwinds[index] = unwind_thread(&worker, *infos[index]);
+        }
+      });
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+
+  std::map<pid_t, ThreadUnwind> result;
+  for (size_t i = 0; i < infos.size(); i++) {
+    if (unwinds[i].frames.empty()) {
+      unwinds[i] = unwind_thread(unwinder, *infos[i]);
+    }
+    result.emplace(infos[i]->tid, std::move(unwinds[i]));
   }
+  return result;
 }
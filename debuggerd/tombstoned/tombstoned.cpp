@@ -99,9 +99,14 @@ class CrashQueue {
   }
 
   static CrashQueue* for_tombstones() {
+    // Each dump goes to its own temporary file and only takes a slot once it's
+    // complete, so crashes of different processes can be dumped at the same time
+    // instead of queueing up behind each other (e.g. during a crash loop).
+    static const int max_tombstones = GetIntProperty("tombstoned.max_tombstone_count", 10, 2);
     static CrashQueue queue("/data/tombstones", "tombstone_" /* file_name_prefix */,
-                            GetIntProperty("tombstoned.max_tombstone_count", 10),
-                            1 /* max_concurrent_dumps */);
+                            max_tombstones,
+                            GetIntProperty("tombstoned.max_concurrent_tombstones", 1, 1,
+                                           max_tombstones - 1) /* max_concurrent_dumps */);
     return &queue;
   }
 
@@ -164,14 +169,14 @@ class CrashQueue {
     time_t oldest_time = std::numeric_limits<time_t>::max();
 
     for (size_t i = 0; i < max_artifacts_; ++i) {
-      std::string path = StringPrintf("%s/%s%02zu", dir_path_.c_str(), file_name_prefix_.c_str(), i);
+      std::string file_name = StringPrintf("%s%02zu", file_name_prefix_.c_str(), i);
       struct stat st;
-      if (stat(path.c_str(), &st) != 0) {
+      if (fstatat(dir_fd_, file_name.c_str(), &st, 0) != 0) {
         if (errno == ENOENT) {
           oldest_tombstone = i;
           break;
         } else {
-          PLOG(ERROR) << "failed to stat " << path;
+          PLOG(ERROR) << "failed to stat " << dir_path_ << "/" << file_name;
           continue;
         }
       }
@@ -101,7 +101,8 @@ bool GetVarHandler(FastbootDevice* device, const std::vector<std::string>& args)
             {FB_VAR_BATTERY_VOLTAGE, {GetBatteryVoltage, nullptr}},
             {FB_VAR_BATTERY_SOC_OK, {GetBatterySoCOk, nullptr}},
             {FB_VAR_HW_REVISION, {GetHardwareRevision, nullptr}},
-            {FB_VAR_SUPER_PARTITION_NAME, {GetSuperPartitionName, nullptr}}};
+            {FB_VAR_SUPER_PARTITION_NAME, {GetSuperPartitionName, nullptr}},
+            {FB_VAR_DOWNLOAD_THROUGHPUT, {GetDownloadThroughput, nullptr}}};
 
     if (args.size() < 2) {
         return device->WriteFail("Missing argument");
@@ -186,7 +187,9 @@ bool DownloadHandler(FastbootDevice* device, const std::vector<std::string>& arg
         return false;
     }
 
+    auto start = std::chrono::steady_clock::now();
     if (device->HandleData(true, &device->download_data())) {
+        device->set_last_download(size, std::chrono::steady_clock::now() - start);
         return device->WriteStatus(FastbootResult::OKAY, "");
     }
 
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -58,6 +59,14 @@ class FastbootDevice {
 
     void set_active_slot(const std::string& active_slot) { active_slot_ = active_slot; }
 
+    // The size of the last completed download, and how long its data phase took.
+    void set_last_download(size_t size, std::chrono::nanoseconds duration) {
+        last_download_size_ = size;
+        last_download_duration_ = duration;
+    }
+    size_t last_download_size() const { return last_download_size_; }
+    std::chrono::nanoseconds last_download_duration() const { return last_download_duration_; }
+
   private:
     const std::unordered_map<std::string, CommandHandler> kCommandMap;
 
@@ -67,4 +76,6 @@ class FastbootDevice {
     android::sp<android::hardware::fastboot::V1_0::IFastboot> fastboot_hal_;
     std::vector<char> download_data_;
     std::string active_slot_;
+    size_t last_download_size_ = 0;
+    std::chrono::nanoseconds last_download_duration_{0};
 };
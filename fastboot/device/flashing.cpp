@@ -20,6 +20,7 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <deque>
 #include <memory>
 #include <set>
 #include <string>
@@ -70,23 +71,75 @@ void WipeOverlayfsForPartition(FastbootDevice* device, const std::string& partit
 
 }  // namespace
 
-int FlashRawDataChunk(int fd, const char* data, size_t len) {
-    size_t ret = 0;
-    while (ret < len) {
-        int this_len = std::min(static_cast<size_t>(1048576UL * 8), len - ret);
-        int this_ret = write(fd, data, this_len);
-        if (this_ret < 0) {
-            PLOG(ERROR) << "Failed to flash data of len " << len;
-            return -1;
+// Writes to a block device, and starts writing back each window of
+// kWriteBehindWindow bytes to the device as soon as it is complete, so that
+// the device is busy while the rest of the image is still being copied into
+// the page cache. At most kWriteBehindDepth windows are in flight: beyond
+// that, the oldest one is waited for, so that a large image doesn't pile up
+// dirty pages that are only written back once it's all been copied.
+class BlockWriter {
+  public:
+    explicit BlockWriter(int fd) : fd_(fd) {}
+
+    int Write(const char* data, size_t len) {
+        size_t ret = 0;
+        while (ret < len) {
+            int this_len = std::min(static_cast<size_t>(1048576UL * 8), len - ret);
+            int this_ret = write(fd_, data, this_len);
+            if (this_ret < 0) {
+                PLOG(ERROR) << "Failed to flash data of len " << len;
+                return -1;
+            }
+            data += this_ret;
+            ret += this_ret;
+            offset_ += this_ret;
+            WriteBehind();
         }
-        data += this_ret;
-        ret += this_ret;
+        return 0;
+    }
+
+    int Skip(size_t len) {
+        offset_ = lseek64(fd_, len, SEEK_CUR);
+        return offset_ >= 0 ? 0 : -errno;
+    }
+
+    // Waits for all the data to be on the device, so that write errors are
+    // reported before the flash is.
+    int Finish() {
+        if (fsync(fd_) < 0) {
+            PLOG(ERROR) << "Failed to sync flashed data";
+            return -errno;
+        }
+        return 0;
     }
-    return 0;
-}
 
-int FlashRawData(int fd, const std::vector<char>& downloaded_data) {
-    int ret = FlashRawDataChunk(fd, downloaded_data.data(), downloaded_data.size());
+  private:
+    static constexpr off64_t kWriteBehindWindow = 8 * 1024 * 1024;
+    static constexpr size_t kWriteBehindDepth = 4;
+
+    void WriteBehind() {
+        while (offset_ - window_start_ >= kWriteBehindWindow) {
+            // Failures here only lose the overlap: Finish() reports write errors.
+            sync_file_range(fd_, window_start_, kWriteBehindWindow, SYNC_FILE_RANGE_WRITE);
+            in_flight_.push_back(window_start_);
+            window_start_ += kWriteBehindWindow;
+            if (in_flight_.size() > kWriteBehindDepth) {
+                sync_file_range(fd_, in_flight_.front(), kWriteBehindWindow,
+                                SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                                        SYNC_FILE_RANGE_WAIT_AFTER);
+                in_flight_.pop_front();
+            }
+        }
+    }
+
+    int fd_;
+    off64_t offset_ = 0;
+    off64_t window_start_ = 0;
+    std::deque<off64_t> in_flight_;
+};
+
+int FlashRawData(BlockWriter* writer, const std::vector<char>& downloaded_data) {
+    int ret = writer->Write(downloaded_data.data(), downloaded_data.size());
     if (ret < 0) {
         return -errno;
     }
@@ -94,29 +147,35 @@ int FlashRawData(int fd, const std::vector<char>& downloaded_data) {
 }
 
 int WriteCallback(void* priv, const void* data, size_t len) {
-    int fd = reinterpret_cast<long long>(priv);
+    BlockWriter* writer = reinterpret_cast<BlockWriter*>(priv);
     if (!data) {
-        return lseek64(fd, len, SEEK_CUR) >= 0 ? 0 : -errno;
+        return writer->Skip(len);
     }
-    return FlashRawDataChunk(fd, reinterpret_cast<const char*>(data), len);
+    return writer->Write(reinterpret_cast<const char*>(data), len);
 }
 
-int FlashSparseData(int fd, std::vector<char>& downloaded_data) {
+int FlashSparseData(BlockWriter* writer, std::vector<char>& downloaded_data) {
     struct sparse_file* file = sparse_file_import_buf(downloaded_data.data(), true, false);
     if (!file) {
         return -ENOENT;
     }
-    return sparse_file_callback(file, false, false, WriteCallback, reinterpret_cast<void*>(fd));
+    return sparse_file_callback(file, false, false, WriteCallback, writer);
 }
 
 int FlashBlockDevice(int fd, std::vector<char>& downloaded_data) {
     lseek64(fd, 0, SEEK_SET);
+    BlockWriter writer(fd);
+    int ret;
     if (downloaded_data.size() >= sizeof(SPARSE_HEADER_MAGIC) &&
         *reinterpret_cast<uint32_t*>(downloaded_data.data()) == SPARSE_HEADER_MAGIC) {
-        return FlashSparseData(fd, downloaded_data);
+        ret = FlashSparseData(&writer, downloaded_data);
     } else {
-        return FlashRawData(fd, downloaded_data);
+        ret = FlashRawData(&writer, downloaded_data);
+    }
+    if (ret < 0) {
+        return ret;
     }
+    return writer.Finish();
 }
 
 int Flash(FastbootDevice* device, const std::string& partition_name) {
@@ -25,16 +25,24 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
+#include <android-base/strings.h>
 
 constexpr int kMaxPacketSizeFs = 64;
 constexpr int kMaxPacketSizeHs = 512;
 constexpr int kMaxPacketsizeSs = 1024;
 
+// As in adbd, not all USB controllers support operations larger than 16k, so only go above that
+// once the host has negotiated a SuperSpeed link, which needs more and larger operations in flight
+// to be kept busy during a download.
 constexpr size_t kFbFfsNumBufs = 16;
 constexpr size_t kFbFfsBufSize = 16384;
 
+constexpr size_t kFbFfsSuperSpeedNumBufs = 32;
+constexpr size_t kFbFfsSuperSpeedBufSize = 65536;
+
 constexpr const char* kUsbFfsFastbootEp0 = "/dev/usb-ffs/fastboot/ep0";
 constexpr const char* kUsbFfsFastbootOut = "/dev/usb-ffs/fastboot/ep1";
 constexpr const char* kUsbFfsFastbootIn = "/dev/usb-ffs/fastboot/ep2";
@@ -240,13 +248,39 @@ err:
     return false;
 }
 
+// The UDC reports the negotiated speed once the host has enabled the function.
+static bool IsSuperSpeedLink() {
+    std::string controller = android::base::GetProperty("sys.usb.controller", "");
+    std::string speed;
+    if (controller.empty() ||
+        !android::base::ReadFileToString("/sys/class/udc/" + controller + "/current_speed",
+                                         &speed)) {
+        return false;
+    }
+    return android::base::StartsWith(speed, "super-speed");
+}
+
 ClientUsbTransport::ClientUsbTransport()
-    : handle_(std::unique_ptr<usb_handle>(create_usb_handle(kFbFfsNumBufs, kFbFfsBufSize))) {
+    : handle_(std::unique_ptr<usb_handle>(
+              create_usb_handle(kFbFfsSuperSpeedNumBufs, kFbFfsBufSize))) {
     if (!InitFunctionFs(handle_.get())) {
         handle_.reset(nullptr);
     }
 }
 
+size_t ClientUsbTransport::MaxTransferSize() {
+    // The link speed is only known once the host is talking to us, and can change if it
+    // reconnects, which Close() covers.
+    if (num_bufs_ == 0) {
+        bool super_speed = IsSuperSpeedLink();
+        num_bufs_ = super_speed ? kFbFfsSuperSpeedNumBufs : kFbFfsNumBufs;
+        handle_->io_size = super_speed ? kFbFfsSuperSpeedBufSize : kFbFfsBufSize;
+        LOG(INFO) << "Using " << num_bufs_ << " USB transfers of " << handle_->io_size
+                  << " bytes" << (super_speed ? " (super-speed link)" : "");
+    }
+    return num_bufs_ * handle_->io_size;
+}
+
 ssize_t ClientUsbTransport::Read(void* data, size_t len) {
     if (handle_ == nullptr || len > SSIZE_MAX) {
         return -1;
@@ -254,7 +288,7 @@ ssize_t ClientUsbTransport::Read(void* data, size_t len) {
     char* char_data = static_cast<char*>(data);
     size_t bytes_read_total = 0;
     while (bytes_read_total < len) {
-        auto bytes_to_read = std::min(len - bytes_read_total, kFbFfsNumBufs * kFbFfsBufSize);
+        auto bytes_to_read = std::min(len - bytes_read_total, MaxTransferSize());
         auto bytes_read_now =
                 handle_->read(handle_.get(), char_data, bytes_to_read, true /* allow_partial */);
         if (bytes_read_now < 0) {
@@ -276,8 +310,8 @@ ssize_t ClientUsbTransport::Write(const void* data, size_t len) {
     const char* char_data = reinterpret_cast<const char*>(data);
     size_t bytes_written_total = 0;
     while (bytes_written_total < len) {
-        auto bytes_to_write = std::min(len - bytes_written_total, kFbFfsNumBufs * kFbFfsBufSize);
-        auto bytes_written_now = handle_->write(handle_.get(), data, bytes_to_write);
+        auto bytes_to_write = std::min(len - bytes_written_total, MaxTransferSize());
+        auto bytes_written_now = handle_->write(handle_.get(), char_data, bytes_to_write);
         if (bytes_written_now < 0) {
             return bytes_written_total == 0 ? -1 : bytes_written_total;
         }
@@ -295,5 +329,6 @@ int ClientUsbTransport::Close() {
         return -1;
     }
     CloseFunctionFs(handle_.get());
+    num_bufs_ = 0;
     return 0;
 }
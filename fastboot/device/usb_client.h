@@ -31,7 +31,12 @@ class ClientUsbTransport : public Transport {
     int Close() override;
 
   private:
+    // The most that can be transferred by one call to the handle, sized for the link speed.
+    size_t MaxTransferSize();
+
     std::unique_ptr<usb_handle> handle_;
+    // The number of transfers in flight for each call, or 0 until the link speed is known.
+    size_t num_bufs_ = 0;
 
     DISALLOW_COPY_AND_ASSIGN(ClientUsbTransport);
 };
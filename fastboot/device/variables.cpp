@@ -253,6 +253,23 @@ bool GetMaxDownloadSize(FastbootDevice* /* device */, const std::vector<std::str
     return true;
 }
 
+bool GetDownloadThroughput(FastbootDevice* device, const std::vector<std::string>& /* args */,
+                           std::string* message) {
+    auto usecs = std::chrono::duration_cast<std::chrono::microseconds>(
+                         device->last_download_duration())
+                         .count();
+    if (device->last_download_size() == 0 || usecs == 0) {
+        *message = "Nothing has been downloaded";
+        return false;
+    }
+    // In KiB/s, followed by what it was measured on.
+    uint64_t kib_per_sec = device->last_download_size() * 1000000ULL / usecs / 1024;
+    *message = android::base::StringPrintf("%" PRIu64 " (%zu bytes in %" PRId64 " us)", kib_per_sec,
+                                           device->last_download_size(),
+                                           static_cast<int64_t>(usecs));
+    return true;
+}
+
 bool GetUnlocked(FastbootDevice* /* device */, const std::vector<std::string>& /* args */,
                  std::string* message) {
     *message = GetDeviceLockStatus() ? "no" : "yes";
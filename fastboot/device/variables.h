@@ -39,6 +39,8 @@ bool GetSlotUnbootable(FastbootDevice* device, const std::vector<std::string>& a
                        std::string* message);
 bool GetMaxDownloadSize(FastbootDevice* device, const std::vector<std::string>& args,
                         std::string* message);
+bool GetDownloadThroughput(FastbootDevice* device, const std::vector<std::string>& args,
+                           std::string* message);
 bool GetUnlocked(FastbootDevice* device, const std::vector<std::string>& args,
                  std::string* message);
 bool GetHasSlot(FastbootDevice* device, const std::vector<std::string>& args, std::string* message);
@@ -43,14 +43,22 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
 #include <functional>
+#include <map>
+#include <memory>
 #include <regex>
 #include <string>
 #include <thread>
 #include <utility>
 #include <vector>
 
+#if !defined(_WIN32)
+#include <poll.h>
+#include <sys/wait.h>
+#endif
+
 #include <android-base/file.h>
 #include <android-base/macros.h>
 #include <android-base/parseint.h>
@@ -217,6 +225,10 @@ static void InfoMessage(const std::string& info) {
     fprintf(stderr, "(bootloader) %s\n", info.c_str());
 }
 
+static void VerboseMessage(const std::string& message) {
+    verbose("%s", message.c_str());
+}
+
 static int64_t get_file_size(int fd) {
     struct stat sb;
     if (fstat(fd, &sb) == -1) {
@@ -426,6 +438,8 @@ static int show_help() {
             " -w                         Wipe userdata.\n"
             " -s SERIAL                  Specify a USB device.\n"
             " -s tcp|udp:HOST[:PORT]     Specify a network device.\n"
+            "                            Repeat -s to run the commands on several devices\n"
+            "                            at once; an update zip is only unpacked once.\n"
             " -S SIZE[K|M|G]             Break into sparse files no larger than SIZE.\n"
             " --force                    Force a flash operation that may be unsafe.\n"
             " --slot SLOT                Use SLOT; 'all' for both slots, 'other' for\n"
@@ -1385,7 +1399,86 @@ int ZipImageSource::OpenFile(const std::string& name) const {
     return unzip_to_file(zip_, name.c_str());
 }
 
+#if !defined(_WIN32)
+// An update zip unpacked once into a temporary directory, so that several devices can be flashed
+// from it at once, each opening the images for itself.
+class ExtractedImageSource final : public ImageSource {
+  public:
+    explicit ExtractedImageSource(ZipArchiveHandle zip);
+    bool ReadFile(const std::string& name, std::vector<char>* out) const override;
+    int OpenFile(const std::string& name) const override;
+    void Remove();
+
+  private:
+    std::string dir_;
+    std::vector<std::string> files_;
+};
+
+ExtractedImageSource::ExtractedImageSource(ZipArchiveHandle zip) : dir_(make_temporary_directory()) {
+    std::vector<std::string> names = {"android-info.txt", "super_empty.img"};
+    for (const Image& image : images) {
+        names.emplace_back(image.img_name);
+        names.emplace_back(image.sig_name);
+    }
+
+    for (const std::string& name : names) {
+        ZipEntry zip_entry;
+        if (std::find(files_.begin(), files_.end(), name) != files_.end() ||
+            FindEntry(zip, name, &zip_entry) != 0) {
+            continue;
+        }
+
+        std::string path = dir_ + "/" + name;
+        unique_fd fd(open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0600));
+        if (fd == -1) {
+            die("failed to create '%s': %s", path.c_str(), strerror(errno));
+        }
+        files_.push_back(name);
+
+        fprintf(stderr, "extracting %s (%" PRIu32 " MB) to disk...", name.c_str(),
+                zip_entry.uncompressed_length / 1024 / 1024);
+        double start = now();
+        int error = ExtractEntryToFile(zip, &zip_entry, fd);
+        if (error != 0) {
+            die("\nfailed to extract '%s': %s", name.c_str(), ErrorCodeString(error));
+        }
+        fprintf(stderr, " took %.3fs\n", now() - start);
+    }
+}
+
+bool ExtractedImageSource::ReadFile(const std::string& name, std::vector<char>* out) const {
+    return ReadFileToVector(dir_ + "/" + name, out);
+}
+
+int ExtractedImageSource::OpenFile(const std::string& name) const {
+    int fd = open((dir_ + "/" + name).c_str(), O_RDONLY | O_BINARY);
+    if (fd == -1 && errno == ENOENT) {
+        fprintf(stderr, "archive does not contain '%s'\n", name.c_str());
+    }
+    return fd;
+}
+
+void ExtractedImageSource::Remove() {
+    for (const std::string& name : files_) {
+        unlink((dir_ + "/" + name).c_str());
+    }
+    rmdir(dir_.c_str());
+}
+
+// Update zips named on the command line, unpacked before forking one process per device.
+static std::map<std::string, std::unique_ptr<ExtractedImageSource>> g_extracted_updates;
+#endif
+
 static void do_update(const char* filename, const std::string& slot_override, bool skip_secondary) {
+#if !defined(_WIN32)
+    auto extracted = g_extracted_updates.find(filename);
+    if (extracted != g_extracted_updates.end()) {
+        FlashAllTool tool(*extracted->second, slot_override, skip_secondary, false);
+        tool.Flash();
+        return;
+    }
+#endif
+
     ZipArchiveHandle zip;
     int error = OpenArchive(filename, &zip);
     if (error != 0) {
@@ -1422,6 +1515,120 @@ static void do_flashall(const std::string& slot_override, bool skip_secondary, b
     tool.Flash();
 }
 
+#if !defined(_WIN32)
+// Unpacks each update zip the commands would flash, so that the per-device processes share it.
+static void extract_updates(const std::vector<std::string>& args) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] != "update") continue;
+        std::string filename = (i + 1 < args.size()) ? args[i + 1] : "update.zip";
+        if (g_extracted_updates.count(filename)) continue;
+
+        ZipArchiveHandle zip;
+        if (OpenArchive(filename.c_str(), &zip) != 0) {
+            // Not a zip after all; leave it to the command to report.
+            CloseArchive(zip);
+            continue;
+        }
+        g_extracted_updates[filename] = std::make_unique<ExtractedImageSource>(zip);
+        CloseArchive(zip);
+    }
+}
+
+// Forks a process for each of |serials| that carries on with the command line against that
+// device, and returns false in each of them. The parent prefixes their output with the serial,
+// waits for all of them, and returns true with the overall exit status in |status|.
+static bool fork_per_device(const std::vector<std::string>& serials, int* status) {
+    struct Child {
+        std::string serial;
+        pid_t pid;
+        unique_fd output;
+        std::string pending;
+    };
+    std::vector<Child> children;
+
+    fflush(stdout);
+    fflush(stderr);
+    for (const std::string& device : serials) {
+        int fds[2];
+        if (pipe(fds) != 0) die("pipe failed: %s", strerror(errno));
+
+        pid_t pid = fork();
+        if (pid == -1) die("fork failed: %s", strerror(errno));
+        if (pid == 0) {
+            for (Child& child : children) {
+                child.output.reset();
+            }
+            close(fds[0]);
+            dup2(fds[1], STDOUT_FILENO);
+            dup2(fds[1], STDERR_FILENO);
+            close(fds[1]);
+            setvbuf(stdout, nullptr, _IONBF, 0);
+            setvbuf(stderr, nullptr, _IONBF, 0);
+            serial = device.c_str();
+            return false;
+        }
+        close(fds[1]);
+        children.push_back({device, pid, unique_fd(fds[0]), ""});
+    }
+
+    // Relay whole lines, so that a status line and its OKAY stay together.
+    size_t open_outputs = children.size();
+    while (open_outputs) {
+        std::vector<pollfd> pfds;
+        std::vector<Child*> polled;
+        for (Child& child : children) {
+            if (child.output == -1) continue;
+            pfds.push_back({child.output.get(), POLLIN, 0});
+            polled.push_back(&child);
+        }
+        if (poll(pfds.data(), pfds.size(), -1) == -1) {
+            if (errno == EINTR) continue;
+            die("poll failed: %s", strerror(errno));
+        }
+
+        for (size_t i = 0; i < pfds.size(); ++i) {
+            if (!pfds[i].revents) continue;
+            Child* child = polled[i];
+            char buf[4096];
+            ssize_t n = TEMP_FAILURE_RETRY(read(child->output.get(), buf, sizeof(buf)));
+            if (n > 0) {
+                child->pending.append(buf, n);
+            }
+            size_t line_end;
+            while ((line_end = child->pending.find('\n')) != std::string::npos) {
+                fprintf(stderr, "%s: %.*s\n", child->serial.c_str(), static_cast<int>(line_end),
+                        child->pending.c_str());
+                child->pending.erase(0, line_end + 1);
+            }
+            if (n <= 0) {
+                if (!child->pending.empty()) {
+                    fprintf(stderr, "%s: %s\n", child->serial.c_str(), child->pending.c_str());
+                    child->pending.clear();
+                }
+                child->output.reset();
+                --open_outputs;
+            }
+        }
+    }
+
+    *status = 0;
+    for (const Child& child : children) {
+        int wstatus;
+        if (TEMP_FAILURE_RETRY(waitpid(child.pid, &wstatus, 0)) == -1) {
+            die("waitpid failed: %s", strerror(errno));
+        }
+        bool ok = WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0;
+        fprintf(stderr, "%s: %s\n", child.serial.c_str(), ok ? "OKAY" : "FAILED");
+        if (!ok) *status = 1;
+    }
+
+    for (auto& [filename, source] : g_extracted_updates) {
+        source->Remove();
+    }
+    return true;
+}
+#endif
+
 static std::string next_arg(std::vector<std::string>* args) {
     if (args->empty()) syntax_error("expected argument");
     std::string result = args->front();
@@ -1671,6 +1878,7 @@ int FastBootTool::Main(int argc, char* argv[]) {
     int longindex;
     std::string slot_override;
     std::string next_active;
+    std::vector<std::string> serials;
 
     g_boot_img_hdr.kernel_addr = 0x00008000;
     g_boot_img_hdr.ramdisk_addr = 0x01000000;
@@ -1777,6 +1985,7 @@ int FastBootTool::Main(int argc, char* argv[]) {
                     break;
                 case 's':
                     serial = optarg;
+                    serials.emplace_back(optarg);
                     break;
                 case 'S':
                     if (!android::base::ParseByteCount(optarg, &sparse_limit)) {
@@ -1811,6 +2020,18 @@ int FastBootTool::Main(int argc, char* argv[]) {
         return show_help();
     }
 
+    if (serials.size() > 1) {
+#if defined(_WIN32)
+        die("-s can only be given once on Windows");
+#else
+        extract_updates(std::vector<std::string>(argv, argv + argc));
+        int status;
+        if (fork_per_device(serials, &status)) {
+            return status;
+        }
+#endif
+    }
+
     Transport* transport = open_device();
     if (transport == nullptr) {
         return 1;
@@ -1819,6 +2040,7 @@ int FastBootTool::Main(int argc, char* argv[]) {
         .prolog = Status,
         .epilog = Epilog,
         .info = InfoMessage,
+        .verbose = VerboseMessage,
     };
     fastboot::FastBootDriver fastboot_driver(transport, driver_callbacks, false);
     fb = &fastboot_driver;
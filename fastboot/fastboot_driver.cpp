@@ -35,9 +35,12 @@
 #include <string.h>
 #include <algorithm>
 #include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include <regex>
+#include <thread>
 #include <vector>
 
 #include <android-base/file.h>
@@ -60,6 +63,7 @@ FastBootDriver::FastBootDriver(Transport* transport, DriverCallbacks driver_call
       prolog_(std::move(driver_callbacks.prolog)),
       epilog_(std::move(driver_callbacks.epilog)),
       info_(std::move(driver_callbacks.info)),
+      verbose_(std::move(driver_callbacks.verbose)),
       disable_checks_(no_checks) {}
 
 FastBootDriver::~FastBootDriver() {
@@ -235,8 +239,12 @@ RetCode FastBootDriver::Download(const std::string& partition, struct sparse_fil
                                  std::vector<std::string>* info) {
     prolog_(StringPrintf("Sending sparse '%s' %zu/%zu (%u KB)", partition.c_str(), current, total,
                          size / 1024));
+    transfer_stats_.clear();
     auto result = Download(s, use_crc, response, info);
     epilog_(result);
+    if (!transfer_stats_.empty()) {
+        verbose_(transfer_stats_);
+    }
     return result;
 }
 
@@ -255,25 +263,7 @@ RetCode FastBootDriver::Download(sparse_file* s, bool use_crc, std::string* resp
         return ret;
     }
 
-    struct SparseCBPrivate {
-        FastBootDriver* self;
-        std::vector<char> tpbuf;
-    } cb_priv;
-    cb_priv.self = this;
-
-    auto cb = [](void* priv, const void* buf, size_t len) -> int {
-        SparseCBPrivate* data = static_cast<SparseCBPrivate*>(priv);
-        const char* cbuf = static_cast<const char*>(buf);
-        return data->self->SparseWriteCallback(data->tpbuf, cbuf, len);
-    };
-
-    if (sparse_file_callback(s, true, use_crc, cb, &cb_priv) < 0) {
-        error_ = "Error reading sparse file";
-        return IO_ERROR;
-    }
-
-    // Now flush
-    if (cb_priv.tpbuf.size() && (ret = SendBuffer(cb_priv.tpbuf))) {
+    if ((ret = SendSparse(s, use_crc))) {
         return ret;
     }
 
@@ -535,37 +525,147 @@ RetCode FastBootDriver::ReadBuffer(void* buf, size_t size) {
     return SUCCESS;
 }
 
-int FastBootDriver::SparseWriteCallback(std::vector<char>& tpbuf, const char* data, size_t len) {
-    size_t total = 0;
-    size_t to_write = std::min(TRANSPORT_CHUNK_SIZE - tpbuf.size(), len);
-
-    // Handle the residual
-    tpbuf.insert(tpbuf.end(), data, data + to_write);
-    if (tpbuf.size() < TRANSPORT_CHUNK_SIZE) {  // Nothing enough to send rn
+namespace {
+
+// Buffers of sparse data on their way from the thread generating them to the thread sending them.
+class SparseQueue {
+  public:
+    explicit SparseQueue(size_t depth) : depth_(depth) {}
+
+    // Blocks while the queue is full. Returns false if the consumer has given up.
+    bool Push(std::vector<char> buf) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return aborted_ || queue_.size() < depth_; });
+        if (aborted_) return false;
+        queue_.push_back(std::move(buf));
+        cv_.notify_all();
+        return true;
+    }
+
+    // Blocks until a buffer is ready. Returns false once the producer has finished and the queue
+    // is empty.
+    bool Pop(std::vector<char>* buf) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return finished_ || !queue_.empty(); });
+        if (queue_.empty()) return false;
+        *buf = std::move(queue_.front());
+        queue_.pop_front();
+        cv_.notify_all();
+        return true;
+    }
+
+    // Hands a sent buffer back so the producer can reuse its allocation.
+    void Recycle(std::vector<char> buf) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_ = std::move(buf);
+    }
+
+    std::vector<char> GetBuffer() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<char> buf = std::move(free_);
+        buf.clear();
+        return buf;
+    }
+
+    void Finish() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_ = true;
+        cv_.notify_all();
+    }
+
+    void Abort() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        aborted_ = true;
+        cv_.notify_all();
+    }
+
+  private:
+    const size_t depth_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::vector<char>> queue_;
+    std::vector<char> free_;
+    bool finished_ = false;
+    bool aborted_ = false;
+};
+
+struct SparseProducer {
+    SparseQueue* queue;
+    std::vector<char> buf;
+
+    // Gathers the callback's data into SPARSE_BUFFER_SIZE buffers. Only the last buffer can be
+    // smaller, so every write but the last is a whole number of TRANSPORT_CHUNK_SIZE chunks.
+    int Write(const char* data, size_t len) {
+        while (len) {
+            if (buf.capacity() < FastBootDriver::SPARSE_BUFFER_SIZE) {
+                buf.reserve(FastBootDriver::SPARSE_BUFFER_SIZE);
+            }
+            size_t n = std::min(len, FastBootDriver::SPARSE_BUFFER_SIZE - buf.size());
+            buf.insert(buf.end(), data, data + n);
+            data += n;
+            len -= n;
+            if (buf.size() == FastBootDriver::SPARSE_BUFFER_SIZE) {
+                if (!queue->Push(std::move(buf))) return -1;
+                buf = queue->GetBuffer();
+            }
+        }
         return 0;
     }
+};
+
+}  // namespace
+
+// Generates the sparse stream on a separate thread, so that reading the backing files overlaps
+// with writing to the transport instead of alternating with it.
+RetCode FastBootDriver::SendSparse(sparse_file* s, bool use_crc) {
+    SparseQueue queue(SPARSE_QUEUE_DEPTH);
+    bool read_failed = false;
+    std::thread producer_thread([&]() {
+        SparseProducer producer{&queue, {}};
+        auto cb = [](void* priv, const void* buf, size_t len) -> int {
+            return static_cast<SparseProducer*>(priv)->Write(static_cast<const char*>(buf), len);
+        };
+        if (sparse_file_callback(s, true, use_crc, cb, &producer) < 0) {
+            read_failed = true;
+        } else if (!producer.buf.empty()) {
+            producer.queue->Push(std::move(producer.buf));
+        }
+        queue.Finish();
+    });
 
-    if (SendBuffer(tpbuf)) {
-        error_ = ErrnoStr("Send failed in SparseWriteCallback()");
-        return -1;
+    RetCode ret = SUCCESS;
+    uint64_t sent = 0;
+    std::chrono::duration<double> waiting(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<char> buf;
+    while (true) {
+        auto wait_start = std::chrono::steady_clock::now();
+        if (!queue.Pop(&buf)) break;
+        waiting += std::chrono::steady_clock::now() - wait_start;
+
+        if ((ret = SendBuffer(buf))) {
+            queue.Abort();
+            break;
+        }
+        sent += buf.size();
+        queue.Recycle(std::move(buf));
     }
-    tpbuf.clear();
-    total += to_write;
+    producer_thread.join();
 
-    // Now we need to send a multiple of chunk size
-    size_t nchunks = (len - total) / TRANSPORT_CHUNK_SIZE;
-    size_t nbytes = TRANSPORT_CHUNK_SIZE * nchunks;
-    if (nbytes && SendBuffer(data + total, nbytes)) {  // Don't send a ZLP
-        error_ = ErrnoStr("Send failed in SparseWriteCallback()");
-        return -1;
+    if (ret) {
+        return ret;
     }
-    total += nbytes;
-
-    if (len - total > 0) {  // We have residual data to save for next time
-        tpbuf.assign(data + total, data + len);
+    if (read_failed) {
+        error_ = "Error reading sparse file";
+        return IO_ERROR;
     }
 
-    return 0;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = std::max(elapsed.count(), 0.001);
+    transfer_stats_ = StringPrintf("sent %" PRIu64 " bytes in %.3fs (%.1f MB/s), %.3fs waiting for "
+                                   "sparse data",
+                                   sent, seconds, sent / seconds / (1024 * 1024), waiting.count());
+    return SUCCESS;
 }
 
 Transport* FastBootDriver::set_transport(Transport* transport) {
@@ -28,6 +28,7 @@
 #pragma once
 #include <cstdlib>
 #include <deque>
+#include <functional>
 #include <limits>
 #include <string>
 #include <vector>
@@ -58,6 +59,8 @@ struct DriverCallbacks {
     std::function<void(const std::string&)> prolog = [](const std::string&) {};
     std::function<void(int)> epilog = [](int) {};
     std::function<void(const std::string&)> info = [](const std::string&) {};
+    // Details only shown with --verbose, such as transfer rates.
+    std::function<void(const std::string&)> verbose = [](const std::string&) {};
 };
 
 class FastBootDriver {
@@ -67,6 +70,10 @@ class FastBootDriver {
     static constexpr int RESP_TIMEOUT = 30;  // 30 seconds
     static constexpr uint32_t MAX_DOWNLOAD_SIZE = std::numeric_limits<uint32_t>::max();
     static constexpr size_t TRANSPORT_CHUNK_SIZE = 1024;
+    // Sparse data is generated on its own thread into buffers of this size (a multiple of
+    // TRANSPORT_CHUNK_SIZE), with up to SPARSE_QUEUE_DEPTH of them waiting to be sent.
+    static constexpr size_t SPARSE_BUFFER_SIZE = 1024 * 1024;
+    static constexpr size_t SPARSE_QUEUE_DEPTH = 2;
 
     FastBootDriver(Transport* transport, DriverCallbacks driver_callbacks = {},
                    bool no_checks = false);
@@ -153,12 +160,14 @@ class FastBootDriver {
     RetCode UploadInner(const std::string& outfile, std::string* response = nullptr,
                         std::vector<std::string>* info = nullptr);
 
-    int SparseWriteCallback(std::vector<char>& tpbuf, const char* data, size_t len);
+    RetCode SendSparse(sparse_file* s, bool use_crc);
 
     std::string error_;
     std::function<void(const std::string&)> prolog_;
     std::function<void(int)> epilog_;
     std::function<void(const std::string&)> info_;
+    std::function<void(const std::string&)> verbose_;
+    std::string transfer_stats_;
     bool disable_checks_;
 };
 
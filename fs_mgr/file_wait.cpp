@@ -25,7 +25,12 @@
 #include <unistd.h>
 #endif
 
+#include <algorithm>
+#include <condition_variable>
 #include <functional>
+#include <map>
+#include <mutex>
+#include <set>
 #include <thread>
 
 #include <android-base/file.h>
@@ -212,15 +217,219 @@ int64_t OneShotInotify::RemainingMs() const {
 }
 #endif
 
-bool WaitForFile(const std::string& path, const std::chrono::milliseconds relative_timeout) {
+static bool FileExists(const std::string& path) {
+    return !access(path.c_str(), F_OK) || errno != ENOENT;
+}
+
+struct FileWaiter::State {
+    std::mutex mutex;
+    std::condition_variable cv;
+    unique_fd inotify_fd;
+    bool reading = false;
+    std::set<std::string> watched_dirs;
+
+    // How closely a pending path is watched. If only an ancestor of its
+    // directory exists, the watch moves down as the missing directories are
+    // created. Unwatched paths are polled.
+    enum class Watched { None, Ancestor, Directory };
+    // Paths that have not appeared yet.
+    std::map<std::string, Watched> pending;
+
+    Watched Watch(const std::string& path);
+    bool ReadEvents(std::chrono::steady_clock::time_point deadline);
+    void Recheck();
+};
+
+// Watch the directory that |path| will be created in or, if it does not exist
+// yet, its nearest existing ancestor. Must be called with the mutex held.
+FileWaiter::State::Watched FileWaiter::State::Watch(const std::string& path) {
 #if defined(__linux__)
-    OneShotInotify inotify(path, IN_CREATE, relative_timeout);
-    return inotify.Wait();
+    if (inotify_fd < 0) return Watched::None;
+
+    std::string dir = android::base::Dirname(path);
+    Watched result = Watched::Directory;
+    while (true) {
+        if (watched_dirs.count(dir)) return result;
+        if (inotify_add_watch(inotify_fd, dir.c_str(), IN_CREATE | IN_MOVED_TO) >= 0) {
+            watched_dirs.emplace(dir);
+            return result;
+        }
+        if (errno != ENOENT || dir == "/" || dir == ".") {
+            PLOG(ERROR) << "inotify_add_watch failed for " << dir;
+            return Watched::None;
+        }
+        dir = android::base::Dirname(dir);
+        result = Watched::Ancestor;
+    }
+#else
+    (void)path;
+    return Watched::None;
+#endif
+}
+
+// Block until there are inotify events or |deadline| passes, and drain them.
+// Returns false on an inotify error. Called without the mutex held, by at most
+// one thread at a time.
+bool FileWaiter::State::ReadEvents(std::chrono::steady_clock::time_point deadline) {
+#if defined(__linux__)
+    auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+    struct pollfd event = {
+            .fd = inotify_fd,
+            .events = POLLIN,
+            .revents = 0,
+    };
+    int rv = poll(&event, 1, std::max<int64_t>(remaining.count(), 0));
+    if (rv < 0) {
+        if (errno == EINTR) return true;
+        PLOG(ERROR) << "poll for inotify failed";
+        return false;
+    }
+    if (rv == 0) return true;
+    if (event.revents & POLLERR) {
+        LOG(ERROR) << "error reading inotify";
+        return false;
+    }
+
+    // As in OneShotInotify, the events themselves don't matter: every pending
+    // path is checked afterwards.
+    static constexpr size_t kBufferSize = sizeof(struct inotify_event) + NAME_MAX + 1;
+    char buffer[kBufferSize];
+    while (true) {
+        ssize_t rv = TEMP_FAILURE_RETRY(read(inotify_fd, buffer, sizeof(buffer)));
+        if (rv <= 0) {
+            if (rv == 0 || errno == EAGAIN) return true;
+            PLOG(ERROR) << "read inotify failed";
+            return false;
+        }
+    }
 #else
-    return PollForFile(path, relative_timeout);
+    (void)deadline;
+    return false;
+#endif
+}
+
+// Drop every pending path that now exists, and move watches down to any
+// directories that were created. Must be called with the mutex held.
+void FileWaiter::State::Recheck() {
+    for (auto iter = pending.begin(); iter != pending.end();) {
+        if (iter->second != Watched::Directory) {
+            iter->second = Watch(iter->first);
+        }
+        if (FileExists(iter->first)) {
+            iter = pending.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+}
+
+FileWaiter::FileWaiter() : state_(new State) {
+#if defined(__linux__)
+    state_->inotify_fd.reset(inotify_init1(IN_CLOEXEC | IN_NONBLOCK));
+    if (state_->inotify_fd < 0) {
+        PLOG(ERROR) << "inotify_init1 failed";
+    }
 #endif
 }
 
+FileWaiter::~FileWaiter() {}
+
+void FileWaiter::Add(const std::string& path) {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    if (state_->pending.count(path) || FileExists(path)) return;
+
+    auto watched = state_->Watch(path);
+    // It's possible the path appeared before the watch was added.
+    if (FileExists(path)) return;
+    state_->pending.emplace(path, watched);
+}
+
+bool FileWaiter::Wait(const std::string& path, const std::chrono::milliseconds relative_timeout) {
+    auto deadline = std::chrono::steady_clock::now() + relative_timeout;
+    Add(path);
+
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    while (true) {
+        auto iter = state_->pending.find(path);
+        if (iter == state_->pending.end()) return true;
+        if (FileExists(path)) {
+            state_->pending.erase(iter);
+            return true;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) return false;
+
+        if (state_->inotify_fd < 0) {
+            // No inotify at all, so poll like PollForFile.
+            lock.unlock();
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+                    50ms, deadline - now));
+            lock.lock();
+            continue;
+        }
+        if (state_->reading) {
+            state_->cv.wait_until(lock, deadline);
+            continue;
+        }
+
+        // Wake up at least as often as PollForFile if anything is unwatched.
+        auto read_deadline = deadline;
+        for (const auto& [pending_path, watched] : state_->pending) {
+            if (watched == State::Watched::None) {
+                read_deadline = std::min(read_deadline, now + 50ms);
+                break;
+            }
+        }
+
+        state_->reading = true;
+        lock.unlock();
+        bool ok = state_->ReadEvents(read_deadline);
+        lock.lock();
+        state_->reading = false;
+        if (!ok) {
+            // Some kind of error with inotify occurred; fall back to polling.
+            state_->inotify_fd.reset();
+        }
+        state_->Recheck();
+        state_->cv.notify_all();
+    }
+}
+
+bool FileWaiter::WaitAll(const std::chrono::milliseconds relative_timeout) {
+    auto deadline = std::chrono::steady_clock::now() + relative_timeout;
+
+    std::vector<std::string> paths;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        for (const auto& [path, watched] : state_->pending) {
+            paths.emplace_back(path);
+        }
+    }
+
+    for (const auto& path : paths) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+        if (!Wait(path, std::max(remaining, 0ms))) return false;
+    }
+    return true;
+}
+
+bool WaitForFile(const std::string& path, const std::chrono::milliseconds relative_timeout) {
+    FileWaiter waiter;
+    return waiter.Wait(path, relative_timeout);
+}
+
+bool WaitForFiles(const std::vector<std::string>& paths,
+                  const std::chrono::milliseconds relative_timeout) {
+    FileWaiter waiter;
+    for (const auto& path : paths) {
+        waiter.Add(path);
+    }
+    return waiter.WaitAll(relative_timeout);
+}
+
 // Wait at most |relative_timeout| milliseconds for |path| to stop existing.
 bool WaitForFileDeleted(const std::string& path, const std::chrono::milliseconds relative_timeout) {
 #if defined(__linux__)
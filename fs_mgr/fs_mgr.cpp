@@ -34,14 +34,18 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <deque>
 #include <functional>
+#include <future>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <thread>
 #include <utility>
 #include <vector>
 
+#include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
@@ -1064,6 +1068,120 @@ static bool IsMountPointMounted(const std::string& mount_point) {
     return GetEntryForMountPoint(&fstab, mount_point) != nullptr;
 }
 
+// Logs a failed mount of an entry that is neither encryptable nor formattable.
+// Returns true if the failure should fail mount_all.
+static bool report_mount_failure(const FstabEntry& attempted_entry) {
+    // fs_options might be null so we cannot use PERROR << directly.
+    // Use StringPrintf to output "(null)" instead.
+    if (attempted_entry.fs_mgr_flags.no_fail) {
+        PERROR << android::base::StringPrintf(
+                "Ignoring failure to mount an un-encryptable or wiped "
+                "partition on %s at %s options: %s",
+                attempted_entry.blk_device.c_str(), attempted_entry.mount_point.c_str(),
+                attempted_entry.fs_options.c_str());
+        return false;
+    }
+    PERROR << android::base::StringPrintf(
+            "Failed to mount an un-encryptable or wiped partition "
+            "on %s at %s options: %s",
+            attempted_entry.blk_device.c_str(), attempted_entry.mount_point.c_str(),
+            attempted_entry.fs_options.c_str());
+    return true;
+}
+
+// Returns true if path is mount_point or lies beneath it.
+static bool path_within(const std::string& path, const std::string& mount_point) {
+    if (path.empty() || mount_point.empty()) {
+        return false;
+    }
+    auto end = mount_point.find_last_not_of('/');
+    if (end == std::string::npos) {
+        return true;
+    }
+    return StartsWith(path + "/", mount_point.substr(0, end + 1) + "/");
+}
+
+// Entries that may be formatted, encrypted or checkpointed touch state shared by the
+// whole of mount_all, so only the plain ones are mounted in the background.
+static bool can_mount_in_background(const Fstab& fstab, size_t start_idx, size_t end_idx) {
+    for (size_t i = start_idx; i <= end_idx; i++) {
+        const auto& entry = fstab[i];
+        if (entry.fs_mgr_flags.formattable || entry.is_encryptable() ||
+            entry.fs_mgr_flags.file_encryption || should_use_metadata_encryption(entry) ||
+            entry.fs_mgr_flags.checkpoint_blk || entry.fs_mgr_flags.checkpoint_fs) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Set ro.fs_mgr.parallel_mount_all to check and mount the plain entries of an fstab
+// concurrently, up to this many at a time. Entries whose mount points nest wait for
+// each other, and every entry is still reported in fstab order.
+static constexpr size_t kMaxBackgroundMounts = 4;
+
+struct BackgroundMount {
+    size_t start_idx;
+    std::string mount_point;
+    std::string blk_device;
+
+    struct Result {
+        bool mounted;
+        int mount_errno;
+        int attempted_idx;
+        std::chrono::milliseconds duration;
+    };
+    std::future<Result> result;
+};
+
+// A wiped formattable entry would otherwise only be formatted once its mount has
+// failed, one after the other. With ro.fs_mgr.parallel_mount_all set, format the
+// ones that are already wiped up front and all at once, so that the mount loop
+// finds them ready. Entries that need their device resolved first, or have a
+// crypto footer or key to take care of, are still left to the loop.
+static void format_wiped_entries(const Fstab& fstab, int mount_mode) {
+    std::vector<const FstabEntry*> wiped;
+    std::set<std::string> mount_points;
+    for (const auto& entry : fstab) {
+        if (!entry.fs_mgr_flags.formattable || entry.fs_mgr_flags.vold_managed ||
+            entry.fs_mgr_flags.recovery_only || entry.fs_mgr_flags.logical ||
+            entry.is_encryptable() ||
+            ((mount_mode == MOUNT_MODE_LATE) && !entry.fs_mgr_flags.late_mount) ||
+            ((mount_mode == MOUNT_MODE_EARLY) && entry.fs_mgr_flags.late_mount)) {
+            continue;
+        }
+        if (entry.fs_mgr_flags.first_stage_mount && IsMountPointMounted(entry.mount_point)) {
+            continue;
+        }
+        // Only the first entry for each mount point is formatted by the loop.
+        if (!mount_points.emplace(entry.mount_point).second) {
+            continue;
+        }
+        if (StartsWith(entry.blk_device, "LABEL=") || access(entry.blk_device.c_str(), F_OK) ||
+            !partition_wiped(entry.blk_device.c_str())) {
+            continue;
+        }
+        wiped.emplace_back(&entry);
+    }
+    if (wiped.size() < 2) {
+        return;
+    }
+
+    android::base::Timer t;
+    std::vector<std::future<int>> formats;
+    for (const auto* entry : wiped) {
+        formats.emplace_back(std::async(std::launch::async, [entry]() {
+            return fs_mgr_do_format(*entry, false);
+        }));
+    }
+    for (size_t i = 0; i < wiped.size(); i++) {
+        if (int rc = formats[i].get(); rc != 0) {
+            LERROR << "Formatting " << wiped[i]->mount_point << " returned " << rc;
+        }
+    }
+    LINFO << "Formatted " << wiped.size() << " wiped partitions in " << t;
+}
+
 // When multiple fstab records share the same mount_point, it will try to mount each
 // one in turn, and ignore any duplicates after a first successful mount.
 // Returns -1 on error, and  FS_MGR_MNTALL_* otherwise.
@@ -1072,11 +1190,35 @@ int fs_mgr_mount_all(Fstab* fstab, int mount_mode) {
     int error_count = 0;
     CheckpointManager checkpoint_manager;
     AvbUniquePtr avb_handle(nullptr);
+    bool parallel = android::base::GetBoolProperty("ro.fs_mgr.parallel_mount_all", false);
+    std::deque<BackgroundMount> background;
 
     if (fstab->empty()) {
         return FS_MGR_MNTALL_FAIL;
     }
 
+    if (parallel) {
+        format_wiped_entries(*fstab, mount_mode);
+    }
+
+    // Reports background mounts in fstab order until at most `keep` are in flight.
+    auto finish_background_mounts = [&](size_t keep) {
+        while (background.size() > keep) {
+            auto result = background.front().result.get();
+            auto& attempted_entry = (*fstab)[background.front().start_idx + result.attempted_idx];
+            if (result.mounted) {
+                LINFO << "Mounted " << attempted_entry.mount_point << " in the background in "
+                      << result.duration.count() << "ms";
+            } else {
+                errno = result.mount_errno;
+                if (report_mount_failure(attempted_entry)) {
+                    ++error_count;
+                }
+            }
+            background.pop_front();
+        }
+    };
+
     for (size_t i = 0; i < fstab->size(); i++) {
         auto& current_entry = (*fstab)[i];
 
@@ -1111,6 +1253,32 @@ int fs_mgr_mount_all(Fstab* fstab, int mount_mode) {
             continue;
         }
 
+        size_t group_end = i;
+        while (group_end + 1 < fstab->size() &&
+               (*fstab)[group_end + 1].mount_point == current_entry.mount_point) {
+            group_end++;
+        }
+        bool in_background = parallel && can_mount_in_background(*fstab, i, group_end);
+
+        // Wait for any background mount this entry sits on, sits under, or reads its
+        // device from, and for all of them before an entry that must mount in order.
+        size_t keep = 0;
+        if (in_background) {
+            keep = background.size();
+            for (size_t j = 0; j < background.size(); j++) {
+                const auto& mount = background[j];
+                if (path_within(current_entry.mount_point, mount.mount_point) ||
+                    path_within(mount.mount_point, current_entry.mount_point) ||
+                    path_within(current_entry.blk_device, mount.mount_point) ||
+                    path_within(current_entry.avb_keys, mount.mount_point) ||
+                    path_within(mount.blk_device, current_entry.mount_point)) {
+                    keep = background.size() - j - 1;
+                }
+            }
+            keep = std::min(keep, kMaxBackgroundMounts - 1);
+        }
+        finish_background_mounts(keep);
+
         // Translate LABEL= file system labels into block devices.
         if (is_extfs(current_entry.fs_type)) {
             if (!TranslateExtLabels(&current_entry)) {
@@ -1167,6 +1335,24 @@ int fs_mgr_mount_all(Fstab* fstab, int mount_mode) {
             }
         }
 
+        if (in_background) {
+            Fstab group(fstab->begin() + i, fstab->begin() + group_end + 1);
+            background.push_back({i, current_entry.mount_point, current_entry.blk_device});
+            background.back().result =
+                    std::async(std::launch::async, [group = std::move(group)]() {
+                        android::base::Timer t;
+                        BackgroundMount::Result result;
+                        int last_idx_inspected;
+                        result.mounted = mount_with_alternatives(group, 0, &last_idx_inspected,
+                                                                 &result.attempted_idx);
+                        result.mount_errno = errno;
+                        result.duration = t.duration();
+                        return result;
+                    });
+            i = group_end;
+            continue;
+        }
+
         int last_idx_inspected;
         int top_idx = i;
         int attempted_idx = -1;
@@ -1271,26 +1457,15 @@ int fs_mgr_mount_all(Fstab* fstab, int mount_mode) {
             encryptable = FS_MGR_MNTALL_DEV_IS_METADATA_ENCRYPTED;
             continue;
         } else {
-            // fs_options might be null so we cannot use PERROR << directly.
-            // Use StringPrintf to output "(null)" instead.
-            if (attempted_entry.fs_mgr_flags.no_fail) {
-                PERROR << android::base::StringPrintf(
-                        "Ignoring failure to mount an un-encryptable or wiped "
-                        "partition on %s at %s options: %s",
-                        attempted_entry.blk_device.c_str(), attempted_entry.mount_point.c_str(),
-                        attempted_entry.fs_options.c_str());
-            } else {
-                PERROR << android::base::StringPrintf(
-                        "Failed to mount an un-encryptable or wiped partition "
-                        "on %s at %s options: %s",
-                        attempted_entry.blk_device.c_str(), attempted_entry.mount_point.c_str(),
-                        attempted_entry.fs_options.c_str());
+            if (report_mount_failure(attempted_entry)) {
                 ++error_count;
             }
             continue;
         }
     }
 
+    finish_background_mounts(0);
+
 #if ALLOW_ADBD_DISABLE_VERITY == 1  // "userdebug" build
     fs_mgr_overlayfs_mount_all(fstab);
 #endif
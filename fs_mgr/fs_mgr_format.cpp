@@ -23,7 +23,12 @@
 #include <errno.h>
 #include <cutils/partition_utils.h>
 #include <sys/mount.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
 
+#include <algorithm>
+
+#include <android-base/chrono_utils.h>
 #include <android-base/unique_fd.h>
 #include <ext4_utils/ext4.h>
 #include <ext4_utils/ext4_utils.h>
@@ -35,6 +40,7 @@
 #include "fs_mgr_priv.h"
 #include "cryptfs.h"
 
+using android::base::Timer;
 using android::base::unique_fd;
 
 // Realistically, this file should be part of the android::fs_mgr namespace;
@@ -56,6 +62,37 @@ static int get_dev_sz(const std::string& fs_blkdev, uint64_t* dev_sz) {
     return 0;
 }
 
+// The mkfs tools discard the whole device with a single ioctl, which the block
+// layer can hold for a long time on large UFS parts. Discard here instead, this
+// much at a time, and tell the tools not to.
+static constexpr uint64_t kDiscardBatchSize = 1ULL << 30;
+
+// Discards the first dev_sz bytes of fs_blkdev. Returns false if the device does
+// not support discard, or it failed part of the way, so that the mkfs tool
+// tries again.
+static bool discard_in_batches(const std::string& fs_blkdev, uint64_t dev_sz) {
+    unique_fd fd(TEMP_FAILURE_RETRY(open(fs_blkdev.c_str(), O_RDWR | O_CLOEXEC)));
+    if (fd < 0) {
+        PERROR << "Cannot open block device " << fs_blkdev;
+        return false;
+    }
+
+    Timer t;
+    for (uint64_t start = 0; start < dev_sz; start += kDiscardBatchSize) {
+        uint64_t range[2] = {start, std::min(kDiscardBatchSize, dev_sz - start)};
+        if (ioctl(fd, BLKDISCARD, &range) == -1) {
+            if (errno == EOPNOTSUPP) {
+                LINFO << fs_blkdev << " does not support discard";
+            } else {
+                PERROR << "Discard of " << fs_blkdev << " failed at offset " << start;
+            }
+            return false;
+        }
+    }
+    LINFO << "Discarded " << dev_sz << " bytes of " << fs_blkdev << " in " << t;
+    return true;
+}
+
 static int format_ext4(const std::string& fs_blkdev, const std::string& fs_mnt_point,
                        bool crypt_footer) {
     uint64_t dev_sz;
@@ -71,10 +108,18 @@ static int format_ext4(const std::string& fs_blkdev, const std::string& fs_mnt_p
         dev_sz -= CRYPT_FOOTER_OFFSET;
     }
 
+    // The inode tables and journal are left to be zeroed by the kernel after
+    // the first mount, which is safe as the device was just discarded or will
+    // be by mke2fs.
+    std::string extended_opts = "lazy_itable_init=1,lazy_journal_init=1";
+    if (discard_in_batches(fs_blkdev, dev_sz)) {
+        extended_opts += ",nodiscard";
+    }
+
     std::string size_str = std::to_string(dev_sz / 4096);
     const char* const mke2fs_args[] = {
-            "/system/bin/mke2fs", "-t",   "ext4", "-b", "4096", fs_blkdev.c_str(),
-            size_str.c_str(),     nullptr};
+            "/system/bin/mke2fs", "-t", "ext4", "-b", "4096", "-E", extended_opts.c_str(),
+            fs_blkdev.c_str(),    size_str.c_str(), nullptr};
 
     rc = android_fork_execvp_ext(arraysize(mke2fs_args), const_cast<char**>(mke2fs_args), NULL,
                                  true, LOG_KLOG, true, nullptr, nullptr, 0);
@@ -108,11 +153,14 @@ static int format_f2fs(const std::string& fs_blkdev, uint64_t dev_sz, bool crypt
         dev_sz -= CRYPT_FOOTER_OFFSET;
     }
 
+    bool discarded = discard_in_batches(fs_blkdev, dev_sz);
+
     std::string size_str = std::to_string(dev_sz / 4096);
     // clang-format off
     const char* const args[] = {
         "/system/bin/make_f2fs",
         "-g", "android",
+        "-t", discarded ? "0" : "1",
         fs_blkdev.c_str(),
         size_str.c_str(),
         nullptr
@@ -126,12 +174,17 @@ static int format_f2fs(const std::string& fs_blkdev, uint64_t dev_sz, bool crypt
 int fs_mgr_do_format(const FstabEntry& entry, bool crypt_footer) {
     LERROR << __FUNCTION__ << ": Format " << entry.blk_device << " as '" << entry.fs_type << "'";
 
+    Timer t;
+    int rc;
     if (entry.fs_type == "f2fs") {
-        return format_f2fs(entry.blk_device, entry.length, crypt_footer);
+        rc = format_f2fs(entry.blk_device, entry.length, crypt_footer);
     } else if (entry.fs_type == "ext4") {
-        return format_ext4(entry.blk_device, entry.mount_point, crypt_footer);
+        rc = format_ext4(entry.blk_device, entry.mount_point, crypt_footer);
     } else {
         LERROR << "File system type '" << entry.fs_type << "' is not supported";
         return -EINVAL;
     }
+    LINFO << __FUNCTION__ << ": Format of " << entry.blk_device << " returned " << rc << " after "
+          << t;
+    return rc;
 }
@@ -21,10 +21,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mount.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <algorithm>
 #include <array>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -41,6 +46,7 @@ using android::base::ParseByteCount;
 using android::base::ParseInt;
 using android::base::ReadFileToString;
 using android::base::Split;
+using android::base::SplitView;
 using android::base::StartsWith;
 
 namespace android {
@@ -153,7 +159,7 @@ void ParseFileEncryption(const std::string& arg, FstabEntry* entry) {
     }
 }
 
-bool SetMountFlag(const std::string& flag, FstabEntry* entry) {
+bool SetMountFlag(std::string_view flag, FstabEntry* entry) {
     for (const auto& [name, value] : kMountFlagsList) {
         if (flag == name) {
             entry->flags |= value;
@@ -165,7 +171,7 @@ bool SetMountFlag(const std::string& flag, FstabEntry* entry) {
 
 void ParseMountFlags(const std::string& flags, FstabEntry* entry) {
     std::string fs_options;
-    for (const auto& flag : Split(flags, ",")) {
+    for (std::string_view flag : SplitView(flags, ",")) {
         if (!SetMountFlag(flag, entry)) {
             // Unknown flag, so it must be a filesystem specific option.
             if (!fs_options.empty()) {
@@ -175,7 +181,7 @@ void ParseMountFlags(const std::string& flags, FstabEntry* entry) {
 
             if (entry->fs_type == "f2fs" && StartsWith(flag, "reserve_root=")) {
                 std::string arg;
-                if (auto equal_sign = flag.find('='); equal_sign != std::string::npos) {
+                if (auto equal_sign = flag.find('='); equal_sign != std::string_view::npos) {
                     arg = flag.substr(equal_sign + 1);
                 }
                 if (!ParseInt(arg, &entry->reserved_size)) {
@@ -190,10 +196,10 @@ void ParseMountFlags(const std::string& flags, FstabEntry* entry) {
 }
 
 void ParseFsMgrFlags(const std::string& flags, FstabEntry* entry) {
-    for (const auto& flag : Split(flags, ",")) {
+    for (std::string_view flag : SplitView(flags, ",")) {
         if (flag.empty() || flag == "defaults") continue;
         std::string arg;
-        if (auto equal_sign = flag.find('='); equal_sign != std::string::npos) {
+        if (auto equal_sign = flag.find('='); equal_sign != std::string_view::npos) {
             arg = flag.substr(equal_sign + 1);
         }
 
@@ -556,6 +562,49 @@ err:
     return false;
 }
 
+// init, vold, adbd and others read the same fstab files many times over, so what was parsed from
+// each file is kept for as long as the file looks unchanged. Files that don't report a size, such
+// as /proc/mounts, change without stat() showing it and are always parsed.
+bool ReadFstabFileCached(FILE* fstab_file, const std::string& path, bool proc_mounts,
+                         Fstab* fstab_out) {
+    struct stat st;
+    if (proc_mounts || fstat(fileno(fstab_file), &st) != 0 || !S_ISREG(st.st_mode) ||
+        st.st_size == 0) {
+        return ReadFstabFile(fstab_file, proc_mounts, fstab_out);
+    }
+
+    struct ParsedFstab {
+        struct stat st;
+        Fstab fstab;
+    };
+    static std::mutex cache_lock;
+    static std::map<std::string, ParsedFstab> cache;
+    auto unchanged = [&st](const struct stat& cached) {
+        return cached.st_dev == st.st_dev && cached.st_ino == st.st_ino &&
+               cached.st_size == st.st_size && cached.st_mtim.tv_sec == st.st_mtim.tv_sec &&
+               cached.st_mtim.tv_nsec == st.st_mtim.tv_nsec &&
+               cached.st_ctim.tv_sec == st.st_ctim.tv_sec &&
+               cached.st_ctim.tv_nsec == st.st_ctim.tv_nsec;
+    };
+    {
+        std::lock_guard<std::mutex> lock(cache_lock);
+        auto it = cache.find(path);
+        if (it != cache.end() && unchanged(it->second.st)) {
+            *fstab_out = it->second.fstab;
+            return true;
+        }
+    }
+
+    Fstab fstab;
+    if (!ReadFstabFile(fstab_file, proc_mounts, &fstab)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(cache_lock);
+    cache[path] = {st, fstab};
+    *fstab_out = std::move(fstab);
+    return true;
+}
+
 /* Extracts <device>s from the by-name symlinks specified in a fstab:
  *   /dev/block/<type>/<device>/by-name/<partition>
  *
@@ -628,6 +677,33 @@ bool EraseFstabEntry(Fstab* fstab, const std::string& mount_point) {
     return false;
 }
 
+// Parses the fstab entries in the device tree, if there are any.
+bool ParseFstabFromDt(Fstab* fstab, bool log) {
+    std::string fstab_buf = ReadFstabFromDt();
+    if (fstab_buf.empty()) {
+        if (log) LINFO << __FUNCTION__ << "(): failed to read fstab from dt";
+        return false;
+    }
+
+    std::unique_ptr<FILE, decltype(&fclose)> fstab_file(
+        fmemopen(static_cast<void*>(const_cast<char*>(fstab_buf.c_str())),
+                 fstab_buf.length(), "r"), fclose);
+    if (!fstab_file) {
+        if (log) PERROR << __FUNCTION__ << "(): failed to create a file stream for fstab dt";
+        return false;
+    }
+
+    if (!ReadFstabFile(fstab_file.get(), false, fstab)) {
+        if (log) {
+            LERROR << __FUNCTION__ << "(): failed to load fstab from kernel:" << std::endl
+                   << fstab_buf;
+        }
+        return false;
+    }
+
+    return true;
+}
+
 }  // namespace
 
 void TransformFstabForDsu(Fstab* fstab, const std::vector<std::string>& dsu_partitions) {
@@ -724,7 +800,7 @@ bool ReadFstabFromFile(const std::string& path, Fstab* fstab) {
 
     bool is_proc_mounts = path == "/proc/mounts";
 
-    if (!ReadFstabFile(fstab_file.get(), is_proc_mounts, fstab)) {
+    if (!ReadFstabFileCached(fstab_file.get(), path, is_proc_mounts, fstab)) {
         LERROR << __FUNCTION__ << "(): failed to load fstab from : '" << path << "'";
         return false;
     }
@@ -741,27 +817,16 @@ bool ReadFstabFromFile(const std::string& path, Fstab* fstab) {
 
 // Returns fstab entries parsed from the device tree if they exist
 bool ReadFstabFromDt(Fstab* fstab, bool log) {
-    std::string fstab_buf = ReadFstabFromDt();
-    if (fstab_buf.empty()) {
-        if (log) LINFO << __FUNCTION__ << "(): failed to read fstab from dt";
-        return false;
-    }
-
-    std::unique_ptr<FILE, decltype(&fclose)> fstab_file(
-        fmemopen(static_cast<void*>(const_cast<char*>(fstab_buf.c_str())),
-                 fstab_buf.length(), "r"), fclose);
-    if (!fstab_file) {
-        if (log) PERROR << __FUNCTION__ << "(): failed to create a file stream for fstab dt";
-        return false;
-    }
-
-    if (!ReadFstabFile(fstab_file.get(), false, fstab)) {
-        if (log) {
-            LERROR << __FUNCTION__ << "(): failed to load fstab from kernel:" << std::endl
-                   << fstab_buf;
-        }
-        return false;
-    }
+    // The device tree doesn't change while we're up, so it's only parsed once.
+    static std::mutex dt_fstab_lock;
+    static std::optional<Fstab> dt_fstab;
+    std::lock_guard<std::mutex> lock(dt_fstab_lock);
+    if (!dt_fstab) {
+        Fstab parsed;
+        if (!ParseFstabFromDt(&parsed, log)) return false;
+        dt_fstab = std::move(parsed);
+    }
+    *fstab = *dt_fstab;
 
     SkipMountingPartitions(fstab);
 
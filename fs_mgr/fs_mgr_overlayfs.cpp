@@ -33,6 +33,8 @@
 
 #include <algorithm>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -294,15 +296,21 @@ bool fs_mgr_rw_access(const std::string& path) {
     return ret;
 }
 
-bool fs_mgr_overlayfs_already_mounted(const std::string& mount_point, bool overlay_only = true) {
-    Fstab fstab;
+// Reads /proc/mounts, for checking several mount points against one snapshot of it.
+Fstab fs_mgr_overlayfs_read_mounts() {
+    Fstab mounts;
     auto save_errno = errno;
-    if (!ReadFstabFromFile("/proc/mounts", &fstab)) {
-        return false;
+    if (!ReadFstabFromFile("/proc/mounts", &mounts)) {
+        return {};
     }
     errno = save_errno;
+    return mounts;
+}
+
+bool fs_mgr_overlayfs_already_mounted(const Fstab& mounts, const std::string& mount_point,
+                                      bool overlay_only = true) {
     const auto lowerdir = kLowerdirOption + mount_point;
-    for (const auto& entry : fstab) {
+    for (const auto& entry : mounts) {
         if (overlay_only && "overlay" != entry.fs_type && "overlayfs" != entry.fs_type) continue;
         if (mount_point != entry.mount_point) continue;
         if (!overlay_only) return true;
@@ -316,6 +324,11 @@ bool fs_mgr_overlayfs_already_mounted(const std::string& mount_point, bool overl
     return false;
 }
 
+bool fs_mgr_overlayfs_already_mounted(const std::string& mount_point, bool overlay_only = true) {
+    return fs_mgr_overlayfs_already_mounted(fs_mgr_overlayfs_read_mounts(), mount_point,
+                                            overlay_only);
+}
+
 bool fs_mgr_wants_overlayfs(FstabEntry* entry) {
     // Don't check entries that are managed by vold.
     if (entry->fs_mgr_flags.vold_managed || entry->fs_mgr_flags.recovery_only) return false;
@@ -1035,13 +1048,11 @@ bool fs_mgr_overlayfs_invalid() {
     return ret;
 }
 
-}  // namespace
-
-Fstab fs_mgr_overlayfs_candidate_list(const Fstab& fstab) {
+Fstab fs_mgr_overlayfs_candidate_list(const Fstab& fstab, const Fstab& mounts) {
     Fstab candidates;
     for (const auto& entry : fstab) {
         FstabEntry new_entry = entry;
-        if (!fs_mgr_overlayfs_already_mounted(entry.mount_point) &&
+        if (!fs_mgr_overlayfs_already_mounted(mounts, entry.mount_point) &&
             !fs_mgr_wants_overlayfs(&new_entry)) {
             continue;
         }
@@ -1065,15 +1076,24 @@ Fstab fs_mgr_overlayfs_candidate_list(const Fstab& fstab) {
     return candidates;
 }
 
+}  // namespace
+
+Fstab fs_mgr_overlayfs_candidate_list(const Fstab& fstab) {
+    return fs_mgr_overlayfs_candidate_list(fstab, fs_mgr_overlayfs_read_mounts());
+}
+
 bool fs_mgr_overlayfs_mount_all(Fstab* fstab) {
     auto ret = false;
     if (fs_mgr_overlayfs_invalid()) return ret;
 
+    // Mounting the overlays doesn't change whether the other candidates are already overlaid,
+    // so one snapshot of /proc/mounts answers that for all of them.
+    const auto mounts = fs_mgr_overlayfs_read_mounts();
     auto scratch_can_be_mounted = true;
-    for (const auto& entry : fs_mgr_overlayfs_candidate_list(*fstab)) {
+    for (const auto& entry : fs_mgr_overlayfs_candidate_list(*fstab, mounts)) {
         if (fs_mgr_is_verity_enabled(entry)) continue;
         auto mount_point = fs_mgr_mount_point(entry.mount_point);
-        if (fs_mgr_overlayfs_already_mounted(mount_point)) {
+        if (fs_mgr_overlayfs_already_mounted(mounts, mount_point)) {
             ret = true;
             continue;
         }
@@ -1105,9 +1125,12 @@ std::vector<std::string> fs_mgr_overlayfs_required_devices(Fstab* fstab) {
         return {};
     }
 
-    for (const auto& entry : fs_mgr_overlayfs_candidate_list(*fstab)) {
+    const auto mounts = fs_mgr_overlayfs_read_mounts();
+    for (const auto& entry : fs_mgr_overlayfs_candidate_list(*fstab, mounts)) {
         if (fs_mgr_is_verity_enabled(entry)) continue;
-        if (fs_mgr_overlayfs_already_mounted(fs_mgr_mount_point(entry.mount_point))) continue;
+        if (fs_mgr_overlayfs_already_mounted(mounts, fs_mgr_mount_point(entry.mount_point))) {
+            continue;
+        }
         auto device = fs_mgr_overlayfs_scratch_device();
         if (!fs_mgr_overlayfs_scratch_can_be_mounted(device)) break;
         return {device};
@@ -1227,15 +1250,18 @@ bool fs_mgr_overlayfs_teardown(const char* mount_point, bool* change) {
 }
 
 bool fs_mgr_overlayfs_is_setup() {
-    if (fs_mgr_overlayfs_already_mounted(kScratchMountPoint, false)) return true;
+    const auto mounts = fs_mgr_overlayfs_read_mounts();
+    if (fs_mgr_overlayfs_already_mounted(mounts, kScratchMountPoint, false)) return true;
     Fstab fstab;
     if (!ReadDefaultFstab(&fstab)) {
         return false;
     }
     if (fs_mgr_overlayfs_invalid()) return false;
-    for (const auto& entry : fs_mgr_overlayfs_candidate_list(fstab)) {
+    for (const auto& entry : fs_mgr_overlayfs_candidate_list(fstab, mounts)) {
         if (fs_mgr_is_verity_enabled(entry)) continue;
-        if (fs_mgr_overlayfs_already_mounted(fs_mgr_mount_point(entry.mount_point))) return true;
+        if (fs_mgr_overlayfs_already_mounted(mounts, fs_mgr_mount_point(entry.mount_point))) {
+            return true;
+        }
     }
     return false;
 }
@@ -1275,12 +1301,21 @@ std::string fs_mgr_get_context(const std::string& mount_point) {
     return context;
 }
 
-OverlayfsValidResult fs_mgr_overlayfs_valid() {
+namespace {
+
+OverlayfsValidResult fs_mgr_overlayfs_probe_valid(bool* can_cache) {
     // Overlayfs available in the kernel, and patched for override_creds?
     if (fs_mgr_access("/sys/module/overlay/parameters/override_creds")) {
         return OverlayfsValidResult::kOverrideCredsRequired;
     }
-    if (!fs_mgr_overlayfs_filesystem_available("overlay")) {
+    // /sys or /proc may not be mounted yet, so don't remember what we found then.
+    if (!fs_mgr_access("/sys/module")) *can_cache = false;
+    std::string filesystems;
+    if (!android::base::ReadFileToString("/proc/filesystems", &filesystems)) {
+        *can_cache = false;
+        return OverlayfsValidResult::kNotSupported;
+    }
+    if (filesystems.find("\toverlay\n") == std::string::npos) {
         return OverlayfsValidResult::kNotSupported;
     }
     struct utsname uts;
@@ -1302,3 +1337,19 @@ OverlayfsValidResult fs_mgr_overlayfs_valid() {
     }
     return OverlayfsValidResult::kOk;
 }
+
+}  // namespace
+
+// The kernel doesn't change under us, so only probe it once per process; this is asked for
+// every overlay candidate and every overlay mount.
+OverlayfsValidResult fs_mgr_overlayfs_valid() {
+    static std::mutex lock;
+    static std::optional<OverlayfsValidResult> cached;
+    std::lock_guard<std::mutex> guard(lock);
+    if (cached) return *cached;
+
+    auto can_cache = true;
+    auto result = fs_mgr_overlayfs_probe_valid(&can_cache);
+    if (can_cache) cached = result;
+    return result;
+}
@@ -15,16 +15,50 @@
 #pragma once
 
 #include <chrono>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace android {
 namespace fs_mgr {
 
-// Wait at most |relative_timeout| milliseconds for |path| to exist. dirname(path)
-// must already exist. For example, to wait on /dev/block/dm-6, /dev/block must
-// be a valid directory.
+// Wait at most |relative_timeout| milliseconds for |path| to exist. If
+// dirname(path) does not exist yet, its nearest existing ancestor is watched
+// until it does.
 bool WaitForFile(const std::string& path, const std::chrono::milliseconds relative_timeout);
 
+// Wait at most |relative_timeout| milliseconds for every one of |paths| to
+// exist. All of them are watched before waiting for any.
+bool WaitForFiles(const std::vector<std::string>& paths,
+                  const std::chrono::milliseconds relative_timeout);
+
+// Waits for many paths to be created, with one inotify instance and one watch
+// per directory shared between all of them. Paths may be added and waited on
+// from any number of threads at once: one waiting thread reads the events on
+// behalf of the others and wakes them as their paths appear. If inotify is not
+// available, paths are polled instead.
+class FileWaiter {
+  public:
+    FileWaiter();
+    ~FileWaiter();
+
+    // Start watching for |path| to exist. This can be called well before
+    // waiting, so that the path may already be there when the wait begins.
+    void Add(const std::string& path);
+
+    // Wait at most |relative_timeout| milliseconds for |path| to exist,
+    // adding it first if needed.
+    bool Wait(const std::string& path, const std::chrono::milliseconds relative_timeout);
+
+    // Wait at most |relative_timeout| milliseconds for every path added so
+    // far to exist.
+    bool WaitAll(const std::chrono::milliseconds relative_timeout);
+
+  private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
 // Wait at most |relative_timeout| milliseconds for |path| to stop existing.
 // Note that this only returns true if the inode itself no longer exists, i.e.,
 // all outstanding file descriptors have been closed.
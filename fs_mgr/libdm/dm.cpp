@@ -20,6 +20,7 @@
 #include <sys/sysmacros.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <functional>
 #include <thread>
 
@@ -27,6 +28,7 @@
 #include <android-base/logging.h>
 #include <android-base/macros.h>
 #include <android-base/strings.h>
+#include <fs_mgr/file_wait.h>
 #include <uuid/uuid.h>
 
 #include "utility.h"
@@ -204,7 +206,104 @@ bool DeviceMapper::CreateDevice(const std::string& name, const DmTable& table) {
     return true;
 }
 
+bool DeviceMapper::CreateDevices(const std::vector<DeviceSpec>& devices,
+                                 std::vector<std::string>* paths,
+                                 const std::chrono::milliseconds& timeout_ms,
+                                 CreateDevicesTimings* timings) {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    using std::chrono::steady_clock;
+
+    CreateDevicesTimings ignore_timings;
+    if (!timings) {
+        timings = &ignore_timings;
+    }
+    *timings = {};
+    paths->clear();
+
+    std::vector<std::string> created;
+    auto fail = [&]() -> bool {
+        for (const auto& name : created) {
+            DeleteDevice(name);
+        }
+        paths->clear();
+        return false;
+    };
+
+    // Watch for each node as soon as its device exists, so that no uevent is
+    // missed while the rest of the batch is set up.
+    android::fs_mgr::FileWaiter waiter;
+    std::vector<std::string> unique_paths;
+    for (const auto& device : devices) {
+        auto start = steady_clock::now();
+        if (!CreateDevice(device.name, GenerateUuid())) {
+            return fail();
+        }
+        created.emplace_back(device.name);
+        auto now = steady_clock::now();
+        timings->create += duration_cast<microseconds>(now - start);
+
+        start = now;
+        if (!LoadTable(device.name, *device.table)) {
+            return fail();
+        }
+        now = steady_clock::now();
+        timings->load += duration_cast<microseconds>(now - start);
+
+        start = now;
+        if (!ChangeState(device.name, DmDeviceState::ACTIVE)) {
+            return fail();
+        }
+        now = steady_clock::now();
+        timings->activate += duration_cast<microseconds>(now - start);
+
+        std::string unique_path, path;
+        if (!GetDeviceUniquePath(device.name, &unique_path) ||
+            !GetDmDevicePathByName(device.name, &path)) {
+            return fail();
+        }
+        if (timeout_ms > std::chrono::milliseconds::zero()) {
+            waiter.Add(unique_path);
+        }
+        unique_paths.emplace_back(unique_path);
+        paths->emplace_back(path);
+    }
+
+    if (timeout_ms <= std::chrono::milliseconds::zero()) {
+        return true;
+    }
+
+    auto start = steady_clock::now();
+    auto deadline = start + timeout_ms;
+    for (const auto& unique_path : unique_paths) {
+        auto remaining = std::max(duration_cast<std::chrono::milliseconds>(
+                                          deadline - steady_clock::now()),
+                                  std::chrono::milliseconds::zero());
+        if (!waiter.Wait(unique_path, remaining)) {
+            LOG(ERROR) << "Timed out waiting for device path: " << unique_path;
+            timings->wait = duration_cast<microseconds>(steady_clock::now() - start);
+            return fail();
+        }
+    }
+    timings->wait = duration_cast<microseconds>(steady_clock::now() - start);
+    return true;
+}
+
 bool DeviceMapper::LoadTableAndActivate(const std::string& name, const DmTable& table) {
+    if (!LoadTable(name, table)) {
+        return false;
+    }
+
+    struct dm_ioctl io;
+    InitIo(&io, name);
+    if (ioctl(fd_, DM_DEV_SUSPEND, &io)) {
+        PLOG(ERROR) << "DM_TABLE_SUSPEND resume failed";
+        return false;
+    }
+    return true;
+}
+
+bool DeviceMapper::LoadTable(const std::string& name, const DmTable& table) {
     std::string ioctl_buffer(sizeof(struct dm_ioctl), 0);
     ioctl_buffer += table.Serialize();
 
@@ -220,12 +319,6 @@ bool DeviceMapper::LoadTableAndActivate(const std::string& name, const DmTable&
         PLOG(ERROR) << "DM_TABLE_LOAD failed";
         return false;
     }
-
-    InitIo(io, name);
-    if (ioctl(fd_, DM_DEV_SUSPEND, io)) {
-        PLOG(ERROR) << "DM_TABLE_SUSPEND resume failed";
-        return false;
-    }
     return true;
 }
 
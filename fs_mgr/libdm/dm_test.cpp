@@ -194,6 +194,69 @@ TEST(libdm, DmSuspendResume) {
     ASSERT_EQ(dm.GetState(dev.name()), DmDeviceState::ACTIVE);
 }
 
+TEST(libdm, CreateDevices) {
+    unique_fd tmp(CreateTempFile("file_create_devices", 4096));
+    ASSERT_GE(tmp, 0);
+    const char message[] = "Every device of the batch maps this sector.";
+    ASSERT_TRUE(android::base::WriteFully(tmp, message, sizeof(message)));
+
+    LoopDevice loop(tmp, 10s);
+    ASSERT_TRUE(loop.valid());
+
+    constexpr int kNumDevices = 4;
+    vector<DmTable> tables(kNumDevices);
+    vector<DeviceMapper::DeviceSpec> devices;
+    for (int i = 0; i < kNumDevices; i++) {
+        ASSERT_TRUE(tables[i].Emplace<DmTargetLinear>(0, 1, loop.device(), 0));
+        devices.push_back({"libdm-test-create-devices-" + to_string(i), &tables[i]});
+    }
+
+    auto& dm = DeviceMapper::Instance();
+    vector<string> paths;
+    DeviceMapper::CreateDevicesTimings timings;
+    ASSERT_TRUE(dm.CreateDevices(devices, &paths, 10s, &timings));
+    ASSERT_EQ(paths.size(), kNumDevices);
+
+    for (int i = 0; i < kNumDevices; i++) {
+        EXPECT_EQ(dm.GetState(devices[i].name), DmDeviceState::ACTIVE);
+
+        unique_fd dev_fd(open(paths[i].c_str(), O_RDONLY | O_CLOEXEC));
+        ASSERT_GE(dev_fd, 0) << paths[i];
+        char sector[512];
+        ASSERT_TRUE(android::base::ReadFully(dev_fd, sector, sizeof(sector)));
+        EXPECT_EQ(strncmp(sector, message, sizeof(message)), 0);
+    }
+    EXPECT_GT(timings.create.count() + timings.load.count() + timings.activate.count(), 0);
+
+    for (const auto& device : devices) {
+        ASSERT_TRUE(dm.DeleteDevice(device.name));
+    }
+}
+
+TEST(libdm, CreateDevicesFailureDeletesBatch) {
+    unique_fd tmp(CreateTempFile("file_create_devices_fail", 4096));
+    ASSERT_GE(tmp, 0);
+    LoopDevice loop(tmp, 10s);
+    ASSERT_TRUE(loop.valid());
+
+    DmTable good, bad;
+    ASSERT_TRUE(good.Emplace<DmTargetLinear>(0, 1, loop.device(), 0));
+    // A linear target past the end of the loop device is rejected by the kernel.
+    ASSERT_TRUE(bad.Emplace<DmTargetLinear>(0, 1, loop.device(), 1024 * 1024));
+
+    vector<DeviceMapper::DeviceSpec> devices = {
+            {"libdm-test-create-devices-good", &good},
+            {"libdm-test-create-devices-bad", &bad},
+    };
+
+    auto& dm = DeviceMapper::Instance();
+    vector<string> paths;
+    ASSERT_FALSE(dm.CreateDevices(devices, &paths, 10s));
+    EXPECT_TRUE(paths.empty());
+    EXPECT_EQ(dm.GetState("libdm-test-create-devices-good"), DmDeviceState::INVALID);
+    EXPECT_EQ(dm.GetState("libdm-test-create-devices-bad"), DmDeviceState::INVALID);
+}
+
 TEST(libdm, DmVerityArgsAvb2) {
     std::string device = "/dev/block/platform/soc/1da4000.ufshc/by-name/vendor_a";
     std::string algorithm = "sha1";
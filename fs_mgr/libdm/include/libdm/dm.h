@@ -136,6 +136,32 @@ class DeviceMapper final {
     // use the timeout variant above.
     bool CreateDevice(const std::string& name, const DmTable& table);
 
+    // A device to create with CreateDevices().
+    struct DeviceSpec {
+        std::string name;
+        const DmTable* table;
+    };
+
+    // Time spent in each step of CreateDevices(), summed over the whole batch.
+    struct CreateDevicesTimings {
+        std::chrono::microseconds create = {};
+        std::chrono::microseconds load = {};
+        std::chrono::microseconds activate = {};
+        std::chrono::microseconds wait = {};
+    };
+
+    // Creates, loads and activates every device in |devices| before waiting
+    // for any of their paths, so that ueventd can create the nodes while the
+    // remaining ioctls are issued, and all waits share one |timeout_ms|
+    // deadline. Like the timeout variant of CreateDevice, it waits on unique
+    // paths, and returns the dm-N path of each device in |paths|, in order.
+    // If any step fails for any device, every device of the batch is deleted
+    // and false is returned. If |timings| is not null, it is filled with the
+    // time spent in each step.
+    bool CreateDevices(const std::vector<DeviceSpec>& devices, std::vector<std::string>* paths,
+                       const std::chrono::milliseconds& timeout_ms,
+                       CreateDevicesTimings* timings = nullptr);
+
     // Loads the device mapper table from parameter into the underlying device
     // mapper device with given name and activate / resumes the device in the
     // process. A device with the given name must already exist.
@@ -223,6 +249,7 @@ class DeviceMapper final {
     static constexpr uint32_t kMaxPossibleDmDevices = 256;
 
     bool CreateDevice(const std::string& name, const std::string& uuid = {});
+    bool LoadTable(const std::string& name, const DmTable& table);
     bool GetTable(const std::string& name, uint32_t flags, std::vector<TargetInfo>* table);
     void InitIo(struct dm_ioctl* io, const std::string& name = std::string()) const;
 
@@ -19,6 +19,8 @@
 
 #include <thread>
 
+#include <fs_mgr/file_wait.h>
+
 using namespace std::literals;
 
 namespace android {
@@ -41,15 +43,7 @@ bool WaitForCondition(const std::function<WaitResult()>& condition,
 }
 
 bool WaitForFile(const std::string& path, const std::chrono::milliseconds& timeout_ms) {
-    auto condition = [&]() -> WaitResult {
-        // If the file exists but returns EPERM or something, we consider the
-        // condition met.
-        if (access(path.c_str(), F_OK) != 0) {
-            if (errno == ENOENT) return WaitResult::Wait;
-        }
-        return WaitResult::Done;
-    };
-    return WaitForCondition(condition, timeout_ms);
+    return android::fs_mgr::WaitForFile(path, timeout_ms);
 }
 
 }  // namespace dm
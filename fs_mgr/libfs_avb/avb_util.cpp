@@ -16,19 +16,26 @@
 
 #include "avb_util.h"
 
+#include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
+#include <future>
+#include <iterator>
 #include <sstream>
 
 #include <android-base/file.h>
 #include <android-base/strings.h>
 #include <android-base/unique_fd.h>
 
+#include "sha.h"
 #include "util.h"
 
 using android::base::Basename;
 using android::base::ReadFileToString;
+using android::base::ReadFullyAtOffset;
 using android::base::StartsWith;
 using android::base::unique_fd;
 
@@ -183,6 +190,143 @@ std::unique_ptr<FsAvbHashtreeDescriptor> GetHashtreeDescriptor(
     return hashtree_desc;
 }
 
+std::unique_ptr<FsAvbHashDescriptor> GetHashDescriptor(
+        const std::string& partition_name, const std::vector<VBMetaData>& vbmeta_images) {
+    bool found = false;
+    const uint8_t* desc_partition_name;
+    auto hash_desc = std::make_unique<FsAvbHashDescriptor>();
+
+    for (const auto& vbmeta : vbmeta_images) {
+        size_t num_descriptors;
+        std::unique_ptr<const AvbDescriptor* [], decltype(&avb_free)> descriptors(
+                avb_descriptor_get_all(vbmeta.data(), vbmeta.size(), &num_descriptors), avb_free);
+
+        if (!descriptors || num_descriptors < 1) {
+            continue;
+        }
+
+        for (size_t n = 0; n < num_descriptors && !found; n++) {
+            AvbDescriptor desc;
+            if (!avb_descriptor_validate_and_byteswap(descriptors[n], &desc)) {
+                LWARNING << "Descriptor[" << n << "] is invalid";
+                continue;
+            }
+            if (desc.tag == AVB_DESCRIPTOR_TAG_HASH) {
+                desc_partition_name = (const uint8_t*)descriptors[n] + sizeof(AvbHashDescriptor);
+                if (!avb_hash_descriptor_validate_and_byteswap((AvbHashDescriptor*)descriptors[n],
+                                                               hash_desc.get())) {
+                    continue;
+                }
+                if (hash_desc->partition_name_len != partition_name.length()) {
+                    continue;
+                }
+                // Notes that desc_partition_name is not NUL-terminated.
+                std::string hash_partition_name((const char*)desc_partition_name,
+                                                hash_desc->partition_name_len);
+                if (hash_partition_name == partition_name) {
+                    found = true;
+                }
+            }
+        }
+
+        if (found) break;
+    }
+
+    if (!found) {
+        LERROR << "Hash descriptor not found: " << partition_name;
+        return nullptr;
+    }
+
+    hash_desc->partition_name = partition_name;
+
+    const uint8_t* desc_salt = desc_partition_name + hash_desc->partition_name_len;
+    hash_desc->salt = BytesToHex(desc_salt, hash_desc->salt_len);
+
+    const uint8_t* desc_digest = desc_salt + hash_desc->salt_len;
+    hash_desc->digest = BytesToHex(desc_digest, hash_desc->digest_len);
+
+    return hash_desc;
+}
+
+// The most of an image held in memory at once is two chunks: the one being hashed and the one
+// being read.
+constexpr size_t kHashChunkSize = 1024 * 1024;
+
+template <typename Hasher>
+static bool HashImage(int fd, uint64_t image_size, const std::string& salt,
+                      std::string* out_digest) {
+    Hasher hasher;
+    if (!salt.empty()) {
+        std::vector<uint8_t> salt_bytes(salt.size() / 2);
+        if (!HexToBytes(salt_bytes.data(), salt_bytes.size(), salt)) {
+            LERROR << "Invalid salt: " << salt;
+            return false;
+        }
+        hasher.update(salt_bytes.data(), salt_bytes.size());
+    }
+
+    posix_fadvise(fd, 0, image_size, POSIX_FADV_SEQUENTIAL);
+    auto read_chunk = [fd](uint8_t* buffer, size_t size, uint64_t offset) {
+        return ReadFullyAtOffset(fd, buffer, size, offset);
+    };
+
+    std::array<std::vector<uint8_t>, 2> buffers;
+    for (auto& buffer : buffers) {
+        buffer.resize(std::min<uint64_t>(image_size, kHashChunkSize));
+    }
+    uint64_t offset = 0;
+    size_t size = buffers[0].size();
+    if (!read_chunk(buffers[0].data(), size, offset)) {
+        PERROR << "Failed to read image at offset: " << offset;
+        return false;
+    }
+    for (size_t current = 0; size > 0; current ^= 1) {
+        uint64_t next_offset = offset + size;
+        size_t next_size = std::min<uint64_t>(image_size - next_offset, kHashChunkSize);
+        std::future<bool> next_read;
+        if (next_size > 0) {
+            next_read = std::async(std::launch::async, read_chunk, buffers[current ^ 1].data(),
+                                   next_size, next_offset);
+        }
+
+        hasher.update(buffers[current].data(), size);
+
+        if (next_size > 0 && !next_read.get()) {
+            PERROR << "Failed to read image at offset: " << next_offset;
+            return false;
+        }
+        offset = next_offset;
+        size = next_size;
+    }
+
+    *out_digest = BytesToHex(hasher.finalize(), Hasher::DIGEST_SIZE);
+    return true;
+}
+
+bool VerifyHashDescriptor(int fd, const FsAvbHashDescriptor& hash_desc) {
+    std::string hash_algorithm((const char*)hash_desc.hash_algorithm,
+                               strnlen((const char*)hash_desc.hash_algorithm,
+                                       sizeof(hash_desc.hash_algorithm)));
+    std::string digest;
+    bool hashed;
+    if (hash_algorithm == "sha256") {
+        hashed = HashImage<SHA256Hasher>(fd, hash_desc.image_size, hash_desc.salt, &digest);
+    } else if (hash_algorithm == "sha512") {
+        hashed = HashImage<SHA512Hasher>(fd, hash_desc.image_size, hash_desc.salt, &digest);
+    } else {
+        LERROR << "Unsupported hash algorithm: " << hash_algorithm;
+        return false;
+    }
+    if (!hashed) return false;
+
+    if (digest != hash_desc.digest) {
+        LERROR << "Hash of " << hash_desc.partition_name << " mismatch, expected "
+               << hash_desc.digest << ", got " << digest;
+        return false;
+    }
+    return true;
+}
+
 bool LoadAvbHashtreeToEnableVerity(FstabEntry* fstab_entry, bool wait_for_verity_dev,
                                    const std::vector<VBMetaData>& vbmeta_images,
                                    const std::string& ab_suffix,
@@ -553,12 +697,56 @@ std::unique_ptr<VBMetaData> LoadAndVerifyVbmetaByPath(
     return vbmeta;
 }
 
+// Loads each chained partition, and the partitions chained from it, on its own thread, into its
+// own list of vbmeta images. They are then merged in chain order, stopping at the first 'ERROR'
+// exactly like the serial loop does.
+static VBMetaVerifyResult LoadAndVerifyChainsInParallel(
+        const std::vector<ChainInfo>& chain_partitions, const std::string& ab_suffix,
+        const std::string& ab_other_suffix, bool allow_verification_error,
+        bool rollback_protection,
+        const std::function<std::string(const std::string&)>& device_path_constructor,
+        VBMetaVerifyResult verify_result, std::vector<VBMetaData>* out_vbmeta_images) {
+    struct ChainResult {
+        VBMetaVerifyResult verify_result;
+        std::vector<VBMetaData> vbmeta_images;
+    };
+    std::vector<std::future<ChainResult>> chain_results;
+    for (const auto& chain : chain_partitions) {
+        chain_results.emplace_back(std::async(std::launch::async, [&, chain]() {
+            ChainResult result;
+            result.verify_result = LoadAndVerifyVbmetaByPartition(
+                    chain.partition_name, ab_suffix, ab_other_suffix, chain.public_key_blob,
+                    allow_verification_error, true /* load_chained_vbmeta */, rollback_protection,
+                    device_path_constructor, true /* is_chained_vbmeta */, &result.vbmeta_images,
+                    true /* verify_chains_in_parallel */);
+            return result;
+        }));
+    }
+
+    // Waits for all of them, even after an 'ERROR', as they use the arguments by reference.
+    std::vector<ChainResult> results;
+    for (auto& chain_result : chain_results) {
+        results.emplace_back(chain_result.get());
+    }
+    for (auto& result : results) {
+        std::move(result.vbmeta_images.begin(), result.vbmeta_images.end(),
+                  std::back_inserter(*out_vbmeta_images));
+        if (result.verify_result != VBMetaVerifyResult::kSuccess) {
+            verify_result = result.verify_result;  // might be 'ERROR' or 'ERROR VERIFICATION'.
+            if (verify_result == VBMetaVerifyResult::kError) {
+                return verify_result;  // stop here if we got an 'ERROR'.
+            }
+        }
+    }
+    return verify_result;
+}
+
 VBMetaVerifyResult LoadAndVerifyVbmetaByPartition(
     const std::string& partition_name, const std::string& ab_suffix,
     const std::string& ab_other_suffix, const std::string& expected_public_key_blob,
     bool allow_verification_error, bool load_chained_vbmeta, bool rollback_protection,
     std::function<std::string(const std::string&)> device_path_constructor, bool is_chained_vbmeta,
-    std::vector<VBMetaData>* out_vbmeta_images) {
+    std::vector<VBMetaData>* out_vbmeta_images, bool verify_chains_in_parallel) {
     auto image_path = device_path_constructor(
         AvbPartitionToDevicePatition(partition_name, ab_suffix, ab_other_suffix));
 
@@ -583,6 +771,12 @@ VBMetaVerifyResult LoadAndVerifyVbmetaByPartition(
         if (fatal_error) {
             return VBMetaVerifyResult::kError;
         }
+        if (verify_chains_in_parallel && chain_partitions.size() > 1) {
+            return LoadAndVerifyChainsInParallel(chain_partitions, ab_suffix, ab_other_suffix,
+                                                 allow_verification_error, rollback_protection,
+                                                 device_path_constructor, verify_result,
+                                                 out_vbmeta_images);
+        }
         for (auto& chain : chain_partitions) {
             auto sub_ret = LoadAndVerifyVbmetaByPartition(
                 chain.partition_name, ab_suffix, ab_other_suffix, chain.public_key_blob,
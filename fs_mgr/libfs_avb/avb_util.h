@@ -44,6 +44,14 @@ std::string GetAvbPropertyDescriptor(const std::string& key,
 std::unique_ptr<FsAvbHashtreeDescriptor> GetHashtreeDescriptor(
         const std::string& partition_name, const std::vector<VBMetaData>& vbmeta_images);
 
+// AvbHashDescriptor lookup, and verification of the image it covers.
+std::unique_ptr<FsAvbHashDescriptor> GetHashDescriptor(
+        const std::string& partition_name, const std::vector<VBMetaData>& vbmeta_images);
+
+// Hashes the first |image_size| bytes of fd with bounded buffers, reading each chunk while
+// the previous one is hashed, and compares the result with the descriptor's digest.
+bool VerifyHashDescriptor(int fd, const FsAvbHashDescriptor& hash_desc);
+
 bool ConstructVerityTable(const FsAvbHashtreeDescriptor& hashtree_desc,
                           const std::string& blk_device, android::dm::DmTable* table);
 
@@ -99,12 +107,14 @@ std::unique_ptr<VBMetaData> LoadAndVerifyVbmetaByPath(
 // Loads the top-level vbmeta and all its chained vbmeta images.
 // The actual device path is constructed at runtime by:
 // partition_name, ab_suffix, ab_other_suffix, and device_path_constructor.
+// With verify_chains_in_parallel, the chained partitions of each vbmeta are read and verified
+// concurrently; the results are the same as loading them one after another.
 VBMetaVerifyResult LoadAndVerifyVbmetaByPartition(
     const std::string& partition_name, const std::string& ab_suffix,
     const std::string& ab_other_suffix, const std::string& expected_public_key_blob,
     bool allow_verification_error, bool load_chained_vbmeta, bool rollback_protection,
     std::function<std::string(const std::string&)> device_path_constructor, bool is_chained_vbmeta,
-    std::vector<VBMetaData>* out_vbmeta_images);
+    std::vector<VBMetaData>* out_vbmeta_images, bool verify_chains_in_parallel = false);
 
 }  // namespace fs_mgr
 }  // namespace android
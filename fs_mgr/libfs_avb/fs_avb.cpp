@@ -184,7 +184,8 @@ AvbUniquePtr AvbHandle::LoadAndVerifyVbmeta(
         const std::string& ab_other_suffix, const std::string& expected_public_key_path,
         const HashAlgorithm& hash_algorithm, bool allow_verification_error,
         bool load_chained_vbmeta, bool rollback_protection,
-        std::function<std::string(const std::string&)> custom_device_path) {
+        std::function<std::string(const std::string&)> custom_device_path,
+        bool verify_chains_in_parallel) {
     AvbUniquePtr avb_handle(new AvbHandle());
     if (!avb_handle) {
         LERROR << "Failed to allocate AvbHandle";
@@ -211,7 +212,7 @@ AvbUniquePtr AvbHandle::LoadAndVerifyVbmeta(
     auto verify_result = LoadAndVerifyVbmetaByPartition(
         partition_name, ab_suffix, ab_other_suffix, expected_key_blob, allow_verification_error,
         load_chained_vbmeta, rollback_protection, device_path, false,
-        /* is_chained_vbmeta */ &avb_handle->vbmeta_images_);
+        /* is_chained_vbmeta */ &avb_handle->vbmeta_images_, verify_chains_in_parallel);
     switch (verify_result) {
         case VBMetaVerifyResult::kSuccess:
             avb_handle->status_ = AvbHandleStatus::kSuccess;
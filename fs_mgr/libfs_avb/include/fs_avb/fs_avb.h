@@ -82,6 +82,9 @@ class AvbHandle {
     //   - a valid unique_ptr with status AvbHandleStatus::Success: the metadata
     //     is verified and can be trusted.
     //
+    // With verify_chains_in_parallel, LoadAndVerifyVbmeta() reads and verifies the chained
+    // partitions of each vbmeta concurrently, instead of one after another.
+    //
     // TODO(bowgotsai): remove Open() and switch to LoadAndVerifyVbmeta().
     static AvbUniquePtr Open();                 // loads inline vbmeta, via libavb.
     static AvbUniquePtr LoadAndVerifyVbmeta();  // loads inline vbmeta.
@@ -92,7 +95,8 @@ class AvbHandle {
             const std::string& ab_other_suffix, const std::string& expected_public_key,
             const HashAlgorithm& hash_algorithm, bool allow_verification_error,
             bool load_chained_vbmeta, bool rollback_protection,
-            std::function<std::string(const std::string&)> custom_device_path = nullptr);
+            std::function<std::string(const std::string&)> custom_device_path = nullptr,
+            bool verify_chains_in_parallel = false);
 
     // Sets up dm-verity on the given fstab entry.
     // The 'wait_for_verity_dev' parameter makes this function wait for the
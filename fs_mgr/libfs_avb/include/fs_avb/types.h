@@ -61,6 +61,12 @@ struct FsAvbHashtreeDescriptor : AvbHashtreeDescriptor {
     std::string root_digest;
 };
 
+struct FsAvbHashDescriptor : AvbHashDescriptor {
+    std::string partition_name;
+    std::string salt;
+    std::string digest;
+};
+
 class VBMetaData {
   public:
     // Constructors
@@ -32,12 +32,14 @@ using android::fs_mgr::FstabEntry;
 using android::fs_mgr::GetAvbFooter;
 using android::fs_mgr::GetAvbPropertyDescriptor;
 using android::fs_mgr::GetChainPartitionInfo;
+using android::fs_mgr::GetHashDescriptor;
 using android::fs_mgr::GetTotalSize;
 using android::fs_mgr::LoadAndVerifyVbmetaByPartition;
 using android::fs_mgr::LoadAndVerifyVbmetaByPath;
 using android::fs_mgr::ValidatePublicKeyBlob;
 using android::fs_mgr::VBMetaData;
 using android::fs_mgr::VBMetaVerifyResult;
+using android::fs_mgr::VerifyHashDescriptor;
 using android::fs_mgr::VerifyVBMetaData;
 using android::fs_mgr::VerifyVBMetaSignature;
 
@@ -415,6 +417,51 @@ TEST_F(AvbUtilTest, GetVBMetaHeader) {
     EXPECT_EQ(content_padding.size() - padding.size(), vbmeta_padding.size());
 }
 
+TEST_F(AvbUtilTest, VerifyHashDescriptor) {
+    // Generates a raw boot.img, spanning a few hashing chunks and ending in a partial one.
+    const size_t image_size = 5 * 1024 * 1024 + 4096;
+    const size_t partition_size = 10 * 1024 * 1024;
+    base::FilePath boot_path = GenerateImage("boot.img", image_size);
+    // Appends AVB Hash Footer.
+    AddAvbFooter(boot_path, "hash", "boot", partition_size, "SHA256_RSA4096", 10,
+                 data_dir_.Append("testkey_rsa4096.pem"), "d00df00d",
+                 "--internal_release_string \"unit test\"");
+    std::vector<VBMetaData> vbmeta_images;
+    vbmeta_images.emplace_back(ExtractAndLoadVBMetaData(boot_path, "boot-vbmeta.img"));
+
+    auto hash_desc = GetHashDescriptor("boot", vbmeta_images);
+    ASSERT_NE(nullptr, hash_desc);
+    EXPECT_EQ(image_size, hash_desc->image_size);
+    EXPECT_EQ("boot", hash_desc->partition_name);
+    EXPECT_EQ("d00df00d", hash_desc->salt);
+    EXPECT_EQ(64UL, hash_desc->digest.size());
+    EXPECT_EQ(nullptr, GetHashDescriptor("system", vbmeta_images));
+
+    {
+        auto fd = OpenUniqueReadFd(boot_path);
+        EXPECT_TRUE(VerifyHashDescriptor(fd, *hash_desc));
+    }
+
+    // Modifies a byte in the last chunk, then in the first one.
+    ModifyFile(boot_path, image_size - 4096, 4096);
+    {
+        auto fd = OpenUniqueReadFd(boot_path);
+        EXPECT_FALSE(VerifyHashDescriptor(fd, *hash_desc));
+    }
+    ModifyFile(boot_path, 0, 4096);
+    {
+        auto fd = OpenUniqueReadFd(boot_path);
+        EXPECT_FALSE(VerifyHashDescriptor(fd, *hash_desc));
+    }
+
+    // Restores the image.
+    ModifyFile(boot_path, 0, -1);
+    {
+        auto fd = OpenUniqueReadFd(boot_path);
+        EXPECT_TRUE(VerifyHashDescriptor(fd, *hash_desc));
+    }
+}
+
 TEST_F(AvbUtilTest, ValidatePublicKeyBlob) {
     // Generates a raw key.bin
     const size_t key_size = 2048;
@@ -1251,6 +1298,21 @@ TEST_F(AvbUtilTest, LoadAndVerifyVbmetaByPartition) {
     EXPECT_TRUE(CompareVBMeta(vbmeta_system_path, vbmeta_images[2]));
     EXPECT_TRUE(CompareVBMeta(system_path, vbmeta_images[3]));
 
+    // Verifying the chains in parallel loads the same images, in the same order.
+    vbmeta_images.clear();
+    EXPECT_EQ(VBMetaVerifyResult::kSuccess,
+              LoadAndVerifyVbmetaByPartition(
+                  "vbmeta" /* partition_name */, "" /* ab_suffix */, "" /* other_suffix */,
+                  "" /* expected_public_key_blob*/, false /* allow_verification_error */,
+                  true /* load_chained_vbmeta */, true /* rollback_protection */, vbmeta_image_path,
+                  false /* is_chained_vbmeta*/, &vbmeta_images,
+                  true /* verify_chains_in_parallel */));
+    EXPECT_EQ(4UL, vbmeta_images.size());
+    EXPECT_TRUE(CompareVBMeta(vbmeta_path, vbmeta_images[0]));
+    EXPECT_TRUE(CompareVBMeta(boot_path, vbmeta_images[1]));
+    EXPECT_TRUE(CompareVBMeta(vbmeta_system_path, vbmeta_images[2]));
+    EXPECT_TRUE(CompareVBMeta(system_path, vbmeta_images[3]));
+
     // Skip loading chained vbmeta images.
     vbmeta_images.clear();
     EXPECT_EQ(VBMetaVerifyResult::kSuccess,
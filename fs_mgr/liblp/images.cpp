@@ -19,6 +19,11 @@
 #include <limits.h>
 #include <sys/stat.h>
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+
 #include <android-base/file.h>
 
 #include "reader.h"
@@ -35,6 +40,34 @@ using android::base::unique_fd;
 static const int O_NOFOLLOW = 0;
 #endif
 
+// Partition images are scanned this many blocks at a time.
+static const size_t kScanBlocks = 256;
+
+// Runs fn(0) ... fn(count - 1) on up to one thread per CPU. Once an fn fails,
+// the remaining indices are not started. Returns false if any fn failed.
+static bool ParallelFor(size_t count, const std::function<bool(size_t)>& fn) {
+    size_t num_threads = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+    std::atomic<size_t> next(0);
+    std::atomic<bool> ok(true);
+    auto worker = [&]() -> void {
+        for (size_t i = next++; i < count && ok; i = next++) {
+            if (!fn(i)) {
+                ok = false;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < num_threads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return ok;
+}
+
 static bool IsEmptySuperImage(borrowed_fd fd) {
     struct stat s;
     if (fstat(fd.get(), &s) < 0) {
@@ -203,7 +236,7 @@ bool ImageBuilder::Export(const std::string& file) {
 }
 
 bool ImageBuilder::ExportFiles(const std::string& output_dir) {
-    for (size_t i = 0; i < device_images_.size(); i++) {
+    auto export_file = [&](size_t i) -> bool {
         std::string name = GetBlockDevicePartitionName(metadata_.block_devices[i]);
         std::string file_name = "super_" + name + ".img";
         std::string file_path = output_dir + "/" + file_name;
@@ -220,8 +253,21 @@ bool ImageBuilder::ExportFiles(const std::string& output_dir) {
             LERROR << "sparse_file_write failed (error code " << ret << ")";
             return false;
         }
+        return true;
+    };
+
+#if defined(_WIN32)
+    // Without mmap, libsparse seeks the image fds, which a partition spanning
+    // several block devices shares between their sparse files.
+    for (size_t i = 0; i < device_images_.size(); i++) {
+        if (!export_file(i)) {
+            return false;
+        }
     }
     return true;
+#else
+    return ParallelFor(device_images_.size(), export_file);
+#endif
 }
 
 bool ImageBuilder::AddData(sparse_file* file, const std::string& blob, uint64_t sector) {
@@ -282,14 +328,13 @@ bool ImageBuilder::Build() {
         return false;
     }
 
+    std::vector<PartitionImage> images;
     for (const auto& partition : metadata_.partitions) {
         auto iter = images_.find(GetPartitionName(partition));
         if (iter == images_.end()) {
             continue;
         }
-        if (!AddPartitionImage(partition, iter->second)) {
-            return false;
-        }
+        images.push_back({&partition, iter->second, -1, {}});
         images_.erase(iter);
     }
 
@@ -297,6 +342,19 @@ bool ImageBuilder::Build() {
         LERROR << "Partition image was specified but no partition was found.";
         return false;
     }
+
+    // Reading the images and looking for fill blocks is what takes time, so
+    // that runs in parallel. The chunks are then added to the sparse files in
+    // partition order; libsparse merges adjacent chunks, so the result is the
+    // same as adding each block on its own.
+    if (!ParallelFor(images.size(), [&](size_t i) { return ScanPartitionImage(&images[i]); })) {
+        return false;
+    }
+    for (const auto& image : images) {
+        if (!AddPartitionImage(image)) {
+            return false;
+        }
+    }
     return true;
 }
 
@@ -310,22 +368,21 @@ static inline bool HasFillValue(uint32_t* buffer, size_t count) {
     return true;
 }
 
-bool ImageBuilder::AddPartitionImage(const LpMetadataPartition& partition,
-                                     const std::string& file) {
-    // Track which extent we're processing.
-    uint32_t extent_index = partition.first_extent_index;
+bool ImageBuilder::ScanPartitionImage(PartitionImage* image) {
+    const LpMetadataPartition& partition = *image->partition;
 
-    const LpMetadataExtent& extent = metadata_.extents[extent_index];
+    const LpMetadataExtent& extent = metadata_.extents[partition.first_extent_index];
     if (extent.target_type != LP_TARGET_TYPE_LINEAR) {
         LERROR << "Partition should only have linear extents: " << GetPartitionName(partition);
         return false;
     }
 
-    int fd = OpenImageFile(file);
+    int fd = OpenImageFile(image->file);
     if (fd < 0) {
         LERROR << "Could not open image for partition: " << GetPartitionName(partition);
         return false;
     }
+    image->fd = fd;
 
     // Make sure the image does not exceed the partition size.
     uint64_t file_length;
@@ -340,69 +397,85 @@ bool ImageBuilder::AddPartitionImage(const LpMetadataPartition& partition,
                << ")";
         return false;
     }
-    if (SeekFile64(fd, 0, SEEK_SET)) {
-        PERROR << "lseek failed";
-        return false;
-    }
-
-    // We track the current logical sector and the position the current extent
-    // ends at.
-    uint64_t output_sector = 0;
-    uint64_t extent_last_sector = extent.num_sectors;
 
-    // We also track the output device and the current output block within that
-    // device.
-    uint32_t output_block;
-    if (!SectorToBlock(extent.target_data, &output_block)) {
-        return false;
-    }
-    sparse_file* output_device = device_images_[extent.target_source].get();
+    // libsparse chunk lengths are 32-bit.
+    const uint64_t max_chunk_length = (UINT_MAX / block_size_) * block_size_;
 
-    // Proceed to read the file and build sparse images.
+    std::vector<uint32_t> buffer(kScanBlocks * block_size_ / sizeof(uint32_t));
     uint64_t pos = 0;
-    uint64_t remaining = file_length;
-    while (remaining) {
-        // Check if we need to advance to the next extent.
-        if (output_sector == extent_last_sector) {
-            extent_index++;
-            if (extent_index >= partition.first_extent_index + partition.num_extents) {
-                LERROR << "image is larger than extent table";
-                return false;
+    while (pos < file_length) {
+        size_t read_size = std::min<uint64_t>(buffer.size() * sizeof(uint32_t), file_length - pos);
+        if (!android::base::ReadFullyAtOffset(fd, buffer.data(), read_size, pos)) {
+            PERROR << "read failed";
+            return false;
+        }
+        for (size_t offset = 0; offset < read_size; offset += block_size_) {
+            size_t length = std::min<size_t>(block_size_, read_size - offset);
+            uint32_t* block = &buffer[offset / sizeof(uint32_t)];
+            bool fill = length == block_size_ && HasFillValue(block, length / sizeof(uint32_t));
+
+            ImageChunk* last = image->chunks.empty() ? nullptr : &image->chunks.back();
+            if (last && last->fill == fill && (!fill || last->fill_value == block[0]) &&
+                last->length + length <= max_chunk_length) {
+                last->length += length;
+            } else {
+                image->chunks.push_back({pos + offset, length, fill, fill ? block[0] : 0});
             }
+        }
+        pos += read_size;
+    }
+    return true;
+}
 
-            const LpMetadataExtent& extent = metadata_.extents[extent_index];
-            extent_last_sector += extent.num_sectors;
-            output_device = device_images_[extent.target_source].get();
-            if (!SectorToBlock(extent.target_data, &output_block)) {
-                return false;
+bool ImageBuilder::AddPartitionImage(const PartitionImage& image) {
+    const LpMetadataPartition& partition = *image.partition;
+
+    // Track which extent we're processing, and how much of it has been used.
+    uint32_t extent_index = partition.first_extent_index;
+    const LpMetadataExtent* extent = &metadata_.extents[extent_index];
+    uint64_t extent_used = 0;
+
+    for (const auto& chunk : image.chunks) {
+        uint64_t offset = chunk.offset;
+        uint64_t remaining = chunk.length;
+        while (remaining) {
+            // Check if we need to advance to the next extent.
+            if (extent_used == extent->num_sectors * LP_SECTOR_SIZE) {
+                extent_index++;
+                if (extent_index >= partition.first_extent_index + partition.num_extents) {
+                    LERROR << "image is larger than extent table";
+                    return false;
+                }
+                extent = &metadata_.extents[extent_index];
+                extent_used = 0;
             }
-        }
 
-        uint32_t buffer[block_size_ / sizeof(uint32_t)];
-        size_t read_size = remaining >= sizeof(buffer) ? sizeof(buffer) : size_t(remaining);
-        if (!android::base::ReadFully(fd, buffer, sizeof(buffer))) {
-            PERROR << "read failed";
-            return false;
-        }
-        if (read_size != sizeof(buffer) || !HasFillValue(buffer, read_size / sizeof(uint32_t))) {
-            int rv = sparse_file_add_fd(output_device, fd, pos, read_size, output_block);
-            if (rv) {
-                LERROR << "sparse_file_add_fd failed with code: " << rv;
+            uint32_t output_block;
+            if (!SectorToBlock(extent->target_data + extent_used / LP_SECTOR_SIZE, &output_block)) {
                 return false;
             }
-        } else {
-            int rv = sparse_file_add_fill(output_device, buffer[0], read_size, output_block);
-            if (rv) {
-                LERROR << "sparse_file_add_fill failed with code: " << rv;
-                return false;
+            sparse_file* output_device = device_images_[extent->target_source].get();
+            uint64_t length =
+                    std::min(remaining, extent->num_sectors * LP_SECTOR_SIZE - extent_used);
+
+            if (chunk.fill) {
+                int rv = sparse_file_add_fill(output_device, chunk.fill_value, length, output_block);
+                if (rv) {
+                    LERROR << "sparse_file_add_fill failed with code: " << rv;
+                    return false;
+                }
+            } else {
+                int rv = sparse_file_add_fd(output_device, image.fd, offset, length, output_block);
+                if (rv) {
+                    LERROR << "sparse_file_add_fd failed with code: " << rv;
+                    return false;
+                }
             }
+            offset += length;
+            remaining -= length;
+            extent_used += length;
         }
-        pos += read_size;
-        remaining -= read_size;
-        output_sector += block_size_ / LP_SECTOR_SIZE;
-        output_block++;
     }
-
     return true;
 }
 
@@ -452,6 +525,7 @@ int ImageBuilder::OpenImageFile(const std::string& file) {
     SparsePtr source(sparse_file_import(source_fd, true, true), sparse_file_destroy);
     if (!source) {
         int fd = source_fd.get();
+        std::lock_guard<std::mutex> lock(temp_fds_lock_);
         temp_fds_.push_back(std::move(source_fd));
         return fd;
     }
@@ -468,8 +542,10 @@ int ImageBuilder::OpenImageFile(const std::string& file) {
         LERROR << "sparse_file_write failed with code: " << rv;
         return -1;
     }
-    temp_fds_.push_back(android::base::unique_fd(tf.release()));
-    return temp_fds_.back().get();
+    int fd = tf.release();
+    std::lock_guard<std::mutex> lock(temp_fds_lock_);
+    temp_fds_.push_back(android::base::unique_fd(fd));
+    return fd;
 }
 
 bool WriteToImageFile(const std::string& file, const LpMetadata& metadata, uint32_t block_size,
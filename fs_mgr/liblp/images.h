@@ -17,7 +17,9 @@
 #include <stdint.h>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <android-base/unique_fd.h>
 #include <liblp/liblp.h>
@@ -49,8 +51,25 @@ class ImageBuilder {
     const std::vector<SparsePtr>& device_images() const { return device_images_; }
 
   private:
+    // A run of whole blocks in a partition image that is either all one fill
+    // value, or has to be copied from the image. The last run may end with a
+    // partial block, which is always copied.
+    struct ImageChunk {
+        uint64_t offset;
+        uint64_t length;
+        bool fill;
+        uint32_t fill_value;
+    };
+    struct PartitionImage {
+        const LpMetadataPartition* partition;
+        std::string file;
+        int fd;
+        std::vector<ImageChunk> chunks;
+    };
+
     bool AddData(sparse_file* file, const std::string& blob, uint64_t sector);
-    bool AddPartitionImage(const LpMetadataPartition& partition, const std::string& file);
+    bool ScanPartitionImage(PartitionImage* image);
+    bool AddPartitionImage(const PartitionImage& image);
     int OpenImageFile(const std::string& file);
     bool SectorToBlock(uint64_t sector, uint32_t* block);
     uint64_t BlockToSector(uint64_t block) const;
@@ -65,6 +84,7 @@ class ImageBuilder {
     std::vector<SparsePtr> device_images_;
     std::string all_metadata_;
     std::map<std::string, std::string> images_;
+    std::mutex temp_fds_lock_;
     std::vector<android::base::unique_fd> temp_fds_;
 };
 
@@ -503,10 +503,12 @@ TEST_F(LiblpTest, UpdatePrimaryMetadataFailure) {
 
     BadWriter writer;
 
-    // Read and write it back.
+    // Read, change and write it back. Unchanged tables are not rewritten.
     writer.FailOnWrite(1);
     unique_ptr<LpMetadata> imported = ReadMetadata(opener, "super", 0);
     ASSERT_NE(imported, nullptr);
+    ASSERT_GE(imported->partitions.size(), 1);
+    imported->partitions[0].name[0]++;
     ASSERT_FALSE(UpdatePartitionTable(opener, "super", *imported.get(), 0, writer));
 
     // We should still be able to read the backup copy.
@@ -516,6 +518,7 @@ TEST_F(LiblpTest, UpdatePrimaryMetadataFailure) {
     // Flash again, this time fail the backup copy. We should still be able
     // to read the primary.
     writer.FailOnWrite(3);
+    imported->partitions[0].name[0]++;
     ASSERT_FALSE(UpdatePartitionTable(opener, "super", *imported.get(), 0, writer));
     imported = ReadMetadata(opener, "super", 0);
     ASSERT_NE(imported, nullptr);
@@ -531,10 +534,12 @@ TEST_F(LiblpTest, UpdateBackupMetadataFailure) {
 
     BadWriter writer;
 
-    // Read and write it back.
+    // Read, change and write it back.
     writer.FailOnWrite(2);
     unique_ptr<LpMetadata> imported = ReadMetadata(opener, "super", 0);
     ASSERT_NE(imported, nullptr);
+    ASSERT_GE(imported->partitions.size(), 1);
+    imported->partitions[0].name[0]++;
     ASSERT_FALSE(UpdatePartitionTable(opener, "super", *imported.get(), 0, writer));
 
     // We should still be able to read the primary copy.
@@ -544,6 +549,7 @@ TEST_F(LiblpTest, UpdateBackupMetadataFailure) {
     // Flash again, this time fail the primary copy. We should still be able
     // to read the primary.
     writer.FailOnWrite(2);
+    imported->partitions[0].name[0]++;
     ASSERT_FALSE(UpdatePartitionTable(opener, "super", *imported.get(), 0, writer));
     imported = ReadMetadata(opener, "super", 0);
     ASSERT_NE(imported, nullptr);
@@ -588,6 +594,35 @@ TEST_F(LiblpTest, UpdateMetadataCleanFailure) {
     ASSERT_EQ(GetPartitionName(new_table->partitions[0]), GetPartitionName(imported->partitions[0]));
 }
 
+// Test that writing back an unchanged table does not touch the disk, and that
+// a changed one still writes both copies.
+TEST_F(LiblpTest, UpdateUnchangedMetadata) {
+    unique_fd fd = CreateFlashedDisk();
+    ASSERT_GE(fd, 0);
+
+    DefaultPartitionOpener opener(fd);
+
+    unsigned int writes = 0;
+    auto writer = [&writes](int fd, const std::string& blob) -> bool {
+        writes++;
+        return android::base::WriteFully(fd, blob.data(), blob.size());
+    };
+
+    unique_ptr<LpMetadata> imported = ReadMetadata(opener, "super", 0);
+    ASSERT_NE(imported, nullptr);
+    ASSERT_TRUE(UpdatePartitionTable(opener, "super", *imported.get(), 0, writer));
+    EXPECT_EQ(writes, 0u);
+
+    ASSERT_GE(imported->partitions.size(), 1);
+    imported->partitions[0].name[0]++;
+    ASSERT_TRUE(UpdatePartitionTable(opener, "super", *imported.get(), 0, writer));
+    EXPECT_EQ(writes, 2u);
+
+    unique_ptr<LpMetadata> updated = ReadMetadata(opener, "super", 0);
+    ASSERT_NE(updated, nullptr);
+    EXPECT_EQ(GetPartitionName(updated->partitions[0]), GetPartitionName(imported->partitions[0]));
+}
+
 // Test that writing a sparse image can be read back.
 TEST_F(LiblpTest, FlashSparseImage) {
     unique_fd fd = CreateFakeDisk();
@@ -623,6 +658,71 @@ TEST_F(LiblpTest, FlashSparseImage) {
     ASSERT_NE(ReadBackupMetadata(fd.get(), geometry, 0), nullptr);
 }
 
+// Test that partition images are copied to their extents, including fill
+// blocks and a partial last block.
+TEST_F(LiblpTest, SparseImagePartitions) {
+    BlockDeviceInfo device_info("super", kDiskSize, 0, 0, 512);
+    unique_ptr<MetadataBuilder> builder =
+            MetadataBuilder::New(device_info, kMetadataSize, kMetadataSlots);
+    ASSERT_NE(builder, nullptr);
+
+    Partition* system = builder->AddPartition("system", LP_PARTITION_ATTR_NONE);
+    ASSERT_NE(system, nullptr);
+    ASSERT_TRUE(builder->ResizePartition(system, 8192));
+    Partition* vendor = builder->AddPartition("vendor", LP_PARTITION_ATTR_NONE);
+    ASSERT_NE(vendor, nullptr);
+    ASSERT_TRUE(builder->ResizePartition(vendor, 4096));
+
+    unique_ptr<LpMetadata> exported = builder->Export();
+    ASSERT_NE(exported, nullptr);
+
+    // Every third block of system is a fill block, vendor ends with a partial
+    // block.
+    std::string system_data(8192, '\0');
+    for (size_t i = 0; i < system_data.size(); i += sizeof(uint32_t)) {
+        size_t block = i / 512;
+        uint32_t value = (block % 3 == 0) ? block : i;
+        memcpy(&system_data[i], &value, sizeof(value));
+    }
+    std::string vendor_data(4000, 'v');
+    vendor_data[1234] = 'x';
+
+    TemporaryFile system_file;
+    ASSERT_TRUE(android::base::WriteStringToFd(system_data, system_file.fd));
+    TemporaryFile vendor_file;
+    ASSERT_TRUE(android::base::WriteStringToFd(vendor_data, vendor_file.fd));
+
+    std::map<std::string, std::string> images = {
+            {"system", system_file.path},
+            {"vendor", vendor_file.path},
+    };
+    ImageBuilder sparse(*exported.get(), 512, images, true /* sparsify */);
+    ASSERT_TRUE(sparse.IsValid());
+    ASSERT_TRUE(sparse.Build());
+    ASSERT_EQ(sparse.device_images().size(), 1u);
+
+    unique_fd fd = CreateFakeDisk();
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(sparse_file_write(sparse.device_images()[0].get(), fd.get(), false, false, false), 0);
+
+    auto read_partition = [&](const LpMetadataPartition& partition) -> std::string {
+        std::string data;
+        for (size_t i = 0; i < partition.num_extents; i++) {
+            const auto& extent = exported->extents[partition.first_extent_index + i];
+            std::string buffer(extent.num_sectors * LP_SECTOR_SIZE, '\0');
+            if (!android::base::ReadFullyAtOffset(fd, buffer.data(), buffer.size(),
+                                                  extent.target_data * LP_SECTOR_SIZE)) {
+                return {};
+            }
+            data += buffer;
+        }
+        return data;
+    };
+    ASSERT_EQ(exported->partitions.size(), 2u);
+    EXPECT_EQ(read_partition(exported->partitions[0]), system_data);
+    EXPECT_EQ(read_partition(exported->partitions[1]).substr(0, vendor_data.size()), vendor_data);
+}
+
 TEST_F(LiblpTest, AutoSlotSuffixing) {
     unique_ptr<MetadataBuilder> builder = CreateDefaultBuilder();
     ASSERT_NE(builder, nullptr);
@@ -383,7 +383,21 @@ bool UpdatePartitionTable(const IPartitionOpener& opener, const std::string& sup
         }
     }
 
-    // Both copies should now be in sync, so we can continue the update.
+    // Both copies should now be in sync. If they already hold exactly this
+    // table, there is nothing to write: the header checksum covers the
+    // tables checksum, so equal checksums mean equal serialized metadata.
+    const LpMetadata* current = primary ? primary.get() : backup.get();
+    if (current && blob.size() >= sizeof(LpMetadataHeader)) {
+        const LpMetadataHeader* header = reinterpret_cast<const LpMetadataHeader*>(blob.data());
+        if (!memcmp(current->header.header_checksum, header->header_checksum,
+                    sizeof(header->header_checksum))) {
+            LINFO << "Logical partition table at slot " << slot_number << " on device "
+                  << super_partition << " is unchanged";
+            return true;
+        }
+    }
+
+    // Continue the update.
     if (!WriteMetadata(fd, metadata, slot_number, blob, writer)) {
         return false;
     }
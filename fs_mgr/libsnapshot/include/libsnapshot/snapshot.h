@@ -172,6 +172,12 @@ class SnapshotManager final {
     //   Other: 0
     UpdateState GetUpdateState(double* progress = nullptr);
 
+    // While merging, report how much COW data has been merged back into the
+    // base devices so far, and how much there was to merge in total, in
+    // sectors. Snapshots which have finished merging and been deleted no
+    // longer count towards either. Returns false if no merge is in progress.
+    bool GetMergeProgress(uint64_t* merged_sectors, uint64_t* total_sectors);
+
     // Create necessary COW device / files for OTA clients. New logical partitions will be added to
     // group "cow" in target_metadata. Regions of partitions of current_metadata will be
     // "write-protected" and snapshotted.
@@ -361,6 +367,7 @@ class SnapshotManager final {
     UpdateState CheckMergeState();
     UpdateState CheckMergeState(LockedFile* lock);
     UpdateState CheckTargetMergeState(LockedFile* lock, const std::string& name);
+    bool GetMergeProgress(LockedFile* lock, uint64_t* merged_sectors, uint64_t* total_sectors);
 
     // Interact with status files under /metadata/ota/snapshots.
     bool WriteSnapshotStatus(LockedFile* lock, const std::string& name,
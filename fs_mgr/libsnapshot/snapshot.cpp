@@ -20,6 +20,7 @@
 #include <sys/types.h>
 #include <sys/unistd.h>
 
+#include <algorithm>
 #include <optional>
 #include <thread>
 #include <unordered_set>
@@ -1119,7 +1120,10 @@ UpdateState SnapshotManager::GetUpdateState(double* progress) {
     if (progress) {
         *progress = 0.0;
         if (state == UpdateState::Merging) {
-            // :TODO: When merging is implemented, set progress_val.
+            uint64_t merged_sectors, total_sectors;
+            if (GetMergeProgress(file.get(), &merged_sectors, &total_sectors) && total_sectors) {
+                *progress = 100.0 * merged_sectors / total_sectors;
+            }
         } else if (state == UpdateState::MergeCompleted) {
             *progress = 100.0;
         }
@@ -1127,6 +1131,55 @@ UpdateState SnapshotManager::GetUpdateState(double* progress) {
     return state;
 }
 
+bool SnapshotManager::GetMergeProgress(uint64_t* merged_sectors, uint64_t* total_sectors) {
+    auto file = LockShared();
+    if (!file) {
+        return false;
+    }
+    if (ReadUpdateState(file.get()) != UpdateState::Merging) {
+        return false;
+    }
+    return GetMergeProgress(file.get(), merged_sectors, total_sectors);
+}
+
+bool SnapshotManager::GetMergeProgress(LockedFile* lock, uint64_t* merged_sectors,
+                                       uint64_t* total_sectors) {
+    std::vector<std::string> snapshots;
+    if (!ListSnapshots(lock, &snapshots)) {
+        return false;
+    }
+
+    *merged_sectors = 0;
+    *total_sectors = 0;
+    for (const auto& snapshot : snapshots) {
+        SnapshotStatus status;
+        if (!ReadSnapshotStatus(lock, snapshot, &status)) {
+            return false;
+        }
+
+        // SwitchSnapshotToMerge recorded how much the COW held when the
+        // merge began; device-mapper only knows how much is left.
+        uint64_t total = 0;
+        if (status.sectors_allocated > status.metadata_sectors) {
+            total = status.sectors_allocated - status.metadata_sectors;
+        }
+        uint64_t remaining = 0;
+        if (status.state == SnapshotState::Merging) {
+            DmTargetSnapshot::Status dm_status;
+            if (!QuerySnapshotStatus(GetSnapshotDeviceName(snapshot, status), nullptr,
+                                     &dm_status)) {
+                return false;
+            }
+            if (dm_status.sectors_allocated > dm_status.metadata_sectors) {
+                remaining = dm_status.sectors_allocated - dm_status.metadata_sectors;
+            }
+        }
+        *total_sectors += total;
+        *merged_sectors += total - std::min(total, remaining);
+    }
+    return true;
+}
+
 bool SnapshotManager::ListSnapshots(LockedFile* lock, std::vector<std::string>* snapshots) {
     CHECK(lock);
 
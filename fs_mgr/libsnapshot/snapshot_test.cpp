@@ -419,11 +419,18 @@ TEST_F(SnapshotTest, Merge) {
     ASSERT_TRUE(sm->IsSnapshotDevice("test_partition_b", &target));
     ASSERT_EQ(DeviceMapper::GetTargetType(target.spec), "snapshot-merge");
 
+    // The write above has to be merged back.
+    uint64_t merged_sectors, total_sectors;
+    ASSERT_TRUE(sm->GetMergeProgress(&merged_sectors, &total_sectors));
+    ASSERT_GT(total_sectors, 0u);
+    ASSERT_LE(merged_sectors, total_sectors);
+
     // We should not be able to cancel an update now.
     ASSERT_FALSE(sm->CancelUpdate());
 
     ASSERT_EQ(sm->ProcessUpdateState(), UpdateState::MergeCompleted);
     ASSERT_EQ(sm->GetUpdateState(), UpdateState::None);
+    ASSERT_FALSE(sm->GetMergeProgress(&merged_sectors, &total_sectors));
 
     // The device should no longer be a snapshot or snapshot-merge.
     ASSERT_FALSE(sm->IsSnapshotDevice("test_partition_b"));
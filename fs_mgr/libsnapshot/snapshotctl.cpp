@@ -14,15 +14,21 @@
 // limitations under the License.
 //
 
+#include <string.h>
 #include <sysexits.h>
 
 #include <chrono>
 #include <iostream>
 #include <map>
+#include <thread>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/parsedouble.h>
+#include <android-base/strings.h>
 #include <libsnapshot/snapshot.h>
 
+using namespace std::chrono_literals;
 using namespace std::string_literals;
 
 int Usage() {
@@ -31,9 +37,11 @@ int Usage() {
                  "Actions:\n"
                  "  dump\n"
                  "    Print snapshot states.\n"
-                 "  merge [--logcat]\n"
+                 "  merge [--logcat] [--wait-for-idle]\n"
                  "    Initialize merge and wait for it to be completed.\n"
-                 "    If --logcat is specified, log to logcat. Otherwise, log to stdout.\n";
+                 "    If --logcat is specified, log to logcat. Otherwise, log to stdout.\n"
+                 "    If --wait-for-idle is specified, put off starting the merge (for up to\n"
+                 "    5 minutes) while the kernel reports I/O pressure.\n";
     return EX_USAGE;
 }
 
@@ -45,13 +53,59 @@ bool DumpCmdHandler(int /*argc*/, char** argv) {
     return SnapshotManager::New()->Dump(std::cout);
 }
 
+// Returns the share of the last 10 seconds, as a percentage, in which some
+// task was stalled on I/O, or a negative value if the kernel lacks PSI.
+static double GetIoPressure() {
+    std::string contents;
+    if (!android::base::ReadFileToString("/proc/pressure/io", &contents)) {
+        return -1.0;
+    }
+    // some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+    for (const auto& line : android::base::Split(contents, "\n")) {
+        auto fields = android::base::Split(line, " ");
+        if (fields.size() < 2 || fields[0] != "some" ||
+            !android::base::StartsWith(fields[1], "avg10=")) {
+            continue;
+        }
+        double avg10;
+        if (android::base::ParseDouble(fields[1].substr(strlen("avg10=")), &avg10)) {
+            return avg10;
+        }
+    }
+    return -1.0;
+}
+
+// The kernel merges as fast as it can once the snapshots are switched to
+// merge targets, so the only say userspace has is when that happens. Hold
+// off while the device is busy with I/O, which right after boot means apps
+// starting up, but not indefinitely.
+static void WaitForIoIdle() {
+    static constexpr double kIoPressureThreshold = 10.0;
+    static constexpr auto kMaxWait = 5min;
+    static constexpr auto kPollInterval = 5s;
+
+    auto begin = std::chrono::steady_clock::now();
+    double pressure;
+    while ((pressure = GetIoPressure()) > kIoPressureThreshold) {
+        if (std::chrono::steady_clock::now() - begin >= kMaxWait) {
+            LOG(INFO) << "I/O pressure still " << pressure << "%, merging anyway.";
+            return;
+        }
+        LOG(INFO) << "I/O pressure is " << pressure << "%, waiting to merge.";
+        std::this_thread::sleep_for(kPollInterval);
+    }
+}
+
 bool MergeCmdHandler(int argc, char** argv) {
     auto begin = std::chrono::steady_clock::now();
 
     bool log_to_logcat = false;
+    bool wait_for_idle = false;
     for (int i = 2; i < argc; ++i) {
         if (argv[i] == "--logcat"s) {
             log_to_logcat = true;
+        } else if (argv[i] == "--wait-for-idle"s) {
+            wait_for_idle = true;
         }
     }
     if (log_to_logcat) {
@@ -68,12 +122,21 @@ bool MergeCmdHandler(int argc, char** argv) {
         return true;
     }
     if (state == UpdateState::Unverified) {
+        if (wait_for_idle) {
+            WaitForIoIdle();
+        }
         if (!sm->InitiateMerge()) {
             LOG(ERROR) << "Failed to initiate merge.";
             return false;
         }
     }
 
+    // What is left to merge, which may be less than the total if a previous
+    // boot already started.
+    uint64_t merged_sectors = 0, total_sectors = 0;
+    sm->GetMergeProgress(&merged_sectors, &total_sectors);
+    auto merge_begin = std::chrono::steady_clock::now();
+
     // All other states can be handled by ProcessUpdateState.
     LOG(INFO) << "Waiting for any merge to complete. This can take up to 1 minute.";
     state = SnapshotManager::New()->ProcessUpdateState();
@@ -82,6 +145,13 @@ bool MergeCmdHandler(int argc, char** argv) {
         auto end = std::chrono::steady_clock::now();
         auto passed = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
         LOG(INFO) << "Snapshot merged in " << passed << " ms.";
+
+        auto merging = std::chrono::duration_cast<std::chrono::milliseconds>(end - merge_begin);
+        uint64_t bytes = (total_sectors - merged_sectors) * android::dm::kSectorSize;
+        if (bytes && merging.count()) {
+            LOG(INFO) << "Merged " << bytes / 1024 << " KiB in " << merging.count() << " ms ("
+                      << bytes * 1000 / merging.count() / 1024 << " KiB/s).";
+        }
         return true;
     }
 
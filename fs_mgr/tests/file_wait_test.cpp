@@ -12,9 +12,12 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <sys/stat.h>
+
 #include <chrono>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/unique_fd.h>
@@ -23,8 +26,10 @@
 
 using namespace std::literals;
 using android::base::unique_fd;
+using android::fs_mgr::FileWaiter;
 using android::fs_mgr::WaitForFile;
 using android::fs_mgr::WaitForFileDeleted;
+using android::fs_mgr::WaitForFiles;
 
 class FileWaitTest : public ::testing::Test {
   protected:
@@ -89,3 +94,79 @@ TEST_F(FileWaitTest, BadPath) {
     ASSERT_FALSE(WaitForFile("/this/path/does/not/exist", 5ms));
     EXPECT_EQ(errno, ENOENT);
 }
+
+TEST_F(FileWaitTest, CreateManyAsync) {
+    std::vector<std::string> paths;
+    for (int i = 0; i < 4; i++) {
+        paths.emplace_back(test_file_ + "." + std::to_string(i));
+    }
+    std::thread thread([&paths] {
+        for (const auto& path : paths) {
+            std::this_thread::sleep_for(200ms);
+            unique_fd fd(open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0700));
+        }
+    });
+    EXPECT_TRUE(WaitForFiles(paths, 3s));
+    thread.join();
+
+    for (const auto& path : paths) {
+        unlink(path.c_str());
+    }
+}
+
+TEST_F(FileWaitTest, CreateManyOneMissing) {
+    std::vector<std::string> paths = {test_file_, test_file_ + ".wontexist"};
+    std::thread thread([this] {
+        std::this_thread::sleep_for(200ms);
+        unique_fd fd(open(test_file_.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0700));
+    });
+    EXPECT_FALSE(WaitForFiles(paths, 1s));
+    thread.join();
+}
+
+TEST_F(FileWaitTest, SharedWaiter) {
+    FileWaiter waiter;
+    std::vector<std::string> paths;
+    for (int i = 0; i < 4; i++) {
+        paths.emplace_back(test_file_ + "." + std::to_string(i));
+        waiter.Add(paths.back());
+    }
+
+    std::vector<std::thread> waiters;
+    std::vector<char> found(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        waiters.emplace_back([&, i] { found[i] = waiter.Wait(paths[i], 3s); });
+    }
+
+    // Create them in reverse, so that the first waiter is woken last.
+    for (auto it = paths.rbegin(); it != paths.rend(); ++it) {
+        std::this_thread::sleep_for(100ms);
+        unique_fd fd(open(it->c_str(), O_CREAT | O_TRUNC | O_RDWR, 0700));
+    }
+    for (auto& thread : waiters) {
+        thread.join();
+    }
+    for (size_t i = 0; i < paths.size(); i++) {
+        EXPECT_TRUE(found[i]) << paths[i];
+        unlink(paths[i].c_str());
+    }
+}
+
+TEST_F(FileWaitTest, CreateInMissingDirectory) {
+    std::string dir = test_file_ + ".dir";
+    std::string path = dir + "/sub/file";
+    std::thread thread([&] {
+        std::this_thread::sleep_for(200ms);
+        mkdir(dir.c_str(), 0700);
+        std::this_thread::sleep_for(200ms);
+        mkdir((dir + "/sub").c_str(), 0700);
+        std::this_thread::sleep_for(200ms);
+        unique_fd fd(open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0700));
+    });
+    EXPECT_TRUE(WaitForFile(path, 3s));
+    thread.join();
+
+    unlink(path.c_str());
+    rmdir((dir + "/sub").c_str());
+    rmdir(dir.c_str());
+}
@@ -1036,3 +1036,33 @@ source none5       swap   defaults      zram_backing_dev_path=/dev/path2
     EXPECT_EQ("none5", entry->mount_point);
     EXPECT_EQ("/dev/path2", entry->zram_backing_dev_path);
 }
+
+TEST(fs_mgr, ReadFstabFromFile_Rewritten) {
+    TemporaryFile tf;
+    ASSERT_TRUE(tf.fd != -1);
+    std::string fstab_contents = R"fs(
+source /system     ext4   ro            wait
+source /vendor     ext4   ro            wait
+)fs";
+    ASSERT_TRUE(android::base::WriteStringToFile(fstab_contents, tf.path));
+
+    // Reading the same file again gives the same entries.
+    for (int i = 0; i < 2; i++) {
+        Fstab fstab;
+        EXPECT_TRUE(ReadFstabFromFile(tf.path, &fstab));
+        ASSERT_EQ(2U, fstab.size());
+        EXPECT_EQ("/system", fstab[0].mount_point);
+        EXPECT_EQ("/vendor", fstab[1].mount_point);
+    }
+
+    // Once the file is rewritten, its new entries are returned.
+    fstab_contents = R"fs(
+source /odm        ext4   ro            wait
+)fs";
+    ASSERT_TRUE(android::base::WriteStringToFile(fstab_contents, tf.path));
+
+    Fstab fstab;
+    EXPECT_TRUE(ReadFstabFromFile(tf.path, &fstab));
+    ASSERT_EQ(1U, fstab.size());
+    EXPECT_EQ("/odm", fstab[0].mount_point);
+}
@@ -30,7 +30,6 @@
 #include <algorithm>
 #include <memory>
 
-#include <android-base/file.h>
 #include <android-base/parseint.h>
 #include <android-base/strings.h>
 #include <batteryservice/BatteryService.h>
@@ -63,6 +62,20 @@ static int mapSysfsString(const char* str,
     return -1;
 }
 
+static bool batteryPropertiesEqual(const BatteryProperties& a, const BatteryProperties& b) {
+    return a.chargerAcOnline == b.chargerAcOnline && a.chargerUsbOnline == b.chargerUsbOnline &&
+           a.chargerWirelessOnline == b.chargerWirelessOnline &&
+           a.maxChargingCurrent == b.maxChargingCurrent &&
+           a.maxChargingVoltage == b.maxChargingVoltage && a.batteryStatus == b.batteryStatus &&
+           a.batteryHealth == b.batteryHealth && a.batteryPresent == b.batteryPresent &&
+           a.batteryLevel == b.batteryLevel && a.batteryVoltage == b.batteryVoltage &&
+           a.batteryTemperature == b.batteryTemperature && a.batteryCurrent == b.batteryCurrent &&
+           a.batteryCycleCount == b.batteryCycleCount &&
+           a.batteryFullCharge == b.batteryFullCharge &&
+           a.batteryChargeCounter == b.batteryChargeCounter &&
+           a.batteryTechnology == b.batteryTechnology;
+}
+
 static void initBatteryProperties(BatteryProperties* props) {
     props->chargerAcOnline = false;
     props->chargerUsbOnline = false;
@@ -86,8 +99,10 @@ BatteryMonitor::BatteryMonitor()
     : mHealthdConfig(nullptr),
       mBatteryDevicePresent(false),
       mBatteryFixedCapacity(0),
-      mBatteryFixedTemperature(0) {
+      mBatteryFixedTemperature(0),
+      mHaveReportedProps(false) {
     initBatteryProperties(&props);
+    initBatteryProperties(&mReportedProps);
 }
 
 struct BatteryProperties getBatteryProperties(BatteryMonitor* batteryMonitor) {
@@ -140,9 +155,44 @@ int BatteryMonitor::getBatteryHealth(const char* status) {
     return ret;
 }
 
+// Called with mSysfsFdsLock held. Returns -1 if the attribute can't be opened.
+int BatteryMonitor::getSysfsFd(const String8& path) {
+    if (path.isEmpty()) return -1;
+
+    auto it = mSysfsFds.find(path.string());
+    if (it != mSysfsFds.end()) return it->second.get();
+
+    android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(path.string(), O_RDONLY | O_CLOEXEC)));
+    if (fd == -1) return -1;
+    return mSysfsFds.emplace(path.string(), std::move(fd)).first->second.get();
+}
+
+bool BatteryMonitor::hasField(const String8& path) {
+    std::lock_guard<std::mutex> lock(mSysfsFdsLock);
+    return getSysfsFd(path) != -1;
+}
+
 int BatteryMonitor::readFromFile(const String8& path, std::string* buf) {
-    if (android::base::ReadFileToString(path.c_str(), buf)) {
-        *buf = android::base::Trim(*buf);
+    // sysfs attributes are at most a page, and are regenerated when read from
+    // the start, so one pread() of a kept open fd gets the current value.
+    char data[4096];
+    ssize_t len = -1;
+
+    buf->clear();
+    {
+        std::lock_guard<std::mutex> lock(mSysfsFdsLock);
+        int fd = getSysfsFd(path);
+        if (fd != -1) {
+            len = TEMP_FAILURE_RETRY(pread(fd, data, sizeof(data), 0));
+            if (len == -1) {
+                // The power supply may have gone away; open it again next time.
+                mSysfsFds.erase(path.string());
+            }
+        }
+    }
+
+    if (len > 0) {
+        *buf = android::base::Trim(std::string(data, len));
     }
     return buf->length();
 }
@@ -201,6 +251,14 @@ int BatteryMonitor::getIntField(const String8& path) {
 }
 
 bool BatteryMonitor::update(void) {
+    return update(true);
+}
+
+bool BatteryMonitor::updateIfChanged(void) {
+    return update(false);
+}
+
+bool BatteryMonitor::update(bool notifyUnchanged) {
     bool logthis;
 
     initBatteryProperties(&props);
@@ -269,16 +327,13 @@ bool BatteryMonitor::update(void) {
             path.clear();
             path.appendFormat("%s/%s/current_max", POWER_SUPPLY_SYSFS_PATH,
                               mChargerNames[i].string());
-            int ChargingCurrent =
-                    (access(path.string(), R_OK) == 0) ? getIntField(path) : 0;
+            int ChargingCurrent = hasField(path) ? getIntField(path) : 0;
 
             path.clear();
             path.appendFormat("%s/%s/voltage_max", POWER_SUPPLY_SYSFS_PATH,
                               mChargerNames[i].string());
 
-            int ChargingVoltage =
-                (access(path.string(), R_OK) == 0) ? getIntField(path) :
-                DEFAULT_VBUS_VOLTAGE;
+            int ChargingVoltage = hasField(path) ? getIntField(path) : DEFAULT_VBUS_VOLTAGE;
 
             double power = ((double)ChargingCurrent / MILLION) *
                            ((double)ChargingVoltage / MILLION);
@@ -332,7 +387,11 @@ bool BatteryMonitor::update(void) {
         KLOG_WARNING(LOG_TAG, "%s\n", dmesgline);
     }
 
-    healthd_mode_ops->battery_update(&props);
+    if (notifyUnchanged || !mHaveReportedProps || !batteryPropertiesEqual(props, mReportedProps)) {
+        healthd_mode_ops->battery_update(&props);
+        mReportedProps = props;
+        mHaveReportedProps = true;
+    }
     return props.chargerAcOnline | props.chargerUsbOnline |
             props.chargerWirelessOnline;
 }
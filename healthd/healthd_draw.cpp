@@ -45,7 +45,7 @@ static int get_split_offset() {
 }
 
 HealthdDraw::HealthdDraw(animation* anim)
-    : kSplitScreen(get_split_screen()), kSplitOffset(get_split_offset()) {
+    : kSplitScreen(get_split_screen()), kSplitOffset(get_split_offset()), screen_valid_(false) {
     int ret = gr_init();
 
     if (ret < 0) {
@@ -80,20 +80,47 @@ HealthdDraw::~HealthdDraw() {}
 
 void HealthdDraw::redraw_screen(const animation* batt_anim, GRSurface* surf_unknown) {
     if (!graphics_available) return;
+
+    const bool unknown = batt_anim->cur_status == BATTERY_STATUS_UNKNOWN ||
+                         batt_anim->cur_level < 0 || batt_anim->num_frames == 0;
+    screen_contents contents = {};
+    if (unknown) {
+        contents.surface = surf_unknown;
+        contents.level = -1;
+        contents.clock_minute = -1;
+    } else {
+        contents.surface = batt_anim->frames[batt_anim->cur_frame].surface;
+        contents.level = batt_anim->cur_level;
+        contents.status = batt_anim->cur_status;
+        contents.clock_minute = batt_anim->text_clock.font ? time(nullptr) / 60 : -1;
+    }
+
+    // Frames that repeat, e.g. while the level stays within the range of a
+    // single frame, don't need to be drawn and flipped again. The buffers are
+    // swapped on flip, so there is no cheaper partial redraw to fall back on.
+    if (screen_valid_ && contents == screen_) {
+        LOGV("skipping unchanged frame #%d\n", batt_anim->cur_frame);
+        return;
+    }
+
     clear_screen();
 
     /* try to display *something* */
-    if (batt_anim->cur_status == BATTERY_STATUS_UNKNOWN || batt_anim->cur_level < 0 ||
-        batt_anim->num_frames == 0)
+    if (unknown)
         draw_unknown(surf_unknown);
     else
         draw_battery(batt_anim);
     gr_flip();
+
+    screen_ = contents;
+    screen_valid_ = true;
 }
 
 void HealthdDraw::blank_screen(bool blank) {
     if (!graphics_available) return;
     gr_fb_blank(blank);
+    // Don't count on the contents surviving a blank, redraw after unblanking.
+    if (blank) screen_valid_ = false;
 }
 
 void HealthdDraw::clear_screen(void) {
@@ -30,7 +30,7 @@ class HealthdDraw {
   HealthdDraw(animation* anim);
   virtual ~HealthdDraw();
 
-  // Redraws screen.
+  // Redraws screen, unless it would show the same as it already does.
   void redraw_screen(const animation* batt_anim, GRSurface* surf_unknown);
 
   // Blanks screen if true, unblanks if false.
@@ -76,6 +76,25 @@ class HealthdDraw {
 
   // true if minui init'ed OK, false if minui init failed
   bool graphics_available;
+
+ private:
+  // What a redraw_screen() call puts on screen.
+  struct screen_contents {
+    const GRSurface* surface;
+    int level;
+    int status;
+    // Minute shown by the clock, or -1 if there is no clock.
+    long clock_minute;
+
+    bool operator==(const screen_contents& other) const {
+      return surface == other.surface && level == other.level && status == other.status &&
+             clock_minute == other.clock_minute;
+    }
+  };
+
+  // What is on screen since the last flip, if screen_valid_.
+  screen_contents screen_;
+  bool screen_valid_;
 };
 
 #endif  // HEALTHD_DRAW_H
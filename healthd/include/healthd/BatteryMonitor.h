@@ -17,6 +17,11 @@
 #ifndef HEALTHD_BATTERYMONITOR_H
 #define HEALTHD_BATTERYMONITOR_H
 
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <android-base/unique_fd.h>
 #include <batteryservice/BatteryService.h>
 #include <utils/String8.h>
 #include <utils/Vector.h>
@@ -39,6 +44,11 @@ class BatteryMonitor {
     BatteryMonitor();
     void init(struct healthd_config *hc);
     bool update(void);
+    // Like update(), but only passes the properties on to
+    // healthd_mode_ops->battery_update() if they differ from the ones passed
+    // on last time. Meant for uevents and periodic polls, which mostly find
+    // nothing new.
+    bool updateIfChanged(void);
     int getChargeStatus();
     status_t getProperty(int id, struct BatteryProperty *val);
     void dumpState(int fd);
@@ -51,7 +61,16 @@ class BatteryMonitor {
     int mBatteryFixedCapacity;
     int mBatteryFixedTemperature;
     struct BatteryProperties props;
+    struct BatteryProperties mReportedProps;
+    bool mHaveReportedProps;
+
+    // The power_supply attributes are kept open and re-read with pread().
+    std::mutex mSysfsFdsLock;
+    std::unordered_map<std::string, android::base::unique_fd> mSysfsFds;
 
+    bool update(bool notifyUnchanged);
+    int getSysfsFd(const String8& path);
+    bool hasField(const String8& path);
     int getBatteryStatus(const char* status);
     int getBatteryHealth(const char* status);
     int readFromFile(const String8& path, std::string* buf);
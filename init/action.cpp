@@ -21,6 +21,7 @@
 #include <android-base/properties.h>
 #include <android-base/strings.h>
 
+#include "boot_trace.h"
 #include "util.h"
 
 using android::base::Join;
@@ -143,24 +144,62 @@ size_t Action::CheckAllCommands() const {
     return failures;
 }
 
-void Action::ExecuteOneCommand(std::size_t command) const {
+size_t Action::ExecuteOneCommand(std::size_t command) const {
+    auto end = command + 1;
+    if (subcontext_ && commands_[command].execute_in_subcontext()) {
+        while (end < commands_.size() && commands_[end].execute_in_subcontext()) {
+            ++end;
+        }
+    }
+    if (end - command > 1) {
+        ExecuteSubcontextCommands(command, end);
+        return end - command;
+    }
+
     // We need a copy here since some Command execution may result in
     // changing commands_ vector by importing .rc files through parser
     Command cmd = commands_[command];
     ExecuteCommand(cmd);
+    return 1;
 }
 
 void Action::ExecuteAllCommands() const {
-    for (const auto& c : commands_) {
-        ExecuteCommand(c);
+    for (std::size_t i = 0; i < commands_.size();) {
+        i += ExecuteOneCommand(i);
     }
 }
 
 void Action::ExecuteCommand(const Command& command) const {
-    android::base::Timer t;
+    auto start = boot_clock::now();
     auto result = command.InvokeFunc(subcontext_);
-    auto duration = t.duration();
+    auto duration = boot_clock::now() - start;
+    BootTrace::GetInstance().Record(BootTraceEvent::kCommand, command.args()[0], duration);
+    LogCommandResult(command, result,
+                     std::chrono::duration_cast<std::chrono::milliseconds>(duration));
+}
+
+// Consecutive commands that run in the subcontext go over in as few messages as possible rather
+// than one round trip each, which adds up for vendor .rc files.
+void Action::ExecuteSubcontextCommands(std::size_t begin, std::size_t end) const {
+    std::vector<Command> commands(commands_.begin() + begin, commands_.begin() + end);
+    std::vector<std::vector<std::string>> args;
+    for (const auto& command : commands) {
+        args.emplace_back(command.args());
+    }
+
+    auto start = boot_clock::now();
+    auto results = subcontext_->ExecuteBatch(args);
+    for (std::size_t i = 0; i < commands.size(); ++i) {
+        // The subcontext only reports durations, so place the commands back to back.
+        start += results[i].duration;
+        BootTrace::GetInstance().Record(BootTraceEvent::kCommand, commands[i].args()[0],
+                                        results[i].duration, start);
+        LogCommandResult(commands[i], results[i].result, results[i].duration);
+    }
+}
 
+void Action::LogCommandResult(const Command& command, const Result<void>& result,
+                              std::chrono::milliseconds duration) const {
     // Any action longer than 50ms will be warned to user as slow operation
     if (!result.has_value() || duration > 50ms ||
         android::base::GetMinimumLogSeverity() <= android::base::DEBUG) {
@@ -18,10 +18,12 @@
 
 #include <android-base/logging.h>
 
+#include "boot_trace.h"
+
 namespace android {
 namespace init {
 
-ActionManager::ActionManager() : current_command_(0) {}
+ActionManager::ActionManager() : next_action_order_(0), current_command_(0) {}
 
 size_t ActionManager::CheckAllCommands() {
     size_t failures = 0;
@@ -37,9 +39,54 @@ ActionManager& ActionManager::GetInstance() {
 }
 
 void ActionManager::AddAction(std::unique_ptr<Action> action) {
+    IndexAction(action.get());
     actions_.emplace_back(std::move(action));
 }
 
+// Index actions by their triggers, so that queued events only need to check
+// the actions that could possibly match them rather than every action.
+void ActionManager::IndexAction(Action* action) {
+    size_t order = next_action_order_++;
+    event_index_[action->event_trigger()].emplace_back(order, action);
+    if (!action->event_trigger().empty()) {
+        return;
+    }
+    if (action->property_triggers().empty()) {
+        untriggered_actions_.emplace_back(order, action);
+        return;
+    }
+    for (const auto& [name, value] : action->property_triggers()) {
+        property_index_[name].emplace_back(order, action);
+    }
+}
+
+void ActionManager::UnindexAction(const Action* action) {
+    auto erase_from = [action](IndexedActions* actions) {
+        auto eraser = [action](const auto& a) { return a.second == action; };
+        actions->erase(std::remove_if(actions->begin(), actions->end(), eraser), actions->end());
+    };
+    auto erase_from_index = [&erase_from](std::map<std::string, IndexedActions>* index,
+                                          const std::string& key) {
+        auto it = index->find(key);
+        if (it == index->end()) {
+            return;
+        }
+        erase_from(&it->second);
+        if (it->second.empty()) {
+            index->erase(it);
+        }
+    };
+
+    erase_from_index(&event_index_, action->event_trigger());
+    if (!action->event_trigger().empty()) {
+        return;
+    }
+    erase_from(&untriggered_actions_);
+    for (const auto& [name, value] : action->property_triggers()) {
+        erase_from_index(&property_index_, name);
+    }
+}
+
 void ActionManager::QueueEventTrigger(const std::string& trigger) {
     event_queue_.emplace(trigger);
 }
@@ -58,18 +105,64 @@ void ActionManager::QueueBuiltinAction(BuiltinFunction func, const std::string&
     action->AddCommand(std::move(func), {name}, 0);
 
     event_queue_.emplace(action.get());
+    IndexAction(action.get());
     actions_.emplace_back(std::move(action));
 }
 
-void ActionManager::ExecuteOneCommand() {
-    // Loop through the event queue until we have an action to execute
-    while (current_executing_actions_.empty() && !event_queue_.empty()) {
+void ActionManager::QueueMatchingActions(const EventTrigger& trigger) {
+    auto it = event_index_.find(trigger);
+    if (it == event_index_.end()) {
+        return;
+    }
+    for (const auto& [order, action] : it->second) {
+        if (action->CheckEvent(trigger)) {
+            current_executing_actions_.emplace(action);
+        }
+    }
+}
+
+void ActionManager::QueueMatchingActions(const PropertyChange& property_change) {
+    const auto& [name, value] = property_change;
+
+    // QueueAllPropertyActions() asks for every property-only action.
+    if (name.empty()) {
         for (const auto& action : actions_) {
-            if (std::visit([&action](const auto& event) { return action->CheckEvent(event); },
-                           event_queue_.front())) {
+            if (action->CheckEvent(property_change)) {
                 current_executing_actions_.emplace(action.get());
             }
         }
+        return;
+    }
+
+    static const IndexedActions kNoActions;
+    auto it = property_index_.find(name);
+    const IndexedActions& named = (it != property_index_.end()) ? it->second : kNoActions;
+
+    // Merge the two candidate lists, keeping the order the actions were added.
+    auto a = named.begin();
+    auto b = untriggered_actions_.begin();
+    while (a != named.end() || b != untriggered_actions_.end()) {
+        Action* action;
+        if (b == untriggered_actions_.end() || (a != named.end() && a->first < b->first)) {
+            action = (a++)->second;
+        } else {
+            action = (b++)->second;
+        }
+        if (action->CheckEvent(property_change)) {
+            current_executing_actions_.emplace(action);
+        }
+    }
+}
+
+void ActionManager::QueueMatchingActions(const BuiltinAction& builtin_action) {
+    current_executing_actions_.emplace(builtin_action);
+}
+
+void ActionManager::ExecuteOneCommand() {
+    // Loop through the event queue until we have an action to execute
+    while (current_executing_actions_.empty() && !event_queue_.empty()) {
+        std::visit([this](const auto& event) { QueueMatchingActions(event); },
+                   event_queue_.front());
         event_queue_.pop();
     }
 
@@ -83,18 +176,20 @@ void ActionManager::ExecuteOneCommand() {
         std::string trigger_name = action->BuildTriggersString();
         LOG(INFO) << "processing action (" << trigger_name << ") from (" << action->filename()
                   << ":" << action->line() << ")";
+        BootTrace::GetInstance().Record(BootTraceEvent::kActionBegin, trigger_name);
     }
 
-    action->ExecuteOneCommand(current_command_);
+    current_command_ += action->ExecuteOneCommand(current_command_);
 
     // If this was the last command in the current action, then remove
     // the action from the executing list.
     // If this action was oneshot, then also remove it from actions_.
-    ++current_command_;
     if (current_command_ == action->NumCommands()) {
+        BootTrace::GetInstance().Record(BootTraceEvent::kActionEnd, "");
         current_executing_actions_.pop();
         current_command_ = 0;
         if (action->oneshot()) {
+            UnindexAction(action);
             auto eraser = [&action](std::unique_ptr<Action>& a) { return a.get() == action; };
             actions_.erase(std::remove_if(actions_.begin(), actions_.end(), eraser),
                            actions_.end());
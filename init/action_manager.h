@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -47,7 +48,24 @@ class ActionManager {
     ActionManager(ActionManager const&) = delete;
     void operator=(ActionManager const&) = delete;
 
+    // Actions that may match an event, tagged with the order in which they
+    // were added, which is the order they must run in.
+    using IndexedActions = std::vector<std::pair<size_t, Action*>>;
+
+    void IndexAction(Action* action);
+    void UnindexAction(const Action* action);
+    void QueueMatchingActions(const EventTrigger& trigger);
+    void QueueMatchingActions(const PropertyChange& property_change);
+    void QueueMatchingActions(const BuiltinAction& builtin_action);
+
     std::vector<std::unique_ptr<Action>> actions_;
+    size_t next_action_order_;
+    // Every action, by its event trigger ("" for property-only actions).
+    std::map<std::string, IndexedActions> event_index_;
+    // Property-only actions, by the name of each property they trigger on.
+    std::map<std::string, IndexedActions> property_index_;
+    // Actions with no triggers at all, which match every property change.
+    IndexedActions untriggered_actions_;
     std::queue<std::variant<EventTrigger, PropertyChange, BuiltinAction>> event_queue_;
     std::queue<const Action*> current_executing_actions_;
     std::size_t current_command_;
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "boot_trace.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <android-base/stringprintf.h>
+
+#include "util.h"
+
+using android::base::boot_clock;
+using android::base::StringAppendF;
+
+namespace android {
+namespace init {
+
+// Enough for the several thousand events of a typical boot, at 64 bytes each.
+static constexpr size_t kBootTraceCapacity = 8192;
+
+BootTrace& BootTrace::GetInstance() {
+    static BootTrace instance(kBootTraceCapacity);
+    return instance;
+}
+
+BootTrace::BootTrace(size_t capacity) : entries_(new Entry[capacity]), capacity_(capacity) {}
+
+void BootTrace::Record(BootTraceEvent event, std::string_view name, int64_t arg,
+                       boot_clock::time_point timestamp) {
+    Entry& entry = entries_[next_];
+    entry.timestamp_ns = std::chrono::nanoseconds(timestamp.time_since_epoch()).count();
+    entry.arg = arg;
+    entry.event = event;
+    size_t length = std::min(name.size(), sizeof(entry.name) - 1);
+    memcpy(entry.name, name.data(), length);
+    entry.name[length] = '\0';
+
+    if (++next_ == capacity_) {
+        next_ = 0;
+        wrapped_ = true;
+    }
+}
+
+static void AppendJsonString(std::string* out, const char* s) {
+    out->push_back('"');
+    for (; *s; ++s) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') {
+            out->push_back('\\');
+            out->push_back(c);
+        } else if (c < 0x20) {
+            StringAppendF(out, "\\u%04x", c);
+        } else {
+            out->push_back(c);
+        }
+    }
+    out->push_back('"');
+}
+
+std::string BootTrace::ToJson() const {
+    std::string out = "{\"traceEvents\":[";
+    bool first = true;
+    size_t count = wrapped_ ? capacity_ : next_;
+    size_t start = wrapped_ ? next_ : 0;
+    for (size_t i = 0; i < count; ++i) {
+        const Entry& entry = entries_[(start + i) % capacity_];
+        auto timestamp_us = entry.timestamp_ns / 1000.0;
+        auto arg_us = entry.arg / 1000.0;
+
+        out += first ? "\n" : ",\n";
+        first = false;
+        out += "{\"pid\":1,\"tid\":1,\"name\":";
+        AppendJsonString(&out, entry.name);
+        switch (entry.event) {
+            case BootTraceEvent::kActionBegin:
+                StringAppendF(&out, ",\"cat\":\"action\",\"ph\":\"B\",\"ts\":%.3f}", timestamp_us);
+                break;
+            case BootTraceEvent::kActionEnd:
+                StringAppendF(&out, ",\"cat\":\"action\",\"ph\":\"E\",\"ts\":%.3f}", timestamp_us);
+                break;
+            case BootTraceEvent::kCommand:
+                StringAppendF(&out, ",\"cat\":\"command\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f}",
+                              timestamp_us - arg_us, arg_us);
+                break;
+            case BootTraceEvent::kServiceFork:
+            case BootTraceEvent::kServiceExit:
+                StringAppendF(&out,
+                              ",\"cat\":\"service\",\"ph\":\"i\",\"s\":\"p\",\"ts\":%.3f,"
+                              "\"args\":{\"event\":\"%s\",\"pid\":%" PRId64 "}}",
+                              timestamp_us,
+                              entry.event == BootTraceEvent::kServiceFork ? "fork" : "exit",
+                              entry.arg);
+                break;
+            case BootTraceEvent::kPropertyWaitBegin:
+                StringAppendF(&out, ",\"cat\":\"wait\",\"ph\":\"b\",\"id\":1,\"ts\":%.3f}",
+                              timestamp_us);
+                break;
+            case BootTraceEvent::kPropertyWaitEnd:
+                StringAppendF(&out, ",\"cat\":\"wait\",\"ph\":\"e\",\"id\":1,\"ts\":%.3f}",
+                              timestamp_us);
+                break;
+            case BootTraceEvent::kFileWait:
+                StringAppendF(&out, ",\"cat\":\"wait\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f}",
+                              timestamp_us - arg_us, arg_us);
+                break;
+        }
+    }
+    StringAppendF(&out, "\n],\"metadata\":{\"overwritten\":%s}}\n", wrapped_ ? "true" : "false");
+    return out;
+}
+
+Result<void> do_dump_boot_trace(const BuiltinArguments& args) {
+    return WriteFile(args[1], BootTrace::GetInstance().ToJson());
+}
+
+}  // namespace init
+}  // namespace android
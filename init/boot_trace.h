@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <android-base/chrono_utils.h>
+
+#include "builtin_arguments.h"
+#include "result.h"
+
+namespace android {
+namespace init {
+
+enum class BootTraceEvent : uint8_t {
+    kActionBegin,
+    kActionEnd,
+    kCommand,             // arg is the duration in nanoseconds.
+    kServiceFork,         // arg is the pid.
+    kServiceExit,         // arg is the pid.
+    kPropertyWaitBegin,
+    kPropertyWaitEnd,
+    kFileWait,            // arg is the duration in nanoseconds.
+};
+
+// A fixed-size ring buffer of init's own events, cheap enough to always be recording: each event
+// is a timestamp and a truncated copy of its name written into a preallocated slot, and the oldest
+// events are overwritten once it is full. It is written to by init's main thread only.
+//
+// It is exported in the JSON trace event format, which Perfetto and chrome://tracing both open.
+class BootTrace {
+  public:
+    static BootTrace& GetInstance();
+
+    // Exposed for testing
+    explicit BootTrace(size_t capacity);
+
+    void Record(BootTraceEvent event, std::string_view name, int64_t arg = 0) {
+        Record(event, name, arg, android::base::boot_clock::now());
+    }
+    void Record(BootTraceEvent event, std::string_view name, std::chrono::nanoseconds duration,
+                android::base::boot_clock::time_point end = android::base::boot_clock::now()) {
+        Record(event, name, duration.count(), end);
+    }
+    void Record(BootTraceEvent event, std::string_view name, int64_t arg,
+                android::base::boot_clock::time_point timestamp);
+    std::string ToJson() const;
+
+  private:
+    struct Entry {
+        int64_t timestamp_ns;
+        int64_t arg;
+        BootTraceEvent event;
+        char name[47];
+    };
+
+    // Not value-initialized, so pages are only touched once they are written.
+    std::unique_ptr<Entry[]> entries_;
+    size_t capacity_;
+    size_t next_ = 0;
+    bool wrapped_ = false;
+};
+
+Result<void> do_dump_boot_trace(const BuiltinArguments& args);
+
+}  // namespace init
+}  // namespace android
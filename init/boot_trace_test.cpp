@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "boot_trace.h"
+
+#include <gtest/gtest.h>
+
+using namespace std::literals;
+
+namespace android {
+namespace init {
+
+static size_t CountOf(const std::string& haystack, const std::string& needle) {
+    size_t count = 0;
+    for (auto pos = haystack.find(needle); pos != std::string::npos;
+         pos = haystack.find(needle, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+TEST(boot_trace, Events) {
+    BootTrace trace(16);
+    trace.Record(BootTraceEvent::kActionBegin, "early-init");
+    trace.Record(BootTraceEvent::kCommand, "mkdir", 2ms);
+    trace.Record(BootTraceEvent::kServiceFork, "ueventd", 42);
+    trace.Record(BootTraceEvent::kActionEnd, "");
+    trace.Record(BootTraceEvent::kFileWait, "/dev/\"quoted\"", 1500us);
+
+    auto json = trace.ToJson();
+    EXPECT_EQ(0U, json.find("{\"traceEvents\":["));
+    EXPECT_NE(std::string::npos,
+              json.find("\"name\":\"early-init\",\"cat\":\"action\",\"ph\":\"B\""));
+    EXPECT_NE(std::string::npos, json.find("\"ph\":\"E\""));
+    EXPECT_NE(std::string::npos, json.find("\"name\":\"mkdir\",\"cat\":\"command\",\"ph\":\"X\""));
+    EXPECT_NE(std::string::npos, json.find("\"dur\":2000.000}"));
+    EXPECT_NE(std::string::npos, json.find("\"event\":\"fork\",\"pid\":42"));
+    EXPECT_NE(std::string::npos, json.find("\"name\":\"/dev/\\\"quoted\\\"\""));
+    EXPECT_NE(std::string::npos, json.find("\"overwritten\":false"));
+}
+
+TEST(boot_trace, Wraps) {
+    BootTrace trace(4);
+    for (int i = 0; i < 6; ++i) {
+        trace.Record(BootTraceEvent::kActionBegin, "action" + std::to_string(i));
+    }
+
+    auto json = trace.ToJson();
+    EXPECT_EQ(4U, CountOf(json, "\"ph\":\"B\""));
+    EXPECT_EQ(std::string::npos, json.find("action1"));
+    EXPECT_LT(json.find("action2"), json.find("action5"));
+    EXPECT_NE(std::string::npos, json.find("\"overwritten\":true"));
+}
+
+TEST(boot_trace, TruncatesNames) {
+    BootTrace trace(1);
+    trace.Record(BootTraceEvent::kActionBegin, std::string(100, 'a'));
+    auto json = trace.ToJson();
+    EXPECT_NE(std::string::npos, json.find("\"" + std::string(46, 'a') + "\""));
+}
+
+}  // namespace init
+}  // namespace android
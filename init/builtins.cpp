@@ -62,6 +62,7 @@
 #include <system/thread_defs.h>
 
 #include "action_manager.h"
+#include "boot_trace.h"
 #include "bootchart.h"
 #include "fscrypt_init_extensions.h"
 #include "init.h"
@@ -155,6 +156,17 @@ static Result<void> do_class_start(const BuiltinArguments& args) {
         return {};
     // Starting a class does not start services which are explicitly disabled.
     // They must  be started individually.
+    if (android::base::GetBoolProperty("ro.init.parallel_class_start", false)) {
+        // The services are still forked one by one, in order, below; only
+        // the SELinux lookups before each fork are done up front.
+        std::vector<Service*> services;
+        for (const auto& service : ServiceList::GetInstance()) {
+            if (service->classnames().count(args[1])) {
+                services.emplace_back(service.get());
+            }
+        }
+        Service::PrecomputeContexts(services);
+    }
     for (const auto& service : ServiceList::GetInstance()) {
         if (service->classnames().count(args[1])) {
             if (auto result = service->StartIfNotDisabled(); !result) {
@@ -1058,10 +1070,17 @@ static Result<void> do_wait(const BuiltinArguments& args) {
         timeout = std::chrono::seconds(timeout_int);
     }
 
-    if (wait_for_file(args[1].c_str(), timeout) != 0) {
-        return Error() << "wait_for_file() failed";
+    // A subcontext has no main loop to return to, so it still waits in place.
+    if (args.context != kInitContext) {
+        if (wait_for_file(args[1].c_str(), timeout) != 0) {
+            return Error() << "wait_for_file() failed";
+        }
+        return {};
     }
 
+    if (!start_waiting_for_file(args[1], timeout)) {
+        return Error() << "already waiting for a property or file";
+    }
     return {};
 }
 
@@ -1208,6 +1227,7 @@ const BuiltinFunctionMap& GetBuiltinFunctionMap() {
         {"class_stop",              {1,     1,    {false,  do_class_stop}}},
         {"copy",                    {2,     2,    {true,   do_copy}}},
         {"domainname",              {1,     1,    {true,   do_domainname}}},
+        {"dump_boot_trace",         {1,     1,    {false,  do_dump_boot_trace}}},
         {"enable",                  {1,     1,    {false,  do_enable}}},
         {"exec",                    {1,     kMax, {false,  do_exec}}},
         {"exec_background",         {1,     kMax, {false,  do_exec_background}}},
@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compiled_config.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <android-base/file.h>
+#include <android-base/mapped_file.h>
+#include <android-base/unique_fd.h>
+#include <openssl/sha.h>
+
+#include "tokenizer.h"
+
+using android::base::MappedFile;
+using android::base::unique_fd;
+using android::base::WriteStringToFile;
+
+namespace android {
+namespace init {
+
+// The layout, in host byte order:
+//   u32 magic, u32 version, string sha256 of the script, u32 line count,
+//   then for each line: u32 line number, u32 arg count, and that many strings,
+// where a string is a u32 length followed by that many bytes.
+static constexpr uint32_t kCompiledConfigMagic = 0x43524e49;  // "INRC"
+static constexpr uint32_t kCompiledConfigVersion = 1;
+
+static std::string Sha256(const std::string& contents) {
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const uint8_t*>(contents.data()), contents.size(), digest);
+    return std::string(reinterpret_cast<const char*>(digest), sizeof(digest));
+}
+
+static void AppendU32(std::string* out, uint32_t value) {
+    out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void AppendString(std::string* out, const std::string& value) {
+    AppendU32(out, value.size());
+    out->append(value);
+}
+
+namespace {
+
+class CompiledConfigReader {
+  public:
+    CompiledConfigReader(const char* data, size_t size) : data_(data), remaining_(size) {}
+
+    bool ReadU32(uint32_t* value) {
+        if (remaining_ < sizeof(*value)) return false;
+        memcpy(value, data_, sizeof(*value));
+        Advance(sizeof(*value));
+        return true;
+    }
+
+    bool ReadString(std::string* value) {
+        uint32_t size;
+        if (!ReadU32(&size) || remaining_ < size) return false;
+        value->assign(data_, size);
+        Advance(size);
+        return true;
+    }
+
+    size_t remaining() const { return remaining_; }
+
+  private:
+    void Advance(size_t size) {
+        data_ += size;
+        remaining_ -= size;
+    }
+
+    const char* data_;
+    size_t remaining_;
+};
+
+}  // namespace
+
+std::vector<ConfigLine> TokenizeConfig(std::string* data) {
+    data->push_back('\n');  // TODO: fix tokenizer
+    data->push_back('\0');
+
+    parse_state state;
+    state.line = 0;
+    state.ptr = data->data();
+    state.nexttoken = 0;
+
+    std::vector<ConfigLine> lines;
+    std::vector<std::string> args;
+    for (;;) {
+        switch (next_token(&state)) {
+            case T_EOF:
+                return lines;
+            case T_NEWLINE:
+                state.line++;
+                if (!args.empty()) {
+                    lines.push_back({state.line, std::move(args)});
+                    args.clear();
+                }
+                break;
+            case T_TEXT:
+                args.emplace_back(state.text);
+                break;
+        }
+    }
+}
+
+Result<void> WriteCompiledConfig(const std::string& path, const std::string& contents,
+                                 const std::vector<ConfigLine>& lines) {
+    std::string out;
+    AppendU32(&out, kCompiledConfigMagic);
+    AppendU32(&out, kCompiledConfigVersion);
+    AppendString(&out, Sha256(contents));
+    AppendU32(&out, lines.size());
+    for (const auto& line : lines) {
+        AppendU32(&out, line.line);
+        AppendU32(&out, line.args.size());
+        for (const auto& arg : line.args) {
+            AppendString(&out, arg);
+        }
+    }
+
+    if (!WriteStringToFile(out, path)) {
+        return ErrnoError() << "Unable to write '" << path << "'";
+    }
+    return {};
+}
+
+Result<std::vector<ConfigLine>> ReadCompiledConfig(const std::string& path,
+                                                   const std::string& contents) {
+    unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC)));
+    if (fd == -1) {
+        return ErrnoError() << "open() failed";
+    }
+
+    // The same rule as for the scripts themselves.
+    struct stat sb;
+    if (fstat(fd, &sb) == -1) {
+        return ErrnoError() << "fstat failed()";
+    }
+    if ((sb.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+        return Error() << "Skipping insecure file";
+    }
+    if (sb.st_size == 0) {
+        return Error() << "Empty file";
+    }
+
+    auto mapping = MappedFile::FromFd(fd, 0, sb.st_size, PROT_READ);
+    if (!mapping) {
+        return ErrnoError() << "mmap() failed";
+    }
+
+    CompiledConfigReader reader(mapping->data(), mapping->size());
+    uint32_t magic, version;
+    if (!reader.ReadU32(&magic) || magic != kCompiledConfigMagic || !reader.ReadU32(&version) ||
+        version != kCompiledConfigVersion) {
+        return Error() << "Unrecognized format";
+    }
+
+    std::string hash;
+    if (!reader.ReadString(&hash)) {
+        return Error() << "Truncated file";
+    }
+    if (hash != Sha256(contents)) {
+        return Error() << "Out of date with its script";
+    }
+
+    uint32_t line_count;
+    if (!reader.ReadU32(&line_count) || line_count > reader.remaining() / 8) {
+        return Error() << "Truncated file";
+    }
+
+    std::vector<ConfigLine> lines(line_count);
+    for (auto& line : lines) {
+        uint32_t line_number, arg_count;
+        if (!reader.ReadU32(&line_number) || !reader.ReadU32(&arg_count) ||
+            arg_count > reader.remaining() / 4) {
+            return Error() << "Truncated file";
+        }
+        line.line = line_number;
+        line.args.resize(arg_count);
+        for (auto& arg : line.args) {
+            if (!reader.ReadString(&arg)) {
+                return Error() << "Truncated file";
+            }
+        }
+    }
+    if (reader.remaining() != 0) {
+        return Error() << "Trailing data";
+    }
+    return lines;
+}
+
+}  // namespace init
+}  // namespace android
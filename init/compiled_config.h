@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "result.h"
+
+// A compiled config is the tokenized form of an init script, written by host_init_verifier at
+// build time to the script's path plus kCompiledConfigSuffix. When init parses a script that has
+// one, and the SHA-256 of the script recorded in it still matches, init hands its lines straight to
+// the section parsers instead of tokenizing the script again. Any other mismatch or error simply
+// falls back to tokenizing the text.
+
+namespace android {
+namespace init {
+
+static constexpr const char kCompiledConfigSuffix[] = ".compiled";
+
+struct ConfigLine {
+    int line;
+    std::vector<std::string> args;
+};
+
+std::vector<ConfigLine> TokenizeConfig(std::string* data);
+
+Result<void> WriteCompiledConfig(const std::string& path, const std::string& contents,
+                                 const std::vector<ConfigLine>& lines);
+
+// Returns an error with code ENOENT if there is no compiled config at path.
+Result<std::vector<ConfigLine>> ReadCompiledConfig(const std::string& path,
+                                                   const std::string& contents);
+
+}  // namespace init
+}  // namespace android
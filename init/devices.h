@@ -109,6 +109,7 @@ class Subsystem {
 class DeviceHandler : public UeventHandler {
   public:
     friend class DeviceHandlerTester;
+    friend class DeviceHandlerBenchmark;
 
     DeviceHandler();
     DeviceHandler(std::vector<Permissions> dev_permissions,
@@ -49,15 +49,37 @@ static void LoadFirmware(const std::string& firmware, const std::string& root, i
     // Start transfer.
     WriteFully(loading_fd, "1", 1);
 
-    // Copy the firmware.
-    int rc = sendfile(data_fd, fw_fd, nullptr, fw_size);
-    if (rc == -1) {
-        PLOG(ERROR) << "firmware: sendfile failed { '" << root << "', '" << firmware << "' }";
+    // The blob is read once, front to back, and the kernel keeps its own copy once loaded.
+    posix_fadvise(fw_fd, 0, fw_size, POSIX_FADV_SEQUENTIAL);
+
+    // Copy the firmware. sendfile() may copy less than asked for, so keep going until it's all
+    // there, rather than committing a truncated blob.
+    size_t copied = 0;
+    bool ok = true;
+    while (copied < fw_size) {
+        ssize_t rc = TEMP_FAILURE_RETRY(sendfile(data_fd, fw_fd, nullptr, fw_size - copied));
+        if (rc == -1) {
+            PLOG(ERROR) << "firmware: sendfile failed { '" << root << "', '" << firmware << "' }";
+            ok = false;
+            break;
+        }
+        if (rc == 0) {
+            LOG(ERROR) << "firmware: sendfile stopped after " << copied << " of " << fw_size
+                       << " bytes { '" << root << "', '" << firmware << "' }";
+            ok = false;
+            break;
+        }
+        copied += rc;
     }
 
     // Tell the firmware whether to abort or commit.
-    const char* response = (rc != -1) ? "0" : "-1";
+    const char* response = ok ? "0" : "-1";
     WriteFully(loading_fd, response, strlen(response));
+
+    posix_fadvise(fw_fd, 0, fw_size, POSIX_FADV_DONTNEED);
+    if (ok) {
+        LOG(INFO) << "firmware: copied " << fw_size << " bytes of '" << firmware << "'";
+    }
 }
 
 static bool IsBooting() {
@@ -141,6 +141,10 @@ bool ForceNormalBoot(const std::string& cmdline) {
     return cmdline.find("androidboot.force_normal_boot=1") != std::string::npos;
 }
 
+bool LoadModulesInParallel(const std::string& cmdline) {
+    return cmdline.find("androidboot.load_modules_parallel=1") != std::string::npos;
+}
+
 }  // namespace
 
 int FirstStageMain(int argc, char** argv) {
@@ -239,7 +243,13 @@ int FirstStageMain(int argc, char** argv) {
     }
 
     Modprobe m({"/lib/modules"});
-    if (!m.LoadListedModules()) {
+    bool modules_loaded;
+    if (LoadModulesInParallel(cmdline)) {
+        modules_loaded = m.LoadModulesParallel(std::thread::hardware_concurrency());
+    } else {
+        modules_loaded = m.LoadListedModules();
+    }
+    if (!modules_loaded) {
         LOG(FATAL) << "Failed to load kernel modules";
     }
 
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+#include <fstab/fstab.h>
+#include <libdm/dm.h>
+#include <libdm/loop_control.h>
+
+using android::base::StringPrintf;
+using android::dm::DeviceMapper;
+using android::dm::DmTable;
+using android::dm::DmTargetLinear;
+using android::dm::LoopDevice;
+using android::fs_mgr::Fstab;
+using android::fs_mgr::ReadFstabFromFile;
+using namespace std::chrono_literals;
+
+namespace android {
+namespace init {
+
+// The partitions of a current device with dynamic partitions, padded out to 20 entries.
+static constexpr int kNumPartitions = 20;
+static constexpr const char* kLogicalPartitions[] = {"system", "system_ext", "product", "vendor",
+                                                     "odm", "vendor_dlkm"};
+static constexpr const char* kPhysicalPartitions[] = {"metadata", "userdata", "persist", "misc",
+                                                      "modem", "bt_firmware", "dsp"};
+
+static std::string MakeFstab() {
+    std::string fstab;
+    int entries = 0;
+    for (const auto& name : kLogicalPartitions) {
+        fstab += StringPrintf(
+                "%-12s /%-12s ext4 ro,barrier=1 "
+                "wait,slotselect,avb=vbmeta_system,logical,first_stage_mount,"
+                "avb_keys=/avb/q-gsi.avbpubkey:/avb/r-gsi.avbpubkey:/avb/s-gsi.avbpubkey\n",
+                name, name);
+        entries++;
+    }
+    fstab += "/dev/block/by-name/metadata /metadata ext4 "
+             "noatime,nosuid,nodev,discard,data=journal,commit=1 "
+             "wait,check,formattable,first_stage_mount\n";
+    fstab += "/dev/block/bootdevice/by-name/userdata /data f2fs "
+             "noatime,nosuid,nodev,discard,reserve_root=32768,resgid=1065,fsync_mode=nobarrier "
+             "latemount,wait,check,fileencryption=aes-256-xts:aes-256-cts:v2,"
+             "keydirectory=/metadata/vold/metadata_encryption,quota,reservedsize=128M,checkpoint=fs\n";
+    entries += 2;
+    for (size_t i = 2; i < std::size(kPhysicalPartitions); i++, entries++) {
+        fstab += StringPrintf("/dev/block/by-name/%s /mnt/vendor/%s ext4 noatime,nosuid,nodev "
+                              "wait,slotselect,check,formattable\n",
+                              kPhysicalPartitions[i], kPhysicalPartitions[i]);
+    }
+    for (; entries < kNumPartitions; entries++) {
+        fstab += StringPrintf("/devices/platform/soc/%d.usb/usb%d auto vfat defaults "
+                              "voldmanaged=usb%d:auto\n",
+                              entries, entries, entries);
+    }
+    return fstab;
+}
+
+// Parses a 20 partition fstab. state.range(0) is 0 when the file is unchanged between reads, so
+// that the cached copy is used, and 1 when it changes before each read.
+static void BenchmarkReadFstab(benchmark::State& state) {
+    android::base::ScopedLogSeverity severity(android::base::WARNING);
+    TemporaryDir dir;
+    std::string path = dir.path + std::string("/fstab.bench");
+    std::string contents = MakeFstab();
+    if (!android::base::WriteStringToFile(contents, path)) {
+        state.SkipWithError("Failed to write the fstab.");
+        return;
+    }
+
+    for (auto _ : state) {
+        if (state.range(0)) {
+            state.PauseTiming();
+            android::base::WriteStringToFile(contents, path);
+            state.ResumeTiming();
+        }
+        Fstab fstab;
+        if (!ReadFstabFromFile(path, &fstab) || fstab.size() != kNumPartitions) {
+            state.SkipWithError("Failed to read the fstab.");
+            return;
+        }
+    }
+}
+BENCHMARK(BenchmarkReadFstab)->Arg(0)->Arg(1);
+
+// A loop device to map the dm-linear devices of the logical partitions onto, as first stage mount
+// does with the super partition.
+class FakeSuper {
+  public:
+    static constexpr uint64_t kPartitionSectors = 2048;
+
+    ~FakeSuper() { DeleteDevices(); }
+
+    bool Init() {
+        if (ftruncate(file_.fd, kNumPartitions * kPartitionSectors * 512) != 0) return false;
+        loop_ = std::make_unique<LoopDevice>(file_.fd, 10s);
+        if (!loop_->valid()) return false;
+
+        for (int i = 0; i < kNumPartitions; i++) {
+            tables_[i].Emplace<DmTargetLinear>(0, kPartitionSectors, loop_->device(),
+                                          i * kPartitionSectors);
+            names_.emplace_back(StringPrintf("init_benchmark_%d", i));
+            DeviceMapper::Instance().DeleteDeviceIfExists(names_.back());
+        }
+        return true;
+    }
+
+    void DeleteDevices() {
+        for (const auto& name : names_) {
+            DeviceMapper::Instance().DeleteDeviceIfExists(name);
+        }
+    }
+
+    const std::vector<std::string>& names() const { return names_; }
+    const DmTable& table(int i) const { return tables_[i]; }
+
+  private:
+    TemporaryFile file_;
+    std::unique_ptr<LoopDevice> loop_;
+    DmTable tables_[kNumPartitions];
+    std::vector<std::string> names_;
+};
+
+// Creates the dm-linear devices of 20 logical partitions and waits for their nodes, one device at
+// a time (0) or as one batch (1).
+static void BenchmarkCreateLogicalPartitions(benchmark::State& state) {
+    if (getuid() != 0) {
+        state.SkipWithError("Skipping benchmark, must be run as root.");
+        return;
+    }
+    FakeSuper super;
+    if (!super.Init()) {
+        state.SkipWithError("Failed to create the loop device.");
+        return;
+    }
+
+    auto& dm = DeviceMapper::Instance();
+    for (auto _ : state) {
+        bool ok = true;
+        if (state.range(0)) {
+            std::vector<DeviceMapper::DeviceSpec> specs;
+            for (int i = 0; i < kNumPartitions; i++) {
+                specs.push_back({super.names()[i], &super.table(i)});
+            }
+            std::vector<std::string> paths;
+            ok = dm.CreateDevices(specs, &paths, 5s);
+        } else {
+            for (int i = 0; i < kNumPartitions && ok; i++) {
+                std::string path;
+                ok = dm.CreateDevice(super.names()[i], super.table(i), &path, 5s);
+            }
+        }
+
+        state.PauseTiming();
+        super.DeleteDevices();
+        if (!ok) {
+            state.SkipWithError("Failed to create the devices.");
+            return;
+        }
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * kNumPartitions);
+}
+BENCHMARK(BenchmarkCreateLogicalPartitions)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+}  // namespace init
+}  // namespace android
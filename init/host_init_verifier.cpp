@@ -35,6 +35,7 @@
 #include "action_manager.h"
 #include "action_parser.h"
 #include "check_builtins.h"
+#include "compiled_config.h"
 #include "host_import_parser.h"
 #include "host_init_stubs.h"
 #include "interface_utils.h"
@@ -142,12 +143,15 @@ static Result<void> check_stub(const BuiltinArguments& args) {
 #include "generated_stub_builtin_function_map.h"
 
 void PrintUsage() {
-    std::cout << "usage: host_init_verifier [-p FILE] -i FILE <init rc file>\n"
+    std::cout << "usage: host_init_verifier [-p FILE] [-o FILE] -i FILE <init rc file>\n"
                  "\n"
                  "Tests an init script for correctness\n"
                  "\n"
                  "-p FILE\tSearch this passwd file for users and groups\n"
                  "-i FILE\tParse this JSON file for the HIDL interface inheritance hierarchy\n"
+                 "-o FILE\tWrite the compiled script to FILE, for init to load instead of\n"
+                 "\tparsing the script; install it next to the script with the suffix "
+              << kCompiledConfigSuffix << "\n"
               << std::endl;
 }
 
@@ -156,6 +160,7 @@ int main(int argc, char** argv) {
     android::base::SetMinimumLogSeverity(android::base::ERROR);
 
     std::string interface_inheritance_hierarchy_file;
+    std::string compiled_config_file;
 
     while (true) {
         static const struct option long_options[] = {
@@ -163,7 +168,7 @@ int main(int argc, char** argv) {
                 {nullptr, 0, nullptr, 0},
         };
 
-        int arg = getopt_long(argc, argv, "p:i:", long_options, nullptr);
+        int arg = getopt_long(argc, argv, "p:i:o:", long_options, nullptr);
 
         if (arg == -1) {
             break;
@@ -179,6 +184,9 @@ int main(int argc, char** argv) {
             case 'i':
                 interface_inheritance_hierarchy_file = optarg;
                 break;
+            case 'o':
+                compiled_config_file = optarg;
+                break;
             default:
                 std::cerr << "getprop: getopt returned invalid result: " << arg << std::endl;
                 return EXIT_FAILURE;
@@ -221,6 +229,20 @@ int main(int argc, char** argv) {
                    << " errors";
         return EXIT_FAILURE;
     }
+
+    if (!compiled_config_file.empty()) {
+        std::string contents;
+        if (!android::base::ReadFileToString(*argv, &contents)) {
+            PLOG(ERROR) << "Failed to read init rc script '" << *argv << "'";
+            return EXIT_FAILURE;
+        }
+        auto data = contents;
+        auto lines = TokenizeConfig(&data);
+        if (auto result = WriteCompiledConfig(compiled_config_file, contents, lines); !result) {
+            LOG(ERROR) << result.error();
+            return EXIT_FAILURE;
+        }
+    }
     return EXIT_SUCCESS;
 }
 
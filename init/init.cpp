@@ -24,12 +24,14 @@
 #include <string.h>
 #include <sys/mount.h>
 #include <sys/signalfd.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #define _REALLY_INCLUDE_SYS__SYSTEM_PROPERTIES_H_
 #include <sys/_system_properties.h>
 
+#include <algorithm>
 #include <functional>
 #include <map>
 #include <memory>
@@ -53,6 +55,7 @@
 #include <selinux/android.h>
 
 #include "action_parser.h"
+#include "boot_trace.h"
 #include "builtins.h"
 #include "epoll.h"
 #include "first_stage_init.h"
@@ -98,6 +101,9 @@ static int property_fd = -1;
 static std::unique_ptr<Timer> waiting_for_prop(nullptr);
 static std::string wait_prop_name;
 static std::string wait_prop_value;
+static std::unique_ptr<Timer> waiting_for_file(nullptr);
+static std::string wait_file_name;
+static std::chrono::nanoseconds wait_file_timeout;
 static bool shutting_down;
 static std::string shutdown_command;
 static bool do_shutdown = false;
@@ -167,6 +173,7 @@ bool start_waiting_for_property(const char *name, const char *value)
         wait_prop_name = name;
         wait_prop_value = value;
         waiting_for_prop.reset(new Timer());
+        BootTrace::GetInstance().Record(BootTraceEvent::kPropertyWaitBegin, wait_prop_name);
     } else {
         LOG(INFO) << "start_waiting_for_property(\""
                   << name << "\", \"" << value << "\"): already set";
@@ -174,7 +181,56 @@ bool start_waiting_for_property(const char *name, const char *value)
     return true;
 }
 
+bool start_waiting_for_file(const std::string& path, std::chrono::nanoseconds timeout) {
+    if (waiting_for_prop || waiting_for_file) {
+        return false;
+    }
+    struct stat sb;
+    if (stat(path.c_str(), &sb) == 0) {
+        LOG(INFO) << "wait for '" << path << "': already exists";
+        return true;
+    }
+    wait_file_name = path;
+    wait_file_timeout = timeout;
+    waiting_for_file.reset(new Timer());
+    return true;
+}
+
+void ResetWaitForFile() {
+    wait_file_name.clear();
+    waiting_for_file.reset();
+}
+
+// Returns when the main loop should next wake up for the wait started by start_waiting_for_file(),
+// or nothing if there is no such wait. Once the file exists or the wait times out, the action
+// queue resumes.
+static std::optional<std::chrono::milliseconds> CheckWaitForFile() {
+    if (!waiting_for_file) return {};
+
+    struct stat sb;
+    bool found = stat(wait_file_name.c_str(), &sb) == 0;
+    auto waited = waiting_for_file->duration();
+    if (found || waited >= wait_file_timeout) {
+        if (found) {
+            LOG(INFO) << "wait for '" << wait_file_name << "' took " << *waiting_for_file;
+        } else {
+            LOG(WARNING) << "wait for '" << wait_file_name << "' timed out and took "
+                         << *waiting_for_file;
+        }
+        BootTrace::GetInstance().Record(BootTraceEvent::kFileWait, wait_file_name, waited);
+        ResetWaitForFile();
+        return 0ms;
+    }
+
+    // Poll as often as wait_for_file() does, without overshooting the deadline.
+    auto remaining = std::chrono::ceil<std::chrono::milliseconds>(wait_file_timeout - waited);
+    return std::min<std::chrono::milliseconds>(10ms, remaining);
+}
+
 void ResetWaitForProp() {
+    if (waiting_for_prop) {
+        BootTrace::GetInstance().Record(BootTraceEvent::kPropertyWaitEnd, wait_prop_name);
+    }
     wait_prop_name.clear();
     wait_prop_value.clear();
     waiting_for_prop.reset();
@@ -818,10 +874,10 @@ int SecondStageMain(int argc, char** argv) {
             }
         }
 
-        if (!(waiting_for_prop || Service::is_exec_service_running())) {
+        if (!(waiting_for_prop || waiting_for_file || Service::is_exec_service_running())) {
             am.ExecuteOneCommand();
         }
-        if (!(waiting_for_prop || Service::is_exec_service_running())) {
+        if (!(waiting_for_prop || waiting_for_file || Service::is_exec_service_running())) {
             if (!shutting_down) {
                 auto next_process_action_time = HandleProcessActions();
 
@@ -836,6 +892,10 @@ int SecondStageMain(int argc, char** argv) {
             // If there's more work to do, wake up again immediately.
             if (am.HasMoreCommands()) epoll_timeout = 0ms;
         }
+        if (auto file_wait_timeout = CheckWaitForFile()) {
+            epoll_timeout = epoll_timeout ? std::min(*epoll_timeout, *file_wait_timeout)
+                                          : *file_wait_timeout;
+        }
 
         auto pending_functions = epoll.Wait(epoll_timeout);
         if (!pending_functions) {
@@ -18,6 +18,7 @@
 
 #include <sys/types.h>
 
+#include <chrono>
 #include <string>
 
 #include "action.h"
@@ -34,10 +35,13 @@ Parser CreateServiceOnlyParser(ServiceList& service_list);
 void EnterShutdown(const std::string& command);
 
 bool start_waiting_for_property(const char *name, const char *value);
+// Pauses the action queue, but not the main loop, until path exists or timeout passes.
+bool start_waiting_for_file(const std::string& path, std::chrono::nanoseconds timeout);
 
 void DumpState();
 
 void ResetWaitForProp();
+void ResetWaitForFile();
 
 void SendLoadPersistentPropertiesMessage();
 void SendStopSendingMessagesMessage();
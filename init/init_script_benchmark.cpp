@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+
+#include "action.h"
+#include "action_manager.h"
+#include "action_parser.h"
+#include "builtin_arguments.h"
+#include "builtins.h"
+#include "compiled_config.h"
+#include "import_parser.h"
+#include "parser.h"
+#include "service_list.h"
+#include "service_parser.h"
+
+using android::base::StringPrintf;
+
+namespace android {
+namespace init {
+
+// The synthetic .rc tree is shaped like the scripts of a current device: a few hundred files, each
+// declaring a handful of services and the actions that set up their files and properties.
+static constexpr int kServicesPerFile = 4;
+static constexpr int kActionsPerFile = 8;
+static constexpr const char* kEventTriggers[] = {"early-init", "init", "post-fs", "post-fs-data",
+                                                 "boot"};
+
+static const BuiltinFunctionMap& BenchmarkFunctionMap() {
+    static const auto function_map = [] {
+        auto nop = [](const BuiltinArguments&) { return Result<void>{}; };
+        constexpr auto kMax = std::numeric_limits<std::size_t>::max();
+        return BuiltinFunctionMap{
+                {"chmod", {2, 2, {true, nop}}},
+                {"chown", {2, 3, {true, nop}}},
+                {"mkdir", {1, 6, {true, nop}}},
+                {"restorecon", {1, kMax, {true, nop}}},
+                {"setprop", {2, 2, {true, nop}}},
+                {"start", {1, 1, {false, nop}}},
+                {"write", {2, 2, {true, nop}}},
+        };
+    }();
+    return function_map;
+}
+
+static std::string MakeScript(int file) {
+    std::string script;
+    for (int i = 0; i < kServicesPerFile; i++) {
+        script += StringPrintf(
+                "service bench_%d_%d /vendor/bin/hw/bench_%d_%d --instance %d\n"
+                "    class %s\n"
+                "    user system\n"
+                "    group system inet\n"
+                "    writepid /dev/cpuset/system-background/tasks\n"
+                "    disabled\n\n",
+                file, i, file, i, i, i % 2 ? "hal" : "main");
+    }
+    for (int i = 0; i < kActionsPerFile; i++) {
+        if (i % 2) {
+            script += StringPrintf("on property:vendor.bench.%d.%d=1\n", file, i);
+        } else {
+            script += StringPrintf("on %s\n", kEventTriggers[(file + i) % std::size(kEventTriggers)]);
+        }
+        script += StringPrintf(
+                "    mkdir /data/vendor/bench_%d_%d 0770 system system\n"
+                "    chown system system /sys/class/bench/bench%d/enable\n"
+                "    chmod 0660 /sys/class/bench/bench%d/enable\n"
+                "    write /sys/class/bench/bench%d/enable 1\n"
+                "    setprop vendor.bench.%d.ready 1\n"
+                "    start bench_%d_%d\n\n",
+                file, i, i, i, i, file, file, i % kServicesPerFile);
+    }
+    return script;
+}
+
+// A directory of generated .rc files, with their compiled configs if requested.
+class ScriptTree {
+  public:
+    bool Create(int num_files, bool compiled) {
+        for (int file = 0; file < num_files; file++) {
+            auto path = StringPrintf("%s/bench_%04d.rc", dir_.path, file);
+            auto script = MakeScript(file);
+            if (!android::base::WriteStringToFile(script, path) || chmod(path.c_str(), 0600)) {
+                return false;
+            }
+            if (compiled) {
+                auto data = script;
+                auto lines = TokenizeConfig(&data);
+                if (!WriteCompiledConfig(path + kCompiledConfigSuffix, script, lines)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    const char* path() const { return dir_.path; }
+
+  private:
+    TemporaryDir dir_;
+};
+
+// Parses the tree into fresh ActionManager and ServiceList instances, the way init parses
+// /system/etc/init and friends in LoadBootScripts().
+static bool ParseTree(const ScriptTree& tree, ActionManager* am, ServiceList* service_list) {
+    Parser parser;
+    parser.AddSectionParser("service",
+                            std::make_unique<ServiceParser>(service_list, nullptr, std::nullopt));
+    parser.AddSectionParser("on", std::make_unique<ActionParser>(am, nullptr));
+    parser.AddSectionParser("import", std::make_unique<ImportParser>(&parser));
+    return parser.ParseConfig(tree.path()) && parser.parse_error_count() == 0;
+}
+
+// state.range(0) files, tokenized from their text (0) or read from compiled configs (1).
+static void BenchmarkParseScripts(benchmark::State& state) {
+    android::base::ScopedLogSeverity severity(android::base::WARNING);
+    Action::set_function_map(&BenchmarkFunctionMap());
+
+    ScriptTree tree;
+    if (!tree.Create(state.range(0), state.range(1))) {
+        state.SkipWithError("Failed to write the scripts.");
+        return;
+    }
+
+    for (auto _ : state) {
+        ActionManager am;
+        ServiceList service_list;
+        if (!ParseTree(tree, &am, &service_list)) {
+            state.SkipWithError("Failed to parse the scripts.");
+            return;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BenchmarkParseScripts)
+        ->Args({50, 0})
+        ->Args({50, 1})
+        ->Args({200, 0})
+        ->Args({200, 1})
+        ->Unit(benchmark::kMillisecond);
+
+static constexpr int kDispatchFiles = 200;
+
+// The actions of a parsed kDispatchFiles tree, which live as long as a benchmark runs.
+class ScriptActions {
+  public:
+    bool Create() {
+        Action::set_function_map(&BenchmarkFunctionMap());
+        return tree_.Create(kDispatchFiles, false) && ParseTree(tree_, &am_, &service_list_);
+    }
+
+    ActionManager& am() { return am_; }
+
+  private:
+    ScriptTree tree_;
+    ActionManager am_;
+    ServiceList service_list_;
+};
+
+// Queues the event triggers of boot and runs every command of the actions they match.
+static void BenchmarkEventTriggerDispatch(benchmark::State& state) {
+    android::base::ScopedLogSeverity severity(android::base::WARNING);
+    ScriptActions actions;
+    if (!actions.Create()) {
+        state.SkipWithError("Failed to create the scripts.");
+        return;
+    }
+
+    auto& am = actions.am();
+    for (auto _ : state) {
+        for (const auto& trigger : kEventTriggers) {
+            am.QueueEventTrigger(trigger);
+        }
+        while (am.HasMoreCommands()) {
+            am.ExecuteOneCommand();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * std::size(kEventTriggers));
+}
+BENCHMARK(BenchmarkEventTriggerDispatch);
+
+// Queues state.range(0) property changes, half of which match a property trigger, and runs every
+// command of the actions they match.
+static void BenchmarkPropertyTriggerDispatch(benchmark::State& state) {
+    android::base::ScopedLogSeverity severity(android::base::WARNING);
+    ScriptActions actions;
+    if (!actions.Create()) {
+        state.SkipWithError("Failed to create the scripts.");
+        return;
+    }
+
+    std::vector<std::pair<std::string, std::string>> changes;
+    for (int i = 0; i < state.range(0); i++) {
+        // The odd actions of each file are the property triggered ones.
+        int file = i % kDispatchFiles;
+        int action = (i / kDispatchFiles * 2 + 1) % kActionsPerFile;
+        changes.emplace_back(StringPrintf("vendor.bench.%d.%d", file, action), i % 2 ? "1" : "0");
+    }
+
+    auto& am = actions.am();
+    for (auto _ : state) {
+        for (const auto& [name, value] : changes) {
+            am.QueuePropertyChange(name, value);
+        }
+        while (am.HasMoreCommands()) {
+            am.ExecuteOneCommand();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BenchmarkPropertyTriggerDispatch)->Arg(100)->Arg(1000)->Arg(5000);
+
+}  // namespace init
+}  // namespace android
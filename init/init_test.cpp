@@ -24,6 +24,7 @@
 #include "action_parser.h"
 #include "builtin_arguments.h"
 #include "builtins.h"
+#include "compiled_config.h"
 #include "import_parser.h"
 #include "keyword_map.h"
 #include "parser.h"
@@ -134,6 +135,55 @@ execute_third
     TestInitText(init_script, test_function_map, commands, &service_list);
 }
 
+TEST(init, PropertyTriggerOrder) {
+    std::string init_script =
+        R"init(
+on property:init.test.a=1
+execute 1
+
+on property:init.test.b=1
+execute_never
+
+on boot
+execute_never
+
+on property:init.test.a=*
+execute 2
+
+on property:init.test.a=2
+execute_never
+
+on property:init.test.a=1
+execute 3
+
+)init";
+
+    int num_executed = 0;
+    auto execute_command = [&num_executed](const BuiltinArguments& args) {
+        EXPECT_EQ(++num_executed, std::stoi(args[1]));
+        return Result<void>{};
+    };
+    auto execute_never = [](const BuiltinArguments&) {
+        ADD_FAILURE() << "Action for another trigger was executed";
+        return Result<void>{};
+    };
+
+    BuiltinFunctionMap test_function_map = {
+            {"execute", {1, 1, {false, execute_command}}},
+            {"execute_never", {0, 0, {false, execute_never}}},
+    };
+
+    ActionManagerCommand change_property = [](ActionManager& am) {
+        am.QueuePropertyChange("init.test.a", "1");
+    };
+    std::vector<ActionManagerCommand> commands{change_property};
+
+    ServiceList service_list;
+    TestInitText(init_script, test_function_map, commands, &service_list);
+
+    EXPECT_EQ(3, num_executed);
+}
+
 TEST(init, OverrideService) {
     std::string init_script = R"init(
 service A something
@@ -219,6 +269,40 @@ TEST(init, EventTriggerOrderMultipleFiles) {
     EXPECT_EQ(6, num_executed);
 }
 
+TEST(init, CompiledConfig) {
+    std::string init_script = "on boot\nexecute 1\n";
+
+    TemporaryDir dir;
+    std::string script_path = std::string(dir.path) + "/test.rc";
+    ASSERT_TRUE(WriteFile(script_path, init_script));
+
+    // The compiled lines differ from the script, to show which of the two was used.
+    std::vector<ConfigLine> lines = {
+            {1, {"on", "boot"}},
+            {2, {"execute", "2"}},
+    };
+    ASSERT_TRUE(WriteCompiledConfig(script_path + kCompiledConfigSuffix, init_script, lines));
+
+    int executed = 0;
+    auto execute_command = [&executed](const BuiltinArguments& args) {
+        executed = std::stoi(args[1]);
+        return Result<void>{};
+    };
+    BuiltinFunctionMap test_function_map = {
+            {"execute", {1, 1, {false, execute_command}}},
+    };
+    ActionManagerCommand trigger_boot = [](ActionManager& am) { am.QueueEventTrigger("boot"); };
+
+    ServiceList service_list;
+    TestInit(script_path, test_function_map, {trigger_boot}, &service_list);
+    EXPECT_EQ(2, executed);
+
+    // Once the script changes, the compiled config is out of date and the script is parsed.
+    ASSERT_TRUE(WriteFile(script_path, "on boot\nexecute 3\n"));
+    TestInit(script_path, test_function_map, {trigger_boot}, &service_list);
+    EXPECT_EQ(3, executed);
+}
+
 }  // namespace init
 }  // namespace android
 
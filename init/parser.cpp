@@ -24,7 +24,7 @@
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 
-#include "tokenizer.h"
+#include "compiled_config.h"
 #include "util.h"
 
 namespace android {
@@ -41,17 +41,12 @@ void Parser::AddSingleLineParser(const std::string& prefix, LineCallback callbac
 }
 
 void Parser::ParseData(const std::string& filename, std::string* data) {
-    data->push_back('\n');  // TODO: fix tokenizer
-    data->push_back('\0');
-
-    parse_state state;
-    state.line = 0;
-    state.ptr = data->data();
-    state.nexttoken = 0;
+    ParseLines(filename, TokenizeConfig(data));
+}
 
+void Parser::ParseLines(const std::string& filename, std::vector<ConfigLine>&& lines) {
     SectionParser* section_parser = nullptr;
     int section_start_line = -1;
-    std::vector<std::string> args;
 
     // If we encounter a bad section start, there is no valid parser object to parse the subsequent
     // sections, so we must suppress errors until the next valid section is found.
@@ -70,63 +65,47 @@ void Parser::ParseData(const std::string& filename, std::string* data) {
         section_start_line = -1;
     };
 
-    for (;;) {
-        switch (next_token(&state)) {
-            case T_EOF:
-                end_section();
-
-                for (const auto& [section_name, section_parser] : section_parsers_) {
-                    section_parser->EndFile();
-                }
-
-                return;
-            case T_NEWLINE: {
-                state.line++;
-                if (args.empty()) break;
-                // If we have a line matching a prefix we recognize, call its callback and unset any
-                // current section parsers.  This is meant for /sys/ and /dev/ line entries for
-                // uevent.
-                auto line_callback = std::find_if(
-                    line_callbacks_.begin(), line_callbacks_.end(),
-                    [&args](const auto& c) { return android::base::StartsWith(args[0], c.first); });
-                if (line_callback != line_callbacks_.end()) {
-                    end_section();
-
-                    if (auto result = line_callback->second(std::move(args)); !result) {
-                        parse_error_count_++;
-                        LOG(ERROR) << filename << ": " << state.line << ": " << result.error();
-                    }
-                } else if (section_parsers_.count(args[0])) {
-                    end_section();
-                    section_parser = section_parsers_[args[0]].get();
-                    section_start_line = state.line;
-                    if (auto result =
-                            section_parser->ParseSection(std::move(args), filename, state.line);
-                        !result) {
-                        parse_error_count_++;
-                        LOG(ERROR) << filename << ": " << state.line << ": " << result.error();
-                        section_parser = nullptr;
-                        bad_section_found = true;
-                    }
-                } else if (section_parser) {
-                    if (auto result = section_parser->ParseLineSection(std::move(args), state.line);
-                        !result) {
-                        parse_error_count_++;
-                        LOG(ERROR) << filename << ": " << state.line << ": " << result.error();
-                    }
-                } else if (!bad_section_found) {
-                    parse_error_count_++;
-                    LOG(ERROR) << filename << ": " << state.line
-                               << ": Invalid section keyword found";
-                }
-                args.clear();
-                break;
+    for (auto& [line, args] : lines) {
+        // If we have a line matching a prefix we recognize, call its callback and unset any
+        // current section parsers.  This is meant for /sys/ and /dev/ line entries for
+        // uevent.
+        auto line_callback = std::find_if(
+            line_callbacks_.begin(), line_callbacks_.end(),
+            [&args](const auto& c) { return android::base::StartsWith(args[0], c.first); });
+        if (line_callback != line_callbacks_.end()) {
+            end_section();
+
+            if (auto result = line_callback->second(std::move(args)); !result) {
+                parse_error_count_++;
+                LOG(ERROR) << filename << ": " << line << ": " << result.error();
+            }
+        } else if (section_parsers_.count(args[0])) {
+            end_section();
+            section_parser = section_parsers_[args[0]].get();
+            section_start_line = line;
+            if (auto result = section_parser->ParseSection(std::move(args), filename, line);
+                !result) {
+                parse_error_count_++;
+                LOG(ERROR) << filename << ": " << line << ": " << result.error();
+                section_parser = nullptr;
+                bad_section_found = true;
             }
-            case T_TEXT:
-                args.emplace_back(state.text);
-                break;
+        } else if (section_parser) {
+            if (auto result = section_parser->ParseLineSection(std::move(args), line); !result) {
+                parse_error_count_++;
+                LOG(ERROR) << filename << ": " << line << ": " << result.error();
+            }
+        } else if (!bad_section_found) {
+            parse_error_count_++;
+            LOG(ERROR) << filename << ": " << line << ": Invalid section keyword found";
         }
     }
+
+    end_section();
+
+    for (const auto& [section_name, section_parser] : section_parsers_) {
+        section_parser->EndFile();
+    }
 }
 
 bool Parser::ParseConfigFileInsecure(const std::string& path) {
@@ -148,7 +127,15 @@ bool Parser::ParseConfigFile(const std::string& path) {
         return false;
     }
 
-    ParseData(path, &config_contents.value());
+    auto compiled_path = path + kCompiledConfigSuffix;
+    if (auto lines = ReadCompiledConfig(compiled_path, *config_contents); lines) {
+        ParseLines(path, std::move(*lines));
+    } else {
+        if (lines.error().code() != ENOENT) {
+            LOG(INFO) << "Not using '" << compiled_path << "': " << lines.error();
+        }
+        ParseData(path, &config_contents.value());
+    }
 
     LOG(VERBOSE) << "(Parsing " << path << " took " << t << ".)";
     return true;
@@ -164,8 +151,10 @@ bool Parser::ParseConfigDir(const std::string& path) {
     dirent* current_file;
     std::vector<std::string> files;
     while ((current_file = readdir(config_dir.get()))) {
-        // Ignore directories and only process regular files.
-        if (current_file->d_type == DT_REG) {
+        // Ignore directories and only process regular files. Compiled configs are picked up
+        // along with their scripts.
+        if (current_file->d_type == DT_REG &&
+            !android::base::EndsWith(current_file->d_name, kCompiledConfigSuffix)) {
             std::string current_path =
                 android::base::StringPrintf("%s/%s", path.c_str(), current_file->d_name);
             files.emplace_back(current_path);
@@ -17,11 +17,13 @@
 #ifndef _INIT_PARSER_H_
 #define _INIT_PARSER_H_
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "compiled_config.h"
 #include "result.h"
 
 //  SectionParser is an interface that can parse a given 'section' in init.
@@ -83,6 +85,7 @@ class Parser {
 
   private:
     void ParseData(const std::string& filename, std::string* data);
+    void ParseLines(const std::string& filename, std::vector<ConfigLine>&& lines);
     bool ParseConfigDir(const std::string& path);
 
     std::map<std::string, std::unique_ptr<SectionParser>> section_parsers_;
@@ -22,7 +22,12 @@
 #include <sys/system_properties.h>
 #include <sys/types.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -36,6 +41,8 @@ using android::base::StartsWith;
 using android::base::WriteStringToFd;
 using android::base::unique_fd;
 
+using namespace std::chrono_literals;
+
 namespace android {
 namespace init {
 
@@ -45,6 +52,17 @@ namespace {
 
 constexpr const char kLegacyPersistentPropertyDir[] = "/data/property";
 
+// Queued properties are written out at most this long after they were set.
+constexpr auto kPersistentPropertyWriteDelay = 1s;
+
+// Held while the file is rewritten, so batches reach it in the order they
+// were taken from the queue.
+std::mutex write_lock;
+std::mutex pending_lock;
+std::condition_variable pending_cv;
+std::map<std::string, std::string> pending_properties;
+bool writer_started = false;
+
 void AddPersistentProperty(const std::string& name, const std::string& value,
                            PersistentProperties* persistent_properties) {
     auto persistent_property_record = persistent_properties->add_properties();
@@ -194,9 +212,11 @@ Result<void> WritePersistentPropertyFile(const PersistentProperties& persistent_
     return {};
 }
 
+namespace {
+
 // Persistent properties are not written often, so we rather not keep any data in memory and read
-// then rewrite the persistent property file for each update.
-void WritePersistentProperty(const std::string& name, const std::string& value) {
+// then rewrite the persistent property file for each batch of updates.
+void WritePersistentProperties(const std::map<std::string, std::string>& properties) {
     auto persistent_properties = LoadPersistentPropertyFile();
 
     if (!persistent_properties) {
@@ -204,14 +224,16 @@ void WritePersistentProperty(const std::string& name, const std::string& value)
                    << persistent_properties.error();
         persistent_properties = LoadPersistentPropertiesFromMemory();
     }
-    auto it = std::find_if(persistent_properties->mutable_properties()->begin(),
-                           persistent_properties->mutable_properties()->end(),
-                           [&name](const auto& record) { return record.name() == name; });
-    if (it != persistent_properties->mutable_properties()->end()) {
-        it->set_name(name);
-        it->set_value(value);
-    } else {
-        AddPersistentProperty(name, value, &persistent_properties.value());
+    for (const auto& [name, value] : properties) {
+        auto it = std::find_if(persistent_properties->mutable_properties()->begin(),
+                               persistent_properties->mutable_properties()->end(),
+                               [&name = name](const auto& record) { return record.name() == name; });
+        if (it != persistent_properties->mutable_properties()->end()) {
+            it->set_name(name);
+            it->set_value(value);
+        } else {
+            AddPersistentProperty(name, value, &persistent_properties.value());
+        }
     }
 
     if (auto result = WritePersistentPropertyFile(*persistent_properties); !result) {
@@ -219,6 +241,60 @@ void WritePersistentProperty(const std::string& name, const std::string& value)
     }
 }
 
+// Must be called with write_lock held.
+void WritePendingProperties() {
+    std::map<std::string, std::string> properties;
+    {
+        std::lock_guard<std::mutex> lock(pending_lock);
+        properties.swap(pending_properties);
+    }
+    if (!properties.empty()) {
+        WritePersistentProperties(properties);
+    }
+}
+
+void PersistentPropertyWriterThread() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(pending_lock);
+            pending_cv.wait(lock, [] { return !pending_properties.empty(); });
+        }
+        // Let a burst of updates accumulate, so that it costs one rewrite
+        // and one fsync rather than one per property.
+        std::this_thread::sleep_for(kPersistentPropertyWriteDelay);
+
+        std::lock_guard<std::mutex> lock(write_lock);
+        WritePendingProperties();
+    }
+}
+
+}  // namespace
+
+void QueuePersistentProperty(const std::string& name, const std::string& value) {
+    std::lock_guard<std::mutex> lock(pending_lock);
+    pending_properties[name] = value;
+    if (!writer_started) {
+        std::thread{PersistentPropertyWriterThread}.detach();
+        writer_started = true;
+    }
+    pending_cv.notify_one();
+}
+
+void FlushPersistentProperties() {
+    std::lock_guard<std::mutex> lock(write_lock);
+    WritePendingProperties();
+}
+
+void WritePersistentProperty(const std::string& name, const std::string& value) {
+    // Anything queued before this property has to reach the file with it.
+    std::lock_guard<std::mutex> lock(write_lock);
+    {
+        std::lock_guard<std::mutex> lock(pending_lock);
+        pending_properties[name] = value;
+    }
+    WritePendingProperties();
+}
+
 PersistentProperties LoadPersistentProperties() {
     auto persistent_properties = LoadPersistentPropertyFile();
 
@@ -28,6 +28,12 @@ namespace init {
 PersistentProperties LoadPersistentProperties();
 void WritePersistentProperty(const std::string& name, const std::string& value);
 
+// Like WritePersistentProperty(), but the property is written in the
+// background, together with any others set in the following second.
+void QueuePersistentProperty(const std::string& name, const std::string& value);
+// Write out any queued properties now, such as before shutting down.
+void FlushPersistentProperties();
+
 // Exposed only for testing
 Result<PersistentProperties> LoadPersistentPropertyFile();
 Result<void> WritePersistentPropertyFile(const PersistentProperties& persistent_properties);
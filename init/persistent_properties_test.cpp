@@ -132,6 +132,32 @@ TEST(persistent_properties, UpdateProperty) {
     CheckPropertiesEqual(persistent_properties_expected, read_back_properties);
 }
 
+TEST(persistent_properties, QueuedProperties) {
+    TemporaryFile tf;
+    ASSERT_TRUE(tf.fd != -1);
+    persistent_property_filename = tf.path;
+
+    std::vector<std::pair<std::string, std::string>> persistent_properties = {
+        {"persist.sys.locale", "en-US"},
+        {"persist.sys.timezone", "America/Los_Angeles"},
+    };
+    ASSERT_TRUE(WritePersistentPropertyFile(VectorToPersistentProperties(persistent_properties)));
+
+    QueuePersistentProperty("persist.sys.locale", "fr-FR");
+    QueuePersistentProperty("persist.test.queued", "1");
+    QueuePersistentProperty("persist.sys.locale", "pt-BR");
+    FlushPersistentProperties();
+
+    std::vector<std::pair<std::string, std::string>> persistent_properties_expected = {
+        {"persist.sys.locale", "pt-BR"},
+        {"persist.sys.timezone", "America/Los_Angeles"},
+        {"persist.test.queued", "1"},
+    };
+
+    auto read_back_properties = LoadPersistentProperties();
+    CheckPropertiesEqual(persistent_properties_expected, read_back_properties);
+}
+
 TEST(persistent_properties, UpdatePropertyBadParse) {
     TemporaryFile tf;
     ASSERT_TRUE(tf.fd != -1);
@@ -39,6 +39,7 @@
 #define _REALLY_INCLUDE_SYS__SYSTEM_PROPERTIES_H_
 #include <sys/_system_properties.h>
 
+#include <condition_variable>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -89,6 +90,11 @@ using android::properties::PropertyInfoEntry;
 namespace android {
 namespace init {
 
+// Property set requests are received on several threads, but are handled one
+// at a time. This lock serializes HandlePropertySet() and guards the state
+// below that it depends on.
+static std::mutex property_set_lock;
+
 static bool persistent_properties_loaded = false;
 
 static int property_set_fd = -1;
@@ -207,7 +213,7 @@ static uint32_t PropertySet(const std::string& name, const std::string& value, s
     // Don't write properties to disk until after we have read all default
     // properties to prevent them from being overwritten by default values.
     if (persistent_properties_loaded && StartsWith(name, "persist.")) {
-        WritePersistentProperty(name, value);
+        QueuePersistentProperty(name, value);
     }
     // If init hasn't started its main loop, then it won't be handling property changed messages
     // anyway, so there's no need to try to send them.
@@ -490,6 +496,10 @@ uint32_t CheckPermissions(const std::string& name, const std::string& value,
 uint32_t HandlePropertySet(const std::string& name, const std::string& value,
                            const std::string& source_context, const ucred& cr,
                            SocketConnection* socket, std::string* error) {
+    // This covers the permission checks too: libselinux's access vector
+    // cache is not locked when used through selinux_check_access().
+    auto guard = std::lock_guard{property_set_lock};
+
     if (auto ret = CheckPermissions(name, value, source_context, cr, error); ret != PROP_SUCCESS) {
         return ret;
     }
@@ -540,13 +550,41 @@ uint32_t InitPropertySet(const std::string& name, const std::string& value) {
 
 uint32_t (*property_set)(const std::string& name, const std::string& value) = InitPropertySet;
 
-static void handle_property_set_fd() {
-    static constexpr uint32_t kDefaultSocketTimeout = 2000; /* ms */
+// Per-uid statistics of property set requests, logged once boot completes.
+struct PropertyClientStats {
+    uint64_t requests = 0;
+    uint64_t failures = 0;
+    std::chrono::microseconds total_time = 0us;
+    std::chrono::microseconds max_time = 0us;
+};
 
-    int s = accept4(property_set_fd, nullptr, nullptr, SOCK_CLOEXEC);
-    if (s == -1) {
-        return;
+static std::mutex client_stats_lock;
+static std::map<uid_t, PropertyClientStats> client_stats;
+
+static void RecordPropertyClient(uid_t uid, uint32_t result, std::chrono::microseconds time) {
+    auto guard = std::lock_guard{client_stats_lock};
+    auto& stats = client_stats[uid];
+    stats.requests++;
+    if (result != PROP_SUCCESS) {
+        stats.failures++;
     }
+    stats.total_time += time;
+    stats.max_time = std::max(stats.max_time, time);
+}
+
+static void LogPropertyClientStats() {
+    auto guard = std::lock_guard{client_stats_lock};
+    for (const auto& [uid, stats] : client_stats) {
+        LOG(INFO) << "Property set requests from uid " << uid << ": " << stats.requests
+                  << " (" << stats.failures << " failed), " << stats.total_time.count()
+                  << "us total, " << stats.max_time.count() << "us max";
+    }
+}
+
+static void HandlePropertyConnection(int s) {
+    static constexpr uint32_t kDefaultSocketTimeout = 2000; /* ms */
+
+    auto begin = std::chrono::steady_clock::now();
 
     ucred cr;
     socklen_t cr_size = sizeof(cr);
@@ -594,6 +632,9 @@ static void handle_property_set_fd() {
             LOG(ERROR) << "Unable to set property '" << prop_name << "' from uid:" << cr.uid
                        << " gid:" << cr.gid << " pid:" << cr.pid << ": " << error;
         }
+        RecordPropertyClient(cr.uid, result,
+                             std::chrono::duration_cast<std::chrono::microseconds>(
+                                     std::chrono::steady_clock::now() - begin));
 
         break;
       }
@@ -623,6 +664,12 @@ static void handle_property_set_fd() {
                        << " gid:" << cr.gid << " pid:" << cr.pid << ": " << error;
         }
         socket.SendUint32(result);
+        RecordPropertyClient(cr.uid, result,
+                             std::chrono::duration_cast<std::chrono::microseconds>(
+                                     std::chrono::steady_clock::now() - begin));
+        if (result == PROP_SUCCESS && name == "sys.boot_completed" && value == "1") {
+            LogPropertyClientStats();
+        }
         break;
       }
 
@@ -633,6 +680,56 @@ static void handle_property_set_fd() {
     }
 }
 
+// Receiving a request can take up to kDefaultSocketTimeout if the client is
+// slow, so connections are handed to a few worker threads, and one stalled
+// client no longer holds up everyone else's setprop.
+class PropertyConnectionPool {
+  public:
+    void Queue(int socket) {
+        auto guard = std::lock_guard{mutex_};
+        sockets_.emplace(socket);
+
+        if (!threads_started_) {
+            threads_started_ = true;
+            for (size_t i = 0; i < kThreads; i++) {
+                std::thread{&PropertyConnectionPool::ThreadFunction, this}.detach();
+            }
+        }
+        cv_.notify_one();
+    }
+
+  private:
+    static constexpr size_t kThreads = 4;
+
+    void ThreadFunction() {
+        auto lock = std::unique_lock{mutex_};
+        while (true) {
+            cv_.wait(lock, [this] { return !sockets_.empty(); });
+            int socket = sockets_.front();
+            sockets_.pop();
+
+            lock.unlock();
+            HandlePropertyConnection(socket);
+            lock.lock();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::queue<int> sockets_;
+    bool threads_started_ = false;
+};
+
+static void handle_property_set_fd() {
+    static PropertyConnectionPool pool;
+
+    int s = accept4(property_set_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (s == -1) {
+        return;
+    }
+    pool.Queue(s);
+}
+
 static bool load_properties_from_file(const char*, const char*,
                                       std::map<std::string, std::string>*);
 
@@ -1026,10 +1123,12 @@ static void HandleInitSocket() {
                                 persistent_property_record.value());
             }
             InitPropertySet("ro.persistent_properties.ready", "true");
+            auto guard = std::lock_guard{property_set_lock};
             persistent_properties_loaded = true;
             break;
         }
         case InitMessage::kStopSendingMessages: {
+            auto guard = std::lock_guard{property_set_lock};
             init_socket = -1;
             break;
         }
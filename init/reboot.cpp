@@ -31,6 +31,8 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 
+#include <atomic>
+#include <map>
 #include <memory>
 #include <set>
 #include <thread>
@@ -41,6 +43,7 @@
 #include <android-base/logging.h>
 #include <android-base/macros.h>
 #include <android-base/properties.h>
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <android-base/unique_fd.h>
 #include <bootloader_message/bootloader_message.h>
@@ -52,6 +55,7 @@
 
 #include "action_manager.h"
 #include "init.h"
+#include "persistent_properties.h"
 #include "property_service.h"
 #include "reboot_utils.h"
 #include "service.h"
@@ -62,6 +66,7 @@
 
 using namespace std::literals;
 
+using android::base::boot_clock;
 using android::base::GetBoolProperty;
 using android::base::Split;
 using android::base::Timer;
@@ -137,6 +142,20 @@ class MountEntry {
         return android::base::StartsWith(mntent.mnt_fsname, "/data/");
     }
 
+    // Whether this filesystem is mounted somewhere below |other|.
+    bool IsBelow(const MountEntry& other) const {
+        return android::base::StartsWith(mnt_dir_, other.mnt_dir_ + "/");
+    }
+
+    bool IsOn(const MountEntry& other) const { return mnt_dir_ == other.mnt_dir_; }
+
+    void Sync() const {
+        unique_fd fd(TEMP_FAILURE_RETRY(open(mnt_dir_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)));
+        if (fd < 0 || syncfs(fd) != 0) {
+            PLOG(WARNING) << "Cannot sync " << mnt_fsname_ << ":" << mnt_dir_;
+        }
+    }
+
   private:
     bool IsF2Fs() const { return mnt_type_ == "f2fs"; }
 
@@ -167,6 +186,41 @@ static void ShutdownVold() {
                             nullptr, nullptr, 0);
 }
 
+// Records how long each step of DoReboot took, so that the slow one can be
+// found from the last kernel log.
+class ShutdownPhases {
+  public:
+    void End(const char* phase) {
+        phases_.emplace_back(phase, timer_.duration());
+        timer_ = Timer();
+    }
+
+    void Log() const {
+        std::string breakdown;
+        for (const auto& [phase, duration] : phases_) {
+            breakdown += android::base::StringPrintf(" %s=%lldms", phase,
+                                                     static_cast<long long>(duration.count()));
+        }
+        LOG(INFO) << "Shutdown phases:" << breakdown;
+    }
+
+  private:
+    Timer timer_;
+    std::vector<std::pair<const char*, std::chrono::milliseconds>> phases_;
+};
+
+// Runs fn on every element of |items| with a thread each, and waits for them.
+template <typename T, typename F>
+static void ForEachInParallel(std::vector<T>& items, F fn) {
+    std::vector<std::thread> threads;
+    for (auto& item : items) {
+        threads.emplace_back([&fn, &item]() { fn(item); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
 static void LogShutdownTime(UmountStat stat, Timer* t) {
     LOG(WARNING) << "powerctl_shutdown_time_ms:" << std::to_string(t->duration().count()) << ":"
                  << stat;
@@ -230,7 +284,37 @@ static void DumpUmountDebuggingInfo() {
     WriteStringToFile("w", PROC_SYSRQ);
 }
 
-static UmountStat UmountPartitions(std::chrono::milliseconds timeout) {
+// Unmounts |entries| with a thread per filesystem. A filesystem is unmounted
+// only after the ones mounted below it, or on top of it, have been tried.
+static bool UmountInParallel(std::vector<MountEntry>* entries, bool force) {
+    // Entries come from /proc/mounts in reverse, so an entry that is on top of
+    // another one with the same mount point comes first.
+    std::vector<MountEntry*> pending;
+    for (auto& entry : *entries) {
+        pending.emplace_back(&entry);
+    }
+
+    std::atomic<bool> unmount_done(true);
+    while (!pending.empty()) {
+        std::vector<MountEntry*> batch;
+        std::vector<MountEntry*> later;
+        for (size_t i = 0; i < pending.size(); i++) {
+            bool blocked = false;
+            for (size_t j = 0; j < pending.size() && !blocked; j++) {
+                blocked = pending[j]->IsBelow(*pending[i]) ||
+                          (j < i && pending[j]->IsOn(*pending[i]));
+            }
+            (blocked ? later : batch).emplace_back(pending[i]);
+        }
+        ForEachInParallel(batch, [&unmount_done, force](MountEntry* entry) {
+            if (!entry->Umount(force)) unmount_done = false;
+        });
+        pending = std::move(later);
+    }
+    return unmount_done;
+}
+
+static UmountStat UmountPartitions(std::chrono::milliseconds timeout, bool parallel) {
     Timer t;
     /* data partition needs all pending writes to be completed and all emulated partitions
      * umounted.If the current waiting is not good enough, give
@@ -254,8 +338,12 @@ static UmountStat UmountPartitions(std::chrono::milliseconds timeout) {
                 sync();
             }
         }
-        for (auto& entry : block_devices) {
-            if (!entry.Umount(timeout == 0ms)) unmount_done = false;
+        if (parallel) {
+            if (!UmountInParallel(&block_devices, timeout == 0ms)) unmount_done = false;
+        } else {
+            for (auto& entry : block_devices) {
+                if (!entry.Umount(timeout == 0ms)) unmount_done = false;
+            }
         }
         if (unmount_done) {
             return UMOUNT_STAT_SUCCESS;
@@ -366,7 +454,8 @@ void RebootMonitorThread(unsigned int cmd, const std::string& rebootTarget, sem_
  * return true when umount was successful. false when timed out.
  */
 static UmountStat TryUmountAndFsck(unsigned int cmd, const std::string& rebootTarget, bool runFsck,
-                                   std::chrono::milliseconds timeout, sem_t* reboot_semaphore) {
+                                   std::chrono::milliseconds timeout, sem_t* reboot_semaphore,
+                                   bool parallel, ShutdownPhases* phases) {
     Timer t;
     std::vector<MountEntry> block_devices;
     std::vector<MountEntry> emulated_devices;
@@ -375,15 +464,16 @@ static UmountStat TryUmountAndFsck(unsigned int cmd, const std::string& rebootTa
         return UMOUNT_STAT_ERROR;
     }
 
-    UmountStat stat = UmountPartitions(timeout - t.duration());
+    UmountStat stat = UmountPartitions(timeout - t.duration(), parallel);
     if (stat != UMOUNT_STAT_SUCCESS) {
         LOG(INFO) << "umount timeout, last resort, kill all and try";
         if (DUMP_ON_UMOUNT_FAILURE) DumpUmountDebuggingInfo();
         KillAllProcesses();
         // even if it succeeds, still it is timeout and do not run fsck with all processes killed
-        UmountStat st = UmountPartitions(0ms);
+        UmountStat st = UmountPartitions(0ms, parallel);
         if ((st != UMOUNT_STAT_SUCCESS) && DUMP_ON_UMOUNT_FAILURE) DumpUmountDebuggingInfo();
     }
+    phases->End("umount");
 
     if (stat == UMOUNT_STAT_SUCCESS && runFsck) {
         LOG(INFO) << "Pause reboot monitor thread before fsck";
@@ -391,12 +481,17 @@ static UmountStat TryUmountAndFsck(unsigned int cmd, const std::string& rebootTa
 
         // fsck part is excluded from timeout check. It only runs for user initiated shutdown
         // and should not affect reboot time.
-        for (auto& entry : block_devices) {
-            entry.DoFsck();
+        if (parallel) {
+            ForEachInParallel(block_devices, [](MountEntry& entry) { entry.DoFsck(); });
+        } else {
+            for (auto& entry : block_devices) {
+                entry.DoFsck();
+            }
         }
 
         LOG(INFO) << "Resume reboot monitor thread after fsck";
         sem_post(reboot_semaphore);
+        phases->End("fsck");
     }
     return stat;
 }
@@ -443,6 +538,55 @@ static void KillZramBackingDevice() {
     LOG(INFO) << "zram_backing_dev: `" << backing_dev << "` is cleared successfully.";
 }
 
+// Counts the services in |names| that are still running. The console is not
+// counted as it ignores SIGTERM and won't exit.
+// Note: SVC_CONSOLE actually means "requires console" but it is only used by the shell.
+static int CountRunningServices(const std::set<std::string>& names) {
+    int service_count = 0;
+    for (const auto& s : ServiceList::GetInstance()) {
+        if (names.count(s->name()) && s->pid() != 0 && (s->flags() & SVC_CONSOLE) == 0) {
+            service_count++;
+        }
+    }
+    return service_count;
+}
+
+// Terminates the services that aren't shutdown critical a batch at a time, and
+// returns how many are still running at |deadline|. Services are batched by
+// their first class, and the batches are terminated in the reverse order of
+// when their class was last started, so that late_start services go before
+// main, and main before core and hal. The next batch is signalled as soon as
+// the previous one has exited, or its share of the time until |deadline| is
+// up, whichever is first.
+static int TerminateServicesInBatches(boot_clock::time_point deadline) {
+    std::vector<std::set<std::string>> batches;
+    std::map<std::string, size_t> class_batches;
+    for (const auto& s : ServiceList::GetInstance().services_in_shutdown_order()) {
+        if (s->IsShutdownCritical()) continue;
+        std::string classname = s->classnames().empty() ? "" : *s->classnames().begin();
+        auto [it, inserted] = class_batches.emplace(classname, batches.size());
+        if (inserted) batches.emplace_back();
+        batches[it->second].emplace(s->name());
+    }
+
+    std::set<std::string> all;
+    auto start = boot_clock::now();
+    for (size_t i = 0; i < batches.size(); i++) {
+        for (const auto& s : ServiceList::GetInstance().services_in_shutdown_order()) {
+            if (batches[i].count(s->name())) s->Terminate();
+        }
+        all.insert(batches[i].begin(), batches[i].end());
+
+        auto batch_deadline = start + (deadline - start) * (i + 1) / batches.size();
+        while (boot_clock::now() < batch_deadline) {
+            ReapAnyOutstandingChildren();
+            if (CountRunningServices(all) == 0) break;
+            std::this_thread::sleep_for(10ms);
+        }
+    }
+    return CountRunningServices(all);
+}
+
 //* Reboot / shutdown the system.
 // cmd ANDROID_RB_* as defined in android_reboot.h
 // reason Reason string like "reboot", "shutdown,userrequested"
@@ -453,6 +597,7 @@ static void KillZramBackingDevice() {
 static void DoReboot(unsigned int cmd, const std::string& reason, const std::string& rebootTarget,
                      bool runFsck) {
     Timer t;
+    ShutdownPhases phases;
     LOG(INFO) << "Reboot start, reason: " << reason << ", rebootTarget: " << rebootTarget;
 
     // If /data isn't mounted then we can skip the extra reboot steps below, since we don't need to
@@ -473,6 +618,8 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
         skip = strlen("reboot,");
     }
     property_set(LAST_REBOOT_REASON_PROPERTY, reason.c_str() + skip);
+    // The reason above is itself persistent, so flush after setting it.
+    FlushPersistentProperties();
     sync();
 
     bool is_thermal_shutdown = cmd == ANDROID_RB_THERMOFF;
@@ -489,6 +636,9 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
         shutdown_timeout = std::chrono::seconds(shutdown_timeout_final);
     }
     LOG(INFO) << "Shutdown timeout: " << shutdown_timeout.count() << " ms";
+    // Every step below runs against the same deadline, counted from the start
+    // of DoReboot, except for fsck.
+    bool parallel = GetBoolProperty("ro.init.shutdown_parallel", false);
 
     sem_t reboot_semaphore;
     if (sem_init(&reboot_semaphore, false, 0) == -1) {
@@ -565,9 +715,18 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
         }
     }
 
+    phases.End("prepare");
+
     // optional shutdown step
     // 1. terminate all services except shutdown critical ones. wait for delay to finish
-    if (shutdown_timeout > 0ms) {
+    if (shutdown_timeout > 0ms && parallel) {
+        LOG(INFO) << "terminating init services in batches";
+        // Only wait up to half of timeout here
+        int service_count = TerminateServicesInBatches(
+                boot_clock::now() + (shutdown_timeout / 2 - t.duration()));
+        LOG(INFO) << "Terminating running services took " << t
+                  << " with remaining services:" << service_count;
+    } else if (shutdown_timeout > 0ms) {
         LOG(INFO) << "terminating init services";
 
         // Ask all services to terminate except shutdown critical ones.
@@ -604,6 +763,7 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
         LOG(INFO) << "Terminating running services took " << t
                   << " with remaining services:" << service_count;
     }
+    phases.End("terminate");
 
     // minimum safety steps before restarting
     // 2. kill all services except ones that are necessary for the shutdown sequence.
@@ -612,6 +772,7 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
     }
     SubcontextTerminate();
     ReapAnyOutstandingChildren();
+    phases.End("kill");
 
     // 3. send volume shutdown to vold
     Service* voldService = ServiceList::GetInstance().FindService("vold");
@@ -625,18 +786,30 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
     for (const auto& s : ServiceList::GetInstance().services_in_shutdown_order()) {
         if (kill_after_apps.count(s->name())) s->Stop();
     }
+    phases.End("vold");
     // 4. sync, try umount, and optionally run fsck for user shutdown
     {
         Timer sync_timer;
         LOG(INFO) << "sync() before umount...";
+        if (parallel) {
+            // Wait for each filesystem's writeback on its own thread, the sync()
+            // below then only has to cover what isn't a block device.
+            std::vector<MountEntry> block_devices;
+            std::vector<MountEntry> emulated_devices;
+            if (FindPartitionsToUmount(&block_devices, &emulated_devices, false)) {
+                ForEachInParallel(block_devices, [](MountEntry& entry) { entry.Sync(); });
+            }
+        }
         sync();
         LOG(INFO) << "sync() before umount took" << sync_timer;
     }
+    phases.End("sync");
     // 5. drop caches and disable zram backing device, if exist
     KillZramBackingDevice();
+    phases.End("zram");
 
     UmountStat stat = TryUmountAndFsck(cmd, rebootTarget, runFsck, shutdown_timeout - t.duration(),
-                                       &reboot_semaphore);
+                                       &reboot_semaphore, parallel, &phases);
     // Follow what linux shutdown is doing: one more sync with little bit delay
     {
         Timer sync_timer;
@@ -645,6 +818,8 @@ static void DoReboot(unsigned int cmd, const std::string& reason, const std::str
         LOG(INFO) << "sync() after umount took" << sync_timer;
     }
     if (!is_thermal_shutdown) std::this_thread::sleep_for(100ms);
+    phases.End("final sync");
+    phases.Log();
     LogShutdownTime(stat, &t);
 
     // Send signal to terminate reboot monitor thread.
@@ -749,8 +924,9 @@ bool HandlePowerctlMessage(const std::string& command) {
     };
     ActionManager::GetInstance().QueueBuiltinAction(shutdown_handler, "shutdown_done");
 
-    // Skip wait for prop if it is in progress
+    // Skip wait for prop or file if it is in progress
     ResetWaitForProp();
+    ResetWaitForFile();
 
     // Clear EXEC flag if there is one pending
     for (const auto& s : ServiceList::GetInstance()) {
@@ -16,6 +16,9 @@
 
 #include "selabel.h"
 
+#include <mutex>
+#include <unordered_map>
+
 #include <selinux/android.h>
 
 namespace android {
@@ -24,8 +27,29 @@ namespace init {
 namespace {
 
 selabel_handle* sehandle = nullptr;
+
+// ueventd looks up the labels of the same device nodes over and over, e.g. as USB devices come and
+// go, and with regex-heavy file_contexts each selabel_lookup_best_match() is expensive. Its result
+// only depends on its arguments and the loaded file_contexts, so successful lookups are kept here,
+// up to kMaxBestMatchCacheEntries of them.
+constexpr size_t kMaxBestMatchCacheEntries = 1024;
+std::mutex best_match_cache_lock;
+std::unordered_map<std::string, std::string> best_match_cache;
+
+std::string BestMatchCacheKey(const std::string& key, const std::vector<std::string>& aliases,
+                              int type) {
+    std::string cache_key = std::to_string(type);
+    cache_key += '\0';
+    cache_key += key;
+    for (const auto& alias : aliases) {
+        cache_key += '\0';
+        cache_key += alias;
+    }
+    return cache_key;
 }
 
+}  // namespace
+
 // selinux_android_file_context_handle() takes on the order of 10+ms to run, so we want to cache
 // its value.  selinux_android_restorecon() also needs an sehandle for file context look up.  It
 // will create and store its own copy, but selinux_android_set_sehandle() can be used to provide
@@ -33,6 +57,9 @@ selabel_handle* sehandle = nullptr;
 void SelabelInitialize() {
     sehandle = selinux_android_file_context_handle();
     selinux_android_set_sehandle(sehandle);
+
+    std::lock_guard<std::mutex> lock(best_match_cache_lock);
+    best_match_cache.clear();
 }
 
 // A C++ wrapper around selabel_lookup() using the cached sehandle.
@@ -60,6 +87,15 @@ bool SelabelLookupFileContextBestMatch(const std::string& key,
 
     if (!sehandle) return true;
 
+    auto cache_key = BestMatchCacheKey(key, aliases, type);
+    {
+        std::lock_guard<std::mutex> lock(best_match_cache_lock);
+        if (auto it = best_match_cache.find(cache_key); it != best_match_cache.end()) {
+            *result = it->second;
+            return true;
+        }
+    }
+
     std::vector<const char*> c_aliases;
     for (const auto& alias : aliases) {
         c_aliases.emplace_back(alias.c_str());
@@ -72,6 +108,12 @@ bool SelabelLookupFileContextBestMatch(const std::string& key,
     }
     *result = context;
     free(context);
+
+    std::lock_guard<std::mutex> lock(best_match_cache_lock);
+    if (best_match_cache.size() >= kMaxBestMatchCacheEntries) {
+        best_match_cache.clear();
+    }
+    best_match_cache.emplace(std::move(cache_key), *result);
     return true;
 }
 
@@ -26,6 +26,10 @@
 #include <termios.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
@@ -36,6 +40,7 @@
 #include <processgroup/processgroup.h>
 #include <selinux/selinux.h>
 
+#include "boot_trace.h"
 #include "service_list.h"
 #include "util.h"
 
@@ -239,6 +244,8 @@ void Service::SetProcessAttributesAndCaps() {
 }
 
 void Service::Reap(const siginfo_t& siginfo) {
+    BootTrace::GetInstance().Record(BootTraceEvent::kServiceExit, name_, pid_);
+
     if (!(flags_ & SVC_ONESHOT) || (flags_ & SVC_RESTART)) {
         KillProcessGroup(SIGKILL);
     }
@@ -370,6 +377,10 @@ Result<void> Service::Start() {
         }
     });
 
+    // A precomputed context is only good for the start it was computed for.
+    auto precomputed_context = std::move(precomputed_context_);
+    precomputed_context_.reset();
+
     if (is_updatable() && !ServiceList::GetInstance().IsServicesUpdated()) {
         ServiceList::GetInstance().DelayService(*this);
         return Error() << "Cannot start an updatable service '" << name_
@@ -422,7 +433,8 @@ Result<void> Service::Start() {
     if (!seclabel_.empty()) {
         scon = seclabel_;
     } else {
-        auto result = ComputeContextFromExecutable(args_[0]);
+        auto result = precomputed_context ? std::move(*precomputed_context)
+                                          : ComputeContextFromExecutable(args_[0]);
         if (!result) {
             return result.error();
         }
@@ -511,6 +523,7 @@ Result<void> Service::Start() {
 
     time_started_ = boot_clock::now();
     pid_ = pid;
+    BootTrace::GetInstance().Record(BootTraceEvent::kServiceFork, name_, pid_);
     flags_ |= SVC_RUNNING;
     start_order_ = next_start_order_++;
     process_cgroup_empty_ = false;
@@ -576,6 +589,40 @@ Result<void> Service::StartIfNotDisabled() {
     return {};
 }
 
+void Service::PrecomputeContexts(const std::vector<Service*>& services) {
+    static constexpr size_t kMaxThreads = 4;
+
+    std::vector<Service*> pending;
+    for (auto* service : services) {
+        if (service->seclabel_.empty() && !(service->flags_ & (SVC_RUNNING | SVC_DISABLED))) {
+            pending.emplace_back(service);
+        }
+    }
+    if (pending.size() < 2) {
+        return;
+    }
+
+    // libselinux caches class lookups without locking; fill the cache on
+    // this thread before the workers need it.
+    string_to_security_class("process");
+
+    std::atomic<size_t> next = 0;
+    auto worker = [&pending, &next] {
+        for (size_t i = next++; i < pending.size(); i = next++) {
+            pending[i]->precomputed_context_ =
+                    ComputeContextFromExecutable(pending[i]->args_[0]);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(kMaxThreads, pending.size()); i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
 Result<void> Service::Enable() {
     flags_ &= ~(SVC_DISABLED | SVC_RC_DISABLED);
     if (flags_ & SVC_DISABLED_START) {
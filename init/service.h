@@ -79,6 +79,10 @@ class Service {
     Result<void> Start();
     Result<void> StartIfNotDisabled();
     Result<void> StartIfPostData();
+    // Compute the SELinux contexts that Start() would otherwise compute one
+    // service at a time, in parallel for all of |services| that are about to
+    // be started. Each service's next Start() uses and discards the result.
+    static void PrecomputeContexts(const std::vector<Service*>& services);
     Result<void> Enable();
     void Reset();
     void ResetIfPostData();
@@ -151,6 +155,7 @@ class Service {
     NamespaceInfo namespaces_;
 
     std::string seclabel_;
+    std::optional<Result<std::string>> precomputed_context_;
 
     std::vector<SocketDescriptor> sockets_;
     std::vector<FileDescriptor> files_;
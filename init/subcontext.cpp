@@ -20,6 +20,7 @@
 #include <poll.h>
 #include <unistd.h>
 
+#include <android-base/chrono_utils.h>
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
@@ -46,11 +47,16 @@ using android::base::Socketpair;
 using android::base::Split;
 using android::base::StartsWith;
 using android::base::unique_fd;
+using namespace std::chrono_literals;
 
 namespace android {
 namespace init {
 namespace {
 
+// Room left in a batch reply for the reply to one more command. Replies are bounded by kBufferSize,
+// so a batch stops early rather than risk a reply that cannot be sent.
+constexpr size_t kBatchReplyReserve = 1024;
+
 class SubcontextProcess {
   public:
     SubcontextProcess(const BuiltinFunctionMap* function_map, std::string context, int init_fd)
@@ -60,6 +66,8 @@ class SubcontextProcess {
   private:
     void RunCommand(const SubcontextCommand::ExecuteCommand& execute_command,
                     SubcontextReply* reply) const;
+    void RunCommandBatch(const SubcontextCommand::ExecuteBatchCommand& execute_batch_command,
+                         SubcontextReply* reply) const;
     void ExpandArgs(const SubcontextCommand::ExpandArgsCommand& expand_args_command,
                     SubcontextReply* reply) const;
 
@@ -93,6 +101,21 @@ void SubcontextProcess::RunCommand(const SubcontextCommand::ExecuteCommand& exec
     }
 }
 
+void SubcontextProcess::RunCommandBatch(
+        const SubcontextCommand::ExecuteBatchCommand& execute_batch_command,
+        SubcontextReply* reply) const {
+    auto* execute_batch_reply = reply->mutable_execute_batch_reply();
+    for (const auto& execute_command : execute_batch_command.commands()) {
+        if (execute_batch_reply->replies_size() > 0 &&
+            reply->ByteSizeLong() > kBufferSize - kBatchReplyReserve) {
+            break;
+        }
+        android::base::Timer t;
+        RunCommand(execute_command, execute_batch_reply->add_replies());
+        execute_batch_reply->add_durations_ms(t.duration().count());
+    }
+}
+
 void SubcontextProcess::ExpandArgs(const SubcontextCommand::ExpandArgsCommand& expand_args_command,
                                    SubcontextReply* reply) const {
     for (const auto& arg : expand_args_command.args()) {
@@ -144,6 +167,10 @@ void SubcontextProcess::MainLoop() {
                 RunCommand(subcontext_command.execute_command(), &reply);
                 break;
             }
+            case SubcontextCommand::kExecuteBatchCommand: {
+                RunCommandBatch(subcontext_command.execute_batch_command(), &reply);
+                break;
+            }
             case SubcontextCommand::kExpandArgsCommand: {
                 ExpandArgs(subcontext_command.expand_args_command(), &reply);
                 break;
@@ -237,6 +264,20 @@ bool Subcontext::PathMatchesSubcontext(const std::string& path) {
     return false;
 }
 
+static Result<void> ExecuteReplyToResult(const SubcontextReply& subcontext_reply) {
+    if (subcontext_reply.reply_case() == SubcontextReply::kFailure) {
+        auto& failure = subcontext_reply.failure();
+        return ResultError(failure.error_string(), failure.error_errno());
+    }
+
+    if (subcontext_reply.reply_case() != SubcontextReply::kSuccess) {
+        return Error() << "Unexpected message type from subcontext: "
+                       << subcontext_reply.reply_case();
+    }
+
+    return {};
+}
+
 Result<SubcontextReply> Subcontext::TransmitMessage(const SubcontextCommand& subcontext_command) {
     if (auto result = SendMessage(socket_, subcontext_command); !result) {
         Restart();
@@ -268,17 +309,59 @@ Result<void> Subcontext::Execute(const std::vector<std::string>& args) {
         return subcontext_reply.error();
     }
 
-    if (subcontext_reply->reply_case() == SubcontextReply::kFailure) {
-        auto& failure = subcontext_reply->failure();
-        return ResultError(failure.error_string(), failure.error_errno());
-    }
+    return ExecuteReplyToResult(*subcontext_reply);
+}
 
-    if (subcontext_reply->reply_case() != SubcontextReply::kSuccess) {
-        return Error() << "Unexpected message type from subcontext: "
-                       << subcontext_reply->reply_case();
-    }
+std::vector<SubcontextCommandResult> Subcontext::ExecuteBatch(
+        const std::vector<std::vector<std::string>>& commands) {
+    auto results = std::vector<SubcontextCommandResult>{};
+    auto fail_remaining = [&results, &commands](const Result<void>& error) {
+        while (results.size() < commands.size()) {
+            results.push_back({error, 0ms});
+        }
+    };
 
-    return {};
+    while (results.size() < commands.size()) {
+        // Send as many of the remaining commands as fit in one message.
+        auto subcontext_command = SubcontextCommand{};
+        auto* execute_batch_command = subcontext_command.mutable_execute_batch_command();
+        for (size_t i = results.size(); i < commands.size(); ++i) {
+            auto* execute_command = execute_batch_command->add_commands();
+            std::copy(commands[i].begin(), commands[i].end(),
+                      RepeatedPtrFieldBackInserter(execute_command->mutable_args()));
+            if (execute_batch_command->commands_size() > 1 &&
+                subcontext_command.ByteSizeLong() > kBufferSize) {
+                execute_batch_command->mutable_commands()->RemoveLast();
+                break;
+            }
+        }
+
+        auto subcontext_reply = TransmitMessage(subcontext_command);
+        if (!subcontext_reply) {
+            fail_remaining(subcontext_reply.error());
+            break;
+        }
+
+        if (subcontext_reply->reply_case() != SubcontextReply::kExecuteBatchReply) {
+            fail_remaining(Error() << "Unexpected message type from subcontext: "
+                                   << subcontext_reply->reply_case());
+            break;
+        }
+
+        auto& execute_batch_reply = subcontext_reply->execute_batch_reply();
+        if (execute_batch_reply.replies_size() == 0 ||
+            execute_batch_reply.replies_size() > execute_batch_command->commands_size() ||
+            execute_batch_reply.durations_ms_size() != execute_batch_reply.replies_size()) {
+            fail_remaining(Error() << "Malformed batch reply from subcontext");
+            break;
+        }
+
+        for (int i = 0; i < execute_batch_reply.replies_size(); ++i) {
+            results.push_back({ExecuteReplyToResult(execute_batch_reply.replies(i)),
+                               std::chrono::milliseconds(execute_batch_reply.durations_ms(i))});
+        }
+    }
+    return results;
 }
 
 Result<std::vector<std::string>> Subcontext::ExpandArgs(const std::vector<std::string>& args) {
@@ -18,6 +18,7 @@
 
 #include <signal.h>
 
+#include <chrono>
 #include <string>
 #include <vector>
 
@@ -33,6 +34,11 @@ namespace init {
 static constexpr const char kInitContext[] = "u:r:init:s0";
 static constexpr const char kVendorContext[] = "u:r:vendor_init:s0";
 
+struct SubcontextCommandResult {
+    Result<void> result;
+    std::chrono::milliseconds duration;
+};
+
 class Subcontext {
   public:
     Subcontext(std::vector<std::string> path_prefixes, std::string context)
@@ -41,6 +47,10 @@ class Subcontext {
     }
 
     Result<void> Execute(const std::vector<std::string>& args);
+    // Runs each of the commands in turn, using as few round trips to the subcontext as will fit
+    // them, and returns one result per command.
+    std::vector<SubcontextCommandResult> ExecuteBatch(
+            const std::vector<std::vector<std::string>>& commands);
     Result<std::vector<std::string>> ExpandArgs(const std::vector<std::string>& args);
     void Restart();
     bool PathMatchesSubcontext(const std::string& path);
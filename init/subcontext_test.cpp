@@ -120,6 +120,29 @@ TEST(subcontext, MultipleCommands) {
     });
 }
 
+TEST(subcontext, ExecuteBatch) {
+    RunTest([](auto& subcontext, auto& context_string) {
+        auto first_pid = subcontext.pid();
+
+        // Enough commands that they do not fit in one message.
+        auto expected_words = std::vector<std::string>(300, "w");
+        auto commands = std::vector<std::vector<std::string>>{};
+        for (const auto& word : expected_words) {
+            commands.emplace_back(std::vector<std::string>{"add_word", word});
+        }
+        commands.emplace_back(std::vector<std::string>{"return_words_as_error"});
+
+        auto results = subcontext.ExecuteBatch(commands);
+        ASSERT_EQ(commands.size(), results.size());
+        for (size_t i = 0; i < expected_words.size(); ++i) {
+            ASSERT_TRUE(results[i].result) << i << ": " << results[i].result.error();
+        }
+        ASSERT_FALSE(results.back().result);
+        EXPECT_EQ(Join(expected_words, " "), results.back().result.error().message());
+        EXPECT_EQ(first_pid, subcontext.pid());
+    });
+}
+
 TEST(subcontext, RecoverAfterAbort) {
     RunTest([](auto& subcontext, auto& context_string) {
         auto first_pid = subcontext.pid();
@@ -183,7 +206,7 @@ BuiltinFunctionMap BuildTestFunctionMap() {
         return Result<void>{};
     };
 
-    // For MultipleCommands
+    // For MultipleCommands and ExecuteBatch
     // Using a shared_ptr to extend lifetime of words to both lambdas
     auto words = std::make_shared<std::vector<std::string>>();
     auto do_add_word = [words](const BuiltinArguments& args) {
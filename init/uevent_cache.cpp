@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "uevent_cache.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <android-base/properties.h>
+
+#include "system/core/init/uevent_cache.pb.h"
+#include "util.h"
+
+namespace android {
+namespace init {
+
+std::string UeventCacheKey() {
+    std::string key = android::base::GetProperty("ro.build.fingerprint", "");
+    struct utsname uts;
+    if (uname(&uts) == 0) {
+        key += std::string("|") + uts.release + "|" + uts.version;
+    }
+    return key;
+}
+
+Result<std::vector<Uevent>> ReadUeventCache(const std::string& path, const std::string& key) {
+    auto contents = ReadFile(path);
+    if (!contents) {
+        return contents.error();
+    }
+
+    UeventCache cache;
+    if (!cache.ParseFromString(*contents)) {
+        return Error() << "Unable to parse uevent cache";
+    }
+    if (cache.key() != key) {
+        return Error() << "Uevent cache is for a different build or kernel";
+    }
+
+    std::vector<Uevent> uevents;
+    for (const auto& cached : cache.uevents()) {
+        Uevent& uevent = uevents.emplace_back();
+        uevent.action = cached.action();
+        uevent.path = cached.path();
+        uevent.subsystem = cached.subsystem();
+        uevent.partition_name = cached.partition_name();
+        uevent.device_name = cached.device_name();
+        uevent.modalias = cached.modalias();
+        uevent.partition_num = cached.partition_num();
+        uevent.major = cached.major();
+        uevent.minor = cached.minor();
+    }
+    return uevents;
+}
+
+Result<void> WriteUeventCache(const std::string& path, const std::string& key,
+                              const std::vector<Uevent>& uevents) {
+    UeventCache cache;
+    cache.set_key(key);
+    for (const auto& uevent : uevents) {
+        auto* cached = cache.add_uevents();
+        cached->set_action(uevent.action);
+        cached->set_path(uevent.path);
+        cached->set_subsystem(uevent.subsystem);
+        cached->set_partition_name(uevent.partition_name);
+        cached->set_device_name(uevent.device_name);
+        cached->set_modalias(uevent.modalias);
+        cached->set_partition_num(uevent.partition_num);
+        cached->set_major(uevent.major);
+        cached->set_minor(uevent.minor);
+    }
+
+    std::string contents;
+    if (!cache.SerializeToString(&contents)) {
+        return Error() << "Unable to serialize uevent cache";
+    }
+
+    const std::string temp_path = path + ".tmp";
+    if (auto result = WriteFile(temp_path, contents); !result) {
+        return result.error();
+    }
+    if (rename(temp_path.c_str(), path.c_str()) != 0) {
+        int saved_errno = errno;
+        unlink(temp_path.c_str());
+        return Error(saved_errno) << "Unable to rename uevent cache";
+    }
+    return {};
+}
+
+}  // namespace init
+}  // namespace android
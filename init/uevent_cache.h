@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "result.h"
+#include "uevent.h"
+
+namespace android {
+namespace init {
+
+// The uevents that a cold boot regenerated, saved so that the next cold boot with the same build
+// and kernel can handle them without asking the kernel for them again.
+
+// Identifies the build and kernel, as a cache is only valid for the ones that wrote it.
+std::string UeventCacheKey();
+
+// Returns an error with code ENOENT if there is no cache at path.
+Result<std::vector<Uevent>> ReadUeventCache(const std::string& path, const std::string& key);
+Result<void> WriteUeventCache(const std::string& path, const std::string& key,
+                              const std::vector<Uevent>& uevents);
+
+}  // namespace init
+}  // namespace android
@@ -19,6 +19,7 @@
 #include <fcntl.h>
 #include <poll.h>
 #include <string.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <memory>
@@ -95,28 +96,48 @@ UeventListener::UeventListener(size_t uevent_socket_rcvbuf_size) {
     fcntl(device_fd_, F_SETFL, O_NONBLOCK);
 }
 
-bool UeventListener::ReadUevent(Uevent* uevent) const {
-    char msg[UEVENT_MSG_LEN + 2];
-    int n = uevent_kernel_multicast_recv(device_fd_, msg, UEVENT_MSG_LEN);
-    if (n <= 0) {
-        if (errno != EAGAIN && errno != EWOULDBLOCK) {
-            LOG(ERROR) << "Error reading from Uevent Fd";
-        }
-        return false;
-    }
-    if (n >= UEVENT_MSG_LEN) {
-        LOG(ERROR) << "Uevent overflowed buffer, discarding";
-        // Return true here even if we discard as we may have more uevents pending and we
-        // want to keep processing them.
-        return true;
+// Drains the socket in batches of messages, each received into its own slot, and passes every
+// uevent to |callback| until it asks to stop.
+ListenerAction UeventListener::ReadUevents(const ListenerCallback& callback) const {
+    static constexpr size_t kBatchSize = 16;
+    static_assert(kBatchSize <= UEVENT_MAX_BATCH);
+
+    char msgs[kBatchSize][UEVENT_MSG_LEN + 2];
+    iovec iovs[kBatchSize];
+    ssize_t lengths[kBatchSize];
+    for (size_t i = 0; i < kBatchSize; i++) {
+        iovs[i].iov_base = msgs[i];
+        iovs[i].iov_len = UEVENT_MSG_LEN;
     }
 
-    msg[n] = '\0';
-    msg[n + 1] = '\0';
+    Uevent uevent;
+    while (true) {
+        int n = uevent_kernel_recv_batch(device_fd_, iovs, lengths, kBatchSize, true);
+        if (n <= 0) {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG(ERROR) << "Error reading from Uevent Fd";
+            }
+            return ListenerAction::kContinue;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (lengths[i] < 0) {
+                LOG(ERROR) << "Error reading from Uevent Fd";
+                continue;
+            }
+            if (lengths[i] >= UEVENT_MSG_LEN) {
+                // Keep processing the rest of the batch, and whatever is still pending.
+                LOG(ERROR) << "Uevent overflowed buffer, discarding";
+                continue;
+            }
 
-    ParseEvent(msg, uevent);
+            msgs[i][lengths[i]] = '\0';
+            msgs[i][lengths[i] + 1] = '\0';
 
-    return true;
+            ParseEvent(msgs[i], &uevent);
+            if (callback(uevent) == ListenerAction::kStop) return ListenerAction::kStop;
+        }
+    }
 }
 
 // RegenerateUevents*() walks parts of the /sys tree and pokes the uevent files to cause the kernel
@@ -126,20 +147,20 @@ bool UeventListener::ReadUevent(Uevent* uevent) const {
 // We drain any pending events from the netlink socket every time we poke another uevent file to
 // make sure we don't overrun the socket's buffer.
 //
+// If skip is set, devices for which it returns true are not poked, though their children still are.
+//
 
-ListenerAction UeventListener::RegenerateUeventsForDir(DIR* d,
-                                                       const ListenerCallback& callback) const {
+ListenerAction UeventListener::RegenerateUeventsForDir(DIR* d, const std::string& path,
+                                                       const ListenerCallback& callback,
+                                                       const RegenerateFilter& skip) const {
     int dfd = dirfd(d);
 
-    int fd = openat(dfd, "uevent", O_WRONLY | O_CLOEXEC);
+    int fd = (skip && skip(path)) ? -1 : openat(dfd, "uevent", O_WRONLY | O_CLOEXEC);
     if (fd >= 0) {
         write(fd, "add\n", 4);
         close(fd);
 
-        Uevent uevent;
-        while (ReadUevent(&uevent)) {
-            if (callback(uevent) == ListenerAction::kStop) return ListenerAction::kStop;
-        }
+        if (ReadUevents(callback) == ListenerAction::kStop) return ListenerAction::kStop;
     }
 
     dirent* de;
@@ -153,7 +174,8 @@ ListenerAction UeventListener::RegenerateUeventsForDir(DIR* d,
         if (d2 == 0) {
             close(fd);
         } else {
-            if (RegenerateUeventsForDir(d2.get(), callback) == ListenerAction::kStop) {
+            if (RegenerateUeventsForDir(d2.get(), path + "/" + de->d_name, callback, skip) ==
+                ListenerAction::kStop) {
                 return ListenerAction::kStop;
             }
         }
@@ -164,18 +186,20 @@ ListenerAction UeventListener::RegenerateUeventsForDir(DIR* d,
 }
 
 ListenerAction UeventListener::RegenerateUeventsForPath(const std::string& path,
-                                                        const ListenerCallback& callback) const {
+                                                        const ListenerCallback& callback,
+                                                        const RegenerateFilter& skip) const {
     std::unique_ptr<DIR, decltype(&closedir)> d(opendir(path.c_str()), closedir);
     if (!d) return ListenerAction::kContinue;
 
-    return RegenerateUeventsForDir(d.get(), callback);
+    return RegenerateUeventsForDir(d.get(), path, callback, skip);
 }
 
 static const char* kRegenerationPaths[] = {"/sys/devices"};
 
-void UeventListener::RegenerateUevents(const ListenerCallback& callback) const {
+void UeventListener::RegenerateUevents(const ListenerCallback& callback,
+                                       const RegenerateFilter& skip) const {
     for (const auto path : kRegenerationPaths) {
-        if (RegenerateUeventsForPath(path, callback) == ListenerAction::kStop) return;
+        if (RegenerateUeventsForPath(path, callback, skip) == ListenerAction::kStop) return;
     }
 }
 
@@ -211,10 +235,7 @@ void UeventListener::Poll(const ListenerCallback& callback,
         if (ufd.revents & POLLIN) {
             // We're non-blocking, so if we receive a poll event keep processing until
             // we have exhausted all uevent messages.
-            Uevent uevent;
-            while (ReadUevent(&uevent)) {
-                if (callback(uevent) == ListenerAction::kStop) return;
-            }
+            if (ReadUevents(callback) == ListenerAction::kStop) return;
         }
     }
 }
@@ -22,6 +22,7 @@
 #include <chrono>
 #include <functional>
 #include <optional>
+#include <string>
 
 #include <android-base/unique_fd.h>
 
@@ -38,20 +39,26 @@ enum class ListenerAction {
 };
 
 using ListenerCallback = std::function<ListenerAction(const Uevent&)>;
+// Given the /sys path of a device, returns true if its uevent should not be regenerated.
+using RegenerateFilter = std::function<bool(const std::string&)>;
 
 class UeventListener {
   public:
     UeventListener(size_t uevent_socket_rcvbuf_size);
 
-    void RegenerateUevents(const ListenerCallback& callback) const;
+    void RegenerateUevents(const ListenerCallback& callback,
+                           const RegenerateFilter& skip = nullptr) const;
     ListenerAction RegenerateUeventsForPath(const std::string& path,
-                                            const ListenerCallback& callback) const;
+                                            const ListenerCallback& callback,
+                                            const RegenerateFilter& skip = nullptr) const;
     void Poll(const ListenerCallback& callback,
               const std::optional<std::chrono::milliseconds> relative_timeout = {}) const;
 
   private:
-    bool ReadUevent(Uevent* uevent) const;
-    ListenerAction RegenerateUeventsForDir(DIR* d, const ListenerCallback& callback) const;
+    ListenerAction ReadUevents(const ListenerCallback& callback) const;
+    ListenerAction RegenerateUeventsForDir(DIR* d, const std::string& path,
+                                           const ListenerCallback& callback,
+                                           const RegenerateFilter& skip) const;
 
     android::base::unique_fd device_fd_;
 };
@@ -27,12 +27,15 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <map>
 #include <set>
 #include <thread>
 
 #include <android-base/chrono_utils.h>
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
+#include <android-base/stringprintf.h>
 #include <fstab/fstab.h>
 #include <selinux/android.h>
 #include <selinux/selinux.h>
@@ -42,6 +45,7 @@
 #include "modalias_handler.h"
 #include "selabel.h"
 #include "selinux.h"
+#include "uevent_cache.h"
 #include "uevent_handler.h"
 #include "uevent_listener.h"
 #include "ueventd_parser.h"
@@ -101,6 +105,14 @@
 //
 // At this point, ueventd is single threaded, poll()'s and then handles any future uevents.
 
+// If ueventd.rc names a coldboot cache, step 1) is shortened: the uevents that the last cold boot of
+// the same build and kernel regenerated are read from the cache, and the /sys traversal only pokes
+// the uevent files of devices that are not in it, or whose major and minor numbers have changed.
+// Devices that have since disappeared are simply never found by the traversal.  The cached and
+// regenerated uevents are then handled exactly as in the steps below, so the nodes, symlinks and
+// permissions always come from the current ueventd.rc files.  The cache is rewritten whenever the
+// set of devices differs from it.
+
 // Lastly, it should be noted that uevents that occur during the coldboot process are handled
 // without issue after the coldboot process completes.  This is because the uevent listener is
 // paused while the uevent handler and restorecon actions take place.  Once coldboot completes,
@@ -114,17 +126,21 @@ class ColdBoot {
   public:
     ColdBoot(UeventListener& uevent_listener,
              std::vector<std::unique_ptr<UeventHandler>>& uevent_handlers,
-             bool enable_parallel_restorecon)
+             bool enable_parallel_restorecon, std::string cache_file)
         : uevent_listener_(uevent_listener),
           uevent_handlers_(uevent_handlers),
           num_handler_subprocesses_(std::thread::hardware_concurrency() ?: 4),
-          enable_parallel_restorecon_(enable_parallel_restorecon) {}
+          enable_parallel_restorecon_(enable_parallel_restorecon),
+          cache_file_(std::move(cache_file)) {}
 
     void Run();
 
   private:
     void UeventHandlerMain(unsigned int process_num, unsigned int total_processes);
+    void LoadCache();
+    bool UseCachedUevent(const std::string& sys_path);
     void RegenerateUevents();
+    void SaveCache();
     void ForkSubProcesses();
     void WaitForSubProcesses();
     void RestoreConHandler(unsigned int process_num, unsigned int total_processes);
@@ -136,6 +152,13 @@ class ColdBoot {
     unsigned int num_handler_subprocesses_;
     bool enable_parallel_restorecon_;
 
+    std::string cache_file_;
+    std::string cache_key_;
+    bool cache_loaded_ = false;
+    // Cached uevents by path, removed as their devices are found.
+    std::map<std::string, Uevent> cached_uevents_;
+    size_t num_cached_uevents_used_ = 0;
+
     std::vector<Uevent> uevent_queue_;
 
     std::set<pid_t> subprocess_pids_;
@@ -182,11 +205,76 @@ void ColdBoot::GenerateRestoreCon(const std::string& directory) {
     }
 }
 
+void ColdBoot::LoadCache() {
+    cache_key_ = UeventCacheKey();
+    auto uevents = ReadUeventCache(cache_file_, cache_key_);
+    if (!uevents) {
+        if (uevents.error().code() != ENOENT) {
+            LOG(INFO) << "Not using coldboot cache '" << cache_file_ << "': " << uevents.error();
+        }
+        return;
+    }
+
+    for (auto& uevent : *uevents) {
+        auto path = uevent.path;
+        cached_uevents_.emplace(std::move(path), std::move(uevent));
+    }
+    cache_loaded_ = true;
+}
+
+bool ColdBoot::UseCachedUevent(const std::string& sys_path) {
+    auto it = cached_uevents_.find(sys_path.substr(strlen("/sys")));
+    if (it == cached_uevents_.end()) return false;
+
+    // Dynamically allocated device numbers can move between boots.
+    const auto& uevent = it->second;
+    if (uevent.major >= 0) {
+        std::string dev;
+        if (!android::base::ReadFileToString(sys_path + "/dev", &dev) ||
+            dev != android::base::StringPrintf("%d:%d\n", uevent.major, uevent.minor)) {
+            return false;
+        }
+    }
+
+    uevent_queue_.emplace_back(std::move(it->second));
+    cached_uevents_.erase(it);
+    num_cached_uevents_used_++;
+    return true;
+}
+
 void ColdBoot::RegenerateUevents() {
-    uevent_listener_.RegenerateUevents([this](const Uevent& uevent) {
-        uevent_queue_.emplace_back(uevent);
-        return ListenerAction::kContinue;
-    });
+    RegenerateFilter skip;
+    if (!cached_uevents_.empty()) {
+        skip = [this](const std::string& sys_path) { return UseCachedUevent(sys_path); };
+    }
+
+    uevent_listener_.RegenerateUevents(
+            [this](const Uevent& uevent) {
+                uevent_queue_.emplace_back(uevent);
+                return ListenerAction::kContinue;
+            },
+            skip);
+}
+
+void ColdBoot::SaveCache() {
+    std::vector<Uevent> uevents;
+    for (const auto& uevent : uevent_queue_) {
+        if (uevent.action == "add" && uevent.firmware.empty()) {
+            uevents.emplace_back(uevent);
+        }
+    }
+
+    LOG(INFO) << "Coldboot used " << num_cached_uevents_used_ << " cached uevents and regenerated "
+              << uevent_queue_.size() - num_cached_uevents_used_;
+
+    // Nothing new was seen and nothing in the cache went unused.
+    if (cache_loaded_ && uevents.size() == num_cached_uevents_used_ && cached_uevents_.empty()) {
+        return;
+    }
+
+    if (auto result = WriteUeventCache(cache_file_, cache_key_, uevents); !result) {
+        LOG(ERROR) << "Could not write coldboot cache '" << cache_file_ << "': " << result.error();
+    }
 }
 
 void ColdBoot::ForkSubProcesses() {
@@ -244,6 +332,10 @@ void ColdBoot::WaitForSubProcesses() {
 void ColdBoot::Run() {
     android::base::Timer cold_boot_timer;
 
+    if (!cache_file_.empty()) {
+        LoadCache();
+    }
+
     RegenerateUevents();
 
     if (enable_parallel_restorecon_) {
@@ -262,6 +354,10 @@ void ColdBoot::Run() {
 
     WaitForSubProcesses();
 
+    if (!cache_file_.empty()) {
+        SaveCache();
+    }
+
     android::base::SetProperty(kColdBootDoneProp, "true");
     LOG(INFO) << "Coldboot took " << cold_boot_timer.duration().count() / 1000.0f << " seconds";
 }
@@ -307,7 +403,8 @@ int ueventd_main(int argc, char** argv) {
 
     if (!android::base::GetBoolProperty(kColdBootDoneProp, false)) {
         ColdBoot cold_boot(uevent_listener, uevent_handlers,
-                           ueventd_configuration.enable_parallel_restorecon);
+                           ueventd_configuration.enable_parallel_restorecon,
+                           ueventd_configuration.coldboot_cache_file);
         cold_boot.Run();
     }
 
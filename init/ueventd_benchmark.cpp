@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+
+#include "devices.h"
+#include "uevent.h"
+#include "uevent_cache.h"
+#include "ueventd_parser.h"
+#include "util.h"
+
+using android::base::Basename;
+using android::base::StringPrintf;
+using namespace std::string_literals;
+
+namespace android {
+namespace init {
+
+// Roughly the number of uevents a cold boot regenerates on a current device.
+static constexpr int kNumUevents = 5000;
+static constexpr int kNumDeviceRules = 300;
+static constexpr int kNumSysfsRules = 100;
+static constexpr int kNumSubsystems = 4;
+static constexpr const char kBootDevice[] = "soc/1d84000.ufshc";
+
+static std::string MakeUeventdConfig() {
+    std::string config;
+    for (int i = 0; i < kNumSubsystems; i++) {
+        config += StringPrintf(
+                "subsystem bench_sub%d\n"
+                "    devname uevent_devname\n"
+                "    dirname /dev/bench_sub%d\n\n",
+                i, i);
+    }
+    config += "/dev/input/*              0660   root       input\n";
+    config += "/dev/block/by-name/*      0600   root       root\n";
+    for (int i = 0; i < kNumDeviceRules; i++) {
+        switch (i % 3) {
+            case 0:
+                config += StringPrintf("/dev/bench%d    0660   system   system\n", i);
+                break;
+            case 1:
+                config += StringPrintf("/dev/bench_sub%d/bench%d*    0660   system   graphics\n",
+                                       i % kNumSubsystems, i);
+                break;
+            case 2:
+                config += StringPrintf("/dev/block/platform/%s/by-name/bench_%d    0640   system "
+                                       "system\n",
+                                       kBootDevice, i);
+                break;
+        }
+    }
+    for (int i = 0; i < kNumSysfsRules; i++) {
+        config += StringPrintf("/sys/devices/platform/soc/*.bench%d    enable    0660  system  "
+                               "system\n",
+                               i);
+    }
+    return config;
+}
+
+// A cold boot's worth of uevents: mostly devices without a node, then partitions of the boot
+// device, input devices, misc devices and devices of the subsystems declared by the config.
+static std::vector<Uevent> MakeUevents() {
+    std::vector<Uevent> uevents;
+    for (int i = 0; i < kNumUevents; i++) {
+        Uevent uevent = {.action = "add", .partition_num = -1, .major = -1, .minor = -1};
+        switch (i % 10) {
+            case 6:
+                uevent.path = StringPrintf("/devices/platform/%s/host0/target0:0:0/0:0:0:0/block/"
+                                           "sda/sda%d",
+                                           kBootDevice, i);
+                uevent.subsystem = "block";
+                uevent.device_name = StringPrintf("sda%d", i);
+                uevent.partition_name = StringPrintf("bench_%d", i);
+                uevent.partition_num = i;
+                uevent.major = 259;
+                uevent.minor = i;
+                break;
+            case 7:
+                uevent.path = StringPrintf("/devices/platform/soc/%x.bench%d/input/input%d/event%d",
+                                           i, i % kNumSysfsRules, i, i);
+                uevent.subsystem = "input";
+                uevent.device_name = StringPrintf("input/event%d", i);
+                uevent.major = 13;
+                uevent.minor = i;
+                break;
+            case 8:
+                uevent.path = StringPrintf("/devices/virtual/misc/bench%d", i % kNumDeviceRules);
+                uevent.subsystem = "misc";
+                uevent.device_name = StringPrintf("bench%d", i % kNumDeviceRules);
+                uevent.major = 10;
+                uevent.minor = i;
+                break;
+            case 9:
+                uevent.path = StringPrintf("/devices/virtual/bench/bench%d", i % kNumDeviceRules);
+                uevent.subsystem = StringPrintf("bench_sub%d", i % kNumSubsystems);
+                uevent.device_name = StringPrintf("bench%d", i % kNumDeviceRules);
+                uevent.major = 240;
+                uevent.minor = i;
+                break;
+            default:
+                uevent.path = StringPrintf("/devices/platform/soc/%x.bench%d/driver%d", i,
+                                           i % kNumSysfsRules, i);
+                uevent.subsystem = "platform";
+                break;
+        }
+        uevents.emplace_back(std::move(uevent));
+    }
+    return uevents;
+}
+
+static bool WriteConfig(const std::string& path) {
+    return android::base::WriteStringToFile(MakeUeventdConfig(), path) &&
+           chmod(path.c_str(), 0600) == 0;
+}
+
+// Runs the part of DeviceHandler::HandleUevent() that decides what to create for a uevent: the
+// sysfs permission fixups, the device path, the block device symlinks and the device permissions.
+// Creating the nodes themselves needs root and a scratch /dev, so that part is left out.
+class DeviceHandlerBenchmark {
+  public:
+    explicit DeviceHandlerBenchmark(const UeventdConfiguration& config)
+        : device_handler_(config.dev_permissions, config.sysfs_permissions, config.subsystems,
+                          {kBootDevice}, true) {}
+
+    // Gives the boot device a sysfs entry that links to the platform bus, as the symlinks of its
+    // partitions are named after it.
+    bool Init() {
+        device_handler_.sysfs_mount_point_ = fake_sys_root_.path;
+        std::string platform_bus = fake_sys_root_.path + "/bus/platform"s;
+        std::string boot_device = fake_sys_root_.path + "/devices/platform/"s + kBootDevice;
+        return mkdir_recursive(platform_bus, 0755) && mkdir_recursive(boot_device, 0755) &&
+               symlink(platform_bus.c_str(), (boot_device + "/subsystem").c_str()) == 0;
+    }
+
+    mode_t Resolve(const Uevent& uevent) const {
+        device_handler_.FixupSysPermissions(uevent.path, uevent.subsystem);
+        if (uevent.major < 0 || uevent.minor < 0) return 0;
+
+        std::string devpath;
+        std::vector<std::string> links;
+        if (uevent.subsystem == "block") {
+            devpath = "/dev/block/" + Basename(uevent.path);
+            links = device_handler_.GetBlockDeviceSymlinks(uevent);
+        } else if (const auto subsystem = std::find(device_handler_.subsystems_.cbegin(),
+                                                    device_handler_.subsystems_.cend(),
+                                                    uevent.subsystem);
+                   subsystem != device_handler_.subsystems_.cend()) {
+            devpath = subsystem->ParseDevPath(uevent);
+        } else {
+            devpath = "/dev/" + Basename(uevent.path);
+        }
+        return std::get<0>(device_handler_.GetDevicePermissions(devpath, links));
+    }
+
+  private:
+    TemporaryDir fake_sys_root_;
+    DeviceHandler device_handler_;
+};
+
+static void BenchmarkParseUeventdConfig(benchmark::State& state) {
+    TemporaryDir dir;
+    std::string path = dir.path + "/ueventd.rc"s;
+    if (!WriteConfig(path)) {
+        state.SkipWithError("Failed to write the config.");
+        return;
+    }
+
+    for (auto _ : state) {
+        auto config = ParseConfig({path});
+        benchmark::DoNotOptimize(config.dev_permissions.size());
+    }
+}
+BENCHMARK(BenchmarkParseUeventdConfig);
+
+// Reading the uevents of a cold boot back from the cache that a previous boot saved.
+static void BenchmarkReadUeventCache(benchmark::State& state) {
+    TemporaryDir dir;
+    std::string path = dir.path + "/uevents"s;
+    if (!WriteUeventCache(path, "bench", MakeUevents())) {
+        state.SkipWithError("Failed to write the cache.");
+        return;
+    }
+
+    for (auto _ : state) {
+        auto uevents = ReadUeventCache(path, "bench");
+        if (!uevents) {
+            state.SkipWithError("Failed to read the cache.");
+            return;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kNumUevents);
+}
+BENCHMARK(BenchmarkReadUeventCache);
+
+// Replays the uevents of a cold boot through the device handler.
+static void BenchmarkColdbootReplay(benchmark::State& state) {
+    android::base::ScopedLogSeverity severity(android::base::WARNING);
+    TemporaryDir dir;
+    std::string path = dir.path + "/ueventd.rc"s;
+    if (!WriteConfig(path)) {
+        state.SkipWithError("Failed to write the config.");
+        return;
+    }
+    DeviceHandlerBenchmark handler(ParseConfig({path}));
+    if (!handler.Init()) {
+        state.SkipWithError("Failed to create the fake sysfs.");
+        return;
+    }
+    auto uevents = MakeUevents();
+
+    for (auto _ : state) {
+        for (const auto& uevent : uevents) {
+            benchmark::DoNotOptimize(handler.Resolve(uevent));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kNumUevents);
+}
+BENCHMARK(BenchmarkColdbootReplay)->Unit(benchmark::kMillisecond);
+
+}  // namespace init
+}  // namespace android
@@ -145,6 +145,21 @@ Result<void> ParseUeventSocketRcvbufSizeLine(std::vector<std::string>&& args,
     return {};
 }
 
+Result<void> ParseColdbootCacheLine(std::vector<std::string>&& args,
+                                    std::string* coldboot_cache_file) {
+    if (args.size() != 2) {
+        return Error() << "coldboot_cache lines take exactly one parameter";
+    }
+
+    if (args[1].empty() || args[1][0] != '/') {
+        return Error() << "coldboot_cache must be an absolute path, not '" << args[1] << "'";
+    }
+
+    *coldboot_cache_file = std::move(args[1]);
+
+    return {};
+}
+
 class SubsystemParser : public SectionParser {
   public:
     SubsystemParser(std::vector<Subsystem>* subsystems) : subsystems_(subsystems) {}
@@ -248,6 +263,9 @@ UeventdConfiguration ParseConfig(const std::vector<std::string>& configs) {
     parser.AddSingleLineParser("parallel_restorecon",
                                std::bind(ParseEnabledDisabledLine, _1,
                                          &ueventd_configuration.enable_parallel_restorecon));
+    parser.AddSingleLineParser("coldboot_cache",
+                               std::bind(ParseColdbootCacheLine, _1,
+                                         &ueventd_configuration.coldboot_cache_file));
 
     for (const auto& config : configs) {
         parser.ParseConfig(config);
@@ -67,6 +67,7 @@ void TestUeventdFile(const std::string& content, const UeventdConfiguration& exp
     TestVector(expected.sysfs_permissions, result.sysfs_permissions, TestSysfsPermissions);
     TestVector(expected.dev_permissions, result.dev_permissions, TestPermissions);
     EXPECT_EQ(expected.firmware_directories, result.firmware_directories);
+    EXPECT_EQ(expected.coldboot_cache_file, result.coldboot_cache_file);
 }
 
 TEST(ueventd_parser, EmptyFile) {
@@ -212,6 +213,17 @@ parallel_restorecon disabled
     TestUeventdFile(ueventd_file2, {{}, {}, {}, {}, {}, true, 0, false});
 }
 
+TEST(ueventd_parser, ColdbootCache) {
+    auto ueventd_file = R"(
+coldboot_cache /metadata/first
+coldboot_cache /metadata/second
+)";
+
+    auto expected = UeventdConfiguration{};
+    expected.coldboot_cache_file = "/metadata/second";
+    TestUeventdFile(ueventd_file, expected);
+}
+
 TEST(ueventd_parser, AllTogether) {
     auto ueventd_file = R"(
 
@@ -316,6 +328,10 @@ external_firmware_handler
 external_firmware_handler blah blah
 external_firmware_handler blah blah blah blah
 
+coldboot_cache
+coldboot_cache relative/path
+coldboot_cache /a /b
+
 )";
 
     TestUeventdFile(ueventd_file, {});
@@ -236,11 +236,15 @@ void import_kernel_cmdline(bool in_qemu,
     std::string cmdline;
     android::base::ReadFileToString("/proc/cmdline", &cmdline);
 
-    for (const auto& entry : android::base::Split(android::base::Trim(cmdline), " ")) {
-        std::vector<std::string> pieces = android::base::Split(entry, "=");
-        if (pieces.size() == 2) {
-            fn(pieces[0], pieces[1], in_qemu);
+    for (std::string_view entry : android::base::Tokenize(android::base::TrimView(cmdline), " ")) {
+        // Only entries with exactly one '=' are key/value pairs.
+        auto equal_sign = entry.find('=');
+        if (equal_sign == std::string_view::npos ||
+            entry.find('=', equal_sign + 1) != std::string_view::npos) {
+            continue;
         }
+        fn(std::string(entry.substr(0, equal_sign)), std::string(entry.substr(equal_sign + 1)),
+           in_qemu);
     }
 }
 
@@ -19,6 +19,8 @@
 #include <sys/epoll.h>
 #include <sys/socket.h>
 
+#include <chrono>
+#include <map>
 #include <unordered_map>
 
 #include <android-base/logging.h>
@@ -30,7 +32,23 @@ namespace android {
 namespace fuse {
 namespace {
 
-enum class FuseBridgeState { kWaitToReadEither, kWaitToReadProxy, kWaitToWriteProxy, kClosing };
+enum class FuseBridgeState { kWaitToReadEither, kWaitToWriteProxy, kClosing };
+
+// Upper bound of replies forwarded per wakeup, so that a busy mount does not starve the others.
+constexpr int kMaxRepliesPerTransfer = 16;
+
+// A request forwarded to the proxy that hasn't been replied to yet.
+struct PendingRequest {
+    uint32_t opcode;
+    std::chrono::steady_clock::time_point start;
+};
+
+// How long the proxy took to reply to the requests of one opcode.
+struct OpcodeLatency {
+    uint64_t count = 0;
+    std::chrono::nanoseconds total{0};
+    std::chrono::nanoseconds max{0};
+};
 
 struct FuseBridgeEntryEvent {
     FuseBridgeEntry* entry;
@@ -43,10 +61,6 @@ void GetObservedEvents(FuseBridgeState state, int* device_events, int* proxy_eve
             *device_events = EPOLLIN;
             *proxy_events = EPOLLIN;
             return;
-        case FuseBridgeState::kWaitToReadProxy:
-            *device_events = 0;
-            *proxy_events = EPOLLIN;
-            return;
         case FuseBridgeState::kWaitToWriteProxy:
             *device_events = 0;
             *proxy_events = EPOLLOUT;
@@ -77,6 +91,8 @@ class FuseBridgeEntry {
           last_proxy_events_({this, 0}),
           open_count_(0) {}
 
+    ~FuseBridgeEntry() { LogLatencies(); }
+
     // Transfer bytes depends on availability of FDs and the internal |state_|.
     void Transfer(FuseBridgeLoopCallback* callback) {
         constexpr int kUnexpectedEventMask = ~(EPOLLIN | EPOLLOUT);
@@ -102,18 +118,16 @@ class FuseBridgeEntry {
 
         switch (state_) {
             case FuseBridgeState::kWaitToReadEither:
+                // Requests don't wait for the replies of earlier ones, so any number of them can
+                // be outstanding. Forward the replies first, then the next request.
                 if (proxy_read_ready) {
                     state_ = ReadFromProxy();
-                } else if (device_read_ready) {
+                }
+                if (device_read_ready && state_ == FuseBridgeState::kWaitToReadEither) {
                     state_ = ReadFromDevice(callback);
                 }
                 return;
 
-            case FuseBridgeState::kWaitToReadProxy:
-                CHECK(proxy_read_ready);
-                state_ = ReadFromProxy();
-                return;
-
             case FuseBridgeState::kWaitToWriteProxy:
                 CHECK(proxy_write_ready);
                 state_ = WriteToProxy();
@@ -132,23 +146,42 @@ class FuseBridgeEntry {
     friend class BridgeEpollController;
 
     FuseBridgeState ReadFromProxy() {
-        switch (buffer_.response.ReadOrAgain(proxy_fd_)) {
-            case ResultOrAgain::kSuccess:
-                break;
-            case ResultOrAgain::kFailure:
+        // Replies are whole messages, so the proxy can be drained of the ones already queued
+        // without waiting for more.
+        for (int i = 0; i < kMaxRepliesPerTransfer; i++) {
+            switch (buffer_.response.ReadOrAgain(proxy_fd_)) {
+                case ResultOrAgain::kSuccess:
+                    break;
+                case ResultOrAgain::kFailure:
+                    return FuseBridgeState::kClosing;
+                case ResultOrAgain::kAgain:
+                    return FuseBridgeState::kWaitToReadEither;
+            }
+
+            if (!WriteReplyToDevice()) {
                 return FuseBridgeState::kClosing;
-            case ResultOrAgain::kAgain:
-                return FuseBridgeState::kWaitToReadProxy;
+            }
         }
+        return FuseBridgeState::kWaitToReadEither;
+    }
 
+    // Forwards the reply in |buffer_| and returns false once the bridge must be closed.
+    bool WriteReplyToDevice() {
         if (!buffer_.response.Write(device_fd_)) {
             LogResponseError("Failed to write a reply from proxy to device", buffer_.response);
-            return FuseBridgeState::kClosing;
+            return false;
         }
 
-        auto it = opcode_map_.find(buffer_.response.header.unique);
-        if (it != opcode_map_.end()) {
-            switch (it->second) {
+        auto it = pending_requests_.find(buffer_.response.header.unique);
+        if (it != pending_requests_.end()) {
+            OpcodeLatency& latency = latencies_[it->second.opcode];
+            const std::chrono::nanoseconds elapsed =
+                    std::chrono::steady_clock::now() - it->second.start;
+            latency.count++;
+            latency.total += elapsed;
+            latency.max = std::max(latency.max, elapsed);
+
+            switch (it->second.opcode) {
                 case FUSE_OPEN:
                     if (buffer_.response.header.error == fuse::kFuseSuccess) {
                         open_count_++;
@@ -163,14 +196,13 @@ class FuseBridgeEntry {
                         break;
                     }
                     if (open_count_ == 0) {
-                        return FuseBridgeState::kClosing;
+                        return false;
                     }
                     break;
             }
-            opcode_map_.erase(it);
+            pending_requests_.erase(it);
         }
-
-        return FuseBridgeState::kWaitToReadEither;
+        return true;
     }
 
     FuseBridgeState ReadFromDevice(FuseBridgeLoopCallback* callback) {
@@ -197,9 +229,7 @@ class FuseBridgeEntry {
             case FUSE_WRITE:
             case FUSE_RELEASE:
             case FUSE_FSYNC:
-                if (opcode == FUSE_OPEN || opcode == FUSE_RELEASE) {
-                    opcode_map_.emplace(buffer_.request.header.unique, opcode);
-                }
+                pending_requests_[unique] = {opcode, std::chrono::steady_clock::now()};
                 return WriteToProxy();
 
             case FUSE_INIT:
@@ -248,9 +278,18 @@ class FuseBridgeEntry {
     FuseBridgeEntryEvent last_device_events_;
     FuseBridgeEntryEvent last_proxy_events_;
 
-    // Remember map between unique and opcode in fuse_in_header so that we can
-    // refer the opcode later.
-    std::unordered_map<uint64_t, uint32_t> opcode_map_;
+    void LogLatencies() const {
+        for (const auto& [opcode, latency] : latencies_) {
+            LOG(DEBUG) << "Mount " << mount_id_ << " opcode=" << opcode << " count=" << latency.count
+                       << " avg_us=" << (latency.total / latency.count).count() / 1000
+                       << " max_us=" << latency.max.count() / 1000;
+        }
+    }
+
+    // Remember the opcode in fuse_in_header of each forwarded request by its
+    // unique, so that we can refer to it when the reply comes back.
+    std::unordered_map<uint64_t, PendingRequest> pending_requests_;
+    std::map<uint32_t, OpcodeLatency> latencies_;
 
     int open_count_;
 
@@ -101,6 +101,22 @@ class FuseBridgeLoopTest : public ::testing::Test {
     EXPECT_EQ(kFuseSuccess, response_.header.error);
   }
 
+  void SendRequest(uint32_t opcode, uint64_t unique) {
+    memset(&request_, 0, sizeof(FuseRequest));
+    request_.header.opcode = opcode;
+    request_.header.unique = unique;
+    request_.header.len = sizeof(fuse_in_header);
+    ASSERT_TRUE(request_.Write(dev_sockets_[0]));
+  }
+
+  void SendResponse(uint64_t unique) {
+    memset(&response_, 0, sizeof(FuseResponse));
+    response_.header.len = sizeof(fuse_out_header);
+    response_.header.unique = unique;
+    response_.header.error = kFuseSuccess;
+    ASSERT_TRUE(response_.Write(proxy_sockets_[1]));
+  }
+
   void SendInitRequest(uint64_t unique) {
     memset(&request_, 0, sizeof(FuseRequest));
     request_.header.opcode = FUSE_INIT;
@@ -210,5 +226,27 @@ TEST_F(FuseBridgeLoopTest, Proxy) {
   Close();
 }
 
+TEST_F(FuseBridgeLoopTest, OutstandingRequests) {
+  // Several requests reach the proxy before any of them is answered.
+  for (uint64_t unique = 1; unique <= 3; unique++) {
+    SendRequest(FUSE_READ, unique);
+  }
+  for (uint64_t unique = 1; unique <= 3; unique++) {
+    memset(&request_, 0, sizeof(FuseRequest));
+    ASSERT_TRUE(request_.Read(proxy_sockets_[1]));
+    EXPECT_EQ(unique, request_.header.unique);
+  }
+
+  // And their replies are forwarded in the order the proxy sends them.
+  for (uint64_t unique : {3u, 1u, 2u}) {
+    SendResponse(unique);
+  }
+  for (uint64_t unique : {3u, 1u, 2u}) {
+    memset(&response_, 0, sizeof(FuseResponse));
+    ASSERT_TRUE(response_.Read(dev_sockets_[0]));
+    EXPECT_EQ(unique, response_.header.unique);
+  }
+}
+
 }  // namespace fuse
 }  // namespace android
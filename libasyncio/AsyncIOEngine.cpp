@@ -0,0 +1,494 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <asyncio/AsyncIOEngine.h>
+
+#include <asyncio/AsyncIO.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define ASYNCIO_HAVE_IO_URING 1
+#endif
+
+namespace android {
+namespace asyncio {
+
+static const timespec kNoWait = {};
+
+AsyncIOEngine::AsyncIOEngine(Backend backend, unsigned queue_depth, int event_fd)
+    : backend_(backend), queue_depth_(queue_depth), event_fd_(event_fd) {
+    requests_.resize(queue_depth);
+    free_slots_.reserve(queue_depth);
+    // Hand out the low slots first.
+    for (unsigned slot = queue_depth; slot > 0; --slot) {
+        free_slots_.push_back(slot - 1);
+    }
+    completed_.reserve(queue_depth);
+}
+
+AsyncIOEngine::~AsyncIOEngine() {
+    close(event_fd_);
+}
+
+bool AsyncIOEngine::PrepRead(int fd, void* buf, size_t len, uint64_t offset, Callback callback) {
+    return Prep(fd, true, buf, len, offset, std::move(callback));
+}
+
+bool AsyncIOEngine::PrepWrite(int fd, const void* buf, size_t len, uint64_t offset,
+                              Callback callback) {
+    return Prep(fd, false, const_cast<void*>(buf), len, offset, std::move(callback));
+}
+
+bool AsyncIOEngine::Prep(int fd, bool read, void* buf, size_t len, uint64_t offset,
+                         Callback callback) {
+    if (free_slots_.empty()) {
+        errno = EAGAIN;
+        return false;
+    }
+    unsigned slot = free_slots_.back();
+    requests_[slot] = {fd, read, buf, len, offset, std::move(callback)};
+    if (!Queue(slot)) {
+        requests_[slot].callback = nullptr;
+        return false;
+    }
+    free_slots_.pop_back();
+    ++queued_;
+    return true;
+}
+
+int AsyncIOEngine::Submit() {
+    if (queued_ == 0) {
+        return 0;
+    }
+    size_t refused = completed_.size();
+    int submitted = SubmitQueued();
+    if (submitted < 0) {
+        return -1;
+    }
+    refused = completed_.size() - refused;
+    queued_ -= submitted + refused;
+    in_flight_ += submitted;
+    if (refused > 0) {
+        // Nothing will signal these, so wake whoever is waiting for completions.
+        uint64_t one = 1;
+        TEMP_FAILURE_RETRY(write(event_fd_, &one, sizeof(one)));
+    }
+    return submitted;
+}
+
+int AsyncIOEngine::Reap(unsigned min_completions, const timespec* timeout) {
+    // The counter is only a wake up; the backend knows what actually completed.
+    uint64_t count;
+    TEMP_FAILURE_RETRY(read(event_fd_, &count, sizeof(count)));
+
+    if (in_flight_ > 0) {
+        unsigned wanted = 0;
+        if (min_completions > completed_.size()) {
+            wanted = std::min(in_flight_, min_completions - unsigned(completed_.size()));
+        }
+        int reaped = ReapCompletions(wanted, in_flight_, wanted > 0 ? timeout : &kNoWait);
+        if (reaped < 0) {
+            if (completed_.empty()) return -1;
+        } else {
+            in_flight_ -= reaped;
+        }
+    }
+
+    // Callbacks may queue more requests, which may reuse the slots being freed here.
+    std::vector<std::pair<unsigned, int64_t>> completed;
+    completed.swap(completed_);
+    for (const auto& [slot, result] : completed) {
+        Callback callback = std::move(requests_[slot].callback);
+        requests_[slot].callback = nullptr;
+        free_slots_.push_back(slot);
+        if (callback) callback(result);
+    }
+    int delivered = completed.size();
+    if (completed_.empty()) {
+        // Keep the capacity around for the next round.
+        completed.clear();
+        completed_.swap(completed);
+    }
+    return delivered;
+}
+
+bool AsyncIOEngine::RegisterBuffers(const std::vector<iovec>&) {
+    return true;
+}
+
+void AsyncIOEngine::Complete(unsigned slot, int64_t result) {
+    completed_.emplace_back(slot, result);
+}
+
+namespace {
+
+class AioEngine : public AsyncIOEngine {
+  public:
+    AioEngine(unsigned queue_depth, int event_fd, aio_context_t ctx)
+        : AsyncIOEngine(Backend::kAio, queue_depth, event_fd), ctx_(ctx) {
+        iocbs_.resize(queue_depth);
+        queued_iocbs_.reserve(queue_depth);
+        events_.resize(queue_depth);
+    }
+
+    ~AioEngine() override {
+        // Waits for anything still in flight, so buffers aren't written to after we're gone.
+        io_destroy(ctx_);
+    }
+
+  protected:
+    bool Queue(unsigned slot) override {
+        const Request& req = request(slot);
+        iocb* cb = &iocbs_[slot];
+        io_prep(cb, req.fd, req.buf, req.len, req.offset, req.read);
+        cb->aio_data = slot;
+        cb->aio_flags = IOCB_FLAG_RESFD;
+        cb->aio_resfd = event_fd();
+        queued_iocbs_.push_back(cb);
+        return true;
+    }
+
+    int SubmitQueued() override {
+        int submitted = 0;
+        size_t next = 0;
+        while (next < queued_iocbs_.size()) {
+            int rc = io_submit(ctx_, queued_iocbs_.size() - next, &queued_iocbs_[next]);
+            if (rc < 0) {
+                if (errno == EINTR) continue;
+                // The kernel refused the first remaining request outright.
+                Complete(queued_iocbs_[next]->aio_data, -errno);
+                ++next;
+                continue;
+            }
+            submitted += rc;
+            next += rc;
+        }
+        queued_iocbs_.clear();
+        return submitted;
+    }
+
+    int ReapCompletions(unsigned min, unsigned max, const timespec* timeout) override {
+        timespec ts;
+        timespec* tsp = nullptr;
+        if (timeout) {
+            ts = *timeout;
+            tsp = &ts;
+        }
+        int rc = TEMP_FAILURE_RETRY(io_getevents(ctx_, min, max, events_.data(), tsp));
+        if (rc < 0) return -1;
+        for (int i = 0; i < rc; ++i) {
+            Complete(events_[i].data, events_[i].res);
+        }
+        return rc;
+    }
+
+  private:
+    aio_context_t ctx_;
+    std::vector<iocb> iocbs_;
+    std::vector<iocb*> queued_iocbs_;
+    std::vector<io_event> events_;
+};
+
+#if defined(ASYNCIO_HAVE_IO_URING)
+
+static int io_uring_setup(unsigned entries, io_uring_params* params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args) {
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static int64_t RemainingNs(const timespec& deadline) {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (deadline.tv_sec - now.tv_sec) * 1000000000LL + (deadline.tv_nsec - now.tv_nsec);
+}
+
+class IoUringEngine : public AsyncIOEngine {
+  public:
+    // Takes ownership of event_fd, even on failure.
+    static std::unique_ptr<IoUringEngine> Create(unsigned queue_depth, int event_fd) {
+        io_uring_params params = {};
+        int ring_fd = io_uring_setup(queue_depth, &params);
+        if (ring_fd < 0) {
+            int saved_errno = errno;
+            close(event_fd);
+            errno = saved_errno;
+            return nullptr;
+        }
+        std::unique_ptr<IoUringEngine> engine(
+                new IoUringEngine(queue_depth, event_fd, ring_fd, params));
+        if (!engine->Map() ||
+            io_uring_register(ring_fd, IORING_REGISTER_EVENTFD, &event_fd, 1) < 0) {
+            return nullptr;
+        }
+        return engine;
+    }
+
+    ~IoUringEngine() override {
+        if (sqes_ != MAP_FAILED) munmap(sqes_, params_.sq_entries * sizeof(io_uring_sqe));
+        if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+        if (sq_ring_ != MAP_FAILED) munmap(sq_ring_, sq_ring_size_);
+        // Closing the ring waits for anything still in flight.
+        close(ring_fd_);
+    }
+
+    bool RegisterBuffers(const std::vector<iovec>& buffers) override {
+        if (pending() != 0) {
+            // Requests in flight may be using the registered buffers.
+            errno = EBUSY;
+            return false;
+        }
+        if (!buffers_.empty()) {
+            io_uring_register(ring_fd_, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+            buffers_.clear();
+        }
+        if (buffers.empty()) return true;
+        if (io_uring_register(ring_fd_, IORING_REGISTER_BUFFERS, buffers.data(),
+                              buffers.size()) < 0) {
+            return false;
+        }
+        buffers_ = buffers;
+        return true;
+    }
+
+  protected:
+    bool Queue(unsigned slot) override {
+        const Request& req = request(slot);
+        unsigned index = sq_tail_ & *sq_mask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->fd = req.fd;
+        sqe->off = req.offset;
+        sqe->user_data = slot;
+
+        int buf_index = FindRegisteredBuffer(req.buf, req.len);
+        if (buf_index >= 0) {
+            sqe->opcode = req.read ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+            sqe->addr = reinterpret_cast<uintptr_t>(req.buf);
+            sqe->len = req.len;
+            sqe->buf_index = buf_index;
+        } else {
+            // READV and WRITEV are in every kernel that has io_uring at all.
+            iovecs_[slot] = {req.buf, req.len};
+            sqe->opcode = req.read ? IORING_OP_READV : IORING_OP_WRITEV;
+            sqe->addr = reinterpret_cast<uintptr_t>(&iovecs_[slot]);
+            sqe->len = 1;
+        }
+        sq_array_[index] = index;
+        ++sq_tail_;
+        return true;
+    }
+
+    int SubmitQueued() override {
+        __atomic_store_n(sq_ktail_, sq_tail_, __ATOMIC_RELEASE);
+        unsigned to_submit = sq_tail_ - sq_submitted_;
+        int submitted = 0;
+        while (submitted < int(to_submit)) {
+            int rc = io_uring_enter(ring_fd_, to_submit - submitted, 0, 0);
+            if (rc < 0) {
+                if (errno == EINTR) continue;
+                // Whatever wasn't consumed stays in the ring for the next Submit().
+                if (submitted == 0) return -1;
+                break;
+            }
+            submitted += rc;
+            sq_submitted_ += rc;
+        }
+        // Requests the kernel refuses still complete, with the error, through the CQ ring.
+        return submitted;
+    }
+
+    int ReapCompletions(unsigned min, unsigned max, const timespec* timeout) override {
+        timespec deadline;
+        if (timeout) {
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += timeout->tv_sec;
+            deadline.tv_nsec += timeout->tv_nsec;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+        }
+
+        unsigned reaped = 0;
+        while (true) {
+            unsigned head = *cq_khead_;
+            unsigned tail = __atomic_load_n(cq_ktail_, __ATOMIC_ACQUIRE);
+            while (head != tail && reaped < max) {
+                const io_uring_cqe& cqe = cqes_[head & *cq_mask_];
+                Complete(cqe.user_data, cqe.res);
+                ++head;
+                ++reaped;
+            }
+            __atomic_store_n(cq_khead_, head, __ATOMIC_RELEASE);
+            if (reaped >= min) break;
+
+            // Every CQE signals the event fd, so wait on that rather than in io_uring_enter,
+            // which only learned to take a timeout in later kernels.
+            timespec remaining;
+            timespec* remaining_ptr = nullptr;
+            if (timeout) {
+                int64_t ns = std::max<int64_t>(RemainingNs(deadline), 0);
+                remaining = {time_t(ns / 1000000000), long(ns % 1000000000)};
+                remaining_ptr = &remaining;
+            }
+            pollfd pfd = {event_fd(), POLLIN, 0};
+            int rc = ppoll(&pfd, 1, remaining_ptr, nullptr);
+            if (rc < 0 && errno != EINTR) {
+                if (reaped == 0) return -1;
+                break;
+            }
+            if (rc == 0 && tail == __atomic_load_n(cq_ktail_, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+            uint64_t count;
+            TEMP_FAILURE_RETRY(read(event_fd(), &count, sizeof(count)));
+        }
+        return reaped;
+    }
+
+  private:
+    IoUringEngine(unsigned queue_depth, int event_fd, int ring_fd, const io_uring_params& params)
+        : AsyncIOEngine(Backend::kIoUring, queue_depth, event_fd),
+          ring_fd_(ring_fd),
+          params_(params) {
+        iovecs_.resize(queue_depth);
+    }
+
+    bool Map() {
+        sq_ring_size_ = params_.sq_off.array + params_.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params_.cq_off.cqes + params_.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = false;
+#if defined(IORING_FEAT_SINGLE_MMAP)
+        single_mmap = params_.features & IORING_FEAT_SINGLE_MMAP;
+#endif
+        if (single_mmap) {
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        }
+
+        sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_ring_ == MAP_FAILED) return false;
+        if (single_mmap) {
+            cq_ring_ = sq_ring_;
+        } else {
+            cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+            if (cq_ring_ == MAP_FAILED) return false;
+        }
+        sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, params_.sq_entries * sizeof(io_uring_sqe),
+                                                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                                ring_fd_, IORING_OFF_SQES));
+        if (sqes_ == MAP_FAILED) return false;
+
+        char* sq = static_cast<char*>(sq_ring_);
+        sq_ktail_ = reinterpret_cast<unsigned*>(sq + params_.sq_off.tail);
+        sq_mask_ = reinterpret_cast<unsigned*>(sq + params_.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + params_.sq_off.array);
+        sq_tail_ = sq_submitted_ = *sq_ktail_;
+
+        char* cq = static_cast<char*>(cq_ring_);
+        cq_khead_ = reinterpret_cast<unsigned*>(cq + params_.cq_off.head);
+        cq_ktail_ = reinterpret_cast<unsigned*>(cq + params_.cq_off.tail);
+        cq_mask_ = reinterpret_cast<unsigned*>(cq + params_.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params_.cq_off.cqes);
+        return true;
+    }
+
+    int FindRegisteredBuffer(const void* buf, size_t len) const {
+        uintptr_t begin = reinterpret_cast<uintptr_t>(buf);
+        for (size_t i = 0; i < buffers_.size(); ++i) {
+            uintptr_t base = reinterpret_cast<uintptr_t>(buffers_[i].iov_base);
+            if (begin >= base && begin + len <= base + buffers_[i].iov_len) return i;
+        }
+        return -1;
+    }
+
+    int ring_fd_;
+    io_uring_params params_;
+    size_t sq_ring_size_ = 0;
+    size_t cq_ring_size_ = 0;
+    void* sq_ring_ = MAP_FAILED;
+    void* cq_ring_ = MAP_FAILED;
+    io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+
+    unsigned* sq_ktail_ = nullptr;
+    unsigned* sq_mask_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    // Our copy of the SQ tail, published to the kernel on submission.
+    unsigned sq_tail_ = 0;
+    unsigned sq_submitted_ = 0;
+
+    unsigned* cq_khead_ = nullptr;
+    unsigned* cq_ktail_ = nullptr;
+    unsigned* cq_mask_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+
+    std::vector<iovec> iovecs_;
+    std::vector<iovec> buffers_;
+};
+
+#endif  // ASYNCIO_HAVE_IO_URING
+
+}  // namespace
+
+std::unique_ptr<AsyncIOEngine> AsyncIOEngine::Create(unsigned queue_depth, Backend backend) {
+    if (queue_depth == 0) {
+        errno = EINVAL;
+        return nullptr;
+    }
+#if defined(ASYNCIO_HAVE_IO_URING)
+    if (backend == Backend::kIoUring) {
+        int event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (event_fd < 0) return nullptr;
+        if (auto engine = IoUringEngine::Create(queue_depth, event_fd)) {
+            return engine;
+        }
+        // Old kernel, or io_uring disabled by policy: fall back to aio.
+    }
+#else
+    (void)backend;
+#endif
+
+    int event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (event_fd < 0) return nullptr;
+    aio_context_t ctx = 0;
+    if (io_setup(queue_depth, &ctx) < 0) {
+        int saved_errno = errno;
+        close(event_fd);
+        errno = saved_errno;
+        return nullptr;
+    }
+    return std::make_unique<AioEngine>(queue_depth, event_fd, ctx);
+}
+
+}  // namespace asyncio
+}  // namespace android
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <asyncio/AsyncIOEngine.h>
+
+#include <errno.h>
+#include <poll.h>
+
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+using android::asyncio::AsyncIOEngine;
+
+class AsyncIOEngineTest : public ::testing::TestWithParam<AsyncIOEngine::Backend> {};
+
+TEST_P(AsyncIOEngineTest, WriteThenRead) {
+    auto engine = AsyncIOEngine::Create(8, GetParam());
+    ASSERT_NE(nullptr, engine) << strerror(errno);
+
+    TemporaryFile tf;
+    std::vector<std::string> blocks;
+    for (int i = 0; i < 4; ++i) {
+        blocks.emplace_back(4096, 'a' + i);
+    }
+
+    int written = 0;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        ASSERT_TRUE(engine->PrepWrite(tf.fd, blocks[i].data(), blocks[i].size(), i * 4096,
+                                      [&](int64_t result) {
+                                          EXPECT_EQ(4096, result);
+                                          ++written;
+                                      }));
+    }
+    ASSERT_EQ(4u, engine->pending());
+    ASSERT_EQ(4, engine->Submit());
+
+    // The event fd is how an epoll loop learns about completions.
+    pollfd pfd = {engine->event_fd(), POLLIN, 0};
+    ASSERT_EQ(1, TEMP_FAILURE_RETRY(poll(&pfd, 1, 5000)));
+
+    while (written < 4) {
+        ASSERT_GE(engine->Reap(1), 0) << strerror(errno);
+    }
+    ASSERT_EQ(0u, engine->pending());
+
+    std::vector<std::string> read_back(blocks.size(), std::string(4096, '\0'));
+    int read = 0;
+    for (size_t i = 0; i < read_back.size(); ++i) {
+        ASSERT_TRUE(engine->PrepRead(tf.fd, read_back[i].data(), read_back[i].size(), i * 4096,
+                                     [&, i](int64_t result) {
+                                         EXPECT_EQ(4096, result);
+                                         EXPECT_EQ(blocks[i], read_back[i]);
+                                         ++read;
+                                     }));
+    }
+    ASSERT_EQ(4, engine->Submit());
+    ASSERT_EQ(4, engine->Reap(4));
+    ASSERT_EQ(4, read);
+}
+
+TEST_P(AsyncIOEngineTest, QueueDepth) {
+    auto engine = AsyncIOEngine::Create(2, GetParam());
+    ASSERT_NE(nullptr, engine) << strerror(errno);
+
+    TemporaryFile tf;
+    char buf[512] = {};
+    ASSERT_TRUE(engine->PrepWrite(tf.fd, buf, sizeof(buf), 0, nullptr));
+    ASSERT_TRUE(engine->PrepWrite(tf.fd, buf, sizeof(buf), 512, nullptr));
+    errno = 0;
+    ASSERT_FALSE(engine->PrepWrite(tf.fd, buf, sizeof(buf), 1024, nullptr));
+    ASSERT_EQ(EAGAIN, errno);
+
+    ASSERT_EQ(2, engine->Submit());
+    ASSERT_EQ(2, engine->Reap(2));
+    ASSERT_TRUE(engine->PrepWrite(tf.fd, buf, sizeof(buf), 1024, nullptr));
+}
+
+TEST_P(AsyncIOEngineTest, CallbackRequeues) {
+    auto engine = AsyncIOEngine::Create(1, GetParam());
+    ASSERT_NE(nullptr, engine) << strerror(errno);
+
+    TemporaryFile tf;
+    std::string data(4096, 'x');
+    int remaining = 16;
+    AsyncIOEngine::Callback write_next = [&](int64_t result) {
+        ASSERT_EQ(4096, result);
+        if (--remaining > 0) {
+            ASSERT_TRUE(engine->PrepWrite(tf.fd, data.data(), data.size(), remaining * 4096,
+                                          write_next));
+            ASSERT_EQ(1, engine->Submit());
+        }
+    };
+    ASSERT_TRUE(engine->PrepWrite(tf.fd, data.data(), data.size(), 0, write_next));
+    ASSERT_EQ(1, engine->Submit());
+    while (remaining > 0) {
+        ASSERT_EQ(1, engine->Reap(1));
+    }
+}
+
+TEST_P(AsyncIOEngineTest, BadFd) {
+    auto engine = AsyncIOEngine::Create(1, GetParam());
+    ASSERT_NE(nullptr, engine) << strerror(errno);
+
+    char buf[512];
+    int64_t error = 0;
+    ASSERT_TRUE(engine->PrepRead(-1, buf, sizeof(buf), 0, [&](int64_t result) { error = result; }));
+    ASSERT_GE(engine->Submit(), 0);
+    ASSERT_EQ(1, engine->Reap(1));
+    ASSERT_EQ(-EBADF, error);
+}
+
+TEST_P(AsyncIOEngineTest, ReapTimeout) {
+    auto engine = AsyncIOEngine::Create(1, GetParam());
+    ASSERT_NE(nullptr, engine) << strerror(errno);
+
+    // Nothing in flight: returns straight away rather than waiting forever.
+    ASSERT_EQ(0, engine->Reap(1));
+
+    if (engine->backend() != AsyncIOEngine::Backend::kIoUring) {
+        GTEST_SKIP() << "Kernel aio completes pipe reads synchronously, skipping";
+    }
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    char c;
+    ASSERT_TRUE(engine->PrepRead(fds[0], &c, 1, 0, nullptr));
+    ASSERT_EQ(1, engine->Submit());
+    timespec timeout = {0, 10 * 1000 * 1000};
+    ASSERT_EQ(0, engine->Reap(1, &timeout));
+    ASSERT_EQ(1, write(fds[1], "!", 1));
+    ASSERT_EQ(1, engine->Reap(1));
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(AsyncIOEngine, RegisterBuffers) {
+    auto engine = AsyncIOEngine::Create(4, AsyncIOEngine::Backend::kIoUring);
+    ASSERT_NE(nullptr, engine) << strerror(errno);
+
+    std::vector<char> pool(4 * 4096, 'r');
+    ASSERT_TRUE(engine->RegisterBuffers({{pool.data(), pool.size()}})) << strerror(errno);
+
+    TemporaryFile tf;
+    int done = 0;
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(engine->PrepWrite(tf.fd, &pool[i * 4096], 4096, i * 4096,
+                                      [&](int64_t result) {
+                                          EXPECT_EQ(4096, result);
+                                          ++done;
+                                      }));
+    }
+    ASSERT_EQ(4, engine->Submit());
+    ASSERT_EQ(4, engine->Reap(4));
+    ASSERT_EQ(4, done);
+
+    std::string contents;
+    ASSERT_TRUE(android::base::ReadFileToString(tf.path, &contents));
+    ASSERT_EQ(std::string(pool.begin(), pool.end()), contents);
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, AsyncIOEngineTest,
+                         ::testing::Values(AsyncIOEngine::Backend::kAio,
+                                           AsyncIOEngine::Backend::kIoUring));
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <time.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace android {
+namespace asyncio {
+
+/**
+ * Queues reads and writes, submits them to the kernel in batches, and runs a
+ * callback for each one as it completes.
+ *
+ * Completions are only ever reaped, and their callbacks only ever run, from
+ * Reap(). The callbacks may queue more requests. An engine isn't thread safe:
+ * it is meant to be driven by a single thread, typically an epoll loop
+ * watching event_fd().
+ */
+class AsyncIOEngine {
+  public:
+    enum class Backend {
+        // Kernel aio, through io_submit(2) and io_getevents(2).
+        kAio,
+        // io_uring, falling back to kernel aio when the kernel doesn't support it.
+        kIoUring,
+    };
+
+    // Called with the number of bytes transferred, or a negative errno.
+    using Callback = std::function<void(int64_t result)>;
+
+    // Creates an engine that can have up to queue_depth requests queued or in flight.
+    // Returns nullptr and sets errno on failure.
+    static std::unique_ptr<AsyncIOEngine> Create(unsigned queue_depth,
+                                                 Backend backend = Backend::kAio);
+
+    virtual ~AsyncIOEngine();
+
+    // Queues a request to be sent by the next Submit(). Returns false, with errno
+    // set to EAGAIN, when queue_depth requests are already queued or in flight.
+    bool PrepRead(int fd, void* buf, size_t len, uint64_t offset, Callback callback);
+    bool PrepWrite(int fd, const void* buf, size_t len, uint64_t offset, Callback callback);
+
+    // Sends the queued requests to the kernel. Returns the number of requests that were
+    // sent, or -1 with errno set. A request the kernel refuses completes with the error
+    // instead, the next time completions are reaped.
+    int Submit();
+
+    // Runs the callbacks of completed requests, first waiting until min_completions of them
+    // are available or the timeout expires. A null timeout waits forever. Returns the number
+    // of callbacks that were run, or -1 with errno set.
+    int Reap(unsigned min_completions = 0, const timespec* timeout = nullptr);
+
+    // Registers buffers that requests will be made into. Backends that support it avoid
+    // mapping those buffers in for each request. Replaces any earlier registration.
+    virtual bool RegisterBuffers(const std::vector<iovec>& buffers);
+
+    // Becomes readable when there are completions to reap.
+    int event_fd() const { return event_fd_; }
+
+    Backend backend() const { return backend_; }
+    unsigned queue_depth() const { return queue_depth_; }
+    // The number of requests that are queued or in flight.
+    unsigned pending() const { return queue_depth_ - free_slots_.size(); }
+
+  protected:
+    struct Request {
+        int fd;
+        bool read;
+        void* buf;
+        size_t len;
+        uint64_t offset;
+        Callback callback;
+    };
+
+    AsyncIOEngine(Backend backend, unsigned queue_depth, int event_fd);
+
+    // Hands the request in the given slot to the kernel the next time it is submitted.
+    virtual bool Queue(unsigned slot) = 0;
+    // Sends the queued requests to the kernel, returning how many of them it accepted.
+    // Completes the request that it refused, if any, with the error.
+    virtual int SubmitQueued() = 0;
+    // Fetches up to max completions, waiting for min of them as Reap() does, and calls
+    // Complete() for each one.
+    virtual int ReapCompletions(unsigned min, unsigned max, const timespec* timeout) = 0;
+
+    // Records the completion of the request in the given slot, to be delivered once the
+    // backend is done reaping.
+    void Complete(unsigned slot, int64_t result);
+
+    Request& request(unsigned slot) { return requests_[slot]; }
+
+  private:
+    bool Prep(int fd, bool read, void* buf, size_t len, uint64_t offset, Callback callback);
+
+    Backend backend_;
+    unsigned queue_depth_;
+    int event_fd_;
+
+    std::vector<Request> requests_;
+    std::vector<unsigned> free_slots_;
+    std::vector<std::pair<unsigned, int64_t>> completed_;
+    // Requests prepared but not yet handed to the kernel, and requests the kernel has.
+    unsigned queued_ = 0;
+    unsigned in_flight_ = 0;
+};
+
+}  // namespace asyncio
+}  // namespace android
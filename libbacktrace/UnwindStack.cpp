@@ -42,6 +42,14 @@
 
 extern "C" char* __cxa_demangle(const char*, char*, size_t*, int*);
 
+void Backtrace::SetGlobalElfCache(bool enable) {
+  unwindstack::Elf::SetCachingEnabled(enable);
+}
+
+void Backtrace::SetGlobalElfCacheMemoryBudget(uint64_t bytes) {
+  unwindstack::Elf::SetCacheMemoryBudget(bytes);
+}
+
 bool Backtrace::Unwind(unwindstack::Regs* regs, BacktraceMap* back_map,
                        std::vector<backtrace_frame_data_t>* frames, size_t num_ignore_frames,
                        std::vector<std::string>* skip_names, BacktraceUnwindError* error) {
@@ -114,6 +114,10 @@ class Backtrace {
 
   static void SetGlobalElfCache(bool enable);
 
+  // Limits the total size of the elf files kept by the global elf cache,
+  // dropping the least recently used ones. Zero means no limit.
+  static void SetGlobalElfCacheMemoryBudget(uint64_t bytes);
+
   // Create the correct Backtrace object based on what is to be unwound.
   // If pid < 0 or equals the current pid, then the Backtrace object
   // corresponds to the current process.
@@ -42,6 +42,8 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <atomic>
+
 #include <android-base/properties.h>
 #include <android-base/unique_fd.h>
 
@@ -57,8 +59,8 @@
 #define MIN_MEMFD_VENDOR_API_LEVEL 29
 #define MIN_MEMFD_VENDOR_API_LEVEL_CHAR 'Q'
 
-/* ashmem identity */
-static dev_t __ashmem_rdev;
+/* ashmem identity, only ever set once it is known */
+static std::atomic<dev_t> __ashmem_rdev;
 /*
  * If we trigger a signal handler in the middle of locked activity and the
  * signal handler calls ashmem, we could get into a deadlock state.
@@ -266,23 +268,18 @@ static int __ashmem_open()
     return fd;
 }
 
-/* Make sure file descriptor references ashmem, negative number means false */
-static int __ashmem_is_ashmem(int fd, int fatal)
+/*
+ * Make sure the file descriptor st was fstat()ed from references ashmem,
+ * negative number means false
+ */
+static int __ashmem_is_ashmem_stat(int fd, const struct stat& st, int fatal)
 {
-    dev_t rdev;
-    struct stat st;
-
-    if (fstat(fd, &st) < 0) {
-        return -1;
-    }
-
-    rdev = 0; /* Too much complexity to sniff __ashmem_rdev */
+    dev_t rdev = 0; /* Too much complexity to sniff __ashmem_rdev */
     if (S_ISCHR(st.st_mode) && st.st_rdev) {
-        pthread_mutex_lock(&__ashmem_lock);
-        rdev = __ashmem_rdev;
-        if (rdev) {
-            pthread_mutex_unlock(&__ashmem_lock);
-        } else {
+        /* Once known, the identity is checked without taking the lock */
+        rdev = __ashmem_rdev.load(std::memory_order_relaxed);
+        if (!rdev) {
+            pthread_mutex_lock(&__ashmem_lock);
             int fd = __ashmem_open_locked();
             if (fd < 0) {
                 pthread_mutex_unlock(&__ashmem_lock);
@@ -317,16 +314,28 @@ static int __ashmem_is_ashmem(int fd, int fatal)
     return -1;
 }
 
+/* Make sure file descriptor references ashmem, negative number means false */
+static int __ashmem_is_ashmem(int fd, int fatal)
+{
+    struct stat st;
+
+    if (fstat(fd, &st) < 0) {
+        return -1;
+    }
+
+    return __ashmem_is_ashmem_stat(fd, st, fatal);
+}
+
 static int __ashmem_check_failure(int fd, int result)
 {
     if (result == -1 && errno == ENOTTY) __ashmem_is_ashmem(fd, 1);
     return result;
 }
 
-static bool memfd_is_ashmem(int fd) {
+static bool memfd_is_ashmem_stat(int fd, const struct stat& st) {
     static bool fd_check_error_once = false;
 
-    if (__ashmem_is_ashmem(fd, 0) == 0) {
+    if (__ashmem_is_ashmem_stat(fd, st, 0) == 0) {
         if (!fd_check_error_once) {
             ALOGE("memfd: memfd expected but ashmem fd used - please use libcutils.\n");
             fd_check_error_once = true;
@@ -338,6 +347,16 @@ static bool memfd_is_ashmem(int fd) {
     return false;
 }
 
+static bool memfd_is_ashmem(int fd) {
+    struct stat st;
+
+    if (fstat(fd, &st) < 0) {
+        return false;
+    }
+
+    return memfd_is_ashmem_stat(fd, st);
+}
+
 int ashmem_valid(int fd)
 {
     if (has_memfd_support() && !memfd_is_ashmem(fd)) {
@@ -468,14 +487,20 @@ int ashmem_unpin_region(int fd, size_t offset, size_t len)
 
 int ashmem_get_size_region(int fd)
 {
-    if (has_memfd_support() && !memfd_is_ashmem(fd)) {
+    if (has_memfd_support()) {
         struct stat sb;
 
+        /* The same fstat() tells memfd from ashmem and gives the size */
         if (fstat(fd, &sb) == -1) {
             ALOGE("ashmem_get_size_region(%d): fstat failed: %s\n", fd, strerror(errno));
             return -1;
         }
 
+        if (memfd_is_ashmem_stat(fd, sb)) {
+            return __ashmem_check_failure(fd,
+                                          TEMP_FAILURE_RETRY(ioctl(fd, ASHMEM_GET_SIZE, NULL)));
+        }
+
         if (debug_log) {
             ALOGD("ashmem_get_size_region(%d): %d\n", fd, static_cast<int>(sb.st_size));
         }
@@ -32,8 +32,16 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
+#include <android-base/file.h>
 #include <android-base/strings.h>
 #include <log/log.h>
 #include <private/android_filesystem_config.h>
@@ -254,113 +262,205 @@ static bool is_partition(const std::string& path) {
     return false;
 }
 
-// alias prefixes of "<partition>/<stuff>" to "system/<partition>/<stuff>" or
-// "system/<partition>/<stuff>" to "<partition>/<stuff>"
-static bool fs_config_cmp(bool dir, const char* prefix, size_t len, const char* path, size_t plen) {
+// Massages a pattern so that it can be used by fnmatch, where directories have
+// to end with /.
+static std::string fs_config_pattern(bool dir, const char* prefix, size_t len) {
     std::string pattern(prefix, len);
-    std::string input(path, plen);
-
-    // Massage pattern and input so that they can be used by fnmatch where
-    // directories have to end with /.
-    if (dir) {
-        if (!EndsWith(input, "/")) {
-            input.append("/");
-        }
-
-        if (!EndsWith(pattern, "/*")) {
-            if (EndsWith(pattern, "/")) {
-                pattern.append("*");
-            } else {
-                pattern.append("/*");
-            }
+    if (dir && !EndsWith(pattern, "/*")) {
+        if (EndsWith(pattern, "/")) {
+            pattern.append("*");
+        } else {
+            pattern.append("/*");
         }
     }
+    return pattern;
+}
 
-    // no FNM_PATHNAME is set in order to match a/b/c/d with a/*
-    // FNM_ESCAPE is set in order to prevent using \\? and \\* and maintenance issues.
-    const int fnm_flags = FNM_NOESCAPE;
-    if (fnmatch(pattern.c_str(), input.c_str(), fnm_flags) == 0) return true;
+static std::string fs_config_input(bool dir, const char* path, size_t plen) {
+    std::string input(path, plen);
+    if (dir && !EndsWith(input, "/")) {
+        input.append("/");
+    }
+    return input;
+}
 
-    // Check match between logical partition's files and patterns.
+// If input is a logical partition's file, e.g. "system/vendor/<stuff>", sets
+// alias to its path within the partition, e.g. "vendor/<stuff>".
+static bool fs_config_alias(const std::string& input, std::string* alias) {
     static constexpr const char* kLogicalPartitions[] = {"system/product/", "system/system_ext/",
                                                          "system/vendor/", "vendor/odm/"};
     for (auto& logical_partition : kLogicalPartitions) {
         if (StartsWith(input, logical_partition)) {
             std::string input_in_partition = input.substr(input.find('/') + 1);
             if (!is_partition(input_in_partition)) continue;
-            if (fnmatch(pattern.c_str(), input_in_partition.c_str(), fnm_flags) == 0) {
-                return true;
-            }
+            *alias = std::move(input_in_partition);
+            return true;
         }
     }
     return false;
 }
+
+// no FNM_PATHNAME is set in order to match a/b/c/d with a/*
+// FNM_ESCAPE is set in order to prevent using \\? and \\* and maintenance issues.
+static constexpr int kFnmFlags = FNM_NOESCAPE;
+
+// alias prefixes of "<partition>/<stuff>" to "system/<partition>/<stuff>" or
+// "system/<partition>/<stuff>" to "<partition>/<stuff>"
+static bool fs_config_cmp(bool dir, const char* prefix, size_t len, const char* path, size_t plen) {
+    std::string pattern = fs_config_pattern(dir, prefix, len);
+    std::string input = fs_config_input(dir, path, plen);
+    if (fnmatch(pattern.c_str(), input.c_str(), kFnmFlags) == 0) return true;
+
+    // Check match between logical partition's files and patterns.
+    std::string alias;
+    return fs_config_alias(input, &alias) && fnmatch(pattern.c_str(), alias.c_str(), kFnmFlags) == 0;
+}
 #ifndef __ANDROID_VNDK__
 auto __for_testing_only__fs_config_cmp = fs_config_cmp;
 #endif
 
-void fs_config(const char* path, int dir, const char* target_out_path, unsigned* uid, unsigned* gid,
-               unsigned* mode, uint64_t* capabilities) {
-    const struct fs_path_config* pc;
-    size_t which, plen;
+namespace {
 
-    if (path[0] == '/') {
-        path++;
-    }
+struct Rule {
+    std::string pattern;
+    unsigned uid;
+    unsigned gid;
+    unsigned mode;
+    uint64_t capabilities;
+};
 
-    plen = strlen(path);
+// The rules that apply to directories or to files: those of the override files,
+// in the order of conf, then the built-in ones. Lookups try them in that order
+// and return the first match, but only those whose pattern starts with a prefix
+// of the path can match. So the literal prefixes of the patterns, the part
+// before the first wildcard, are kept sorted, and a lookup binary-searches for
+// the prefixes of the path rather than running fnmatch on every rule.
+class RuleTable {
+  public:
+    RuleTable(bool dir, const char* target_out_path) : dir_(dir) {
+        for (size_t which = 0; which < (sizeof(conf) / sizeof(conf[0])); ++which) {
+            int fd = fs_config_open(dir, which, target_out_path);
+            if (fd < 0) continue;
+            std::string data;
+            bool read = android::base::ReadFdToString(fd, &data);
+            close(fd);
+            if (read) AddRulesFromFile(conf[which][dir], data);
+        }
+
+        const struct fs_path_config* pc;
+        for (pc = dir ? android_dirs : android_files; pc->prefix; pc++) {
+            AddRule(pc->prefix, strlen(pc->prefix), pc->uid, pc->gid, pc->mode, pc->capabilities);
+        }
+        default_ = {"", pc->uid, pc->gid, pc->mode, pc->capabilities};
 
-    for (which = 0; which < (sizeof(conf) / sizeof(conf[0])); ++which) {
-        struct fs_path_config_from_file header;
+        // rules_ doesn't change from here on, so the views stay valid.
+        for (size_t i = 0; i < rules_.size(); ++i) {
+            const std::string& pattern = rules_[i].pattern;
+            index_.emplace_back(std::string_view(pattern).substr(0, pattern.find_first_of("*?[")),
+                                i);
+        }
+        std::sort(index_.begin(), index_.end());
+    }
+
+    const Rule& Find(const char* path, size_t plen) const {
+        std::string input = fs_config_input(dir_, path, plen);
+        std::string alias;
+        bool has_alias = fs_config_alias(input, &alias);
+
+        std::vector<size_t> candidates;
+        AddCandidates(input, &candidates);
+        if (has_alias) AddCandidates(alias, &candidates);
+        std::sort(candidates.begin(), candidates.end());
+
+        for (size_t i : candidates) {
+            const char* pattern = rules_[i].pattern.c_str();
+            if (fnmatch(pattern, input.c_str(), kFnmFlags) == 0 ||
+                (has_alias && fnmatch(pattern, alias.c_str(), kFnmFlags) == 0)) {
+                return rules_[i];
+            }
+        }
+        return default_;
+    }
 
-        int fd = fs_config_open(dir, which, target_out_path);
-        if (fd < 0) continue;
+  private:
+    void AddRule(const char* prefix, size_t len, unsigned uid, unsigned gid, unsigned mode,
+                 uint64_t capabilities) {
+        rules_.push_back({fs_config_pattern(dir_, prefix, len), uid, gid, mode, capabilities});
+    }
 
-        while (TEMP_FAILURE_RETRY(read(fd, &header, sizeof(header))) == sizeof(header)) {
-            char* prefix;
+    void AddRulesFromFile(const char* name, const std::string& data) {
+        size_t offset = 0;
+        while (data.size() - offset >= sizeof(fs_path_config_from_file)) {
+            struct fs_path_config_from_file header;
+            memcpy(&header, data.data() + offset, sizeof(header));
             uint16_t host_len = header.len;
             ssize_t len, remainder = host_len - sizeof(header);
             if (remainder <= 0) {
-                ALOGE("%s len is corrupted", conf[which][dir]);
+                ALOGE("%s len is corrupted", name);
                 break;
             }
-            prefix = static_cast<char*>(calloc(1, remainder));
-            if (!prefix) {
-                ALOGE("%s out of memory", conf[which][dir]);
-                break;
-            }
-            if (TEMP_FAILURE_RETRY(read(fd, prefix, remainder)) != remainder) {
-                free(prefix);
-                ALOGE("%s prefix is truncated", conf[which][dir]);
+            if (static_cast<size_t>(remainder) > data.size() - offset - sizeof(header)) {
+                ALOGE("%s prefix is truncated", name);
                 break;
             }
+            const char* prefix = data.data() + offset + sizeof(header);
             len = strnlen(prefix, remainder);
             if (len >= remainder) {  // missing a terminating null
-                free(prefix);
-                ALOGE("%s is corrupted", conf[which][dir]);
+                ALOGE("%s is corrupted", name);
                 break;
             }
-            if (fs_config_cmp(dir, prefix, len, path, plen)) {
-                free(prefix);
-                close(fd);
-                *uid = header.uid;
-                *gid = header.gid;
-                *mode = (*mode & (~07777)) | header.mode;
-                *capabilities = header.capabilities;
-                return;
-            }
-            free(prefix);
+            AddRule(prefix, len, header.uid, header.gid, header.mode, header.capabilities);
+            offset += host_len;
         }
-        close(fd);
     }
 
-    for (pc = dir ? android_dirs : android_files; pc->prefix; pc++) {
-        if (fs_config_cmp(dir, pc->prefix, strlen(pc->prefix), path, plen)) {
-            break;
+    // Adds the rules whose literal prefix is a prefix of s.
+    void AddCandidates(std::string_view s, std::vector<size_t>* candidates) const {
+        auto it = index_.begin();
+        for (size_t len = 0; len <= s.size(); ++len) {
+            std::string_view prefix = s.substr(0, len);
+            it = std::lower_bound(it, index_.end(), prefix,
+                                  [](const auto& entry, std::string_view value) {
+                                      return entry.first < value;
+                                  });
+            for (; it != index_.end() && it->first == prefix; ++it) {
+                candidates->push_back(it->second);
+            }
+            // Stop once no longer literal prefix starts with this one.
+            if (it == index_.end() || !StartsWith(it->first, prefix)) break;
         }
     }
-    *uid = pc->uid;
-    *gid = pc->gid;
-    *mode = (*mode & (~07777)) | pc->mode;
-    *capabilities = pc->capabilities;
+
+    const bool dir_;
+    std::vector<Rule> rules_;
+    Rule default_;
+    std::vector<std::pair<std::string_view, size_t>> index_;
+};
+
+}  // namespace
+
+// The override files are read once per process, for each target_out_path: image
+// builders look up every file of the image, and devices only change them on
+// updates, which restart the processes that use them.
+static const RuleTable& fs_config_rules(bool dir, const char* target_out_path) {
+    static auto& lock = *new std::mutex();
+    static auto& tables = *new std::map<std::pair<bool, std::string>, std::unique_ptr<RuleTable>>();
+
+    std::lock_guard<std::mutex> guard(lock);
+    auto& table = tables[{dir, target_out_path ? target_out_path : ""}];
+    if (!table) table.reset(new RuleTable(dir, target_out_path));
+    return *table;
+}
+
+void fs_config(const char* path, int dir, const char* target_out_path, unsigned* uid, unsigned* gid,
+               unsigned* mode, uint64_t* capabilities) {
+    if (path[0] == '/') {
+        path++;
+    }
+
+    const Rule& rule = fs_config_rules(dir, target_out_path).Find(path, strlen(path));
+    *uid = rule.uid;
+    *gid = rule.gid;
+    *mode = (*mode & (~07777)) | rule.mode;
+    *capabilities = rule.capabilities;
 }
@@ -25,6 +25,7 @@
 #include <android-base/strings.h>
 
 #include <private/android_filesystem_config.h>
+#include <private/fs_config.h>
 
 #include "fs_config.h"
 
@@ -257,3 +258,35 @@ TEST(fs_config, odm_files_alias) {
 TEST(fs_config, system_alias) {
     EXPECT_FALSE(check_fs_config_cmp(fs_config_cmp_tests));
 }
+
+// The indexed lookup in fs_config() has to pick the same rule as trying every
+// built-in rule in order. Override files only cover the partitions of the
+// images, so paths in /data only match built-in rules.
+static void check_fs_config_lookup(bool dir, const char* path) {
+    const fs_path_config* pc = dir ? __for_testing_only__android_dirs
+                                   : __for_testing_only__android_files;
+    for (; pc->prefix; ++pc) {
+        if (__for_testing_only__fs_config_cmp(dir, pc->prefix, strlen(pc->prefix), path,
+                                              strlen(path))) {
+            break;
+        }
+    }
+
+    unsigned uid, gid, mode = 0;
+    uint64_t capabilities;
+    fs_config(path, dir, nullptr, &uid, &gid, &mode, &capabilities);
+    EXPECT_EQ(pc->uid, uid) << path;
+    EXPECT_EQ(pc->gid, gid) << path;
+    EXPECT_EQ(pc->mode, mode) << path;
+    EXPECT_EQ(pc->capabilities, capabilities) << path;
+}
+
+TEST(fs_config, lookup_matches_first_rule) {
+    for (const char* path : {"data", "data/", "data/app", "data/app/com.example/base.apk",
+                             "data/misc", "data/misc/dhcp", "data/misc/wifi", "data/local",
+                             "data/local/tmp", "data/local/tmp/test", "data/media/Music",
+                             "data/media/0/DCIM", "data/nativetest64/foo/foo", "datafoo"}) {
+        check_fs_config_lookup(true, path);
+        check_fs_config_lookup(false, path);
+    }
+}
@@ -19,27 +19,63 @@
 #include <assert.h>
 #include <errno.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 
+/*
+ * The map is an open-addressing table with linear probing. The entries are
+ * stored inline, so lookups don't chase pointers and insertions don't allocate,
+ * and a parallel array holds one control byte per bucket: empty, deleted, or a
+ * few bits of the hash of the entry, so that most mismatches are rejected
+ * without touching the entry.
+ *
+ * Removed entries leave a tombstone instead of moving other entries, so that
+ * callbacks of hashmapForEach can remove entries. Tombstones are cleared when
+ * the table is rehashed.
+ */
 typedef struct Entry Entry;
 struct Entry {
     void* key;
     int hash;
     void* value;
-    Entry* next;
 };
 
+static const uint8_t kEmpty = 0;
+static const uint8_t kDeleted = 1;
+static const uint8_t kFull = 0x80;
+
 struct Hashmap {
-    Entry** buckets;
+    Entry* entries;
+    uint8_t* control;
     size_t bucketCount;
     int (*hash)(void* key);
     bool (*equals)(void* keyA, void* keyB);
     pthread_mutex_t lock;
     size_t size;
+    // Live entries plus tombstones: the buckets that aren't empty.
+    size_t used;
 };
 
+static inline uint8_t controlByte(int hash) {
+    // The top bits, since the bottom ones pick the bucket.
+    return kFull | (((unsigned int) hash) >> 25);
+}
+
+static bool allocateBuckets(Hashmap* map, size_t bucketCount) {
+    // One allocation, the entries first to keep them aligned.
+    void* block = calloc(bucketCount, sizeof(Entry) + 1);
+    if (block == NULL) {
+        return false;
+    }
+    map->entries = static_cast<Entry*>(block);
+    map->control = reinterpret_cast<uint8_t*>(map->entries + bucketCount);
+    map->bucketCount = bucketCount;
+    map->used = 0;
+    return true;
+}
+
 Hashmap* hashmapCreate(size_t initialCapacity,
         int (*hash)(void* key), bool (*equals)(void* keyA, void* keyB)) {
     assert(hash != NULL);
@@ -52,14 +88,13 @@ Hashmap* hashmapCreate(size_t initialCapacity,
 
     // 0.75 load factor.
     size_t minimumBucketCount = initialCapacity * 4 / 3;
-    map->bucketCount = 1;
-    while (map->bucketCount <= minimumBucketCount) {
+    size_t bucketCount = 2;
+    while (bucketCount <= minimumBucketCount) {
         // Bucket count must be power of 2.
-        map->bucketCount <<= 1;
+        bucketCount <<= 1;
     }
 
-    map->buckets = static_cast<Entry**>(calloc(map->bucketCount, sizeof(Entry*)));
-    if (map->buckets == NULL) {
+    if (!allocateBuckets(map, bucketCount)) {
         free(map);
         return NULL;
     }
@@ -97,35 +132,38 @@ static inline size_t calculateIndex(size_t bucketCount, int hash) {
     return ((size_t) hash) & (bucketCount - 1);
 }
 
-static void expandIfNecessary(Hashmap* map) {
-    // If the load factor exceeds 0.75...
-    if (map->size > (map->bucketCount * 3 / 4)) {
-        // Start off with a 0.33 load factor.
-        size_t newBucketCount = map->bucketCount << 1;
-        Entry** newBuckets = static_cast<Entry**>(calloc(newBucketCount, sizeof(Entry*)));
-        if (newBuckets == NULL) {
-            // Abort expansion.
-            return;
-        }
+/**
+ * Moves the live entries to a new table, big enough to stay at most half full
+ * after one more insertion. Returns false if allocation fails, in which case the
+ * map is unchanged.
+ */
+static bool rehash(Hashmap* map) {
+    size_t newBucketCount = map->bucketCount;
+    while ((map->size + 1) * 2 > newBucketCount) {
+        newBucketCount <<= 1;
+    }
+
+    Entry* oldEntries = map->entries;
+    uint8_t* oldControl = map->control;
+    size_t oldBucketCount = map->bucketCount;
+    if (!allocateBuckets(map, newBucketCount)) {
+        return false;
+    }
 
-        // Move over existing entries.
-        size_t i;
-        for (i = 0; i < map->bucketCount; i++) {
-            Entry* entry = map->buckets[i];
-            while (entry != NULL) {
-                Entry* next = entry->next;
-                size_t index = calculateIndex(newBucketCount, entry->hash);
-                entry->next = newBuckets[index];
-                newBuckets[index] = entry;
-                entry = next;
+    for (size_t i = 0; i < oldBucketCount; i++) {
+        if (oldControl[i] & kFull) {
+            size_t index = calculateIndex(newBucketCount, oldEntries[i].hash);
+            while (map->control[index] != kEmpty) {
+                index = (index + 1) & (newBucketCount - 1);
             }
+            map->entries[index] = oldEntries[i];
+            map->control[index] = oldControl[i];
+            map->used++;
         }
-
-        // Copy over internals.
-        free(map->buckets);
-        map->buckets = newBuckets;
-        map->bucketCount = newBucketCount;
     }
+
+    free(oldEntries);
+    return true;
 }
 
 void hashmapLock(Hashmap* map) {
@@ -137,16 +175,7 @@ void hashmapUnlock(Hashmap* map) {
 }
 
 void hashmapFree(Hashmap* map) {
-    size_t i;
-    for (i = 0; i < map->bucketCount; i++) {
-        Entry* entry = map->buckets[i];
-        while (entry != NULL) {
-            Entry* next = entry->next;
-            free(entry);
-            entry = next;
-        }
-    }
-    free(map->buckets);
+    free(map->entries);
     pthread_mutex_destroy(&map->lock);
     free(map);
 }
@@ -166,109 +195,88 @@ int hashmapHash(void* key, size_t keySize) {
     return h;
 }
 
-static Entry* createEntry(void* key, int hash, void* value) {
-    Entry* entry = static_cast<Entry*>(malloc(sizeof(Entry)));
-    if (entry == NULL) {
-        return NULL;
-    }
-    entry->key = key;
-    entry->hash = hash;
-    entry->value = value;
-    entry->next = NULL;
-    return entry;
-}
-
-static inline bool equalKeys(void* keyA, int hashA, void* keyB, int hashB,
-        bool (*equals)(void*, void*)) {
-    if (keyA == keyB) {
-        return true;
-    }
-    if (hashA != hashB) {
-        return false;
+/**
+ * Returns the index of the bucket holding the key, or -1. There is always at
+ * least one empty bucket, which ends the probe.
+ */
+static ssize_t findIndex(Hashmap* map, void* key, int hash) {
+    const uint8_t control = controlByte(hash);
+    size_t mask = map->bucketCount - 1;
+    for (size_t index = calculateIndex(map->bucketCount, hash);; index = (index + 1) & mask) {
+        uint8_t c = map->control[index];
+        if (c == kEmpty) {
+            return -1;
+        }
+        if (c == control) {
+            Entry* entry = &map->entries[index];
+            if (entry->key == key || (entry->hash == hash && map->equals(entry->key, key))) {
+                return index;
+            }
+        }
     }
-    return equals(keyA, keyB);
 }
 
 void* hashmapPut(Hashmap* map, void* key, void* value) {
     int hash = hashKey(map, key);
-    size_t index = calculateIndex(map->bucketCount, hash);
-
-    Entry** p = &(map->buckets[index]);
-    while (true) {
-        Entry* current = *p;
-
-        // Add a new entry.
-        if (current == NULL) {
-            *p = createEntry(key, hash, value);
-            if (*p == NULL) {
-                errno = ENOMEM;
-                return NULL;
-            }
-            map->size++;
-            expandIfNecessary(map);
-            return NULL;
-        }
 
-        // Replace existing entry.
-        if (equalKeys(current->key, current->hash, key, hash, map->equals)) {
-            void* oldValue = current->value;
-            current->value = value;
-            return oldValue;
-        }
+    // Replace existing entry.
+    ssize_t existing = findIndex(map, key, hash);
+    if (existing >= 0) {
+        void* oldValue = map->entries[existing].value;
+        map->entries[existing].value = value;
+        return oldValue;
+    }
 
-        // Move to next entry.
-        p = &current->next;
+    // Keep the load factor, tombstones included, under 0.75. If the table can't
+    // grow, carry on as long as an empty bucket is left to end probes.
+    if ((map->used + 1) * 4 > map->bucketCount * 3 && !rehash(map) &&
+        map->used + 1 >= map->bucketCount) {
+        errno = ENOMEM;
+        return NULL;
     }
-}
 
-void* hashmapGet(Hashmap* map, void* key) {
-    int hash = hashKey(map, key);
+    // Add a new entry, reusing the first tombstone on the way.
+    size_t mask = map->bucketCount - 1;
     size_t index = calculateIndex(map->bucketCount, hash);
-
-    Entry* entry = map->buckets[index];
-    while (entry != NULL) {
-        if (equalKeys(entry->key, entry->hash, key, hash, map->equals)) {
-            return entry->value;
-        }
-        entry = entry->next;
+    while (map->control[index] & kFull) {
+        index = (index + 1) & mask;
     }
-
+    if (map->control[index] == kEmpty) {
+        map->used++;
+    }
+    map->entries[index].key = key;
+    map->entries[index].hash = hash;
+    map->entries[index].value = value;
+    map->control[index] = controlByte(hash);
+    map->size++;
     return NULL;
 }
 
-void* hashmapRemove(Hashmap* map, void* key) {
-    int hash = hashKey(map, key);
-    size_t index = calculateIndex(map->bucketCount, hash);
-
-    // Pointer to the current entry.
-    Entry** p = &(map->buckets[index]);
-    Entry* current;
-    while ((current = *p) != NULL) {
-        if (equalKeys(current->key, current->hash, key, hash, map->equals)) {
-            void* value = current->value;
-            *p = current->next;
-            free(current);
-            map->size--;
-            return value;
-        }
+void* hashmapGet(Hashmap* map, void* key) {
+    ssize_t index = findIndex(map, key, hashKey(map, key));
+    return index >= 0 ? map->entries[index].value : NULL;
+}
 
-        p = &current->next;
+void* hashmapRemove(Hashmap* map, void* key) {
+    ssize_t index = findIndex(map, key, hashKey(map, key));
+    if (index < 0) {
+        return NULL;
     }
 
-    return NULL;
+    void* value = map->entries[index].value;
+    map->control[index] = kDeleted;
+    map->size--;
+    return value;
 }
 
 void hashmapForEach(Hashmap* map, bool (*callback)(void* key, void* value, void* context),
                     void* context) {
-    size_t i;
-    for (i = 0; i < map->bucketCount; i++) {
-        Entry* entry = map->buckets[i];
-        while (entry != NULL) {
-            Entry *next = entry->next;
+    for (size_t i = 0; i < map->bucketCount; i++) {
+        if (map->control[i] & kFull) {
+            Entry* entry = &map->entries[i];
             if (!callback(entry->key, entry->value, context)) {
                 return;
             }
-            entry = next;
         }
     }
 }
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cutils/hashmap.h>
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <set>
+
+static int int_hash(void* key) {
+    return static_cast<int>(reinterpret_cast<intptr_t>(key));
+}
+
+// Every key in the same bucket, to exercise probing.
+static int bad_hash(void*) {
+    return 42;
+}
+
+static bool int_equals(void* a, void* b) {
+    return a == b;
+}
+
+static void* Key(intptr_t i) {
+    return reinterpret_cast<void*>(i);
+}
+
+static void* Value(intptr_t i) {
+    return reinterpret_cast<void*>(i * 10);
+}
+
+TEST(hashmap, put_get_remove) {
+    for (auto hash : {int_hash, bad_hash}) {
+        Hashmap* map = hashmapCreate(0, hash, int_equals);
+        ASSERT_NE(nullptr, map);
+
+        for (intptr_t i = 1; i <= 1000; i++) {
+            ASSERT_EQ(nullptr, hashmapPut(map, Key(i), Value(i)));
+        }
+        ASSERT_EQ(Value(1), hashmapPut(map, Key(1), Value(2)));
+        ASSERT_EQ(Value(2), hashmapGet(map, Key(1)));
+        for (intptr_t i = 2; i <= 1000; i++) {
+            ASSERT_EQ(Value(i), hashmapGet(map, Key(i)));
+        }
+        ASSERT_EQ(nullptr, hashmapGet(map, Key(1001)));
+
+        for (intptr_t i = 1; i <= 1000; i += 2) {
+            ASSERT_EQ(i == 1 ? Value(2) : Value(i), hashmapRemove(map, Key(i)));
+        }
+        ASSERT_EQ(nullptr, hashmapRemove(map, Key(1)));
+        for (intptr_t i = 1; i <= 1000; i++) {
+            ASSERT_EQ(i % 2 == 0 ? Value(i) : nullptr, hashmapGet(map, Key(i)));
+        }
+
+        hashmapFree(map);
+    }
+}
+
+TEST(hashmap, reuses_removed_buckets) {
+    Hashmap* map = hashmapCreate(4, int_hash, int_equals);
+    ASSERT_NE(nullptr, map);
+
+    // Churn through many more keys than the map ever holds at once.
+    for (intptr_t i = 1; i <= 10000; i++) {
+        ASSERT_EQ(nullptr, hashmapPut(map, Key(i), Value(i)));
+        if (i > 3) {
+            ASSERT_EQ(Value(i - 3), hashmapRemove(map, Key(i - 3)));
+        }
+    }
+    for (intptr_t i = 9998; i <= 10000; i++) {
+        ASSERT_EQ(Value(i), hashmapGet(map, Key(i)));
+    }
+
+    hashmapFree(map);
+}
+
+struct ForEachContext {
+    Hashmap* map;
+    std::set<intptr_t>* seen;
+};
+
+static bool remove_while_iterating(void* key, void*, void* context) {
+    ForEachContext* ctxt = static_cast<ForEachContext*>(context);
+    EXPECT_TRUE(ctxt->seen->insert(reinterpret_cast<intptr_t>(key)).second);
+    hashmapRemove(ctxt->map, key);
+    return true;
+}
+
+TEST(hashmap, for_each_remove) {
+    for (auto hash : {int_hash, bad_hash}) {
+        Hashmap* map = hashmapCreate(0, hash, int_equals);
+        ASSERT_NE(nullptr, map);
+        for (intptr_t i = 1; i <= 100; i++) {
+            hashmapPut(map, Key(i), Value(i));
+        }
+
+        // Every entry is visited exactly once, even when the callback removes it.
+        std::set<intptr_t> seen;
+        ForEachContext ctxt = {map, &seen};
+        hashmapForEach(map, remove_while_iterating, &ctxt);
+        ASSERT_EQ(100U, seen.size());
+        for (intptr_t i = 1; i <= 100; i++) {
+            ASSERT_EQ(nullptr, hashmapGet(map, Key(i)));
+        }
+
+        hashmapFree(map);
+    }
+}
@@ -17,6 +17,7 @@
 #ifndef __CUTILS_STR_PARMS_H
 #define __CUTILS_STR_PARMS_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <sys/cdefs.h>
 
@@ -55,6 +56,31 @@ char *str_parms_to_str(struct str_parms *str_parms);
 /* debug */
 void str_parms_dump(struct str_parms *str_parms);
 
+// The str_parms_view functions read a "key=value;key=value" string in place, without copying or
+// allocating, for callers that only need to look values up. They find the same pairs as
+// str_parms_create_str on the same string: empty pairs and pairs with an empty key are skipped,
+// a key without '=' has an empty value, and the last of duplicate keys wins.
+
+// One pair of the string: neither the key nor the value is NUL-terminated.
+struct str_parms_pair {
+    const char *key;
+    size_t key_len;
+    const char *value;
+    size_t value_len;
+};
+
+// Fills in 'pair' with the next pair at or after '*cursor', which starts out as the string, and
+// moves '*cursor' past it. Returns zero, leaving 'pair' untouched, once there are no more pairs.
+// Duplicate keys are returned as often as they appear.
+int str_parms_view_next(const char **cursor, struct str_parms_pair *pair);
+
+// Like str_parms_has_key, str_parms_get_str, str_parms_get_int and str_parms_get_float on
+// str_parms_create_str(str).
+int str_parms_view_has_key(const char *str, const char *key);
+int str_parms_view_get_str(const char *str, const char *key, char *out_val, int len);
+int str_parms_view_get_int(const char *str, const char *key, int *out_val);
+int str_parms_view_get_float(const char *str, const char *key, float *out_val);
+
 __END_DECLS
 
 #endif /* __CUTILS_STR_PARMS_H */
@@ -19,6 +19,7 @@
 
 #include <stdbool.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,6 +30,18 @@ ssize_t uevent_kernel_multicast_recv(int socket, void *buffer, size_t length);
 ssize_t uevent_kernel_multicast_uid_recv(int socket, void *buffer, size_t length, uid_t *uid);
 ssize_t uevent_kernel_recv(int socket, void *buffer, size_t length, bool require_group, uid_t *uid);
 
+#define UEVENT_MAX_BATCH 32
+
+/*
+ * Like uevent_kernel_recv(), for up to |count| (at most UEVENT_MAX_BATCH) messages with a single system
+ * call: message i is received into iovs[i], and its length is stored in
+ * lengths[i], or -1 if it didn't come from the kernel and was cleared.
+ * Waits for the first message only, and returns the number of messages
+ * received, or -1 with errno set.
+ */
+int uevent_kernel_recv_batch(int socket, const struct iovec *iovs, ssize_t *lengths,
+                             size_t count, bool require_group);
+
 #ifdef __cplusplus
 }
 #endif
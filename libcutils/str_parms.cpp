@@ -367,3 +367,131 @@ void str_parms_dump(struct str_parms *str_parms)
 {
     hashmapForEach(str_parms->map, dump_entry, str_parms);
 }
+
+int str_parms_view_next(const char **cursor, struct str_parms_pair *pair)
+{
+    const char* p = *cursor;
+    while (*p) {
+        const char* end = strchr(p, ';');
+        if (!end) end = p + strlen(p);
+        const char* eq = static_cast<const char*>(memchr(p, '=', end - p));
+        if (eq != p && end != p) {
+            pair->key = p;
+            if (eq) {
+                pair->key_len = eq - p;
+                pair->value = eq + 1;
+                pair->value_len = end - (eq + 1);
+            } else {
+                pair->key_len = end - p;
+                pair->value = end;
+                pair->value_len = 0;
+            }
+            *cursor = *end ? end + 1 : end;
+            return 1;
+        }
+        p = *end ? end + 1 : end;
+    }
+    *cursor = p;
+    return 0;
+}
+
+/*
+ * Finds the value of the last pair with the given key. Rather than splitting every pair, this
+ * only checks whether each one starts with the key.
+ */
+static bool view_find(const char *str, const char *key, struct str_parms_pair *found)
+{
+    size_t key_len = strlen(key);
+    /* No pair has such a key. */
+    if (!key_len || strpbrk(key, "=;"))
+        return false;
+
+    bool has_key = false;
+    for (const char* p = str; *p; ) {
+        if (!strncmp(p, key, key_len) && (p[key_len] == '=' || p[key_len] == ';' ||
+                                          p[key_len] == '\0')) {
+            const char* value = p[key_len] == '=' ? p + key_len + 1 : p + key_len;
+            found->key = p;
+            found->key_len = key_len;
+            found->value = value;
+            const char* end = strchr(value, ';');
+            found->value_len = end ? end - value : strlen(value);
+            has_key = true;
+        }
+        p = strchr(p, ';');
+        if (!p) break;
+        p++;
+    }
+    return has_key;
+}
+
+/*
+ * Copies the value of the given key, NUL-terminated, into buf for strtol and strtof. A value too
+ * long for buf isn't a number they would accept without overflowing anyway.
+ */
+static int view_get_number(const char *str, const char *key, char *buf, size_t len)
+{
+    struct str_parms_pair pair;
+    if (!view_find(str, key, &pair))
+        return -ENOENT;
+    if (pair.value_len >= len)
+        return -EINVAL;
+
+    memcpy(buf, pair.value, pair.value_len);
+    buf[pair.value_len] = '\0';
+    return 0;
+}
+
+int str_parms_view_has_key(const char *str, const char *key)
+{
+    struct str_parms_pair pair;
+    return view_find(str, key, &pair);
+}
+
+int str_parms_view_get_str(const char *str, const char *key, char *val, int len)
+{
+    struct str_parms_pair pair;
+    if (!view_find(str, key, &pair))
+        return -ENOENT;
+
+    if (len > 0) {
+        size_t copied = pair.value_len < static_cast<size_t>(len - 1) ? pair.value_len : len - 1;
+        memcpy(val, pair.value, copied);
+        val[copied] = '\0';
+    }
+    return pair.value_len;
+}
+
+int str_parms_view_get_int(const char *str, const char *key, int *val)
+{
+    char buf[64];
+    char *end;
+
+    int ret = view_get_number(str, key, buf, sizeof(buf));
+    if (ret)
+        return ret;
+
+    *val = (int)strtol(buf, &end, 0);
+    if (*buf != '\0' && *end == '\0')
+        return 0;
+
+    return -EINVAL;
+}
+
+int str_parms_view_get_float(const char *str, const char *key, float *val)
+{
+    char buf[64];
+    float out;
+    char *end;
+
+    int ret = view_get_number(str, key, buf, sizeof(buf));
+    if (ret)
+        return ret;
+
+    out = strtof(buf, &end);
+    if (*buf == '\0' || *end != '\0')
+        return -EINVAL;
+
+    *val = out;
+    return 0;
+}
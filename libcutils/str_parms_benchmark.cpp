@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cutils/str_parms.h>
+
+#include <dlfcn.h>
+#include <string.h>
+
+#include <atomic>
+
+#include <benchmark/benchmark.h>
+
+// Counts calls to malloc, calloc and realloc, by interposing on them, so that each benchmark can
+// report its allocations per iteration.
+static std::atomic<size_t> gAllocations;
+
+template <typename Fn>
+static Fn* RealAllocator(const char* name) {
+    return reinterpret_cast<Fn*>(dlsym(RTLD_NEXT, name));
+}
+
+extern "C" void* malloc(size_t size) {
+    static auto real_malloc = RealAllocator<void*(size_t)>("malloc");
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    return real_malloc(size);
+}
+
+// Not forwarded: dlsym itself may call calloc.
+extern "C" void* calloc(size_t count, size_t size) {
+    size_t bytes;
+    if (__builtin_mul_overflow(count, size, &bytes)) return nullptr;
+    void* p = malloc(bytes);
+    if (p) memset(p, 0, bytes);
+    return p;
+}
+
+extern "C" void* realloc(void* p, size_t size) {
+    static auto real_realloc = RealAllocator<void*(void*, size_t)>("realloc");
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    return real_realloc(p, size);
+}
+
+// Reports the allocations made since 'start', which is read before the benchmark loop.
+static void ReportAllocations(benchmark::State& state, size_t start) {
+    size_t allocations = gAllocations.load(std::memory_order_relaxed) - start;
+    state.counters["allocs"] = benchmark::Counter(allocations, benchmark::Counter::kAvgIterations);
+}
+
+// Shaped like the parameters an audio HAL gets from the framework.
+static const char kParameters[] =
+        "routing=2;input_source=1;sampling_rate=48000;format=1;channels=12;frame_count=960;"
+        "screen_state=on;bt_headset_nrec=on;bt_wbs=off;A2dpSuspended=false;"
+        "connect=128;disconnect=0;rotation=90;tty_mode=tty_off;hac=OFF";
+
+static void BM_str_parms_create_str(benchmark::State& state) {
+    size_t start = gAllocations.load(std::memory_order_relaxed);
+    for (auto _ : state) {
+        str_parms* parms = str_parms_create_str(kParameters);
+        benchmark::DoNotOptimize(parms);
+        str_parms_destroy(parms);
+    }
+    ReportAllocations(state, start);
+}
+BENCHMARK(BM_str_parms_create_str);
+
+static void BM_str_parms_get(benchmark::State& state) {
+    str_parms* parms = str_parms_create_str(kParameters);
+    char value[32];
+    int sampling_rate;
+    size_t start = gAllocations.load(std::memory_order_relaxed);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(str_parms_get_str(parms, "routing", value, sizeof(value)));
+        benchmark::DoNotOptimize(str_parms_get_int(parms, "sampling_rate", &sampling_rate));
+        benchmark::DoNotOptimize(str_parms_has_key(parms, "screen_state"));
+        benchmark::DoNotOptimize(str_parms_has_key(parms, "not_a_parameter"));
+    }
+    ReportAllocations(state, start);
+    str_parms_destroy(parms);
+}
+BENCHMARK(BM_str_parms_get);
+
+// What a set_parameters call does with str_parms: parse the string, then look up its keys.
+static void BM_str_parms_create_str_get(benchmark::State& state) {
+    char value[32];
+    int sampling_rate;
+    size_t start = gAllocations.load(std::memory_order_relaxed);
+    for (auto _ : state) {
+        str_parms* parms = str_parms_create_str(kParameters);
+        benchmark::DoNotOptimize(str_parms_get_str(parms, "routing", value, sizeof(value)));
+        benchmark::DoNotOptimize(str_parms_get_int(parms, "sampling_rate", &sampling_rate));
+        benchmark::DoNotOptimize(str_parms_has_key(parms, "screen_state"));
+        benchmark::DoNotOptimize(str_parms_has_key(parms, "not_a_parameter"));
+        str_parms_destroy(parms);
+    }
+    ReportAllocations(state, start);
+}
+BENCHMARK(BM_str_parms_create_str_get);
+
+// The same lookups on the string itself.
+static void BM_str_parms_view_get(benchmark::State& state) {
+    char value[32];
+    int sampling_rate;
+    size_t start = gAllocations.load(std::memory_order_relaxed);
+    for (auto _ : state) {
+        const char* parms = kParameters;
+        benchmark::DoNotOptimize(str_parms_view_get_str(parms, "routing", value, sizeof(value)));
+        benchmark::DoNotOptimize(str_parms_view_get_int(parms, "sampling_rate", &sampling_rate));
+        benchmark::DoNotOptimize(str_parms_view_has_key(parms, "screen_state"));
+        benchmark::DoNotOptimize(str_parms_view_has_key(parms, "not_a_parameter"));
+    }
+    ReportAllocations(state, start);
+}
+BENCHMARK(BM_str_parms_view_get);
+
+static void BM_str_parms_view_next(benchmark::State& state) {
+    size_t start = gAllocations.load(std::memory_order_relaxed);
+    for (auto _ : state) {
+        const char* cursor = kParameters;
+        str_parms_pair pair;
+        while (str_parms_view_next(&cursor, &pair)) {
+            benchmark::DoNotOptimize(pair);
+        }
+    }
+    ReportAllocations(state, start);
+}
+BENCHMARK(BM_str_parms_view_next);
+
+static void BM_str_parms_add_del(benchmark::State& state) {
+    str_parms* parms = str_parms_create_str(kParameters);
+    size_t start = gAllocations.load(std::memory_order_relaxed);
+    for (auto _ : state) {
+        str_parms_add_int(parms, "volume", 7);
+        str_parms_del(parms, "volume");
+    }
+    ReportAllocations(state, start);
+    str_parms_destroy(parms);
+}
+BENCHMARK(BM_str_parms_add_del);
+
+BENCHMARK_MAIN();
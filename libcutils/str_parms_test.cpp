@@ -17,6 +17,8 @@
 #include <cutils/str_parms.h>
 #include <gtest/gtest.h>
 
+#include <string>
+
 static void test_str_parms_str(const char* str, const char* expected) {
     str_parms* str_parms = str_parms_create_str(str);
     str_parms_add_str(str_parms, "dude", "woah");
@@ -55,3 +57,84 @@ TEST(str_parms, put_ENOMEM) {
     ASSERT_EQ(ENOMEM, errno);
     test_str_parms_str("foo=bar;baz=", "foo=bar;baz=");
 }
+
+// Rebuilds the string the way str_parms_to_str would, from the pairs the view finds.
+static void test_str_parms_view_str(const char* str, const char* expected) {
+    str_parms* str_parms = str_parms_create();
+    const char* cursor = str;
+    str_parms_pair pair;
+    while (str_parms_view_next(&cursor, &pair)) {
+        std::string key(pair.key, pair.key_len);
+        std::string value(pair.value, pair.value_len);
+        ASSERT_TRUE(str_parms_view_has_key(str, key.c_str())) << str;
+        str_parms_add_str(str_parms, key.c_str(), value.c_str());
+    }
+    ASSERT_EQ('\0', *cursor) << str;
+    ASSERT_FALSE(str_parms_view_next(&cursor, &pair)) << str;
+    char* out_str = str_parms_to_str(str_parms);
+    str_parms_destroy(str_parms);
+    ASSERT_STREQ(expected, out_str) << str;
+    free(out_str);
+}
+
+TEST(str_parms, view_smoke) {
+    test_str_parms_view_str("", "");
+    test_str_parms_view_str(";", "");
+    test_str_parms_view_str("=", "");
+    test_str_parms_view_str("=;", "");
+    test_str_parms_view_str("=bar", "");
+    test_str_parms_view_str("=bar;", "");
+    test_str_parms_view_str(";;foo=;;", "foo=");
+    test_str_parms_view_str("foo=", "foo=");
+    test_str_parms_view_str("foo=;", "foo=");
+    test_str_parms_view_str("foo=bar", "foo=bar");
+    test_str_parms_view_str("foo=bar;", "foo=bar");
+    test_str_parms_view_str("foo=bar;baz", "foo=bar;baz=");
+    test_str_parms_view_str("foo=bar;baz=", "foo=bar;baz=");
+    test_str_parms_view_str("foo=bar;baz=bat", "foo=bar;baz=bat");
+    test_str_parms_view_str("foo=bar;baz=bat;", "foo=bar;baz=bat");
+    test_str_parms_view_str("foo=bar1;baz=bat;foo=bar2", "foo=bar2;baz=bat");
+    test_str_parms_view_str("foo=bar=baz", "foo=bar=baz");
+}
+
+TEST(str_parms, view_get) {
+    const char* str = "routing=2;rate=48000;gain=0.5;name=speaker;name=earpiece;empty;bad=12x";
+    char value[8];
+    int i;
+    float f;
+
+    ASSERT_TRUE(str_parms_view_has_key(str, "empty"));
+    ASSERT_FALSE(str_parms_view_has_key(str, "rout"));
+    ASSERT_FALSE(str_parms_view_has_key(str, "routing=2"));
+
+    ASSERT_EQ(8, str_parms_view_get_str(str, "name", value, sizeof(value)));
+    ASSERT_STREQ("earpiec", value);
+    ASSERT_EQ(0, str_parms_view_get_str(str, "empty", value, sizeof(value)));
+    ASSERT_STREQ("", value);
+    ASSERT_EQ(-ENOENT, str_parms_view_get_str(str, "missing", value, sizeof(value)));
+
+    ASSERT_EQ(0, str_parms_view_get_int(str, "rate", &i));
+    ASSERT_EQ(48000, i);
+    ASSERT_EQ(-EINVAL, str_parms_view_get_int(str, "bad", &i));
+    ASSERT_EQ(-EINVAL, str_parms_view_get_int(str, "empty", &i));
+    ASSERT_EQ(-ENOENT, str_parms_view_get_int(str, "missing", &i));
+
+    ASSERT_EQ(0, str_parms_view_get_float(str, "gain", &f));
+    ASSERT_FLOAT_EQ(0.5f, f);
+    ASSERT_EQ(-EINVAL, str_parms_view_get_float(str, "name", &f));
+    ASSERT_EQ(-ENOENT, str_parms_view_get_float(str, "missing", &f));
+
+    // Agree with str_parms on every key.
+    str_parms* str_parms = str_parms_create_str(str);
+    for (const char* key : {"routing", "rate", "gain", "name", "empty", "bad", "missing"}) {
+        char expected[8];
+        int expected_ret = str_parms_get_str(str_parms, key, expected, sizeof(expected));
+        ASSERT_EQ(expected_ret, str_parms_view_get_str(str, key, value, sizeof(value))) << key;
+        if (expected_ret >= 0) ASSERT_STREQ(expected, value) << key;
+        ASSERT_EQ(str_parms_get_int(str_parms, key, &i), str_parms_view_get_int(str, key, &i))
+                << key;
+        ASSERT_EQ(str_parms_get_float(str_parms, key, &f), str_parms_view_get_float(str, key, &f))
+                << key;
+    }
+    str_parms_destroy(str_parms);
+}
@@ -169,7 +169,7 @@ void atrace_begin_body(const char* name)
 
     if (atrace_marker_fd < 0) return;
 
-    WRITE_MSG("B|%d|", "%s", name, "");
+    atrace_write_msg('B', name, false, 0);
 }
 
 void atrace_end_body()
@@ -181,7 +181,7 @@ void atrace_end_body()
 
     if (atrace_marker_fd < 0) return;
 
-    WRITE_MSG("E|%d", "%s", "", "");
+    atrace_write_msg('E', nullptr, false, 0);
 }
 
 void atrace_async_begin_body(const char* name, int32_t cookie)
@@ -193,7 +193,7 @@ void atrace_async_begin_body(const char* name, int32_t cookie)
 
     if (atrace_marker_fd < 0) return;
 
-    WRITE_MSG("S|%d|", "|%" PRId32, name, cookie);
+    atrace_write_msg('S', name, true, cookie);
 }
 
 void atrace_async_end_body(const char* name, int32_t cookie)
@@ -205,7 +205,7 @@ void atrace_async_end_body(const char* name, int32_t cookie)
 
     if (atrace_marker_fd < 0) return;
 
-    WRITE_MSG("F|%d|", "|%" PRId32, name, cookie);
+    atrace_write_msg('F', name, true, cookie);
 }
 
 void atrace_int_body(const char* name, int32_t value)
@@ -217,7 +217,7 @@ void atrace_int_body(const char* name, int32_t value)
 
     if (atrace_marker_fd < 0) return;
 
-    WRITE_MSG("C|%d|", "|%" PRId32, name, value);
+    atrace_write_msg('C', name, true, value);
 }
 
 void atrace_int64_body(const char* name, int64_t value)
@@ -229,5 +229,5 @@ void atrace_int64_body(const char* name, int64_t value)
 
     if (atrace_marker_fd < 0) return;
 
-    WRITE_MSG("C|%d|", "|%" PRId64, name, value);
+    atrace_write_msg('C', name, true, value);
 }
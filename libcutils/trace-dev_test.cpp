@@ -292,3 +292,19 @@ TEST_F(TraceDevTest, atrace_int64_body_truncated) {
   expected += android::base::StringPrintf("%.*s|17179869183", expected_len, name.c_str());
   ASSERT_STREQ(expected.c_str(), actual.c_str());
 }
+
+TEST_F(TraceDevTest, atrace_int64_body_limits) {
+  atrace_int64_body("fake_name", INT64_MIN);
+  atrace_int64_body("fake_name", -1);
+  atrace_int64_body("fake_name", 0);
+  atrace_int64_body("fake_name", INT64_MAX);
+
+  ASSERT_EQ(0, lseek(atrace_marker_fd, 0, SEEK_SET));
+
+  std::string actual;
+  ASSERT_TRUE(android::base::ReadFdToString(atrace_marker_fd, &actual));
+  std::string expected = android::base::StringPrintf(
+      "C|%d|fake_name|%" PRId64 "C|%d|fake_name|-1C|%d|fake_name|0C|%d|fake_name|%" PRId64,
+      getpid(), INT64_MIN, getpid(), getpid(), getpid(), INT64_MAX);
+  ASSERT_STREQ(expected.c_str(), actual.c_str());
+}
@@ -92,6 +92,44 @@ out:
     return -1;
 }
 
+int uevent_kernel_recv_batch(int socket, const struct iovec* iovs, ssize_t* lengths, size_t count,
+                             bool require_group) {
+    struct mmsghdr hdrs[UEVENT_MAX_BATCH];
+    struct {
+        struct sockaddr_nl addr;
+        char control[CMSG_SPACE(sizeof(struct ucred))];
+    } msgs[UEVENT_MAX_BATCH];
+    if (count > UEVENT_MAX_BATCH) count = UEVENT_MAX_BATCH;
+
+    memset(hdrs, 0, count * sizeof(hdrs[0]));
+    for (size_t i = 0; i < count; i++) {
+        struct msghdr* hdr = &hdrs[i].msg_hdr;
+        hdr->msg_name = &msgs[i].addr;
+        hdr->msg_namelen = sizeof(msgs[i].addr);
+        hdr->msg_iov = const_cast<struct iovec*>(&iovs[i]);
+        hdr->msg_iovlen = 1;
+        hdr->msg_control = msgs[i].control;
+        hdr->msg_controllen = sizeof(msgs[i].control);
+    }
+
+    /* Only the first message is waited for, the rest are whatever is queued. */
+    int n = recvmmsg(socket, hdrs, count, MSG_WAITFORONE, NULL);
+    for (int i = 0; i < n; i++) {
+        struct msghdr* hdr = &hdrs[i].msg_hdr;
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(hdr);
+        /* Same checks as uevent_kernel_recv(). */
+        if (cmsg == NULL || cmsg->cmsg_type != SCM_CREDENTIALS || msgs[i].addr.nl_pid != 0 ||
+            (require_group && msgs[i].addr.nl_groups == 0)) {
+            /* clear residual potentially malicious data */
+            bzero(iovs[i].iov_base, iovs[i].iov_len);
+            lengths[i] = -1;
+        } else {
+            lengths[i] = hdrs[i].msg_len;
+        }
+    }
+    return n;
+}
+
 int uevent_open_socket(int buf_sz, bool passcred) {
     struct sockaddr_nl addr;
     int on = passcred;
@@ -21,6 +21,7 @@
 #ifndef __SYS_CORE_ION_H
 #define __SYS_CORE_ION_H
 
+#include <stdint.h>
 #include <sys/types.h>
 #include <linux/ion.h>
 
@@ -50,6 +51,39 @@ int ion_query_get_heaps(int fd, int cnt, void* buffers);
 
 int ion_is_legacy(int fd);
 
+/**
+  * A pool that recycles the buffers of ion_alloc_fd, for clients that keep
+  * allocating and freeing buffers of the same few sizes. Buffers returned to
+  * the pool with ion_pool_free_fd are handed out again by ion_pool_alloc_fd
+  * for the same page-rounded length, heap mask and flags, without an ioctl.
+  * Their contents are not cleared, and they must no longer be shared with
+  * anyone else when they are returned.
+  *
+  * Buffers that stay in the pool for longer than idle_ms (unless it is 0) are
+  * closed, as are the least recently returned ones beyond max_cached_bytes.
+  * The pool doesn't own the ion fd, which must stay open until
+  * ion_pool_destroy.
+  */
+struct ion_pool;
+
+struct ion_pool_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t trimmed;
+    size_t cached_buffers;
+    size_t cached_bytes;
+};
+
+struct ion_pool* ion_pool_create(int fd, size_t max_cached_bytes, unsigned int idle_ms);
+void ion_pool_destroy(struct ion_pool* pool);
+int ion_pool_alloc_fd(struct ion_pool* pool, size_t len, unsigned int heap_mask,
+                      unsigned int flags, int* handle_fd);
+int ion_pool_free_fd(struct ion_pool* pool, int handle_fd, size_t len, unsigned int heap_mask,
+                     unsigned int flags);
+/* Closes the idle buffers, and the least recently returned ones beyond keep_bytes. */
+void ion_pool_trim(struct ion_pool* pool, size_t keep_bytes);
+int ion_pool_get_stats(struct ion_pool* pool, struct ion_pool_stats* stats);
+
 __END_DECLS
 
 #endif /* __SYS_CORE_ION_H */
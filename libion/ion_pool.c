@@ -0,0 +1,207 @@
+/*
+ *  ion_pool.c
+ *
+ * A pool that recycles ion buffers
+ *
+ * Copyright 2019 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <ion/ion.h>
+
+struct ion_pool_buffer {
+    struct ion_pool_buffer* next;
+    int fd;
+    size_t len;
+    unsigned int heap_mask;
+    unsigned int flags;
+    uint64_t freed_ns;
+};
+
+struct ion_pool {
+    int ion_fd;
+    size_t max_cached_bytes;
+    uint64_t idle_ns;
+    pthread_mutex_t lock;
+    /* Most recently freed first. */
+    struct ion_pool_buffer* buffers;
+    struct ion_pool_stats stats;
+};
+
+static uint64_t ion_pool_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static size_t ion_pool_round_len(size_t len) {
+    size_t page_size = getpagesize();
+    return (len + page_size - 1) & ~(page_size - 1);
+}
+
+/*
+ * Unlinks the buffers that have been idle for too long, and then the least
+ * recently freed ones until no more than keep_bytes are cached. Returns them
+ * as a list, to be closed once the lock is released.
+ */
+static struct ion_pool_buffer* ion_pool_unlink_trimmed(struct ion_pool* pool, size_t keep_bytes,
+                                                       uint64_t now_ns) {
+    struct ion_pool_buffer* trimmed = NULL;
+    size_t kept_bytes = 0;
+    struct ion_pool_buffer** link = &pool->buffers;
+    while (*link) {
+        struct ion_pool_buffer* buffer = *link;
+        bool idle = pool->idle_ns && (now_ns - buffer->freed_ns) > pool->idle_ns;
+        if (idle || kept_bytes + buffer->len > keep_bytes) {
+            *link = buffer->next;
+            pool->stats.cached_buffers--;
+            pool->stats.cached_bytes -= buffer->len;
+            pool->stats.trimmed++;
+            buffer->next = trimmed;
+            trimmed = buffer;
+        } else {
+            kept_bytes += buffer->len;
+            link = &buffer->next;
+        }
+    }
+    return trimmed;
+}
+
+static void ion_pool_close_buffers(struct ion_pool_buffer* buffers) {
+    while (buffers) {
+        struct ion_pool_buffer* next = buffers->next;
+        close(buffers->fd);
+        free(buffers);
+        buffers = next;
+    }
+}
+
+struct ion_pool* ion_pool_create(int fd, size_t max_cached_bytes, unsigned int idle_ms) {
+    struct ion_pool* pool = calloc(1, sizeof(*pool));
+    if (!pool) return NULL;
+
+    pool->ion_fd = fd;
+    pool->max_cached_bytes = max_cached_bytes;
+    pool->idle_ns = (uint64_t)idle_ms * 1000000;
+    pthread_mutex_init(&pool->lock, NULL);
+    return pool;
+}
+
+void ion_pool_destroy(struct ion_pool* pool) {
+    if (!pool) return;
+
+    ion_pool_close_buffers(pool->buffers);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+int ion_pool_alloc_fd(struct ion_pool* pool, size_t len, unsigned int heap_mask,
+                      unsigned int flags, int* handle_fd) {
+    if (!pool || !handle_fd) return -EINVAL;
+
+    len = ion_pool_round_len(len);
+    uint64_t now_ns = ion_pool_now_ns();
+
+    pthread_mutex_lock(&pool->lock);
+    struct ion_pool_buffer* trimmed = ion_pool_unlink_trimmed(pool, pool->max_cached_bytes, now_ns);
+    struct ion_pool_buffer* found = NULL;
+    for (struct ion_pool_buffer** link = &pool->buffers; *link; link = &(*link)->next) {
+        struct ion_pool_buffer* buffer = *link;
+        if (buffer->len == len && buffer->heap_mask == heap_mask && buffer->flags == flags) {
+            *link = buffer->next;
+            pool->stats.cached_buffers--;
+            pool->stats.cached_bytes -= buffer->len;
+            found = buffer;
+            break;
+        }
+    }
+    if (found) {
+        pool->stats.hits++;
+    } else {
+        pool->stats.misses++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    ion_pool_close_buffers(trimmed);
+
+    if (found) {
+        *handle_fd = found->fd;
+        free(found);
+        return 0;
+    }
+    return ion_alloc_fd(pool->ion_fd, len, 0, heap_mask, flags, handle_fd);
+}
+
+int ion_pool_free_fd(struct ion_pool* pool, int handle_fd, size_t len, unsigned int heap_mask,
+                     unsigned int flags) {
+    if (!pool || handle_fd < 0) return -EINVAL;
+
+    len = ion_pool_round_len(len);
+    if (len > pool->max_cached_bytes) {
+        pthread_mutex_lock(&pool->lock);
+        pool->stats.trimmed++;
+        pthread_mutex_unlock(&pool->lock);
+        close(handle_fd);
+        return 0;
+    }
+
+    struct ion_pool_buffer* buffer = malloc(sizeof(*buffer));
+    if (!buffer) {
+        close(handle_fd);
+        return -ENOMEM;
+    }
+    buffer->fd = handle_fd;
+    buffer->len = len;
+    buffer->heap_mask = heap_mask;
+    buffer->flags = flags;
+    buffer->freed_ns = ion_pool_now_ns();
+
+    pthread_mutex_lock(&pool->lock);
+    buffer->next = pool->buffers;
+    pool->buffers = buffer;
+    pool->stats.cached_buffers++;
+    pool->stats.cached_bytes += len;
+    struct ion_pool_buffer* trimmed =
+            ion_pool_unlink_trimmed(pool, pool->max_cached_bytes, buffer->freed_ns);
+    pthread_mutex_unlock(&pool->lock);
+
+    ion_pool_close_buffers(trimmed);
+    return 0;
+}
+
+void ion_pool_trim(struct ion_pool* pool, size_t keep_bytes) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    struct ion_pool_buffer* trimmed = ion_pool_unlink_trimmed(pool, keep_bytes, ion_pool_now_ns());
+    pthread_mutex_unlock(&pool->lock);
+
+    ion_pool_close_buffers(trimmed);
+}
+
+int ion_pool_get_stats(struct ion_pool* pool, struct ion_pool_stats* stats) {
+    if (!pool || !stats) return -EINVAL;
+
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
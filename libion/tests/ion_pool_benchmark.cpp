@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+
+#include <ion/ion.h>
+
+// Allocates and frees a buffer of the given size from the system heap, with
+// an ioctl each time.
+static void BM_AllocFree(benchmark::State& state) {
+    int ionfd = ion_open();
+    if (ionfd < 0) {
+        state.SkipWithError("cannot open /dev/ion");
+        return;
+    }
+    for (auto _ : state) {
+        int fd;
+        if (ion_alloc_fd(ionfd, state.range(0), 0, ION_HEAP_SYSTEM_MASK, 0, &fd) != 0) {
+            state.SkipWithError("ion_alloc_fd failed");
+            break;
+        }
+        close(fd);
+    }
+    ion_close(ionfd);
+}
+BENCHMARK(BM_AllocFree)->Arg(4 * 1024)->Arg(64 * 1024)->Arg(1024 * 1024)->Arg(8 * 1024 * 1024);
+
+// The same through a pool, where every allocation after the first is a hit.
+static void BM_PoolAllocFree(benchmark::State& state) {
+    int ionfd = ion_open();
+    if (ionfd < 0) {
+        state.SkipWithError("cannot open /dev/ion");
+        return;
+    }
+    struct ion_pool* pool = ion_pool_create(ionfd, 16 * 1024 * 1024, 0);
+    for (auto _ : state) {
+        int fd;
+        if (ion_pool_alloc_fd(pool, state.range(0), ION_HEAP_SYSTEM_MASK, 0, &fd) != 0) {
+            state.SkipWithError("ion_pool_alloc_fd failed");
+            break;
+        }
+        ion_pool_free_fd(pool, fd, state.range(0), ION_HEAP_SYSTEM_MASK, 0);
+    }
+    ion_pool_destroy(pool);
+    ion_close(ionfd);
+}
+BENCHMARK(BM_PoolAllocFree)->Arg(4 * 1024)->Arg(64 * 1024)->Arg(1024 * 1024)->Arg(8 * 1024 * 1024);
+
+BENCHMARK_MAIN();
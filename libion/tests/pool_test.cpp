@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <ion/ion.h>
+#include "ion_test_fixture.h"
+
+class Pool : public IonTest {};
+
+TEST_F(Pool, RecyclesBuffers) {
+    struct ion_pool* pool = ion_pool_create(ionfd, 1024 * 1024, 0);
+    ASSERT_TRUE(pool != nullptr);
+
+    int fd;
+    ASSERT_EQ(0, ion_pool_alloc_fd(pool, getpagesize(), ION_HEAP_SYSTEM_MASK, 0, &fd));
+    ASSERT_EQ(0, ion_pool_free_fd(pool, fd, getpagesize(), ION_HEAP_SYSTEM_MASK, 0));
+
+    // The same length, heap and flags get the buffer back.
+    int recycled_fd;
+    ASSERT_EQ(0, ion_pool_alloc_fd(pool, getpagesize(), ION_HEAP_SYSTEM_MASK, 0, &recycled_fd));
+    EXPECT_EQ(fd, recycled_fd);
+
+    // Other flags don't.
+    int cached_fd;
+    ASSERT_EQ(0, ion_pool_alloc_fd(pool, getpagesize(), ION_HEAP_SYSTEM_MASK, ION_FLAG_CACHED,
+                                   &cached_fd));
+    EXPECT_NE(recycled_fd, cached_fd);
+
+    struct ion_pool_stats stats;
+    ASSERT_EQ(0, ion_pool_get_stats(pool, &stats));
+    EXPECT_EQ(1U, stats.hits);
+    EXPECT_EQ(2U, stats.misses);
+    EXPECT_EQ(0U, stats.cached_buffers);
+
+    ASSERT_EQ(0, close(recycled_fd));
+    ASSERT_EQ(0, close(cached_fd));
+    ion_pool_destroy(pool);
+}
+
+TEST_F(Pool, Trim) {
+    const size_t size = getpagesize();
+    struct ion_pool* pool = ion_pool_create(ionfd, 2 * size, 0);
+    ASSERT_TRUE(pool != nullptr);
+
+    int fds[3];
+    for (int& fd : fds) {
+        ASSERT_EQ(0, ion_pool_alloc_fd(pool, size, ION_HEAP_SYSTEM_MASK, 0, &fd));
+    }
+    for (int fd : fds) {
+        ASSERT_EQ(0, ion_pool_free_fd(pool, fd, size, ION_HEAP_SYSTEM_MASK, 0));
+    }
+
+    // Only max_cached_bytes are kept.
+    struct ion_pool_stats stats;
+    ASSERT_EQ(0, ion_pool_get_stats(pool, &stats));
+    EXPECT_EQ(2U, stats.cached_buffers);
+    EXPECT_EQ(2 * size, stats.cached_bytes);
+    EXPECT_EQ(1U, stats.trimmed);
+
+    ion_pool_trim(pool, 0);
+    ASSERT_EQ(0, ion_pool_get_stats(pool, &stats));
+    EXPECT_EQ(0U, stats.cached_buffers);
+    EXPECT_EQ(0U, stats.cached_bytes);
+    EXPECT_EQ(3U, stats.trimmed);
+
+    ion_pool_destroy(pool);
+}
@@ -29,7 +29,7 @@
 static void Usage(int exit_code) {
   fprintf(stderr, "usage: mini-keyctl <action> [args,]\n");
   fprintf(stderr, "       mini-keyctl add <type> <desc> <data> <keyring>\n");
-  fprintf(stderr, "       mini-keyctl padd <type> <desc> <keyring>\n");
+  fprintf(stderr, "       mini-keyctl padd <type> <desc> <keyring> [<file>...]\n");
   fprintf(stderr, "       mini-keyctl unlink <key> <keyring>\n");
   fprintf(stderr, "       mini-keyctl restrict_keyring <keyring>\n");
   fprintf(stderr, "       mini-keyctl security <key>\n");
@@ -56,10 +56,13 @@ int main(int argc, const char** argv) {
     std::string keyring = argv[5];
     return Add(type, desc, data, keyring);
   } else if (action == "padd") {
-    if (argc != 5) Usage(1);
+    if (argc < 5) Usage(1);
     std::string type = argv[2];
     std::string desc = argv[3];
     std::string keyring = argv[4];
+    if (argc > 5) {
+      return PaddFiles(type, desc, keyring, std::vector<std::string>(argv + 5, argv + argc));
+    }
     return Padd(type, desc, keyring);
   } else if (action == "restrict_keyring") {
     if (argc != 3) Usage(1);
@@ -19,70 +19,82 @@
 #include <dirent.h>
 #include <errno.h>
 #include <error.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <unistd.h>
 
-#include <fstream>
 #include <iostream>
-#include <iterator>
-#include <sstream>
+#include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <android-base/file.h>
 #include <android-base/parseint.h>
 #include <android-base/properties.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <keyutils.h>
 
 static constexpr int kMaxCertSize = 4096;
 
-static std::vector<std::string> SplitBySpace(const std::string& s) {
-  std::istringstream iss(s);
-  return std::vector<std::string>{std::istream_iterator<std::string>{iss},
-                                  std::istream_iterator<std::string>{}};
-}
-
-// Find the keyring id. Because request_key(2) syscall is not available or the key is
-// kernel keyring, the id is looked up from /proc/keys. The keyring description may contain other
-// information in the descritption section depending on the key type, only the first word in the
-// keyring description is used for searching.
-static key_serial_t GetKeyringIdOrDie(const std::string& keyring_desc) {
-  // If the keyring id is already a hex number, directly convert it to keyring id
-  key_serial_t keyring_id;
-  if (android::base::ParseInt(keyring_desc.c_str(), &keyring_id)) {
-    return keyring_id;
-  }
+// The ids of the keyrings in /proc/keys, by the first word of their description.
+static std::map<std::string, key_serial_t>* keyring_ids = nullptr;
 
+static void LoadKeyringIdsOrDie() {
   // Only keys allowed by SELinux rules will be shown here.
-  std::ifstream proc_keys_file("/proc/keys");
-  if (!proc_keys_file.is_open()) {
-    error(1, errno, "Failed to open /proc/keys");
-    return -1;
+  std::string proc_keys;
+  if (!android::base::ReadFileToString("/proc/keys", &proc_keys)) {
+    error(1, errno, "Failed to read /proc/keys");
   }
 
-  std::string line;
-  while (getline(proc_keys_file, line)) {
-    std::vector<std::string> tokens = SplitBySpace(line);
-    if (tokens.size() < 9) {
+  keyring_ids = new std::map<std::string, key_serial_t>;
+  for (std::string_view line : android::base::SplitView(proc_keys, "\n")) {
+    // Only the first 9 fields are needed: the key id, its type and its description.
+    std::string_view tokens[9];
+    size_t count = 0;
+    for (std::string_view token : android::base::Tokenize(line, " ")) {
+      tokens[count++] = token;
+      if (count == 9) break;
+    }
+    if (count < 9) {
       continue;
     }
-    std::string key_id = "0x" + tokens[0];
-    std::string key_type = tokens[7];
+    std::string key_id = "0x" + std::string(tokens[0]);
+    std::string_view key_type = tokens[7];
     // The key description may contain space.
-    std::string key_desc_prefix = tokens[8];
+    std::string_view key_desc_prefix = tokens[8];
     // The prefix has a ":" at the end
-    std::string key_desc_pattern = keyring_desc + ":";
-    if (key_type != "keyring" || key_desc_prefix != key_desc_pattern) {
+    if (key_type != "keyring" || key_desc_prefix.empty() || key_desc_prefix.back() != ':') {
       continue;
     }
+    key_serial_t keyring_id;
     if (!android::base::ParseInt(key_id.c_str(), &keyring_id)) {
       error(1, 0, "Unexpected key format in /proc/keys: %s", key_id.c_str());
-      return -1;
     }
+    key_desc_prefix.remove_suffix(1);
+    // Like a scan for a single description, the first keyring listed wins.
+    keyring_ids->emplace(std::string(key_desc_prefix), keyring_id);
+  }
+}
+
+// Find the keyring id. Because request_key(2) syscall is not available or the key is
+// kernel keyring, the id is looked up from /proc/keys. The keyring description may contain other
+// information in the descritption section depending on the key type, only the first word in the
+// keyring description is used for searching. /proc/keys is only read once: all of its keyrings
+// are remembered for the lookups that follow.
+static key_serial_t GetKeyringIdOrDie(const std::string& keyring_desc) {
+  // If the keyring id is already a hex number, directly convert it to keyring id
+  key_serial_t keyring_id;
+  if (android::base::ParseInt(keyring_desc.c_str(), &keyring_id)) {
     return keyring_id;
   }
-  return -1;
+
+  if (keyring_ids == nullptr) {
+    LoadKeyringIdsOrDie();
+  }
+  auto it = keyring_ids->find(keyring_desc);
+  return it != keyring_ids->end() ? it->second : -1;
 }
 
 int Unlink(key_serial_t key, const std::string& keyring) {
@@ -113,22 +125,23 @@ int Add(const std::string& type, const std::string& desc, const std::string& dat
   return 0;
 }
 
-int Padd(const std::string& type, const std::string& desc, const std::string& keyring) {
-  key_serial_t keyring_id = GetKeyringIdOrDie(keyring);
-
-  // read from stdin to get the certificates
-  std::istreambuf_iterator<char> begin(std::cin), end;
-  std::string data(begin, end);
+static int AddFromFd(const std::string& type, const std::string& desc, int fd,
+                     key_serial_t keyring_id, const char* source) {
+  std::string data;
+  if (!android::base::ReadFdToString(fd, &data)) {
+    error(0, errno, "Failed to read %s", source);
+    return 1;
+  }
 
   if (data.size() > kMaxCertSize) {
-    error(1, 0, "Certificate too large");
+    error(0, 0, "Certificate too large: %s", source);
     return 1;
   }
 
   key_serial_t key = add_key(type.c_str(), desc.c_str(), data.c_str(), data.size(), keyring_id);
 
   if (key < 0) {
-    error(1, errno, "Failed to add key");
+    error(0, errno, "Failed to add key from %s", source);
     return 1;
   }
 
@@ -136,6 +149,32 @@ int Padd(const std::string& type, const std::string& desc, const std::string& ke
   return 0;
 }
 
+int Padd(const std::string& type, const std::string& desc, const std::string& keyring) {
+  key_serial_t keyring_id = GetKeyringIdOrDie(keyring);
+
+  // read from stdin to get the certificates
+  return AddFromFd(type, desc, STDIN_FILENO, keyring_id, "stdin");
+}
+
+int PaddFiles(const std::string& type, const std::string& desc, const std::string& keyring,
+              const std::vector<std::string>& files) {
+  key_serial_t keyring_id = GetKeyringIdOrDie(keyring);
+
+  int result = 0;
+  for (const auto& file : files) {
+    android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(file.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (fd == -1) {
+      error(0, errno, "Failed to open %s", file.c_str());
+      result = 1;
+      continue;
+    }
+    if (AddFromFd(type, desc, fd.get(), keyring_id, file.c_str()) != 0) {
+      result = 1;
+    }
+  }
+  return result;
+}
+
 int RestrictKeyring(const std::string& keyring) {
   key_serial_t keyring_id = GetKeyringIdOrDie(keyring);
   if (keyctl_restrict_keyring(keyring_id, nullptr, nullptr) < 0) {
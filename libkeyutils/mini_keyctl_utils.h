@@ -17,6 +17,7 @@
 #include "include/keyutils.h"
 
 #include <string>
+#include <vector>
 
 // Add key to a keyring. Returns non-zero if error happens.
 int Add(const std::string& type, const std::string& desc, const std::string& data,
@@ -25,6 +26,11 @@ int Add(const std::string& type, const std::string& desc, const std::string& dat
 // Add key from stdin to a keyring. Returns non-zero if error happens.
 int Padd(const std::string& type, const std::string& desc, const std::string& keyring);
 
+// Add a key from each of the files to a keyring, looking the keyring up once. Carries on past the
+// files that fail, and returns non-zero if any did.
+int PaddFiles(const std::string& type, const std::string& desc, const std::string& keyring,
+              const std::vector<std::string>& files);
+
 // Removes the link from a keyring to a key if exists. Return non-zero if error happens.
 int Unlink(key_serial_t key, const std::string& keyring);
 
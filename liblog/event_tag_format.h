@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include <vector>
+
+#include <log/event_tag_map.h>
+
+/*
+ * One "(<name>|data type[|data unit])" value description of an event tag
+ * format, as android_log_printBinaryEvent() consumes them.
+ */
+struct EventFormatField {
+  const char* name;
+  size_t nameLen;  /* printed, trailing space trimmed */
+  size_t nameScan; /* as it appears in the format */
+  char type;       /* data type digit, 0 if none */
+  char unit;       /* data unit, 0 if none */
+  bool last;       /* the format description ends after this value */
+};
+
+/* A tag's name and its format, parsed once then reused for every entry. */
+struct EventTagFormat {
+  const char* tag; /* NULL if unknown */
+  size_t tagLen;
+  std::vector<EventFormatField> fields;
+};
+
+/* Parse a format description into fields, in logprint.cpp. */
+void android_compileEventFormat(const char* fmt, size_t len,
+                                std::vector<EventFormatField>* fields);
+
+/*
+ * Cached in map, unknown tags included, so that logd is asked about an
+ * unknown tag only once. Valid until the map is closed.
+ */
+const EventTagFormat* android_lookupEventTagFormat(const EventTagMap* map,
+                                                   unsigned int tag);
@@ -24,11 +24,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <functional>
+#include <mutex>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <log/event_tag_map.h>
 #include <log/log_properties.h>
@@ -36,6 +41,7 @@
 #include <utils/FastStrcmp.h>
 #include <utils/RWLock.h>
 
+#include "event_tag_format.h"
 #include "log_portability.h"
 #include "logd_reader.h"
 
@@ -125,8 +131,21 @@ struct EventTagMap {
   // protect unordered sets
   android::RWLock rwlock;
 
+  // parsed formats for logprint, see android_lookupEventTagFormat()
+  std::unordered_map<uint32_t, EventTagFormat> Idx2Format;
+  android::RWLock formatLock;
+
+  // entries logd appended to /dev/event-log-tags after we mapped it, see
+  // refreshDynamic(); strings in the maps above point into these too.
+  std::vector<std::pair<void*, size_t>> tailMaps;
+  std::mutex tailLock;
+
  public:
-  EventTagMap() {
+  // how much of /dev/event-log-tags has been parsed, if it is followed.
+  bool dynamicFollow;
+  size_t dynamicEnd;
+
+  EventTagMap() : dynamicFollow(false), dynamicEnd(0) {
     memset(mapAddr, 0, sizeof(mapAddr));
     memset(mapLen, 0, sizeof(mapLen));
   }
@@ -141,14 +160,35 @@ struct EventTagMap {
         mapAddr[which] = 0;
       }
     }
+    for (auto& tail : tailMaps) {
+      munmap(tail.first, tail.second);
+    }
   }
 
   bool emplaceUnique(uint32_t tag, const TagFmt& tagfmt, bool verbose = false);
   const TagFmt* find(uint32_t tag) const;
   int find(TagFmt&& tagfmt) const;
   int find(MapString&& tag) const;
+
+  const EventTagFormat* findFormat(uint32_t tag) const;
+  const EventTagFormat* emplaceFormat(uint32_t tag, EventTagFormat&& format);
+
+  bool refreshDynamic();
 };
 
+const EventTagFormat* EventTagMap::findFormat(uint32_t tag) const {
+  android::RWLock::AutoRLock readLock(const_cast<android::RWLock&>(formatLock));
+  std::unordered_map<uint32_t, EventTagFormat>::const_iterator it = Idx2Format.find(tag);
+  if (it == Idx2Format.end()) return NULL;
+  return &it->second;
+}
+
+// Keeps the first if two threads raced to parse the same tag.
+const EventTagFormat* EventTagMap::emplaceFormat(uint32_t tag, EventTagFormat&& format) {
+  android::RWLock::AutoWLock writeLock(formatLock);
+  return &Idx2Format.emplace(tag, std::move(format)).first->second;
+}
+
 bool EventTagMap::emplaceUnique(uint32_t tag, const TagFmt& tagfmt,
                                 bool verbose) {
   bool ret = true;
@@ -247,8 +287,12 @@ static const char* endOfTag(const char* cp) {
 // will disappear after the call. A non-zero lineNum means we own the
 // data and it will outlive the call.
 //
+// warn = false does not report duplicates, for content that may have been
+// cached already.
+//
 // Returns 0 on success, nonzero on failure.
-static int scanTagLine(EventTagMap* map, const char*& pData, int lineNum) {
+static int scanTagLine(EventTagMap* map, const char*& pData, int lineNum,
+                       bool warn = true) {
   char* ep;
   unsigned long val = strtoul(pData, &ep, 10);
   const char* cp = ep;
@@ -307,13 +351,13 @@ static int scanTagLine(EventTagMap* map, const char*& pData, int lineNum) {
   // Ideally we want to check if there are identicals
   // recorded for the same uid, but recording that
   // unused detail in our database is too burdensome.
-  bool verbose = true;
+  bool verbose = warn;
   while (*cp && (*cp != '#') && (*cp != '\n')) ++cp;
   if (*cp == '#') {
     do {
       ++cp;
     } while (isspace(*cp) && (*cp != '\n'));
-    verbose = !!fastcmp<strncmp>(cp, "uid=", strlen("uid="));
+    verbose = warn && fastcmp<strncmp>(cp, "uid=", strlen("uid="));
   }
 
   while (*cp && (*cp != '\n')) ++cp;
@@ -346,6 +390,9 @@ static const char* eventTagFiles[NUM_MAPS] = {
   EVENT_TAG_MAP_FILE, "/dev/event-log-tags",
 };
 
+static int parseLines(EventTagMap* map, const char* cp, size_t len,
+                      size_t which, bool warn = true);
+
 // Parse the tags out of the file.
 static int parseMapLines(EventTagMap* map, size_t which) {
   const char* cp = static_cast<char*>(map->mapAddr[which]);
@@ -365,6 +412,13 @@ static int parseMapLines(EventTagMap* map, size_t which) {
     return -1;
   }
 
+  return parseLines(map, cp, len, which);
+}
+
+// Parse the tag lines in [cp, cp + len), which ends with EOL.
+static int parseLines(EventTagMap* map, const char* cp, size_t len,
+                      size_t which, bool warn) {
+  const char* endp = cp + len;
   bool lineStart = true;
   int lineNum = 1;
   while (cp < endp) {
@@ -377,7 +431,7 @@ static int parseMapLines(EventTagMap* map, size_t which) {
         lineStart = false;
       } else if (isdigit(*cp)) {
         // looks like a tag; scan it out
-        if (scanTagLine(map, cp, lineNum) != 0) {
+        if (scanTagLine(map, cp, lineNum, warn) != 0) {
           if (!which || (errno != EMLINK)) {
             return -1;
           }
@@ -403,6 +457,45 @@ static int parseMapLines(EventTagMap* map, size_t which) {
   return 0;
 }
 
+// Catch up with the entries logd appended to /dev/event-log-tags since we
+// last looked, mapping just the new part of the file, so that tags other
+// processes registered can be found without asking logd for them.
+//
+// Returns true if there were new entries.
+bool EventTagMap::refreshDynamic() {
+  std::lock_guard<std::mutex> lock(tailLock);
+  if (!dynamicFollow) return false;
+
+  int fd = open(eventTagFiles[1], O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) || (st.st_size <= (off_t)dynamicEnd)) {
+    // logd only ever appends, unless it rebuilds a damaged file.
+    close(fd);
+    return false;
+  }
+
+  size_t offset = dynamicEnd & ~(size_t)(getpagesize() - 1);
+  size_t len = st.st_size - offset;
+  void* addr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, offset);
+  close(fd);
+  if ((addr == MAP_FAILED) || (addr == NULL)) return false;
+
+  const char* cp = static_cast<const char*>(addr) + (dynamicEnd - offset);
+  const char* endp = static_cast<const char*>(addr) + len;
+  // Leave an entry logd is still writing for next time.
+  while ((endp > cp) && (*(endp - 1) != '\n')) --endp;
+  if (endp == cp) {
+    munmap(addr, len);
+    return false;
+  }
+
+  tailMaps.emplace_back(addr, len);
+  parseLines(this, cp, endp - cp, 1, false);
+  dynamicEnd += endp - cp;
+  return true;
+}
+
 // Open the map file and allocate a structure to manage it.
 //
 // We create a private mapping because we want to terminate the log tag
@@ -475,6 +568,14 @@ EventTagMap* android_openEventTagMap(const char* fileName) {
     /* See 'fd DONE' comments above and below, no need to clean up here */
   }
 
+  if (!fileName) {
+    // An incomplete last line was not parsed, start over from the top.
+    size_t len = newTagMap->mapLen[1];
+    const char* cp = static_cast<char*>(newTagMap->mapAddr[1]);
+    newTagMap->dynamicFollow = true;
+    newTagMap->dynamicEnd = (len && (cp[len - 1] == '\n')) ? len : 0;
+  }
+
   return newTagMap;
 
 fail_unmap:
@@ -495,6 +596,11 @@ void android_closeEventTagMap(EventTagMap* map) {
 // Cache miss, go to logd to acquire a public reference.
 // Because we lack access to a SHARED PUBLIC /dev/event-log-tags file map?
 static const TagFmt* __getEventTag(EventTagMap* map, unsigned int tag) {
+  if (map->refreshDynamic()) {
+    const TagFmt* str = map->find(tag);
+    if (str) return str;
+  }
+
   // call event tag service to arrange for a new tag
   char* buf = NULL;
   // Can not use android::base::StringPrintf, asprintf + free instead.
@@ -558,6 +664,23 @@ const char* android_lookupEventFormat_len(const EventTagMap* map, size_t* len, u
   return str->second.data();
 }
 
+const EventTagFormat* android_lookupEventTagFormat(const EventTagMap* map, unsigned int tag) {
+  const EventTagFormat* format = map->findFormat(tag);
+  if (format) return format;
+
+  EventTagFormat parsed = {NULL, 0, {}};
+  const TagFmt* str = map->find(tag);
+  if (!str) {
+    str = __getEventTag(const_cast<EventTagMap*>(map), tag);
+  }
+  if (str) {
+    parsed.tag = str->first.data();
+    parsed.tagLen = str->first.length();
+    android_compileEventFormat(str->second.data(), str->second.length(), &parsed.fields);
+  }
+  return const_cast<EventTagMap*>(map)->emplaceFormat(tag, std::move(parsed));
+}
+
 // This function is deprecated and replaced with android_lookupEventTag_len
 // since it will cause the map to change from Shared and backed by a file,
 // to Private Dirty and backed up by swap, albeit highly compressible. By
@@ -597,6 +720,12 @@ int android_lookupEventTagNum(EventTagMap* map, const char* tagname, const char*
       std::make_pair(MapString(tagname, len), MapString(format, fmtLen))));
   if (ret != -1) return ret;
 
+  if (map->refreshDynamic()) {
+    ret = map->find(TagFmt(
+        std::make_pair(MapString(tagname, len), MapString(format, fmtLen))));
+    if (ret != -1) return ret;
+  }
+
   // call event tag service to arrange for a new tag
   char* buf = NULL;
   // Can not use android::base::StringPrintf, asprintf + free instead.
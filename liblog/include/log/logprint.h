@@ -111,6 +111,12 @@ int android_log_addFilterString(AndroidLogFormat* p_format,
 int android_log_shouldPrintLine(AndroidLogFormat* p_format, const char* tag,
                                 android_LogPriority pri);
 
+/**
+ * returns the lowest priority at which a log line with any tag could be
+ * printed, lines below it can be rejected without looking at their tag
+ */
+android_LogPriority android_log_minPrintPriority(AndroidLogFormat* p_format);
+
 /**
  * Splits a wire-format buffer into an AndroidLogEntry
  * entry allocated by caller. Pointers will point directly into buf
@@ -147,6 +147,23 @@ bool __android_logger_property_get_bool(const char* key, int flag);
 unsigned long __android_logger_get_buffer_size(log_id_t logId);
 bool __android_logger_valid_buffer_size(unsigned long value);
 
+/*
+ * Ask logd to leave out entries below prio, and entries not from one of
+ * uids, before they are sent to the reader. Advisory, other transports
+ * ignore it so the reader must still filter. Call before the first read.
+ * Returns 0, or -E2BIG for more than LOGGER_LIST_MAX_UIDS uids.
+ */
+#define LOGGER_LIST_MAX_UIDS 8
+int __android_logger_list_set_filter(struct logger_list* logger_list, android_LogPriority prio,
+                                     const uid_t* uids, size_t count);
+
+/*
+ * Opt-in, per process: entries for logd are queued and sent in batches by
+ * a background thread, rather than by the logging thread. Fatal, crash and
+ * security entries are still written synchronously. Returns 0 or -errno.
+ */
+int __android_log_set_async(int enable);
+
 /* Retrieve the composed event buffer */
 int android_log_write_list_buffer(android_log_context ctx, const char** msg);
 
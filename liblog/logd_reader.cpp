@@ -394,9 +394,26 @@ static int logdOpen(struct android_log_logger_list* logger_list,
   if (logger_list->pid) {
     ret = snprintf(cp, remaining, " pid=%u", logger_list->pid);
     ret = min(ret, remaining);
+    remaining -= ret;
     cp += ret;
   }
 
+  if (logger_list->prio > ANDROID_LOG_VERBOSE) {
+    ret = snprintf(cp, remaining, " prio=%d", logger_list->prio);
+    ret = min(ret, remaining);
+    remaining -= ret;
+    cp += ret;
+  }
+
+  c = '=';
+  for (size_t i = 0; i < logger_list->uidCount; ++i) {
+    ret = snprintf(cp, remaining, "%s%c%u", (c == '=') ? " uids" : "", c, logger_list->uids[i]);
+    ret = min(ret, remaining);
+    remaining -= ret;
+    cp += ret;
+    c = ',';
+  }
+
   if (logger_list->mode & ANDROID_LOG_NONBLOCK) {
     /* Deal with an unresponsive logd */
     memset(&ignore, 0, sizeof(ignore));
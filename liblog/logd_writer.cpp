@@ -19,6 +19,8 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <stdarg.h>
 #include <stdatomic.h>
 #include <stdio.h>
@@ -48,6 +50,9 @@ static int logdOpen();
 static void logdClose();
 static int logdWrite(log_id_t logId, struct timespec* ts, struct iovec* vec, size_t nr);
 
+static atomic_int dropped;
+static atomic_int droppedSecurity;
+
 struct android_log_transport_write logdLoggerWrite = {
     .node = {&logdLoggerWrite.node, &logdLoggerWrite.node},
     .context.sock = -EBADF,
@@ -123,6 +128,296 @@ static int logdAvailable(log_id_t logId) {
   return 1;
 }
 
+/*
+ * Opt-in asynchronous mode, see __android_log_set_async(). The logging
+ * thread copies each entry into a bounded lock-free ring. A flush thread
+ * sends the entries, still one datagram each, in batches with sendmmsg().
+ * Fatal, crash and security entries, and any entry that finds the ring
+ * full, are written synchronously after flushing what is pending.
+ */
+#define ASYNC_SLOTS 64                 /* power of two */
+#define ASYNC_BATCH 32                 /* entries per sendmmsg */
+#define ASYNC_DELAY_NS (2 * 1000000L)  /* to gather a burst, bounds latency */
+
+struct asyncSlot {
+  atomic_size_t sequence;
+  size_t len;
+  unsigned char data[sizeof(android_log_header_t) + LOGGER_ENTRY_MAX_PAYLOAD];
+};
+
+struct asyncRing {
+  struct asyncSlot slot[ASYNC_SLOTS];
+  atomic_size_t enqueue;
+  atomic_size_t dequeue; /* written with flushLock held */
+  pthread_mutex_t flushLock;
+  sem_t wake;
+  atomic_bool sleeping;
+  atomic_bool running;
+};
+
+static _Atomic(struct asyncRing*) asyncRing; /* NULL unless enabled */
+static atomic_bool asyncEnabled;
+
+static void asyncDrain(struct asyncRing* ring);
+
+/* Reserve the next slot, NULL if the ring is full. */
+static struct asyncSlot* asyncReserve(struct asyncRing* ring, size_t* pos) {
+  size_t p = atomic_load_explicit(&ring->enqueue, memory_order_relaxed);
+  for (;;) {
+    struct asyncSlot* slot = &ring->slot[p & (ASYNC_SLOTS - 1)];
+    size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)p;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&ring->enqueue, &p, p + 1, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        *pos = p;
+        return slot;
+      }
+    } else if (diff < 0) {
+      return NULL;
+    } else {
+      p = atomic_load_explicit(&ring->enqueue, memory_order_relaxed);
+    }
+  }
+}
+
+/* Slot at pos if it is ready to be sent, NULL if not. */
+static struct asyncSlot* asyncPeek(struct asyncRing* ring, size_t pos) {
+  struct asyncSlot* slot = &ring->slot[pos & (ASYNC_SLOTS - 1)];
+  if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != (pos + 1)) {
+    return NULL;
+  }
+  return slot;
+}
+
+static void* asyncThread(void* arg) {
+  struct asyncRing* ring = (struct asyncRing*)arg;
+
+  for (;;) {
+    atomic_store(&ring->sleeping, true);
+    size_t dequeue = atomic_load_explicit(&ring->dequeue, memory_order_relaxed);
+    if (!asyncPeek(ring, dequeue)) {
+      while (sem_wait(&ring->wake) && (errno == EINTR)) {
+      }
+    }
+    atomic_store(&ring->sleeping, false);
+
+    dequeue = atomic_load_explicit(&ring->dequeue, memory_order_relaxed);
+    if (!asyncPeek(ring, dequeue + ASYNC_BATCH - 1)) {
+      struct timespec delay = {0, ASYNC_DELAY_NS};
+      nanosleep(&delay, NULL);
+    }
+
+    pthread_mutex_lock(&ring->flushLock);
+    asyncDrain(ring);
+    pthread_mutex_unlock(&ring->flushLock);
+  }
+  return NULL;
+}
+
+static void asyncStart(struct asyncRing* ring) {
+  bool expected = false;
+  if (!atomic_compare_exchange_strong(&ring->running, &expected, true)) {
+    return;
+  }
+  pthread_attr_t attr;
+  pthread_t thread;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if (pthread_create(&thread, &attr, asyncThread, ring)) {
+    atomic_store(&ring->running, false);
+  } else {
+    pthread_setname_np(thread, "liblog_async");
+  }
+  pthread_attr_destroy(&attr);
+}
+
+/* The flush thread does not survive fork, what it held is reset. */
+static void asyncForkChild() {
+  struct asyncRing* ring = atomic_load(&asyncRing);
+  if (!ring) {
+    return;
+  }
+  pthread_mutex_init(&ring->flushLock, NULL);
+  sem_init(&ring->wake, 0, 0);
+  atomic_store(&ring->sleeping, false);
+  atomic_store(&ring->running, false);
+}
+
+/*
+ * Flush from the calling thread, to keep order ahead of a synchronous
+ * write. The flush thread never blocks on the socket, so waiting for it is
+ * brief; the wait is bounded in case we interrupted ourselves holding it.
+ */
+static void asyncFlush(struct asyncRing* ring) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_nsec += 10 * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_nsec -= 1000000000L;
+    ++deadline.tv_sec;
+  }
+  if (!pthread_mutex_timedlock(&ring->flushLock, &deadline)) {
+    asyncDrain(ring);
+    pthread_mutex_unlock(&ring->flushLock);
+  }
+}
+
+static void asyncExit() {
+  struct asyncRing* ring = atomic_load(&asyncRing);
+  if (ring) {
+    asyncFlush(ring);
+  }
+}
+
+int __android_log_set_async(int enable) {
+  struct asyncRing* ring = atomic_load(&asyncRing);
+  if (!enable) {
+    atomic_store(&asyncEnabled, false);
+    if (ring) {
+      pthread_mutex_lock(&ring->flushLock);
+      asyncDrain(ring);
+      pthread_mutex_unlock(&ring->flushLock);
+    }
+    return 0;
+  }
+  if (!ring) {
+    __android_log_lock();
+    ring = atomic_load(&asyncRing);
+    if (!ring) {
+      ring = (struct asyncRing*)calloc(1, sizeof(struct asyncRing));
+      if (!ring) {
+        __android_log_unlock();
+        return -ENOMEM;
+      }
+      for (size_t i = 0; i < ASYNC_SLOTS; ++i) {
+        atomic_init(&ring->slot[i].sequence, i);
+      }
+      pthread_mutex_init(&ring->flushLock, NULL);
+      sem_init(&ring->wake, 0, 0);
+      pthread_atfork(NULL, NULL, asyncForkChild);
+      atexit(asyncExit);
+      atomic_store(&asyncRing, ring);
+    }
+    __android_log_unlock();
+  }
+  asyncStart(ring);
+  atomic_store(&asyncEnabled, true);
+  return 0;
+}
+
+/* Entries that must not sit in the ring if the process is about to die. */
+static bool asyncMustSync(log_id_t logId, struct iovec* vec, size_t nr) {
+  switch (logId) {
+    case LOG_ID_CRASH:
+    case LOG_ID_SECURITY:
+      return true;
+    case LOG_ID_EVENTS:
+    case LOG_ID_STATS:
+      return false;
+    default:
+      return nr && vec[0].iov_len &&
+             (*(const unsigned char*)vec[0].iov_base >= ANDROID_LOG_FATAL);
+  }
+}
+
+static int asyncWrite(struct asyncRing* ring, log_id_t logId, struct timespec* ts,
+                      struct iovec* vec, size_t nr) {
+  size_t pos;
+  struct asyncSlot* slot = asyncReserve(ring, &pos);
+  if (!slot) {
+    return -EAGAIN;
+  }
+
+  android_log_header_t header;
+  header.id = logId;
+  header.tid = gettid();
+  header.realtime.tv_sec = ts->tv_sec;
+  header.realtime.tv_nsec = ts->tv_nsec;
+  memcpy(slot->data, &header, sizeof(header));
+
+  size_t len = sizeof(header);
+  for (size_t i = 0; (i < nr) && (len < sizeof(slot->data)); ++i) {
+    size_t n = min(vec[i].iov_len, sizeof(slot->data) - len);
+    memcpy(slot->data + len, vec[i].iov_base, n);
+    len += n;
+  }
+  slot->len = len;
+  atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+
+  if (!atomic_load(&ring->running)) {
+    asyncStart(ring);
+  }
+  if (atomic_exchange(&ring->sleeping, false)) {
+    sem_post(&ring->wake);
+  }
+  return len - sizeof(header);
+}
+
+/* Send what is ready, a batch per system call. flushLock held. */
+static void asyncDrain(struct asyncRing* ring) {
+  struct mmsghdr msgs[ASYNC_BATCH];
+  struct iovec iov[ASYNC_BATCH];
+  struct asyncSlot* slots[ASYNC_BATCH];
+  bool retried = false;
+
+  for (;;) {
+    size_t dequeue = atomic_load_explicit(&ring->dequeue, memory_order_relaxed);
+    int n = 0;
+    while (n < ASYNC_BATCH) {
+      struct asyncSlot* slot = asyncPeek(ring, dequeue + n);
+      if (!slot) {
+        break;
+      }
+      iov[n].iov_base = slot->data;
+      iov[n].iov_len = slot->len;
+      memset(&msgs[n], 0, sizeof(msgs[n]));
+      msgs[n].msg_hdr.msg_iov = &iov[n];
+      msgs[n].msg_hdr.msg_iovlen = 1;
+      slots[n] = slot;
+      ++n;
+    }
+    if (!n) {
+      return;
+    }
+
+    int sent = n;
+    int sock = atomic_load(&logdLoggerWrite.context.sock);
+    int ret = (sock < 0) ? sock : TEMP_FAILURE_RETRY(sendmmsg(sock, msgs, n, 0));
+    if (ret < 0) {
+      ret = (sock < 0) ? sock : -errno;
+      switch (ret) {
+        case -ENOTCONN:
+        case -ECONNREFUSED:
+        case -ENOENT:
+          if (!retried && !__android_log_trylock()) {
+            retried = true;
+            __logdClose(ret);
+            ret = logdOpen();
+            __android_log_unlock();
+            if (ret >= 0) {
+              continue;
+            }
+          }
+          break;
+        case -EAGAIN:
+          /* logd is overloaded, the batch is lost as a write would be */
+          atomic_fetch_add_explicit(&dropped, n, memory_order_relaxed);
+          break;
+        default:
+          break;
+      }
+    } else if (ret > 0) {
+      sent = ret;
+    }
+
+    for (int i = 0; i < sent; ++i, ++dequeue) {
+      atomic_store_explicit(&slots[i]->sequence, dequeue + ASYNC_SLOTS, memory_order_release);
+    }
+    atomic_store_explicit(&ring->dequeue, dequeue, memory_order_relaxed);
+  }
+}
+
 static int logdWrite(log_id_t logId, struct timespec* ts, struct iovec* vec, size_t nr) {
   ssize_t ret;
   int sock;
@@ -130,8 +425,6 @@ static int logdWrite(log_id_t logId, struct timespec* ts, struct iovec* vec, siz
   struct iovec newVec[nr + headerLength];
   android_log_header_t header;
   size_t i, payloadSize;
-  static atomic_int dropped;
-  static atomic_int droppedSecurity;
 
   sock = atomic_load(&logdLoggerWrite.context.sock);
   if (sock < 0) switch (sock) {
@@ -153,6 +446,17 @@ static int logdWrite(log_id_t logId, struct timespec* ts, struct iovec* vec, siz
     return 0;
   }
 
+  if (atomic_load(&asyncEnabled)) {
+    struct asyncRing* ring = atomic_load(&asyncRing);
+    if (!asyncMustSync(logId, vec, nr)) {
+      ret = asyncWrite(ring, logId, ts, vec, nr);
+      if (ret >= 0) {
+        return ret;
+      }
+    }
+    asyncFlush(ring);
+  }
+
   /*
    *  struct {
    *      // what we provide to socket
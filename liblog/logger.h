@@ -20,6 +20,7 @@
 
 #include <cutils/list.h>
 #include <log/log.h>
+#include <private/android_logger.h>
 
 #include "log_portability.h"
 #include "uio.h"
@@ -112,6 +113,10 @@ struct android_log_logger_list {
   unsigned int tail;
   log_time start;
   pid_t pid;
+  /* filters the transport may apply on our behalf, see logger_read.cpp */
+  android_LogPriority prio;
+  uid_t uids[LOGGER_LIST_MAX_UIDS];
+  size_t uidCount;
 };
 
 struct android_log_logger {
@@ -250,6 +250,24 @@ struct logger* android_logger_open(struct logger_list* logger_list, log_id_t log
   return (struct logger*)logger;
 }
 
+int __android_logger_list_set_filter(struct logger_list* logger_list, android_LogPriority prio,
+                                     const uid_t* uids, size_t count) {
+  struct android_log_logger_list* logger_list_internal =
+      (struct android_log_logger_list*)logger_list;
+
+  if (!logger_list_internal) {
+    return -EINVAL;
+  }
+  if (count > LOGGER_LIST_MAX_UIDS) {
+    return -E2BIG;
+  }
+
+  logger_list_internal->prio = prio;
+  memcpy(logger_list_internal->uids, uids, count * sizeof(uids[0]));
+  logger_list_internal->uidCount = count;
+  return 0;
+}
+
 /* Open the single named log and make it part of a new logger list */
 struct logger_list* android_logger_list_open(log_id_t logId, int mode, unsigned int tail,
                                              pid_t pid) {
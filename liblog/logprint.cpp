@@ -38,6 +38,7 @@
 #include <log/log.h>
 #include <log/logprint.h>
 
+#include "event_tag_format.h"
 #include "log_portability.h"
 
 #define MS_PER_NSEC 1000000
@@ -200,6 +201,19 @@ int android_log_shouldPrintLine(AndroidLogFormat* p_format, const char* tag,
   return pri >= filterPriForTag(p_format, tag);
 }
 
+android_LogPriority android_log_minPrintPriority(AndroidLogFormat* p_format) {
+  android_LogPriority pri = p_format->global_pri;
+
+  for (FilterInfo* p_curFilter = p_format->filters; p_curFilter != NULL;
+       p_curFilter = p_curFilter->p_next) {
+    if ((p_curFilter->mPri != ANDROID_LOG_DEFAULT) && (p_curFilter->mPri < pri)) {
+      pri = p_curFilter->mPri;
+    }
+  }
+
+  return pri;
+}
+
 AndroidLogFormat* android_log_format_new() {
   AndroidLogFormat* p_ret;
 
@@ -612,6 +626,81 @@ static bool findChar(const char** cp, size_t* len, int c) {
   return false;
 }
 
+/*
+ * event.logtag format specification:
+ *
+ * Optionally, after the tag names can be put a description for the value(s)
+ * of the tag. Description are in the format
+ *    (<name>|data type[|data unit])
+ * Multiple values are separated by commas.
+ *
+ * The data type is a number from the following values:
+ * 1: int
+ * 2: long
+ * 3: string
+ * 4: list
+ * 5: float
+ *
+ * The data unit is a number taken from the following list:
+ * 1: Number of objects
+ * 2: Number of bytes
+ * 3: Number of milliseconds
+ * 4: Number of allocations
+ * 5: Id
+ * 6: Percent
+ * s: Number of seconds (monotonic time)
+ * Default value for data of type int/long is 2 (bytes).
+ *
+ * Parsed once per tag, the fields are then applied to the values in order
+ * by android_log_printBinaryEvent(). A malformed description ends at the
+ * last field that could be parsed.
+ */
+void android_compileEventFormat(const char* cp, size_t len, std::vector<EventFormatField>* fields) {
+  fields->clear();
+  while (len && *cp) {
+    if (!findChar(&cp, &len, '(')) break;
+
+    EventFormatField field = {};
+    findChar(&cp, &len, INT_MAX);
+    field.name = cp;
+    while (len && *cp && (*cp != '|') && (*cp != ')')) {
+      ++cp;
+      --len;
+    }
+    field.nameScan = cp - field.name;
+    field.nameLen = field.nameScan;
+    if (field.nameLen && isspace(field.name[field.nameLen - 1])) {
+      --field.nameLen;
+    }
+
+    if (findChar(&cp, &len, '|') && findChar(&cp, &len, INT_MAX)) {
+      field.type = *cp;
+      ++cp;
+      --len;
+    }
+    field.last = true;
+    if (len) {
+      if (findChar(&cp, &len, '|') && findChar(&cp, &len, INT_MAX)) {
+        field.unit = *cp;
+        ++cp;
+        --len;
+      }
+      field.last = !findChar(&cp, &len, ')') || !findChar(&cp, &len, ',');
+    }
+    fields->push_back(field);
+    if (field.last) break;
+  }
+}
+
+/*
+ * Progress through a tag's format fields while printing its values. A field
+ * whose data type does not match the value ends the description.
+ */
+struct EventFormatState {
+  const std::vector<EventFormatField>* fields;
+  size_t next; /* fields->size() once done */
+};
+
 /*
  * Recursively convert binary log data to printable form.
  *
@@ -634,8 +723,8 @@ enum objectType {
 };
 
 static int android_log_printBinaryEvent(const unsigned char** pEventData, size_t* pEventDataLen,
-                                        char** pOutBuf, size_t* pOutBufLen, const char** fmtStr,
-                                        size_t* fmtLen) {
+                                        char** pOutBuf, size_t* pOutBufLen,
+                                        EventFormatState* format) {
   const unsigned char* eventData = *pEventData;
   size_t eventDataLen = *pEventDataLen;
   char* outBuf = *pOutBuf;
@@ -645,8 +734,9 @@ static int android_log_printBinaryEvent(const unsigned char** pEventData, size_t
   unsigned char type;
   size_t outCount = 0;
   int result = 0;
-  const char* cp;
-  size_t len;
+  const EventFormatField* field = NULL;
+  size_t index = 0;
+  bool described = false;
   int64_t lval;
 
   if (eventDataLen < 1) return -1;
@@ -654,85 +744,39 @@ static int android_log_printBinaryEvent(const unsigned char** pEventData, size_t
   type = *eventData++;
   eventDataLen--;
 
-  cp = NULL;
-  len = 0;
-  if (fmtStr && *fmtStr && fmtLen && *fmtLen && **fmtStr) {
-    cp = *fmtStr;
-    len = *fmtLen;
+  if (format && (format->next < format->fields->size())) {
+    index = format->next;
+    field = &(*format->fields)[index];
+    described = true;
   }
-  /*
-   * event.logtag format specification:
-   *
-   * Optionally, after the tag names can be put a description for the value(s)
-   * of the tag. Description are in the format
-   *    (<name>|data type[|data unit])
-   * Multiple values are separated by commas.
-   *
-   * The data type is a number from the following values:
-   * 1: int
-   * 2: long
-   * 3: string
-   * 4: list
-   * 5: float
-   *
-   * The data unit is a number taken from the following list:
-   * 1: Number of objects
-   * 2: Number of bytes
-   * 3: Number of milliseconds
-   * 4: Number of allocations
-   * 5: Id
-   * 6: Percent
-   * s: Number of seconds (monotonic time)
-   * Default value for data of type int/long is 2 (bytes).
-   */
-  if (!cp || !findChar(&cp, &len, '(')) {
-    len = 0;
-  } else {
-    char* outBufLastSpace = NULL;
-
-    findChar(&cp, &len, INT_MAX);
-    while (len && *cp && (*cp != '|') && (*cp != ')')) {
-      if (outBufLen <= 0) {
-        /* halt output */
-        goto no_room;
-      }
-      outBufLastSpace = isspace(*cp) ? outBuf : NULL;
-      *outBuf = *cp;
-      ++outBuf;
-      ++cp;
-      --outBufLen;
-      --len;
-    }
-    if (outBufLastSpace) {
-      outBufLen += outBuf - outBufLastSpace;
-      outBuf = outBufLastSpace;
+  if (field) {
+    if (outBufLen < field->nameScan) {
+      /* halt output */
+      goto no_room;
     }
+    memcpy(outBuf, field->name, field->nameLen);
+    outBuf += field->nameLen;
+    outBufLen -= field->nameLen;
     if (outBufLen <= 0) {
       /* halt output */
       goto no_room;
     }
-    if (outBufSave != outBuf) {
+    if (field->nameLen) {
       *outBuf = '=';
       ++outBuf;
       --outBufLen;
     }
 
-    if (findChar(&cp, &len, '|') && findChar(&cp, &len, INT_MAX)) {
-      static const unsigned char typeTable[] = {EVENT_TYPE_INT, EVENT_TYPE_LONG, EVENT_TYPE_STRING,
-                                                EVENT_TYPE_LIST, EVENT_TYPE_FLOAT};
-
-      if ((*cp >= '1') && (*cp < (char)('1' + (sizeof(typeTable) / sizeof(typeTable[0])))) &&
-          (type != typeTable[(size_t)(*cp - '1')]))
-        len = 0;
+    static const unsigned char typeTable[] = {EVENT_TYPE_INT, EVENT_TYPE_LONG, EVENT_TYPE_STRING,
+                                              EVENT_TYPE_LIST, EVENT_TYPE_FLOAT};
 
-      if (len) {
-        ++cp;
-        --len;
-      } else {
-        /* reset the format */
-        outBuf = outBufSave;
-        outBufLen = outBufLenSave;
-      }
+    if ((field->type >= '1') &&
+        (field->type < (char)('1' + (sizeof(typeTable) / sizeof(typeTable[0])))) &&
+        (type != typeTable[(size_t)(field->type - '1')])) {
+      described = false;
+      /* reset the format */
+      outBuf = outBufSave;
+      outBufLen = outBufLenSave;
     }
   }
   outCount = 0;
@@ -804,7 +848,7 @@ static int android_log_printBinaryEvent(const unsigned char** pEventData, size_t
           strLen = eventDataLen;
         }
 
-        if (cp && (strLen == 0)) {
+        if (field && (strLen == 0)) {
           /* reset the format if no content */
           outBuf = outBufSave;
           outBufLen = outBufLenSave;
@@ -845,7 +889,7 @@ static int android_log_printBinaryEvent(const unsigned char** pEventData, size_t
 
         for (i = 0; i < count; i++) {
           result = android_log_printBinaryEvent(&eventData, &eventDataLen, &outBuf, &outBufLen,
-                                                fmtStr, fmtLen);
+                                                format);
           if (result != 0) goto bail;
 
           if (i < (count - 1)) {
@@ -865,9 +909,9 @@ static int android_log_printBinaryEvent(const unsigned char** pEventData, size_t
       fprintf(stderr, "Unknown binary event type %d\n", type);
       return -1;
   }
-  if (cp && len) {
-    if (findChar(&cp, &len, '|') && findChar(&cp, &len, INT_MAX)) {
-      switch (*cp) {
+  if (described) {
+    if (field->unit) {
+      switch (field->unit) {
         case TYPE_OBJECTS:
           outCount = 0;
           /* outCount = snprintf(outBuf, outBufLen, " objects"); */
@@ -955,8 +999,6 @@ static int android_log_printBinaryEvent(const unsigned char** pEventData, size_t
           outCount = 0;
           break;
       }
-      ++cp;
-      --len;
       if (outCount < outBufLen) {
         outBuf += outCount;
         outBufLen -= outCount;
@@ -965,8 +1007,6 @@ static int android_log_printBinaryEvent(const unsigned char** pEventData, size_t
         goto no_room;
       }
     }
-    if (!findChar(&cp, &len, ')')) len = 0;
-    if (!findChar(&cp, &len, ',')) len = 0;
   }
 
 bail:
@@ -974,9 +1014,8 @@ bail:
   *pEventDataLen = eventDataLen;
   *pOutBuf = outBuf;
   *pOutBufLen = outBufLen;
-  if (cp) {
-    *fmtStr = cp;
-    *fmtLen = len;
+  if (field) {
+    format->next = (described && !field->last) ? index + 1 : format->fields->size();
   }
   return result;
 
@@ -1040,9 +1079,15 @@ int android_log_processBinaryLogBuffer(
 
   entry->tagLen = 0;
   entry->tag = NULL;
+  EventFormatState format = {NULL, 0};
 #ifdef __ANDROID__
   if (map != NULL) {
-    entry->tag = android_lookupEventTag_len(map, &entry->tagLen, tagIndex);
+    const EventTagFormat* tagFormat = android_lookupEventTagFormat(map, tagIndex);
+    entry->tag = tagFormat->tag;
+    entry->tagLen = tagFormat->tagLen;
+    if (descriptive_output && !tagFormat->fields.empty()) {
+      format.fields = &tagFormat->fields;
+    }
   }
 #endif
 
@@ -1067,23 +1112,15 @@ int android_log_processBinaryLogBuffer(
   /*
    * Format the event log data into the buffer.
    */
-  const char* fmtStr = NULL;
-  size_t fmtLen = 0;
-#ifdef __ANDROID__
-  if (descriptive_output && map) {
-    fmtStr = android_lookupEventFormat_len(map, &fmtLen, tagIndex);
-  }
-#endif
-
   char* outBuf = messageBuf;
   size_t outRemaining = messageBufLen - 1; /* leave one for nul byte */
   int result = 0;
 
-  if ((inCount > 0) || fmtLen) {
-    result = android_log_printBinaryEvent(&eventData, &inCount, &outBuf, &outRemaining, &fmtStr,
-                                          &fmtLen);
+  if ((inCount > 0) || format.fields) {
+    result = android_log_printBinaryEvent(&eventData, &inCount, &outBuf, &outRemaining,
+                                          format.fields ? &format : NULL);
   }
-  if ((result == 1) && fmtStr) {
+  if ((result == 1) && format.fields) {
     /* We overflowed :-(, let's repaint the line w/o format dressings */
     eventData = (const unsigned char*)buf->msg;
     if (buf2->hdr_size) {
@@ -1092,7 +1129,7 @@ int android_log_processBinaryLogBuffer(
     eventData += 4;
     outBuf = messageBuf;
     outRemaining = messageBufLen - 1;
-    result = android_log_printBinaryEvent(&eventData, &inCount, &outBuf, &outRemaining, NULL, NULL);
+    result = android_log_printBinaryEvent(&eventData, &inCount, &outBuf, &outRemaining, NULL);
   }
   if (result < 0) {
     fprintf(stderr, "Binary log entry conversion failed\n");
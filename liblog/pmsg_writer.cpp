@@ -20,6 +20,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
@@ -49,7 +50,109 @@ struct android_log_transport_write pmsgLoggerWrite = {
     .write = pmsgWrite,
 };
 
+/*
+ * With ro.logd.pmsg.batch set, entries are collected in a small per process
+ * buffer and written to pstore together, which cuts the cost of persistent
+ * logging to about one syscall per batch. pstore keeps no write boundaries
+ * and the reader already splits the stream on the pmsg headers, so batches
+ * need no framing of their own.
+ *
+ * A batch is written once it is full, once its first entry is older than
+ * PMSG_BATCH_AGE_NS (checked on the next entry), right away for crash,
+ * security and error or higher entries, and on close, fork and exit.
+ */
+#define PMSG_BATCH_SIZE 8192
+#define PMSG_BATCH_AGE_NS (100 * 1000000LL)
+
+static struct {
+  pthread_mutex_t lock;
+  bool enabled;
+  size_t len;
+  int64_t startNs;
+  unsigned char buf[PMSG_BATCH_SIZE];
+} pmsgBatch = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static pthread_once_t pmsgBatchOnce = PTHREAD_ONCE_INIT;
+
+static int64_t pmsgNowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* pmsgBatch.lock held */
+static ssize_t pmsgBatchFlushLocked() {
+  ssize_t ret = 0;
+  if (pmsgBatch.len) {
+    int fd = atomic_load(&pmsgLoggerWrite.context.fd);
+    ret = (fd < 0) ? -EBADF : TEMP_FAILURE_RETRY(write(fd, pmsgBatch.buf, pmsgBatch.len));
+    if (ret < 0) {
+      ret = errno ? -errno : -ENOTCONN;
+    }
+    pmsgBatch.len = 0;
+  }
+  return ret;
+}
+
+static void pmsgBatchFlush() {
+  pthread_mutex_lock(&pmsgBatch.lock);
+  pmsgBatchFlushLocked();
+  pthread_mutex_unlock(&pmsgBatch.lock);
+}
+
+static void pmsgBatchPrepare() {
+  pthread_mutex_lock(&pmsgBatch.lock);
+}
+
+static void pmsgBatchParent() {
+  pthread_mutex_unlock(&pmsgBatch.lock);
+}
+
+static void pmsgBatchChild() {
+  /* The parent writes what was buffered. */
+  pmsgBatch.len = 0;
+  pthread_mutex_unlock(&pmsgBatch.lock);
+}
+
+static void pmsgBatchInit() {
+  pmsgBatch.enabled = __android_logger_property_get_bool("ro.logd.pmsg.batch", BOOL_DEFAULT_FALSE);
+  if (pmsgBatch.enabled) {
+    pthread_atfork(pmsgBatchPrepare, pmsgBatchParent, pmsgBatchChild);
+    atexit(pmsgBatchFlush);
+  }
+}
+
+/* Returns the length of the entry, or a negative errno if a write failed. */
+static ssize_t pmsgBatchWrite(const struct iovec* vec, size_t nr, size_t len, bool flush) {
+  ssize_t ret = len;
+  pthread_mutex_lock(&pmsgBatch.lock);
+  int64_t now = pmsgNowNs();
+  if (pmsgBatch.len + len > sizeof(pmsgBatch.buf)) {
+    ssize_t err = pmsgBatchFlushLocked();
+    if (err < 0) {
+      ret = err;
+    }
+  }
+  if (!pmsgBatch.len) {
+    pmsgBatch.startNs = now;
+  }
+  for (size_t i = 0; i < nr; ++i) {
+    memcpy(pmsgBatch.buf + pmsgBatch.len, vec[i].iov_base, vec[i].iov_len);
+    pmsgBatch.len += vec[i].iov_len;
+  }
+  if (flush || ((now - pmsgBatch.startNs) >= PMSG_BATCH_AGE_NS)) {
+    ssize_t err = pmsgBatchFlushLocked();
+    if (err < 0) {
+      ret = err;
+    }
+  }
+  pthread_mutex_unlock(&pmsgBatch.lock);
+  return ret;
+}
+
 static int pmsgOpen() {
+  pthread_once(&pmsgBatchOnce, pmsgBatchInit);
+
   int fd = atomic_load(&pmsgLoggerWrite.context.fd);
   if (fd < 0) {
     int i;
@@ -65,6 +168,9 @@ static int pmsgOpen() {
 }
 
 static void pmsgClose() {
+  if (pmsgBatch.enabled) {
+    pmsgBatchFlush();
+  }
   int fd = atomic_exchange(&pmsgLoggerWrite.context.fd, -1);
   if (fd >= 0) {
     close(fd);
@@ -166,9 +272,16 @@ static int pmsgWrite(log_id_t logId, struct timespec* ts, struct iovec* vec, siz
   }
   pmsgHeader.len += payloadSize;
 
-  ret = TEMP_FAILURE_RETRY(writev(atomic_load(&pmsgLoggerWrite.context.fd), newVec, i));
-  if (ret < 0) {
-    ret = errno ? -errno : -ENOTCONN;
+  if (pmsgBatch.enabled) {
+    bool flush = (logId == LOG_ID_CRASH) || (logId == LOG_ID_SECURITY) ||
+                 ((logId != LOG_ID_EVENTS) && vec[0].iov_len &&
+                  (*static_cast<char*>(vec[0].iov_base) >= ANDROID_LOG_ERROR));
+    ret = pmsgBatchWrite(newVec, i, pmsgHeader.len, flush);
+  } else {
+    ret = TEMP_FAILURE_RETRY(writev(atomic_load(&pmsgLoggerWrite.context.fd), newVec, i));
+    if (ret < 0) {
+      ret = errno ? -errno : -ENOTCONN;
+    }
   }
 
   if (ret > (ssize_t)(sizeof(header) + sizeof(pmsgHeader))) {
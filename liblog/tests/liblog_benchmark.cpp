@@ -25,12 +25,14 @@
 #include <unistd.h>
 
 #include <unordered_set>
+#include <vector>
 
 #include <android-base/file.h>
 #include <benchmark/benchmark.h>
 #include <cutils/sockets.h>
 #include <log/event_tag_map.h>
 #include <log/log_transport.h>
+#include <log/logprint.h>
 #include <private/android_logger.h>
 
 BENCHMARK_MAIN();
@@ -945,6 +947,67 @@ static void BM_lookupEventTagNum(benchmark::State& state) {
 }
 BENCHMARK(BM_lookupEventTagNum);
 
+// Snapshot of the events buffer, kept around for multiple iterations
+static std::vector<log_msg> events;
+
+static bool prechargeEvents() {
+  if (!events.empty()) return true;
+
+  struct logger_list* logger_list =
+      android_logger_list_open(LOG_ID_EVENTS, ANDROID_LOG_RDONLY | ANDROID_LOG_NONBLOCK, 0, 0);
+  if (!logger_list) return false;
+  log_msg log_msg;
+  while (android_logger_list_read(logger_list, &log_msg) > 0) {
+    events.push_back(log_msg);
+  }
+  android_logger_list_close(logger_list);
+
+  return !events.empty();
+}
+
+static void do_processBinaryLogBuffer(benchmark::State& state, bool descriptive) {
+  prechargeEventMap();
+  if (!prechargeEvents()) {
+    state.SkipWithError("events buffer empty");
+    return;
+  }
+
+  AndroidLogFormat* logformat = android_log_format_new();
+  if (descriptive) {
+    android_log_setPrintFormat(logformat, FORMAT_MODIFIER_DESCRIPT);
+  }
+
+  std::vector<log_msg>::const_iterator it = events.begin();
+  int64_t bytes = 0;
+
+  while (state.KeepRunning()) {
+    AndroidLogEntry entry;
+    char msgBuf[1024];
+    log_msg msg = *it;
+    android_log_processBinaryLogBuffer(&msg.entry_v1, &entry, map, msgBuf, sizeof(msgBuf));
+    bytes += msg.entry.len;
+    ++it;
+    if (it == events.end()) it = events.begin();
+  }
+  state.SetBytesProcessed(bytes);
+
+  android_log_format_free(logformat);
+}
+
+/*
+ *	Measure the time it takes for android_log_processBinaryLogBuffer
+ *	to format the entries of the events buffer
+ */
+static void BM_processBinaryLogBuffer(benchmark::State& state) {
+  do_processBinaryLogBuffer(state, false);
+}
+BENCHMARK(BM_processBinaryLogBuffer);
+
+static void BM_processBinaryLogBuffer_descriptive(benchmark::State& state) {
+  do_processBinaryLogBuffer(state, true);
+}
+BENCHMARK(BM_processBinaryLogBuffer_descriptive);
+
 // Must be functionally identical to liblog internal __send_log_msg.
 static void send_to_control(char* buf, size_t len) {
   int sock =
@@ -23,6 +23,7 @@
 #include <semaphore.h>
 #include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -611,6 +612,60 @@ TEST(liblog, __android_log_buf_write_and_print__newline_space_prefix) {
   buf_write_test("\n Hello World \n");
 }
 
+TEST(liblog, __android_log_set_async) {
+#if (defined(__ANDROID__) && defined(USING_LOGGER_DEFAULT))
+  struct logger_list* logger_list;
+
+  pid_t pid = getpid();
+
+  ASSERT_TRUE(
+      NULL !=
+      (logger_list = android_logger_list_open(
+           LOG_ID_MAIN, ANDROID_LOG_RDONLY | ANDROID_LOG_NONBLOCK, 1000, pid)));
+
+  static const char tag[] = "TEST__android_log_set_async";
+  static const int entries = 200;  // more than the ring holds
+
+  ASSERT_EQ(0, __android_log_set_async(1));
+  for (int i = 0; i < entries; ++i) {
+    EXPECT_LT(0, __android_log_buf_print(LOG_ID_MAIN, ANDROID_LOG_INFO, tag,
+                                         "%d", i));
+  }
+  EXPECT_EQ(0, __android_log_set_async(0));
+  usleep(1000000);
+
+  int count = 0;
+  bool ordered = true;
+
+  for (;;) {
+    log_msg log_msg;
+    if (android_logger_list_read(logger_list, &log_msg) <= 0) {
+      break;
+    }
+
+    if ((log_msg.entry.pid != pid) || (log_msg.id() != LOG_ID_MAIN)) {
+      continue;
+    }
+    AndroidLogEntry entry;
+    if (android_log_processLogBuffer(&log_msg.entry_v1, &entry) ||
+        strcmp(entry.tag, tag)) {
+      continue;
+    }
+    if (atoi(entry.message) != count) {
+      ordered = false;
+    }
+    ++count;
+  }
+
+  EXPECT_EQ(entries, count);
+  EXPECT_TRUE(ordered);
+
+  android_logger_list_close(logger_list);
+#else
+  GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
+}
+
 #ifdef USING_LOGGER_DEFAULT  // requires blocking reader functionality
 #ifdef TEST_PREFIX
 static unsigned signaled;
@@ -1415,6 +1470,22 @@ TEST(liblog, filterRule) {
 
   android_log_format_free(p_format);
 }
+
+TEST(liblog, minPrintPriority) {
+  AndroidLogFormat* p_format = android_log_format_new();
+
+  EXPECT_EQ(ANDROID_LOG_VERBOSE, android_log_minPrintPriority(p_format));
+  EXPECT_EQ(0, android_log_addFilterString(p_format, "*:w"));
+  EXPECT_EQ(ANDROID_LOG_WARN, android_log_minPrintPriority(p_format));
+  EXPECT_EQ(0, android_log_addFilterString(p_format, "random:e"));
+  EXPECT_EQ(ANDROID_LOG_WARN, android_log_minPrintPriority(p_format));
+  EXPECT_EQ(0, android_log_addFilterString(p_format, "crap:i *:s"));
+  EXPECT_EQ(ANDROID_LOG_INFO, android_log_minPrintPriority(p_format));
+  EXPECT_EQ(0, android_log_addFilterString(p_format, "random"));
+  EXPECT_EQ(ANDROID_LOG_VERBOSE, android_log_minPrintPriority(p_format));
+
+  android_log_format_free(p_format);
+}
 #endif  // USING_LOGGER_DEFAULT
 
 #ifdef USING_LOGGER_DEFAULT  // Do not retest property handling
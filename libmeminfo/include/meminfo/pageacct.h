@@ -20,6 +20,7 @@
 #include <unistd.h>
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <android-base/unique_fd.h>
@@ -41,6 +42,19 @@ class PageAcct final {
 
     int IsPageIdle(uint64_t pfn);
 
+    // Batched idle page tracking for many page frames, with one read or write of the idle
+    // bitmap per run of nearby page frames. pfns must be sorted.
+    // Sets (*idle)[i] to whether pfns[i] has not been accessed since it was last marked idle.
+    bool PagesIdle(const std::vector<uint64_t>& pfns, std::vector<bool>* idle);
+    // Marks all of pfns idle, and no other page frames.
+    bool MarkPagesIdle(const std::vector<uint64_t>& pfns);
+
+    // Keeps the kpageflags and kpagecount entries read by PageFlags and PageMapCount, in
+    // blocks of neighbouring page frames, so that pages shared with processes already looked
+    // at cost no further reads. The kept entries go stale as the system runs, so this is meant
+    // for tools that take one snapshot of many processes. Disabling drops them.
+    void SetCacheEnabled(bool enabled);
+
     // The only way to create PageAcct object
     static PageAcct& Instance() {
         static PageAcct instance;
@@ -50,10 +64,18 @@ class PageAcct final {
     ~PageAcct() = default;
 
   private:
-    PageAcct() : kpagecount_fd_(-1), kpageflags_fd_(-1), pageidle_fd_(-1) {}
+    PageAcct() : kpagecount_fd_(-1), kpageflags_fd_(-1), pageidle_fd_(-1), cache_enabled_(false) {}
     int MarkPageIdle(uint64_t pfn) const;
     int GetPageIdle(uint64_t pfn) const;
 
+    // Calls f(first_word, num_words, begin, end) for runs of idle bitmap words, where
+    // pfns[begin, end) are the page frames that fall in the run.
+    template <typename F>
+    bool ForEachIdleBitmapRun(const std::vector<uint64_t>& pfns, F&& f);
+
+    using EntryCache = std::unordered_map<uint64_t, std::vector<uint64_t>>;
+    bool ReadEntry(int fd, EntryCache* cache, uint64_t pfn, uint64_t* value);
+
     // Non-copyable & Non-movable
     PageAcct(const PageAcct&) = delete;
     PageAcct& operator=(const PageAcct&) = delete;
@@ -63,6 +85,10 @@ class PageAcct final {
     ::android::base::unique_fd kpagecount_fd_;
     ::android::base::unique_fd kpageflags_fd_;
     ::android::base::unique_fd pageidle_fd_;
+
+    bool cache_enabled_;
+    EntryCache flags_cache_;
+    EntryCache count_cache_;
 };
 
 // Returns if the page present bit is set in the value
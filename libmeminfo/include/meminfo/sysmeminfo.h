@@ -23,6 +23,8 @@
 #include <string>
 #include <vector>
 
+#include <android-base/unique_fd.h>
+
 namespace android {
 namespace meminfo {
 
@@ -84,6 +86,29 @@ class SysMemInfo final {
                      std::function<void(const std::string&, uint64_t)> store_val);
 };
 
+// Reads the values of a fixed set of tags from /proc/meminfo, keeping the file open between
+// reads and reading it into a buffer of its own, so that nothing is allocated after
+// construction. For callers that sample memory at a high rate.
+class MemInfoReader final {
+  public:
+    // tags are as for SysMemInfo::ReadMemInfo, except that "Zram:" is not supported.
+    explicit MemInfoReader(const std::vector<std::string>& tags = SysMemInfo::kDefaultSysMemInfoTags,
+                           const std::string& path = "/proc/meminfo");
+
+    // Stores the value of each tag in the same order as the tags into out, which must have
+    // room for all of them. Tags that are missing from the file are stored as 0.
+    bool Read(uint64_t* out);
+
+  private:
+    MemInfoReader(const MemInfoReader&) = delete;
+    MemInfoReader& operator=(const MemInfoReader&) = delete;
+
+    std::vector<std::string> tags_;
+    std::string path_;
+    ::android::base::unique_fd fd_;
+    char buffer_[4096];
+};
+
 // Parse /proc/vmallocinfo and return total physical memory mapped
 // in vmalloc area by the kernel. Note that this deliberately ignores binder buffers. They are
 // _always_ mapped in a process and are counted for in each process.
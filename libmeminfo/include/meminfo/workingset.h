@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include <android-base/unique_fd.h>
+
+#include "meminfo.h"
+
+namespace android {
+namespace meminfo {
+
+class WorkingSetTracker final {
+    // Continuous working set estimation for one process using CONFIG_IDLE_PAGE_TRACKING.
+    //
+    // Each call to Sample() finds the resident pages of the process, checks which of them were
+    // accessed since the previous call, and marks them all idle again. Every page has an age, the
+    // number of samples since it was last seen accessed, and each mapping keeps a histogram of
+    // its resident bytes by age. The working set over the last n samples is the bytes with an
+    // age below n.
+  public:
+    struct VmaWorkingSet {
+        Vma vma;
+        // bytes_by_age[i] is the resident bytes last accessed i samples ago. The last entry
+        // also has everything older.
+        std::vector<uint64_t> bytes_by_age;
+
+        // Age of each page of the mapping, kNotResident for pages that weren't resident.
+        std::vector<uint8_t> page_ages;
+    };
+
+    static constexpr uint8_t kNotResident = 0xff;
+
+    // num_ages is the number of histogram buckets, at most 255.
+    explicit WorkingSetTracker(pid_t pid, size_t num_ages = 16);
+
+    // Samples the idle state of the pages of the process. Pages seen for the first time start with
+    // an age of 0, so the first sample reports every resident page as in use.
+    bool Sample();
+
+    // Resident bytes accessed within the last 'samples' samples.
+    uint64_t WorkingSetBytes(size_t samples) const;
+
+    const std::vector<VmaWorkingSet>& Vmas() const { return vmas_; }
+    size_t num_ages() const { return num_ages_; }
+
+  private:
+    WorkingSetTracker(const WorkingSetTracker&) = delete;
+    WorkingSetTracker& operator=(const WorkingSetTracker&) = delete;
+
+    bool ReadVmas(std::vector<VmaWorkingSet>* vmas);
+
+    pid_t pid_;
+    size_t num_ages_;
+    ::android::base::unique_fd pagemap_fd_;
+    std::vector<VmaWorkingSet> vmas_;
+};
+
+}  // namespace meminfo
+}  // namespace android
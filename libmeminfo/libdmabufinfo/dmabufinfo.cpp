@@ -16,6 +16,7 @@
 
 #include <dirent.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
@@ -25,6 +26,8 @@
 #include <filesystem>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <android-base/file.h>
@@ -39,10 +42,33 @@
 namespace android {
 namespace dmabufinfo {
 
-static bool FileIsDmaBuf(const std::string& path) {
+static bool FileIsDmaBuf(std::string_view path) {
     return ::android::base::StartsWith(path, "/dmabuf");
 }
 
+// The position in 'dmabufs' of each buffer, by inode.
+using InodeIndex = std::unordered_map<ino_t, size_t>;
+
+static InodeIndex BuildInodeIndex(const std::vector<DmaBuffer>& dmabufs) {
+    InodeIndex index;
+    index.reserve(dmabufs.size());
+    for (size_t i = 0; i < dmabufs.size(); i++) {
+        index.emplace(dmabufs[i].inode(), i);
+    }
+    return index;
+}
+
+static DmaBuffer* FindDmaBuf(std::vector<DmaBuffer>* dmabufs, const InodeIndex& index,
+                             ino_t inode) {
+    auto it = index.find(inode);
+    return it == index.end() ? nullptr : &(*dmabufs)[it->second];
+}
+
+static bool HasFdInfo(const DmaBuffer& buf) {
+    return buf.name() != "" && buf.name() != "<unknown>" && buf.exporter() != "" &&
+           buf.exporter() != "<unknown>" && buf.count() != 0;
+}
+
 static bool ReadDmaBufFdInfo(pid_t pid, int fd, std::string* name, std::string* exporter,
                              uint64_t* count) {
     std::string fdinfo = ::android::base::StringPrintf("/proc/%d/fdinfo/%d", pid, fd);
@@ -81,22 +107,7 @@ static bool ReadDmaBufFdInfo(pid_t pid, int fd, std::string* name, std::string*
     return true;
 }
 
-// TODO: std::filesystem::is_symlink fails to link on vendor code,
-// forcing this workaround.
-// Move back to libc++fs once it is vendor-available. See b/124012728
-static bool is_symlink(const char *filename)
-{
-    struct stat p_statbuf;
-    if (lstat(filename, &p_statbuf) < 0) {
-        return false;
-    }
-    if (S_ISLNK(p_statbuf.st_mode) == 1) {
-        return true;
-    }
-    return false;
-}
-
-static bool ReadDmaBufFdRefs(pid_t pid, std::vector<DmaBuffer>* dmabufs) {
+static bool ReadDmaBufFdRefs(pid_t pid, std::vector<DmaBuffer>* dmabufs, InodeIndex* index) {
     std::string fdpath = ::android::base::StringPrintf("/proc/%d/fd", pid);
 
     std::unique_ptr<DIR, int (*)(DIR*)> dir(opendir(fdpath.c_str()), closedir);
@@ -105,51 +116,55 @@ static bool ReadDmaBufFdRefs(pid_t pid, std::vector<DmaBuffer>* dmabufs) {
         return false;
     }
     struct dirent* dent;
+    char target[PATH_MAX];
     while ((dent = readdir(dir.get()))) {
-        std::string path =
-            ::android::base::StringPrintf("%s/%s", fdpath.c_str(), dent->d_name);
-
-        if (!strcmp(dent->d_name, ".") || !strcmp(dent->d_name, "..") ||
-            !is_symlink(path.c_str())) {
+        // Every open file descriptor is a symlink, so this also skips "." and "..".
+        if (dent->d_type != DT_LNK) {
             continue;
         }
 
-        std::string target;
-        if (!::android::base::Readlink(path, &target)) {
-            LOG(ERROR) << "Failed to find target for symlink: " << path;
+        ssize_t len = readlinkat(dirfd(dir.get()), dent->d_name, target, sizeof(target));
+        if (len < 0 || static_cast<size_t>(len) == sizeof(target)) {
+            PLOG(ERROR) << "Failed to find target for symlink: " << fdpath << "/" << dent->d_name;
             return false;
         }
 
-        if (!FileIsDmaBuf(target)) {
+        if (!FileIsDmaBuf(std::string_view(target, len))) {
             continue;
         }
 
         int fd;
         if (!::android::base::ParseInt(dent->d_name, &fd)) {
-            LOG(ERROR) << "Dmabuf fd: " << path << " is invalid";
+            LOG(ERROR) << "Dmabuf fd: " << fdpath << "/" << dent->d_name << " is invalid";
             return false;
         }
 
+        struct stat sb;
+        if (fstatat(dirfd(dir.get()), dent->d_name, &sb, 0) < 0) {
+            PLOG(ERROR) << "Failed to stat: " << fdpath << "/" << dent->d_name;
+            return false;
+        }
+
+        uint64_t inode = sb.st_ino;
+        DmaBuffer* buf = FindDmaBuf(dmabufs, *index, inode);
+        // The fdinfo of a buffer that is already fully known from another fd or process has
+        // nothing new to tell.
+        if (buf != nullptr && HasFdInfo(*buf)) {
+            buf->AddFdRef(pid);
+            continue;
+        }
+
         // Set defaults in case the kernel doesn't give us the information
         // we need in fdinfo
         std::string name = "<unknown>";
         std::string exporter = "<unknown>";
         uint64_t count = 0;
         if (!ReadDmaBufFdInfo(pid, fd, &name, &exporter, &count)) {
-            LOG(ERROR) << "Failed to read fdinfo for: " << path;
+            LOG(ERROR) << "Failed to read fdinfo for: " << fdpath << "/" << dent->d_name;
             return false;
         }
 
-        struct stat sb;
-        if (stat(path.c_str(), &sb) < 0) {
-            PLOG(ERROR) << "Failed to stat: " << path;
-            return false;
-        }
-
-        uint64_t inode = sb.st_ino;
-        auto buf = std::find_if(dmabufs->begin(), dmabufs->end(),
-                                [&inode](const DmaBuffer& dbuf) { return dbuf.inode() == inode; });
-        if (buf != dmabufs->end()) {
+        if (buf != nullptr) {
             if (buf->name() == "" || buf->name() == "<unknown>") buf->SetName(name);
             if (buf->exporter() == "" || buf->exporter() == "<unknown>") buf->SetExporter(exporter);
             if (buf->count() == 0) buf->SetCount(count);
@@ -157,6 +172,7 @@ static bool ReadDmaBufFdRefs(pid_t pid, std::vector<DmaBuffer>* dmabufs) {
             continue;
         }
 
+        index->emplace(inode, dmabufs->size());
         DmaBuffer& db = dmabufs->emplace_back(sb.st_ino, sb.st_blocks * 512, count, exporter, name);
         db.AddFdRef(pid);
     }
@@ -164,7 +180,7 @@ static bool ReadDmaBufFdRefs(pid_t pid, std::vector<DmaBuffer>* dmabufs) {
     return true;
 }
 
-static bool ReadDmaBufMapRefs(pid_t pid, std::vector<DmaBuffer>* dmabufs) {
+static bool ReadDmaBufMapRefs(pid_t pid, std::vector<DmaBuffer>* dmabufs, InodeIndex* index) {
     std::string mapspath = ::android::base::StringPrintf("/proc/%d/maps", pid);
     auto fp = std::unique_ptr<FILE, decltype(&fclose)>{fopen(mapspath.c_str(), "re"), fclose};
     if (fp == nullptr) {
@@ -180,18 +196,18 @@ static bool ReadDmaBufMapRefs(pid_t pid, std::vector<DmaBuffer>* dmabufs) {
     auto account_dmabuf = [&](uint64_t start, uint64_t end, uint16_t /* flags */,
                               uint64_t /* pgoff */, ino_t inode, const char* name) {
         // no need to look into this mapping if it is not dmabuf
-        if (!FileIsDmaBuf(std::string(name))) {
+        if (!FileIsDmaBuf(name)) {
             return;
         }
 
-        auto buf = std::find_if(dmabufs->begin(), dmabufs->end(),
-                                [&inode](const DmaBuffer& dbuf) { return dbuf.inode() == inode; });
-        if (buf != dmabufs->end()) {
+        DmaBuffer* buf = FindDmaBuf(dmabufs, *index, inode);
+        if (buf != nullptr) {
             buf->AddMapRef(pid);
             return;
         }
 
         // We have a new buffer, but unknown count and name
+        index->emplace(inode, dmabufs->size());
         DmaBuffer& dbuf = dmabufs->emplace_back(inode, end - start, 0, "<unknown>", "<unknown>");
         dbuf.AddMapRef(pid);
     };
@@ -248,18 +264,58 @@ bool ReadDmaBufInfo(pid_t pid, std::vector<DmaBuffer>* dmabufs) {
     return AppendDmaBufInfo(pid, dmabufs);
 }
 
-bool AppendDmaBufInfo(pid_t pid, std::vector<DmaBuffer>* dmabufs) {
-    if (!ReadDmaBufFdRefs(pid, dmabufs)) {
+static bool AppendDmaBufInfo(pid_t pid, std::vector<DmaBuffer>* dmabufs, InodeIndex* index) {
+    if (!ReadDmaBufFdRefs(pid, dmabufs, index)) {
         LOG(ERROR) << "Failed to read dmabuf fd references";
         return false;
     }
 
-    if (!ReadDmaBufMapRefs(pid, dmabufs)) {
+    if (!ReadDmaBufMapRefs(pid, dmabufs, index)) {
         LOG(ERROR) << "Failed to read dmabuf map references";
         return false;
     }
     return true;
 }
 
+bool AppendDmaBufInfo(pid_t pid, std::vector<DmaBuffer>* dmabufs) {
+    InodeIndex index = BuildInodeIndex(*dmabufs);
+    return AppendDmaBufInfo(pid, dmabufs, &index);
+}
+
+bool AppendDmaBufInfoForAllProcesses(std::vector<DmaBuffer>* dmabufs,
+                                     std::unordered_map<pid_t, uint64_t>* pid_totals) {
+    std::unique_ptr<DIR, int (*)(DIR*)> dir(opendir("/proc"), closedir);
+    if (!dir) {
+        PLOG(ERROR) << "Failed to open /proc directory";
+        return false;
+    }
+
+    InodeIndex index = BuildInodeIndex(*dmabufs);
+    struct dirent* dent;
+    while ((dent = readdir(dir.get()))) {
+        if (dent->d_type != DT_DIR) continue;
+
+        pid_t pid;
+        if (!::android::base::ParseInt(dent->d_name, &pid, 1)) {
+            continue;
+        }
+
+        if (!AppendDmaBufInfo(pid, dmabufs, &index)) {
+            LOG(ERROR) << "Unable to read dmabuf info for pid " << pid;
+            return false;
+        }
+    }
+
+    if (pid_totals != nullptr) {
+        pid_totals->clear();
+        for (const DmaBuffer& buf : *dmabufs) {
+            for (pid_t pid : buf.pids()) {
+                (*pid_totals)[pid] += buf.size();
+            }
+        }
+    }
+    return true;
+}
+
 }  // namespace dmabufinfo
 }  // namespace android
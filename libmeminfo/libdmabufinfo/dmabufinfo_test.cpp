@@ -22,6 +22,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <fstream>
 #include <string>
 #include <unordered_map>
@@ -339,6 +340,27 @@ TEST_F(DmaBufTester, TestFdRef) {
     EXPECT_TRUE(dmabufs.empty());
 }
 
+TEST_F(DmaBufTester, TestAllProcesses) {
+    // Test that the system wide walk finds the buffer and accounts it to this
+    // process
+    ASSERT_TRUE(is_valid());
+    pid_t pid = getpid();
+    std::vector<DmaBuffer> dmabufs;
+    std::unordered_map<pid_t, uint64_t> pid_totals;
+    {
+        unique_fd buf = allocate(4096, "dmabuftester-4k");
+        ASSERT_GT(buf, 0) << "Allocated buffer is invalid";
+        ASSERT_TRUE(AppendDmaBufInfoForAllProcesses(&dmabufs, &pid_totals));
+
+        auto it = std::find_if(dmabufs.begin(), dmabufs.end(), [](const DmaBuffer& dmabuf) {
+            return dmabuf.name() == "dmabuftester-4k";
+        });
+        ASSERT_NE(it, dmabufs.end());
+        EXPECT_PID_IN_FDREFS(it, pid, true);
+        EXPECT_GE(pid_totals[pid], 4096ULL);
+    }
+}
+
 TEST_F(DmaBufTester, TestMapRef) {
     // Test to make sure we can find a buffer if the fd is closed but the buffer
     // is mapped
@@ -109,5 +109,13 @@ bool ReadDmaBufInfo(pid_t pid, std::vector<DmaBuffer>* dmabufs);
 // Returns false if something went wrong with the function, true otherwise.
 bool AppendDmaBufInfo(pid_t pid, std::vector<DmaBuffer>* dmabufs);
 
+// Same as AppendDmaBufInfo, for every process in /proc in one pass. Buffers are matched by
+// inode in a single index across all processes, and the fdinfo of a buffer is only read until
+// its name, exporter and count are known. If pid_totals is not null, it is set to the total size
+// of the buffers each process references.
+// Returns false if something went wrong with the function, true otherwise.
+bool AppendDmaBufInfoForAllProcesses(std::vector<DmaBuffer>* dmabufs,
+                                     std::unordered_map<pid_t, uint64_t>* pid_totals = nullptr);
+
 }  // namespace dmabufinfo
 }  // namespace android
@@ -14,7 +14,6 @@
  * limitations under the License.
  */
 
-#include <dirent.h>
 #include <errno.h>
 #include <getopt.h>
 #include <inttypes.h>
@@ -182,29 +181,12 @@ static bool ReadDmaBufs(std::vector<DmaBuffer>* bufs) {
         return false;
     }
 
-    std::unique_ptr<DIR, int (*)(DIR*)> dir(opendir("/proc"), closedir);
-    if (!dir) {
-        fprintf(stderr, "Failed to open /proc directory\n");
+    if (!AppendDmaBufInfoForAllProcesses(bufs)) {
+        fprintf(stderr, "Unable to read dmabuf info for all processes\n");
         bufs->clear();
         return false;
     }
 
-    struct dirent* dent;
-    while ((dent = readdir(dir.get()))) {
-        if (dent->d_type != DT_DIR) continue;
-
-        int pid = atoi(dent->d_name);
-        if (pid == 0) {
-            continue;
-        }
-
-        if (!AppendDmaBufInfo(pid, bufs)) {
-            fprintf(stderr, "Unable to read dmabuf info for pid %d\n", pid);
-            bufs->clear();
-            return false;
-        }
-    }
-
     return true;
 }
 
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <linux/kernel-page-flags.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -27,6 +28,7 @@
 #include <meminfo/pageacct.h>
 #include <meminfo/procmeminfo.h>
 #include <meminfo/sysmeminfo.h>
+#include <meminfo/workingset.h>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -159,6 +161,85 @@ TEST(ProcMemInfo, PageMapPresent) {
     ASSERT_EQ(0, munmap(reinterpret_cast<void*>(addr), kNumPages * pagesize));
 }
 
+TEST(PageAcct, CachedEntries) {
+    static constexpr size_t kNumPages = 8;
+    size_t pagesize = getpagesize();
+    void* ptr = mmap(nullptr, pagesize * kNumPages, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(MAP_FAILED, ptr);
+    uint8_t* data = reinterpret_cast<uint8_t*>(ptr);
+    for (size_t i = 0; i < kNumPages; i++) {
+        data[i * pagesize] = 1;
+    }
+
+    Vma vma;
+    vma.start = reinterpret_cast<uint64_t>(ptr);
+    vma.end = vma.start + pagesize * kNumPages;
+    ProcMemInfo proc_mem(getpid());
+    std::vector<uint64_t> pagemap;
+    ASSERT_TRUE(proc_mem.PageMap(vma, &pagemap));
+    ASSERT_EQ(kNumPages, pagemap.size());
+
+    PageAcct& pinfo = PageAcct::Instance();
+    for (int cached = 0; cached < 2; cached++) {
+        pinfo.SetCacheEnabled(cached);
+        for (size_t i = 0; i < kNumPages; i++) {
+            ASSERT_TRUE(page_present(pagemap[i])) << "Page " << i << " is not present.";
+            uint64_t pfn = page_pfn(pagemap[i]);
+            uint64_t flags, mapcount;
+            ASSERT_TRUE(pinfo.PageFlags(pfn, &flags));
+            ASSERT_TRUE(pinfo.PageMapCount(pfn, &mapcount));
+            EXPECT_TRUE(flags & (1 << KPF_ANON)) << "Page " << i << " is not anonymous.";
+            EXPECT_EQ(1, mapcount) << "Page " << i << " is shared.";
+        }
+    }
+    pinfo.SetCacheEnabled(false);
+
+    ASSERT_EQ(0, munmap(ptr, pagesize * kNumPages));
+}
+
+TEST(WorkingSetTracker, Ages) {
+    if (!PageAcct::KernelHasPageIdle()) {
+        GTEST_SKIP() << "Idle page tracking is not supported by the kernel";
+    }
+
+    static constexpr size_t kNumPages = 16;
+    size_t pagesize = getpagesize();
+    void* ptr = mmap(nullptr, pagesize * kNumPages, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(MAP_FAILED, ptr);
+    volatile uint8_t* data = reinterpret_cast<uint8_t*>(ptr);
+    for (size_t i = 0; i < kNumPages; i++) {
+        data[i * pagesize] = 1;
+    }
+
+    using VmaWorkingSet = WorkingSetTracker::VmaWorkingSet;
+    auto find_vma = [&](const WorkingSetTracker& tracker) -> const VmaWorkingSet* {
+        for (auto& ws : tracker.Vmas()) {
+            if (ws.vma.start == reinterpret_cast<uint64_t>(ptr)) return &ws;
+        }
+        return nullptr;
+    };
+
+    WorkingSetTracker tracker(getpid(), 4);
+    ASSERT_TRUE(tracker.Sample());
+    const VmaWorkingSet* ws = find_vma(tracker);
+    ASSERT_TRUE(ws != nullptr);
+    EXPECT_EQ(kNumPages * pagesize, ws->bytes_by_age[0]);
+
+    // Only the first 4 pages are accessed between the samples.
+    for (size_t i = 0; i < 4; i++) {
+        data[i * pagesize] = 2;
+    }
+    ASSERT_TRUE(tracker.Sample());
+    ws = find_vma(tracker);
+    ASSERT_TRUE(ws != nullptr);
+    EXPECT_EQ(4 * pagesize, ws->bytes_by_age[0]);
+    EXPECT_EQ((kNumPages - 4) * pagesize, ws->bytes_by_age[1]);
+
+    ASSERT_EQ(0, munmap(ptr, pagesize * kNumPages));
+}
+
 TEST(ProcMemInfo, WssEmpty) {
     // If we created the object for getting usage,
     // the working set must be empty
@@ -574,6 +655,54 @@ Hugepagesize:       2048 kB)meminfo";
     EXPECT_EQ(mi.mem_kernel_stack_kb(), 4880);
 }
 
+TEST(SysMemInfo, TestMemInfoReader) {
+    std::string meminfo = R"meminfo(MemTotal:        3019740 kB
+MemFree:         1809728 kB
+MemAvailable:    2546560 kB
+Buffers:           54736 kB
+Cached:           776052 kB
+SwapTotal:         32768 kB
+SwapFree:           4096 kB
+Mapped:            62624 kB
+Shmem:              4020 kB)meminfo";
+
+    TemporaryFile tf;
+    ASSERT_TRUE(tf.fd != -1);
+    ASSERT_TRUE(::android::base::WriteStringToFd(meminfo, tf.fd));
+
+    std::vector<std::string> tags = {
+            SysMemInfo::kMemShmem,
+            SysMemInfo::kMemTotal,
+            SysMemInfo::kMemSlab,
+            SysMemInfo::kMemCached,
+    };
+    MemInfoReader reader(tags, tf.path);
+    uint64_t mem[4];
+    ASSERT_TRUE(reader.Read(mem));
+    EXPECT_EQ(mem[0], 4020);
+    EXPECT_EQ(mem[1], 3019740);
+    EXPECT_EQ(mem[2], 0);
+    EXPECT_EQ(mem[3], 776052);
+
+    // Every read starts again from the beginning of the file.
+    ASSERT_EQ(0, ftruncate(tf.fd, 0));
+    ASSERT_TRUE(::android::base::WriteStringToFile("MemTotal: 1024 kB\nCached: 12 kB\n", tf.path));
+    ASSERT_TRUE(reader.Read(mem));
+    EXPECT_EQ(mem[0], 0);
+    EXPECT_EQ(mem[1], 1024);
+    EXPECT_EQ(mem[2], 0);
+    EXPECT_EQ(mem[3], 12);
+
+    ASSERT_TRUE(::android::base::WriteStringToFile("MemTotal: bad kB\n", tf.path));
+    EXPECT_FALSE(reader.Read(mem));
+}
+
+TEST(SysMemInfo, TestMemInfoReaderNoFile) {
+    MemInfoReader reader(SysMemInfo::kDefaultSysMemInfoTags, "/does/not/exist");
+    std::vector<uint64_t> mem(SysMemInfo::kDefaultSysMemInfoTags.size());
+    EXPECT_FALSE(reader.Read(mem.data()));
+}
+
 TEST(SysMemInfo, TestEmptyFile) {
     TemporaryFile tf;
     std::string empty_string = "";
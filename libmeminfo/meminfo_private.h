@@ -23,6 +23,7 @@
 #include <meminfo/pageacct.h>
 #include <meminfo/procmeminfo.h>
 #include <meminfo/sysmeminfo.h>
+#include <meminfo/workingset.h>
 
 // Macros to do per-page flag manipulation
 #define _BITS(x, offset, bits) (((x) >> (offset)) & ((1LL << (bits)) - 1))
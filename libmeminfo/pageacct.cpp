@@ -16,6 +16,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <android-base/logging.h>
@@ -74,6 +75,49 @@ bool PageAcct::InitPageAcct(bool pageidle_enable) {
     return true;
 }
 
+// 4KiB of entries per read when caching, and at most 16MiB of them in each cache.
+static constexpr size_t kCacheBlockPages = 512;
+static constexpr size_t kMaxCacheBlocks = 4096;
+
+void PageAcct::SetCacheEnabled(bool enabled) {
+    cache_enabled_ = enabled;
+    if (!enabled) {
+        flags_cache_.clear();
+        count_cache_.clear();
+    }
+}
+
+bool PageAcct::ReadEntry(int fd, EntryCache* cache, uint64_t pfn, uint64_t* value) {
+    if (!cache_enabled_) {
+        return pread64(fd, value, sizeof(uint64_t), pfn * sizeof(uint64_t)) == sizeof(uint64_t);
+    }
+
+    uint64_t block = pfn / kCacheBlockPages;
+    auto it = cache->find(block);
+    if (it == cache->end()) {
+        if (cache->size() >= kMaxCacheBlocks) {
+            cache->clear();
+        }
+        std::vector<uint64_t> entries(kCacheBlockPages);
+        // The last block may be cut short by the end of physical memory.
+        ssize_t bytes = pread64(fd, entries.data(), entries.size() * sizeof(uint64_t),
+                                block * kCacheBlockPages * sizeof(uint64_t));
+        if (bytes < 0) {
+            return false;
+        }
+        entries.resize(bytes / sizeof(uint64_t));
+        it = cache->emplace(block, std::move(entries)).first;
+    }
+
+    size_t index = pfn % kCacheBlockPages;
+    if (index >= it->second.size()) {
+        errno = EINVAL;
+        return false;
+    }
+    *value = it->second[index];
+    return true;
+}
+
 bool PageAcct::PageFlags(uint64_t pfn, uint64_t* flags) {
     if (!flags) return false;
 
@@ -81,8 +125,7 @@ bool PageAcct::PageFlags(uint64_t pfn, uint64_t* flags) {
         if (!InitPageAcct()) return false;
     }
 
-    if (pread64(kpageflags_fd_, flags, sizeof(uint64_t), pfn * sizeof(uint64_t)) !=
-        sizeof(uint64_t)) {
+    if (!ReadEntry(kpageflags_fd_, &flags_cache_, pfn, flags)) {
         PLOG(ERROR) << "Failed to read page flags for page " << pfn;
         return false;
     }
@@ -96,8 +139,7 @@ bool PageAcct::PageMapCount(uint64_t pfn, uint64_t* mapcount) {
         if (!InitPageAcct()) return false;
     }
 
-    if (pread64(kpagecount_fd_, mapcount, sizeof(uint64_t), pfn * sizeof(uint64_t)) !=
-        sizeof(uint64_t)) {
+    if (!ReadEntry(kpagecount_fd_, &count_cache_, pfn, mapcount)) {
         PLOG(ERROR) << "Failed to read map count for page " << pfn;
         return false;
     }
@@ -140,6 +182,74 @@ int PageAcct::GetPageIdle(uint64_t pfn) const {
     return !!(idle_bits & (1ULL << (pfn % 64)));
 }
 
+// Words of the idle bitmap closer than this are read or written together.
+static constexpr size_t kIdleBitmapRunGap = 8;
+static constexpr size_t kMaxIdleBitmapRun = 512;
+
+template <typename F>
+bool PageAcct::ForEachIdleBitmapRun(const std::vector<uint64_t>& pfns, F&& f) {
+    if (pageidle_fd_ < 0) {
+        if (!InitPageAcct(true)) return false;
+    }
+
+    size_t i = 0;
+    while (i < pfns.size()) {
+        uint64_t first_word = pfns[i] / 64;
+        uint64_t last_word = first_word;
+        size_t end = i + 1;
+        while (end < pfns.size()) {
+            uint64_t word = pfns[end] / 64;
+            if (word - last_word > kIdleBitmapRunGap || word - first_word >= kMaxIdleBitmapRun) {
+                break;
+            }
+            last_word = word;
+            end++;
+        }
+        if (!f(first_word, last_word - first_word + 1, i, end)) {
+            return false;
+        }
+        i = end;
+    }
+    return true;
+}
+
+bool PageAcct::PagesIdle(const std::vector<uint64_t>& pfns, std::vector<bool>* idle) {
+    idle->assign(pfns.size(), false);
+    uint64_t words[kMaxIdleBitmapRun];
+    return ForEachIdleBitmapRun(pfns, [&](uint64_t first_word, size_t num_words, size_t begin,
+                                          size_t end) {
+        size_t bytes = num_words * sizeof(uint64_t);
+        if (pread64(pageidle_fd_, words, bytes, first_word * sizeof(uint64_t)) !=
+            static_cast<ssize_t>(bytes)) {
+            PLOG(ERROR) << "Failed to read page idle bitmap for page " << pfns[begin];
+            return false;
+        }
+        for (size_t i = begin; i < end; i++) {
+            (*idle)[i] = !!(words[pfns[i] / 64 - first_word] & (1ULL << (pfns[i] % 64)));
+        }
+        return true;
+    });
+}
+
+bool PageAcct::MarkPagesIdle(const std::vector<uint64_t>& pfns) {
+    uint64_t words[kMaxIdleBitmapRun];
+    return ForEachIdleBitmapRun(pfns, [&](uint64_t first_word, size_t num_words, size_t begin,
+                                          size_t end) {
+        // Clear bits leave the state of their pages alone.
+        memset(words, 0, num_words * sizeof(uint64_t));
+        for (size_t i = begin; i < end; i++) {
+            words[pfns[i] / 64 - first_word] |= 1ULL << (pfns[i] % 64);
+        }
+        size_t bytes = num_words * sizeof(uint64_t);
+        if (pwrite64(pageidle_fd_, words, bytes, first_word * sizeof(uint64_t)) !=
+            static_cast<ssize_t>(bytes)) {
+            PLOG(ERROR) << "Failed to write page idle bitmap for page " << pfns[begin];
+            return false;
+        }
+        return true;
+    });
+}
+
 // Public methods
 bool page_present(uint64_t pagemap_val) {
     return PAGE_PRESENT(pagemap_val);
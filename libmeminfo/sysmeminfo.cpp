@@ -177,6 +177,68 @@ bool SysMemInfo::ReadMemInfo(const std::vector<std::string>& tags, const std::st
 }
 #endif
 
+// Parses the decimal number at *p, leaving *p after it.
+static bool ParseDecimal(const char** p, uint64_t* val) {
+    const char* s = *p;
+    if (*s < '0' || *s > '9') return false;
+    uint64_t v = 0;
+    for (; *s >= '0' && *s <= '9'; s++) {
+        v = v * 10 + (*s - '0');
+    }
+    *val = v;
+    *p = s;
+    return true;
+}
+
+MemInfoReader::MemInfoReader(const std::vector<std::string>& tags, const std::string& path)
+    : tags_(tags), path_(path), fd_(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC))) {
+    if (fd_ < 0) {
+        PLOG(ERROR) << "Failed to open file :" << path;
+    }
+}
+
+bool MemInfoReader::Read(uint64_t* out) {
+    if (fd_ < 0) {
+        return false;
+    }
+
+    // procfs regenerates the file for every read from offset 0.
+    ssize_t len = TEMP_FAILURE_RETRY(pread(fd_, buffer_, sizeof(buffer_) - 1, 0));
+    if (len < 0) {
+        PLOG(ERROR) << "Failed to read file :" << path_;
+        return false;
+    }
+    buffer_[len] = '\0';
+
+    std::fill(out, out + tags_.size(), 0);
+    const char* p = buffer_;
+    size_t found = 0;
+    uint32_t lineno = 0;
+    while (*p && found < tags_.size()) {
+        for (size_t i = 0; i < tags_.size(); i++) {
+            const std::string& tag = tags_[i];
+            if (strncmp(p, tag.c_str(), tag.size()) == 0) {
+                p += tag.size();
+                while (*p == ' ') p++;
+                if (!ParseDecimal(&p, &out[i])) {
+                    LOG(ERROR) << "Failed to parse line:" << lineno + 1 << " in file: " << path_;
+                    return false;
+                }
+                found++;
+                break;
+            }
+        }
+
+        while (*p && *p != '\n') {
+            p++;
+        }
+        if (*p) p++;
+        lineno++;
+    }
+
+    return true;
+}
+
 uint64_t SysMemInfo::mem_zram_kb(const std::string& zram_dev) {
     uint64_t mem_zram_total = 0;
     if (!zram_dev.empty()) {
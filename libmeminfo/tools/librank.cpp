@@ -35,6 +35,7 @@
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 
+#include <meminfo/pageacct.h>
 #include <meminfo/procmeminfo.h>
 
 using ::android::meminfo::MemUsage;
@@ -301,6 +302,9 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    // Pages shared between processes only need their flags and map count read once.
+    ::android::meminfo::PageAcct::Instance().SetCacheEnabled(true);
+
     if (!read_all_pids(scan_libs_per_process)) {
         error(EXIT_FAILURE, 0, "Failed to read all pids from the system");
     }
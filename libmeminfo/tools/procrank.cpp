@@ -23,6 +23,7 @@
 #include <inttypes.h>
 #include <linux/kernel-page-flags.h>
 #include <linux/oom.h>
+#include <meminfo/pageacct.h>
 #include <meminfo/procmeminfo.h>
 #include <meminfo/sysmeminfo.h>
 #include <stdio.h>
@@ -485,6 +486,9 @@ int main(int argc, char* argv[]) {
         return true;
     };
 
+    // Pages shared between processes only need their flags and map count read once.
+    ::android::meminfo::PageAcct::Instance().SetCacheEnabled(true);
+
     // Get a list of all pids currently running in the system in 1st pass through all processes.
     // Mark each swap offset used by the process as we find them for calculating proportional
     // swap usage later.
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <procinfo/process_map.h>
+
+#include "meminfo_private.h"
+
+namespace android {
+namespace meminfo {
+
+WorkingSetTracker::WorkingSetTracker(pid_t pid, size_t num_ages)
+    : pid_(pid), num_ages_(std::max<size_t>(1, std::min<size_t>(num_ages, kNotResident))) {
+    std::string pagemap_file = ::android::base::StringPrintf("/proc/%d/pagemap", pid_);
+    pagemap_fd_.reset(TEMP_FAILURE_RETRY(open(pagemap_file.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (pagemap_fd_ < 0) {
+        PLOG(ERROR) << "Failed to open " << pagemap_file;
+    }
+}
+
+bool WorkingSetTracker::ReadVmas(std::vector<VmaWorkingSet>* vmas) {
+    std::string maps_file = ::android::base::StringPrintf("/proc/%d/maps", pid_);
+    auto old_vma = vmas_.begin();
+    if (!::android::procinfo::ReadMapFile(
+                maps_file, [&](uint64_t start, uint64_t end, uint16_t flags, uint64_t pgoff, ino_t,
+                               const char* name) {
+                    vmas->emplace_back();
+                    VmaWorkingSet& ws = vmas->back();
+                    ws.vma = Vma(start, end, pgoff, flags, name);
+                    ws.bytes_by_age.resize(num_ages_);
+
+                    // Both lists are sorted, keep the page ages of mappings that are still there.
+                    while (old_vma != vmas_.end() && old_vma->vma.start < start) old_vma++;
+                    if (old_vma != vmas_.end() && old_vma->vma.start == start &&
+                        old_vma->vma.end == end && old_vma->vma.name == ws.vma.name) {
+                        ws.page_ages = std::move(old_vma->page_ages);
+                    } else {
+                        ws.page_ages.assign((end - start) / getpagesize(), kNotResident);
+                    }
+                })) {
+        LOG(ERROR) << "Failed to parse " << maps_file;
+        return false;
+    }
+    return true;
+}
+
+bool WorkingSetTracker::Sample() {
+    if (pagemap_fd_ < 0) {
+        return false;
+    }
+
+    // ReadVmas moves the page ages out of vmas_, so any failure from here on starts the
+    // history over.
+    std::vector<VmaWorkingSet> vmas;
+    if (!ReadVmas(&vmas)) {
+        vmas_.clear();
+        return false;
+    }
+
+    // The resident pages, as (page frame, (vma, page in vma)), so that they can be looked up in
+    // the idle bitmap in page frame order.
+    std::vector<std::pair<uint64_t, std::pair<uint32_t, uint32_t>>> pages;
+    uint64_t pagesz = getpagesize();
+    std::vector<uint64_t> pagemap;
+    for (size_t v = 0; v < vmas.size(); v++) {
+        VmaWorkingSet& ws = vmas[v];
+        size_t num_pages = ws.page_ages.size();
+        static constexpr size_t kMaxPages = 2048;
+        for (size_t first = 0; first < num_pages; first += kMaxPages) {
+            pagemap.resize(std::min(kMaxPages, num_pages - first));
+            size_t bytes = pagemap.size() * sizeof(uint64_t);
+            off64_t offset = (ws.vma.start / pagesz + first) * sizeof(uint64_t);
+            ssize_t bytes_read = pread64(pagemap_fd_, pagemap.data(), bytes, offset);
+            if (bytes_read == -1) {
+                PLOG(ERROR) << "Failed to read page map for pid " << pid_ << " at 0x" << std::hex
+                            << ws.vma.start + first * pagesz;
+                vmas_.clear();
+                return false;
+            }
+            // Mappings above the user address space, like [vsyscall], have no entries.
+            std::fill(pagemap.begin() + bytes_read / sizeof(uint64_t), pagemap.end(), 0);
+            for (size_t i = 0; i < pagemap.size(); i++) {
+                if (!PAGE_PRESENT(pagemap[i]) || PAGE_SWAPPED(pagemap[i])) {
+                    ws.page_ages[first + i] = kNotResident;
+                    continue;
+                }
+                pages.emplace_back(PAGE_PFN(pagemap[i]), std::make_pair(v, first + i));
+            }
+        }
+    }
+    std::sort(pages.begin(), pages.end());
+
+    std::vector<uint64_t> pfns;
+    pfns.reserve(pages.size());
+    for (auto& page : pages) {
+        pfns.push_back(page.first);
+    }
+
+    PageAcct& pinfo = PageAcct::Instance();
+    std::vector<bool> idle;
+    if (!pinfo.PagesIdle(pfns, &idle)) {
+        vmas_.clear();
+        return false;
+    }
+
+    for (size_t i = 0; i < pages.size(); i++) {
+        VmaWorkingSet& ws = vmas[pages[i].second.first];
+        uint8_t& age = ws.page_ages[pages[i].second.second];
+        if (age == kNotResident || !idle[i]) {
+            age = 0;
+        } else if (age + 1u < num_ages_) {
+            age++;
+        }
+    }
+
+    if (!pinfo.MarkPagesIdle(pfns)) {
+        vmas_.clear();
+        return false;
+    }
+
+    for (auto& ws : vmas) {
+        for (uint8_t age : ws.page_ages) {
+            if (age != kNotResident) {
+                ws.bytes_by_age[age] += pagesz;
+            }
+        }
+    }
+
+    vmas_ = std::move(vmas);
+    return true;
+}
+
+uint64_t WorkingSetTracker::WorkingSetBytes(size_t samples) const {
+    uint64_t bytes = 0;
+    for (auto& ws : vmas_) {
+        for (size_t age = 0; age < samples && age < ws.bytes_by_age.size(); age++) {
+            bytes += ws.bytes_by_age[age];
+        }
+    }
+    return bytes;
+}
+
+}  // namespace meminfo
+}  // namespace android
@@ -63,13 +63,23 @@ static constexpr unsigned int kNumBuckets =
     const_log2(kMaxBucketAllocationSize) - const_log2(kMinBucketAllocationSize) + 1;
 static constexpr unsigned int kUsablePagesPerChunk = kUsableChunkSize / kPageSize;
 
+// Arena heaps carve allocations up to kMaxBucketAllocationSize out of
+// kChunkSize blocks.  The first kArenaAlignment bytes of each block link it to
+// the previous one, which also keeps arena allocations from ever being chunk
+// aligned like the ones from MapAlloc.
+static constexpr unsigned int kNumArenas = 8;
+static constexpr size_t kArenaAlignment = 16;
+// Threads are spread across the arenas by their stack address, walker thread
+// stacks are 64KiB.
+static constexpr size_t kArenaStackStride = 64 * 1024;
+
 std::atomic<int> heap_count;
 
 class Chunk;
 
 class HeapImpl {
  public:
-  HeapImpl();
+  explicit HeapImpl(bool arena);
   ~HeapImpl();
   void* operator new(std::size_t count) noexcept;
   void operator delete(void* ptr);
@@ -100,6 +110,20 @@ class HeapImpl {
   };
   MapAllocation* map_allocation_list_;
   std::mutex m_;
+
+  struct ArenaBlock {
+    ArenaBlock* next;
+  };
+  struct Arena {
+    std::mutex m;
+    uintptr_t next;
+    uintptr_t end;
+    ArenaBlock* blocks;
+  };
+  void* ArenaAlloc(size_t size);
+
+  const bool arena_;
+  Arena arenas_[kNumArenas];
 };
 
 // Integer log 2, rounds down
@@ -250,6 +274,8 @@ void* Chunk::Alloc() {
   unsigned int i = first_free_bitmap_;
   while (free_bitmap_[i] == 0) i++;
   assert(i < arraysize(free_bitmap_));
+  // Every word before i is full, don't scan them again on the next Alloc.
+  first_free_bitmap_ = i;
   unsigned int bit = __builtin_ffs(free_bitmap_[i]) - 1;
   assert(free_bitmap_[i] & (1U << bit));
   free_bitmap_[i] &= ~(1U << bit);
@@ -304,6 +330,7 @@ void Chunk::Purge() {
 
 // Override new operator on HeapImpl to use mmap to allocate a page
 void* HeapImpl::operator new(std::size_t count __attribute__((unused))) noexcept {
+  static_assert(sizeof(HeapImpl) <= kPageSize, "HeapImpl must fit in page");
   assert(count == sizeof(HeapImpl));
   void* mem = MapAligned(kPageSize, kPageSize);
   if (!mem) {
@@ -318,9 +345,19 @@ void HeapImpl::operator delete(void* ptr) {
   munmap(ptr, kPageSize);
 }
 
-HeapImpl::HeapImpl() : free_chunks_(), full_chunks_(), map_allocation_list_(NULL) {}
+HeapImpl::HeapImpl(bool arena)
+    : free_chunks_(), full_chunks_(), map_allocation_list_(NULL), arena_(arena), arenas_() {}
 
 bool HeapImpl::Empty() {
+  // Arena allocations are never freed individually, an arena heap is only
+  // empty if nothing was ever allocated from its arenas.
+  for (unsigned int i = 0; i < kNumArenas; i++) {
+    std::lock_guard<std::mutex> lk(arenas_[i].m);
+    if (arenas_[i].blocks != nullptr) {
+      return false;
+    }
+  }
+
   for (unsigned int i = 0; i < kNumBuckets; i++) {
     for (LinkedList<Chunk*>* it = free_chunks_[i].next(); it->data() != NULL; it = it->next()) {
       if (!it->data()->Empty()) {
@@ -350,13 +387,66 @@ HeapImpl::~HeapImpl() {
       delete chunk;
     }
   }
+  for (unsigned int i = 0; i < kNumArenas; i++) {
+    while (arenas_[i].blocks != nullptr) {
+      ArenaBlock* block = arenas_[i].blocks;
+      arenas_[i].blocks = block->next;
+      munmap(block, kChunkSize);
+    }
+  }
 }
 
 void* HeapImpl::Alloc(size_t size) {
+  if (arena_ && size <= kMaxBucketAllocationSize) {
+    return ArenaAlloc(size);
+  }
   std::lock_guard<std::mutex> lk(m_);
   return AllocLocked(size);
 }
 
+void* HeapImpl::ArenaAlloc(size_t size) {
+  size = (size + kArenaAlignment - 1) & ~(kArenaAlignment - 1);
+  if (size == 0) {
+    size = kArenaAlignment;
+  }
+
+  // Start from the arena picked by the caller's stack, but take any idle one
+  // rather than wait for it.  The walker threads are started with clone, so
+  // thread locals can't be used to find a per-thread arena.
+  unsigned int home =
+      (reinterpret_cast<uintptr_t>(__builtin_frame_address(0)) / kArenaStackStride) % kNumArenas;
+  Arena* arena = nullptr;
+  for (unsigned int i = 0; i < kNumArenas; i++) {
+    Arena* candidate = &arenas_[(home + i) % kNumArenas];
+    if (candidate->m.try_lock()) {
+      arena = candidate;
+      break;
+    }
+  }
+  if (arena == nullptr) {
+    arena = &arenas_[home];
+    arena->m.lock();
+  }
+  std::lock_guard<std::mutex> lk(arena->m, std::adopt_lock);
+
+  if (arena->end - arena->next < size) {
+    // The rest of the current block is abandoned until the heap is destroyed.
+    void* mem = MapAligned(kChunkSize, kChunkSize);
+    if (!mem) {
+      abort();  // throw std::bad_alloc;
+    }
+    ArenaBlock* block = reinterpret_cast<ArenaBlock*>(mem);
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->next = reinterpret_cast<uintptr_t>(mem) + kArenaAlignment;
+    arena->end = reinterpret_cast<uintptr_t>(mem) + kChunkSize;
+  }
+
+  void* ptr = reinterpret_cast<void*>(arena->next);
+  arena->next += size;
+  return ptr;
+}
+
 void* HeapImpl::AllocLocked(size_t size) {
   if (size > kMaxBucketAllocationSize) {
     return MapAlloc(size);
@@ -370,6 +460,10 @@ void* HeapImpl::AllocLocked(size_t size) {
 }
 
 void HeapImpl::Free(void* ptr) {
+  if (arena_ && Chunk::is_chunk(ptr)) {
+    // Released with the rest of the arena when the heap is destroyed.
+    return;
+  }
   std::lock_guard<std::mutex> lk(m_);
   FreeLocked(ptr);
 }
@@ -434,12 +528,12 @@ void HeapImpl::MoveToList(Chunk* chunk, LinkedList<Chunk*>* head) {
   node->insert(chunk->node_);
 }
 
-Heap::Heap() {
+Heap::Heap(Mode mode) {
   // HeapImpl overloads the operator new in order to mmap itself instead of
   // allocating with new.
   // Can't use a shared_ptr to store the result because shared_ptr needs to
   // allocate, and Allocator<T> is still being constructed.
-  impl_ = new HeapImpl();
+  impl_ = new HeapImpl(mode == kArena);
   owns_impl_ = true;
 }
 
@@ -41,7 +41,16 @@ class Allocator;
 // implementation out of the header file
 class Heap {
  public:
-  Heap();
+  enum Mode {
+    kGeneral,
+    // Allocations of up to 64KiB are bump allocated from per-thread arenas and
+    // never reused, deallocating them is a no-op.  The arenas are unmapped
+    // all at once when the Heap is destroyed.  Meant for heaps that live for
+    // a single leak scan.
+    kArena,
+  };
+
+  explicit Heap(Mode mode = kGeneral);
   ~Heap();
 
   // Copy constructor that does not take ownership of impl_
@@ -16,16 +16,21 @@
 
 #include <errno.h>
 #include <inttypes.h>
+#include <sched.h>
 #include <sys/mman.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <map>
+#include <mutex>
 #include <utility>
 
 #include "Allocator.h"
 #include "HeapWalker.h"
 #include "LeakFolding.h"
 #include "ScopedSignalHandler.h"
+#include "Stack.h"
 #include "log.h"
 
 namespace android {
@@ -44,6 +49,7 @@ bool HeapWalker::Allocation(uintptr_t begin, uintptr_t end) {
   }
   auto inserted = allocations_.insert(std::pair<Range, AllocationInfo>(range, AllocationInfo{}));
   if (inserted.second) {
+    index_valid_ = false;
     valid_allocations_range_.begin = std::min(valid_allocations_range_.begin, begin);
     valid_allocations_range_.end = std::max(valid_allocations_range_.end, end);
     allocation_bytes_ += range.size();
@@ -66,38 +72,211 @@ static uintptr_t ReadWordAtAddressUnsafe(uintptr_t word_ptr)
   return *reinterpret_cast<uintptr_t*>(word_ptr);
 }
 
-bool HeapWalker::WordContainsAllocationPtr(uintptr_t word_ptr, Range* range, AllocationInfo** info) {
-  walking_ptr_ = word_ptr;
+bool HeapWalker::WordContainsAllocationPtr(uintptr_t word_ptr, Range* range, AllocationInfo** info,
+                                           WalkState* state) {
+  state->walking_ptr = word_ptr;
   // This access may segfault if the process under test has done something strange,
   // for example mprotect(PROT_NONE) on a native heap page.  If so, it will be
   // caught and handled by mmaping a zero page over the faulting page.
   uintptr_t value = ReadWordAtAddressUnsafe(word_ptr);
-  walking_ptr_ = 0;
-  if (value >= valid_allocations_range_.begin && value < valid_allocations_range_.end) {
+  state->walking_ptr = 0;
+  if (value < valid_allocations_range_.begin || value >= valid_allocations_range_.end) {
+    return false;
+  }
+
+  if (!index_valid_) {
     AllocationMap::iterator it = allocations_.find(Range{value, value + 1});
     if (it != allocations_.end()) {
       *range = it->first;
       *info = &it->second;
       return true;
     }
+    return false;
+  }
+
+  size_t granule = (value - valid_allocations_range_.begin) >> index_granule_shift_;
+  if ((index_granules_[granule / 64] & (1ULL << (granule % 64))) == 0) {
+    return false;
+  }
+  // The last allocation that starts at or before value is the only one that
+  // can contain it.
+  auto it = std::upper_bound(index_begins_.begin(), index_begins_.end(), value);
+  if (it == index_begins_.begin()) {
+    return false;
+  }
+  size_t n = it - index_begins_.begin() - 1;
+  const IndexEntry& entry = index_entries_[n];
+  if (value >= entry.end) {
+    return false;
+  }
+  *range = Range{index_begins_[n], entry.end};
+  *info = entry.info;
+  return true;
+}
+
+// Granules are at least a page, and grow for sparse heaps so that the bitmap
+// stays under 16MiB.
+static constexpr size_t kMinIndexGranuleShift = 12;
+static constexpr size_t kMaxIndexGranules = 128 * 1024 * 1024;
+
+void HeapWalker::BuildIndex() {
+  index_begins_.clear();
+  index_entries_.clear();
+  index_granules_.clear();
+  index_valid_ = false;
+  if (allocations_.empty()) {
+    return;
+  }
+
+  index_begins_.reserve(allocations_.size());
+  index_entries_.reserve(allocations_.size());
+  for (auto& it : allocations_) {
+    index_begins_.push_back(it.first.begin);
+    index_entries_.push_back(IndexEntry{it.first.end, &it.second});
+  }
+
+  size_t span = valid_allocations_range_.end - valid_allocations_range_.begin;
+  index_granule_shift_ = kMinIndexGranuleShift;
+  while (((span - 1) >> index_granule_shift_) >= kMaxIndexGranules) {
+    index_granule_shift_++;
+  }
+  size_t granules = ((span - 1) >> index_granule_shift_) + 1;
+  index_granules_.resize((granules + 63) / 64, 0);
+  for (size_t i = 0; i < index_begins_.size(); i++) {
+    size_t first = (index_begins_[i] - valid_allocations_range_.begin) >> index_granule_shift_;
+    size_t last = (index_entries_[i].end - 1 - valid_allocations_range_.begin) >> index_granule_shift_;
+    for (size_t granule = first; granule <= last; granule++) {
+      index_granules_[granule / 64] |= 1ULL << (granule % 64);
+    }
   }
-  return false;
+  index_valid_ = true;
 }
 
 void HeapWalker::RecurseRoot(const Range& root) {
+  WalkState* state = &walk_states_[0];
   allocator::vector<Range> to_do(1, root, allocator_);
   while (!to_do.empty()) {
     Range range = to_do.back();
     to_do.pop_back();
 
-    walking_range_ = range;
+    state->walking_range = range;
     ForEachPtrInRange(range, [&](Range& ref_range, AllocationInfo* ref_info) {
       if (!ref_info->referenced_from_root) {
         ref_info->referenced_from_root = true;
         to_do.push_back(ref_range);
       }
     });
-    walking_range_ = Range{0, 0};
+    state->walking_range = Range{0, 0};
+  }
+}
+
+// Ranges larger than this are split so that other walker threads can help
+// with them.
+static constexpr size_t kMarkChunkSize = 64 * 1024;
+
+static constexpr size_t kWalkerStackSize = 64 * 1024;
+
+// The ranges that are waiting to be walked by any walker thread. Each
+// thread walks the ranges it finds itself, and only gives some of them
+// back here when another thread has run out.
+//
+// The walkers are not threads as far as libc knows, and libc may skip the
+// atomic operations in its mutexes in a process it thinks has a single
+// thread, so the queue is guarded by its own spin lock.  Nothing else the
+// walkers share is written outside of it.
+class HeapWalker::MarkQueue {
+ public:
+  MarkQueue(Allocator<Range> allocator, size_t threads)
+      : ranges_(allocator), threads_(threads), idle_(0), done_(false) {}
+
+  void Add(const Range& range) {
+    std::lock_guard<MarkQueue> lk(*this);
+    ranges_.push_back(range);
+  }
+
+  // Called when a thread could not be started.
+  void RemoveThread() {
+    std::lock_guard<MarkQueue> lk(*this);
+    threads_--;
+  }
+
+  // Moves some of the waiting ranges to to_do. Returns false once every
+  // thread has run out of ranges.
+  bool Take(allocator::vector<Range>* to_do) {
+    std::unique_lock<MarkQueue> lk(*this);
+    idle_++;
+    while (ranges_.empty()) {
+      if (done_ || idle_ == threads_) {
+        done_ = true;
+        return false;
+      }
+      lk.unlock();
+      sched_yield();
+      lk.lock();
+    }
+    idle_--;
+
+    size_t count = std::max<size_t>(1, ranges_.size() / threads_);
+    to_do->insert(to_do->end(), ranges_.end() - count, ranges_.end());
+    ranges_.resize(ranges_.size() - count);
+    return true;
+  }
+
+  // Gives half of to_do to the waiting ranges if another thread is idle.
+  void Share(allocator::vector<Range>* to_do) {
+    if (idle_ == 0 || to_do->size() < 2) {
+      return;
+    }
+    std::lock_guard<MarkQueue> lk(*this);
+    if (!ranges_.empty()) {
+      return;
+    }
+    // The oldest ranges are the most likely to lead to more work.
+    size_t count = to_do->size() / 2;
+    ranges_.insert(ranges_.end(), to_do->begin(), to_do->begin() + count);
+    to_do->erase(to_do->begin(), to_do->begin() + count);
+  }
+
+  void lock() {
+    while (locked_.test_and_set(std::memory_order_acquire)) {
+      sched_yield();
+    }
+  }
+
+  void unlock() { locked_.clear(std::memory_order_release); }
+
+ private:
+  std::atomic_flag locked_ = ATOMIC_FLAG_INIT;
+  allocator::vector<Range> ranges_;
+  size_t threads_;
+  std::atomic<size_t> idle_;
+  bool done_;
+};
+
+void HeapWalker::MarkWorker(MarkQueue* queue, WalkState* state) {
+  // A heap of its own, for the same reason as the queue's lock.
+  Heap heap;
+  allocator::vector<Range> to_do(heap);
+  while (!to_do.empty() || queue->Take(&to_do)) {
+    Range range = to_do.back();
+    to_do.pop_back();
+    if (range.size() > kMarkChunkSize) {
+      to_do.push_back(Range{range.begin + kMarkChunkSize, range.end});
+      range.end = range.begin + kMarkChunkSize;
+    }
+
+    state->walking_range = range;
+    ForEachPtrInRange(
+        range,
+        [&](Range& ref_range, AllocationInfo* ref_info) {
+          if (!__atomic_exchange_n(&ref_info->referenced_from_root, true, __ATOMIC_RELAXED)) {
+            to_do.push_back(ref_range);
+          }
+        },
+        state);
+    state->walking_range = Range{0, 0};
+
+    queue->Share(&to_do);
   }
 }
 
@@ -122,23 +301,80 @@ size_t HeapWalker::AllocationBytes() {
   return allocation_bytes_;
 }
 
-bool HeapWalker::DetectLeaks() {
-  // Recursively walk pointers from roots to mark referenced allocations
-  for (auto it = roots_.begin(); it != roots_.end(); it++) {
-    RecurseRoot(*it);
-  }
-
+bool HeapWalker::DetectLeaks(size_t num_threads) {
   Range vals;
   vals.begin = reinterpret_cast<uintptr_t>(root_vals_.data());
   vals.end = vals.begin + root_vals_.size() * sizeof(uintptr_t);
 
-  RecurseRoot(vals);
+  BuildIndex();
+
+  num_threads = std::min(num_threads, kMaxWalkerThreads);
+  bool ok = true;
+  if (num_threads <= 1) {
+    // Recursively walk pointers from roots to mark referenced allocations
+    for (auto it = roots_.begin(); it != roots_.end(); it++) {
+      RecurseRoot(*it);
+    }
+
+    RecurseRoot(vals);
+  } else {
+    MarkQueue queue(allocator_, num_threads);
+    for (auto it = roots_.begin(); it != roots_.end(); it++) {
+      queue.Add(*it);
+    }
+    queue.Add(vals);
+
+    // The heap walker runs in a process forked from a thread that was itself
+    // started with clone, where pthread_create can't be trusted. Start the
+    // other walkers the same way as PtracerThread, as processes that share
+    // the address space.
+    struct Walker {
+      HeapWalker* heap_walker;
+      MarkQueue* queue;
+      WalkState* state;
+      Allocator<Stack>::unique_ptr stack;
+      pid_t pid = -1;
+    };
+    Walker walkers[kMaxWalkerThreads];
+    auto walk = [](void* arg) -> int {
+      Walker* walker = reinterpret_cast<Walker*>(arg);
+      walker->heap_walker->MarkWorker(walker->queue, walker->state);
+      return 0;
+    };
+    for (size_t i = 1; i < num_threads; i++) {
+      Walker& walker = walkers[i];
+      walker.heap_walker = this;
+      walker.queue = &queue;
+      walker.state = &walk_states_[i];
+      walker.stack = Allocator<Stack>(allocator_).make_unique(kWalkerStackSize);
+      walker.pid = clone(walk, walker.stack->top(), CLONE_VM | CLONE_FS | CLONE_FILES, &walker);
+      if (walker.pid < 0) {
+        MEM_ALOGE("failed to clone heap walker: %s", strerror(errno));
+        queue.RemoveThread();
+      }
+    }
+
+    MarkWorker(&queue, &walk_states_[0]);
+
+    for (size_t i = 1; i < num_threads; i++) {
+      pid_t pid = walkers[i].pid;
+      if (pid < 0) {
+        continue;
+      }
+      int status;
+      if (TEMP_FAILURE_RETRY(waitpid(pid, &status, __WALL)) != pid || !WIFEXITED(status) ||
+          WEXITSTATUS(status) != 0) {
+        MEM_ALOGE("heap walker %d failed", pid);
+        ok = false;
+      }
+    }
+  }
 
   if (segv_page_count_ > 0) {
-    MEM_ALOGE("%zu pages skipped due to segfaults", segv_page_count_);
+    MEM_ALOGE("%zu pages skipped due to segfaults", segv_page_count_.load());
   }
 
-  return true;
+  return ok;
 }
 
 bool HeapWalker::Leaked(allocator::vector<Range>& leaked, size_t limit, size_t* num_leaks_out,
@@ -189,17 +425,23 @@ static bool MapOverPage(void* addr) {
 void HeapWalker::HandleSegFault(ScopedSignalHandler& handler, int signal, siginfo_t* si,
                                 void* /*uctx*/) {
   uintptr_t addr = reinterpret_cast<uintptr_t>(si->si_addr);
-  if (addr != walking_ptr_) {
+  WalkState* state = nullptr;
+  for (auto& walk_state : walk_states_) {
+    if (addr == walk_state.walking_ptr) {
+      state = &walk_state;
+      break;
+    }
+  }
+  if (state == nullptr) {
     handler.reset();
     return;
   }
-  if (!segv_logged_) {
+  if (!segv_logged_.exchange(true)) {
     MEM_ALOGW("failed to read page at %p, signal %d", si->si_addr, signal);
-    if (walking_range_.begin != 0U) {
-      MEM_ALOGW("while walking range %p-%p", reinterpret_cast<void*>(walking_range_.begin),
-                reinterpret_cast<void*>(walking_range_.end));
+    if (state->walking_range.begin != 0U) {
+      MEM_ALOGW("while walking range %p-%p", reinterpret_cast<void*>(state->walking_range.begin),
+                reinterpret_cast<void*>(state->walking_range.end));
     }
-    segv_logged_ = true;
   }
   segv_page_count_++;
   if (!MapOverPage(si->si_addr)) {
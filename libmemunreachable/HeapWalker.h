@@ -19,6 +19,8 @@
 
 #include <signal.h>
 
+#include <atomic>
+
 #include "android-base/macros.h"
 
 #include "Allocator.h"
@@ -50,12 +52,15 @@ class HeapWalker {
       : allocator_(allocator),
         allocations_(allocator),
         allocation_bytes_(0),
+        index_begins_(allocator),
+        index_entries_(allocator),
+        index_granules_(allocator),
+        index_granule_shift_(0),
+        index_valid_(false),
         roots_(allocator),
         root_vals_(allocator),
         sigsegv_handler_(allocator),
         sigbus_handler_(allocator),
-        walking_ptr_(0),
-        walking_range_{0, 0},
         segv_logged_(false),
         segv_page_count_(0) {
     valid_allocations_range_.end = 0;
@@ -79,14 +84,24 @@ class HeapWalker {
   void Root(uintptr_t begin, uintptr_t end);
   void Root(const allocator::vector<uintptr_t>& vals);
 
-  bool DetectLeaks();
+  // Marks the allocations reachable from the roots, using up to
+  // kMaxWalkerThreads threads.
+  bool DetectLeaks(size_t num_threads = 1);
 
   bool Leaked(allocator::vector<Range>&, size_t limit, size_t* num_leaks, size_t* leak_bytes);
   size_t Allocations();
   size_t AllocationBytes();
 
+  static constexpr size_t kMaxWalkerThreads = 8;
+
+  // What each walker thread is reading, so a fault can be matched to it.
+  struct WalkState {
+    volatile uintptr_t walking_ptr = 0;
+    Range walking_range{0, 0};
+  };
+
   template <class F>
-  void ForEachPtrInRange(const Range& range, F&& f);
+  void ForEachPtrInRange(const Range& range, F&& f, WalkState* state = nullptr);
 
   template <class F>
   void ForEachAllocation(F&& f);
@@ -96,8 +111,13 @@ class HeapWalker {
   };
 
  private:
+  class MarkQueue;
+
+  void BuildIndex();
   void RecurseRoot(const Range& root);
-  bool WordContainsAllocationPtr(uintptr_t ptr, Range* range, AllocationInfo** info);
+  void MarkWorker(MarkQueue* queue, WalkState* state);
+  bool WordContainsAllocationPtr(uintptr_t ptr, Range* range, AllocationInfo** info,
+                                 WalkState* state);
   void HandleSegFault(ScopedSignalHandler&, int, siginfo_t*, void*);
 
   DISALLOW_COPY_AND_ASSIGN(HeapWalker);
@@ -105,6 +125,22 @@ class HeapWalker {
   using AllocationMap = allocator::map<Range, AllocationInfo, compare_range>;
   AllocationMap allocations_;
   size_t allocation_bytes_;
+
+  // A flat copy of allocations_ for the word lookups while walking, built by
+  // BuildIndex.  index_begins_ holds the sorted start addresses on their own
+  // so the binary search over them stays in as few cache lines as possible,
+  // and index_granules_ has a bit set for each granule of
+  // valid_allocations_range_ that overlaps an allocation, so most words
+  // that aren't pointers into the heap are rejected without a search.
+  struct IndexEntry {
+    uintptr_t end;
+    AllocationInfo* info;
+  };
+  allocator::vector<uintptr_t> index_begins_;
+  allocator::vector<IndexEntry> index_entries_;
+  allocator::vector<uint64_t> index_granules_;
+  size_t index_granule_shift_;
+  bool index_valid_;
   Range valid_allocations_range_;
   Range valid_mappings_range_;
 
@@ -113,14 +149,16 @@ class HeapWalker {
 
   ScopedSignalHandler sigsegv_handler_;
   ScopedSignalHandler sigbus_handler_;
-  volatile uintptr_t walking_ptr_;
-  Range walking_range_;
-  bool segv_logged_;
-  size_t segv_page_count_;
+  WalkState walk_states_[kMaxWalkerThreads];
+  std::atomic<bool> segv_logged_;
+  std::atomic<size_t> segv_page_count_;
 };
 
 template <class F>
-inline void HeapWalker::ForEachPtrInRange(const Range& range, F&& f) {
+inline void HeapWalker::ForEachPtrInRange(const Range& range, F&& f, WalkState* state) {
+  if (state == nullptr) {
+    state = &walk_states_[0];
+  }
   uintptr_t begin = (range.begin + (sizeof(uintptr_t) - 1)) & ~(sizeof(uintptr_t) - 1);
   // TODO(ccross): we might need to consider a pointer to the end of a buffer
   // to be inside the buffer, which means the common case of a pointer to the
@@ -128,7 +166,7 @@ inline void HeapWalker::ForEachPtrInRange(const Range& range, F&& f) {
   for (uintptr_t i = begin; i < range.end; i += sizeof(uintptr_t)) {
     Range ref_range;
     AllocationInfo* ref_info;
-    if (WordContainsAllocationPtr(i, &ref_range, &ref_info)) {
+    if (WordContainsAllocationPtr(i, &ref_range, &ref_info, state)) {
       f(ref_range, ref_info);
     }
   }
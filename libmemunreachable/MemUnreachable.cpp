@@ -16,7 +16,10 @@
 
 #include <inttypes.h>
 #include <string.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
 #include <functional>
 #include <iomanip>
 #include <mutex>
@@ -59,10 +62,22 @@ class MemUnreachable {
                           const allocator::vector<uintptr_t>& refs);
   bool GetUnreachableMemory(allocator::vector<Leak>& leaks, size_t limit, size_t* num_leaks,
                             size_t* leak_bytes);
+  // Like above, but only reports the leaks that are not in previous_leaks,
+  // and fills current_leaks with every unreachable allocation.  Both lists
+  // hold the bitwise complement of the start addresses in ascending order,
+  // see GetNewUnreachableMemory.
+  bool GetNewUnreachableMemory(allocator::vector<Leak>& leaks, size_t limit, size_t* num_leaks,
+                               size_t* leak_bytes, const std::vector<uintptr_t>& previous_leaks,
+                               allocator::vector<uintptr_t>& current_leaks, size_t* num_new_leaks,
+                               size_t* new_leak_bytes);
   size_t Allocations() { return heap_walker_.Allocations(); }
   size_t AllocationBytes() { return heap_walker_.AllocationBytes(); }
 
  private:
+  bool GetUnreachableMemory(allocator::vector<Leak>& leaks, size_t limit, size_t* num_leaks,
+                            size_t* leak_bytes, const std::vector<uintptr_t>* previous_leaks,
+                            allocator::vector<uintptr_t>* current_leaks, size_t* num_new_leaks,
+                            size_t* new_leak_bytes);
   bool ClassifyMappings(const allocator::vector<Mapping>& mappings,
                         allocator::vector<Mapping>& heap_mappings,
                         allocator::vector<Mapping>& anon_mappings,
@@ -136,15 +151,56 @@ bool MemUnreachable::CollectAllocations(const allocator::vector<ThreadInfo>& thr
 
 bool MemUnreachable::GetUnreachableMemory(allocator::vector<Leak>& leaks, size_t limit,
                                           size_t* num_leaks, size_t* leak_bytes) {
+  return GetUnreachableMemory(leaks, limit, num_leaks, leak_bytes, nullptr, nullptr, nullptr,
+                              nullptr);
+}
+
+static bool WasLeaked(const std::vector<uintptr_t>& previous_leaks, uintptr_t begin) {
+  return std::binary_search(previous_leaks.begin(), previous_leaks.end(), ~begin);
+}
+
+bool MemUnreachable::GetNewUnreachableMemory(allocator::vector<Leak>& leaks, size_t limit,
+                                             size_t* num_leaks, size_t* leak_bytes,
+                                             const std::vector<uintptr_t>& previous_leaks,
+                                             allocator::vector<uintptr_t>& current_leaks,
+                                             size_t* num_new_leaks, size_t* new_leak_bytes) {
+  return GetUnreachableMemory(leaks, limit, num_leaks, leak_bytes, &previous_leaks,
+                              &current_leaks, num_new_leaks, new_leak_bytes);
+}
+
+bool MemUnreachable::GetUnreachableMemory(allocator::vector<Leak>& leaks, size_t limit,
+                                          size_t* num_leaks, size_t* leak_bytes,
+                                          const std::vector<uintptr_t>* previous_leaks,
+                                          allocator::vector<uintptr_t>* current_leaks,
+                                          size_t* num_new_leaks, size_t* new_leak_bytes) {
   MEM_ALOGI("sweeping process %d for unreachable memory", pid_);
   leaks.clear();
 
-  if (!heap_walker_.DetectLeaks()) {
+  // The heap walker process has the CoW snapshot to itself, so it can use
+  // every cpu to mark it.
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t num_threads = std::min<size_t>(cpus > 0 ? cpus : 1, HeapWalker::kMaxWalkerThreads);
+  if (!heap_walker_.DetectLeaks(num_threads)) {
     return false;
   }
 
   allocator::vector<Range> leaked1{allocator_};
-  heap_walker_.Leaked(leaked1, 0, num_leaks, leak_bytes);
+  heap_walker_.Leaked(leaked1, previous_leaks ? SIZE_MAX : 0, num_leaks, leak_bytes);
+
+  if (previous_leaks != nullptr) {
+    current_leaks->clear();
+    current_leaks->reserve(leaked1.size());
+    *num_new_leaks = 0;
+    *new_leak_bytes = 0;
+    for (auto& range : leaked1) {
+      current_leaks->push_back(~range.begin);
+      if (!WasLeaked(*previous_leaks, range.begin)) {
+        (*num_new_leaks)++;
+        *new_leak_bytes += range.size();
+      }
+    }
+    std::sort(current_leaks->begin(), current_leaks->end());
+  }
 
   MEM_ALOGI("sweeping done");
 
@@ -168,6 +224,10 @@ bool MemUnreachable::GetUnreachableMemory(allocator::vector<Leak>& leaks, size_t
   leaks.reserve(leaked.size());
 
   for (auto& it : leaked) {
+    if (previous_leaks != nullptr && WasLeaked(*previous_leaks, it.range.begin)) {
+      continue;
+    }
+
     leaks.emplace_back();
     Leak* leak = &leaks.back();
 
@@ -281,7 +341,10 @@ static inline const char* plural(T val) {
   return (val == 1) ? "" : "s";
 }
 
-bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit) {
+// previous_leaks and current_leaks are only set for GetNewUnreachableMemory.
+static bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit,
+                                 const std::vector<uintptr_t>* previous_leaks,
+                                 std::vector<uintptr_t>* current_leaks) {
   if (info.version > 0) {
     MEM_ALOGE("unsupported UnreachableMemoryInfo.version %zu in GetUnreachableMemory",
               info.version);
@@ -353,7 +416,11 @@ bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit) {
         _exit(1);
       }
 
-      MemUnreachable unreachable{parent_pid, heap};
+      auto walk_start = std::chrono::steady_clock::now();
+      // Everything allocated while walking lives until the process exits,
+      // bump allocate it from arenas instead of the general heap.
+      Heap scan_heap(Heap::kArena);
+      MemUnreachable unreachable{parent_pid, scan_heap};
 
       if (!unreachable.CollectAllocations(thread_info, mappings, refs)) {
         _exit(2);
@@ -361,17 +428,36 @@ bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit) {
       size_t num_allocations = unreachable.Allocations();
       size_t allocation_bytes = unreachable.AllocationBytes();
 
-      allocator::vector<Leak> leaks{heap};
+      allocator::vector<Leak> leaks{scan_heap};
 
       size_t num_leaks = 0;
       size_t leak_bytes = 0;
-      bool ok = unreachable.GetUnreachableMemory(leaks, limit, &num_leaks, &leak_bytes);
+      allocator::vector<uintptr_t> current{scan_heap};
+      size_t num_new_leaks = 0;
+      size_t new_leak_bytes = 0;
+      bool ok;
+      if (previous_leaks != nullptr) {
+        ok = unreachable.GetNewUnreachableMemory(leaks, limit, &num_leaks, &leak_bytes,
+                                                 *previous_leaks, current, &num_new_leaks,
+                                                 &new_leak_bytes);
+      } else {
+        ok = unreachable.GetUnreachableMemory(leaks, limit, &num_leaks, &leak_bytes);
+      }
+      size_t heap_walk_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                     std::chrono::steady_clock::now() - walk_start)
+                                     .count();
 
+      ok = ok && pipe.Sender().Send(heap_walk_time_ms);
       ok = ok && pipe.Sender().Send(num_allocations);
       ok = ok && pipe.Sender().Send(allocation_bytes);
       ok = ok && pipe.Sender().Send(num_leaks);
       ok = ok && pipe.Sender().Send(leak_bytes);
       ok = ok && pipe.Sender().SendVector(leaks);
+      if (previous_leaks != nullptr) {
+        ok = ok && pipe.Sender().Send(num_new_leaks);
+        ok = ok && pipe.Sender().Send(new_leak_bytes);
+        ok = ok && pipe.Sender().SendVector(current);
+      }
 
       if (!ok) {
         _exit(3);
@@ -390,6 +476,7 @@ bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit) {
   // Original thread
   /////////////////////////////////////////////
 
+  auto freeze_start = std::chrono::steady_clock::now();
   {
     // Disable malloc to get a consistent view of memory
     ScopedDisableMalloc disable_malloc;
@@ -404,8 +491,12 @@ bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit) {
     // Re-enable malloc so the collection thread can fork.
   }
 
-  // Wait for the collection thread to exit
+  // Wait for the collection thread to exit, which releases the rest of the
+  // threads once the heap walker process has been forked.
   int ret = thread.Join();
+  info.freeze_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::steady_clock::now() - freeze_start)
+                            .count();
   if (ret != 0) {
     return false;
   }
@@ -418,22 +509,49 @@ bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit) {
   }
 
   bool ok = true;
+  ok = ok && pipe.Receiver().Receive(&info.heap_walk_time_ms);
   ok = ok && pipe.Receiver().Receive(&info.num_allocations);
   ok = ok && pipe.Receiver().Receive(&info.allocation_bytes);
   ok = ok && pipe.Receiver().Receive(&info.num_leaks);
   ok = ok && pipe.Receiver().Receive(&info.leak_bytes);
   ok = ok && pipe.Receiver().ReceiveVector(info.leaks);
+  if (previous_leaks != nullptr) {
+    ok = ok && pipe.Receiver().Receive(&info.num_new_leaks);
+    ok = ok && pipe.Receiver().Receive(&info.new_leak_bytes);
+    ok = ok && pipe.Receiver().ReceiveVector(*current_leaks);
+  }
   if (!ok) {
     return false;
   }
 
-  MEM_ALOGI("unreachable memory detection done");
+  MEM_ALOGI("unreachable memory detection done, threads frozen for %zu ms, heap walk took %zu ms",
+            info.freeze_time_ms, info.heap_walk_time_ms);
   MEM_ALOGE("%zu bytes in %zu allocation%s unreachable out of %zu bytes in %zu allocation%s",
             info.leak_bytes, info.num_leaks, plural(info.num_leaks), info.allocation_bytes,
             info.num_allocations, plural(info.num_allocations));
   return true;
 }
 
+bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit) {
+  return GetUnreachableMemory(info, limit, nullptr, nullptr);
+}
+
+// The unreachable allocations found by the last call to
+// GetNewUnreachableMemory.  The addresses are stored complemented, otherwise
+// the next pass would find them here and consider every old leak reachable.
+static std::mutex previous_leaks_mutex;
+static std::vector<uintptr_t> previous_leaks;
+
+bool GetNewUnreachableMemory(UnreachableMemoryInfo& info, size_t limit) {
+  std::lock_guard<std::mutex> lk(previous_leaks_mutex);
+  std::vector<uintptr_t> current_leaks;
+  if (!GetUnreachableMemory(info, limit, &previous_leaks, &current_leaks)) {
+    return false;
+  }
+  previous_leaks.swap(current_leaks);
+  return true;
+}
+
 std::string Leak::ToString(bool log_contents) const {
   std::ostringstream oss;
 
@@ -66,7 +66,18 @@ struct UnreachableMemoryInfo {
   size_t allocation_bytes = 0;
 
   size_t version = 0;  // Must be 0
-  size_t reserved[8] = {};
+
+  // How long the threads of the process were stopped, and how long the heap
+  // walker process took to find the unreachable allocations after that.
+  size_t freeze_time_ms = 0;
+  size_t heap_walk_time_ms = 0;
+
+  // Only set by GetNewUnreachableMemory, the part of num_leaks and
+  // leak_bytes that was not unreachable at the previous call.
+  size_t num_new_leaks = 0;
+  size_t new_leak_bytes = 0;
+
+  size_t reserved[4] = {};
 
   UnreachableMemoryInfo() {}
   ~UnreachableMemoryInfo();
@@ -76,6 +87,11 @@ struct UnreachableMemoryInfo {
 
 bool GetUnreachableMemory(UnreachableMemoryInfo& info, size_t limit = 100);
 
+// Like GetUnreachableMemory, but info.leaks only has the leaks that were not
+// already unreachable at the previous call to GetNewUnreachableMemory in this
+// process, so that periodic checks only report what has leaked since.
+bool GetNewUnreachableMemory(UnreachableMemoryInfo& info, size_t limit = 100);
+
 std::string GetUnreachableMemoryString(bool log_contents = false, size_t limit = 100);
 
 }  // namespace android
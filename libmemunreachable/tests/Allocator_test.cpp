@@ -173,4 +173,65 @@ TEST_F(AllocatorTest, unique) {
   ASSERT_NE(ptr, nullptr);
 }
 
+TEST(AllocatorArenaTest, bump) {
+  Heap heap(Heap::kArena);
+  ASSERT_TRUE(heap.empty());
+
+  Allocator<char[100]> allocator(heap);
+  void* ptr1 = allocator.allocate();
+  ASSERT_TRUE(ptr1 != NULL);
+  ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(ptr1) % 16);
+  allocator.deallocate(ptr1);
+
+  // Freed arena memory is not reused
+  void* ptr2 = allocator.allocate();
+  ASSERT_NE(ptr1, ptr2);
+  ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(ptr2) % 16);
+  allocator.deallocate(ptr2);
+
+  ASSERT_FALSE(heap.empty());
+}
+
+TEST(AllocatorArenaTest, many) {
+  Heap heap(Heap::kArena);
+  const int num = 4096;
+  const int size = 1024;
+  Allocator<char[size]> allocator(heap);
+  void* ptr[num];
+  for (int i = 0; i < num; i++) {
+    ptr[i] = allocator.allocate();
+    memset(ptr[i], i & 0xFF, size);
+  }
+
+  for (int i = 0; i < num; i++) {
+    ASSERT_EQ(*(reinterpret_cast<unsigned char*>(ptr[i]) + size - 1), i & 0xFF);
+    allocator.deallocate(ptr[i]);
+  }
+}
+
+TEST(AllocatorArenaTest, large) {
+  Heap heap(Heap::kArena);
+  const size_t size = 1024 * 1024;
+  Allocator<char[size]> allocator(heap);
+  void* ptr = allocator.allocate();
+  memset(ptr, 0xaa, size);
+  allocator.deallocate(ptr);
+  ASSERT_TRUE(heap.empty());
+}
+
+TEST(AllocatorArenaTest, stl_map) {
+  Heap heap(Heap::kArena);
+  allocator::map<int, int> m(heap);
+  for (int i = 0; i < 100000; i++) {
+    m[i] = i * 2;
+  }
+  for (int i = 0; i < 100000; i += 2) {
+    m.erase(i);
+  }
+  ASSERT_EQ(50000U, m.size());
+  for (auto& it : m) {
+    ASSERT_EQ(it.first * 2, it.second);
+  }
+}
+
 }  // namespace android
@@ -196,6 +196,43 @@ TEST_F(HeapWalkerTest, cycle) {
   ASSERT_EQ(2U, leaked.size());
 }
 
+TEST_F(HeapWalkerTest, sparse) {
+  const size_t page_size = sysconf(_SC_PAGE_SIZE);
+  const size_t pages = 16;
+  void* map = mmap(NULL, pages * page_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE,
+                   -1, 0);
+  ASSERT_NE(MAP_FAILED, map);
+  uintptr_t base = reinterpret_cast<uintptr_t>(map);
+
+  HeapWalker heap_walker(heap_);
+  heap_walker.Allocation(base, base + 16);
+  heap_walker.Allocation(base + 5 * page_size + 64, base + 5 * page_size + 96);
+  heap_walker.Allocation(base + pages * page_size - 16, base + pages * page_size);
+
+  allocator::vector<uintptr_t> vals(heap_);
+  // Inside the second allocation, just past the first one, and in a page
+  // with no allocations.
+  vals.push_back(base + 5 * page_size + 72);
+  vals.push_back(base + 16);
+  vals.push_back(base + 10 * page_size);
+  heap_walker.Root(vals);
+
+  ASSERT_EQ(true, heap_walker.DetectLeaks());
+
+  allocator::vector<Range> leaked(heap_);
+  size_t num_leaks = 0;
+  size_t leaked_bytes = 0;
+  ASSERT_EQ(true, heap_walker.Leaked(leaked, 100, &num_leaks, &leaked_bytes));
+
+  EXPECT_EQ(2U, num_leaks);
+  EXPECT_EQ(32U, leaked_bytes);
+  ASSERT_EQ(2U, leaked.size());
+  EXPECT_EQ(base, leaked[0].begin);
+  EXPECT_EQ(base + pages * page_size - 16, leaked[1].begin);
+
+  munmap(map, pages * page_size);
+}
+
 TEST_F(HeapWalkerTest, segv) {
   const size_t page_size = sysconf(_SC_PAGE_SIZE);
   void* buffer1 = mmap(NULL, page_size, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
@@ -220,4 +257,86 @@ TEST_F(HeapWalkerTest, segv) {
   ASSERT_EQ(0U, leaked.size());
 }
 
+TEST_F(HeapWalkerTest, segv_threads) {
+  const size_t page_size = sysconf(_SC_PAGE_SIZE);
+  void* buffer1 = mmap(NULL, page_size, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  ASSERT_NE(buffer1, nullptr);
+  void* buffer2;
+
+  buffer2 = &buffer1;
+
+  HeapWalker heap_walker(heap_);
+  heap_walker.Allocation(buffer_begin(buffer1), buffer_begin(buffer1) + page_size);
+  heap_walker.Root(buffer_begin(buffer2), buffer_end(buffer2));
+
+  ASSERT_EQ(true, heap_walker.DetectLeaks(4));
+
+  allocator::vector<Range> leaked(heap_);
+  size_t num_leaks = 0;
+  size_t leaked_bytes = 0;
+  ASSERT_EQ(true, heap_walker.Leaked(leaked, 100, &num_leaks, &leaked_bytes));
+
+  EXPECT_EQ(0U, num_leaks);
+  EXPECT_EQ(0U, leaked_bytes);
+  ASSERT_EQ(0U, leaked.size());
+}
+
+// Builds a binary tree of allocations, with a root range large enough to be
+// split between walker threads, and checks that every thread count marks
+// the same allocations.
+TEST_F(HeapWalkerTest, threads) {
+  const size_t num_nodes = 64 * 1024;
+  const size_t num_live_nodes = num_nodes - 100;
+  const size_t node_size = 2 * sizeof(uintptr_t);
+  const size_t roots_size = 256 * 1024;
+
+  void* nodes_map = mmap(NULL, num_nodes * node_size, PROT_READ | PROT_WRITE,
+                         MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  ASSERT_NE(MAP_FAILED, nodes_map);
+  void* roots_map = mmap(NULL, roots_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE,
+                         -1, 0);
+  ASSERT_NE(MAP_FAILED, roots_map);
+
+  uintptr_t* nodes = reinterpret_cast<uintptr_t*>(nodes_map);
+  for (size_t i = 0; i < num_live_nodes; i++) {
+    size_t left = 2 * i + 1;
+    size_t right = 2 * i + 2;
+    if (left < num_live_nodes) {
+      nodes[2 * i] = reinterpret_cast<uintptr_t>(&nodes[2 * left]);
+    }
+    if (right < num_live_nodes) {
+      nodes[2 * i + 1] = reinterpret_cast<uintptr_t>(&nodes[2 * right]);
+    }
+  }
+  // The only reference to the tree is at the end of the roots.
+  uintptr_t* roots = reinterpret_cast<uintptr_t*>(roots_map);
+  roots[roots_size / sizeof(uintptr_t) - 1] = reinterpret_cast<uintptr_t>(nodes);
+
+  for (size_t threads : {1, 2, 4, 8}) {
+    SCOPED_TRACE(threads);
+    HeapWalker heap_walker(heap_);
+    for (size_t i = 0; i < num_nodes; i++) {
+      uintptr_t node = reinterpret_cast<uintptr_t>(&nodes[2 * i]);
+      heap_walker.Allocation(node, node + node_size);
+    }
+    heap_walker.Root(reinterpret_cast<uintptr_t>(roots),
+                     reinterpret_cast<uintptr_t>(roots) + roots_size);
+
+    ASSERT_EQ(true, heap_walker.DetectLeaks(threads));
+
+    allocator::vector<Range> leaked(heap_);
+    size_t num_leaks = 0;
+    size_t leaked_bytes = 0;
+    ASSERT_EQ(true, heap_walker.Leaked(leaked, 100, &num_leaks, &leaked_bytes));
+
+    EXPECT_EQ(num_nodes - num_live_nodes, num_leaks);
+    EXPECT_EQ((num_nodes - num_live_nodes) * node_size, leaked_bytes);
+    ASSERT_EQ(100U, leaked.size());
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(&nodes[2 * num_live_nodes]), leaked[0].begin);
+  }
+
+  munmap(nodes_map, num_nodes * node_size);
+  munmap(roots_map, roots_size);
+}
+
 }  // namespace android
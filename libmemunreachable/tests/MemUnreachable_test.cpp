@@ -227,6 +227,57 @@ TEST_F(MemunreachableTest, twice) {
   }
 }
 
+TEST_F(MemunreachableTest, new_leaks) {
+  {
+    UnreachableMemoryInfo info;
+
+    ASSERT_TRUE(GetNewUnreachableMemory(info));
+    ASSERT_EQ(0U, info.leaks.size());
+  }
+
+  HiddenPointer hidden_ptr1;
+
+  {
+    UnreachableMemoryInfo info;
+
+    ASSERT_TRUE(GetNewUnreachableMemory(info));
+    ASSERT_EQ(1U, info.leaks.size());
+    ASSERT_EQ(1U, info.num_leaks);
+    ASSERT_EQ(1U, info.num_new_leaks);
+  }
+
+  {
+    UnreachableMemoryInfo info;
+
+    ASSERT_TRUE(GetNewUnreachableMemory(info));
+    ASSERT_EQ(0U, info.leaks.size());
+    ASSERT_EQ(1U, info.num_leaks);
+    ASSERT_EQ(0U, info.num_new_leaks);
+  }
+
+  HiddenPointer hidden_ptr2;
+
+  {
+    UnreachableMemoryInfo info;
+
+    ASSERT_TRUE(GetNewUnreachableMemory(info));
+    ASSERT_EQ(1U, info.leaks.size());
+    ASSERT_EQ(2U, info.num_leaks);
+    ASSERT_EQ(1U, info.num_new_leaks);
+  }
+
+  hidden_ptr1.Free();
+  hidden_ptr2.Free();
+
+  {
+    UnreachableMemoryInfo info;
+
+    ASSERT_TRUE(GetNewUnreachableMemory(info));
+    ASSERT_EQ(0U, info.leaks.size());
+    ASSERT_EQ(0U, info.num_leaks);
+  }
+}
+
 TEST_F(MemunreachableTest, log) {
   HiddenPointer hidden_ptr;
 
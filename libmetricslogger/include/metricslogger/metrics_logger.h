@@ -16,6 +16,7 @@
 
 #include <log/log_event_list.h>
 #include <stats_event_list.h>
+#include <chrono>
 #include <cstdint>
 #include <string>
 
@@ -30,6 +31,20 @@ void LogHistogram(const std::string& event, int32_t data);
 // log buffer.
 void LogCounter(const std::string& name, int32_t val);
 
+// Makes LogHistogram and LogCounter aggregate their samples in the process,
+// instead of logging each one. Every |flush_interval|, checked as samples come
+// in, each histogram bucket is logged once with its number of samples, and each
+// counter once with the sum of its values, which Tron reads the same as the
+// separate samples. Call FlushAggregatedMetrics before exiting, to log the
+// samples of the last interval.
+void EnableAggregation(std::chrono::milliseconds flush_interval);
+
+// Logs the samples aggregated so far.
+void FlushAggregatedMetrics();
+
+// Logs the samples aggregated so far, and goes back to logging each sample.
+void DisableAggregation();
+
 // Logs a Tron multi_action with category|category| containing the string
 // |value| in the field |field|.
 void LogMultiAction(int32_t category, int32_t field, const std::string& value);
@@ -16,7 +16,12 @@
 
 #include "metricslogger/metrics_logger.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <utility>
 
 #include <android-base/chrono_utils.h>
 #include <log/event_tag_map.h>
@@ -42,6 +47,133 @@ int64_t getElapsedTimeNanoSinceBoot() {
             .count();
 }
 
+void WriteHistogram(const std::string& event, int32_t bucket, int32_t count) {
+    android_log_event_list log(kSysuiMultiActionTag);
+    log << metricslogger::LOGBUILDER_CATEGORY << metricslogger::LOGBUILDER_HISTOGRAM
+        << metricslogger::LOGBUILDER_NAME << event << metricslogger::LOGBUILDER_BUCKET << bucket
+        << metricslogger::LOGBUILDER_VALUE << count << LOG_ID_EVENTS;
+
+    stats_event_list stats_log(kStatsEventTag);
+    stats_log << getElapsedTimeNanoSinceBoot() << kKeyValuePairAtomId
+              << metricslogger::LOGBUILDER_CATEGORY << metricslogger::LOGBUILDER_HISTOGRAM
+              << metricslogger::LOGBUILDER_NAME << event << metricslogger::LOGBUILDER_BUCKET
+              << bucket << metricslogger::LOGBUILDER_VALUE << count;
+    stats_log.write(LOG_ID_STATS);
+}
+
+void WriteCounter(const std::string& name, int32_t val) {
+    android_log_event_list log(kSysuiMultiActionTag);
+    log << metricslogger::LOGBUILDER_CATEGORY << metricslogger::LOGBUILDER_COUNTER
+        << metricslogger::LOGBUILDER_NAME << name << metricslogger::LOGBUILDER_VALUE << val
+        << LOG_ID_EVENTS;
+
+    stats_event_list stats_log(kStatsEventTag);
+    stats_log << getElapsedTimeNanoSinceBoot() << kKeyValuePairAtomId
+              << metricslogger::LOGBUILDER_CATEGORY << metricslogger::LOGBUILDER_COUNTER
+              << metricslogger::LOGBUILDER_NAME << name << metricslogger::LOGBUILDER_VALUE << val;
+    stats_log.write(LOG_ID_STATS);
+}
+
+// Samples held back by EnableAggregation(), logged by the next Flush().
+class Aggregator {
+  public:
+    typedef std::map<std::pair<std::string, int32_t>, int32_t> Histograms;
+    typedef std::map<std::string, int64_t> Counters;
+
+    void Enable(std::chrono::milliseconds flush_interval) {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (!enabled_) {
+            last_flush_ = android::base::boot_clock::now();
+        }
+        enabled_ = true;
+        flush_interval_ = flush_interval;
+    }
+
+    void Disable() {
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            enabled_ = false;
+        }
+        Flush();
+    }
+
+    // Returns false if samples aren't being aggregated.
+    bool AddHistogram(const std::string& event, int32_t bucket) {
+        std::unique_lock<std::mutex> lock(lock_);
+        if (!enabled_) return false;
+        auto& count = histograms_[std::make_pair(event, bucket)];
+        if (count == std::numeric_limits<int32_t>::max()) {
+            WriteHistogram(event, bucket, count);
+            count = 0;
+        }
+        ++count;
+        MaybeFlush(lock);
+        return true;
+    }
+
+    bool AddCounter(const std::string& name, int32_t val) {
+        std::unique_lock<std::mutex> lock(lock_);
+        if (!enabled_) return false;
+        counters_[name] += val;
+        MaybeFlush(lock);
+        return true;
+    }
+
+    void Flush() {
+        Histograms histograms;
+        Counters counters;
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            histograms.swap(histograms_);
+            counters.swap(counters_);
+            last_flush_ = android::base::boot_clock::now();
+        }
+        Write(histograms, counters);
+    }
+
+  private:
+    void MaybeFlush(std::unique_lock<std::mutex>& lock) {
+        auto now = android::base::boot_clock::now();
+        if (now - last_flush_ < flush_interval_) return;
+        Histograms histograms;
+        Counters counters;
+        histograms.swap(histograms_);
+        counters.swap(counters_);
+        last_flush_ = now;
+        lock.unlock();
+        Write(histograms, counters);
+    }
+
+    static void Write(const Histograms& histograms, const Counters& counters) {
+        for (const auto& [key, count] : histograms) {
+            WriteHistogram(key.first, key.second, count);
+        }
+        // A sum that doesn't fit the value of one event is logged over several.
+        for (const auto& [name, total] : counters) {
+            auto remaining = total;
+            do {
+                auto val = static_cast<int32_t>(
+                        std::clamp<int64_t>(remaining, std::numeric_limits<int32_t>::min(),
+                                            std::numeric_limits<int32_t>::max()));
+                WriteCounter(name, val);
+                remaining -= val;
+            } while (remaining != 0);
+        }
+    }
+
+    std::mutex lock_;
+    bool enabled_ = false;
+    std::chrono::milliseconds flush_interval_;
+    android::base::boot_clock::time_point last_flush_;
+    Histograms histograms_;
+    Counters counters_;
+};
+
+Aggregator& GetAggregator() {
+    static auto* aggregator = new Aggregator();
+    return *aggregator;
+}
+
 }  // namespace
 
 namespace android {
@@ -49,27 +181,26 @@ namespace metricslogger {
 
 // Mirror com.android.internal.logging.MetricsLogger#histogram().
 void LogHistogram(const std::string& event, int32_t data) {
-    android_log_event_list log(kSysuiMultiActionTag);
-    log << LOGBUILDER_CATEGORY << LOGBUILDER_HISTOGRAM << LOGBUILDER_NAME << event
-        << LOGBUILDER_BUCKET << data << LOGBUILDER_VALUE << 1 << LOG_ID_EVENTS;
-
-    stats_event_list stats_log(kStatsEventTag);
-    stats_log << getElapsedTimeNanoSinceBoot() << kKeyValuePairAtomId << LOGBUILDER_CATEGORY
-              << LOGBUILDER_HISTOGRAM << LOGBUILDER_NAME << event << LOGBUILDER_BUCKET << data
-              << LOGBUILDER_VALUE << 1;
-    stats_log.write(LOG_ID_STATS);
+    if (GetAggregator().AddHistogram(event, data)) return;
+    WriteHistogram(event, data, 1);
 }
 
 // Mirror com.android.internal.logging.MetricsLogger#count().
 void LogCounter(const std::string& name, int32_t val) {
-    android_log_event_list log(kSysuiMultiActionTag);
-    log << LOGBUILDER_CATEGORY << LOGBUILDER_COUNTER << LOGBUILDER_NAME << name << LOGBUILDER_VALUE
-        << val << LOG_ID_EVENTS;
+    if (GetAggregator().AddCounter(name, val)) return;
+    WriteCounter(name, val);
+}
 
-    stats_event_list stats_log(kStatsEventTag);
-    stats_log << getElapsedTimeNanoSinceBoot() << kKeyValuePairAtomId << LOGBUILDER_CATEGORY
-              << LOGBUILDER_COUNTER << LOGBUILDER_NAME << name << LOGBUILDER_VALUE << val;
-    stats_log.write(LOG_ID_STATS);
+void EnableAggregation(std::chrono::milliseconds flush_interval) {
+    GetAggregator().Enable(flush_interval);
+}
+
+void FlushAggregatedMetrics() {
+    GetAggregator().Flush();
+}
+
+void DisableAggregation() {
+    GetAggregator().Disable();
 }
 
 // Mirror com.android.internal.logging.MetricsLogger#action().
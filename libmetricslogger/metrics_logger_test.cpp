@@ -26,3 +26,13 @@ TEST(MetricsLoggerTest, AddSingleBootEvent) {
 TEST(MetricsLoggerTest, AddCounterVal) {
     android::metricslogger::LogCounter("test_count", 10);
 }
+
+TEST(MetricsLoggerTest, AggregateSamples) {
+    android::metricslogger::EnableAggregation(std::chrono::hours(1));
+    for (int i = 0; i < 100; i++) {
+        android::metricslogger::LogHistogram("test_event", i % 4);
+        android::metricslogger::LogCounter("test_count", 10);
+    }
+    android::metricslogger::FlushAggregatedMetrics();
+    android::metricslogger::DisableAggregation();
+}
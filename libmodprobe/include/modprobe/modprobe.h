@@ -26,6 +26,9 @@ class Modprobe {
     Modprobe(const std::vector<std::string>&);
 
     bool LoadListedModules();
+    // Like LoadListedModules(), but modules that do not depend on each other
+    // are loaded concurrently, on up to |num_threads| threads.
+    bool LoadModulesParallel(int num_threads);
     bool LoadWithAliases(const std::string& module_name, bool strict,
                          const std::string& parameters = "");
     bool Remove(const std::string& module_name);
@@ -38,6 +41,7 @@ class Modprobe {
 
   private:
     std::string MakeCanonical(const std::string& module_path);
+    std::set<std::string> ExpandAliases(const std::string& module_name);
     bool InsmodWithDeps(const std::string& module_name, const std::string& parameters);
     bool Insmod(const std::string& path_name, const std::string& parameters);
     bool Rmmod(const std::string& module_name);
@@ -53,6 +57,11 @@ class Modprobe {
     void ParseCfg(const std::string& cfg, std::function<bool(const std::vector<std::string>&)> f);
 
     std::vector<std::pair<std::string, std::string>> module_aliases_;
+    // Indexes into module_aliases_, by the literal prefix of the alias pattern (everything up to
+    // its first wildcard), and the lengths of those prefixes. A name can only match the patterns
+    // whose prefix it starts with, so only those need to go through fnmatch().
+    std::unordered_map<std::string, std::vector<size_t>> module_alias_prefixes_;
+    std::set<size_t> module_alias_prefix_lengths_;
     std::unordered_map<std::string, std::vector<std::string>> module_deps_;
     std::vector<std::pair<std::string, std::string>> module_pre_softdep_;
     std::vector<std::pair<std::string, std::string>> module_post_softdep_;
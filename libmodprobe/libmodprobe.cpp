@@ -21,8 +21,14 @@
 #include <sys/syscall.h>
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
 #include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <android-base/chrono_utils.h>
@@ -103,6 +109,9 @@ bool Modprobe::ParseAliasCallback(const std::vector<std::string>& args) {
 
     const std::string& alias = *it++;
     const std::string& module_name = *it++;
+    auto prefix = alias.substr(0, alias.find_first_of("*?[\\"));
+    this->module_alias_prefix_lengths_.emplace(prefix.size());
+    this->module_alias_prefixes_[prefix].emplace_back(this->module_aliases_.size());
     this->module_aliases_.emplace_back(alias, module_name);
 
     return true;
@@ -328,18 +337,29 @@ bool Modprobe::InsmodWithDeps(const std::string& module_name, const std::string&
     return true;
 }
 
-bool Modprobe::LoadWithAliases(const std::string& module_name, bool strict,
-                               const std::string& parameters) {
-    std::set<std::string> modules_to_load = {MakeCanonical(module_name)};
-    bool module_loaded = false;
+std::set<std::string> Modprobe::ExpandAliases(const std::string& module_name) {
+    std::set<std::string> modules = {MakeCanonical(module_name)};
 
     // use aliases to expand list of modules to load (multiple modules
     // may alias themselves to the requested name)
-    for (const auto& [alias, aliased_module] : module_aliases_) {
-        if (fnmatch(alias.c_str(), module_name.c_str(), 0) != 0) continue;
-        LOG(VERBOSE) << "Found alias for '" << module_name << "': '" << aliased_module;
-        modules_to_load.emplace(aliased_module);
+    for (size_t prefix_length : module_alias_prefix_lengths_) {
+        if (prefix_length > module_name.size()) break;
+        auto candidates = module_alias_prefixes_.find(module_name.substr(0, prefix_length));
+        if (candidates == module_alias_prefixes_.end()) continue;
+        for (size_t i : candidates->second) {
+            const auto& [alias, aliased_module] = module_aliases_[i];
+            if (fnmatch(alias.c_str(), module_name.c_str(), 0) != 0) continue;
+            LOG(VERBOSE) << "Found alias for '" << module_name << "': '" << aliased_module;
+            modules.emplace(aliased_module);
+        }
     }
+    return modules;
+}
+
+bool Modprobe::LoadWithAliases(const std::string& module_name, bool strict,
+                               const std::string& parameters) {
+    std::set<std::string> modules_to_load = ExpandAliases(module_name);
+    bool module_loaded = false;
 
     // attempt to load all modules aliased to this name
     for (const auto& module : modules_to_load) {
@@ -363,6 +383,163 @@ bool Modprobe::LoadListedModules() {
     return true;
 }
 
+namespace {
+
+struct ModuleNode {
+    enum class State { Waiting, Loaded, Failed };
+
+    // Modules that have to be loaded first. If a hard dependency fails to
+    // load, so does this module; soft dependencies only order the loads.
+    std::set<std::string> hard_deps;
+    std::set<std::string> soft_deps;
+    std::vector<std::string> dependents;
+    size_t pending = 0;
+    bool missing_dep = false;
+    State state = State::Waiting;
+};
+
+}  // namespace
+
+bool Modprobe::LoadModulesParallel(int num_threads) {
+    // Work out every module that LoadListedModules() would try to load, and
+    // what each one has to wait for, following the same rules as
+    // InsmodWithDeps().
+    std::map<std::string, ModuleNode> graph;
+    std::function<void(const std::string&)> add_module = [&](const std::string& module) {
+        if (graph.count(module)) return;
+        auto& node = graph[module];
+
+        auto dependencies = GetDependencies(module);
+        for (auto dep = dependencies.rbegin(); dep != dependencies.rend() - 1; ++dep) {
+            auto dep_module = MakeCanonical(*dep);
+            if (!ModuleExists(dep_module)) {
+                LOG(ERROR) << "Hard dep '" << *dep << "' of '" << module << "' does not exist";
+                node.missing_dep = true;
+                continue;
+            }
+            node.hard_deps.emplace(dep_module);
+            add_module(dep_module);
+        }
+        for (const auto& [it_module, softdep] : module_pre_softdep_) {
+            if (it_module != module) continue;
+            for (const auto& soft_module : ExpandAliases(softdep)) {
+                if (!ModuleExists(soft_module)) continue;
+                node.soft_deps.emplace(soft_module);
+                add_module(soft_module);
+            }
+        }
+        for (const auto& [it_module, softdep] : module_post_softdep_) {
+            if (it_module != module) continue;
+            for (const auto& soft_module : ExpandAliases(softdep)) {
+                if (!ModuleExists(soft_module)) continue;
+                add_module(soft_module);
+                graph[soft_module].soft_deps.emplace(module);
+            }
+        }
+    };
+
+    std::vector<std::pair<std::string, std::set<std::string>>> listed;
+    for (const auto& module_name : module_load_) {
+        std::set<std::string> modules;
+        for (const auto& module : ExpandAliases(module_name)) {
+            if (!ModuleExists(module)) continue;
+            modules.emplace(module);
+            add_module(module);
+        }
+        listed.emplace_back(module_name, std::move(modules));
+    }
+
+    std::deque<std::string> ready;
+    for (auto& [module, node] : graph) {
+        node.pending = node.hard_deps.size() + node.soft_deps.size();
+        for (const auto& dep : node.hard_deps) graph[dep].dependents.emplace_back(module);
+        for (const auto& dep : node.soft_deps) graph[dep].dependents.emplace_back(module);
+        if (!node.pending) ready.emplace_back(module);
+    }
+
+    // Soft dependencies can form cycles, which only the sequential loader
+    // knows how to break.
+    {
+        std::map<std::string, size_t> pending;
+        for (const auto& [module, node] : graph) pending[module] = node.pending;
+        std::deque<std::string> sorted(ready.begin(), ready.end());
+        size_t visited = 0;
+        while (!sorted.empty()) {
+            auto module = sorted.front();
+            sorted.pop_front();
+            visited++;
+            for (const auto& dependent : graph[module].dependents) {
+                if (!--pending[dependent]) sorted.emplace_back(dependent);
+            }
+        }
+        if (visited != graph.size()) {
+            LOG(WARNING) << "Module dependencies contain a cycle, loading modules sequentially";
+            return LoadListedModules();
+        }
+    }
+
+    android::base::Timer total_timer;
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t remaining = graph.size();
+
+    auto worker = [&] {
+        auto lock = std::unique_lock{mutex};
+        while (true) {
+            cv.wait(lock, [&] { return !ready.empty() || !remaining; });
+            if (ready.empty()) return;
+            auto module = ready.front();
+            ready.pop_front();
+            auto& node = graph[module];
+
+            bool ok = !node.missing_dep;
+            for (const auto& dep : node.hard_deps) {
+                if (graph[dep].state != ModuleNode::State::Loaded) ok = false;
+            }
+            if (ok) {
+                lock.unlock();
+                android::base::Timer timer;
+                ok = Insmod(GetDependencies(module).front(), "");
+                LOG(INFO) << "Loading module " << module << " took " << timer;
+                lock.lock();
+            } else {
+                LOG(ERROR) << "Not loading module " << module << ", a hard dep failed to load";
+            }
+
+            node.state = ok ? ModuleNode::State::Loaded : ModuleNode::State::Failed;
+            for (const auto& dependent : node.dependents) {
+                if (!--graph[dependent].pending) ready.emplace_back(dependent);
+            }
+            remaining--;
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads && i < static_cast<int>(graph.size()); i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    LOG(INFO) << "Loaded " << graph.size() << " modules on " << threads.size() + 1
+              << " threads in " << total_timer;
+
+    bool result = true;
+    for (const auto& [module_name, modules] : listed) {
+        bool module_loaded = false;
+        for (const auto& module : modules) {
+            if (graph[module].state == ModuleNode::State::Loaded) module_loaded = true;
+        }
+        if (!module_loaded) {
+            LOG(ERROR) << "LoadModulesParallel was unable to load " << module_name;
+            result = false;
+        }
+    }
+    return result;
+}
+
 bool Modprobe::Remove(const std::string& module_name) {
     auto dependencies = GetDependencies(MakeCanonical(module_name));
     if (dependencies.empty()) {
@@ -17,6 +17,7 @@
 #include <sys/stat.h>
 #include <sys/syscall.h>
 
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -29,7 +30,11 @@
 
 #include "libmodprobe_test.h"
 
+// LoadModulesParallel() calls Insmod() from several threads.
+static std::mutex modules_loaded_lock;
+
 bool Modprobe::Insmod(const std::string& path_name, const std::string& parameters) {
+    std::lock_guard<std::mutex> guard(modules_loaded_lock);
     auto deps = GetDependencies(MakeCanonical(path_name));
     if (deps.empty()) {
         return false;
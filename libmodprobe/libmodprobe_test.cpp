@@ -164,3 +164,96 @@ TEST(libmodprobe, Test) {
     m.EnableBlacklist(true);
     EXPECT_FALSE(m.LoadWithAliases("test4", true));
 }
+
+TEST(libmodprobe, LoadModulesParallel) {
+    test_modules = {"/mod_a.ko", "/mod_b.ko", "/mod_c.ko", "/mod_d.ko",
+                    "/mod_e.ko", "/mod_f.ko", "/mod_g.ko"};
+    modules_loaded.clear();
+
+    const std::string modules_dep =
+            "mod_a.ko:\n"
+            "mod_b.ko: mod_a.ko\n"
+            "mod_c.ko: mod_a.ko\n"
+            "mod_d.ko: mod_b.ko mod_c.ko mod_a.ko\n"
+            "mod_e.ko:\n"
+            "mod_f.ko:\n"
+            "mod_g.ko:\n";
+    const std::string modules_softdep = "softdep mod_e pre: mod_f post: mod_g\n";
+    const std::string modules_load =
+            "mod_d.ko\n"
+            "mod_e.ko\n";
+
+    TemporaryDir dir;
+    auto dir_path = std::string(dir.path);
+    ASSERT_TRUE(android::base::WriteStringToFile(modules_dep, dir_path + "/modules.dep", 0600,
+                                                 getuid(), getgid()));
+    ASSERT_TRUE(android::base::WriteStringToFile(modules_softdep, dir_path + "/modules.softdep",
+                                                 0600, getuid(), getgid()));
+    ASSERT_TRUE(android::base::WriteStringToFile(modules_load, dir_path + "/modules.load", 0600,
+                                                 getuid(), getgid()));
+    for (auto i = test_modules.begin(); i != test_modules.end(); ++i) {
+        *i = dir.path + *i;
+    }
+
+    Modprobe m({dir.path});
+    EXPECT_TRUE(m.LoadModulesParallel(4));
+    ASSERT_EQ(test_modules.size(), modules_loaded.size());
+
+    auto position = [&dir_path](const std::string& module) {
+        auto it = std::find(modules_loaded.begin(), modules_loaded.end(), dir_path + module);
+        EXPECT_NE(it, modules_loaded.end()) << module << " was not loaded";
+        return it - modules_loaded.begin();
+    };
+    EXPECT_LT(position("/mod_a.ko"), position("/mod_b.ko"));
+    EXPECT_LT(position("/mod_a.ko"), position("/mod_c.ko"));
+    EXPECT_LT(position("/mod_b.ko"), position("/mod_d.ko"));
+    EXPECT_LT(position("/mod_c.ko"), position("/mod_d.ko"));
+    EXPECT_LT(position("/mod_f.ko"), position("/mod_e.ko"));
+    EXPECT_LT(position("/mod_e.ko"), position("/mod_g.ko"));
+}
+
+TEST(libmodprobe, LoadWithAliasesWildcards) {
+    test_modules = {"/mod_pci.ko", "/mod_usb.ko", "/mod_of.ko", "/mod_any.ko", "/mod_set.ko"};
+    modules_loaded.clear();
+
+    const std::string modules_dep =
+            "mod_pci.ko:\n"
+            "mod_usb.ko:\n"
+            "mod_of.ko:\n"
+            "mod_any.ko:\n"
+            "mod_set.ko:\n";
+    const std::string modules_alias =
+            "alias pci:v00008086d00001234sv*sd*bc*sc*i* mod_pci\n"
+            "alias usb:v05ACp*d*dc*dsc*dp*ic03isc*ip*in* mod_usb\n"
+            "alias of:N*T*Cvendor,device mod_of\n"
+            "alias *:anything mod_any\n"
+            "alias platform:chip[0-9] mod_set\n";
+
+    TemporaryDir dir;
+    auto dir_path = std::string(dir.path);
+    ASSERT_TRUE(android::base::WriteStringToFile(modules_dep, dir_path + "/modules.dep", 0600,
+                                                 getuid(), getgid()));
+    ASSERT_TRUE(android::base::WriteStringToFile(modules_alias, dir_path + "/modules.alias", 0600,
+                                                 getuid(), getgid()));
+    for (auto i = test_modules.begin(); i != test_modules.end(); ++i) {
+        *i = dir.path + *i;
+    }
+
+    Modprobe m({dir.path});
+    auto loads = [&](const std::string& modalias, const std::string& module) {
+        modules_loaded.clear();
+        return m.LoadWithAliases(modalias, true) && modules_loaded.size() == 1 &&
+               modules_loaded[0] == dir_path + module;
+    };
+    EXPECT_TRUE(loads("pci:v00008086d00001234sv00001028sd0000ABCDbc02sc00i00", "/mod_pci.ko"));
+    EXPECT_TRUE(loads("usb:v05ACp1234d0100dc00dsc00dp00ic03isc01ip02in00", "/mod_usb.ko"));
+    EXPECT_TRUE(loads("of:NfooTbarCvendor,device", "/mod_of.ko"));
+    EXPECT_TRUE(loads("acpi:anything", "/mod_any.ko"));
+    EXPECT_TRUE(loads("platform:chip7", "/mod_set.ko"));
+
+    modules_loaded.clear();
+    EXPECT_FALSE(m.LoadWithAliases("pci:v00008086d00005678sv00001028sd0000ABCDbc02sc00i00", true));
+    EXPECT_FALSE(m.LoadWithAliases("of:NfooTbarCvendor,other", true));
+    EXPECT_FALSE(m.LoadWithAliases("platform:chipX", true));
+    EXPECT_TRUE(modules_loaded.empty());
+}
@@ -24,11 +24,16 @@
 #include <stdio.h>
 #include <sys/mount.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <cinttypes>
 #include <cstring>
+#include <mutex>
 
 #include <android-base/macros.h>
+#include <android-base/properties.h>
 #include <log/log.h>
 
 namespace android {
@@ -119,6 +124,29 @@ static const NativeBridgeRuntimeCallbacks* runtime_callbacks = nullptr;
 // The app's code cache directory.
 static char* app_code_cache_dir = nullptr;
 
+// With ro.dalvik.vm.native.bridge.lazy_init, InitializeNativeBridge leaves the initialization of
+// the bridge itself, and the code cache checks, to the first call that needs the bridge. That
+// takes them off the app start path, and out of apps that never load a bridged library. Bridges
+// that opt in must support getAppEnv being called before initialize.
+static constexpr const char* kLazyInitProperty = "ro.dalvik.vm.native.bridge.lazy_init";
+// Whether that initialization is still to come. The bridge may then be used from any thread, so
+// it is done under a lock, and state must only be read once this is false again.
+static std::atomic<bool> initialization_deferred(false);
+static std::mutex deferred_initialization_lock;
+// The instruction set to initialize the bridge for, while initialization is deferred.
+static char deferred_instruction_set[16];
+
+static uint64_t NowUs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Logs how long a step of setting up the bridge took, started at start_us.
+static void LogTiming(const char* step, uint64_t start_us) {
+  ALOGD("Native bridge %s took %" PRIu64 " us.", step, NowUs() - start_us);
+}
+
 // Code cache directory (relative to the application private directory)
 // Ideally we'd like to call into framework to retrieve this name. However that's considered an
 // implementation detail and will require either hacks or consistent refactorings. We compromise
@@ -222,7 +250,9 @@ bool LoadNativeBridge(const char* nb_library_filename,
       CloseNativeBridge(true);
     } else {
       // Try to open the library.
+      const uint64_t start_us = NowUs();
       void* handle = dlopen(nb_library_filename, RTLD_LAZY);
+      LogTiming("dlopen", start_us);
       if (handle != nullptr) {
         callbacks = reinterpret_cast<NativeBridgeCallbacks*>(dlsym(handle,
                                                                    kNativeBridgeInterfaceSymbol));
@@ -409,28 +439,43 @@ static void SetupEnvironment(const NativeBridgeCallbacks* callbacks, JNIEnv* env
   env->PopLocalFrame(nullptr);
 }
 
+// Checks for the code cache: if it doesn't exist, tries to create it. Releases the path on failure.
+static void CheckAppCodeCacheDir() {
+  struct stat st;
+  if (stat(app_code_cache_dir, &st) == -1) {
+    if (errno == ENOENT) {
+      if (mkdir(app_code_cache_dir, S_IRWXU | S_IRWXG | S_IXOTH) == -1) {
+        ALOGW("Cannot create code cache directory %s: %s.", app_code_cache_dir, strerror(errno));
+        ReleaseAppCodeCacheDir();
+      }
+    } else {
+      ALOGW("Cannot stat code cache directory %s: %s.", app_code_cache_dir, strerror(errno));
+      ReleaseAppCodeCacheDir();
+    }
+  } else if (!S_ISDIR(st.st_mode)) {
+    ALOGW("Code cache is not a directory %s.", app_code_cache_dir);
+    ReleaseAppCodeCacheDir();
+  }
+}
+
 bool InitializeNativeBridge(JNIEnv* env, const char* instruction_set) {
   // We expect only one place that calls InitializeNativeBridge: Runtime::DidForkFromZygote. At that
   // point we are not multi-threaded, so we do not need locking here.
 
   if (state == NativeBridgeState::kPreInitialized) {
-    // Check for code cache: if it doesn't exist try to create it.
-    struct stat st;
-    if (stat(app_code_cache_dir, &st) == -1) {
-      if (errno == ENOENT) {
-        if (mkdir(app_code_cache_dir, S_IRWXU | S_IRWXG | S_IXOTH) == -1) {
-          ALOGW("Cannot create code cache directory %s: %s.", app_code_cache_dir, strerror(errno));
-          ReleaseAppCodeCacheDir();
-        }
-      } else {
-        ALOGW("Cannot stat code cache directory %s: %s.", app_code_cache_dir, strerror(errno));
-        ReleaseAppCodeCacheDir();
-      }
-    } else if (!S_ISDIR(st.st_mode)) {
-      ALOGW("Code cache is not a directory %s.", app_code_cache_dir);
-      ReleaseAppCodeCacheDir();
+    const uint64_t start_us = NowUs();
+    if (instruction_set != nullptr && strlen(instruction_set) < sizeof(deferred_instruction_set) &&
+        android::base::GetBoolProperty(kLazyInitProperty, false)) {
+      // The environment can only be set up now, while we have a JNIEnv.
+      SetupEnvironment(callbacks, env, instruction_set);
+      strcpy(deferred_instruction_set, instruction_set);
+      initialization_deferred.store(true, std::memory_order_release);
+      LogTiming("environment setup", start_us);
+      return true;
     }
 
+    CheckAppCodeCacheDir();
+
     // If we're still PreInitialized (dind't fail the code cache checks) try to initialize.
     if (state == NativeBridgeState::kPreInitialized) {
       if (callbacks->initialize(runtime_callbacks, app_code_cache_dir, instruction_set)) {
@@ -438,6 +483,7 @@ bool InitializeNativeBridge(JNIEnv* env, const char* instruction_set) {
         state = NativeBridgeState::kInitialized;
         // We no longer need the code cache path, release the memory.
         ReleaseAppCodeCacheDir();
+        LogTiming("initialization", start_us);
       } else {
         // Unload the library.
         dlclose(native_bridge_handle);
@@ -451,6 +497,29 @@ bool InitializeNativeBridge(JNIEnv* env, const char* instruction_set) {
   return state == NativeBridgeState::kInitialized;
 }
 
+// Finishes an initialization left for later by InitializeNativeBridge, if there is one. Returns
+// whether the bridge is initialized.
+static bool EnsureNativeBridgeInitialized() {
+  if (initialization_deferred.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> guard(deferred_initialization_lock);
+    if (initialization_deferred.load(std::memory_order_relaxed)) {
+      const uint64_t start_us = NowUs();
+      CheckAppCodeCacheDir();
+      if (callbacks->initialize(runtime_callbacks, app_code_cache_dir, deferred_instruction_set)) {
+        state = NativeBridgeState::kInitialized;
+        ReleaseAppCodeCacheDir();
+        LogTiming("deferred initialization", start_us);
+      } else {
+        ALOGE("Deferred native bridge initialization failed.");
+        dlclose(native_bridge_handle);
+        CloseNativeBridge(true);
+      }
+      initialization_deferred.store(false, std::memory_order_release);
+    }
+  }
+  return state == NativeBridgeState::kInitialized;
+}
+
 void UnloadNativeBridge() {
   // We expect only one place that calls UnloadNativeBridge: Runtime::DidForkFromZygote. At that
   // point we are not multi-threaded, so we do not need locking here.
@@ -460,6 +529,7 @@ void UnloadNativeBridge() {
     case NativeBridgeState::kPreInitialized:
     case NativeBridgeState::kInitialized:
       // Unload.
+      initialization_deferred.store(false, std::memory_order_relaxed);
       dlclose(native_bridge_handle);
       CloseNativeBridge(false);
       break;
@@ -487,12 +557,14 @@ bool NativeBridgeAvailable() {
 
 bool NativeBridgeInitialized() {
   // Calls of this are supposed to happen in a state where the native bridge is stable, i.e., after
-  // Runtime::DidForkFromZygote. In that case we do not need a lock.
-  return state == NativeBridgeState::kInitialized;
+  // Runtime::DidForkFromZygote. In that case we do not need a lock. A deferred initialization
+  // counts: it is finished by the first call that needs the bridge.
+  return initialization_deferred.load(std::memory_order_acquire) ||
+         state == NativeBridgeState::kInitialized;
 }
 
 void* NativeBridgeLoadLibrary(const char* libpath, int flag) {
-  if (NativeBridgeInitialized()) {
+  if (EnsureNativeBridgeInitialized()) {
     return callbacks->loadLibrary(libpath, flag);
   }
   return nullptr;
@@ -500,14 +572,14 @@ void* NativeBridgeLoadLibrary(const char* libpath, int flag) {
 
 void* NativeBridgeGetTrampoline(void* handle, const char* name, const char* shorty,
                                 uint32_t len) {
-  if (NativeBridgeInitialized()) {
+  if (EnsureNativeBridgeInitialized()) {
     return callbacks->getTrampoline(handle, name, shorty, len);
   }
   return nullptr;
 }
 
 bool NativeBridgeIsSupported(const char* libpath) {
-  if (NativeBridgeInitialized()) {
+  if (EnsureNativeBridgeInitialized()) {
     return callbacks->isSupported(libpath);
   }
   return false;
@@ -521,7 +593,10 @@ uint32_t NativeBridgeGetVersion() {
 }
 
 NativeBridgeSignalHandlerFn NativeBridgeGetSignalHandler(int signal) {
-  if (NativeBridgeInitialized()) {
+  // This is called from signal handlers, so it must not initialize the bridge: until that is done,
+  // the bridge hasn't run any code that could need its handlers.
+  if (!initialization_deferred.load(std::memory_order_acquire) &&
+      state == NativeBridgeState::kInitialized) {
     if (isCompatibleWith(SIGNAL_VERSION)) {
       return callbacks->getSignalHandler(signal);
     } else {
@@ -532,7 +607,7 @@ NativeBridgeSignalHandlerFn NativeBridgeGetSignalHandler(int signal) {
 }
 
 int NativeBridgeUnloadLibrary(void* handle) {
-  if (NativeBridgeInitialized()) {
+  if (EnsureNativeBridgeInitialized()) {
     if (isCompatibleWith(NAMESPACE_VERSION)) {
       return callbacks->unloadLibrary(handle);
     } else {
@@ -543,7 +618,7 @@ int NativeBridgeUnloadLibrary(void* handle) {
 }
 
 const char* NativeBridgeGetError() {
-  if (NativeBridgeInitialized()) {
+  if (EnsureNativeBridgeInitialized()) {
     if (isCompatibleWith(NAMESPACE_VERSION)) {
       return callbacks->getError();
     } else {
@@ -554,7 +629,7 @@ const char* NativeBridgeGetError() {
 }
 
 bool NativeBridgeIsPathSupported(const char* path) {
-  if (NativeBridgeInitialized()) {
+  if (EnsureNativeBridgeInitialized()) {
     if (isCompatibleWith(NAMESPACE_VERSION)) {
       return callbacks->isPathSupported(path);
     } else {
@@ -566,7 +641,7 @@ bool NativeBridgeIsPathSupported(const char* path) {
 
 bool NativeBridgeInitAnonymousNamespace(const char* public_ns_sonames,
                                         const char* anon_ns_library_path) {
-  if (NativeBridgeInitialized()) {
+  if (EnsureNativeBridgeInitialized()) {
     if (isCompatibleWith(NAMESPACE_VERSION)) {
       return callbacks->initAnonymousNamespace(public_ns_sonames, anon_ns_library_path);
     } else {
@@ -583,7 +658,7 @@ native_bridge_namespace_t* NativeBridgeCreateNamespace(const char* name,
                                                        uint64_t type,
                                                        const char* permitted_when_isolated_path,
                                                        native_bridge_namespace_t* parent_ns) {
-  if (NativeBridgeInitialized()) {
+  if (EnsureNativeBridgeInitialized()) {
     if (isCompatibleWith(NAMESPACE_VERSION)) {
       return callbacks->createNamespace(name,
                                         ld_library_path,
@@ -601,7 +676,7 @@ native_bridge_namespace_t* NativeBridgeCreateNamespace(const char* name,
 
 bool NativeBridgeLinkNamespaces(native_bridge_namespace_t* from, native_bridge_namespace_t* to,
                                 const char* shared_libs_sonames) {
-  if (NativeBridgeInitialized()) {
+  if (EnsureNativeBridgeInitialized()) {
     if (isCompatibleWith(NAMESPACE_VERSION)) {
       return callbacks->linkNamespaces(from, to, shared_libs_sonames);
     } else {
@@ -613,7 +688,7 @@ bool NativeBridgeLinkNamespaces(native_bridge_namespace_t* from, native_bridge_n
 }
 
 native_bridge_namespace_t* NativeBridgeGetExportedNamespace(const char* name) {
-  if (!NativeBridgeInitialized()) {
+  if (!EnsureNativeBridgeInitialized()) {
     return nullptr;
   }
 
@@ -631,7 +706,7 @@ native_bridge_namespace_t* NativeBridgeGetExportedNamespace(const char* name) {
 }
 
 void* NativeBridgeLoadLibraryExt(const char* libpath, int flag, native_bridge_namespace_t* ns) {
-  if (NativeBridgeInitialized()) {
+  if (EnsureNativeBridgeInitialized()) {
     if (isCompatibleWith(NAMESPACE_VERSION)) {
       return callbacks->loadLibraryExt(libpath, flag, ns);
     } else {
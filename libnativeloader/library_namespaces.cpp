@@ -18,8 +18,10 @@
 #include <dirent.h>
 #include <dlfcn.h>
 
-#include <regex>
+#include <algorithm>
+#include <iterator>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <android-base/file.h>
@@ -67,8 +69,8 @@ constexpr const char* kWhitelistedDirectories = "/data:/mnt/expand";
 constexpr const char* kVendorLibPath = "/vendor/" LIB;
 constexpr const char* kProductLibPath = "/product/" LIB ":/system/product/" LIB;
 
-const std::regex kVendorDexPathRegex("(^|:)/vendor/");
-const std::regex kProductDexPathRegex("(^|:)(/system)?/product/");
+constexpr const char* kVendorDexPathPrefix = "/vendor/";
+constexpr const char* kProductDexPathPrefixes[] = {"/product/", "/system/product/"};
 
 // Define origin of APK if it is from vendor partition or product partition
 typedef enum {
@@ -85,17 +87,32 @@ jobject GetParentClassLoader(JNIEnv* env, jobject class_loader) {
   return env->CallObjectMethod(class_loader, get_parent);
 }
 
+// Returns true if one of the colon-separated |paths| starts with |prefix|.
+bool HasPathWithPrefix(std::string_view paths, std::string_view prefix) {
+  size_t pos = 0;
+  while (paths.compare(pos, prefix.size(), prefix) != 0) {
+    pos = paths.find(':', pos);
+    if (pos == std::string_view::npos) {
+      return false;
+    }
+    ++pos;
+  }
+  return true;
+}
+
 ApkOrigin GetApkOriginFromDexPath(JNIEnv* env, jstring dex_path) {
   ApkOrigin apk_origin = APK_ORIGIN_DEFAULT;
 
   if (dex_path != nullptr) {
     ScopedUtfChars dex_path_utf_chars(env, dex_path);
+    std::string_view paths = dex_path_utf_chars.c_str();
 
-    if (std::regex_search(dex_path_utf_chars.c_str(), kVendorDexPathRegex)) {
+    if (HasPathWithPrefix(paths, kVendorDexPathPrefix)) {
       apk_origin = APK_ORIGIN_VENDOR;
     }
 
-    if (std::regex_search(dex_path_utf_chars.c_str(), kProductDexPathRegex)) {
+    if (std::any_of(std::begin(kProductDexPathPrefixes), std::end(kProductDexPathPrefixes),
+                    [&paths](const char* prefix) { return HasPathWithPrefix(paths, prefix); })) {
       LOG_ALWAYS_FATAL_IF(apk_origin == APK_ORIGIN_VENDOR,
                           "Dex path contains both vendor and product partition : %s",
                           dex_path_utf_chars.c_str());
@@ -106,6 +123,23 @@ ApkOrigin GetApkOriginFromDexPath(JNIEnv* env, jstring dex_path) {
   return apk_origin;
 }
 
+// The libraries of the platform namespace that apps link to. Classloaders of
+// the same kind share them, so they are only joined once per process.
+const std::string& unbundled_vendor_or_product_exposed_libraries() {
+  // Also give access to LLNDK libraries since they are available to vendors
+  static std::string list = default_public_libraries() + ":" + llndk_libraries();
+  return list;
+}
+
+const std::string& system_exposed_libraries() {
+  // extended public libraries are NOT available to vendor apks, otherwise it
+  // would be system->vendor violation.
+  static std::string list = extended_public_libraries().empty()
+                                ? default_public_libraries()
+                                : default_public_libraries() + ':' + extended_public_libraries();
+  return list;
+}
+
 }  // namespace
 
 void LibraryNamespaces::Initialize() {
@@ -162,7 +196,7 @@ Result<NativeLoaderNamespace*> LibraryNamespaces::Create(JNIEnv* env, uint32_t t
   LOG_ALWAYS_FATAL_IF(FindNamespaceByClassLoader(env, class_loader) != nullptr,
                       "There is already a namespace associated with this classloader");
 
-  std::string system_exposed_libraries = default_public_libraries();
+  const std::string* exposed_libraries = &system_exposed_libraries();
   const char* namespace_name = kClassloaderNamespaceName;
   bool unbundled_vendor_or_product_app = false;
   if ((apk_origin == APK_ORIGIN_VENDOR ||
@@ -191,19 +225,12 @@ Result<NativeLoaderNamespace*> LibraryNamespaces::Create(JNIEnv* env, uint32_t t
     library_path = library_path + ":" + origin_lib_path;
     permitted_path = permitted_path + ":" + origin_lib_path;
 
-    // Also give access to LLNDK libraries since they are available to vendors
-    system_exposed_libraries = system_exposed_libraries + ":" + llndk_libraries().c_str();
+    exposed_libraries = &unbundled_vendor_or_product_exposed_libraries();
 
     // Different name is useful for debugging
     namespace_name = kVendorClassloaderNamespaceName;
     ALOGD("classloader namespace configured for unbundled %s apk. library_path=%s",
           origin_partition, library_path.c_str());
-  } else {
-    // extended public libraries are NOT available to vendor apks, otherwise it
-    // would be system->vendor violation.
-    if (!extended_public_libraries().empty()) {
-      system_exposed_libraries = system_exposed_libraries + ':' + extended_public_libraries();
-    }
   }
 
   // Create the app namespace
@@ -232,7 +259,7 @@ Result<NativeLoaderNamespace*> LibraryNamespaces::Create(JNIEnv* env, uint32_t t
     return platform_ns.error();
   }
 
-  auto linked = app_ns->Link(*platform_ns, system_exposed_libraries);
+  auto linked = app_ns->Link(*platform_ns, *exposed_libraries);
   if (!linked) {
     return linked.error();
   }
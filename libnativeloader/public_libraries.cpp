@@ -154,26 +154,44 @@ void ReadExtensionLibraries(const char* dirname, std::vector<std::string>* sonam
   }
 }
 
-static std::string InitDefaultPublicLibraries(bool for_preload) {
+// Removes |names| from |sonames|, if they are there.
+void RemoveLibraries(const std::vector<std::string>& names, std::vector<std::string>* sonames) {
+  for (const std::string& name : names) {
+    auto it = std::find(sonames->begin(), sonames->end(), name);
+    if (it != sonames->end()) {
+      sonames->erase(it);
+    }
+  }
+}
+
+// The default public libraries, and the subset of them that is preloaded.
+struct DefaultPublicLibraries {
+  std::string all;
+  std::string preloadable;
+};
+
+// Reads public.libraries.txt once for both of the lists.
+static DefaultPublicLibraries InitDefaultPublicLibraries() {
   std::string config_file = root_dir() + kDefaultPublicLibrariesFile;
+  std::vector<std::string> preloadable;
   auto sonames =
-      ReadConfig(config_file, [&for_preload](const struct ConfigEntry& entry) -> Result<bool> {
-        if (for_preload) {
-          return !entry.nopreload;
-        } else {
-          return true;
+      ReadConfig(config_file, [&preloadable](const struct ConfigEntry& entry) -> Result<bool> {
+        if (!entry.nopreload) {
+          preloadable.push_back(entry.soname);
         }
+        return true;
       });
   if (!sonames) {
     LOG_ALWAYS_FATAL("Error reading public native library list from \"%s\": %s",
                      config_file.c_str(), sonames.error().message().c_str());
-    return "";
+    return {};
   }
 
   std::string additional_libs = additional_public_libraries();
   if (!additional_libs.empty()) {
     auto vec = base::Split(additional_libs, ":");
     std::copy(vec.begin(), vec.end(), std::back_inserter(*sonames));
+    std::copy(vec.begin(), vec.end(), std::back_inserter(preloadable));
   }
 
   // Remove the public libs in the runtime namespace.
@@ -182,6 +200,7 @@ static std::string InitDefaultPublicLibraries(bool for_preload) {
   // For example, libicuuc.so is exposed to classloader namespace from runtime namespace.
   // Unfortunately, it does not have stable C symbols, and default namespace should only use
   // stable symbols in libandroidicu.so. http://b/120786417
+  std::vector<std::string> removed;
   for (const std::string& lib_name : kArtApexPublicLibraries) {
     std::string path(kArtApexLibPath);
     path.append("/").append(lib_name);
@@ -192,19 +211,20 @@ static std::string InitDefaultPublicLibraries(bool for_preload) {
     if (stat(path.c_str(), &s) != 0) {
       continue;
     }
-
-    auto it = std::find(sonames->begin(), sonames->end(), lib_name);
-    if (it != sonames->end()) {
-      sonames->erase(it);
-    }
+    removed.push_back(lib_name);
   }
 
   // Remove the public libs in the nnapi namespace.
-  auto it = std::find(sonames->begin(), sonames->end(), kNeuralNetworksApexPublicLibrary);
-  if (it != sonames->end()) {
-    sonames->erase(it);
-  }
-  return android::base::Join(*sonames, ':');
+  removed.push_back(kNeuralNetworksApexPublicLibrary);
+
+  RemoveLibraries(removed, &*sonames);
+  RemoveLibraries(removed, &preloadable);
+  return {android::base::Join(*sonames, ':'), android::base::Join(preloadable, ':')};
+}
+
+static const DefaultPublicLibraries& default_public_libraries_lists() {
+  static DefaultPublicLibraries lists = InitDefaultPublicLibraries();
+  return lists;
 }
 
 static std::string InitArtPublicLibraries() {
@@ -267,13 +287,11 @@ static std::string InitNeuralNetworksPublicLibraries() {
 }  // namespace
 
 const std::string& preloadable_public_libraries() {
-  static std::string list = InitDefaultPublicLibraries(/*for_preload*/ true);
-  return list;
+  return default_public_libraries_lists().preloadable;
 }
 
 const std::string& default_public_libraries() {
-  static std::string list = InitDefaultPublicLibraries(/*for_preload*/ false);
-  return list;
+  return default_public_libraries_lists().all;
 }
 
 const std::string& runtime_public_libraries() {
@@ -22,6 +22,7 @@
 #include <netinet/ip_icmp.h>
 #include <netinet/tcp.h>
 #include <netinet/udp.h>
+#include <string.h>
 
 #include "netutils/checksum.h"
 
@@ -30,22 +31,47 @@
  * current - the current checksum (or 0 to start a new checksum)
  *   data        - the data to add to the checksum
  *   len         - length of data
+ *
+ * The one's complement sum doesn't depend on how the data is split into words, so this adds 32-bit
+ * words into a 64-bit sum, four at a time, and folds that to 16 bits before adding it to current.
+ * The result is the same as adding the data 16 bits at a time, once folded.
  */
 uint32_t ip_checksum_add(uint32_t current, const void* data, int len) {
-    uint32_t checksum = current;
-    int left = len;
-    const uint16_t* data_16 = data;
-
-    while (left > 1) {
-        checksum += *data_16;
-        data_16++;
-        left -= 2;
+    const uint8_t* p = data;
+    uint64_t sum = 0;
+    uint32_t w0, w1, w2, w3;
+
+    while (len >= 16) {
+        memcpy(&w0, p, 4);
+        memcpy(&w1, p + 4, 4);
+        memcpy(&w2, p + 8, 4);
+        memcpy(&w3, p + 12, 4);
+        sum += (uint64_t)w0 + w1 + w2 + w3;
+        p += 16;
+        len -= 16;
+    }
+    while (len >= 4) {
+        memcpy(&w0, p, 4);
+        sum += w0;
+        p += 4;
+        len -= 4;
+    }
+    if (len >= 2) {
+        uint16_t w;
+        memcpy(&w, p, 2);
+        sum += w;
+        p += 2;
+        len -= 2;
     }
-    if (left) {
-        checksum += *(uint8_t*)data_16;
+    if (len) {
+        sum += *p;
     }
 
-    return checksum;
+    sum = (sum >> 32) + (sum & 0xffffffff);
+    sum = (sum >> 32) + (sum & 0xffffffff);
+    sum = (sum >> 16) + (sum & 0xffff);
+    sum = (sum >> 16) + (sum & 0xffff);
+    return current + (uint32_t)sum;
 }
 
 /* function: ip_checksum_fold
@@ -384,147 +384,254 @@ static int is_valid_reply(dhcp_msg *msg, dhcp_msg *reply, int sz)
 #define TIMEOUT_INITIAL   4000
 #define TIMEOUT_MAX      32000
 
-int dhcp_init_ifc(const char *ifname)
-{
-    dhcp_msg discover_msg;
-    dhcp_msg request_msg;
-    dhcp_msg reply;
-    dhcp_msg *msg;
-    dhcp_info info;
-    int s, r, size;
-    int valid_reply;
-    uint32_t xid;
+/* The state of the DHCP exchange on one interface. */
+typedef struct dhcp_client {
+    const char *ifname;
+    int s;
+    int if_index;
     unsigned char hwaddr[6];
-    struct pollfd pfd;
+    uint32_t xid;
     unsigned int state;
     unsigned int timeout;
-    int if_index;
+    msecs_t deadline;
+    dhcp_msg discover_msg;
+    dhcp_msg request_msg;
+    dhcp_info info;
+    /* Whether the exchange is over, and if so its result, and errno on failure. */
+    int done;
+    int result;
+    int error;
+} dhcp_client;
 
-    xid = (uint32_t) get_msecs();
+static void dhcp_client_finish(dhcp_client *c, int result)
+{
+    c->error = result < 0 ? errno : 0;
+    if (c->s >= 0) {
+        close(c->s);
+        c->s = -1;
+    }
+    c->result = result;
+    c->done = 1;
+}
 
-    if (ifc_get_hwaddr(ifname, hwaddr)) {
-        return fatal("cannot obtain interface address");
+static void dhcp_client_transmit(dhcp_client *c)
+{
+    dhcp_msg *msg = NULL;
+    int size = 0;
+
+    switch(c->state) {
+    case STATE_SELECTING:
+        msg = &c->discover_msg;
+        size = init_dhcp_discover_msg(msg, c->hwaddr, c->xid);
+        break;
+    case STATE_REQUESTING:
+        msg = &c->request_msg;
+        size = init_dhcp_request_msg(msg, c->hwaddr, c->xid, c->info.ipaddr, c->info.serveraddr);
+        break;
     }
-    if (ifc_get_ifindex(ifname, &if_index)) {
-        return fatal("cannot obtain interface index");
+    if (size != 0) {
+        if (send_message(c->s, c->if_index, msg, size) < 0) {
+            printerr("error sending dhcp msg: %s\n", strerror(errno));
+        }
     }
+    c->deadline = get_msecs() + c->timeout;
+}
+
+static int dhcp_client_start(dhcp_client *c, const char *ifname, uint32_t xid)
+{
+    memset(c, 0, sizeof(*c));
+    c->ifname = ifname;
+    c->s = -1;
+    c->xid = xid;
 
-    s = open_raw_socket(ifname, hwaddr, if_index);
+    if (ifc_get_hwaddr(ifname, c->hwaddr)) {
+        dhcp_client_finish(c, fatal("cannot obtain interface address"));
+        return -1;
+    }
+    if (ifc_get_ifindex(ifname, &c->if_index)) {
+        dhcp_client_finish(c, fatal("cannot obtain interface index"));
+        return -1;
+    }
 
-    timeout = TIMEOUT_INITIAL;
-    state = STATE_SELECTING;
-    info.type = 0;
-    goto transmit;
+    c->s = open_raw_socket(ifname, c->hwaddr, c->if_index);
+    if (c->s < 0) {
+        dhcp_client_finish(c, -1);
+        return -1;
+    }
 
-    for (;;) {
-        pfd.fd = s;
-        pfd.events = POLLIN;
-        pfd.revents = 0;
-        r = poll(&pfd, 1, timeout);
+    c->timeout = TIMEOUT_INITIAL;
+    c->state = STATE_SELECTING;
+    c->info.type = 0;
+    dhcp_client_transmit(c);
+    return 0;
+}
 
-        if (r == 0) {
+static void dhcp_client_timed_out(dhcp_client *c)
+{
 #if VERBOSE
-            printerr("TIMEOUT\n");
+    printerr("TIMEOUT\n");
 #endif
-            if (timeout >= TIMEOUT_MAX) {
-                printerr("timed out\n");
-                if ( info.type == DHCPOFFER ) {
-                    printerr("no acknowledgement from DHCP server\nconfiguring %s with offered parameters\n", ifname);
-                    return dhcp_configure(ifname, &info);
-                }
-                errno = ETIME;
-                close(s);
-                return -1;
-            }
-            timeout = timeout * 2;
-
-        transmit:
-            size = 0;
-            msg = NULL;
-            switch(state) {
-            case STATE_SELECTING:
-                msg = &discover_msg;
-                size = init_dhcp_discover_msg(msg, hwaddr, xid);
-                break;
-            case STATE_REQUESTING:
-                msg = &request_msg;
-                size = init_dhcp_request_msg(msg, hwaddr, xid, info.ipaddr, info.serveraddr);
-                break;
-            default:
-                r = 0;
-            }
-            if (size != 0) {
-                r = send_message(s, if_index, msg, size);
-                if (r < 0) {
-                    printerr("error sending dhcp msg: %s\n", strerror(errno));
-                }
-            }
-            continue;
+    if (c->timeout >= TIMEOUT_MAX) {
+        printerr("timed out\n");
+        if ( c->info.type == DHCPOFFER ) {
+            printerr("no acknowledgement from DHCP server\nconfiguring %s with offered parameters\n", c->ifname);
+            dhcp_client_finish(c, dhcp_configure(c->ifname, &c->info));
+            return;
         }
+        errno = ETIME;
+        dhcp_client_finish(c, -1);
+        return;
+    }
+    c->timeout = c->timeout * 2;
+    dhcp_client_transmit(c);
+}
 
-        if (r < 0) {
-            if ((errno == EAGAIN) || (errno == EINTR)) {
-                continue;
-            }
-            return fatal("poll failed");
-        }
+static void dhcp_client_receive(dhcp_client *c)
+{
+    dhcp_msg reply;
+    int r;
+    int valid_reply;
 
-        errno = 0;
-        r = receive_packet(s, &reply);
-        if (r < 0) {
-            if (errno != 0) {
-                ALOGD("receive_packet failed (%d): %s", r, strerror(errno));
-                if (errno == ENETDOWN || errno == ENXIO) {
-                    return -1;
-                }
+    errno = 0;
+    r = receive_packet(c->s, &reply);
+    if (r < 0) {
+        if (errno != 0) {
+            ALOGD("receive_packet failed (%d): %s", r, strerror(errno));
+            if (errno == ENETDOWN || errno == ENXIO) {
+                dhcp_client_finish(c, -1);
             }
-            continue;
         }
+        return;
+    }
 
 #if VERBOSE > 1
-        dump_dhcp_msg(&reply, r);
+    dump_dhcp_msg(&reply, r);
 #endif
-        decode_dhcp_msg(&reply, r, &info);
+    decode_dhcp_msg(&reply, r, &c->info);
 
-        if (state == STATE_SELECTING) {
-            valid_reply = is_valid_reply(&discover_msg, &reply, r);
-        } else {
-            valid_reply = is_valid_reply(&request_msg, &reply, r);
+    if (c->state == STATE_SELECTING) {
+        valid_reply = is_valid_reply(&c->discover_msg, &reply, r);
+    } else {
+        valid_reply = is_valid_reply(&c->request_msg, &reply, r);
+    }
+    if (!valid_reply) {
+        printerr("invalid reply\n");
+        return;
+    }
+
+    if (verbose) dump_dhcp_info(&c->info);
+
+    switch(c->state) {
+    case STATE_SELECTING:
+        if (c->info.type == DHCPOFFER) {
+            c->state = STATE_REQUESTING;
+            c->timeout = TIMEOUT_INITIAL;
+            c->xid++;
+            dhcp_client_transmit(c);
         }
-        if (!valid_reply) {
-            printerr("invalid reply\n");
-            continue;
+        break;
+    case STATE_REQUESTING:
+        if (c->info.type == DHCPACK) {
+            printerr("configuring %s\n", c->ifname);
+            dhcp_client_finish(c, dhcp_configure(c->ifname, &c->info));
+        } else if (c->info.type == DHCPNAK) {
+            printerr("configuration request denied\n");
+            errno = 0;
+            dhcp_client_finish(c, -1);
+        } else {
+            printerr("ignoring %s message in state %d\n",
+                     dhcp_type_to_name(c->info.type), c->state);
         }
+        break;
+    }
+}
+
+int dhcp_init_ifcs(const char **ifnames, int count, int *results)
+{
+    dhcp_client *clients;
+    struct pollfd *pfds;
+    dhcp_client **polled;
+    uint32_t xid;
+    int i, n, r;
+    int failed = 0;
+
+    clients = calloc(count, sizeof(*clients));
+    pfds = calloc(count, sizeof(*pfds));
+    polled = calloc(count, sizeof(*polled));
+    if (!clients || !pfds || !polled) {
+        free(clients);
+        free(pfds);
+        free(polled);
+        errno = ENOMEM;
+        return -1;
+    }
 
-        if (verbose) dump_dhcp_info(&info);
+    /* Each exchange gets its own xids, so one interface's replies don't match another's. */
+    xid = (uint32_t) get_msecs();
+    for (i = 0; i < count; i++) {
+        dhcp_client_start(&clients[i], ifnames[i], xid + 2 * i);
+    }
 
-        switch(state) {
-        case STATE_SELECTING:
-            if (info.type == DHCPOFFER) {
-                state = STATE_REQUESTING;
-                timeout = TIMEOUT_INITIAL;
-                xid++;
-                goto transmit;
+    for (;;) {
+        msecs_t now = get_msecs();
+        int timeout = -1;
+
+        n = 0;
+        for (i = 0; i < count; i++) {
+            dhcp_client *c = &clients[i];
+            if (c->done) continue;
+            pfds[n].fd = c->s;
+            pfds[n].events = POLLIN;
+            pfds[n].revents = 0;
+            polled[n] = c;
+            n++;
+            int left = c->deadline > now ? (int)(c->deadline - now) : 0;
+            if (timeout < 0 || left < timeout) timeout = left;
+        }
+        if (n == 0) break;
+
+        r = poll(pfds, n, timeout);
+        if (r < 0) {
+            if ((errno == EAGAIN) || (errno == EINTR)) {
+                continue;
             }
-            break;
-        case STATE_REQUESTING:
-            if (info.type == DHCPACK) {
-                printerr("configuring %s\n", ifname);
-                close(s);
-                return dhcp_configure(ifname, &info);
-            } else if (info.type == DHCPNAK) {
-                printerr("configuration request denied\n");
-                close(s);
-                return -1;
-            } else {
-                printerr("ignoring %s message in state %d\n",
-                         dhcp_type_to_name(info.type), state);
+            r = fatal("poll failed");
+            for (i = 0; i < n; i++) {
+                dhcp_client_finish(polled[i], r);
             }
             break;
         }
+
+        now = get_msecs();
+        for (i = 0; i < n; i++) {
+            dhcp_client *c = polled[i];
+            if (pfds[i].revents) {
+                dhcp_client_receive(c);
+            } else if (c->deadline <= now) {
+                dhcp_client_timed_out(c);
+            }
+        }
     }
-    close(s);
-    return 0;
+
+    for (i = 0; i < count; i++) {
+        if (results) results[i] = clients[i].result;
+        if (clients[i].result < 0 && !failed) {
+            failed = 1;
+            errno = clients[i].error;
+        }
+    }
+    free(clients);
+    free(pfds);
+    free(polled);
+    return failed ? -1 : 0;
+}
+
+int dhcp_init_ifc(const char *ifname)
+{
+    int result = -1;
+
+    dhcp_init_ifcs(&ifname, 1, &result);
+    return result;
 }
 
 int do_dhcp(char *iname)
@@ -541,3 +648,49 @@ int do_dhcp(char *iname)
 
     return dhcp_init_ifc(iname);
 }
+
+int do_dhcps(char **inames, int count, int *results)
+{
+    const char **started;
+    int *started_results;
+    int i, n = 0;
+    int failed = 0;
+    int error = 0;
+
+    started = calloc(count, sizeof(*started));
+    started_results = calloc(count, sizeof(*started_results));
+    if (!started || !started_results) {
+        free(started);
+        free(started_results);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    /* Bring every interface up first, so that their exchanges all run at once. */
+    for (i = 0; i < count; i++) {
+        results[i] = -1;
+        if (ifc_set_addr(inames[i], 0)) {
+            printerr("failed to set ip addr for %s to 0.0.0.0: %s\n", inames[i], strerror(errno));
+        } else if (ifc_up(inames[i])) {
+            printerr("failed to bring up interface %s: %s\n", inames[i], strerror(errno));
+        } else {
+            started[n++] = inames[i];
+            continue;
+        }
+        if (!failed) error = errno;
+        failed = 1;
+    }
+
+    if (n > 0 && dhcp_init_ifcs(started, n, started_results) < 0 && !failed) {
+        error = errno;
+        failed = 1;
+    }
+    for (i = 0, n = 0; i < count; i++) {
+        if (started[n] == inames[i]) results[i] = started_results[n++];
+    }
+
+    free(started);
+    free(started_results);
+    if (failed) errno = error;
+    return failed ? -1 : 0;
+}
@@ -22,23 +22,31 @@
 
 #include <netutils/ifc.h>
 
-extern int do_dhcp(char*);
+extern int do_dhcps(char**, int, int*);
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        error(EXIT_FAILURE, 0, "usage: %s INTERFACE", argv[0]);
+    if (argc < 2) {
+        error(EXIT_FAILURE, 0, "usage: %s INTERFACE...", argv[0]);
     }
 
-    char* interface = argv[1];
+    char** interfaces = argv + 1;
+    int count = argc - 1;
     if (ifc_init()) {
-        err(errno, "dhcptool %s: ifc_init failed", interface);
+        err(errno, "dhcptool %s: ifc_init failed", interfaces[0]);
         ifc_close();
         return EXIT_FAILURE;
     }
 
-    int rc = do_dhcp(interface);
+    // All of the interfaces are configured at once, rather than one after the other.
+    int results[count];
+    int rc = do_dhcps(interfaces, count, results);
+    for (int i = 0; i < count; i++) {
+        if (results[i]) {
+            warnx("dhcptool %s: do_dhcp failed", interfaces[i]);
+        }
+    }
     if (rc) {
-        err(errno, "dhcptool %s: do_dhcp failed", interface);
+        err(errno, "dhcptool: do_dhcp failed");
     }
     warn("IP assignment is for debug purposes ONLY");
     ifc_close();
@@ -35,6 +35,7 @@
 #define ALOGW printf
 #endif
 
+#include <netutils/checksum.h>
 #include "dhcpmsg.h"
 
 int fatal();
@@ -62,30 +63,6 @@ int open_raw_socket(const char *ifname __attribute__((unused)), uint8_t *hwaddr,
     return s;
 }
 
-static uint32_t checksum(void *buffer, unsigned int count, uint32_t startsum)
-{
-    uint16_t *up = (uint16_t *)buffer;
-    uint32_t sum = startsum;
-    uint32_t upper16;
-
-    while (count > 1) {
-        sum += *up++;
-        count -= 2;
-    }
-    if (count > 0) {
-        sum += (uint16_t) *(uint8_t *)up;
-    }
-    while ((upper16 = (sum >> 16)) != 0) {
-        sum = (sum & 0xffff) + upper16;
-    }
-    return sum;
-}
-
-static uint32_t finish_sum(uint32_t sum)
-{
-    return ~sum & 0xffff;
-}
-
 int send_packet(int s, int if_index, struct dhcp_msg *msg, int size,
                 uint32_t saddr, uint32_t daddr, uint32_t sport, uint32_t dport)
 {
@@ -93,7 +70,6 @@ int send_packet(int s, int if_index, struct dhcp_msg *msg, int size,
     struct udphdr udp;
     struct iovec iov[3];
     uint32_t udpsum;
-    uint16_t temp;
     struct msghdr msghdr;
     struct sockaddr_ll destaddr;
 
@@ -108,27 +84,18 @@ int send_packet(int s, int if_index, struct dhcp_msg *msg, int size,
     ip.check = 0;
     ip.saddr = saddr;
     ip.daddr = daddr;
-    ip.check = finish_sum(checksum(&ip, sizeof(ip), 0));
+    ip.check = ip_checksum(&ip, sizeof(ip));
 
     udp.source = htons(sport);
     udp.dest = htons(dport);
     udp.len = htons(sizeof(udp) + size);
     udp.check = 0;
 
-    /* Calculate checksum for pseudo header */
-    udpsum = checksum(&ip.saddr, sizeof(ip.saddr), 0);
-    udpsum = checksum(&ip.daddr, sizeof(ip.daddr), udpsum);
-    temp = htons(IPPROTO_UDP);
-    udpsum = checksum(&temp, sizeof(temp), udpsum);
-    temp = udp.len;
-    udpsum = checksum(&temp, sizeof(temp), udpsum);
-
-    /* Add in the checksum for the udp header */
-    udpsum = checksum(&udp, sizeof(udp), udpsum);
-
-    /* Add in the checksum for the data */
-    udpsum = checksum(msg, size, udpsum);
-    udp.check = finish_sum(udpsum);
+    /* The pseudo header, the udp header, then the data */
+    udpsum = ipv4_pseudo_header_checksum(&ip, sizeof(udp) + size);
+    udpsum = ip_checksum_add(udpsum, &udp, sizeof(udp));
+    udpsum = ip_checksum_add(udpsum, msg, size);
+    udp.check = ip_checksum_finish(udpsum);
 
     iov[0].iov_base = (char *)&ip;
     iov[0].iov_len = sizeof(ip);
@@ -157,17 +124,21 @@ int receive_packet(int s, struct dhcp_msg *msg)
 {
     int nread;
     int is_valid;
-    struct dhcp_packet {
-        struct iphdr ip;
-        struct udphdr udp;
-        struct dhcp_msg dhcp;
-    } packet;
+    struct iphdr ip;
+    struct udphdr udp;
+    struct iovec iov[3];
     int dhcp_size;
+    int data_size;
     uint32_t sum;
-    uint16_t temp;
-    uint32_t saddr, daddr;
 
-    nread = read(s, &packet, sizeof(packet));
+    /* Read the DHCP message straight into msg, rather than copying it out of a whole packet. */
+    iov[0].iov_base = &ip;
+    iov[0].iov_len = sizeof(ip);
+    iov[1].iov_base = &udp;
+    iov[1].iov_len = sizeof(udp);
+    iov[2].iov_base = msg;
+    iov[2].iov_len = sizeof(*msg);
+    nread = readv(s, iov, sizeof(iov) / sizeof(struct iovec));
     if (nread < 0) {
         return -1;
     }
@@ -181,21 +152,21 @@ int receive_packet(int s, struct dhcp_msg *msg)
 #if VERBOSE
         ALOGD("Packet is too small (%d) to be a UDP datagram", nread);
 #endif
-    } else if (packet.ip.version != IPVERSION || packet.ip.ihl != (sizeof(packet.ip) >> 2)) {
+    } else if (ip.version != IPVERSION || ip.ihl != (sizeof(ip) >> 2)) {
 #if VERBOSE
         ALOGD("Not a valid IP packet");
 #endif
-    } else if (nread < ntohs(packet.ip.tot_len)) {
+    } else if (nread < ntohs(ip.tot_len)) {
 #if VERBOSE
-        ALOGD("Packet was truncated (read %d, needed %d)", nread, ntohs(packet.ip.tot_len));
+        ALOGD("Packet was truncated (read %d, needed %d)", nread, ntohs(ip.tot_len));
 #endif
-    } else if (packet.ip.protocol != IPPROTO_UDP) {
+    } else if (ip.protocol != IPPROTO_UDP) {
 #if VERBOSE
-        ALOGD("IP protocol (%d) is not UDP", packet.ip.protocol);
+        ALOGD("IP protocol (%d) is not UDP", ip.protocol);
 #endif
-    } else if (packet.udp.dest != htons(PORT_BOOTP_CLIENT)) {
+    } else if (udp.dest != htons(PORT_BOOTP_CLIENT)) {
 #if VERBOSE
-        ALOGD("UDP dest port (%d) is not DHCP client", ntohs(packet.udp.dest));
+        ALOGD("UDP dest port (%d) is not DHCP client", ntohs(udp.dest));
 #endif
     } else {
         is_valid = 1;
@@ -207,17 +178,12 @@ int receive_packet(int s, struct dhcp_msg *msg)
 
     /* Seems like it's probably a valid DHCP packet */
     /* validate IP header checksum */
-    sum = finish_sum(checksum(&packet.ip, sizeof(packet.ip), 0));
-    if (sum != 0) {
-        ALOGW("IP header checksum failure (0x%x)", packet.ip.check);
+    if (ip_checksum(&ip, sizeof(ip)) != 0) {
+        ALOGW("IP header checksum failure (0x%x)", ip.check);
         return -1;
     }
-    /*
-     * Validate the UDP checksum.
-     * Since we don't need the IP header anymore, we "borrow" it
-     * to construct the pseudo header used in the checksum calculation.
-     */
-    dhcp_size = ntohs(packet.udp.len) - sizeof(packet.udp);
+    dhcp_size = ntohs(udp.len) - sizeof(udp);
+    data_size = ntohs(ip.tot_len) - (int)(sizeof(ip) + sizeof(udp));
     /*
      * check validity of dhcp_size.
      * 1) cannot be negative or zero.
@@ -226,30 +192,23 @@ int receive_packet(int s, struct dhcp_msg *msg)
      */
     if ((dhcp_size <= 0) ||
         ((int)(nread - sizeof(struct iphdr) - sizeof(struct udphdr)) < dhcp_size) ||
-        ((int)sizeof(struct dhcp_msg) < dhcp_size)) {
+        ((int)sizeof(struct dhcp_msg) < dhcp_size) || data_size < 0) {
 #if VERBOSE
         ALOGD("Malformed Packet");
 #endif
         return -1;
     }
-    saddr = packet.ip.saddr;
-    daddr = packet.ip.daddr;
-    nread = ntohs(packet.ip.tot_len);
-    memset(&packet.ip, 0, sizeof(packet.ip));
-    packet.ip.saddr = saddr;
-    packet.ip.daddr = daddr;
-    packet.ip.protocol = IPPROTO_UDP;
-    packet.ip.tot_len = packet.udp.len;
-    temp = packet.udp.check;
-    packet.udp.check = 0;
-    sum = finish_sum(checksum(&packet, nread, 0));
-    packet.udp.check = temp;
+    /* Validate the UDP checksum, over the pseudo header, the udp header and the data. */
+    sum = ipv4_pseudo_header_checksum(&ip, ntohs(udp.len));
+    sum = ip_checksum_add(sum, &udp.source, sizeof(udp.source));
+    sum = ip_checksum_add(sum, &udp.dest, sizeof(udp.dest));
+    sum = ip_checksum_add(sum, &udp.len, sizeof(udp.len));
+    sum = ip_checksum_finish(ip_checksum_add(sum, msg, data_size));
     if (!sum)
-        sum = finish_sum(sum);
-    if (temp != sum) {
-        ALOGW("UDP header checksum failure (0x%x should be 0x%x)", sum, temp);
+        sum = 0xffff;
+    if (udp.check != sum) {
+        ALOGW("UDP header checksum failure (0x%x should be 0x%x)", sum, udp.check);
         return -1;
     }
-    memcpy(msg, &packet.dhcp, dhcp_size);
     return dhcp_size;
 }
@@ -75,6 +75,23 @@ bool packagelist_parse(bool (*callback)(pkg_info* info, void* user_data), void*
 bool packagelist_parse_file(const char* path, bool (*callback)(pkg_info* info, void* user_data),
                             void* user_data);
 
+/**
+ * Looks up the package with the given uid in the given package list, or in the
+ * system's default package list if `path` is NULL. If several packages share the
+ * uid, the first one in the list is returned.
+ * Returns a new `pkg_info*` that the caller owns and should free with
+ * packagelist_free(), or NULL if there is no such package or the list couldn't
+ * be parsed.
+ * The parsed list is kept, and only parsed again once the file changes, so this
+ * is much cheaper than packagelist_parse_file() for repeated lookups.
+ */
+pkg_info* packagelist_find_by_uid(const char* path, uid_t uid);
+
+/**
+ * Same as packagelist_find_by_uid(), but looks the package up by name.
+ */
+pkg_info* packagelist_find_by_name(const char* path, const char* name);
+
 /** Frees the given `pkg_info`. */
 void packagelist_free(pkg_info* info);
 
@@ -23,8 +23,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/limits.h>
+#include <sys/stat.h>
 
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <log/log.h>
 
@@ -98,26 +103,25 @@ static bool parse_line(const char* path, size_t line_number, const char* line, p
   return true;
 }
 
-bool packagelist_parse_file(const char* path, bool (*callback)(pkg_info*, void*), void* user_data) {
-  std::unique_ptr<FILE, decltype(&fclose)> fp(fopen(path, "re"), &fclose);
-  if (!fp) {
-    ALOGE("couldn't open '%s': %s", path, strerror(errno));
-    return false;
-  }
-
+static bool parse_fp(const char* path, FILE* fp, bool (*callback)(pkg_info*, void*),
+                     void* user_data) {
   size_t line_number = 0;
   char* line = nullptr;
   size_t allocated_length = 0;
-  while (getline(&line, &allocated_length, fp.get()) > 0) {
+  while (getline(&line, &allocated_length, fp) > 0) {
     ++line_number;
     std::unique_ptr<pkg_info, decltype(&packagelist_free)> info(
         static_cast<pkg_info*>(calloc(1, sizeof(pkg_info))), &packagelist_free);
     if (!info) {
       ALOGE("%s:%zu: couldn't allocate pkg_info", path, line_number);
+      free(line);
       return false;
     }
 
-    if (!parse_line(path, line_number, line, info.get())) return false;
+    if (!parse_line(path, line_number, line, info.get())) {
+      free(line);
+      return false;
+    }
 
     if (!callback(info.release(), user_data)) break;
   }
@@ -125,10 +129,137 @@ bool packagelist_parse_file(const char* path, bool (*callback)(pkg_info*, void*)
   return true;
 }
 
+bool packagelist_parse_file(const char* path, bool (*callback)(pkg_info*, void*), void* user_data) {
+  std::unique_ptr<FILE, decltype(&fclose)> fp(fopen(path, "re"), &fclose);
+  if (!fp) {
+    ALOGE("couldn't open '%s': %s", path, strerror(errno));
+    return false;
+  }
+  return parse_fp(path, fp.get(), callback, user_data);
+}
+
 bool packagelist_parse(bool (*callback)(pkg_info*, void*), void* user_data) {
   return packagelist_parse_file("/data/system/packages.list", callback, user_data);
 }
 
+namespace {
+
+using PkgInfoPtr = std::unique_ptr<pkg_info, decltype(&packagelist_free)>;
+
+// The last package list parsed by the packagelist_find_by_* functions. It is
+// parsed again when the file is replaced (as PackageManager does) or written.
+struct ParsedPackageList {
+  std::string path;
+  dev_t dev = 0;
+  ino_t ino = 0;
+  off_t size = 0;
+  struct timespec mtime = {};
+  struct timespec ctime = {};
+
+  std::vector<PkgInfoPtr> packages;
+  std::unordered_map<uid_t, size_t> by_uid;
+  std::unordered_map<std::string, size_t> by_name;
+};
+
+std::mutex parsed_lock;
+ParsedPackageList* parsed_list = nullptr;
+
+bool same_time(const struct timespec& a, const struct timespec& b) {
+  return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+bool is_current(const ParsedPackageList* list, const char* path, const struct stat& st) {
+  return list != nullptr && list->path == path && list->dev == st.st_dev &&
+         list->ino == st.st_ino && list->size == st.st_size &&
+         same_time(list->mtime, st.st_mtim) && same_time(list->ctime, st.st_ctim);
+}
+
+// Returns the parsed package list at |path|, parsing it first if it changed.
+// Must be called with parsed_lock held.
+const ParsedPackageList* get_parsed_list(const char* path) {
+  if (path == nullptr) path = "/data/system/packages.list";
+
+  std::unique_ptr<FILE, decltype(&fclose)> fp(fopen(path, "re"), &fclose);
+  if (!fp) {
+    ALOGE("couldn't open '%s': %s", path, strerror(errno));
+    return nullptr;
+  }
+  // Stat what is actually read, so a file replaced meanwhile is parsed again next time.
+  struct stat st;
+  if (fstat(fileno(fp.get()), &st) == -1) {
+    ALOGE("couldn't stat '%s': %s", path, strerror(errno));
+    return nullptr;
+  }
+  if (is_current(parsed_list, path, st)) return parsed_list;
+
+  std::unique_ptr<ParsedPackageList> list(new ParsedPackageList);
+  bool parsed = parse_fp(
+      path, fp.get(),
+      [](pkg_info* info, void* user_data) -> bool {
+        auto packages = reinterpret_cast<std::vector<PkgInfoPtr>*>(user_data);
+        packages->emplace_back(info, &packagelist_free);
+        return true;
+      },
+      &list->packages);
+  if (!parsed) return nullptr;
+
+  for (size_t i = 0; i < list->packages.size(); ++i) {
+    // emplace keeps the first package of a shared uid.
+    list->by_uid.emplace(list->packages[i]->uid, i);
+    list->by_name.emplace(list->packages[i]->name, i);
+  }
+  list->path = path;
+  list->dev = st.st_dev;
+  list->ino = st.st_ino;
+  list->size = st.st_size;
+  list->mtime = st.st_mtim;
+  list->ctime = st.st_ctim;
+
+  delete parsed_list;
+  parsed_list = list.release();
+  return parsed_list;
+}
+
+pkg_info* copy_info(const pkg_info* info) {
+  PkgInfoPtr copy(static_cast<pkg_info*>(calloc(1, sizeof(pkg_info))), &packagelist_free);
+  if (!copy) return nullptr;
+
+  copy->uid = info->uid;
+  copy->debuggable = info->debuggable;
+  copy->profileable_from_shell = info->profileable_from_shell;
+  copy->version_code = info->version_code;
+  copy->name = strdup(info->name);
+  copy->data_dir = strdup(info->data_dir);
+  copy->seinfo = strdup(info->seinfo);
+  if (!copy->name || !copy->data_dir || !copy->seinfo) return nullptr;
+  if (info->gids.cnt > 0) {
+    copy->gids.gids = new gid_t[info->gids.cnt];
+    copy->gids.cnt = info->gids.cnt;
+    memcpy(copy->gids.gids, info->gids.gids, info->gids.cnt * sizeof(gid_t));
+  }
+  return copy.release();
+}
+
+}  // namespace
+
+pkg_info* packagelist_find_by_uid(const char* path, uid_t uid) {
+  std::lock_guard<std::mutex> guard(parsed_lock);
+  const ParsedPackageList* list = get_parsed_list(path);
+  if (!list) return nullptr;
+
+  auto it = list->by_uid.find(uid);
+  return it != list->by_uid.end() ? copy_info(list->packages[it->second].get()) : nullptr;
+}
+
+pkg_info* packagelist_find_by_name(const char* path, const char* name) {
+  std::lock_guard<std::mutex> guard(parsed_lock);
+  const ParsedPackageList* list = get_parsed_list(path);
+  if (!list) return nullptr;
+
+  auto it = list->by_name.find(name);
+  return it != list->by_name.end() ? copy_info(list->packages[it->second].get()) : nullptr;
+}
+
 void packagelist_free(pkg_info* info) {
   if (!info) return;
 
@@ -115,6 +115,45 @@ TEST(packagelistparser, early_exit) {
   for (auto& package : packages) packagelist_free(package);
 }
 
+TEST(packagelistparser, find) {
+  TemporaryFile tf;
+  android::base::WriteStringToFile(
+      "com.test.a0 10014 0 /data/user/0/com.test.a0 platform:privapp:targetSdkVersion=19 none\n"
+      "com.test.a1 10007 1 /data/user/0/com.test.a1 platform:privapp:targetSdkVersion=21 1023\n"
+      // Shares its uid with com.test.a1.
+      "com.test.a2 10007 0 /data/user/0/com.test.a2 media:privapp:targetSdkVersion=30 "
+      "2001,1065\n",
+      tf.path);
+
+  std::unique_ptr<pkg_info, decltype(&packagelist_free)> info(
+      packagelist_find_by_uid(tf.path, 10007), &packagelist_free);
+  ASSERT_NE(nullptr, info);
+  ASSERT_STREQ("com.test.a1", info->name);
+  ASSERT_TRUE(info->debuggable);
+  ASSERT_EQ(1U, info->gids.cnt);
+  ASSERT_EQ(1023U, info->gids.gids[0]);
+
+  info.reset(packagelist_find_by_name(tf.path, "com.test.a2"));
+  ASSERT_NE(nullptr, info);
+  ASSERT_EQ(10007, info->uid);
+  ASSERT_STREQ("/data/user/0/com.test.a2", info->data_dir);
+  ASSERT_STREQ("media:privapp:targetSdkVersion=30", info->seinfo);
+  ASSERT_EQ(2U, info->gids.cnt);
+  ASSERT_EQ(2001U, info->gids.gids[0]);
+  ASSERT_EQ(1065U, info->gids.gids[1]);
+
+  ASSERT_EQ(nullptr, packagelist_find_by_uid(tf.path, 10099));
+  ASSERT_EQ(nullptr, packagelist_find_by_name(tf.path, "com.test.missing"));
+
+  // Changes to the file are picked up.
+  android::base::WriteStringToFile("com.test.b0 10099 0 /data/user/0/com.test.b0 selabel none\n",
+                                   tf.path);
+  info.reset(packagelist_find_by_uid(tf.path, 10099));
+  ASSERT_NE(nullptr, info);
+  ASSERT_STREQ("com.test.b0", info->name);
+  ASSERT_EQ(nullptr, packagelist_find_by_name(tf.path, "com.test.a0"));
+}
+
 TEST(packagelistparser, system_package_list) {
   // Check that we can actually read the packages.list installed on the device.
   std::vector<pkg_info*> packages;
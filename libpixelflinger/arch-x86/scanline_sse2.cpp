@@ -0,0 +1,155 @@
+/* libs/pixelflinger/arch-x86/scanline_sse2.cpp
+**
+** Copyright 2019, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+/*
+ * SSE2 versions of the scanline shortcuts that have hand-written assembly
+ * on ARM and MIPS. x86 has no code generator, so without these every pixel
+ * goes through the C loops in scanline.cpp.
+ *
+ * They produce exactly the same pixels as those C loops: all of the
+ * arithmetic is done in 16-bit lanes, which truncate like the uint16_t
+ * casts there, and 8 pixels are processed at a time, with the remainder
+ * done one pixel at a time.
+ */
+
+#include <emmintrin.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace {
+
+inline uint16_t blend_pixel(uint32_t s, uint16_t d)
+{
+    int sA = (s>>24);
+    int f = 0x100 - (sA + (sA>>7));
+    int sR = (s >> (   3))&0x1F;
+    int sG = (s >> ( 8+2))&0x3F;
+    int sB = (s >> (16+3))&0x1F;
+    int dR = (d>>11)&0x1f;
+    int dG = (d>>5)&0x3f;
+    int dB = (d)&0x1f;
+    sR += (f*dR)>>8;
+    sG += (f*dG)>>8;
+    sB += (f*dB)>>8;
+    return uint16_t((sR<<11)|(sG<<5)|sB);
+}
+
+// Packs the low 16 bits of each 32-bit lane of lo and hi into 8 16-bit lanes.
+inline __m128i pack_lo16(__m128i lo, __m128i hi)
+{
+    // _mm_packs_epi32 saturates, so sign-extend the low halves first.
+    lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+    hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+    return _mm_packs_epi32(lo, hi);
+}
+
+// Extracts the 16-bit lanes (s >> shift) & mask of 8 abgr8888 pixels.
+inline __m128i extract8888(__m128i lo, __m128i hi, int shift, int mask)
+{
+    const __m128i m = _mm_set1_epi32(mask);
+    lo = _mm_and_si128(_mm_srl_epi32(lo, _mm_cvtsi32_si128(shift)), m);
+    hi = _mm_and_si128(_mm_srl_epi32(hi, _mm_cvtsi32_si128(shift)), m);
+    return _mm_packs_epi32(lo, hi);
+}
+
+// Blends the rgb565 pixels d with the 5/6/5-bit source components and
+// 1-srcA factors f, all in 16-bit lanes.
+inline __m128i blend8(__m128i sR, __m128i sG, __m128i sB, __m128i f, __m128i d)
+{
+    const __m128i mask5 = _mm_set1_epi16(0x1f);
+    const __m128i mask6 = _mm_set1_epi16(0x3f);
+    __m128i dR = _mm_and_si128(_mm_srli_epi16(d, 11), mask5);
+    __m128i dG = _mm_and_si128(_mm_srli_epi16(d, 5), mask6);
+    __m128i dB = _mm_and_si128(d, mask5);
+    // f <= 0x100 and the components are < 0x40, so the products fit.
+    sR = _mm_add_epi16(sR, _mm_srli_epi16(_mm_mullo_epi16(f, dR), 8));
+    sG = _mm_add_epi16(sG, _mm_srli_epi16(_mm_mullo_epi16(f, dG), 8));
+    sB = _mm_add_epi16(sB, _mm_srli_epi16(_mm_mullo_epi16(f, dB), 8));
+    return _mm_or_si128(_mm_or_si128(_mm_slli_epi16(sR, 11), _mm_slli_epi16(sG, 5)), sB);
+}
+
+}  // namespace
+
+extern "C" void scanline_t32cb16blend_sse2(uint16_t* dst, uint32_t* src, size_t ct)
+{
+    const __m128i one = _mm_set1_epi16(0x100);
+    while (ct >= 8) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+
+        __m128i sA = _mm_packs_epi32(_mm_srli_epi32(lo, 24), _mm_srli_epi32(hi, 24));
+        __m128i f = _mm_sub_epi16(one, _mm_add_epi16(sA, _mm_srli_epi16(sA, 7)));
+        __m128i sR = extract8888(lo, hi, 3, 0x1f);
+        __m128i sG = extract8888(lo, hi, 8+2, 0x3f);
+        __m128i sB = extract8888(lo, hi, 16+3, 0x1f);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), blend8(sR, sG, sB, f, d));
+        src += 8;
+        dst += 8;
+        ct -= 8;
+    }
+    while (ct--) {
+        *dst = blend_pixel(*src++, *dst);
+        dst++;
+    }
+}
+
+extern "C" void scanline_col32cb16blend_sse2(uint16_t* dst, uint32_t s, size_t ct)
+{
+    int sA = (s>>24);
+    const __m128i f = _mm_set1_epi16(static_cast<int16_t>(0x100 - (sA + (sA>>7))));
+    const __m128i sR = _mm_set1_epi16(static_cast<int16_t>((s >> (   3))&0x1F));
+    const __m128i sG = _mm_set1_epi16(static_cast<int16_t>((s >> ( 8+2))&0x3F));
+    const __m128i sB = _mm_set1_epi16(static_cast<int16_t>((s >> (16+3))&0x1F));
+    while (ct >= 8) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), blend8(sR, sG, sB, f, d));
+        dst += 8;
+        ct -= 8;
+    }
+    while (ct--) {
+        *dst = blend_pixel(s, *dst);
+        dst++;
+    }
+}
+
+extern "C" void scanline_t32cb16_sse2(uint16_t* dst, uint32_t* src, size_t ct)
+{
+    const __m128i maskR = _mm_set1_epi32(0xf800);
+    const __m128i maskG = _mm_set1_epi32(0x07e0);
+    const __m128i maskB = _mm_set1_epi32(0x001f);
+    while (ct >= 8) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4));
+        // Same as convertAbgr8888ToRgb565(), 4 pixels at a time.
+        lo = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_slli_epi32(lo, 8), maskR),
+                                       _mm_and_si128(_mm_srli_epi32(lo, 5), maskG)),
+                          _mm_and_si128(_mm_srli_epi32(lo, 19), maskB));
+        hi = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_slli_epi32(hi, 8), maskR),
+                                       _mm_and_si128(_mm_srli_epi32(hi, 5), maskG)),
+                          _mm_and_si128(_mm_srli_epi32(hi, 19), maskB));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), pack_lo16(lo, hi));
+        src += 8;
+        dst += 8;
+        ct -= 8;
+    }
+    while (ct--) {
+        uint32_t s = *src++;
+        *dst++ = uint16_t(((s << 8) & 0xf800) | ((s >> 5) & 0x07e0) | ((s >> 19) & 0x001f));
+    }
+}
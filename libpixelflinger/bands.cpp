@@ -0,0 +1,169 @@
+/* libs/pixelflinger/bands.cpp
+**
+** Copyright 2019, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bands.h"
+
+namespace android {
+
+// ----------------------------------------------------------------------------
+
+// Below this, waking up the workers costs more than they save.
+static const size_t kMinBandBytes = 256 * 1024;
+
+// The most worker threads that can be asked for.
+static const size_t kMaxBandThreads = 8;
+
+class BandWorkers {
+public:
+    ~BandWorkers() { stop(); }
+
+    void setThreads(size_t count) {
+        std::lock_guard<std::mutex> runLock(mRunLock);
+        stop();
+        mStopping = false;
+        for (size_t i = 0; i < count && i < kMaxBandThreads; i++) {
+            mThreads.emplace_back([this]() { loop(); });
+        }
+    }
+
+    void run(uint32_t h, size_t bytesPerRow, ggl_band_func_t func, void* cookie) {
+        const size_t bytes = size_t(h) * bytesPerRow;
+        std::unique_lock<std::mutex> runLock(mRunLock, std::try_to_lock);
+        // Another context is already using the workers: don't wait for it.
+        if (!runLock.owns_lock() || mThreads.empty() || bytes < 2 * kMinBandBytes) {
+            func(cookie, 0, h);
+            return;
+        }
+
+        size_t bands = bytes / kMinBandBytes;
+        if (bands > mThreads.size() + 1) bands = mThreads.size() + 1;
+        if (bands > h) bands = h;
+        const Job job = { func, cookie, h, uint32_t(bands) };
+        uint32_t generation;
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            generation = ++mGeneration;
+            mJob = job;
+            mDoneBands = 0;
+            mNextBand.store(uint64_t(generation) << 32, std::memory_order_relaxed);
+        }
+        mWork.notify_all();
+
+        runBands(generation, job);
+
+        std::unique_lock<std::mutex> lock(mLock);
+        mDone.wait(lock, [&]() { return mDoneBands == job.bands; });
+    }
+
+private:
+    struct Job {
+        ggl_band_func_t func;
+        void*           cookie;
+        uint32_t        rows;
+        uint32_t        bands;
+    };
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mStopping = true;
+        }
+        mWork.notify_all();
+        for (auto& thread : mThreads) {
+            thread.join();
+        }
+        mThreads.clear();
+    }
+
+    void loop() {
+        uint32_t generation = 0;
+        std::unique_lock<std::mutex> lock(mLock);
+        while (true) {
+            mWork.wait(lock, [&]() { return mStopping || mGeneration != generation; });
+            if (mStopping) return;
+            generation = mGeneration;
+            const Job job = mJob;
+            lock.unlock();
+            runBands(generation, job);
+            lock.lock();
+        }
+    }
+
+    // Runs bands of the given primitive until there are none left. The next
+    // band is tagged with the generation of its primitive, so that a worker
+    // that only wakes up once that primitive is done doesn't take bands of
+    // the next one.
+    void runBands(uint32_t generation, const Job& job) {
+        uint32_t done = 0;
+        uint64_t next = mNextBand.load(std::memory_order_relaxed);
+        while (uint32_t(next >> 32) == generation && uint32_t(next) < job.bands) {
+            if (!mNextBand.compare_exchange_weak(next, next + 1, std::memory_order_relaxed)) {
+                continue;
+            }
+            const uint32_t band = uint32_t(next);
+            // Spread the remainder over the first bands, so rows are split exactly.
+            const uint32_t y = uint32_t(uint64_t(job.rows) * band / job.bands);
+            const uint32_t end = uint32_t(uint64_t(job.rows) * (band + 1) / job.bands);
+            job.func(job.cookie, y, end - y);
+            done++;
+            next = mNextBand.load(std::memory_order_relaxed);
+        }
+        if (done) {
+            std::lock_guard<std::mutex> lock(mLock);
+            mDoneBands += done;
+            if (mDoneBands == job.bands) {
+                mDone.notify_one();
+            }
+        }
+    }
+
+    // Serializes run() and setThreads().
+    std::mutex                  mRunLock;
+    std::vector<std::thread>    mThreads;
+
+    // Protects the current primitive, and wakes up the workers for it.
+    std::mutex                  mLock;
+    std::condition_variable     mWork;
+    std::condition_variable     mDone;
+    bool                        mStopping = false;
+    uint32_t                    mGeneration = 0;
+    Job                         mJob = {};
+    uint32_t                    mDoneBands = 0;
+    // The generation of the current primitive, and the next band to run.
+    std::atomic<uint64_t>       mNextBand{0};
+};
+
+static BandWorkers gBandWorkers;
+
+void ggl_set_band_threads(size_t count)
+{
+    gBandWorkers.setThreads(count);
+}
+
+void ggl_run_bands(uint32_t h, size_t bytesPerRow, ggl_band_func_t func, void* cookie)
+{
+    gBandWorkers.run(h, bytesPerRow, func, cookie);
+}
+
+// ----------------------------------------------------------------------------
+}; // namespace android
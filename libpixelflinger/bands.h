@@ -0,0 +1,42 @@
+/* libs/pixelflinger/bands.h
+**
+** Copyright 2019, The Android Open Source Project
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**     http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+
+
+#ifndef ANDROID_GGL_BANDS_H
+#define ANDROID_GGL_BANDS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// Processes rows [y, y+h) of a primitive. Must only touch those rows.
+typedef void (*ggl_band_func_t)(void* cookie, uint32_t y, uint32_t h);
+
+// Sets how many worker threads, besides the caller's, primitives can be
+// split across. 0, the default, keeps everything on the caller's thread.
+void ggl_set_band_threads(size_t count);
+
+// Calls func for bands of the h rows of a primitive, in parallel on the
+// worker threads for large enough primitives (by bytesPerRow), and returns
+// once all of them are done. Since each row is only written by one band,
+// the result is the same as a single call for all the rows.
+void ggl_run_bands(uint32_t h, size_t bytesPerRow, ggl_band_func_t func, void* cookie);
+
+}; // namespace android
+
+#endif // ANDROID_GGL_BANDS_H
@@ -17,6 +17,7 @@
 
 #include <cutils/memory.h>
 
+#include "bands.h"
 #include "clear.h"
 #include "buffer.h"
 
@@ -47,13 +48,22 @@ void ggl_init_clear(context_t* c)
 
 // ----------------------------------------------------------------------------
 
-static void memset2d(context_t* c, const surface_t& s, uint32_t packed,
-        uint32_t l, uint32_t t, uint32_t w, uint32_t h)
+struct memset2d_t {
+    uint8_t*    dst;
+    int32_t     stride;
+    uint32_t    size;
+    uint32_t    packed;
+    uint32_t    w;
+};
+
+static void memset2d_rows(void* cookie, uint32_t y, uint32_t h)
 {
-    const uint32_t size = c->formats[s.format].size;
-    const int32_t stride = s.stride * size;
-    uint8_t* dst = (uint8_t*)s.data + (l + t*s.stride)*size;
-    w *= size;
+    const memset2d_t& m = *static_cast<const memset2d_t*>(cookie);
+    const uint32_t size = m.size;
+    const int32_t stride = m.stride;
+    const uint32_t packed = m.packed;
+    uint8_t* dst = m.dst + y*stride;
+    uint32_t w = m.w;
 
     if (ggl_likely(int32_t(w) == stride)) {
         // clear the whole thing in one call
@@ -85,6 +95,18 @@ static void memset2d(context_t* c, const surface_t& s, uint32_t packed,
     }    
 }
 
+static void memset2d(context_t* c, const surface_t& s, uint32_t packed,
+        uint32_t l, uint32_t t, uint32_t w, uint32_t h)
+{
+    memset2d_t m;
+    m.size = c->formats[s.format].size;
+    m.stride = s.stride * m.size;
+    m.dst = (uint8_t*)s.data + (l + t*s.stride)*m.size;
+    m.packed = packed;
+    m.w = w * m.size;
+    ggl_run_bands(h, m.w, memset2d_rows, &m);
+}
+
 static inline GGLfixed fixedToZ(GGLfixed z) {
     return GGLfixed(((int64_t(z) << 16) - z) >> 16);
 }
@@ -20,7 +20,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#include <cutils/properties.h>
+#include <android-base/properties.h>
 #include <log/log.h>
 #include <private/pixelflinger/ggl_context.h>
 
@@ -177,9 +177,8 @@ int ARMAssembler::generate(const char* name)
     const char * const format = "generated %s (%d ins) at [%p:%p] in %lld ns\n";
     ALOGI(format, name, int(pc()-base()), base(), pc(), duration);
 
-    char value[PROPERTY_VALUE_MAX];
-    property_get("debug.pf.disasm", value, "0");
-    if (atoi(value) != 0) {
+    static android::base::CachedBoolProperty disasm("debug.pf.disasm");
+    if (disasm.Get(false)) {
         printf(format, name, int(pc()-base()), base(), pc(), duration);
         disassemble(name);
     }
@@ -32,7 +32,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include <cutils/properties.h>
+#include <android-base/properties.h>
 #include <log/log.h>
 #include <private/pixelflinger/ggl_context.h>
 
@@ -318,9 +318,8 @@ int ArmToArm64Assembler::generate(const char* name)
     ALOGI(format, name, int(pc()-base()), base(), pc(), duration);
 
 
-    char value[PROPERTY_VALUE_MAX];
-    property_get("debug.pf.disasm", value, "0");
-    if (atoi(value) != 0)
+    static android::base::CachedBoolProperty disasm("debug.pf.disasm");
+    if (disasm.Get(false))
     {
         printf(format, name, int(pc()-base()), base(), pc(), duration);
         disassemble(name);
@@ -153,7 +153,7 @@ ssize_t Assembly::resize(size_t newSize)
 // ----------------------------------------------------------------------------
 
 CodeCache::CodeCache(size_t size)
-    : mCacheSize(size), mCacheInUse(0)
+    : mCacheSize(size), mCacheInUse(0), mHits(0), mMisses(0), mEvictions(0)
 {
     pthread_mutex_init(&mLock, 0);
 }
@@ -172,6 +172,9 @@ sp<Assembly> CodeCache::lookup(const AssemblyKeyBase& keyBase) const
         const cache_entry_t& e = mCacheData.valueAt(index);
         e.when = mWhen++;
         r = e.entry;
+        mHits++;
+    } else {
+        mMisses++;
     }
     pthread_mutex_unlock(&mLock);
     return r;
@@ -196,6 +199,7 @@ int CodeCache::cache(  const AssemblyKeyBase& keyBase,
         const cache_entry_t& e = mCacheData.valueAt(lru);
         mCacheInUse -= e.entry->size();
         mCacheData.removeItemsAt(lru);
+        mEvictions++;
     }
 
     ssize_t err = mCacheData.add(key_t(keyBase), cache_entry_t(assembly, mWhen));
@@ -212,6 +216,18 @@ int CodeCache::cache(  const AssemblyKeyBase& keyBase,
     return err;
 }
 
+void CodeCache::getStats(Stats* stats) const
+{
+    pthread_mutex_lock(&mLock);
+    stats->hits = mHits;
+    stats->misses = mMisses;
+    stats->evictions = mEvictions;
+    stats->entries = mCacheData.size();
+    stats->bytes = mCacheInUse;
+    stats->capacity = mCacheSize;
+    pthread_mutex_unlock(&mLock);
+}
+
 // ----------------------------------------------------------------------------
 
 }; // namespace android
@@ -89,6 +89,16 @@ public:
     int                 cache(const AssemblyKeyBase& key,
                               const sp<Assembly>& assembly);
 
+    struct Stats {
+        uint32_t    hits;       // lookups that found an assembly
+        uint32_t    misses;     // lookups that didn't
+        uint32_t    evictions;  // assemblies evicted to make room
+        uint32_t    entries;    // assemblies currently cached
+        size_t      bytes;      // size of the assemblies currently cached
+        size_t      capacity;   // maximum size of the cached assemblies
+    };
+    void                getStats(Stats* stats) const;
+
 private:
     // nothing to see here...
     struct cache_entry_t {
@@ -114,6 +124,9 @@ private:
     size_t                              mCacheSize;
     size_t                              mCacheInUse;
     KeyedVector<key_t, cache_entry_t>   mCacheData;
+    mutable uint32_t                    mHits;
+    mutable uint32_t                    mMisses;
+    uint32_t                            mEvictions;
 
     friend int compare_type(
         const key_value_pair_t<key_t, cache_entry_t>&,
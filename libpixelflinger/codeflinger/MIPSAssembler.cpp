@@ -53,7 +53,7 @@
 #include <stdlib.h>
 #include <inttypes.h>
 
-#include <cutils/properties.h>
+#include <android-base/properties.h>
 #include <log/log.h>
 #include <private/pixelflinger/ggl_context.h>
 
@@ -1412,12 +1412,8 @@ int MIPSAssembler::generate(const char* name)
     const char * const format = "generated %s (%d ins) at [%p:%p] in %" PRId64 " ns\n";
     ALOGI(format, name, int(pc()-base()), base(), pc(), duration);
 
-    char value[PROPERTY_VALUE_MAX];
-    value[0] = '\0';
-
-    property_get("debug.pf.disasm", value, "0");
-
-    if (atoi(value) != 0) {
+    static android::base::CachedBoolProperty disasm("debug.pf.disasm");
+    if (disasm.Get(false)) {
         disassemble(name);
     }
 
@@ -315,6 +315,25 @@ extern "C" {
 ssize_t gglInit(GGLContext** context);
 ssize_t gglUninit(GGLContext* context);
 
+// statistics of the code generated for the pixel pipelines, which is
+// shared by all the contexts of a process
+typedef struct {
+    uint32_t    hits;
+    uint32_t    misses;
+    uint32_t    evictions;
+    uint32_t    entries;
+    size_t      bytes;
+    size_t      capacity;
+} GGLCodeCacheStats;
+
+// returns -1 on architectures without a code generator
+ssize_t gglGetCodeCacheStats(GGLCodeCacheStats* stats);
+
+// sets how many worker threads large clears and copies are split across,
+// besides the calling thread. 0, the default, disables them. The output is
+// the same either way.
+ssize_t gglSetBandThreads(GGLint count);
+
 GGLint gglBitBlit(
         GGLContext* c,
         int tmu,
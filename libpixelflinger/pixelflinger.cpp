@@ -25,6 +25,7 @@
 #include <pixelflinger/pixelflinger.h>
 #include <private/pixelflinger/ggl_context.h>
 
+#include "bands.h"
 #include "buffer.h"
 #include "clear.h"
 #include "picker.h"
@@ -834,3 +835,17 @@ ssize_t gglUninit(GGLContext* con)
 	return 0;
 }
 
+ssize_t gglGetCodeCacheStats(GGLCodeCacheStats* stats)
+{
+    return ggl_get_code_cache_stats(stats) ? 0 : -1;
+}
+
+ssize_t gglSetBandThreads(GGLint count)
+{
+    if (count < 0) {
+        return -1;
+    }
+    ggl_set_band_threads(size_t(count));
+    return 0;
+}
+
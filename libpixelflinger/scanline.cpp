@@ -25,6 +25,7 @@
 #include <cutils/memory.h>
 #include <log/log.h>
 
+#include "bands.h"
 #include "buffer.h"
 #include "scanline.h"
 
@@ -136,6 +137,10 @@ extern "C" void scanline_t32cb16blend_mips(uint16_t*, uint32_t*, size_t);
 #elif defined(__mips__) && defined(__LP64__)
 extern "C" void scanline_t32cb16blend_mips64(uint16_t*, uint32_t*, size_t);
 extern "C" void scanline_col32cb16blend_mips64(uint16_t *dst, uint32_t col, size_t ct);
+#elif defined(__i386__) || defined(__x86_64__)
+extern "C" void scanline_t32cb16blend_sse2(uint16_t*, uint32_t*, size_t);
+extern "C" void scanline_t32cb16_sse2(uint16_t *dst, uint32_t *src, size_t ct);
+extern "C" void scanline_col32cb16blend_sse2(uint16_t *dst, uint32_t col, size_t ct);
 #endif
 
 // ----------------------------------------------------------------------------
@@ -305,6 +310,26 @@ public:
 
 // ----------------------------------------------------------------------------
 
+bool ggl_get_code_cache_stats(GGLCodeCacheStats* stats)
+{
+#if ANDROID_ARM_CODEGEN
+    CodeCache::Stats s;
+    gCodeCache.getStats(&s);
+    stats->hits = s.hits;
+    stats->misses = s.misses;
+    stats->evictions = s.evictions;
+    stats->entries = s.entries;
+    stats->bytes = s.bytes;
+    stats->capacity = s.capacity;
+    return true;
+#else
+    memset(stats, 0, sizeof(*stats));
+    return false;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+
 void ggl_init_scanline(context_t* c)
 {
     c->init_y = init_y;
@@ -2107,6 +2132,8 @@ void scanline_col32cb16blend(context_t* c)
     scanline_col32cb16blend_arm64(dst, GGL_RGBA_TO_HOST(c->packed8888), ct);
 #elif ((ANDROID_CODEGEN >= ANDROID_CODEGEN_ASM) && (defined(__mips__) && defined(__LP64__)))
     scanline_col32cb16blend_mips64(dst, GGL_RGBA_TO_HOST(c->packed8888), ct);
+#elif ((ANDROID_CODEGEN >= ANDROID_CODEGEN_ASM) && (defined(__i386__) || defined(__x86_64__)))
+    scanline_col32cb16blend_sse2(dst, GGL_RGBA_TO_HOST(c->packed8888), ct);
 #else
     uint32_t s = GGL_RGBA_TO_HOST(c->packed8888);
     int sA = (s>>24);
@@ -2144,6 +2171,10 @@ void scanline_t32cb16(context_t* c)
     const int32_t u = (c->state.texture[0].shade.is0>>16) + x;
     const int32_t v = (c->state.texture[0].shade.it0>>16) + y;
     uint32_t *src = reinterpret_cast<uint32_t*>(tex->data)+(u+(tex->stride*v));
+
+#if ((ANDROID_CODEGEN >= ANDROID_CODEGEN_ASM) && (defined(__i386__) || defined(__x86_64__)))
+    scanline_t32cb16_sse2(dst, src, ct);
+#else
     uint32_t s, d;
 
     if (ct==1 || uintptr_t(dst)&2) {
@@ -2174,12 +2205,14 @@ last_one:
     if (ct > 0) {
         goto last_one;
     }
+#endif
 }
 
 void scanline_t32cb16blend(context_t* c)
 {
 #if ((ANDROID_CODEGEN >= ANDROID_CODEGEN_ASM) && (defined(__arm__) || defined(__aarch64__) || \
-    (defined(__mips__) && ((!defined(__LP64__) && __mips_isa_rev < 6) || defined(__LP64__)))))
+    (defined(__mips__) && ((!defined(__LP64__) && __mips_isa_rev < 6) || defined(__LP64__))) || \
+    defined(__i386__) || defined(__x86_64__)))
     int32_t x = c->iterators.xl;
     size_t ct = c->iterators.xr - x;
     int32_t y = c->iterators.y;
@@ -2199,6 +2232,8 @@ void scanline_t32cb16blend(context_t* c)
     scanline_t32cb16blend_mips(dst, src, ct);
 #elif defined(__mips__) && defined(__LP64__)
     scanline_t32cb16blend_mips64(dst, src, ct);
+#elif defined(__i386__) || defined(__x86_64__)
+    scanline_t32cb16blend_sse2(dst, src, ct);
 #endif
 #else
     dst_iterator16  di(c);
@@ -2339,6 +2374,30 @@ void rect_generic(context_t* c, size_t yc)
     } while (--yc);
 }
 
+struct rect_memcpy_t {
+    uint8_t*        dst;
+    const uint8_t*  src;
+    size_t          size;
+    size_t          dbpr;
+    size_t          sbpr;
+};
+
+static void rect_memcpy_rows(void* cookie, uint32_t y, uint32_t yc)
+{
+    const rect_memcpy_t& m = *static_cast<const rect_memcpy_t*>(cookie);
+    uint8_t* dst = m.dst + y * m.dbpr;
+    const uint8_t* src = m.src + y * m.sbpr;
+    if (m.dbpr == m.sbpr && m.size == m.dbpr) {
+        memcpy(dst, src, m.size * yc);
+    } else {
+        do {
+            memcpy(dst, src, m.size);
+            dst += m.dbpr;
+            src += m.sbpr;
+        } while (--yc);
+    }
+}
+
 void rect_memcpy(context_t* c, size_t yc)
 {
     int32_t x = c->iterators.xl;
@@ -2355,18 +2414,13 @@ void rect_memcpy(context_t* c, size_t yc)
     uint8_t *src = reinterpret_cast<uint8_t*>(tex->data) +
                             (u + (tex->stride * v)) * fp->size;
 
-    if (cb->stride == tex->stride && ct == size_t(cb->stride)) {
-        memcpy(dst, src, ct * fp->size * yc);
-    } else {
-        const size_t size = ct * fp->size;
-        const size_t dbpr = cb->stride  * fp->size;
-        const size_t sbpr = tex->stride * fp->size;
-        do {
-            memcpy(dst, src, size);
-            dst += dbpr;
-            src += sbpr;        
-        } while (--yc);
-    }
+    rect_memcpy_t m;
+    m.dst = dst;
+    m.src = src;
+    m.size = ct * fp->size;
+    m.dbpr = cb->stride  * fp->size;
+    m.sbpr = tex->stride * fp->size;
+    ggl_run_bands(yc, m.size, rect_memcpy_rows, &m);
 }
 // ----------------------------------------------------------------------------
 }; // namespace android
@@ -26,6 +26,7 @@ namespace android {
 void ggl_init_scanline(context_t* c);
 void ggl_uninit_scanline(context_t* c);
 void ggl_pick_scanline(context_t* c);
+bool ggl_get_code_cache_stats(GGLCodeCacheStats* stats);
 
 }; // namespace android
 
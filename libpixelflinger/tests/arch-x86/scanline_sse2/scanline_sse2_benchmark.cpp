@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+extern "C" void scanline_t32cb16blend_sse2(uint16_t*, uint32_t*, size_t);
+extern "C" void scanline_t32cb16_sse2(uint16_t* dst, uint32_t* src, size_t ct);
+extern "C" void scanline_col32cb16blend_sse2(uint16_t* dst, uint32_t col, size_t ct);
+
+// The per-pixel blend that scanline.cpp does without the SSE2 versions.
+static void scanline_t32cb16blend_c(uint16_t* dst, uint32_t* src, size_t ct) {
+    while (ct--) {
+        uint32_t s = *src++;
+        uint16_t d = *dst;
+        int sA = (s >> 24);
+        int f = 0x100 - (sA + (sA >> 7));
+        int sR = ((s >> (3)) & 0x1F) + ((f * ((d >> 11) & 0x1f)) >> 8);
+        int sG = ((s >> (8 + 2)) & 0x3F) + ((f * ((d >> 5) & 0x3f)) >> 8);
+        int sB = ((s >> (16 + 3)) & 0x1F) + ((f * (d & 0x1f)) >> 8);
+        *dst++ = uint16_t((sR << 11) | (sG << 5) | sB);
+    }
+}
+
+// A scanline of a 1080p framebuffer.
+static const size_t kWidth = 1920;
+
+static void BM_t32cb16blend_c(benchmark::State& state) {
+    std::vector<uint32_t> src(kWidth, 0x80402010);
+    std::vector<uint16_t> dst(kWidth, 0x1234);
+    for (auto _ : state) {
+        scanline_t32cb16blend_c(dst.data(), src.data(), kWidth);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kWidth);
+}
+BENCHMARK(BM_t32cb16blend_c);
+
+static void BM_t32cb16blend_sse2(benchmark::State& state) {
+    std::vector<uint32_t> src(kWidth, 0x80402010);
+    std::vector<uint16_t> dst(kWidth, 0x1234);
+    for (auto _ : state) {
+        scanline_t32cb16blend_sse2(dst.data(), src.data(), kWidth);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kWidth);
+}
+BENCHMARK(BM_t32cb16blend_sse2);
+
+static void BM_col32cb16blend_sse2(benchmark::State& state) {
+    std::vector<uint16_t> dst(kWidth, 0x1234);
+    for (auto _ : state) {
+        scanline_col32cb16blend_sse2(dst.data(), 0x80402010, kWidth);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kWidth);
+}
+BENCHMARK(BM_col32cb16blend_sse2);
+
+static void BM_t32cb16_sse2(benchmark::State& state) {
+    std::vector<uint32_t> src(kWidth, 0xff402010);
+    std::vector<uint16_t> dst(kWidth);
+    for (auto _ : state) {
+        scanline_t32cb16_sse2(dst.data(), src.data(), kWidth);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kWidth);
+}
+BENCHMARK(BM_t32cb16_sse2);
+
+BENCHMARK_MAIN();
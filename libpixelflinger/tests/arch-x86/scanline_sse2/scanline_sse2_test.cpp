@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" void scanline_t32cb16blend_sse2(uint16_t*, uint32_t*, size_t);
+extern "C" void scanline_t32cb16_sse2(uint16_t* dst, uint32_t* src, size_t ct);
+extern "C" void scanline_col32cb16blend_sse2(uint16_t* dst, uint32_t col, size_t ct);
+
+// The C loops of scanline.cpp that the SSE2 versions replace.
+static uint16_t convertAbgr8888ToRgb565(uint32_t pix) {
+    return uint16_t(((pix << 8) & 0xf800) | ((pix >> 5) & 0x07e0) | ((pix >> 19) & 0x001f));
+}
+
+static uint16_t blend_c(uint32_t s, uint16_t d) {
+    int sA = (s >> 24);
+    int f = 0x100 - (sA + (sA >> 7));
+    int sR = (s >> (3)) & 0x1F;
+    int sG = (s >> (8 + 2)) & 0x3F;
+    int sB = (s >> (16 + 3)) & 0x1F;
+    int dR = (d >> 11) & 0x1f;
+    int dG = (d >> 5) & 0x3f;
+    int dB = (d)&0x1f;
+    sR += (f * dR) >> 8;
+    sG += (f * dG) >> 8;
+    sB += (f * dB) >> 8;
+    return uint16_t((sR << 11) | (sG << 5) | sB);
+}
+
+static void scanline_t32cb16blend_c(uint16_t* dst, uint32_t* src, size_t ct) {
+    while (ct--) {
+        uint32_t s = *src++;
+        if (s == 0) {
+            // Transparent pixels are skipped.
+        } else if ((s >> 24) == 0xff) {
+            *dst = convertAbgr8888ToRgb565(s);
+        } else {
+            *dst = blend_c(s, *dst);
+        }
+        dst++;
+    }
+}
+
+static void scanline_col32cb16blend_c(uint16_t* dst, uint32_t col, size_t ct) {
+    while (ct--) {
+        *dst = blend_c(col, *dst);
+        dst++;
+    }
+}
+
+static void scanline_t32cb16_c(uint16_t* dst, uint32_t* src, size_t ct) {
+    while (ct--) {
+        *dst++ = convertAbgr8888ToRgb565(*src++);
+    }
+}
+
+static uint32_t random_pixel() {
+    uint32_t pixel = (uint32_t(rand()) << 16) ^ uint32_t(rand());
+    // Make sure the shortcuts for transparent and opaque pixels are hit.
+    switch (rand() % 4) {
+        case 0: return 0;
+        case 1: return pixel | 0xff000000;
+        default: return pixel;
+    }
+}
+
+static const size_t kMaxCount = 67;
+
+int main() {
+    int failures = 0;
+    srand(1);
+
+    // Cover every remainder after the 8-pixel blocks, and unaligned destinations.
+    for (size_t count = 0; count <= kMaxCount; ++count) {
+        for (size_t offset = 0; offset < 4; ++offset) {
+            uint32_t src[kMaxCount];
+            uint16_t dst_c[kMaxCount + 4], dst_sse2[kMaxCount + 4];
+            for (size_t i = 0; i < kMaxCount; ++i) {
+                src[i] = random_pixel();
+            }
+            for (size_t i = 0; i < kMaxCount + 4; ++i) {
+                dst_c[i] = dst_sse2[i] = uint16_t(rand());
+            }
+
+            scanline_t32cb16blend_c(dst_c + offset, src, count);
+            scanline_t32cb16blend_sse2(dst_sse2 + offset, src, count);
+            if (memcmp(dst_c, dst_sse2, sizeof(dst_c)) != 0) {
+                printf("scanline_t32cb16blend: count %zu offset %zu: Failed\n", count, offset);
+                failures++;
+            }
+
+            scanline_col32cb16blend_c(dst_c + offset, src[0], count);
+            scanline_col32cb16blend_sse2(dst_sse2 + offset, src[0], count);
+            if (memcmp(dst_c, dst_sse2, sizeof(dst_c)) != 0) {
+                printf("scanline_col32cb16blend: count %zu offset %zu: Failed\n", count, offset);
+                failures++;
+            }
+
+            scanline_t32cb16_c(dst_c + offset, src, count);
+            scanline_t32cb16_sse2(dst_sse2 + offset, src, count);
+            if (memcmp(dst_c, dst_sse2, sizeof(dst_c)) != 0) {
+                printf("scanline_t32cb16: count %zu offset %zu: Failed\n", count, offset);
+                failures++;
+            }
+        }
+    }
+
+    printf("%s\n", failures ? "Failed" : "Passed");
+    return failures ? 1 : 0;
+}
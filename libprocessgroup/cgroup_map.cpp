@@ -28,7 +28,7 @@
 #include <time.h>
 #include <unistd.h>
 
-#include <regex>
+#include <string_view>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -86,12 +86,19 @@ std::string CgroupController::GetTasksFilePath(const std::string& rel_path) cons
     return (version() == 1) ? tasks_path + CGROUP_TASKS_FILE : tasks_path + CGROUP_TASKS_FILE_V2;
 }
 
+static void ReplaceAll(std::string* str, std::string_view from, const std::string& to) {
+    for (size_t pos = 0; (pos = str->find(from.data(), pos, from.size())) != std::string::npos;
+         pos += to.size()) {
+        str->replace(pos, from.size(), to);
+    }
+}
+
 std::string CgroupController::GetProcsFilePath(const std::string& rel_path, uid_t uid,
                                                pid_t pid) const {
     std::string proc_path(path());
     proc_path.append("/").append(rel_path);
-    proc_path = regex_replace(proc_path, std::regex("<uid>"), std::to_string(uid));
-    proc_path = regex_replace(proc_path, std::regex("<pid>"), std::to_string(pid));
+    ReplaceAll(&proc_path, "<uid>", std::to_string(uid));
+    ReplaceAll(&proc_path, "<pid>", std::to_string(pid));
 
     return proc_path.append(CGROUP_PROCS_FILE);
 }
@@ -110,7 +117,8 @@ bool CgroupController::GetTaskGroup(int tid, std::string* group) const {
         return true;
     }
 
-    std::string cg_tag = StringPrintf(":%s:", name());
+    std::string cg_tag(":");
+    cg_tag.append(name()).append(":");
     size_t start_pos = content.find(cg_tag);
     if (start_pos == std::string::npos) {
         return false;
@@ -119,9 +127,9 @@ bool CgroupController::GetTaskGroup(int tid, std::string* group) const {
     start_pos += cg_tag.length() + 1;  // skip '/'
     size_t end_pos = content.find('\n', start_pos);
     if (end_pos == std::string::npos) {
-        *group = content.substr(start_pos, std::string::npos);
+        group->assign(content, start_pos, std::string::npos);
     } else {
-        *group = content.substr(start_pos, end_pos - start_pos);
+        group->assign(content, start_pos, end_pos - start_pos);
     }
 
     return true;
@@ -143,6 +151,13 @@ CgroupMap& CgroupMap::GetInstance() {
 bool CgroupMap::LoadRcFile() {
     if (!loaded_) {
         loaded_ = (ACgroupFile_getVersion() != 0);
+        if (loaded_) {
+            auto controller_count = ACgroupFile_getControllerCount();
+            usable_.reset(new std::atomic<bool>[controller_count]);
+            for (uint32_t i = 0; i < controller_count; ++i) {
+                usable_[i] = false;
+            }
+        }
     }
     return loaded_;
 }
@@ -178,7 +193,15 @@ CgroupController CgroupMap::FindController(const std::string& name) const {
     for (uint32_t i = 0; i < controller_count; ++i) {
         const ACgroupController* controller = ACgroupFile_getController(i);
         if (name == ACgroupController_getName(controller)) {
-            return CgroupController(controller);
+            // Spare callers such as get_sched_policy() an access() call per lookup
+            if (usable_[i]) {
+                return CgroupController(controller, CgroupController::USABLE);
+            }
+            CgroupController result(controller);
+            if (result.IsUsable()) {
+                usable_[i] = true;
+            }
+            return result;
         }
     }
 
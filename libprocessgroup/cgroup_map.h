@@ -19,6 +19,7 @@
 #include <sys/cdefs.h>
 #include <sys/types.h>
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -51,8 +52,14 @@ class CgroupController {
         MISSING = 2,
     };
 
+    // Used by CgroupMap for controllers already known to be usable
+    CgroupController(const ACgroupController* controller, ControllerState state)
+        : controller_(controller), state_(state) {}
+
     const ACgroupController* controller_ = nullptr;
     ControllerState state_;
+
+    friend class CgroupMap;
 };
 
 class CgroupMap {
@@ -65,6 +72,9 @@ class CgroupMap {
 
   private:
     bool loaded_ = false;
+    // Controllers found usable so far, indexed like the rc file controllers. Only positive
+    // results are cached since a controller can be mounted after it was first looked up.
+    std::unique_ptr<std::atomic<bool>[]> usable_;
     CgroupMap();
     bool LoadRcFile();
     void Print() const;
@@ -18,6 +18,7 @@
 
 #include <sys/cdefs.h>
 #include <sys/types.h>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -30,6 +31,11 @@ bool CgroupGetAttributePath(const std::string& attr_name, std::string* path);
 bool CgroupGetAttributePathForTask(const std::string& attr_name, int tid, std::string* path);
 
 bool SetTaskProfiles(int tid, const std::vector<std::string>& profiles, bool use_fd_cache = false);
+// Same as SetTaskProfiles() for a group of threads, e.g. all threads of a process. Each
+// profile action is applied to all of them at once, so a cgroup tasks file is opened or
+// locked once per batch rather than once per thread.
+bool SetTaskProfilesBatch(const std::vector<int>& tids, const std::vector<std::string>& profiles,
+                          bool use_fd_cache = false);
 bool SetProcessProfiles(uid_t uid, pid_t pid, const std::vector<std::string>& profiles,
                         bool use_fd_cache = false);
 
@@ -46,13 +52,20 @@ void DropTaskProfilesResourceCaching();
 
 // Return 0 and removes the cgroup if there are no longer any processes in it.
 // Returns -1 in the case of an error occurring or if there are processes still running
-// even after retrying for up to 200ms.
+// even after retrying for up to 200ms. Where the kernel supports pidfds the exits are waited
+// for directly instead of polling cgroup.procs.
 int killProcessGroup(uid_t uid, int initialPid, int signal);
 
 // Returns the same as killProcessGroup(), however it does not retry, which means
 // that it only returns 0 in the case that the cgroup exists and it contains no processes.
 int killProcessGroupOnce(uid_t uid, int initialPid, int signal);
 
+// Same as killProcessGroup(), but returns immediately. The process group is killed on a
+// background thread, which then calls 'callback', if set, with the killProcessGroup() result.
+// Requests are served in the order they were made.
+void killProcessGroupAsync(uid_t uid, int initialPid, int signal,
+                           std::function<void(int)> callback = nullptr);
+
 int createProcessGroup(uid_t uid, int initialPid, bool memControl = false);
 
 // Set various properties of a process group. For these functions to work, the process group must
@@ -22,26 +22,34 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <set>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <cutils/android_filesystem_config.h>
 #include <processgroup/processgroup.h>
 #include <task_profiles.h>
@@ -49,12 +57,17 @@
 using android::base::GetBoolProperty;
 using android::base::StartsWith;
 using android::base::StringPrintf;
+using android::base::unique_fd;
 using android::base::WriteStringToFile;
 
 using namespace std::chrono_literals;
 
 #define PROCESSGROUP_CGROUP_PROCS_FILE "/cgroup.procs"
 
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
+
 bool CgroupGetControllerPath(const std::string& cgroup_name, std::string* path) {
     auto controller = CgroupMap::GetInstance().FindController(cgroup_name);
 
@@ -156,6 +169,27 @@ bool SetTaskProfiles(int tid, const std::vector<std::string>& profiles, bool use
     return true;
 }
 
+bool SetTaskProfilesBatch(const std::vector<int>& tids, const std::vector<std::string>& profiles,
+                          bool use_fd_cache) {
+    const TaskProfiles& tp = TaskProfiles::GetInstance();
+
+    for (const auto& name : profiles) {
+        TaskProfile* profile = tp.GetProfile(name);
+        if (profile != nullptr) {
+            if (use_fd_cache) {
+                profile->EnableResourceCaching();
+            }
+            if (!profile->ExecuteForTasks(tids)) {
+                PLOG(WARNING) << "Failed to apply " << name << " task profile";
+            }
+        } else {
+            PLOG(WARNING) << "Failed to find " << name << "task profile";
+        }
+    }
+
+    return true;
+}
+
 static std::string ConvertUidToPath(const char* cgroup, uid_t uid) {
     return StringPrintf("%s/uid_%d", cgroup, uid);
 }
@@ -263,7 +297,9 @@ static bool MkdirAndChown(const std::string& path, mode_t mode, uid_t uid, gid_t
 // Returns number of processes killed on success
 // Returns 0 if there are no processes in the process cgroup left to kill
 // Returns -1 on error
-static int DoKillProcessGroupOnce(const char* cgroup, uid_t uid, int initialPid, int signal) {
+// If 'killed' is not null it is set to the pids that were signalled.
+static int DoKillProcessGroupOnce(const char* cgroup, uid_t uid, int initialPid, int signal,
+                                  std::vector<pid_t>* killed = nullptr) {
     auto path = ConvertUidPidToPath(cgroup, uid, initialPid) + PROCESSGROUP_CGROUP_PROCS_FILE;
     std::unique_ptr<FILE, decltype(&fclose)> fd(fopen(path.c_str(), "re"), fclose);
     if (!fd) {
@@ -291,6 +327,7 @@ static int DoKillProcessGroupOnce(const char* cgroup, uid_t uid, int initialPid,
             LOG(WARNING) << "Yikes, we've been told to kill pid 0!  How about we don't do that?";
             continue;
         }
+        if (killed) killed->push_back(pid);
         pid_t pgid = getpgid(pid);
         if (pgid == -1) PLOG(ERROR) << "getpgid(" << pid << ") failed";
         if (pgid == pid) {
@@ -333,6 +370,56 @@ static int DoKillProcessGroupOnce(const char* cgroup, uid_t uid, int initialPid,
     return feof(fd.get()) ? processes : -1;
 }
 
+// Waits until all of 'pids' have exited or until 'deadline'. A process leaves its cgroup before
+// its pidfd becomes readable, so cgroup.procs only has to be read again once this returns.
+// Returns false if pidfds are not supported by the kernel, in which case the caller has to poll.
+static bool WaitForProcessesToExit(const std::vector<pid_t>& pids,
+                                   std::chrono::steady_clock::time_point deadline) {
+    std::vector<unique_fd> pidfds;
+    std::vector<pollfd> fds;
+
+    for (const auto pid : pids) {
+        unique_fd pidfd(syscall(__NR_pidfd_open, pid, 0));
+        if (pidfd == -1) {
+            if (errno == ESRCH) {
+                // Already gone
+                continue;
+            }
+            if (errno != ENOSYS) {
+                PLOG(WARNING) << "pidfd_open(" << pid << ") failed";
+            }
+            return false;
+        }
+        fds.push_back({pidfd.get(), POLLIN, 0});
+        pidfds.push_back(std::move(pidfd));
+    }
+
+    while (!fds.empty()) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            break;
+        }
+        auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+        int ret = TEMP_FAILURE_RETRY(poll(fds.data(), fds.size(), timeout.count() + 1));
+        if (ret <= 0) {
+            if (ret < 0) PLOG(WARNING) << "poll on pidfds failed";
+            break;
+        }
+
+        // Drop the processes that exited.
+        for (size_t i = 0; i < fds.size();) {
+            if (fds[i].revents) {
+                fds[i] = fds.back();
+                fds.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+
+    return true;
+}
+
 static int KillProcessGroup(uid_t uid, int initialPid, int signal, int retries) {
     std::string cpuacct_path;
     std::string memory_path;
@@ -347,13 +434,19 @@ static int KillProcessGroup(uid_t uid, int initialPid, int signal, int retries)
                     : memory_path.c_str();
 
     std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point deadline = start + retries * 5ms;
 
     int retry = retries;
     int processes;
-    while ((processes = DoKillProcessGroupOnce(cgroup, uid, initialPid, signal)) > 0) {
+    std::vector<pid_t> killed;
+    while ((processes = DoKillProcessGroupOnce(cgroup, uid, initialPid, signal, &killed)) > 0) {
         LOG(VERBOSE) << "Killed " << processes << " processes for processgroup " << initialPid;
-        if (retry > 0) {
-            std::this_thread::sleep_for(5ms);
+        if (retry > 0 && std::chrono::steady_clock::now() < deadline) {
+            // Sleep only if the exits can't be waited for.
+            if (!WaitForProcessesToExit(killed, deadline)) {
+                std::this_thread::sleep_for(5ms);
+            }
+            killed.clear();
             --retry;
         } else {
             break;
@@ -399,6 +492,60 @@ int killProcessGroupOnce(uid_t uid, int initialPid, int signal) {
     return KillProcessGroup(uid, initialPid, signal, 0 /*retries*/);
 }
 
+namespace {
+
+struct KillRequest {
+    uid_t uid;
+    int initialPid;
+    int signal;
+    std::function<void(int)> callback;
+};
+
+// Requests of killProcessGroupAsync(), served in order by a single thread.
+class KillQueue {
+  public:
+    static KillQueue& GetInstance() {
+        static auto* instance = new KillQueue;
+        return *instance;
+    }
+
+    void Push(KillRequest request) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        requests_.push_back(std::move(request));
+        if (!started_) {
+            std::thread(&KillQueue::Run, this).detach();
+            started_ = true;
+        }
+        cv_.notify_one();
+    }
+
+  private:
+    void Run() {
+        while (true) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return !requests_.empty(); });
+            KillRequest request = std::move(requests_.front());
+            requests_.pop_front();
+            lock.unlock();
+
+            int ret = killProcessGroup(request.uid, request.initialPid, request.signal);
+            if (request.callback) request.callback(ret);
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<KillRequest> requests_;
+    bool started_ = false;
+};
+
+}  // namespace
+
+void killProcessGroupAsync(uid_t uid, int initialPid, int signal,
+                           std::function<void(int)> callback) {
+    KillQueue::GetInstance().Push({uid, initialPid, signal, std::move(callback)});
+}
+
 int createProcessGroup(uid_t uid, int initialPid, bool memControl) {
     std::string cgroup;
     if (isMemoryCgroupSupported() && (memControl || UsePerAppMemcg())) {
@@ -408,18 +555,28 @@ int createProcessGroup(uid_t uid, int initialPid, bool memControl) {
         CgroupGetControllerPath("cpuacct", &cgroup);
     }
 
-    auto uid_path = ConvertUidToPath(cgroup.c_str(), uid);
-
-    if (!MkdirAndChown(uid_path, 0750, AID_SYSTEM, AID_SYSTEM)) {
-        PLOG(ERROR) << "Failed to make and chown " << uid_path;
-        return -errno;
-    }
-
     auto uid_pid_path = ConvertUidPidToPath(cgroup.c_str(), uid, initialPid);
 
+    // This is on the app launch path. The uid directory usually exists already, either from
+    // another process of the same uid or from an earlier launch, so only create it when the
+    // pid directory can't be made without it.
     if (!MkdirAndChown(uid_pid_path, 0750, AID_SYSTEM, AID_SYSTEM)) {
-        PLOG(ERROR) << "Failed to make and chown " << uid_pid_path;
-        return -errno;
+        if (errno != ENOENT) {
+            PLOG(ERROR) << "Failed to make and chown " << uid_pid_path;
+            return -errno;
+        }
+
+        auto uid_path = ConvertUidToPath(cgroup.c_str(), uid);
+
+        if (!MkdirAndChown(uid_path, 0750, AID_SYSTEM, AID_SYSTEM)) {
+            PLOG(ERROR) << "Failed to make and chown " << uid_path;
+            return -errno;
+        }
+
+        if (!MkdirAndChown(uid_pid_path, 0750, AID_SYSTEM, AID_SYSTEM)) {
+            PLOG(ERROR) << "Failed to make and chown " << uid_pid_path;
+            return -errno;
+        }
     }
 
     auto uid_pid_procs_file = uid_pid_path + PROCESSGROUP_CGROUP_PROCS_FILE;
@@ -54,11 +54,19 @@ bool ProfileAttribute::GetPathForTask(int tid, std::string* path) const {
         return true;
     }
 
-    if (subgroup.empty()) {
-        *path = StringPrintf("%s/%s", controller()->path(), file_name_.c_str());
-    } else {
-        *path = StringPrintf("%s/%s/%s", controller()->path(), subgroup.c_str(),
-                             file_name_.c_str());
+    path->assign(controller()->path()).append("/");
+    if (!subgroup.empty()) {
+        path->append(subgroup).append("/");
+    }
+    path->append(file_name_);
+    return true;
+}
+
+bool ProfileAction::ExecuteForTasks(const std::vector<int>& tids) const {
+    for (const auto tid : tids) {
+        if (!ExecuteForTask(tid)) {
+            return false;
+        }
     }
     return true;
 }
@@ -268,6 +276,50 @@ bool SetCgroupAction::ExecuteForTask(int tid) const {
     return true;
 }
 
+bool SetCgroupAction::ExecuteForTasks(const std::vector<int>& tids) const {
+    unique_fd fd;
+    {
+        // Only hold the lock to get a private reference to the cached fd, so that a
+        // concurrent DropResourceCaching() can't close it while the tids are written.
+        std::lock_guard<std::mutex> lock(fd_mutex_);
+        if (fd_ == FDS_INACCESSIBLE) {
+            // no permissions to access the file, ignore
+            return true;
+        }
+
+        if (fd_ == FDS_APP_DEPENDENT) {
+            // application-dependent path can't be used with tid
+            PLOG(ERROR) << "Application profile can't be applied to a thread";
+            return false;
+        }
+
+        if (IsFdValid()) {
+            fd.reset(fcntl(fd_, F_DUPFD_CLOEXEC, 0));
+        }
+    }
+
+    if (fd < 0) {
+        // fd is not cached or could not be duplicated, open the file once for all tids
+        std::string tasks_path = controller()->GetTasksFilePath(path_);
+        fd.reset(TEMP_FAILURE_RETRY(open(tasks_path.c_str(), O_WRONLY | O_CLOEXEC)));
+        if (fd < 0) {
+            PLOG(WARNING) << "Failed to open " << tasks_path;
+            return false;
+        }
+    }
+
+    // The tasks file takes one tid per write
+    bool ret = true;
+    for (const auto tid : tids) {
+        if (!AddTidToCgroup(tid, fd)) {
+            LOG(ERROR) << "Failed to add task into cgroup";
+            ret = false;
+        }
+    }
+
+    return ret;
+}
+
 bool TaskProfile::ExecuteForProcess(uid_t uid, pid_t pid) const {
     for (const auto& element : elements_) {
         if (!element->ExecuteForProcess(uid, pid)) {
@@ -289,6 +341,21 @@ bool TaskProfile::ExecuteForTask(int tid) const {
     return true;
 }
 
+bool TaskProfile::ExecuteForTasks(const std::vector<int>& tids) const {
+    std::vector<int> resolved(tids);
+    for (auto& tid : resolved) {
+        if (tid == 0) {
+            tid = GetThreadId();
+        }
+    }
+    for (const auto& element : elements_) {
+        if (!element->ExecuteForTasks(resolved)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void TaskProfile::EnableResourceCaching() {
     if (res_cached_) {
         return;
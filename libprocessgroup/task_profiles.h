@@ -49,6 +49,8 @@ class ProfileAction {
     // Default implementations will fail
     virtual bool ExecuteForProcess(uid_t, pid_t) const { return false; };
     virtual bool ExecuteForTask(int) const { return false; };
+    // Applies the action to all threads, by default one ExecuteForTask() call per thread
+    virtual bool ExecuteForTasks(const std::vector<int>& tids) const;
 
     virtual void EnableResourceCaching() {}
     virtual void DropResourceCaching() {}
@@ -114,6 +116,7 @@ class SetCgroupAction : public ProfileAction {
 
     virtual bool ExecuteForProcess(uid_t uid, pid_t pid) const;
     virtual bool ExecuteForTask(int tid) const;
+    virtual bool ExecuteForTasks(const std::vector<int>& tids) const;
     virtual void EnableResourceCaching();
     virtual void DropResourceCaching();
 
@@ -146,6 +149,7 @@ class TaskProfile {
 
     bool ExecuteForProcess(uid_t uid, pid_t pid) const;
     bool ExecuteForTask(int tid) const;
+    bool ExecuteForTasks(const std::vector<int>& tids) const;
     void EnableResourceCaching();
     void DropResourceCaching();
 
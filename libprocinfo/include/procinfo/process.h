@@ -22,6 +22,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <type_traits>
@@ -62,6 +63,27 @@ bool GetProcessInfo(pid_t tid, ProcessInfo* process_info, std::string* error = n
 // |fd| should be an fd pointing at a /proc/<pid> directory.
 bool GetProcessInfoFromProcPidFd(int fd, ProcessInfo* process_info, std::string* error = nullptr);
 
+// Where the batched readers below take a ProcessInfo from. /proc/<tid>/stat is
+// cheaper for the kernel to generate than /proc/<tid>/status, but it has no
+// tracer, uid or gid: those are set to -1 instead.
+enum ProcessInfoSource {
+  kProcessInfoFromStatus,
+  kProcessInfoFromStat,
+};
+
+// Calls |callback| with the ProcessInfo of each thread of process |pid|.
+// The same directory fd and buffers are used for every thread, and the
+// ProcessInfo passed in is only valid during the call. Threads that exit
+// while being listed are skipped.
+bool GetProcessThreadInfos(pid_t pid, ProcessInfoSource source,
+                           const std::function<void(const ProcessInfo&)>& callback,
+                           std::string* error = nullptr);
+
+// Same thing, for every process of the system (only their main threads).
+bool GetAllProcessInfos(ProcessInfoSource source,
+                        const std::function<void(const ProcessInfo&)>& callback,
+                        std::string* error = nullptr);
+
 // Fetch the list of threads from a given process's /proc/<pid> directory.
 // |fd| should be an fd pointing at a /proc/<pid> directory.
 template <typename Collection>
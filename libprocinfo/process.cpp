@@ -16,14 +16,18 @@
 
 #include <procinfo/process.h>
 
+#include <dirent.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include <functional>
+#include <memory>
 #include <string>
 
+#include <android-base/macros.h>
 #include <android-base/unique_fd.h>
 
 using android::base::unique_fd;
@@ -53,6 +57,8 @@ static ProcessState parse_state(const char* state) {
     case 'S':
       return kProcessStateSleeping;
     case 'D':
+    // Idle kernel threads: an uninterruptible wait that doesn't count towards the load.
+    case 'I':
       return kProcessStateUninterruptibleWait;
     case 'T':
       return kProcessStateStopped;
@@ -64,73 +70,174 @@ static ProcessState parse_state(const char* state) {
   }
 }
 
-bool GetProcessInfoFromProcPidFd(int fd, ProcessInfo* process_info, std::string* error) {
-  int status_fd = openat(fd, "status", O_RDONLY | O_CLOEXEC);
+// Large enough for the fields we use: they are all at the start of the files.
+static constexpr size_t kProcFileBufferSize = 4096;
 
-  if (status_fd == -1) {
-    if (error != nullptr) {
-      *error = "failed to open status fd in GetProcessInfoFromProcPidFd";
-    }
+// Reads the start of |dirfd|/|name| into |buf| as a C string, with a single read.
+static bool ReadProcFile(int dirfd, const char* name, char* buf, size_t size) {
+  unique_fd fd(openat(dirfd, name, O_RDONLY | O_CLOEXEC));
+  if (fd == -1) {
     return false;
   }
-
-  std::unique_ptr<FILE, decltype(&fclose)> fp(fdopen(status_fd, "r"), fclose);
-  if (!fp) {
-    if (error != nullptr) {
-      *error = "failed to open status file in GetProcessInfoFromProcPidFd";
-    }
-    close(status_fd);
+  ssize_t len = TEMP_FAILURE_RETRY(read(fd.get(), buf, size - 1));
+  if (len <= 0) {
     return false;
   }
+  buf[len] = '\0';
+  return true;
+}
 
+// Parses the contents of a status file, read by ReadProcFile.
+static bool ParseStatus(char* buf, ProcessInfo* process_info) {
   int field_bitmap = 0;
   static constexpr int finished_bitmap = 255;
-  char* line = nullptr;
-  size_t len = 0;
 
-  while (getline(&line, &len, fp.get()) != -1 && field_bitmap != finished_bitmap) {
-    char* tab = strchr(line, '\t');
-    if (tab == nullptr) {
-      continue;
+  for (char* line = buf; line != nullptr && field_bitmap != finished_bitmap;) {
+    char* eol = strchr(line, '\n');
+    if (eol == nullptr) {
+      // A line cut off by the end of the buffer.
+      break;
     }
+    *eol = '\0';
 
-    size_t header_len = tab - line;
-    std::string header = std::string(line, header_len);
-    if (header == "Name:") {
-      std::string name = line + header_len + 1;
-
-      // line includes the trailing newline.
-      name.pop_back();
-      process_info->name = std::move(name);
-
-      field_bitmap |= 1;
-    } else if (header == "Pid:") {
-      process_info->tid = atoi(tab + 1);
-      field_bitmap |= 2;
-    } else if (header == "Tgid:") {
-      process_info->pid = atoi(tab + 1);
-      field_bitmap |= 4;
-    } else if (header == "PPid:") {
-      process_info->ppid = atoi(tab + 1);
-      field_bitmap |= 8;
-    } else if (header == "TracerPid:") {
-      process_info->tracer = atoi(tab + 1);
-      field_bitmap |= 16;
-    } else if (header == "Uid:") {
-      process_info->uid = atoi(tab + 1);
-      field_bitmap |= 32;
-    } else if (header == "Gid:") {
-      process_info->gid = atoi(tab + 1);
-      field_bitmap |= 64;
-    } else if (header == "State:") {
-      process_info->state = parse_state(tab + 1);
-      field_bitmap |= 128;
+    char* tab = strchr(line, '\t');
+    if (tab != nullptr) {
+      *tab = '\0';
+      const char* value = tab + 1;
+      if (strcmp(line, "Name:") == 0) {
+        process_info->name.assign(value, eol - value);
+        field_bitmap |= 1;
+      } else if (strcmp(line, "Pid:") == 0) {
+        process_info->tid = atoi(value);
+        field_bitmap |= 2;
+      } else if (strcmp(line, "Tgid:") == 0) {
+        process_info->pid = atoi(value);
+        field_bitmap |= 4;
+      } else if (strcmp(line, "PPid:") == 0) {
+        process_info->ppid = atoi(value);
+        field_bitmap |= 8;
+      } else if (strcmp(line, "TracerPid:") == 0) {
+        process_info->tracer = atoi(value);
+        field_bitmap |= 16;
+      } else if (strcmp(line, "Uid:") == 0) {
+        process_info->uid = atoi(value);
+        field_bitmap |= 32;
+      } else if (strcmp(line, "Gid:") == 0) {
+        process_info->gid = atoi(value);
+        field_bitmap |= 64;
+      } else if (strcmp(line, "State:") == 0) {
+        process_info->state = parse_state(value);
+        field_bitmap |= 128;
+      }
     }
+    line = eol + 1;
   }
 
-  free(line);
   return field_bitmap == finished_bitmap;
 }
 
+// Parses the contents of a stat file, read by ReadProcFile, like:
+//   1234 (name) S 1 ...
+// where the name may itself contain spaces and parentheses.
+static bool ParseStat(char* buf, pid_t pid, ProcessInfo* process_info) {
+  char* name = strchr(buf, '(');
+  char* name_end = strrchr(buf, ')');
+  if (name == nullptr || name_end == nullptr || name_end < name || name_end[1] != ' ') {
+    return false;
+  }
+  const char* state = name_end + 2;
+  if (*state == '\0' || state[1] != ' ') {
+    return false;
+  }
+
+  process_info->name.assign(name + 1, name_end - name - 1);
+  process_info->tid = atoi(buf);
+  process_info->pid = pid;
+  process_info->ppid = atoi(state + 2);
+  process_info->state = parse_state(state);
+  process_info->tracer = -1;
+  process_info->uid = -1;
+  process_info->gid = -1;
+  return true;
+}
+
+bool GetProcessInfoFromProcPidFd(int fd, ProcessInfo* process_info, std::string* error) {
+  char buf[kProcFileBufferSize];
+  if (!ReadProcFile(fd, "status", buf, sizeof(buf))) {
+    if (error != nullptr) {
+      *error = "failed to read status file in GetProcessInfoFromProcPidFd";
+    }
+    return false;
+  }
+
+  return ParseStatus(buf, process_info);
+}
+
+// Calls |callback| for each numeric entry of |dirfd|, which it takes ownership of.
+static bool ForEachNumericEntry(int dirfd, const std::function<void(int, const char*)>& callback) {
+  std::unique_ptr<DIR, int (*)(DIR*)> dir(fdopendir(dirfd), closedir);
+  if (!dir) {
+    if (dirfd != -1) close(dirfd);
+    return false;
+  }
+
+  struct dirent* dent;
+  while ((dent = readdir(dir.get()))) {
+    if (dent->d_name[0] >= '1' && dent->d_name[0] <= '9') {
+      callback(dirfd, dent->d_name);
+    }
+  }
+  return true;
+}
+
+bool GetProcessThreadInfos(pid_t pid, ProcessInfoSource source,
+                           const std::function<void(const ProcessInfo&)>& callback,
+                           std::string* error) {
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "/proc/%d/task", pid);
+
+  ProcessInfo process_info;
+  char buf[kProcFileBufferSize];
+  const char* file = source == kProcessInfoFromStat ? "stat" : "status";
+  bool listed = ForEachNumericEntry(
+      open(path, O_DIRECTORY | O_RDONLY | O_CLOEXEC), [&](int task_fd, const char* tid) {
+        char file_path[64];
+        snprintf(file_path, sizeof(file_path), "%s/%s", tid, file);
+        // Threads that exited since the directory was read are skipped.
+        if (!ReadProcFile(task_fd, file_path, buf, sizeof(buf))) return;
+        if (source == kProcessInfoFromStat ? ParseStat(buf, pid, &process_info)
+                                           : ParseStatus(buf, &process_info)) {
+          callback(process_info);
+        }
+      });
+  if (!listed && error != nullptr) {
+    *error = std::string("failed to open ") + path;
+  }
+  return listed;
+}
+
+bool GetAllProcessInfos(ProcessInfoSource source,
+                        const std::function<void(const ProcessInfo&)>& callback,
+                        std::string* error) {
+  ProcessInfo process_info;
+  char buf[kProcFileBufferSize];
+  const char* file = source == kProcessInfoFromStat ? "stat" : "status";
+  bool listed = ForEachNumericEntry(
+      open("/proc", O_DIRECTORY | O_RDONLY | O_CLOEXEC), [&](int proc_fd, const char* pid) {
+        char file_path[64];
+        snprintf(file_path, sizeof(file_path), "%s/%s", pid, file);
+        // Processes that exited since the directory was read are skipped.
+        if (!ReadProcFile(proc_fd, file_path, buf, sizeof(buf))) return;
+        if (source == kProcessInfoFromStat ? ParseStat(buf, atoi(pid), &process_info)
+                                           : ParseStatus(buf, &process_info)) {
+          callback(process_info);
+        }
+      });
+  if (!listed && error != nullptr) {
+    *error = "failed to open /proc";
+  }
+  return listed;
+}
+
 } /* namespace procinfo */
 } /* namespace android */
@@ -41,6 +41,28 @@ static void BM_ReadMapFile(benchmark::State& state) {
 }
 BENCHMARK(BM_ReadMapFile);
 
+// Parsing only: the copy is needed since ReadMapFileContent splits the lines in place.
+static void BM_ReadMapFileContent(benchmark::State& state) {
+  std::string map_file = android::base::GetExecutableDirectory() + "/testdata/maps";
+  std::string content;
+  CHECK(android::base::ReadFileToString(map_file, &content));
+  // Repeat the maps, to look like a process with as many mappings as asked for.
+  std::string maps_content;
+  for (int64_t i = 0; i < state.range(0); i += 2043) {
+    maps_content += content;
+  }
+  const size_t expected_total = (state.range(0) + 2042) / 2043 * 2043;
+  for (auto _ : state) {
+    std::string buffer(maps_content);
+    size_t total = 0;
+    android::procinfo::ReadMapFileContent(
+        &buffer[0], [&](uint64_t, uint64_t, uint16_t, uint64_t, ino_t, const char*) { total++; });
+    CHECK_EQ(total, expected_total);
+  }
+  state.SetItemsProcessed(state.iterations() * expected_total);
+}
+BENCHMARK(BM_ReadMapFileContent)->Arg(2043)->Arg(10215);
+
 static void BM_unwindstack_FileMaps(benchmark::State& state) {
   std::string map_file = android::base::GetExecutableDirectory() + "/testdata/maps";
   for (auto _ : state) {
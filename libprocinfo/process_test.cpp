@@ -86,6 +86,50 @@ TEST(process_info, process_tids_smoke) {
   }).join();
 }
 
+TEST(process_info, process_thread_infos) {
+  pid_t main_tid = gettid();
+  std::thread([main_tid]() {
+    pid_t thread_tid = gettid();
+
+    for (auto source : {android::procinfo::kProcessInfoFromStatus,
+                        android::procinfo::kProcessInfoFromStat}) {
+      std::set<pid_t> tids;
+      ASSERT_TRUE(android::procinfo::GetProcessThreadInfos(
+          getpid(), source, [&](const android::procinfo::ProcessInfo& info) {
+            ASSERT_EQ(getpid(), info.pid);
+            ASSERT_EQ(getppid(), info.ppid);
+            ASSERT_FALSE(info.name.empty());
+            if (source == android::procinfo::kProcessInfoFromStatus) {
+              ASSERT_EQ(getuid(), info.uid);
+              ASSERT_EQ(getgid(), info.gid);
+            }
+            tids.insert(info.tid);
+          }));
+      ASSERT_EQ(1u, tids.count(main_tid));
+      ASSERT_EQ(1u, tids.count(thread_tid));
+    }
+  }).join();
+}
+
+TEST(process_info, all_process_infos) {
+  for (auto source : {android::procinfo::kProcessInfoFromStatus,
+                      android::procinfo::kProcessInfoFromStat}) {
+    bool found_self = false;
+    ASSERT_TRUE(android::procinfo::GetAllProcessInfos(
+        source, [&](const android::procinfo::ProcessInfo& info) {
+          ASSERT_EQ(info.pid, info.tid);
+          if (info.pid == getpid()) {
+            // Process name is capped at 15 bytes.
+            ASSERT_EQ("libprocinfo_tes", info.name);
+            ASSERT_EQ(getppid(), info.ppid);
+            ASSERT_EQ(android::procinfo::kProcessStateRunning, info.state);
+            found_self = true;
+          }
+        }));
+    ASSERT_TRUE(found_self);
+  }
+}
+
 TEST(process_info, process_state) {
   int pipefd[2];
   ASSERT_EQ(0, pipe2(pipefd, O_CLOEXEC));
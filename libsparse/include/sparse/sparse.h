@@ -307,6 +307,37 @@ struct sparse_file *sparse_file_import_buf(char* buf, bool verbose, bool crc);
  */
 struct sparse_file *sparse_file_import_auto(int fd, bool crc, bool verbose);
 
+/**
+ * sparse_file_read_chunks - stream the chunks of a sparse file to callbacks
+ *
+ * @fd - file descriptor to read from
+ * @verbose - print verbose errors while reading the sparse file
+ * @crc - verify the crc of a file in the Android sparse file format
+ * @block_size - set to the block size of the sparse file
+ * @len - set to the expanded length of the sparse file
+ * @data - function to call for raw data
+ * @fill - function to call for fill chunks
+ * @priv - value that will be passed as the first argument to data and fill
+ *
+ * Reads a file in the Android sparse file format front to back without
+ * building a sparse file cookie, so memory use stays constant however large
+ * the image is, and fd may be a pipe.  block_size and len are set before the
+ * first callback.  'data' is called with whole blocks of raw data, at most
+ * about 1MiB at a time, starting at the given block; the data is only valid
+ * during the call.  'fill' is called with the fill value of nr_blocks blocks
+ * starting at the given block.  Don't care chunks produce no calls.  The
+ * callbacks should return negative on error, 0 on success.  If crc is true,
+ * data already handed to the callbacks may later turn out not to match.
+ *
+ * Returns 0 on success, negative errno on error.
+ */
+int sparse_file_read_chunks(int fd, bool verbose, bool crc, unsigned int *block_size,
+		int64_t *len,
+		int (*data)(void *priv, const void *data, size_t len, unsigned int block),
+		int (*fill)(void *priv, uint32_t fill_val, unsigned int block,
+			    unsigned int nr_blocks),
+		void *priv);
+
 /** sparse_file_resparse - rechunk an existing sparse file into smaller files
  *
  * @in_s - sparse file cookie of the existing sparse file
@@ -39,6 +39,8 @@
 #include <sys/mman.h>
 #define O_BINARY 0
 #else
+#include <io.h>
+#include <windows.h>
 #define ftruncate64 ftruncate
 #endif
 
@@ -644,42 +646,71 @@ int write_fill_chunk(struct output_file* out, unsigned int len, uint32_t fill_va
   return out->sparse_ops->write_fill_chunk(out, len, fill_val);
 }
 
+#ifdef _WIN32
+/* Maps len bytes of fd at offset for reading, or returns nullptr. *view is set to what must be
+ * handed to UnmapViewOfFile. */
+static char* map_fd_chunk(int fd, int64_t offset, uint64_t len, void** view) {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  int64_t aligned_offset = offset & ~(static_cast<int64_t>(info.dwAllocationGranularity) - 1);
+  uint64_t view_size = len + (offset - aligned_offset);
+  if (view_size > SIZE_MAX) return nullptr;
+
+  HANDLE file = reinterpret_cast<HANDLE>(_get_osfhandle(fd));
+  if (file == INVALID_HANDLE_VALUE) return nullptr;
+  HANDLE mapping = CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) return nullptr;
+  /* The view keeps the mapping alive on its own. */
+  *view = MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(aligned_offset >> 32),
+                        static_cast<DWORD>(aligned_offset), view_size);
+  CloseHandle(mapping);
+  if (!*view) return nullptr;
+  return reinterpret_cast<char*>(*view) + (offset - aligned_offset);
+}
+#endif
+
+/* The data is handed to the output straight from a read-only mapping of the file, so that
+ * nothing is copied on the way to the output callback. */
 int write_fd_chunk(struct output_file* out, unsigned int len, int fd, int64_t offset) {
   int ret;
-  int64_t aligned_offset;
-  int aligned_diff;
-  uint64_t buffer_size;
   char* ptr;
 
-  aligned_offset = offset & ~(4096 - 1);
-  aligned_diff = offset - aligned_offset;
-  buffer_size = (uint64_t)len + (uint64_t)aligned_diff;
-
 #ifndef _WIN32
+  int64_t aligned_offset = offset & ~(4096 - 1);
+  int aligned_diff = offset - aligned_offset;
+  uint64_t buffer_size = (uint64_t)len + (uint64_t)aligned_diff;
+
   if (buffer_size > SIZE_MAX) return -E2BIG;
   char* data =
       reinterpret_cast<char*>(mmap64(nullptr, buffer_size, PROT_READ, MAP_SHARED, fd, aligned_offset));
   if (data == MAP_FAILED) {
     return -errno;
   }
+  /* Each chunk is read once, front to back, so ask for aggressive readahead. */
+  madvise(data, buffer_size, MADV_SEQUENTIAL);
   ptr = data + aligned_diff;
 #else
-  off64_t pos;
-  char* data = reinterpret_cast<char*>(malloc(len));
-  if (!data) {
-    return -errno;
-  }
-  pos = lseek64(fd, offset, SEEK_SET);
-  if (pos < 0) {
-    free(data);
-    return -errno;
-  }
-  ret = read_all(fd, data, len);
-  if (ret < 0) {
-    free(data);
-    return ret;
+  void* view = nullptr;
+  char* data = nullptr;
+  ptr = map_fd_chunk(fd, offset, len, &view);
+  if (!ptr) {
+    /* Not mappable (a pipe, say), so fall back to reading into a buffer. */
+    data = reinterpret_cast<char*>(malloc(len));
+    if (!data) {
+      return -errno;
+    }
+    off64_t pos = lseek64(fd, offset, SEEK_SET);
+    if (pos < 0) {
+      free(data);
+      return -errno;
+    }
+    ret = read_all(fd, data, len);
+    if (ret < 0) {
+      free(data);
+      return ret;
+    }
+    ptr = data;
   }
-  ptr = data;
 #endif
 
   ret = out->sparse_ops->write_data_chunk(out, len, ptr);
@@ -687,7 +718,11 @@ int write_fd_chunk(struct output_file* out, unsigned int len, int fd, int64_t of
 #ifndef _WIN32
   munmap(data, buffer_size);
 #else
-  free(data);
+  if (view) {
+    UnmapViewOfFile(view);
+  } else {
+    free(data);
+  }
 #endif
 
   return ret;
@@ -14,8 +14,12 @@
  * limitations under the License.
  */
 
+#define _FILE_OFFSET_BITS 64
+#define _LARGEFILE64_SOURCE 1
+
 #include <sparse/sparse.h>
 
+#include <errno.h>
 #include <fcntl.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -29,15 +33,72 @@
 #define O_BINARY 0
 #endif
 
+#if defined(__APPLE__) && defined(__MACH__)
+#define lseek64 lseek
+#define ftruncate64 ftruncate
+#define off64_t off_t
+#endif
+
+#if defined(_WIN32)
+#define ftruncate64 ftruncate
+#endif
+
 void usage() {
   fprintf(stderr, "Usage: simg2img <sparse_image_files> <raw_image_file>\n");
 }
 
+struct raw_output {
+  int fd;
+  unsigned int block_size;
+  int64_t len;
+};
+
+static int write_at(int fd, const void* data, size_t len, off64_t offset) {
+  if (lseek64(fd, offset, SEEK_SET) != offset) {
+    return -errno;
+  }
+  const char* p = static_cast<const char*>(data);
+  while (len) {
+    ssize_t ret = write(fd, p, len);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      return -errno;
+    }
+    p += ret;
+    len -= ret;
+  }
+  return 0;
+}
+
+static int write_data(void* priv, const void* data, size_t len, unsigned int block) {
+  raw_output* out = static_cast<raw_output*>(priv);
+  return write_at(out->fd, data, len, (off64_t)block * out->block_size);
+}
+
+static int write_fill(void* priv, uint32_t fill_val, unsigned int block, unsigned int nr_blocks) {
+  raw_output* out = static_cast<raw_output*>(priv);
+  static uint32_t fill_buf[64 * 1024];
+  static constexpr unsigned int kFillBufSize = sizeof(fill_buf);
+  for (auto& v : fill_buf) v = fill_val;
+
+  off64_t offset = (off64_t)block * out->block_size;
+  int64_t len = (int64_t)nr_blocks * out->block_size;
+  while (len) {
+    size_t chunk = len < kFillBufSize ? len : kFillBufSize;
+    int ret = write_at(out->fd, fill_buf, chunk, offset);
+    if (ret < 0) {
+      return ret;
+    }
+    offset += chunk;
+    len -= chunk;
+  }
+  return 0;
+}
+
 int main(int argc, char* argv[]) {
   int in;
   int out;
   int i;
-  struct sparse_file* s;
 
   if (argc < 3) {
     usage();
@@ -61,22 +122,19 @@ int main(int argc, char* argv[]) {
       }
     }
 
-    s = sparse_file_import(in, true, false);
-    if (!s) {
+    /* Stream each image straight to the output rather than importing it,
+     * so memory use does not grow with the size of the image. */
+    raw_output raw = {.fd = out};
+    if (sparse_file_read_chunks(in, true, false, &raw.block_size, &raw.len, write_data,
+                                write_fill, &raw) < 0) {
       fprintf(stderr, "Failed to read sparse file\n");
       exit(-1);
     }
 
-    if (lseek(out, 0, SEEK_SET) == -1) {
-      perror("lseek failed");
-      exit(EXIT_FAILURE);
-    }
-
-    if (sparse_file_write(s, out, false, false, false) < 0) {
+    if (ftruncate64(out, raw.len) < 0) {
       fprintf(stderr, "Cannot write output file\n");
       exit(-1);
     }
-    sparse_file_destroy(s);
     close(in);
   }
 
@@ -27,9 +27,12 @@
 #include <unistd.h>
 #include <algorithm>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <sparse/sparse.h>
 
+#include "android-base/file.h"
 #include "android-base/stringprintf.h"
 #include "defs.h"
 #include "output_file.h"
@@ -410,54 +413,95 @@ static int sparse_file_read_sparse(struct sparse_file* s, SparseFileSource* sour
   return 0;
 }
 
-static int sparse_file_read_normal(struct sparse_file* s, int fd) {
+/* A block is a fill block if it is one 32-bit value repeated, which is the case
+ * exactly when it equals itself shifted by one value. libc's memcmp compares
+ * many bytes at a time, unlike a loop over the values. */
+static bool is_fill_block(const uint32_t* buf, unsigned int block_size) {
+  return memcmp(buf, buf + 1, block_size - sizeof(uint32_t)) == 0;
+}
+
+/* Raw images are read and classified SLICE_SIZE at a time by up to MAX_THREADS
+ * threads, then added to the sparse file in order. */
+static constexpr int64_t SLICE_SIZE = 16 * 1024 * 1024;
+static constexpr unsigned int MAX_THREADS = 8;
+
+struct raw_slice {
+  int64_t offset;
+  int64_t len;
+  std::vector<uint32_t> buf;
+  /* One entry per block: whether it is a fill block. */
+  std::vector<bool> fill;
   int ret;
-  uint32_t* buf = (uint32_t*)malloc(s->block_size);
-  unsigned int block = 0;
-  int64_t remain = s->len;
-  int64_t offset = 0;
-  unsigned int to_read;
-  unsigned int i;
-  bool sparse_block;
+};
 
-  if (!buf) {
-    return -ENOMEM;
+static void classify_slice(int fd, unsigned int block_size, raw_slice* slice) {
+  slice->buf.resize((slice->len + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+  if (!android::base::ReadFullyAtOffset(fd, slice->buf.data(), slice->len, slice->offset)) {
+    slice->ret = errno ? -errno : -EOVERFLOW;
+    return;
   }
 
-  while (remain > 0) {
-    to_read = std::min(remain, (int64_t)(s->block_size));
-    ret = read_all(fd, buf, to_read);
-    if (ret < 0) {
-      error("failed to read sparse file");
-      free(buf);
-      return ret;
-    }
+  size_t blocks = (slice->len + block_size - 1) / block_size;
+  slice->fill.assign(blocks, false);
+  for (size_t i = 0; i < blocks; i++) {
+    int64_t block_len = std::min<int64_t>(slice->len - i * block_size, block_size);
+    /* Only whole blocks can be fills. */
+    slice->fill[i] = (block_len == block_size) &&
+                     is_fill_block(slice->buf.data() + i * (block_size / sizeof(uint32_t)),
+                                   block_size);
+  }
+  slice->ret = 0;
+}
 
-    if (to_read == s->block_size) {
-      sparse_block = true;
-      for (i = 1; i < s->block_size / sizeof(uint32_t); i++) {
-        if (buf[0] != buf[i]) {
-          sparse_block = false;
-          break;
-        }
-      }
-    } else {
-      sparse_block = false;
+static int sparse_file_read_normal(struct sparse_file* s, int fd) {
+  int64_t slice_size = std::max<int64_t>(SLICE_SIZE / s->block_size, 1) * s->block_size;
+  int64_t slices = (s->len + slice_size - 1) / slice_size;
+  int64_t max_threads = std::min<int64_t>(MAX_THREADS, slices);
+  unsigned int threads = std::clamp<int64_t>(std::thread::hardware_concurrency(), 1, max_threads);
+  std::vector<raw_slice> round(threads);
+
+  for (int64_t offset = 0; offset < s->len;) {
+    /* Read and classify the next |threads| slices in parallel... */
+    size_t count = 0;
+    for (; count < round.size() && offset < s->len; count++) {
+      round[count].offset = offset;
+      round[count].len = std::min(s->len - offset, slice_size);
+      offset += round[count].len;
     }
-
-    if (sparse_block) {
-      /* TODO: add flag to use skip instead of fill for buf[0] == 0 */
-      sparse_file_add_fill(s, buf[0], to_read, block);
+    if (count == 1) {
+      classify_slice(fd, s->block_size, &round[0]);
     } else {
-      sparse_file_add_fd(s, fd, offset, to_read, block);
+      std::vector<std::thread> workers;
+      for (size_t i = 0; i < count; i++) {
+        workers.emplace_back(classify_slice, fd, s->block_size, &round[i]);
+      }
+      for (std::thread& worker : workers) {
+        worker.join();
+      }
     }
 
-    remain -= to_read;
-    offset += to_read;
-    block++;
+    /* ...then add them to the sparse file in order, which must be serial. */
+    for (size_t i = 0; i < count; i++) {
+      raw_slice* slice = &round[i];
+      if (slice->ret < 0) {
+        error("failed to read sparse file");
+        return slice->ret;
+      }
+      unsigned int block = slice->offset / s->block_size;
+      for (size_t j = 0; j < slice->fill.size(); j++, block++) {
+        int64_t block_offset = slice->offset + j * s->block_size;
+        unsigned int block_len = std::min<int64_t>(s->len - block_offset, s->block_size);
+        if (slice->fill[j]) {
+          /* TODO: add flag to use skip instead of fill for buf[0] == 0 */
+          uint32_t fill_val = slice->buf[j * (s->block_size / sizeof(uint32_t))];
+          sparse_file_add_fill(s, fill_val, block_len, block);
+        } else {
+          sparse_file_add_fd(s, fd, block_offset, block_len, block);
+        }
+      }
+    }
   }
 
-  free(buf);
   return 0;
 }
 
@@ -575,3 +619,193 @@ struct sparse_file* sparse_file_import_auto(int fd, bool crc, bool verbose) {
 
   return s;
 }
+
+/* Reads and discards len bytes, so that streams work on pipes too. */
+static int stream_skip(int fd, std::vector<char>* buf, int64_t len) {
+  while (len) {
+    size_t chunk = std::min<int64_t>(len, buf->size());
+    int ret = read_all(fd, buf->data(), chunk);
+    if (ret < 0) {
+      return ret;
+    }
+    len -= chunk;
+  }
+  return 0;
+}
+
+/* Adds len bytes of the fill value, or of zeros, to the running crc. */
+static void stream_crc_fill(std::vector<char>* buf, uint32_t fill_val, int64_t len,
+                            uint32_t* crc32) {
+  uint32_t* fillbuf = reinterpret_cast<uint32_t*>(buf->data());
+  std::fill(fillbuf, fillbuf + buf->size() / sizeof(fill_val), fill_val);
+  while (len) {
+    size_t chunk = std::min<int64_t>(len, buf->size());
+    *crc32 = sparse_crc32(*crc32, buf->data(), chunk);
+    len -= chunk;
+  }
+}
+
+int sparse_file_read_chunks(int fd, bool verbose, bool crc, unsigned int* block_size,
+                            int64_t* len,
+                            int (*data)(void* priv, const void* data, size_t len,
+                                        unsigned int block),
+                            int (*fill)(void* priv, uint32_t fill_val, unsigned int block,
+                                        unsigned int nr_blocks),
+                            void* priv) {
+  int ret;
+  sparse_header_t sparse_header;
+  chunk_header_t chunk_header;
+  uint32_t crc32 = 0;
+  unsigned int cur_block = 0;
+  int64_t offset = 0;
+
+  ret = read_all(fd, &sparse_header, sizeof(sparse_header));
+  if (ret < 0) {
+    verbose_error(verbose, ret, "header");
+    return ret;
+  }
+
+  if (sparse_header.magic != SPARSE_HEADER_MAGIC) {
+    verbose_error(verbose, -EINVAL, "header magic");
+    return -EINVAL;
+  }
+
+  if (sparse_header.major_version != SPARSE_HEADER_MAJOR_VER) {
+    verbose_error(verbose, -EINVAL, "header major version");
+    return -EINVAL;
+  }
+
+  if (sparse_header.file_hdr_sz < SPARSE_HEADER_LEN ||
+      sparse_header.chunk_hdr_sz < sizeof(chunk_header) || sparse_header.blk_sz == 0 ||
+      sparse_header.blk_sz % sizeof(uint32_t) != 0) {
+    verbose_error(verbose, -EINVAL, "header");
+    return -EINVAL;
+  }
+
+  /* Raw data is handed over in whole blocks, as many as fit in COPY_BUF_SIZE,
+   * so memory use does not depend on the size of the image or its chunks. */
+  unsigned int piece_blocks = std::max<unsigned int>(1, COPY_BUF_SIZE / sparse_header.blk_sz);
+  std::vector<char> buf((size_t)piece_blocks * sparse_header.blk_sz);
+
+  ret = stream_skip(fd, &buf, sparse_header.file_hdr_sz - SPARSE_HEADER_LEN);
+  if (ret < 0) {
+    verbose_error(verbose, ret, "header");
+    return ret;
+  }
+  offset += sparse_header.file_hdr_sz;
+
+  *block_size = sparse_header.blk_sz;
+  *len = (int64_t)sparse_header.total_blks * sparse_header.blk_sz;
+
+  for (unsigned int i = 0; i < sparse_header.total_chunks; i++) {
+    ret = read_all(fd, &chunk_header, sizeof(chunk_header));
+    if (ret >= 0) {
+      ret = stream_skip(fd, &buf, sparse_header.chunk_hdr_sz - CHUNK_HEADER_LEN);
+    }
+    if (ret < 0) {
+      verbose_error(verbose, ret, "chunk header at %" PRId64, offset);
+      return ret;
+    }
+    offset += sparse_header.chunk_hdr_sz;
+
+    if (chunk_header.total_sz < sparse_header.chunk_hdr_sz) {
+      verbose_error(verbose, -EINVAL, "chunk header at %" PRId64, offset);
+      return -EINVAL;
+    }
+    unsigned int chunk_data_size = chunk_header.total_sz - sparse_header.chunk_hdr_sz;
+    int64_t chunk_len = (int64_t)chunk_header.chunk_sz * sparse_header.blk_sz;
+
+    switch (chunk_header.chunk_type) {
+      case CHUNK_TYPE_RAW:
+        if (chunk_data_size != chunk_len) {
+          verbose_error(verbose, -EINVAL, "data block at %" PRId64, offset);
+          return -EINVAL;
+        }
+        for (unsigned int done = 0; done < chunk_header.chunk_sz;) {
+          unsigned int blocks = std::min(chunk_header.chunk_sz - done, piece_blocks);
+          size_t piece_len = (size_t)blocks * sparse_header.blk_sz;
+          ret = read_all(fd, buf.data(), piece_len);
+          if (ret < 0) {
+            verbose_error(verbose, ret, "data block at %" PRId64, offset);
+            return ret;
+          }
+          if (crc) {
+            crc32 = sparse_crc32(crc32, buf.data(), piece_len);
+          }
+          ret = data(priv, buf.data(), piece_len, cur_block + done);
+          if (ret < 0) {
+            return ret;
+          }
+          done += blocks;
+        }
+        break;
+      case CHUNK_TYPE_FILL: {
+        uint32_t fill_val;
+        if (chunk_data_size != sizeof(fill_val)) {
+          verbose_error(verbose, -EINVAL, "fill block at %" PRId64, offset);
+          return -EINVAL;
+        }
+        ret = read_all(fd, &fill_val, sizeof(fill_val));
+        if (ret < 0) {
+          verbose_error(verbose, ret, "fill block at %" PRId64, offset);
+          return ret;
+        }
+        if (crc) {
+          stream_crc_fill(&buf, fill_val, chunk_len, &crc32);
+        }
+        ret = fill(priv, fill_val, cur_block, chunk_header.chunk_sz);
+        if (ret < 0) {
+          return ret;
+        }
+        break;
+      }
+      case CHUNK_TYPE_DONT_CARE:
+        if (chunk_data_size != 0) {
+          verbose_error(verbose, -EINVAL, "skip block at %" PRId64, offset);
+          return -EINVAL;
+        }
+        if (crc) {
+          stream_crc_fill(&buf, 0, chunk_len, &crc32);
+        }
+        break;
+      case CHUNK_TYPE_CRC32: {
+        uint32_t file_crc32;
+        if (chunk_data_size != sizeof(file_crc32)) {
+          verbose_error(verbose, -EINVAL, "crc block at %" PRId64, offset);
+          return -EINVAL;
+        }
+        ret = read_all(fd, &file_crc32, sizeof(file_crc32));
+        if (ret < 0) {
+          verbose_error(verbose, ret, "crc block at %" PRId64, offset);
+          return ret;
+        }
+        if (crc && file_crc32 != crc32) {
+          verbose_error(verbose, -EINVAL, "crc block at %" PRId64, offset);
+          return -EINVAL;
+        }
+        chunk_len = 0;
+        break;
+      }
+      default:
+        /* Like sparse_file_import, skip over chunks of unknown type. */
+        verbose_error(verbose, -EINVAL, "unknown block %04X at %" PRId64, chunk_header.chunk_type,
+                      offset);
+        ret = stream_skip(fd, &buf, chunk_data_size);
+        if (ret < 0) {
+          return ret;
+        }
+        chunk_len = 0;
+        break;
+    }
+
+    offset += chunk_data_size;
+    cur_block += chunk_len / sparse_header.blk_sz;
+  }
+
+  if (sparse_header.total_blks != cur_block) {
+    verbose_error(verbose, -EINVAL, "block count");
+    return -EINVAL;
+  }
+
+  return 0;
+}
@@ -17,6 +17,8 @@
 #pragma once
 
 #include <log/log_event_list.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <sys/uio.h>
 
 #ifdef __cplusplus
@@ -29,6 +31,28 @@ void stats_log_close();
 int android_log_write_char_array(android_log_context ctx, const char* value, size_t len);
 extern int (*write_to_statsd)(struct iovec* vec, size_t nr);
 
+/*
+ * Queues atoms in memory, and sends them to statsd from a background thread,
+ * many per syscall, after at most flush_delay_ms or once half of max_bytes is
+ * used. Each atom is still its own datagram. Writes then only fail with
+ * -ENOBUFS when the queue is full, which callers should note_log_drop() as
+ * usual. Atoms statsd doesn't take later are counted into the next drop report.
+ * Returns 0 on success, including when already batching, or -errno.
+ */
+int stats_log_start_batching(size_t max_bytes, unsigned flush_delay_ms);
+/* Returns once the atoms queued so far were sent, or dropped. */
+void stats_log_flush();
+
+struct stats_log_batch_stats {
+    uint64_t queued;       /* atoms queued */
+    uint64_t sent;         /* queued atoms sent to statsd */
+    uint64_t dropped_full; /* atoms refused with -ENOBUFS */
+    uint64_t dropped_send; /* queued atoms that could not be sent */
+    size_t queued_bytes;   /* memory used by atoms not sent yet */
+    size_t max_bytes;      /* memory available to the queue */
+};
+void stats_log_get_batch_stats(struct stats_log_batch_stats* stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -124,7 +124,20 @@ void note_log_drop(int error, int tag) {
     statsdLoggerWrite.noteDrop(error, tag);
 }
 
+int stats_log_start_batching(size_t max_bytes, unsigned flush_delay_ms) {
+    return statsd_writer_start_batching(max_bytes, flush_delay_ms);
+}
+
+void stats_log_flush() {
+    statsd_writer_flush();
+}
+
+void stats_log_get_batch_stats(struct stats_log_batch_stats* stats) {
+    statsd_writer_get_batch_stats(stats);
+}
+
 void stats_log_close() {
+    stats_log_flush();
     statsd_writer_init_lock();
     write_to_statsd = __write_to_statsd_init;
     if (statsdLoggerWrite.close) {
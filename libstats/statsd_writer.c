@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 #include "statsd_writer.h"
+#include "include/stats_event_list.h"
 
 #include <cutils/fs.h>
 #include <cutils/sockets.h>
@@ -26,6 +27,7 @@
 #include <private/android_logger.h>
 #include <stdarg.h>
 #include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -59,6 +61,7 @@ static pthread_mutex_t log_init_lock = PTHREAD_MUTEX_INITIALIZER;
 static atomic_int dropped = 0;
 static atomic_int log_error = 0;
 static atomic_int atom_tag = 0;
+static atomic_bool batching = false;
 
 void statsd_writer_init_lock() {
     /*
@@ -81,6 +84,7 @@ static int statsdOpen();
 static void statsdClose();
 static int statsdWrite(struct timespec* ts, struct iovec* vec, size_t nr);
 static void statsdNoteDrop();
+static int statsdBatchAppend(struct iovec* vec, size_t nr);
 
 struct android_log_transport_write statsdLoggerWrite = {
         .name = "statsd",
@@ -172,13 +176,64 @@ static void statsdNoteDrop(int error, int tag) {
     atomic_exchange_explicit(&atom_tag, tag, memory_order_relaxed);
 }
 
+// If we dropped events before, try to tell statsd. header is that of the
+// event being written, and is sent again with the drop report.
+static void statsdSendDrops(int sock, android_log_header_t* header) {
+    int32_t snapshot = atomic_exchange_explicit(&dropped, 0, memory_order_relaxed);
+    if (snapshot) {
+        android_log_event_long_t buffer;
+        struct iovec vec[2];
+        ssize_t ret;
+        // store the last log error in the tag field. This tag field is not used by statsd.
+        buffer.header.tag = htole32(atomic_load(&log_error));
+        buffer.payload.type = EVENT_TYPE_LONG;
+        // format:
+        // |atom_tag|dropped_count|
+        int64_t composed_long = atomic_load(&atom_tag);
+        // Send 2 int32's via an int64.
+        composed_long = ((composed_long << 32) | ((int64_t)snapshot));
+        buffer.payload.data = htole64(composed_long);
+
+        vec[0].iov_base = header;
+        vec[0].iov_len = sizeof(*header);
+        vec[1].iov_base = &buffer;
+        vec[1].iov_len = sizeof(buffer);
+
+        ret = TEMP_FAILURE_RETRY(writev(sock, vec, 2));
+        if (ret != (ssize_t)(sizeof(*header) + sizeof(buffer))) {
+            atomic_fetch_add_explicit(&dropped, snapshot, memory_order_relaxed);
+        }
+    }
+}
+
+// Fills newVec after the header with vec, truncated to LOGGER_ENTRY_MAX_PAYLOAD,
+// and returns the number of entries of newVec used.
+static size_t statsdPayloadVec(struct iovec* newVec, struct iovec* vec, size_t nr) {
+    static const unsigned headerLength = 1;
+    size_t i, payloadSize;
+
+    for (payloadSize = 0, i = headerLength; i < nr + headerLength; i++) {
+        newVec[i].iov_base = vec[i - headerLength].iov_base;
+        payloadSize += newVec[i].iov_len = vec[i - headerLength].iov_len;
+
+        if (payloadSize > LOGGER_ENTRY_MAX_PAYLOAD) {
+            newVec[i].iov_len -= payloadSize - LOGGER_ENTRY_MAX_PAYLOAD;
+            if (newVec[i].iov_len) {
+                ++i;
+            }
+            break;
+        }
+    }
+    return i;
+}
+
 static int statsdWrite(struct timespec* ts, struct iovec* vec, size_t nr) {
     ssize_t ret;
     int sock;
     static const unsigned headerLength = 1;
     struct iovec newVec[nr + headerLength];
     android_log_header_t header;
-    size_t i, payloadSize;
+    size_t i;
 
     sock = atomic_load(&statsdLoggerWrite.sock);
     if (sock < 0) switch (sock) {
@@ -210,49 +265,22 @@ static int statsdWrite(struct timespec* ts, struct iovec* vec, size_t nr) {
     header.tid = gettid();
     header.realtime.tv_sec = ts->tv_sec;
     header.realtime.tv_nsec = ts->tv_nsec;
+    header.id = LOG_ID_STATS;
 
     newVec[0].iov_base = (unsigned char*)&header;
     newVec[0].iov_len = sizeof(header);
+    i = statsdPayloadVec(newVec, vec, nr);
 
-    // If we dropped events before, try to tell statsd.
-    if (sock >= 0) {
-        int32_t snapshot = atomic_exchange_explicit(&dropped, 0, memory_order_relaxed);
-        if (snapshot) {
-            android_log_event_long_t buffer;
-            header.id = LOG_ID_STATS;
-            // store the last log error in the tag field. This tag field is not used by statsd.
-            buffer.header.tag = htole32(atomic_load(&log_error));
-            buffer.payload.type = EVENT_TYPE_LONG;
-            // format:
-            // |atom_tag|dropped_count|
-            int64_t composed_long = atomic_load(&atom_tag);
-            // Send 2 int32's via an int64.
-            composed_long = ((composed_long << 32) | ((int64_t)snapshot));
-            buffer.payload.data = htole64(composed_long);
-
-            newVec[headerLength].iov_base = &buffer;
-            newVec[headerLength].iov_len = sizeof(buffer);
-
-            ret = TEMP_FAILURE_RETRY(writev(sock, newVec, 2));
-            if (ret != (ssize_t)(sizeof(header) + sizeof(buffer))) {
-                atomic_fetch_add_explicit(&dropped, snapshot, memory_order_relaxed);
-            }
+    if (atomic_load_explicit(&batching, memory_order_relaxed)) {
+        ret = statsdBatchAppend(newVec, i);
+        if (ret != -EAGAIN) {
+            return ret;
         }
     }
 
-    header.id = LOG_ID_STATS;
-
-    for (payloadSize = 0, i = headerLength; i < nr + headerLength; i++) {
-        newVec[i].iov_base = vec[i - headerLength].iov_base;
-        payloadSize += newVec[i].iov_len = vec[i - headerLength].iov_len;
-
-        if (payloadSize > LOGGER_ENTRY_MAX_PAYLOAD) {
-            newVec[i].iov_len -= payloadSize - LOGGER_ENTRY_MAX_PAYLOAD;
-            if (newVec[i].iov_len) {
-                ++i;
-            }
-            break;
-        }
+    // If we dropped events before, try to tell statsd.
+    if (sock >= 0) {
+        statsdSendDrops(sock, &header);
     }
 
     /*
@@ -302,3 +330,332 @@ static int statsdWrite(struct timespec* ts, struct iovec* vec, size_t nr) {
 
     return ret;
 }
+
+/*
+ * Client side batching, see stats_log_start_batching().
+ *
+ * Writers append their atom, header included, to the active one of two
+ * buffers, each record prefixed with its 16 bit length. The flush thread swaps
+ * the buffers, and outside of the lock sends the atoms of the other one to
+ * statsd, still one datagram each as statsd expects, but many per syscall.
+ */
+#define STATSD_BATCH_MSGS 64
+/* How long a batch may wait for a busy statsd, rather than drop atoms. */
+#define STATSD_BATCH_MAX_WAIT_MS 100
+
+struct statsd_batch_buffer {
+    uint8_t* data;
+    size_t len;
+    size_t count;
+};
+
+static pthread_mutex_t batch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t batch_wake = PTHREAD_COND_INITIALIZER;     /* for the flush thread */
+static pthread_cond_t batch_flushed = PTHREAD_COND_INITIALIZER;  /* for statsd_writer_flush */
+static struct statsd_batch_buffer batch_buffers[2];
+static int batch_active;      /* index of the buffer atoms are appended to */
+static size_t batch_capacity; /* of each buffer */
+static unsigned batch_delay_ms;
+static uint64_t batch_flush_requested;
+static uint64_t batch_flush_done;
+static struct stats_log_batch_stats batch_stats;
+
+/* Returns the size of the queued payload, -EAGAIN if the atom should be written
+ * directly, or -ENOBUFS if there is no space left for it. */
+static int statsdBatchAppend(struct iovec* vec, size_t nr) {
+    struct statsd_batch_buffer* buffer;
+    size_t len, i;
+    uint16_t record_len;
+
+    for (len = i = 0; i < nr; i++) {
+        len += vec[i].iov_len;
+    }
+    /* Don't wait behind other writers, or on ourselves from a signal handler. */
+    if (pthread_mutex_trylock(&batch_lock)) {
+        return -EAGAIN;
+    }
+    if (!atomic_load(&batching)) {
+        pthread_mutex_unlock(&batch_lock);
+        return -EAGAIN;
+    }
+    buffer = &batch_buffers[batch_active];
+    if (buffer->len + sizeof(record_len) + len > batch_capacity) {
+        batch_stats.dropped_full++;
+        pthread_mutex_unlock(&batch_lock);
+        return -ENOBUFS;
+    }
+    record_len = len;
+    memcpy(buffer->data + buffer->len, &record_len, sizeof(record_len));
+    buffer->len += sizeof(record_len);
+    for (i = 0; i < nr; i++) {
+        memcpy(buffer->data + buffer->len, vec[i].iov_base, vec[i].iov_len);
+        buffer->len += vec[i].iov_len;
+    }
+    buffer->count++;
+    batch_stats.queued++;
+    batch_stats.queued_bytes += sizeof(record_len) + len;
+    /* Start sending early rather than dropping. */
+    if (buffer->len >= batch_capacity / 2) {
+        pthread_cond_signal(&batch_wake);
+    }
+    pthread_mutex_unlock(&batch_lock);
+
+    return len - sizeof(android_log_header_t);
+}
+
+/* Returns the statsd socket, reconnecting if statsd went away. */
+static int statsdBatchSocket(int error) {
+    int sock = atomic_load(&statsdLoggerWrite.sock);
+
+    if ((sock >= 0) && !error) {
+        return sock;
+    }
+    switch (error ? error : sock) {
+        case -ENOTCONN:
+        case -ECONNREFUSED:
+        case -ENOENT:
+            break;
+        default:
+            return error ? error : sock;
+    }
+    statsd_writer_init_lock();
+    __statsdClose(error ? error : sock);
+    statsdOpen();
+    statsd_writer_init_unlock();
+    return atomic_load(&statsdLoggerWrite.sock);
+}
+
+/* Sends count records of data, returns how many statsd took, or -errno. */
+static int statsdBatchSendRecords(int sock, uint8_t* data, size_t count) {
+#if defined(__ANDROID__)
+    struct mmsghdr msgs[STATSD_BATCH_MSGS];
+    struct iovec vecs[STATSD_BATCH_MSGS];
+    uint16_t record_len;
+    size_t i;
+    int ret;
+
+    memset(msgs, 0, sizeof(msgs));
+    for (i = 0; i < count; i++) {
+        memcpy(&record_len, data, sizeof(record_len));
+        vecs[i].iov_base = data + sizeof(record_len);
+        vecs[i].iov_len = record_len;
+        msgs[i].msg_hdr.msg_iov = &vecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        data += sizeof(record_len) + record_len;
+    }
+    ret = TEMP_FAILURE_RETRY(sendmmsg(sock, msgs, count, 0));
+    return ret < 0 ? -errno : ret;
+#else
+    uint16_t record_len;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        memcpy(&record_len, data, sizeof(record_len));
+        if (TEMP_FAILURE_RETRY(write(sock, data + sizeof(record_len), record_len)) < 0) {
+            return i ? (int)i : -errno;
+        }
+        data += sizeof(record_len) + record_len;
+    }
+    return count;
+#endif
+}
+
+static void statsdBatchSend(struct statsd_batch_buffer* buffer) {
+    uint8_t* data = buffer->data;
+    size_t remaining = buffer->count;
+    uint64_t sent = 0, dropped_send = 0;
+    bool retried = false;
+    struct timespec start = {0, 0};
+    int sock = statsdBatchSocket(0);
+
+    if (sock >= 0) {
+        /* The header of the first atom stands in for the drop report's. */
+        android_log_header_t header;
+        memcpy(&header, data + sizeof(uint16_t), sizeof(header));
+        statsdSendDrops(sock, &header);
+    }
+    while (remaining) {
+        size_t count = min(remaining, (size_t)STATSD_BATCH_MSGS);
+        int ret = sock < 0 ? sock : statsdBatchSendRecords(sock, data, count);
+        if (ret == 0) {
+            ret = -EAGAIN;
+        }
+        if (ret == -EAGAIN) {
+            /* Unlike writers, the flush thread can afford to wait for statsd. */
+            struct timespec now;
+            long waited_ms;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (!start.tv_sec && !start.tv_nsec) {
+                start = now;
+            }
+            waited_ms = (now.tv_sec - start.tv_sec) * 1000 +
+                        (now.tv_nsec - start.tv_nsec) / 1000000;
+            if (waited_ms < STATSD_BATCH_MAX_WAIT_MS) {
+                struct pollfd pfd = {.fd = sock, .events = POLLOUT};
+                TEMP_FAILURE_RETRY(poll(&pfd, 1, STATSD_BATCH_MAX_WAIT_MS - waited_ms));
+                continue;
+            }
+        }
+        if ((ret < 0) && !retried) {
+            /* statsd restarted? */
+            int reconnected = statsdBatchSocket(ret);
+            retried = true;
+            if (reconnected >= 0) {
+                sock = reconnected;
+                continue;
+            }
+        }
+        if (ret < 0) {
+            /* Give up on this chunk, noting each atom for the next drop report. */
+            size_t i;
+            for (i = 0; i < count; i++) {
+                uint16_t record_len;
+                uint32_t tag;
+                memcpy(&record_len, data, sizeof(record_len));
+                memcpy(&tag, data + sizeof(record_len) + sizeof(android_log_header_t),
+                       sizeof(tag));
+                statsdNoteDrop(ret, tag);
+                data += sizeof(record_len) + record_len;
+            }
+            dropped_send += count;
+            remaining -= count;
+            continue;
+        }
+        while (ret--) {
+            uint16_t record_len;
+            memcpy(&record_len, data, sizeof(record_len));
+            data += sizeof(record_len) + record_len;
+            sent++;
+            remaining--;
+        }
+    }
+
+    pthread_mutex_lock(&batch_lock);
+    batch_stats.sent += sent;
+    batch_stats.dropped_send += dropped_send;
+    batch_stats.queued_bytes -= buffer->len;
+    pthread_mutex_unlock(&batch_lock);
+}
+
+static void* statsdBatchThread(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&batch_lock);
+    for (;;) {
+        struct statsd_batch_buffer* buffer = &batch_buffers[batch_active];
+        uint64_t requested = batch_flush_requested;
+
+        if (!buffer->count) {
+            if (batch_flush_done != requested) {
+                batch_flush_done = requested;
+                pthread_cond_broadcast(&batch_flushed);
+            }
+            pthread_cond_wait(&batch_wake, &batch_lock);
+            continue;
+        }
+        if ((batch_flush_done == requested) && (buffer->len < batch_capacity / 2)) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += batch_delay_ms / 1000;
+            deadline.tv_nsec += (batch_delay_ms % 1000) * 1000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            if (pthread_cond_timedwait(&batch_wake, &batch_lock, &deadline) != ETIMEDOUT) {
+                continue;
+            }
+        }
+
+        batch_active ^= 1;
+        pthread_mutex_unlock(&batch_lock);
+        statsdBatchSend(buffer);
+        pthread_mutex_lock(&batch_lock);
+        buffer->len = 0;
+        buffer->count = 0;
+        batch_flush_done = requested;
+        pthread_cond_broadcast(&batch_flushed);
+    }
+    return NULL;
+}
+
+static void statsdBatchAtforkPrepare() {
+    pthread_mutex_lock(&batch_lock);
+}
+
+static void statsdBatchAtforkParent() {
+    pthread_mutex_unlock(&batch_lock);
+}
+
+/* The flush thread isn't forked, leave the queued atoms to the parent. */
+static void statsdBatchAtforkChild() {
+    atomic_store(&batching, false);
+    batch_buffers[0].len = batch_buffers[0].count = 0;
+    batch_buffers[1].len = batch_buffers[1].count = 0;
+    batch_flush_requested = batch_flush_done = 0;
+    memset(&batch_stats, 0, sizeof(batch_stats));
+    pthread_mutex_unlock(&batch_lock);
+}
+
+int statsd_writer_start_batching(size_t max_bytes, unsigned flush_delay_ms) {
+    static bool atfork_registered;
+    /* Each buffer must take the largest atom. */
+    const size_t min_capacity =
+            sizeof(uint16_t) + sizeof(android_log_header_t) + LOGGER_ENTRY_MAX_PAYLOAD;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int ret = 0;
+
+    pthread_mutex_lock(&batch_lock);
+    if (atomic_load(&batching)) {
+        goto out;
+    }
+    batch_capacity = max_bytes / 2 < min_capacity ? min_capacity : max_bytes / 2;
+    batch_delay_ms = flush_delay_ms;
+    for (int i = 0; i < 2; i++) {
+        uint8_t* data = realloc(batch_buffers[i].data, batch_capacity);
+        if (!data) {
+            ret = -ENOMEM;
+            goto out;
+        }
+        batch_buffers[i].data = data;
+    }
+    if (!atfork_registered) {
+        ret = -pthread_atfork(statsdBatchAtforkPrepare, statsdBatchAtforkParent,
+                              statsdBatchAtforkChild);
+        if (ret) {
+            goto out;
+        }
+        atfork_registered = true;
+    }
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ret = -pthread_create(&thread, &attr, statsdBatchThread, NULL);
+    pthread_attr_destroy(&attr);
+    if (ret) {
+        goto out;
+    }
+    batch_stats.max_bytes = 2 * batch_capacity;
+    atomic_store(&batching, true);
+
+out:
+    pthread_mutex_unlock(&batch_lock);
+    return ret;
+}
+
+void statsd_writer_flush() {
+    pthread_mutex_lock(&batch_lock);
+    if (atomic_load(&batching)) {
+        uint64_t requested = ++batch_flush_requested;
+        pthread_cond_signal(&batch_wake);
+        while (batch_flush_done < requested) {
+            pthread_cond_wait(&batch_flushed, &batch_lock);
+        }
+    }
+    pthread_mutex_unlock(&batch_lock);
+}
+
+void statsd_writer_get_batch_stats(struct stats_log_batch_stats* stats) {
+    pthread_mutex_lock(&batch_lock);
+    *stats = batch_stats;
+    pthread_mutex_unlock(&batch_lock);
+}
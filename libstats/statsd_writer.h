@@ -19,6 +19,7 @@
 
 #include <pthread.h>
 #include <stdatomic.h>
+#include <stddef.h>
 #include <sys/socket.h>
 
 /**
@@ -30,6 +31,11 @@ void statsd_writer_init_lock();
 int statsd_writer_init_trylock();
 void statsd_writer_init_unlock();
 
+struct stats_log_batch_stats;
+int statsd_writer_start_batching(size_t max_bytes, unsigned flush_delay_ms);
+void statsd_writer_flush();
+void statsd_writer_get_batch_stats(struct stats_log_batch_stats* stats);
+
 struct android_log_transport_write {
     const char* name; /* human name to describe the transport */
     atomic_int sock;
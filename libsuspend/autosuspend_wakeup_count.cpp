@@ -18,6 +18,7 @@
 //#define LOG_NDEBUG 0
 
 #include <fcntl.h>
+#include <inttypes.h>
 #include <pthread.h>
 #include <semaphore.h>
 #include <stdbool.h>
@@ -28,8 +29,12 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <chrono>
+
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 
 #include "autosuspend_ops.h"
@@ -40,7 +45,7 @@
 static int state_fd = -1;
 static int wakeup_count_fd;
 
-using android::base::ReadFdToString;
+using android::base::StringAppendF;
 using android::base::Trim;
 using android::base::WriteStringToFd;
 
@@ -53,33 +58,96 @@ static constexpr char sys_power_state[] = "/sys/power/state";
 static constexpr char sys_power_wakeup_count[] = "/sys/power/wakeup_count";
 static bool autosuspend_is_init = false;
 
-static void update_sleep_time(bool success) {
-    if (success) {
-        sleep_time = BASE_SLEEP_TIME;
+enum class attempt_result {
+    // The system suspended and resumed.
+    suspended,
+    // A wakeup event was reported between reading and writing wakeup_count.
+    count_changed,
+    // Writing to /sys/power/state failed: a wakeup event or a driver aborted the suspend.
+    aborted,
+    // wakeup_count couldn't be read.
+    error,
+};
+
+// Histogram of the time between the end of one suspend attempt (the resume, or the
+// failure) and the start of the next one: how long the SoC stays awake for nothing.
+// Bucket i counts latencies below 2^i ms; the last one counts everything above.
+static constexpr size_t kLatencyBuckets = 16;
+static std::atomic<uint64_t> latency_histogram[kLatencyBuckets];
+static std::atomic<uint64_t> attempt_counts[4];
+static std::chrono::steady_clock::time_point last_attempt_end;
+
+static void record_latency(std::chrono::steady_clock::time_point attempt_start) {
+    if (last_attempt_end == std::chrono::steady_clock::time_point()) {
         return;
     }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(attempt_start -
+                                                                    last_attempt_end)
+                      .count();
+    size_t bucket = 0;
+    while (bucket < kLatencyBuckets - 1 && ms >= (1LL << bucket)) {
+        bucket++;
+    }
+    latency_histogram[bucket]++;
+}
+
+// The fds stay open for the life of the thread; sysfs attributes are always read and
+// written from offset 0, so there's no need to seek between uses.
+static bool read_wakeup_count(std::string* wakeup_count) {
+    char buf[32];
+    ssize_t n = TEMP_FAILURE_RETRY(pread(wakeup_count_fd, buf, sizeof(buf) - 1, 0));
+    if (n < 0) {
+        PLOG(ERROR) << "error reading from " << sys_power_wakeup_count;
+        return false;
+    }
+    buf[n] = '\0';
+    *wakeup_count = Trim(buf);
+    if (wakeup_count->empty()) {
+        LOG(ERROR) << "empty wakeup count";
+        return false;
+    }
+    return true;
+}
+
+static bool write_attribute(int fd, const std::string& value) {
+    ssize_t n = TEMP_FAILURE_RETRY(pwrite(fd, value.data(), value.size(), 0));
+    return n == static_cast<ssize_t>(value.size());
+}
+
+static void update_sleep_time(attempt_result result, const std::string& wakeup_count) {
+    switch (result) {
+        case attempt_result::suspended:
+        case attempt_result::count_changed:
+            // Reading wakeup_count blocks until the pending wakeup events are processed,
+            // so there's nothing to gain from waiting longer before trying again.
+            sleep_time = BASE_SLEEP_TIME;
+            return;
+        case attempt_result::aborted: {
+            // If wakeup sources reported events since we wrote wakeup_count, one of them
+            // aborted the suspend and has been handled by now. Otherwise a driver refused
+            // to suspend, and retrying quickly would just keep failing.
+            std::string current;
+            if (read_wakeup_count(&current) && current != wakeup_count) {
+                sleep_time = BASE_SLEEP_TIME;
+                return;
+            }
+            break;
+        }
+        case attempt_result::error:
+            break;
+    }
     // double sleep time after each failure up to one minute
     sleep_time = MIN(sleep_time * 2, MAX_SLEEP_TIME);
 }
 
 static void* suspend_thread_func(void* arg __attribute__((unused))) {
-    bool success = true;
-
     while (true) {
-        update_sleep_time(success);
         usleep(sleep_time);
-        success = false;
+        attempt_result result = attempt_result::error;
         LOG(VERBOSE) << "read wakeup_count";
-        lseek(wakeup_count_fd, 0, SEEK_SET);
         std::string wakeup_count;
-        if (!ReadFdToString(wakeup_count_fd, &wakeup_count)) {
-            PLOG(ERROR) << "error reading from " << sys_power_wakeup_count;
-            continue;
-        }
-
-        wakeup_count = Trim(wakeup_count);
-        if (wakeup_count.empty()) {
-            LOG(ERROR) << "empty wakeup count";
+        if (!read_wakeup_count(&wakeup_count)) {
+            update_sleep_time(result, wakeup_count);
             continue;
         }
 
@@ -87,20 +155,25 @@ static void* suspend_thread_func(void* arg __attribute__((unused))) {
         int ret = sem_wait(&suspend_lockout);
         if (ret < 0) {
             PLOG(ERROR) << "error waiting on semaphore";
+            update_sleep_time(result, wakeup_count);
             continue;
         }
 
         LOG(VERBOSE) << "write " << wakeup_count << " to wakeup_count";
-        if (WriteStringToFd(wakeup_count, wakeup_count_fd)) {
+        if (write_attribute(wakeup_count_fd, wakeup_count)) {
             LOG(VERBOSE) << "write " << sleep_state << " to " << sys_power_state;
-            success = WriteStringToFd(sleep_state, state_fd);
+            record_latency(std::chrono::steady_clock::now());
+            bool success = write_attribute(state_fd, sleep_state);
+            last_attempt_end = std::chrono::steady_clock::now();
+            result = success ? attempt_result::suspended : attempt_result::aborted;
 
             void (*func)(bool success) = wakeup_func;
             if (func != NULL) {
                 (*func)(success);
             }
         } else {
-            PLOG(ERROR) << "error writing to " << sys_power_wakeup_count;
+            PLOG(VERBOSE) << "error writing to " << sys_power_wakeup_count;
+            result = attempt_result::count_changed;
         }
 
         LOG(VERBOSE) << "release sem";
@@ -108,6 +181,9 @@ static void* suspend_thread_func(void* arg __attribute__((unused))) {
         if (ret < 0) {
             PLOG(ERROR) << "error releasing semaphore";
         }
+
+        attempt_counts[static_cast<int>(result)]++;
+        update_sleep_time(result, wakeup_count);
     }
     return NULL;
 }
@@ -216,6 +292,28 @@ static int force_suspend(int timeout_ms) {
     return WriteStringToFd(sleep_state, state_fd) ? 0 : -1;
 }
 
+static void autosuspend_wakeup_count_dump(int fd) {
+    std::string out = "autosuspend (wakeup_count):\n";
+    StringAppendF(&out, "  suspended: %" PRIu64 "\n",
+                  attempt_counts[static_cast<int>(attempt_result::suspended)].load());
+    StringAppendF(&out, "  aborted: %" PRIu64 "\n",
+                  attempt_counts[static_cast<int>(attempt_result::aborted)].load());
+    StringAppendF(&out, "  wakeup count changed: %" PRIu64 "\n",
+                  attempt_counts[static_cast<int>(attempt_result::count_changed)].load());
+    StringAppendF(&out, "  current backoff: %d us\n", sleep_time);
+    out += "  resume to next suspend attempt:\n";
+    for (size_t i = 0; i < kLatencyBuckets; i++) {
+        uint64_t count = latency_histogram[i].load();
+        if (count == 0) continue;
+        if (i == kLatencyBuckets - 1) {
+            StringAppendF(&out, "    >= %lld ms: %" PRIu64 "\n", 1LL << (i - 1), count);
+        } else {
+            StringAppendF(&out, "    < %lld ms: %" PRIu64 "\n", 1LL << i, count);
+        }
+    }
+    WriteStringToFd(out, fd);
+}
+
 static void autosuspend_set_wakeup_callback(void (*func)(bool success)) {
     if (wakeup_func != NULL) {
         LOG(ERROR) << "duplicate wakeup callback applied, keeping original";
@@ -229,6 +327,7 @@ struct autosuspend_ops autosuspend_wakeup_count_ops = {
     .disable = autosuspend_wakeup_count_disable,
     .force_suspend = force_suspend,
     .set_wakeup_callback = autosuspend_set_wakeup_callback,
+    .dump = autosuspend_wakeup_count_dump,
 };
 
 struct autosuspend_ops* autosuspend_wakeup_count_init(void) {
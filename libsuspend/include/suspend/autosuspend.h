@@ -64,6 +64,15 @@ int autosuspend_force_suspend(int timeout_ms);
  */
 void autosuspend_set_wakeup_callback(void (*func)(bool success));
 
+/*
+ * autosuspend_dump
+ *
+ * Writes suspend attempt statistics to fd, in a human readable form suitable for
+ * dumpsys: how attempts ended, the current retry backoff, and a histogram of how
+ * long the system stayed awake between resuming and trying to suspend again.
+ */
+void autosuspend_dump(int fd);
+
 __END_DECLS
 
 #endif
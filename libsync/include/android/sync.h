@@ -37,6 +37,8 @@
  * break builds.
  */
 
+#include <stddef.h>
+
 #include "../ndk/sync.h"
 
 __BEGIN_DECLS
@@ -44,6 +46,28 @@ __BEGIN_DECLS
 /* timeout in msecs */
 int sync_wait(int fd, int timeout);
 
+/* Merges the "count" fences in "fds" into one, stored in "merged". Fences that
+ * have already signaled without error, duplicates and -1 entries are left out,
+ * and the rest are merged pairwise as a balanced tree. If a single fence is
+ * left, "merged" is a dup of it, and if none is, "merged" is -1. The fences in
+ * "fds" stay owned by the caller.
+ *
+ * Returns 0 on success, or -1 with errno set.
+ */
+int sync_merge_fences(const char* name, const int32_t* fds, size_t count, int32_t* merged);
+
+/* Waits for the "count" fences in "fds", polling all of them at once, until
+ * all of them have signaled if "wait_all" is non-zero, or until any of them
+ * has otherwise.
+ * "timeout" is in msecs, and -1 waits forever. If "signaled" isn't NULL, entry
+ * i is set to 1 if fence i has signaled and 0 otherwise, also on timeout.
+ *
+ * Returns the number of fences that have signaled, or -1 with errno set to
+ * ETIME on timeout and EINVAL for invalid fences.
+ */
+int sync_wait_fences(const int32_t* fds, size_t count, int timeout, int wait_all,
+                     uint8_t* signaled);
+
 __END_DECLS
 
 #endif /* __SYS_CORE_SYNC_H */
@@ -23,6 +23,8 @@
 #include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <sys/ioctl.h>
 #include <sys/stat.h>
@@ -206,6 +208,83 @@ int sync_merge(const char *name, int fd1, int fd2)
     return ret;
 }
 
+static int64_t monotonic_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int sync_wait_fences(const int32_t *fds, size_t count, int timeout,
+                     int wait_all, uint8_t *signaled)
+{
+    struct pollfd *pfds;
+    size_t num_signaled = 0;
+    size_t i;
+    int64_t deadline = 0;
+    int ret;
+
+    if (count == 0 || count > INT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    pfds = calloc(count, sizeof(*pfds));
+    if (!pfds)
+        return -1;
+    for (i = 0; i < count; i++) {
+        if (fds[i] < 0) {
+            free(pfds);
+            errno = EINVAL;
+            return -1;
+        }
+        pfds[i].fd = fds[i];
+        pfds[i].events = POLLIN;
+        if (signaled)
+            signaled[i] = 0;
+    }
+    if (timeout > 0)
+        deadline = monotonic_ms() + timeout;
+
+    for (;;) {
+        ret = poll(pfds, count, timeout);
+        if (ret < 0) {
+            if (errno != EINTR && errno != EAGAIN)
+                break;
+        } else if (ret == 0) {
+            errno = ETIME;
+            ret = -1;
+            break;
+        } else {
+            for (i = 0; i < count; i++) {
+                if (pfds[i].fd < 0 || !pfds[i].revents)
+                    continue;
+                if (pfds[i].revents & (POLLERR | POLLNVAL)) {
+                    free(pfds);
+                    errno = EINVAL;
+                    return -1;
+                }
+                /* A negative fd makes poll() skip the entry from now on. */
+                pfds[i].fd = -1;
+                if (signaled)
+                    signaled[i] = 1;
+                num_signaled++;
+            }
+            if (!wait_all || num_signaled == count) {
+                ret = (int)num_signaled;
+                break;
+            }
+        }
+        if (timeout > 0) {
+            int64_t remaining = deadline - monotonic_ms();
+            timeout = remaining > 0 ? (int)remaining : 0;
+        }
+    }
+
+    free(pfds);
+    return ret;
+}
+
 static struct sync_fence_info_data *legacy_sync_fence_info(int fd)
 {
     struct sync_fence_info_data *legacy_info;
@@ -408,6 +487,133 @@ void sync_file_info_free(struct sync_file_info *info)
     free(info);
 }
 
+/* Returns 1 if the fence has signaled without error, so that a merge can leave
+ * it out. Fences that signaled with an error are kept to pass the error on.
+ */
+static int sync_fence_signaled_ok(int fd)
+{
+    struct sync_file_info *info;
+    int ok;
+
+    info = sync_file_info(fd);
+    ok = info && info->status == 1;
+    sync_file_info_free(info);
+    return ok;
+}
+
+struct sync_merge_entry {
+    int32_t fd;
+    int owned;
+};
+
+int sync_merge_fences(const char *name, const int32_t *fds, size_t count,
+                      int32_t *merged)
+{
+    struct pollfd *pfds = NULL;
+    struct sync_merge_entry *pending = NULL;
+    size_t num_pending = 0;
+    size_t i, j, n;
+    int saved_errno;
+    int ret = -1;
+
+    if (!merged || (count && !fds) || count > INT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    *merged = -1;
+    if (count == 0)
+        return 0;
+
+    pfds = calloc(count, sizeof(*pfds));
+    pending = calloc(count, sizeof(*pending));
+    if (!pfds || !pending)
+        goto out;
+
+    /* One poll tells which fences have already signaled. Entries of -1 are
+     * ignored by poll() and skipped below.
+     */
+    for (i = 0; i < count; i++) {
+        pfds[i].fd = fds[i];
+        pfds[i].events = POLLIN;
+    }
+    do {
+        ret = poll(pfds, count, 0);
+    } while (ret == -1 && (errno == EINTR || errno == EAGAIN));
+    if (ret < 0)
+        goto out;
+
+    for (i = 0; i < count; i++) {
+        if (fds[i] < 0)
+            continue;
+        if (pfds[i].revents & POLLNVAL) {
+            errno = EINVAL;
+            ret = -1;
+            goto out;
+        }
+        if ((pfds[i].revents & POLLIN) && sync_fence_signaled_ok(fds[i]))
+            continue;
+        for (j = 0; j < num_pending && pending[j].fd != fds[i]; j++)
+            ;
+        if (j == num_pending)
+            pending[num_pending++].fd = fds[i];
+    }
+
+    ret = 0;
+    if (num_pending == 1) {
+        *merged = fcntl(pending[0].fd, F_DUPFD_CLOEXEC, 0);
+        if (*merged < 0)
+            ret = -1;
+        num_pending = 0;
+    }
+
+    /* The kernel only merges two fences at a time, and each merge copies the
+     * points of both. Merging neighbours level by level copies every point
+     * log2(n) times, where folding them into one growing fence would copy the
+     * first ones n times.
+     */
+    while (num_pending > 1) {
+        for (i = 0, n = 0; i < num_pending; i += 2, n++) {
+            if (i + 1 == num_pending) {
+                pending[n] = pending[i];
+                continue;
+            }
+            ret = sync_merge(name, pending[i].fd, pending[i + 1].fd);
+            if (ret < 0)
+                break;
+            if (pending[i].owned)
+                close(pending[i].fd);
+            if (pending[i + 1].owned)
+                close(pending[i + 1].fd);
+            pending[n].fd = ret;
+            pending[n].owned = 1;
+        }
+        if (ret < 0) {
+            /* The entries from n on weren't consumed yet. */
+            saved_errno = errno;
+            for (j = 0; j < n; j++)
+                close(pending[j].fd);
+            for (j = i; j < num_pending; j++) {
+                if (pending[j].owned)
+                    close(pending[j].fd);
+            }
+            errno = saved_errno;
+            goto out;
+        }
+        num_pending = n;
+        if (num_pending == 1) {
+            *merged = pending[0].fd;
+            ret = 0;
+        }
+    }
+
+out:
+    saved_errno = errno;
+    free(pfds);
+    free(pending);
+    errno = saved_errno;
+    return ret < 0 ? -1 : 0;
+}
+
 
 int sw_sync_timeline_create(void)
 {
@@ -154,6 +154,11 @@ public:
             setFd(fd);
         }
     }
+    // Takes ownership of an fd returned by the library.
+    explicit SyncFence(int fd) noexcept {
+        if (fd >= 0)
+            setFd(fd);
+    }
     SyncFence(const SyncTimeline &timeline,
               int value,
               const char *name = nullptr) noexcept {
@@ -477,6 +482,84 @@ TEST(FenceTest, MultiTimelineWait) {
     ASSERT_EQ(mergedFence.wait(100), 0);
 }
 
+TEST(FenceTest, MergeFences) {
+    SyncTimeline timelineA, timelineB, timelineC;
+
+    SyncFence fenceA(timelineA, 5);
+    SyncFence fenceB(timelineB, 5);
+    SyncFence fenceC(timelineC, 5);
+    SyncFence signaledFence(timelineC, 0);
+
+    // Signaled fences, duplicates and -1 entries are left out of the merge.
+    int32_t fds[] = {fenceA.getFd(), -1, signaledFence.getFd(), fenceB.getFd(),
+                     fenceA.getFd(), fenceC.getFd()};
+    int32_t merged = -1;
+    ASSERT_EQ(sync_merge_fences("mergeFences", fds, 6, &merged), 0);
+    ASSERT_GE(merged, 0);
+    SyncFence mergedFence(merged);
+    ASSERT_EQ(mergedFence.getSize(), 3);
+    ASSERT_EQ(mergedFence.getActiveCount(), 3);
+
+    timelineA.inc(5);
+    timelineB.inc(5);
+    ASSERT_EQ(mergedFence.getActiveCount(), 1);
+    timelineC.inc(5);
+    ASSERT_EQ(mergedFence.wait(100), 0);
+
+    // Once everything has signaled, there is nothing left to merge.
+    ASSERT_EQ(sync_merge_fences("mergeFences", fds, 6, &merged), 0);
+    ASSERT_EQ(merged, -1);
+}
+
+TEST(FenceTest, MergeFencesSingle) {
+    SyncTimeline timeline;
+    SyncFence fence(timeline, 1);
+
+    int32_t fds[] = {fence.getFd(), fence.getFd()};
+    int32_t merged = -1;
+    ASSERT_EQ(sync_merge_fences("mergeFences", fds, 2, &merged), 0);
+    ASSERT_GE(merged, 0);
+    ASSERT_NE(merged, fence.getFd());
+    SyncFence mergedFence(merged);
+    ASSERT_EQ(mergedFence.getActiveCount(), 1);
+}
+
+TEST(FenceTest, WaitFences) {
+    SyncTimeline timelineA, timelineB;
+
+    SyncFence fenceA(timelineA, 5);
+    SyncFence fenceB(timelineB, 5);
+    int32_t fds[] = {fenceA.getFd(), fenceB.getFd()};
+    uint8_t signaled[2];
+
+    ASSERT_EQ(sync_wait_fences(fds, 2, 0, 0, signaled), -1);
+    ASSERT_EQ(errno, ETIME);
+
+    timelineB.inc(5);
+    ASSERT_EQ(sync_wait_fences(fds, 2, 100, 0, signaled), 1);
+    ASSERT_EQ(signaled[0], 0);
+    ASSERT_EQ(signaled[1], 1);
+
+    // Waiting for all of them still times out, but tells which ones signaled.
+    ASSERT_EQ(sync_wait_fences(fds, 2, 10, 1, signaled), -1);
+    ASSERT_EQ(errno, ETIME);
+    ASSERT_EQ(signaled[0], 0);
+    ASSERT_EQ(signaled[1], 1);
+
+    thread signaler([&timelineA]() {
+        usleep(10000);
+        timelineA.inc(5);
+    });
+    ASSERT_EQ(sync_wait_fences(fds, 2, -1, 1, signaled), 2);
+    ASSERT_EQ(signaled[0], 1);
+    ASSERT_EQ(signaled[1], 1);
+    signaler.join();
+
+    int32_t badFds[] = {fenceA.getFd(), -1};
+    ASSERT_EQ(sync_wait_fences(badFds, 2, 0, 0, nullptr), -1);
+    ASSERT_EQ(errno, EINVAL);
+}
+
 TEST(FenceTest, GetInfoActive) {
     SyncTimeline timeline;
     ASSERT_TRUE(timeline.isValid());
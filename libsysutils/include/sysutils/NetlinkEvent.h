@@ -42,11 +42,16 @@ private:
     Action mAction;
     char *mSubsystem;
     char *mParams[NL_PARAMS_MAX];
+    // Whether the strings above point into the buffer passed to decode()
+    // rather than being owned by the event.
+    bool mBorrowsBuffer;
 
 public:
     NetlinkEvent();
     virtual ~NetlinkEvent();
 
+    // ASCII events refer to |buffer| rather than copying out of it, so it
+    // must outlive the event and not be reused until then.
     bool decode(char *buffer, int size, int format = NetlinkListener::NETLINK_FORMAT_ASCII);
     const char *findParam(const char *paramName);
 
@@ -44,6 +44,9 @@ public:
 protected:
     virtual bool onDataAvailable(SocketClient *cli);
     virtual void onEvent(NetlinkEvent *evt) = 0;
+
+private:
+    bool receiveUevents(int socket);
 };
 
 #endif
@@ -60,6 +60,9 @@ public:
     int sendData(const void *data, int len);
     // iovec contents not preserved through call
     int sendDatav(struct iovec *iov, int iovcnt);
+    // Send each of count iovecs as a packet of its own, as many per system
+    // call as possible. Only for SOCK_SEQPACKET or SOCK_DGRAM sockets.
+    int sendPacketsv(struct iovec *iov, int count);
 
     // Optional reference counting.  Reference count starts at 1.  If
     // it's decremented to 0, it deletes itself.
@@ -17,8 +17,11 @@
 #define _SOCKETLISTENER_H
 
 #include <pthread.h>
+#include <stdint.h>
 
+#include <deque>
 #include <unordered_map>
+#include <vector>
 
 #include <sysutils/SocketClient.h>
 #include "SocketClientCommand.h"
@@ -32,6 +35,13 @@ class SocketListener {
     int                     mCtrlPipe[2];
     pthread_t               mThread;
     bool                    mUseCmdNum;
+    int                     mEpollFd;
+    uint32_t                mClientEvents;
+    std::vector<pthread_t>  mWorkers;
+    std::deque<SocketClient*> mPending;
+    pthread_mutex_t         mPendingLock;
+    pthread_cond_t          mPendingCond;
+    bool                    mStopWorkers;
 
 public:
     SocketListener(const char *socketName, bool listen);
@@ -41,26 +51,38 @@ public:
     virtual ~SocketListener();
     int startListener();
     int startListener(int backlog);
+    // Like startListener(backlog), but with onDataAvailable() called on a pool
+    // of |workers| threads instead of the listener thread, so that a client that
+    // takes long to handle doesn't hold up the others. A client is only handed
+    // to one worker at a time, so its data is still handled in order, but
+    // onDataAvailable() must be safe to call for different clients at once.
+    int startListener(int backlog, size_t workers);
     int stopListener();
 
     void sendBroadcast(int code, const char *msg, bool addErrno);
 
     void runOnEachSocket(SocketClientCommand *command);
 
-    bool release(SocketClient *c) { return release(c, true); }
+    bool release(SocketClient *c);
 
 protected:
     virtual bool onDataAvailable(SocketClient *c) = 0;
 
 private:
     static void *threadStart(void *obj);
+    static void *workerStart(void *obj);
 
     // Add all clients to a separate list, so we don't have to hold the lock
     // while processing it.
     std::vector<SocketClient*> snapshotClients();
 
-    bool release(SocketClient *c, bool wakeup);
+    // Adds |fd| to the epoll set, readable events are then reported for it.
+    bool watch(int fd, uint32_t events);
+    // Calls onDataAvailable() and drops the reference the caller took on |c|.
+    void dispatch(SocketClient *c);
     void runListener();
+    void runWorker();
+    void stopWorkers();
     void init(const char *socketName, int socketFd, bool listen, bool useCmdNum);
 };
 #endif
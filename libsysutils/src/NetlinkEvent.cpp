@@ -50,10 +50,13 @@ NetlinkEvent::NetlinkEvent() {
     memset(mParams, 0, sizeof(mParams));
     mPath = nullptr;
     mSubsystem = nullptr;
+    mBorrowsBuffer = false;
 }
 
 NetlinkEvent::~NetlinkEvent() {
     int i;
+    if (mBorrowsBuffer)
+        return;
     if (mPath)
         free(mPath);
     if (mSubsystem)
@@ -601,10 +604,13 @@ has_prefix(const char* str, const char* end, const char* prefix, size_t prefixle
 /*
  * Parse an ASCII-formatted message from a NETLINK_KOBJECT_UEVENT
  * netlink socket.
+ *
+ * The strings of a uevent are already NUL-separated, so the path, subsystem
+ * and parameters point into the buffer instead of being copied out of it.
  */
 bool NetlinkEvent::parseAsciiNetlinkMessage(char *buffer, int size) {
-    const char *s = buffer;
-    const char *end;
+    char *s = buffer;
+    char *end;
     int param_idx = 0;
     int first = 1;
 
@@ -614,17 +620,18 @@ bool NetlinkEvent::parseAsciiNetlinkMessage(char *buffer, int size) {
     /* Ensure the buffer is zero-terminated, the code below depends on this */
     buffer[size-1] = '\0';
 
+    mBorrowsBuffer = true;
     end = s + size;
     while (s < end) {
         if (first) {
-            const char *p;
+            char *p;
             /* buffer is 0-terminated, no need to check p < end */
             for (p = s; *p != '@'; p++) {
                 if (!*p) { /* no '@', should not happen */
                     return false;
                 }
             }
-            mPath = strdup(p+1);
+            mPath = p+1;
             first = 0;
         } else {
             const char* a;
@@ -640,9 +647,9 @@ bool NetlinkEvent::parseAsciiNetlinkMessage(char *buffer, int size) {
                     SLOGE("NetlinkEvent::parseAsciiNetlinkMessage: failed to parse SEQNUM=%s", a);
                 }
             } else if ((a = HAS_CONST_PREFIX(s, end, "SUBSYSTEM=")) != nullptr) {
-                mSubsystem = strdup(a);
+                mSubsystem = s + CONST_STRLEN("SUBSYSTEM=");
             } else if (param_idx < NL_PARAMS_MAX) {
-                mParams[param_idx++] = strdup(s);
+                mParams[param_idx++] = s;
             }
         }
         s += strlen(s) + 1;
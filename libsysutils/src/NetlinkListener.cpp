@@ -20,6 +20,7 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <linux/netlink.h> /* out of order because must follow sys/socket.h */
@@ -46,6 +47,11 @@ NetlinkListener::NetlinkListener(int socket, int format) :
 bool NetlinkListener::onDataAvailable(SocketClient *cli)
 {
     int socket = cli->getSocket();
+
+    if (mFormat == NETLINK_FORMAT_ASCII) {
+        return receiveUevents(socket);
+    }
+
     ssize_t count;
     uid_t uid = -1;
 
@@ -61,15 +67,52 @@ bool NetlinkListener::onDataAvailable(SocketClient *cli)
         return false;
     }
 
-    NetlinkEvent *evt = new NetlinkEvent();
-    if (evt->decode(mBuffer, count, mFormat)) {
-        onEvent(evt);
+    NetlinkEvent evt;
+    if (evt.decode(mBuffer, count, mFormat)) {
+        onEvent(&evt);
     } else if (mFormat != NETLINK_FORMAT_BINARY) {
         // Don't complain if parseBinaryNetlinkMessage returns false. That can
         // just mean that the buffer contained no messages we're interested in.
         SLOGE("Error decoding NetlinkEvent");
     }
+    return true;
+}
 
-    delete evt;
+/*
+ * Uevents are at most 2048 bytes (UEVENT_BUFFER_SIZE in the kernel), so the
+ * buffer is split into slots to receive a whole batch of them at once. The
+ * events refer to their slot, which stays untouched until the next batch.
+ */
+bool NetlinkListener::receiveUevents(int socket)
+{
+    static constexpr size_t kBatchSize = 16;
+    static constexpr size_t kSlotSize = sizeof(mBuffer) / kBatchSize;
+    static_assert(kBatchSize <= UEVENT_MAX_BATCH, "batch too large for uevent_kernel_recv_batch");
+
+    struct iovec iovs[kBatchSize];
+    ssize_t lengths[kBatchSize];
+    for (size_t i = 0; i < kBatchSize; i++) {
+        iovs[i].iov_base = mBuffer + i * kSlotSize;
+        iovs[i].iov_len = kSlotSize;
+    }
+
+    int n = TEMP_FAILURE_RETRY(uevent_kernel_recv_batch(socket, iovs, lengths, kBatchSize, true));
+    if (n < 0) {
+        SLOGE("recvmmsg failed (%s)", strerror(errno));
+        return false;
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (lengths[i] < 0) {
+            SLOGE("recvmmsg failed (%s)", strerror(EIO));
+            return false;
+        }
+        NetlinkEvent evt;
+        if (evt.decode(static_cast<char*>(iovs[i].iov_base), lengths[i], mFormat)) {
+            onEvent(&evt);
+        } else {
+            SLOGE("Error decoding NetlinkEvent");
+        }
+    }
     return true;
 }
@@ -190,6 +190,56 @@ int SocketClient::sendDatav(struct iovec *iov, int iovcnt) {
     return rc;
 }
 
+int SocketClient::sendPacketsv(struct iovec *iov, int count) {
+    static const int maxPackets = 64;
+    struct mmsghdr msgs[maxPackets];
+
+    if (mSocket < 0) {
+        errno = EHOSTUNREACH;
+        return -1;
+    }
+
+    int ret = 0;
+    int e = 0; // SLOGW is not inert regarding errno
+    int current = 0;
+
+    pthread_mutex_lock(&mWriteMutex);
+    while (current < count) {
+        int batch = count - current;
+        if (batch > maxPackets) {
+            batch = maxPackets;
+        }
+        memset(msgs, 0, sizeof(msgs[0]) * batch);
+        for (int i = 0; i < batch; ++i) {
+            msgs[i].msg_hdr.msg_iov = &iov[current + i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int rc = TEMP_FAILURE_RETRY(
+            sendmmsg(mSocket, msgs, batch, MSG_NOSIGNAL));
+        if (rc > 0) {
+            current += rc;
+            continue;
+        }
+
+        if (rc == 0) {
+            e = EIO;
+            SLOGW("0 length write :(");
+        } else {
+            e = errno;
+            SLOGW("write error (%s)", strerror(e));
+        }
+        ret = -1;
+        break;
+    }
+    pthread_mutex_unlock(&mWriteMutex);
+
+    if (e != 0) {
+        errno = e;
+    }
+    return ret;
+}
+
 int SocketClient::sendDataLockedv(struct iovec *iov, int iovcnt) {
 
     if (mSocket < 0) {
@@ -19,7 +19,7 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/poll.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -34,7 +34,6 @@
 #include <sysutils/SocketClient.h>
 
 #define CtrlPipe_Shutdown 0
-#define CtrlPipe_Wakeup   1
 
 SocketListener::SocketListener(const char *socketName, bool listen) {
     init(socketName, -1, listen, false);
@@ -53,7 +52,14 @@ void SocketListener::init(const char *socketName, int socketFd, bool listen, boo
     mSocketName = socketName;
     mSock = socketFd;
     mUseCmdNum = useCmdNum;
+    mCtrlPipe[0] = -1;
+    mCtrlPipe[1] = -1;
+    mEpollFd = -1;
+    mClientEvents = EPOLLIN;
+    mStopWorkers = false;
     pthread_mutex_init(&mClientsLock, nullptr);
+    pthread_mutex_init(&mPendingLock, nullptr);
+    pthread_cond_init(&mPendingCond, nullptr);
 }
 
 SocketListener::~SocketListener() {
@@ -64,6 +70,9 @@ SocketListener::~SocketListener() {
         close(mCtrlPipe[0]);
         close(mCtrlPipe[1]);
     }
+    if (mEpollFd != -1) {
+        close(mEpollFd);
+    }
     for (auto pair : mClients) {
         pair.second->decRef();
     }
@@ -74,6 +83,10 @@ int SocketListener::startListener() {
 }
 
 int SocketListener::startListener(int backlog) {
+    return startListener(backlog, 0);
+}
+
+int SocketListener::startListener(int backlog, size_t workers) {
 
     if (!mSocketName && mSock == -1) {
         SLOGE("Failed to start unbound listener");
@@ -100,14 +113,49 @@ int SocketListener::startListener(int backlog) {
         return -1;
     }
 
+    // With workers, a client is only reported again once its worker is done
+    // with it, see dispatch().
+    mClientEvents = workers > 0 ? (EPOLLIN | EPOLLONESHOT) : EPOLLIN;
+
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEpollFd == -1) {
+        SLOGE("epoll_create1 failed (%s)", strerror(errno));
+        return -1;
+    }
+    if (!watch(mCtrlPipe[0], EPOLLIN) || !watch(mSock, mListen ? EPOLLIN : mClientEvents)) {
+        return -1;
+    }
+
+    mWorkers.resize(workers);
+    for (size_t i = 0; i < workers; i++) {
+        if (pthread_create(&mWorkers[i], nullptr, SocketListener::workerStart, this)) {
+            SLOGE("pthread_create (%s)", strerror(errno));
+            mWorkers.resize(i);
+            stopWorkers();
+            return -1;
+        }
+    }
+
     if (pthread_create(&mThread, nullptr, SocketListener::threadStart, this)) {
         SLOGE("pthread_create (%s)", strerror(errno));
+        stopWorkers();
         return -1;
     }
 
     return 0;
 }
 
+bool SocketListener::watch(int fd, uint32_t events) {
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        SLOGE("epoll_ctl ADD %d failed (%s)", fd, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
 int SocketListener::stopListener() {
     char c = CtrlPipe_Shutdown;
     int  rc;
@@ -123,10 +171,14 @@ int SocketListener::stopListener() {
         SLOGE("Error joining to listener thread (%s)", strerror(errno));
         return -1;
     }
+    stopWorkers();
+
     close(mCtrlPipe[0]);
     close(mCtrlPipe[1]);
     mCtrlPipe[0] = -1;
     mCtrlPipe[1] = -1;
+    close(mEpollFd);
+    mEpollFd = -1;
 
     if (mSocketName && mSock > -1) {
         close(mSock);
@@ -148,82 +200,159 @@ void *SocketListener::threadStart(void *obj) {
     return nullptr;
 }
 
-void SocketListener::runListener() {
-    while (true) {
-        std::vector<pollfd> fds;
+void *SocketListener::workerStart(void *obj) {
+    SocketListener *me = reinterpret_cast<SocketListener *>(obj);
 
-        pthread_mutex_lock(&mClientsLock);
-        fds.reserve(2 + mClients.size());
-        fds.push_back({.fd = mCtrlPipe[0], .events = POLLIN});
-        if (mListen) fds.push_back({.fd = mSock, .events = POLLIN});
-        for (auto pair : mClients) {
-            // NB: calling out to an other object with mClientsLock held (safe)
-            const int fd = pair.second->getSocket();
-            if (fd != pair.first) SLOGE("fd mismatch: %d != %d", fd, pair.first);
-            fds.push_back({.fd = fd, .events = POLLIN});
-        }
-        pthread_mutex_unlock(&mClientsLock);
+    me->runWorker();
+    pthread_exit(nullptr);
+    return nullptr;
+}
 
+void SocketListener::runListener() {
+    // The clients are registered with epoll as they come and go, so there's
+    // nothing to collect before waiting.
+    epoll_event events[32];
+    while (true) {
         SLOGV("mListen=%d, mSocketName=%s", mListen, mSocketName);
-        int rc = TEMP_FAILURE_RETRY(poll(fds.data(), fds.size(), -1));
+        int rc = TEMP_FAILURE_RETRY(epoll_wait(mEpollFd, events, 32, -1));
         if (rc < 0) {
-            SLOGE("poll failed (%s) mListen=%d", strerror(errno), mListen);
+            SLOGE("epoll_wait failed (%s) mListen=%d", strerror(errno), mListen);
             sleep(1);
             continue;
         }
 
-        if (fds[0].revents & (POLLIN | POLLERR)) {
+        // Add all active clients to the pending list first, so we can release
+        // the lock before invoking the callbacks.
+        std::vector<SocketClient*> pending;
+        bool shutdown = false;
+        bool incoming = false;
+        pthread_mutex_lock(&mClientsLock);
+        for (int i = 0; i < rc; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == mCtrlPipe[0]) {
+                shutdown = true;
+                continue;
+            }
+            if (mListen && fd == mSock) {
+                incoming = true;
+                continue;
+            }
+            auto it = mClients.find(fd);
+            if (it == mClients.end()) {
+                SLOGE("fd vanished: %d", fd);
+                continue;
+            }
+            SocketClient* c = it->second;
+            pending.push_back(c);
+            c->incRef();
+        }
+        pthread_mutex_unlock(&mClientsLock);
+
+        if (shutdown) {
             char c = CtrlPipe_Shutdown;
             TEMP_FAILURE_RETRY(read(mCtrlPipe[0], &c, 1));
-            if (c == CtrlPipe_Shutdown) {
-                break;
-            }
-            continue;
         }
-        if (mListen && (fds[1].revents & (POLLIN | POLLERR))) {
+        if (incoming && !shutdown) {
             int c = TEMP_FAILURE_RETRY(accept4(mSock, nullptr, nullptr, SOCK_CLOEXEC));
             if (c < 0) {
                 SLOGE("accept failed (%s)", strerror(errno));
                 sleep(1);
-                continue;
+            } else {
+                pthread_mutex_lock(&mClientsLock);
+                SocketClient* client = new SocketClient(c, true, mUseCmdNum);
+                if (watch(c, mClientEvents)) {
+                    mClients[c] = client;
+                } else {
+                    client->decRef();
+                }
+                pthread_mutex_unlock(&mClientsLock);
             }
-            pthread_mutex_lock(&mClientsLock);
-            mClients[c] = new SocketClient(c, true, mUseCmdNum);
-            pthread_mutex_unlock(&mClientsLock);
         }
 
-        // Add all active clients to the pending list first, so we can release
-        // the lock before invoking the callbacks.
-        std::vector<SocketClient*> pending;
+        if (shutdown) {
+            for (SocketClient* c : pending) {
+                c->decRef();
+            }
+            break;
+        }
+
+        if (mWorkers.empty()) {
+            for (SocketClient* c : pending) {
+                dispatch(c);
+            }
+        } else if (!pending.empty()) {
+            pthread_mutex_lock(&mPendingLock);
+            mPending.insert(mPending.end(), pending.begin(), pending.end());
+            pthread_cond_broadcast(&mPendingCond);
+            pthread_mutex_unlock(&mPendingLock);
+        }
+    }
+}
+
+void SocketListener::dispatch(SocketClient* c) {
+    const int fd = c->getSocket();
+    // Process it, if false is returned, remove from the map
+    SLOGV("processing fd %d", fd);
+    if (!onDataAvailable(c)) {
+        release(c);
+    }
+
+    // A worker's client stays quiet until it's armed again, so that no other
+    // worker picks up its next data while this one still handles the last.
+    if (mClientEvents & EPOLLONESHOT) {
         pthread_mutex_lock(&mClientsLock);
-        const int size = fds.size();
-        for (int i = mListen ? 2 : 1; i < size; ++i) {
-            const struct pollfd& p = fds[i];
-            if (p.revents & (POLLIN | POLLERR)) {
-                auto it = mClients.find(p.fd);
-                if (it == mClients.end()) {
-                    SLOGE("fd vanished: %d", p.fd);
-                    continue;
-                }
-                SocketClient* c = it->second;
-                pending.push_back(c);
-                c->incRef();
+        if (mClients.find(fd) != mClients.end()) {
+            epoll_event event = {};
+            event.events = mClientEvents;
+            event.data.fd = fd;
+            if (epoll_ctl(mEpollFd, EPOLL_CTL_MOD, fd, &event) == -1) {
+                SLOGE("epoll_ctl MOD %d failed (%s)", fd, strerror(errno));
             }
         }
         pthread_mutex_unlock(&mClientsLock);
+    }
+    c->decRef();
+}
 
-        for (SocketClient* c : pending) {
-            // Process it, if false is returned, remove from the map
-            SLOGV("processing fd %d", c->getSocket());
-            if (!onDataAvailable(c)) {
-                release(c, false);
-            }
-            c->decRef();
+void SocketListener::runWorker() {
+    pthread_mutex_lock(&mPendingLock);
+    while (true) {
+        while (mPending.empty() && !mStopWorkers) {
+            pthread_cond_wait(&mPendingCond, &mPendingLock);
         }
+        if (mStopWorkers) break;
+
+        SocketClient* c = mPending.front();
+        mPending.pop_front();
+        pthread_mutex_unlock(&mPendingLock);
+        dispatch(c);
+        pthread_mutex_lock(&mPendingLock);
     }
+    pthread_mutex_unlock(&mPendingLock);
 }
 
-bool SocketListener::release(SocketClient* c, bool wakeup) {
+void SocketListener::stopWorkers() {
+    pthread_mutex_lock(&mPendingLock);
+    mStopWorkers = true;
+    pthread_cond_broadcast(&mPendingCond);
+    pthread_mutex_unlock(&mPendingLock);
+
+    for (pthread_t worker : mWorkers) {
+        if (pthread_join(worker, nullptr)) {
+            SLOGE("Error joining to worker thread (%s)", strerror(errno));
+        }
+    }
+    mWorkers.clear();
+
+    // Data that no worker got to is dropped, like on the listener thread.
+    for (SocketClient* c : mPending) {
+        c->decRef();
+    }
+    mPending.clear();
+    mStopWorkers = false;
+}
+
+bool SocketListener::release(SocketClient* c) {
     bool ret = false;
     /* if our sockets are connection-based, remove and destroy it */
     if (mListen && c) {
@@ -231,13 +360,14 @@ bool SocketListener::release(SocketClient* c, bool wakeup) {
         SLOGV("going to zap %d for %s", c->getSocket(), mSocketName);
         pthread_mutex_lock(&mClientsLock);
         ret = (mClients.erase(c->getSocket()) != 0);
+        // Stop watching it before the socket can be closed, and its number
+        // reused for another client.
+        if (ret && mEpollFd != -1) {
+            epoll_ctl(mEpollFd, EPOLL_CTL_DEL, c->getSocket(), nullptr);
+        }
         pthread_mutex_unlock(&mClientsLock);
         if (ret) {
             ret = c->decRef();
-            if (wakeup) {
-                char b = CtrlPipe_Wakeup;
-                TEMP_FAILURE_RETRY(write(mCtrlPipe[1], &b, 1));
-            }
         }
     }
     return ret;
@@ -23,7 +23,9 @@
 #include <sys/un.h>
 
 #include <algorithm>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -181,3 +183,91 @@ TEST_F(FrameworkListenerTest, MultipleClients) {
     EXPECT_EQ(std::string("42 test,2") + '\0', recvReply(client2.get()));
     EXPECT_EQ(std::string("42 test,1") + '\0', recvReply(client1.get()));
 }
+
+namespace {
+
+std::string recvBytes(int fd, size_t size) {
+    std::string reply;
+    while (reply.size() < size) {
+        std::string more = recvReply(fd);
+        if (more.empty()) break;
+        reply += more;
+    }
+    return reply;
+}
+
+// Echoes back each byte it reads, one byte per call. A '.' blocks the client
+// until unblock() is called.
+class EchoListener : public SocketListener {
+  public:
+    EchoListener(int fd) : SocketListener(fd, true) {}
+
+    void unblock() {
+        std::lock_guard<std::mutex> lock(mLock);
+        mBlocked = false;
+        mCond.notify_all();
+    }
+
+  protected:
+    bool onDataAvailable(SocketClient* c) override {
+        char b;
+        if (TEMP_FAILURE_RETRY(read(c->getSocket(), &b, 1)) != 1) return false;
+        if (b == '.') {
+            std::unique_lock<std::mutex> lock(mLock);
+            mCond.wait(lock, [this] { return !mBlocked; });
+        }
+        return c->sendData(&b, 1) == 0;
+    }
+
+  private:
+    std::mutex mLock;
+    std::condition_variable mCond;
+    bool mBlocked = true;
+};
+
+}  // unnamed namespace
+
+class SocketListenerWorkersTest : public testing::Test {
+  public:
+    SocketListenerWorkersTest() {
+        mSocketPath = testSocketPath();
+        mServerFd = serverSocket(mSocketPath);
+        mListener = std::make_unique<EchoListener>(mServerFd.get());
+        EXPECT_EQ(0, mListener->startListener(4, 2));
+    }
+
+    ~SocketListenerWorkersTest() override {
+        mListener->unblock();
+        EXPECT_EQ(0, mListener->stopListener());
+        unlink(mSocketPath.c_str());
+    }
+
+  protected:
+    std::string mSocketPath;
+    unique_fd mServerFd;
+    std::unique_ptr<EchoListener> mListener;
+};
+
+TEST_F(SocketListenerWorkersTest, SlowClientDoesNotBlockOthers) {
+    unique_fd slow = clientSocket(mSocketPath);
+    unique_fd fast = clientSocket(mSocketPath);
+    sendCmd(slow.get(), ".");
+    // Give the listener a chance to hand the slow client to a worker first.
+    usleep(10000);
+    sendCmd(fast.get(), "x");
+
+    EXPECT_EQ(std::string("x") + '\0', recvBytes(fast.get(), 2));
+
+    mListener->unblock();
+    EXPECT_EQ(std::string(".") + '\0', recvBytes(slow.get(), 2));
+}
+
+TEST_F(SocketListenerWorkersTest, KeepsOrderPerClient) {
+    unique_fd client = clientSocket(mSocketPath);
+    const std::string data = "0123456789abcdefghijklmnopqrstuvwxyz";
+    for (char b : data) {
+        ASSERT_EQ(1, TEMP_FAILURE_RETRY(write(client.get(), &b, 1)));
+    }
+
+    EXPECT_EQ(data, recvBytes(client.get(), data.size()));
+}
@@ -18,6 +18,7 @@
 
 #include <deque>
 #include <string>
+#include <vector>
 
 #include <android-base/stringprintf.h>
 
@@ -827,6 +828,222 @@ bool ArmExidx::Eval() {
   return status_ == ARM_STATUS_FINISH;
 }
 
+void ArmExidx::Compile(ArmExidxProgram* program) {
+  std::vector<ArmExidxOp>& ops = program->ops;
+  ops.clear();
+  // Adjacent vsp adjustments are merged, the offsets wrap around like cfa_ does.
+  auto add_cfa = [&ops](uint32_t offset) {
+    if (!ops.empty() && ops.back().type == ARM_EXIDX_OP_ADD_CFA) {
+      ops.back().offset += offset;
+    } else {
+      ops.push_back({ARM_EXIDX_OP_ADD_CFA, 0, 0, offset});
+    }
+  };
+  auto pop = [&ops](uint16_t registers) { ops.push_back({ARM_EXIDX_OP_POP, 0, registers, 0}); };
+
+  status_ = ARM_STATUS_NONE;
+  uint8_t byte;
+  while (status_ == ARM_STATUS_NONE && GetByte(&byte)) {
+    uint8_t arg;
+    switch (byte >> 4) {
+      case 0x0:
+      case 0x1:
+      case 0x2:
+      case 0x3:
+        // 00xxxxxx: vsp = vsp + (xxxxxx << 2) + 4
+        add_cfa(((byte & 0x3f) << 2) + 4);
+        break;
+      case 0x4:
+      case 0x5:
+      case 0x6:
+      case 0x7:
+        // 01xxxxxx: vsp = vsp - (xxxxxx << 2) - 4
+        add_cfa(-(((byte & 0x3f) << 2) + 4));
+        break;
+      case 0x8:
+        // 1000iiii iiiiiiii: Pop up to 12 integer registers under masks {r15-r12}, {r11-r4}
+        // 10000000 00000000: Refuse to unwind
+        if (GetByte(&arg)) {
+          uint16_t registers = ((byte & 0xf) << 8) | arg;
+          if (registers == 0) {
+            status_ = ARM_STATUS_NO_UNWIND;
+          } else {
+            pop(registers << 4);
+          }
+        }
+        break;
+      case 0x9:
+        // 1001nnnn: Set vsp = r[nnnn] (nnnn != 13, 15)
+        if ((byte & 0xf) == 13 || (byte & 0xf) == 15) {
+          status_ = ARM_STATUS_RESERVED;
+        } else {
+          ops.push_back({ARM_EXIDX_OP_SET_CFA, static_cast<uint8_t>(byte & 0xf), 0, 0});
+        }
+        break;
+      case 0xa:
+        // 10100nnn: Pop r4-r[4+nnn]
+        // 10101nnn: Pop r4-r[4+nnn], r14
+        pop((((2 << (byte & 0x7)) - 1) << 4) | ((byte & 0x8) ? (1 << ARM_REG_R14) : 0));
+        break;
+      case 0xb:
+        switch (byte & 0xf) {
+          case 0:
+            // 10110000: Finish
+            status_ = ARM_STATUS_FINISH;
+            break;
+          case 1:
+            // 10110001 0000iiii: Pop integer registers under mask {r3, r2, r1, r0}
+            if (GetByte(&arg)) {
+              if (arg == 0 || (arg >> 4)) {
+                status_ = ARM_STATUS_SPARE;
+              } else {
+                pop(arg);
+              }
+            }
+            break;
+          case 2: {
+            // 10110010 uleb128: vsp = vsp + 0x204 + (uleb128 << 2)
+            uint32_t result = 0;
+            uint32_t shift = 0;
+            do {
+              if (!GetByte(&arg)) {
+                break;
+              }
+              result |= (arg & 0x7f) << shift;
+              shift += 7;
+            } while (arg & 0x80);
+            if (status_ == ARM_STATUS_NONE) {
+              add_cfa(0x204 + (result << 2));
+            }
+            break;
+          }
+          case 3:
+            // 10110011 sssscccc: Pop VFP double precision registers D[ssss]-D[ssss+cccc] by FSTMFDX
+            if (GetByte(&arg)) {
+              add_cfa((arg & 0xf) * 8 + 12);
+            }
+            break;
+          case 4:
+          case 5:
+          case 6:
+          case 7:
+            // 101101nn: Spare
+            status_ = ARM_STATUS_SPARE;
+            break;
+          default:
+            // 10111nnn: Pop VFP double-precision registers D[8]-D[8+nnn] by FSTMFDX
+            add_cfa((byte & 0x7) * 8 + 12);
+            break;
+        }
+        break;
+      case 0xc:
+        if ((byte & 0x7) == 6 && !(byte & 0x8)) {
+          // 11000110 sssscccc: Intel Wireless MMX pop wR[ssss]-wR[ssss+cccc]
+          if (GetByte(&arg)) {
+            add_cfa((arg & 0xf) * 8 + 8);
+          }
+        } else if ((byte & 0x7) == 7 && !(byte & 0x8)) {
+          // 11000111 0000iiii: Intel Wireless MMX pop wCGR registers {wCGR0,1,2,3}
+          if (GetByte(&arg)) {
+            if (arg == 0 || (arg >> 4)) {
+              status_ = ARM_STATUS_SPARE;
+            } else {
+              add_cfa(__builtin_popcount(arg) * 4);
+            }
+          }
+        } else if (!(byte & 0x8)) {
+          // 11000nnn: Intel Wireless MMX pop wR[10]-wR[10+nnn] (nnn != 6, 7)
+          add_cfa((byte & 0x7) * 8 + 8);
+        } else if ((byte & 0x7) <= 1) {
+          // 11001000 sssscccc: Pop VFP double precision registers D[16+ssss]-D[16+ssss+cccc]
+          // 11001001 sssscccc: Pop VFP double precision registers D[ssss]-D[ssss+cccc]
+          if (GetByte(&arg)) {
+            add_cfa((arg & 0xf) * 8 + 8);
+          }
+        } else {
+          // 11001yyy: Spare (yyy != 000, 001)
+          status_ = ARM_STATUS_SPARE;
+        }
+        break;
+      case 0xd:
+        if (!(byte & 0x8)) {
+          // 11010nnn: Pop VFP double precision registers D[8]-D[8+nnn] by VPUSH
+          add_cfa((byte & 0x7) * 8 + 8);
+        } else {
+          // 11xxxyyy: Spare (xxx != 000, 001, 010)
+          status_ = ARM_STATUS_SPARE;
+        }
+        break;
+      default:
+        // 11xxxyyy: Spare (xxx != 000, 001, 010)
+        status_ = ARM_STATUS_SPARE;
+        break;
+    }
+  }
+  program->status = status_;
+}
+
+inline bool ArmExidx::Pop(uint16_t registers) {
+  // Read all of the registers at once, which is a single read of the process
+  // memory instead of one for each register.
+  uint32_t values[16];
+  size_t count = __builtin_popcount(registers);
+  if (!process_memory_->ReadFully(cfa_, values, count * sizeof(uint32_t))) {
+    // Find the first address that can't be read, setting the registers
+    // before it, as popping them one at a time would.
+    for (size_t reg = 0; reg < 16; reg++) {
+      if (registers & (1 << reg)) {
+        if (!process_memory_->Read32(cfa_, &(*regs_)[reg])) {
+          status_ = ARM_STATUS_READ_FAILED;
+          status_address_ = cfa_;
+          return false;
+        }
+        cfa_ += 4;
+      }
+    }
+    return true;
+  }
+
+  const uint32_t* value = values;
+  for (size_t reg = 0; reg < 16; reg++) {
+    if (registers & (1 << reg)) {
+      (*regs_)[reg] = *value++;
+    }
+  }
+  cfa_ += count * sizeof(uint32_t);
+  return true;
+}
+
+bool ArmExidx::Eval(const ArmExidxProgram& program) {
+  pc_set_ = false;
+  status_ = ARM_STATUS_NONE;
+  for (const ArmExidxOp& op : program.ops) {
+    switch (op.type) {
+      case ARM_EXIDX_OP_ADD_CFA:
+        cfa_ += op.offset;
+        break;
+      case ARM_EXIDX_OP_SET_CFA:
+        cfa_ = (*regs_)[op.reg];
+        break;
+      case ARM_EXIDX_OP_POP:
+        if (!Pop(op.registers)) {
+          return false;
+        }
+        // If the sp register is modified, change the cfa value.
+        if (op.registers & (1 << ARM_REG_SP)) {
+          cfa_ = (*regs_)[ARM_REG_SP];
+        }
+        // Indicate if the pc register was set.
+        if (op.registers & (1 << ARM_REG_PC)) {
+          pc_set_ = true;
+        }
+        break;
+    }
+  }
+  status_ = program.status;
+  return status_ == ARM_STATUS_FINISH;
+}
+
 void ArmExidx::LogByReg() {
   if (log_type_ != ARM_LOG_BY_REG) {
     return;
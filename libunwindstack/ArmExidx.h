@@ -21,6 +21,7 @@
 
 #include <deque>
 #include <map>
+#include <vector>
 
 namespace unwindstack {
 
@@ -45,6 +46,27 @@ enum ArmOp : uint8_t {
   ARM_OP_FINISH = 0xb0,
 };
 
+enum ArmExidxOpType : uint8_t {
+  ARM_EXIDX_OP_ADD_CFA,  // cfa += offset
+  ARM_EXIDX_OP_SET_CFA,  // cfa = r[reg]
+  ARM_EXIDX_OP_POP,      // Pop the registers in the mask, lowest first.
+};
+
+struct ArmExidxOp {
+  ArmExidxOpType type;
+  uint8_t reg;
+  uint16_t registers;
+  uint32_t offset;
+};
+
+// The effect of the unwind instructions of an entry, decoded once so that
+// stepping through the same function again only has to apply it.
+struct ArmExidxProgram {
+  std::vector<ArmExidxOp> ops;
+  // The status once all of the ops have been applied.
+  ArmStatus status = ARM_STATUS_NONE;
+};
+
 enum ArmLogType : uint8_t {
   ARM_LOG_NONE,
   ARM_LOG_FULL,
@@ -67,6 +89,13 @@ class ArmExidx {
 
   bool Decode();
 
+  // Decodes the data from ExtractEntryData() into a program, without
+  // executing or logging anything.
+  void Compile(ArmExidxProgram* program);
+
+  // Does what Eval() does, but from a program made by Compile().
+  bool Eval(const ArmExidxProgram& program);
+
   std::deque<uint8_t>* data() { return &data_; }
 
   ArmStatus status() { return status_; }
@@ -87,6 +116,7 @@ class ArmExidx {
  private:
   bool GetByte(uint8_t* byte);
   void AdjustRegisters(int32_t offset);
+  bool Pop(uint16_t registers);
 
   bool DecodePrefix_10_00(uint8_t byte);
   bool DecodePrefix_10_01(uint8_t byte);
@@ -20,6 +20,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <iterator>
 #include <memory>
 
 #include <unwindstack/DexFiles.h>
@@ -71,51 +72,60 @@ void DexFiles::ProcessArch() {
   }
 }
 
-uint64_t DexFiles::ReadEntryPtr32(uint64_t addr) {
-  uint32_t entry;
+bool DexFiles::ReadEntryPtr32(uint64_t addr, uint64_t* entry) {
+  uint32_t value;
   const uint32_t field_offset = 12;  // offset of first_entry_ in the descriptor struct.
-  if (!memory_->ReadFully(addr + field_offset, &entry, sizeof(entry))) {
-    return 0;
+  if (!memory_->ReadFully(addr + field_offset, &value, sizeof(value))) {
+    return false;
   }
-  return entry;
+  *entry = value;
+  return true;
 }
 
-uint64_t DexFiles::ReadEntryPtr64(uint64_t addr) {
-  uint64_t entry;
+bool DexFiles::ReadEntryPtr64(uint64_t addr, uint64_t* entry) {
   const uint32_t field_offset = 16;  // offset of first_entry_ in the descriptor struct.
-  if (!memory_->ReadFully(addr + field_offset, &entry, sizeof(entry))) {
-    return 0;
-  }
-  return entry;
+  return memory_->ReadFully(addr + field_offset, entry, sizeof(*entry));
 }
 
-bool DexFiles::ReadEntry32() {
+bool DexFiles::ReadEntry32(uint64_t addr, uint64_t* next, uint64_t* dex_file) {
   DEXFileEntry32 entry;
-  if (!memory_->ReadFully(entry_addr_, &entry, sizeof(entry)) || entry.dex_file == 0) {
-    entry_addr_ = 0;
+  if (!memory_->ReadFully(addr, &entry, sizeof(entry)) || entry.dex_file == 0) {
     return false;
   }
 
-  addrs_.push_back(entry.dex_file);
-  entry_addr_ = entry.next;
+  *next = entry.next;
+  *dex_file = entry.dex_file;
   return true;
 }
 
-bool DexFiles::ReadEntry64() {
+bool DexFiles::ReadEntry64(uint64_t addr, uint64_t* next, uint64_t* dex_file) {
   DEXFileEntry64 entry;
-  if (!memory_->ReadFully(entry_addr_, &entry, sizeof(entry)) || entry.dex_file == 0) {
-    entry_addr_ = 0;
+  if (!memory_->ReadFully(addr, &entry, sizeof(entry)) || entry.dex_file == 0) {
     return false;
   }
 
-  addrs_.push_back(entry.dex_file);
-  entry_addr_ = entry.next;
+  *next = entry.next;
+  *dex_file = entry.dex_file;
   return true;
 }
 
 bool DexFiles::ReadVariableData(uint64_t ptr_offset) {
-  entry_addr_ = (this->*read_entry_ptr_func_)(ptr_offset);
-  return entry_addr_ != 0;
+  uint64_t first_entry;
+  if (!(this->*read_entry_ptr_func_)(ptr_offset, &first_entry)) {
+    return false;
+  }
+  // Keep looking for a descriptor with entries, but remember the first
+  // empty one in case no other is found. Its entries are picked up when
+  // they are added.
+  if (first_entry == 0 && descriptor_addr_ != 0) {
+    return false;
+  }
+
+  descriptor_addr_ = ptr_offset;
+  entry_addr_ = first_entry;
+  head_entry_ = first_entry;
+  has_seqlock_ = ReadDescriptorSeqlock(ptr_offset, &seqlock_);
+  return first_entry != 0;
 }
 
 void DexFiles::Init(Maps* maps) {
@@ -128,6 +138,43 @@ void DexFiles::Init(Maps* maps) {
   FindAndReadVariable(maps, "__dex_debug_descriptor");
 }
 
+bool DexFiles::ReadEntry(uint64_t addr, uint64_t* next, uint64_t* dex_file) {
+  if (!seen_entries_.insert(addr).second || !(this->*read_entry_func_)(addr, next, dex_file)) {
+    return false;
+  }
+  addrs_.insert(*dex_file);
+  return true;
+}
+
+void DexFiles::ReadNewEntries() {
+  if (descriptor_addr_ == 0) {
+    return;
+  }
+
+  // When the list has a seqlock, skip reading it while it is being changed,
+  // or if nothing changed since the last read.
+  uint32_t seqlock = 0;
+  if (has_seqlock_ && (!ReadDescriptorSeqlock(descriptor_addr_, &seqlock) ||
+                       (seqlock & 1) != 0 || seqlock == seqlock_)) {
+    return;
+  }
+
+  uint64_t first_entry;
+  if (!(this->*read_entry_ptr_func_)(descriptor_addr_, &first_entry) ||
+      first_entry == head_entry_) {
+    return;
+  }
+
+  // New entries are always added at the head of the list, so only read up
+  // to the head from the last read.
+  uint64_t addr = first_entry;
+  uint64_t dex_file;
+  while (addr != 0 && addr != head_entry_ && ReadEntry(addr, &addr, &dex_file)) {
+  }
+  head_entry_ = first_entry;
+  seqlock_ = seqlock;
+}
+
 DexFile* DexFiles::GetDexFile(uint64_t dex_file_offset, MapInfo* info) {
   // Lock while processing the data.
   DexFile* dex_file;
@@ -142,16 +189,15 @@ DexFile* DexFiles::GetDexFile(uint64_t dex_file_offset, MapInfo* info) {
   return dex_file;
 }
 
-bool DexFiles::GetAddr(size_t index, uint64_t* addr) {
-  if (index < addrs_.size()) {
-    *addr = addrs_[index];
-    return true;
-  }
-  if (entry_addr_ != 0 && (this->*read_entry_func_)()) {
-    *addr = addrs_.back();
-    return true;
+bool DexFiles::GetMethodInformationFromAddr(uint64_t addr, MapInfo* info, uint64_t dex_pc,
+                                            std::string* method_name, uint64_t* method_offset) {
+  if (addr < info->start || addr >= info->end || addr > dex_pc) {
+    return false;
   }
-  return false;
+
+  DexFile* dex_file = GetDexFile(addr, info);
+  return dex_file != nullptr &&
+         dex_file->GetMethodInformation(dex_pc - addr, method_name, method_offset);
 }
 
 void DexFiles::GetMethodInformation(Maps* maps, MapInfo* info, uint64_t dex_pc,
@@ -161,16 +207,27 @@ void DexFiles::GetMethodInformation(Maps* maps, MapInfo* info, uint64_t dex_pc,
     Init(maps);
   }
 
-  size_t index = 0;
-  uint64_t addr;
-  while (GetAddr(index++, &addr)) {
-    if (addr < info->start || addr >= info->end) {
-      continue;
+  ReadNewEntries();
+
+  // Only the dex files that start in the map, below dex_pc, can contain it.
+  // Try the closest one first.
+  for (auto entry = addrs_.upper_bound(dex_pc);
+       entry != addrs_.begin() && *std::prev(entry) >= info->start;) {
+    --entry;
+    if (GetMethodInformationFromAddr(*entry, info, dex_pc, method_name, method_offset)) {
+      return;
     }
+  }
 
-    DexFile* dex_file = GetDexFile(addr, info);
-    if (dex_file != nullptr &&
-        dex_file->GetMethodInformation(dex_pc - addr, method_name, method_offset)) {
+  // Continue reading the entries that were in the list when it was first
+  // read.
+  uint64_t addr;
+  while (entry_addr_ != 0) {
+    if (!ReadEntry(entry_addr_, &entry_addr_, &addr)) {
+      entry_addr_ = 0;
+      break;
+    }
+    if (GetMethodInformationFromAddr(addr, info, dex_pc, method_name, method_offset)) {
       break;
     }
   }
@@ -16,7 +16,7 @@
 
 #include <stdint.h>
 
-#include <deque>
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -1481,7 +1481,7 @@ const typename DwarfOp<AddressType>::OpHandleFuncPtr DwarfOp<AddressType>::kOpHa
 template <typename AddressType>
 bool DwarfOp<AddressType>::Eval(uint64_t start, uint64_t end) {
   is_register_ = false;
-  stack_.clear();
+  stack_size_ = 0;
   memory_->set_cur_offset(start);
   dex_pc_set_ = false;
 
@@ -1498,7 +1498,7 @@ bool DwarfOp<AddressType>::Eval(uint64_t start, uint64_t end) {
     return true;
   }
   bool check_for_drop;
-  if (cur_op_ == 0x0c && operands_.back() == 0x31584544) {
+  if (cur_op_ == 0x0c && operands_[0] == 0x31584544) {
     check_for_drop = true;
   } else {
     check_for_drop = false;
@@ -1530,6 +1530,118 @@ bool DwarfOp<AddressType>::Eval(uint64_t start, uint64_t end) {
   return true;
 }
 
+template <typename AddressType>
+bool DwarfOp<AddressType>::Compile(uint64_t start, uint64_t end, DwarfExpression* expression) {
+  expression->start = start;
+  expression->dex_pc_set = false;
+  auto& ops = expression->ops;
+  ops.clear();
+
+  // The offsets of the start of each op, and of the end of the last one.
+  std::vector<uint64_t> offsets;
+  memory_->set_cur_offset(start);
+  while (memory_->cur_offset() < end) {
+    offsets.push_back(memory_->cur_offset());
+    uint8_t cur_op;
+    if (!memory_->ReadBytes(&cur_op, 1)) {
+      return false;
+    }
+    const auto* callback = &kCallbackTable[cur_op];
+    if (callback->handle_func == OP_ILLEGAL) {
+      return false;
+    }
+    DwarfExpressionOp op{cur_op, callback->handle_func, callback->num_required_stack_values,
+                         callback->num_operands, {0, 0}};
+    for (size_t i = 0; i < callback->num_operands; i++) {
+      if (!memory_->ReadEncodedValue<AddressType>(callback->operands[i], &op.operands[i])) {
+        return false;
+      }
+    }
+    ops.push_back(op);
+  }
+  offsets.push_back(memory_->cur_offset());
+
+  // Any branch past the end finishes the expression, so it continues at the
+  // index past the last op.
+  auto find_op = [&](uint64_t offset, uint64_t* index) {
+    if (offset >= end) {
+      *index = ops.size();
+      return true;
+    }
+    auto entry = std::lower_bound(offsets.begin(), offsets.end() - 1, offset);
+    if (entry == offsets.end() - 1 || *entry != offset) {
+      return false;
+    }
+    *index = entry - offsets.begin();
+    return true;
+  };
+  for (size_t i = 0; i < ops.size(); i++) {
+    auto& op = ops[i];
+    if (op.handle_func != OP_BRA && op.handle_func != OP_SKIP) {
+      continue;
+    }
+    int16_t offset = static_cast<int16_t>(op.operands[0]);
+    uint64_t next_offset = offsets[i + 1];
+    if (op.handle_func == OP_BRA) {
+      // Same as op_bra().
+      if (!find_op(next_offset + offset, &op.operands[0]) ||
+          !find_op(next_offset - offset, &op.operands[1])) {
+        return false;
+      }
+    } else if (!find_op(next_offset + offset, &op.operands[0])) {
+      return false;
+    }
+  }
+
+  expression->dex_pc_set = ops.size() >= 2 && ops[0].op == 0x0c &&
+                           static_cast<AddressType>(ops[0].operands[0]) == 0x31584544 &&
+                           ops[1].op == 0x13;
+  return true;
+}
+
+template <typename AddressType>
+bool DwarfOp<AddressType>::Eval(const DwarfExpression& expression) {
+  is_register_ = false;
+  stack_size_ = 0;
+  dex_pc_set_ = false;
+  last_error_.code = DWARF_ERROR_NONE;
+
+  const auto& ops = expression.ops;
+  size_t index = 0;
+  uint32_t iterations = 0;
+  while (index < ops.size()) {
+    const auto& op = ops[index];
+    if (stack_size_ < op.num_required_stack_values || stack_size_ == kMaxStackSize) {
+      last_error_.code = DWARF_ERROR_STACK_INDEX_NOT_VALID;
+      return false;
+    }
+    // The branches were resolved to op indexes by Compile().
+    if (op.handle_func == OP_BRA) {
+      index = (StackPop() != 0) ? op.operands[0] : op.operands[1];
+    } else if (op.handle_func == OP_SKIP) {
+      index = op.operands[0];
+    } else {
+      cur_op_ = op.op;
+      num_operands_ = op.num_operands;
+      operands_[0] = op.operands[0];
+      operands_[1] = op.operands[1];
+      if (!(this->*kOpHandleFuncList[op.handle_func])()) {
+        return false;
+      }
+      index++;
+    }
+    iterations++;
+    if (iterations == 2) {
+      dex_pc_set_ = expression.dex_pc_set;
+    } else if (iterations == 1001) {
+      // The same limit as Eval(start, end), which doesn't count the first two ops.
+      last_error_.code = DWARF_ERROR_TOO_MANY_ITERATIONS;
+      return false;
+    }
+  }
+  return true;
+}
+
 template <typename AddressType>
 bool DwarfOp<AddressType>::Decode() {
   last_error_.code = DWARF_ERROR_NONE;
@@ -1547,13 +1659,14 @@ bool DwarfOp<AddressType>::Decode() {
 
   const auto handle_func = kOpHandleFuncList[op->handle_func];
 
-  // Make sure that the required number of stack elements is available.
-  if (stack_.size() < op->num_required_stack_values) {
+  // Make sure that the required number of stack elements is available,
+  // and that there is room for the one value an op can push.
+  if (stack_size_ < op->num_required_stack_values || stack_size_ == kMaxStackSize) {
     last_error_.code = DWARF_ERROR_STACK_INDEX_NOT_VALID;
     return false;
   }
 
-  operands_.clear();
+  num_operands_ = op->num_operands;
   for (size_t i = 0; i < op->num_operands; i++) {
     uint64_t value;
     if (!memory_->ReadEncodedValue<AddressType>(op->operands[i], &value)) {
@@ -1561,7 +1674,7 @@ bool DwarfOp<AddressType>::Decode() {
       last_error_.address = memory_->cur_offset();
       return false;
     }
-    operands_.push_back(value);
+    operands_[i] = value;
   }
   return (this->*handle_func)();
 }
@@ -1618,7 +1731,7 @@ bool DwarfOp<AddressType>::op_deref() {
     last_error_.address = addr;
     return false;
   }
-  stack_.push_front(value);
+  StackPush(value);
   return true;
 }
 
@@ -1637,22 +1750,22 @@ bool DwarfOp<AddressType>::op_deref_size() {
     last_error_.address = addr;
     return false;
   }
-  stack_.push_front(value);
+  StackPush(value);
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_push() {
   // Push all of the operands.
-  for (auto operand : operands_) {
-    stack_.push_front(operand);
+  for (size_t i = 0; i < num_operands_; i++) {
+    StackPush(operands_[i]);
   }
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_dup() {
-  stack_.push_front(StackAt(0));
+  StackPush(StackAt(0));
   return true;
 }
 
@@ -1664,52 +1777,52 @@ bool DwarfOp<AddressType>::op_drop() {
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_over() {
-  stack_.push_front(StackAt(1));
+  StackPush(StackAt(1));
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_pick() {
   AddressType index = OperandAt(0);
-  if (index > StackSize()) {
+  if (index >= StackSize()) {
     last_error_.code = DWARF_ERROR_STACK_INDEX_NOT_VALID;
     return false;
   }
-  stack_.push_front(StackAt(index));
+  StackPush(StackAt(index));
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_swap() {
-  AddressType old_value = stack_[0];
-  stack_[0] = stack_[1];
-  stack_[1] = old_value;
+  AddressType old_value = StackEntry(0);
+  StackEntry(0) = StackEntry(1);
+  StackEntry(1) = old_value;
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_rot() {
-  AddressType top = stack_[0];
-  stack_[0] = stack_[1];
-  stack_[1] = stack_[2];
-  stack_[2] = top;
+  AddressType top = StackEntry(0);
+  StackEntry(0) = StackEntry(1);
+  StackEntry(1) = StackEntry(2);
+  StackEntry(2) = top;
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_abs() {
-  SignedType signed_value = static_cast<SignedType>(stack_[0]);
+  SignedType signed_value = static_cast<SignedType>(StackEntry(0));
   if (signed_value < 0) {
     signed_value = -signed_value;
   }
-  stack_[0] = static_cast<AddressType>(signed_value);
+  StackEntry(0) = static_cast<AddressType>(signed_value);
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_and() {
   AddressType top = StackPop();
-  stack_[0] &= top;
+  StackEntry(0) &= top;
   return true;
 }
 
@@ -1721,15 +1834,15 @@ bool DwarfOp<AddressType>::op_div() {
     return false;
   }
   SignedType signed_divisor = static_cast<SignedType>(top);
-  SignedType signed_dividend = static_cast<SignedType>(stack_[0]);
-  stack_[0] = static_cast<AddressType>(signed_dividend / signed_divisor);
+  SignedType signed_dividend = static_cast<SignedType>(StackEntry(0));
+  StackEntry(0) = static_cast<AddressType>(signed_dividend / signed_divisor);
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_minus() {
   AddressType top = StackPop();
-  stack_[0] -= top;
+  StackEntry(0) -= top;
   return true;
 }
 
@@ -1740,76 +1853,76 @@ bool DwarfOp<AddressType>::op_mod() {
     last_error_.code = DWARF_ERROR_ILLEGAL_VALUE;
     return false;
   }
-  stack_[0] %= top;
+  StackEntry(0) %= top;
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_mul() {
   AddressType top = StackPop();
-  stack_[0] *= top;
+  StackEntry(0) *= top;
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_neg() {
-  SignedType signed_value = static_cast<SignedType>(stack_[0]);
-  stack_[0] = static_cast<AddressType>(-signed_value);
+  SignedType signed_value = static_cast<SignedType>(StackEntry(0));
+  StackEntry(0) = static_cast<AddressType>(-signed_value);
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_not() {
-  stack_[0] = ~stack_[0];
+  StackEntry(0) = ~StackEntry(0);
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_or() {
   AddressType top = StackPop();
-  stack_[0] |= top;
+  StackEntry(0) |= top;
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_plus() {
   AddressType top = StackPop();
-  stack_[0] += top;
+  StackEntry(0) += top;
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_plus_uconst() {
-  stack_[0] += OperandAt(0);
+  StackEntry(0) += OperandAt(0);
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_shl() {
   AddressType top = StackPop();
-  stack_[0] <<= top;
+  StackEntry(0) <<= top;
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_shr() {
   AddressType top = StackPop();
-  stack_[0] >>= top;
+  StackEntry(0) >>= top;
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_shra() {
   AddressType top = StackPop();
-  SignedType signed_value = static_cast<SignedType>(stack_[0]) >> top;
-  stack_[0] = static_cast<AddressType>(signed_value);
+  SignedType signed_value = static_cast<SignedType>(StackEntry(0)) >> top;
+  StackEntry(0) = static_cast<AddressType>(signed_value);
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_xor() {
   AddressType top = StackPop();
-  stack_[0] ^= top;
+  StackEntry(0) ^= top;
   return true;
 }
 
@@ -1831,42 +1944,42 @@ bool DwarfOp<AddressType>::op_bra() {
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_eq() {
   AddressType top = StackPop();
-  stack_[0] = bool_to_dwarf_bool(stack_[0] == top);
+  StackEntry(0) = bool_to_dwarf_bool(StackEntry(0) == top);
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_ge() {
   AddressType top = StackPop();
-  stack_[0] = bool_to_dwarf_bool(stack_[0] >= top);
+  StackEntry(0) = bool_to_dwarf_bool(StackEntry(0) >= top);
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_gt() {
   AddressType top = StackPop();
-  stack_[0] = bool_to_dwarf_bool(stack_[0] > top);
+  StackEntry(0) = bool_to_dwarf_bool(StackEntry(0) > top);
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_le() {
   AddressType top = StackPop();
-  stack_[0] = bool_to_dwarf_bool(stack_[0] <= top);
+  StackEntry(0) = bool_to_dwarf_bool(StackEntry(0) <= top);
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_lt() {
   AddressType top = StackPop();
-  stack_[0] = bool_to_dwarf_bool(stack_[0] < top);
+  StackEntry(0) = bool_to_dwarf_bool(StackEntry(0) < top);
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_ne() {
   AddressType top = StackPop();
-  stack_[0] = bool_to_dwarf_bool(stack_[0] != top);
+  StackEntry(0) = bool_to_dwarf_bool(StackEntry(0) != top);
   return true;
 }
 
@@ -1880,21 +1993,21 @@ bool DwarfOp<AddressType>::op_skip() {
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_lit() {
-  stack_.push_front(cur_op() - 0x30);
+  StackPush(cur_op() - 0x30);
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_reg() {
   is_register_ = true;
-  stack_.push_front(cur_op() - 0x50);
+  StackPush(cur_op() - 0x50);
   return true;
 }
 
 template <typename AddressType>
 bool DwarfOp<AddressType>::op_regx() {
   is_register_ = true;
-  stack_.push_front(OperandAt(0));
+  StackPush(OperandAt(0));
   return true;
 }
 
@@ -1908,7 +2021,7 @@ bool DwarfOp<AddressType>::op_breg() {
     last_error_.code = DWARF_ERROR_ILLEGAL_VALUE;
     return false;
   }
-  stack_.push_front(regs_info_->Get(reg) + OperandAt(0));
+  StackPush(regs_info_->Get(reg) + OperandAt(0));
   return true;
 }
 
@@ -1919,7 +2032,7 @@ bool DwarfOp<AddressType>::op_bregx() {
     last_error_.code = DWARF_ERROR_ILLEGAL_VALUE;
     return false;
   }
-  stack_.push_front(regs_info_->Get(reg) + OperandAt(1));
+  StackPush(regs_info_->Get(reg) + OperandAt(1));
   return true;
 }
 
@@ -19,12 +19,12 @@
 
 #include <stdint.h>
 
-#include <deque>
 #include <string>
 #include <type_traits>
 #include <vector>
 
 #include <unwindstack/DwarfError.h>
+#include <unwindstack/DwarfLocation.h>
 
 #include "DwarfEncoding.h"
 #include "RegsInfo.h"
@@ -51,10 +51,17 @@ class DwarfOp {
 
   bool Eval(uint64_t start, uint64_t end);
 
+  // Decodes the ops between start and end without evaluating them. Fails for
+  // expressions that can't be decoded ahead of time, such as those with a
+  // branch into the middle of an op, which can still be evaluated by Eval().
+  bool Compile(uint64_t start, uint64_t end, DwarfExpression* expression);
+
+  bool Eval(const DwarfExpression& expression);
+
   void GetLogInfo(uint64_t start, uint64_t end, std::vector<std::string>* lines);
 
-  AddressType StackAt(size_t index) { return stack_[index]; }
-  size_t StackSize() { return stack_.size(); }
+  AddressType StackAt(size_t index) { return StackEntry(index); }
+  size_t StackSize() { return stack_size_; }
 
   void set_regs_info(RegsInfo<AddressType>* regs_info) { regs_info_ = regs_info; }
 
@@ -72,13 +79,9 @@ class DwarfOp {
 
  protected:
   AddressType OperandAt(size_t index) { return operands_[index]; }
-  size_t OperandsSize() { return operands_.size(); }
+  size_t OperandsSize() { return num_operands_; }
 
-  AddressType StackPop() {
-    AddressType value = stack_.front();
-    stack_.pop_front();
-    return value;
-  }
+  AddressType StackPop() { return stack_[--stack_size_]; }
 
  private:
   DwarfMemory* memory_;
@@ -89,8 +92,17 @@ class DwarfOp {
   bool is_register_ = false;
   DwarfErrorData last_error_{DWARF_ERROR_NONE, 0};
   uint8_t cur_op_;
-  std::vector<AddressType> operands_;
-  std::deque<AddressType> stack_;
+  AddressType operands_[2];
+  uint8_t num_operands_ = 0;
+
+  // No op pushes more than one value, so the iteration limit in Eval() also
+  // limits the size of the stack. The top of the stack is the last entry.
+  static constexpr size_t kMaxStackSize = 1024;
+  AddressType stack_[kMaxStackSize];
+  size_t stack_size_ = 0;
+
+  AddressType& StackEntry(size_t index) { return stack_[stack_size_ - 1 - index]; }
+  void StackPush(AddressType value) { stack_[stack_size_++] = value; }
 
   inline AddressType bool_to_dwarf_bool(bool value) { return value ? 1 : 0; }
 
@@ -16,6 +16,8 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+
 #include <unwindstack/DwarfError.h>
 #include <unwindstack/DwarfLocation.h>
 #include <unwindstack/DwarfMemory.h>
@@ -54,12 +56,34 @@ bool DwarfSection::Step(uint64_t pc, Regs* regs, Memory* process_memory, bool* f
     }
     loc_regs.cie = fde->cie;
 
-    // Store it in the cache.
-    it = loc_regs_.emplace(loc_regs.pc_end, std::move(loc_regs)).first;
+    // Store it in the cache in the flattened form, so that later steps in
+    // the same range go straight to evaluating the rules.
+    DwarfRegRules rules;
+    FlattenLocations(loc_regs, &rules);
+    it = loc_regs_.emplace(rules.pc_end, std::move(rules)).first;
   }
 
   // Now eval the actual registers.
-  return Eval(it->second.cie, process_memory, it->second, regs, finished);
+  return EvalRules(it->second.cie, process_memory, it->second, regs, finished);
+}
+
+void DwarfSection::FlattenLocations(const dwarf_loc_regs_t& loc_regs, DwarfRegRules* rules) {
+  rules->cie = loc_regs.cie;
+  rules->pc_start = loc_regs.pc_start;
+  rules->pc_end = loc_regs.pc_end;
+  rules->cfa_defined = false;
+  rules->regs.clear();
+  rules->regs.reserve(loc_regs.size());
+  for (const auto& entry : loc_regs) {
+    if (entry.first == CFA_REG) {
+      rules->cfa_defined = true;
+      rules->cfa = entry.second;
+    } else {
+      rules->regs.push_back({entry.first, entry.second});
+    }
+  }
+  std::sort(rules->regs.begin(), rules->regs.end(),
+            [](const DwarfRegRule& a, const DwarfRegRule& b) { return a.reg < b.reg; });
 }
 
 template <typename AddressType>
@@ -378,10 +402,26 @@ bool DwarfSectionImpl<AddressType>::EvalExpression(const DwarfLocation& loc, Mem
   DwarfOp<AddressType> op(&memory_, regular_memory);
   op.set_regs_info(regs_info);
 
-  // Need to evaluate the op data.
+  // Need to evaluate the op data. It is decoded the first time the
+  // expression is used, unless it can't be decoded ahead of time.
   uint64_t end = loc.values[1];
   uint64_t start = end - loc.values[0];
-  if (!op.Eval(start, end)) {
+  auto entry = expressions_.find(end);
+  if (entry == expressions_.end() || entry->second.start != start) {
+    DwarfExpression expression;
+    if (op.Compile(start, end, &expression)) {
+      entry = expressions_.insert_or_assign(end, std::move(expression)).first;
+    } else {
+      entry = expressions_.end();
+    }
+  }
+  bool evaluated;
+  if (entry != expressions_.end()) {
+    evaluated = op.Eval(entry->second);
+  } else {
+    evaluated = op.Eval(start, end);
+  }
+  if (!evaluated) {
     last_error_ = op.last_error();
     return false;
   }
@@ -403,7 +443,6 @@ bool DwarfSectionImpl<AddressType>::EvalExpression(const DwarfLocation& loc, Mem
 
 template <typename AddressType>
 struct EvalInfo {
-  const dwarf_loc_regs_t* loc_regs;
   const DwarfCie* cie;
   Memory* regular_memory;
   AddressType cfa;
@@ -473,6 +512,15 @@ template <typename AddressType>
 bool DwarfSectionImpl<AddressType>::Eval(const DwarfCie* cie, Memory* regular_memory,
                                          const dwarf_loc_regs_t& loc_regs, Regs* regs,
                                          bool* finished) {
+  DwarfRegRules rules;
+  FlattenLocations(loc_regs, &rules);
+  return EvalRules(cie, regular_memory, rules, regs, finished);
+}
+
+template <typename AddressType>
+bool DwarfSectionImpl<AddressType>::EvalRules(const DwarfCie* cie, Memory* regular_memory,
+                                              const DwarfRegRules& rules, Regs* regs,
+                                              bool* finished) {
   RegsImpl<AddressType>* cur_regs = reinterpret_cast<RegsImpl<AddressType>*>(regs);
   if (cie->return_address_register >= cur_regs->total_regs()) {
     last_error_.code = DWARF_ERROR_ILLEGAL_VALUE;
@@ -480,8 +528,7 @@ bool DwarfSectionImpl<AddressType>::Eval(const DwarfCie* cie, Memory* regular_me
   }
 
   // Get the cfa value;
-  auto cfa_entry = loc_regs.find(CFA_REG);
-  if (cfa_entry == loc_regs.end()) {
+  if (!rules.cfa_defined) {
     last_error_.code = DWARF_ERROR_CFA_NOT_DEFINED;
     return false;
   }
@@ -489,11 +536,10 @@ bool DwarfSectionImpl<AddressType>::Eval(const DwarfCie* cie, Memory* regular_me
   // Always set the dex pc to zero when evaluating.
   cur_regs->set_dex_pc(0);
 
-  EvalInfo<AddressType> eval_info{.loc_regs = &loc_regs,
-                                  .cie = cie,
+  EvalInfo<AddressType> eval_info{.cie = cie,
                                   .regular_memory = regular_memory,
                                   .regs_info = RegsInfo<AddressType>(cur_regs)};
-  const DwarfLocation* loc = &cfa_entry->second;
+  const DwarfLocation* loc = &rules.cfa;
   // Only a few location types are valid for the cfa.
   switch (loc->type) {
     case DWARF_LOCATION_REGISTER:
@@ -518,11 +564,8 @@ bool DwarfSectionImpl<AddressType>::Eval(const DwarfCie* cie, Memory* regular_me
       return false;
   }
 
-  for (const auto& entry : loc_regs) {
-    uint32_t reg = entry.first;
-    // Already handled the CFA register.
-    if (reg == CFA_REG) continue;
-
+  for (const auto& rule : rules.regs) {
+    uint32_t reg = rule.reg;
     AddressType* reg_ptr;
     if (reg >= cur_regs->total_regs()) {
       // Skip this unknown register.
@@ -530,7 +573,7 @@ bool DwarfSectionImpl<AddressType>::Eval(const DwarfCie* cie, Memory* regular_me
     }
 
     reg_ptr = eval_info.regs_info.Save(reg);
-    if (!EvalRegister(&entry.second, reg, reg_ptr, &eval_info)) {
+    if (!EvalRegister(&rule.location, reg, reg_ptr, &eval_info)) {
       return false;
     }
   }
@@ -606,39 +649,38 @@ bool DwarfSectionImplNoHdr<AddressType>::Init(uint64_t offset, uint64_t size, ui
   return true;
 }
 
-// Create a cached version of the fde information such that it is a std::map
-// that is indexed by end pc and contains a pair that represents the start pc
-// followed by the fde object. The fde pointers are owned by fde_entries_
-// and not by the map object.
+// Add the pc range of an fde to a std::map that is indexed by end pc and
+// contains the start pc and the offset of the fde. The fdes are read in
+// section order, and where ranges overlap the fde that came first wins.
 // It is possible for an fde to be represented by multiple entries in
 // the map. This can happen if the the start pc and end pc overlap already
 // existing entries. For example, if there is already an entry of 0x400, 0x200,
 // and an fde has a start pc of 0x100 and end pc of 0x500, two new entries
 // will be added: 0x200, 0x100 and 0x500, 0x400.
 template <typename AddressType>
-void DwarfSectionImplNoHdr<AddressType>::InsertFde(const DwarfFde* fde) {
-  uint64_t start = fde->pc_start;
-  uint64_t end = fde->pc_end;
-  auto it = fdes_.upper_bound(start);
+void DwarfSectionImplNoHdr<AddressType>::InsertFde(uint64_t start, uint64_t end,
+                                                   uint64_t fde_offset,
+                                                   std::map<uint64_t, FdeRange>* fdes) {
+  auto it = fdes->upper_bound(start);
   bool add_element = false;
-  while (it != fdes_.end() && start < end) {
+  while (it != fdes->end() && start < end) {
     if (add_element) {
       add_element = false;
-      if (end < it->second.first) {
+      if (end < it->second.pc_start) {
         if (it->first == end) {
           return;
         }
-        fdes_[end] = std::make_pair(start, fde);
+        (*fdes)[end] = FdeRange{start, end, fde_offset};
         return;
       }
-      if (start != it->second.first) {
-        fdes_[it->second.first] = std::make_pair(start, fde);
+      if (start != it->second.pc_start) {
+        (*fdes)[it->second.pc_start] = FdeRange{start, it->second.pc_start, fde_offset};
       }
     }
     if (start < it->first) {
-      if (end < it->second.first) {
+      if (end < it->second.pc_start) {
         if (it->first != end) {
-          fdes_[end] = std::make_pair(start, fde);
+          (*fdes)[end] = FdeRange{start, end, fde_offset};
         }
         return;
       }
@@ -648,7 +690,47 @@ void DwarfSectionImplNoHdr<AddressType>::InsertFde(const DwarfFde* fde) {
     ++it;
   }
   if (start < end) {
-    fdes_[end] = std::make_pair(start, fde);
+    (*fdes)[end] = FdeRange{start, end, fde_offset};
+  }
+}
+
+// Read every entry in the section once and keep only the pc ranges of the
+// fdes, sorted so that a lookup is a binary search. The fdes themselves are
+// not kept, GetFdeFromPc reads the one it finds by offset, which means that
+// only fdes that are actually used stay in memory.
+template <typename AddressType>
+void DwarfSectionImplNoHdr<AddressType>::BuildFdeIndex() {
+  fde_index_built_ = true;
+
+  std::map<uint64_t, FdeRange> fdes;
+  next_entries_offset_ = entries_offset_;
+  while (next_entries_offset_ < entries_end_) {
+    uint64_t entry_offset = next_entries_offset_;
+    bool cached = fde_entries_.count(entry_offset) != 0;
+    DwarfFde* fde;
+    if (!GetNextCieOrFde(&fde)) {
+      // Skip over a bad entry, unless its length could not be read.
+      if (next_entries_offset_ <= entry_offset) {
+        break;
+      }
+      continue;
+    }
+    if (fde != nullptr) {
+      InsertFde(fde->pc_start, fde->pc_end, entry_offset, &fdes);
+      if (!cached) {
+        fde_entries_.erase(entry_offset);
+      }
+    }
+
+    if (next_entries_offset_ < memory_.cur_offset()) {
+      // Simply consider the processing done in this case.
+      break;
+    }
+  }
+
+  fde_index_.reserve(fdes.size());
+  for (const auto& entry : fdes) {
+    fde_index_.push_back(entry.second);
   }
 }
 
@@ -735,30 +817,13 @@ bool DwarfSectionImplNoHdr<AddressType>::GetNextCieOrFde(DwarfFde** fde_entry) {
 
 template <typename AddressType>
 void DwarfSectionImplNoHdr<AddressType>::GetFdes(std::vector<const DwarfFde*>* fdes) {
-  // Loop through the already cached entries.
-  uint64_t entry_offset = entries_offset_;
-  while (entry_offset < next_entries_offset_) {
-    auto cie_it = cie_entries_.find(entry_offset);
-    if (cie_it != cie_entries_.end()) {
-      entry_offset = cie_it->second.cfa_instructions_end;
-    } else {
-      auto fde_it = fde_entries_.find(entry_offset);
-      if (fde_it == fde_entries_.end()) {
-        // No fde or cie at this entry, should not be possible.
-        return;
-      }
-      entry_offset = fde_it->second.cfa_instructions_end;
-      fdes->push_back(&fde_it->second);
-    }
-  }
-
+  next_entries_offset_ = entries_offset_;
   while (next_entries_offset_ < entries_end_) {
     DwarfFde* fde;
     if (!GetNextCieOrFde(&fde)) {
       break;
     }
     if (fde != nullptr) {
-      InsertFde(fde);
       fdes->push_back(fde);
     }
 
@@ -771,35 +836,16 @@ void DwarfSectionImplNoHdr<AddressType>::GetFdes(std::vector<const DwarfFde*>* f
 
 template <typename AddressType>
 const DwarfFde* DwarfSectionImplNoHdr<AddressType>::GetFdeFromPc(uint64_t pc) {
-  // Search in the list of fdes we already have.
-  auto it = fdes_.upper_bound(pc);
-  if (it != fdes_.end()) {
-    if (pc >= it->second.first) {
-      return it->second.second;
-    }
+  if (!fde_index_built_) {
+    BuildFdeIndex();
   }
 
-  // The section might have overlapping pcs in fdes, so it is necessary
-  // to do a linear search of the fdes by pc. As fdes are read, a cached
-  // search map is created.
-  while (next_entries_offset_ < entries_end_) {
-    DwarfFde* fde;
-    if (!GetNextCieOrFde(&fde)) {
-      return nullptr;
-    }
-    if (fde != nullptr) {
-      InsertFde(fde);
-      if (pc >= fde->pc_start && pc < fde->pc_end) {
-        return fde;
-      }
-    }
-
-    if (next_entries_offset_ < memory_.cur_offset()) {
-      // Simply consider the processing done in this case.
-      break;
-    }
+  auto it = std::upper_bound(fde_index_.begin(), fde_index_.end(), pc,
+                             [](uint64_t pc, const FdeRange& range) { return pc < range.pc_end; });
+  if (it == fde_index_.end() || pc < it->pc_start) {
+    return nullptr;
   }
-  return nullptr;
+  return this->GetFdeFromOffset(it->fde_offset);
 }
 
 // Explicitly instantiate DwarfSectionImpl
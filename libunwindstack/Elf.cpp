@@ -17,10 +17,16 @@
 #include <elf.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <list>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #define LOG_TAG "unwind"
 #include <log/log.h>
@@ -37,8 +43,84 @@
 namespace unwindstack {
 
 bool Elf::cache_enabled_;
-std::unordered_map<std::string, std::pair<std::shared_ptr<Elf>, bool>>* Elf::cache_;
-std::mutex* Elf::cache_lock_;
+
+// The elf cache is split into shards, each with its own lock, so that
+// threads getting the elf objects of different files do not contend. A map
+// is assigned to a shard by its name, so the name and name:offset keys of a
+// map always land in the same shard. Each shard keeps its elf objects in
+// least recently used order. When the elf files kept by the whole cache
+// exceed the budget, the least recently used ones of the shard being added
+// to are dropped.
+namespace {
+
+struct ElfCacheShard {
+  struct Entry {
+    std::shared_ptr<Elf> elf;
+    uint64_t size;
+    std::vector<std::string> keys;
+  };
+  using EntryList = std::list<Entry>;
+
+  std::mutex lock;
+  // Most recently used first.
+  EntryList lru;
+  // The second element in the pair indicates whether elf_offset should
+  // be set to offset when getting out of the cache.
+  std::unordered_map<std::string, std::pair<EntryList::iterator, bool>> keys;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+};
+
+}  // namespace
+
+static constexpr size_t kElfCacheShards = 16;
+static ElfCacheShard* g_cache_shards;
+static std::atomic<uint64_t> g_cache_bytes;
+static std::atomic<uint64_t> g_cache_budget;
+
+static ElfCacheShard* GetCacheShard(const std::string& name) {
+  return &g_cache_shards[std::hash<std::string>()(name) % kElfCacheShards];
+}
+
+static void CacheSetKey(ElfCacheShard* shard, const std::string& key,
+                        ElfCacheShard::EntryList::iterator entry, bool set_elf_offset) {
+  auto it = shard->keys.find(key);
+  if (it != shard->keys.end()) {
+    auto old_entry = it->second.first;
+    if (old_entry != entry) {
+      auto& old_keys = old_entry->keys;
+      old_keys.erase(std::find(old_keys.begin(), old_keys.end(), key));
+      if (old_keys.empty()) {
+        g_cache_bytes -= old_entry->size;
+        shard->lru.erase(old_entry);
+      }
+      entry->keys.push_back(key);
+    }
+    it->second = std::make_pair(entry, set_elf_offset);
+    return;
+  }
+  shard->keys.emplace(key, std::make_pair(entry, set_elf_offset));
+  entry->keys.push_back(key);
+}
+
+// Always keeps the most recently used entry, even if it is over the budget
+// by itself.
+static void CacheEvict(ElfCacheShard* shard) {
+  uint64_t budget = g_cache_budget;
+  if (budget == 0) {
+    return;
+  }
+  while (g_cache_bytes > budget && shard->lru.size() > 1) {
+    auto& entry = shard->lru.back();
+    for (const auto& key : entry.keys) {
+      shard->keys.erase(key);
+    }
+    g_cache_bytes -= entry.size;
+    shard->lru.pop_back();
+    shard->evictions++;
+  }
+}
 
 bool Elf::Init() {
   load_bias_ = 0;
@@ -320,24 +402,66 @@ uint64_t Elf::GetLoadBias(Memory* memory) {
 void Elf::SetCachingEnabled(bool enable) {
   if (!cache_enabled_ && enable) {
     cache_enabled_ = true;
-    cache_ = new std::unordered_map<std::string, std::pair<std::shared_ptr<Elf>, bool>>;
-    cache_lock_ = new std::mutex;
+    g_cache_shards = new ElfCacheShard[kElfCacheShards];
+    g_cache_bytes = 0;
   } else if (cache_enabled_ && !enable) {
     cache_enabled_ = false;
-    delete cache_;
-    delete cache_lock_;
+    delete[] g_cache_shards;
+    g_cache_shards = nullptr;
   }
 }
 
-void Elf::CacheLock() {
-  cache_lock_->lock();
+void Elf::SetCacheMemoryBudget(uint64_t bytes) {
+  g_cache_budget = bytes;
+  if (!cache_enabled_) {
+    return;
+  }
+  for (size_t i = 0; i < kElfCacheShards; i++) {
+    std::lock_guard<std::mutex> guard(g_cache_shards[i].lock);
+    CacheEvict(&g_cache_shards[i]);
+  }
+}
+
+ElfCacheStats Elf::GetCacheStats() {
+  ElfCacheStats stats;
+  if (!cache_enabled_) {
+    return stats;
+  }
+  for (size_t i = 0; i < kElfCacheShards; i++) {
+    ElfCacheShard* shard = &g_cache_shards[i];
+    std::lock_guard<std::mutex> guard(shard->lock);
+    stats.hits += shard->hits;
+    stats.misses += shard->misses;
+    stats.evictions += shard->evictions;
+    stats.elfs += shard->lru.size();
+  }
+  stats.bytes = g_cache_bytes;
+  return stats;
 }
 
-void Elf::CacheUnlock() {
-  cache_lock_->unlock();
+void Elf::CacheLock(MapInfo* info) {
+  GetCacheShard(info->name)->lock.lock();
+}
+
+void Elf::CacheUnlock(MapInfo* info) {
+  GetCacheShard(info->name)->lock.unlock();
 }
 
 void Elf::CacheAdd(MapInfo* info) {
+  ElfCacheShard* shard = GetCacheShard(info->name);
+  shard->misses++;
+
+  // Charge the elf with the size of the file that it keeps mapped or
+  // decompressed, and at least with the size of the object itself.
+  uint64_t size = 0;
+  if (!info->elf->valid() || !GetInfo(info->elf->memory(), &size)) {
+    size = 0;
+  }
+  size = std::max<uint64_t>(size, sizeof(Elf));
+  shard->lru.push_front({info->elf, size, {}});
+  auto entry = shard->lru.begin();
+  g_cache_bytes += size;
+
   // If elf_offset != 0, then cache both name:offset and name.
   // The cached name is used to do lookups if multiple maps for the same
   // named elf file exist.
@@ -346,15 +470,14 @@ void Elf::CacheAdd(MapInfo* info) {
   // use the same cached elf object.
 
   if (info->offset == 0 || info->elf_offset != 0) {
-    (*cache_)[info->name] = std::make_pair(info->elf, true);
+    CacheSetKey(shard, info->name, entry, true);
   }
 
   if (info->offset != 0) {
-    // The second element in the pair indicates whether elf_offset should
-    // be set to offset when getting out of the cache.
-    (*cache_)[info->name + ':' + std::to_string(info->offset)] =
-        std::make_pair(info->elf, info->elf_offset != 0);
+    CacheSetKey(shard, info->name + ':' + std::to_string(info->offset), entry,
+                info->elf_offset != 0);
   }
+  CacheEvict(shard);
 }
 
 bool Elf::CacheAfterCreateMemory(MapInfo* info) {
@@ -362,16 +485,20 @@ bool Elf::CacheAfterCreateMemory(MapInfo* info) {
     return false;
   }
 
-  auto entry = cache_->find(info->name);
-  if (entry == cache_->end()) {
+  ElfCacheShard* shard = GetCacheShard(info->name);
+  auto it = shard->keys.find(info->name);
+  if (it == shard->keys.end()) {
     return false;
   }
 
   // In this case, the whole file is the elf, and the name has already
   // been cached. Add an entry at name:offset to get this directly out
   // of the cache next time.
-  info->elf = entry->second.first;
-  (*cache_)[info->name + ':' + std::to_string(info->offset)] = std::make_pair(info->elf, true);
+  auto entry = it->second.first;
+  info->elf = entry->elf;
+  shard->lru.splice(shard->lru.begin(), shard->lru, entry);
+  CacheSetKey(shard, info->name + ':' + std::to_string(info->offset), entry, true);
+  shard->hits++;
   return true;
 }
 
@@ -380,15 +507,19 @@ bool Elf::CacheGet(MapInfo* info) {
   if (info->offset != 0) {
     name += ':' + std::to_string(info->offset);
   }
-  auto entry = cache_->find(name);
-  if (entry != cache_->end()) {
-    info->elf = entry->second.first;
-    if (entry->second.second) {
-      info->elf_offset = info->offset;
-    }
-    return true;
+  ElfCacheShard* shard = GetCacheShard(info->name);
+  auto it = shard->keys.find(name);
+  if (it == shard->keys.end()) {
+    return false;
   }
-  return false;
+  auto entry = it->second.first;
+  info->elf = entry->elf;
+  if (it->second.second) {
+    info->elf_offset = info->offset;
+  }
+  shard->lru.splice(shard->lru.begin(), shard->lru, entry);
+  shard->hits++;
+  return true;
 }
 
 std::string Elf::GetBuildID(Memory* memory) {
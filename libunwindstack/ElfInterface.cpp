@@ -523,6 +523,20 @@ bool ElfInterface::Step(uint64_t pc, Regs* regs, Memory* process_memory, bool* f
   return false;
 }
 
+size_t ElfInterface::DwarfIndexMemorySize() {
+  size_t size = 0;
+  if (eh_frame_ != nullptr) {
+    size += eh_frame_->FdeIndexMemorySize();
+  }
+  if (debug_frame_ != nullptr) {
+    size += debug_frame_->FdeIndexMemorySize();
+  }
+  if (gnu_debugdata_interface_ != nullptr) {
+    size += gnu_debugdata_interface_->DwarfIndexMemorySize();
+  }
+  return size;
+}
+
 // This is an estimation of the size of the elf file using the location
 // of the section headers and size. This assumes that the section headers
 // are at the end of the elf file. If the elf has a load bias, the size
@@ -126,7 +126,15 @@ bool ElfInterfaceArm::StepExidx(uint64_t pc, Regs* regs, Memory* process_memory,
   ArmExidx arm(regs_arm, memory_, process_memory);
   arm.set_cfa(regs_arm->sp());
   bool return_value = false;
-  if (arm.ExtractEntryData(entry_offset) && arm.Eval()) {
+  // Only entries whose data could be extracted are cached, the rest are
+  // looked up again, which also reports the same error again.
+  auto program = exidx_programs_.find(entry_offset);
+  if (program == exidx_programs_.end() && arm.ExtractEntryData(entry_offset)) {
+    ArmExidxProgram new_program;
+    arm.Compile(&new_program);
+    program = exidx_programs_.emplace(entry_offset, std::move(new_program)).first;
+  }
+  if (program != exidx_programs_.end() && arm.Eval(program->second)) {
     // If the pc was not set, then use the LR registers for the PC.
     if (!arm.pc_set()) {
       (*regs_arm)[ARM_REG_PC] = (*regs_arm)[ARM_REG_LR];
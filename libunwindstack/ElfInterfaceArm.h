@@ -26,6 +26,8 @@
 #include <unwindstack/ElfInterface.h>
 #include <unwindstack/Memory.h>
 
+#include "ArmExidx.h"
+
 namespace unwindstack {
 
 class ElfInterfaceArm : public ElfInterface32 {
@@ -90,6 +92,8 @@ class ElfInterfaceArm : public ElfInterface32 {
   uint64_t load_bias_ = 0;
 
   std::unordered_map<size_t, uint32_t> addrs_;
+  // The decoded unwind instructions of the entries already stepped through, by entry offset.
+  std::unordered_map<uint64_t, ArmExidxProgram> exidx_programs_;
 };
 
 }  // namespace unwindstack
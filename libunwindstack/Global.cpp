@@ -63,6 +63,34 @@ uint64_t Global::GetVariableOffset(MapInfo* info, const std::string& variable) {
   return 0;
 }
 
+bool Global::ReadDescriptorSeqlock(uint64_t addr, uint32_t* seqlock) {
+  struct {
+    uint8_t magic[8];
+    uint32_t flags;
+    uint32_t sizeof_descriptor;
+    uint32_t sizeof_entry;
+    uint32_t action_seqlock;
+  } android_fields;
+
+  // The fields follow version, action_flag, relevant_entry and first_entry.
+  switch (arch()) {
+    case ARCH_ARM:
+    case ARCH_MIPS:
+    case ARCH_X86:
+      addr += 16;
+      break;
+    default:
+      addr += 24;
+      break;
+  }
+  if (!memory_->ReadFully(addr, &android_fields, sizeof(android_fields)) ||
+      memcmp(android_fields.magic, "Android1", sizeof(android_fields.magic)) != 0) {
+    return false;
+  }
+  *seqlock = android_fields.action_seqlock;
+  return true;
+}
+
 void Global::FindAndReadVariable(Maps* maps, const char* var_str) {
   std::string variable(var_str);
   // When looking for global variables, do not arbitrarily search every
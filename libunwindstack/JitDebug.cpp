@@ -18,6 +18,7 @@
 #include <sys/mman.h>
 
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include <unwindstack/Elf.h>
@@ -81,65 +82,60 @@ JitDebug::~JitDebug() {
   }
 }
 
-uint64_t JitDebug::ReadDescriptor32(uint64_t addr) {
+bool JitDebug::ReadDescriptor32(uint64_t addr, uint64_t* first_entry) {
   JITDescriptor32 desc;
-  if (!memory_->ReadFully(addr, &desc, sizeof(desc))) {
-    return 0;
+  if (!memory_->ReadFully(addr, &desc, sizeof(desc)) || desc.header.version != 1) {
+    return false;
   }
 
-  if (desc.header.version != 1 || desc.first_entry == 0) {
-    // Either unknown version, or no jit entries.
-    return 0;
-  }
-
-  return desc.first_entry;
+  *first_entry = desc.first_entry;
+  return true;
 }
 
-uint64_t JitDebug::ReadDescriptor64(uint64_t addr) {
+bool JitDebug::ReadDescriptor64(uint64_t addr, uint64_t* first_entry) {
   JITDescriptor64 desc;
-  if (!memory_->ReadFully(addr, &desc, sizeof(desc))) {
-    return 0;
-  }
-
-  if (desc.header.version != 1 || desc.first_entry == 0) {
-    // Either unknown version, or no jit entries.
-    return 0;
+  if (!memory_->ReadFully(addr, &desc, sizeof(desc)) || desc.header.version != 1) {
+    return false;
   }
 
-  return desc.first_entry;
+  *first_entry = desc.first_entry;
+  return true;
 }
 
-uint64_t JitDebug::ReadEntry32Pack(uint64_t* start, uint64_t* size) {
+bool JitDebug::ReadEntry32Pack(uint64_t addr, uint64_t* next, uint64_t* start, uint64_t* size) {
   JITCodeEntry32Pack code;
-  if (!memory_->ReadFully(entry_addr_, &code, sizeof(code))) {
-    return 0;
+  if (!memory_->ReadFully(addr, &code, sizeof(code))) {
+    return false;
   }
 
+  *next = code.next;
   *start = code.symfile_addr;
   *size = code.symfile_size;
-  return code.next;
+  return true;
 }
 
-uint64_t JitDebug::ReadEntry32Pad(uint64_t* start, uint64_t* size) {
+bool JitDebug::ReadEntry32Pad(uint64_t addr, uint64_t* next, uint64_t* start, uint64_t* size) {
   JITCodeEntry32Pad code;
-  if (!memory_->ReadFully(entry_addr_, &code, sizeof(code))) {
-    return 0;
+  if (!memory_->ReadFully(addr, &code, sizeof(code))) {
+    return false;
   }
 
+  *next = code.next;
   *start = code.symfile_addr;
   *size = code.symfile_size;
-  return code.next;
+  return true;
 }
 
-uint64_t JitDebug::ReadEntry64(uint64_t* start, uint64_t* size) {
+bool JitDebug::ReadEntry64(uint64_t addr, uint64_t* next, uint64_t* start, uint64_t* size) {
   JITCodeEntry64 code;
-  if (!memory_->ReadFully(entry_addr_, &code, sizeof(code))) {
-    return 0;
+  if (!memory_->ReadFully(addr, &code, sizeof(code))) {
+    return false;
   }
 
+  *next = code.next;
   *start = code.symfile_addr;
   *size = code.symfile_size;
-  return code.next;
+  return true;
 }
 
 void JitDebug::ProcessArch() {
@@ -167,8 +163,22 @@ void JitDebug::ProcessArch() {
 }
 
 bool JitDebug::ReadVariableData(uint64_t ptr) {
-  entry_addr_ = (this->*read_descriptor_func_)(ptr);
-  return entry_addr_ != 0;
+  uint64_t first_entry;
+  if (!(this->*read_descriptor_func_)(ptr, &first_entry)) {
+    return false;
+  }
+  // Keep looking for a descriptor with entries, but remember the first
+  // empty one in case no other is found. Its entries are picked up when
+  // they are added.
+  if (first_entry == 0 && descriptor_addr_ != 0) {
+    return false;
+  }
+
+  descriptor_addr_ = ptr;
+  entry_addr_ = first_entry;
+  head_entry_ = first_entry;
+  has_seqlock_ = ReadDescriptorSeqlock(ptr, &seqlock_);
+  return first_entry != 0;
 }
 
 void JitDebug::Init(Maps* maps) {
@@ -181,6 +191,87 @@ void JitDebug::Init(Maps* maps) {
   FindAndReadVariable(maps, "__jit_debug_descriptor");
 }
 
+Elf* JitDebug::ReadEntryElf(uint64_t addr, uint64_t* next) {
+  uint64_t start;
+  uint64_t size;
+  if (!seen_entries_.insert(addr).second || !(this->*read_entry_func_)(addr, next, &start, &size)) {
+    return nullptr;
+  }
+
+  Elf* elf = new Elf(new MemoryRange(memory_, start, size, 0));
+  elf->Init();
+  if (!elf->valid()) {
+    delete elf;
+    return nullptr;
+  }
+  elf_list_.push_back(elf);
+
+  const auto& pt_loads = elf->interface()->pt_loads();
+  if (pt_loads.empty()) {
+    unindexed_elfs_.push_back(elf);
+  }
+  for (const auto& entry : pt_loads) {
+    // A newer entry for the same code replaces the older one.
+    uint64_t load_start = entry.second.table_offset;
+    elf_ranges_[load_start] = std::make_pair(load_start + entry.second.table_size, elf);
+  }
+  return elf;
+}
+
+Elf* JitDebug::FindElf(uint64_t pc) {
+  auto entry = elf_ranges_.upper_bound(pc);
+  if (entry != elf_ranges_.begin()) {
+    --entry;
+    if (pc < entry->second.first && entry->second.second->IsValidPc(pc)) {
+      return entry->second.second;
+    }
+  }
+
+  for (Elf* elf : unindexed_elfs_) {
+    if (elf->IsValidPc(pc)) {
+      return elf;
+    }
+  }
+  return nullptr;
+}
+
+Elf* JitDebug::ReadNewEntries(uint64_t pc) {
+  if (descriptor_addr_ == 0) {
+    return nullptr;
+  }
+
+  // When the list has a seqlock, skip reading it while it is being changed,
+  // or if nothing changed since the last read.
+  uint32_t seqlock = 0;
+  if (has_seqlock_ && (!ReadDescriptorSeqlock(descriptor_addr_, &seqlock) ||
+                       (seqlock & 1) != 0 || seqlock == seqlock_)) {
+    return nullptr;
+  }
+
+  uint64_t first_entry;
+  if (!(this->*read_descriptor_func_)(descriptor_addr_, &first_entry) ||
+      first_entry == head_entry_) {
+    return nullptr;
+  }
+
+  // New entries are always added at the head of the list, so only read up
+  // to the head from the last read.
+  Elf* found = nullptr;
+  uint64_t addr = first_entry;
+  while (addr != 0 && addr != head_entry_) {
+    Elf* elf = ReadEntryElf(addr, &addr);
+    if (elf == nullptr) {
+      break;
+    }
+    if (found == nullptr && elf->IsValidPc(pc)) {
+      found = elf;
+    }
+  }
+  head_entry_ = first_entry;
+  seqlock_ = seqlock;
+  return found;
+}
+
 Elf* JitDebug::GetElf(Maps* maps, uint64_t pc) {
   // Use a single lock, this object should be used so infrequently that
   // a fine grain lock is unnecessary.
@@ -189,28 +280,27 @@ Elf* JitDebug::GetElf(Maps* maps, uint64_t pc) {
     Init(maps);
   }
 
-  // Search the existing elf object first.
-  for (Elf* elf : elf_list_) {
-    if (elf->IsValidPc(pc)) {
-      return elf;
-    }
+  // Search the existing elf objects first.
+  Elf* elf = FindElf(pc);
+  if (elf != nullptr) {
+    return elf;
   }
 
-  while (entry_addr_ != 0) {
-    uint64_t start;
-    uint64_t size;
-    entry_addr_ = (this->*read_entry_func_)(&start, &size);
+  elf = ReadNewEntries(pc);
+  if (elf != nullptr) {
+    return elf;
+  }
 
-    Elf* elf = new Elf(new MemoryRange(memory_, start, size, 0));
-    elf->Init();
-    if (!elf->valid()) {
+  // Continue reading the entries that were in the list when it was first
+  // read.
+  while (entry_addr_ != 0) {
+    elf = ReadEntryElf(entry_addr_, &entry_addr_);
+    if (elf == nullptr) {
       // The data is not formatted in a way we understand, do not attempt
       // to process any other entries.
       entry_addr_ = 0;
-      delete elf;
       return nullptr;
     }
-    elf_list_.push_back(elf);
 
     if (elf->IsValidPc(pc)) {
       return elf;
@@ -28,6 +28,7 @@
 
 #include <pthread.h>
 #include <stdint.h>
+#include <sys/mman.h>
 
 #include <memory>
 #include <string>
@@ -35,6 +36,8 @@
 
 #include <unwindstack/Elf.h>
 #include <unwindstack/LocalUnwinder.h>
+#include <unwindstack/MachineArm64.h>
+#include <unwindstack/MachineX86_64.h>
 #include <unwindstack/MapInfo.h>
 #include <unwindstack/Maps.h>
 #include <unwindstack/Memory.h>
@@ -85,6 +88,105 @@ MapInfo* LocalUnwinder::GetMapInfo(uint64_t pc) {
   return map_info;
 }
 
+MapInfo* LocalUnwinder::FindMapInfo(uint64_t pc) {
+  pthread_rwlock_rdlock(&maps_rwlock_);
+  MapInfo* map_info = maps_->Find(pc);
+  pthread_rwlock_unlock(&maps_rwlock_);
+  return map_info;
+}
+
+// A frame record is the caller's frame pointer followed by the return
+// address. It is read directly, so it must lie on this thread's stack, and
+// above the current sp, which also means the chain can only go up the
+// stack and has to end.
+bool LocalUnwinder::StepFramePointer(Regs* regs, uint16_t fp_reg, MapInfo* stack_map) {
+  uint64_t* raw_regs = reinterpret_cast<uint64_t*>(regs->RawData());
+  uint64_t fp = raw_regs[fp_reg];
+  if ((fp & (sizeof(uint64_t) - 1)) != 0 || fp < regs->sp() || fp < stack_map->start ||
+      fp > stack_map->end - 2 * sizeof(uint64_t)) {
+    return false;
+  }
+
+  const uint64_t* record = reinterpret_cast<const uint64_t*>(static_cast<uintptr_t>(fp));
+  uint64_t pc = record[1];
+  MapInfo* map_info = FindMapInfo(pc);
+  if (map_info == nullptr || (map_info->flags & PROT_EXEC) == 0) {
+    return false;
+  }
+
+  raw_regs[fp_reg] = record[0];
+  regs->set_pc(pc);
+  regs->set_sp(fp + 2 * sizeof(uint64_t));
+  return true;
+}
+
+bool LocalUnwinder::UnwindPcs(std::vector<uint64_t>* pcs, size_t max_frames) {
+  std::unique_ptr<unwindstack::Regs> regs(unwindstack::Regs::CreateFromLocal());
+  unwindstack::RegsGetLocal(regs.get());
+  ArchEnum arch = regs->Arch();
+
+  MapInfo* stack_map = nullptr;
+  uint16_t fp_reg = 0;
+  if (frame_pointer_unwinding_) {
+    if (arch == ARCH_ARM64) {
+      fp_reg = ARM64_REG_R29;
+    } else if (arch == ARCH_X86_64) {
+      fp_reg = X86_64_REG_RBP;
+    }
+    if (fp_reg != 0) {
+      stack_map = FindMapInfo(regs->sp());
+      if (stack_map != nullptr && (stack_map->flags & PROT_READ) == 0) {
+        stack_map = nullptr;
+      }
+    }
+  }
+
+  size_t num_frames = 0;
+  bool adjust_pc = false;
+  while (true) {
+    uint64_t cur_pc = regs->pc();
+    uint64_t cur_sp = regs->sp();
+
+    MapInfo* map_info = GetMapInfo(cur_pc);
+    if (map_info == nullptr) {
+      break;
+    }
+
+    // Skip any locations that are within this library.
+    if (num_frames != 0 || !ShouldSkipLibrary(map_info->name)) {
+      pcs->push_back(cur_pc);
+      num_frames++;
+    }
+    if (pcs->size() == max_frames) {
+      break;
+    }
+
+    // The first frame is this function, which might not keep a frame
+    // pointer, so always step out of it with the unwind information.
+    if (adjust_pc && stack_map != nullptr && StepFramePointer(regs.get(), fp_reg, stack_map)) {
+      continue;
+    }
+
+    Elf* elf = map_info->GetElf(process_memory_, arch);
+    uint64_t rel_pc = elf->GetRelPc(cur_pc, map_info);
+    uint64_t step_pc = rel_pc;
+    if (adjust_pc) {
+      step_pc -= regs->GetPcAdjustment(rel_pc, elf);
+    }
+
+    bool finished = false;
+    if (!elf->StepIfSignalHandler(rel_pc, regs.get(), process_memory_.get()) &&
+        !elf->Step(step_pc, regs.get(), process_memory_.get(), &finished)) {
+      finished = true;
+    }
+    if (finished || (cur_pc == regs->pc() && cur_sp == regs->sp())) {
+      break;
+    }
+    adjust_pc = true;
+  }
+  return num_frames != 0;
+}
+
 bool LocalUnwinder::Unwind(std::vector<LocalFrameData>* frame_info, size_t max_frames) {
   std::unique_ptr<unwindstack::Regs> regs(unwindstack::Regs::CreateFromLocal());
   unwindstack::RegsGetLocal(regs.get());
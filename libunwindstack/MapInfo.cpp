@@ -202,10 +202,10 @@ Elf* MapInfo::GetElf(const std::shared_ptr<Memory>& process_memory, ArchEnum exp
 
     bool locked = false;
     if (Elf::CachingEnabled() && !name.empty()) {
-      Elf::CacheLock();
+      Elf::CacheLock(this);
       locked = true;
       if (Elf::CacheGet(this)) {
-        Elf::CacheUnlock();
+        Elf::CacheUnlock(this);
         return elf.get();
       }
     }
@@ -214,7 +214,7 @@ Elf* MapInfo::GetElf(const std::shared_ptr<Memory>& process_memory, ArchEnum exp
     if (locked) {
       if (Elf::CacheAfterCreateMemory(this)) {
         delete memory;
-        Elf::CacheUnlock();
+        Elf::CacheUnlock(this);
         return elf.get();
       }
     }
@@ -229,7 +229,7 @@ Elf* MapInfo::GetElf(const std::shared_ptr<Memory>& process_memory, ArchEnum exp
 
     if (locked) {
       Elf::CacheAdd(this);
-      Elf::CacheUnlock();
+      Elf::CacheUnlock(this);
     }
   }
 
@@ -40,27 +40,27 @@
 namespace unwindstack {
 
 MapInfo* Maps::Find(uint64_t pc) {
-  if (maps_.empty()) {
+  auto entry = std::upper_bound(ends_.begin(), ends_.end(), pc);
+  if (entry == ends_.end()) {
     return nullptr;
   }
-  size_t first = 0;
-  size_t last = maps_.size();
-  while (first < last) {
-    size_t index = (first + last) / 2;
-    const auto& cur = maps_[index];
-    if (pc >= cur->start && pc < cur->end) {
-      return cur.get();
-    } else if (pc < cur->start) {
-      last = index;
-    } else {
-      first = index + 1;
-    }
+  MapInfo* info = maps_[entry - ends_.begin()].get();
+  if (pc < info->start) {
+    return nullptr;
+  }
+  return info;
+}
+
+void Maps::UpdateIndex() {
+  ends_.clear();
+  ends_.reserve(maps_.size());
+  for (const auto& map_info : maps_) {
+    ends_.push_back(map_info->end);
   }
-  return nullptr;
 }
 
 bool Maps::Parse() {
-  return android::procinfo::ReadMapFile(
+  bool parsed = android::procinfo::ReadMapFile(
       GetMapsFile(),
       [&](uint64_t start, uint64_t end, uint16_t flags, uint64_t pgoff, ino_t, const char* name) {
         // Mark a device map in /dev/ and not in /dev/ashmem/ specially.
@@ -71,6 +71,8 @@ bool Maps::Parse() {
             new MapInfo(maps_.empty() ? nullptr : maps_.back().get(), start, end, pgoff,
                         flags, name));
       });
+  UpdateIndex();
+  return parsed;
 }
 
 void Maps::Add(uint64_t start, uint64_t end, uint64_t offset, uint64_t flags,
@@ -79,6 +81,7 @@ void Maps::Add(uint64_t start, uint64_t end, uint64_t offset, uint64_t flags,
       std::make_unique<MapInfo>(maps_.empty() ? nullptr : maps_.back().get(), start, end, offset,
                                 flags, name);
   map_info->load_bias = load_bias;
+  ends_.push_back(end);
   maps_.emplace_back(std::move(map_info));
 }
 
@@ -93,11 +96,12 @@ void Maps::Sort() {
     map_info->prev_map = prev_map;
     prev_map = map_info.get();
   }
+  UpdateIndex();
 }
 
 bool BufferMaps::Parse() {
   std::string content(buffer_);
-  return android::procinfo::ReadMapFileContent(
+  bool parsed = android::procinfo::ReadMapFileContent(
       &content[0],
       [&](uint64_t start, uint64_t end, uint16_t flags, uint64_t pgoff, ino_t, const char* name) {
         // Mark a device map in /dev/ and not in /dev/ashmem/ specially.
@@ -108,6 +112,8 @@ bool BufferMaps::Parse() {
             new MapInfo(maps_.empty() ? nullptr : maps_.back().get(), start, end, pgoff,
                         flags, name));
       });
+  UpdateIndex();
+  return parsed;
 }
 
 const std::string RemoteMaps::GetMapsFile() const {
@@ -119,66 +125,71 @@ const std::string LocalUpdatableMaps::GetMapsFile() const {
 }
 
 bool LocalUpdatableMaps::Reparse() {
-  // New maps will be added at the end without deleting the old ones.
-  size_t last_map_idx = maps_.size();
-  if (!Parse()) {
-    maps_.resize(last_map_idx);
+  // The maps file is sorted the same way as maps_, so walk both together.
+  // A line that matches the old map at the same position reuses it, no
+  // MapInfo is built for it, and nothing is moved until the whole file has
+  // been read so that a failure leaves the maps as they were.
+  struct NewMap {
+    size_t old_index;
+    std::unique_ptr<MapInfo> info;
+  };
+  std::vector<NewMap> new_maps;
+  new_maps.reserve(maps_.size());
+  size_t old_index = 0;
+  bool parsed = android::procinfo::ReadMapFile(
+      GetMapsFile(),
+      [&](uint64_t start, uint64_t end, uint16_t flags, uint64_t pgoff, ino_t, const char* name) {
+        // Mark a device map in /dev/ and not in /dev/ashmem/ specially.
+        if (strncmp(name, "/dev/", 5) == 0 && strncmp(name + 5, "ashmem/", 7) != 0) {
+          flags |= unwindstack::MAPS_FLAGS_DEVICE_MAP;
+        }
+        while (old_index < maps_.size() && maps_[old_index]->start < start) {
+          old_index++;
+        }
+        if (old_index < maps_.size()) {
+          const auto& info = maps_[old_index];
+          if (info->start == start) {
+            old_index++;
+            if (info->end == end && info->offset == pgoff && info->flags == flags &&
+                info->name == name) {
+              new_maps.push_back({old_index - 1, nullptr});
+              return;
+            }
+          }
+        }
+        new_maps.push_back(
+            {SIZE_MAX, std::make_unique<MapInfo>(nullptr, start, end, pgoff, flags, name)});
+      });
+  if (!parsed) {
     return false;
   }
 
-  size_t total_entries = maps_.size();
-  size_t search_map_idx = 0;
-  for (size_t new_map_idx = last_map_idx; new_map_idx < maps_.size(); new_map_idx++) {
-    auto& new_map_info = maps_[new_map_idx];
-    uint64_t start = new_map_info->start;
-    uint64_t end = new_map_info->end;
-    uint64_t flags = new_map_info->flags;
-    std::string* name = &new_map_info->name;
-    for (size_t old_map_idx = search_map_idx; old_map_idx < last_map_idx; old_map_idx++) {
-      auto& info = maps_[old_map_idx];
-      if (start == info->start && end == info->end && flags == info->flags && *name == info->name) {
-        // No need to check
-        search_map_idx = old_map_idx + 1;
-        maps_[new_map_idx] = nullptr;
-        total_entries--;
-        break;
-      } else if (info->start > start) {
-        // Stop, there isn't going to be a match.
-        search_map_idx = old_map_idx;
-        break;
-      }
-
-      // Never delete these maps, they may be in use. The assumption is
-      // that there will only every be a handful of these so waiting
-      // to destroy them is not too expensive.
-      saved_maps_.emplace_back(std::move(info));
-      search_map_idx = old_map_idx + 1;
-      maps_[old_map_idx] = nullptr;
-      total_entries--;
-    }
-    if (search_map_idx >= last_map_idx) {
-      break;
+  std::vector<std::unique_ptr<MapInfo>> maps;
+  maps.reserve(new_maps.size());
+  for (auto& new_map : new_maps) {
+    if (new_map.old_index == SIZE_MAX) {
+      maps.emplace_back(std::move(new_map.info));
+    } else {
+      maps.emplace_back(std::move(maps_[new_map.old_index]));
     }
   }
 
-  // Now move out any of the maps that never were found.
-  for (size_t i = search_map_idx; i < last_map_idx; i++) {
-    saved_maps_.emplace_back(std::move(maps_[i]));
-    maps_[i] = nullptr;
-    total_entries--;
+  // Never delete the maps that went away, they may be in use. The assumption
+  // is that there will only ever be a handful of these so waiting to destroy
+  // them is not too expensive.
+  for (auto& info : maps_) {
+    if (info != nullptr) {
+      saved_maps_.emplace_back(std::move(info));
+    }
   }
+  maps_ = std::move(maps);
 
-  // Sort all of the values such that the nullptrs wind up at the end, then
-  // resize them away.
-  std::sort(maps_.begin(), maps_.end(), [](const auto& a, const auto& b) {
-    if (a == nullptr) {
-      return false;
-    } else if (b == nullptr) {
-      return true;
-    }
-    return a->start < b->start;
-  });
-  maps_.resize(total_entries);
+  MapInfo* prev_map = nullptr;
+  for (const auto& map_info : maps_) {
+    map_info->prev_map = prev_map;
+    prev_map = map_info.get();
+  }
+  UpdateIndex();
 
   return true;
 }
@@ -26,6 +26,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <mutex>
 
 #include <android-base/unique_fd.h>
 
@@ -99,6 +100,68 @@ static size_t ProcessVmRead(pid_t pid, uint64_t remote_src, void* dst, size_t le
   return total_read;
 }
 
+// Reads all of the requests using as few process_vm_readv calls as possible.
+// As in ProcessVmRead, each remote iovec covers at most one page. The kernel
+// stops at the first remote iovec it cannot read, so after a short transfer
+// the request that iovec belongs to is done, and the next call starts with
+// the request after it.
+static void ProcessVmReadBatch(pid_t pid, std::vector<MemoryReadRequest>* requests) {
+  constexpr size_t kMaxIovecs = 64;
+  struct iovec dst_iovs[kMaxIovecs];
+  struct iovec src_iovs[kMaxIovecs];
+  size_t owners[kMaxIovecs];
+
+  for (auto& request : *requests) {
+    request.bytes_read = 0;
+  }
+
+  size_t next = 0;
+  size_t next_offset = 0;
+  while (next < requests->size()) {
+    size_t iovecs_used = 0;
+    size_t index = next;
+    size_t offset = next_offset;
+    while (index < requests->size() && iovecs_used < kMaxIovecs) {
+      MemoryReadRequest* request = &(*requests)[index];
+      uint64_t cur;
+      if (offset == request->size || __builtin_add_overflow(request->addr, offset, &cur) ||
+          cur >= UINTPTR_MAX) {
+        index++;
+        offset = 0;
+        continue;
+      }
+
+      uintptr_t misalignment = cur & (getpagesize() - 1);
+      size_t iov_len = std::min(getpagesize() - misalignment, request->size - offset);
+      dst_iovs[iovecs_used].iov_base = &reinterpret_cast<uint8_t*>(request->dst)[offset];
+      dst_iovs[iovecs_used].iov_len = iov_len;
+      src_iovs[iovecs_used].iov_base = reinterpret_cast<void*>(cur);
+      src_iovs[iovecs_used].iov_len = iov_len;
+      owners[iovecs_used] = index;
+      ++iovecs_used;
+      offset += iov_len;
+    }
+    if (iovecs_used == 0) {
+      return;
+    }
+
+    ssize_t rc = process_vm_readv(pid, dst_iovs, iovecs_used, src_iovs, iovecs_used, 0);
+    size_t bytes = rc == -1 ? 0 : rc;
+    size_t i = 0;
+    for (; i < iovecs_used && bytes >= src_iovs[i].iov_len; i++) {
+      (*requests)[owners[i]].bytes_read += src_iovs[i].iov_len;
+      bytes -= src_iovs[i].iov_len;
+    }
+    if (i == iovecs_used) {
+      next = index;
+      next_offset = offset;
+    } else {
+      next = owners[i] + 1;
+      next_offset = 0;
+    }
+  }
+}
+
 static bool PtraceReadLong(pid_t pid, uint64_t addr, long* value) {
   // ptrace() returns -1 and sets errno when the operation fails.
   // To disambiguate -1 from a valid result, we clear errno beforehand.
@@ -158,6 +221,12 @@ bool Memory::ReadFully(uint64_t addr, void* dst, size_t size) {
   return rc == size;
 }
 
+void Memory::ReadBatch(std::vector<MemoryReadRequest>* requests) {
+  for (auto& request : *requests) {
+    request.bytes_read = Read(request.addr, request.dst, request.size);
+  }
+}
+
 bool Memory::ReadString(uint64_t addr, std::string* string, uint64_t max_read) {
   string->clear();
   uint64_t bytes_read = 0;
@@ -320,10 +389,43 @@ size_t MemoryRemote::Read(uint64_t addr, void* dst, size_t size) {
   }
 }
 
+void MemoryRemote::ReadBatch(std::vector<MemoryReadRequest>* requests) {
+#if !defined(__LP64__)
+  // Cannot read an address greater than 32 bits in a 32 bit context.
+  if (std::any_of(requests->begin(), requests->end(),
+                  [](const MemoryReadRequest& request) { return request.addr > UINT32_MAX; })) {
+    Memory::ReadBatch(requests);
+    return;
+  }
+#endif
+
+  uintptr_t read_func = read_redirect_func_.load();
+  if (read_func == reinterpret_cast<uintptr_t>(PtraceRead)) {
+    Memory::ReadBatch(requests);
+    return;
+  }
+
+  ProcessVmReadBatch(pid_, requests);
+  if (read_func == 0) {
+    // Same as in Read: if process_vm_readv returned anything, keep using it,
+    // otherwise let Read work out whether ptrace does any better.
+    if (std::any_of(requests->begin(), requests->end(),
+                    [](const MemoryReadRequest& request) { return request.bytes_read > 0; })) {
+      read_redirect_func_ = reinterpret_cast<uintptr_t>(ProcessVmRead);
+    } else {
+      Memory::ReadBatch(requests);
+    }
+  }
+}
+
 size_t MemoryLocal::Read(uint64_t addr, void* dst, size_t size) {
   return ProcessVmRead(getpid(), addr, dst, size);
 }
 
+void MemoryLocal::ReadBatch(std::vector<MemoryReadRequest>* requests) {
+  ProcessVmReadBatch(getpid(), requests);
+}
+
 MemoryRange::MemoryRange(const std::shared_ptr<Memory>& memory, uint64_t begin, uint64_t length,
                          uint64_t offset)
     : memory_(memory), begin_(begin), length_(length), offset_(offset) {}
@@ -429,12 +531,38 @@ size_t MemoryOfflineParts::Read(uint64_t addr, void* dst, size_t size) {
   return 0;
 }
 
+void MemoryCache::Prefetch(uint64_t addr, size_t size) {
+  uint64_t end;
+  if (size == 0 || __builtin_add_overflow(addr, size, &end)) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(cache_lock_);
+  std::vector<MemoryReadRequest> requests;
+  for (uint64_t page = addr >> kCacheBits; page <= (end - 1) >> kCacheBits; page++) {
+    if (cache_.find(page) == cache_.end()) {
+      requests.push_back({.addr = page << kCacheBits, .dst = cache_[page], .size = kCacheSize});
+    }
+  }
+  if (requests.empty()) {
+    return;
+  }
+
+  impl_->ReadBatch(&requests);
+  for (const auto& request : requests) {
+    if (request.bytes_read != kCacheSize) {
+      cache_.erase(request.addr >> kCacheBits);
+    }
+  }
+}
+
 size_t MemoryCache::Read(uint64_t addr, void* dst, size_t size) {
   // Only bother caching and looking at the cache if this is a small read for now.
   if (size > 64) {
     return impl_->Read(addr, dst, size);
   }
 
+  std::lock_guard<std::mutex> guard(cache_lock_);
   uint64_t addr_page = addr >> kCacheBits;
   auto entry = cache_.find(addr_page);
   uint8_t* cache_dst;
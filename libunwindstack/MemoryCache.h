@@ -20,6 +20,7 @@
 #include <stdint.h>
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 
@@ -34,13 +35,23 @@ class MemoryCache : public Memory {
 
   size_t Read(uint64_t addr, void* dst, size_t size) override;
 
-  void Clear() override { cache_.clear(); }
+  // Reads all the pages of the range that are not cached yet with a single
+  // ReadBatch, and caches the ones that could be read.
+  void Prefetch(uint64_t addr, size_t size) override;
+
+  void Clear() override {
+    std::lock_guard<std::mutex> guard(cache_lock_);
+    cache_.clear();
+  }
 
  private:
   constexpr static size_t kCacheBits = 12;
   constexpr static size_t kCacheMask = (1 << kCacheBits) - 1;
   constexpr static size_t kCacheSize = 1 << kCacheBits;
   std::unordered_map<uint64_t, uint8_t[kCacheSize]> cache_;
+  // Elfs built from process memory keep a reference to it, so a cache can be
+  // read from every thread that shares those elfs, not just its unwinder's.
+  std::mutex cache_lock_;
 
   std::unique_ptr<Memory> impl_;
 };
@@ -29,6 +29,7 @@ class MemoryLocal : public Memory {
   virtual ~MemoryLocal() = default;
 
   size_t Read(uint64_t addr, void* dst, size_t size) override;
+  void ReadBatch(std::vector<MemoryReadRequest>* requests) override;
 };
 
 }  // namespace unwindstack
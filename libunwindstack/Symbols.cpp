@@ -16,91 +16,108 @@
 
 #include <elf.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <algorithm>
 #include <string>
+#include <vector>
 
 #include <unwindstack/Memory.h>
 
-#include "Check.h"
 #include "Symbols.h"
 
 namespace unwindstack {
 
 Symbols::Symbols(uint64_t offset, uint64_t size, uint64_t entry_size, uint64_t str_offset,
                  uint64_t str_size)
-    : cur_offset_(offset),
-      offset_(offset),
+    : offset_(offset),
       end_(offset + size),
       entry_size_(entry_size),
       str_offset_(str_offset),
       str_end_(str_offset_ + str_size) {}
 
 const Symbols::Info* Symbols::GetInfoFromCache(uint64_t addr) {
-  // Binary search the table.
-  size_t first = 0;
-  size_t last = symbols_.size();
-  while (first < last) {
-    size_t current = first + (last - first) / 2;
-    const Info* info = &symbols_[current];
-    if (addr < info->start_offset) {
-      last = current;
-    } else if (addr < info->end_offset) {
-      return info;
-    } else {
-      first = current + 1;
-    }
+  // Find the last symbol that starts at or before addr. Symbols with the
+  // same start are sorted by size, so this is the largest of them.
+  auto entry = std::upper_bound(
+      symbols_.begin(), symbols_.end(), addr,
+      [](uint64_t addr, const Info& info) { return addr < info.start_offset; });
+  if (entry == symbols_.begin()) {
+    return nullptr;
+  }
+  --entry;
+  if (addr - entry->start_offset >= entry->size) {
+    return nullptr;
   }
-  return nullptr;
+  return &*entry;
 }
 
 template <typename SymType>
-bool Symbols::GetName(uint64_t addr, Memory* elf_memory, std::string* name, uint64_t* func_offset) {
-  if (symbols_.size() != 0) {
-    const Info* info = GetInfoFromCache(addr);
-    if (info) {
-      CHECK(addr >= info->start_offset && addr <= info->end_offset);
-      *func_offset = addr - info->start_offset;
-      return elf_memory->ReadString(info->str_offset, name, str_end_ - info->str_offset);
-    }
+void Symbols::BuildCache(Memory* elf_memory) {
+  symbols_built_ = true;
+  if (entry_size_ < sizeof(SymType) || end_ < offset_) {
+    return;
   }
 
-  bool symbol_added = false;
-  bool return_value = false;
-  while (cur_offset_ + entry_size_ <= end_) {
-    SymType entry;
-    if (!elf_memory->ReadFully(cur_offset_, &entry, sizeof(entry))) {
-      // Stop all processing, something looks like it is corrupted.
-      cur_offset_ = UINT64_MAX;
-      return false;
-    }
-    cur_offset_ += entry_size_;
-
-    if (entry.st_shndx != SHN_UNDEF && ELF32_ST_TYPE(entry.st_info) == STT_FUNC) {
-      // Treat st_value as virtual address.
-      uint64_t start_offset = entry.st_value;
-      uint64_t end_offset = start_offset + entry.st_size;
-
-      // Cache the value.
-      symbols_.emplace_back(start_offset, end_offset, str_offset_ + entry.st_name);
-      symbol_added = true;
-
-      if (addr >= start_offset && addr < end_offset) {
-        *func_offset = addr - start_offset;
-        uint64_t offset = str_offset_ + entry.st_name;
-        if (offset < str_end_) {
-          return_value = elf_memory->ReadString(offset, name, str_end_ - offset);
-        }
+  // Read whole chunks of the table at once rather than entry by entry.
+  constexpr uint64_t kChunkSize = 64 * 1024;
+  uint64_t entries_per_chunk = std::max<uint64_t>(1, kChunkSize / entry_size_);
+  std::vector<uint8_t> buffer;
+  uint64_t cur_offset = offset_;
+  while (cur_offset + entry_size_ <= end_) {
+    uint64_t entries = std::min(entries_per_chunk, (end_ - cur_offset) / entry_size_);
+    // The last entry only needs to have room for a SymType.
+    size_t bytes = (entries - 1) * entry_size_ + sizeof(SymType);
+    buffer.resize(bytes);
+    if (!elf_memory->ReadFully(cur_offset, buffer.data(), bytes)) {
+      if (entries == 1) {
+        // Stop all processing, something looks like it is corrupted.
         break;
       }
+      // Find out which entry is unreadable by going one at a time.
+      entries_per_chunk = 1;
+      continue;
+    }
+    cur_offset += entries * entry_size_;
+
+    for (uint64_t i = 0; i < entries; i++) {
+      SymType entry;
+      memcpy(&entry, &buffer[i * entry_size_], sizeof(entry));
+      if (entry.st_shndx == SHN_UNDEF || ELF32_ST_TYPE(entry.st_info) != STT_FUNC ||
+          entry.st_size == 0) {
+        continue;
+      }
+      // Treat st_value as virtual address.
+      uint32_t size = std::min<uint64_t>(entry.st_size, UINT32_MAX);
+      symbols_.emplace_back(entry.st_value, size, entry.st_name);
     }
   }
 
-  if (symbol_added) {
-    std::sort(symbols_.begin(), symbols_.end(),
-              [](const Info& a, const Info& b) { return a.start_offset < b.start_offset; });
+  std::sort(symbols_.begin(), symbols_.end(), [](const Info& a, const Info& b) {
+    if (a.start_offset != b.start_offset) {
+      return a.start_offset < b.start_offset;
+    }
+    return a.size < b.size;
+  });
+  symbols_.shrink_to_fit();
+}
+
+template <typename SymType>
+bool Symbols::GetName(uint64_t addr, Memory* elf_memory, std::string* name, uint64_t* func_offset) {
+  if (!symbols_built_) {
+    BuildCache<SymType>(elf_memory);
+  }
+
+  const Info* info = GetInfoFromCache(addr);
+  if (info == nullptr) {
+    return false;
+  }
+  *func_offset = addr - info->start_offset;
+  uint64_t offset = str_offset_ + info->name;
+  if (offset >= str_end_) {
+    return false;
   }
-  return return_value;
+  return elf_memory->ReadString(offset, name, str_end_ - offset);
 }
 
 template <typename SymType>
@@ -28,12 +28,14 @@ namespace unwindstack {
 class Memory;
 
 class Symbols {
+  // One function symbol. The name is an offset from the start of the string
+  // table, which keeps an entry to 16 bytes.
   struct Info {
-    Info(uint64_t start_offset, uint64_t end_offset, uint64_t str_offset)
-        : start_offset(start_offset), end_offset(end_offset), str_offset(str_offset) {}
+    Info(uint64_t start_offset, uint32_t size, uint32_t name)
+        : start_offset(start_offset), size(size), name(name) {}
     uint64_t start_offset;
-    uint64_t end_offset;
-    uint64_t str_offset;
+    uint32_t size;
+    uint32_t name;
   };
 
  public:
@@ -51,17 +53,22 @@ class Symbols {
 
   void ClearCache() {
     symbols_.clear();
-    cur_offset_ = offset_;
+    symbols_built_ = false;
   }
 
  private:
-  uint64_t cur_offset_;
+  // Reads every function symbol in the table, in large chunks, into a
+  // vector sorted by address.
+  template <typename SymType>
+  void BuildCache(Memory* elf_memory);
+
   uint64_t offset_;
   uint64_t end_;
   uint64_t entry_size_;
   uint64_t str_offset_;
   uint64_t str_end_;
 
+  bool symbols_built_ = false;
   std::vector<Info> symbols_;
 };
 
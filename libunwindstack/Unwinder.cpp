@@ -23,6 +23,11 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
 
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
@@ -38,11 +43,45 @@
 #include <unwindstack/DexFiles.h>
 #endif
 
+#include "MemoryOfflineBuffer.h"
+
 // Use the demangler from libc++.
 extern "C" char* __cxa_demangle(const char*, char*, size_t*, int* status);
 
 namespace unwindstack {
 
+// The same names get demangled over and over when formatting tombstones and
+// profiles, so keep the results, shared by every unwinder in the process.
+static constexpr size_t kMaxDemangleCacheEntries = 4096;
+
+static std::string DemangleName(const std::string& name) {
+  static std::mutex& lock = *new std::mutex;
+  static auto& cache = *new std::unordered_map<std::string, std::string>;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    auto entry = cache.find(name);
+    if (entry != cache.end()) {
+      return entry->second;
+    }
+  }
+
+  std::string demangled;
+  char* demangled_name = __cxa_demangle(name.c_str(), nullptr, nullptr, nullptr);
+  if (demangled_name == nullptr) {
+    demangled = name;
+  } else {
+    demangled = demangled_name;
+    free(demangled_name);
+  }
+
+  std::lock_guard<std::mutex> guard(lock);
+  if (cache.size() >= kMaxDemangleCacheEntries) {
+    cache.clear();
+  }
+  cache.emplace(name, demangled);
+  return demangled;
+}
+
 // Inject extra 'virtual' frame that represents the dex pc data.
 // The dex pc is a magic register defined in the Mterp interpreter,
 // and thus it will be restored/observed in the frame after it.
@@ -148,6 +187,17 @@ void Unwinder::Unwind(const std::vector<std::string>* initial_map_names_to_skip,
   last_error_.address = 0;
   elf_from_memory_not_file_ = false;
 
+  if (stack_prefetch_size_ != 0) {
+    // Most of the reads done by the steps below are of the top of the stack,
+    // so let a caching process memory fetch it in one go.
+    uint64_t sp = regs_->sp();
+    MapInfo* stack_map = maps_->Find(sp);
+    if (stack_map != nullptr) {
+      process_memory_->Prefetch(
+          sp, std::min(stack_map->end - sp, static_cast<uint64_t>(stack_prefetch_size_)));
+    }
+  }
+
   ArchEnum arch = regs_->Arch();
 
   bool return_address_attempt = false;
@@ -331,14 +381,7 @@ std::string Unwinder::FormatFrame(const FrameData& frame) const {
   }
 
   if (!frame.function_name.empty()) {
-    char* demangled_name = __cxa_demangle(frame.function_name.c_str(), nullptr, nullptr, nullptr);
-    if (demangled_name == nullptr) {
-      data += " (" + frame.function_name;
-    } else {
-      data += " (";
-      data += demangled_name;
-      free(demangled_name);
-    }
+    data += " (" + DemangleName(frame.function_name);
     if (frame.function_offset != 0) {
       data += android::base::StringPrintf("+%" PRId64, frame.function_offset);
     }
@@ -383,7 +426,11 @@ bool UnwinderFromPid::Init(ArchEnum arch) {
   if (!maps_ptr_->Parse()) {
     return false;
   }
-  maps_ = maps_ptr_.get();
+  return Init(arch, maps_ptr_.get());
+}
+
+bool UnwinderFromPid::Init(ArchEnum arch, Maps* maps) {
+  maps_ = maps;
 
   process_memory_ = Memory::CreateProcessMemoryCached(pid_);
 
@@ -399,4 +446,44 @@ bool UnwinderFromPid::Init(ArchEnum arch) {
   return true;
 }
 
+OfflineUnwinder::OfflineUnwinder(size_t max_frames, Maps* maps)
+    : max_frames_(max_frames), maps_(maps) {}
+
+OfflineUnwinder::~OfflineUnwinder() = default;
+
+void OfflineUnwinder::Unwind(const std::vector<OfflineSample>& samples, size_t num_threads,
+                             const Callback& callback) {
+  num_threads = std::max<size_t>(1, std::min(num_threads, samples.size()));
+  while (workers_.size() < num_threads) {
+    Worker worker;
+    worker.stack.reset(new MemoryOfflineBuffer(nullptr, 0, 0));
+    worker.unwinder.reset(new Unwinder(max_frames_, maps_, worker.stack));
+    // The whole stack is already in memory.
+    worker.unwinder->SetStackPrefetchSize(0);
+    workers_.emplace_back(std::move(worker));
+  }
+
+  std::atomic<size_t> next(0);
+  auto unwind_samples = [&](Worker* worker) {
+    worker->unwinder->SetResolveNames(resolve_names_);
+    for (size_t i = next++; i < samples.size(); i = next++) {
+      const OfflineSample& sample = samples[i];
+      worker->stack->Reset(sample.stack_data, sample.stack_start,
+                           sample.stack_start + sample.stack_size);
+      worker->unwinder->SetRegs(sample.regs);
+      worker->unwinder->Unwind();
+      callback(i, worker->unwinder.get());
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; i++) {
+    threads.emplace_back(unwind_samples, &workers_[i]);
+  }
+  unwind_samples(&workers_[0]);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
 }  // namespace unwindstack
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <benchmark/benchmark.h>
+
+#include <unwindstack/MachineArm.h>
+#include <unwindstack/RegsArm.h>
+
+#include "ArmExidx.h"
+#include "ElfInterfaceArm.h"
+#include "MemoryBuffer.h"
+
+// A single exidx entry, for a function at 0x1000, undoing a typical prologue:
+//   push {r4-r11, lr}; vpush {d8-d9}; sub sp, #16
+// The entry is out of line, using the personality 1 compact model.
+static constexpr uint64_t kExidxOffset = 0x100;
+static constexpr uint32_t kEntryData[] = {
+    // Index table: prel31 function address, prel31 offset to the unwind data.
+    0x1000 - kExidxOffset, 0x4,
+    // vsp = vsp + 16, pop {d8-d9}, pop {r4-r11, r14}, finish.
+    0x810103c9, 0x8184ffb0,
+};
+
+static void InitMemory(unwindstack::MemoryBuffer* elf_memory,
+                       unwindstack::MemoryBuffer* stack_memory) {
+  elf_memory->Resize(kExidxOffset + sizeof(kEntryData));
+  memcpy(elf_memory->GetPtr(kExidxOffset), kEntryData, sizeof(kEntryData));
+  stack_memory->Resize(0x1000);
+  for (size_t i = 0; i < 0x1000 / sizeof(uint32_t); i++) {
+    reinterpret_cast<uint32_t*>(stack_memory->GetPtr(0))[i] = 0x2000 + i;
+  }
+}
+
+static void ResetRegs(unwindstack::RegsArm* regs) {
+  (*regs)[unwindstack::ARM_REG_SP] = 0x100;
+  (*regs)[unwindstack::ARM_REG_LR] = 0x3000;
+  regs->set_sp(0x100);
+  regs->set_pc(0x1010);
+}
+
+// Decodes the entry every time, as each step used to.
+static void BM_arm_exidx_decode(benchmark::State& state) {
+  unwindstack::MemoryBuffer elf_memory;
+  unwindstack::MemoryBuffer stack_memory;
+  InitMemory(&elf_memory, &stack_memory);
+  unwindstack::RegsArm regs;
+
+  for (auto _ : state) {
+    ResetRegs(&regs);
+    unwindstack::ArmExidx arm(&regs, &elf_memory, &stack_memory);
+    arm.set_cfa(regs.sp());
+    if (!arm.ExtractEntryData(kExidxOffset) || !arm.Eval()) {
+      state.SkipWithError("Failed to evaluate the exidx entry.");
+      break;
+    }
+    benchmark::DoNotOptimize(arm.cfa());
+  }
+}
+BENCHMARK(BM_arm_exidx_decode);
+
+// Steps through the function the way the unwinder does.
+static void BM_arm_exidx_step(benchmark::State& state) {
+  unwindstack::MemoryBuffer elf_memory;
+  unwindstack::MemoryBuffer stack_memory;
+  InitMemory(&elf_memory, &stack_memory);
+  unwindstack::ElfInterfaceArm interface(&elf_memory);
+  interface.HandleUnknownType(0x70000001 /* PT_ARM_EXIDX */, kExidxOffset, 8);
+  unwindstack::RegsArm regs;
+
+  for (auto _ : state) {
+    ResetRegs(&regs);
+    bool finished;
+    if (!interface.StepExidx(0x1010, &regs, &stack_memory, &finished)) {
+      state.SkipWithError("Failed to step through the exidx entry.");
+      break;
+    }
+    benchmark::DoNotOptimize(regs.pc());
+  }
+}
+BENCHMARK(BM_arm_exidx_step);
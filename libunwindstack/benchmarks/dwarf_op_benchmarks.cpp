@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <unwindstack/DwarfLocation.h>
+#include <unwindstack/DwarfMemory.h>
+#include <unwindstack/MachineX86_64.h>
+#include <unwindstack/RegsX86_64.h>
+
+#include "DwarfOp.h"
+#include "MemoryBuffer.h"
+#include "RegsInfo.h"
+
+static const std::vector<uint8_t> kExpression = {
+    // The CFA expression of the x86_64 signal return trampoline:
+    //   DW_OP_breg7 (rsp) 160; DW_OP_deref
+    0x77, 0xa0, 0x01, 0x06,
+    // A loop counting down from three, to exercise the arithmetic and branch ops:
+    //   DW_OP_lit3; loop: DW_OP_lit1; DW_OP_minus; DW_OP_dup; DW_OP_bra loop
+    0x33, 0x31, 0x1c, 0x12, 0x28, 0xfa, 0xff,
+};
+
+static void InitMemory(unwindstack::MemoryBuffer* op_memory,
+                       unwindstack::MemoryBuffer* stack_memory) {
+  op_memory->Resize(kExpression.size());
+  memcpy(op_memory->GetPtr(0), kExpression.data(), kExpression.size());
+  stack_memory->Resize(0x1000);
+  for (size_t i = 0; i < 0x1000 / sizeof(uint64_t); i++) {
+    reinterpret_cast<uint64_t*>(stack_memory->GetPtr(0))[i] = i * sizeof(uint64_t);
+  }
+}
+
+// Reads and decodes the ops on every evaluation, as each step used to.
+static void BM_dwarf_op_eval(benchmark::State& state) {
+  unwindstack::MemoryBuffer op_memory;
+  unwindstack::MemoryBuffer stack_memory;
+  InitMemory(&op_memory, &stack_memory);
+  unwindstack::DwarfMemory dwarf_memory(&op_memory);
+  unwindstack::RegsX86_64 regs;
+  regs[unwindstack::X86_64_REG_RSP] = 0x100;
+  unwindstack::RegsInfo<uint64_t> regs_info(&regs);
+  unwindstack::DwarfOp<uint64_t> op(&dwarf_memory, &stack_memory);
+  op.set_regs_info(&regs_info);
+
+  for (auto _ : state) {
+    if (!op.Eval(0, kExpression.size())) {
+      state.SkipWithError("Failed to evaluate the expression.");
+      break;
+    }
+    benchmark::DoNotOptimize(op.StackAt(0));
+  }
+}
+BENCHMARK(BM_dwarf_op_eval);
+
+// Evaluates the expression decoded ahead of time.
+static void BM_dwarf_op_eval_decoded(benchmark::State& state) {
+  unwindstack::MemoryBuffer op_memory;
+  unwindstack::MemoryBuffer stack_memory;
+  InitMemory(&op_memory, &stack_memory);
+  unwindstack::DwarfMemory dwarf_memory(&op_memory);
+  unwindstack::RegsX86_64 regs;
+  regs[unwindstack::X86_64_REG_RSP] = 0x100;
+  unwindstack::RegsInfo<uint64_t> regs_info(&regs);
+  unwindstack::DwarfOp<uint64_t> op(&dwarf_memory, &stack_memory);
+  op.set_regs_info(&regs_info);
+  unwindstack::DwarfExpression expression;
+  if (!op.Compile(0, kExpression.size(), &expression)) {
+    state.SkipWithError("Failed to decode the expression.");
+    return;
+  }
+
+  for (auto _ : state) {
+    if (!op.Eval(expression)) {
+      state.SkipWithError("Failed to evaluate the expression.");
+      break;
+    }
+    benchmark::DoNotOptimize(op.StackAt(0));
+  }
+}
+BENCHMARK(BM_dwarf_op_eval_decoded);
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+
+#include <unwindstack/MachineArm64.h>
+#include <unwindstack/Maps.h>
+#include <unwindstack/Memory.h>
+#include <unwindstack/RegsArm64.h>
+#include <unwindstack/Unwinder.h>
+
+// Unwinds copies of one of the offline test samples, the way a profiler
+// post-processes the samples it captured from a process.
+class OfflineSamples {
+ public:
+  static constexpr size_t kNumSamples = 1024;
+
+  bool Init(benchmark::State& state) {
+    std::string dir =
+        android::base::GetExecutableDirectory() + "/tests/files/offline/straddle_arm64/";
+    std::string maps_data;
+    std::string regs_data;
+    if (!android::base::ReadFileToString(dir + "maps.txt", &maps_data) ||
+        !android::base::ReadFileToString(dir + "regs.txt", &regs_data) ||
+        !android::base::ReadFileToString(dir + "stack.data", &stack_) ||
+        stack_.size() <= sizeof(uint64_t)) {
+      state.SkipWithError("Failed to read the offline files.");
+      return false;
+    }
+    memcpy(&stack_start_, stack_.data(), sizeof(stack_start_));
+
+    maps_.reset(new unwindstack::BufferMaps(maps_data.c_str()));
+    if (!maps_->Parse()) {
+      state.SkipWithError("Failed to parse the offline maps.");
+      return false;
+    }
+
+    regs_.reset(new unwindstack::RegsArm64);
+    for (const auto& line : android::base::Split(regs_data, "\n")) {
+      char name[16];
+      uint64_t value;
+      if (sscanf(line.c_str(), "%15[^:]: %" SCNx64, name, &value) != 2) {
+        continue;
+      }
+      if (strcmp(name, "pc") == 0) {
+        regs_->set_pc(value);
+      } else if (strcmp(name, "sp") == 0) {
+        regs_->set_sp(value);
+      } else if (strcmp(name, "lr") == 0) {
+        (*regs_)[unwindstack::ARM64_REG_LR] = value;
+      } else if (name[0] == 'x') {
+        (*regs_)[unwindstack::ARM64_REG_R0 + atoi(&name[1])] = value;
+      }
+    }
+
+    // The maps name the elf files relative to the sample directory.
+    if (chdir(dir.c_str()) != 0) {
+      state.SkipWithError("Failed to change to the offline directory.");
+      return false;
+    }
+    return true;
+  }
+
+  // Unwinding moves the registers, so each run needs fresh copies.
+  std::vector<unwindstack::OfflineSample>& Reset() {
+    regs_copies_.clear();
+    samples_.clear();
+    for (size_t i = 0; i < kNumSamples; i++) {
+      regs_copies_.emplace_back(regs_->Clone());
+      samples_.push_back({regs_copies_.back().get(), stack_start_,
+                          reinterpret_cast<const uint8_t*>(stack_.data()) + sizeof(uint64_t),
+                          stack_.size() - sizeof(uint64_t)});
+    }
+    return samples_;
+  }
+
+  unwindstack::Maps* maps() { return maps_.get(); }
+
+ private:
+  std::unique_ptr<unwindstack::Maps> maps_;
+  std::unique_ptr<unwindstack::RegsArm64> regs_;
+  std::string stack_;
+  uint64_t stack_start_;
+  std::vector<std::unique_ptr<unwindstack::Regs>> regs_copies_;
+  std::vector<unwindstack::OfflineSample> samples_;
+};
+
+// A new Unwinder and stack memory for every sample.
+static void BM_offline_unwind_per_sample(benchmark::State& state) {
+  OfflineSamples samples;
+  if (!samples.Init(state)) {
+    return;
+  }
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto& batch = samples.Reset();
+    state.ResumeTiming();
+
+    for (const auto& sample : batch) {
+      auto stack = unwindstack::Memory::CreateOfflineMemory(
+          sample.stack_data, sample.stack_start, sample.stack_start + sample.stack_size);
+      unwindstack::Unwinder unwinder(128, samples.maps(), sample.regs, stack);
+      unwinder.Unwind();
+      benchmark::DoNotOptimize(unwinder.NumFrames());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * OfflineSamples::kNumSamples);
+}
+BENCHMARK(BM_offline_unwind_per_sample)->UseRealTime();
+
+// The same samples through an OfflineUnwinder, on state.range(0) threads.
+static void BM_offline_unwind_batch(benchmark::State& state) {
+  OfflineSamples samples;
+  if (!samples.Init(state)) {
+    return;
+  }
+
+  unwindstack::OfflineUnwinder unwinder(128, samples.maps());
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto& batch = samples.Reset();
+    state.ResumeTiming();
+
+    std::atomic<size_t> num_frames(0);
+    unwinder.Unwind(batch, state.range(0), [&num_frames](size_t, unwindstack::Unwinder* sample) {
+      num_frames += sample->NumFrames();
+    });
+    benchmark::DoNotOptimize(num_frames.load());
+  }
+  state.SetItemsProcessed(state.iterations() * OfflineSamples::kNumSamples);
+}
+BENCHMARK(BM_offline_unwind_batch)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
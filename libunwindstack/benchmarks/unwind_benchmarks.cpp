@@ -15,14 +15,18 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 
 #include <memory>
+#include <vector>
 
 #include <benchmark/benchmark.h>
 
 #include <android-base/strings.h>
 
+#include <unwindstack/DwarfSection.h>
 #include <unwindstack/Elf.h>
+#include <unwindstack/ElfInterface.h>
 #include <unwindstack/Maps.h>
 #include <unwindstack/Memory.h>
 #include <unwindstack/Regs.h>
@@ -142,4 +146,102 @@ static void BM_get_build_id_from_file(benchmark::State& state) {
 }
 BENCHMARK(BM_get_build_id_from_file);
 
+// Steps out of the frame of this function over and over, the way a sampling
+// profiler unwinds the same hot pcs. The cached version goes through
+// Elf::Step, which keeps the flattened rules for the pc range after the first
+// step. The uncached version redoes what every step used to: find the FDE,
+// evaluate the CIE and FDE CFA instructions, then evaluate the rules.
+static void DwarfStep(benchmark::State& state, bool cached) {
+  auto process_memory = unwindstack::Memory::CreateProcessMemory(getpid());
+  unwindstack::LocalMaps maps;
+  if (!maps.Parse()) {
+    state.SkipWithError("Failed to parse local maps.");
+    return;
+  }
+
+  std::unique_ptr<unwindstack::Regs> initial_regs(unwindstack::Regs::CreateFromLocal());
+  unwindstack::RegsGetLocal(initial_regs.get());
+  unwindstack::MapInfo* map_info = maps.Find(initial_regs->pc());
+  if (map_info == nullptr) {
+    state.SkipWithError("Failed to find the map of the current pc.");
+    return;
+  }
+  unwindstack::Elf* elf = map_info->GetElf(process_memory, initial_regs->Arch());
+  if (!elf->valid()) {
+    state.SkipWithError("Cannot get valid elf from map.");
+    return;
+  }
+  uint64_t rel_pc = elf->GetRelPc(initial_regs->pc(), map_info);
+
+  unwindstack::DwarfSection* section = nullptr;
+  const unwindstack::DwarfFde* fde = nullptr;
+  for (auto* candidate : {elf->interface()->debug_frame(), elf->interface()->eh_frame()}) {
+    if (candidate != nullptr && (fde = candidate->GetFdeFromPc(rel_pc)) != nullptr) {
+      section = candidate;
+      break;
+    }
+  }
+  if (section == nullptr) {
+    state.SkipWithError("No dwarf information for the current pc.");
+    return;
+  }
+
+  std::unique_ptr<unwindstack::Regs> regs(initial_regs->Clone());
+  size_t regs_size = regs->total_regs() * (regs->Is32Bit() ? sizeof(uint32_t) : sizeof(uint64_t));
+  for (auto _ : state) {
+    memcpy(regs->RawData(), initial_regs->RawData(), regs_size);
+    bool finished;
+    if (cached) {
+      benchmark::DoNotOptimize(elf->Step(rel_pc, regs.get(), process_memory.get(), &finished));
+    } else {
+      fde = section->GetFdeFromPc(rel_pc);
+      unwindstack::dwarf_loc_regs_t loc_regs;
+      section->GetCfaLocationInfo(rel_pc, fde, &loc_regs);
+      benchmark::DoNotOptimize(
+          section->Eval(fde->cie, process_memory.get(), loc_regs, regs.get(), &finished));
+    }
+  }
+}
+
+static void BM_dwarf_step_cached(benchmark::State& state) {
+  DwarfStep(state, true);
+}
+BENCHMARK(BM_dwarf_step_cached);
+
+static void BM_dwarf_step_uncached(benchmark::State& state) {
+  DwarfStep(state, false);
+}
+BENCHMARK(BM_dwarf_step_uncached);
+
+static void BM_local_updatable_maps_reparse(benchmark::State& state) {
+  unwindstack::LocalUpdatableMaps maps;
+  if (!maps.Parse()) {
+    state.SkipWithError("Failed to parse local maps.");
+  }
+  for (auto _ : state) {
+    if (!maps.Reparse()) {
+      state.SkipWithError("Failed to reparse local maps.");
+    }
+  }
+}
+BENCHMARK(BM_local_updatable_maps_reparse);
+
+static void BM_maps_find(benchmark::State& state) {
+  unwindstack::LocalMaps maps;
+  if (!maps.Parse() || maps.Total() == 0) {
+    state.SkipWithError("Failed to parse local maps.");
+    return;
+  }
+  std::vector<uint64_t> pcs;
+  for (const auto& map_info : maps) {
+    pcs.push_back(map_info->start + (map_info->end - map_info->start) / 2);
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(maps.Find(pcs[i]));
+    i = (i + 1) % pcs.size();
+  }
+}
+BENCHMARK(BM_maps_find);
+
 BENCHMARK_MAIN();
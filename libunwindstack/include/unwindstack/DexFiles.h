@@ -21,8 +21,10 @@
 
 #include <memory>
 #include <mutex>
+#include <set>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <unwindstack/Global.h>
@@ -50,15 +52,22 @@ class DexFiles : public Global {
  private:
   void Init(Maps* maps);
 
-  bool GetAddr(size_t index, uint64_t* addr);
+  bool GetMethodInformationFromAddr(uint64_t addr, MapInfo* info, uint64_t dex_pc,
+                                    std::string* method_name, uint64_t* method_offset);
 
-  uint64_t ReadEntryPtr32(uint64_t addr);
+  bool ReadEntryPtr32(uint64_t addr, uint64_t* entry);
 
-  uint64_t ReadEntryPtr64(uint64_t addr);
+  bool ReadEntryPtr64(uint64_t addr, uint64_t* entry);
 
-  bool ReadEntry32();
+  bool ReadEntry32(uint64_t addr, uint64_t* next, uint64_t* dex_file);
 
-  bool ReadEntry64();
+  bool ReadEntry64(uint64_t addr, uint64_t* next, uint64_t* dex_file);
+
+  // Reads the entry at addr, unless it was already read.
+  bool ReadEntry(uint64_t addr, uint64_t* next, uint64_t* dex_file);
+
+  // Reads only the entries added to the list since it was last read.
+  void ReadNewEntries();
 
   bool ReadVariableData(uint64_t ptr_offset) override;
 
@@ -68,10 +77,17 @@ class DexFiles : public Global {
   bool initialized_ = false;
   std::unordered_map<uint64_t, std::unique_ptr<DexFile>> files_;
 
+  uint64_t descriptor_addr_ = 0;
+  uint64_t head_entry_ = 0;
   uint64_t entry_addr_ = 0;
-  uint64_t (DexFiles::*read_entry_ptr_func_)(uint64_t) = nullptr;
-  bool (DexFiles::*read_entry_func_)() = nullptr;
-  std::vector<uint64_t> addrs_;
+  bool has_seqlock_ = false;
+  uint32_t seqlock_ = 0;
+  bool (DexFiles::*read_entry_ptr_func_)(uint64_t, uint64_t*) = nullptr;
+  bool (DexFiles::*read_entry_func_)(uint64_t, uint64_t*, uint64_t*) = nullptr;
+  std::unordered_set<uint64_t> seen_entries_;
+  // The addresses of all of the dex files read, sorted to find the ones in
+  // a map quickly.
+  std::set<uint64_t> addrs_;
 };
 
 }  // namespace unwindstack
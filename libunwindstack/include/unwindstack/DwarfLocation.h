@@ -20,6 +20,7 @@
 #include <stdint.h>
 
 #include <unordered_map>
+#include <vector>
 
 namespace unwindstack {
 
@@ -48,6 +49,40 @@ struct DwarfLocations : public std::unordered_map<uint32_t, DwarfLocation> {
 };
 typedef DwarfLocations dwarf_loc_regs_t;
 
+struct DwarfRegRule {
+  uint32_t reg;
+  DwarfLocation location;
+};
+
+// The same rules as a DwarfLocations, flattened for evaluation: the CFA rule
+// is pulled out and the register rules are kept in an array sorted by register.
+struct DwarfRegRules {
+  const DwarfCie* cie = nullptr;
+  // The range of PCs where the rules are valid (end is exclusive).
+  uint64_t pc_start = 0;
+  uint64_t pc_end = 0;
+  bool cfa_defined = false;
+  DwarfLocation cfa{DWARF_LOCATION_INVALID, {0, 0}};
+  std::vector<DwarfRegRule> regs;
+};
+
+struct DwarfExpressionOp {
+  uint8_t op;
+  uint8_t handle_func;
+  uint8_t num_required_stack_values;
+  uint8_t num_operands;
+  // For the branch ops, these are the indexes of the ops to continue at.
+  uint64_t operands[2];
+};
+
+// A DWARF expression decoded once, so that it can be evaluated again without
+// reading and decoding the op data.
+struct DwarfExpression {
+  uint64_t start = 0;
+  bool dex_pc_set = false;
+  std::vector<DwarfExpressionOp> ops;
+};
+
 }  // namespace unwindstack
 
 #endif  // _LIBUNWINDSTACK_DWARF_LOCATION_H
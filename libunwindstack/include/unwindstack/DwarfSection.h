@@ -22,6 +22,7 @@
 #include <iterator>
 #include <map>
 #include <unordered_map>
+#include <vector>
 
 #include <unwindstack/DwarfError.h>
 #include <unwindstack/DwarfLocation.h>
@@ -90,6 +91,8 @@ class DwarfSection {
 
   virtual bool Eval(const DwarfCie*, Memory*, const dwarf_loc_regs_t&, Regs*, bool*) = 0;
 
+  virtual bool EvalRules(const DwarfCie*, Memory*, const DwarfRegRules&, Regs*, bool*) = 0;
+
   virtual bool Log(uint8_t indent, uint64_t pc, const DwarfFde* fde) = 0;
 
   virtual void GetFdes(std::vector<const DwarfFde*>* fdes) = 0;
@@ -104,8 +107,14 @@ class DwarfSection {
 
   virtual uint64_t AdjustPcFromFde(uint64_t pc) = 0;
 
+  // Returns the number of bytes used by the pc to fde lookup table kept for
+  // the section, if it builds one.
+  virtual size_t FdeIndexMemorySize() { return 0; }
+
   bool Step(uint64_t pc, Regs* regs, Memory* process_memory, bool* finished);
 
+  static void FlattenLocations(const dwarf_loc_regs_t& loc_regs, DwarfRegRules* rules);
+
  protected:
   DwarfMemory memory_;
   DwarfErrorData last_error_{DWARF_ERROR_NONE, 0};
@@ -116,7 +125,8 @@ class DwarfSection {
   std::unordered_map<uint64_t, DwarfFde> fde_entries_;
   std::unordered_map<uint64_t, DwarfCie> cie_entries_;
   std::unordered_map<uint64_t, dwarf_loc_regs_t> cie_loc_regs_;
-  std::map<uint64_t, dwarf_loc_regs_t> loc_regs_;  // Single row indexed by pc_end.
+  std::map<uint64_t, DwarfRegRules> loc_regs_;  // Single row indexed by pc_end.
+  std::unordered_map<uint64_t, DwarfExpression> expressions_;  // Indexed by the end of the op data.
 };
 
 template <typename AddressType>
@@ -134,6 +144,9 @@ class DwarfSectionImpl : public DwarfSection {
   bool Eval(const DwarfCie* cie, Memory* regular_memory, const dwarf_loc_regs_t& loc_regs,
             Regs* regs, bool* finished) override;
 
+  bool EvalRules(const DwarfCie* cie, Memory* regular_memory, const DwarfRegRules& rules,
+                 Regs* regs, bool* finished) override;
+
   bool GetCfaLocationInfo(uint64_t pc, const DwarfFde* fde, dwarf_loc_regs_t* loc_regs) override;
 
   bool Log(uint8_t indent, uint64_t pc, const DwarfFde* fde) override;
@@ -181,14 +194,27 @@ class DwarfSectionImplNoHdr : public DwarfSectionImpl<AddressType> {
 
   void GetFdes(std::vector<const DwarfFde*>* fdes) override;
 
+  size_t FdeIndexMemorySize() override { return fde_index_.capacity() * sizeof(FdeRange); }
+
  protected:
+  struct FdeRange {
+    uint64_t pc_start;
+    uint64_t pc_end;
+    uint64_t fde_offset;
+  };
+
   bool GetNextCieOrFde(DwarfFde** fde_entry);
 
-  void InsertFde(const DwarfFde* fde);
+  void InsertFde(uint64_t start, uint64_t end, uint64_t fde_offset,
+                 std::map<uint64_t, FdeRange>* fdes);
+
+  void BuildFdeIndex();
 
   uint64_t next_entries_offset_ = 0;
 
-  std::map<uint64_t, std::pair<uint64_t, const DwarfFde*>> fdes_;
+  // Sorted by pc_end, with no overlapping ranges.
+  std::vector<FdeRange> fde_index_;
+  bool fde_index_built_ = false;
 };
 
 }  // namespace unwindstack
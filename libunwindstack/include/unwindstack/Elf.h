@@ -38,6 +38,14 @@ namespace unwindstack {
 struct MapInfo;
 class Regs;
 
+struct ElfCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  size_t elfs = 0;
+  uint64_t bytes = 0;
+};
+
 enum ArchEnum : uint8_t {
   ARCH_UNKNOWN = 0,
   ARCH_ARM,
@@ -108,8 +116,15 @@ class Elf {
   static void SetCachingEnabled(bool enable);
   static bool CachingEnabled() { return cache_enabled_; }
 
-  static void CacheLock();
-  static void CacheUnlock();
+  // Limits the total size of the elf files that the cache keeps alive. When
+  // it is exceeded, the least recently used elf objects are dropped from the
+  // cache. Zero, the default, means no limit.
+  static void SetCacheMemoryBudget(uint64_t bytes);
+  static ElfCacheStats GetCacheStats();
+
+  // The cache is split into shards by map name, these lock the shard of info.
+  static void CacheLock(MapInfo* info);
+  static void CacheUnlock(MapInfo* info);
   static void CacheAdd(MapInfo* info);
   static bool CacheGet(MapInfo* info);
   static bool CacheAfterCreateMemory(MapInfo* info);
@@ -129,8 +144,6 @@ class Elf {
   std::unique_ptr<ElfInterface> gnu_debugdata_interface_;
 
   static bool cache_enabled_;
-  static std::unordered_map<std::string, std::pair<std::shared_ptr<Elf>, bool>>* cache_;
-  static std::mutex* cache_lock_;
 };
 
 }  // namespace unwindstack
@@ -93,6 +93,9 @@ class ElfInterface {
   DwarfSection* eh_frame() { return eh_frame_.get(); }
   DwarfSection* debug_frame() { return debug_frame_.get(); }
 
+  // The bytes used by the pc lookup tables of the dwarf sections built so far.
+  size_t DwarfIndexMemorySize();
+
   const ErrorData& last_error() { return last_error_; }
   ErrorCode LastErrorCode() { return last_error_.code; }
   uint64_t LastErrorAddress() { return last_error_.address; }
@@ -48,6 +48,12 @@ class Global {
   uint64_t GetVariableOffset(MapInfo* info, const std::string& variable);
   void FindAndReadVariable(Maps* maps, const char* variable);
 
+  // ART follows the first_entry field of the jit and dex descriptors with
+  // fields that start with the magic "Android1". The action_seqlock among
+  // them is odd while the list is being changed, and advances with every
+  // change. Returns false if the descriptor at addr lacks these fields.
+  bool ReadDescriptorSeqlock(uint64_t addr, uint32_t* seqlock);
+
   virtual bool ReadVariableData(uint64_t offset) = 0;
 
   virtual void ProcessArch() = 0;
@@ -19,9 +19,12 @@
 
 #include <stdint.h>
 
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <unwindstack/Global.h>
@@ -45,23 +48,43 @@ class JitDebug : public Global {
  private:
   void Init(Maps* maps);
 
-  uint64_t (JitDebug::*read_descriptor_func_)(uint64_t) = nullptr;
-  uint64_t (JitDebug::*read_entry_func_)(uint64_t*, uint64_t*) = nullptr;
+  bool (JitDebug::*read_descriptor_func_)(uint64_t, uint64_t*) = nullptr;
+  bool (JitDebug::*read_entry_func_)(uint64_t, uint64_t*, uint64_t*, uint64_t*) = nullptr;
 
-  uint64_t ReadDescriptor32(uint64_t);
-  uint64_t ReadDescriptor64(uint64_t);
+  bool ReadDescriptor32(uint64_t addr, uint64_t* first_entry);
+  bool ReadDescriptor64(uint64_t addr, uint64_t* first_entry);
 
-  uint64_t ReadEntry32Pack(uint64_t* start, uint64_t* size);
-  uint64_t ReadEntry32Pad(uint64_t* start, uint64_t* size);
-  uint64_t ReadEntry64(uint64_t* start, uint64_t* size);
+  bool ReadEntry32Pack(uint64_t addr, uint64_t* next, uint64_t* start, uint64_t* size);
+  bool ReadEntry32Pad(uint64_t addr, uint64_t* next, uint64_t* start, uint64_t* size);
+  bool ReadEntry64(uint64_t addr, uint64_t* next, uint64_t* start, uint64_t* size);
 
   bool ReadVariableData(uint64_t ptr_offset) override;
 
   void ProcessArch() override;
 
+  // Reads the entry at addr and returns its elf, or nullptr if the entry
+  // was already read or does not hold a valid elf.
+  Elf* ReadEntryElf(uint64_t addr, uint64_t* next);
+
+  Elf* FindElf(uint64_t pc);
+
+  // Reads only the entries added to the list since it was last read.
+  // Returns the elf of one of them that contains pc.
+  Elf* ReadNewEntries(uint64_t pc);
+
+  uint64_t descriptor_addr_ = 0;
+  uint64_t head_entry_ = 0;
   uint64_t entry_addr_ = 0;
+  bool has_seqlock_ = false;
+  uint32_t seqlock_ = 0;
   bool initialized_ = false;
   std::vector<Elf*> elf_list_;
+  std::unordered_set<uint64_t> seen_entries_;
+
+  // The executable ranges of the elf objects, keyed by start, and the elf
+  // objects without any PT_LOAD to index.
+  std::map<uint64_t, std::pair<uint64_t, Elf*>> elf_ranges_;
+  std::vector<Elf*> unindexed_elfs_;
 
   std::mutex lock_;
 };
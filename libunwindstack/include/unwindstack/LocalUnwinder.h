@@ -34,6 +34,7 @@ namespace unwindstack {
 // Forward declarations.
 class Elf;
 struct MapInfo;
+class Regs;
 
 struct LocalFrameData {
   LocalFrameData(MapInfo* map_info, uint64_t pc, uint64_t rel_pc, const std::string& function_name,
@@ -66,6 +67,17 @@ class LocalUnwinder {
 
   bool Unwind(std::vector<LocalFrameData>* frame_info, size_t max_frames);
 
+  // Unwinds like Unwind, but only records the pc of each frame, and never
+  // looks up function names. Every pc but the first is a return address.
+  bool UnwindPcs(std::vector<uint64_t>* pcs, size_t max_frames);
+
+  // When enabled, UnwindPcs follows the frame pointer chain on arm64 and
+  // x86_64, and only uses the unwind information in the elf files for a frame
+  // whose record is not on this thread's stack or does not return into
+  // executable code. This is much faster, but can miss frames in code built
+  // without frame pointers. Set this before the first unwind.
+  void SetFramePointerUnwinding(bool enable) { frame_pointer_unwinding_ = enable; }
+
   bool ShouldSkipLibrary(const std::string& map_name);
 
   MapInfo* GetMapInfo(uint64_t pc);
@@ -74,10 +86,16 @@ class LocalUnwinder {
   uint64_t LastErrorAddress() { return last_error_.address; }
 
  private:
+  // Like GetMapInfo, but never reparses the maps.
+  MapInfo* FindMapInfo(uint64_t pc);
+
+  bool StepFramePointer(Regs* regs, uint16_t fp_reg, MapInfo* stack_map);
+
   pthread_rwlock_t maps_rwlock_;
   std::unique_ptr<LocalUpdatableMaps> maps_ = nullptr;
   std::shared_ptr<Memory> process_memory_;
   std::vector<std::string> skip_libraries_;
+  bool frame_pointer_unwinding_ = false;
   ErrorData last_error_;
 };
 
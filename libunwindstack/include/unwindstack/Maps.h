@@ -76,7 +76,15 @@ class Maps {
   }
 
  protected:
+  // Rebuilds the index that Find searches from maps_, which has to be sorted.
+  void UpdateIndex();
+
   std::vector<std::unique_ptr<MapInfo>> maps_;
+
+ private:
+  // The end of every map, in the same order as maps_, so that Find only
+  // touches the MapInfo it returns.
+  std::vector<uint64_t> ends_;
 };
 
 class RemoteMaps : public Maps {
@@ -101,6 +109,8 @@ class LocalUpdatableMaps : public Maps {
   LocalUpdatableMaps() : Maps() {}
   virtual ~LocalUpdatableMaps() = default;
 
+  // Parses the maps again, keeping the MapInfo, and any elf already created
+  // for it, of every map that has not changed.
   bool Reparse();
 
   const std::string GetMapsFile() const override;
@@ -23,9 +23,18 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace unwindstack {
 
+struct MemoryReadRequest {
+  uint64_t addr;
+  void* dst;
+  size_t size;
+  // Set by ReadBatch to what Read would have returned for this request.
+  size_t bytes_read = 0;
+};
+
 class Memory {
  public:
   Memory() = default;
@@ -43,6 +52,14 @@ class Memory {
 
   virtual size_t Read(uint64_t addr, void* dst, size_t size) = 0;
 
+  // Reads every request, setting its bytes_read. Memory that can read several
+  // ranges with one system call overrides this, the default reads one at a time.
+  virtual void ReadBatch(std::vector<MemoryReadRequest>* requests);
+
+  // A hint that the given range is about to be read in small pieces. Only
+  // MemoryCache does anything with it.
+  virtual void Prefetch(uint64_t, size_t) {}
+
   bool ReadFully(uint64_t addr, void* dst, size_t size);
 
   inline bool Read32(uint64_t addr, uint32_t* dst) {
@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -35,6 +36,7 @@ namespace unwindstack {
 
 // Forward declarations.
 class Elf;
+class MemoryOfflineBuffer;
 enum ArchEnum : uint8_t;
 
 struct FrameData {
@@ -107,6 +109,10 @@ class Unwinder {
 
   void SetDisplayBuildID(bool display_build_id) { display_build_id_ = display_build_id; }
 
+  // How much of the stack, starting at the initial sp, to hand to the process
+  // memory's Prefetch before unwinding. Zero disables the prefetch.
+  void SetStackPrefetchSize(size_t size) { stack_prefetch_size_ = size; }
+
 #if !defined(NO_LIBDEXFILE_SUPPORT)
   void SetDexFiles(DexFiles* dex_files, ArchEnum arch);
 #endif
@@ -134,6 +140,7 @@ class Unwinder {
   bool resolve_names_ = true;
   bool embedded_soname_ = true;
   bool display_build_id_ = false;
+  size_t stack_prefetch_size_ = 32 * 1024;
   // True if at least one elf file is coming from memory and not the related
   // file. This is only true if there is an actual file backing up the elf.
   bool elf_from_memory_not_file_ = false;
@@ -146,6 +153,13 @@ class UnwinderFromPid : public Unwinder {
   virtual ~UnwinderFromPid() = default;
 
   bool Init(ArchEnum arch);
+  // Unwinds with maps, which the caller owns, instead of parsing them. The
+  // maps, and the elf data in them, can be shared with unwinders running on
+  // other threads; everything else, such as the process memory and its cache,
+  // belongs to this unwinder.
+  bool Init(ArchEnum arch, Maps* maps);
+
+  pid_t pid() { return pid_; }
 
  private:
   pid_t pid_;
@@ -156,6 +170,48 @@ class UnwinderFromPid : public Unwinder {
 #endif
 };
 
+// The registers of a thread and a copy of its stack, captured while it ran.
+struct OfflineSample {
+  // Unwinding moves these to the outermost frame, so each sample can only be
+  // unwound once.
+  Regs* regs;
+  uint64_t stack_start;
+  const uint8_t* stack_data;
+  size_t stack_size;
+};
+
+// Unwinds many samples captured from the same process. The maps, and the Elf
+// objects created for them, are shared by every sample. Each thread keeps an
+// Unwinder, its stack memory and its frame buffer, and reuses them for every
+// sample, across calls to Unwind.
+class OfflineUnwinder {
+ public:
+  OfflineUnwinder(size_t max_frames, Maps* maps);
+  ~OfflineUnwinder();
+
+  // Called on the thread that unwound samples[index], with the unwinder
+  // holding its frames. The frames are only valid until the callback returns.
+  using Callback = std::function<void(size_t index, Unwinder* unwinder)>;
+
+  // Unwinds every sample, spread across up to num_threads threads, the
+  // calling thread included.
+  void Unwind(const std::vector<OfflineSample>& samples, size_t num_threads,
+              const Callback& callback);
+
+  void SetResolveNames(bool resolve) { resolve_names_ = resolve; }
+
+ private:
+  struct Worker {
+    std::shared_ptr<MemoryOfflineBuffer> stack;
+    std::unique_ptr<Unwinder> unwinder;
+  };
+
+  size_t max_frames_;
+  Maps* maps_;
+  bool resolve_names_ = true;
+  std::vector<Worker> workers_;
+};
+
 }  // namespace unwindstack
 
 #endif  // _LIBUNWINDSTACK_UNWINDER_H
@@ -1665,4 +1665,56 @@ TEST_P(ArmExidxDecodeTest, eval_pc_set) {
 INSTANTIATE_TEST_SUITE_P(, ArmExidxDecodeTest,
                          ::testing::Values("logging", "register_logging", "no_logging"));
 
+// Compares a compiled program against decoding the same bytes directly, for
+// every pair of leading bytes.
+TEST(ArmExidxCompileTest, matches_decode) {
+  MemoryFake elf_memory;
+  MemoryFake process_memory;
+  // Only eight registers worth of stack, so that long pops fail part way.
+  for (uint32_t i = 0; i < 8; i++) {
+    process_memory.SetData32(0x10000 + i * 4, 0x1000 + i);
+  }
+
+  auto init_regs = [](RegsArm* regs) {
+    for (size_t i = 0; i < regs->total_regs(); i++) {
+      (*regs)[i] = 0x10000 + i * 4;
+    }
+  };
+
+  for (size_t first = 0; first < 0x100; first++) {
+    for (size_t second = 0; second < 0x100; second++) {
+      SCOPED_TRACE(testing::Message() << std::hex << "0x" << first << " 0x" << second);
+      std::deque<uint8_t> data{static_cast<uint8_t>(first), static_cast<uint8_t>(second),
+                               ARM_OP_FINISH};
+
+      RegsArm decode_regs;
+      init_regs(&decode_regs);
+      ArmExidx decode(&decode_regs, &elf_memory, &process_memory);
+      decode.set_cfa(0x10000);
+      *decode.data() = data;
+      bool decode_result = decode.Eval();
+
+      RegsArm compile_regs;
+      init_regs(&compile_regs);
+      ArmExidx compile(&compile_regs, &elf_memory, &process_memory);
+      compile.set_cfa(0x10000);
+      *compile.data() = data;
+      ArmExidxProgram program;
+      compile.Compile(&program);
+      bool compile_result = compile.Eval(program);
+
+      ASSERT_EQ(decode_result, compile_result);
+      ASSERT_EQ(decode.status(), compile.status());
+      if (decode.status() == ARM_STATUS_READ_FAILED) {
+        ASSERT_EQ(decode.status_address(), compile.status_address());
+      }
+      ASSERT_EQ(decode.cfa(), compile.cfa());
+      ASSERT_EQ(decode.pc_set(), compile.pc_set());
+      for (size_t i = 0; i < decode_regs.total_regs(); i++) {
+        ASSERT_EQ(decode_regs[i], compile_regs[i]) << "r" << i;
+      }
+    }
+  }
+}
+
 }  // namespace unwindstack
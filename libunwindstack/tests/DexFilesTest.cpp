@@ -233,6 +233,38 @@ TEST_F(DexFilesTest, get_method_information_cached) {
   EXPECT_EQ(0U, method_offset);
 }
 
+TEST_F(DexFilesTest, get_method_information_new_entries) {
+  std::string method_name = "nothing";
+  uint64_t method_offset = 0x124;
+  MapInfo* info = maps_->Get(kMapDexFiles);
+
+  WriteDescriptor32(0xf800, 0x200000);
+  WriteEntry32(0x200000, 0, 0, 0x300000);
+  WriteDex(0x300000);
+
+  dex_files_->GetMethodInformation(maps_.get(), info, 0x300100, &method_name, &method_offset);
+  EXPECT_EQ("Main.<init>", method_name);
+  EXPECT_EQ(0U, method_offset);
+
+  // Add a new entry at the head, and clear the old entry to verify that
+  // it is not read again.
+  memory_->SetData32(0x200000, 0xffffffff);
+  memory_->SetData32(0x200008, 0);
+  WriteDescriptor32(0xf800, 0x200100);
+  WriteEntry32(0x200100, 0x200000, 0, 0x310000);
+  WriteDex(0x310000);
+
+  method_name = "nothing";
+  dex_files_->GetMethodInformation(maps_.get(), info, 0x310104, &method_name, &method_offset);
+  EXPECT_EQ("Main.<init>", method_name);
+  EXPECT_EQ(4U, method_offset);
+
+  method_name = "nothing";
+  dex_files_->GetMethodInformation(maps_.get(), info, 0x300102, &method_name, &method_offset);
+  EXPECT_EQ("Main.<init>", method_name);
+  EXPECT_EQ(2U, method_offset);
+}
+
 TEST_F(DexFilesTest, get_method_information_search_libs) {
   std::string method_name = "nothing";
   uint64_t method_offset = 0x124;
@@ -812,6 +812,53 @@ TYPED_TEST_P(DwarfDebugFrameTest, GetFdeFromPc_interleaved) {
   EXPECT_EQ(0xb50U, fde->pc_end);
 }
 
+TYPED_TEST_P(DwarfDebugFrameTest, GetFdeFromPc_index) {
+  SetFourFdes32(&this->memory_);
+  ASSERT_TRUE(this->debug_frame_->Init(0x5000, 0x600, 0));
+  EXPECT_EQ(0U, this->debug_frame_->FdeIndexMemorySize());
+
+  const DwarfFde* fde = this->debug_frame_->GetFdeFromPc(0x2600);
+  ASSERT_TRUE(fde != nullptr);
+  EXPECT_EQ(0x2500U, fde->pc_start);
+  size_t index_size = this->debug_frame_->FdeIndexMemorySize();
+  EXPECT_NE(0U, index_size);
+
+  // The index is only built once.
+  fde = this->debug_frame_->GetFdeFromPc(0x4600);
+  ASSERT_TRUE(fde != nullptr);
+  EXPECT_EQ(0x4500U, fde->pc_start);
+  EXPECT_EQ(index_size, this->debug_frame_->FdeIndexMemorySize());
+
+  // Pointers to the fdes stay valid.
+  const DwarfFde* other = this->debug_frame_->GetFdeFromPc(0x2700);
+  EXPECT_EQ(0x2500U, other->pc_start);
+  std::vector<const DwarfFde*> fdes;
+  this->debug_frame_->GetFdes(&fdes);
+  ASSERT_EQ(4U, fdes.size());
+  EXPECT_EQ(other, fdes[1]);
+}
+
+TYPED_TEST_P(DwarfDebugFrameTest, GetFdeFromPc_bad_fde_skipped) {
+  SetCie32(&this->memory_, 0x5000, 0xfc, std::vector<uint8_t>{1, '\0', 0, 0, 1});
+
+  SetFde32(&this->memory_, 0x5100, 0xfc, 0, 0x1500, 0x200);
+  // This fde points at a cie that does not exist.
+  SetFde32(&this->memory_, 0x5200, 0xfc, 0x2000, 0x2500, 0x300);
+  SetFde32(&this->memory_, 0x5300, 0xfc, 0, 0x3500, 0x400);
+
+  ASSERT_TRUE(this->debug_frame_->Init(0x5000, 0x400, 0));
+
+  const DwarfFde* fde = this->debug_frame_->GetFdeFromPc(0x3600);
+  ASSERT_TRUE(fde != nullptr);
+  EXPECT_EQ(0x3500U, fde->pc_start);
+
+  EXPECT_TRUE(this->debug_frame_->GetFdeFromPc(0x2600) == nullptr);
+
+  fde = this->debug_frame_->GetFdeFromPc(0x1600);
+  ASSERT_TRUE(fde != nullptr);
+  EXPECT_EQ(0x1500U, fde->pc_start);
+}
+
 REGISTER_TYPED_TEST_SUITE_P(
     DwarfDebugFrameTest, GetFdes32, GetFdes32_after_GetFdeFromPc, GetFdes32_not_in_section,
     GetFdeFromPc32, GetFdeFromPc32_reverse, GetFdeFromPc32_not_in_section, GetFdes64,
@@ -822,7 +869,8 @@ REGISTER_TYPED_TEST_SUITE_P(
     GetCieFromOffset64_version4, GetCieFromOffset32_version5, GetCieFromOffset64_version5,
     GetCieFromOffset_version_invalid, GetCieFromOffset32_augment, GetCieFromOffset64_augment,
     GetFdeFromOffset32_augment, GetFdeFromOffset64_augment, GetFdeFromOffset32_lsda_address,
-    GetFdeFromOffset64_lsda_address, GetFdeFromPc_interleaved);
+    GetFdeFromOffset64_lsda_address, GetFdeFromPc_interleaved, GetFdeFromPc_index,
+    GetFdeFromPc_bad_fde_skipped);
 
 typedef ::testing::Types<uint32_t, uint64_t> DwarfDebugFrameTestTypes;
 INSTANTIATE_TYPED_TEST_SUITE_P(, DwarfDebugFrameTest, DwarfDebugFrameTestTypes);
@@ -1571,6 +1571,61 @@ TYPED_TEST_P(DwarfOpTest, is_dex_pc) {
   EXPECT_FALSE(this->op_->dex_pc_set());
 }
 
+TYPED_TEST_P(DwarfOpTest, compile) {
+  std::vector<std::vector<uint8_t>> expressions = {
+      // Multi operation opcodes.
+      {0x08, 0x04, 0x08, 0x03, 0x08, 0x02, 0x08, 0x01},
+      // Count down from three, then branch past the end.
+      {0x33, 0x31, 0x1c, 0x12, 0x28, 0xfa, 0xff},
+      // Infinite loop.
+      {0x2f, 0xfd, 0xff},
+      // Stack error.
+      {0x31, 0x1c, 0x1c},
+      // Register set.
+      {0x50},
+      // Dex pc.
+      {0x0c, 'D', 'E', 'X', '1', 0x13},
+  };
+  for (const auto& expression : expressions) {
+    SCOPED_TRACE(testing::PrintToString(expression));
+    this->op_memory_.Clear();
+    this->op_memory_.SetMemory(0x100, expression);
+    uint64_t end = 0x100 + expression.size();
+
+    bool expected = this->op_->Eval(0x100, end);
+    DwarfErrorCode expected_error = this->op_->LastErrorCode();
+    bool expected_register = this->op_->is_register();
+    bool expected_dex_pc = this->op_->dex_pc_set();
+    std::vector<TypeParam> expected_stack;
+    for (size_t i = 0; i < this->op_->StackSize(); i++) {
+      expected_stack.push_back(this->op_->StackAt(i));
+    }
+
+    DwarfExpression compiled;
+    ASSERT_TRUE(this->op_->Compile(0x100, end, &compiled));
+    // Make sure nothing is read when evaluating the decoded expression.
+    this->op_memory_.Clear();
+    ASSERT_EQ(expected, this->op_->Eval(compiled));
+    ASSERT_EQ(expected_error, this->op_->LastErrorCode());
+    ASSERT_EQ(expected_register, this->op_->is_register());
+    ASSERT_EQ(expected_dex_pc, this->op_->dex_pc_set());
+    std::vector<TypeParam> stack;
+    for (size_t i = 0; i < this->op_->StackSize(); i++) {
+      stack.push_back(this->op_->StackAt(i));
+    }
+    ASSERT_EQ(expected_stack, stack);
+  }
+
+  // A branch into the middle of an op can't be decoded ahead of time.
+  this->op_memory_.SetMemory(0, std::vector<uint8_t>{0x08, 0x01, 0x2f, 0xfc, 0xff});
+  DwarfExpression compiled;
+  ASSERT_FALSE(this->op_->Compile(0, 5, &compiled));
+
+  // Neither can an illegal op.
+  this->op_memory_.SetMemory(0, std::vector<uint8_t>{0x31, 0x00});
+  ASSERT_FALSE(this->op_->Compile(0, 2, &compiled));
+}
+
 REGISTER_TYPED_TEST_SUITE_P(DwarfOpTest, decode, eval, illegal_opcode, not_implemented, op_addr,
                             op_deref, op_deref_size, const_unsigned, const_signed, const_uleb,
                             const_sleb, op_dup, op_drop, op_over, op_pick, op_swap, op_rot, op_abs,
@@ -1578,7 +1633,7 @@ REGISTER_TYPED_TEST_SUITE_P(DwarfOpTest, decode, eval, illegal_opcode, not_imple
                             op_plus, op_plus_uconst, op_shl, op_shr, op_shra, op_xor, op_bra,
                             compare_opcode_stack_error, compare_opcodes, op_skip, op_lit, op_reg,
                             op_regx, op_breg, op_breg_invalid_register, op_bregx, op_nop,
-                            is_dex_pc);
+                            is_dex_pc, compile);
 
 typedef ::testing::Types<uint32_t, uint64_t> DwarfOpTestTypes;
 INSTANTIATE_TYPED_TEST_SUITE_P(, DwarfOpTest, DwarfOpTestTypes);
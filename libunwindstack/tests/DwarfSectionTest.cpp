@@ -34,6 +34,8 @@ class MockDwarfSection : public DwarfSection {
 
   MOCK_METHOD5(Eval, bool(const DwarfCie*, Memory*, const dwarf_loc_regs_t&, Regs*, bool*));
 
+  MOCK_METHOD5(EvalRules, bool(const DwarfCie*, Memory*, const DwarfRegRules&, Regs*, bool*));
+
   MOCK_METHOD3(Log, bool(uint8_t, uint64_t, const DwarfFde*));
 
   MOCK_METHOD1(GetFdes, void(std::vector<const DwarfFde*>*));
@@ -100,7 +102,7 @@ TEST_F(DwarfSectionTest, Step_pass) {
       .WillOnce(::testing::Return(true));
 
   MemoryFake process;
-  EXPECT_CALL(*section_, Eval(&cie, &process, ::testing::_, nullptr, ::testing::_))
+  EXPECT_CALL(*section_, EvalRules(&cie, &process, ::testing::_, nullptr, ::testing::_))
       .WillOnce(::testing::Return(true));
 
   bool finished;
@@ -126,7 +128,7 @@ TEST_F(DwarfSectionTest, Step_cache) {
       .WillOnce(::testing::Invoke(MockGetCfaLocationInfo));
 
   MemoryFake process;
-  EXPECT_CALL(*section_, Eval(&cie, &process, ::testing::_, nullptr, ::testing::_))
+  EXPECT_CALL(*section_, EvalRules(&cie, &process, ::testing::_, nullptr, ::testing::_))
       .WillRepeatedly(::testing::Return(true));
 
   bool finished;
@@ -146,7 +148,7 @@ TEST_F(DwarfSectionTest, Step_cache_not_in_pc) {
       .WillOnce(::testing::Invoke(MockGetCfaLocationInfo));
 
   MemoryFake process;
-  EXPECT_CALL(*section_, Eval(&cie, &process, ::testing::_, nullptr, ::testing::_))
+  EXPECT_CALL(*section_, EvalRules(&cie, &process, ::testing::_, nullptr, ::testing::_))
       .WillRepeatedly(::testing::Return(true));
 
   bool finished;
@@ -164,4 +166,67 @@ TEST_F(DwarfSectionTest, Step_cache_not_in_pc) {
   ASSERT_TRUE(section_->Step(0x700, nullptr, &process, &finished));
 }
 
+static bool MockGetCfaLocationInfoWithRegs(::testing::Unused, const DwarfFde* fde,
+                                           dwarf_loc_regs_t* loc_regs) {
+  loc_regs->pc_start = fde->pc_start;
+  loc_regs->pc_end = fde->pc_end;
+  (*loc_regs)[5] = DwarfLocation{DWARF_LOCATION_OFFSET, {0x10, 0}};
+  (*loc_regs)[CFA_REG] = DwarfLocation{DWARF_LOCATION_REGISTER, {9, 0x20}};
+  (*loc_regs)[2] = DwarfLocation{DWARF_LOCATION_VAL_OFFSET, {0x8, 0}};
+  return true;
+}
+
+TEST_F(DwarfSectionTest, Step_cache_flattened) {
+  DwarfCie cie{};
+  DwarfFde fde{};
+  fde.pc_start = 0x1000;
+  fde.pc_end = 0x2000;
+  fde.cie = &cie;
+
+  EXPECT_CALL(*section_, GetFdeFromPc(0x1000)).WillOnce(::testing::Return(&fde));
+  EXPECT_CALL(*section_, GetCfaLocationInfo(0x1000, &fde, ::testing::_))
+      .WillOnce(::testing::Invoke(MockGetCfaLocationInfoWithRegs));
+
+  MemoryFake process;
+  std::vector<DwarfRegRules> seen;
+  EXPECT_CALL(*section_, EvalRules(&cie, &process, ::testing::_, nullptr, ::testing::_))
+      .Times(2)
+      .WillRepeatedly(::testing::Invoke(
+          [&seen](const DwarfCie*, Memory*, const DwarfRegRules& rules, Regs*, bool*) {
+            seen.push_back(rules);
+            return true;
+          }));
+
+  bool finished;
+  ASSERT_TRUE(section_->Step(0x1000, nullptr, &process, &finished));
+  ASSERT_TRUE(section_->Step(0x1800, nullptr, &process, &finished));
+
+  ASSERT_EQ(2U, seen.size());
+  for (const auto& rules : seen) {
+    EXPECT_EQ(&cie, rules.cie);
+    EXPECT_EQ(0x1000U, rules.pc_start);
+    EXPECT_EQ(0x2000U, rules.pc_end);
+    ASSERT_TRUE(rules.cfa_defined);
+    EXPECT_EQ(DWARF_LOCATION_REGISTER, rules.cfa.type);
+    EXPECT_EQ(9U, rules.cfa.values[0]);
+    EXPECT_EQ(0x20U, rules.cfa.values[1]);
+    ASSERT_EQ(2U, rules.regs.size());
+    EXPECT_EQ(2U, rules.regs[0].reg);
+    EXPECT_EQ(DWARF_LOCATION_VAL_OFFSET, rules.regs[0].location.type);
+    EXPECT_EQ(5U, rules.regs[1].reg);
+    EXPECT_EQ(DWARF_LOCATION_OFFSET, rules.regs[1].location.type);
+  }
+}
+
+TEST_F(DwarfSectionTest, FlattenLocations_no_cfa) {
+  dwarf_loc_regs_t loc_regs;
+  loc_regs[3] = DwarfLocation{DWARF_LOCATION_UNDEFINED, {0, 0}};
+
+  DwarfRegRules rules;
+  DwarfSection::FlattenLocations(loc_regs, &rules);
+  EXPECT_FALSE(rules.cfa_defined);
+  ASSERT_EQ(1U, rules.regs.size());
+  EXPECT_EQ(3U, rules.regs[0].reg);
+}
+
 }  // namespace unwindstack
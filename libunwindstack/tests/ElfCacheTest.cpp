@@ -17,6 +17,9 @@
 #include <elf.h>
 #include <unistd.h>
 
+#include <memory>
+#include <vector>
+
 #include <android-base/file.h>
 
 #include <gtest/gtest.h>
@@ -35,7 +38,10 @@ class ElfCacheTest : public ::testing::Test {
 
   void SetUp() override { Elf::SetCachingEnabled(true); }
 
-  void TearDown() override { Elf::SetCachingEnabled(false); }
+  void TearDown() override {
+    Elf::SetCacheMemoryBudget(0);
+    Elf::SetCachingEnabled(false);
+  }
 
   void WriteElfFile(uint64_t offset, TemporaryFile* tf, uint32_t type) {
     ASSERT_TRUE(type == EM_ARM || type == EM_386 || type == EM_X86_64);
@@ -260,4 +266,65 @@ TEST_F(ElfCacheTest, caching_valid_elf_offset_non_zero_never_read_at_zero) {
   VerifyWithinSameMapNeverReadAtZero(true);
 }
 
+TEST_F(ElfCacheTest, stats) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+  WriteElfFile(0, &tf, EM_ARM);
+  close(tf.fd);
+
+  MapInfo info1(nullptr, 0x1000, 0x20000, 0, 0x5, tf.path);
+  MapInfo info2(nullptr, 0x1000, 0x20000, 0, 0x5, tf.path);
+  ASSERT_TRUE(info1.GetElf(memory_, ARCH_ARM)->valid());
+  ASSERT_TRUE(info2.GetElf(memory_, ARCH_ARM)->valid());
+
+  ElfCacheStats stats = Elf::GetCacheStats();
+  EXPECT_EQ(1U, stats.hits);
+  EXPECT_EQ(1U, stats.misses);
+  EXPECT_EQ(0U, stats.evictions);
+  EXPECT_EQ(1U, stats.elfs);
+  EXPECT_NE(0U, stats.bytes);
+}
+
+TEST_F(ElfCacheTest, memory_budget) {
+  constexpr size_t kFiles = 40;
+  std::vector<std::unique_ptr<TemporaryFile>> files;
+  std::vector<std::unique_ptr<MapInfo>> infos;
+  for (size_t i = 0; i < kFiles; i++) {
+    files.emplace_back(new TemporaryFile);
+    ASSERT_TRUE(files.back()->fd != -1);
+    WriteElfFile(0, files.back().get(), EM_ARM);
+    close(files.back()->fd);
+    infos.emplace_back(new MapInfo(nullptr, 0x1000, 0x20000, 0, 0x5, files.back()->path));
+    ASSERT_TRUE(infos.back()->GetElf(memory_, ARCH_ARM)->valid());
+  }
+
+  // Without a budget, everything is kept.
+  ElfCacheStats stats = Elf::GetCacheStats();
+  EXPECT_EQ(kFiles, stats.misses);
+  EXPECT_EQ(kFiles, stats.elfs);
+  EXPECT_EQ(0U, stats.evictions);
+
+  // Setting a budget that nothing fits in drops all but the most recently
+  // used elf of each shard.
+  Elf::SetCacheMemoryBudget(1);
+  stats = Elf::GetCacheStats();
+  EXPECT_LT(stats.elfs, kFiles);
+  EXPECT_EQ(kFiles, stats.elfs + stats.evictions);
+
+  // The evicted elf objects are still owned by their maps.
+  for (auto& info : infos) {
+    EXPECT_TRUE(info->elf->valid());
+  }
+
+  // Getting an evicted elf again creates a new object.
+  for (auto& file : files) {
+    MapInfo info(nullptr, 0x1000, 0x20000, 0, 0x5, file->path);
+    ASSERT_TRUE(info.GetElf(memory_, ARCH_ARM)->valid());
+  }
+  stats = Elf::GetCacheStats();
+  EXPECT_GT(stats.misses, kFiles);
+  EXPECT_EQ(kFiles, stats.hits + stats.misses - kFiles);
+  EXPECT_LT(stats.elfs, kFiles);
+}
+
 }  // namespace unwindstack
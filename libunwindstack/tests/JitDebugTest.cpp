@@ -382,6 +382,77 @@ TEST_F(JitDebugTest, get_elf_multiple_entries) {
   EXPECT_EQ(nullptr, jit_debug_->GetElf(maps_.get(), 0x2700));
 }
 
+TEST_F(JitDebugTest, get_elf_new_entries) {
+  CreateElf<Elf32_Ehdr, Elf32_Shdr>(0x4000, ELFCLASS32, EM_ARM, 0x1500, 0x200);
+
+  WriteDescriptor32(0xf800, 0x200000);
+  WriteEntry32Pad(0x200000, 0, 0, 0x4000, 0x1000);
+
+  Elf* elf_1 = jit_debug_->GetElf(maps_.get(), 0x1500);
+  ASSERT_TRUE(elf_1 != nullptr);
+
+  // Add a new entry at the head, and clear the old entry to verify that
+  // it is not read again.
+  memory_->Clear();
+  CreateElf<Elf32_Ehdr, Elf32_Shdr>(0x5000, ELFCLASS32, EM_ARM, 0x2300, 0x400);
+  WriteDescriptor32(0xf800, 0x200100);
+  WriteEntry32Pad(0x200100, 0, 0x200000, 0x5000, 0x1000);
+
+  Elf* elf_2 = jit_debug_->GetElf(maps_.get(), 0x2400);
+  ASSERT_TRUE(elf_2 != nullptr);
+  EXPECT_NE(elf_1, elf_2);
+  EXPECT_EQ(elf_1, jit_debug_->GetElf(maps_.get(), 0x1500));
+  EXPECT_EQ(nullptr, jit_debug_->GetElf(maps_.get(), 0x2700));
+}
+
+TEST_F(JitDebugTest, get_elf_new_entries_empty_list) {
+  WriteDescriptor32(0xf800, 0);
+
+  EXPECT_EQ(nullptr, jit_debug_->GetElf(maps_.get(), 0x1500));
+
+  CreateElf<Elf32_Ehdr, Elf32_Shdr>(0x4000, ELFCLASS32, EM_ARM, 0x1500, 0x200);
+  WriteDescriptor32(0xf800, 0x200000);
+  WriteEntry32Pad(0x200000, 0, 0, 0x4000, 0x1000);
+
+  EXPECT_TRUE(jit_debug_->GetElf(maps_.get(), 0x1500) != nullptr);
+}
+
+TEST_F(JitDebugTest, get_elf_new_entries_seqlock) {
+  Init(ARCH_ARM64);
+
+  CreateElf<Elf64_Ehdr, Elf64_Shdr>(0x4000, ELFCLASS64, EM_AARCH64, 0x1500, 0x200);
+
+  WriteDescriptor64(0xf800, 0x200000);
+  // The fields ART adds after first_entry:
+  //   uint8_t magic[8]
+  memory_->SetMemory(0xf800 + 24, "Android1", 8);
+  //   uint32_t flags
+  memory_->SetData32(0xf800 + 32, 0);
+  //   uint32_t sizeof_descriptor
+  memory_->SetData32(0xf800 + 36, 56);
+  //   uint32_t sizeof_entry
+  memory_->SetData32(0xf800 + 40, 40);
+  //   uint32_t action_seqlock
+  memory_->SetData32(0xf800 + 44, 2);
+  WriteEntry64(0x200000, 0, 0, 0x4000, 0x1000);
+
+  ASSERT_TRUE(jit_debug_->GetElf(maps_.get(), 0x1500) != nullptr);
+
+  CreateElf<Elf64_Ehdr, Elf64_Shdr>(0x5000, ELFCLASS64, EM_AARCH64, 0x2300, 0x400);
+  WriteDescriptor64(0xf800, 0x200100);
+  WriteEntry64(0x200100, 0, 0x200000, 0x5000, 0x1000);
+
+  // The seqlock has not changed, so the list is not read.
+  EXPECT_EQ(nullptr, jit_debug_->GetElf(maps_.get(), 0x2400));
+
+  // The list is being changed.
+  memory_->SetData32(0xf800 + 44, 3);
+  EXPECT_EQ(nullptr, jit_debug_->GetElf(maps_.get(), 0x2400));
+
+  memory_->SetData32(0xf800 + 44, 4);
+  EXPECT_TRUE(jit_debug_->GetElf(maps_.get(), 0x2400) != nullptr);
+}
+
 TEST_F(JitDebugTest, get_elf_search_libs) {
   CreateElf<Elf32_Ehdr, Elf32_Shdr>(0x4000, ELFCLASS32, EM_ARM, 0x1500, 0x200);
 
@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include <signal.h>
 #include <stdint.h>
+#include <unistd.h>
 
 #include <memory>
 #include <string>
@@ -27,7 +28,11 @@
 
 #include <android-base/stringprintf.h>
 
+#include <unwindstack/Elf.h>
 #include <unwindstack/LocalUnwinder.h>
+#include <unwindstack/MapInfo.h>
+#include <unwindstack/Memory.h>
+#include <unwindstack/Regs.h>
 
 namespace unwindstack {
 
@@ -132,6 +137,45 @@ extern "C" void LocalOuterFunction(LocalUnwinder* unwinder, bool unwind_through_
   LocalMiddleFunction(unwinder, unwind_through_signal);
 }
 
+extern "C" void PcsInnerFunction(LocalUnwinder* unwinder, std::vector<uint64_t>* pcs) {
+  ASSERT_TRUE(unwinder->UnwindPcs(pcs, 256));
+}
+
+extern "C" void PcsMiddleFunction(LocalUnwinder* unwinder, std::vector<uint64_t>* pcs) {
+  PcsInnerFunction(unwinder, pcs);
+}
+
+extern "C" void PcsOuterFunction(LocalUnwinder* unwinder, std::vector<uint64_t>* pcs) {
+  PcsMiddleFunction(unwinder, pcs);
+}
+
+static void VerifyUnwindPcs(LocalUnwinder* unwinder) {
+  std::vector<uint64_t> pcs;
+  ASSERT_NO_FATAL_FAILURE(PcsOuterFunction(unwinder, &pcs));
+
+  std::shared_ptr<Memory> process_memory(Memory::CreateProcessMemory(getpid()));
+  std::vector<const char*> expected_function_names{"PcsOuterFunction", "PcsMiddleFunction",
+                                                   "PcsInnerFunction"};
+  std::string unwind;
+  for (size_t i = 0; i < pcs.size(); i++) {
+    MapInfo* map_info = unwinder->GetMapInfo(pcs[i]);
+    ASSERT_TRUE(map_info != nullptr);
+    Elf* elf = map_info->GetElf(process_memory, Regs::CurrentArch());
+    // Every pc but the first is a return address, so look up the call.
+    uint64_t rel_pc = elf->GetRelPc(pcs[i], map_info) - (i == 0 ? 0 : 1);
+    std::string name;
+    uint64_t offset;
+    elf->GetFunctionName(rel_pc, &name, &offset);
+    unwind += android::base::StringPrintf("#%02zu pc 0x%" PRIx64 " %s\n", i, pcs[i], name.c_str());
+    if (!expected_function_names.empty() && name == expected_function_names.back()) {
+      expected_function_names.pop_back();
+    }
+  }
+  ASSERT_TRUE(expected_function_names.empty())
+      << "Unwind completed without finding all frames\nUnwind data:\n"
+      << unwind;
+}
+
 class LocalUnwinderTest : public ::testing::Test {
  protected:
   void SetUp() override {
@@ -160,6 +204,18 @@ TEST_F(LocalUnwinderTest, local_multiple) {
   ASSERT_NO_FATAL_FAILURE(LocalOuterFunction(unwinder_.get(), true));
 }
 
+TEST_F(LocalUnwinderTest, unwind_pcs) {
+  VerifyUnwindPcs(unwinder_.get());
+}
+
+TEST_F(LocalUnwinderTest, unwind_pcs_frame_pointer) {
+  unwinder_->SetFramePointerUnwinding(true);
+  VerifyUnwindPcs(unwinder_.get());
+
+  // Make sure the regular unwind is unaffected.
+  LocalOuterFunction(unwinder_.get(), false);
+}
+
 // This test verifies that doing an unwind before and after a dlopen
 // works. It's verifying that the maps read during the first unwind
 // do not cause a problem when doing the unwind using the code in
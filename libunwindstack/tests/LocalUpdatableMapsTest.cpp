@@ -271,4 +271,65 @@ TEST_F(LocalUpdatableMapsTest, all_new_maps) {
   EXPECT_TRUE(map_info->name.empty());
 }
 
+TEST_F(LocalUpdatableMapsTest, unchanged_maps_kept) {
+  MapInfo* old_first = maps_.Get(0);
+  MapInfo* old_second = maps_.Get(1);
+
+  TemporaryFile tf;
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("3000-4000 r-xp 00000 00:00 0\n"
+                                       "5000-6000 r-xp 00000 00:00 0\n"
+                                       "8000-9000 r-xp 00000 00:00 0\n",
+                                       tf.path));
+
+  maps_.TestSetMapsFile(tf.path);
+  ASSERT_TRUE(maps_.Reparse());
+  ASSERT_EQ(3U, maps_.Total());
+  EXPECT_EQ(0U, maps_.TestGetSavedMaps().size());
+
+  EXPECT_EQ(old_first, maps_.Get(0));
+  EXPECT_EQ(old_second, maps_.Get(2));
+  MapInfo* map_info = maps_.Get(1);
+  ASSERT_TRUE(map_info != nullptr);
+  EXPECT_EQ(0x5000U, map_info->start);
+  EXPECT_EQ(0x6000U, map_info->end);
+
+  // The prev_map links and the lookup both follow the new layout.
+  EXPECT_EQ(nullptr, maps_.Get(0)->prev_map);
+  EXPECT_EQ(maps_.Get(0), maps_.Get(1)->prev_map);
+  EXPECT_EQ(maps_.Get(1), maps_.Get(2)->prev_map);
+  EXPECT_EQ(maps_.Get(1), maps_.Find(0x5800));
+  EXPECT_EQ(maps_.Get(2), maps_.Find(0x8000));
+  EXPECT_EQ(nullptr, maps_.Find(0x4000));
+  EXPECT_EQ(nullptr, maps_.Find(0x9000));
+}
+
+TEST_F(LocalUpdatableMapsTest, same_map_new_offset) {
+  TemporaryFile tf;
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("3000-4000 r-xp 01000 00:00 0\n"
+                                       "8000-9000 r-xp 00000 00:00 0\n",
+                                       tf.path));
+
+  maps_.TestSetMapsFile(tf.path);
+  ASSERT_TRUE(maps_.Reparse());
+  ASSERT_EQ(2U, maps_.Total());
+  EXPECT_EQ(0x1000U, maps_.Get(0)->offset);
+
+  auto& saved_maps = maps_.TestGetSavedMaps();
+  ASSERT_EQ(1U, saved_maps.size());
+  EXPECT_EQ(0x3000U, saved_maps[0]->start);
+  EXPECT_EQ(0U, saved_maps[0]->offset);
+}
+
+TEST_F(LocalUpdatableMapsTest, reparse_fail_keeps_maps) {
+  MapInfo* old_first = maps_.Get(0);
+
+  maps_.TestSetMapsFile("/does/not/exist");
+  ASSERT_FALSE(maps_.Reparse());
+  ASSERT_EQ(2U, maps_.Total());
+  EXPECT_EQ(old_first, maps_.Get(0));
+  EXPECT_EQ(old_first, maps_.Find(0x3000));
+}
+
 }  // namespace unwindstack
@@ -139,4 +139,33 @@ TEST_F(MemoryCacheTest, read_for_cache_fail_cross) {
   ASSERT_EQ(expect, buffer);
 }
 
+TEST_F(MemoryCacheTest, prefetch) {
+  memory_cache_->Prefetch(0x8010, 0x2100);
+
+  // Only the pages that could be read completely are cached.
+  memory_->SetMemoryBlock(0x8000, 4096, 0xff);
+  memory_->SetMemoryBlock(0x9000, 4096, 0xff);
+  memory_->SetMemoryBlock(0xa000, 3000, 0xff);
+  std::vector<uint8_t> buffer(kMaxCachedSize);
+  ASSERT_TRUE(memory_cache_->ReadFully(0x8000, buffer.data(), kMaxCachedSize));
+  ASSERT_EQ(std::vector<uint8_t>(kMaxCachedSize, 0xab), buffer);
+  ASSERT_TRUE(memory_cache_->ReadFully(0x9fc0, buffer.data(), kMaxCachedSize));
+  ASSERT_EQ(std::vector<uint8_t>(kMaxCachedSize, 0xde), buffer);
+  ASSERT_TRUE(memory_cache_->ReadFully(0xa000, buffer.data(), kMaxCachedSize));
+  ASSERT_EQ(std::vector<uint8_t>(kMaxCachedSize, 0xff), buffer);
+}
+
+TEST_F(MemoryCacheTest, prefetch_keeps_cached_pages) {
+  std::vector<uint8_t> buffer(kMaxCachedSize);
+  ASSERT_TRUE(memory_cache_->ReadFully(0x8000, buffer.data(), kMaxCachedSize));
+
+  memory_->SetMemoryBlock(0x8000, 4096, 0xff);
+  memory_->SetMemoryBlock(0x9000, 4096, 0xff);
+  memory_cache_->Prefetch(0x8000, 0x2000);
+  ASSERT_TRUE(memory_cache_->ReadFully(0x8000, buffer.data(), kMaxCachedSize));
+  ASSERT_EQ(std::vector<uint8_t>(kMaxCachedSize, 0xab), buffer);
+  ASSERT_TRUE(memory_cache_->ReadFully(0x9000, buffer.data(), kMaxCachedSize));
+  ASSERT_EQ(std::vector<uint8_t>(kMaxCachedSize, 0xff), buffer);
+}
+
 }  // namespace unwindstack
@@ -108,4 +108,56 @@ TEST(MemoryLocalTest, read_hole) {
   ASSERT_EQ(0, munmap(mapping, 3 * 4096));
 }
 
+TEST(MemoryLocalTest, read_batch) {
+  static constexpr size_t kLargePages = 100;
+  std::vector<uint8_t> small(64, 0x11);
+  std::vector<uint8_t> large(kLargePages * 4096);
+  for (size_t i = 0; i < kLargePages; i++) {
+    memset(&large[i * 4096], i, 4096);
+  }
+
+  std::vector<uint8_t> small_dst(small.size());
+  std::vector<uint8_t> large_dst(large.size());
+  std::vector<MemoryReadRequest> requests{
+      {.addr = reinterpret_cast<uintptr_t>(small.data()), .dst = small_dst.data(),
+       .size = small.size()},
+      {.addr = reinterpret_cast<uintptr_t>(large.data()), .dst = large_dst.data(),
+       .size = large.size()},
+  };
+  MemoryLocal local;
+  local.ReadBatch(&requests);
+  ASSERT_EQ(small.size(), requests[0].bytes_read);
+  ASSERT_EQ(large.size(), requests[1].bytes_read);
+  ASSERT_EQ(small, small_dst);
+  ASSERT_EQ(large, large_dst);
+}
+
+TEST(MemoryLocalTest, read_batch_hole) {
+  void* mapping =
+      mmap(nullptr, 3 * 4096, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  ASSERT_NE(MAP_FAILED, mapping);
+  memset(mapping, 0xFF, 3 * 4096);
+  mprotect(static_cast<char*>(mapping) + 4096, 4096, PROT_NONE);
+  uintptr_t addr = reinterpret_cast<uintptr_t>(mapping);
+
+  std::vector<uint8_t> dst(4096 * 3, 0xCC);
+  std::vector<MemoryReadRequest> requests{
+      {.addr = addr, .dst = &dst[0], .size = 100},
+      {.addr = addr + 4000, .dst = &dst[4096], .size = 200},
+      {.addr = addr + 4096, .dst = &dst[4096 * 2 - 100], .size = 100},
+      {.addr = addr + 2 * 4096, .dst = &dst[4096 * 2], .size = 4096},
+  };
+  MemoryLocal local;
+  local.ReadBatch(&requests);
+  ASSERT_EQ(100U, requests[0].bytes_read);
+  ASSERT_EQ(96U, requests[1].bytes_read);
+  ASSERT_EQ(0U, requests[2].bytes_read);
+  ASSERT_EQ(4096U, requests[3].bytes_read);
+  for (size_t i = 0; i < dst.size(); ++i) {
+    bool read = i < 100 || (i >= 4096 && i < 4096 + 96) || i >= 2 * 4096;
+    ASSERT_EQ(read ? 0xFF : 0xCC, dst[i]) << "Failed at byte " << i;
+  }
+  ASSERT_EQ(0, munmap(mapping, 3 * 4096));
+}
+
 }  // namespace unwindstack
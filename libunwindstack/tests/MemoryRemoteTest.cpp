@@ -265,6 +265,51 @@ TEST_F(MemoryRemoteTest, read_mprotect_hole) {
   }
 }
 
+TEST_F(MemoryRemoteTest, read_batch_mprotect_hole) {
+  size_t page_size = getpagesize();
+  void* mapping =
+      mmap(nullptr, 3 * getpagesize(), PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  ASSERT_NE(MAP_FAILED, mapping);
+  memset(mapping, 0xFF, 3 * page_size);
+  ASSERT_EQ(0, mprotect(static_cast<char*>(mapping) + page_size, page_size, PROT_NONE));
+
+  pid_t pid;
+  if ((pid = fork()) == 0) {
+    while (true);
+    exit(1);
+  }
+  ASSERT_LT(0, pid);
+  TestScopedPidReaper reap(pid);
+
+  ASSERT_EQ(0, munmap(mapping, 3 * page_size));
+
+  ASSERT_TRUE(Attach(pid));
+
+  MemoryRemote remote(pid);
+  uint64_t addr = reinterpret_cast<uint64_t>(mapping);
+  std::vector<uint8_t> first(page_size, 0xCC);
+  std::vector<uint8_t> hole(page_size, 0xCC);
+  std::vector<uint8_t> last(page_size, 0xCC);
+  std::vector<MemoryReadRequest> requests{
+      {.addr = addr, .dst = first.data(), .size = page_size},
+      {.addr = addr + page_size, .dst = hole.data(), .size = page_size},
+      {.addr = addr + 2 * page_size, .dst = last.data(), .size = page_size},
+  };
+  remote.ReadBatch(&requests);
+  ASSERT_EQ(page_size, requests[0].bytes_read);
+  ASSERT_EQ(std::vector<uint8_t>(page_size, 0xFF), first);
+  // Some read methods can read PROT_NONE maps, allow that.
+  if (requests[1].bytes_read == 0) {
+    ASSERT_EQ(std::vector<uint8_t>(page_size, 0xCC), hole);
+  } else {
+    ASSERT_EQ(page_size, requests[1].bytes_read);
+  }
+  ASSERT_EQ(page_size, requests[2].bytes_read);
+  ASSERT_EQ(std::vector<uint8_t>(page_size, 0xFF), last);
+
+  ASSERT_TRUE(Detach(pid));
+}
+
 TEST_F(MemoryRemoteTest, read_munmap_hole) {
   size_t page_size = getpagesize();
   void* mapping =
@@ -362,9 +362,76 @@ TYPED_TEST_P(SymbolsTest, get_global) {
   EXPECT_EQ(4U, offset);
 }
 
+TYPED_TEST_P(SymbolsTest, many_entries) {
+  // Enough entries that the table is read in more than one chunk.
+  constexpr size_t kEntries = 10000;
+  Symbols symbols(0x100000, kEntries * sizeof(TypeParam), sizeof(TypeParam), 0x1000, 0x100);
+
+  std::vector<TypeParam> syms(kEntries);
+  for (size_t i = 0; i < kEntries; i++) {
+    // Put the entries in descending order.
+    this->InitSym(&syms[i], 0x10000000 - i * 0x100, 0x80, 0x10);
+  }
+  this->memory_.SetMemory(0x100000, syms.data(), kEntries * sizeof(TypeParam));
+  this->memory_.SetMemory(0x1010, "fake_function");
+
+  std::string name;
+  uint64_t func_offset;
+  for (size_t i = 0; i < kEntries; i += 997) {
+    uint64_t start = 0x10000000 - i * 0x100;
+    ASSERT_TRUE(symbols.GetName<TypeParam>(start + 0x7f, &this->memory_, &name, &func_offset))
+        << "Failed at entry " << i;
+    ASSERT_EQ("fake_function", name);
+    ASSERT_EQ(0x7fU, func_offset);
+    ASSERT_FALSE(symbols.GetName<TypeParam>(start + 0x80, &this->memory_, &name, &func_offset))
+        << "Failed at entry " << i;
+  }
+}
+
+TYPED_TEST_P(SymbolsTest, read_stops_at_bad_entry) {
+  Symbols symbols(0x1000, 3 * sizeof(TypeParam), sizeof(TypeParam), 0x2000, 0x100);
+
+  // Only the first entry is readable.
+  TypeParam sym;
+  this->InitSym(&sym, 0x5000, 0x10, 0x40);
+  this->memory_.SetMemory(0x1000, &sym, sizeof(sym));
+  this->memory_.SetMemory(0x2040, "fake_function");
+
+  std::string name;
+  uint64_t func_offset;
+  ASSERT_TRUE(symbols.GetName<TypeParam>(0x5004, &this->memory_, &name, &func_offset));
+  ASSERT_EQ("fake_function", name);
+  ASSERT_EQ(4U, func_offset);
+  ASSERT_FALSE(symbols.GetName<TypeParam>(0x6000, &this->memory_, &name, &func_offset));
+}
+
+TYPED_TEST_P(SymbolsTest, same_start) {
+  Symbols symbols(0x1000, 3 * sizeof(TypeParam), sizeof(TypeParam), 0x2000, 0x100);
+
+  // A zero sized alias and a smaller alias of the same function.
+  TypeParam sym;
+  this->InitSym(&sym, 0x5000, 0x100, 0x40);
+  this->memory_.SetMemory(0x1000, &sym, sizeof(sym));
+  this->InitSym(&sym, 0x5000, 0, 0x60);
+  this->memory_.SetMemory(0x1000 + sizeof(sym), &sym, sizeof(sym));
+  this->InitSym(&sym, 0x5000, 0x10, 0x60);
+  this->memory_.SetMemory(0x1000 + 2 * sizeof(sym), &sym, sizeof(sym));
+  this->memory_.SetMemory(0x2040, "function");
+  this->memory_.SetMemory(0x2060, "alias");
+
+  std::string name;
+  uint64_t func_offset;
+  ASSERT_TRUE(symbols.GetName<TypeParam>(0x5000, &this->memory_, &name, &func_offset));
+  ASSERT_EQ("function", name);
+  ASSERT_TRUE(symbols.GetName<TypeParam>(0x50f0, &this->memory_, &name, &func_offset));
+  ASSERT_EQ("function", name);
+  ASSERT_EQ(0xf0U, func_offset);
+}
+
 REGISTER_TYPED_TEST_SUITE_P(SymbolsTest, function_bounds_check, no_symbol, multiple_entries,
                             multiple_entries_nonstandard_size, symtab_value_out_of_bounds,
-                            symtab_read_cached, get_global);
+                            symtab_read_cached, get_global, many_entries,
+                            read_stops_at_bad_entry, same_start);
 
 typedef ::testing::Types<Elf32_Sym, Elf64_Sym> SymbolsTestTypes;
 INSTANTIATE_TYPED_TEST_SUITE_P(, SymbolsTest, SymbolsTestTypes);
@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
@@ -297,6 +298,47 @@ TEST_F(UnwindOfflineTest, pc_straddle_arm64) {
   EXPECT_EQ(0x7fe0d84110U, unwinder.frames()[5].sp);
 }
 
+TEST_F(UnwindOfflineTest, pc_straddle_arm64_offline_unwinder) {
+  ASSERT_NO_FATAL_FAILURE(Init("straddle_arm64/", ARCH_ARM64));
+
+  // The first 8 bytes of the stack data are its start address.
+  std::string stack;
+  ASSERT_TRUE(android::base::ReadFileToString(dir_ + "stack.data", &stack));
+  ASSERT_GT(stack.size(), sizeof(uint64_t));
+  uint64_t stack_start;
+  memcpy(&stack_start, stack.data(), sizeof(stack_start));
+
+  constexpr size_t kNumSamples = 64;
+  std::vector<std::unique_ptr<Regs>> regs;
+  std::vector<OfflineSample> samples;
+  for (size_t i = 0; i < kNumSamples; i++) {
+    regs.emplace_back(regs_->Clone());
+    samples.push_back({regs.back().get(), stack_start,
+                       reinterpret_cast<const uint8_t*>(stack.data()) + sizeof(uint64_t),
+                       stack.size() - sizeof(uint64_t)});
+  }
+
+  std::vector<std::string> frame_infos(kNumSamples);
+  OfflineUnwinder unwinder(128, maps_.get());
+  unwinder.Unwind(samples, 4, [&](size_t index, Unwinder* sample_unwinder) {
+    frame_infos[index] = DumpFrames(*sample_unwinder);
+  });
+
+  for (size_t i = 0; i < kNumSamples; i++) {
+    EXPECT_EQ(
+        "  #00 pc 0000000000429fd8  libunwindstack_test (SignalInnerFunction+24)\n"
+        "  #01 pc 000000000042a078  libunwindstack_test (SignalMiddleFunction+8)\n"
+        "  #02 pc 000000000042a08c  libunwindstack_test (SignalOuterFunction+8)\n"
+        "  #03 pc 000000000042d8fc  libunwindstack_test "
+        "(unwindstack::RemoteThroughSignal(int, unsigned int)+20)\n"
+        "  #04 pc 000000000042d8d8  libunwindstack_test "
+        "(unwindstack::UnwindTest_remote_through_signal_Test::TestBody()+32)\n"
+        "  #05 pc 0000000000455d70  libunwindstack_test (testing::Test::Run()+392)\n",
+        frame_infos[i])
+        << "Sample " << i;
+  }
+}
+
 TEST_F(UnwindOfflineTest, jit_debug_x86) {
   ASSERT_NO_FATAL_FAILURE(Init("jit_debug_x86/", ARCH_X86));
 
@@ -26,8 +26,11 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <unordered_set>
+
 #include <unwindstack/DexFiles.h>
 #include <unwindstack/Elf.h>
+#include <unwindstack/ElfInterface.h>
 #include <unwindstack/JitDebug.h>
 #include <unwindstack/Maps.h>
 #include <unwindstack/Memory.h>
@@ -102,6 +105,25 @@ void DoUnwind(pid_t pid) {
   for (size_t i = 0; i < unwinder.NumFrames(); i++) {
     printf("%s\n", unwinder.FormatFrame(i).c_str());
   }
+
+  // Print the memory used by the fde lookup tables built while unwinding.
+  bool printed_header = false;
+  std::unordered_set<unwindstack::Elf*> seen;
+  for (const auto& map_info : *unwinder.GetMaps()) {
+    unwindstack::Elf* elf = map_info->elf.get();
+    if (elf == nullptr || !elf->valid() || !seen.insert(elf).second) {
+      continue;
+    }
+    size_t size = elf->interface()->DwarfIndexMemorySize();
+    if (size == 0) {
+      continue;
+    }
+    if (!printed_header) {
+      printf("\nFde index memory:\n");
+      printed_header = true;
+    }
+    printf("  %s: %zu bytes\n", map_info->name.c_str(), size);
+  }
 }
 
 int main(int argc, char** argv) {
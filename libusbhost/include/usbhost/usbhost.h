@@ -266,6 +266,63 @@ struct usb_request *usb_request_wait(struct usb_device *dev, int timeoutMillis);
 /* Cancels a pending usb_request_queue() operation. */
 int usb_request_cancel(struct usb_request *req);
 
+/* Passed to a usb_stream_cb instead of a completion status when the request is
+ * about to be submitted for the first time.
+ */
+#define USB_STREAM_START 1
+
+struct usb_stream;
+
+/* Called for each request of a stream, with USB_STREAM_START before the request
+ * is first submitted, then with the status of each of its transfers once it
+ * completes: 0 (req->actual_length bytes were transferred) or a negative errno.
+ * On completion of an IN transfer, req->buffer holds the data. For an OUT
+ * endpoint, the callback fills req->buffer with the next data to send.
+ * req->buffer_length is reset to the stream's buffer length before each call,
+ * and may be lowered by the callback for the next transfer.
+ * Return 0 to submit the request again, or nonzero to leave it idle.
+ * Requests complete in the order they were submitted.
+ */
+typedef int (*usb_stream_cb)(struct usb_request *req, int status, void *client_data);
+
+/* Creates a stream of |count| requests on a bulk or interrupt endpoint, so that
+ * several transfers can be in flight at a time. The buffers are mapped from
+ * usbfs where the kernel supports it, which lets the controller transfer to
+ * and from them directly rather than through a copy in the kernel.
+ * The client_data of each request points to the stream: use the client_data
+ * of the callback instead.
+ * Returns NULL on error.
+ */
+struct usb_stream *usb_stream_new(struct usb_device *dev,
+        const struct usb_endpoint_descriptor *ep_desc, int count,
+        int buffer_length, usb_stream_cb callback, void *client_data);
+
+/* Submits the requests of the stream, calling the callback with
+ * USB_STREAM_START for each first.
+ * Returns 0 on success, or -1 and sets errno if a request couldn't be submitted.
+ */
+int usb_stream_start(struct usb_stream *stream);
+
+/* Cancels the requests of the stream that are in flight, and frees it. Its
+ * memory is only released once they are reaped by
+ * usb_device_process_streams(), or the device is closed.
+ */
+void usb_stream_free(struct usb_stream *stream);
+
+/* Reaps the requests that completed on the device, calling the callbacks of
+ * their streams and submitting them again. Waits up to timeoutMillis for the
+ * first one, or forever if it is -1: usb_device_get_fd() polls for POLLOUT
+ * when there are some, so a caller with its own event loop can use 0.
+ * While streams are in use, all of the device's requests must be reaped here
+ * rather than with usb_request_wait(): a request that isn't part of a stream
+ * stops the processing and is returned in |other_req|, which must then not be
+ * NULL.
+ * Returns the number of stream requests that completed, or -1 and sets errno
+ * on error.
+ */
+int usb_device_process_streams(struct usb_device *dev, int timeoutMillis,
+        struct usb_request **other_req);
+
 #ifdef __cplusplus
 }
 #endif
@@ -40,6 +40,7 @@
 #include <stddef.h>
 
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/time.h>
 #include <sys/inotify.h>
@@ -84,8 +85,29 @@ struct usb_device {
     int desc_length;
     int fd;
     int writeable;
+    struct usb_stream *streams;
 };
 
+struct usb_stream_slot {
+    struct usb_request *req;
+    int mapped;  /* buffer comes from mmap on the usbfs fd, rather than malloc */
+    int queued;
+};
+
+struct usb_stream {
+    struct usb_device *dev;
+    struct usb_stream *next;
+    usb_stream_cb callback;
+    void *client_data;
+    int buffer_length;
+    int in_flight;
+    int closing;
+    int count;
+    struct usb_stream_slot slots[];
+};
+
+static void usb_stream_destroy(struct usb_stream *stream);
+
 static inline int badname(const char *name)
 {
     while(*name) {
@@ -363,7 +385,13 @@ struct usb_device *usb_device_open(const char *dev_name)
 
 void usb_device_close(struct usb_device *device)
 {
+    /* Closing the fd discards the URBs that are still in flight. */
     close(device->fd);
+    while (device->streams) {
+        struct usb_stream *stream = device->streams;
+        device->streams = stream->next;
+        usb_stream_destroy(stream);
+    }
     free(device);
 }
 
@@ -778,3 +806,184 @@ int usb_request_cancel(struct usb_request *req)
     struct usbdevfs_urb *urb = ((struct usbdevfs_urb*)req->private_data);
     return ioctl(req->dev->fd, USBDEVFS_DISCARDURB, urb);
 }
+
+static void usb_stream_destroy(struct usb_stream *stream)
+{
+    int i;
+    for (i = 0; i < stream->count; i++) {
+        struct usb_request *req = stream->slots[i].req;
+        if (!req)
+            continue;
+        if (stream->slots[i].mapped)
+            munmap(req->buffer, stream->buffer_length);
+        else
+            free(req->buffer);
+        usb_request_free(req);
+    }
+    free(stream);
+}
+
+static void usb_stream_unlink(struct usb_stream *stream)
+{
+    struct usb_stream **link = &stream->dev->streams;
+    while (*link != stream)
+        link = &(*link)->next;
+    *link = stream->next;
+}
+
+struct usb_stream *usb_stream_new(struct usb_device *dev,
+        const struct usb_endpoint_descriptor *ep_desc, int count,
+        int buffer_length, usb_stream_cb callback, void *client_data)
+{
+    int i;
+    if (count <= 0 || buffer_length <= 0 || !callback) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct usb_stream *stream = calloc(1, sizeof(struct usb_stream) +
+            count * sizeof(struct usb_stream_slot));
+    if (!stream)
+        return NULL;
+    stream->dev = dev;
+    stream->callback = callback;
+    stream->client_data = client_data;
+    stream->buffer_length = buffer_length;
+    stream->count = count;
+
+    for (i = 0; i < count; i++) {
+        struct usb_request *req = usb_request_new(dev, ep_desc);
+        if (!req)
+            goto failed;
+        stream->slots[i].req = req;
+        req->client_data = stream;
+
+        /* usbfs has been able to map buffers for DMA since Linux 4.6. */
+        void *buffer = mmap(NULL, buffer_length, PROT_READ | PROT_WRITE, MAP_SHARED, dev->fd, 0);
+        if (buffer != MAP_FAILED) {
+            stream->slots[i].mapped = 1;
+        } else {
+            buffer = malloc(buffer_length);
+            if (!buffer)
+                goto failed;
+        }
+        req->buffer = buffer;
+        req->buffer_length = buffer_length;
+    }
+
+    stream->next = dev->streams;
+    dev->streams = stream;
+    return stream;
+
+failed:
+    usb_stream_destroy(stream);
+    return NULL;
+}
+
+/* Calls the callback of the request in slot i, and submits it again if asked to. */
+static int usb_stream_resubmit(struct usb_stream *stream, int i, int status)
+{
+    struct usb_request *req = stream->slots[i].req;
+    req->buffer_length = stream->buffer_length;
+    if (stream->callback(req, status, stream->client_data) != 0)
+        return 0;
+    if (usb_request_queue(req) < 0)
+        return -1;
+    stream->slots[i].queued = 1;
+    stream->in_flight++;
+    return 0;
+}
+
+int usb_stream_start(struct usb_stream *stream)
+{
+    int i;
+    for (i = 0; i < stream->count; i++) {
+        if (stream->slots[i].queued)
+            continue;
+        stream->slots[i].req->actual_length = 0;
+        if (usb_stream_resubmit(stream, i, USB_STREAM_START) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+void usb_stream_free(struct usb_stream *stream)
+{
+    int i;
+    stream->closing = 1;
+    for (i = 0; i < stream->count; i++) {
+        if (stream->slots[i].queued)
+            usb_request_cancel(stream->slots[i].req);
+    }
+    if (stream->in_flight == 0) {
+        usb_stream_unlink(stream);
+        usb_stream_destroy(stream);
+    }
+}
+
+int usb_device_process_streams(struct usb_device *dev, int timeoutMillis,
+        struct usb_request **other_req)
+{
+    int completed = 0;
+
+    if (other_req)
+        *other_req = NULL;
+
+    if (timeoutMillis != 0) {
+        struct pollfd p = {.fd = dev->fd, .events = POLLOUT, .revents = 0};
+        int res = TEMP_FAILURE_RETRY(poll(&p, 1, timeoutMillis));
+        if (res < 0)
+            return -1;
+        if (res == 0)
+            return 0;
+    }
+
+    while (1) {
+        struct usbdevfs_urb *urb = NULL;
+        int res = TEMP_FAILURE_RETRY(ioctl(dev->fd, USBDEVFS_REAPURBNDELAY, &urb));
+        if (res < 0) {
+            if (errno == EAGAIN || completed > 0)
+                break;
+            return -1;
+        }
+
+        struct usb_request *req = (struct usb_request*)urb->usercontext;
+        req->actual_length = urb->actual_length;
+
+        struct usb_stream *stream;
+        int slot = -1;
+        for (stream = dev->streams; stream && slot < 0; stream = stream->next) {
+            int i;
+            if (req->client_data != stream)
+                continue;
+            for (i = 0; i < stream->count; i++) {
+                if (stream->slots[i].req == req) {
+                    slot = i;
+                    break;
+                }
+            }
+            if (slot >= 0)
+                break;
+        }
+        if (slot < 0) {
+            D("[ reaped urb @%p outside of streams ]\n", urb);
+            if (other_req)
+                *other_req = req;
+            break;
+        }
+
+        stream->slots[slot].queued = 0;
+        stream->in_flight--;
+        completed++;
+        if (stream->closing) {
+            if (stream->in_flight == 0) {
+                usb_stream_unlink(stream);
+                usb_stream_destroy(stream);
+            }
+            continue;
+        }
+        if (usb_stream_resubmit(stream, slot, urb->status) < 0)
+            return -1;
+    }
+    return completed;
+}
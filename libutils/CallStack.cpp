@@ -38,18 +38,28 @@ CallStack::CallStack(const char* logtag, int32_t ignoreDepth) {
 CallStack::~CallStack() {
 }
 
-void CallStack::update(int32_t ignoreDepth, pid_t tid) {
-    mFrameLines.clear();
+// Always inlined, so that both versions of update() are a single frame deep.
+static ALWAYS_INLINE inline void unwind(Vector<String8>* frameLines, int32_t ignoreDepth,
+                                        pid_t tid, BacktraceMap* map) {
+    frameLines->clear();
 
-    std::unique_ptr<Backtrace> backtrace(Backtrace::Create(BACKTRACE_CURRENT_PROCESS, tid));
+    std::unique_ptr<Backtrace> backtrace(Backtrace::Create(BACKTRACE_CURRENT_PROCESS, tid, map));
     if (!backtrace->Unwind(ignoreDepth)) {
-        ALOGW("%s: Failed to unwind callstack.", __FUNCTION__);
+        ALOGW("update: Failed to unwind callstack.");
     }
     for (size_t i = 0; i < backtrace->NumFrames(); i++) {
-      mFrameLines.push_back(String8(backtrace->FormatFrameData(i).c_str()));
+      frameLines->push_back(String8(backtrace->FormatFrameData(i).c_str()));
     }
 }
 
+void CallStack::update(int32_t ignoreDepth, pid_t tid) {
+    unwind(&mFrameLines, ignoreDepth, tid, nullptr);
+}
+
+void CallStack::update(int32_t ignoreDepth, pid_t tid, BacktraceMap* map) {
+    unwind(&mFrameLines, ignoreDepth, tid, map);
+}
+
 void CallStack::log(const char* logtag, android_LogPriority priority, const char* prefix) const {
     LogPrinter printer(logtag, priority, prefix, /*ignoreBlankLines*/false);
     print(printer);
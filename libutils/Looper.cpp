@@ -16,6 +16,8 @@
 #include <utils/Looper.h>
 
 #include <sys/eventfd.h>
+
+#include <algorithm>
 #include <cinttypes>
 
 namespace android {
@@ -62,6 +64,7 @@ static pthread_key_t gTLSKey = 0;
 Looper::Looper(bool allowNonCallbacks)
     : mAllowNonCallbacks(allowNonCallbacks),
       mSendingMessage(false),
+      mNextMessageSeq(0),
       mPolling(false),
       mEpollRebuildRequired(false),
       mNextRequestSeq(0),
@@ -303,18 +306,19 @@ Done: ;
 
     // Invoke pending message callbacks.
     mNextMessageUptime = LLONG_MAX;
-    while (mMessageEnvelopes.size() != 0) {
+    while (!mMessageEnvelopes.empty()) {
         nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
-        const MessageEnvelope& messageEnvelope = mMessageEnvelopes.itemAt(0);
+        const MessageEnvelope& messageEnvelope = mMessageEnvelopes.front();
         if (messageEnvelope.uptime <= now) {
             // Remove the envelope from the list.
             // We keep a strong reference to the handler until the call to handleMessage
             // finishes.  Then we drop it so that the handler can be deleted *before*
             // we reacquire our lock.
             { // obtain handler
-                sp<MessageHandler> handler = messageEnvelope.handler;
-                Message message = messageEnvelope.message;
-                mMessageEnvelopes.removeAt(0);
+                std::pop_heap(mMessageEnvelopes.begin(), mMessageEnvelopes.end());
+                sp<MessageHandler> handler = std::move(mMessageEnvelopes.back().handler);
+                Message message = mMessageEnvelopes.back().message;
+                mMessageEnvelopes.pop_back();
                 mSendingMessage = true;
                 mLock.unlock();
 
@@ -590,17 +594,14 @@ void Looper::sendMessageAtTime(nsecs_t uptime, const sp<MessageHandler>& handler
             this, uptime, handler.get(), message.what);
 #endif
 
-    size_t i = 0;
+    bool atHead;
     { // acquire lock
         AutoMutex _l(mLock);
 
-        size_t messageCount = mMessageEnvelopes.size();
-        while (i < messageCount && uptime >= mMessageEnvelopes.itemAt(i).uptime) {
-            i += 1;
-        }
+        atHead = mMessageEnvelopes.empty() || uptime < mMessageEnvelopes.front().uptime;
 
-        MessageEnvelope messageEnvelope(uptime, handler, message);
-        mMessageEnvelopes.insertAt(messageEnvelope, i, 1);
+        mMessageEnvelopes.emplace_back(uptime, mNextMessageSeq++, handler, message);
+        std::push_heap(mMessageEnvelopes.begin(), mMessageEnvelopes.end());
 
         // Optimization: If the Looper is currently sending a message, then we can skip
         // the call to wake() because the next thing the Looper will do after processing
@@ -612,11 +613,20 @@ void Looper::sendMessageAtTime(nsecs_t uptime, const sp<MessageHandler>& handler
     } // release lock
 
     // Wake the poll loop only when we enqueue a new message at the head.
-    if (i == 0) {
+    if (atHead) {
         wake();
     }
 }
 
+template <typename Pred>
+void Looper::removeMessagesLocked(Pred pred) {
+    auto end = std::remove_if(mMessageEnvelopes.begin(), mMessageEnvelopes.end(), pred);
+    if (end != mMessageEnvelopes.end()) {
+        mMessageEnvelopes.erase(end, mMessageEnvelopes.end());
+        std::make_heap(mMessageEnvelopes.begin(), mMessageEnvelopes.end());
+    }
+}
+
 void Looper::removeMessages(const sp<MessageHandler>& handler) {
 #if DEBUG_CALLBACKS
     ALOGD("%p ~ removeMessages - handler=%p", this, handler.get());
@@ -625,12 +635,9 @@ void Looper::removeMessages(const sp<MessageHandler>& handler) {
     { // acquire lock
         AutoMutex _l(mLock);
 
-        for (size_t i = mMessageEnvelopes.size(); i != 0; ) {
-            const MessageEnvelope& messageEnvelope = mMessageEnvelopes.itemAt(--i);
-            if (messageEnvelope.handler == handler) {
-                mMessageEnvelopes.removeAt(i);
-            }
-        }
+        removeMessagesLocked([&](const MessageEnvelope& messageEnvelope) {
+            return messageEnvelope.handler == handler;
+        });
     } // release lock
 }
 
@@ -642,13 +649,10 @@ void Looper::removeMessages(const sp<MessageHandler>& handler, int what) {
     { // acquire lock
         AutoMutex _l(mLock);
 
-        for (size_t i = mMessageEnvelopes.size(); i != 0; ) {
-            const MessageEnvelope& messageEnvelope = mMessageEnvelopes.itemAt(--i);
-            if (messageEnvelope.handler == handler
-                    && messageEnvelope.message.what == what) {
-                mMessageEnvelopes.removeAt(i);
-            }
-        }
+        removeMessagesLocked([&](const MessageEnvelope& messageEnvelope) {
+            return messageEnvelope.handler == handler
+                    && messageEnvelope.message.what == what;
+        });
     } // release lock
 }
 
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <utils/Looper.h>
+
+using namespace android;
+
+class NullHandler : public MessageHandler {
+  public:
+    virtual void handleMessage(const Message&) {}
+};
+
+// Sends state.range(0) messages in reverse due order, then dispatches them.
+void BM_looper_send_and_dispatch(benchmark::State& state) {
+    sp<Looper> looper = new Looper(true);
+    sp<NullHandler> handler = new NullHandler();
+    const int count = state.range(0);
+    while (state.KeepRunning()) {
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        for (int i = 0; i < count; i++) {
+            looper->sendMessageAtTime(now - i, handler, Message(i));
+        }
+        while (looper->pollOnce(0) == Looper::POLL_CALLBACK) {
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_looper_send_and_dispatch)->Arg(1)->Arg(64)->Arg(1024);
+
+// Sends messages into a queue that already holds state.range(0) future messages.
+void BM_looper_send_to_deep_queue(benchmark::State& state) {
+    sp<Looper> looper = new Looper(true);
+    sp<NullHandler> handler = new NullHandler();
+    nsecs_t future = systemTime(SYSTEM_TIME_MONOTONIC) + s2ns(3600);
+    for (int i = 0; i < state.range(0); i++) {
+        looper->sendMessageAtTime(future + i, handler, Message(i));
+    }
+    while (state.KeepRunning()) {
+        looper->sendMessageAtTime(future + state.range(0), handler, Message(-1));
+        state.PauseTiming();
+        looper->removeMessages(handler, -1);
+        state.ResumeTiming();
+    }
+}
+BENCHMARK(BM_looper_send_to_deep_queue)->Arg(16)->Arg(1024)->Arg(16384);
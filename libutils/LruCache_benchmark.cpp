@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <utils/LruCache.h>
+#include <utils/Mutex.h>
+#include <utils/ShardedLruCache.h>
+
+using namespace android;
+
+static constexpr int kKeys = 1024;
+
+// What callers do today: a single LruCache behind a global lock.
+static Mutex gLock;
+static LruCache<int, int>* gLockedCache;
+
+void BM_get_locked_lru_cache(benchmark::State& state) {
+    if (state.thread_index == 0) {
+        gLockedCache = new LruCache<int, int>(kKeys);
+        for (int i = 0; i < kKeys; i++) {
+            gLockedCache->put(i, i);
+        }
+    }
+    int key = state.thread_index;
+    while (state.KeepRunning()) {
+        Mutex::Autolock _l(gLock);
+        benchmark::DoNotOptimize(gLockedCache->get(key));
+        key = (key + 7) % kKeys;
+    }
+    if (state.thread_index == 0) {
+        delete gLockedCache;
+    }
+}
+BENCHMARK(BM_get_locked_lru_cache)->ThreadRange(1, 4);
+
+static ShardedLruCache<int, int>* gShardedCache;
+
+void BM_get_sharded_lru_cache(benchmark::State& state) {
+    if (state.thread_index == 0) {
+        gShardedCache = new ShardedLruCache<int, int>(kKeys);
+        for (int i = 0; i < kKeys; i++) {
+            gShardedCache->put(i, i);
+        }
+    }
+    int key = state.thread_index;
+    int value;
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(gShardedCache->get(key, &value));
+        key = (key + 7) % kKeys;
+    }
+    if (state.thread_index == 0) {
+        delete gShardedCache;
+    }
+}
+BENCHMARK(BM_get_sharded_lru_cache)->ThreadRange(1, 4);
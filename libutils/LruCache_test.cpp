@@ -16,10 +16,14 @@
 
 #include <stdlib.h>
 
+#include <thread>
+#include <vector>
+
 #include <android/log.h>
 #include <gtest/gtest.h>
 #include <utils/JenkinsHash.h>
 #include <utils/LruCache.h>
+#include <utils/ShardedLruCache.h>
 
 namespace {
 
@@ -456,4 +460,112 @@ TEST_F(LruCacheTest, DontCopyKeyInGet) {
     cache.get(KeyFailsOnCopy(0));
 }
 
+TEST_F(LruCacheTest, GetIfPresent) {
+    LruCache<SimpleKey, int> cache(100);
+    cache.put(1, 0);
+
+    ASSERT_NE(nullptr, cache.getIfPresent(1));
+    EXPECT_EQ(0, *cache.getIfPresent(1));
+    EXPECT_EQ(nullptr, cache.getIfPresent(2));
+}
+
+TEST_F(LruCacheTest, ShardedSimple) {
+    ShardedLruCache<SimpleKey, StringValue> cache(100);
+    StringValue value = nullptr;
+
+    EXPECT_FALSE(cache.get(1, &value));
+    EXPECT_TRUE(cache.put(1, "one"));
+    EXPECT_FALSE(cache.put(1, "uno"));
+    EXPECT_TRUE(cache.get(1, &value));
+    EXPECT_STREQ("one", value);
+    EXPECT_TRUE(cache.remove(1));
+    EXPECT_FALSE(cache.remove(1));
+    EXPECT_EQ(0u, cache.size());
+
+    ShardedLruCache<SimpleKey, StringValue>::Stats stats = cache.getStats();
+    EXPECT_EQ(1u, stats.hits);
+    EXPECT_EQ(1u, stats.misses);
+    EXPECT_EQ(0u, stats.evictions);
+}
+
+TEST_F(LruCacheTest, ShardedCostBudget) {
+    // A single shard, so that the eviction order is exact.
+    ShardedLruCache<SimpleKey, int> cache(
+            10, [](const SimpleKey&, const int& v) { return static_cast<size_t>(v); }, 1);
+
+    EXPECT_FALSE(cache.put(1, 11)) << "entry over the budget was accepted";
+    EXPECT_TRUE(cache.put(1, 4));
+    EXPECT_TRUE(cache.put(2, 4));
+    int value = 0;
+    EXPECT_TRUE(cache.get(1, &value));
+    EXPECT_TRUE(cache.put(3, 4));
+
+    EXPECT_TRUE(cache.get(1, &value));
+    EXPECT_FALSE(cache.get(2, &value)) << "least recently used entry wasn't evicted";
+    EXPECT_TRUE(cache.get(3, &value));
+
+    ShardedLruCache<SimpleKey, int>::Stats stats = cache.getStats();
+    EXPECT_EQ(1u, stats.evictions);
+    EXPECT_EQ(2u, stats.size);
+    EXPECT_EQ(8u, stats.cost);
+}
+
+TEST_F(LruCacheTest, ShardedCallback) {
+    ShardedLruCache<SimpleKey, StringValue> cache(1, nullptr, 1);
+    EntryRemovedCallback callback;
+    cache.setOnEntryRemovedListener(&callback);
+
+    cache.put(1, "one");
+    cache.put(2, "two");
+    EXPECT_EQ(1, callback.callbackCount);
+    EXPECT_EQ(1, callback.lastKey);
+    EXPECT_STREQ("one", callback.lastValue);
+
+    cache.clear();
+    EXPECT_EQ(2, callback.callbackCount);
+    EXPECT_EQ(0u, cache.getStats().cost);
+}
+
+TEST_F(LruCacheTest, ShardedNoLeak) {
+    ShardedLruCache<ComplexKey, ComplexValue> cache(10, nullptr, 4);
+
+    for (int i = 0; i < 100; i++) {
+        cache.put(ComplexKey(i), ComplexValue(i));
+    }
+    EXPECT_GE(10u, cache.size());
+}
+
+TEST_F(LruCacheTest, ShardedConcurrent) {
+    static constexpr int kThreads = 4;
+    static constexpr int kKeys = 64;
+    static constexpr int kIterations = 10000;
+    ShardedLruCache<SimpleKey, int> cache(kKeys / 2);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([&cache, t]() {
+            for (int i = 0; i < kIterations; i++) {
+                int key = (i * 7 + t) % kKeys;
+                int value = 0;
+                if (cache.get(key, &value)) {
+                    ASSERT_EQ(key * 2, value);
+                } else {
+                    cache.put(key, key * 2);
+                }
+                if (i % 16 == 0) {
+                    cache.remove(key);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    ShardedLruCache<SimpleKey, int>::Stats stats = cache.getStats();
+    EXPECT_EQ(static_cast<uint64_t>(kThreads * kIterations), stats.hits + stats.misses);
+    EXPECT_EQ(stats.size, stats.cost);
+    EXPECT_GE(static_cast<size_t>(kKeys / 2), stats.size);
+}
+
 }
@@ -24,6 +24,7 @@
 
 #include <memory>
 
+#include <backtrace/BacktraceMap.h>
 #include <utils/Printer.h>
 
 namespace android {
@@ -138,6 +139,17 @@ void ProcessCallStack::update() {
 
     clear();
 
+    // Parse the maps of the process once, for all of its threads, rather than
+    // once per thread. The unwinder also caches what it reads from the ELF files
+    // in the map, so the libraries that most threads share are only read once.
+    // A dump doesn't outlive this call, so neither does the map: the next one
+    // sees the libraries loaded and unloaded in the meantime.
+    std::unique_ptr<BacktraceMap> map(BacktraceMap::Create(selfPid));
+    if (map == nullptr) {
+        ALOGW("%s: Failed to read the process's maps, unwinding with a map per thread",
+              __FUNCTION__);
+    }
+
     // Get current time.
     {
         time_t t = time(nullptr);
@@ -179,7 +191,7 @@ void ProcessCallStack::update() {
         int ignoreDepth = (selfPid == tid) ? IGNORE_DEPTH_CURRENT_THREAD : 0;
 
         // Update thread's call stacks
-        threadInfo.callStack.update(ignoreDepth, tid);
+        threadInfo.callStack.update(ignoreDepth, tid, map.get());
 
         // Read/save thread name
         threadInfo.threadName = getThreadName(tid);
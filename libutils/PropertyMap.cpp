@@ -18,6 +18,13 @@
 
 #include <utils/PropertyMap.h>
 
+#include <sys/stat.h>
+
+#include <string>
+#include <unordered_map>
+
+#include <utils/Mutex.h>
+
 // Enables debug output for the parser.
 #define DEBUG_PARSER 0
 
@@ -30,6 +37,36 @@ namespace android {
 static const char* WHITESPACE = " \t\r";
 static const char* WHITESPACE_OR_PROPERTY_DELIMITER = " \t\r=";
 
+// The same configuration files get loaded over and over, for instance every
+// time an input device is connected. Up to this many of them are kept
+// parsed, for as long as they are unchanged.
+static const size_t MAX_CACHED_FILES = 64;
+
+struct CachedPropertyMap {
+    struct stat st;
+    PropertyMap map;
+};
+
+static bool isSameFile(const struct stat& a, const struct stat& b) {
+    return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_size == b.st_size &&
+#if defined(__linux__)
+            a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec &&
+            a.st_ctim.tv_sec == b.st_ctim.tv_sec && a.st_ctim.tv_nsec == b.st_ctim.tv_nsec;
+#else
+            a.st_mtime == b.st_mtime && a.st_ctime == b.st_ctime;
+#endif
+}
+
+static Mutex& cacheLock() {
+    static Mutex* lock = new Mutex();
+    return *lock;
+}
+
+static std::unordered_map<std::string, CachedPropertyMap>& cache() {
+    static auto* cache = new std::unordered_map<std::string, CachedPropertyMap>();
+    return *cache;
+}
+
 
 // --- PropertyMap ---
 
@@ -114,6 +151,19 @@ void PropertyMap::addAll(const PropertyMap* map) {
 status_t PropertyMap::load(const String8& filename, PropertyMap** outMap) {
     *outMap = nullptr;
 
+    // Only regular files with content can be told apart by their stat, files
+    // in sysfs and the like always look the same.
+    struct stat st;
+    bool cacheable = !stat(filename.string(), &st) && S_ISREG(st.st_mode) && st.st_size > 0;
+    if (cacheable) {
+        Mutex::Autolock _l(cacheLock());
+        auto it = cache().find(filename.string());
+        if (it != cache().end() && isSameFile(it->second.st, st)) {
+            *outMap = new PropertyMap(it->second.map);
+            return OK;
+        }
+    }
+
     Tokenizer* tokenizer;
     status_t status = Tokenizer::open(filename, &tokenizer);
     if (status) {
@@ -139,6 +189,13 @@ status_t PropertyMap::load(const String8& filename, PropertyMap** outMap) {
                 delete map;
             } else {
                 *outMap = map;
+                if (cacheable) {
+                    Mutex::Autolock _l(cacheLock());
+                    if (cache().size() >= MAX_CACHED_FILES) {
+                        cache().erase(cache().begin());
+                    }
+                    cache()[filename.string()] = CachedPropertyMap{st, *map};
+                }
             }
         }
         delete tokenizer;
@@ -197,13 +254,15 @@ status_t PropertyMap::Parser::parse() {
                 return BAD_VALUE;
             }
 
-            if (mMap->hasProperty(keyToken)) {
+            // A single lookup: add() replaces the value of a duplicate key, but
+            // then the map gets thrown away anyway.
+            size_t count = mMap->mProperties.size();
+            mMap->addProperty(keyToken, valueToken);
+            if (mMap->mProperties.size() == count) {
                 ALOGE("%s: Duplicate property value for key '%s'.",
                         mTokenizer->getLocation().string(), keyToken.string());
                 return BAD_VALUE;
             }
-
-            mMap->addProperty(keyToken, valueToken);
         }
 
         mTokenizer->nextLine();
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/PropertyMap.h"
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "android-base/file.h"
+
+using android::OK;
+using android::PropertyMap;
+using android::String8;
+
+static std::unique_ptr<PropertyMap> Load(const char* path) {
+    PropertyMap* map = nullptr;
+    if (PropertyMap::load(String8(path), &map) != OK) {
+        return nullptr;
+    }
+    return std::unique_ptr<PropertyMap>(map);
+}
+
+TEST(PropertyMap, load) {
+    TemporaryFile tf;
+    ASSERT_TRUE(android::base::WriteStringToFile(
+            "# Comment\n"
+            "touch.deviceType = touchScreen\n"
+            "touch.orientationAware=1\n"
+            "\n"
+            "device.scale = 1.5\n",
+            tf.path));
+
+    auto map = Load(tf.path);
+    ASSERT_NE(nullptr, map);
+    ASSERT_EQ(3u, map->getProperties().size());
+
+    String8 type;
+    ASSERT_TRUE(map->tryGetProperty(String8("touch.deviceType"), type));
+    ASSERT_EQ(String8("touchScreen"), type);
+    bool orientationAware = false;
+    ASSERT_TRUE(map->tryGetProperty(String8("touch.orientationAware"), orientationAware));
+    ASSERT_TRUE(orientationAware);
+    float scale = 0;
+    ASSERT_TRUE(map->tryGetProperty(String8("device.scale"), scale));
+    ASSERT_FLOAT_EQ(1.5f, scale);
+}
+
+TEST(PropertyMap, load_duplicate_key) {
+    TemporaryFile tf;
+    ASSERT_TRUE(android::base::WriteStringToFile("a = 1\nb = 2\na = 3\n", tf.path));
+    ASSERT_EQ(nullptr, Load(tf.path));
+}
+
+TEST(PropertyMap, load_rewritten) {
+    TemporaryFile tf;
+    ASSERT_TRUE(android::base::WriteStringToFile("a = 1\n", tf.path));
+    auto first = Load(tf.path);
+    ASSERT_NE(nullptr, first);
+
+    // Loading it again gives a map of its own.
+    auto second = Load(tf.path);
+    ASSERT_NE(nullptr, second);
+    second->addProperty(String8("b"), String8("2"));
+    ASSERT_FALSE(first->hasProperty(String8("b")));
+    auto third = Load(tf.path);
+    ASSERT_NE(nullptr, third);
+    ASSERT_FALSE(third->hasProperty(String8("b")));
+
+    // Changes to the file are picked up.
+    ASSERT_TRUE(android::base::WriteStringToFile("a = 10\n", tf.path));
+    auto rewritten = Load(tf.path);
+    ASSERT_NE(nullptr, rewritten);
+    int32_t a = 0;
+    ASSERT_TRUE(rewritten->tryGetProperty(String8("a"), a));
+    ASSERT_EQ(10, a);
+}
@@ -78,8 +78,10 @@ namespace android {
 // reference, and thus may fail when attemptIncStrong would succeed.
 //
 // mStrong is the strong reference count.  mWeak is the weak reference count.
-// Between calls, and ignoring memory ordering effects, mWeak includes strong
-// references, and is thus >= mStrong.
+// Between calls, and ignoring memory ordering effects, the strong references
+// collectively hold a single weak reference: it is acquired by whoever takes
+// the first strong reference and released along with the last one.  Thus mWeak
+// is > 0 while mStrong is, but copying a sp<> only touches mStrong.
 //
 // A weakref_impl holds all the information, including both reference counts,
 // required to perform wp<> operations.  Thus these can continue to be performed
@@ -411,8 +413,16 @@ private:
 void RefBase::incStrong(const void* id) const
 {
     weakref_impl* const refs = mRefs;
-    refs->incWeak(id);
-    
+    // The caller either holds a strong reference already, or is taking the
+    // first one.  Only the latter needs to acquire the weak reference held by
+    // the strong references, and has to do so before the increment so that a
+    // concurrent decWeak() can't free refs underneath us.
+    const bool maybeFirst =
+            refs->mStrong.load(std::memory_order_relaxed) == INITIAL_STRONG_VALUE;
+    if (maybeFirst) {
+        refs->incWeak(refs->mBase);
+    }
+
     refs->addStrongRef(id);
     const int32_t c = refs->mStrong.fetch_add(1, std::memory_order_relaxed);
     ALOG_ASSERT(c > 0, "incStrong() called on %p after last strong ref", refs);
@@ -420,6 +430,10 @@ void RefBase::incStrong(const void* id) const
     ALOGD("incStrong of %p from %p: cnt=%d\n", this, id, c);
 #endif
     if (c != INITIAL_STRONG_VALUE)  {
+        if (maybeFirst) {
+            // Another thread took the first strong reference in the meantime.
+            refs->decWeak(refs->mBase);
+        }
         return;
     }
 
@@ -439,14 +453,17 @@ void RefBase::decStrong(const void* id) const
 #endif
     LOG_ALWAYS_FATAL_IF(BAD_STRONG(c), "decStrong() called on %p too many times",
             refs);
-    if (c == 1) {
-        std::atomic_thread_fence(std::memory_order_acquire);
-        refs->mBase->onLastStrongRef(id);
-        int32_t flags = refs->mFlags.load(std::memory_order_relaxed);
-        if ((flags&OBJECT_LIFETIME_MASK) == OBJECT_LIFETIME_STRONG) {
-            delete this;
-            // The destructor does not delete refs in this case.
-        }
+    if (c != 1) {
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // Keep refs->mBase, this may be gone by the time we drop the weak reference.
+    const void* const weakId = refs->mBase;
+    refs->mBase->onLastStrongRef(id);
+    int32_t flags = refs->mFlags.load(std::memory_order_relaxed);
+    if ((flags&OBJECT_LIFETIME_MASK) == OBJECT_LIFETIME_STRONG) {
+        delete this;
+        // The destructor does not delete refs in this case.
     }
     // Note that even with only strong reference operations, the thread
     // deallocating this may not be the same as the thread deallocating refs.
@@ -459,7 +476,7 @@ void RefBase::decStrong(const void* id) const
     // they can change between `delete this;` and `refs->decWeak(id);`. This is
     // not the case. The analyzer may become more okay with this patten when
     // https://bugs.llvm.org/show_bug.cgi?id=34365 gets resolved. NOLINTNEXTLINE
-    refs->decWeak(id);
+    refs->decWeak(weakId);
 }
 
 void RefBase::forceIncStrong(const void* id) const
@@ -467,7 +484,7 @@ void RefBase::forceIncStrong(const void* id) const
     // Allows initial mStrong of 0 in addition to INITIAL_STRONG_VALUE.
     // TODO: Better document assumptions.
     weakref_impl* const refs = mRefs;
-    refs->incWeak(id);
+    refs->incWeak(refs->mBase);
     
     refs->addStrongRef(id);
     const int32_t c = refs->mStrong.fetch_add(1, std::memory_order_relaxed);
@@ -483,7 +500,11 @@ void RefBase::forceIncStrong(const void* id) const
                 std::memory_order_relaxed);
         FALLTHROUGH_INTENDED;
     case 0:
+        // Our weak reference is the one held by the strong references now.
         refs->mBase->onFirstRef();
+        break;
+    default:
+        refs->decWeak(refs->mBase);
     }
 }
 
@@ -643,6 +664,15 @@ bool RefBase::weakref_type::attemptIncStrong(const void* id)
                 std::memory_order_relaxed);
     }
 
+    if (curCount == INITIAL_STRONG_VALUE || curCount == 0) {
+        // We took the first strong reference, our weak reference becomes the
+        // one held by the strong references.
+        impl->renameWeakRefId(id, impl->mBase);
+    } else {
+        // Can't be the last weak reference, the strong references hold one.
+        decWeak(id);
+    }
+
     return true;
 }
 
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <utils/LightRefBase.h>
+#include <utils/RefBase.h>
+#include <utils/StrongPointer.h>
+
+using namespace android;
+
+class Heavy : public RefBase {};
+class Light : public LightRefBase<Light> {};
+
+void BM_copy_sp_refbase(benchmark::State& state) {
+    sp<Heavy> obj = new Heavy();
+    while (state.KeepRunning()) {
+        sp<Heavy> copy = obj;
+        benchmark::DoNotOptimize(copy.get());
+    }
+}
+BENCHMARK(BM_copy_sp_refbase);
+
+void BM_copy_sp_light_refbase(benchmark::State& state) {
+    sp<Light> obj = new Light();
+    while (state.KeepRunning()) {
+        sp<Light> copy = obj;
+        benchmark::DoNotOptimize(copy.get());
+    }
+}
+BENCHMARK(BM_copy_sp_light_refbase);
+
+void BM_promote_wp(benchmark::State& state) {
+    sp<Heavy> obj = new Heavy();
+    wp<Heavy> weak = obj;
+    while (state.KeepRunning()) {
+        sp<Heavy> promoted = weak.promote();
+        benchmark::DoNotOptimize(promoted.get());
+    }
+}
+BENCHMARK(BM_promote_wp);
+
+void BM_create_destroy_refbase(benchmark::State& state) {
+    while (state.KeepRunning()) {
+        sp<Heavy> obj = new Heavy();
+        benchmark::DoNotOptimize(obj.get());
+    }
+}
+BENCHMARK(BM_create_destroy_refbase);
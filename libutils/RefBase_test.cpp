@@ -128,6 +128,25 @@ TEST(RefBase, WeakCopies) {
     ASSERT_FALSE(isDeleted) << "Deletion on wp destruction should no longer occur";
 }
 
+TEST(RefBase, StrongCopiesShareWeakRef) {
+    bool isDeleted;
+    Foo* foo = new Foo(&isDeleted);
+    wp<Foo> wp1(foo);
+    sp<Foo> sp1(foo);
+    // The strong references together hold a single weak reference.
+    EXPECT_EQ(2, foo->getWeakRefs()->getWeakCount());
+    {
+        sp<Foo> sp2 = sp1;
+        sp<Foo> sp3 = wp1.promote();
+        EXPECT_EQ(3, foo->getStrongCount());
+        EXPECT_EQ(2, foo->getWeakRefs()->getWeakCount());
+    }
+    sp1 = nullptr;
+    ASSERT_TRUE(isDeleted) << "foo was leaked!";
+    EXPECT_EQ(1, wp1.get_refs()->getWeakCount());
+    ASSERT_TRUE(wp1.promote().get() == nullptr);
+}
+
 TEST(RefBase, Comparisons) {
     bool isDeleted, isDeleted2, isDeleted3;
     Foo* foo = new Foo(&isDeleted);
@@ -210,6 +210,20 @@ TEST(String16Test, StringMoveFromStaticString) {
     EXPECT_STR16EQ(u"Verify me", another);
 }
 
+TEST(String16Test, MoveTakesBuffer) {
+    String16 tmp(u"Verify me");
+    const char16_t* buffer = tmp.string();
+    String16 another(std::move(tmp));
+    EXPECT_EQ(buffer, another.string());
+    EXPECT_EQ(0U, tmp.size());
+    EXPECT_TRUE(tmp.isStaticString());
+
+    String16 third(u"nonstatic");
+    third = std::move(another);
+    EXPECT_EQ(buffer, third.string());
+    EXPECT_STR16EQ(u"Verify me", third);
+}
+
 TEST(String16Test, EmptyStringIsStatic) {
     String16 tmp("");
     EXPECT_TRUE(tmp.isStaticString());
@@ -144,6 +144,12 @@ String8::String8(const String8& o)
     SharedBuffer::bufferFromData(mString)->acquire();
 }
 
+String8::String8(String8&& o) noexcept
+    : mString(o.mString)
+{
+    o.mString = getEmptyString();
+}
+
 String8::String8(const char* o)
     : mString(allocFromUTF8(o, strlen(o)))
 {
@@ -88,6 +88,19 @@ TEST_F(String8Test, CorrectInvalidSurrogate) {
     EXPECT_EQ(4U, string8.length());
 }
 
+TEST_F(String8Test, Move) {
+    String8 tmp("Verify me");
+    const char* buffer = tmp.string();
+    String8 another(std::move(tmp));
+    EXPECT_EQ(buffer, another.string());
+    EXPECT_EQ(0U, tmp.length());
+
+    String8 third("nonstatic");
+    third = std::move(another);
+    EXPECT_EQ(buffer, third.string());
+    EXPECT_STREQ("Verify me", third.string());
+}
+
 TEST_F(String8Test, CheckUtf32Conversion) {
     // Since bound checks were added, check the conversion can be done without fatal errors.
     // The utf8 lengths of these are chars are 1 + 2 + 3 + 4 = 10.
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <utils/String16.h>
+#include <utils/String8.h>
+#include <vector>
+
+using namespace android;
+
+// std::vector relocates its elements with the move constructor on growth.
+void BM_fill_std_vector_string16(benchmark::State& state) {
+    String16 str(u"android.os.IServiceManager");
+    while (state.KeepRunning()) {
+        std::vector<String16> v;
+        for (int i = 0; i < 256; i++) {
+            v.push_back(str);
+        }
+    }
+}
+BENCHMARK(BM_fill_std_vector_string16);
+
+void BM_fill_std_vector_string8(benchmark::State& state) {
+    String8 str("android.os.IServiceManager");
+    while (state.KeepRunning()) {
+        std::vector<String8> v;
+        for (int i = 0; i < 256; i++) {
+            v.push_back(str);
+        }
+    }
+}
+BENCHMARK(BM_fill_std_vector_string8);
+
+void BM_return_string16(benchmark::State& state) {
+    String16 str(u"android.os.IServiceManager");
+    while (state.KeepRunning()) {
+        String16 result;
+        result = String16(str);
+        benchmark::DoNotOptimize(result.string());
+    }
+}
+BENCHMARK(BM_return_string16);
+
+static const char kAsciiText[] =
+        "android.hardware.graphics.composer@2.3::IComposer/default "
+        "android.hardware.camera.provider@2.4::ICameraProvider/legacy/0 "
+        "android.os.IServiceManager android.content.pm.IPackageManager";
+// "Android is a mobile operating system based on a modified version of the
+// Linux kernel." in Chinese and Japanese.
+static const char kCjkText[] =
+        "\xE5\xAE\x89\xE5\x8D\x93\xE6\x98\xAF\xE4\xB8\x80\xE4\xB8\xAA\xE5\x9F\xBA\xE4\xBA\x8E"
+        "\xE4\xBF\xAE\xE6\x94\xB9\xE7\x89\x88\x4C\x69\x6E\x75\x78\xE5\x86\x85\xE6\xA0\xB8\xE7"
+        "\x9A\x84\xE7\xA7\xBB\xE5\x8A\xA8\xE6\x93\x8D\xE4\xBD\x9C\xE7\xB3\xBB\xE7\xBB\x9F\xE3"
+        "\x80\x82\xE3\x82\xA2\xE3\x83\xB3\xE3\x83\x89\xE3\x83\xAD\xE3\x82\xA4\xE3\x83\x89\xE3"
+        "\x81\xAF\x4C\x69\x6E\x75\x78\xE3\x82\xAB\xE3\x83\xBC\xE3\x83\x8D\xE3\x83\xAB\xE3\x82"
+        "\x92\xE3\x83\x99\xE3\x83\xBC\xE3\x82\xB9\xE3\x81\xA8\xE3\x81\x97\xE3\x81\x9F\xE3\x83"
+        "\xA2\xE3\x83\x90\xE3\x82\xA4\xE3\x83\xAB\x4F\x53\xE3\x81\xA7\xE3\x81\x99\xE3\x80\x82";
+
+static void BM_string16_from_utf8(benchmark::State& state, const char* text) {
+    while (state.KeepRunning()) {
+        String16 str(text);
+        benchmark::DoNotOptimize(str.string());
+    }
+    state.SetBytesProcessed(state.iterations() * strlen(text));
+}
+BENCHMARK_CAPTURE(BM_string16_from_utf8, ascii, kAsciiText);
+BENCHMARK_CAPTURE(BM_string16_from_utf8, cjk, kCjkText);
+
+static void BM_string8_from_utf16(benchmark::State& state, const char* text) {
+    String16 src(text);
+    while (state.KeepRunning()) {
+        String8 str(src);
+        benchmark::DoNotOptimize(str.string());
+    }
+    state.SetBytesProcessed(state.iterations() * src.size() * sizeof(char16_t));
+}
+BENCHMARK_CAPTURE(BM_string8_from_utf16, ascii, kAsciiText);
+BENCHMARK_CAPTURE(BM_string8_from_utf16, cjk, kCjkText);
@@ -18,6 +18,7 @@
 
 #include <android-base/macros.h>
 #include <limits.h>
+#include <string.h>
 #include <utils/Unicode.h>
 
 #include <log/log.h>
@@ -66,6 +67,36 @@ static const char32_t kFirstByteMark[] = {
     0x00000000, 0x00000000, 0x000000C0, 0x000000E0, 0x000000F0
 };
 
+// --------------------------------------------------------------------------
+// ASCII runs
+// --------------------------------------------------------------------------
+
+// The conversions below first skip over runs of ASCII, which is what most
+// strings are made of, a block at a time rather than a code point at a
+// time. The blocks are tested a word at a time, and the widening and
+// narrowing loops are simple enough for the compiler to vectorize.
+static const size_t kAsciiBlock = 16;
+
+static inline uint64_t load64(const void* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Are the kAsciiBlock bytes at src all ASCII?
+static inline bool utf8_block_is_ascii(const uint8_t* src)
+{
+    return ((load64(src) | load64(src + 8)) & 0x8080808080808080ULL) == 0;
+}
+
+// Are the kAsciiBlock code units at src all ASCII?
+static inline bool utf16_block_is_ascii(const char16_t* src)
+{
+    return ((load64(src) | load64(src + 4) | load64(src + 8) | load64(src + 12)) &
+            0xFF80FF80FF80FF80ULL) == 0;
+}
+
 // --------------------------------------------------------------------------
 // UTF-32
 // --------------------------------------------------------------------------
@@ -335,6 +366,16 @@ void utf16_to_utf8(const char16_t* src, size_t src_len, char* dst, size_t dst_le
     const char16_t* const end_utf16 = src + src_len;
     char *cur = dst;
     while (cur_utf16 < end_utf16) {
+        if ((size_t)(end_utf16 - cur_utf16) >= kAsciiBlock && dst_len >= kAsciiBlock &&
+                utf16_block_is_ascii(cur_utf16)) {
+            for (size_t i = 0; i < kAsciiBlock; i++) {
+                cur[i] = (char) cur_utf16[i];
+            }
+            cur_utf16 += kAsciiBlock;
+            cur += kAsciiBlock;
+            dst_len -= kAsciiBlock;
+            continue;
+        }
         char32_t utf32;
         // surrogate pairs
         if((*cur_utf16 & 0xFC00) == 0xD800 && (cur_utf16 + 1) < end_utf16
@@ -411,6 +452,12 @@ ssize_t utf16_to_utf8_length(const char16_t *src, size_t src_len)
     size_t ret = 0;
     const char16_t* const end = src + src_len;
     while (src < end) {
+        // Can't overflow: a block of code units is never longer in UTF-8.
+        if ((size_t)(end - src) >= kAsciiBlock && utf16_block_is_ascii(src)) {
+            src += kAsciiBlock;
+            ret += kAsciiBlock;
+            continue;
+        }
         size_t char_len;
         if ((*src & 0xFC00) == 0xD800 && (src + 1) < end
                 && (*(src + 1) & 0xFC00) == 0xDC00) {
@@ -490,6 +537,11 @@ ssize_t utf8_to_utf16_length(const uint8_t* u8str, size_t u8len, bool overreadIs
     /* Validate that the UTF-8 is the correct len */
     size_t u16measuredLen = 0;
     while (u8cur < u8end) {
+        if ((size_t)(u8end - u8cur) >= kAsciiBlock && utf8_block_is_ascii(u8cur)) {
+            u8cur += kAsciiBlock;
+            u16measuredLen += kAsciiBlock;
+            continue;
+        }
         u16measuredLen++;
         int u8charLen = utf8_codepoint_len(*u8cur);
         // Malformed utf8, some characters are beyond the end.
@@ -543,6 +595,15 @@ char16_t* utf8_to_utf16_no_null_terminator(
     char16_t* u16cur = dst;
 
     while (u8cur < u8end && u16cur < u16end) {
+        if ((size_t)(u8end - u8cur) >= kAsciiBlock && (size_t)(u16end - u16cur) >= kAsciiBlock &&
+                utf8_block_is_ascii(u8cur)) {
+            for (size_t i = 0; i < kAsciiBlock; i++) {
+                u16cur[i] = (char16_t) u8cur[i];
+            }
+            u8cur += kAsciiBlock;
+            u16cur += kAsciiBlock;
+            continue;
+        }
         size_t u8len = utf8_codepoint_len(*u8cur);
         uint32_t codepoint = utf8_to_utf32_codepoint(u8cur, u8len);
 
@@ -19,6 +19,9 @@
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <string>
+#include <vector>
+
 #include <log/log.h>
 #include <utils/Unicode.h>
 
@@ -176,6 +179,38 @@ TEST_F(UnicodeTest, strstr16TargetNotPresent) {
     EXPECT_EQ(nullptr, result);
 }
 
+// The ASCII fast paths work on blocks, make sure the code points around
+// the ends of the blocks come out right whatever their offset.
+TEST_F(UnicodeTest, UTF8toUTF16AndBackMixedBlocks) {
+    // U+00E9, U+4E2D and U+1F600 surrounded by ASCII
+    const char* const kNonAscii[] = { "\xC3\xA9", "\xE4\xB8\xAD", "\xF0\x9F\x98\x80" };
+    const size_t kU16Len[] = { 1, 1, 2 };
+    for (size_t which = 0; which < 3; which++) {
+        for (size_t offset = 0; offset < 40; offset++) {
+            std::string utf8(offset + 1, 'a');
+            utf8 += kNonAscii[which];
+            utf8 += std::string(40 - offset, 'b');
+            const uint8_t* src = reinterpret_cast<const uint8_t*>(utf8.data());
+
+            ssize_t u16len = utf8_to_utf16_length(src, utf8.size());
+            ASSERT_EQ(static_cast<ssize_t>(41 + kU16Len[which]), u16len);
+
+            std::vector<char16_t> utf16(u16len + 1);
+            char16_t* end = utf8_to_utf16(src, utf8.size(), utf16.data(), utf16.size());
+            ASSERT_EQ(utf16.data() + u16len, end);
+            EXPECT_EQ(u'a', utf16[0]);
+            EXPECT_EQ(u'b', utf16[u16len - 1]);
+            EXPECT_EQ(0, utf16[u16len]);
+
+            ASSERT_EQ(static_cast<ssize_t>(utf8.size()),
+                      utf16_to_utf8_length(utf16.data(), u16len));
+            std::vector<char> back(utf8.size() + 1);
+            utf16_to_utf8(utf16.data(), u16len, back.data(), back.size());
+            EXPECT_EQ(utf8, std::string(back.data()));
+        }
+    }
+}
+
 // http://b/29267949
 // Test that overreading in utf8_to_utf16_length is detected
 TEST_F(UnicodeTest, InvalidUtf8OverreadDetected) {
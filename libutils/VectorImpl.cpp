@@ -407,11 +407,9 @@ void* VectorImpl::_grow(size_t where, size_t amount)
                             "new_alloc_size overflow");
 
         // ALOGV("grow vector %p, new_capacity=%d", this, (int)new_capacity);
-        if ((mStorage) &&
-            (mCount==where) &&
-            (mFlags & HAS_TRIVIAL_COPY) &&
-            (mFlags & HAS_TRIVIAL_DTOR))
-        {
+        if (_can_resize_in_place()) {
+            // editResize() either reallocs the buffer, which relocates the items, or makes
+            // a bitwise copy of a shared one, which needs trivially copyable items.
             const SharedBuffer* cur_sb = SharedBuffer::bufferFromData(mStorage);
             SharedBuffer* sb = cur_sb->editResize(new_alloc_size);
             if (sb) {
@@ -419,6 +417,11 @@ void* VectorImpl::_grow(size_t where, size_t amount)
             } else {
                 return nullptr;
             }
+            if (where != mCount) {
+                const void* from = reinterpret_cast<const uint8_t *>(mStorage) + where*mItemSize;
+                void* to = reinterpret_cast<uint8_t *>(mStorage) + (where+amount)*mItemSize;
+                _do_move_forward(to, from, mCount - where);
+            }
         } else {
             SharedBuffer* sb = SharedBuffer::alloc(new_alloc_size);
             if (sb) {
@@ -475,10 +478,17 @@ void VectorImpl::_shrink(size_t where, size_t amount)
         // we are always reducing the capacity of the underlying SharedBuffer.
         // In other words, (old_capacity * mItemSize) did not overflow, and
         // where < (where + amount) < new_capacity < old_capacity.
-        if ((where == new_size) &&
-            (mFlags & HAS_TRIVIAL_COPY) &&
-            (mFlags & HAS_TRIVIAL_DTOR))
-        {
+        if ((where == new_size || (mFlags & HAS_TRIVIAL_MOVE)) && _can_resize_in_place()) {
+            if (where != new_size || !(mFlags & HAS_TRIVIAL_DTOR)) {
+                // Close the gap first, editResize() only keeps the head of the buffer.
+                void* array = editArrayImpl();
+                void* to = reinterpret_cast<uint8_t *>(array) + where*mItemSize;
+                _do_destroy(to, amount);
+                if (where != new_size) {
+                    const void* from = reinterpret_cast<uint8_t *>(array) + (where+amount)*mItemSize;
+                    _do_move_backward(to, from, new_size - where);
+                }
+            }
             const SharedBuffer* cur_sb = SharedBuffer::bufferFromData(mStorage);
             SharedBuffer* sb = cur_sb->editResize(new_capacity * mItemSize);
             if (sb) {
@@ -548,11 +558,29 @@ void VectorImpl::_do_splat(void* dest, const void* item, size_t num) const {
 }
 
 void VectorImpl::_do_move_forward(void* dest, const void* from, size_t num) const {
-    do_move_forward(dest, from, num);
+    if (mFlags & HAS_TRIVIAL_MOVE) {
+        memmove(dest, from, num*itemSize());
+    } else {
+        do_move_forward(dest, from, num);
+    }
 }
 
 void VectorImpl::_do_move_backward(void* dest, const void* from, size_t num) const {
-    do_move_backward(dest, from, num);
+    if (mFlags & HAS_TRIVIAL_MOVE) {
+        memmove(dest, from, num*itemSize());
+    } else {
+        do_move_backward(dest, from, num);
+    }
+}
+
+bool VectorImpl::_can_resize_in_place() const {
+    if (!mStorage) {
+        return false;
+    }
+    if ((mFlags & HAS_TRIVIAL_COPY) && (mFlags & HAS_TRIVIAL_DTOR)) {
+        return true;
+    }
+    return (mFlags & HAS_TRIVIAL_MOVE) && SharedBuffer::bufferFromData(mStorage)->onlyOwner();
 }
 
 /*****************************************************************************/
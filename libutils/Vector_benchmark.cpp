@@ -15,6 +15,8 @@
  */
 
 #include <benchmark/benchmark.h>
+#include <utils/KeyedVector.h>
+#include <utils/String8.h>
 #include <utils/Vector.h>
 #include <vector>
 
@@ -50,4 +52,46 @@ void BM_prepend_std_vector(benchmark::State& state) {
 }
 BENCHMARK(BM_prepend_std_vector);
 
+// String8 is relocated with memmove but has to be copied element by element when the
+// storage is shared.
+void BM_insert_remove_middle_android_vector_string8(benchmark::State& state) {
+    android::Vector<android::String8> v;
+    for (int i = 0; i < state.range(0); i++) {
+        v.push(android::String8("item"));
+    }
+    android::String8 item("A");
+    while (state.KeepRunning()) {
+        v.insertAt(item, v.size() / 2);
+        v.removeAt(v.size() / 2);
+    }
+}
+BENCHMARK(BM_insert_remove_middle_android_vector_string8)->Arg(16)->Arg(1024);
+
+void BM_grow_android_vector_string8(benchmark::State& state) {
+    android::String8 item("A");
+    while (state.KeepRunning()) {
+        android::Vector<android::String8> v;
+        for (int i = 0; i < state.range(0); i++) {
+            v.insertAt(item, 0);
+        }
+        while (!v.isEmpty()) {
+            v.removeAt(0);
+        }
+    }
+}
+BENCHMARK(BM_grow_android_vector_string8)->Arg(64)->Arg(1024);
+
+void BM_lookup_keyed_vector(benchmark::State& state) {
+    android::KeyedVector<int, int> kv;
+    for (int i = 0; i < state.range(0); i++) {
+        kv.add(i * 2, i);
+    }
+    int key = 0;
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(kv.indexOfKey(key));
+        key = (key + 7) % (state.range(0) * 2);
+    }
+}
+BENCHMARK(BM_lookup_keyed_vector)->Arg(16)->Arg(1024);
+
 BENCHMARK_MAIN();
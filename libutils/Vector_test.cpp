@@ -22,6 +22,7 @@
 
 #include <android/log.h>
 #include <gtest/gtest.h>
+#include <utils/String8.h>
 #include <utils/Vector.h>
 
 namespace android {
@@ -136,4 +137,31 @@ TEST_F(VectorTest, editArray_Shared) {
   }
 }
 
+TEST_F(VectorTest, TrivialMove_GrowAndShrink) {
+  // String8 is trivially movable but not trivially copyable, so the storage is only
+  // resized in place while it isn't shared.
+  Vector<String8> vector;
+  for (int i = 0; i < 64; i++) {
+    vector.insertAt(String8::format("%d", i), vector.size() / 2);
+  }
+  Vector<String8> other = vector;
+
+  vector.insertAt(String8("middle"), 32);
+  ASSERT_EQ(65U, vector.size());
+  ASSERT_EQ(64U, other.size());
+  EXPECT_STREQ("middle", vector[32].string());
+  EXPECT_STREQ(other[31].string(), vector[31].string());
+  EXPECT_STREQ(other[32].string(), vector[33].string());
+
+  vector.removeItemsAt(1, 60);
+  ASSERT_EQ(5U, vector.size());
+  EXPECT_STREQ(other[0].string(), vector[0].string());
+  EXPECT_STREQ(other[60].string(), vector[1].string());
+  EXPECT_STREQ(other[63].string(), vector[4].string());
+
+  other.removeItemsAt(0, 63);
+  ASSERT_EQ(1U, other.size());
+  EXPECT_STREQ(vector[4].string(), other[0].string());
+}
+
 } // namespace android
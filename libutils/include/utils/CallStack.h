@@ -40,6 +40,8 @@
 
 #define ALWAYS_INLINE __attribute__((always_inline))
 
+class BacktraceMap;
+
 namespace android {
 
 class Printer;
@@ -61,6 +63,10 @@ public:
     // The default is to dump the stack of the current call.
     void update(int32_t ignoreDepth = 1, pid_t tid = BACKTRACE_CURRENT_THREAD);
 
+    // Same as above, but unwinds with the given map of the current process,
+    // which callers that collect many stacks at once can share between them.
+    void update(int32_t ignoreDepth, pid_t tid, BacktraceMap* map);
+
     // Dump a stack trace to the log using the supplied logtag.
     void log(const char* logtag,
              android_LogPriority priority = ANDROID_LOG_DEBUG,
@@ -24,6 +24,8 @@
 
 #include <sys/epoll.h>
 
+#include <vector>
+
 #include <android-base/unique_fd.h>
 
 namespace android {
@@ -436,13 +438,20 @@ private:
     };
 
     struct MessageEnvelope {
-        MessageEnvelope() : uptime(0) { }
+        MessageEnvelope() : uptime(0), seq(0) { }
+
+        MessageEnvelope(nsecs_t u, uint64_t s, const sp<MessageHandler> h,
+                const Message& m) : uptime(u), seq(s), handler(h), message(m) {
+        }
 
-        MessageEnvelope(nsecs_t u, const sp<MessageHandler> h,
-                const Message& m) : uptime(u), handler(h), message(m) {
+        // Heap order: the earliest uptime on top, messages sent for the same
+        // uptime in the order they were sent.
+        bool operator<(const MessageEnvelope& other) const {
+            return uptime != other.uptime ? uptime > other.uptime : seq > other.seq;
         }
 
         nsecs_t uptime;
+        uint64_t seq;
         sp<MessageHandler> handler;
         Message message;
     };
@@ -452,7 +461,10 @@ private:
     android::base::unique_fd mWakeEventFd;  // immutable
     Mutex mLock;
 
-    Vector<MessageEnvelope> mMessageEnvelopes; // guarded by mLock
+    // Binary heap ordered by MessageEnvelope::operator<, so that sending a
+    // message costs O(log n) instead of a sorted insertion.
+    std::vector<MessageEnvelope> mMessageEnvelopes; // guarded by mLock
+    uint64_t mNextMessageSeq; // guarded by mLock
     bool mSendingMessage; // guarded by mLock
 
     // Whether we are currently waiting for work.  Not protected by a lock,
@@ -477,6 +489,8 @@ private:
     void awoken();
     void pushResponse(int events, const Request& request);
     void rebuildEpollLocked();
+    template <typename Pred>
+    void removeMessagesLocked(Pred pred);
     void scheduleEpollRebuildLocked();
 
     static void initTLSKey();
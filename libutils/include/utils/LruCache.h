@@ -47,6 +47,8 @@ public:
     void setOnEntryRemovedListener(OnEntryRemoved<TKey, TValue>* listener);
     size_t size() const;
     const TValue& get(const TKey& key);
+    // Like get(), but returns nullptr for missing keys instead of the null value.
+    const TValue* getIfPresent(const TKey& key);
     bool put(const TKey& key, const TValue& value);
     bool remove(const TKey& key);
     bool removeOldest();
@@ -188,16 +190,22 @@ size_t LruCache<TKey, TValue>::size() const {
 
 template <typename TKey, typename TValue>
 const TValue& LruCache<TKey, TValue>::get(const TKey& key) {
+    const TValue* value = getIfPresent(key);
+    return value ? *value : mNullValue;
+}
+
+template <typename TKey, typename TValue>
+const TValue* LruCache<TKey, TValue>::getIfPresent(const TKey& key) {
     typename LruCacheSet::const_iterator find_result = findByKey(key);
     if (find_result == mSet->end()) {
-        return mNullValue;
+        return nullptr;
     }
     // All the elements in the set are of type Entry. See comment in the definition
     // of LruCacheSet above.
     Entry *entry = reinterpret_cast<Entry*>(*find_result);
     detachFromCache(*entry);
     attachToCache(*entry);
-    return entry->value;
+    return &entry->value;
 }
 
 template <typename TKey, typename TValue>
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_UTILS_SHARDED_LRU_CACHE_H
+#define ANDROID_UTILS_SHARDED_LRU_CACHE_H
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+
+#include <utils/LruCache.h>
+#include <utils/Mutex.h>
+
+namespace android {
+
+/**
+ * A thread-safe LruCache split into independently locked shards, so that
+ * lookups of different keys rarely contend on the same lock.
+ *
+ * Keys are assigned to a shard by their hash_type(). Each shard evicts its own
+ * least recently used entries once it goes over its share of the budget, so
+ * the eviction order is only LRU within a shard.
+ *
+ * The budget is in units of the cost function, which defaults to 1 per entry
+ * and can instead return e.g. the size in bytes of the value. It is split evenly
+ * between the shards, so it should be well above the shard count. Values are
+ * returned by copy, since another thread may evict the entry at any time.
+ */
+template <typename TKey, typename TValue>
+class ShardedLruCache {
+public:
+    typedef std::function<size_t(const TKey& key, const TValue& value)> CostFunction;
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t size;
+        size_t cost;
+    };
+
+    explicit ShardedLruCache(size_t maxCost, CostFunction costFunction = nullptr,
+                             size_t shardCount = 8);
+
+    // Called with the lock of the entry's shard held, also for evictions.
+    // Must not call back into the cache.
+    void setOnEntryRemovedListener(OnEntryRemoved<TKey, TValue>* listener);
+
+    // Copies the value into outValue and makes the entry the most recently
+    // used one of its shard. Returns false when the key isn't in the cache.
+    bool get(const TKey& key, TValue* outValue);
+    // Returns false if the key is already in the cache, or if the entry alone
+    // costs more than the budget of a shard.
+    bool put(const TKey& key, const TValue& value);
+    bool remove(const TKey& key);
+    void clear();
+
+    size_t size() const;
+    Stats getStats() const;
+
+private:
+    ShardedLruCache(const ShardedLruCache&) = delete;
+    ShardedLruCache& operator=(const ShardedLruCache&) = delete;
+
+    class Shard final : public OnEntryRemoved<TKey, TValue> {
+    public:
+        Shard() : owner(nullptr), maxCost(0), cost(0), hits(0), misses(0), evictions(0),
+                  cache(LruCache<TKey, TValue>::kUnlimitedCapacity) {
+            cache.setOnEntryRemovedListener(this);
+        }
+
+        void operator()(TKey& key, TValue& value) override {
+            cost -= owner->entryCost(key, value);
+            if (owner->mListener) {
+                (*owner->mListener)(key, value);
+            }
+        }
+
+        mutable Mutex lock;
+        ShardedLruCache* owner;
+        size_t maxCost;
+        size_t cost;
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        // Last, its destructor calls back into the shard.
+        LruCache<TKey, TValue> cache;
+    };
+
+    size_t entryCost(const TKey& key, const TValue& value) const {
+        return mCostFunction ? mCostFunction(key, value) : 1;
+    }
+
+    Shard& shardFor(const TKey& key) const {
+        // Scramble the hash so that the shards don't pick on the same bits as the
+        // buckets of their hash sets, then map it onto [0, mShardCount) without a
+        // division.
+        const uint32_t hash = static_cast<uint32_t>(hash_type(key)) * 0x9e3779b9u;
+        return mShards[(static_cast<uint64_t>(hash) * mShardCount) >> 32];
+    }
+
+    const size_t mShardCount;
+    const CostFunction mCostFunction;
+    OnEntryRemoved<TKey, TValue>* mListener;
+    std::unique_ptr<Shard[]> mShards;
+};
+
+// Implementation is here, because it's fully templated
+template <typename TKey, typename TValue>
+ShardedLruCache<TKey, TValue>::ShardedLruCache(size_t maxCost, CostFunction costFunction,
+                                               size_t shardCount)
+    : mShardCount(shardCount ? shardCount : 1),
+      mCostFunction(costFunction),
+      mListener(nullptr),
+      mShards(new Shard[mShardCount]) {
+    for (size_t i = 0; i < mShardCount; i++) {
+        mShards[i].owner = this;
+        // Hand out the remainder one by one, so that the budgets add up to maxCost.
+        mShards[i].maxCost = maxCost / mShardCount + (i < maxCost % mShardCount ? 1 : 0);
+    }
+}
+
+template <typename TKey, typename TValue>
+void ShardedLruCache<TKey, TValue>::setOnEntryRemovedListener(
+        OnEntryRemoved<TKey, TValue>* listener) {
+    mListener = listener;
+}
+
+template <typename TKey, typename TValue>
+bool ShardedLruCache<TKey, TValue>::get(const TKey& key, TValue* outValue) {
+    Shard& shard = shardFor(key);
+    Mutex::Autolock _l(shard.lock);
+    const TValue* value = shard.cache.getIfPresent(key);
+    if (value == nullptr) {
+        shard.misses++;
+        return false;
+    }
+    shard.hits++;
+    *outValue = *value;
+    return true;
+}
+
+template <typename TKey, typename TValue>
+bool ShardedLruCache<TKey, TValue>::put(const TKey& key, const TValue& value) {
+    const size_t cost = entryCost(key, value);
+    Shard& shard = shardFor(key);
+    if (cost > shard.maxCost) {
+        return false;
+    }
+    Mutex::Autolock _l(shard.lock);
+    if (!shard.cache.put(key, value)) {
+        return false;
+    }
+    shard.cost += cost;
+    while (shard.cost > shard.maxCost) {
+        shard.cache.removeOldest();
+        shard.evictions++;
+    }
+    return true;
+}
+
+template <typename TKey, typename TValue>
+bool ShardedLruCache<TKey, TValue>::remove(const TKey& key) {
+    Shard& shard = shardFor(key);
+    Mutex::Autolock _l(shard.lock);
+    return shard.cache.remove(key);
+}
+
+template <typename TKey, typename TValue>
+void ShardedLruCache<TKey, TValue>::clear() {
+    for (size_t i = 0; i < mShardCount; i++) {
+        Mutex::Autolock _l(mShards[i].lock);
+        mShards[i].cache.clear();
+    }
+}
+
+template <typename TKey, typename TValue>
+size_t ShardedLruCache<TKey, TValue>::size() const {
+    size_t size = 0;
+    for (size_t i = 0; i < mShardCount; i++) {
+        Mutex::Autolock _l(mShards[i].lock);
+        size += mShards[i].cache.size();
+    }
+    return size;
+}
+
+template <typename TKey, typename TValue>
+typename ShardedLruCache<TKey, TValue>::Stats ShardedLruCache<TKey, TValue>::getStats() const {
+    Stats stats = {};
+    for (size_t i = 0; i < mShardCount; i++) {
+        const Shard& shard = mShards[i];
+        Mutex::Autolock _l(shard.lock);
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.evictions += shard.evictions;
+        stats.size += shard.cache.size();
+        stats.cost += shard.cost;
+    }
+    return stats;
+}
+
+}  // namespace android
+
+#endif  // ANDROID_UTILS_SHARDED_LRU_CACHE_H
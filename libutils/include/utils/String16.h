@@ -58,6 +58,8 @@ public:
                                 String16();
     explicit                    String16(StaticLinkage);
                                 String16(const String16& o);
+                                // Takes over the buffer of o, which is left empty.
+                                String16(String16&& o) noexcept;
                                 String16(const String16& o,
                                          size_t len,
                                          size_t begin=0);
@@ -86,6 +88,8 @@ public:
             status_t            append(const char16_t* other, size_t len);
 
     inline  String16&           operator=(const String16& other);
+    // Swaps buffers with other rather than sharing them.
+    inline  String16&           operator=(String16&& other) noexcept;
 
     inline  String16&           operator+=(const String16& other);
     inline  String16            operator+(const String16& other) const;
@@ -268,6 +272,14 @@ inline String16& String16::operator=(const String16& other)
     return *this;
 }
 
+inline String16& String16::operator=(String16&& other) noexcept
+{
+    const char16_t* str = mString;
+    mString = other.mString;
+    other.mString = str;
+    return *this;
+}
+
 inline String16& String16::operator+=(const String16& other)
 {
     append(other);
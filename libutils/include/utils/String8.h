@@ -50,6 +50,8 @@ public:
                                 String8();
     explicit                    String8(StaticLinkage);
                                 String8(const String8& o);
+                                // Takes over the buffer of o, which is left empty.
+                                String8(String8&& o) noexcept;
     explicit                    String8(const char* o);
     explicit                    String8(const char* o, size_t numChars);
 
@@ -96,6 +98,8 @@ public:
             status_t            appendFormatV(const char* fmt, va_list args);
 
     inline  String8&            operator=(const String8& other);
+    // Swaps buffers with other rather than sharing them.
+    inline  String8&            operator=(String8&& other) noexcept;
     inline  String8&            operator=(const char* other);
 
     inline  String8&            operator+=(const String8& other);
@@ -298,6 +302,14 @@ inline String8& String8::operator=(const String8& other)
     return *this;
 }
 
+inline String8& String8::operator=(String8&& other) noexcept
+{
+    const char* str = mString;
+    mString = other.mString;
+    other.mString = str;
+    return *this;
+}
+
 inline String8& String8::operator=(const char* other)
 {
     setTo(other);
@@ -44,6 +44,8 @@ public:
         HAS_TRIVIAL_CTOR    = 0x00000001,
         HAS_TRIVIAL_DTOR    = 0x00000002,
         HAS_TRIVIAL_COPY    = 0x00000004,
+        // The items can be relocated with memmove (see use_trivial_move<>).
+        HAS_TRIVIAL_MOVE    = 0x00000008,
     };
 
                             VectorImpl(size_t itemSize, uint32_t flags);
@@ -116,6 +118,8 @@ private:
         inline void _do_splat(void* dest, const void* item, size_t num) const;
         inline void _do_move_forward(void* dest, const void* from, size_t num) const;
         inline void _do_move_backward(void* dest, const void* from, size_t num) const;
+        // Whether the storage can go through SharedBuffer::editResize().
+        bool  _can_resize_in_place() const;
 
             // These 2 fields are exposed in the inlines below,
             // so they're set in stone.
@@ -25,6 +25,10 @@
 #include <unistd.h>
 
 #include <initializer_list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
 
 __attribute__((weak)) extern "C" android_namespace_t* android_get_exported_namespace(const char*);
 __attribute__((weak)) extern "C" void* android_dlopen_ext(const char*, int,
@@ -37,8 +41,24 @@ struct VendorNamespace {
     const char* name = nullptr;
 };
 
+// SP-HAL loaders open the same libraries over and over, so the handles are kept
+// here with a count of the loads that haven't been unloaded yet. The library is
+// dlclose()d once, when that count drops to zero. The lock is recursive as
+// library constructors and destructors may load and unload SP-HALs themselves.
+struct SphalLibraries {
+    std::recursive_mutex lock;
+    std::map<std::pair<std::string, int>, void*> handles;
+    std::map<void*, int> refs;
+};
+
 }  // anonymous namespace
 
+static SphalLibraries& get_sphal_libraries() {
+    // Never destroyed, libraries may be unloaded from other libraries' destructors.
+    static SphalLibraries* libraries = new SphalLibraries;
+    return *libraries;
+}
+
 static VendorNamespace get_vendor_namespace() {
     static VendorNamespace result = ([] {
         for (const char* name : {"sphal", "default"}) {
@@ -65,11 +85,12 @@ int android_is_in_vendor_process() {
     }
 
     // In vendor process, 'vndk' namespace is not visible, whereas in system
-    // process, it is.
-    return android_get_exported_namespace("vndk") == nullptr;
+    // process, it is. That can't change once the process is running.
+    static int result = android_get_exported_namespace("vndk") == nullptr;
+    return result;
 }
 
-void* android_load_sphal_library(const char* name, int flag) {
+static void* load_sphal_library(const char* name, int flag) {
     VendorNamespace vendor_namespace = get_vendor_namespace();
     if (vendor_namespace.ptr != nullptr) {
         const android_dlextinfo dlextinfo = {
@@ -91,6 +112,44 @@ void* android_load_sphal_library(const char* name, int flag) {
     }
 }
 
+void* android_load_sphal_library(const char* name, int flag) {
+    SphalLibraries& libraries = get_sphal_libraries();
+    std::lock_guard<std::recursive_mutex> lock(libraries.lock);
+
+    auto key = std::make_pair(std::string(name), flag);
+    if (auto it = libraries.handles.find(key); it != libraries.handles.end()) {
+        libraries.refs[it->second]++;
+        return it->second;
+    }
+
+    void* handle = load_sphal_library(name, flag);
+    if (handle == nullptr) {
+        return nullptr;
+    }
+    // The same library may already be loaded under another name or flags, the
+    // linker returns the same handle then. Only one reference is kept.
+    if (auto [it, inserted] = libraries.refs.emplace(handle, 1); !inserted) {
+        it->second++;
+        dlclose(handle);
+    }
+    libraries.handles.emplace(std::move(key), handle);
+    return handle;
+}
+
 int android_unload_sphal_library(void* handle) {
+    SphalLibraries& libraries = get_sphal_libraries();
+    std::lock_guard<std::recursive_mutex> lock(libraries.lock);
+
+    auto it = libraries.refs.find(handle);
+    if (it == libraries.refs.end()) {
+        return dlclose(handle);
+    }
+    if (--it->second > 0) {
+        return 0;
+    }
+    libraries.refs.erase(it);
+    for (auto h = libraries.handles.begin(); h != libraries.handles.end();) {
+        h = h->second == handle ? libraries.handles.erase(h) : std::next(h);
+    }
     return dlclose(handle);
 }
@@ -53,3 +53,15 @@ TEST(linker, load_nonexisting_lib) {
     void* handle = android_load_sphal_library("libNeverUseThisName.so", RTLD_NOW | RTLD_LOCAL);
     ASSERT_EQ(nullptr, handle);
 }
+
+TEST(linker, load_same_lib_twice) {
+    std::string name = find_sphal_lib();
+    ASSERT_NE("", name);
+    void* handle = android_load_sphal_library(name.c_str(), RTLD_NOW | RTLD_LOCAL);
+    ASSERT_NE(nullptr, handle);
+    void* handle2 = android_load_sphal_library(name.c_str(), RTLD_NOW | RTLD_LOCAL);
+    ASSERT_EQ(handle, handle2);
+
+    ASSERT_EQ(0, android_unload_sphal_library(handle2));
+    ASSERT_EQ(0, android_unload_sphal_library(handle));
+}
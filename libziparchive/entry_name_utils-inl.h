@@ -19,6 +19,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <limits>
 
@@ -29,7 +30,19 @@ inline bool IsValidEntryName(const uint8_t* entry_name, const size_t length) {
   if (length > std::numeric_limits<uint16_t>::max()) {
     return false;
   }
-  for (size_t i = 0; i < length; ++i) {
+  size_t i = 0;
+  // Names are nearly always ASCII, check those 8 bytes at a time: the high bit
+  // of a byte is set either by the byte itself (non-ASCII), or by subtracting 1
+  // from it (NUL).
+  static constexpr uint64_t kOnes = 0x0101010101010101ULL;
+  for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, entry_name + i, sizeof(word));
+    if (((word | (word - kOnes)) & (kOnes << 7)) != 0) {
+      break;
+    }
+  }
+  for (; i < length; ++i) {
     const uint8_t byte = entry_name[i];
     if (byte == 0) {
       return false;
@@ -16,6 +16,8 @@
 
 #include "entry_name_utils-inl.h"
 
+#include <string>
+
 #include <gtest/gtest.h>
 
 TEST(entry_name_utils, NullChars) {
@@ -60,3 +62,24 @@ TEST(entry_name_utils, BadContinuation) {
   const uint8_t bad2[] = {0xc2, 0xa1, 0xc2, 0xfe};
   ASSERT_FALSE(IsValidEntryName(bad2, sizeof(bad2)));
 }
+
+TEST(entry_name_utils, LongNames) {
+  // Long enough to go through the word at a time ASCII check.
+  std::string name = "res/drawable-xxhdpi-v4/icon.png";
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(name.data());
+  ASSERT_TRUE(IsValidEntryName(bytes, name.size()));
+
+  for (size_t i = 0; i < name.size(); ++i) {
+    std::string with_nul = name;
+    with_nul[i] = '\0';
+    ASSERT_FALSE(IsValidEntryName(reinterpret_cast<const uint8_t*>(with_nul.data()),
+                                  with_nul.size()))
+        << "NUL at " << i;
+  }
+
+  // A valid 2 byte sequence straddling the first word, and an invalid one.
+  std::string utf8 = "res/raw\xc2\xa1.bin";
+  ASSERT_TRUE(IsValidEntryName(reinterpret_cast<const uint8_t*>(utf8.data()), utf8.size()));
+  std::string bad = "res/raw\xc2\x41.bin";
+  ASSERT_FALSE(IsValidEntryName(reinterpret_cast<const uint8_t*>(bad.data()), bad.size()));
+}
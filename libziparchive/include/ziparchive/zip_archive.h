@@ -114,6 +114,43 @@ int32_t OpenArchive(const char* fileName, ZipArchiveHandle* handle);
 int32_t OpenArchiveFd(const int fd, const char* debugFileName, ZipArchiveHandle* handle,
                       bool assume_ownership = true);
 
+/*
+ * Like OpenArchive and OpenArchiveFd, but only verify the central directory
+ * when opening. The first few calls to FindEntry scan the central directory,
+ * and the table of entries is only built after that, or by StartIteration.
+ * This makes opening large archives that are only looked up a few times
+ * cheaper. Errors that are only found while building the table, like
+ * kDuplicateEntry, are returned by those calls instead.
+ */
+int32_t OpenArchiveLazy(const char* fileName, ZipArchiveHandle* handle);
+int32_t OpenArchiveFdLazy(const int fd, const char* debugFileName, ZipArchiveHandle* handle,
+                          bool assume_ownership = true);
+
+/*
+ * Like OpenArchiveFd, but uses the table of entries stored in "index_fd" by
+ * WriteArchiveIndex, instead of scanning the central directory again. The
+ * index is mapped read-only, so processes opening the same archive share it.
+ *
+ * An index that is missing (negative "index_fd"), stale or corrupt is ignored,
+ * and the archive is scanned as usual. The index must be stored somewhere only
+ * trusted code can write to, since the entries it holds aren't checked again.
+ * The caller keeps ownership of "index_fd", which can be closed after this
+ * returns.
+ *
+ * Returns 0 on success, and negative values on failure.
+ */
+int32_t OpenArchiveFdWithIndex(const int fd, const int index_fd, const char* debugFileName,
+                               ZipArchiveHandle* handle, bool assume_ownership = true);
+
+/*
+ * Writes the table of entries of the archive to "fd", for OpenArchiveFdWithIndex.
+ * The index is tied to the file of the archive, and is ignored once the file
+ * is replaced or written to.
+ *
+ * Returns 0 on success, and negative values on failure.
+ */
+int32_t WriteArchiveIndex(const ZipArchiveHandle archive, int fd);
+
 int32_t OpenArchiveFromMemory(void* address, size_t length, const char* debugFileName,
                               ZipArchiveHandle* handle);
 /*
@@ -185,6 +222,19 @@ void EndIteration(void* cookie);
  */
 int32_t ExtractEntryToFile(ZipArchiveHandle archive, ZipEntry* entry, int fd);
 
+/*
+ * Like ExtractEntryToFile, for |count| entries at once: |entries[i]| is
+ * written to |fds[i]|. The entries are extracted on up to |num_threads|
+ * threads, including the calling one, so each entry must go to a different
+ * file.
+ *
+ * Once an entry fails, no more entries are started. Returns 0 when all of them
+ * were extracted, and otherwise the error of the first one that failed, in the
+ * order of |entries|.
+ */
+int32_t ExtractEntriesToFiles(ZipArchiveHandle archive, ZipEntry* entries, const int* fds,
+                              size_t count, size_t num_threads);
+
 /**
  * Uncompress a given zip entry to the memory region at |begin| and of
  * size |size|. This size is expected to be the same as the *declared*
@@ -195,6 +245,23 @@ int32_t ExtractEntryToFile(ZipArchiveHandle archive, ZipEntry* entry, int fd);
  */
 int32_t ExtractToMemory(ZipArchiveHandle archive, ZipEntry* entry, uint8_t* begin, uint32_t size);
 
+/*
+ * Sets |data| and |length| to the contents of a stored (uncompressed) entry,
+ * in place in the memory of an archive opened with OpenArchiveFromMemory, so
+ * that they can be used without a copy. The view is valid as long as that
+ * memory is. Archives opened from a file return kInvalidHandle: callers can
+ * map |entry->offset| of GetFileDescriptor() themselves.
+ *
+ * If |advice| isn't 0, it's passed to madvise() for the pages of the entry,
+ * e.g. MADV_WILLNEED or MADV_SEQUENTIAL. The memory must then be a mapping
+ * that the advice is safe for. Failures to advise are not an error.
+ *
+ * Returns 0 on success, kEntryNotStored for compressed entries, and other
+ * negative values on failure.
+ */
+int32_t GetStoredEntryData(ZipArchiveHandle archive, ZipEntry* entry, const uint8_t** data,
+                           uint32_t* length, int advice = 0);
+
 int GetFileDescriptor(const ZipArchiveHandle archive);
 
 const char* ErrorCodeString(int32_t error_code);
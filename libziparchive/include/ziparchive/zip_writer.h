@@ -91,6 +91,18 @@ class ZipWriter {
    */
   explicit ZipWriter(FILE* f);
 
+  /**
+   * Like ZipWriter(FILE*), but entries are deflated on |compression_threads| threads,
+   * while the calling thread goes on to the next entry. The data of each entry is kept in
+   * memory until the entry is written, which happens in the order the entries were
+   * started in, so the output is laid out as it would be without threads.
+   *
+   * Errors of an entry are returned by a later call, at the latest by Finish().
+   */
+  ZipWriter(FILE* f, size_t compression_threads);
+
+  ~ZipWriter();
+
   // Move constructor.
   ZipWriter(ZipWriter&& zipWriter) noexcept;
 
@@ -161,7 +173,12 @@ class ZipWriter {
  private:
   DISALLOW_COPY_AND_ASSIGN(ZipWriter);
 
+  class ParallelDeflater;
+
   int32_t HandleError(int32_t error_code);
+  int32_t WriteLocalFileHeader(FileEntry* file, uint32_t alignment, bool use_data_descriptor);
+  int32_t WriteDataDescriptor(const FileEntry& file);
+  int32_t WritePendingEntries(bool wait_for_all);
   int32_t PrepareDeflate();
   int32_t StoreBytes(FileEntry* file, const void* data, uint32_t len);
   int32_t CompressBytes(FileEntry* file, const void* data, uint32_t len);
@@ -181,9 +198,14 @@ class ZipWriter {
   State state_;
   std::vector<FileEntry> files_;
   FileEntry current_file_entry_;
+  uint32_t current_alignment_;
 
   std::unique_ptr<z_stream, void (*)(z_stream*)> z_stream_;
   std::vector<uint8_t> buffer_;
 
+  // Only set for writers that deflate on compression threads. Then buffer_ holds the
+  // data of the current entry.
+  std::unique_ptr<ParallelDeflater> deflater_;
+
   FRIEND_TEST(zipwriter, WriteToUnseekableFile);
 };
@@ -28,10 +28,15 @@
 #include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #if defined(__APPLE__)
@@ -42,6 +47,10 @@
 #include <android/fdsan.h>
 #endif
 
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/macros.h>  // TEMP_FAILURE_RETRY may or may not be in unistd
@@ -65,6 +74,10 @@ static const bool kCrcChecksEnabled = false;
 // The maximum number of bytes to scan backwards for the EOCD start.
 static const uint32_t kMaxEOCDSearch = kMaxCommentLen + sizeof(EocdRecord);
 
+// The number of lookups into a lazily opened archive that scan the central
+// directory before its hash table gets built.
+static const uint32_t kMaxLinearLookups = 4;
+
 /*
  * A Read-only Zip archive.
  *
@@ -170,7 +183,11 @@ ZipArchive::ZipArchive(const int fd, bool assume_ownership)
       directory_map(),
       num_entries(0),
       hash_table_size(0),
-      hash_table(nullptr) {
+      hash_table(nullptr),
+      hash_table_result(0),
+      lazy_hash_table(false),
+      hash_table_ready(false),
+      linear_lookups(0) {
 #if defined(__BIONIC__)
   if (assume_ownership) {
     android_fdsan_exchange_owner_tag(fd, 0, GetOwnerTag(this));
@@ -186,7 +203,11 @@ ZipArchive::ZipArchive(void* address, size_t length)
       directory_map(),
       num_entries(0),
       hash_table_size(0),
-      hash_table(nullptr) {}
+      hash_table(nullptr),
+      hash_table_result(0),
+      lazy_hash_table(false),
+      hash_table_ready(false),
+      linear_lookups(0) {}
 
 ZipArchive::~ZipArchive() {
   if (close_file && mapped_zip.GetFileDescriptor() >= 0) {
@@ -197,7 +218,10 @@ ZipArchive::~ZipArchive() {
 #endif
   }
 
-  free(hash_table);
+  // A hash table loaded from an index points into index_map.
+  if (!index_map) {
+    free(hash_table);
+  }
 }
 
 static int32_t MapCentralDirectory0(const char* debug_file_name, ZipArchive* archive,
@@ -332,28 +356,112 @@ static int32_t MapCentralDirectory(const char* debug_file_name, ZipArchive* arch
   return result;
 }
 
-/*
- * Parses the Zip archive's Central Directory.  Allocates and populates the
- * hash table.
- *
- * Returns 0 on success.
- */
-static int32_t ParseZipArchive(ZipArchive* archive) {
-  const uint8_t* const cd_ptr = archive->central_directory.GetBasePtr();
-  const size_t cd_length = archive->central_directory.GetMapLength();
-  const uint16_t num_entries = archive->num_entries;
-
+static bool AllocateHashTable(ZipArchive* archive) {
   /*
    * Create hash table.  We have a minimum 75% load factor, possibly as
    * low as 50% after we round off to a power of 2.  There must be at
    * least one unused entry to avoid an infinite loop during creation.
    */
-  archive->hash_table_size = RoundUpPower2(1 + (num_entries * 4) / 3);
+  archive->hash_table_size = RoundUpPower2(1 + (archive->num_entries * 4) / 3);
   archive->hash_table =
       reinterpret_cast<ZipStringOffset*>(calloc(archive->hash_table_size, sizeof(ZipStringOffset)));
   if (archive->hash_table == nullptr) {
     ALOGW("Zip: unable to allocate the %u-entry hash_table, entry size: %zu",
           archive->hash_table_size, sizeof(ZipStringOffset));
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Populates the hash table of an archive whose central directory was already
+ * verified by ParseZipArchive.
+ *
+ * Returns 0 on success.
+ */
+static int32_t BuildHashTable(ZipArchive* archive) {
+  if (!AllocateHashTable(archive)) {
+    return -1;
+  }
+
+  const uint8_t* const cd_ptr = archive->central_directory.GetBasePtr();
+  const uint8_t* ptr = cd_ptr;
+  for (uint16_t i = 0; i < archive->num_entries; i++) {
+    const CentralDirectoryRecord* cdr = reinterpret_cast<const CentralDirectoryRecord*>(ptr);
+    const uint16_t file_name_length = cdr->file_name_length;
+    std::string_view entry_name{reinterpret_cast<const char*>(ptr + sizeof(CentralDirectoryRecord)),
+                                file_name_length};
+    const int add_result = AddToHash(archive->hash_table, archive->hash_table_size, entry_name,
+                                     cd_ptr);
+    if (add_result != 0) {
+      ALOGW("Zip: Error adding entry to hash table %d", add_result);
+      return add_result;
+    }
+    ptr += sizeof(CentralDirectoryRecord) + file_name_length + cdr->extra_field_length +
+           cdr->comment_length;
+  }
+  return 0;
+}
+
+/*
+ * Makes sure the hash table of the archive is populated, and returns the
+ * result of doing so. Archives opened lazily only build it here, on their
+ * first lookup or iteration.
+ */
+static int32_t EnsureHashTable(ZipArchive* archive) {
+  std::call_once(archive->hash_table_once, [archive]() {
+    if (archive->hash_table == nullptr) {
+      archive->hash_table_result = BuildHashTable(archive);
+    }
+    archive->hash_table_ready.store(true, std::memory_order_release);
+  });
+  return archive->hash_table_result;
+}
+
+/*
+ * Looks an entry up by walking the verified central directory, for archives
+ * whose hash table isn't built yet. Like the hash table, this rejects names
+ * that appear more than once.
+ *
+ * Returns 0 on success.
+ */
+static int32_t FindEntryLinear(const ZipArchive* archive, std::string_view name,
+                               ZipStringOffset* entry) {
+  const uint8_t* const cd_ptr = archive->central_directory.GetBasePtr();
+  const uint8_t* ptr = cd_ptr;
+  bool found = false;
+  for (uint16_t i = 0; i < archive->num_entries; i++) {
+    const CentralDirectoryRecord* cdr = reinterpret_cast<const CentralDirectoryRecord*>(ptr);
+    const uint16_t file_name_length = cdr->file_name_length;
+    const uint8_t* file_name = ptr + sizeof(CentralDirectoryRecord);
+    if (file_name_length == name.size() && memcmp(file_name, name.data(), name.size()) == 0) {
+      if (found) {
+        ALOGW("Zip: Found duplicate entry %.*s", static_cast<int>(name.size()), name.data());
+        return kDuplicateEntry;
+      }
+      found = true;
+      entry->name_offset = static_cast<uint32_t>(file_name - cd_ptr);
+      entry->name_length = file_name_length;
+    }
+    ptr = file_name + file_name_length + cdr->extra_field_length + cdr->comment_length;
+  }
+  return found ? 0 : kEntryNotFound;
+}
+
+/*
+ * Parses the Zip archive's Central Directory.  Allocates and populates the
+ * hash table, unless |lazy| is set, in which case only the entries are
+ * verified and EnsureHashTable builds the table later.
+ *
+ * Returns 0 on success.
+ */
+static int32_t ParseZipArchive(ZipArchive* archive, bool lazy) {
+  const uint8_t* const cd_ptr = archive->central_directory.GetBasePtr();
+  const size_t cd_length = archive->central_directory.GetMapLength();
+  const uint16_t num_entries = archive->num_entries;
+
+  archive->lazy_hash_table = lazy;
+  if (!lazy && !AllocateHashTable(archive)) {
     return -1;
   }
 
@@ -403,12 +511,14 @@ static int32_t ParseZipArchive(ZipArchive* archive) {
     }
 
     // Add the CDE filename to the hash table.
-    std::string_view entry_name{reinterpret_cast<const char*>(file_name), file_name_length};
-    const int add_result = AddToHash(archive->hash_table, archive->hash_table_size, entry_name,
-                                     archive->central_directory.GetBasePtr());
-    if (add_result != 0) {
-      ALOGW("Zip: Error adding entry to hash table %d", add_result);
-      return add_result;
+    if (!lazy) {
+      std::string_view entry_name{reinterpret_cast<const char*>(file_name), file_name_length};
+      const int add_result = AddToHash(archive->hash_table, archive->hash_table_size, entry_name,
+                                       archive->central_directory.GetBasePtr());
+      if (add_result != 0) {
+        ALOGW("Zip: Error adding entry to hash table %d", add_result);
+        return add_result;
+      }
     }
 
     ptr += sizeof(CentralDirectoryRecord) + file_name_length + extra_length + comment_length;
@@ -438,13 +548,14 @@ static int32_t ParseZipArchive(ZipArchive* archive) {
   return 0;
 }
 
-static int32_t OpenArchiveInternal(ZipArchive* archive, const char* debug_file_name) {
+static int32_t OpenArchiveInternal(ZipArchive* archive, const char* debug_file_name,
+                                   bool lazy = false) {
   int32_t result = -1;
   if ((result = MapCentralDirectory(debug_file_name, archive)) != 0) {
     return result;
   }
 
-  if ((result = ParseZipArchive(archive))) {
+  if ((result = ParseZipArchive(archive, lazy))) {
     return result;
   }
 
@@ -458,7 +569,165 @@ int32_t OpenArchiveFd(int fd, const char* debug_file_name, ZipArchiveHandle* han
   return OpenArchiveInternal(archive, debug_file_name);
 }
 
-int32_t OpenArchive(const char* fileName, ZipArchiveHandle* handle) {
+int32_t OpenArchiveFdLazy(int fd, const char* debug_file_name, ZipArchiveHandle* handle,
+                          bool assume_ownership) {
+  ZipArchive* archive = new ZipArchive(fd, assume_ownership);
+  *handle = archive;
+  return OpenArchiveInternal(archive, debug_file_name, true);
+}
+
+/*
+ * The header of an archive index, as written by WriteArchiveIndex. It is
+ * followed by the hash_table_size entries of the archive's hash table, in the
+ * native layout, so an index can only be read by the same ABI that wrote it.
+ *
+ * Everything but the magic and version identifies the archive the index was
+ * written for, so a stale index doesn't match the archive any more. Writing to
+ * the file updates its ctime, which can't be set back, so together with the
+ * inode this tells whether the archive changed without reading all of it.
+ */
+struct ArchiveIndexHeader {
+  static constexpr uint32_t kMagic = 0x5844495a;  // "ZIDX"
+  static constexpr uint32_t kVersion = 1;
+
+  uint32_t magic;
+  uint32_t version;
+  uint64_t device;
+  uint64_t inode;
+  uint64_t file_length;
+  int64_t mtime;
+  int64_t ctime;
+  uint64_t directory_offset;
+  uint32_t directory_size;
+  uint32_t num_entries;
+  uint32_t hash_table_size;
+  uint32_t reserved;
+};
+static_assert(sizeof(ArchiveIndexHeader) == 72, "ArchiveIndexHeader has padding");
+
+static bool GetArchiveIndexHeader(const ZipArchive* archive, ArchiveIndexHeader* header) {
+  struct stat sb;
+  if (fstat(archive->mapped_zip.GetFileDescriptor(), &sb) == -1) {
+    ALOGW("Zip: unable to stat archive: %s", strerror(errno));
+    return false;
+  }
+
+  header->magic = ArchiveIndexHeader::kMagic;
+  header->version = ArchiveIndexHeader::kVersion;
+  header->device = sb.st_dev;
+  header->inode = sb.st_ino;
+  header->file_length = sb.st_size;
+  header->mtime = sb.st_mtime;
+  header->ctime = sb.st_ctime;
+  header->directory_offset = archive->directory_offset;
+  header->directory_size = static_cast<uint32_t>(archive->central_directory.GetMapLength());
+  header->num_entries = archive->num_entries;
+  header->hash_table_size = RoundUpPower2(1 + (archive->num_entries * 4) / 3);
+  header->reserved = 0;
+  return true;
+}
+
+/*
+ * Maps the hash table of the archive from |index_fd|, if the index was written
+ * for this archive.
+ *
+ * A matching header means the central directory is the one that was verified
+ * when the index was written, so it isn't verified again. The index itself
+ * must come from somewhere only trusted code can write to, but it is still
+ * checked to not point lookups outside of the central directory.
+ */
+static bool LoadArchiveIndex(ZipArchive* archive, int index_fd) {
+  ArchiveIndexHeader expected;
+  if (!GetArchiveIndexHeader(archive, &expected)) {
+    return false;
+  }
+
+  struct stat sb;
+  const size_t index_length =
+      sizeof(ArchiveIndexHeader) + expected.hash_table_size * sizeof(ZipStringOffset);
+  if (fstat(index_fd, &sb) == -1 || static_cast<uint64_t>(sb.st_size) != index_length) {
+    ALOGV("Zip: index has the wrong size");
+    return false;
+  }
+
+  std::unique_ptr<android::base::MappedFile> index_map =
+      android::base::MappedFile::FromFd(index_fd, 0, index_length, PROT_READ);
+  if (!index_map) {
+    ALOGW("Zip: unable to map index: %s", strerror(errno));
+    return false;
+  }
+  if (memcmp(index_map->data(), &expected, sizeof(expected)) != 0) {
+    ALOGV("Zip: index is for a different archive");
+    return false;
+  }
+
+  ZipStringOffset* hash_table =
+      reinterpret_cast<ZipStringOffset*>(index_map->data() + sizeof(ArchiveIndexHeader));
+  const size_t cd_length = archive->central_directory.GetMapLength();
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < expected.hash_table_size; i++) {
+    if (hash_table[i].name_offset == 0) {
+      continue;
+    }
+    if (hash_table[i].name_offset < sizeof(CentralDirectoryRecord) ||
+        hash_table[i].name_offset + hash_table[i].name_length > cd_length) {
+      ALOGW("Zip: index entry %" PRIu32 " is out of bounds", i);
+      return false;
+    }
+    count++;
+  }
+  if (count != expected.num_entries) {
+    ALOGW("Zip: index has %" PRIu32 " entries, expected %" PRIu32, count, expected.num_entries);
+    return false;
+  }
+
+  archive->hash_table_size = expected.hash_table_size;
+  archive->hash_table = hash_table;
+  archive->index_map = std::move(index_map);
+  return true;
+}
+
+int32_t OpenArchiveFdWithIndex(int fd, int index_fd, const char* debug_file_name,
+                               ZipArchiveHandle* handle, bool assume_ownership) {
+  ZipArchive* archive = new ZipArchive(fd, assume_ownership);
+  *handle = archive;
+
+  int32_t result = MapCentralDirectory(debug_file_name, archive);
+  if (result != 0) {
+    return result;
+  }
+
+  if (index_fd >= 0 && LoadArchiveIndex(archive, index_fd)) {
+    return 0;
+  }
+  return ParseZipArchive(archive, false);
+}
+
+int32_t WriteArchiveIndex(const ZipArchiveHandle archive, int fd) {
+  if (!archive->mapped_zip.HasFd()) {
+    ALOGW("Zip: archives opened from memory can't be indexed");
+    return kInvalidHandle;
+  }
+
+  int32_t result = EnsureHashTable(archive);
+  if (result != 0) {
+    return result;
+  }
+
+  ArchiveIndexHeader header;
+  if (!GetArchiveIndexHeader(archive, &header)) {
+    return kIoError;
+  }
+  if (!android::base::WriteFully(fd, &header, sizeof(header)) ||
+      !android::base::WriteFully(fd, archive->hash_table,
+                                 archive->hash_table_size * sizeof(ZipStringOffset))) {
+    ALOGW("Zip: unable to write index: %s", strerror(errno));
+    return kIoError;
+  }
+  return 0;
+}
+
+static int32_t OpenArchivePath(const char* fileName, ZipArchiveHandle* handle, bool lazy) {
   const int fd = ::android::base::utf8::open(fileName, O_RDONLY | O_BINARY | O_CLOEXEC, 0);
   ZipArchive* archive = new ZipArchive(fd, true);
   *handle = archive;
@@ -468,7 +737,15 @@ int32_t OpenArchive(const char* fileName, ZipArchiveHandle* handle) {
     return kIoError;
   }
 
-  return OpenArchiveInternal(archive, fileName);
+  return OpenArchiveInternal(archive, fileName, lazy);
+}
+
+int32_t OpenArchive(const char* fileName, ZipArchiveHandle* handle) {
+  return OpenArchivePath(fileName, handle, false);
+}
+
+int32_t OpenArchiveLazy(const char* fileName, ZipArchiveHandle* handle) {
+  return OpenArchivePath(fileName, handle, true);
 }
 
 int32_t OpenArchiveFromMemory(void* address, size_t length, const char* debug_file_name,
@@ -518,14 +795,15 @@ static int32_t ValidateDataDescriptor(MappedZipFile& mapped_zip, ZipEntry* entry
   return 0;
 }
 
-static int32_t FindEntry(const ZipArchive* archive, const int32_t ent, ZipEntry* data) {
-  const uint16_t nameLen = archive->hash_table[ent].name_length;
+static int32_t FindEntry(const ZipArchive* archive, const ZipStringOffset& entry,
+                         ZipEntry* data) {
+  const uint16_t nameLen = entry.name_length;
 
   // Recover the start of the central directory entry from the filename
   // pointer.  The filename is the first entry past the fixed-size data,
   // so we can just subtract back from that.
   const uint8_t* base_ptr = archive->central_directory.GetBasePtr();
-  const uint8_t* ptr = base_ptr + archive->hash_table[ent].name_offset;
+  const uint8_t* ptr = base_ptr + entry.name_offset;
   ptr -= sizeof(CentralDirectoryRecord);
 
   // This is the base of our mmapped region, we have to sanity check that
@@ -636,8 +914,7 @@ static int32_t FindEntry(const ZipArchive* archive, const int32_t ent, ZipEntry*
     ALOGW("Zip: failed reading lfh name from offset %" PRId64, static_cast<int64_t>(name_offset));
     return kIoError;
   }
-  const std::string_view entry_name =
-      archive->hash_table[ent].ToStringView(archive->central_directory.GetBasePtr());
+  const std::string_view entry_name = entry.ToStringView(archive->central_directory.GetBasePtr());
   if (memcmp(entry_name.data(), name_buf.data(), nameLen) != 0) {
     ALOGW("Zip: lfh name did not match central directory");
     return kInconsistentInformation;
@@ -684,7 +961,16 @@ struct IterationHandle {
 int32_t StartIteration(ZipArchiveHandle archive, void** cookie_ptr,
                        const std::string_view optional_prefix,
                        const std::string_view optional_suffix) {
-  if (archive == NULL || archive->hash_table == NULL) {
+  if (archive == NULL) {
+    ALOGW("Zip: Invalid ZipArchiveHandle");
+    return kInvalidHandle;
+  }
+
+  const int32_t result = EnsureHashTable(archive);
+  if (result != 0) {
+    return result;
+  }
+  if (archive->hash_table == NULL) {
     ALOGW("Zip: Invalid ZipArchiveHandle");
     return kInvalidHandle;
   }
@@ -710,6 +996,24 @@ int32_t FindEntry(const ZipArchiveHandle archive, const std::string_view entryNa
     return kInvalidEntryName;
   }
 
+  // The first few lookups into a lazily opened archive scan the central
+  // directory, which is much cheaper than hashing every name in it.
+  if (archive->lazy_hash_table && !archive->hash_table_ready.load(std::memory_order_acquire) &&
+      archive->linear_lookups.fetch_add(1, std::memory_order_relaxed) < kMaxLinearLookups) {
+    ZipStringOffset entry;
+    const int32_t result = FindEntryLinear(archive, entryName, &entry);
+    if (result != 0) {
+      ALOGV("Zip: Could not find entry %.*s", static_cast<int>(entryName.size()), entryName.data());
+      return result;
+    }
+    return FindEntry(archive, entry, data);
+  }
+
+  const int32_t result = EnsureHashTable(archive);
+  if (result != 0) {
+    return result;
+  }
+
   const int64_t ent = EntryToIndex(archive->hash_table, archive->hash_table_size, entryName,
                                    archive->central_directory.GetBasePtr());
   if (ent < 0) {
@@ -717,7 +1021,7 @@ int32_t FindEntry(const ZipArchiveHandle archive, const std::string_view entryNa
     return static_cast<int32_t>(ent);  // kEntryNotFound is safe to truncate.
   }
   // We know there are at most hash_table_size entries, safe to truncate.
-  return FindEntry(archive, static_cast<uint32_t>(ent), data);
+  return FindEntry(archive, archive->hash_table[ent], data);
 }
 
 int32_t Next(void* cookie, ZipEntry* data, std::string* name) {
@@ -751,7 +1055,7 @@ int32_t Next(void* cookie, ZipEntry* data, std::string_view* name) {
     if (hash_table[i].name_offset != 0 && (android::base::StartsWith(entry_name, handle->prefix) &&
                                            android::base::EndsWith(entry_name, handle->suffix))) {
       handle->position = (i + 1);
-      const int error = FindEntry(archive, i, data);
+      const int error = FindEntry(archive, hash_table[i], data);
       if (!error && name) {
         *name = entry_name;
       }
@@ -1089,9 +1393,138 @@ int32_t ExtractToWriter(ZipArchiveHandle archive, ZipEntry* entry, zip_archive::
   return return_value;
 }
 
+// Inflates a whole entry straight into |begin|. With all of the input and
+// the output at hand, a single inflate call decodes the stream, mostly in
+// inflate_fast, without copying the output through a buffer and the window.
+static int32_t InflateEntryToMemory(const MappedZipFile& mapped_zip, const ZipEntry* entry,
+                                    uint8_t* begin, uint32_t size, uint64_t* crc_out) {
+  const uint32_t compressed_length = entry->compressed_length;
+  std::unique_ptr<android::base::MappedFile> input_map;
+  std::vector<uint8_t> input_buf;
+  const uint8_t* input = nullptr;
+  if (!mapped_zip.HasFd()) {
+    if (entry->offset < 0 || entry->offset + compressed_length > mapped_zip.GetFileLength()) {
+      ALOGW("Zip: invalid entry range %" PRId64 " + %" PRIu32, static_cast<int64_t>(entry->offset),
+            compressed_length);
+      return kIoError;
+    }
+    input = static_cast<const uint8_t*>(mapped_zip.GetBasePtr()) + entry->offset;
+  } else {
+    input_map = android::base::MappedFile::FromFd(mapped_zip.GetFileDescriptor(), entry->offset,
+                                                  compressed_length, PROT_READ);
+    if (input_map) {
+      // All of the input is about to be read, once: have it read in ahead of inflate.
+      input_map->Advise(MADV_WILLNEED);
+      input = reinterpret_cast<const uint8_t*>(input_map->data());
+    } else {
+      input_buf.resize(compressed_length);
+      if (!mapped_zip.ReadAtOffset(input_buf.data(), compressed_length, entry->offset)) {
+        return kIoError;
+      }
+      input = input_buf.data();
+    }
+  }
+
+  z_stream zstream = {};
+  int zerr = zlib_inflateInit2(&zstream, -MAX_WBITS);
+  if (zerr != Z_OK) {
+    ALOGW("Call to inflateInit2 failed (zerr=%d)", zerr);
+    return kZlibError;
+  }
+  zstream.next_in = const_cast<uint8_t*>(input);
+  zstream.avail_in = compressed_length;
+  zstream.next_out = begin;
+  zstream.avail_out = size;
+  zerr = inflate(&zstream, Z_FINISH);
+  const uLong total_out = zstream.total_out;
+  inflateEnd(&zstream);
+
+  if (zerr != Z_STREAM_END) {
+    if (zstream.avail_out == 0) {
+      ALOGW("Zip: Unexpected size %" PRIu32 " (declared) vs more (actual)", size);
+      return kIoError;
+    }
+    ALOGW("Zip: inflate zerr=%d (aIn=%u aOut=%u)", zerr, zstream.avail_in, zstream.avail_out);
+    return kZlibError;
+  }
+  if (total_out != entry->uncompressed_length) {
+    ALOGW("Zip: size mismatch on inflated file (%lu vs %" PRIu32 ")", total_out,
+          entry->uncompressed_length);
+    return kInconsistentInformation;
+  }
+
+  if (crc_out != nullptr) {
+    *crc_out = crc32(0, begin, entry->uncompressed_length);
+  }
+  return 0;
+}
+
 int32_t ExtractToMemory(ZipArchiveHandle archive, ZipEntry* entry, uint8_t* begin, uint32_t size) {
-  MemoryWriter writer(begin, size);
-  return ExtractToWriter(archive, entry, &writer);
+  if (entry->method != kCompressDeflated) {
+    MemoryWriter writer(begin, size);
+    return ExtractToWriter(archive, entry, &writer);
+  }
+
+  // Unlike streaming to a Writer, the CRC is only computed when it's checked.
+  uint64_t crc = 0;
+  int32_t result = InflateEntryToMemory(archive->mapped_zip, entry, begin, size,
+                                        kCrcChecksEnabled ? &crc : nullptr);
+  if (result == 0 && entry->has_data_descriptor) {
+    result = ValidateDataDescriptor(archive->mapped_zip, entry);
+  }
+  if (result == 0 && kCrcChecksEnabled && entry->crc32 != static_cast<uint32_t>(crc)) {
+    ALOGW("Zip: crc mismatch: expected %" PRIu32 ", was %" PRIu64, entry->crc32, crc);
+    return kInconsistentInformation;
+  }
+  return result;
+}
+
+int32_t GetStoredEntryData(ZipArchiveHandle archive, ZipEntry* entry, const uint8_t** data,
+                           uint32_t* length, int advice) {
+  const MappedZipFile& mapped_zip = archive->mapped_zip;
+  if (mapped_zip.HasFd()) {
+    ALOGW("Zip: stored entries can only be accessed in place in archives opened from memory");
+    return kInvalidHandle;
+  }
+  if (entry->method != kCompressStored) {
+    return kEntryNotStored;
+  }
+  if (entry->compressed_length != entry->uncompressed_length) {
+    ALOGW("Zip: stored entry has different lengths (%" PRIu32 " vs %" PRIu32 ")",
+          entry->compressed_length, entry->uncompressed_length);
+    return kInconsistentInformation;
+  }
+  if (entry->offset < 0 ||
+      entry->offset + entry->uncompressed_length > mapped_zip.GetFileLength()) {
+    ALOGW("Zip: invalid entry range %" PRId64 " + %" PRIu32, static_cast<int64_t>(entry->offset),
+          entry->uncompressed_length);
+    return kInvalidOffset;
+  }
+  if (entry->has_data_descriptor) {
+    int32_t result = ValidateDataDescriptor(archive->mapped_zip, entry);
+    if (result != 0) {
+      return result;
+    }
+  }
+
+  const uint8_t* begin = static_cast<const uint8_t*>(mapped_zip.GetBasePtr()) + entry->offset;
+#if !defined(_WIN32)
+  if (advice != 0 && entry->uncompressed_length != 0) {
+    // madvise works on whole pages.
+    const uintptr_t page_size = sysconf(_SC_PAGE_SIZE);
+    const uintptr_t start = reinterpret_cast<uintptr_t>(begin) & ~(page_size - 1);
+    const uintptr_t end = reinterpret_cast<uintptr_t>(begin) + entry->uncompressed_length;
+    if (madvise(reinterpret_cast<void*>(start), end - start, advice) == -1) {
+      ALOGW("Zip: madvise(%d) failed: %s", advice, strerror(errno));
+    }
+  }
+#else
+  UNUSED(advice);
+#endif
+
+  *data = begin;
+  *length = entry->uncompressed_length;
+  return 0;
 }
 
 int32_t ExtractEntryToFile(ZipArchiveHandle archive, ZipEntry* entry, int fd) {
@@ -1103,6 +1536,42 @@ int32_t ExtractEntryToFile(ZipArchiveHandle archive, ZipEntry* entry, int fd) {
   return ExtractToWriter(archive, entry, &writer);
 }
 
+int32_t ExtractEntriesToFiles(ZipArchiveHandle archive, ZipEntry* entries, const int* fds,
+                              size_t count, size_t num_threads) {
+  // Reads go through ReadAtOffset and each entry has its own writer, so the
+  // entries can be extracted concurrently. Threads take the next entry until
+  // there are none left, or one of them failed.
+  std::vector<int32_t> results(count, 0);
+  std::atomic<size_t> next_entry(0);
+  std::atomic<bool> failed(false);
+  auto extract = [&]() {
+    size_t i;
+    while (!failed.load(std::memory_order_relaxed) &&
+           (i = next_entry.fetch_add(1, std::memory_order_relaxed)) < count) {
+      results[i] = ExtractEntryToFile(archive, &entries[i], fds[i]);
+      if (results[i] != 0) {
+        failed.store(true, std::memory_order_relaxed);
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < std::min(num_threads, count); i++) {
+    threads.emplace_back(extract);
+  }
+  extract();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  for (int32_t result : results) {
+    if (result != 0) {
+      return result;
+    }
+  }
+  return 0;
+}
+
 const char* ErrorCodeString(int32_t error_code) {
   // Make sure that the number of entries in kErrorMessages and ErrorCodes
   // match.
@@ -1205,6 +1674,8 @@ bool ZipArchive::InitializeCentralDirectory(off64_t cd_start_offset, size_t cd_s
     if (!directory_map) return false;
 
     CHECK_EQ(directory_map->size(), cd_size);
+    // Opening the archive walks all of the central directory straight away.
+    directory_map->Advise(MADV_WILLNEED);
     central_directory.Initialize(directory_map->data(), 0 /*offset*/, cd_size);
   } else {
     if (mapped_zip.GetBasePtr() == nullptr) {
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <fcntl.h>
+
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -23,6 +25,7 @@
 #include <vector>
 
 #include <android-base/test_utils.h>
+#include <android-base/unique_fd.h>
 #include <benchmark/benchmark.h>
 #include <ziparchive/zip_archive.h>
 #include <ziparchive/zip_archive_stream_entry.h>
@@ -47,6 +50,91 @@ static TemporaryFile* CreateZip() {
   return result;
 }
 
+// An archive shaped like a resource-heavy APK: a manifest, a dex file and
+// lots of small resources.
+static TemporaryFile* CreateApkLikeZip(size_t num_resources) {
+  TemporaryFile* result = new TemporaryFile;
+  FILE* fp = fdopen(result->fd, "w");
+
+  ZipWriter writer(fp);
+  for (const char* name : {"AndroidManifest.xml", "classes.dex"}) {
+    writer.StartEntry(name, 0);
+    writer.WriteBytes("helo", 4);
+    writer.FinishEntry();
+  }
+  for (size_t i = 0; i < num_resources; i++) {
+    writer.StartEntry("res/drawable-xxhdpi-v4/icon_" + std::to_string(i) + ".png", 0);
+    writer.WriteBytes("helo", 4);
+    writer.FinishEntry();
+  }
+  writer.Finish();
+  fclose(fp);
+
+  return result;
+}
+
+static void OpenArchive_find_single(benchmark::State& state) {
+  std::unique_ptr<TemporaryFile> temp_file(CreateApkLikeZip(state.range(0)));
+  ZipArchiveHandle handle;
+  ZipEntry data;
+
+  for (auto _ : state) {
+    OpenArchive(temp_file->path, &handle);
+    FindEntry(handle, "AndroidManifest.xml", &data);
+    CloseArchive(handle);
+  }
+}
+BENCHMARK(OpenArchive_find_single)->Arg(1000)->Arg(50000);
+
+static void OpenArchiveLazy_find_single(benchmark::State& state) {
+  std::unique_ptr<TemporaryFile> temp_file(CreateApkLikeZip(state.range(0)));
+  ZipArchiveHandle handle;
+  ZipEntry data;
+
+  for (auto _ : state) {
+    OpenArchiveLazy(temp_file->path, &handle);
+    FindEntry(handle, "AndroidManifest.xml", &data);
+    CloseArchive(handle);
+  }
+}
+BENCHMARK(OpenArchiveLazy_find_single)->Arg(1000)->Arg(50000);
+
+static void OpenArchiveLazy_find_many(benchmark::State& state) {
+  std::unique_ptr<TemporaryFile> temp_file(CreateApkLikeZip(state.range(0)));
+  ZipArchiveHandle handle;
+  ZipEntry data;
+
+  // Goes past the lookups that scan the central directory, to show what building
+  // the hash table on demand costs.
+  for (auto _ : state) {
+    OpenArchiveLazy(temp_file->path, &handle);
+    for (int i = 0; i < 16; i++) {
+      FindEntry(handle, "AndroidManifest.xml", &data);
+    }
+    CloseArchive(handle);
+  }
+}
+BENCHMARK(OpenArchiveLazy_find_many)->Arg(1000)->Arg(50000);
+
+static void OpenArchiveFdWithIndex_find_single(benchmark::State& state) {
+  std::unique_ptr<TemporaryFile> temp_file(CreateApkLikeZip(state.range(0)));
+  TemporaryFile index_file;
+  ZipArchiveHandle handle;
+  ZipEntry data;
+
+  OpenArchive(temp_file->path, &handle);
+  WriteArchiveIndex(handle, index_file.fd);
+  CloseArchive(handle);
+
+  android::base::unique_fd fd(open(temp_file->path, O_RDONLY));
+  for (auto _ : state) {
+    OpenArchiveFdWithIndex(fd, index_file.fd, temp_file->path, &handle, false);
+    FindEntry(handle, "AndroidManifest.xml", &data);
+    CloseArchive(handle);
+  }
+}
+BENCHMARK(OpenArchiveFdWithIndex_find_single)->Arg(1000)->Arg(50000);
+
 static void FindEntry_no_match(benchmark::State& state) {
   // Create a temporary zip archive.
   std::unique_ptr<TemporaryFile> temp_file(CreateZip());
@@ -84,6 +172,70 @@ static void Iterate_all_files(benchmark::State& state) {
 }
 BENCHMARK(Iterate_all_files);
 
+// An archive with one deflated entry of |size| bytes, shaped like a dex file:
+// compressible, but not trivially so.
+static TemporaryFile* CreateLargeEntryZip(size_t size) {
+  TemporaryFile* result = new TemporaryFile;
+  FILE* fp = fdopen(result->fd, "w");
+
+  std::vector<uint8_t> data(size);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < size; i++) {
+    seed = seed * 1103515245 + 12345;
+    data[i] = static_cast<uint8_t>((seed >> 16) % 16 + (i % 1024 < 512 ? 'a' : 'A'));
+  }
+  ZipWriter writer(fp);
+  writer.StartEntry("classes.dex", ZipWriter::kCompress);
+  writer.WriteBytes(data.data(), data.size());
+  writer.FinishEntry();
+  writer.Finish();
+  fclose(fp);
+
+  return result;
+}
+
+static void ExtractToMemory_large(benchmark::State& state) {
+  std::unique_ptr<TemporaryFile> temp_file(CreateLargeEntryZip(state.range(0)));
+  ZipArchiveHandle handle;
+  ZipEntry data;
+  OpenArchive(temp_file->path, &handle);
+  FindEntry(handle, "classes.dex", &data);
+  std::vector<uint8_t> buffer(data.uncompressed_length);
+
+  for (auto _ : state) {
+    ExtractToMemory(handle, &data, buffer.data(), buffer.size());
+  }
+  state.SetBytesProcessed(state.iterations() * buffer.size());
+  CloseArchive(handle);
+}
+BENCHMARK(ExtractToMemory_large)->Arg(64 * 1024)->Arg(8 * 1024 * 1024);
+
+// The same through the streaming path, which ExtractToMemory used to take.
+static void ProcessZipEntryContents_large(benchmark::State& state) {
+  std::unique_ptr<TemporaryFile> temp_file(CreateLargeEntryZip(state.range(0)));
+  ZipArchiveHandle handle;
+  ZipEntry data;
+  OpenArchive(temp_file->path, &handle);
+  FindEntry(handle, "classes.dex", &data);
+  std::vector<uint8_t> buffer(data.uncompressed_length);
+
+  for (auto _ : state) {
+    uint8_t* out = buffer.data();
+    ProcessZipEntryContents(
+        handle, &data,
+        [](const uint8_t* buf, size_t buf_size, void* cookie) {
+          uint8_t** out = reinterpret_cast<uint8_t**>(cookie);
+          memcpy(*out, buf, buf_size);
+          *out += buf_size;
+          return true;
+        },
+        &out);
+  }
+  state.SetBytesProcessed(state.iterations() * buffer.size());
+  CloseArchive(handle);
+}
+BENCHMARK(ProcessZipEntryContents_large)->Arg(64 * 1024)->Arg(8 * 1024 * 1024);
+
 static void StartAlignedEntry(benchmark::State& state) {
   TemporaryFile file;
   FILE* fp = fdopen(file.fd, "w");
@@ -106,5 +258,28 @@ static void StartAlignedEntry(benchmark::State& state) {
 }
 BENCHMARK(StartAlignedEntry)->Arg(2)->Arg(16)->Arg(1024)->Arg(4096);
 
+// Compresses 64 entries of 64KiB each, on the given number of compression threads.
+static void WriteCompressedEntries(benchmark::State& state) {
+  std::vector<uint8_t> data(64 * 1024);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<uint8_t>(i * i / 7);
+  }
+
+  for (auto _ : state) {
+    TemporaryFile file;
+    FILE* fp = fdopen(file.fd, "w");
+    ZipWriter writer(fp, state.range(0));
+    for (int i = 0; i < 64; i++) {
+      writer.StartEntry("entry" + std::to_string(i), ZipWriter::kCompress);
+      writer.WriteBytes(data.data(), data.size());
+      writer.FinishEntry();
+    }
+    writer.Finish();
+    fclose(fp);
+    file.fd = -1;
+  }
+}
+BENCHMARK(WriteCompressedEntries)->Arg(0)->Arg(2)->Arg(4);
+
 
 BENCHMARK_MAIN();
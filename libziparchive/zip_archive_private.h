@@ -22,7 +22,9 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include "android-base/macros.h"
@@ -42,6 +44,7 @@ static const char* kErrorMessages[] = {
     "Invalid entry name",
     "I/O error",
     "File mapping failed",
+    "Entry is not stored",
 };
 
 enum ErrorCodes : int32_t {
@@ -87,7 +90,10 @@ enum ErrorCodes : int32_t {
   // We were not able to mmap the central directory or entry contents.
   kMmapFailed = -12,
 
-  kLastErrorCode = kMmapFailed,
+  // The entry is compressed, so its data can't be accessed in place.
+  kEntryNotStored = -13,
+
+  kLastErrorCode = kEntryNotStored,
 };
 
 class MappedZipFile {
@@ -176,6 +182,20 @@ struct ZipArchive {
   uint32_t hash_table_size;
   ZipStringOffset* hash_table;
 
+  // Archives opened with OpenArchiveLazy or OpenArchiveFdLazy scan the central
+  // directory for their first kMaxLinearLookups lookups, and only then, or on
+  // StartIteration, build the hash table. hash_table_result is the outcome,
+  // e.g. kDuplicateEntry, and is returned by every lookup from then on.
+  std::once_flag hash_table_once;
+  int32_t hash_table_result;
+  bool lazy_hash_table;
+  std::atomic<bool> hash_table_ready;
+  std::atomic<uint32_t> linear_lookups;
+
+  // Maps the index that hash_table points into, for archives opened with
+  // OpenArchiveFdWithIndex. Otherwise hash_table is allocated.
+  std::unique_ptr<android::base::MappedFile> index_map;
+
   ZipArchive(const int fd, bool assume_ownership);
   ZipArchive(void* address, size_t length);
   ~ZipArchive();
@@ -23,6 +23,10 @@
 #include <string.h>
 #include <unistd.h>
 
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
 #include <memory>
 #include <vector>
 
@@ -237,6 +241,168 @@ TEST(ziparchive, FindEntry_too_long) {
   CloseArchive(handle);
 }
 
+TEST(ziparchive, ExtractEntriesToFiles) {
+  ZipArchiveHandle handle;
+  ASSERT_EQ(0, OpenArchiveWrapper(kValidZip, &handle));
+
+  const std::vector<std::string> names = {kATxtName, kBTxtName, "b/c.txt", "b/d.txt"};
+  std::vector<ZipEntry> entries(names.size());
+  std::vector<std::unique_ptr<TemporaryFile>> files;
+  std::vector<int> fds;
+  for (size_t i = 0; i < names.size(); i++) {
+    ASSERT_EQ(0, FindEntry(handle, names[i], &entries[i]));
+    files.emplace_back(new TemporaryFile);
+    fds.push_back(files.back()->fd);
+  }
+  ASSERT_EQ(0, ExtractEntriesToFiles(handle, entries.data(), fds.data(), entries.size(), 3));
+
+  for (size_t i = 0; i < names.size(); i++) {
+    std::vector<uint8_t> expected(entries[i].uncompressed_length);
+    ASSERT_EQ(0, ExtractToMemory(handle, &entries[i], expected.data(), expected.size()));
+    std::string actual;
+    ASSERT_TRUE(android::base::ReadFileToString(files[i]->path, &actual));
+    ASSERT_EQ(std::string(expected.begin(), expected.end()), actual) << names[i];
+  }
+
+  // Errors are reported by the first failing entry.
+  fds[2] = -1;
+  ASSERT_EQ(kIoError, ExtractEntriesToFiles(handle, entries.data(), fds.data(), entries.size(), 2));
+
+  CloseArchive(handle);
+}
+
+TEST(ziparchive, OpenLazy) {
+  const std::string path = test_data_dir + "/" + kValidZip;
+  ZipArchiveHandle handle;
+  ASSERT_EQ(0, OpenArchiveLazy(path.c_str(), &handle));
+
+  // Enough lookups to go from scanning the central directory to the hash table.
+  for (int i = 0; i < 10; i++) {
+    ZipEntry data;
+    ASSERT_EQ(0, FindEntry(handle, kATxtName, &data));
+    ASSERT_EQ(63, data.offset);
+    ASSERT_EQ(static_cast<uint32_t>(17), data.uncompressed_length);
+    ASSERT_EQ(0x950821c5, data.crc32);
+    ASSERT_EQ(0, FindEntry(handle, "b/c.txt", &data));
+    ASSERT_EQ(kEntryNotFound, FindEntry(handle, kNonexistentTxtName, &data));
+  }
+
+  void* iteration_cookie;
+  ASSERT_EQ(0, StartIteration(handle, &iteration_cookie));
+  ZipEntry data;
+  std::string name;
+  size_t count = 0;
+  while (Next(iteration_cookie, &data, &name) == 0) count++;
+  EndIteration(iteration_cookie);
+  ASSERT_EQ(5u, count);
+
+  CloseArchive(handle);
+
+  ASSERT_EQ(-1, OpenArchiveLazy((test_data_dir + "/" + kBadFilenameZip).c_str(), &handle));
+  CloseArchive(handle);
+}
+
+TEST(ziparchive, OpenWithIndex) {
+  const std::string path = test_data_dir + "/" + kValidZip;
+  android::base::unique_fd fd(open(path.c_str(), O_RDONLY | O_BINARY));
+  ASSERT_NE(-1, fd);
+  TemporaryFile index_file;
+  ASSERT_NE(-1, index_file.fd);
+
+  ZipArchiveHandle handle;
+  ASSERT_EQ(0, OpenArchiveFd(fd, "OpenWithIndex", &handle, false));
+  ASSERT_EQ(0, WriteArchiveIndex(handle, index_file.fd));
+  CloseArchive(handle);
+
+  ASSERT_EQ(0, OpenArchiveFdWithIndex(fd, index_file.fd, "OpenWithIndex", &handle, false));
+  ASSERT_NE(nullptr, handle->index_map);
+  ZipEntry data;
+  ASSERT_EQ(0, FindEntry(handle, kATxtName, &data));
+  ASSERT_EQ(63, data.offset);
+  ASSERT_EQ(0x950821c5, data.crc32);
+  ASSERT_EQ(0, FindEntry(handle, "b/c.txt", &data));
+  ASSERT_EQ(kEntryNotFound, FindEntry(handle, kNonexistentTxtName, &data));
+
+  void* iteration_cookie;
+  ASSERT_EQ(0, StartIteration(handle, &iteration_cookie));
+  std::string name;
+  size_t count = 0;
+  while (Next(iteration_cookie, &data, &name) == 0) count++;
+  EndIteration(iteration_cookie);
+  ASSERT_EQ(5u, count);
+  CloseArchive(handle);
+
+  // Without an index, the archive is scanned as usual.
+  ASSERT_EQ(0, OpenArchiveFdWithIndex(fd, -1, "OpenWithIndex", &handle, false));
+  ASSERT_EQ(nullptr, handle->index_map);
+  ASSERT_EQ(0, FindEntry(handle, kATxtName, &data));
+  CloseArchive(handle);
+}
+
+TEST(ziparchive, OpenWithIndex_mismatch) {
+  android::base::unique_fd fd(
+      open((test_data_dir + "/" + kValidZip).c_str(), O_RDONLY | O_BINARY));
+  ASSERT_NE(-1, fd);
+  android::base::unique_fd other_fd(
+      open((test_data_dir + "/" + kLargeZip).c_str(), O_RDONLY | O_BINARY));
+  ASSERT_NE(-1, other_fd);
+  TemporaryFile index_file;
+  ASSERT_NE(-1, index_file.fd);
+
+  // An index for a different archive is ignored.
+  ZipArchiveHandle handle;
+  ASSERT_EQ(0, OpenArchiveFd(other_fd, "OpenWithIndex_mismatch", &handle, false));
+  ASSERT_EQ(0, WriteArchiveIndex(handle, index_file.fd));
+  CloseArchive(handle);
+  ASSERT_EQ(0, OpenArchiveFdWithIndex(fd, index_file.fd, "OpenWithIndex_mismatch", &handle, false));
+  ASSERT_EQ(nullptr, handle->index_map);
+  ZipEntry data;
+  ASSERT_EQ(0, FindEntry(handle, kATxtName, &data));
+  CloseArchive(handle);
+
+  // So is an index whose entries point outside of the central directory.
+  ASSERT_EQ(0, ftruncate(index_file.fd, 0));
+  ASSERT_EQ(0, lseek(index_file.fd, 0, SEEK_SET));
+  ASSERT_EQ(0, OpenArchiveFd(fd, "OpenWithIndex_mismatch", &handle, false));
+  ASSERT_EQ(0, WriteArchiveIndex(handle, index_file.fd));
+  CloseArchive(handle);
+  std::string index;
+  ASSERT_TRUE(android::base::ReadFileToString(index_file.path, &index));
+  for (size_t i = 72; i < index.size(); i++) index[i] = '\xff';
+  ASSERT_TRUE(android::base::WriteStringToFile(index, index_file.path));
+  ASSERT_EQ(0, OpenArchiveFdWithIndex(fd, index_file.fd, "OpenWithIndex_mismatch", &handle, false));
+  ASSERT_EQ(nullptr, handle->index_map);
+  ASSERT_EQ(0, FindEntry(handle, kATxtName, &data));
+  CloseArchive(handle);
+}
+
+TEST(ziparchive, OpenLazy_duplicate_entry) {
+  // valid.zip, with "b.txt" renamed to a second "a.txt".
+  std::string zip_data;
+  ASSERT_TRUE(android::base::ReadFileToString(test_data_dir + "/" + kValidZip, &zip_data));
+  for (size_t pos = zip_data.find("b.txt"); pos != std::string::npos;
+       pos = zip_data.find("b.txt", pos)) {
+    zip_data[pos] = 'a';
+  }
+  TemporaryFile tmp_file;
+  ASSERT_NE(-1, tmp_file.fd);
+  ASSERT_TRUE(android::base::WriteStringToFd(zip_data, tmp_file.fd));
+
+  ZipArchiveHandle handle;
+  ASSERT_EQ(kDuplicateEntry, OpenArchive(tmp_file.path, &handle));
+  CloseArchive(handle);
+
+  // A lazy open only finds out on lookup, both by scanning and from the hash table.
+  ASSERT_EQ(0, OpenArchiveLazy(tmp_file.path, &handle));
+  ZipEntry data;
+  ASSERT_EQ(kDuplicateEntry, FindEntry(handle, kATxtName, &data));
+  ASSERT_EQ(0, FindEntry(handle, "b/d.txt", &data));
+  void* iteration_cookie;
+  ASSERT_EQ(kDuplicateEntry, StartIteration(handle, &iteration_cookie));
+  ASSERT_EQ(kDuplicateEntry, FindEntry(handle, "b/d.txt", &data));
+  CloseArchive(handle);
+}
+
 TEST(ziparchive, TestInvalidDeclaredLength) {
   ZipArchiveHandle handle;
   ASSERT_EQ(0, OpenArchiveWrapper("declaredlength.zip", &handle));
@@ -279,6 +445,56 @@ TEST(ziparchive, ExtractToMemory) {
   CloseArchive(handle);
 }
 
+TEST(ziparchive, GetStoredEntryData) {
+  std::string zip_data;
+  ASSERT_TRUE(android::base::ReadFileToString(test_data_dir + "/" + kValidZip, &zip_data));
+  ZipArchiveHandle handle;
+  ASSERT_EQ(0, OpenArchiveFromMemory(zip_data.data(), zip_data.size(), "GetStoredEntryData",
+                                     &handle));
+
+  ZipEntry data;
+  ASSERT_EQ(0, FindEntry(handle, kBTxtName, &data));
+  const uint8_t* begin = nullptr;
+  uint32_t length = 0;
+#if !defined(_WIN32)
+  ASSERT_EQ(0, GetStoredEntryData(handle, &data, &begin, &length, MADV_WILLNEED));
+#else
+  ASSERT_EQ(0, GetStoredEntryData(handle, &data, &begin, &length));
+#endif
+  ASSERT_EQ(reinterpret_cast<const uint8_t*>(zip_data.data()) + data.offset, begin);
+  ASSERT_EQ(std::string(kBTxtContents.begin(), kBTxtContents.end()),
+            std::string(reinterpret_cast<const char*>(begin), length));
+
+  ASSERT_EQ(0, FindEntry(handle, kATxtName, &data));
+  ASSERT_EQ(kEntryNotStored, GetStoredEntryData(handle, &data, &begin, &length));
+  CloseArchive(handle);
+
+  // Archives opened from a file have no memory to point into.
+  ASSERT_EQ(0, OpenArchiveWrapper(kValidZip, &handle));
+  ASSERT_EQ(0, FindEntry(handle, kBTxtName, &data));
+  ASSERT_EQ(kInvalidHandle, GetStoredEntryData(handle, &data, &begin, &length));
+  CloseArchive(handle);
+}
+
+TEST(ziparchive, ExtractToMemory_wrong_size) {
+  ZipArchiveHandle handle;
+  ASSERT_EQ(0, OpenArchiveWrapper(kValidZip, &handle));
+
+  ZipEntry data;
+  ASSERT_EQ(0, FindEntry(handle, kATxtName, &data));
+  std::vector<uint8_t> buffer(kATxtContents.size() + 1);
+  ASSERT_EQ(kIoError, ExtractToMemory(handle, &data, buffer.data(), kATxtContents.size() - 1));
+
+  // More room than declared is fine, as long as the entry matches its declared size.
+  ASSERT_EQ(0, ExtractToMemory(handle, &data, buffer.data(), buffer.size()));
+  ASSERT_EQ(0, memcmp(buffer.data(), kATxtContents.data(), kATxtContents.size()));
+  data.uncompressed_length++;
+  ASSERT_EQ(kInconsistentInformation,
+            ExtractToMemory(handle, &data, buffer.data(), buffer.size()));
+
+  CloseArchive(handle);
+}
+
 static const uint32_t kEmptyEntriesZip[] = {
     0x04034b50, 0x0000000a, 0x63600000, 0x00004438, 0x00000000, 0x00000000, 0x00090000,
     0x6d65001c, 0x2e797470, 0x55747874, 0x03000954, 0x52e25c13, 0x52e25c24, 0x000b7875,
@@ -647,7 +863,7 @@ TEST(ziparchive, ErrorCodeString) {
 
   // Out of bounds.
   ASSERT_STREQ("Unknown return code", ErrorCodeString(1));
-  ASSERT_STREQ("Unknown return code", ErrorCodeString(-13));
+  ASSERT_STREQ("Unknown return code", ErrorCodeString(-14));
 
   ASSERT_STREQ("I/O error", ErrorCodeString(kIoError));
 }
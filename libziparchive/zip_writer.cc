@@ -22,7 +22,11 @@
 #include <cstdio>
 #define DEF_MEM_LEVEL 8  // normally in zutil.h?
 
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "android-base/logging.h"
@@ -84,11 +88,148 @@ static void DeleteZStream(z_stream* stream) {
   delete stream;
 }
 
+// Deflates all of |data| in place, with the same settings as PrepareDeflate.
+static int32_t DeflateInPlace(std::vector<uint8_t>* data) {
+  z_stream stream = {};
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+  int zerr = deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL,
+                          Z_DEFAULT_STRATEGY);
+#pragma GCC diagnostic pop
+  if (zerr != Z_OK) {
+    LOG(ERROR) << "deflateInit2 failed (zerr=" << zerr << ")";
+    return kZlibError;
+  }
+
+  std::vector<uint8_t> out(deflateBound(&stream, data->size()));
+  stream.next_in = data->data();
+  stream.avail_in = static_cast<uint32_t>(data->size());
+  stream.next_out = out.data();
+  stream.avail_out = static_cast<uint32_t>(out.size());
+  zerr = deflate(&stream, Z_FINISH);
+  const size_t out_size = stream.total_out;
+  deflateEnd(&stream);
+  if (zerr != Z_STREAM_END) {
+    return kZlibError;
+  }
+
+  out.resize(out_size);
+  data->swap(out);
+  return kNoError;
+}
+
+/**
+ * Deflates the entries of a ZipWriter on a pool of threads. The entries are
+ * handed back in the order they were added in, each one once it's deflated.
+ */
+class ZipWriter::ParallelDeflater {
+ public:
+  struct Entry {
+    FileEntry file_entry;
+    uint32_t alignment;
+    // Uncompressed until the entry is deflated, if it's compressed at all.
+    std::vector<uint8_t> data;
+    int32_t result;
+    bool done;
+  };
+
+  explicit ParallelDeflater(size_t num_threads)
+      : max_pending_(2 * num_threads), stopping_(false) {
+    for (size_t i = 0; i < num_threads; i++) {
+      threads_.emplace_back(&ParallelDeflater::Run, this);
+    }
+  }
+
+  ~ParallelDeflater() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    work_cv_.notify_all();
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  size_t PendingCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+
+  void Add(FileEntry file_entry, uint32_t alignment, std::vector<uint8_t> data) {
+    std::unique_ptr<Entry> entry(new Entry);
+    entry->file_entry = std::move(file_entry);
+    entry->alignment = alignment;
+    entry->data = std::move(data);
+    entry->result = kNoError;
+    const bool deflate = entry->file_entry.compression_method == kCompressDeflated;
+    entry->done = !deflate;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (deflate) {
+        jobs_.push_back(entry.get());
+      }
+      entries_.push_back(std::move(entry));
+    }
+    if (deflate) {
+      work_cv_.notify_one();
+    }
+  }
+
+  // Returns the oldest entry if it's done. Waits for it if |wait| is set, or if too many
+  // entries are pending, so that they don't all pile up in memory. Returns null otherwise.
+  std::unique_ptr<Entry> TakeOldest(bool wait) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (entries_.empty()) {
+      return nullptr;
+    }
+    if (wait || entries_.size() > max_pending_) {
+      done_cv_.wait(lock, [this] { return entries_.front()->done; });
+    } else if (!entries_.front()->done) {
+      return nullptr;
+    }
+    std::unique_ptr<Entry> entry = std::move(entries_.front());
+    entries_.pop_front();
+    return entry;
+  }
+
+ private:
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      work_cv_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      Entry* entry = jobs_.front();
+      jobs_.pop_front();
+
+      lock.unlock();
+      const int32_t result = DeflateInPlace(&entry->data);
+      lock.lock();
+      entry->result = result;
+      entry->done = true;
+      done_cv_.notify_all();
+    }
+  }
+
+  const size_t max_pending_;
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  // All entries that weren't taken yet, in order. jobs_ has those still to deflate.
+  std::deque<std::unique_ptr<Entry>> entries_;
+  std::deque<Entry*> jobs_;
+  bool stopping_;
+  std::vector<std::thread> threads_;
+};
+
 ZipWriter::ZipWriter(FILE* f)
     : file_(f),
       seekable_(false),
       current_offset_(0),
       state_(State::kWritingZip),
+      current_alignment_(0),
       z_stream_(nullptr, DeleteZStream),
       buffer_(kBufSize) {
   // Check if the file is seekable (regular file). If fstat fails, that's fine, subsequent calls
@@ -99,14 +240,25 @@ ZipWriter::ZipWriter(FILE* f)
   }
 }
 
+ZipWriter::ZipWriter(FILE* f, size_t compression_threads) : ZipWriter(f) {
+  if (compression_threads > 0) {
+    deflater_.reset(new ParallelDeflater(compression_threads));
+  }
+}
+
+ZipWriter::~ZipWriter() = default;
+
 ZipWriter::ZipWriter(ZipWriter&& writer) noexcept
     : file_(writer.file_),
       seekable_(writer.seekable_),
       current_offset_(writer.current_offset_),
       state_(writer.state_),
       files_(std::move(writer.files_)),
+      current_file_entry_(std::move(writer.current_file_entry_)),
+      current_alignment_(writer.current_alignment_),
       z_stream_(std::move(writer.z_stream_)),
-      buffer_(std::move(writer.buffer_)) {
+      buffer_(std::move(writer.buffer_)),
+      deflater_(std::move(writer.deflater_)) {
   writer.file_ = nullptr;
   writer.state_ = State::kError;
 }
@@ -117,8 +269,11 @@ ZipWriter& ZipWriter::operator=(ZipWriter&& writer) noexcept {
   current_offset_ = writer.current_offset_;
   state_ = writer.state_;
   files_ = std::move(writer.files_);
+  current_file_entry_ = std::move(writer.current_file_entry_);
+  current_alignment_ = writer.current_alignment_;
   z_stream_ = std::move(writer.z_stream_);
   buffer_ = std::move(writer.buffer_);
+  deflater_ = std::move(writer.deflater_);
   writer.file_ = nullptr;
   writer.state_ = State::kError;
   return *this;
@@ -205,7 +360,8 @@ int32_t ZipWriter::StartAlignedEntryWithTime(std::string_view path, size_t flags
   }
 
   // Can only have 16535 entries because of zip records.
-  if (files_.size() == std::numeric_limits<uint16_t>::max()) {
+  const size_t num_files = files_.size() + (deflater_ ? deflater_->PendingCount() : 0);
+  if (num_files == std::numeric_limits<uint16_t>::max()) {
     return HandleError(kIoError);
   }
 
@@ -221,12 +377,7 @@ int32_t ZipWriter::StartAlignedEntryWithTime(std::string_view path, size_t flags
   }
 
   FileEntry file_entry = {};
-  file_entry.local_file_header_offset = current_offset_;
   file_entry.path = path;
-  // No support for larger than 4GB files.
-  if (file_entry.local_file_header_offset > std::numeric_limits<uint32_t>::max()) {
-    return HandleError(kIoError);
-  }
 
   if (!IsValidEntryName(reinterpret_cast<const uint8_t*>(file_entry.path.data()),
                         file_entry.path.size())) {
@@ -236,9 +387,11 @@ int32_t ZipWriter::StartAlignedEntryWithTime(std::string_view path, size_t flags
   if (flags & ZipWriter::kCompress) {
     file_entry.compression_method = kCompressDeflated;
 
-    int32_t result = PrepareDeflate();
-    if (result != kNoError) {
-      return result;
+    if (!deflater_) {
+      int32_t result = PrepareDeflate();
+      if (result != kNoError) {
+        return result;
+      }
     }
   } else {
     file_entry.compression_method = kCompressStored;
@@ -246,7 +399,33 @@ int32_t ZipWriter::StartAlignedEntryWithTime(std::string_view path, size_t flags
 
   ExtractTimeAndDate(time, &file_entry.last_mod_time, &file_entry.last_mod_date);
 
-  off_t offset = current_offset_ + sizeof(LocalFileHeader) + file_entry.path.size();
+  if (deflater_) {
+    // The header is only written after the data is deflated, by WritePendingEntries.
+    buffer_.clear();
+  } else {
+    // Always start expecting a data descriptor. When the data has finished being written,
+    // if it is possible to seek back, the GPB flag will reset and the sizes written.
+    int32_t result = WriteLocalFileHeader(&file_entry, alignment, true /*use_data_descriptor*/);
+    if (result != kNoError) {
+      return result;
+    }
+  }
+
+  current_file_entry_ = std::move(file_entry);
+  current_alignment_ = alignment;
+  state_ = State::kWritingEntry;
+  return kNoError;
+}
+
+int32_t ZipWriter::WriteLocalFileHeader(FileEntry* file, uint32_t alignment,
+                                        bool use_data_descriptor) {
+  file->local_file_header_offset = current_offset_;
+  // No support for larger than 4GB files.
+  if (file->local_file_header_offset > std::numeric_limits<uint32_t>::max()) {
+    return HandleError(kIoError);
+  }
+
+  off_t offset = current_offset_ + sizeof(LocalFileHeader) + file->path.size();
   // prepare a pre-zeroed memory page in case when we need to pad some aligned data.
   static constexpr auto kPageSize = 4096;
   static constexpr char kSmallZeroPadding[kPageSize] = {};
@@ -257,7 +436,7 @@ int32_t ZipWriter::StartAlignedEntryWithTime(std::string_view path, size_t flags
   if (alignment != 0 && (offset & (alignment - 1))) {
     // Pad the extra field so the data will be aligned.
     uint16_t padding = static_cast<uint16_t>(alignment - (offset % alignment));
-    file_entry.padding_length = padding;
+    file->padding_length = padding;
     offset += padding;
     if (padding <= std::size(kSmallZeroPadding)) {
         zero_padding = kSmallZeroPadding;
@@ -268,31 +447,88 @@ int32_t ZipWriter::StartAlignedEntryWithTime(std::string_view path, size_t flags
   }
 
   LocalFileHeader header = {};
-  // Always start expecting a data descriptor. When the data has finished being written,
-  // if it is possible to seek back, the GPB flag will reset and the sizes written.
-  CopyFromFileEntry(file_entry, true /*use_data_descriptor*/, &header);
+  CopyFromFileEntry(*file, use_data_descriptor, &header);
 
   if (fwrite(&header, sizeof(header), 1, file_) != 1) {
     return HandleError(kIoError);
   }
 
-  if (fwrite(path.data(), 1, path.size(), file_) != path.size()) {
+  if (fwrite(file->path.data(), 1, file->path.size(), file_) != file->path.size()) {
     return HandleError(kIoError);
   }
 
-  if (file_entry.padding_length != 0 && fwrite(zero_padding, 1, file_entry.padding_length,
-                                               file_) != file_entry.padding_length) {
+  if (file->padding_length != 0 &&
+      fwrite(zero_padding, 1, file->padding_length, file_) != file->padding_length) {
     return HandleError(kIoError);
   }
 
-  current_file_entry_ = std::move(file_entry);
   current_offset_ = offset;
-  state_ = State::kWritingEntry;
+  return kNoError;
+}
+
+int32_t ZipWriter::WriteDataDescriptor(const FileEntry& file) {
+  const uint32_t sig = DataDescriptor::kOptSignature;
+  if (fwrite(&sig, sizeof(sig), 1, file_) != 1) {
+    return HandleError(kIoError);
+  }
+
+  DataDescriptor dd = {};
+  dd.crc32 = file.crc32;
+  dd.compressed_size = file.compressed_size;
+  dd.uncompressed_size = file.uncompressed_size;
+  if (fwrite(&dd, sizeof(dd), 1, file_) != 1) {
+    return HandleError(kIoError);
+  }
+  current_offset_ += sizeof(DataDescriptor::kOptSignature) + sizeof(dd);
+  return kNoError;
+}
+
+int32_t ZipWriter::WritePendingEntries(bool wait_for_all) {
+  CHECK(deflater_);
+
+  std::unique_ptr<ParallelDeflater::Entry> entry;
+  while ((entry = deflater_->TakeOldest(wait_for_all)) != nullptr) {
+    if (entry->result != kNoError) {
+      return HandleError(entry->result);
+    }
+    FileEntry& file = entry->file_entry;
+    if (entry->data.size() > std::numeric_limits<uint32_t>::max()) {
+      return HandleError(kIoError);
+    }
+    file.compressed_size = static_cast<uint32_t>(entry->data.size());
+
+    // The sizes are known up front, so the header only needs a data descriptor when
+    // the output isn't seekable, just like for the entries FinishEntry writes.
+    int32_t result = WriteLocalFileHeader(&file, entry->alignment, ShouldUseDataDescriptor());
+    if (result != kNoError) {
+      return result;
+    }
+    if (fwrite(entry->data.data(), 1, entry->data.size(), file_) != entry->data.size()) {
+      return HandleError(kIoError);
+    }
+    current_offset_ += entry->data.size();
+    if (ShouldUseDataDescriptor()) {
+      result = WriteDataDescriptor(file);
+      if (result != kNoError) {
+        return result;
+      }
+    }
+    files_.emplace_back(std::move(file));
+  }
   return kNoError;
 }
 
 int32_t ZipWriter::DiscardLastEntry() {
-  if (state_ != State::kWritingZip || files_.empty()) {
+  if (state_ != State::kWritingZip) {
+    return kInvalidState;
+  }
+  if (deflater_) {
+    int32_t result = WritePendingEntries(true);
+    if (result != kNoError) {
+      return result;
+    }
+  }
+  if (files_.empty()) {
     return kInvalidState;
   }
 
@@ -308,6 +544,12 @@ int32_t ZipWriter::DiscardLastEntry() {
 int32_t ZipWriter::GetLastEntry(FileEntry* out_entry) {
   CHECK(out_entry != nullptr);
 
+  if (deflater_ && state_ == State::kWritingZip) {
+    int32_t result = WritePendingEntries(true);
+    if (result != kNoError) {
+      return result;
+    }
+  }
   if (files_.empty()) {
     return kInvalidState;
   }
@@ -355,7 +597,10 @@ int32_t ZipWriter::WriteBytes(const void* data, size_t len) {
   uint32_t len32 = static_cast<uint32_t>(len);
 
   int32_t result = kNoError;
-  if (current_file_entry_.compression_method & kCompressDeflated) {
+  if (deflater_) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    buffer_.insert(buffer_.end(), bytes, bytes + len32);
+  } else if (current_file_entry_.compression_method & kCompressDeflated) {
     result = CompressBytes(&current_file_entry_, data, len32);
   } else {
     result = StoreBytes(&current_file_entry_, data, len32);
@@ -465,6 +710,14 @@ int32_t ZipWriter::FinishEntry() {
     return kInvalidState;
   }
 
+  if (deflater_) {
+    // Hand the data over to be deflated, and write out whatever entries are done.
+    deflater_->Add(std::move(current_file_entry_), current_alignment_, std::move(buffer_));
+    buffer_.clear();
+    state_ = State::kWritingZip;
+    return WritePendingEntries(false);
+  }
+
   if (current_file_entry_.compression_method & kCompressDeflated) {
     int32_t result = FlushCompressedBytes(&current_file_entry_);
     if (result != kNoError) {
@@ -475,19 +728,10 @@ int32_t ZipWriter::FinishEntry() {
   if (ShouldUseDataDescriptor()) {
     // Some versions of ZIP don't allow STORED data to have a trailing DataDescriptor.
     // If this file is not seekable, or if the data is compressed, write a DataDescriptor.
-    const uint32_t sig = DataDescriptor::kOptSignature;
-    if (fwrite(&sig, sizeof(sig), 1, file_) != 1) {
-      return HandleError(kIoError);
-    }
-
-    DataDescriptor dd = {};
-    dd.crc32 = current_file_entry_.crc32;
-    dd.compressed_size = current_file_entry_.compressed_size;
-    dd.uncompressed_size = current_file_entry_.uncompressed_size;
-    if (fwrite(&dd, sizeof(dd), 1, file_) != 1) {
-      return HandleError(kIoError);
+    int32_t result = WriteDataDescriptor(current_file_entry_);
+    if (result != kNoError) {
+      return result;
     }
-    current_offset_ += sizeof(DataDescriptor::kOptSignature) + sizeof(dd);
   } else {
     // Seek back to the header and rewrite to include the size.
     if (fseeko(file_, current_file_entry_.local_file_header_offset, SEEK_SET) != 0) {
@@ -516,6 +760,13 @@ int32_t ZipWriter::Finish() {
     return kInvalidState;
   }
 
+  if (deflater_) {
+    int32_t result = WritePendingEntries(true);
+    if (result != kNoError) {
+      return result;
+    }
+  }
+
   off_t startOfCdr = current_offset_;
   for (FileEntry& file : files_) {
     CentralDirectoryRecord cdr = {};
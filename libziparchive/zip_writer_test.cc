@@ -17,10 +17,12 @@
 #include "ziparchive/zip_writer.h"
 #include "ziparchive/zip_archive.h"
 
+#include <android-base/file.h>
 #include <android-base/test_utils.h>
 #include <gtest/gtest.h>
 #include <time.h>
 #include <memory>
+#include <string>
 #include <vector>
 
 static ::testing::AssertionResult AssertFileEntryContentsEq(const std::string& expected,
@@ -403,6 +405,82 @@ TEST_F(zipwriter, TruncateFileAfterBackup) {
   ASSERT_GT(before_len, after_len);
 }
 
+static void WriteMixedEntries(ZipWriter* writer) {
+  std::vector<uint8_t> data(100000);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<uint8_t>(i * i / 7);
+  }
+  for (size_t i = 0; i < 20; i++) {
+    const std::string name = "file" + std::to_string(i);
+    const size_t flags = (i % 3 == 0) ? 0 : ZipWriter::kCompress;
+    ASSERT_EQ(0, writer->StartAlignedEntry(name, flags, (i % 2 == 0) ? 4096 : 4));
+    ASSERT_EQ(0, writer->WriteBytes(data.data(), data.size() / (i + 1)));
+    ASSERT_EQ(0, writer->WriteBytes(name.data(), name.size()));
+    ASSERT_EQ(0, writer->FinishEntry());
+  }
+  ASSERT_EQ(0, writer->StartEntry("empty.txt", ZipWriter::kCompress));
+  ASSERT_EQ(0, writer->FinishEntry());
+  ASSERT_EQ(0, writer->Finish());
+}
+
+TEST_F(zipwriter, CompressionThreadsKeepTheLayout) {
+  TemporaryFile serial_file;
+  FILE* fp = fdopen(serial_file.fd, "w");
+  ASSERT_NE(nullptr, fp);
+  ZipWriter serial_writer(fp);
+  WriteMixedEntries(&serial_writer);
+  ASSERT_EQ(0, fclose(fp));
+  serial_file.fd = -1;
+
+  ZipWriter writer(file_, 4);
+  WriteMixedEntries(&writer);
+  ASSERT_EQ(0, fflush(file_));
+
+  std::string expected;
+  std::string actual;
+  ASSERT_TRUE(android::base::ReadFileToString(serial_file.path, &expected));
+  ASSERT_TRUE(android::base::ReadFileToString(temp_file_->path, &actual));
+  ASSERT_TRUE(expected == actual);
+
+  ZipArchiveHandle handle;
+  ASSERT_EQ(0, OpenArchiveFd(fd_, "temp", &handle, false));
+  ZipEntry data;
+  ASSERT_EQ(0, FindEntry(handle, "file2", &data));
+  EXPECT_EQ(kCompressDeflated, data.method);
+  EXPECT_EQ(0, data.offset & 0xfff);
+  ASSERT_EQ(0, FindEntry(handle, "empty.txt", &data));
+  ASSERT_TRUE(AssertFileEntryContentsEq("", handle, &data));
+  CloseArchive(handle);
+}
+
+TEST_F(zipwriter, CompressionThreadsBackup) {
+  ZipWriter writer(file_, 2);
+
+  ASSERT_EQ(0, writer.StartEntry("keep.txt", ZipWriter::kCompress));
+  ASSERT_EQ(0, writer.WriteBytes("keep", 4));
+  ASSERT_EQ(0, writer.FinishEntry());
+  ASSERT_EQ(0, writer.StartEntry("drop.txt", ZipWriter::kCompress));
+  ASSERT_EQ(0, writer.WriteBytes("drop", 4));
+  ASSERT_EQ(0, writer.FinishEntry());
+
+  ZipWriter::FileEntry entry;
+  ASSERT_EQ(0, writer.GetLastEntry(&entry));
+  EXPECT_EQ("drop.txt", entry.path);
+  ASSERT_EQ(0, writer.DiscardLastEntry());
+  ASSERT_EQ(0, writer.GetLastEntry(&entry));
+  EXPECT_EQ("keep.txt", entry.path);
+  ASSERT_EQ(0, writer.Finish());
+
+  ASSERT_GE(0, lseek(fd_, 0, SEEK_SET));
+  ZipArchiveHandle handle;
+  ASSERT_EQ(0, OpenArchiveFd(fd_, "temp", &handle, false));
+  ZipEntry data;
+  ASSERT_EQ(0, FindEntry(handle, "keep.txt", &data));
+  ASSERT_TRUE(AssertFileEntryContentsEq("keep", handle, &data));
+  ASSERT_NE(0, FindEntry(handle, "drop.txt", &data));
+  CloseArchive(handle);
+}
+
 static ::testing::AssertionResult AssertFileEntryContentsEq(const std::string& expected,
                                                             ZipArchiveHandle handle,
                                                             ZipEntry* zip_entry) {
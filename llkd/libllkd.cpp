@@ -28,6 +28,7 @@
 #include <sys/cdefs.h>  // ___STRING, __predict_true() and _predict_false()
 #include <sys/mman.h>   // mlockall()
 #include <sys/prctl.h>
+#include <sys/resource.h>  // getrlimit()
 #include <sys/stat.h>     // lstat()
 #include <sys/syscall.h>  // __NR_getdents64
 #include <sys/sysinfo.h>  // get_nprocs_conf()
@@ -47,6 +48,7 @@
 #include <android-base/parseint.h>
 #include <android-base/properties.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <cutils/android_get_control_file.h>
 #include <log/log_main.h>
 
@@ -276,6 +278,13 @@ uid_t llkProcGetUid(pid_t tid) {
     return ret;
 }
 
+// /proc/<pid>/task/<tid>/stat of every thread is kept open across checks, as
+// long as llkStatFdsMax allows, and read into llkStatBuffer.  The content is
+// well under 1K even with the longest comm.
+char llkStatBuffer[1024];
+size_t llkStatFds;     // number of open proc::statFd
+size_t llkStatFdsMax;  // limit for the above, derived from RLIMIT_NOFILE
+
 struct proc {
     pid_t tid;                     // monitored thread id (in Z or D state).
     nanoseconds schedUpdate;       // /proc/<tid>/sched "se.avg.lastUpdateTime",
@@ -291,7 +300,7 @@ struct proc {
                                    // /proc/<pid>/task/<tid> for threads.
     pid_t ppid;                    // /proc/<tid>/stat field 4 parent pid.
     uid_t uid;                     // /proc/<tid>/status Uid: field.
-    unsigned time;                 // sum of /proc/<tid>/stat field 14 utime &
+    unsigned time;                 // sum of /proc/<pid>/task/<tid>/stat field 14 utime &
                                    // 15 stime for coarse ABA problem detection.
     std::string cmdline;           // cached /cmdline content
     char state;                    // /proc/<tid>/stat field 3: Z or D
@@ -304,6 +313,7 @@ struct proc {
     bool cmdlineValid;             // cmdline has been cached
     bool updated;                  // cleared before monitoring pass.
     bool killed;                   // sent a kill to this thread, next panic...
+    android::base::unique_fd statFd;  // cached /proc/<pid>/task/<tid>/stat
 
     void setComm(const char* _comm) { strncpy(comm + 1, _comm, sizeof(comm) - 2); }
 
@@ -332,6 +342,22 @@ struct proc {
         setComm(_comm);
     }
 
+    proc(proc&&) = default;
+
+    ~proc() { closeStat(); }
+
+    void setStatFd(android::base::unique_fd&& fd) {
+        if ((fd < 0) || (statFd >= 0) || (llkStatFds >= llkStatFdsMax)) return;
+        statFd = std::move(fd);
+        ++llkStatFds;
+    }
+
+    void closeStat(void) {
+        if (statFd < 0) return;
+        statFd.reset();
+        --llkStatFds;
+    }
+
     const char* getComm(void) {
         if (comm[1] == '\0') {  // comm Valid?
             strncpy(comm + 1, llkProcGetName(tid, "/comm").c_str(), sizeof(comm) - 2);
@@ -773,6 +799,60 @@ bool llkIsMonitorState(char state) {
     return (state == 'Z') || (state == 'D');
 }
 
+// Reads <dir><tid>/stat into llkStatBuffer, through the fd cached in procp if
+// there is one, which spares the open and close.  Once the thread exits, the
+// cached fd can no longer be read, and the tid may have been reused: the fd is
+// dropped and the cache in procp reset, and the stat is opened afresh into
+// *opened for the caller to hand to the proc.  Returns the length read, 0 on
+// failure.
+//
+// dir should be /proc/<pid>/task/ rather than /proc/, because the kernel sums
+// up the times of every thread of the process for each read of /proc/<tid>/stat.
+size_t llkReadStat(proc* procp, const std::string& dir, const char* tid,
+                   android::base::unique_fd* opened) {
+    if (procp && (procp->statFd >= 0)) {
+        auto len = TEMP_FAILURE_RETRY(
+                ::pread(procp->statFd, llkStatBuffer, sizeof(llkStatBuffer) - 1, 0));
+        if (len > 0) {
+            llkStatBuffer[len] = '\0';
+            return len;
+        }
+        procp->closeStat();
+        procp->reset();
+    }
+    auto stat = dir + tid + "/stat";
+    opened->reset(TEMP_FAILURE_RETRY(::open(stat.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (*opened < 0) {
+        PLOG(DEBUG) << "Read " << stat << " failed";
+        return 0;
+    }
+    auto len = TEMP_FAILURE_RETRY(::pread(*opened, llkStatBuffer, sizeof(llkStatBuffer) - 1, 0));
+    if (len <= 0) {
+        PLOG(DEBUG) << "Read " << stat << " failed";
+        opened->reset();
+        return 0;
+    }
+    llkStatBuffer[len] = '\0';
+    return len;
+}
+
+// State of the thread from the stat content in llkStatBuffer, field 3 after
+// the comm in parentheses, which may itself contain ')'.
+char llkStatState(void) {
+    auto end = ::strrchr(llkStatBuffer, ')');
+    if ((end == nullptr) || (end[1] != ' ')) return '?';
+    return end[2];
+}
+
+// Whether threads need checking outside of the Z and D states
+bool llkCheckAllStates(void) {
+#ifdef __PTRACE_ENABLED__
+    return !llkCheckStackSymbols.empty();
+#else
+    return false;
+#endif
+}
+
 // returns -1 if not found
 long long getSchedValue(const std::string& schedString, const char* key) {
     auto pos = schedString.find(key);
@@ -1004,6 +1084,7 @@ milliseconds llkCheck(bool checkRunning) {
         dir taskDirectory(taskdir);
         if (__predict_false(!taskDirectory)) {
             LOG(DEBUG) << "+opendir(\"" << taskdir << "\") failed";
+            taskdir = procdir;
         }
         for (auto tp = taskDirectory.read(dir::task, dp); tp != nullptr;
              tp = taskDirectory.read(dir::task)) {
@@ -1011,11 +1092,34 @@ milliseconds llkCheck(bool checkRunning) {
                 continue;
             }
 
+            pid_t dirTid;
+            if (!android::base::ParseInt(tp->d_name, &dirTid)) {
+                continue;
+            }
+            auto procp = llkTidLookup(dirTid);
+
             // Get the process stat
-            std::string stat = ReadFile(piddir + "/stat");
-            if (stat.empty()) {
+            android::base::unique_fd statFd;
+            if (!llkReadStat(procp, taskdir, tp->d_name, &statFd)) {
+                continue;
+            }
+
+            // Only threads that are, or just were, in a state we monitor go
+            // through the parsing and checks below.  The others have nothing
+            // to update, until their state changes.
+            if (procp && (statFd < 0) && (llkStatState() == procp->state) &&
+                !llkIsMonitorState(procp->state) && !llkCheckAllStates()) {
+                if (pid == -1) {
+                    pid = procp->pid;
+                }
+                procp->updated = true;
+                procp->update = llkUpdate;
+                if (pid == myPid) {
+                    break;
+                }
                 continue;
             }
+
             unsigned tid = -1;
             char pdir[TASK_COMM_LEN + 1];
             char state = '?';
@@ -1026,7 +1130,7 @@ milliseconds llkCheck(bool checkRunning) {
             pdir[0] = '\0';
             // tid should not change value
             auto match = ::sscanf(
-                stat.c_str(),
+                llkStatBuffer,
                 "%u (%" ___STRING(
                     TASK_COMM_LEN) "[^)]) %c %u %*d %*d %*d %*d %*d %*d %*d %*d %*d %u %u %d",
                 &tid, pdir, &state, &ppid, &utime, &stime, &dummy);
@@ -1039,7 +1143,10 @@ milliseconds llkCheck(bool checkRunning) {
                 continue;
             }
 
-            auto procp = llkTidLookup(tid);
+            if (__predict_false(tid != static_cast<unsigned>(dirTid))) {
+                procp = llkTidLookup(tid);
+                statFd.reset();
+            }
             if (procp == nullptr) {
                 procp = llkTidAlloc(tid, pid, ppid, pdir, utime + stime, state);
             } else {
@@ -1066,6 +1173,7 @@ milliseconds llkCheck(bool checkRunning) {
                     procp->count += llkCycle;
                 }
             }
+            procp->setStatFd(std::move(statFd));
 
             // Filter checks in intuitive order of CPU cost to evaluate
             // If tid unique continue, if ppid or pid unique break
@@ -1261,6 +1369,12 @@ bool llkInit(const char* threadname) {
         }
     }
     llkEnableSysrqT = android::base::GetBoolProperty(LLK_ENABLE_SYSRQ_T_PROPERTY, llkEnableSysrqT);
+    // Leave half of the file descriptors to everything else, panic included.
+    rlimit rlim;
+    llkStatFdsMax = 0;
+    if (!getrlimit(RLIMIT_NOFILE, &rlim)) {
+        llkStatFdsMax = std::min(rlim.rlim_cur, static_cast<rlim_t>(65536)) / 2;
+    }
     llkEnable = android::base::GetBoolProperty(LLK_ENABLE_PROPERTY, llkEnable);
     if (llkEnable && !llkTopDirectory.reset(procdir)) {
         // Most likely reason we could be here is llkd was started
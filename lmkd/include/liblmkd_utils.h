@@ -39,6 +39,15 @@ int lmkd_connect();
  */
 int lmkd_register_proc(int sock, struct lmk_procprio *params);
 
+/*
+ * Registers up to MAX_PROCPRIO_BATCH processes with lmkd in a single packet.
+ * When the same pid is listed more than once the last entry wins.
+ * On success returns 0.
+ * On error, -1 is returned.
+ * In the case of error errno is set appropriately.
+ */
+int lmkd_register_procs(int sock, struct lmk_procprio *params, size_t proc_cnt);
+
 /*
  * Creates memcg directory for given process.
  * On success returns 0.
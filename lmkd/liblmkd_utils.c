@@ -42,6 +42,22 @@ int lmkd_register_proc(int sock, struct lmk_procprio *params) {
     return (ret < 0) ? -1 : 0;
 }
 
+int lmkd_register_procs(int sock, struct lmk_procprio *params, size_t proc_cnt) {
+    LMKD_CTRL_PACKET packet;
+    size_t size;
+    int ret;
+
+    if (proc_cnt == 0 || proc_cnt > MAX_PROCPRIO_BATCH) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size = lmkd_pack_set_procprio_batch(packet, params, proc_cnt);
+    ret = TEMP_FAILURE_RETRY(write(sock, packet, size));
+
+    return (ret < 0) ? -1 : 0;
+}
+
 int create_memcg(uid_t uid, pid_t pid) {
     char buf[256];
     int tasks_file;
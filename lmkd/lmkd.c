@@ -31,6 +31,7 @@
 #include <sys/mman.h>
 #include <sys/resource.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
 #include <sys/sysinfo.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -117,8 +118,18 @@
 
 #define min(a, b) (((a) < (b)) ? (a) : (b))
 
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
+
 #define FAIL_REPORT_RLIMIT_MS 1000
 
+/*
+ * Max number of /proc/<pid>/statm files kept open. Processes registered
+ * beyond that reopen the file on every read.
+ */
+#define MAX_STATM_FDS 512
+
 /* default to old in-kernel interface if no memory pressure events */
 static bool use_inkernel_interface = true;
 static bool has_inkernel_module;
@@ -190,8 +201,11 @@ static struct sock_event_handler_info data_sock[MAX_DATA_CONN];
 /* vmpressure event handler data */
 static struct event_handler_info vmpressure_hinfo[VMPRESS_LEVEL_COUNT];
 
-/* 3 memory pressure levels, 1 ctrl listen socket, 2 ctrl data socket, 1 lmk events */
-#define MAX_EPOLL_EVENTS (2 + MAX_DATA_CONN + VMPRESS_LEVEL_COUNT)
+/*
+ * 3 memory pressure levels, 1 ctrl listen socket, 2 ctrl data socket, 1 lmk events,
+ * 1 pidfd of the last killed process
+ */
+#define MAX_EPOLL_EVENTS (3 + MAX_DATA_CONN + VMPRESS_LEVEL_COUNT)
 static int epollfd;
 static int maxevents;
 
@@ -326,6 +340,8 @@ struct proc {
     int pid;
     uid_t uid;
     int oomadj;
+    /* Cached /proc/<pid>/statm fd or -1 if not opened yet */
+    int statm_fd;
     struct proc *pidhash_next;
 };
 
@@ -359,6 +375,8 @@ static uint16_t killcnt[MAX_DISTINCT_OOM_ADJ];
 static int killcnt_free_idx = 0;
 static uint32_t killcnt_total = 0;
 
+static int statm_fd_count = 0;
+
 /* PAGE_SIZE / 1024 */
 static long page_k;
 
@@ -514,6 +532,10 @@ static int pid_remove(int pid) {
         prevp->pidhash_next = procp->pidhash_next;
 
     proc_unslot(procp);
+    if (procp->statm_fd != -1) {
+        close(procp->statm_fd);
+        statm_fd_count--;
+    }
     free(procp);
     return 0;
 }
@@ -595,40 +617,37 @@ out:
     return (int)tgid;
 }
 
-static void cmd_procprio(LMKD_CTRL_PACKET packet) {
+static void set_procprio(struct lmk_procprio *params) {
     struct proc *procp;
     char path[80];
     char val[20];
     int soft_limit_mult;
-    struct lmk_procprio params;
     bool is_system_server;
     struct passwd *pwdrec;
     int tgid;
 
-    lmkd_pack_get_procprio(packet, &params);
-
-    if (params.oomadj < OOM_SCORE_ADJ_MIN ||
-        params.oomadj > OOM_SCORE_ADJ_MAX) {
-        ALOGE("Invalid PROCPRIO oomadj argument %d", params.oomadj);
+    if (params->oomadj < OOM_SCORE_ADJ_MIN ||
+        params->oomadj > OOM_SCORE_ADJ_MAX) {
+        ALOGE("Invalid PROCPRIO oomadj argument %d", params->oomadj);
         return;
     }
 
     /* Check if registered process is a thread group leader */
-    tgid = proc_get_tgid(params.pid);
-    if (tgid >= 0 && tgid != params.pid) {
+    tgid = proc_get_tgid(params->pid);
+    if (tgid >= 0 && tgid != params->pid) {
         ALOGE("Attempt to register a task that is not a thread group leader (tid %d, tgid %d)",
-            params.pid, tgid);
+            params->pid, tgid);
         return;
     }
 
     /* gid containing AID_READPROC required */
     /* CAP_SYS_RESOURCE required */
     /* CAP_DAC_OVERRIDE required */
-    snprintf(path, sizeof(path), "/proc/%d/oom_score_adj", params.pid);
-    snprintf(val, sizeof(val), "%d", params.oomadj);
+    snprintf(path, sizeof(path), "/proc/%d/oom_score_adj", params->pid);
+    snprintf(val, sizeof(val), "%d", params->oomadj);
     if (!writefilestring(path, val, false)) {
         ALOGW("Failed to open %s; errno=%d: process %d might have been killed",
-              path, errno, params.pid);
+              path, errno, params->pid);
         /* If this file does not exist the process is dead. */
         return;
     }
@@ -638,27 +657,27 @@ static void cmd_procprio(LMKD_CTRL_PACKET packet) {
     }
 
     if (per_app_memcg) {
-        if (params.oomadj >= 900) {
+        if (params->oomadj >= 900) {
             soft_limit_mult = 0;
-        } else if (params.oomadj >= 800) {
+        } else if (params->oomadj >= 800) {
             soft_limit_mult = 0;
-        } else if (params.oomadj >= 700) {
+        } else if (params->oomadj >= 700) {
             soft_limit_mult = 0;
-        } else if (params.oomadj >= 600) {
+        } else if (params->oomadj >= 600) {
             // Launcher should be perceptible, don't kill it.
-            params.oomadj = 200;
+            params->oomadj = 200;
             soft_limit_mult = 1;
-        } else if (params.oomadj >= 500) {
+        } else if (params->oomadj >= 500) {
             soft_limit_mult = 0;
-        } else if (params.oomadj >= 400) {
+        } else if (params->oomadj >= 400) {
             soft_limit_mult = 0;
-        } else if (params.oomadj >= 300) {
+        } else if (params->oomadj >= 300) {
             soft_limit_mult = 1;
-        } else if (params.oomadj >= 200) {
+        } else if (params->oomadj >= 200) {
             soft_limit_mult = 8;
-        } else if (params.oomadj >= 100) {
+        } else if (params->oomadj >= 100) {
             soft_limit_mult = 10;
-        } else if (params.oomadj >=   0) {
+        } else if (params->oomadj >=   0) {
             soft_limit_mult = 20;
         } else {
             // Persistent processes will have a large
@@ -668,20 +687,20 @@ static void cmd_procprio(LMKD_CTRL_PACKET packet) {
 
         snprintf(path, sizeof(path), MEMCG_SYSFS_PATH
                  "apps/uid_%d/pid_%d/memory.soft_limit_in_bytes",
-                 params.uid, params.pid);
+                 params->uid, params->pid);
         snprintf(val, sizeof(val), "%d", soft_limit_mult * EIGHT_MEGA);
 
         /*
          * system_server process has no memcg under /dev/memcg/apps but should be
          * registered with lmkd. This is the best way so far to identify it.
          */
-        is_system_server = (params.oomadj == SYSTEM_ADJ &&
+        is_system_server = (params->oomadj == SYSTEM_ADJ &&
                             (pwdrec = getpwnam("system")) != NULL &&
-                            params.uid == pwdrec->pw_uid);
+                            params->uid == pwdrec->pw_uid);
         writefilestring(path, val, !is_system_server);
     }
 
-    procp = pid_lookup(params.pid);
+    procp = pid_lookup(params->pid);
     if (!procp) {
             procp = malloc(sizeof(struct proc));
             if (!procp) {
@@ -689,17 +708,44 @@ static void cmd_procprio(LMKD_CTRL_PACKET packet) {
                 return;
             }
 
-            procp->pid = params.pid;
-            procp->uid = params.uid;
-            procp->oomadj = params.oomadj;
+            procp->pid = params->pid;
+            procp->uid = params->uid;
+            procp->oomadj = params->oomadj;
+            procp->statm_fd = -1;
             proc_insert(procp);
     } else {
         proc_unslot(procp);
-        procp->oomadj = params.oomadj;
+        procp->oomadj = params->oomadj;
         proc_slot(procp);
     }
 }
 
+static void cmd_procprio(LMKD_CTRL_PACKET packet) {
+    struct lmk_procprio params;
+
+    lmkd_pack_get_procprio(packet, &params);
+    set_procprio(&params);
+}
+
+static void cmd_procprio_batch(int proc_cnt, LMKD_CTRL_PACKET packet) {
+    struct lmk_procprio params[MAX_PROCPRIO_BATCH];
+    int i, j;
+
+    for (i = 0; i < proc_cnt; i++) {
+        lmkd_pack_get_procprio_batch(packet, i, &params[i]);
+    }
+
+    for (i = 0; i < proc_cnt; i++) {
+        /* Only the last update of a pid in the batch is applied */
+        for (j = i + 1; j < proc_cnt && params[j].pid != params[i].pid; j++)
+            ;
+        if (j < proc_cnt) {
+            continue;
+        }
+        set_procprio(&params[i]);
+    }
+}
+
 static void cmd_procremove(LMKD_CTRL_PACKET packet) {
     struct lmk_procremove params;
 
@@ -733,11 +779,15 @@ static void cmd_procpurge() {
         procp = pidhash[i];
         while (procp) {
             next = procp->pidhash_next;
+            if (procp->statm_fd != -1) {
+                close(procp->statm_fd);
+            }
             free(procp);
             procp = next;
         }
     }
     memset(&pidhash[0], 0, sizeof(pidhash));
+    statm_fd_count = 0;
 }
 
 static void inc_killcnt(int oomadj) {
@@ -926,6 +976,7 @@ static void ctrl_command_handler(int dsock_idx) {
     enum lmk_cmd cmd;
     int nargs;
     int targets;
+    int procs;
     int kill_cnt;
 
     len = ctrl_data_read(dsock_idx, (char *)packet, CTRL_PACKET_MAX_SIZE);
@@ -954,6 +1005,12 @@ static void ctrl_command_handler(int dsock_idx) {
             goto wronglen;
         cmd_procprio(packet);
         break;
+    case LMK_PROCPRIO_BATCH:
+        procs = nargs / 3;
+        if (nargs % 3 || procs == 0 || procs > MAX_PROCPRIO_BATCH)
+            goto wronglen;
+        cmd_procprio_batch(procs, packet);
+        break;
     case LMK_PROCREMOVE:
         if (nargs != 1)
             goto wronglen;
@@ -1267,28 +1324,42 @@ static void meminfo_log(union meminfo *mi) {
     android_log_reset(ctx);
 }
 
-static int proc_get_size(int pid) {
+/*
+ * The statm file is kept open for the lifetime of the proc record so that
+ * choosing the heaviest task under memory pressure does not need to open a
+ * file per candidate. The open file stays bound to the original process,
+ * which reports zero rss once it has died, even if its pid was reused.
+ */
+static int proc_get_size(struct proc *procp) {
     char path[PATH_MAX];
     char line[LINE_MAX];
-    int fd;
+    int fd = procp->statm_fd;
     int rss = 0;
     int total;
     ssize_t ret;
 
-    /* gid containing AID_READPROC required */
-    snprintf(path, PATH_MAX, "/proc/%d/statm", pid);
-    fd = open(path, O_RDONLY | O_CLOEXEC);
-    if (fd == -1)
-        return -1;
+    if (fd == -1) {
+        /* gid containing AID_READPROC required */
+        snprintf(path, PATH_MAX, "/proc/%d/statm", procp->pid);
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            return -1;
+        if (statm_fd_count < MAX_STATM_FDS) {
+            procp->statm_fd = fd;
+            statm_fd_count++;
+        }
+    }
 
     ret = read_all(fd, line, sizeof(line) - 1);
-    if (ret < 0) {
+    if (fd != procp->statm_fd) {
         close(fd);
+    }
+    if (ret < 0) {
         return -1;
     }
+    line[ret] = '\0';
 
     sscanf(line, "%d %d ", &total, &rss);
-    close(fd);
     return rss;
 }
 
@@ -1328,7 +1399,7 @@ static struct proc *proc_get_heaviest(int oomadj) {
     int maxsize = 0;
     while (curr != head) {
         int pid = ((struct proc *)curr)->pid;
-        int tasksize = proc_get_size(pid);
+        int tasksize = proc_get_size((struct proc *)curr);
         if (tasksize <= 0) {
             struct adjslot_list *next = curr->next;
             pid_remove(pid);
@@ -1379,7 +1450,76 @@ static void set_process_group_and_prio(int pid, SchedPolicy sp, int prio) {
     closedir(d);
 }
 
-static int last_killed_pid = -1;
+/*
+ * Last killed process. With pidfd support this is a pidfd registered with
+ * epoll that is closed as soon as the process exits, otherwise it is the pid
+ * probed in /proc.
+ */
+static int last_kill_pid_or_fd = -1;
+static struct timespec last_kill_start_tm;
+static bool pidfd_supported;
+
+static int pidfd_open(pid_t pid, unsigned int flags) {
+    return syscall(__NR_pidfd_open, pid, flags);
+}
+
+static void stop_wait_for_proc_kill(void) {
+    struct epoll_event epev;
+
+    if (last_kill_pid_or_fd < 0) {
+        return;
+    }
+
+    if (pidfd_supported) {
+        if (epoll_ctl(epollfd, EPOLL_CTL_DEL, last_kill_pid_or_fd, &epev) == -1) {
+            // Log a warning and keep going
+            ALOGW("epoll_ctl for last killed process failed; errno=%d", errno);
+        }
+        maxevents--;
+        close(last_kill_pid_or_fd);
+    }
+
+    last_kill_pid_or_fd = -1;
+}
+
+static void kill_done_handler(int data, uint32_t events __unused) {
+    struct timespec curr_tm;
+
+    /* Stale event for a pidfd already replaced by a newer kill */
+    if (data != last_kill_pid_or_fd) {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &curr_tm);
+    ALOGI("Killed process exited after %ldms",
+          get_time_diff_ms(&last_kill_start_tm, &curr_tm));
+    stop_wait_for_proc_kill();
+}
+
+static struct event_handler_info kill_done_hinfo = { 0, kill_done_handler };
+
+static void start_wait_for_proc_kill(int pid, int pidfd) {
+    struct epoll_event epev;
+
+    stop_wait_for_proc_kill();
+    clock_gettime(CLOCK_MONOTONIC, &last_kill_start_tm);
+
+    if (pidfd < 0) {
+        last_kill_pid_or_fd = pid;
+        return;
+    }
+
+    epev.events = EPOLLIN;
+    kill_done_hinfo.data = pidfd;
+    epev.data.ptr = (void *)&kill_done_hinfo;
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, pidfd, &epev) != 0) {
+        ALOGE("epoll_ctl for last kill failed; errno=%d", errno);
+        close(pidfd);
+        return;
+    }
+    maxevents++;
+    last_kill_pid_or_fd = pidfd;
+}
 
 /* Kill one process specified by procp.  Returns the size of the process killed */
 static int kill_one_process(struct proc* procp, int min_oom_score) {
@@ -1390,6 +1530,7 @@ static int kill_one_process(struct proc* procp, int min_oom_score) {
     int tasksize;
     int r;
     int result = -1;
+    int pidfd = -1;
 
 #ifdef LMKD_LOG_STATS
     struct memory_stat mem_st = {};
@@ -1410,7 +1551,7 @@ static int kill_one_process(struct proc* procp, int min_oom_score) {
         goto out;
     }
 
-    tasksize = proc_get_size(pid);
+    tasksize = proc_get_size(procp);
     if (tasksize <= 0) {
         goto out;
     }
@@ -1425,6 +1566,15 @@ static int kill_one_process(struct proc* procp, int min_oom_score) {
     }
 #endif
 
+    if (pidfd_supported) {
+        /* Taken before the kill so that it refers to the task being killed */
+        pidfd = pidfd_open(pid, 0);
+        if (pidfd < 0) {
+            ALOGE("pidfd_open for pid %d failed; errno=%d", pid, errno);
+            goto out;
+        }
+    }
+
     TRACE_KILL_START(pid);
 
     /* CAP_KILL required */
@@ -1438,12 +1588,14 @@ static int kill_one_process(struct proc* procp, int min_oom_score) {
 
     TRACE_KILL_END();
 
-    last_killed_pid = pid;
-
     if (r) {
         ALOGE("kill(%d): errno=%d", pid, errno);
+        if (pidfd >= 0) {
+            close(pidfd);
+        }
         goto out;
     } else {
+        start_wait_for_proc_kill(pid, pidfd);
 #ifdef LMKD_LOG_STATS
         if (memory_stat_parse_result == 0) {
             stats_write_lmk_kill_occurred(log_ctx, LMK_KILL_OCCURRED, uid, taskname,
@@ -1576,17 +1728,22 @@ enum vmpressure_level downgrade_level(enum vmpressure_level level) {
 static bool is_kill_pending(void) {
     char buf[24];
 
-    if (last_killed_pid < 0) {
+    if (last_kill_pid_or_fd < 0) {
         return false;
     }
 
-    snprintf(buf, sizeof(buf), "/proc/%d/", last_killed_pid);
+    if (pidfd_supported) {
+        // kill_done_handler resets the pidfd when the process exits
+        return true;
+    }
+
+    snprintf(buf, sizeof(buf), "/proc/%d/", last_kill_pid_or_fd);
     if (access(buf, F_OK) == 0) {
         return true;
     }
 
     // reset last killed PID because there's nothing pending
-    last_killed_pid = -1;
+    stop_wait_for_proc_kill();
     return false;
 }
 
@@ -1993,6 +2150,7 @@ static void init_poll_kernel() {
 
 static int init(void) {
     struct epoll_event epev;
+    int pidfd;
     int i;
     int ret;
 
@@ -2069,6 +2227,16 @@ static int init(void) {
 
     memset(killcnt_idx, KILLCNT_INVALID_IDX, sizeof(killcnt_idx));
 
+    /* Kernels before 5.3 have no pidfd_open, use /proc to track kills there */
+    pidfd = pidfd_open(getpid(), 0);
+    if (pidfd >= 0) {
+        pidfd_supported = true;
+        close(pidfd);
+    } else {
+        pidfd_supported = false;
+    }
+    ALOGI("Process polling is %s", pidfd_supported ? "supported" : "not supported");
+
     return 0;
 }
 
@@ -2140,6 +2308,16 @@ static void mainloop(void) {
                 handler_info = (struct event_handler_info*)evt->data.ptr;
                 handler_info->handler(handler_info->data, evt->events);
 
+                if (polling && handler_info->handler == kill_done_handler) {
+                    /*
+                     * Memory of the last killed process has been released,
+                     * recheck memory state right away instead of waiting
+                     * for the next polling period.
+                     */
+                    poll_handler->handler(poll_handler->data, 0);
+                    clock_gettime(CLOCK_MONOTONIC_COARSE, &last_report_tm);
+                }
+
                 if (use_psi_monitors && handler_info->handler == mp_event_common) {
                     /*
                      * Poll for the duration of PSI_WINDOW_SIZE_MS after the
@@ -39,11 +39,16 @@
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
+#include <zlib.h>
 
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <regex>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -51,6 +56,7 @@
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <cutils/sockets.h>
 #include <log/event_tag_map.h>
 #include <log/logprint.h>
@@ -110,10 +116,15 @@ struct android_logcat_context_internal {
     size_t logRotateSizeKBytes;
     // 0 means "unbounded"
     size_t maxRotatedLogs;
+    bool compressRotatedLogs;
+    // shifting the rotated logs along, off the read path
+    pthread_t rotateThread;
+    bool rotating;
     size_t outByteCount;
     int printBinary;
     int devCount;  // >1 means multiple
     std::unique_ptr<std::regex> regex;
+    std::vector<uid_t> uids;  // empty means all
     log_device_t* devices;
     EventTagMap* eventTagMap;
     // 0 means "infinite"
@@ -249,46 +260,118 @@ static void close_error(android_logcat_context_internal* context) {
     }
 }
 
-static void rotateLogs(android_logcat_context_internal* context) {
-    int err;
-
-    // Can't rotate logs if we're not outputting to a file
-    if (!context->outputFileName) return;
-
-    close_output(context);
-
+// <name>.<i>, or <name> for i == 0, with i zero padded to the digits
+// needed to count up to maxRotatedLogs.
+static std::string rotatedLogName(const char* name, size_t maxRotatedLogs, size_t i) {
     // Compute the maximum number of digits needed to count up to
     // maxRotatedLogs in decimal.  eg:
     // maxRotatedLogs == 30
     //   -> log10(30) == 1.477
     //   -> maxRotationCountDigits == 2
     int maxRotationCountDigits =
-        (context->maxRotatedLogs > 0)
-            ? (int)(floor(log10(context->maxRotatedLogs) + 1))
-            : 0;
+        (maxRotatedLogs > 0) ? (int)(floor(log10(maxRotatedLogs) + 1)) : 0;
 
-    for (int i = context->maxRotatedLogs; i > 0; i--) {
-        std::string file1 = android::base::StringPrintf(
-            "%s.%.*d", context->outputFileName, maxRotationCountDigits, i);
+    if (!i) return name;
+    return android::base::StringPrintf("%s.%.*zu", name, maxRotationCountDigits, i);
+}
 
-        std::string file0;
-        if (!(i - 1)) {
-            file0 = android::base::StringPrintf("%s", context->outputFileName);
-        } else {
-            file0 =
-                android::base::StringPrintf("%s.%.*d", context->outputFileName,
-                                            maxRotationCountDigits, i - 1);
-        }
+// The output file moves here on rotation, until it is shifted to <name>.1.
+static std::string stagedLogName(const char* name) {
+    return std::string(name) + ".rotating";
+}
+
+static void renameRotatedLog(const std::string& from, const std::string& to) {
+    if (rename(from.c_str(), to.c_str()) < 0 && errno != ENOENT) {
+        perror("while rotating log files");
+    }
+}
 
-        if (!file0.length() || !file1.length()) {
-            perror("while rotating log files");
+static bool compressLog(const std::string& name) {
+    std::string compressed = name + ".gz";
+    std::string tmp = compressed + ".tmp";
+
+    android::base::unique_fd in(open(name.c_str(), O_RDONLY | O_CLOEXEC));
+    if (in < 0) return false;
+    gzFile out = gzopen(tmp.c_str(), "wbe");
+    if (!out) return false;
+
+    char buf[64 * 1024];
+    ssize_t len;
+    bool ok = true;
+    while ((len = TEMP_FAILURE_RETRY(read(in, buf, sizeof(buf)))) > 0) {
+        if (gzwrite(out, buf, len) != len) {
+            ok = false;
             break;
         }
+    }
+    if (len < 0) ok = false;
+    if (gzclose(out) != Z_OK) ok = false;
+
+    if (!ok || rename(tmp.c_str(), compressed.c_str()) < 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    unlink(name.c_str());
+    return true;
+}
 
-        err = rename(file0.c_str(), file1.c_str());
+// Shifts <name>.<i> to <name>.<i+1>, dropping the oldest, and moves the
+// staged output file to <name>.1.
+static void shiftRotatedLogs(const char* name, size_t maxRotatedLogs, bool compress) {
+    for (size_t i = maxRotatedLogs; i > 1; i--) {
+        std::string file1 = rotatedLogName(name, maxRotatedLogs, i);
+        std::string file0 = rotatedLogName(name, maxRotatedLogs, i - 1);
+        renameRotatedLog(file0, file1);
+        renameRotatedLog(file0 + ".gz", file1 + ".gz");
+    }
 
-        if (err < 0 && errno != ENOENT) {
-            perror("while rotating log files");
+    std::string first = rotatedLogName(name, maxRotatedLogs, 1);
+    renameRotatedLog(stagedLogName(name), first);
+    if (compress && !compressLog(first)) {
+        perror("while compressing rotated log file");
+    }
+}
+
+struct RotateArgs {
+    const char* name;
+    size_t maxRotatedLogs;
+    bool compress;
+};
+
+static void* rotateThreadStart(void* obj) {
+    std::unique_ptr<RotateArgs> args(static_cast<RotateArgs*>(obj));
+    shiftRotatedLogs(args->name, args->maxRotatedLogs, args->compress);
+    return nullptr;
+}
+
+// Waits for the rotated logs to be shifted along, if they still are.
+static void finishRotation(android_logcat_context_internal* context) {
+    if (!context->rotating) return;
+    pthread_join(context->rotateThread, nullptr);
+    context->rotating = false;
+}
+
+// Only the output file is moved out of the way here; renaming the chain of
+// rotated logs, and compressing them, happens on another thread so that
+// logcat carries on draining logd meanwhile.
+static void rotateLogs(android_logcat_context_internal* context) {
+    // Can't rotate logs if we're not outputting to a file
+    if (!context->outputFileName) return;
+
+    // The previous rotation has to be done with the staged file.
+    finishRotation(context);
+
+    close_output(context);
+
+    if (context->maxRotatedLogs > 0) {
+        renameRotatedLog(context->outputFileName, stagedLogName(context->outputFileName));
+
+        auto args = new RotateArgs{context->outputFileName, context->maxRotatedLogs,
+                                   context->compressRotatedLogs};
+        if (!pthread_create(&context->rotateThread, nullptr, rotateThreadStart, args)) {
+            context->rotating = true;
+        } else {
+            rotateThreadStart(args);
         }
     }
 
@@ -325,42 +408,73 @@ static bool regexOk(android_logcat_context_internal* context,
     return std::regex_search(entry.message, entry.message + entry.messageLen, *context->regex);
 }
 
-static void processBuffer(android_logcat_context_internal* context,
-                          log_device_t* dev, struct log_msg* buf) {
-    int bytesWritten = 0;
+static bool uidOk(android_logcat_context_internal* context,
+                  struct log_msg* buf) {
+    if (context->uids.empty()) return true;
+    if (buf->entry.hdr_size < sizeof(buf->entry_v4)) return true;
+
+    return std::find(context->uids.begin(), context->uids.end(),
+                     buf->entry_v4.uid) != context->uids.end();
+}
+
+// Decode buf into entry, unless the filterspecs reject it. Binary entries
+// are checked on their tag before their payload is formatted.
+static bool prepareBuffer(android_logcat_context_internal* context,
+                          log_device_t* dev, struct log_msg* buf,
+                          AndroidLogEntry* entry, char* binaryMsgBuf,
+                          size_t binaryMsgBufLen) {
     int err;
-    AndroidLogEntry entry;
-    char binaryMsgBuf[1024];
 
     if (dev->binary) {
         if (!context->eventTagMap && !context->hasOpenedEventTagMap) {
             context->eventTagMap = android_openEventTagMap(nullptr);
             context->hasOpenedEventTagMap = true;
         }
+        size_t tagLen;
+        const char* tag = nullptr;
+        if (context->eventTagMap && (buf->entry.len >= sizeof(uint32_t))) {
+            uint32_t tagIndex;
+            memcpy(&tagIndex, buf->msg(), sizeof(tagIndex));
+            tag = android_lookupEventTag_len(context->eventTagMap, &tagLen,
+                                             tagIndex);
+        }
+        if (tag) {
+            android_LogPriority priority = (buf->id() == LOG_ID_SECURITY)
+                                               ? ANDROID_LOG_WARN
+                                               : ANDROID_LOG_INFO;
+            if (!android_log_shouldPrintLine(context->logformat,
+                                             std::string(tag, tagLen).c_str(),
+                                             priority)) {
+                return false;
+            }
+        }
         err = android_log_processBinaryLogBuffer(
-            &buf->entry_v1, &entry, context->eventTagMap, binaryMsgBuf,
-            sizeof(binaryMsgBuf));
+            &buf->entry_v1, entry, context->eventTagMap, binaryMsgBuf,
+            binaryMsgBufLen);
         // printf(">>> pri=%d len=%d msg='%s'\n",
-        //    entry.priority, entry.messageLen, entry.message);
+        //    entry->priority, entry->messageLen, entry->message);
     } else {
-        err = android_log_processLogBuffer(&buf->entry_v1, &entry);
+        err = android_log_processLogBuffer(&buf->entry_v1, entry);
     }
-    if ((err < 0) && !context->debug) return;
+    if ((err < 0) && !context->debug) return false;
 
-    if (android_log_shouldPrintLine(
-            context->logformat, std::string(entry.tag, entry.tagLen).c_str(),
-            entry.priority)) {
-        bool match = regexOk(context, entry);
+    return android_log_shouldPrintLine(
+        context->logformat, std::string(entry->tag, entry->tagLen).c_str(),
+        entry->priority);
+}
 
-        context->printCount += match;
-        if (match || context->printItAnyways) {
-            bytesWritten = android_log_printLogLine(context->logformat,
-                                                    context->output_fd, &entry);
+static void printBuffer(android_logcat_context_internal* context,
+                        const AndroidLogEntry& entry, bool match) {
+    int bytesWritten = 0;
 
-            if (bytesWritten < 0) {
-                logcat_panic(context, HELP_FALSE, "output error");
-                return;
-            }
+    context->printCount += match;
+    if (match || context->printItAnyways) {
+        bytesWritten = android_log_printLogLine(context->logformat,
+                                                context->output_fd, &entry);
+
+        if (bytesWritten < 0) {
+            logcat_panic(context, HELP_FALSE, "output error");
+            return;
         }
     }
 
@@ -372,6 +486,18 @@ static void processBuffer(android_logcat_context_internal* context,
     }
 }
 
+static void processBuffer(android_logcat_context_internal* context,
+                          log_device_t* dev, struct log_msg* buf) {
+    AndroidLogEntry entry;
+    char binaryMsgBuf[1024];
+
+    if (!prepareBuffer(context, dev, buf, &entry, binaryMsgBuf,
+                       sizeof(binaryMsgBuf))) {
+        return;
+    }
+    printBuffer(context, entry, regexOk(context, entry));
+}
+
 static void maybePrintStart(android_logcat_context_internal* context,
                             log_device_t* dev, bool printDividers) {
     if (!dev->printed || printDividers) {
@@ -388,6 +514,146 @@ static void maybePrintStart(android_logcat_context_internal* context,
     }
 }
 
+// When dumping with --regex, entries are read ahead into a batch of slots
+// and the expression is matched against the whole batch by a pool of
+// threads; the batch is then printed in order.
+static const size_t regexBatchSize = 256;
+static const unsigned regexThreadsMax = 4;
+
+struct FilterSlot {
+    struct log_msg msg;
+    log_device_t* dev;
+    AndroidLogEntry entry;
+    bool candidate;  // passed the filterspecs, regex to be matched
+    bool match;
+    char binaryMsgBuf[1024];
+};
+
+class RegexPool {
+   public:
+    RegexPool(const std::regex& regex, unsigned threads);
+    ~RegexPool();
+    RegexPool(const RegexPool&) = delete;
+    RegexPool& operator=(const RegexPool&) = delete;
+
+    // Sets match for the candidates, the caller's thread takes part.
+    void match(FilterSlot* slots, size_t count);
+
+   private:
+    static const size_t chunk = 16;
+
+    void work();
+    void matchSome(FilterSlot* slots, size_t count);
+
+    const std::regex& mRegex;
+    std::mutex mLock;
+    std::condition_variable mStart;
+    std::condition_variable mDone;
+    // Batch on offer to the workers, mCount is zero once it is withdrawn.
+    FilterSlot* mSlots = nullptr;
+    size_t mCount = 0;
+    std::atomic<size_t> mNext{0};
+    uint64_t mGeneration = 0;
+    size_t mBusy = 0;
+    bool mExiting = false;
+    std::vector<std::thread> mThreads;
+};
+
+RegexPool::RegexPool(const std::regex& regex, unsigned threads) : mRegex(regex) {
+    for (unsigned i = 0; i < threads; ++i) {
+        mThreads.emplace_back(&RegexPool::work, this);
+    }
+}
+
+RegexPool::~RegexPool() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mExiting = true;
+    }
+    mStart.notify_all();
+    for (auto& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void RegexPool::matchSome(FilterSlot* slots, size_t count) {
+    size_t i;
+    while ((i = mNext.fetch_add(chunk)) < count) {
+        for (size_t end = std::min(i + chunk, count); i < end; ++i) {
+            FilterSlot& slot = slots[i];
+            if (!slot.candidate) continue;
+            slot.match = std::regex_search(
+                slot.entry.message, slot.entry.message + slot.entry.messageLen,
+                mRegex);
+        }
+    }
+}
+
+void RegexPool::work() {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mLock);
+    while (true) {
+        mStart.wait(lock, [this, &seen] {
+            return mExiting || (mCount && (mGeneration != seen));
+        });
+        if (mExiting) return;
+        seen = mGeneration;
+        FilterSlot* slots = mSlots;
+        size_t count = mCount;
+        ++mBusy;
+        lock.unlock();
+        matchSome(slots, count);
+        lock.lock();
+        if (!--mBusy) mDone.notify_one();
+    }
+}
+
+void RegexPool::match(FilterSlot* slots, size_t count) {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mSlots = slots;
+        mCount = count;
+        mNext = 0;
+        ++mGeneration;
+    }
+    mStart.notify_all();
+    matchSome(slots, count);
+
+    // Withdraw the batch, then wait for the workers that took part in it.
+    std::unique_lock<std::mutex> lock(mLock);
+    mSlots = nullptr;
+    mCount = 0;
+    mDone.wait(lock, [this] { return !mBusy; });
+}
+
+static void processSlots(android_logcat_context_internal* context,
+                         RegexPool* pool, FilterSlot* slots, size_t count,
+                         log_device_t** dev, bool printDividers) {
+    for (size_t i = 0; i < count; ++i) {
+        FilterSlot& slot = slots[i];
+        slot.candidate = prepareBuffer(context, slot.dev, &slot.msg,
+                                       &slot.entry, slot.binaryMsgBuf,
+                                       sizeof(slot.binaryMsgBuf));
+        slot.match = false;
+    }
+
+    pool->match(slots, count);
+
+    for (size_t i = 0; i < count; ++i) {
+        if (context->stop) break;
+        if (context->maxCount && (context->printCount >= context->maxCount)) {
+            break;
+        }
+        FilterSlot& slot = slots[i];
+        if (*dev != slot.dev) {
+            *dev = slot.dev;
+            maybePrintStart(context, *dev, printDividers);
+            if (context->stop) break;
+        }
+        if (slot.candidate) printBuffer(context, slot.entry, slot.match);
+    }
+}
+
 static void setupOutputAndSchedulingPolicy(
     android_logcat_context_internal* context, bool blocking) {
     if (!context->outputFileName) return;
@@ -414,6 +680,13 @@ static void setupOutputAndSchedulingPolicy(
 
     close_output(context);
 
+    // A previous logcat was interrupted in the middle of a rotation.
+    if (context->maxRotatedLogs > 0 &&
+        !access(stagedLogName(context->outputFileName).c_str(), F_OK)) {
+        shiftRotatedLogs(context->outputFileName, context->maxRotatedLogs,
+                         context->compressRotatedLogs);
+    }
+
     context->output_fd = openLogFile(context->outputFileName, context->logRotateSizeKBytes);
 
     if (context->output_fd < 0) {
@@ -455,6 +728,8 @@ static void show_help(android_logcat_context_internal* context) {
                     "                  Rotate log every kbytes. Requires -f option\n"
                     "  -n <count>, --rotate-count=<count>\n"
                     "                  Sets max number of rotated logs to <count>, default 4\n"
+                    "  --rotate-compress\n"
+                    "                  gzip rotated logs, as <file>.<n>.gz\n"
                     "  --id=<id>       If the signature id for logging to file changes, then clear\n"
                     "                  the fileset and continue\n"
                     "  -v <format>, --format=<format>\n"
@@ -510,6 +785,8 @@ static void show_help(android_logcat_context_internal* context) {
                     "                  Set prune white and ~black list, using same format as\n"
                     "                  listed above. Must be quoted.\n"
                     "  --pid=<pid>     Only prints logs from the given pid.\n"
+                    "  --uid=<uids>    Only prints logs from the given comma separated list of\n"
+                    "                  numeric uids.\n"
                     // Check ANDROID_LOG_WRAP_DEFAULT_TIMEOUT value for match to 2 hours
                     "  --wrap          Sleep for 2 hours or when buffer about to wrap whichever\n"
                     "                  comes first. Improves efficiency of polling by providing\n"
@@ -757,6 +1034,9 @@ static int __logcat(android_logcat_context_internal* context) {
 
     // object instantiations before goto's can happen
     log_device_t unexpected("unexpected", false);
+    std::unique_ptr<RegexPool> regexPool;
+    std::vector<FilterSlot> slots;
+    size_t slotCount = 0;
     const char* openDeviceFail = nullptr;
     const char* clearFail = nullptr;
     const char* setSizeFail = nullptr;
@@ -871,6 +1151,8 @@ static int __logcat(android_logcat_context_internal* context) {
         static const char id_str[] = "id";
         static const char wrap_str[] = "wrap";
         static const char print_str[] = "print";
+        static const char uid_str[] = "uid";
+        static const char rotate_compress_str[] = "rotate-compress";
         // clang-format off
         static const struct option long_options[] = {
           { "binary",        no_argument,       nullptr, 'B' },
@@ -893,11 +1175,13 @@ static int __logcat(android_logcat_context_internal* context) {
           { print_str,       no_argument,       nullptr, 0 },
           { "prune",         optional_argument, nullptr, 'p' },
           { "regex",         required_argument, nullptr, 'e' },
+          { rotate_compress_str, no_argument,   nullptr, 0 },
           { "rotate-count",  required_argument, nullptr, 'n' },
           { "rotate-kbytes", required_argument, nullptr, 'r' },
           { "statistics",    no_argument,       nullptr, 'S' },
           // hidden and undocumented reserved alias for -t
           { "tail",          required_argument, nullptr, 't' },
+          { uid_str,         required_argument, nullptr, 0 },
           // support, but ignore and do not document, the optional argument
           { wrap_str,        optional_argument, nullptr, 0 },
           { nullptr,         0,                 nullptr, 0 }
@@ -948,6 +1232,23 @@ static int __logcat(android_logcat_context_internal* context) {
                     context->printItAnyways = true;
                     break;
                 }
+                if (long_options[option_index].name == uid_str) {
+                    std::vector<std::string> uids = android::base::Split(optarg, ",");
+                    for (const auto& uid : uids) {
+                        size_t val;
+                        if (!getSizeTArg(uid.c_str(), &val, 0, UINT32_MAX)) {
+                            logcat_panic(context, HELP_TRUE, "%s %s out of range\n",
+                                         long_options[option_index].name, optarg);
+                            goto exit;
+                        }
+                        context->uids.push_back(val);
+                    }
+                    break;
+                }
+                if (long_options[option_index].name == rotate_compress_str) {
+                    context->compressRotatedLogs = true;
+                    break;
+                }
                 if (long_options[option_index].name == debug_str) {
                     context->debug = true;
                     break;
@@ -1427,6 +1728,16 @@ static int __logcat(android_logcat_context_internal* context) {
     } else {
         logger_list = android_logger_list_alloc(mode, tail_lines, pid);
     }
+    // Let logd drop what we would not print anyways. Binary output is not
+    // subject to the filterspecs.
+    if (logger_list) {
+        android_LogPriority prio = context->printBinary
+                                       ? ANDROID_LOG_VERBOSE
+                                       : android_log_minPrintPriority(context->logformat);
+        size_t uidCount = context->uids.size();
+        if (uidCount > LOGGER_LIST_MAX_UIDS) uidCount = 0;
+        __android_logger_list_set_filter(logger_list, prio, context->uids.data(), uidCount);
+    }
     // We have three orthogonal actions below to clear, set log size and
     // get log size. All sharing the same iteration loop.
     while (dev) {
@@ -1441,28 +1752,16 @@ static int __logcat(android_logcat_context_internal* context) {
 
         if (clearLog || setId) {
             if (context->outputFileName) {
-                int maxRotationCountDigits =
-                    (context->maxRotatedLogs > 0) ?
-                        (int)(floor(log10(context->maxRotatedLogs) + 1)) :
-                        0;
-
+                std::vector<std::string> files;
                 for (int i = context->maxRotatedLogs ; i >= 0 ; --i) {
-                    std::string file;
-
-                    if (!i) {
-                        file = android::base::StringPrintf(
-                            "%s", context->outputFileName);
-                    } else {
-                        file = android::base::StringPrintf("%s.%.*d",
-                            context->outputFileName, maxRotationCountDigits, i);
-                    }
-
-                    if (!file.length()) {
-                        perror("while clearing log files");
-                        reportErrorName(&clearFail, dev->device, allSelected);
-                        break;
-                    }
+                    std::string file = rotatedLogName(context->outputFileName,
+                                                      context->maxRotatedLogs, i);
+                    files.push_back(file + ".gz");
+                    files.push_back(file);
+                }
+                files.push_back(stagedLogName(context->outputFileName));
 
+                for (const auto& file : files) {
                     err = unlink(file.c_str());
 
                     if (err < 0 && errno != ENOENT && !clearFail) {
@@ -1609,10 +1908,24 @@ static int __logcat(android_logcat_context_internal* context) {
 
     dev = nullptr;
 
+    if (context->regex && (mode & ANDROID_LOG_NONBLOCK) && !context->printBinary) {
+        unsigned threads = std::min(std::thread::hardware_concurrency(), regexThreadsMax);
+        if (threads > 1) {
+            regexPool.reset(new RegexPool(*context->regex, threads - 1));
+            slots.resize(regexBatchSize);
+        }
+    }
+
     while (!context->stop &&
            (!context->maxCount || (context->printCount < context->maxCount))) {
         struct log_msg log_msg;
         int ret = android_logger_list_read(logger_list, &log_msg);
+        if ((ret <= 0) && slotCount) {
+            // Print what was read ahead before reporting an error.
+            processSlots(context, regexPool.get(), slots.data(), slotCount, &dev,
+                         printDividers);
+            slotCount = 0;
+        }
         if (!ret) {
             logcat_panic(context, HELP_FALSE, "read: unexpected EOF!\n");
             break;
@@ -1643,6 +1956,20 @@ static int __logcat(android_logcat_context_internal* context) {
             d->binary = log_msg.id() == LOG_ID_EVENTS;
         }
 
+        if (!uidOk(context, &log_msg)) continue;
+
+        if (regexPool) {
+            FilterSlot& slot = slots[slotCount++];
+            slot.msg = log_msg;
+            slot.dev = d;
+            if (slotCount == slots.size()) {
+                processSlots(context, regexPool.get(), slots.data(), slotCount, &dev,
+                             printDividers);
+                slotCount = 0;
+            }
+            continue;
+        }
+
         if (dev != d) {
             dev = d;
             maybePrintStart(context, dev, printDividers);
@@ -1654,6 +1981,9 @@ static int __logcat(android_logcat_context_internal* context) {
             processBuffer(context, dev, &log_msg);
         }
     }
+    if (slotCount) {
+        processSlots(context, regexPool.get(), slots.data(), slotCount, &dev, printDividers);
+    }
 
 close:
     // Short and sweet. Implemented generic version in android_logcat_destroy.
@@ -1664,6 +1994,7 @@ close:
     android_logger_list_free(logger_list);
 
 exit:
+    android::finishRotation(context);
     // close write end of pipe to help things along
     if (context->output_fd == context->fds[1]) {
         android::close_output(context);
@@ -1718,6 +2049,7 @@ int android_logcat_destroy(android_logcat_context* ctx) {
     context->args.clear();
     context->envp_hold.clear();
     context->envs.clear();
+    context->uids.clear();
     if (context->fds[0] >= 0) {
         close(context->fds[0]);
         context->fds[0] = -1;
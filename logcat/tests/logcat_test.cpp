@@ -1474,6 +1474,79 @@ TEST(logcat, maxcount) {
     ASSERT_EQ(3, count);
 }
 
+// Enough matches to span several read ahead batches, which are matched in
+// parallel, yet must be printed in order and stop at the exact count.
+TEST(logcat, regex_maxcount_order) {
+    FILE* fp;
+    int count = 0;
+
+    char buffer[BIG_BUFFER];
+#define logcat_order_prefix logcat_executable "_order"
+
+    static const int messages = 1000;
+    static const int matches = 300;
+    for (int i = 0; i < messages; ++i) {
+        LOG_FAILURE_RETRY(__android_log_print(ANDROID_LOG_WARN, logcat_order_prefix,
+                                              logcat_order_prefix "_%s_%d",
+                                              (i % 2) ? "odd" : "even", i));
+    }
+    rest();
+
+    snprintf(buffer, sizeof(buffer),
+             logcat_executable " --pid %d -d -v brief -m %d -e " logcat_order_prefix
+                               "_even_ -s " logcat_order_prefix,
+             getpid(), matches);
+    ASSERT_TRUE(NULL != (fp = popen(buffer, "r")));
+
+    while (fgets(buffer, sizeof(buffer), fp)) {
+        if (!strncmp(begin, buffer, sizeof(begin) - 1)) {
+            continue;
+        }
+
+        const char* cp = strstr(buffer, logcat_order_prefix "_even_");
+        ASSERT_TRUE(cp != NULL);
+        EXPECT_EQ(count * 2, atoi(cp + strlen(logcat_order_prefix "_even_")));
+
+        count++;
+    }
+
+    pclose(fp);
+
+    ASSERT_EQ(matches, count);
+}
+
+TEST(logcat, uid) {
+    FILE* fp;
+
+#undef LOG_TAG
+#define LOG_TAG "inject.uid"
+    ALOGE(logcat_executable);
+    rest();
+
+    for (uid_t uid : { getuid(), getuid() + 1 }) {
+        std::string command = android::base::StringPrintf(
+            logcat_executable " --pid=%d --uid=%u -d -s inject.uid 2>/dev/null",
+            getpid(), uid);
+        ASSERT_TRUE(NULL != (fp = popen(command.c_str(), "r")));
+
+        char buffer[BIG_BUFFER];
+
+        int count = 0;
+
+        while (fgets(buffer, sizeof(buffer), fp)) {
+            if (strncmp(begin, buffer, sizeof(begin) - 1)) ++count;
+        }
+
+        pclose(fp);
+
+        if (uid == getuid()) {
+            EXPECT_GE(count, 1);
+        } else {
+            EXPECT_EQ(0, count);
+        }
+    }
+}
+
 static bool End_to_End(const char* tag, const char* fmt, ...)
 #if defined(__GNUC__)
     __attribute__((__format__(printf, 2, 3)))
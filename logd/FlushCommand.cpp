@@ -62,7 +62,7 @@ void FlushCommand::runSocketCommand(SocketClient* client) {
                     return;
                 }
             }
-            entry->triggerReader_Locked();
+            entry->notifyNewLog_Locked();
             LogTimeEntry::unlock();
             return;
         }
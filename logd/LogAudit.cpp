@@ -54,7 +54,11 @@ LogAudit::LogAudit(LogBuffer* buf, LogReader* reader, int fdDmesg)
                                               BOOL_DEFAULT_TRUE)),
       events(__android_logger_property_get_bool("ro.logd.auditd.events",
                                                 BOOL_DEFAULT_TRUE)),
-      initialized(false) {
+      coalesce(__android_logger_property_get_bool("ro.logd.auditd.coalesce",
+                                                  BOOL_DEFAULT_FALSE)),
+      initialized(false),
+      lastRecordTime(log_time::EPOCH),
+      suppressed(0) {
     static const char auditd_message[] = { KMSG_PRIORITY(LOG_INFO),
                                            'l',
                                            'o',
@@ -195,13 +199,21 @@ int LogAudit::logPrint(const char* fmt, ...) {
     // Work around kernels missing
     // https://github.com/torvalds/linux/commit/b8f89caafeb55fba75b74bea25adc4e4cd91be67
     // Such kernels improperly add newlines inside audit messages.
-    while ((cp = strchr(str, '\n'))) {
-        *cp = ' ';
+    // Turn those into spaces and squash runs of spaces in a single pass.
+    char* out = str;
+    for (cp = str; *cp; ++cp) {
+        char c = (*cp == '\n') ? ' ' : *cp;
+        if ((c != ' ') || (out == str) || (out[-1] != ' ')) {
+            *out++ = c;
+        }
     }
+    *out = '\0';
 
-    while ((cp = strstr(str, "  "))) {
-        memmove(cp, cp + 1, strlen(cp + 1) + 1);
+    if (coalesce && isDuplicate(str)) {
+        free(str);
+        return 0;
     }
+
     pid_t pid = getpid();
     pid_t tid = gettid();
     uid_t uid = AID_LOGD;
@@ -374,6 +386,67 @@ int LogAudit::logPrint(const char* fmt, ...) {
     return rc;
 }
 
+bool LogAudit::isDuplicate(const char* str) {
+    // Records only differ by their audit(<time>:<serial>) stamp when repeated.
+    static const char audit_str[] = " audit(";
+    const char* stamp = strstr(str, audit_str);
+    const char* rest = stamp ? strstr(stamp, "):") : nullptr;
+    if (rest) {
+        record.assign(str, stamp - str);
+        record.append(rest);
+    } else {
+        record.assign(str);
+    }
+
+    log_time now(CLOCK_MONOTONIC);
+    if ((record == lastRecord) && (suppressed < UINT16_MAX) &&
+        ((now.nsec() - lastRecordTime.nsec()) < kCoalesceWindowNs)) {
+        ++suppressed;
+        return true;
+    }
+
+    logSuppressed();
+    lastRecord.swap(record);
+    lastRecordTime = now;
+    return false;
+}
+
+void LogAudit::logSuppressed() {
+    if (!suppressed) {
+        return;
+    }
+
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "%u duplicate messages suppressed", suppressed);
+    suppressed = 0;
+
+    if ((fdDmesg >= 0) && initialized) {
+        static const char log_info[] = { KMSG_PRIORITY(LOG_INFO) };
+        static const char tag[] = "logd.auditd: ";
+        struct iovec iov[4] = {
+            { const_cast<char*>(log_info), sizeof(log_info) },
+            { const_cast<char*>(tag), strlen(tag) },
+            { buf, static_cast<size_t>(len) },
+            { const_cast<char*>("\n"), 1 },
+        };
+        writev(fdDmesg, iov, arraysize(iov));
+    }
+
+    if (main) {
+        static const char tag[] = "auditd";
+        char newstr[1 + sizeof(tag) + len + 1];
+        *newstr = ANDROID_LOG_INFO;
+        memcpy(newstr + 1, tag, sizeof(tag));
+        memcpy(newstr + 1 + sizeof(tag), buf, len + 1);
+
+        pid_t pid = getpid();
+        if (logbuf->log(LOG_ID_MAIN, log_time(CLOCK_REALTIME), AID_LOGD, pid, gettid(), newstr,
+                        sizeof(newstr)) >= 0) {
+            reader->notifyNewLog(1 << LOG_ID_MAIN);
+        }
+    }
+}
+
 int LogAudit::log(char* buf, size_t len) {
     char* audit = strstr(buf, " audit(");
     if (!audit || (audit >= &buf[len])) {
@@ -18,6 +18,7 @@
 #define _LOGD_LOG_AUDIT_H__
 
 #include <map>
+#include <string>
 
 #include <sysutils/SocketListener.h>
 
@@ -31,8 +32,17 @@ class LogAudit : public SocketListener {
     int fdDmesg;  // fdDmesg >= 0 is functionally bool dmesg
     bool main;
     bool events;
+    bool coalesce;
     bool initialized;
 
+    // Identical records arriving within this window of the first one are
+    // only counted, see isDuplicate().
+    static constexpr uint64_t kCoalesceWindowNs = 1000000000ULL;
+    std::string record;
+    std::string lastRecord;
+    log_time lastRecordTime;
+    unsigned suppressed;
+
    public:
     LogAudit(LogBuffer* buf, LogReader* reader, int fdDmesg);
     int log(char* buf, size_t len);
@@ -49,6 +59,8 @@ class LogAudit : public SocketListener {
     std::string denialParse(const std::string& denial, char terminator,
                             const std::string& search_term);
     void auditParse(const std::string& string, uid_t uid, std::string* bug_num);
+    bool isDuplicate(const char* str);
+    void logSuppressed();
     int logPrint(const char* fmt, ...)
         __attribute__((__format__(__printf__, 2, 3)));
 };
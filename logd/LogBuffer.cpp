@@ -26,7 +26,10 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <new>
 #include <unordered_map>
+#include <vector>
 
 #include <cutils/properties.h>
 #include <private/android_logger.h>
@@ -72,10 +75,7 @@ void LogBuffer::init() {
         // as the act of mounting /data would trigger persist.logd.timestamp to
         // be corrected. 1/30 corner case YMMV.
         //
-        rdlock();
-        LogBufferElementCollection::iterator it = mLogElements.begin();
-        while ((it != mLogElements.end())) {
-            LogBufferElement* e = *it;
+        auto fixup = [this](LogBufferElement* e) {
             if (monotonic) {
                 if (!android::isMonotonic(e->mRealTime)) {
                     LogKlog::convertRealToMonotonic(e->mRealTime);
@@ -91,8 +91,31 @@ void LogBuffer::init() {
                     }
                 }
             }
+        };
+        rdlock();
+        LogBufferElementCollection::iterator it = mLogElements.begin();
+        while ((it != mLogElements.end())) {
+            fixup(*it);
             ++it;
         }
+        log_id_for_each(i) {
+            for (size_t r = mRing[i].begin(); r != LogRing::npos;
+                 r = mRing[i].next(r)) {
+                fixup(mRing[i].element(r));
+            }
+            LogHistory& history = mHistory[i];
+            std::vector<char> run;
+            for (size_t c = 0; c < history.size(); ++c) {
+                if (!history.unseal(history[c], &run)) {
+                    continue;
+                }
+                for (size_t r = 0; r < run.size();
+                     r = LogRing::runNext(run.data(), r)) {
+                    fixup(LogRing::runElement(run.data(), r));
+                }
+                history.reseal(c, run);
+            }
+        }
         unlock();
     }
 
@@ -114,8 +137,19 @@ void LogBuffer::init() {
 }
 
 LogBuffer::LogBuffer(LastLogTimes* times)
-    : monotonic(android_log_clockid() == CLOCK_MONOTONIC), mTimes(*times) {
+    : mSinceIndexed(0),
+      monotonic(android_log_clockid() == CLOCK_MONOTONIC),
+      mHavePending(false),
+      mRingBuffer(__android_logger_property_get_bool(
+          "logd.ring_buffer", BOOL_DEFAULT_FALSE | BOOL_DEFAULT_FLAG_PERSIST)),
+      mSequence(1),
+      mCompress(mRingBuffer &&
+                __android_logger_property_get_bool(
+                    "logd.ring_buffer.compress",
+                    BOOL_DEFAULT_FALSE | BOOL_DEFAULT_FLAG_PERSIST)),
+      mTimes(*times) {
     pthread_rwlock_init(&mLogElementsLock, nullptr);
+    pthread_mutex_init(&mPendingLock, nullptr);
 
     log_id_for_each(i) {
         lastLoggedElements[i] = nullptr;
@@ -126,6 +160,9 @@ LogBuffer::LogBuffer(LastLogTimes* times)
 }
 
 LogBuffer::~LogBuffer() {
+    for (const PendingElement& p : mPending) {
+        delete p.element;
+    }
     log_id_for_each(i) {
         delete lastLoggedElements[i];
         delete droppedElements[i];
@@ -198,6 +235,16 @@ static enum match_type identical(LogBufferElement* elem,
 
 int LogBuffer::log(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
                    pid_t tid, const char* msg, uint16_t len) {
+    return accept(log_id, realtime, uid, pid, tid, msg, len, true);
+}
+
+int LogBuffer::logBatched(log_id_t log_id, log_time realtime, uid_t uid,
+                          pid_t pid, pid_t tid, const char* msg, uint16_t len) {
+    return accept(log_id, realtime, uid, pid, tid, msg, len, false);
+}
+
+int LogBuffer::accept(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
+                      pid_t tid, const char* msg, uint16_t len, bool commitNow) {
     if (log_id >= LOG_ID_MAX) {
         return -EINVAL;
     }
@@ -226,15 +273,86 @@ int LogBuffer::log(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
         if (!__android_log_is_loggable_len(prio, tag, tag_len,
                                            ANDROID_LOG_VERBOSE)) {
             // Log traffic received to total
-            wrlock();
-            stats.addTotal(elem);
-            unlock();
-            delete elem;
+            stage(elem, false, commitNow);
             return -EACCES;
         }
     }
 
-    wrlock();
+    stage(elem, true, commitNow);
+    return len;
+}
+
+// Queue elem to be committed in arrival order, then try to commit it along
+// with anything else pending. If the lock is held, by readers or another
+// writer, the holder commits on its way out in unlock() instead.
+void LogBuffer::stage(LogBufferElement* elem, bool loggable, bool commitNow) {
+    pthread_mutex_lock(&mPendingLock);
+    mPending.push_back({elem, pthread_self(), loggable});
+    mHavePending = true;
+    pthread_mutex_unlock(&mPendingLock);
+
+    if (commitNow) {
+        commitPending();
+    }
+}
+
+// Entries staged by the calling thread are reported to the readers by the
+// caller, everything else is committed on behalf of writers that have moved
+// on, so the readers watching must be triggered here.
+void LogBuffer::commitPending() {
+    // Pairs with the fence in unlock(), either the holder sees the staged
+    // entry or we see the lock released.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (mHavePending) {
+        if (pthread_rwlock_trywrlock(&mLogElementsLock)) {
+            return;
+        }
+
+        pthread_mutex_lock(&mPendingLock);
+        std::vector<PendingElement> pending;
+        pending.swap(mPending);
+        mHavePending = false;
+        pthread_mutex_unlock(&mPendingLock);
+
+        pthread_t self = pthread_self();
+        log_mask_t deferred = 0;
+        for (const PendingElement& p : pending) {
+            if (!p.loggable) {
+                stats.addTotal(p.element);
+                delete p.element;
+                continue;
+            }
+            if (!pthread_equal(p.thread, self)) {
+                deferred |= 1 << p.element->getLogId();
+            }
+            commit(p.element);
+        }
+
+        pthread_rwlock_unlock(&mLogElementsLock);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (deferred) {
+            notifyReaders(deferred);
+        }
+    }
+}
+
+// Minimal FlushCommand::runSocketCommand() for entries committed from
+// another thread than the one that received them.
+void LogBuffer::notifyReaders(log_mask_t logMask) {
+    LogTimeEntry::wrlock();
+    for (const auto& entry : mTimes) {
+        if (entry->isWatchingMultiple(logMask) && !entry->mTimeout.tv_sec &&
+            !entry->mTimeout.tv_nsec) {
+            entry->notifyNewLog_Locked();
+        }
+    }
+    LogTimeEntry::unlock();
+}
+
+// assumes LogBuffer::wrlock() held, owns elem
+void LogBuffer::commit(LogBufferElement* elem) {
+    log_id_t log_id = elem->getLogId();
     LogBufferElement* currentLast = lastLoggedElements[log_id];
     if (currentLast) {
         LogBufferElement* dropped = droppedElements[log_id];
@@ -335,15 +453,13 @@ int LogBuffer::log(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
                     // check for overflow
                     if (total >= UINT32_MAX) {
                         log(currentLast);
-                        unlock();
-                        return len;
+                        return;
                     }
                     stats.addTotal(currentLast);
                     delete currentLast;
                     swab = total;
                     event->payload.data = htole32(swab);
-                    unlock();
-                    return len;
+                    return;
                 }
                 if (count == USHRT_MAX) {
                     log(dropped);
@@ -359,8 +475,7 @@ int LogBuffer::log(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
             }
             droppedElements[log_id] = currentLast;
             lastLoggedElements[log_id] = elem;
-            unlock();
-            return len;
+            return;
         }
         if (dropped) {         // State 1 or 2
             if (count) {       // State 2
@@ -377,13 +492,15 @@ int LogBuffer::log(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
     lastLoggedElements[log_id] = new LogBufferElement(*elem);
 
     log(elem);
-    unlock();
-
-    return len;
 }
 
 // assumes LogBuffer::wrlock() held, owns elem, look after garbage collection
 void LogBuffer::log(LogBufferElement* elem) {
+    if (mRingBuffer) {
+        logRing(elem);
+        return;
+    }
+
     // cap on how far back we will sort in-place, otherwise append
     static uint32_t too_far_back = 5;  // five seconds
     // Insert elements in time sorted order if possible
@@ -398,6 +515,7 @@ void LogBuffer::log(LogBufferElement* elem) {
                         (elem->getLogId() != LOG_ID_KERNEL) &&
                         ((*it)->getLogId() != LOG_ID_KERNEL))) {
         mLogElements.push_back(elem);
+        indexAppended();
     } else {
         log_time end(log_time::EPOCH);
         bool end_set = false;
@@ -422,6 +540,7 @@ void LogBuffer::log(LogBufferElement* elem) {
 
         if (end_always || (end_set && (end > (*it)->getRealTime()))) {
             mLogElements.push_back(elem);
+            indexAppended();
         } else {
             // should be short as timestamps are localized near end()
             do {
@@ -441,11 +560,65 @@ void LogBuffer::log(LogBufferElement* elem) {
     maybePrune(elem->getLogId());
 }
 
+// Index every indexInterval'th element appended to mLogElements, skipping
+// any that would break the time order of the index.
+//
+// LogBuffer::wrlock() must be held when this function is called.
+void LogBuffer::indexAppended() {
+    if (++mSinceIndexed < indexInterval) {
+        return;
+    }
+    LogBufferElementCollection::iterator it = mLogElements.end();
+    --it;
+    if (!mIndex.empty() &&
+        ((*mIndex.back())->getRealTime() > (*it)->getRealTime())) {
+        return;
+    }
+    mSinceIndexed = 0;
+    (*it)->mIndexed = true;
+    mIndex.push_back(it);
+}
+
+// LogBuffer::wrlock() must be held when this function is called.
+void LogBuffer::unindex(LogBufferElementCollection::iterator it) {
+    (*it)->mIndexed = false;
+    // Pruning is mostly from the oldest entries, check the front first.
+    if (mIndex.front() == it) {
+        mIndex.pop_front();
+        return;
+    }
+    auto found = std::find(mIndex.begin(), mIndex.end(), it);
+    if (found != mIndex.end()) {
+        mIndex.erase(found);
+    }
+}
+
+// Where to start walking forward to find the first element after start: an
+// indexed element at or before start, one further back to be lenient with
+// entries that arrived out of order.
+//
+// LogBuffer::rdlock() must be held when this function is called.
+LogBufferElementCollection::iterator LogBuffer::seek(const log_time& start) {
+    auto found = std::upper_bound(
+        mIndex.begin(), mIndex.end(), start,
+        [](const log_time& t, const LogBufferElementCollection::iterator& it) {
+            return t < (*it)->getRealTime();
+        });
+    if (found == mIndex.begin()) {
+        return mLogElements.begin();
+    }
+    --found;
+    if (found != mIndex.begin()) {
+        --found;
+    }
+    return *found;
+}
+
 // Prune at most 10% of the log entries or maxPrune, whichever is less.
 //
 // LogBuffer::wrlock() must be held when this function is called.
 void LogBuffer::maybePrune(log_id_t id) {
-    size_t sizes = stats.sizes(id);
+    size_t sizes = mCompress ? storedSize(id) : stats.sizes(id);
     unsigned long maxSize = log_buffer_size(id);
     if (sizes > maxSize) {
         size_t sizeOver = sizes - ((maxSize * 9) / 10);
@@ -506,6 +679,9 @@ LogBufferElementCollection::iterator LogBuffer::erase(
                   ? element->getTag()
                   : element->getUid();
 #endif
+    if (element->mIndexed) {
+        unindex(it);
+    }
     it = mLogElements.erase(it);
     if (doSetLast) {
         log_id_for_each(i) {
@@ -718,6 +894,12 @@ bool LogBuffer::prune(log_id_t id, unsigned long pruneRows, uid_t caller_uid) {
     log_time watermark(log_time::tv_sec_max, log_time::tv_nsec_max);
     if (oldest) watermark = oldest->mStart - pruneMargin;
 
+    if (mRingBuffer) {
+        busy = pruneRing(id, pruneRows, caller_uid, oldest, watermark);
+        LogTimeEntry::unlock();
+        return busy;
+    }
+
     LogBufferElementCollection::iterator it;
 
     if (__predict_false(caller_uid != AID_ROOT)) {  // unlikely
@@ -1072,7 +1254,7 @@ bool LogBuffer::clear(log_id_t id, uid_t uid) {
 // get the used space associated with "id".
 unsigned long LogBuffer::getSizeUsed(log_id_t id) {
     rdlock();
-    size_t retval = stats.sizes(id);
+    size_t retval = mCompress ? storedSize(id) : stats.sizes(id);
     unlock();
     return retval;
 }
@@ -1084,6 +1266,21 @@ int LogBuffer::setSize(log_id_t id, unsigned long size) {
         return -1;
     }
     wrlock();
+    // The ring holds twice the target so that readers region locking the
+    // oldest entries get the same slack as the list before losing data.
+    // When compressing, the slack is in the history instead and the ring is
+    // only the window of recent entries not yet compressed.
+    size_t capacity = mCompress ? (size / 4) : (2 * size);
+    if (mCompress) {
+        while (mRing[id].used() > capacity) {
+            spillRing(id);
+        }
+    }
+    if (mRingBuffer &&
+        !mRing[id].setCapacity(capacity, evictedFromRing, this)) {
+        unlock();
+        return -1;
+    }
     log_buffer_size(id) = size;
     unlock();
     return 0;
@@ -1097,11 +1294,75 @@ unsigned long LogBuffer::getSize(log_id_t id) {
     return retval;
 }
 
+namespace {
+
+// Entries serialized for a reader while the lock is held, then sent with
+// as few system calls as possible once it is dropped. Each still goes out
+// as a packet of its own, readers expect one entry per read.
+class FlushBatch {
+   public:
+    static constexpr size_t maxEntries = 64;
+    static constexpr size_t maxBytes = 64 * 1024;
+
+    FlushBatch() : mLast(log_time::EPOCH) {
+        mData.reserve(maxBytes);
+        mEnds.reserve(maxEntries);
+    }
+
+    bool empty() const {
+        return mEnds.empty();
+    }
+    bool full() const {
+        return (mEnds.size() >= maxEntries) ||
+               ((mData.size() + LOGGER_ENTRY_MAX_LEN) > maxBytes);
+    }
+
+    void add(const LogBufferElement* element, bool privileged) {
+        size_t size = mData.size();
+        mData.resize(size + LOGGER_ENTRY_MAX_LEN);
+        size += element->serialize(mData.data() + size, privileged);
+        mData.resize(size);
+        mEnds.push_back(size);
+        mLast = element->getRealTime();
+    }
+
+    // Send and empty the batch. Returns the time of the last entry sent,
+    // curr if there was none, or FLUSH_ERROR.
+    log_time send(SocketClient* reader, log_time curr) {
+        if (mEnds.empty()) {
+            return curr;
+        }
+        struct iovec iov[maxEntries];
+        size_t begin = 0;
+        for (size_t i = 0; i < mEnds.size(); ++i) {
+            iov[i].iov_base = mData.data() + begin;
+            iov[i].iov_len = mEnds[i] - begin;
+            begin = mEnds[i];
+        }
+        int rc = reader->sendPacketsv(iov, mEnds.size());
+        mData.clear();
+        mEnds.clear();
+        return rc ? LogBufferElement::FLUSH_ERROR : mLast;
+    }
+
+   private:
+    std::vector<char> mData;
+    std::vector<size_t> mEnds;  // of each entry in mData
+    log_time mLast;
+};
+
+}  // namespace
+
 log_time LogBuffer::flushTo(SocketClient* reader, const log_time& start,
                             pid_t* lastTid, bool privileged, bool security,
                             int (*filter)(const LogBufferElement* element,
                                           void* arg),
                             void* arg) {
+    if (mRingBuffer) {
+        return flushToRing(reader, start, lastTid, privileged, security,
+                           filter, arg);
+    }
+
     LogBufferElementCollection::iterator it;
     uid_t uid = reader->getUid();
 
@@ -1111,29 +1372,17 @@ log_time LogBuffer::flushTo(SocketClient* reader, const log_time& start,
         // client wants to start from the beginning
         it = mLogElements.begin();
     } else {
-        // Cap to 300 iterations we look back for out-of-order entries.
-        size_t count = 300;
-
-        // Client wants to start from some specified time. Chances are
-        // we are better off starting from the end of the time sorted list.
-        LogBufferElementCollection::iterator last;
-        for (last = it = mLogElements.end(); it != mLogElements.begin();
-             /* do nothing */) {
-            --it;
-            LogBufferElement* element = *it;
-            if (element->getRealTime() > start) {
-                last = it;
-            } else if (element->getRealTime() == start) {
-                last = ++it;
-                break;
-            } else if (!--count) {
+        // Client wants to start from some specified time. Find the nearest
+        // indexed element and walk forward from there.
+        for (it = seek(start); it != mLogElements.end(); ++it) {
+            if ((*it)->getRealTime() > start) {
                 break;
             }
         }
-        it = last;
     }
 
     log_time curr = start;
+    FlushBatch batch;
 
     LogBufferElement* lastElement = nullptr;  // iterator corruption paranoia
     static const size_t maxSkip = 4194304;    // maximum entries to skip
@@ -1182,21 +1431,492 @@ log_time LogBuffer::flushTo(SocketClient* reader, const log_time& start,
                 (element->getDropped() && !sameTid) ? 0 : element->getTid();
         }
 
+        skip = maxSkip;
+        if (!element->getDropped()) {
+            batch.add(element, privileged);
+            if (!batch.full()) {
+                continue;
+            }
+        }
+
         unlock();
 
-        // range locking in LastLogTimes looks after us
-        curr = element->flushTo(reader, this, privileged, sameTid);
+        curr = batch.send(reader, curr);
+        if (element->getDropped() && (curr != element->FLUSH_ERROR)) {
+            // range locking in LastLogTimes looks after us
+            curr = element->flushTo(reader, this, privileged, sameTid);
+        }
 
         if (curr == element->FLUSH_ERROR) {
             return curr;
         }
 
-        skip = maxSkip;
         rdlock();
     }
     unlock();
 
-    return curr;
+    return batch.send(reader, curr);
+}
+
+// assumes LogBuffer::wrlock() held, owns elem
+void LogBuffer::logRing(LogBufferElement* elem) {
+    log_id_t id = elem->getLogId();
+    LogRing& ring = mRing[id];
+
+    // maybePrune() keeps the ring at half capacity unless readers region
+    // lock the oldest entries. Once that slack is gone too, expire anyway;
+    // the slow readers resume at the new head, as if told to skip ahead.
+    // When compressing, the oldest entries move to the history instead and
+    // the same applies to it at twice the buffer size.
+    while (!ring.empty() && !ring.fits(*elem)) {
+        if (mCompress) {
+            spillRing(id);
+        } else {
+            popRing(id);
+        }
+    }
+    LogBufferElement* stored = ring.append(*elem, mSequence++);
+    delete elem;
+    if (!stored) {
+        return;
+    }
+
+    stats.add(stored);
+    if (mCompress) {
+        while (!mHistory[id].empty() &&
+               (storedSize(id) > (2 * log_buffer_size(id)))) {
+            dropHistory(id);
+        }
+        stats.setStored(id, storedSize(id));
+    }
+    maybePrune(id);
+}
+
+// Compress a run of the oldest ring entries into the history. Should that
+// fail, they are expired as popRing() would.
+//
+// assumes LogBuffer::wrlock() held
+void LogBuffer::spillRing(log_id_t id) {
+    LogRing& ring = mRing[id];
+    std::vector<char> run;
+    size_t count = ring.spill(&run, std::min(spillSize, ring.capacity() / 2));
+    if (mHistory[id].seal(run, count)) {
+        return;
+    }
+    LogRing::relink(run.data(), run.size());
+    for (size_t r = 0; r < run.size(); r = LogRing::runNext(run.data(), r)) {
+        if (!LogRing::runErased(run.data(), r)) {
+            stats.subtract(LogRing::runElement(run.data(), r));
+        }
+    }
+}
+
+// Expire the oldest history chunk, it is decompressed once more to keep
+// the statistics in step.
+//
+// assumes LogBuffer::wrlock() held
+void LogBuffer::dropHistory(log_id_t id) {
+    LogHistory& history = mHistory[id];
+    if (history.empty()) {
+        return;
+    }
+    std::vector<char> run;
+    if (history.unseal(history[0], &run)) {
+        for (size_t r = 0; r < run.size();
+             r = LogRing::runNext(run.data(), r)) {
+            if (!LogRing::runErased(run.data(), r)) {
+                stats.subtract(LogRing::runElement(run.data(), r));
+            }
+        }
+    }
+    history.pop_front();
+}
+
+// assumes LogBuffer::wrlock() held
+void LogBuffer::popRing(log_id_t id) {
+    LogRing& ring = mRing[id];
+    size_t it = ring.begin();
+    if (it == LogRing::npos) {
+        return;
+    }
+    if (!ring.erased(it)) {
+        stats.subtract(ring.element(it));
+    }
+    ring.pop_front();
+}
+
+void LogBuffer::evictedFromRing(LogBufferElement* element, void* me) {
+    reinterpret_cast<LogBuffer*>(me)->stats.subtract(element);
+}
+
+// Ring storage counterpart of the pruning loops in prune(). Entries can
+// only leave from the head, so there is no worst offender or whitelist
+// processing, only expiration of the oldest entries up to the reader
+// region lock. Clearing on behalf of a single uid hides its entries in
+// place until they reach the head.
+//
+// LogBuffer::wrlock() and LogTimeEntry::rdlock() must be held.
+bool LogBuffer::pruneRing(log_id_t id, unsigned long pruneRows,
+                          uid_t caller_uid, LogTimeEntry* oldest,
+                          log_time watermark) {
+    LogRing& ring = mRing[id];
+    LogHistory& history = mHistory[id];
+    bool busy = false;
+    bool blocked = false;
+
+    auto ringBusy = [&]() {
+        log_time newest = ring.empty() ? history[history.size() - 1].newest
+                                       : ring.element(ring.back())->getRealTime();
+        return watermark < (newest - pruneMargin - log_time(1, 0));
+    };
+
+    if (__predict_false(caller_uid != AID_ROOT)) {  // unlikely
+        // Chunks holding entries of the uid are rewritten without them,
+        // the statistics only follow once that has succeeded.
+        std::vector<char> run;
+        std::vector<size_t> cleared;
+        for (size_t c = 0; (c < history.size()) && pruneRows && !blocked; ++c) {
+            if (!history.unseal(history[c], &run)) {
+                continue;
+            }
+            cleared.clear();
+            for (size_t r = 0; (r < run.size()) && pruneRows;
+                 r = LogRing::runNext(run.data(), r)) {
+                if (LogRing::runErased(run.data(), r)) {
+                    continue;
+                }
+                LogBufferElement* element = LogRing::runElement(run.data(), r);
+                if (element->getUid() != caller_uid) {
+                    continue;
+                }
+                if (oldest && (watermark <= element->getRealTime())) {
+                    busy = ringBusy();
+                    if (busy) kickMe(oldest, id, pruneRows);
+                    blocked = true;
+                    break;
+                }
+                LogRing::runErase(run.data(), r);
+                cleared.push_back(r);
+                --pruneRows;
+            }
+            if (cleared.empty()) {
+                continue;
+            }
+            if (!history.reseal(c, run)) {
+                pruneRows += cleared.size();
+                continue;
+            }
+            for (size_t r : cleared) {
+                stats.subtract(LogRing::runElement(run.data(), r));
+            }
+        }
+        for (size_t it = ring.begin();
+             (it != LogRing::npos) && pruneRows && !blocked;
+             it = ring.next(it)) {
+            if (ring.erased(it)) {
+                continue;
+            }
+            LogBufferElement* element = ring.element(it);
+            if (element->getUid() != caller_uid) {
+                continue;
+            }
+            if (oldest && (watermark <= element->getRealTime())) {
+                busy = ringBusy();
+                if (busy) kickMe(oldest, id, pruneRows);
+                break;
+            }
+            stats.subtract(element);
+            ring.erase(it);
+            --pruneRows;
+        }
+        while (!ring.empty() && ring.erased(ring.begin())) {
+            ring.pop_front();
+        }
+        if (mCompress) {
+            stats.setStored(id, storedSize(id));
+        }
+        return busy;
+    }
+
+    // History chunks go whole, whatever their count of entries.
+    while ((pruneRows > 0) && !history.empty()) {
+        if (oldest && (watermark <= history[0].newest)) {
+            busy = ringBusy();
+            if (busy) kickMe(oldest, id, pruneRows);
+            blocked = true;
+            break;
+        }
+        pruneRows -= std::min<unsigned long>(pruneRows, history[0].count);
+        dropHistory(id);
+    }
+
+    while ((pruneRows > 0) && !ring.empty() && !blocked) {
+        size_t it = ring.begin();
+        if (!ring.erased(it)) {
+            if (oldest && (watermark <= ring.element(it)->getRealTime())) {
+                busy = ringBusy();
+                if (busy) kickMe(oldest, id, pruneRows);
+                break;
+            }
+            --pruneRows;
+        }
+        popRing(id);
+    }
+
+    if (mCompress) {
+        stats.setStored(id, storedSize(id));
+    }
+    return (pruneRows > 0) && busy;
+}
+
+// Ring storage counterpart of flushTo(). The rings are merged in time
+// order, each preceded by its compressed history if any. Each entry is
+// copied out while the lock is held, the storage can be expired, spilled or
+// relocated by writers while the copy is being sent, so the position in
+// each log id is tracked by sequence number.
+log_time LogBuffer::flushToRing(SocketClient* reader, const log_time& start,
+                                pid_t* lastTid, bool privileged, bool security,
+                                int (*filter)(const LogBufferElement* element,
+                                              void* arg),
+                                void* arg) {
+    // Last record visited in each log id. offset is its place in the ring,
+    // npos when it was not in the ring or has left it since.
+    struct Cursor {
+        size_t offset;
+        uint64_t sequence;
+        uint32_t layout;
+        bool seeking;  // skipping entries at or before start
+        // The history chunk being walked, decompressed.
+        uint64_t chunk;  // its first sequence number, 0 if none
+        uint32_t history;  // layout of the history when decompressed
+        std::vector<char> run;
+        size_t pos;  // in run of the next record to visit
+    } cursor[LOG_ID_MAX];
+    uid_t uid = reader->getUid();
+    FlushBatch batch;
+    std::vector<char> scratch;
+
+    auto resume = [&](log_id_t i) {
+        LogRing& ring = mRing[i];
+        Cursor& c = cursor[i];
+        if (c.offset == LogRing::npos) {
+            return ring.find(c.sequence + 1);
+        }
+        if (c.layout != ring.layout()) {
+            c.layout = ring.layout();
+            size_t it = ring.find(c.sequence);
+            if ((it != LogRing::npos) && (ring.sequence(it) == c.sequence)) {
+                c.offset = it;
+                return ring.next(it);
+            }
+            c.offset = LogRing::npos;
+            return it;
+        }
+        if (ring.empty() || (ring.frontSequence() > c.sequence)) {
+            // what we visited last has since expired
+            c.offset = LogRing::npos;
+            return ring.begin();
+        }
+        return ring.next(c.offset);
+    };
+
+    // The next record for log id i, from the history while it has records
+    // after the cursor, then from the ring. Sets offset to the place in the
+    // ring, or npos for a history record.
+    auto candidate = [&](log_id_t i, size_t* offset) -> LogBufferElement* {
+        Cursor& c = cursor[i];
+        LogHistory& history = mHistory[i];
+        for (size_t k = history.find(c.sequence); k < history.size();
+             k = history.find(c.sequence)) {
+            const LogHistory::Chunk& chunk = history[k];
+            if ((c.chunk != chunk.first) || (c.history != history.layout())) {
+                c.chunk = chunk.first;
+                c.history = history.layout();
+                c.pos = 0;
+                if (!history.unseal(chunk, &c.run)) {
+                    // unreadable, skip past it
+                    c.chunk = 0;
+                    c.offset = LogRing::npos;
+                    c.sequence = chunk.last;
+                    continue;
+                }
+            }
+            char* run = c.run.data();
+            while ((c.pos < c.run.size()) &&
+                   (LogRing::runSequence(run, c.pos) <= c.sequence)) {
+                c.pos = LogRing::runNext(run, c.pos);
+            }
+            if (c.pos < c.run.size()) {
+                *offset = LogRing::npos;
+                return LogRing::runElement(run, c.pos);
+            }
+            // not expected, chunk.last is in the run
+            c.chunk = 0;
+            c.sequence = chunk.last;
+        }
+        LogRing& ring = mRing[i];
+        size_t it = resume(i);
+        *offset = it;
+        return (it != LogRing::npos) ? ring.element(it) : nullptr;
+    };
+
+    auto visit = [&](log_id_t i, size_t offset) {
+        Cursor& c = cursor[i];
+        if (offset == LogRing::npos) {
+            c.offset = LogRing::npos;
+            c.sequence = LogRing::runSequence(c.run.data(), c.pos);
+            c.pos = LogRing::runNext(c.run.data(), c.pos);
+        } else {
+            c.offset = offset;
+            c.sequence = mRing[i].sequence(offset);
+            c.layout = mRing[i].layout();
+        }
+    };
+
+    auto erased = [&](log_id_t i, size_t offset) {
+        if (offset == LogRing::npos) {
+            return LogRing::runErased(cursor[i].run.data(), cursor[i].pos);
+        }
+        return mRing[i].erased(offset);
+    };
+
+    auto sequence = [&](log_id_t i, size_t offset) {
+        if (offset == LogRing::npos) {
+            return LogRing::runSequence(cursor[i].run.data(), cursor[i].pos);
+        }
+        return mRing[i].sequence(offset);
+    };
+
+    rdlock();
+
+    log_id_for_each(i) {
+        LogRing& ring = mRing[i];
+        LogHistory& history = mHistory[i];
+        Cursor& c = cursor[i];
+        c.offset = LogRing::npos;
+        c.sequence = 0;
+        c.layout = ring.layout();
+        c.seeking = start != log_time::EPOCH;
+        c.chunk = 0;
+        c.history = history.layout();
+        c.pos = 0;
+        if (!c.seeking) {
+            continue;
+        }
+        // Jump over what is known to be at or before start.
+        size_t k = history.seek(start);
+        if (k < history.size()) {
+            c.sequence = history[k].last;
+        }
+        if (history.empty() || (k == (history.size() - 1))) {
+            size_t it = ring.seek(start);
+            if (it != LogRing::npos) {
+                c.offset = it;
+                c.sequence = ring.sequence(it);
+            }
+        }
+    }
+
+    log_time curr = start;
+
+    for (;;) {
+        log_id_t id = LOG_ID_MAX;
+        size_t offset = LogRing::npos;
+        LogBufferElement* element = nullptr;
+        log_id_for_each(i) {
+            size_t it;
+            LogBufferElement* e;
+            for (;;) {
+                e = candidate(i, &it);
+                if (!e) {
+                    break;
+                }
+                if (!erased(i, it) &&
+                    (!cursor[i].seeking || (e->getRealTime() > start))) {
+                    cursor[i].seeking = false;
+                    break;
+                }
+                visit(i, it);
+            }
+            if (!e) {
+                continue;
+            }
+            if (!element || (e->getRealTime() < element->getRealTime()) ||
+                ((e->getRealTime() == element->getRealTime()) &&
+                 (sequence(i, it) < sequence(id, offset)))) {
+                id = i;
+                offset = it;
+                element = e;
+            }
+        }
+        if (!element) {
+            break;
+        }
+        visit(id, offset);
+
+        if (!privileged && (element->getUid() != uid)) {
+            continue;
+        }
+
+        if (!security && (element->getLogId() == LOG_ID_SECURITY)) {
+            continue;
+        }
+
+        // NB: calling out to another object with wrlock() held (safe)
+        if (filter) {
+            int ret = (*filter)(element, arg);
+            if (ret == false) {
+                continue;
+            }
+            if (ret != true) {
+                break;
+            }
+        }
+
+        bool sameTid = false;
+        if (lastTid) {
+            sameTid = lastTid[element->getLogId()] == element->getTid();
+            lastTid[element->getLogId()] =
+                (element->getDropped() && !sameTid) ? 0 : element->getTid();
+        }
+
+        if (!element->getDropped()) {
+            batch.add(element, privileged);
+            if (batch.full()) {
+                unlock();
+                curr = batch.send(reader, curr);
+                if (curr == LogBufferElement::FLUSH_ERROR) {
+                    return curr;
+                }
+                rdlock();
+            }
+            continue;
+        }
+
+        // The chatty message is made up with the lock dropped, from a copy.
+        size_t size = sizeof(LogBufferElement) + element->getMsgLen();
+        if (scratch.size() < size) {
+            scratch.resize(size);
+        }
+        LogBufferElement* copy = new (scratch.data()) LogBufferElement(
+            *element, scratch.data() + sizeof(LogBufferElement));
+
+        unlock();
+
+        curr = batch.send(reader, curr);
+        if (curr != copy->FLUSH_ERROR) {
+            curr = copy->flushTo(reader, this, privileged, sameTid);
+        }
+
+        if (curr == copy->FLUSH_ERROR) {
+            return curr;
+        }
+
+        rdlock();
+    }
+    unlock();
+
+    return batch.send(reader, curr);
 }
 
 std::string LogBuffer::formatStatistics(uid_t uid, pid_t pid,
@@ -19,14 +19,19 @@
 
 #include <sys/types.h>
 
+#include <atomic>
+#include <deque>
 #include <list>
 #include <string>
+#include <vector>
 
 #include <android/log.h>
 #include <private/android_filesystem_config.h>
 #include <sysutils/SocketClient.h>
 
 #include "LogBufferElement.h"
+#include "LogHistory.h"
+#include "LogRing.h"
 #include "LogStatistics.h"
 #include "LogTags.h"
 #include "LogTimes.h"
@@ -93,6 +98,16 @@ class LogBuffer {
         LogBufferPidIteratorMap;
     LogBufferPidIteratorMap mLastWorstPidOfSystem[LOG_ID_MAX];
 
+    // Sparse seek index into mLogElements, an element every indexInterval
+    // appended, in list order and time order. Referenced elements have
+    // mIndexed set so erase() can keep the index from going stale.
+    static constexpr size_t indexInterval = 256;
+    std::deque<LogBufferElementCollection::iterator> mIndex;
+    size_t mSinceIndexed;
+    void indexAppended();
+    void unindex(LogBufferElementCollection::iterator it);
+    LogBufferElementCollection::iterator seek(const log_time& start);
+
     unsigned long mMaxSize[LOG_ID_MAX];
 
     bool monotonic;
@@ -103,6 +118,43 @@ class LogBuffer {
     LogBufferElement* droppedElements[LOG_ID_MAX];
     void log(LogBufferElement* elem);
 
+    // Entries accepted by log() but not yet committed, in arrival order.
+    // Writers do not wait for mLogElementsLock, see commitPending().
+    struct PendingElement {
+        LogBufferElement* element;
+        pthread_t thread;  // that staged it
+        bool loggable;     // false only counts towards the totals
+    };
+    pthread_mutex_t mPendingLock;
+    std::vector<PendingElement> mPending;
+    std::atomic<bool> mHavePending;
+    int accept(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
+               pid_t tid, const char* msg, uint16_t len, bool commitNow);
+    void stage(LogBufferElement* elem, bool loggable, bool commitNow);
+    void commitPending();
+    void commit(LogBufferElement* elem);
+    void notifyReaders(log_mask_t logMask);
+
+    // Optional contiguous per log id storage, replaces mLogElements when
+    // logd.ring_buffer is set at startup.
+    const bool mRingBuffer;
+    LogRing mRing[LOG_ID_MAX];
+    uint64_t mSequence;
+    void logRing(LogBufferElement* elem);
+
+    // logd.ring_buffer.compress, the oldest entries spill from each ring
+    // into a compressed history and the buffer size limits the bytes
+    // actually held rather than the logical size of the entries.
+    const bool mCompress;
+    LogHistory mHistory[LOG_ID_MAX];
+    // Run of records compressed into a history chunk at a time.
+    static constexpr size_t spillSize = 64 * 1024;
+    void spillRing(log_id_t id);
+    void dropHistory(log_id_t id);
+    size_t storedSize(log_id_t id) const {
+        return mRing[id].used() + mHistory[id].compressedSize();
+    }
+
    public:
     LastLogTimes& mTimes;
 
@@ -115,6 +167,13 @@ class LogBuffer {
 
     int log(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid, pid_t tid, const char* msg,
             uint16_t len);
+    // As log(), but the entry stays staged until commitBatch(), so a batch
+    // of entries costs a single acquisition of the lock.
+    int logBatched(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
+                   pid_t tid, const char* msg, uint16_t len);
+    void commitBatch() {
+        commitPending();
+    }
     // lastTid is an optional context to help detect if the last previous
     // valid message was from the same source so we can differentiate chatty
     // filter types (identical or expired)
@@ -170,6 +229,11 @@ class LogBuffer {
     }
     void unlock() {
         pthread_rwlock_unlock(&mLogElementsLock);
+        // Commit what writers staged while we held the lock.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mHavePending) {
+            commitPending();
+        }
     }
 
    private:
@@ -184,6 +248,16 @@ class LogBuffer {
     bool prune(log_id_t id, unsigned long pruneRows, uid_t uid = AID_ROOT);
     LogBufferElementCollection::iterator erase(
         LogBufferElementCollection::iterator it, bool coalesce = false);
+
+    bool pruneRing(log_id_t id, unsigned long pruneRows, uid_t caller_uid,
+                   LogTimeEntry* oldest, log_time watermark);
+    void popRing(log_id_t id);
+    static void evictedFromRing(LogBufferElement* element, void* me);
+    log_time flushToRing(SocketClient* writer, const log_time& start,
+                         pid_t* lastTid, bool privileged, bool security,
+                         int (*filter)(const LogBufferElement* element,
+                                       void* arg),
+                         void* arg);
 };
 
 #endif  // _LOGD_LOG_BUFFER_H__
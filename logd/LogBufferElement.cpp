@@ -42,7 +42,8 @@ LogBufferElement::LogBufferElement(log_id_t log_id, log_time realtime,
       mRealTime(realtime),
       mMsgLen(len),
       mLogId(log_id),
-      mDropped(false) {
+      mDropped(false),
+      mIndexed(false) {
     mMsg = new char[len];
     memcpy(mMsg, msg, len);
 }
@@ -54,7 +55,8 @@ LogBufferElement::LogBufferElement(const LogBufferElement& elem)
       mRealTime(elem.mRealTime),
       mMsgLen(elem.mMsgLen),
       mLogId(elem.mLogId),
-      mDropped(elem.mDropped) {
+      mDropped(elem.mDropped),
+      mIndexed(false) {
     if (mDropped) {
         mTag = elem.getTag();
     } else {
@@ -63,6 +65,23 @@ LogBufferElement::LogBufferElement(const LogBufferElement& elem)
     }
 }
 
+LogBufferElement::LogBufferElement(const LogBufferElement& elem, char* storage)
+    : mUid(elem.mUid),
+      mPid(elem.mPid),
+      mTid(elem.mTid),
+      mRealTime(elem.mRealTime),
+      mMsgLen(elem.mMsgLen),
+      mLogId(elem.mLogId),
+      mDropped(elem.mDropped),
+      mIndexed(false) {
+    if (mDropped) {
+        mTag = elem.getTag();
+    } else {
+        mMsg = storage;
+        memcpy(mMsg, elem.mMsg, mMsgLen);
+    }
+}
+
 LogBufferElement::~LogBufferElement() {
     if (!mDropped) {
         delete[] mMsg;
@@ -283,3 +302,25 @@ log_time LogBufferElement::flushTo(SocketClient* reader, LogBuffer* parent,
 
     return retval;
 }
+
+size_t LogBufferElement::serialize(char* buffer, bool privileged) const {
+    struct logger_entry_v4 entry;
+
+    memset(&entry, 0, sizeof(struct logger_entry_v4));
+
+    entry.hdr_size = privileged ? sizeof(struct logger_entry_v4)
+                                : sizeof(struct logger_entry_v3);
+    entry.lid = mLogId;
+    entry.pid = mPid;
+    entry.tid = mTid;
+    entry.uid = mUid;
+    entry.sec = mRealTime.tv_sec;
+    entry.nsec = mRealTime.tv_nsec;
+    entry.len = mMsgLen;
+
+    memcpy(buffer, &entry, entry.hdr_size);
+    if (mMsgLen) {
+        memcpy(buffer + entry.hdr_size, mMsg, mMsgLen);
+    }
+    return entry.hdr_size + mMsgLen;
+}
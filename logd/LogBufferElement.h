@@ -26,6 +26,7 @@
 #include <sysutils/SocketClient.h>
 
 class LogBuffer;
+class LogRing;
 
 #define EXPIRE_HOUR_THRESHOLD 24  // Only expire chatty UID logs to preserve
                                   // non-chatty UIDs less than this age in hours
@@ -35,6 +36,7 @@ class LogBuffer;
 
 class __attribute__((packed)) LogBufferElement {
     friend LogBuffer;
+    friend LogRing;
 
     // sized to match reality of incoming log packets
     const uint32_t mUid;
@@ -50,7 +52,8 @@ class __attribute__((packed)) LogBufferElement {
         uint16_t mDroppedCount;  // mDropped == true
     };
     const uint8_t mLogId;
-    bool mDropped;
+    bool mDropped : 1;
+    bool mIndexed : 1;  // referenced by the LogBuffer seek index
 
     static atomic_int_fast64_t sequence;
 
@@ -62,6 +65,10 @@ class __attribute__((packed)) LogBufferElement {
     LogBufferElement(log_id_t log_id, log_time realtime, uid_t uid, pid_t pid,
                      pid_t tid, const char* msg, uint16_t len);
     LogBufferElement(const LogBufferElement& elem);
+    // Copy of elem with the payload placed in caller supplied storage of at
+    // least elem.getMsgLen() bytes. The caller owns the storage, so the
+    // destructor must not be run on the result.
+    LogBufferElement(const LogBufferElement& elem, char* storage);
     ~LogBufferElement();
 
     bool isBinary(void) const {
@@ -98,6 +105,11 @@ class __attribute__((packed)) LogBufferElement {
     static const log_time FLUSH_ERROR;
     log_time flushTo(SocketClient* writer, LogBuffer* parent, bool privileged,
                      bool lastSame);
+    // The entry as flushTo() would send it, header then payload, written
+    // to buffer which must have room for LOGGER_ENTRY_MAX_LEN. Not for
+    // dropped entries, their message is made up when flushed. Returns the
+    // length written.
+    size_t serialize(char* buffer, bool privileged) const;
 };
 
 #endif
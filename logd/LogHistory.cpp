@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <algorithm>
+#include <new>
+
+#include <zlib.h>
+
+#include "LogHistory.h"
+#include "LogRing.h"
+
+// Favour speed, logd compresses on the write path with the lock held.
+static constexpr int compressionLevel = Z_BEST_SPEED;
+
+bool LogHistory::compress(const std::vector<char>& run, Chunk* chunk) {
+    uLongf length = compressBound(run.size());
+    std::unique_ptr<char[]> bound(new (std::nothrow) char[length]);
+    if (!bound) {
+        return false;
+    }
+    if (compress2(reinterpret_cast<Bytef*>(bound.get()), &length,
+                  reinterpret_cast<const Bytef*>(run.data()), run.size(),
+                  compressionLevel) != Z_OK) {
+        return false;
+    }
+    std::unique_ptr<char[]> data(new (std::nothrow) char[length]);
+    if (!data) {
+        return false;
+    }
+    memcpy(data.get(), bound.get(), length);
+
+    // The run is only read; the element accessors want a mutable pointer.
+    char* records = const_cast<char*>(run.data());
+    log_time newest(log_time::EPOCH);
+    for (size_t offset = 0; offset < run.size();
+         offset = LogRing::runNext(records, offset)) {
+        log_time realtime = LogRing::runElement(records, offset)->getRealTime();
+        if (newest < realtime) {
+            newest = realtime;
+        }
+        if (!offset) {
+            chunk->first = LogRing::runSequence(records, offset);
+        }
+        chunk->last = LogRing::runSequence(records, offset);
+    }
+
+    chunk->data = std::move(data);
+    chunk->compressedSize = length;
+    chunk->size = run.size();
+    chunk->newest = newest;
+    return true;
+}
+
+bool LogHistory::seal(const std::vector<char>& run, size_t count) {
+    if (run.empty()) {
+        return true;
+    }
+    Chunk chunk;
+    if (!compress(run, &chunk)) {
+        return false;
+    }
+    chunk.count = count;
+    mCompressedSize += chunk.compressedSize;
+    mChunks.push_back(std::move(chunk));
+    return true;
+}
+
+bool LogHistory::unseal(const Chunk& chunk, std::vector<char>* run) const {
+    run->resize(chunk.size);
+    uLongf length = chunk.size;
+    if ((uncompress(reinterpret_cast<Bytef*>(run->data()), &length,
+                    reinterpret_cast<const Bytef*>(chunk.data.get()),
+                    chunk.compressedSize) != Z_OK) ||
+        (length != chunk.size)) {
+        run->clear();
+        return false;
+    }
+    LogRing::relink(run->data(), run->size());
+    return true;
+}
+
+bool LogHistory::reseal(size_t i, const std::vector<char>& run) {
+    Chunk& chunk = mChunks[i];
+    Chunk replacement;
+    if (!compress(run, &replacement)) {
+        return false;
+    }
+    mCompressedSize -= chunk.compressedSize;
+    mCompressedSize += replacement.compressedSize;
+    chunk.data = std::move(replacement.data);
+    chunk.compressedSize = replacement.compressedSize;
+    chunk.newest = replacement.newest;
+    ++mLayout;
+    return true;
+}
+
+void LogHistory::pop_front() {
+    if (mChunks.empty()) {
+        return;
+    }
+    mCompressedSize -= mChunks.front().compressedSize;
+    mChunks.pop_front();
+}
+
+size_t LogHistory::find(uint64_t sequence) const {
+    auto found = std::upper_bound(
+        mChunks.begin(), mChunks.end(), sequence,
+        [](uint64_t s, const Chunk& chunk) { return s < chunk.last; });
+    return found - mChunks.begin();
+}
+
+size_t LogHistory::seek(const log_time& start) const {
+    // newest is not monotonic across chunks when entries arrive out of
+    // order, so this is a linear scan; there are only a few chunks.
+    size_t found = mChunks.size();
+    for (size_t i = 0; i < mChunks.size(); ++i) {
+        if (start < mChunks[i].newest) {
+            break;
+        }
+        found = i;
+    }
+    return found;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGD_LOG_HISTORY_H__
+#define _LOGD_LOG_HISTORY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <log/log_time.h>
+
+// Older entries of a single log id, spilled from the head of its LogRing
+// and kept as sealed, deflate compressed runs of ring records. Chunks are
+// only ever added at the back and dropped from the front, a chunk is
+// rewritten whole when entries in it are erased.
+//
+// Callers must hold the LogBuffer lock for every operation.
+class LogHistory {
+   public:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t compressedSize;
+        size_t size;  // of the run once decompressed
+        size_t count;
+        uint64_t first;  // sequence numbers of the first and last records
+        uint64_t last;
+        log_time newest;  // latest realtime in the chunk
+    };
+
+    LogHistory() : mCompressedSize(0), mLayout(0) {
+    }
+    LogHistory(const LogHistory&) = delete;
+    LogHistory& operator=(const LogHistory&) = delete;
+
+    // Compress a run of records produced by LogRing::spill() into a new
+    // chunk at the back. False if out of memory, the run is left untouched.
+    bool seal(const std::vector<char>& run, size_t count);
+    // Decompress chunk into run and relink the elements in it.
+    bool unseal(const Chunk& chunk, std::vector<char>* run) const;
+    // Replace the content of chunk i with run, its records erased or
+    // their timestamps corrected, but none added or removed.
+    bool reseal(size_t i, const std::vector<char>& run);
+    void pop_front();
+
+    bool empty() const {
+        return mChunks.empty();
+    }
+    size_t size() const {
+        return mChunks.size();
+    }
+    const Chunk& operator[](size_t i) const {
+        return mChunks[i];
+    }
+    // Index of the first chunk holding records after sequence, or size().
+    size_t find(uint64_t sequence) const;
+    // Index of the last chunk with nothing after start, or size() if none.
+    size_t seek(const log_time& start) const;
+
+    // Incremented whenever a chunk is resealed; decompressed copies of the
+    // chunks are stale.
+    uint32_t layout() const {
+        return mLayout;
+    }
+
+    // Bytes held, compressed.
+    size_t compressedSize() const {
+        return mCompressedSize;
+    }
+
+   private:
+    bool compress(const std::vector<char>& run, Chunk* chunk);
+
+    std::deque<Chunk> mChunks;
+    size_t mCompressedSize;
+    uint32_t mLayout;
+};
+
+#endif  // _LOGD_LOG_HISTORY_H__
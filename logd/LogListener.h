@@ -17,12 +17,28 @@
 #ifndef _LOGD_LOG_LISTENER_H__
 #define _LOGD_LOG_LISTENER_H__
 
+#include <sys/socket.h>
+
+#include <memory>
+
+#include <private/android_logger.h>
 #include <sysutils/SocketListener.h>
 #include "LogReader.h"
 
 class LogListener : public SocketListener {
+    // Datagrams drained from the socket per wakeup.
+    static constexpr unsigned int batchSize = 32;
+
+    struct Datagram {
+        // + 1 to ensure null terminator if MAX_PAYLOAD buffer is received
+        char buffer[sizeof_log_id_t + sizeof(uint16_t) + sizeof(log_time) +
+                    LOGGER_ENTRY_MAX_PAYLOAD + 1];
+        alignas(4) char control[CMSG_SPACE(sizeof(struct ucred))];
+    };
+
     LogBuffer* logbuf;
     LogReader* reader;
+    std::unique_ptr<Datagram[]> datagrams;
 
    public:
      LogListener(LogBuffer* buf, LogReader* reader);
@@ -32,6 +48,7 @@ class LogListener : public SocketListener {
 
    private:
     static int getLogSocket();
+    log_id_t ingest(char* buffer, ssize_t n, struct msghdr* hdr);
 };
 
 #endif
@@ -21,6 +21,9 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 
+#include <algorithm>
+
+#include <cutils/properties.h>
 #include <cutils/sockets.h>
 #include <private/android_logger.h>
 
@@ -31,7 +34,9 @@
 #include "LogUtils.h"
 
 LogReader::LogReader(LogBuffer* logbuf)
-    : SocketListener(getLogSocket(), true), mLogbuf(*logbuf) {
+    : SocketListener(getLogSocket(), true),
+      mLogbuf(*logbuf),
+      mDefaultBatchMs(std::max(property_get_int32("logd.reader.batch_ms", 0), 0)) {
 }
 
 // When we are notified a new log entry is available, inform
@@ -120,6 +125,44 @@ bool LogReader::onDataAvailable(SocketClient* cli) {
         pid = atol(cp + sizeof(_pid) - 1);
     }
 
+    android_LogPriority prio = ANDROID_LOG_DEFAULT;
+    static const char _prio[] = " prio=";
+    cp = strstr(buffer, _prio);
+    if (cp) {
+        prio = static_cast<android_LogPriority>(atoi(cp + sizeof(_prio) - 1));
+    }
+
+    std::vector<uid_t> uids;
+    static const char _uids[] = " uids=";
+    cp = strstr(buffer, _uids);
+    if (cp) {
+        cp += sizeof(_uids) - 1;
+        while (isdigit(*cp)) {
+            char* ep;
+            uids.push_back(strtoul(cp, &ep, 10));
+            cp = ep;
+            if (*cp != ',') {
+                break;
+            }
+            ++cp;
+        }
+    }
+
+    // " batch=<ms>[,<count>]": let up to <count> new entries accumulate for
+    // up to <ms> before waking, instead of waking for each. batch=0 keeps
+    // waking for every entry whatever the default is.
+    uint32_t batchMs = mDefaultBatchMs;
+    unsigned long batchCount = LogTimeEntry::DEFAULT_BATCH_COUNT;
+    static const char _batch[] = " batch=";
+    cp = strstr(buffer, _batch);
+    if (cp) {
+        char* ep;
+        batchMs = strtoul(cp + sizeof(_batch) - 1, &ep, 10);
+        if (*ep == ',') {
+            batchCount = strtoul(ep + 1, nullptr, 10);
+        }
+    }
+
     bool nonBlock = false;
     if (!fastcmp<strncmp>(buffer, "dumpAndClose", 12)) {
         // Allow writer to get some cycles, and wait for pending notifications
@@ -207,10 +250,12 @@ bool LogReader::onDataAvailable(SocketClient* cli) {
     }
 
     android::prdebug(
-        "logdr: UID=%d GID=%d PID=%d %c tail=%lu logMask=%x pid=%d "
-        "start=%" PRIu64 "ns timeout=%" PRIu64 "ns\n",
+        "logdr: UID=%d GID=%d PID=%d %c tail=%lu logMask=%x pid=%d prio=%d "
+        "uids=%zu start=%" PRIu64 "ns timeout=%" PRIu64 "ns batch=%" PRIu32
+        "ms,%lu\n",
         cli->getUid(), cli->getGid(), cli->getPid(), nonBlock ? 'n' : 'b', tail,
-        logMask, (int)pid, sequence.nsec(), timeout);
+        logMask, (int)pid, prio, uids.size(), sequence.nsec(), timeout, batchMs,
+        batchCount);
 
     if (sequence == log_time::EPOCH) {
         timeout = 0;
@@ -218,7 +263,8 @@ bool LogReader::onDataAvailable(SocketClient* cli) {
 
     LogTimeEntry::wrlock();
     auto entry = std::make_unique<LogTimeEntry>(
-        *this, cli, nonBlock, tail, logMask, pid, sequence, timeout);
+        *this, cli, nonBlock, tail, logMask, pid, prio, std::move(uids),
+        sequence, timeout, batchMs, batchCount);
     if (!entry->startReader_Locked()) {
         LogTimeEntry::unlock();
         return false;
@@ -27,6 +27,8 @@ class LogBuffer;
 
 class LogReader : public SocketListener {
     LogBuffer& mLogbuf;
+    // Wakeup coalescing window for readers that don't ask for one
+    const uint32_t mDefaultBatchMs;
 
    public:
     explicit LogReader(LogBuffer* logbuf);
@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <new>
+
+#include "LogRing.h"
+
+// Keep every record header naturally aligned.
+static constexpr size_t recordAlign = sizeof(uint64_t);
+
+LogRing::LogRing()
+    : mData(nullptr),
+      mCapacity(0),
+      mUsed(0),
+      mCount(0),
+      mHead(0),
+      mTail(0),
+      mLast(0),
+      mWrapEnd(0),
+      mWrapped(false),
+      mLayout(0),
+      mSinceIndexed(0) {
+}
+
+LogRing::~LogRing() {
+    free(mData);
+}
+
+size_t LogRing::recordSize(const LogBufferElement& element) {
+    size_t size = sizeof(Record) + element.getMsgLen();
+    return (size + recordAlign - 1) & ~(recordAlign - 1);
+}
+
+bool LogRing::setCapacity(size_t capacity,
+                          void (*evicted)(LogBufferElement* element, void* arg),
+                          void* arg) {
+    capacity &= ~(recordAlign - 1);
+    if (capacity == mCapacity) {
+        return true;
+    }
+
+    char* data = static_cast<char*>(malloc(capacity));
+    if (!data) {
+        return false;
+    }
+
+    while (mCount && (mUsed > capacity)) {
+        if (evicted && !erased(mHead)) {
+            (*evicted)(element(mHead), arg);
+        }
+        pop_front();
+    }
+
+    // Compact the surviving records, oldest first, from the bottom.
+    size_t offset = 0;
+    size_t last = 0;
+    auto checkpoint = mIndex.begin();
+    for (size_t it = begin(); it != npos; it = next(it)) {
+        Record* from = record(it);
+        Record* to = reinterpret_cast<Record*>(data + offset);
+        memcpy(to, from, from->size);
+        if (!to->element.mDropped) {
+            to->element.mMsg = reinterpret_cast<char*>(to + 1);
+        }
+        if ((checkpoint != mIndex.end()) && (checkpoint->offset == it)) {
+            checkpoint->offset = offset;
+            ++checkpoint;
+        }
+        last = offset;
+        offset += from->size;
+    }
+
+    free(mData);
+    mData = data;
+    mCapacity = capacity;
+    mHead = 0;
+    mTail = mCount ? offset : 0;
+    mLast = last;
+    mWrapEnd = 0;
+    mWrapped = false;
+    ++mLayout;
+    return true;
+}
+
+// Offset a record of size bytes would be placed at, or npos if no room.
+size_t LogRing::placement(size_t size) const {
+    if (!mCount) {
+        return (size <= mCapacity) ? 0 : npos;
+    }
+    if (mWrapped) {
+        return ((mHead - mTail) >= size) ? mTail : npos;
+    }
+    if ((mCapacity - mTail) >= size) {
+        return mTail;
+    }
+    return (mHead >= size) ? 0 : npos;
+}
+
+bool LogRing::fits(const LogBufferElement& element) const {
+    return placement(recordSize(element)) != npos;
+}
+
+LogBufferElement* LogRing::append(const LogBufferElement& element,
+                                  uint64_t sequence) {
+    size_t size = recordSize(element);
+    size_t offset = placement(size);
+    if (offset == npos) {
+        return nullptr;
+    }
+    if (!mCount) {
+        mHead = 0;
+    } else if (!mWrapped && (offset < mTail)) {
+        mWrapEnd = mTail;
+        mWrapped = true;
+    }
+
+    Record* r = record(offset);
+    r->sequence = sequence;
+    r->size = size;
+    r->flags = 0;
+    new (&r->element) LogBufferElement(element, reinterpret_cast<char*>(r + 1));
+
+    mTail = offset + size;
+    mLast = offset;
+    mUsed += size;
+    ++mCount;
+    indexAppended(offset);
+    return &r->element;
+}
+
+// Index every indexInterval'th record appended, skipping any that would
+// break the time order of the index.
+void LogRing::indexAppended(size_t offset) {
+    if (++mSinceIndexed < indexInterval) {
+        return;
+    }
+    const LogBufferElement& e = record(offset)->element;
+    if (!mIndex.empty() &&
+        (element(mIndex.back().offset)->getRealTime() > e.getRealTime())) {
+        return;
+    }
+    mSinceIndexed = 0;
+    mIndex.push_back({offset});
+}
+
+size_t LogRing::seek(const log_time& start) const {
+    auto found = std::upper_bound(mIndex.begin(), mIndex.end(), start,
+                                  [this](const log_time& t, const Checkpoint& c) {
+                                      return t < element(c.offset)->getRealTime();
+                                  });
+    if (found == mIndex.begin()) {
+        return npos;
+    }
+    --found;
+    // One further back to be lenient with entries that arrived out of order.
+    if (found != mIndex.begin()) {
+        --found;
+    }
+    return found->offset;
+}
+
+void LogRing::pop_front() {
+    if (!mCount) {
+        return;
+    }
+    size_t size = record(mHead)->size;
+    if (!mIndex.empty() && (mIndex.front().offset == mHead)) {
+        mIndex.pop_front();
+    }
+    mUsed -= size;
+    if (!--mCount) {
+        mHead = mTail = mLast = mWrapEnd = 0;
+        mWrapped = false;
+        return;
+    }
+    mHead += size;
+    if (mWrapped && (mHead == mWrapEnd)) {
+        mHead = 0;
+        mWrapEnd = 0;
+        mWrapped = false;
+    }
+}
+
+size_t LogRing::next(size_t offset) const {
+    if ((offset == npos) || (offset == mLast)) {
+        return npos;
+    }
+    offset += record(offset)->size;
+    if (mWrapped && (offset == mWrapEnd)) {
+        return 0;
+    }
+    return offset;
+}
+
+size_t LogRing::find(uint64_t sequence) const {
+    size_t it = begin();
+    while ((it != npos) && (record(it)->sequence < sequence)) {
+        it = next(it);
+    }
+    return it;
+}
+
+size_t LogRing::spill(std::vector<char>* run, size_t limit) {
+    size_t count = 0;
+    while (mCount) {
+        Record* r = record(mHead);
+        size_t size = run->size();
+        if (count && ((size + r->size) > limit)) {
+            break;
+        }
+        run->resize(size + r->size);
+        memcpy(run->data() + size, r, r->size);
+        pop_front();
+        ++count;
+    }
+    return count;
+}
+
+void LogRing::relink(char* run, size_t size) {
+    for (size_t offset = 0; offset < size; offset = runNext(run, offset)) {
+        Record* r = reinterpret_cast<Record*>(run + offset);
+        if (!r->element.mDropped) {
+            r->element.mMsg = reinterpret_cast<char*>(r + 1);
+        }
+    }
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOGD_LOG_RING_H__
+#define _LOGD_LOG_RING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <vector>
+
+#include "LogBufferElement.h"
+
+// Contiguous storage for the entries of a single log id.
+//
+// Each record holds a small header, an inline LogBufferElement and the
+// message payload, so pushing a log entry is a bump of the tail offset and
+// expiring the oldest entry is a bump of the head offset. Records never
+// straddle the end of the storage area; when the tail runs out of room it
+// wraps back to offset zero and the unused remainder is skipped.
+//
+// Offsets handed out remain valid until the record is popped, or until
+// setCapacity() relocates the storage (layout() changes). Callers must hold
+// the LogBuffer lock for every operation.
+class LogRing {
+   public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    LogRing();
+    ~LogRing();
+    LogRing(const LogRing&) = delete;
+    LogRing& operator=(const LogRing&) = delete;
+
+    // Resize the storage area, relocating the live records. Records that do
+    // not fit are expired from the head, and reported through evicted so
+    // the caller can keep its statistics in step.
+    bool setCapacity(size_t capacity,
+                     void (*evicted)(LogBufferElement* element, void* arg) = nullptr,
+                     void* arg = nullptr);
+    size_t capacity() const {
+        return mCapacity;
+    }
+    // Bytes in use by live records, headers included.
+    size_t used() const {
+        return mUsed;
+    }
+    size_t count() const {
+        return mCount;
+    }
+    bool empty() const {
+        return mCount == 0;
+    }
+    // Incremented whenever records move; outstanding offsets are stale.
+    uint32_t layout() const {
+        return mLayout;
+    }
+
+    // Room for a copy of element without expiring anything?
+    bool fits(const LogBufferElement& element) const;
+    // Append a copy of element, payload inline, returns nullptr if no room.
+    LogBufferElement* append(const LogBufferElement& element, uint64_t sequence);
+    // Expire the oldest record.
+    void pop_front();
+
+    size_t begin() const {
+        return mCount ? mHead : npos;
+    }
+    size_t back() const {
+        return mCount ? mLast : npos;
+    }
+    size_t next(size_t offset) const;
+    // First record with a sequence number at or after sequence, or npos.
+    size_t find(uint64_t sequence) const;
+    // A record at or before start to walk forward from looking for the
+    // entries after start, or npos if the walk has to begin at the head.
+    size_t seek(const log_time& start) const;
+
+    LogBufferElement* element(size_t offset) const {
+        return &record(offset)->element;
+    }
+    uint64_t sequence(size_t offset) const {
+        return record(offset)->sequence;
+    }
+    uint64_t frontSequence() const {
+        return mCount ? record(mHead)->sequence : 0;
+    }
+
+    // Erased records stay in place, hidden to readers, until they reach the
+    // head. Used when a buffer is cleared on behalf of a single uid.
+    bool erased(size_t offset) const {
+        return record(offset)->flags & FLAG_ERASED;
+    }
+    void erase(size_t offset) {
+        record(offset)->flags |= FLAG_ERASED;
+    }
+
+    // Bytes required to store element.
+    static size_t recordSize(const LogBufferElement& element);
+
+    // Move records from the head, oldest first, back to back into run until
+    // limit bytes are reached; at least one record is moved if there is any.
+    // Returns the count moved. The element message pointers in run are left
+    // dangling until relinked.
+    size_t spill(std::vector<char>* run, size_t limit);
+
+    // Accessors for a run of records produced by spill().
+    static LogBufferElement* runElement(char* run, size_t offset) {
+        return &reinterpret_cast<Record*>(run + offset)->element;
+    }
+    static uint64_t runSequence(const char* run, size_t offset) {
+        return reinterpret_cast<const Record*>(run + offset)->sequence;
+    }
+    static size_t runNext(const char* run, size_t offset) {
+        return offset + reinterpret_cast<const Record*>(run + offset)->size;
+    }
+    static bool runErased(const char* run, size_t offset) {
+        return reinterpret_cast<const Record*>(run + offset)->flags & FLAG_ERASED;
+    }
+    static void runErase(char* run, size_t offset) {
+        reinterpret_cast<Record*>(run + offset)->flags |= FLAG_ERASED;
+    }
+    // Point the element messages in run back at their inline payloads, after
+    // the run has been copied or decompressed.
+    static void relink(char* run, size_t size);
+
+   private:
+    static constexpr uint32_t FLAG_ERASED = 1;
+
+    struct Record {
+        uint64_t sequence;
+        uint32_t size;
+        uint32_t flags;
+        LogBufferElement element;
+        // payload follows
+    };
+
+    // Sparse seek index, a record every indexInterval appended, in ring
+    // order and time order.
+    static constexpr size_t indexInterval = 256;
+    struct Checkpoint {
+        size_t offset;
+    };
+
+    Record* record(size_t offset) const {
+        return reinterpret_cast<Record*>(mData + offset);
+    }
+    size_t placement(size_t size) const;
+    void indexAppended(size_t offset);
+
+    char* mData;
+    size_t mCapacity;
+    size_t mUsed;
+    size_t mCount;
+    size_t mHead;     // offset of the oldest record
+    size_t mTail;     // offset where the next record goes
+    size_t mLast;     // offset of the newest record
+    size_t mWrapEnd;  // end of the records at the top when wrapped
+    bool mWrapped;
+    uint32_t mLayout;
+    std::deque<Checkpoint> mIndex;
+    size_t mSinceIndexed;
+};
+
+#endif  // _LOGD_LOG_RING_H__
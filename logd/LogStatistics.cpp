@@ -42,6 +42,7 @@ LogStatistics::LogStatistics() : enable(false) {
         mDroppedElements[id] = 0;
         mSizesTotal[id] = 0;
         mElementsTotal[id] = 0;
+        mStored[id] = 0;
         mOldest[id] = now;
         mNewest[id] = now;
         mNewestDropped[id] = now;
@@ -680,6 +681,34 @@ std::string LogStatistics::format(uid_t uid, pid_t pid,
     output += android::base::StringPrintf("%*s%zu/%zu", spaces, "", totalSize,
                                           totalEls);
 
+    // Bytes actually held when the storage is compressed.
+    bool compressed = false;
+    log_id_for_each(id) {
+        if ((logMask & (1 << id)) && mStored[id]) compressed = true;
+    }
+    if (compressed) {
+        static const char StoredStr[] = "\nStored";
+        spaces = 10 - strlen(StoredStr);
+        output += StoredStr;
+
+        totalSize = 0;
+        log_id_for_each(id) {
+            if (!(logMask & (1 << id))) continue;
+
+            size_t szs = mStored[id];
+            if (szs) {
+                oldLength = output.length();
+                if (spaces < 0) spaces = 0;
+                totalSize += szs;
+                output += android::base::StringPrintf("%*s%zu", spaces, "", szs);
+                spaces -= output.length() - oldLength;
+            }
+            spaces += spaces_total;
+        }
+        if (spaces < 0) spaces = 0;
+        output += android::base::StringPrintf("%*s%zu", spaces, "", totalSize);
+    }
+
     static const char SpanStr[] = "\nLogspan";
     spaces = 10 - strlen(SpanStr);
     output += SpanStr;
@@ -25,10 +25,13 @@
 #include <sys/types.h>
 
 #include <algorithm>  // std::max
+#include <functional>
 #include <memory>
+#include <set>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <utility>
 
 #include <android-base/stringprintf.h>
 #include <android/log.h>
@@ -44,10 +47,29 @@
 
 class LogStatistics;
 
-template <typename TKey, typename TEntry>
+// With ranked set, the table also keeps its entries ordered by size as
+// they are updated, so that sort() for the chattiest few entries, asked
+// for on every pruning pass, does not have to visit the whole table.
+template <typename TKey, typename TEntry, bool ranked = false>
 class LogHashtable {
     std::unordered_map<TKey, TEntry> map;
 
+    typedef std::pair<size_t, TKey> rank_t;
+    std::set<rank_t, std::greater<rank_t>> rank;
+
+    template <typename TIterator>
+    void unrank(const TIterator& it) {
+        if constexpr (ranked) {
+            rank.erase(rank_t(it->second.getSizes(), it->first));
+        }
+    }
+    template <typename TIterator>
+    void addRank(const TIterator& it) {
+        if constexpr (ranked) {
+            rank.insert(rank_t(it->second.getSizes(), it->first));
+        }
+    }
+
     size_t bucket_size() const {
         size_t count = 0;
         for (size_t idx = 0; idx < map.bucket_count(); ++idx) {
@@ -62,6 +84,7 @@ class LogHashtable {
 
     static const size_t unordered_map_per_entry_overhead = sizeof(void*);
     static const size_t unordered_map_bucket_overhead = sizeof(void*);
+    static const size_t set_per_entry_overhead = 4 * sizeof(void*);
 
    public:
     size_t size() const {
@@ -72,7 +95,9 @@ class LogHashtable {
     size_t sizeOf() const {
         return sizeof(*this) +
                (size() * (sizeof(TEntry) + unordered_map_per_entry_overhead)) +
-               (bucket_size() * sizeof(size_t) + unordered_map_bucket_overhead);
+               (bucket_size() * sizeof(size_t) +
+                unordered_map_bucket_overhead) +
+               (rank.size() * (sizeof(rank_t) + set_per_entry_overhead));
     }
 
     typedef typename std::unordered_map<TKey, TEntry>::iterator iterator;
@@ -89,6 +114,23 @@ class LogHashtable {
         const TEntry** retval = new const TEntry*[len];
         memset(retval, 0, sizeof(*retval) * len);
 
+        if constexpr (ranked) {
+            size_t index = 0;
+            for (auto r = rank.begin(); (r != rank.end()) && (index < len);
+                 ++r) {
+                const TEntry& entry = map.find(r->second)->second;
+                if ((uid != AID_ROOT) && (uid != entry.getUid())) {
+                    continue;
+                }
+                if (pid && entry.getPid() && (pid != entry.getPid())) {
+                    continue;
+                }
+                retval[index++] = &entry;
+            }
+            std::unique_ptr<const TEntry* []> sorted(retval);
+            return sorted;
+        }
+
         for (const_iterator it = map.begin(); it != map.end(); ++it) {
             const TEntry& entry = it->second;
 
@@ -122,8 +164,10 @@ class LogHashtable {
         if (it == map.end()) {
             it = map.insert(std::make_pair(key, TEntry(element))).first;
         } else {
+            unrank(it);
             it->second.add(element);
         }
+        addRank(it);
         return it;
     }
 
@@ -132,29 +176,45 @@ class LogHashtable {
         if (it == map.end()) {
             it = map.insert(std::make_pair(key, TEntry(key))).first;
         } else {
+            unrank(it);
             it->second.add(key);
         }
+        addRank(it);
         return it;
     }
 
     void subtract(TKey&& key, const LogBufferElement* element) {
         iterator it = map.find(std::move(key));
-        if ((it != map.end()) && it->second.subtract(element)) {
+        if (it == map.end()) {
+            return;
+        }
+        unrank(it);
+        if (it->second.subtract(element)) {
             map.erase(it);
+        } else {
+            addRank(it);
         }
     }
 
     void subtract(const TKey& key, const LogBufferElement* element) {
         iterator it = map.find(key);
-        if ((it != map.end()) && it->second.subtract(element)) {
+        if (it == map.end()) {
+            return;
+        }
+        unrank(it);
+        if (it->second.subtract(element)) {
             map.erase(it);
+        } else {
+            addRank(it);
         }
     }
 
     inline void drop(TKey key, const LogBufferElement* element) {
         iterator it = map.find(key);
         if (it != map.end()) {
+            unrank(it);
             it->second.drop(element);
+            addRank(it);
         }
     }
 
@@ -671,6 +731,7 @@ class LogStatistics {
     size_t mDroppedElements[LOG_ID_MAX];
     size_t mSizesTotal[LOG_ID_MAX];
     size_t mElementsTotal[LOG_ID_MAX];
+    size_t mStored[LOG_ID_MAX];  // bytes held, when compressed
     log_time mOldest[LOG_ID_MAX];
     log_time mNewest[LOG_ID_MAX];
     log_time mNewestDropped[LOG_ID_MAX];
@@ -678,11 +739,11 @@ class LogStatistics {
     bool enable;
 
     // uid to size list
-    typedef LogHashtable<uid_t, UidEntry> uidTable_t;
+    typedef LogHashtable<uid_t, UidEntry, true> uidTable_t;
     uidTable_t uidTable[LOG_ID_MAX];
 
     // pid of system to size list
-    typedef LogHashtable<pid_t, PidEntry> pidSystemTable_t;
+    typedef LogHashtable<pid_t, PidEntry, true> pidSystemTable_t;
     pidSystemTable_t pidSystemTable[LOG_ID_MAX];
 
     // pid to uid list
@@ -694,7 +755,7 @@ class LogStatistics {
     tidTable_t tidTable;
 
     // tag list
-    typedef LogHashtable<uint32_t, TagEntry> tagTable_t;
+    typedef LogHashtable<uint32_t, TagEntry, true> tagTable_t;
     tagTable_t tagTable;
 
     // security tag list
@@ -769,6 +830,14 @@ class LogStatistics {
     size_t realElements(log_id_t id) const {
         return mElements[id] - mDroppedElements[id];
     }
+    // Set by LogBuffer when storage is compressed, sizes() stays the size
+    // of the entries as logged.
+    void setStored(log_id_t id, size_t size) {
+        mStored[id] = size;
+    }
+    size_t stored(log_id_t id) const {
+        return mStored[id];
+    }
     size_t sizesTotal(log_id_t id) const {
         return mSizesTotal[id];
     }
@@ -18,6 +18,8 @@
 #include <string.h>
 #include <sys/prctl.h>
 
+#include <algorithm>
+
 #include <private/android_logger.h>
 
 #include "FlushCommand.h"
@@ -29,14 +31,21 @@ pthread_mutex_t LogTimeEntry::timesLock = PTHREAD_MUTEX_INITIALIZER;
 
 LogTimeEntry::LogTimeEntry(LogReader& reader, SocketClient* client,
                            bool nonBlock, unsigned long tail, log_mask_t logMask,
-                           pid_t pid, log_time start, uint64_t timeout)
+                           pid_t pid, android_LogPriority prio,
+                           std::vector<uid_t> uids, log_time start,
+                           uint64_t timeout, uint32_t batchMs,
+                           unsigned long batchCount)
     : leadingDropped(false),
       mReader(reader),
       mLogMask(logMask),
       mPid(pid),
+      mPrio(prio),
+      mUids(std::move(uids)),
       mCount(0),
       mTail(tail),
       mIndex(0),
+      mBatchMs(batchMs),
+      mBatchCount(batchCount ? batchCount : 1),
       mClient(client),
       mStart(start),
       mNonBlock(nonBlock),
@@ -95,6 +104,9 @@ void* LogTimeEntry::threadStart(void* obj) {
             }
         }
 
+        // Whatever was notified so far is covered by this flush.
+        me->mBatchPending = 0;
+
         unlock();
 
         if (me->mTail) {
@@ -120,7 +132,11 @@ void* LogTimeEntry::threadStart(void* obj) {
         me->cleanSkip_Locked();
 
         if (!me->mTimeout.tv_sec && !me->mTimeout.tv_nsec) {
-            pthread_cond_wait(&me->threadTriggeredCondition, &timesLock);
+            // A batching reader may have been notified while flushing.
+            if (!me->mBatchPending) {
+                pthread_cond_wait(&me->threadTriggeredCondition, &timesLock);
+            }
+            me->waitForBatch_Locked();
         }
     }
 
@@ -143,6 +159,53 @@ void* LogTimeEntry::threadStart(void* obj) {
     return nullptr;
 }
 
+// Called once woken with a batch started: lets the batch fill for up to
+// mBatchMs, or until it is full or the reader is released.
+void LogTimeEntry::waitForBatch_Locked() {
+    if (!mBatchMs || !mBatchPending) {
+        return;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += mBatchMs / 1000;
+    deadline.tv_nsec += (mBatchMs % 1000) * 1000000;
+    if (deadline.tv_nsec >= NS_PER_SEC) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= NS_PER_SEC;
+    }
+
+    while (!mRelease && (mBatchPending < mBatchCount)) {
+        if (pthread_cond_timedwait(&threadTriggeredCondition, &timesLock,
+                                   &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+}
+
+// Filters the reader asked us to apply, after the tail has been counted so
+// that a tail still refers to the last entries of the buffers.
+bool LogTimeEntry::isSelected(const LogBufferElement* element) const {
+    if (!mUids.empty() &&
+        (std::find(mUids.begin(), mUids.end(), element->getUid()) ==
+         mUids.end())) {
+        return false;
+    }
+    if (mPrio <= ANDROID_LOG_VERBOSE) {
+        return true;
+    }
+
+    // Priority as logcat will see it, chatty entries are reported as info.
+    int prio = ANDROID_LOG_INFO;
+    if (element->getLogId() == LOG_ID_SECURITY) {
+        prio = ANDROID_LOG_WARN;
+    } else if (!element->isBinary() && element->getMsg() &&
+               element->getMsgLen()) {
+        prio = element->getMsg()[0];
+    }
+    return prio >= mPrio;
+}
+
 // A first pass to count the number of elements
 int LogTimeEntry::FilterFirstPass(const LogBufferElement* element, void* obj) {
     LogTimeEntry* me = reinterpret_cast<LogTimeEntry*>(obj);
@@ -223,6 +286,10 @@ int LogTimeEntry::FilterSecondPass(const LogBufferElement* element, void* obj) {
     }
 
 ok:
+    if (!me->isSelected(element)) {
+        goto skip;
+    }
+
     if (!me->skipAhead[element->getLogId()]) {
         LogTimeEntry::unlock();
         return true;
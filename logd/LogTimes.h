@@ -24,6 +24,7 @@
 
 #include <list>
 #include <memory>
+#include <vector>
 
 #include <log/log.h>
 #include <sysutils/SocketClient.h>
@@ -41,18 +42,31 @@ class LogTimeEntry {
     pthread_t mThread;
     LogReader& mReader;
     static void* threadStart(void* me);
+    bool isSelected(const LogBufferElement* element) const;
     const log_mask_t mLogMask;
     const pid_t mPid;
+    const android_LogPriority mPrio;
+    const std::vector<uid_t> mUids;
     unsigned int skipAhead[LOG_ID_MAX];
     pid_t mLastTid[LOG_ID_MAX];
     unsigned long mCount;
     unsigned long mTail;
     unsigned long mIndex;
+    // New entry wakeup coalescing, see notifyNewLog_Locked()
+    const uint32_t mBatchMs;
+    const unsigned long mBatchCount;
+    unsigned long mBatchPending = 0;
+    void waitForBatch_Locked();
 
    public:
     LogTimeEntry(LogReader& reader, SocketClient* client, bool nonBlock,
                  unsigned long tail, log_mask_t logMask, pid_t pid,
-                 log_time start, uint64_t timeout);
+                 android_LogPriority prio, std::vector<uid_t> uids,
+                 log_time start, uint64_t timeout, uint32_t batchMs = 0,
+                 unsigned long batchCount = DEFAULT_BATCH_COUNT);
+
+    // Entries a batching reader lets accumulate before it is woken early
+    static const unsigned long DEFAULT_BATCH_COUNT = 256;
 
     SocketClient* mClient;
     log_time mStart;
@@ -77,6 +91,21 @@ class LogTimeEntry {
         pthread_cond_signal(&threadTriggeredCondition);
     }
 
+    // New entries are available. A reader that asked for batching is only
+    // woken for the first entry of a batch, then waits out its window on its
+    // own, or until mBatchCount entries have been notified, so that each of
+    // its flushes covers many entries.
+    void notifyNewLog_Locked(void) {
+        if (!mBatchMs) {
+            triggerReader_Locked();
+            return;
+        }
+        ++mBatchPending;
+        if ((mBatchPending == 1) || (mBatchPending == mBatchCount)) {
+            triggerReader_Locked();
+        }
+    }
+
     void triggerSkip_Locked(log_id_t id, unsigned int skip) {
         skipAhead[id] = skip;
     }
@@ -17,6 +17,7 @@
 #ifndef _LOGD_LOG_UTILS_H__
 #define _LOGD_LOG_UTILS_H__
 
+#include <string.h>
 #include <sys/cdefs.h>
 #include <sys/types.h>
 
@@ -53,14 +54,15 @@ static inline const char* strnstr(const char* s, ssize_t len,
 
     const char c = *needle++;
     const size_t needleLen = strlen(needle);
-    do {
-        do {
-            if (len <= (ssize_t)needleLen) return nullptr;
-            --len;
-        } while (*s++ != c);
-    } while (fastcmp<memcmp>(s, needle, needleLen));
-    s--;
-    return s;
+    while (len > (ssize_t)needleLen) {
+        // memchr() skips to the next candidate much faster than a byte loop.
+        const char* cp = static_cast<const char*>(memchr(s, c, len - needleLen));
+        if (!cp) return nullptr;
+        len -= cp + 1 - s;
+        s = cp + 1;
+        if (!fastcmp<memcmp>(s, needle, needleLen)) return cp;
+    }
+    return nullptr;
 }
 }
 
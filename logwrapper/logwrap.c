@@ -51,6 +51,20 @@ do {                                                                          \
 
 #define MAX_KLOG_TAG 16
 
+/* The longest line logged as a whole, longer lines are split. */
+#define MAX_LINE_LEN 4095
+
+/* How much of the child's output to read at a time. Tools such as fsck can
+ * print a lot, and reading it in small chunks is what throttles them.
+ */
+#define READ_BUF_SIZE 0x10000
+
+/* Consecutive lines for the Android log are sent together in one entry, so
+ * that a chatty child costs one log write per chunk of output rather than
+ * one per line. logcat still shows each line on its own.
+ */
+#define ALOG_BATCH_SIZE (LOGGER_ENTRY_MAX_PAYLOAD - 256)
+
 /* This is a simple buffer that holds up to the first beginning_buf->buf_size
  * bytes of output from a command.
  */
@@ -94,6 +108,8 @@ struct log_info {
     bool abbreviated;
     FILE *fp;
     struct abbr_buf a_buf;
+    char alog_batch[ALOG_BATCH_SIZE];
+    size_t alog_batch_len;
 };
 
 /* Forware declaration */
@@ -153,13 +169,43 @@ static void add_line_to_circular_buf(struct ending_buf *e_buf,
     e_buf->write = (e_buf->write + line_len) % e_buf->buf_size;
 }
 
+/* Send the lines batched for the Android log */
+static void flush_alog_batch(struct log_info *log_info) {
+    if (log_info->alog_batch_len) {
+        log_info->alog_batch[log_info->alog_batch_len] = '\0';
+        ALOG(LOG_INFO, log_info->btag, "%s", log_info->alog_batch);
+        log_info->alog_batch_len = 0;
+    }
+}
+
+/* Add a line to the batch for the Android log, flushing it if need be */
+static void add_line_to_alog_batch(struct log_info *log_info, const char *line) {
+    size_t len = strlen(line);
+    if (len && (line[len - 1] == '\n')) {
+        len--;
+    }
+    /* Room for the separating newline and the terminating null byte */
+    if (log_info->alog_batch_len + len + 2 > sizeof(log_info->alog_batch)) {
+        flush_alog_batch(log_info);
+        if (len + 1 > sizeof(log_info->alog_batch)) {
+            ALOG(LOG_INFO, log_info->btag, "%s", line);
+            return;
+        }
+    }
+    if (log_info->alog_batch_len) {
+        log_info->alog_batch[log_info->alog_batch_len++] = '\n';
+    }
+    memcpy(&log_info->alog_batch[log_info->alog_batch_len], line, len);
+    log_info->alog_batch_len += len;
+}
+
 /* Log directly to the specified log */
 static void do_log_line(struct log_info *log_info, char *line) {
     if (log_info->log_target & LOG_KLOG) {
         klog_write(6, log_info->klog_fmt, line);
     }
     if (log_info->log_target & LOG_ALOG) {
-        ALOG(LOG_INFO, log_info->btag, "%s", line);
+        add_line_to_alog_batch(log_info, line);
     }
     if (log_info->log_target & LOG_FILE) {
         fprintf(log_info->fp, "%s\n", line);
@@ -292,7 +338,7 @@ static void print_abbr_buf(struct log_info *log_info) {
 static int parent(const char *tag, int parent_read, pid_t pid,
         int *chld_sts, int log_target, bool abbreviated, char *file_path) {
     int status = 0;
-    char buffer[4096];
+    char *buffer;
     struct pollfd poll_fds[] = {
         [0] = {
             .fd = parent_read,
@@ -310,6 +356,12 @@ static int parent(const char *tag, int parent_read, pid_t pid,
     bool found_child = false;
     char tmpbuf[256];
 
+    buffer = malloc(READ_BUF_SIZE);
+    if (!buffer) {
+        ERROR("Cannot allocate read buffer\n");
+        return -1;
+    }
+
     log_info.btag = basename(tag);
     if (!log_info.btag) {
         log_info.btag = (char*) tag;
@@ -345,6 +397,7 @@ static int parent(const char *tag, int parent_read, pid_t pid,
 
     log_info.log_target = log_target;
     log_info.abbreviated = abbreviated;
+    log_info.alog_batch_len = 0;
 
     while (!found_child) {
         if (TEMP_FAILURE_RETRY(poll(poll_fds, ARRAY_SIZE(poll_fds), -1)) < 0) {
@@ -355,7 +408,7 @@ static int parent(const char *tag, int parent_read, pid_t pid,
 
         if (poll_fds[0].revents & POLLIN) {
             sz = TEMP_FAILURE_RETRY(
-                read(parent_read, &buffer[b], sizeof(buffer) - 1 - b));
+                read(parent_read, &buffer[b], READ_BUF_SIZE - 1 - b));
 
             sz += b;
             // Log one line at a time
@@ -380,12 +433,16 @@ static int parent(const char *tag, int parent_read, pid_t pid,
                 }
             }
 
-            if (a == 0 && b == sizeof(buffer) - 1) {
-                // buffer is full, flush
-                buffer[b] = '\0';
-                log_line(&log_info, &buffer[a], b - a);
-                b = 0;
-            } else if (a != b) {
+            // Split lines that are too long
+            while (b - a >= MAX_LINE_LEN) {
+                char c = buffer[a + MAX_LINE_LEN];
+                buffer[a + MAX_LINE_LEN] = '\0';
+                log_line(&log_info, &buffer[a], MAX_LINE_LEN);
+                buffer[a + MAX_LINE_LEN] = c;
+                a += MAX_LINE_LEN;
+            }
+
+            if (a != b) {
                 // Keep left-overs
                 b -= a;
                 memmove(buffer, &buffer[a], b);
@@ -394,6 +451,9 @@ static int parent(const char *tag, int parent_read, pid_t pid,
                 a = 0;
                 b = 0;
             }
+
+            // Don't hold on to what was read while waiting for more
+            flush_alog_batch(&log_info);
         }
 
         if (poll_fds[0].revents & POLLHUP) {
@@ -451,12 +511,14 @@ static int parent(const char *tag, int parent_read, pid_t pid,
 
 err_waitpid:
 err_poll:
+    flush_alog_batch(&log_info);
     if (log_target & LOG_FILE) {
         fclose(log_info.fp); /* Also closes underlying fd */
     }
     if (abbreviated) {
         free_abbr_buf(&log_info.a_buf);
     }
+    free(buffer);
     return rc;
 }
 
@@ -52,8 +52,24 @@ struct TrieNodeInternal {
   // Exact matches are a sorted list of exact matches at this node_; binary search them.
   uint32_t num_exact_matches;
   uint32_t exact_match_entries;
+
+  // Added in version 2.
+  // The ChildNameKey() of each child node, in the same order as child_nodes. Searching this
+  // compact array first means only the children that share a key have their names compared.
+  uint32_t child_name_keys;
 };
 
+// The first four bytes of a name, packed such that comparing keys orders names the same way as
+// strcmp() does, as far as those bytes go. Shorter names are padded with '\0'.
+static inline uint32_t ChildNameKey(const char* name, uint32_t namelen) {
+  uint32_t key = 0;
+  for (uint32_t i = 0; i < 4; ++i) {
+    key <<= 8;
+    if (i < namelen) key |= static_cast<unsigned char>(name[i]);
+  }
+  return key;
+}
+
 struct PropertyInfoAreaHeader {
   // The current version of this data as created by property service.
   uint32_t current_version;
@@ -71,6 +87,10 @@ class SerializedData {
     return reinterpret_cast<const PropertyInfoAreaHeader*>(data_base_)->size;
   }
 
+  uint32_t version() const {
+    return reinterpret_cast<const PropertyInfoAreaHeader*>(data_base_)->current_version;
+  }
+
   const char* c_string(uint32_t offset) const {
     if (offset != 0 && offset > size()) return nullptr;
     return static_cast<const char*>(data_base_ + offset);
@@ -115,6 +135,12 @@ class TrieNode {
 
   bool FindChildForString(const char* input, uint32_t namelen, TrieNode* child) const;
 
+  // The keys of the children, or nullptr if the data predates them.
+  const uint32_t* child_name_keys() const {
+    if (serialized_data_->version() < 2) return nullptr;
+    return serialized_data_->uint32_array(trie_node_base_->child_name_keys);
+  }
+
   uint32_t num_prefixes() const { return trie_node_base_->num_prefixes; }
   const PropertyEntry* prefix(int n) const {
     uint32_t prefix_entry_offset =
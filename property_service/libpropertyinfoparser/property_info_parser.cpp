@@ -28,11 +28,10 @@ namespace properties {
 
 namespace {
 
-// Binary search to find index of element in an array compared via f(search).
+// Binary search to find index of element in an array compared via f(search), within the indexes
+// [bottom, top].
 template <typename F>
-int Find(uint32_t array_length, F&& f) {
-  int bottom = 0;
-  int top = array_length - 1;
+int Find(int bottom, int top, F&& f) {
   while (top >= bottom) {
     int search = (top + bottom) / 2;
 
@@ -45,6 +44,12 @@ int Find(uint32_t array_length, F&& f) {
   return -1;
 }
 
+// Binary search to find index of element in an array compared via f(search).
+template <typename F>
+int Find(uint32_t array_length, F&& f) {
+  return Find(0, array_length - 1, f);
+}
+
 }  // namespace
 
 // Binary search the list of contexts to find the index of a given context string.
@@ -68,7 +73,28 @@ int PropertyInfoArea::FindTypeIndex(const char* type) const {
 // Binary search the list of children nodes to find a TrieNode for a given property piece.
 // Used to traverse the Trie in GetPropertyInfoIndexes().
 bool TrieNode::FindChildForString(const char* name, uint32_t namelen, TrieNode* child) const {
-  auto node_index = Find(trie_node_base_->num_child_nodes, [this, name, namelen](auto array_offset) {
+  int bottom = 0;
+  int top = trie_node_base_->num_child_nodes - 1;
+
+  // Narrow the search down to the children with the same key, without touching the nodes.
+  if (const uint32_t* keys = child_name_keys(); keys != nullptr) {
+    const uint32_t key = ChildNameKey(name, namelen);
+    int low = bottom;
+    int high = top + 1;
+    while (low < high) {
+      int middle = (low + high) / 2;
+      if (keys[middle] < key) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    bottom = low;
+    while (high <= top && keys[high] == key) ++high;
+    top = high - 1;
+  }
+
+  auto node_index = Find(bottom, top, [this, name, namelen](auto array_offset) {
     const char* child_name = child_node(array_offset).name();
     int cmp = strncmp(child_name, name, namelen);
     if (cmp == 0 && child_name[namelen] != '\0') {
@@ -0,0 +1,106 @@
+//
+// Copyright (C) 2019 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <benchmark/benchmark.h>
+#include <property_info_parser/property_info_parser.h>
+#include <property_info_serializer/property_info_serializer.h>
+
+using android::base::ReadFileToString;
+using android::properties::BuildTrie;
+using android::properties::ParsePropertyInfoFile;
+using android::properties::PropertyInfoArea;
+using android::properties::PropertyInfoEntry;
+
+namespace {
+
+// The files that init builds /dev/__properties__/property_info from.
+const char* const kPropertyContexts[] = {
+    "/system/etc/selinux/plat_property_contexts",
+    "/vendor/etc/selinux/vendor_property_contexts",
+    "/vendor/etc/selinux/nonplat_property_contexts",
+    "/product/etc/selinux/product_property_contexts",
+    "/odm/etc/selinux/odm_property_contexts",
+};
+
+std::vector<PropertyInfoEntry> LoadPropertyContexts() {
+  std::vector<PropertyInfoEntry> property_infos;
+  for (const char* path : kPropertyContexts) {
+    std::string file_contents;
+    if (!ReadFileToString(path, &file_contents)) continue;
+    std::vector<std::string> errors;
+    ParsePropertyInfoFile(file_contents, &property_infos, &errors);
+  }
+  return property_infos;
+}
+
+// Names that exercise every entry: the exact matches themselves, and a name under each prefix.
+std::vector<std::string> NamesToLookUp(const std::vector<PropertyInfoEntry>& property_infos) {
+  std::vector<std::string> names;
+  for (const auto& entry : property_infos) {
+    names.emplace_back(entry.exact_match ? entry.name : entry.name + "benchmark");
+  }
+  return names;
+}
+
+}  // namespace
+
+static void BM_BuildTrie(benchmark::State& state) {
+  auto property_infos = LoadPropertyContexts();
+  if (property_infos.empty()) {
+    state.SkipWithError("no property_contexts files found");
+    return;
+  }
+
+  for (auto _ : state) {
+    std::string serialized_trie;
+    std::string error;
+    BuildTrie(property_infos, "u:object_r:default_prop:s0", "string", &serialized_trie, &error);
+    benchmark::DoNotOptimize(serialized_trie.data());
+  }
+}
+BENCHMARK(BM_BuildTrie);
+
+static void BM_GetPropertyInfo(benchmark::State& state) {
+  auto property_infos = LoadPropertyContexts();
+  std::string serialized_trie;
+  std::string error;
+  if (property_infos.empty() ||
+      !BuildTrie(property_infos, "u:object_r:default_prop:s0", "string", &serialized_trie,
+                 &error)) {
+    state.SkipWithError("no usable property_contexts files found");
+    return;
+  }
+  auto property_info_area = reinterpret_cast<const PropertyInfoArea*>(serialized_trie.data());
+  auto names = NamesToLookUp(property_infos);
+
+  for (auto _ : state) {
+    for (const auto& name : names) {
+      const char* context;
+      const char* type;
+      property_info_area->GetPropertyInfo(name.c_str(), &context, &type);
+      benchmark::DoNotOptimize(context);
+      benchmark::DoNotOptimize(type);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * names.size());
+}
+BENCHMARK(BM_GetPropertyInfo);
+
+BENCHMARK_MAIN();
@@ -39,7 +39,7 @@ TEST(propertyinfoserializer, TrieNodeCheck) {
   auto property_info_area = reinterpret_cast<const PropertyInfoArea*>(serialized_trie.data());
 
   // Initial checks for property area.
-  EXPECT_EQ(1U, property_info_area->current_version());
+  EXPECT_EQ(2U, property_info_area->current_version());
   EXPECT_EQ(1U, property_info_area->minimum_supported_version());
 
   // Check the root node
@@ -886,5 +886,86 @@ TEST(propertyinfoserializer, GetPropertyInfo_empty_context_and_type) {
   EXPECT_STREQ("5th", type);
 }
 
+TEST(propertyinfoserializer, ChildNodesAreAdjacent) {
+  auto property_info = std::vector<PropertyInfoEntry>{
+      {"audio.", "1st", "1st", false},       {"audio.hal.", "2nd", "2nd", false},
+      {"bluetooth.", "3rd", "3rd", false},   {"bluetooth.a2dp.", "4th", "4th", false},
+      {"camera.", "5th", "5th", false},      {"dalvik.vm.", "6th", "6th", false},
+      {"persist.sys.", "7th", "7th", false}, {"ro.build.id", "8th", "8th", true},
+  };
+
+  auto serialized_trie = std::string();
+  auto build_trie_error = std::string();
+  ASSERT_TRUE(BuildTrie(property_info, "default", "default", &serialized_trie, &build_trie_error))
+      << build_trie_error;
+
+  auto property_info_area = reinterpret_cast<const PropertyInfoArea*>(serialized_trie.data());
+  auto root_node = property_info_area->root_node();
+  ASSERT_EQ(6U, root_node.num_child_nodes());
+
+  // Each child is its node, its property entry and its name, with nothing from the grandchildren
+  // in between.
+  for (uint32_t i = 0; i + 1 < root_node.num_child_nodes(); ++i) {
+    const char* name = root_node.child_node(i).name();
+    const char* next_name = root_node.child_node(i + 1).name();
+    size_t aligned_name_size = (strlen(name) + 1 + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+    EXPECT_EQ(aligned_name_size + sizeof(TrieNodeInternal) + sizeof(PropertyEntry),
+              static_cast<size_t>(next_name - name))
+        << name;
+  }
+
+  const char* context;
+  property_info_area->GetPropertyInfo("audio.hal.primary", &context, nullptr);
+  EXPECT_STREQ("2nd", context);
+  property_info_area->GetPropertyInfo("bluetooth.a2dp.enabled", &context, nullptr);
+  EXPECT_STREQ("4th", context);
+  property_info_area->GetPropertyInfo("persist.sys.locale", &context, nullptr);
+  EXPECT_STREQ("7th", context);
+  property_info_area->GetPropertyInfo("ro.build.id", &context, nullptr);
+  EXPECT_STREQ("8th", context);
+}
+
+TEST(propertyinfoserializer, GetPropertyInfo_shared_child_name_keys) {
+  auto property_info = std::vector<PropertyInfoEntry>{
+      {"ven.", "1st", "1st", false},        {"vend.", "2nd", "2nd", false},
+      {"vendor.", "3rd", "3rd", false},     {"vendor_a.", "4th", "4th", false},
+      {"vendor_b.x", "5th", "5th", true},   {"vendorz.", "6th", "6th", false},
+      {"\xffvendor.", "7th", "7th", false},
+  };
+
+  auto serialized_trie = std::string();
+  auto build_trie_error = std::string();
+  ASSERT_TRUE(BuildTrie(property_info, "default", "default", &serialized_trie, &build_trie_error))
+      << build_trie_error;
+
+  auto check = [&serialized_trie]() {
+    auto property_info_area = reinterpret_cast<const PropertyInfoArea*>(serialized_trie.data());
+    const char* context;
+    property_info_area->GetPropertyInfo("ven.x", &context, nullptr);
+    EXPECT_STREQ("1st", context);
+    property_info_area->GetPropertyInfo("vend.x", &context, nullptr);
+    EXPECT_STREQ("2nd", context);
+    property_info_area->GetPropertyInfo("vendor.x", &context, nullptr);
+    EXPECT_STREQ("3rd", context);
+    property_info_area->GetPropertyInfo("vendor_a.x", &context, nullptr);
+    EXPECT_STREQ("4th", context);
+    property_info_area->GetPropertyInfo("vendor_b.x", &context, nullptr);
+    EXPECT_STREQ("5th", context);
+    property_info_area->GetPropertyInfo("vendorz.x", &context, nullptr);
+    EXPECT_STREQ("6th", context);
+    property_info_area->GetPropertyInfo("\xffvendor.x", &context, nullptr);
+    EXPECT_STREQ("7th", context);
+    property_info_area->GetPropertyInfo("vendo.x", &context, nullptr);
+    EXPECT_STREQ("default", context);
+    property_info_area->GetPropertyInfo("vendor_c.x", &context, nullptr);
+    EXPECT_STREQ("default", context);
+  };
+  check();
+
+  // Data written before the child name keys were added is still searched correctly.
+  reinterpret_cast<PropertyInfoAreaHeader*>(serialized_trie.data())->current_version = 1;
+  check();
+}
+
 }  // namespace properties
 }  // namespace android
@@ -51,6 +51,11 @@ class TrieNodeArena {
     return ArenaObjectPointer<T>(data_, offset);
   }
 
+  template <typename T>
+  ArenaObjectPointer<T> object(uint32_t offset) {
+    return ArenaObjectPointer<T>(data_, offset);
+  }
+
   uint32_t AllocateUint32Array(int length) {
     uint32_t offset;
     AllocateData(sizeof(uint32_t) * length, &offset);
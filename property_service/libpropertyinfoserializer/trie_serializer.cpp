@@ -58,19 +58,19 @@ uint32_t TrieSerializer::WritePropertyEntry(const PropertyEntryBuilder& property
 uint32_t TrieSerializer::WriteTrieNode(const TrieBuilderNode& builder_node) {
   uint32_t trie_offset;
   auto trie = arena_->AllocateObject<TrieNodeInternal>(&trie_offset);
-
   trie->property_entry = WritePropertyEntry(builder_node.property_entry());
+  return trie_offset;
+}
 
+void TrieSerializer::WriteTrieNodeContents(const TrieBuilderNode& builder_node,
+                                           uint32_t trie_offset) {
   // Write prefix matches
   auto sorted_prefix_matches = builder_node.prefixes();
   // Prefixes are sorted by descending length
   std::sort(sorted_prefix_matches.begin(), sorted_prefix_matches.end(),
             [](const auto& lhs, const auto& rhs) { return lhs.name.size() > rhs.name.size(); });
 
-  trie->num_prefixes = sorted_prefix_matches.size();
-
   uint32_t prefix_entries_array_offset = arena_->AllocateUint32Array(sorted_prefix_matches.size());
-  trie->prefix_entries = prefix_entries_array_offset;
 
   for (unsigned int i = 0; i < sorted_prefix_matches.size(); ++i) {
     uint32_t property_entry_offset = WritePropertyEntry(sorted_prefix_matches[i]);
@@ -83,11 +83,8 @@ uint32_t TrieSerializer::WriteTrieNode(const TrieBuilderNode& builder_node) {
   std::sort(sorted_exact_matches.begin(), sorted_exact_matches.end(),
             [](const auto& lhs, const auto& rhs) { return lhs.name < rhs.name; });
 
-  trie->num_exact_matches = sorted_exact_matches.size();
-
   uint32_t exact_match_entries_array_offset =
       arena_->AllocateUint32Array(sorted_exact_matches.size());
-  trie->exact_match_entries = exact_match_entries_array_offset;
 
   for (unsigned int i = 0; i < sorted_exact_matches.size(); ++i) {
     uint32_t property_entry_offset = WritePropertyEntry(sorted_exact_matches[i]);
@@ -99,14 +96,32 @@ uint32_t TrieSerializer::WriteTrieNode(const TrieBuilderNode& builder_node) {
   std::sort(sorted_children.begin(), sorted_children.end(),
             [](const auto& lhs, const auto& rhs) { return lhs.name() < rhs.name(); });
 
-  trie->num_child_nodes = sorted_children.size();
   uint32_t children_offset_array_offset = arena_->AllocateUint32Array(sorted_children.size());
-  trie->child_nodes = children_offset_array_offset;
+  uint32_t child_name_keys_array_offset = arena_->AllocateUint32Array(sorted_children.size());
+  for (unsigned int i = 0; i < sorted_children.size(); ++i) {
+    const std::string& name = sorted_children[i].name();
+    arena_->uint32_array(child_name_keys_array_offset)[i] = ChildNameKey(name.c_str(), name.size());
+  }
 
+  // TrieNode::FindChildForString() searches the keys first, and then reads the names of the few
+  // children that share the key, so all of the children, with their property entries and names,
+  // are written back to back with the arrays above, before any of their own contents.
   for (unsigned int i = 0; i < sorted_children.size(); ++i) {
     arena_->uint32_array(children_offset_array_offset)[i] = WriteTrieNode(sorted_children[i]);
   }
-  return trie_offset;
+  for (unsigned int i = 0; i < sorted_children.size(); ++i) {
+    WriteTrieNodeContents(sorted_children[i],
+                          arena_->uint32_array(children_offset_array_offset)[i]);
+  }
+
+  auto trie = arena_->object<TrieNodeInternal>(trie_offset);
+  trie->num_prefixes = sorted_prefix_matches.size();
+  trie->prefix_entries = prefix_entries_array_offset;
+  trie->num_exact_matches = sorted_exact_matches.size();
+  trie->exact_match_entries = exact_match_entries_array_offset;
+  trie->num_child_nodes = sorted_children.size();
+  trie->child_nodes = children_offset_array_offset;
+  trie->child_name_keys = child_name_keys_array_offset;
 }
 
 TrieSerializer::TrieSerializer() {}
@@ -115,7 +130,7 @@ std::string TrieSerializer::SerializeTrie(const TrieBuilder& trie_builder) {
   arena_.reset(new TrieNodeArena());
 
   auto header = arena_->AllocateObject<PropertyInfoAreaHeader>(nullptr);
-  header->current_version = 1;
+  header->current_version = 2;
   header->minimum_supported_version = 1;
 
   // Store where we're about to write the contexts.
@@ -130,6 +145,7 @@ std::string TrieSerializer::SerializeTrie(const TrieBuilder& trie_builder) {
   header->size = arena_->size();
 
   uint32_t root_trie_offset = WriteTrieNode(trie_builder.builder_root());
+  WriteTrieNodeContents(trie_builder.builder_root(), root_trie_offset);
   header->root_offset = root_trie_offset;
 
   // Record the real size now that we've written everything
@@ -38,9 +38,12 @@ class TrieSerializer {
   void SerializeStrings(const std::set<std::string>& strings);
   uint32_t WritePropertyEntry(const PropertyEntryBuilder& property_entry);
 
-  // Writes a new TrieNode to arena, and recursively writes its children.
+  // Writes a new TrieNode to arena, with only its own property entry.
   // Returns the offset within arena.
   uint32_t WriteTrieNode(const TrieBuilderNode& builder_node);
+  // Writes the prefixes, exact matches and children of the TrieNode at trie_offset, and
+  // recursively the contents of its children.
+  void WriteTrieNodeContents(const TrieBuilderNode& builder_node, uint32_t trie_offset);
 
   const PropertyInfoArea* serialized_info() const {
     return reinterpret_cast<const PropertyInfoArea*>(arena_->data().data());
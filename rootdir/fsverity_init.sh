@@ -18,11 +18,10 @@
 # Enforce fsverity signature checking
 echo 1 > /proc/sys/fs/verity/require_signatures
 
-# Load all keys
-for cert in /product/etc/security/fsverity/*.der; do
-  /system/bin/mini-keyctl padd asymmetric fsv_product .fs-verity < "$cert" ||
-    log -p e -t fsverity_init "Failed to load $cert"
-done
+# Load all keys, with a single mini-keyctl
+/system/bin/mini-keyctl padd asymmetric fsv_product .fs-verity \
+    /product/etc/security/fsverity/*.der ||
+  log -p e -t fsverity_init "Failed to load some of /product/etc/security/fsverity/*.der"
 
 DEBUGGABLE=$(getprop ro.debuggable)
 if [ $DEBUGGABLE != "1" ]; then
@@ -64,6 +64,10 @@ using namespace android;
 #define DEFAULT_PERIODIC_CHORES_INTERVAL_UID_IO_LIMIT ( 300 )
 #define DEFAULT_PERIODIC_CHORES_INTERVAL_FLUSH_PROTO ( 3600 )
 
+// Per disk and partition sampling interval in milliseconds, and samples kept
+#define DEFAULT_DISKSTATS_SAMPLE_INTERVAL ( 1000 )
+#define DEFAULT_DISKSTATS_SAMPLE_HISTORY ( 300 )
+
 // UID IO threshold in bytes
 #define DEFAULT_PERIODIC_CHORES_UID_IO_THRESHOLD ( 1024 * 1024 * 1024ULL )
 
@@ -73,6 +77,7 @@ struct storaged_config {
     int periodic_chores_interval_uid_io;
     int periodic_chores_interval_flush_proto;
     int event_time_check_usec;  // check how much cputime spent in event loop
+    int diskstats_sample_interval_msec;  // 0 disables per partition sampling
 };
 
 class storaged_t : public android::hardware::health::V2_0::IHealthInfoCallback,
@@ -81,6 +86,7 @@ class storaged_t : public android::hardware::health::V2_0::IHealthInfoCallback,
     time_t mTimer;
     storaged_config mConfig;
     unique_ptr<disk_stats_monitor> mDsm;
+    unique_ptr<diskstats_sampler> mSampler;
     uid_monitor mUidm;
     time_t mStarttime;
     sp<android::hardware::health::V2_0::IHealth> health;
@@ -95,7 +101,24 @@ class storaged_t : public android::hardware::health::V2_0::IHealthInfoCallback,
         return string("/data/misc_ce/") + to_string(user_id) +
                "/storaged/storaged.proto";
     }
+    // The uid I/O history of a user is appended to a journal as it grows,
+    // instead of being part of each rewrite of the proto. The journal is only
+    // rewritten once it has grown well past the history still in memory.
+    struct uid_io_journal {
+        uint64_t last_end_ts = 0;      // of the newest record in the journal
+        size_t size = 0;               // of the valid records in the journal
+        bool needs_rewrite = false;    // after an append failed or was torn
+        bool proto_has_history = false;
+    };
+    unordered_map<userid_t, uid_io_journal> uid_io_journals;
+    void load_uid_io_journal(userid_t user_id);
+    bool flush_uid_io_journal(userid_t user_id, const UidIOUsage& uid_io_usage);
+    string uid_io_journal_path(userid_t user_id) {
+        return string("/data/misc_ce/") + to_string(user_id) +
+               "/storaged/uid_io.journal";
+    }
     void init_health_service();
+    void init_diskstats_sampler();
 
   public:
     storaged_t(void);
@@ -120,6 +143,14 @@ class storaged_t : public android::hardware::health::V2_0::IHealthInfoCallback,
 
     uint32_t get_recent_perf(void) { return storage_info->get_recent_perf(); }
 
+    vector<diskstats_summary> get_diskstats_summaries(void) {
+        return mSampler ? mSampler->get_summaries() : vector<diskstats_summary>();
+    }
+
+    vector<diskstats_sample> get_diskstats_history(const string& name) {
+        return mSampler ? mSampler->get_history(name) : vector<diskstats_sample>();
+    }
+
     map<uint64_t, struct uid_records> get_uid_records(
             double hours, uint64_t threshold, bool force_report) {
         return mUidm.dump(hours, threshold, force_report);
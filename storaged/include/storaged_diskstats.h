@@ -19,6 +19,11 @@
 
 #include <stdint.h>
 
+#include <string>
+#include <vector>
+
+#include <utils/Mutex.h>
+
 #include <android/hardware/health/2.0/IHealth.h>
 
 // number of attributes diskstats has
@@ -196,4 +201,77 @@ public:
   void publish(void);
 };
 
+// One interval of a disk or partition, as seen by diskstats_sampler.
+struct diskstats_sample {
+    uint64_t end_time;          // monotonic time the interval ends (ms)
+    uint32_t interval;          // length of the interval (ms)
+    uint32_t read_perf;         // read speed (kbytes/s)
+    uint32_t read_ios;          // read I/Os per second
+    uint32_t read_latency;      // average time a read completed in the interval took (us)
+    uint32_t write_perf;        // write speed (kbytes/s)
+    uint32_t write_ios;         // write I/Os per second
+    uint32_t write_latency;     // average time a write completed in the interval took (us)
+    uint32_t queue;             // I/Os in flight at the end of the interval
+};
+
+struct diskstats_percentiles {
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t p99;
+    uint32_t max;
+};
+
+struct diskstats_summary {
+    std::string name;           // kernel name, e.g. "sda3"
+    std::string partname;       // GPT partition name, e.g. "userdata", if any
+    uint32_t samples;
+    diskstats_percentiles read_perf;
+    diskstats_percentiles read_latency;
+    diskstats_percentiles write_perf;
+    diskstats_percentiles write_latency;
+    diskstats_percentiles queue;
+};
+
+/*
+ * Samples the stat file of every disk and partition under /sys/block at a
+ * fine granularity, and keeps the recent history of each in a ring. Unlike
+ * disk_stats_monitor, which follows the one configured device once per event
+ * loop, this is meant to pin I/O jank on a partition.
+ *
+ * The stat files are opened once by scan(); each sample is then a pread and a
+ * parse per device.
+ */
+class diskstats_sampler {
+  private:
+    struct device {
+        std::string name;
+        std::string partname;
+        int fd;
+        bool primed;
+        disk_stats prev;
+        std::vector<diskstats_sample> ring;
+        size_t next;            // where the next sample goes in the ring
+        size_t count;           // valid samples in the ring
+    };
+    const std::string mSysfsBlock;
+    const size_t mHistory;
+    android::Mutex mLock;
+    std::vector<device> mDevices;
+
+    bool add_device(const std::string& name, const std::string& dir);
+    void record(device* dev, const disk_stats& curr);
+
+  public:
+    explicit diskstats_sampler(const std::string& sysfs_block = "/sys/block",
+                               size_t history = 300)
+        : mSysfsBlock(sysfs_block), mHistory(history) {}
+    ~diskstats_sampler();
+    // Finds and opens the disks and partitions. Returns how many there are.
+    size_t scan();
+    // Reads every device once, adding to its history the interval since the last read.
+    void sample();
+    std::vector<diskstats_summary> get_summaries();
+    std::vector<diskstats_sample> get_history(const std::string& name);
+};
+
 #endif /* _STORAGED_DISKSTATS_H_ */
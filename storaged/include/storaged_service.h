@@ -32,6 +32,8 @@ class StoragedService : public BinderService<StoragedService>, public BnStoraged
 private:
     void dumpUidRecordsDebug(int fd, const vector<struct uid_record>& entries);
     void dumpUidRecords(int fd, const vector<struct uid_record>& entries);
+    void dumpDiskstats(int fd);
+    void dumpDiskstatsHistory(int fd, const string& name);
 public:
     static status_t start();
     static char const* getServiceName() { return "storaged"; }
@@ -20,6 +20,7 @@
 #include <stdint.h>
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -39,7 +40,7 @@ using namespace android::os::storaged;
 
 class uid_info : public UidInfo {
 public:
-    bool parse_uid_io_stats(string&& s);
+    bool parse_uid_io_stats(std::string_view s);
 };
 
 class io_usage {
@@ -83,13 +84,15 @@ private:
 
     // last dump from /proc/uid_io/stats, uid -> uid_info
     unordered_map<uint32_t, uid_info> last_uid_io_stats_;
+    // package names of the uids in last_uid_io_stats_, uid -> name
+    unordered_map<uint32_t, string> uid_names_;
     // current io usage for next report, app name -> uid_io_usage
     unordered_map<string, uid_io_usage> curr_io_stats_;
     // io usage records, end timestamp -> {start timestamp, vector of records}
     map<uint64_t, uid_records> io_history_;
     // charger ON/OFF
     charger_stat_t charger_stat_;
-    // protects curr_io_stats, last_uid_io_stats, records and charger_stat
+    // protects curr_io_stats, last_uid_io_stats, uid_names, records and charger_stat
     Mutex uidm_mutex_;
     // start time for IO records
     uint64_t start_ts_;
@@ -36,6 +36,12 @@ void add_disk_stats(struct disk_stats* src, struct disk_stats* dst);
 map<string, io_usage> merge_io_usage(const vector<uid_record>& entries);
 void sort_running_uids_info(std::vector<UidInfo> &uids);
 
+// UID I/O history journal: back to back UidIOItem records, each with its size and checksum
+void append_uid_io_journal_record(const UidIOItem& item, std::string* journal);
+// Adds the records of |journal| to |usage|, up to the first one that is truncated
+// or corrupted, and returns the size of the records that were added.
+size_t parse_uid_io_journal(const std::string& journal, UidIOUsage* usage);
+
 // Logging
 void log_console_running_uids_info(const std::vector<UidInfo>& uids, bool flag_dump_task);
 void log_console_perf_history(const vector<int>& perf_history);
@@ -17,6 +17,7 @@
 #define _UID_INFO_H_
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 #include <binder/Parcelable.h>
@@ -56,7 +57,7 @@ public:
     std::string comm;
     pid_t pid;
     io_stats io[UID_STATS];
-    bool parse_task_io_stats(std::string&& s);
+    bool parse_task_io_stats(std::string_view s);
 };
 
 class UidInfo : public Parcelable {
@@ -27,6 +27,7 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <thread>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -60,6 +61,8 @@ constexpr ssize_t benchmark_unit_size = 16 * 1024;  // 16KB
 
 constexpr ssize_t min_benchmark_size = 128 * 1024;  // 128KB
 
+constexpr size_t min_uid_io_journal_rewrite_size = 64 * 1024;  // 64KB
+
 }  // namespace
 
 const uint32_t storaged_t::current_version = 4;
@@ -89,6 +92,32 @@ void storaged_t::init() {
     init_health_service();
     mDsm = std::make_unique<disk_stats_monitor>(health);
     storage_info.reset(storage_info_t::get_storage_info(health));
+    init_diskstats_sampler();
+}
+
+void storaged_t::init_diskstats_sampler() {
+    int interval = mConfig.diskstats_sample_interval_msec;
+    if (interval <= 0) {
+        return;
+    }
+
+    auto sampler = std::make_unique<diskstats_sampler>(
+            "/sys/block", property_get_int32("ro.storaged.diskstats_sample.history",
+                                             DEFAULT_DISKSTATS_SAMPLE_HISTORY));
+    if (sampler->scan() == 0) {
+        LOG_TO(SYSTEM, WARNING) << "diskstats: no block devices to sample";
+        return;
+    }
+    mSampler = std::move(sampler);
+
+    // Sampled apart from the event loop, which runs far too rarely for this.
+    diskstats_sampler* s = mSampler.get();
+    std::thread([s, interval]() {
+        for (;;) {
+            s->sample();
+            std::this_thread::sleep_for(milliseconds(interval));
+        }
+    }).detach();
 }
 
 void storaged_t::init_health_service() {
@@ -147,6 +176,10 @@ storaged_t::storaged_t(void) {
     mConfig.event_time_check_usec =
         property_get_int32("ro.storaged.event.perf_check", 0);
 
+    mConfig.diskstats_sample_interval_msec =
+        property_get_int32("ro.storaged.diskstats_sample.interval",
+                           DEFAULT_DISKSTATS_SAMPLE_INTERVAL);
+
     mConfig.periodic_chores_interval_disk_stats_publish =
         property_get_int32("ro.storaged.disk_stats_pub",
                            DEFAULT_PERIODIC_CHORES_INTERVAL_DISK_STATS_PUBLISH);
@@ -166,6 +199,7 @@ storaged_t::storaged_t(void) {
 void storaged_t::add_user_ce(userid_t user_id) {
     if (!proto_loaded[user_id]) {
         load_proto(user_id);
+        load_uid_io_journal(user_id);
         proto_loaded[user_id] = true;
     }
 }
@@ -174,6 +208,8 @@ void storaged_t::remove_user_ce(userid_t user_id) {
     proto_loaded[user_id] = false;
     mUidm.clear_user_history(user_id);
     RemoveFileIfExists(proto_path(user_id), nullptr);
+    RemoveFileIfExists(uid_io_journal_path(user_id), nullptr);
+    uid_io_journals.erase(user_id);
 }
 
 void storaged_t::load_proto(userid_t user_id) {
@@ -197,6 +233,7 @@ void storaged_t::load_proto(userid_t user_id) {
     }
 
     mUidm.load_uid_io_proto(user_id, proto.uid_io_usage());
+    uid_io_journals[user_id].proto_has_history = uid_io_usage.uid_io_items_size() > 0;
 
     if (user_id == USER_SYSTEM) {
         storage_info->load_perf_history_proto(proto.perf_history());
@@ -293,6 +330,88 @@ void storaged_t::flush_proto_data(userid_t user_id,
     rename(tmp_file.c_str(), proto_file.c_str());
 }
 
+void storaged_t::load_uid_io_journal(userid_t user_id) {
+    uid_io_journal& journal = uid_io_journals[user_id];
+    string journal_file = uid_io_journal_path(user_id);
+    string data;
+    if (!ReadFileToString(journal_file, &data)) return;
+
+    UidIOUsage uid_io_usage;
+    journal.size = parse_uid_io_journal(data, &uid_io_usage);
+    if (journal.size != data.size()) {
+        LOG_TO(SYSTEM, WARNING) << "Dropped " << data.size() - journal.size
+                                << " bytes of invalid records in " << journal_file;
+        journal.needs_rewrite = true;
+    }
+    for (const auto& item : uid_io_usage.uid_io_items()) {
+        journal.last_end_ts = MAX(journal.last_end_ts, item.end_ts());
+    }
+
+    // Records that are also in the proto, if flushing the journal failed
+    // before, aren't added twice.
+    mUidm.load_uid_io_proto(user_id, uid_io_usage);
+}
+
+bool storaged_t::flush_uid_io_journal(userid_t user_id, const UidIOUsage& uid_io_usage) {
+    uid_io_journal& journal = uid_io_journals[user_id];
+    string journal_file = uid_io_journal_path(user_id);
+
+    string records;
+    uint64_t last_end_ts = journal.last_end_ts;
+    for (const auto& item : uid_io_usage.uid_io_items()) {
+        if (item.end_ts() > journal.last_end_ts) {
+            append_uid_io_journal_record(item, &records);
+            last_end_ts = MAX(last_end_ts, item.end_ts());
+        }
+    }
+
+    // Records that aged out of the history stay in the journal until it gets
+    // rewritten, which bounds it to a few times the size of the history.
+    size_t max_size = MAX(min_uid_io_journal_rewrite_size,
+                          2 * static_cast<size_t>(uid_io_usage.ByteSize()));
+    if (!journal.needs_rewrite && journal.size + records.size() <= max_size) {
+        if (records.empty()) return true;
+
+        unique_fd fd(TEMP_FAILURE_RETRY(open(journal_file.c_str(),
+                     O_SYNC | O_CREAT | O_APPEND | O_WRONLY | O_CLOEXEC,
+                     S_IRUSR | S_IWUSR)));
+        if (fd == -1 || !WriteFully(fd, records.data(), records.size())) {
+            PLOG_TO(SYSTEM, ERROR) << "Failed to append to " << journal_file;
+            journal.needs_rewrite = true;
+            return false;
+        }
+        journal.size += records.size();
+        journal.last_end_ts = last_end_ts;
+        return true;
+    }
+
+    records.clear();
+    last_end_ts = 0;
+    for (const auto& item : uid_io_usage.uid_io_items()) {
+        append_uid_io_journal_record(item, &records);
+        last_end_ts = MAX(last_end_ts, item.end_ts());
+    }
+
+    string tmp_file = journal_file + "_tmp";
+    unique_fd fd(TEMP_FAILURE_RETRY(open(tmp_file.c_str(),
+                 O_SYNC | O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC,
+                 S_IRUSR | S_IWUSR)));
+    if (fd == -1 || !WriteFully(fd, records.data(), records.size())) {
+        PLOG_TO(SYSTEM, ERROR) << "Failed to write " << tmp_file;
+        return false;
+    }
+    fd.reset(-1);
+    if (rename(tmp_file.c_str(), journal_file.c_str()) == -1) {
+        PLOG_TO(SYSTEM, ERROR) << "Failed to rename " << tmp_file;
+        return false;
+    }
+
+    journal.size = records.size();
+    journal.last_end_ts = last_end_ts;
+    journal.needs_rewrite = false;
+    return true;
+}
+
 void storaged_t::flush_proto(userid_t user_id, StoragedProto* proto) {
     unique_ptr<char> proto_data(prepare_proto(user_id, proto));
     if (proto_data == nullptr) return;
@@ -305,8 +424,35 @@ void storaged_t::flush_protos(unordered_map<int, StoragedProto>* protos) {
         /*
          * Don't flush proto if we haven't attempted to load it from file.
          */
-        if (proto_loaded[it.first]) {
-            flush_proto(it.first, &it.second);
+        if (!proto_loaded[it.first]) {
+            continue;
+        }
+
+        userid_t user_id = it.first;
+        StoragedProto* proto = &it.second;
+        uid_io_journal& journal = uid_io_journals[user_id];
+
+        /*
+         * The uid I/O history goes to the journal, and only stays in the
+         * proto if that failed.
+         */
+        if (proto->has_uid_io_usage() &&
+            flush_uid_io_journal(user_id, proto->uid_io_usage())) {
+            proto->clear_uid_io_usage();
+        }
+
+        /*
+         * Besides the history, only the proto of the system user has
+         * anything in it: the perf history, which writing the proto
+         * measures. The proto of other users is only kept while the
+         * journal doesn't have their history yet.
+         */
+        if (user_id == USER_SYSTEM || proto->has_uid_io_usage()) {
+            flush_proto(user_id, proto);
+            journal.proto_has_history = proto->has_uid_io_usage();
+        } else if (journal.proto_has_history) {
+            RemoveFileIfExists(proto_path(user_id), nullptr);
+            journal.proto_has_history = false;
         }
     }
 }
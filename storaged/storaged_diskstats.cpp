@@ -16,13 +16,18 @@
 
 #define LOG_TAG "storaged"
 
+#include <dirent.h>
+#include <fcntl.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <sstream>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/strings.h>
 #include <log/log_event_list.h>
 
 #include "storaged.h"
@@ -328,3 +333,218 @@ void disk_stats_monitor::publish(void)
     // Reset global structures
     memset(&mAccumulate_pub, 0, sizeof(struct disk_stats));
 }
+
+/* diskstats_sampler */
+namespace {
+
+bool read_disk_stats_fd(int fd, struct disk_stats* stats) {
+    char buffer[512];
+    ssize_t len = TEMP_FAILURE_RETRY(pread(fd, buffer, sizeof(buffer) - 1, 0));
+    if (len <= 0) {
+        return false;
+    }
+    buffer[len] = '\0';
+
+    // Newer kernels append discard and flush stats; only the first fields matter here.
+    char* p = buffer;
+    for (uint i = 0; i < DISK_STATS_SIZE; ++i) {
+        char* end;
+        *((uint64_t*)stats + i) = strtoull(p, &end, 10);
+        if (end == p) {
+            return false;
+        }
+        p = end;
+    }
+    return true;
+}
+
+uint32_t clamp_u32(uint64_t value) {
+    return value > UINT32_MAX ? UINT32_MAX : (uint32_t)value;
+}
+
+diskstats_percentiles get_percentiles(std::vector<uint32_t>* values) {
+    diskstats_percentiles result = {};
+    if (values->empty()) {
+        return result;
+    }
+    std::sort(values->begin(), values->end());
+    auto at = [values](size_t percent) {
+        return (*values)[(values->size() - 1) * percent / 100];
+    };
+    result.p50 = at(50);
+    result.p90 = at(90);
+    result.p99 = at(99);
+    result.max = values->back();
+    return result;
+}
+
+} // namespace
+
+diskstats_sampler::~diskstats_sampler() {
+    for (auto& dev : mDevices) {
+        close(dev.fd);
+    }
+}
+
+bool diskstats_sampler::add_device(const std::string& name, const std::string& dir) {
+    int fd = TEMP_FAILURE_RETRY(open((dir + "/stat").c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        return false;
+    }
+
+    device dev = {};
+    dev.name = name;
+    dev.fd = fd;
+    dev.ring.resize(mHistory);
+
+    std::string uevent;
+    if (android::base::ReadFileToString(dir + "/uevent", &uevent)) {
+        for (const auto& line : android::base::Split(uevent, "\n")) {
+            if (android::base::StartsWith(line, "PARTNAME=")) {
+                dev.partname = line.substr(strlen("PARTNAME="));
+            }
+        }
+    }
+
+    mDevices.emplace_back(std::move(dev));
+    return true;
+}
+
+size_t diskstats_sampler::scan() {
+    android::Mutex::Autolock _l(mLock);
+
+    for (auto& dev : mDevices) {
+        close(dev.fd);
+    }
+    mDevices.clear();
+
+    std::unique_ptr<DIR, decltype(&closedir)> block(opendir(mSysfsBlock.c_str()), closedir);
+    if (!block) {
+        PLOG_TO(SYSTEM, ERROR) << "opendir " << mSysfsBlock << " failed";
+        return 0;
+    }
+
+    while (struct dirent* disk = readdir(block.get())) {
+        std::string name = disk->d_name;
+        // Loop and ram disks don't say anything about the storage.
+        if (name[0] == '.' || android::base::StartsWith(name, "loop") ||
+            android::base::StartsWith(name, "ram")) {
+            continue;
+        }
+        std::string disk_dir = mSysfsBlock + "/" + name;
+        if (!add_device(name, disk_dir)) {
+            continue;
+        }
+
+        std::unique_ptr<DIR, decltype(&closedir)> parts(opendir(disk_dir.c_str()), closedir);
+        if (!parts) {
+            continue;
+        }
+        while (struct dirent* part = readdir(parts.get())) {
+            std::string part_dir = disk_dir + "/" + part->d_name;
+            if (part->d_name[0] == '.' || access((part_dir + "/partition").c_str(), F_OK)) {
+                continue;
+            }
+            add_device(part->d_name, part_dir);
+        }
+    }
+
+    return mDevices.size();
+}
+
+void diskstats_sampler::record(device* dev, const disk_stats& curr) {
+    if (!dev->primed) {
+        dev->prev = curr;
+        dev->primed = true;
+        return;
+    }
+
+    disk_stats inc = curr - dev->prev;
+    uint64_t interval = curr.end_time - dev->prev.end_time;
+    dev->prev = curr;
+    if (interval == 0 || mHistory == 0) {
+        return;
+    }
+
+    diskstats_sample& s = dev->ring[dev->next];
+    s.end_time = curr.end_time;
+    s.interval = clamp_u32(interval);
+    s.read_perf = clamp_u32(inc.read_sectors * SECTOR_SIZE / interval);
+    s.read_ios = clamp_u32(inc.read_ios * SEC_TO_MSEC / interval);
+    s.read_latency = inc.read_ios ? clamp_u32(inc.read_ticks * MSEC_TO_USEC / inc.read_ios) : 0;
+    s.write_perf = clamp_u32(inc.write_sectors * SECTOR_SIZE / interval);
+    s.write_ios = clamp_u32(inc.write_ios * SEC_TO_MSEC / interval);
+    s.write_latency =
+            inc.write_ios ? clamp_u32(inc.write_ticks * MSEC_TO_USEC / inc.write_ios) : 0;
+    s.queue = clamp_u32(curr.io_in_flight);
+
+    dev->next = (dev->next + 1) % mHistory;
+    dev->count = std::min(dev->count + 1, mHistory);
+}
+
+void diskstats_sampler::sample() {
+    struct timespec ts;
+    if (!get_time(&ts)) {
+        return;
+    }
+
+    android::Mutex::Autolock _l(mLock);
+    for (auto& dev : mDevices) {
+        disk_stats curr = {};
+        if (!read_disk_stats_fd(dev.fd, &curr)) {
+            continue;
+        }
+        init_disk_stats_other(ts, &curr);
+        record(&dev, curr);
+    }
+}
+
+std::vector<diskstats_sample> diskstats_sampler::get_history(const std::string& name) {
+    android::Mutex::Autolock _l(mLock);
+
+    std::vector<diskstats_sample> history;
+    for (const auto& dev : mDevices) {
+        if (dev.name != name) {
+            continue;
+        }
+        // Oldest first.
+        size_t first = (dev.next + mHistory - dev.count) % mHistory;
+        for (size_t i = 0; i < dev.count; ++i) {
+            history.push_back(dev.ring[(first + i) % mHistory]);
+        }
+        break;
+    }
+    return history;
+}
+
+std::vector<diskstats_summary> diskstats_sampler::get_summaries() {
+    android::Mutex::Autolock _l(mLock);
+
+    std::vector<diskstats_summary> summaries;
+    std::vector<uint32_t> values;
+    for (const auto& dev : mDevices) {
+        diskstats_summary summary = {};
+        summary.name = dev.name;
+        summary.partname = dev.partname;
+        summary.samples = dev.count;
+
+        auto percentiles = [&](uint32_t diskstats_sample::*field, bool skip_idle) {
+            values.clear();
+            for (size_t i = 0; i < dev.count; ++i) {
+                uint32_t value = dev.ring[i].*field;
+                // A latency of 0 means nothing completed, not that it was fast.
+                if (value || !skip_idle) {
+                    values.push_back(value);
+                }
+            }
+            return get_percentiles(&values);
+        };
+        summary.read_perf = percentiles(&diskstats_sample::read_perf, false);
+        summary.read_latency = percentiles(&diskstats_sample::read_latency, true);
+        summary.write_perf = percentiles(&diskstats_sample::write_perf, false);
+        summary.write_latency = percentiles(&diskstats_sample::write_latency, true);
+        summary.queue = percentiles(&diskstats_sample::queue, false);
+        summaries.emplace_back(std::move(summary));
+    }
+    return summaries;
+}
@@ -92,6 +92,36 @@ void StoragedService::dumpUidRecordsDebug(int fd, const vector<uid_record>& entr
     }
 }
 
+static void dumpPercentiles(int fd, const char* label, const diskstats_percentiles& p) {
+    dprintf(fd, " %s %" PRIu32 "/%" PRIu32 "/%" PRIu32 "/%" PRIu32,
+            label, p.p50, p.p90, p.p99, p.max);
+}
+
+void StoragedService::dumpDiskstats(int fd) {
+    dprintf(fd, "name partname samples, then p50/p90/p99/max of each metric\n");
+    for (const auto& summary : storaged_sp->get_diskstats_summaries()) {
+        dprintf(fd, "%s %s %" PRIu32, summary.name.c_str(),
+                summary.partname.empty() ? "-" : summary.partname.c_str(), summary.samples);
+        dumpPercentiles(fd, "rd_kbps", summary.read_perf);
+        dumpPercentiles(fd, "rd_lat_us", summary.read_latency);
+        dumpPercentiles(fd, "wr_kbps", summary.write_perf);
+        dumpPercentiles(fd, "wr_lat_us", summary.write_latency);
+        dumpPercentiles(fd, "queue", summary.queue);
+        dprintf(fd, "\n");
+    }
+}
+
+void StoragedService::dumpDiskstatsHistory(int fd, const string& name) {
+    dprintf(fd, "end_ms interval_ms rd_kbps rd_iops rd_lat_us"
+            " wr_kbps wr_iops wr_lat_us queue\n");
+    for (const auto& s : storaged_sp->get_diskstats_history(name)) {
+        dprintf(fd, "%" PRIu64 " %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32
+                " %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 "\n",
+                s.end_time, s.interval, s.read_perf, s.read_ios, s.read_latency,
+                s.write_perf, s.write_ios, s.write_latency, s.queue);
+    }
+}
+
 status_t StoragedService::dump(int fd, const Vector<String16>& args) {
     IPCThreadState* self = IPCThreadState::self();
     const int pid = self->getCallingPid();
@@ -107,6 +137,8 @@ status_t StoragedService::dump(int fd, const Vector<String16>& args) {
     uint64_t threshold = 0;
     bool force_report = false;
     bool debug = false;
+    bool diskstats = false;
+    string diskstats_history;
     for (size_t i = 0; i < args.size(); i++) {
         const auto& arg = args[i];
         if (arg == String16("--hours")) {
@@ -138,6 +170,25 @@ status_t StoragedService::dump(int fd, const Vector<String16>& args) {
             debug = true;
             continue;
         }
+        if (arg == String16("--diskstats")) {
+            diskstats = true;
+            continue;
+        }
+        if (arg == String16("--diskstats_history")) {
+            if (++i >= args.size())
+                break;
+            diskstats_history = String8(args[i]).c_str();
+            continue;
+        }
+    }
+
+    if (diskstats) {
+        dumpDiskstats(fd);
+        return OK;
+    }
+    if (!diskstats_history.empty()) {
+        dumpDiskstatsHistory(fd, diskstats_history);
+        return OK;
     }
 
     uint64_t last_ts = 0;
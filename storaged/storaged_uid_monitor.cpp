@@ -19,7 +19,9 @@
 #include <stdint.h>
 #include <time.h>
 
+#include <charconv>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -27,7 +29,6 @@
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/macros.h>
-#include <android-base/parseint.h>
 #include <android-base/strings.h>
 #include <android-base/stringprintf.h>
 #include <binder/IServiceManager.h>
@@ -44,9 +45,16 @@ using namespace storaged_proto;
 
 namespace {
 
-bool refresh_uid_names;
 const char* UID_IO_STATS_PATH = "/proc/uid_io/stats";
 
+/* parses all of |s| as a decimal number, without copying it */
+template <typename T>
+bool parse_decimal(std::string_view s, T* out)
+{
+    auto result = std::from_chars(s.data(), s.data() + s.size(), *out);
+    return result.ec == std::errc() && result.ptr == s.data() + s.size();
+}
+
 } // namepsace
 
 std::unordered_map<uint32_t, uid_info> uid_monitor::get_uid_io_stats()
@@ -56,21 +64,26 @@ std::unordered_map<uint32_t, uid_info> uid_monitor::get_uid_io_stats()
 };
 
 /* return true on parse success and false on failure */
-bool uid_info::parse_uid_io_stats(std::string&& s)
+bool uid_info::parse_uid_io_stats(std::string_view s)
 {
-    std::vector<std::string> fields = Split(s, " ");
-    if (fields.size() < 11 ||
-        !ParseUint(fields[0],  &uid) ||
-        !ParseUint(fields[1],  &io[FOREGROUND].rchar) ||
-        !ParseUint(fields[2],  &io[FOREGROUND].wchar) ||
-        !ParseUint(fields[3],  &io[FOREGROUND].read_bytes) ||
-        !ParseUint(fields[4],  &io[FOREGROUND].write_bytes) ||
-        !ParseUint(fields[5],  &io[BACKGROUND].rchar) ||
-        !ParseUint(fields[6],  &io[BACKGROUND].wchar) ||
-        !ParseUint(fields[7],  &io[BACKGROUND].read_bytes) ||
-        !ParseUint(fields[8],  &io[BACKGROUND].write_bytes) ||
-        !ParseUint(fields[9],  &io[FOREGROUND].fsync) ||
-        !ParseUint(fields[10], &io[BACKGROUND].fsync)) {
+    std::string_view fields[11];
+    size_t num_fields = 0;
+    for (std::string_view field : SplitView(s, " ")) {
+        if (num_fields == arraysize(fields)) break;
+        fields[num_fields++] = field;
+    }
+    if (num_fields < arraysize(fields) ||
+        !parse_decimal(fields[0],  &uid) ||
+        !parse_decimal(fields[1],  &io[FOREGROUND].rchar) ||
+        !parse_decimal(fields[2],  &io[FOREGROUND].wchar) ||
+        !parse_decimal(fields[3],  &io[FOREGROUND].read_bytes) ||
+        !parse_decimal(fields[4],  &io[FOREGROUND].write_bytes) ||
+        !parse_decimal(fields[5],  &io[BACKGROUND].rchar) ||
+        !parse_decimal(fields[6],  &io[BACKGROUND].wchar) ||
+        !parse_decimal(fields[7],  &io[BACKGROUND].read_bytes) ||
+        !parse_decimal(fields[8],  &io[BACKGROUND].write_bytes) ||
+        !parse_decimal(fields[9],  &io[FOREGROUND].fsync) ||
+        !parse_decimal(fields[10], &io[BACKGROUND].fsync)) {
         LOG_TO(SYSTEM, WARNING) << "Invalid uid I/O stats: \""
                                 << s << "\"";
         return false;
@@ -79,28 +92,39 @@ bool uid_info::parse_uid_io_stats(std::string&& s)
 }
 
 /* return true on parse success and false on failure */
-bool task_info::parse_task_io_stats(std::string&& s)
+bool task_info::parse_task_io_stats(std::string_view s)
 {
-    std::vector<std::string> fields = Split(s, ",");
-    size_t size = fields.size();
-    if (size < 13 ||
-        !ParseInt(fields[size - 11],  &pid) ||
-        !ParseUint(fields[size - 10],  &io[FOREGROUND].rchar) ||
-        !ParseUint(fields[size - 9],  &io[FOREGROUND].wchar) ||
-        !ParseUint(fields[size - 8],  &io[FOREGROUND].read_bytes) ||
-        !ParseUint(fields[size - 7],  &io[FOREGROUND].write_bytes) ||
-        !ParseUint(fields[size - 6],  &io[BACKGROUND].rchar) ||
-        !ParseUint(fields[size - 5],  &io[BACKGROUND].wchar) ||
-        !ParseUint(fields[size - 4],  &io[BACKGROUND].read_bytes) ||
-        !ParseUint(fields[size - 3], &io[BACKGROUND].write_bytes) ||
-        !ParseUint(fields[size - 2], &io[FOREGROUND].fsync) ||
-        !ParseUint(fields[size - 1], &io[BACKGROUND].fsync)) {
+    // "task,<comm>,<pid>,<10 counters>", where comm may contain commas, so the
+    // fields are taken from the end.
+    std::string_view fields[11];
+    std::string_view head = s;
+    for (size_t i = arraysize(fields); i > 0; i--) {
+        size_t comma = head.rfind(',');
+        if (comma == std::string_view::npos) {
+            head = {};
+            break;
+        }
+        fields[i - 1] = head.substr(comma + 1);
+        head = head.substr(0, comma);
+    }
+    size_t comma = head.find(',');
+    if (comma == std::string_view::npos ||
+        !parse_decimal(fields[0],  &pid) ||
+        !parse_decimal(fields[1],  &io[FOREGROUND].rchar) ||
+        !parse_decimal(fields[2],  &io[FOREGROUND].wchar) ||
+        !parse_decimal(fields[3],  &io[FOREGROUND].read_bytes) ||
+        !parse_decimal(fields[4],  &io[FOREGROUND].write_bytes) ||
+        !parse_decimal(fields[5],  &io[BACKGROUND].rchar) ||
+        !parse_decimal(fields[6],  &io[BACKGROUND].wchar) ||
+        !parse_decimal(fields[7],  &io[BACKGROUND].read_bytes) ||
+        !parse_decimal(fields[8],  &io[BACKGROUND].write_bytes) ||
+        !parse_decimal(fields[9],  &io[FOREGROUND].fsync) ||
+        !parse_decimal(fields[10], &io[BACKGROUND].fsync)) {
         LOG_TO(SYSTEM, WARNING) << "Invalid task I/O stats: \""
                                 << s << "\"";
         return false;
     }
-    comm = Join(std::vector<std::string>(
-                fields.begin() + 1, fields.end() - 11), ',');
+    comm = head.substr(comma + 1);
     return true;
 }
 
@@ -119,36 +143,29 @@ bool io_usage::is_zero() const
 
 namespace {
 
-void get_uid_names(const vector<int>& uids, const vector<std::string*>& uid_names)
+/* return true if the package manager answered, with one name per uid */
+bool get_uid_names(const vector<int>& uids, std::vector<std::string>* names)
 {
     sp<IServiceManager> sm = defaultServiceManager();
     if (sm == NULL) {
         LOG_TO(SYSTEM, ERROR) << "defaultServiceManager failed";
-        return;
+        return false;
     }
 
     sp<IBinder> binder = sm->getService(String16("package_native"));
     if (binder == NULL) {
         LOG_TO(SYSTEM, ERROR) << "getService package_native failed";
-        return;
+        return false;
     }
 
     sp<IPackageManagerNative> package_mgr = interface_cast<IPackageManagerNative>(binder);
-    std::vector<std::string> names;
-    binder::Status status = package_mgr->getNamesForUids(uids, &names);
+    binder::Status status = package_mgr->getNamesForUids(uids, names);
     if (!status.isOk()) {
         LOG_TO(SYSTEM, ERROR) << "package_native::getNamesForUids failed: "
                               << status.exceptionMessage();
-        return;
-    }
-
-    for (uint32_t i = 0; i < uid_names.size(); i++) {
-        if (!names[i].empty()) {
-            *uid_names[i] = names[i];
-        }
+        return false;
     }
-
-    refresh_uid_names = false;
+    return names->size() == uids.size();
 }
 
 } // namespace
@@ -162,38 +179,52 @@ std::unordered_map<uint32_t, uid_info> uid_monitor::get_uid_io_stats_locked()
         return uid_io_stats;
     }
 
-    std::vector<std::string> io_stats = Split(std::move(buffer), "\n");
-    uid_info u;
-    vector<int> uids;
-    vector<std::string*> uid_names;
-
-    for (uint32_t i = 0; i < io_stats.size(); i++) {
-        if (io_stats[i].empty()) {
-            continue;
-        }
+    uid_info* u = nullptr;
+    vector<int> unnamed_uids;
 
-        if (io_stats[i].compare(0, 4, "task")) {
-            if (!u.parse_uid_io_stats(std::move(io_stats[i])))
+    for (std::string_view line : Tokenize(buffer, "\n")) {
+        if (!StartsWith(line, "task")) {
+            uid_info parsed;
+            if (!parsed.parse_uid_io_stats(line))
                 continue;
-            uid_io_stats[u.uid] = u;
-            uid_io_stats[u.uid].name = std::to_string(u.uid);
-            uids.push_back(u.uid);
-            uid_names.push_back(&uid_io_stats[u.uid].name);
-            if (last_uid_io_stats_.find(u.uid) == last_uid_io_stats_.end()) {
-                refresh_uid_names = true;
+            u = &uid_io_stats[parsed.uid];
+            *u = std::move(parsed);
+            auto name = uid_names_.find(u->uid);
+            if (name != uid_names_.end()) {
+                u->name = name->second;
             } else {
-                uid_io_stats[u.uid].name = last_uid_io_stats_[u.uid].name;
+                u->name = std::to_string(u->uid);
+                unnamed_uids.push_back(u->uid);
             }
-        } else {
+        } else if (u != nullptr) {
             task_info t;
-            if (!t.parse_task_io_stats(std::move(io_stats[i])))
+            if (!t.parse_task_io_stats(line))
                 continue;
-            uid_io_stats[u.uid].tasks[t.pid] = t;
+            u->tasks[t.pid] = std::move(t);
+        }
+    }
+
+    // Only ask the package manager about the uids we haven't seen yet. If it
+    // doesn't answer, they keep their number as a name and are asked about
+    // again next time.
+    std::vector<std::string> names;
+    if (!unnamed_uids.empty() && get_uid_names(unnamed_uids, &names)) {
+        for (size_t i = 0; i < unnamed_uids.size(); i++) {
+            uid_info& info = uid_io_stats[unnamed_uids[i]];
+            if (!names[i].empty()) {
+                info.name = std::move(names[i]);
+            }
+            uid_names_[info.uid] = info.name;
         }
     }
 
-    if (!uids.empty() && refresh_uid_names) {
-        get_uid_names(uids, uid_names);
+    // Forget the names of uids that went away, their uid may be reused.
+    for (auto it = uid_names_.begin(); it != uid_names_.end();) {
+        if (uid_io_stats.find(it->first) == uid_io_stats.end()) {
+            it = uid_names_.erase(it);
+        } else {
+            ++it;
+        }
     }
 
     return uid_io_stats;
@@ -303,6 +334,56 @@ std::map<uint64_t, struct uid_records> uid_monitor::dump(
     return dump_records;
 }
 
+namespace {
+
+bool io_stats_equal(const io_stats& a, const io_stats& b)
+{
+    return a.rchar == b.rchar && a.wchar == b.wchar &&
+           a.read_bytes == b.read_bytes && a.write_bytes == b.write_bytes &&
+           a.fsync == b.fsync;
+}
+
+bool uid_io_changed(const uid_info& curr, const uid_info& last)
+{
+    if (!io_stats_equal(curr.io[FOREGROUND], last.io[FOREGROUND]) ||
+        !io_stats_equal(curr.io[BACKGROUND], last.io[BACKGROUND]) ||
+        curr.tasks.size() != last.tasks.size()) {
+        return true;
+    }
+    for (const auto& task_it : curr.tasks) {
+        auto last_task = last.tasks.find(task_it.first);
+        if (last_task == last.tasks.end() ||
+            last_task->second.comm != task_it.second.comm ||
+            !io_stats_equal(task_it.second.io[FOREGROUND], last_task->second.io[FOREGROUND]) ||
+            !io_stats_equal(task_it.second.io[BACKGROUND], last_task->second.io[BACKGROUND])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* counters go back to 0 when a uid is removed and added again */
+uint64_t io_delta(uint64_t curr, uint64_t last)
+{
+    int64_t delta = curr - last;
+    return (delta < 0) ? 0 : delta;
+}
+
+void add_io_deltas(io_usage* usage, const io_stats (&curr)[UID_STATS],
+                   const io_stats (&last)[UID_STATS], charger_stat_t charger_stat)
+{
+    usage->bytes[READ][FOREGROUND][charger_stat] +=
+        io_delta(curr[FOREGROUND].read_bytes, last[FOREGROUND].read_bytes);
+    usage->bytes[READ][BACKGROUND][charger_stat] +=
+        io_delta(curr[BACKGROUND].read_bytes, last[BACKGROUND].read_bytes);
+    usage->bytes[WRITE][FOREGROUND][charger_stat] +=
+        io_delta(curr[FOREGROUND].write_bytes, last[FOREGROUND].write_bytes);
+    usage->bytes[WRITE][BACKGROUND][charger_stat] +=
+        io_delta(curr[BACKGROUND].write_bytes, last[BACKGROUND].write_bytes);
+}
+
+} // namespace
+
 void uid_monitor::update_curr_io_stats_locked()
 {
     std::unordered_map<uint32_t, uid_info> uid_io_stats =
@@ -311,59 +392,38 @@ void uid_monitor::update_curr_io_stats_locked()
         return;
     }
 
+    static const io_stats zero_io[UID_STATS] = {};
+
     for (const auto& it : uid_io_stats) {
         const uid_info& uid = it.second;
-        if (curr_io_stats_.find(uid.name) == curr_io_stats_.end()) {
-            curr_io_stats_[uid.name] = {};
+        auto last_it = last_uid_io_stats_.find(uid.uid);
+        const uid_info* last = last_it == last_uid_io_stats_.end() ? nullptr : &last_it->second;
+
+        // Most uids are idle between two reports, skip them without
+        // touching curr_io_stats_.
+        if (last != nullptr && !uid_io_changed(uid, *last)) {
+            continue;
         }
 
         struct uid_io_usage& usage = curr_io_stats_[uid.name];
         usage.user_id = multiuser_get_user_id(uid.uid);
-
-        int64_t fg_rd_delta = uid.io[FOREGROUND].read_bytes -
-            last_uid_io_stats_[uid.uid].io[FOREGROUND].read_bytes;
-        int64_t bg_rd_delta = uid.io[BACKGROUND].read_bytes -
-            last_uid_io_stats_[uid.uid].io[BACKGROUND].read_bytes;
-        int64_t fg_wr_delta = uid.io[FOREGROUND].write_bytes -
-            last_uid_io_stats_[uid.uid].io[FOREGROUND].write_bytes;
-        int64_t bg_wr_delta = uid.io[BACKGROUND].write_bytes -
-            last_uid_io_stats_[uid.uid].io[BACKGROUND].write_bytes;
-
-        usage.uid_ios.bytes[READ][FOREGROUND][charger_stat_] +=
-            (fg_rd_delta < 0) ? 0 : fg_rd_delta;
-        usage.uid_ios.bytes[READ][BACKGROUND][charger_stat_] +=
-            (bg_rd_delta < 0) ? 0 : bg_rd_delta;
-        usage.uid_ios.bytes[WRITE][FOREGROUND][charger_stat_] +=
-            (fg_wr_delta < 0) ? 0 : fg_wr_delta;
-        usage.uid_ios.bytes[WRITE][BACKGROUND][charger_stat_] +=
-            (bg_wr_delta < 0) ? 0 : bg_wr_delta;
+        add_io_deltas(&usage.uid_ios, uid.io, last ? last->io : zero_io, charger_stat_);
 
         for (const auto& task_it : uid.tasks) {
             const task_info& task = task_it.second;
-            const pid_t pid = task_it.first;
-            const std::string& comm = task_it.second.comm;
-            int64_t task_fg_rd_delta = task.io[FOREGROUND].read_bytes -
-                last_uid_io_stats_[uid.uid].tasks[pid].io[FOREGROUND].read_bytes;
-            int64_t task_bg_rd_delta = task.io[BACKGROUND].read_bytes -
-                last_uid_io_stats_[uid.uid].tasks[pid].io[BACKGROUND].read_bytes;
-            int64_t task_fg_wr_delta = task.io[FOREGROUND].write_bytes -
-                last_uid_io_stats_[uid.uid].tasks[pid].io[FOREGROUND].write_bytes;
-            int64_t task_bg_wr_delta = task.io[BACKGROUND].write_bytes -
-                last_uid_io_stats_[uid.uid].tasks[pid].io[BACKGROUND].write_bytes;
-
-            io_usage& task_usage = usage.task_ios[comm];
-            task_usage.bytes[READ][FOREGROUND][charger_stat_] +=
-                (task_fg_rd_delta < 0) ? 0 : task_fg_rd_delta;
-            task_usage.bytes[READ][BACKGROUND][charger_stat_] +=
-                (task_bg_rd_delta < 0) ? 0 : task_bg_rd_delta;
-            task_usage.bytes[WRITE][FOREGROUND][charger_stat_] +=
-                (task_fg_wr_delta < 0) ? 0 : task_fg_wr_delta;
-            task_usage.bytes[WRITE][BACKGROUND][charger_stat_] +=
-                (task_bg_wr_delta < 0) ? 0 : task_bg_wr_delta;
+            const task_info* last_task = nullptr;
+            if (last != nullptr) {
+                auto last_task_it = last->tasks.find(task_it.first);
+                if (last_task_it != last->tasks.end()) {
+                    last_task = &last_task_it->second;
+                }
+            }
+            add_io_deltas(&usage.task_ios[task.comm], task.io,
+                          last_task ? last_task->io : zero_io, charger_stat_);
         }
     }
 
-    last_uid_io_stats_ = uid_io_stats;
+    last_uid_io_stats_ = std::move(uid_io_stats);
 }
 
 void uid_monitor::report(unordered_map<int, StoragedProto>* protos)
@@ -27,6 +27,7 @@
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #include <iomanip>
 #include <sstream>
@@ -130,3 +131,50 @@ map<string, io_usage> merge_io_usage(const vector<uid_record>& entries) {
     }
     return merged_entries;
 }
+
+namespace {
+
+// Seeds the checksum of journal records, so that records of a different
+// format are rejected.
+constexpr uint32_t uid_io_journal_version = 1;
+
+struct uid_io_journal_record_header {
+    uint32_t size;  // of the serialized UidIOItem that follows
+    uint32_t crc;   // of the serialized UidIOItem
+};
+
+uint32_t uid_io_journal_crc(const char* data, size_t size) {
+    return crc32(uid_io_journal_version, reinterpret_cast<const Bytef*>(data), size);
+}
+
+}  // namespace
+
+void append_uid_io_journal_record(const UidIOItem& item, string* journal) {
+    string data = item.SerializeAsString();
+    uid_io_journal_record_header header = {
+        .size = static_cast<uint32_t>(data.size()),
+        .crc = uid_io_journal_crc(data.data(), data.size()),
+    };
+    journal->append(reinterpret_cast<const char*>(&header), sizeof(header));
+    journal->append(data);
+}
+
+size_t parse_uid_io_journal(const string& journal, UidIOUsage* usage) {
+    size_t offset = 0;
+    while (journal.size() - offset >= sizeof(uid_io_journal_record_header)) {
+        uid_io_journal_record_header header;
+        memcpy(&header, journal.data() + offset, sizeof(header));
+        const char* data = journal.data() + offset + sizeof(header);
+        UidIOItem item;
+        if (header.size > journal.size() - offset - sizeof(header) ||
+            header.crc != uid_io_journal_crc(data, header.size) ||
+            !item.ParseFromArray(data, header.size)) {
+            // A record that was only partly written when storaged or the
+            // device went down, and anything after it, is dropped.
+            break;
+        }
+        usage->add_uid_io_items()->Swap(&item);
+        offset += sizeof(header) + header.size;
+    }
+    return offset;
+}
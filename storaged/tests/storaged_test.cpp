@@ -23,6 +23,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <android-base/file.h>
 #include <gtest/gtest.h>
 
 #include <healthhalutils/HealthHalUtils.h>
@@ -684,3 +685,122 @@ TEST(storaged_test, load_uid_io_proto) {
     uidm.load_uid_io_proto(0, user_0);
     ASSERT_LE(io_history.size(), size_t(uid_monitor::MAX_UID_RECORDS_SIZE));
 }
+
+TEST(storaged_test, parse_io_stats) {
+    uid_info u;
+    ASSERT_TRUE(u.parse_uid_io_stats("10123 1 2 3 4 5 6 7 8 9 10"));
+    EXPECT_EQ(10123u, u.uid);
+    EXPECT_EQ(1u, u.io[FOREGROUND].rchar);
+    EXPECT_EQ(4u, u.io[FOREGROUND].write_bytes);
+    EXPECT_EQ(8u, u.io[BACKGROUND].write_bytes);
+    EXPECT_EQ(9u, u.io[FOREGROUND].fsync);
+    EXPECT_EQ(10u, u.io[BACKGROUND].fsync);
+    EXPECT_FALSE(u.parse_uid_io_stats("10123 1 2 3 4 5 6 7 8 9"));
+    EXPECT_FALSE(u.parse_uid_io_stats("10123 1 2 3 4 5 6 7 8 9 x"));
+    EXPECT_FALSE(u.parse_uid_io_stats("10123 1 2 3 4 5 6 7 8 9 -10"));
+
+    // Task names may contain commas.
+    task_info t;
+    ASSERT_TRUE(t.parse_task_io_stats("task,Binder:1,2,1234,1,2,3,4,5,6,7,8,9,10"));
+    EXPECT_EQ("Binder:1,2", t.comm);
+    EXPECT_EQ(1234, t.pid);
+    EXPECT_EQ(3u, t.io[FOREGROUND].read_bytes);
+    EXPECT_EQ(10u, t.io[BACKGROUND].fsync);
+    EXPECT_FALSE(t.parse_task_io_stats("task,1234,1,2,3,4,5,6,7,8,9,10"));
+    EXPECT_FALSE(t.parse_task_io_stats("task,comm,1234,1,2,3,4,5,6,7,8,9,x"));
+}
+
+TEST(storaged_test, uid_io_journal) {
+    string journal;
+    for (uint64_t end_ts = 100; end_ts <= 300; end_ts += 100) {
+        UidIOItem item;
+        item.set_end_ts(end_ts);
+        UidRecord* rec = item.mutable_records()->add_entries();
+        rec->set_uid_name("app" + to_string(end_ts));
+        rec->mutable_uid_io()->set_wr_fg_chg_on(end_ts * 1000);
+        append_uid_io_journal_record(item, &journal);
+    }
+
+    UidIOUsage usage;
+    ASSERT_EQ(journal.size(), parse_uid_io_journal(journal, &usage));
+    ASSERT_EQ(3, usage.uid_io_items_size());
+    EXPECT_EQ(200u, usage.uid_io_items(1).end_ts());
+    EXPECT_EQ("app200", usage.uid_io_items(1).records().entries(0).uid_name());
+    EXPECT_EQ(200000u, usage.uid_io_items(1).records().entries(0).uid_io().wr_fg_chg_on());
+
+    // A torn write only loses the last record.
+    size_t two_records = 0;
+    {
+        UidIOUsage first_two;
+        string partial = journal.substr(0, journal.size() - 1);
+        two_records = parse_uid_io_journal(partial, &first_two);
+        EXPECT_EQ(2, first_two.uid_io_items_size());
+        EXPECT_LT(two_records, partial.size());
+    }
+
+    // Corruption drops the record and everything after it.
+    journal[two_records - 1] ^= 0x55;
+    UidIOUsage corrupted;
+    size_t valid = parse_uid_io_journal(journal, &corrupted);
+    EXPECT_EQ(1, corrupted.uid_io_items_size());
+    EXPECT_LT(valid, two_records);
+}
+
+TEST(storaged_test, diskstats_sampler) {
+    TemporaryDir block;
+    string disk = string(block.path) + "/sda";
+    string part = disk + "/sda1";
+    ASSERT_EQ(0, mkdir(disk.c_str(), 0700));
+    ASSERT_EQ(0, mkdir(part.c_str(), 0700));
+    ASSERT_EQ(0, mkdir((string(block.path) + "/loop0").c_str(), 0700));
+    ASSERT_TRUE(android::base::WriteStringToFile("1\n", part + "/partition"));
+    ASSERT_TRUE(android::base::WriteStringToFile("MAJOR=8\nPARTNAME=userdata\n",
+                                                 part + "/uevent"));
+    ASSERT_TRUE(android::base::WriteStringToFile("0 0 0 0 0 0 0 0 0 0 0\n",
+                                                 string(block.path) + "/loop0/stat"));
+
+    auto write_stats = [&](const string& stats) {
+        ASSERT_TRUE(android::base::WriteStringToFile(stats, disk + "/stat"));
+        ASSERT_TRUE(android::base::WriteStringToFile(stats, part + "/stat"));
+    };
+    write_stats("100 0 800 50 10 0 80 20 0 70 70 0 0 0 0\n");
+
+    diskstats_sampler sampler(block.path, 4);
+    ASSERT_EQ(2u, sampler.scan());
+    sampler.sample();
+    // The first read only sets the baseline.
+    EXPECT_TRUE(sampler.get_history("sda1").empty());
+
+    for (int i = 1; i <= 6; ++i) {
+        usleep(20 * 1000);
+        // Each round, i more reads taking 2ms each and one more write taking 5ms.
+        uint64_t reads = 100 + i * (i + 1) / 2;
+        write_stats(to_string(reads) + " 0 " + to_string(reads * 8) + " " +
+                    to_string(50 + 2 * (reads - 100)) + " " + to_string(10 + i) + " 0 " +
+                    to_string(80 + i * 8) + " " + to_string(20 + 5 * i) + " " +
+                    to_string(i) + " 70 70\n");
+        sampler.sample();
+    }
+
+    // Only the last four intervals are kept, oldest first.
+    vector<diskstats_sample> history = sampler.get_history("sda1");
+    ASSERT_EQ(4u, history.size());
+    for (size_t i = 0; i < history.size(); ++i) {
+        EXPECT_GT(history[i].interval, 0u);
+        EXPECT_EQ(2000u, history[i].read_latency);
+        EXPECT_EQ(5000u, history[i].write_latency);
+        EXPECT_EQ(i + 3, history[i].queue);
+        if (i > 0) EXPECT_GT(history[i].end_time, history[i - 1].end_time);
+    }
+    EXPECT_TRUE(sampler.get_history("loop0").empty());
+
+    vector<diskstats_summary> summaries = sampler.get_summaries();
+    ASSERT_EQ(2u, summaries.size());
+    const diskstats_summary& userdata =
+            summaries[0].name == "sda1" ? summaries[0] : summaries[1];
+    EXPECT_EQ("userdata", userdata.partname);
+    EXPECT_EQ(4u, userdata.samples);
+    EXPECT_EQ(2000u, userdata.read_latency.p99);
+    EXPECT_EQ(4u, userdata.queue.p50);
+    EXPECT_EQ(6u, userdata.queue.max);
+}
@@ -11,6 +11,7 @@
 #include <linux/input.h>
 #include <err.h>
 #include <errno.h>
+#include <signal.h>
 #include <unistd.h>
 
 struct label {
@@ -37,6 +38,34 @@ static struct pollfd *ufds;
 static char **device_names;
 static int nfds;
 
+/*
+ * The records written by -b, in host byte order. A device record is followed
+ * by the device's path, padded with zeroes to a multiple of 4 bytes, and
+ * value is the length of the path. device is the index of the device, as in
+ * the "add device" and "remove device" lines.
+ */
+enum {
+    RECORD_EVENT            = 0,
+    RECORD_ADD_DEVICE       = 1,
+    RECORD_REMOVE_DEVICE    = 2,
+};
+
+struct record {
+    uint32_t sec;
+    uint32_t usec;
+    uint16_t kind;
+    uint16_t device;
+    uint16_t type;
+    uint16_t code;
+    int32_t value;
+};
+
+/* Records are written out whenever this fills up, and on exit. */
+static char record_buf[64 * 1024];
+static size_t record_len;
+static int record_fd = -1;
+static volatile sig_atomic_t stop_recording;
+
 enum {
     PRINT_DEVICE_ERRORS     = 1U << 0,
     PRINT_DEVICE            = 1U << 1,
@@ -60,6 +89,47 @@ static const char *get_label(const struct label *labels, int value)
     return labels->name;
 }
 
+static void flush_records(void)
+{
+    size_t done = 0;
+    while(done < record_len) {
+        ssize_t res = write(record_fd, record_buf + done, record_len - done);
+        if(res < 0) {
+            if(errno == EINTR)
+                continue;
+            err(1, "could not write recording");
+        }
+        done += res;
+    }
+    record_len = 0;
+}
+
+static void add_record(const struct record *record, const char *path)
+{
+    size_t path_len = path ? (strlen(path) + 3) & ~3 : 0;
+    if(record_len + sizeof(*record) + path_len > sizeof(record_buf))
+        flush_records();
+    memcpy(record_buf + record_len, record, sizeof(*record));
+    record_len += sizeof(*record);
+    if(path) {
+        memset(record_buf + record_len, 0, path_len);
+        memcpy(record_buf + record_len, path, strlen(path));
+        record_len += path_len;
+    }
+}
+
+static void record_device(int kind, int index, const char *path)
+{
+    struct record record = { .kind = kind, .device = index, .value = strlen(path) };
+    add_record(&record, kind == RECORD_ADD_DEVICE ? path : NULL);
+}
+
+static void stop_recording_handler(int sig)
+{
+    (void)sig;
+    stop_recording = 1;
+}
+
 static int print_input_props(int fd)
 {
     uint8_t bits[INPUT_PROP_CNT / 8];
@@ -403,6 +473,8 @@ static int open_device(const char *device, int print_flags)
     ufds[nfds].fd = fd;
     ufds[nfds].events = POLLIN;
     device_names[nfds] = strdup(device);
+    if(record_fd >= 0)
+        record_device(RECORD_ADD_DEVICE, nfds, device);
     nfds++;
 
     return 0;
@@ -416,6 +488,8 @@ int close_device(const char *device, int print_flags)
             int count = nfds - i - 1;
             if(print_flags & PRINT_DEVICE)
                 printf("remove device %d: %s\n", i, device);
+            if(record_fd >= 0)
+                record_device(RECORD_REMOVE_DEVICE, i, device);
             free(device_names[i]);
             memmove(device_names + i, device_names + i + 1, sizeof(device_names[0]) * count);
             memmove(ufds + i, ufds + i + 1, sizeof(ufds[0]) * count);
@@ -494,9 +568,85 @@ static int scan_dir(const char *dirname, int print_flags)
     return 0;
 }
 
+/* Prints one event line, for both live events and recorded ones. */
+static void print_event_line(const char *device_name, long sec, long usec, int type, int code,
+                             int value, int get_time, int sync_rate, int64_t *last_sync_time,
+                             const char *newline, int print_flags)
+{
+    if(get_time) {
+        printf("[%8ld.%06ld] ", sec, usec);
+    }
+    if(device_name)
+        printf("%s: ", device_name);
+    print_event(type, code, value, print_flags);
+    if(sync_rate && type == 0 && code == 0) {
+        int64_t now = sec * 1000000LL + usec;
+        if(*last_sync_time)
+            printf(" rate %lld", 1000000LL / (now - *last_sync_time));
+        *last_sync_time = now;
+    }
+    printf("%s", newline);
+}
+
+/* Prints the events recorded with -b in path, like they would have been live. */
+static int print_recording(const char *path, int print_device, int get_time, int sync_rate,
+                           const char *newline, int print_flags)
+{
+    FILE *f = fopen(path, "re");
+    struct record record;
+    char **names = NULL;
+    int count = 0;
+    int64_t last_sync_time = 0;
+
+    if(f == NULL) {
+        fprintf(stderr, "could not open %s, %s\n", path, strerror(errno));
+        return 1;
+    }
+    while(fread(&record, sizeof(record), 1, f) == 1) {
+        if(record.kind == RECORD_ADD_DEVICE) {
+            size_t path_len = (record.value + 3) & ~3;
+            char **new_names = realloc(names, sizeof(names[0]) * (record.device + 1));
+            char *name = calloc(1, path_len + 1);
+            if(new_names == NULL || name == NULL || record.device != count + 1) {
+                fprintf(stderr, "bad device record in %s\n", path);
+                return 1;
+            }
+            names = new_names;
+            if(fread(name, 1, path_len, f) != path_len) {
+                fprintf(stderr, "truncated device record in %s\n", path);
+                return 1;
+            }
+            names[record.device] = name;
+            count++;
+            if(print_flags & PRINT_DEVICE)
+                printf("add device %d: %s\n", record.device, name);
+        } else if(record.kind == RECORD_REMOVE_DEVICE) {
+            if(record.device < 1 || record.device > count) {
+                fprintf(stderr, "bad device record in %s\n", path);
+                return 1;
+            }
+            if(print_flags & PRINT_DEVICE)
+                printf("remove device %d: %s\n", record.device, names[record.device]);
+            free(names[record.device]);
+            memmove(names + record.device, names + record.device + 1,
+                    sizeof(names[0]) * (count - record.device));
+            count--;
+        } else {
+            const char *name = NULL;
+            if(print_device)
+                name = record.device >= 1 && record.device <= count ? names[record.device] : "?";
+            print_event_line(name, record.sec, record.usec, record.type, record.code,
+                             record.value, get_time, sync_rate, &last_sync_time, newline,
+                             print_flags);
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
 static void usage(char *name)
 {
-    fprintf(stderr, "Usage: %s [-t] [-n] [-s switchmask] [-S] [-v [mask]] [-d] [-p] [-i] [-l] [-q] [-c count] [-r] [device]\n", name);
+    fprintf(stderr, "Usage: %s [-t] [-n] [-s switchmask] [-S] [-v [mask]] [-d] [-p] [-i] [-l] [-q] [-c count] [-r] [-b file] [-B file] [device]\n", name);
     fprintf(stderr, "    -t: show time stamps\n");
     fprintf(stderr, "    -n: don't print newlines\n");
     fprintf(stderr, "    -s: print switch states for given bits\n");
@@ -509,6 +659,8 @@ static void usage(char *name)
     fprintf(stderr, "    -q: quiet (clear verbosity mask)\n");
     fprintf(stderr, "    -c: print given number of events then exit\n");
     fprintf(stderr, "    -r: print rate events are received\n");
+    fprintf(stderr, "    -b: record events to file in a compact binary form instead of printing them\n");
+    fprintf(stderr, "    -B: print the events recorded with -b in file, then exit\n");
 }
 
 int getevent_main(int argc, char *argv[])
@@ -520,7 +672,9 @@ int getevent_main(int argc, char *argv[])
     int print_device = 0;
     char *newline = "\n";
     uint16_t get_switch = 0;
-    struct input_event event;
+    struct input_event events[64];
+    const char *record_path = NULL;
+    const char *recording = NULL;
     int print_flags = 0;
     int print_flags_set = 0;
     int dont_block = -1;
@@ -530,12 +684,12 @@ int getevent_main(int argc, char *argv[])
     const char *device = NULL;
     const char *device_path = "/dev/input";
 
-    /* disable buffering on stdout */
-    setbuf(stdout, NULL);
+    /* stdout is flushed after each batch of events instead of after each write */
+    setvbuf(stdout, NULL, _IOFBF, BUFSIZ);
 
     opterr = 0;
     do {
-        c = getopt(argc, argv, "tns:Sv::dpilqc:rh");
+        c = getopt(argc, argv, "tns:Sv::dpilqc:rb:B:h");
         if (c == EOF)
             break;
         switch (c) {
@@ -591,6 +745,12 @@ int getevent_main(int argc, char *argv[])
         case 'r':
             sync_rate = 1;
             break;
+        case 'b':
+            record_path = optarg;
+            break;
+        case 'B':
+            recording = optarg;
+            break;
         case '?':
             fprintf(stderr, "%s: invalid option -%c\n",
                 argv[0], optopt);
@@ -610,6 +770,26 @@ int getevent_main(int argc, char *argv[])
         usage(argv[0]);
         exit(1);
     }
+    if(recording) {
+        if(!print_flags_set)
+            print_flags |= PRINT_DEVICE_ERRORS | PRINT_DEVICE;
+        return print_recording(recording, device == NULL, get_time, sync_rate, newline,
+                               print_flags);
+    }
+    if(record_path) {
+        struct sigaction sa;
+        record_fd = open(record_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if(record_fd < 0) {
+            fprintf(stderr, "could not open %s, %s\n", record_path, strerror(errno));
+            return 1;
+        }
+        /* Without SA_RESTART, so that poll returns and the last records get written. */
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = stop_recording_handler;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+        sigaction(SIGHUP, &sa, NULL);
+    }
     nfds = 1;
     ufds = calloc(1, sizeof(ufds[0]));
     ufds[0].fd = inotify_init();
@@ -650,43 +830,67 @@ int getevent_main(int argc, char *argv[])
         }
     }
 
-    if(dont_block)
+    if(dont_block) {
+        if(record_fd >= 0)
+            flush_records();
         return 0;
+    }
 
-    while(1) {
+    fflush(stdout);
+    while(!stop_recording) {
         //int pollres =
         poll(ufds, nfds, -1);
         //printf("poll %d, returned %d\n", nfds, pollres);
+        if(stop_recording)
+            break;
         if(ufds[0].revents & POLLIN) {
             read_notify(device_path, ufds[0].fd, print_flags);
         }
         for(i = 1; i < nfds; i++) {
             if(ufds[i].revents) {
                 if(ufds[i].revents & POLLIN) {
-                    res = read(ufds[i].fd, &event, sizeof(event));
-                    if(res < (int)sizeof(event)) {
+                    /* Take all of the events that are already there in one read. */
+                    int count, j;
+                    res = read(ufds[i].fd, events, sizeof(events));
+                    if(res < (int)sizeof(events[0])) {
                         fprintf(stderr, "could not get event\n");
                         return 1;
                     }
-                    if(get_time) {
-                        printf("[%8ld.%06ld] ", event.time.tv_sec, event.time.tv_usec);
-                    }
-                    if(print_device)
-                        printf("%s: ", device_names[i]);
-                    print_event(event.type, event.code, event.value, print_flags);
-                    if(sync_rate && event.type == 0 && event.code == 0) {
-                        int64_t now = event.time.tv_sec * 1000000LL + event.time.tv_usec;
-                        if(last_sync_time)
-                            printf(" rate %lld", 1000000LL / (now - last_sync_time));
-                        last_sync_time = now;
+                    count = res / sizeof(events[0]);
+                    if(event_count && count > event_count)
+                        count = event_count;
+                    for(j = 0; j < count; j++) {
+                        const struct input_event *event = &events[j];
+                        if(record_fd >= 0) {
+                            struct record record = {
+                                .sec = event->time.tv_sec,
+                                .usec = event->time.tv_usec,
+                                .kind = RECORD_EVENT,
+                                .device = i,
+                                .type = event->type,
+                                .code = event->code,
+                                .value = event->value,
+                            };
+                            add_record(&record, NULL);
+                        } else {
+                            print_event_line(print_device ? device_names[i] : NULL,
+                                             event->time.tv_sec, event->time.tv_usec,
+                                             event->type, event->code, event->value, get_time,
+                                             sync_rate, &last_sync_time, newline, print_flags);
+                        }
                     }
-                    printf("%s", newline);
-                    if(event_count && --event_count == 0)
+                    if(event_count && (event_count -= count) == 0) {
+                        if(record_fd >= 0)
+                            flush_records();
                         return 0;
+                    }
                 }
             }
         }
+        fflush(stdout);
     }
 
+    if(record_fd >= 0)
+        flush_records();
     return 0;
 }
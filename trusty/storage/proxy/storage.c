@@ -16,6 +16,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
@@ -30,6 +31,7 @@
 
 #define FD_TBL_SIZE 64
 #define MAX_READ_SIZE 4096
+#define MAX_SYNC_THREADS 8
 
 enum sync_state {
     SS_UNUSED = -1,
@@ -83,10 +85,14 @@ static int lookup_fd(uint32_t handle, bool dirty)
     return handle;
 }
 
-static int remove_fd(uint32_t handle)
+static int remove_fd(uint32_t handle, bool *dirty)
 {
     if (handle < FD_TBL_SIZE) {
+        *dirty = fd_state[handle] == SS_DIRTY;
         fd_state[handle] = SS_UNUSED; /* set to uninstalled */
+    } else {
+        /* untracked fds are always synced before they are closed */
+        *dirty = true;
     }
     return handle;
 }
@@ -307,10 +313,18 @@ int storage_file_close(struct storage_msg *msg,
         goto err_response;
     }
 
-    int fd = remove_fd(req->handle);
+    bool dirty;
+    int fd = remove_fd(req->handle, &dirty);
     ALOGV("%s: handle = %u: fd = %u\n", __func__, req->handle, fd);
 
-    int rc = fsync(fd);
+    /*
+     * Once the fd is closed the next checkpoint can't sync it anymore, so
+     * sync it now unless nothing has been written to it since the last one.
+     */
+    int rc = 0;
+    if (dirty) {
+        rc = fsync(fd);
+    }
     if (rc < 0) {
         rc = errno;
         ALOGE("%s: fsync failed for fd=%u: %s\n",
@@ -483,37 +497,102 @@ int storage_init(const char *dirname)
     return 0;
 }
 
+struct sync_work {
+    pthread_t thread;
+    int fd;
+    int rc;
+    int error;
+};
+
+static void *sync_thread(void *arg)
+{
+    struct sync_work *work = arg;
+
+    work->rc = fsync(work->fd);
+    work->error = errno;
+    return NULL;
+}
+
+/*
+ * Syncs all of the fds, and the directory if dir is true. The syncs are
+ * issued concurrently, so that the filesystem can commit them together
+ * rather than one after the other.
+ */
+static int sync_fds(const int *fds, uint cnt, bool dir)
+{
+    struct sync_work work[FD_TBL_SIZE + 1];
+    uint work_cnt = 0;
+    int rc = 0;
+
+    for (uint i = 0; i < cnt; i++) {
+        work[work_cnt++].fd = fds[i];
+    }
+    if (dir) {
+        work[work_cnt++].fd = ssdir_fd;
+    }
+
+    /* the first one, and any beyond MAX_SYNC_THREADS, are synced on this thread */
+    uint started = 1;
+    for (uint i = 1; i < work_cnt && i < MAX_SYNC_THREADS; i++, started++) {
+        if (pthread_create(&work[i].thread, NULL, sync_thread, &work[i])) {
+            break;
+        }
+    }
+    for (uint i = 0; i < work_cnt; i++) {
+        if (i == 0 || i >= started) {
+            sync_thread(&work[i]);
+        } else {
+            pthread_join(work[i].thread, NULL);
+        }
+    }
+
+    for (uint i = 0; i < work_cnt; i++) {
+        if (work[i].rc < 0) {
+            if (work[i].fd == ssdir_fd) {
+                ALOGE("fsync for ssdir failed: %s\n", strerror(work[i].error));
+            } else {
+                ALOGE("fsync for fd=%d failed: %s\n", work[i].fd, strerror(work[i].error));
+            }
+            errno = work[i].error;
+            rc = work[i].rc;
+        }
+    }
+    return rc;
+}
+
 int storage_sync_checkpoint(void)
 {
     int rc;
+    int dirty_fds[FD_TBL_SIZE];
+    uint dirty_cnt = 0;
 
     /* sync fd table and reset it to clean state first */
     for (uint fd = 0; fd < FD_TBL_SIZE; fd++) {
          if (fd_state[fd] == SS_DIRTY) {
              if (fs_state == SS_CLEAN) {
                  /* need to sync individual fd */
-                 rc = fsync(fd);
-                 if (rc < 0) {
-                     ALOGE("fsync for fd=%d failed: %s\n", fd, strerror(errno));
-                     return rc;
-                 }
+                 dirty_fds[dirty_cnt++] = fd;
              }
-             fd_state[fd] = SS_CLEAN; /* set to clean */
          }
     }
 
     /* check if we need to sync the directory */
-    if (dir_state == SS_DIRTY) {
-        if (fs_state == SS_CLEAN) {
-            rc = fsync(ssdir_fd);
-            if (rc < 0) {
-                ALOGE("fsync for ssdir failed: %s\n", strerror(errno));
-                return rc;
-            }
+    bool sync_dir = dir_state == SS_DIRTY && fs_state == SS_CLEAN;
+
+    if (dirty_cnt || sync_dir) {
+        rc = sync_fds(dirty_fds, dirty_cnt, sync_dir);
+        if (rc < 0) {
+            return rc;
         }
-        dir_state = SS_CLEAN;  /* set to clean */
     }
 
+    for (uint fd = 0; fd < FD_TBL_SIZE; fd++) {
+         if (fd_state[fd] == SS_DIRTY) {
+             fd_state[fd] = SS_CLEAN; /* set to clean */
+         }
+    }
+    dir_state = SS_CLEAN;  /* set to clean */
+
     /* check if we need to sync the whole fs */
     if (fs_state == SS_DIRTY) {
         rc = syscall(SYS_syncfs, ssdir_fd);
@@ -526,4 +605,3 @@ int storage_sync_checkpoint(void)
 
     return 0;
 }
-
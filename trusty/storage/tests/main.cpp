@@ -16,6 +16,8 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <chrono>
+#include <string>
 #include <gtest/gtest.h>
 
 #include <trusty/lib/storage.h>
@@ -3037,3 +3039,43 @@ TEST_P(StorageServiceTest, Transact2_Write_Write_Discard_Discard) {
     storage_delete_file(session_, fname, STORAGE_OP_COMPLETE);
 }
 
+// Measures how long small committed transactions take, which on the TD port
+// is mostly the syncs that the proxy issues at commit.
+TEST_P(StorageServiceTest, TransactCommitLatency) {
+    int rc;
+    const size_t file_cnt = 4;
+    const size_t blk = 512;
+    const int iterations = 32;
+    file_handle_t handles[file_cnt];
+
+    for (size_t i = 0; i < file_cnt; i++) {
+        std::string fname = "test_transact_commit_latency_" + std::to_string(i);
+        rc = storage_open_file(session_, &handles[i], fname.c_str(),
+                               STORAGE_FILE_OPEN_CREATE | STORAGE_FILE_OPEN_TRUNCATE,
+                               STORAGE_OP_COMPLETE);
+        ASSERT_EQ(0, rc);
+    }
+
+    // write to every file, then commit once
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < iterations; n++) {
+        for (size_t i = 0; i < file_cnt; i++) {
+            WritePattern(handles[i], n * blk, blk, blk, false);
+            ASSERT_FALSE(HasFatalFailure());
+        }
+        rc = storage_end_transaction(session_, true);
+        ASSERT_EQ(0, rc);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    auto avg_us =
+            std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / iterations;
+    RecordProperty("avg_commit_us", avg_us);
+    printf("%zu files x %zu bytes: %lld us per commit\n", file_cnt, blk, (long long)avg_us);
+
+    // cleanup
+    for (size_t i = 0; i < file_cnt; i++) {
+        std::string fname = "test_transact_commit_latency_" + std::to_string(i);
+        storage_close_file(handles[i]);
+        storage_delete_file(session_, fname.c_str(), STORAGE_OP_COMPLETE);
+    }
+}